@@ -0,0 +1,889 @@
+/**
+ * @file bench_cpu.cpp
+ * @brief Microbenchmarks for the CPU hot paths: noise, terrain generation, height queries, camera math, scene queries
+ *        and crowd steering.
+ *
+ * Every benchmark reports its throughput and the number of heap allocations per iteration;
+ * index generation and reordering also report the ACMR of the resulting triangle order.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "affine.hpp"
+#include "audio_occlusion.hpp"
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "concurrent_map.hpp"
+#include "crowd.hpp"
+#include "frustum.hpp"
+#include "height_field.hpp"
+#include "job_system.hpp"
+#include "landscape.hpp"
+#include "mpmc_queue.hpp"
+#include "nav_mesh.hpp"
+#include "noise.hpp"
+#include "vertex_cache.hpp"
+
+namespace {
+    std::atomic<uint64_t> g_allocations{0};
+
+    /// Reports allocations made since construction as a per-iteration average.
+    struct AllocationCounter {
+        benchmark::State& state;
+        uint64_t start = g_allocations.load(std::memory_order_relaxed);
+
+        explicit AllocationCounter(benchmark::State& s) : state(s) {}
+        ~AllocationCounter() {
+            state.counters["allocs"] = benchmark::Counter((double)(g_allocations.load(std::memory_order_relaxed) - start),
+                                                          benchmark::Counter::kAvgIterations);
+        }
+    };
+
+    void set_rate(benchmark::State& state, const char* name, double itemsPerIteration) {
+        state.counters[name] = benchmark::Counter(itemsPerIteration * state.iterations(), benchmark::Counter::kIsRate);
+    }
+
+    // Two triangles per cell in plain row-major order, the layout the stripes replace
+    std::vector<uint32_t> make_row_major_grid(uint32_t n) {
+        std::vector<uint32_t> indices;
+        indices.reserve((size_t)(n - 1) * (n - 1) * 6);
+        for (uint32_t z = 0; z < n - 1; ++z) {
+            for (uint32_t x = 0; x < n - 1; ++x) {
+                uint32_t i0 = z * n + x;
+                indices.insert(indices.end(), { i0, i0 + n, i0 + 1, i0 + 1, i0 + n, i0 + n + 1 });
+            }
+        }
+        return indices;
+    }
+
+    void make_points(std::vector<float>& xs, std::vector<float>& zs, size_t n) {
+        xs.resize(n);
+        zs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            xs[i] = -20.0f + 40.0f * (float)(i % 317) / 317.0f;
+            zs[i] = -20.0f + 40.0f * (float)(i / 317 % 293) / 293.0f;
+        }
+    }
+
+    // Unit boxes on a square grid two units apart, jittered so no two rows line up
+    std::vector<BoundingBox> make_scene_boxes(size_t n) {
+        const size_t side = (size_t)std::ceil(std::sqrt((double)n));
+        std::vector<BoundingBox> boxes(n);
+        for (size_t i = 0; i < n; ++i) {
+            float x = 2.0f * (float)(i % side) + 0.3f * (float)(i * 7 % 5);
+            float z = 2.0f * (float)(i / side) + 0.3f * (float)(i * 3 % 7);
+            boxes[i] = { { x - 0.5f, 0.0f, z - 0.5f }, { x + 0.5f, 1.0f, z + 0.5f } };
+        }
+        return boxes;
+    }
+
+    Bvh make_bvh(const std::vector<BoundingBox>& boxes, std::vector<uint32_t>* leaves = nullptr) {
+        Bvh bvh;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            uint32_t leaf = bvh_insert(bvh, boxes[i], (uint32_t)i);
+            if (leaves) {
+                leaves->push_back(leaf);
+            }
+        }
+        return bvh;
+    }
+}
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// --- Noise ---
+
+static void BM_FractalNoise(benchmark::State& state) {
+    AllocationCounter allocs(state);
+    float x = 0.0f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fractal_noise(x, 0.37f * x));
+        x += 0.013f;
+    }
+    set_rate(state, "samples/s", 1.0);
+}
+BENCHMARK(BM_FractalNoise);
+
+static void BM_FractalNoiseBatch(benchmark::State& state) {
+    const size_t n = state.range(0);
+    NoiseSettings settings;
+    settings.basis = (NoiseBasis)state.range(1);
+    settings.interpolation = (NoiseInterpolation)state.range(2);
+    std::vector<float> xs, zs, out(n);
+    make_points(xs, zs, n);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        fractal_noise_batch(xs.data(), zs.data(), out.data(), n, settings);
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "samples/s", (double)n);
+}
+BENCHMARK(BM_FractalNoiseBatch)
+    ->Args({4096, (int)NoiseBasis::Value, (int)NoiseInterpolation::Cosine})
+    ->Args({4096, (int)NoiseBasis::Value, (int)NoiseInterpolation::Smoothstep})
+    ->Args({4096, (int)NoiseBasis::Gradient, (int)NoiseInterpolation::Smoothstep})
+    ->Args({4096, (int)NoiseBasis::Simplex, (int)NoiseInterpolation::Smoothstep});
+
+// The same fields with only the octave count fixed, branching on the basis every octave; the
+// registered instantiations above fix the basis too
+static void BM_FractalNoiseBatchSettingsField(benchmark::State& state) {
+    const size_t n = state.range(0);
+    NoiseSettings settings;
+    settings.basis = (NoiseBasis)state.range(1);
+    settings.interpolation = (NoiseInterpolation)state.range(2);
+    std::vector<float> xs, zs, out(n);
+    make_points(xs, zs, n);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        fractal_noise_batch<5>(xs.data(), zs.data(), out.data(), n, settings);
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "samples/s", (double)n);
+}
+BENCHMARK(BM_FractalNoiseBatchSettingsField)
+    ->Args({4096, (int)NoiseBasis::Value, (int)NoiseInterpolation::Cosine})
+    ->Args({4096, (int)NoiseBasis::Simplex, (int)NoiseInterpolation::Smoothstep});
+
+// Value and both derivatives per sample; compare with five BM_FractalNoiseBatch samples for central differences
+static void BM_FractalNoiseSampleBatch(benchmark::State& state) {
+    const size_t n = state.range(0);
+    NoiseSettings settings;
+    settings.basis = (NoiseBasis)state.range(1);
+    settings.interpolation = NoiseInterpolation::Smoothstep;
+    std::vector<float> xs, zs;
+    std::vector<NoiseSample> out(n);
+    make_points(xs, zs, n);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        fractal_noise_sample_batch(xs.data(), zs.data(), out.data(), n, settings);
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "samples/s", (double)n);
+}
+BENCHMARK(BM_FractalNoiseSampleBatch)
+    ->Args({4096, (int)NoiseBasis::Value})
+    ->Args({4096, (int)NoiseBasis::Gradient})
+    ->Args({4096, (int)NoiseBasis::Simplex});
+
+// A 64x64 grid at the terrain's 0.1 noise units per sample, against BM_FractalNoiseBatch's 4096 scattered points
+static void BM_FractalNoiseGrid(benchmark::State& state) {
+    const size_t side = 64;
+    NoiseSettings settings;
+    settings.basis = (NoiseBasis)state.range(0);
+    std::vector<float> xs(side), zs(side), out(side * side);
+    for (size_t i = 0; i < side; ++i) {
+        xs[i] = -3.2f + 0.1f * i;
+        zs[i] = 1.9f + 0.1f * i;
+    }
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        fractal_noise_grid(xs.data(), side, zs.data(), side, out.data(), settings);
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "samples/s", (double)(side * side));
+}
+BENCHMARK(BM_FractalNoiseGrid)->Arg((int)NoiseBasis::Value)->Arg((int)NoiseBasis::Gradient);
+
+// --- Terrain generation ---
+
+static void BM_CreateLandscape(benchmark::State& state) {
+    const int size = (int)state.range(0);
+    std::vector<uint32_t> rowMajor = make_row_major_grid(size);
+    MeshData striped = create_landscape(size, size);
+    state.counters["acmr_row_major"] = vertex_cache_acmr(rowMajor.data(), rowMajor.size(), (size_t)size * size);
+    state.counters["acmr"] = vertex_cache_acmr(striped.indices, striped.vertices.size());
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        MeshData landscape = create_landscape(size, size);
+        benchmark::DoNotOptimize(landscape.vertices.data());
+    }
+    set_rate(state, "vertices/s", (double)size * size);
+}
+BENCHMARK(BM_CreateLandscape)->Arg(50)->Arg(256)->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+
+// Scaling curve: the same landscape on 2 to 8 threads, the caller included; BM_CreateLandscape is the 1-thread point
+static void BM_CreateLandscapeParallel(benchmark::State& state) {
+    const int size = (int)state.range(0);
+    const uint32_t threads = (uint32_t)state.range(1);
+    JobSystem jobs({ threads - 1, 1 });
+    for (auto _ : state) {
+        MeshData landscape = create_landscape(size, size, jobs);
+        benchmark::DoNotOptimize(landscape.vertices.data());
+    }
+    state.counters["threads"] = (double)threads;
+    set_rate(state, "vertices/s", (double)size * size);
+}
+BENCHMARK(BM_CreateLandscapeParallel)
+    ->ArgsProduct({ { 1024, 4096 }, { 2, 4, 6, 8 } })
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_CreateTerrainChunk(benchmark::State& state) {
+    const int resolution = (int)state.range(0);
+    AllocationCounter allocs(state);
+    int chunk = 0;
+    for (auto _ : state) {
+        MeshData mesh = create_terrain_chunk(chunk++, 0, resolution, 32.0f);
+        benchmark::DoNotOptimize(mesh.vertices.data());
+    }
+    set_rate(state, "vertices/s", (double)resolution * resolution);
+}
+BENCHMARK(BM_CreateTerrainChunk)->Arg(33)->Arg(65)->Unit(benchmark::kMicrosecond);
+
+namespace {
+    // The largest cell ChunkManagerConfig::vertexLitPixels lights per vertex by default
+    constexpr int LIGHTING_CELL_PIXELS = 4;
+
+    // Interpolates across a grid cell's two triangles, split along the b-c diagonal
+    template <typename T>
+    T cell_interpolate(T a, T b, T c, T d, float u, float v) {
+        return u + v < 1.0f ? a + u * (b - a) + v * (c - a) : d + (1.0f - u) * (c - d) + (1.0f - v) * (b - d);
+    }
+
+    float lambert(simd::float3 normal, simd::float3 light) {
+        return std::min(std::max(simd::dot(simd::normalize(normal), light), 0.0f), 1.0f);
+    }
+
+    // Lights every cell of a chunk drawn at a LOD level, each covering LIGHTING_CELL_PIXELS squared
+    // pixels: per pixel from the interpolated normal as landscape_fragment_main does, or per vertex
+    // and interpolated as with ShaderVariant::vertexLighting
+    void light_cells(const MeshData& chunk, int resolution, int level, simd::float3 light, bool perVertex,
+                     std::vector<float>& vertexDiffuse, std::vector<float>& out) {
+        const int step = 1 << level;
+        const int cells = (resolution - 1) / step;
+        if (perVertex) {
+            for (int z = 0; z < resolution; z += step) {
+                for (int x = 0; x < resolution; x += step) {
+                    vertexDiffuse[z * resolution + x] = lambert(chunk.vertices[z * resolution + x].normal, light);
+                }
+            }
+        }
+        out.resize((size_t)cells * cells * LIGHTING_CELL_PIXELS * LIGHTING_CELL_PIXELS);
+        float* pixel = out.data();
+        for (int cz = 0; cz < cells; ++cz) {
+            for (int cx = 0; cx < cells; ++cx) {
+                const int a = cz * step * resolution + cx * step;
+                const int corners[4] = { a, a + step, a + step * resolution, a + step * resolution + step };
+                for (int py = 0; py < LIGHTING_CELL_PIXELS; ++py) {
+                    for (int px = 0; px < LIGHTING_CELL_PIXELS; ++px) {
+                        const float u = (px + 0.5f) / LIGHTING_CELL_PIXELS;
+                        const float v = (py + 0.5f) / LIGHTING_CELL_PIXELS;
+                        if (perVertex) {
+                            *pixel++ = cell_interpolate(vertexDiffuse[corners[0]], vertexDiffuse[corners[1]],
+                                                        vertexDiffuse[corners[2]], vertexDiffuse[corners[3]], u, v);
+                        } else {
+                            const simd::float3 normal = cell_interpolate(
+                                chunk.vertices[corners[0]].normal, chunk.vertices[corners[1]].normal,
+                                chunk.vertices[corners[2]].normal, chunk.vertices[corners[3]].normal, u, v);
+                            *pixel++ = lambert(normal, light);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Per-vertex against per-pixel terrain lighting of one chunk at a LOD level (arg 0); arg 1 selects
+// per vertex. Besides the CPU cost per pixel of each, the per-vertex runs report how far their
+// diffuse term strays from the per-pixel one in 8-bit levels, the quality side of the trade; GPU
+// frame times of the same choice come from --benchmark with and without --vertex-lighting.
+static void BM_TerrainLighting(benchmark::State& state) {
+    const int level = (int)state.range(0);
+    const bool perVertex = state.range(1) != 0;
+    const int resolution = 33;
+    const MeshData chunk = create_terrain_chunk(3, 5, resolution, 32.0f);
+    const simd::float3 light = simd::normalize(simd::float3{ 0.4f, 0.8f, 0.3f });
+    std::vector<float> vertexDiffuse((size_t)resolution * resolution), out;
+    light_cells(chunk, resolution, level, light, perVertex, vertexDiffuse, out);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        light_cells(chunk, resolution, level, light, perVertex, vertexDiffuse, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    std::vector<float> reference;
+    light_cells(chunk, resolution, level, light, false, vertexDiffuse, reference);
+    double sum = 0.0, largest = 0.0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        const double error = std::fabs(out[i] - reference[i]) * 255.0;
+        sum += error;
+        largest = std::max(largest, error);
+    }
+    state.counters["mean_error_levels"] = sum / (double)out.size();
+    state.counters["max_error_levels"] = largest;
+    set_rate(state, "pixels/s", (double)out.size());
+}
+BENCHMARK(BM_TerrainLighting)->ArgsProduct({ { 0, 2, 4 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+
+static void BM_OptimizeVertexCache(benchmark::State& state) {
+    const uint32_t size = (uint32_t)state.range(0);
+    const size_t vertexCount = (size_t)size * size;
+    const std::vector<uint32_t> rowMajor = make_row_major_grid(size);
+    std::vector<uint32_t> indices;
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        state.PauseTiming();
+        indices = rowMajor;
+        state.ResumeTiming();
+        optimize_vertex_cache(indices.data(), indices.size(), vertexCount);
+        benchmark::ClobberMemory();
+    }
+    state.counters["acmr_before"] = vertex_cache_acmr(rowMajor.data(), rowMajor.size(), vertexCount);
+    state.counters["acmr_after"] = vertex_cache_acmr(indices.data(), indices.size(), vertexCount);
+    set_rate(state, "triangles/s", (double)rowMajor.size() / 3);
+}
+BENCHMARK(BM_OptimizeVertexCache)->Arg(33)->Arg(256)->Unit(benchmark::kMillisecond);
+
+// --- Height queries ---
+
+static void BM_GetTerrainHeight(benchmark::State& state) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 4096);
+
+    AllocationCounter allocs(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(get_terrain_height(xs[i], zs[i]));
+        i = (i + 1) % xs.size();
+    }
+    set_rate(state, "queries/s", 1.0);
+}
+BENCHMARK(BM_GetTerrainHeight);
+
+static void BM_GetTerrainHeights(benchmark::State& state) {
+    std::vector<float> xs, zs, out;
+    make_points(xs, zs, 4096);
+    out.resize(xs.size());
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        get_terrain_heights(xs.data(), zs.data(), out.data(), xs.size());
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "queries/s", (double)xs.size());
+}
+BENCHMARK(BM_GetTerrainHeights);
+
+static void BM_GetTerrainHeight4(benchmark::State& state) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 4096);
+
+    AllocationCounter allocs(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        const simd::float4 x = { xs[i], xs[i + 1], xs[i + 2], xs[i + 3] };
+        const simd::float4 z = { zs[i], zs[i + 1], zs[i + 2], zs[i + 3] };
+        benchmark::DoNotOptimize(get_terrain_height4(x, z));
+        i = (i + 4) % xs.size();
+    }
+    set_rate(state, "queries/s", 4.0);
+}
+BENCHMARK(BM_GetTerrainHeight4);
+
+static void BM_GetTerrainHeight8(benchmark::State& state) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 4096);
+
+    AllocationCounter allocs(state);
+    size_t i = 0;
+    for (auto _ : state) {
+        simd::float8 x, z;
+        for (size_t j = 0; j < 8; ++j) {
+            x[j] = xs[i + j];
+            z[j] = zs[i + j];
+        }
+        benchmark::DoNotOptimize(get_terrain_height8(x, z));
+        i = (i + 8) % xs.size();
+    }
+    set_rate(state, "queries/s", 8.0);
+}
+BENCHMARK(BM_GetTerrainHeight8);
+
+static void BM_HeightFieldHeights(benchmark::State& state) {
+    HeightField field = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f);
+    std::vector<float> xs, zs, out;
+    make_points(xs, zs, 4096);
+    out.resize(xs.size());
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        height_field_heights(field, xs.data(), zs.data(), out.data(), xs.size());
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "queries/s", (double)xs.size());
+}
+BENCHMARK(BM_HeightFieldHeights);
+
+namespace {
+    // Shallow rays from above the terrain in every direction, the kind line-of-sight checks cast
+    void make_rays(std::vector<simd::float3>& origins, std::vector<simd::float3>& directions,
+                   std::vector<float>& maxDistances, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            float angle = 0.61f * (float)i;
+            origins.push_back({ -40.0f + 80.0f * (float)(i % 61) / 61.0f, 8.0f, -40.0f + 80.0f * (float)(i % 53) / 53.0f });
+            directions.push_back({ std::cos(angle), -0.15f, std::sin(angle) });
+            maxDistances.push_back(64.0f);
+        }
+    }
+}
+
+static void BM_HeightFieldRaycast(benchmark::State& state) {
+    HeightField field = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f);
+    std::vector<simd::float3> origins, directions;
+    std::vector<float> maxDistances;
+    make_rays(origins, directions, maxDistances, 1024);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        for (size_t i = 0; i < origins.size(); ++i) {
+            TerrainHit hit;
+            benchmark::DoNotOptimize(height_field_raycast(field, origins[i], directions[i], maxDistances[i], hit));
+        }
+    }
+    set_rate(state, "rays/s", (double)origins.size());
+}
+BENCHMARK(BM_HeightFieldRaycast);
+
+static void BM_HeightFieldRaycasts(benchmark::State& state) {
+    HeightField field = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f);
+    std::vector<simd::float3> origins, directions;
+    std::vector<float> maxDistances;
+    make_rays(origins, directions, maxDistances, 1024);
+    std::vector<TerrainHit> hits(origins.size());
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(height_field_raycasts(field, origins.data(), directions.data(), maxDistances.data(),
+                                                       hits.data(), origins.size()));
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "rays/s", (double)origins.size());
+}
+BENCHMARK(BM_HeightFieldRaycasts);
+
+// --- Camera ---
+
+static void BM_UpdateCamera(benchmark::State& state) {
+    Camera cam = make_camera(1280, 720);
+    bool keys[1024] = {};
+    keys['W'] = true;
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        update_camera(cam, 1.0f / 60.0f, keys, 1.0f, 0.0f);
+        benchmark::DoNotOptimize(cam.viewMatrix);
+    }
+    set_rate(state, "updates/s", 1.0);
+}
+BENCHMARK(BM_UpdateCamera);
+
+static void BM_MatrixPerspective(benchmark::State& state) {
+    AllocationCounter allocs(state);
+    float fov = 1.0f;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matrix_perspective_right_hand(fov, 16.0f / 9.0f, 0.1f, 100.0f));
+        fov += 1e-6f;
+    }
+    set_rate(state, "matrices/s", 1.0);
+}
+BENCHMARK(BM_MatrixPerspective);
+
+static void BM_MatrixLookAt(benchmark::State& state) {
+    AllocationCounter allocs(state);
+    simd::float3 eye = {0.0f, 5.0f, 10.0f};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matrix_look_at_right_hand(eye, simd::float3{0, 0, 0}, simd::float3{0, 1, 0}));
+        eye.x += 1e-4f;
+    }
+    set_rate(state, "matrices/s", 1.0);
+}
+BENCHMARK(BM_MatrixLookAt);
+
+static void BM_MatrixModelTransform(benchmark::State& state) {
+    AllocationCounter allocs(state);
+    float angle = 0.0f;
+    for (auto _ : state) {
+        simd::float4x4 model = matrix_translation(1.0f, 2.0f, 3.0f) * matrix_rotation_y(angle) * matrix_scale(1.5f, 1.0f, 2.5f);
+        benchmark::DoNotOptimize(model);
+        angle += 1e-4f;
+    }
+    set_rate(state, "matrices/s", 1.0);
+}
+BENCHMARK(BM_MatrixModelTransform);
+
+static void BM_AffineModelTransform(benchmark::State& state) {
+    AllocationCounter allocs(state);
+    float angle = 0.0f;
+    for (auto _ : state) {
+        Affine model = affine_trs_y({ 1.0f, 2.0f, 3.0f }, angle, { 1.5f, 1.0f, 2.5f });
+        benchmark::DoNotOptimize(model);
+        angle += 1e-4f;
+    }
+    set_rate(state, "matrices/s", 1.0);
+}
+BENCHMARK(BM_AffineModelTransform);
+
+// Parent * child for n children, as a transform graph level does: 4x4 products vs 3x4 ones
+static void BM_MatrixComposeBatch(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const simd::float4x4 parent = matrix_translation(1.0f, 2.0f, 3.0f) * matrix_rotation_y(0.5f);
+    std::vector<simd::float4x4> local(n), world(n);
+    for (size_t i = 0; i < n; ++i) {
+        local[i] = matrix_translation((float)i, 0.0f, 0.0f) * matrix_scale(2.0f, 2.0f, 2.0f);
+    }
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        for (size_t i = 0; i < n; ++i) {
+            world[i] = parent * local[i];
+        }
+        benchmark::DoNotOptimize(world.data());
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "matrices/s", (double)n);
+}
+BENCHMARK(BM_MatrixComposeBatch)->Arg(1024)->Arg(65536);
+
+static void BM_AffineComposeBatch(benchmark::State& state) {
+    const size_t n = state.range(0);
+    const Affine parent = affine_trs_y({ 1.0f, 2.0f, 3.0f }, 0.5f, { 1.0f, 1.0f, 1.0f });
+    std::vector<Affine> local(n), world(n);
+    for (size_t i = 0; i < n; ++i) {
+        local[i] = affine_translation_scale((float)i, 0.0f, 0.0f, 2.0f, 2.0f, 2.0f);
+    }
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        affine_multiply_batch(parent, local.data(), world.data(), n);
+        benchmark::DoNotOptimize(world.data());
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "matrices/s", (double)n);
+}
+BENCHMARK(BM_AffineComposeBatch)->Arg(1024)->Arg(65536);
+
+// --- Culling ---
+
+static void BM_FrustumCull(benchmark::State& state) {
+    const size_t n = state.range(0);
+    Camera cam = make_camera(1280, 720);
+    Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+
+    CullBounds bounds;
+    for (size_t i = 0; i < n; ++i) {
+        float x = -200.0f + 400.0f * (float)(i % 97) / 97.0f;
+        float z = -200.0f + 400.0f * (float)(i / 97 % 89) / 89.0f;
+        cull_bounds_add(bounds, { { x - 1.0f, -1.0f, z - 1.0f }, { x + 1.0f, 1.0f, z + 1.0f } });
+    }
+    std::vector<uint32_t> visible(n);
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frustum_cull(frustum, bounds, visible.data()));
+        benchmark::ClobberMemory();
+    }
+    set_rate(state, "boxes/s", (double)n);
+}
+BENCHMARK(BM_FrustumCull)->Arg(4096)->Arg(65536);
+
+// --- Scene queries ---
+
+static void BM_BvhBuild(benchmark::State& state) {
+    const std::vector<BoundingBox> boxes = make_scene_boxes(state.range(0));
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        Bvh bvh = make_bvh(boxes);
+        benchmark::DoNotOptimize(bvh.root);
+    }
+    set_rate(state, "inserts/s", (double)boxes.size());
+}
+BENCHMARK(BM_BvhBuild)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+static void BM_BvhQueryFrustum(benchmark::State& state) {
+    const std::vector<BoundingBox> boxes = make_scene_boxes(state.range(0));
+    const Bvh bvh = make_bvh(boxes);
+    Camera cam = make_camera(1280, 720);
+    cam.position = { 50.0f, 10.0f, 150.0f };
+    update_camera_view(cam);
+    Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+    std::vector<uint32_t> items;
+    items.reserve(boxes.size());
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        bvh_query_frustum(bvh, frustum, items);
+        benchmark::DoNotOptimize(items.data());
+    }
+    state.counters["visible"] = (double)items.size();
+    set_rate(state, "queries/s", 1.0);
+}
+BENCHMARK(BM_BvhQueryFrustum)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_BvhRaycast(benchmark::State& state) {
+    const std::vector<BoundingBox> boxes = make_scene_boxes(state.range(0));
+    const Bvh bvh = make_bvh(boxes);
+    const float extent = 2.0f * (float)std::ceil(std::sqrt((double)boxes.size()));
+
+    AllocationCounter allocs(state);
+    uint32_t ray = 0;
+    for (auto _ : state) {
+        // Diagonal rays skimming the tops of the boxes, across the whole grid
+        const simd::float3 origin = { 0.0f, 0.9f, extent * (float)(ray++ % 64) / 64.0f };
+        const simd::float3 direction = { 0.8f, 0.0f, 0.6f };
+        const simd::float3 inverse = 1.0f / direction;
+        float distance;
+        benchmark::DoNotOptimize(bvh_raycast(bvh, origin, direction, extent, [&](uint32_t item, float limit) {
+            return ray_box_distance(boxes[item], origin, inverse, limit);
+        }, distance));
+    }
+    set_rate(state, "rays/s", 1.0);
+}
+BENCHMARK(BM_BvhRaycast)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+static void BM_BvhRefit(benchmark::State& state) {
+    // One object in sixteen moves every iteration, as after a transform update
+    std::vector<BoundingBox> boxes = make_scene_boxes(state.range(0));
+    std::vector<uint32_t> leaves;
+    Bvh bvh = make_bvh(boxes, &leaves);
+
+    AllocationCounter allocs(state);
+    float offset = 0.0f;
+    for (auto _ : state) {
+        offset = offset > 0.0f ? 0.0f : 0.5f;
+        for (size_t i = 0; i < boxes.size(); i += 16) {
+            BoundingBox box = boxes[i];
+            box.min.y += offset;
+            box.max.y += offset;
+            bvh_move(bvh, leaves[i], box);
+        }
+        benchmark::DoNotOptimize(bvh_refit(bvh));
+    }
+    set_rate(state, "moves/s", (double)((boxes.size() + 15) / 16));
+}
+BENCHMARK(BM_BvhRefit)->Arg(10000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+// --- Crowd ---
+
+static void BM_CrowdUpdate(benchmark::State& state) {
+    const uint32_t agents = (uint32_t)state.range(0);
+    const uint32_t threads = (uint32_t)state.range(1);
+    HeightField field = create_height_field(-256.0f, -256.0f, 513, 513, 1.0f);
+    SceneStore scene;
+    const CrowdSettings settings;
+    Crowd crowd = create_crowd(scene, field, agents, 0, { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } }, settings);
+    JobSystem jobs({ threads - 1, 1 });
+
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        crowd_update(crowd, scene, jobs, field, settings, 1.0f / 60.0f);
+        // Refitting the moved bounds is the scene's cost, measured by BM_BvhRefit
+        scene.dirty.clear();
+    }
+    state.counters["threads"] = (double)threads;
+    set_rate(state, "agents/s", (double)agents);
+}
+BENCHMARK(BM_CrowdUpdate)
+    ->ArgsProduct({ { 100000, 400000 }, { 1, 2, 4, 8 } })
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_NavMeshRebuild(benchmark::State& state) {
+    const uint32_t threads = (uint32_t)state.range(0);
+    const HeightField field = create_height_field(-128.0f, -128.0f, 257, 257, 1.0f);
+    JobSystem jobs({ threads - 1, 1 });
+    NavMesh mesh = create_nav_mesh(field, NavMeshSettings{}, jobs);
+
+    // A brush-sized edit against the whole field
+    uint32_t tiles = 0;
+    for (auto _ : state) {
+        tiles = nav_mesh_rebuild(mesh, field, jobs, -4.0f, -4.0f, 4.0f, 4.0f);
+    }
+    state.counters["threads"] = (double)threads;
+    state.counters["tiles"] = (double)tiles;
+    state.counters["all tiles"] = (double)mesh.tiles.size();
+}
+BENCHMARK(BM_NavMeshRebuild)->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_NavMeshFindPaths(benchmark::State& state) {
+    const uint32_t threads = (uint32_t)state.range(0);
+    const HeightField field = create_height_field(-128.0f, -128.0f, 257, 257, 1.0f);
+    JobSystem jobs({ threads - 1, 1 });
+    const NavMesh mesh = create_nav_mesh(field, NavMeshSettings{}, jobs);
+
+    std::vector<NavPathQuery> queries(1024);
+    uint32_t seed = 1;
+    auto next = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / (float)(1u << 24) * 240.0f - 120.0f;
+    };
+    for (NavPathQuery& query : queries) {
+        query = { { next(), next() }, { next(), next() } };
+    }
+    std::vector<NavPath> paths(queries.size());
+
+    for (auto _ : state) {
+        nav_mesh_find_paths(mesh, jobs, queries.data(), paths.data(), (uint32_t)queries.size());
+    }
+    state.counters["threads"] = (double)threads;
+    set_rate(state, "paths/s", (double)queries.size());
+}
+BENCHMARK(BM_NavMeshFindPaths)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_AudioOcclusion(benchmark::State& state) {
+    const uint32_t emitters = (uint32_t)state.range(0);
+    const uint32_t threads = (uint32_t)state.range(1);
+    const HeightField field = create_height_field(-256.0f, -256.0f, 513, 513, 1.0f);
+    JobSystem jobs({ threads - 1, 1 });
+    AudioOcclusion occlusion;
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < emitters; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        const float x = (float)(seed >> 8) / (float)(1u << 24) * 400.0f - 200.0f;
+        seed = seed * 1664525u + 1013904223u;
+        const float z = (float)(seed >> 8) / (float)(1u << 24) * 400.0f - 200.0f;
+        occlusion.positions.push_back({ x, height_field_height(field, x, z), z });
+    }
+
+    // Every tick moves the listener past its tolerance, so every emitter is tested: the uncached cost
+    const AudioOcclusionSettings settings;
+    float listenerX = 0.0f;
+    for (auto _ : state) {
+        listenerX = listenerX > 0.0f ? -1.0f : 1.0f;
+        const simd::float3 listener = { listenerX, height_field_height(field, listenerX, 0.0f) + 1.7f, 0.0f };
+        audio_occlusion_update(occlusion, field, jobs, listener, settings);
+    }
+    state.counters["threads"] = (double)threads;
+    set_rate(state, "segments/s", (double)emitters);
+}
+BENCHMARK(BM_AudioOcclusion)
+    ->ArgsProduct({ { 256, 4096 }, { 1, 4 } })
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+// --- Concurrency ---
+
+// Every thread pushes a value and pops one, against the same queue; a mutex around a deque is the baseline
+static void BM_MpmcQueuePushPop(benchmark::State& state) {
+    static MpmcQueue<uint64_t, 1024> queue;
+    uint64_t value = 0;
+    for (auto _ : state) {
+        queue.push(value);
+        queue.pop(value);
+        benchmark::DoNotOptimize(value);
+    }
+    set_rate(state, "pairs/s", 1.0);
+}
+BENCHMARK(BM_MpmcQueuePushPop)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MutexQueuePushPop(benchmark::State& state) {
+    static std::mutex mutex;
+    static std::deque<uint64_t> queue;
+    uint64_t value = 0;
+    for (auto _ : state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() < 1024) {
+                queue.push_back(value);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!queue.empty()) {
+                value = queue.front();
+                queue.pop_front();
+            }
+        }
+        benchmark::DoNotOptimize(value);
+    }
+    set_rate(state, "pairs/s", 1.0);
+}
+BENCHMARK(BM_MutexQueuePushPop)->ThreadRange(1, 8)->UseRealTime();
+
+namespace {
+    // Chunk state lookups over a 64x64 window of chunks; arg 0 is the percentage of them that are writes
+    constexpr int MAP_WINDOW = 64;
+
+    template <typename Find, typename Assign>
+    void run_chunk_lookups(benchmark::State& state, Find find, Assign assign) {
+        const uint32_t writePercent = (uint32_t)state.range(0);
+        uint32_t seed = 1u + (uint32_t)state.thread_index();
+        for (auto _ : state) {
+            seed = seed * 1664525u + 1013904223u;
+            const ChunkKey key = { (int)(seed >> 8) % MAP_WINDOW, (int)(seed >> 20) % MAP_WINDOW };
+            if ((seed >> 4) % 100 < writePercent) {
+                assign(key, (int)seed);
+            } else {
+                benchmark::DoNotOptimize(find(key));
+            }
+        }
+        set_rate(state, "lookups/s", 1.0);
+    }
+}
+
+static void BM_ConcurrentMapLookups(benchmark::State& state) {
+    static ConcurrentMap<ChunkKey, int, ChunkKeyHash> map(256);
+    if (state.thread_index() == 0 && map.size() == 0) {
+        for (int i = 0; i < MAP_WINDOW * MAP_WINDOW; ++i) {
+            map.insert({ i % MAP_WINDOW, i / MAP_WINDOW }, i);
+        }
+    }
+    run_chunk_lookups(state, [](ChunkKey key) {
+        int value = 0;
+        map.find(key, value);
+        return value;
+    }, [](ChunkKey key, int value) { map.insert_or_assign(key, value); });
+}
+BENCHMARK(BM_ConcurrentMapLookups)->ArgsProduct({ { 0, 10 } })->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MutexMapLookups(benchmark::State& state) {
+    static std::mutex mutex;
+    static std::unordered_map<ChunkKey, int, ChunkKeyHash> map;
+    if (state.thread_index() == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < MAP_WINDOW * MAP_WINDOW; ++i) {
+            map.emplace(ChunkKey{ i % MAP_WINDOW, i / MAP_WINDOW }, i);
+        }
+    }
+    run_chunk_lookups(state, [](ChunkKey key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto found = map.find(key);
+        return found != map.end() ? found->second : 0;
+    }, [](ChunkKey key, int value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        map[key] = value;
+    });
+}
+BENCHMARK(BM_MutexMapLookups)->ArgsProduct({ { 0, 10 } })->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
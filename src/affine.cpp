@@ -0,0 +1,31 @@
+#include "affine.hpp"
+
+void affine_multiply_batch(const Affine& a, const Affine* b, Affine* out, size_t n) {
+    // Hoisted once, so each transform costs nine vector multiply-adds and three adds
+    const simd::float4 r0 = a.rows[0], r1 = a.rows[1], r2 = a.rows[2];
+    const simd::float4 t = { 0.0f, 0.0f, 0.0f, 1.0f };
+    for (size_t i = 0; i < n; ++i) {
+        const simd::float4 b0 = b[i].rows[0], b1 = b[i].rows[1], b2 = b[i].rows[2];
+        out[i].rows[0] = r0.x * b0 + r0.y * b1 + r0.z * b2 + r0.w * t;
+        out[i].rows[1] = r1.x * b0 + r1.y * b1 + r1.z * b2 + r1.w * t;
+        out[i].rows[2] = r2.x * b0 + r2.y * b1 + r2.z * b2 + r2.w * t;
+    }
+}
+
+void affine_multiply_batch(const Affine* a, const Affine* b, Affine* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = affine_multiply(a[i], b[i]);
+    }
+}
+
+void affine_from_trs_batch(const Trs* trs, Affine* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = affine_from_trs(trs[i]);
+    }
+}
+
+void affine_matrix_batch(const Affine* in, simd::float4x4* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = affine_matrix(in[i]);
+    }
+}
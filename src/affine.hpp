@@ -0,0 +1,241 @@
+/**
+ * @file affine.hpp
+ * @brief Affine transforms stored as 3x4 matrices, for model and node transforms.
+ *
+ * Model transforms never project, so their bottom row is always (0, 0, 0, 1). Storing only
+ * the top three rows saves a quarter of the memory, and composing two of them takes nine
+ * vector multiply-adds where a float4x4 product takes sixteen. Inverses are built from the
+ * 3x3 part alone, or analytically from a translation, rotation and scale. Transforms are
+ * widened to simd::float4x4 only where the GPU or the scene needs one.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cmath>
+#include <cstddef>
+
+/**
+ * @struct Affine
+ * @brief The top three rows of an affine 4x4 matrix; the fourth row is implicitly (0, 0, 0, 1).
+ */
+struct Affine {
+    simd::float4 rows[3]; ///< Row i of the linear part in xyz and translation i in w.
+};
+
+/**
+ * @struct Trs
+ * @brief Translation, rotation and scale, applied to a point as T * R * S.
+ */
+struct Trs {
+    simd::float3 translation = { 0.0f, 0.0f, 0.0f }; ///< Applied last.
+    simd::quatf rotation = simd::quatf{ simd::float4{ 0.0f, 0.0f, 0.0f, 1.0f } }; ///< Unit quaternion.
+    simd::float3 scale = { 1.0f, 1.0f, 1.0f };       ///< Per-axis scale, applied first; no component may be 0.
+};
+
+/**
+ * @struct AffinePair
+ * @brief A transform together with its inverse.
+ */
+struct AffinePair {
+    Affine forward; ///< The transform.
+    Affine inverse; ///< Its inverse.
+};
+
+/// @return The identity transform.
+constexpr Affine affine_identity() {
+    return { { simd::float4{ 1.0f, 0.0f, 0.0f, 0.0f }, simd::float4{ 0.0f, 1.0f, 0.0f, 0.0f },
+               simd::float4{ 0.0f, 0.0f, 1.0f, 0.0f } } };
+}
+
+/// @return The transform moving points by (tx, ty, tz).
+constexpr Affine affine_translation(float tx, float ty, float tz) {
+    return { { simd::float4{ 1.0f, 0.0f, 0.0f, tx }, simd::float4{ 0.0f, 1.0f, 0.0f, ty },
+               simd::float4{ 0.0f, 0.0f, 1.0f, tz } } };
+}
+
+/// @return The transform scaling points by (sx, sy, sz) about the origin.
+constexpr Affine affine_scale(float sx, float sy, float sz) {
+    return { { simd::float4{ sx, 0.0f, 0.0f, 0.0f }, simd::float4{ 0.0f, sy, 0.0f, 0.0f },
+               simd::float4{ 0.0f, 0.0f, sz, 0.0f } } };
+}
+
+/// @return translation * scale, built directly.
+constexpr Affine affine_translation_scale(float tx, float ty, float tz, float sx, float sy, float sz) {
+    return { { simd::float4{ sx, 0.0f, 0.0f, tx }, simd::float4{ 0.0f, sy, 0.0f, ty },
+               simd::float4{ 0.0f, 0.0f, sz, tz } } };
+}
+
+/**
+ * @brief Builds translation * rotation about +Y * scale directly, without any products of matrices.
+ * @param translation The translation.
+ * @param yaw The rotation about +Y in radians; matches matrix_rotation_y().
+ * @param scale The per-axis scale.
+ * @return The transform.
+ */
+inline Affine affine_trs_y(simd::float3 translation, float yaw, simd::float3 scale) {
+    const float c = cosf(yaw);
+    const float s = sinf(yaw);
+    return { { simd::float4{ c * scale.x, 0.0f, s * scale.z, translation.x },
+               simd::float4{ 0.0f, scale.y, 0.0f, translation.y },
+               simd::float4{ -s * scale.x, 0.0f, c * scale.z, translation.z } } };
+}
+
+/**
+ * @brief Builds T * R * S directly from a Trs.
+ * @param trs The translation, rotation and scale.
+ * @return The transform.
+ */
+inline Affine affine_from_trs(const Trs& trs) {
+    const simd::float4 q = trs.rotation.vector;
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    const simd::float3 s = trs.scale;
+    const simd::float3 t = trs.translation;
+    return { { simd::float4{ (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy - wz) * s.y, 2.0f * (xz + wy) * s.z, t.x },
+               simd::float4{ 2.0f * (xy + wz) * s.x, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz - wx) * s.z, t.y },
+               simd::float4{ 2.0f * (xz - wy) * s.x, 2.0f * (yz + wx) * s.y, (1.0f - 2.0f * (xx + yy)) * s.z, t.z } } };
+}
+
+/**
+ * @brief Builds the inverse of a Trs, S^-1 * R^-1 * T^-1, without a general inversion.
+ * @param trs The translation, rotation and scale.
+ * @return The inverse transform.
+ */
+inline Affine affine_inverse_trs(const Trs& trs) {
+    // R^T scaled per row by 1 / s, then the translation carried through it
+    const Affine r = affine_from_trs({ { 0.0f, 0.0f, 0.0f }, trs.rotation, { 1.0f, 1.0f, 1.0f } });
+    const simd::float3 inv = 1.0f / trs.scale;
+    const simd::float3 t = trs.translation;
+    Affine out;
+    for (int i = 0; i < 3; ++i) {
+        const float sx = r.rows[0][i], sy = r.rows[1][i], sz = r.rows[2][i];
+        out.rows[i] = simd::float4{ sx, sy, sz, -(sx * t.x + sy * t.y + sz * t.z) } * inv[i];
+    }
+    return out;
+}
+
+/**
+ * @brief Composes two transforms.
+ * @param a The transform applied second, e.g. the parent.
+ * @param b The transform applied first, e.g. the child.
+ * @return a * b.
+ */
+inline Affine affine_multiply(const Affine& a, const Affine& b) {
+    Affine out;
+    for (int i = 0; i < 3; ++i) {
+        const simd::float4 r = a.rows[i];
+        out.rows[i] = r.x * b.rows[0] + r.y * b.rows[1] + r.z * b.rows[2];
+        out.rows[i].w += r.w;
+    }
+    return out;
+}
+
+/**
+ * @brief Inverts a transform through the cofactors of its 3x3 part.
+ * @param m The transform; its 3x3 part must be invertible.
+ * @return The inverse transform.
+ */
+inline Affine affine_inverse(const Affine& m) {
+    const simd::float3 r0 = { m.rows[0].x, m.rows[0].y, m.rows[0].z };
+    const simd::float3 r1 = { m.rows[1].x, m.rows[1].y, m.rows[1].z };
+    const simd::float3 r2 = { m.rows[2].x, m.rows[2].y, m.rows[2].z };
+    const simd::float3 t = { m.rows[0].w, m.rows[1].w, m.rows[2].w };
+
+    // The columns of the inverse 3x3 are cross products of the rows over the determinant
+    const simd::float3 c0 = simd::cross(r1, r2);
+    const simd::float3 c1 = simd::cross(r2, r0);
+    const simd::float3 c2 = simd::cross(r0, r1);
+    const float invDet = 1.0f / simd::dot(r0, c0);
+
+    Affine out;
+    for (int i = 0; i < 3; ++i) {
+        const simd::float3 row = simd::float3{ c0[i], c1[i], c2[i] } * invDet;
+        out.rows[i] = simd::float4{ row.x, row.y, row.z, -simd::dot(row, t) };
+    }
+    return out;
+}
+
+/**
+ * @brief Composes a parent with a Trs child and inverts the result in the same step.
+ *
+ * The child's inverse is analytic and the parent's is already known, so the inverse of
+ * the product is one more affine_multiply rather than a general inversion.
+ *
+ * @param parent The parent transform and its inverse.
+ * @param local The child transform relative to the parent.
+ * @return parent * local and its inverse.
+ */
+inline AffinePair affine_compose_trs(const AffinePair& parent, const Trs& local) {
+    return { affine_multiply(parent.forward, affine_from_trs(local)),
+             affine_multiply(affine_inverse_trs(local), parent.inverse) };
+}
+
+/// @return m applied to the point p.
+inline simd::float3 affine_transform_point(const Affine& m, simd::float3 p) {
+    const simd::float4 h = { p.x, p.y, p.z, 1.0f };
+    return { simd::dot(m.rows[0], h), simd::dot(m.rows[1], h), simd::dot(m.rows[2], h) };
+}
+
+/// @return m applied to the direction v, ignoring the translation.
+inline simd::float3 affine_transform_vector(const Affine& m, simd::float3 v) {
+    const simd::float4 h = { v.x, v.y, v.z, 0.0f };
+    return { simd::dot(m.rows[0], h), simd::dot(m.rows[1], h), simd::dot(m.rows[2], h) };
+}
+
+/// @return The translation of m.
+inline simd::float3 affine_translation_of(const Affine& m) {
+    return { m.rows[0].w, m.rows[1].w, m.rows[2].w };
+}
+
+/// @return m widened to a column-major float4x4.
+inline simd::float4x4 affine_matrix(const Affine& m) {
+    return simd::float4x4(simd::float4{ m.rows[0].x, m.rows[1].x, m.rows[2].x, 0.0f },
+                          simd::float4{ m.rows[0].y, m.rows[1].y, m.rows[2].y, 0.0f },
+                          simd::float4{ m.rows[0].z, m.rows[1].z, m.rows[2].z, 0.0f },
+                          simd::float4{ m.rows[0].w, m.rows[1].w, m.rows[2].w, 1.0f });
+}
+
+/// @return The top three rows of a float4x4 whose bottom row is (0, 0, 0, 1).
+inline Affine affine_from_matrix(const simd::float4x4& m) {
+    Affine out;
+    for (int i = 0; i < 3; ++i) {
+        out.rows[i] = simd::float4{ m.columns[0][i], m.columns[1][i], m.columns[2][i], m.columns[3][i] };
+    }
+    return out;
+}
+
+/**
+ * @brief Applies one transform to many: out[i] = a * b[i].
+ * @param a The transform applied second.
+ * @param b n transforms applied first.
+ * @param out Receives n transforms; may alias b.
+ * @param n The number of transforms.
+ */
+void affine_multiply_batch(const Affine& a, const Affine* b, Affine* out, size_t n);
+
+/**
+ * @brief Composes pairs of transforms: out[i] = a[i] * b[i].
+ * @param a n transforms applied second.
+ * @param b n transforms applied first.
+ * @param out Receives n transforms; may alias a or b.
+ * @param n The number of transforms.
+ */
+void affine_multiply_batch(const Affine* a, const Affine* b, Affine* out, size_t n);
+
+/**
+ * @brief Builds many transforms from their Trs.
+ * @param trs n translations, rotations and scales.
+ * @param out Receives n transforms.
+ * @param n The number of transforms.
+ */
+void affine_from_trs_batch(const Trs* trs, Affine* out, size_t n);
+
+/**
+ * @brief Widens many transforms, e.g. straight into a GPU instance buffer.
+ * @param in n transforms.
+ * @param out Receives n column-major float4x4s.
+ * @param n The number of transforms.
+ */
+void affine_matrix_batch(const Affine* in, simd::float4x4* out, size_t n);
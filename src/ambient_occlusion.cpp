@@ -0,0 +1,78 @@
+#include "ambient_occlusion.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Keeps the weight of a sample at exactly the pixel's depth finite
+    constexpr float UPSAMPLE_EPSILON = 1e-3f;
+
+    float fract(float x) {
+        return x - floorf(x);
+    }
+}
+
+AmbientOcclusionUniforms ambient_occlusion_uniforms(const simd::float4x4& projection, uint32_t width, uint32_t height,
+                                                    float clearDepth, const AmbientOcclusionSettings& settings) {
+    AmbientOcclusionUniforms uniforms;
+    uniforms.inverseProjection = simd::inverse(projection);
+    uniforms.viewport = { (float)width, (float)height };
+    uniforms.pixelsPerUnit = projection.columns[1].y * 0.5f * (float)height;
+    uniforms.radius = settings.radius;
+    uniforms.intensity = settings.intensity;
+    uniforms.clearDepth = clearDepth;
+    return uniforms;
+}
+
+simd::float3 ao_view_position(const AmbientOcclusionUniforms& uniforms, simd::float2 pixel, float depth) {
+    const simd::float2 ndc = { pixel.x / uniforms.viewport.x * 2.0f - 1.0f, 1.0f - pixel.y / uniforms.viewport.y * 2.0f };
+    const simd::float4 view = uniforms.inverseProjection * simd::float4{ ndc.x, ndc.y, depth, 1.0f };
+    return simd::float3{ view.x, view.y, view.z } / view.w;
+}
+
+simd::float3 ao_normal(simd::float3 center, simd::float3 left, simd::float3 right, simd::float3 up, simd::float3 down) {
+    const simd::float3 dx = fabsf(right.z - center.z) < fabsf(center.z - left.z) ? right - center : center - left;
+    const simd::float3 dy = fabsf(up.z - center.z) < fabsf(center.z - down.z) ? up - center : center - down;
+    simd::float3 normal = simd::normalize(simd::cross(dx, dy));
+    // The camera is at the origin
+    if (simd::dot(normal, center) > 0.0f) {
+        normal = -normal;
+    }
+    return normal;
+}
+
+float ao_noise(uint32_t x, uint32_t y) {
+    return fract(52.9829189f * fract(0.06711056f * (float)x + 0.00583715f * (float)y));
+}
+
+simd::float2 ao_sample_offset(uint32_t i, float rotation) {
+    const float alpha = ((float)i + 0.5f) / AO_SAMPLES;
+    const float angle = (alpha * AO_SPIRAL_TURNS + rotation) * 2.0f * (float)M_PI;
+    return simd::float2{ cosf(angle), sinf(angle) } * alpha;
+}
+
+float ao_pixel_radius(const AmbientOcclusionUniforms& uniforms, float viewDepth) {
+    return std::min(uniforms.radius * uniforms.pixelsPerUnit / viewDepth, AO_MAX_PIXEL_RADIUS);
+}
+
+float ao_sample_occlusion(simd::float3 offset, simd::float3 normal, float radius) {
+    const float distanceSquared = simd::dot(offset, offset);
+    const float radiusSquared = radius * radius;
+    if (distanceSquared >= radiusSquared || distanceSquared <= 0.0f) {
+        return 0.0f;
+    }
+    const float cosine = simd::dot(offset, normal) / sqrtf(distanceSquared);
+    return std::max(cosine - AO_BIAS, 0.0f) * (1.0f - distanceSquared / radiusSquared);
+}
+
+float ao_visibility(float occlusion, float intensity) {
+    return std::clamp(1.0f - intensity * occlusion / AO_SAMPLES, 0.0f, 1.0f);
+}
+
+float ao_upsample_weight(float viewDepth, float sampleDepth) {
+    return 1.0f / (UPSAMPLE_EPSILON + fabsf(sampleDepth - viewDepth) / viewDepth);
+}
+
+simd::float3 ao_apply(simd::float3 color, float ambientShare, float visibility) {
+    return color * (1.0f - ambientShare * (1.0f - visibility));
+}
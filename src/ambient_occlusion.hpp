@@ -0,0 +1,122 @@
+/**
+ * @file ambient_occlusion.hpp
+ * @brief Screen-space ambient occlusion from the scene depth, at half resolution.
+ *
+ * The ambient term is a constant, so without occlusion valleys, crevices and the foot of a rock
+ * get as much sky light as an open slope. After the scene pass, a compute kernel rebuilds each
+ * half-resolution pixel's view position and normal from the full-resolution depth, and samples
+ * AO_SAMPLES points on a spiral within a world radius around it (the Alchemy estimator of
+ * McGuire et al. 2011): every sample above the pixel's tangent plane occludes by the cosine of
+ * its elevation, fading out towards the radius. Rotating the spiral per pixel turns banding into
+ * noise, which the upsample averages away.
+ *
+ * A full-screen pass then upsamples the result bilaterally, weighting the 3x3 half-resolution
+ * neighbours by how close their view depth is to the pixel's so occlusion does not bleed across
+ * silhouettes, and darkens the scene colour in place. Only the ambient light is occluded: the
+ * ShaderVariant::ambientOcclusion fragments write the share of their colour that is ambient to
+ * the scene colour's alpha, and the pass scales that share alone.
+ *
+ * These functions mirror ambient_occlusion and ambient_occlusion_apply_fragment in shaders.metal;
+ * see gpu_ambient_occlusion.hpp for the passes.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+/// Depth samples per pixel.
+constexpr uint32_t AO_SAMPLES = 12;
+/// Turns of the sample spiral; coprime with AO_SAMPLES so no two samples share a direction.
+constexpr uint32_t AO_SPIRAL_TURNS = 5;
+/// Largest sample distance in full-resolution pixels, which bounds the cost of near surfaces.
+constexpr float AO_MAX_PIXEL_RADIUS = 64.0f;
+/// Cosine above the tangent plane a sample must exceed to occlude; hides self-occlusion of flat ground.
+constexpr float AO_BIAS = 0.1f;
+
+/**
+ * @struct AmbientOcclusionSettings
+ * @brief The tunable part of the occlusion.
+ */
+struct AmbientOcclusionSettings {
+    float radius = 4.0f;        ///< World distance within which geometry occludes.
+    float intensity = 1.5f;     ///< Scale of the occlusion; 1 is the plain average.
+};
+
+/**
+ * @struct AmbientOcclusionUniforms
+ * @brief Parameters of both passes; matches AmbientOcclusionUniforms in shaders.metal.
+ */
+struct AmbientOcclusionUniforms {
+    simd::float4x4 inverseProjection;   ///< Clip to view space of the camera the depth was drawn with.
+    simd::float2 viewport;              ///< Full-resolution size in pixels.
+    float pixelsPerUnit;                ///< Pixels a world unit covers at view depth 1.
+    float radius;                       ///< AmbientOcclusionSettings::radius.
+    float intensity;                    ///< AmbientOcclusionSettings::intensity.
+    float clearDepth;                   ///< Depth of pixels no surface covered.
+};
+
+/**
+ * @brief Builds the uniforms of a frame.
+ * @param projection The projection the depth was drawn with, possibly jittered; any depth mapping.
+ * @param width Full-resolution width in pixels.
+ * @param height Full-resolution height in pixels.
+ * @param clearDepth The depth the scene pass clears to.
+ * @param settings Radius and intensity.
+ * @return The uniforms.
+ */
+AmbientOcclusionUniforms ambient_occlusion_uniforms(const simd::float4x4& projection, uint32_t width, uint32_t height,
+                                                    float clearDepth, const AmbientOcclusionSettings& settings);
+
+/**
+ * @brief Rebuilds a view-space position from the depth buffer.
+ * @param uniforms The uniforms.
+ * @param pixel Full-resolution pixel coordinates, y down; pixel centres are at .5.
+ * @param depth The depth buffer value there.
+ * @return The view-space position; the view depth is its negated z.
+ */
+simd::float3 ao_view_position(const AmbientOcclusionUniforms& uniforms, simd::float2 pixel, float depth);
+
+/**
+ * @brief Returns a view-space normal from a position and its four neighbours.
+ *
+ * On each axis the neighbour closer in depth is used, so a pixel on a silhouette takes the
+ * slope of its own surface rather than the jump to the one behind.
+ *
+ * @return The unit normal, facing the camera.
+ */
+simd::float3 ao_normal(simd::float3 center, simd::float3 left, simd::float3 right, simd::float3 up, simd::float3 down);
+
+/// @return A pixel's rotation of the sample spiral in [0, 1) turns; interleaved gradient noise (Jimenez 2014).
+float ao_noise(uint32_t x, uint32_t y);
+
+/// @return Sample i of the spiral within the unit disk, rotated by rotation turns.
+simd::float2 ao_sample_offset(uint32_t i, float rotation);
+
+/// @return Radius of the sample spiral in full-resolution pixels for a surface at viewDepth.
+float ao_pixel_radius(const AmbientOcclusionUniforms& uniforms, float viewDepth);
+
+/**
+ * @brief Returns how much one sample occludes a surface.
+ * @param offset View-space vector from the surface to the sample.
+ * @param normal The surface's unit normal.
+ * @param radius World distance within which geometry occludes.
+ * @return The cosine of the sample's elevation above the tangent plane less AO_BIAS, faded out
+ *         towards radius; 0 for samples below the plane or beyond the radius.
+ */
+float ao_sample_occlusion(simd::float3 offset, simd::float3 normal, float radius);
+
+/// @return Ambient visibility in [0, 1] from the summed occlusion of AO_SAMPLES samples.
+float ao_visibility(float occlusion, float intensity);
+
+/// @return Weight of a half-resolution sample at sampleDepth when upsampling for a pixel at viewDepth.
+float ao_upsample_weight(float viewDepth, float sampleDepth);
+
+/**
+ * @brief Occludes the ambient part of a scene colour.
+ * @param color The lit, fogged colour.
+ * @param ambientShare The share of color that is ambient light, from the scene colour's alpha.
+ * @param visibility Upsampled ambient visibility.
+ * @return The darkened colour.
+ */
+simd::float3 ao_apply(simd::float3 color, float ambientShare, float visibility);
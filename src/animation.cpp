@@ -0,0 +1,170 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Normalized lerp of n joint rotations from a to b along the shorter arc, and lerp of their
+    // translations; every array is a separate track, so each loop runs over contiguous floats
+    void nlerp_joints(const float* const ra[4], const float* const ta[3], const float* const rb[4],
+                      const float* const tb[3], float t, uint32_t n, Pose& out) {
+        for (uint32_t j = 0; j < n; ++j) {
+            const float dot = ra[0][j] * rb[0][j] + ra[1][j] * rb[1][j] + ra[2][j] * rb[2][j] + ra[3][j] * rb[3][j];
+            // q and -q are the same rotation; the one nearer a takes the shorter way round
+            const float tb1 = dot < 0.0f ? -t : t;
+            const float ta1 = 1.0f - t;
+            const float x = ta1 * ra[0][j] + tb1 * rb[0][j];
+            const float y = ta1 * ra[1][j] + tb1 * rb[1][j];
+            const float z = ta1 * ra[2][j] + tb1 * rb[2][j];
+            const float w = ta1 * ra[3][j] + tb1 * rb[3][j];
+            const float inv = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+            out.rotation[0][j] = x * inv;
+            out.rotation[1][j] = y * inv;
+            out.rotation[2][j] = z * inv;
+            out.rotation[3][j] = w * inv;
+        }
+        for (int c = 0; c < 3; ++c) {
+            for (uint32_t j = 0; j < n; ++j) {
+                out.translation[c][j] = ta[c][j] + t * (tb[c][j] - ta[c][j]);
+            }
+        }
+    }
+
+    void sample_animator(const AnimationSet& set, const Animator& animator, Pose& pose, Pose& scratch) {
+        animation_sample(set.clips[animator.clips[0]], animator.phase, pose);
+        if (animator.blend > 0.0f) {
+            animation_sample(set.clips[animator.clips[1]], animator.phase, scratch);
+            animation_blend(pose, scratch, animator.blend, set.skeleton.size(), pose);
+        }
+    }
+}
+
+void animation_clip_resize(AnimationClip& clip, uint32_t jointCount, uint32_t frameCount) {
+    clip.jointCount = std::min(jointCount, ANIMATION_MAX_JOINTS);
+    clip.frameCount = frameCount;
+    const size_t keys = (size_t)clip.jointCount * frameCount;
+    for (int c = 0; c < 4; ++c) {
+        clip.rotation[c].assign(keys, c == 3 ? 1.0f : 0.0f);
+    }
+    for (int c = 0; c < 3; ++c) {
+        clip.translation[c].assign(keys, 0.0f);
+    }
+}
+
+void animation_set_key(AnimationClip& clip, uint32_t frame, uint32_t joint, simd::quatf rotation,
+                       simd::float3 translation) {
+    const size_t key = (size_t)frame * clip.jointCount + joint;
+    for (int c = 0; c < 4; ++c) {
+        clip.rotation[c][key] = rotation.vector[c];
+    }
+    for (int c = 0; c < 3; ++c) {
+        clip.translation[c][key] = translation[c];
+    }
+}
+
+void animation_sample(const AnimationClip& clip, float phase, Pose& pose) {
+    const uint32_t n = clip.jointCount;
+    if (clip.frameCount == 0) {
+        return;
+    }
+    uint32_t frame = 0;
+    float t = 0.0f;
+    if (clip.frameCount > 1) {
+        const float position = (phase - floorf(phase)) * (float)(clip.frameCount - 1);
+        frame = std::min((uint32_t)position, clip.frameCount - 2);
+        t = std::clamp(position - (float)frame, 0.0f, 1.0f);
+    }
+    const size_t first = (size_t)frame * n;
+    const size_t second = clip.frameCount > 1 ? first + n : first;
+    const float* const ra[4] = { clip.rotation[0].data() + first, clip.rotation[1].data() + first,
+                                 clip.rotation[2].data() + first, clip.rotation[3].data() + first };
+    const float* const rb[4] = { clip.rotation[0].data() + second, clip.rotation[1].data() + second,
+                                 clip.rotation[2].data() + second, clip.rotation[3].data() + second };
+    const float* const ta[3] = { clip.translation[0].data() + first, clip.translation[1].data() + first,
+                                 clip.translation[2].data() + first };
+    const float* const tb[3] = { clip.translation[0].data() + second, clip.translation[1].data() + second,
+                                 clip.translation[2].data() + second };
+    nlerp_joints(ra, ta, rb, tb, t, n, pose);
+}
+
+void animation_blend(const Pose& a, const Pose& b, float weight, uint32_t jointCount, Pose& out) {
+    const float* const ra[4] = { a.rotation[0], a.rotation[1], a.rotation[2], a.rotation[3] };
+    const float* const rb[4] = { b.rotation[0], b.rotation[1], b.rotation[2], b.rotation[3] };
+    const float* const ta[3] = { a.translation[0], a.translation[1], a.translation[2] };
+    const float* const tb[3] = { b.translation[0], b.translation[1], b.translation[2] };
+    // Joint j of out is written only after joint j of a and b is read, so out may alias either
+    nlerp_joints(ra, ta, rb, tb, std::clamp(weight, 0.0f, 1.0f), std::min(jointCount, ANIMATION_MAX_JOINTS), out);
+}
+
+void animation_palette(const Skeleton& skeleton, const Pose& pose, Affine* palette) {
+    Affine model[ANIMATION_MAX_JOINTS];
+    const uint32_t n = std::min(skeleton.size(), ANIMATION_MAX_JOINTS);
+    for (uint32_t j = 0; j < n; ++j) {
+        Trs local;
+        local.translation = { pose.translation[0][j], pose.translation[1][j], pose.translation[2][j] };
+        local.rotation = simd::quatf{ simd::float4{ pose.rotation[0][j], pose.rotation[1][j], pose.rotation[2][j],
+                                                    pose.rotation[3][j] } };
+        const Affine transform = affine_from_trs(local);
+        const uint32_t parent = skeleton.parents[j];
+        model[j] = parent == JOINT_ROOT ? transform : affine_multiply(model[parent], transform);
+        palette[j] = affine_multiply(model[j], skeleton.inverseBind[j]);
+    }
+}
+
+void animator_advance(Animator& animator, const AnimationSet& set, float dt) {
+    const float first = set.clips[animator.clips[0]].duration();
+    const float second = set.clips[animator.clips[1]].duration();
+    const float duration = first + animator.blend * (second - first);
+    if (duration > 0.0f) {
+        animator.phase += dt * animator.speed / duration;
+        animator.phase -= floorf(animator.phase);
+    }
+}
+
+void animate(JobSystem& jobs, const AnimationSet& set, Animator* animators, uint32_t count, float dt,
+             Affine* palettes) {
+    const uint32_t joints = set.skeleton.size();
+    jobs.parallel_for(count, ANIMATION_GRAIN, [&](uint32_t begin, uint32_t end) {
+        Pose pose;
+        Pose scratch;
+        for (uint32_t i = begin; i < end; ++i) {
+            animator_advance(animators[i], set, dt);
+            sample_animator(set, animators[i], pose, scratch);
+            animation_palette(set.skeleton, pose, palettes + (size_t)i * joints);
+        }
+    });
+}
+
+Vertex skin_vertex(const Vertex& vertex, const VertexSkin& skin, const Affine* palette) {
+    Affine blended = {};
+    for (uint32_t i = 0; i < SKIN_INFLUENCES; ++i) {
+        const float weight = skin.weights[i] * (1.0f / 255.0f);
+        const Affine& m = palette[skin.joints[i]];
+        for (int r = 0; r < 3; ++r) {
+            blended.rows[r] += weight * m.rows[r];
+        }
+    }
+    Vertex out;
+    out.position = affine_transform_point(blended, vertex.position);
+    out.normal = simd::normalize(affine_transform_vector(blended, vertex.normal));
+    return out;
+}
+
+BoundingBox animation_bounds(const SkinnedMesh& mesh, const AnimationSet& set) {
+    BoundingBox box = compute_bounds(mesh.mesh.vertices.data(), mesh.mesh.vertices.size());
+    Pose pose;
+    Affine palette[ANIMATION_MAX_JOINTS];
+    for (const AnimationClip& clip : set.clips) {
+        for (uint32_t frame = 0; frame < clip.frameCount; ++frame) {
+            // The phase of a key lands exactly on it
+            animation_sample(clip, clip.frameCount > 1 ? (float)frame / (clip.frameCount - 1) : 0.0f, pose);
+            animation_palette(set.skeleton, pose, palette);
+            for (size_t v = 0; v < mesh.mesh.vertices.size(); ++v) {
+                const simd::float3 p = skin_vertex(mesh.mesh.vertices[v], mesh.skin[v], palette).position;
+                box.min = simd::min(box.min, p);
+                box.max = simd::max(box.max, p);
+            }
+        }
+    }
+    return box;
+}
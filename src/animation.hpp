@@ -0,0 +1,210 @@
+/**
+ * @file animation.hpp
+ * @brief Skeletal animation: clips sampled and blended on the job system into skinning palettes.
+ *
+ * A clip keeps its keys as structure-of-arrays tracks, one array per rotation and translation
+ * component, frame after frame, so sampling walks every joint of a frame with the same
+ * arithmetic over contiguous floats and the loops vectorize. Keys are taken at a fixed rate, so
+ * the two keys around a time are found with a multiply rather than a search, and rotations
+ * between them are a normalized lerp along the shorter arc, which at 30 keys a second cannot be
+ * told from a slerp. Two poses blend the same way. Clips are played by phase rather than time, so
+ * blending a walk with an idle of another length keeps both cycles in step as the weight moves.
+ *
+ * Joints are ordered parents first, so one forward pass finds every model space transform. A
+ * palette entry is that transform times the joint's inverse bind transform: it moves a bind pose
+ * vertex to where the joint has carried it. skin_vertex() is the reference the skin_vertices
+ * kernel in shaders.metal is ported from.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "affine.hpp"
+#include "job_system.hpp"
+#include "objects.hpp"
+
+/// Most joints a skeleton can have; a joint index must also fit VertexSkin::joints.
+constexpr uint32_t ANIMATION_MAX_JOINTS = 64;
+/// Joints each vertex follows.
+constexpr uint32_t SKIN_INFLUENCES = 4;
+/// Parent of a root joint.
+constexpr uint32_t JOINT_ROOT = UINT32_MAX;
+/// Fewest animators per animate() job.
+constexpr uint32_t ANIMATION_GRAIN = 8;
+
+/**
+ * @struct Skeleton
+ * @brief The joint hierarchy in its bind pose.
+ */
+struct Skeleton {
+    std::vector<uint32_t> parents;      ///< Parent of each joint, which comes before it, or JOINT_ROOT.
+    std::vector<Affine> inverseBind;    ///< Model space to joint space in the bind pose.
+
+    /// @return The number of joints.
+    uint32_t size() const { return (uint32_t)parents.size(); }
+};
+
+/**
+ * @struct AnimationClip
+ * @brief Joint rotations and translations relative to the parent, keyed at a fixed rate.
+ *
+ * Each track holds frameCount * jointCount keys, frame-major: the key of joint j at frame f is
+ * entry f * jointCount + j. The last frame of a looping clip repeats the first.
+ */
+struct AnimationClip {
+    uint32_t jointCount = 0;            ///< Joints keyed per frame.
+    uint32_t frameCount = 0;            ///< Frames in every track.
+    float sampleRate = 30.0f;           ///< Frames per second.
+    std::vector<float> rotation[4];     ///< Quaternion x, y, z and w tracks.
+    std::vector<float> translation[3];  ///< Translation x, y and z tracks.
+
+    /// @return The clip's length in seconds.
+    float duration() const { return frameCount > 1 ? (frameCount - 1) / sampleRate : 0.0f; }
+};
+
+/**
+ * @struct Pose
+ * @brief One rotation and translation per joint, relative to its parent, in the clip track layout.
+ *
+ * Fixed size, so a job samples and blends on its own stack without allocating.
+ */
+struct Pose {
+    alignas(16) float rotation[4][ANIMATION_MAX_JOINTS];    ///< Quaternion components per joint.
+    alignas(16) float translation[3][ANIMATION_MAX_JOINTS]; ///< Translation components per joint.
+};
+
+/**
+ * @struct AnimationSet
+ * @brief A skeleton and the clips keyed for it.
+ */
+struct AnimationSet {
+    Skeleton skeleton;                  ///< The joints every clip keys.
+    std::vector<AnimationClip> clips;   ///< Clips, indexed by Animator::clips.
+};
+
+/**
+ * @struct Animator
+ * @brief How one skinned instance plays its set: two clips and the weight between them.
+ */
+struct Animator {
+    uint32_t clips[2] = { 0, 0 };       ///< The blended clips.
+    float blend = 0.0f;                 ///< Weight of clips[1]; 0 plays clips[0] alone.
+    float phase = 0.0f;                 ///< Position in the cycle, in [0, 1).
+    float speed = 1.0f;                 ///< Playback rate.
+};
+
+/**
+ * @struct VertexSkin
+ * @brief The joints a vertex follows; matches `VertexSkin` in shaders.metal.
+ */
+struct VertexSkin {
+    uint8_t joints[SKIN_INFLUENCES];    ///< Joint indices; unused influences have weight 0.
+    uint8_t weights[SKIN_INFLUENCES];   ///< unorm8 weights summing to 255.
+};
+
+/**
+ * @struct SkinnedMesh
+ * @brief A mesh in its bind pose and the joints each vertex follows.
+ */
+struct SkinnedMesh {
+    MeshData mesh;                      ///< Bind pose vertices and indices.
+    std::vector<VertexSkin> skin;       ///< One entry per vertex.
+};
+
+/**
+ * @brief Sizes every track of a clip and fills it with identity keys.
+ * @param clip The clip.
+ * @param jointCount Joints keyed per frame; at most ANIMATION_MAX_JOINTS.
+ * @param frameCount Frames per track.
+ */
+void animation_clip_resize(AnimationClip& clip, uint32_t jointCount, uint32_t frameCount);
+
+/**
+ * @brief Sets one key of a clip.
+ * @param clip The clip.
+ * @param frame The frame.
+ * @param joint The joint.
+ * @param rotation Rotation relative to the parent.
+ * @param translation Translation relative to the parent.
+ */
+void animation_set_key(AnimationClip& clip, uint32_t frame, uint32_t joint, simd::quatf rotation,
+                       simd::float3 translation);
+
+/**
+ * @brief Samples a clip, interpolating between the two keys around a point of its cycle.
+ * @param clip The clip.
+ * @param phase Position in the clip's cycle; wrapped into [0, 1).
+ * @param pose Receives the clip's joints.
+ */
+void animation_sample(const AnimationClip& clip, float phase, Pose& pose);
+
+/**
+ * @brief Blends two poses joint by joint.
+ * @param a The pose at weight 0.
+ * @param b The pose at weight 1.
+ * @param weight How far to move from a towards b.
+ * @param jointCount The joints to blend.
+ * @param out Receives the blend; may be a or b.
+ */
+void animation_blend(const Pose& a, const Pose& b, float weight, uint32_t jointCount, Pose& out);
+
+/**
+ * @brief Builds a skinning palette from a pose.
+ * @param skeleton The skeleton the pose is of.
+ * @param pose The joints relative to their parents.
+ * @param palette Receives skeleton.size() transforms from bind pose to posed model space.
+ */
+void animation_palette(const Skeleton& skeleton, const Pose& pose, Affine* palette);
+
+/**
+ * @brief Moves an animator along its cycle.
+ *
+ * The cycle lasts the blend of its two clips' durations, so the phase advances at the
+ * rate of whichever clip the weight favours.
+ *
+ * @param animator The animator.
+ * @param set The set its clips belong to.
+ * @param dt Elapsed seconds.
+ */
+void animator_advance(Animator& animator, const AnimationSet& set, float dt);
+
+/**
+ * @brief Advances, samples and blends every animator and writes its palette, in jobs of ANIMATION_GRAIN.
+ * @param jobs The job system; the caller takes part and returns once every palette is written.
+ * @param set The set every animator plays.
+ * @param animators The animators.
+ * @param count The number of animators.
+ * @param dt Elapsed seconds.
+ * @param palettes Receives set.skeleton.size() transforms per animator, in animator order.
+ */
+void animate(JobSystem& jobs, const AnimationSet& set, Animator* animators, uint32_t count, float dt,
+             Affine* palettes);
+
+/**
+ * @brief Skins one vertex; matches skin_vertices in shaders.metal.
+ *
+ * The palette entries are blended by weight and the blend moves the position and, renormalized,
+ * the normal. Joints only rotate and translate, so the blend's 3x3 part is close enough to a
+ * rotation to carry normals.
+ *
+ * @param vertex The bind pose vertex.
+ * @param skin The joints it follows.
+ * @param palette The palette of the pose.
+ * @return The posed vertex.
+ */
+Vertex skin_vertex(const Vertex& vertex, const VertexSkin& skin, const Affine* palette);
+
+/**
+ * @brief Returns a box around a skinned mesh in every key frame of every clip of a set.
+ *
+ * Blends stay between the poses they blend, so the box also bounds them up to the curvature of
+ * the interpolation; callers pad it slightly.
+ *
+ * @param mesh The mesh.
+ * @param set The set it is played with.
+ * @return The model space box.
+ */
+BoundingBox animation_bounds(const SkinnedMesh& mesh, const AnimationSet& set);
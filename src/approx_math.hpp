@@ -0,0 +1,97 @@
+/**
+ * @file approx_math.hpp
+ * @brief Polynomial sine and cosine for call sites that can give up libm's last bits for speed.
+ *
+ * Each call site picks its precision: the approx_ functions below, or libm (through
+ * precise_sincos() when both are wanted) where an error would accumulate or must match
+ * another path exactly, such as the ocean's FFT twiddles or the transforms the tests
+ * compare against matrix_rotation_y(). The argument is reduced to [-pi/4, pi/4] by a
+ * three-part Cody-Waite subtraction and both functions are evaluated there by short
+ * polynomials, so a sine and cosine of the same angle cost one reduction.
+ *
+ * The noise's cosine interpolant does not call these: it only needs [0, pi], and its own
+ * polynomial lives in noise_shared.hpp so the GPU evaluates it with the same operations.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/// Largest |x| for which APPROX_TRIG_MAX_ERROR holds; beyond it the reduction loses bits.
+constexpr float APPROX_TRIG_RANGE = 12800.0f;
+/// Largest absolute error of approx_sin and approx_cos against the exact values, within range.
+constexpr float APPROX_TRIG_MAX_ERROR = 1.5e-7f;
+
+namespace approx_detail {
+    // x - k pi/2 for the nearest integer k; the first two parts of pi/2 have few enough bits
+    // that their products with any k below 2^13 are exact
+    inline float reduce(float x, int32_t& quadrant) {
+        const float k = (float)(int32_t)std::fma(x, 0.636619772f, std::copysign(0.5f, x));
+        quadrant = (int32_t)k;
+        float r = std::fma(k, -1.5703125f, x);
+        r = std::fma(k, -4.83751297e-4f, r);
+        return std::fma(k, -7.54978995e-8f, r);
+    }
+
+    // Minimax polynomials on [-pi/4, pi/4], after Cephes' sinf and cosf
+    inline float sin_kernel(float r) {
+        const float z = r * r;
+        return std::fma(std::fma(std::fma(-1.9515296e-4f, z, 8.3321609e-3f), z, -1.6666655e-1f), z * r, r);
+    }
+
+    inline float cos_kernel(float r) {
+        const float z = r * r;
+        const float p = std::fma(std::fma(2.4433157e-5f, z, -1.3887316e-3f), z, 4.1666646e-2f);
+        return std::fma(std::fma(p, z, -0.5f), z, 1.0f);
+    }
+}
+
+/**
+ * @brief Computes the sine and cosine of an angle together, by polynomial.
+ * @param x The angle in radians; see APPROX_TRIG_RANGE.
+ * @param s Receives the sine, within APPROX_TRIG_MAX_ERROR.
+ * @param c Receives the cosine, within APPROX_TRIG_MAX_ERROR.
+ */
+inline void approx_sincos(float x, float& s, float& c) {
+    int32_t quadrant;
+    const float r = approx_detail::reduce(x, quadrant);
+    const float sr = approx_detail::sin_kernel(r);
+    const float cr = approx_detail::cos_kernel(r);
+    switch (quadrant & 3) {
+    case 0: s = sr; c = cr; break;
+    case 1: s = cr; c = -sr; break;
+    case 2: s = -sr; c = -cr; break;
+    default: s = -cr; c = sr; break;
+    }
+}
+
+/// @return The sine of x in radians, within APPROX_TRIG_MAX_ERROR.
+inline float approx_sin(float x) {
+    float s, c;
+    approx_sincos(x, s, c);
+    return s;
+}
+
+/// @return The cosine of x in radians, within APPROX_TRIG_MAX_ERROR.
+inline float approx_cos(float x) {
+    float s, c;
+    approx_sincos(x, s, c);
+    return c;
+}
+
+/**
+ * @brief Computes the sine and cosine of an angle together with libm's precision.
+ * @param x The angle in radians.
+ * @param s Receives sinf(x).
+ * @param c Receives cosf(x).
+ */
+inline void precise_sincos(float x, float& s, float& c) {
+#ifdef __APPLE__
+    __sincosf(x, &s, &c);
+#else
+    // GCC and Clang fuse the pair into one sincosf call
+    s = sinf(x);
+    c = cosf(x);
+#endif
+}
@@ -0,0 +1,107 @@
+/**
+ * @file asset_loader.hpp
+ * @brief Streams file contents straight into GPU buffers and textures with Metal fast resource loading.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <mutex>
+#include <string>
+
+/**
+ * @enum AssetPriority
+ * @brief Order in which queued loads are serviced; each priority has its own IO queue.
+ */
+enum class AssetPriority {
+    High,   ///< Needed for the next frames, e.g. terrain next to the camera.
+    Normal, ///< Needed soon.
+    Low,    ///< Prefetching.
+};
+
+/**
+ * @enum AssetLoadStatus
+ * @brief State of an AssetLoad.
+ */
+enum class AssetLoadStatus {
+    Pending,    ///< Queued or being read.
+    Complete,   ///< The destination holds the file contents.
+    Failed,     ///< Cancelled or failed; the destination contents are undefined.
+};
+
+/**
+ * @struct AssetLoad
+ * @brief A load in flight; copyable, all copies refer to the same load.
+ */
+struct AssetLoad {
+    id<MTLIOCommandBuffer> commands; ///< The IO command buffer doing the load; nil for no load.
+};
+
+/// @return True if the device and OS support MTLIOCommandQueue.
+bool asset_loader_supported(id<MTLDevice> device);
+
+/**
+ * @class AssetLoader
+ * @brief Loads files into GPU resources on MTLIOCommandQueues, keeping the CPU out of the copy.
+ *
+ * The GPU's IO path reads and, for compressed files, decompresses the data and writes it into
+ * the destination, which may be private. Callers gate on status() before the destination is
+ * used, as with ResourceUploader::is_complete(). Loads that are no longer wanted, like terrain
+ * the camera has left, are dropped with cancel(). Safe to call from several threads.
+ */
+class AssetLoader {
+public:
+    explicit AssetLoader(id<MTLDevice> device);
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    /**
+     * @brief Queues a read of part of a file into a buffer.
+     * @param path The file to read.
+     * @param fileOffset Byte offset of the data in the file, after decompression.
+     * @param length Number of bytes to read.
+     * @param buffer The destination buffer.
+     * @param bufferOffset Byte offset in the destination.
+     * @param priority Queue the load runs on.
+     * @param compression How the file was written; MTLIOCompressionMethodZlib etc., or -1 if uncompressed.
+     * @return The load, or one with nil commands if the file could not be opened.
+     */
+    AssetLoad load_buffer(const std::string& path, size_t fileOffset, size_t length, id<MTLBuffer> buffer,
+                          size_t bufferOffset, AssetPriority priority, NSInteger compression = -1);
+
+    /**
+     * @brief Queues a read of tightly packed texels into one slice and level of a texture.
+     * @param path The file to read.
+     * @param fileOffset Byte offset of the texels in the file, after decompression.
+     * @param texture The destination texture.
+     * @param slice The array slice or cube face.
+     * @param level The mip level.
+     * @param size Texels to write, starting at the origin of the level.
+     * @param bytesPerRow Bytes between rows in the file; rows of blocks for ASTC or BC1 textures.
+     * @param priority Queue the load runs on.
+     * @param compression How the file was written, or -1 if uncompressed.
+     * @return The load, or one with nil commands if the file could not be opened.
+     */
+    AssetLoad load_texture(const std::string& path, size_t fileOffset, id<MTLTexture> texture, NSUInteger slice,
+                           NSUInteger level, MTLSize size, size_t bytesPerRow, AssetPriority priority,
+                           NSInteger compression = -1);
+
+    /// @return The state of a load; a load with nil commands has Failed.
+    static AssetLoadStatus status(const AssetLoad& load);
+
+    /// Cancels a load if it has not completed; its status becomes Failed unless it already finished.
+    static void cancel(const AssetLoad& load);
+
+    /// @return Bytes queued for loading since creation.
+    size_t loaded_bytes() const;
+
+private:
+    id<MTLIOFileHandle> open(const std::string& path, NSInteger compression);
+    AssetLoad commit(id<MTLIOCommandBuffer> commands, id<MTLIOFileHandle> handle, size_t length);
+
+    id<MTLDevice> m_device;
+    id<MTLIOCommandQueue> m_queues[3];  ///< Indexed by AssetPriority.
+    size_t m_loadedBytes = 0;
+    mutable std::mutex m_mutex;
+};
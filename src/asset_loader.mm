@@ -0,0 +1,117 @@
+#import "asset_loader.hpp"
+
+#include "gpu_texture_compression.hpp"
+
+namespace {
+    const MTLIOPriority QUEUE_PRIORITIES[] = { MTLIOPriorityHigh, MTLIOPriorityNormal, MTLIOPriorityLow };
+    NSString* const QUEUE_LABELS[] = { @"Asset loads (high)", @"Asset loads (normal)", @"Asset loads (low)" };
+}
+
+bool asset_loader_supported(id<MTLDevice> device) {
+    if (@available(macOS 13.0, *)) {
+        return [device respondsToSelector:@selector(newIOCommandQueueWithDescriptor:error:)];
+    }
+    return false;
+}
+
+AssetLoader::AssetLoader(id<MTLDevice> device) : m_device(device) {
+    for (int i = 0; i < 3; ++i) {
+        MTLIOCommandQueueDescriptor* desc = [MTLIOCommandQueueDescriptor new];
+        desc.priority = QUEUE_PRIORITIES[i];
+        // Loads of different chunks are independent; let them finish out of order
+        desc.type = MTLIOCommandQueueTypeConcurrent;
+        NSError* error = nil;
+        m_queues[i] = [m_device newIOCommandQueueWithDescriptor:desc error:&error];
+        if (!m_queues[i]) {
+            NSLog(@"Failed to create IO command queue: %@", error);
+            continue;
+        }
+        m_queues[i].label = QUEUE_LABELS[i];
+    }
+}
+
+id<MTLIOFileHandle> AssetLoader::open(const std::string& path, NSInteger compression) {
+    NSURL* url = [NSURL fileURLWithPath:[NSString stringWithUTF8String:path.c_str()]];
+    NSError* error = nil;
+    id<MTLIOFileHandle> handle = compression < 0
+        ? [m_device newIOFileHandleWithURL:url error:&error]
+        : [m_device newIOFileHandleWithURL:url compressionMethod:(MTLIOCompressionMethod)compression error:&error];
+    if (!handle) {
+        NSLog(@"Failed to open %s for loading: %@", path.c_str(), error);
+    }
+    return handle;
+}
+
+AssetLoad AssetLoader::load_buffer(const std::string& path, size_t fileOffset, size_t length, id<MTLBuffer> buffer,
+                                   size_t bufferOffset, AssetPriority priority, NSInteger compression) {
+    id<MTLIOCommandQueue> queue = m_queues[(int)priority];
+    id<MTLIOFileHandle> handle = queue ? open(path, compression) : nil;
+    if (!handle) {
+        return {};
+    }
+    id<MTLIOCommandBuffer> commands = [queue commandBuffer];
+    [commands loadBuffer:buffer offset:bufferOffset size:length sourceHandle:handle sourceHandleOffset:fileOffset];
+    return commit(commands, handle, length);
+}
+
+AssetLoad AssetLoader::load_texture(const std::string& path, size_t fileOffset, id<MTLTexture> texture,
+                                    NSUInteger slice, NSUInteger level, MTLSize size, size_t bytesPerRow,
+                                    AssetPriority priority, NSInteger compression) {
+    id<MTLIOCommandQueue> queue = m_queues[(int)priority];
+    id<MTLIOFileHandle> handle = queue ? open(path, compression) : nil;
+    if (!handle) {
+        return {};
+    }
+    // Block-compressed files hold rows of blocks
+    const size_t blockHeight = texture_block_format(texture_compression_of(texture.pixelFormat)).height;
+    const size_t bytesPerImage = bytesPerRow * ((size.height + blockHeight - 1) / blockHeight);
+    id<MTLIOCommandBuffer> commands = [queue commandBuffer];
+    [commands loadTexture:texture
+                    slice:slice
+                    level:level
+                     size:size
+        sourceBytesPerRow:bytesPerRow
+      sourceBytesPerImage:bytesPerImage
+        destinationOrigin:MTLOriginMake(0, 0, 0)
+             sourceHandle:handle
+       sourceHandleOffset:fileOffset];
+    return commit(commands, handle, bytesPerImage * size.depth);
+}
+
+AssetLoad AssetLoader::commit(id<MTLIOCommandBuffer> commands, id<MTLIOFileHandle> handle, size_t length) {
+    // The handle must outlive the reads; the block keeps it until the buffer completes
+    [commands addCompletedHandler:^(id<MTLIOCommandBuffer> completed) {
+        (void)handle;
+        if (completed.status == MTLIOStatusError) {
+            NSLog(@"Asset load failed: %@", completed.error);
+        }
+    }];
+    [commands commit];
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loadedBytes += length;
+    return { commands };
+}
+
+AssetLoadStatus AssetLoader::status(const AssetLoad& load) {
+    if (!load.commands) {
+        return AssetLoadStatus::Failed;
+    }
+    switch (load.commands.status) {
+    case MTLIOStatusPending:
+        return AssetLoadStatus::Pending;
+    case MTLIOStatusComplete:
+        return AssetLoadStatus::Complete;
+    default:
+        return AssetLoadStatus::Failed;
+    }
+}
+
+void AssetLoader::cancel(const AssetLoad& load) {
+    [load.commands tryCancel];
+}
+
+size_t AssetLoader::loaded_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_loadedBytes;
+}
@@ -0,0 +1,93 @@
+#include "atmosphere.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr float HALF_PI = 1.57079632679f;
+
+    // Sum of the media's extinction at an altitude
+    simd::float3 extinction(const AtmosphereParams& params, float altitude) {
+        const float rayleigh = expf(-altitude / params.rayleighScaleHeight);
+        const float mie = expf(-altitude / params.mieScaleHeight);
+        const float ozone = std::max(0.0f, 1.0f - fabsf(altitude - params.ozoneCenter) / (0.5f * params.ozoneWidth));
+        return params.rayleighScattering * rayleigh + params.mieExtinction * mie + params.ozoneAbsorption * ozone;
+    }
+
+    // Distance from a point inside the sphere of radius sphere to where the ray leaves it
+    float distance_to_sphere(float radius, float mu, float sphere) {
+        const float discriminant = radius * radius * (mu * mu - 1.0f) + sphere * sphere;
+        return std::max(0.0f, -radius * mu + sqrtf(std::max(discriminant, 0.0f)));
+    }
+
+    // The sun's azimuth in the horizontal plane; +X when the sun is straight up
+    simd::float3 sun_forward(simd::float3 sun) {
+        const float length = sqrtf(sun.x * sun.x + sun.z * sun.z);
+        return length > 1e-5f ? simd::float3{ sun.x / length, 0.0f, sun.z / length } : simd::float3{ 1.0f, 0.0f, 0.0f };
+    }
+}
+
+simd::float2 atmosphere_transmittance_uv(const AtmosphereParams& params, float radius, float mu) {
+    const float horizon = sqrtf(params.topRadius * params.topRadius - params.bottomRadius * params.bottomRadius);
+    const float rho = sqrtf(std::max(radius * radius - params.bottomRadius * params.bottomRadius, 0.0f));
+    const float d = distance_to_sphere(radius, mu, params.topRadius);
+    const float dMin = params.topRadius - radius;
+    const float dMax = rho + horizon;
+    return { (d - dMin) / (dMax - dMin), rho / horizon };
+}
+
+void atmosphere_transmittance_radius_mu(const AtmosphereParams& params, simd::float2 uv, float& radius, float& mu) {
+    const float horizon = sqrtf(params.topRadius * params.topRadius - params.bottomRadius * params.bottomRadius);
+    const float rho = horizon * uv.y;
+    radius = sqrtf(rho * rho + params.bottomRadius * params.bottomRadius);
+    const float dMin = params.topRadius - radius;
+    const float dMax = rho + horizon;
+    const float d = dMin + uv.x * (dMax - dMin);
+    mu = d == 0.0f ? 1.0f : (horizon * horizon - rho * rho - d * d) / (2.0f * radius * d);
+    mu = std::clamp(mu, -1.0f, 1.0f);
+}
+
+simd::float3 atmosphere_transmittance(const AtmosphereParams& params, float radius, float mu, uint32_t steps) {
+    const float length = distance_to_sphere(radius, mu, params.topRadius);
+    const float dt = length / (float)steps;
+    simd::float3 opticalDepth = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t i = 0; i < steps; ++i) {
+        // Midpoint of the step, by the law of cosines
+        const float t = ((float)i + 0.5f) * dt;
+        const float r = sqrtf(radius * radius + t * t + 2.0f * radius * mu * t);
+        opticalDepth += extinction(params, r - params.bottomRadius) * dt;
+    }
+    return { expf(-opticalDepth.x), expf(-opticalDepth.y), expf(-opticalDepth.z) };
+}
+
+simd::float2 atmosphere_sky_view_uv(simd::float3 direction, simd::float3 sun) {
+    const float elevation = asinf(std::clamp(direction.y, -1.0f, 1.0f));
+    const float v = elevation >= 0.0f ? 0.5f * (1.0f - sqrtf(elevation / HALF_PI))
+                                      : 0.5f + 0.5f * sqrtf(-elevation / HALF_PI);
+
+    float cosAzimuth = 1.0f;
+    const float horizontal = sqrtf(direction.x * direction.x + direction.z * direction.z);
+    if (horizontal > 1e-5f) {
+        const simd::float3 forward = sun_forward(sun);
+        cosAzimuth = std::clamp((direction.x * forward.x + direction.z * forward.z) / horizontal, -1.0f, 1.0f);
+    }
+    return { sqrtf(std::clamp(0.5f - 0.5f * cosAzimuth, 0.0f, 1.0f)), v };
+}
+
+simd::float3 atmosphere_sky_view_direction(simd::float2 uv, simd::float3 sun) {
+    const float c = uv.y < 0.5f ? 1.0f - 2.0f * uv.y : 2.0f * uv.y - 1.0f;
+    const float elevation = (uv.y < 0.5f ? 1.0f : -1.0f) * c * c * HALF_PI;
+    const float cosAzimuth = 1.0f - 2.0f * uv.x * uv.x;
+    const float sinAzimuth = sqrtf(std::max(1.0f - cosAzimuth * cosAzimuth, 0.0f));
+
+    // cross(forward, up) for a horizontal forward
+    const simd::float3 forward = sun_forward(sun);
+    const simd::float3 side = { -forward.z, 0.0f, forward.x };
+    const simd::float3 horizontal = forward * cosAzimuth + side * sinAzimuth;
+    return horizontal * cosf(elevation) + simd::float3{ 0.0f, sinf(elevation), 0.0f };
+}
+
+bool atmosphere_sun_moved(simd::float3 computed, simd::float3 sun) {
+    // About a quarter of a degree, under half a sky view texel next to the sun
+    return simd::dot(computed, sun) < 0.99999f;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file atmosphere.hpp
+ * @brief Physically based sky: the atmosphere model and the parameterization of its lookup tables.
+ *
+ * The sky follows Hillaire's "A Scalable and Production Ready Sky and Atmosphere Rendering
+ * Technique" (2020). A planet-sized sphere of Rayleigh, Mie and ozone media is summarised in
+ * three textures that compute kernels fill (see sky.hpp):
+ *
+ *  - Transmittance, by altitude and the cosine of the view zenith angle. It depends on the
+ *    atmosphere alone, so it is computed once.
+ *  - Multiple scattering, by altitude and the cosine of the sun zenith angle: the light that
+ *    arrives after two or more bounces, as an isotropic source. Also computed once.
+ *  - Sky view, the radiance reaching the viewer from every direction, by view elevation and
+ *    azimuth from the sun. It depends on the sun and is only recomputed when the sun moves.
+ *
+ * The sky pass and the distance fog both read the sky view, so fog takes the colour of the
+ * sky behind it. These functions are the CPU reference of the kernels' parameterizations and
+ * of the transmittance integral; distances are in kilometres.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+/// Transmittance lookup texels: cosine of the view zenith across, altitude down.
+constexpr uint32_t ATMOSPHERE_TRANSMITTANCE_WIDTH = 256;
+constexpr uint32_t ATMOSPHERE_TRANSMITTANCE_HEIGHT = 64;
+/// Multiple scattering lookup texels along each side: cosine of the sun zenith across, altitude down.
+constexpr uint32_t ATMOSPHERE_MULTISCATTERING_SIZE = 32;
+/// Sky view lookup texels: azimuth from the sun across, view elevation down.
+constexpr uint32_t ATMOSPHERE_SKY_VIEW_WIDTH = 192;
+constexpr uint32_t ATMOSPHERE_SKY_VIEW_HEIGHT = 108;
+
+/**
+ * @struct AtmosphereParams
+ * @brief The atmosphere and the sun; matches AtmosphereParams in shaders.metal.
+ *
+ * Coefficients are per kilometre at sea level, and fall off exponentially with altitude,
+ * except ozone, whose density is a tent around ozoneCenter.
+ */
+struct AtmosphereParams {
+    simd::float3 rayleighScattering = { 5.802e-3f, 13.558e-3f, 33.1e-3f }; ///< Rayleigh scattering, which has no absorption.
+    simd::float3 mieScattering = { 3.996e-3f, 3.996e-3f, 3.996e-3f };      ///< Mie scattering.
+    simd::float3 mieExtinction = { 4.44e-3f, 4.44e-3f, 4.44e-3f };         ///< Mie scattering plus absorption.
+    simd::float3 ozoneAbsorption = { 0.650e-3f, 1.881e-3f, 0.085e-3f };    ///< Ozone absorption at the tent's peak.
+    simd::float3 groundAlbedo = { 0.3f, 0.3f, 0.3f };                      ///< Light the ground reflects into the air.
+    simd::float3 sunDirection = { 0.0f, 1.0f, 0.0f };                      ///< Towards the sun, unit length.
+    float bottomRadius = 6360.0f;       ///< Radius of the ground.
+    float topRadius = 6460.0f;          ///< Radius where the atmosphere ends.
+    float rayleighScaleHeight = 8.0f;   ///< Altitude over which Rayleigh density falls by e.
+    float mieScaleHeight = 1.2f;        ///< Altitude over which Mie density falls by e.
+    float miePhaseG = 0.8f;             ///< Mie forward scattering anisotropy.
+    float ozoneCenter = 25.0f;          ///< Altitude of the ozone peak.
+    float ozoneWidth = 30.0f;           ///< Altitude range of the ozone layer.
+    float viewerAltitude = 0.2f;        ///< Altitude the sky view is computed for; the scene is small enough to stay there.
+    float sunIlluminance = 1.0f;        ///< Sun irradiance at the top of the atmosphere.
+    float exposure = 40.0f;             ///< Radiance to display scale, before 1 - exp(-x) tone mapping.
+};
+
+/**
+ * @brief Returns the transmittance lookup coordinates of a ray that starts inside the atmosphere.
+ *
+ * Bruneton's mapping: v follows the distance to the horizon and u the distance to the top of
+ * the atmosphere between its shortest and longest, so texels concentrate near the horizon.
+ * Only rays that miss the ground map into the table; u exceeds 1 for the others.
+ *
+ * @param params The atmosphere.
+ * @param radius Distance of the ray's start from the planet centre.
+ * @param mu Cosine of the ray's zenith angle.
+ * @return Coordinates, in [0, 1]^2 for rays above the horizon.
+ */
+simd::float2 atmosphere_transmittance_uv(const AtmosphereParams& params, float radius, float mu);
+
+/**
+ * @brief Inverts atmosphere_transmittance_uv().
+ * @param params The atmosphere.
+ * @param uv Lookup coordinates.
+ * @param radius Receives the distance from the planet centre.
+ * @param mu Receives the cosine of the zenith angle.
+ */
+void atmosphere_transmittance_radius_mu(const AtmosphereParams& params, simd::float2 uv, float& radius, float& mu);
+
+/**
+ * @brief Integrates the transmittance from a point to the top of the atmosphere.
+ *
+ * The reference for the transmittance kernel, which integrates the rays that miss the ground.
+ *
+ * @param params The atmosphere.
+ * @param radius Distance of the point from the planet centre.
+ * @param mu Cosine of the ray's zenith angle.
+ * @param steps Integration steps.
+ * @return The fraction of light of each channel that survives.
+ */
+simd::float3 atmosphere_transmittance(const AtmosphereParams& params, float radius, float mu, uint32_t steps = 40);
+
+/**
+ * @brief Returns the sky view lookup coordinates of a world direction.
+ *
+ * u is sqrt((1 - cos azimuth) / 2), from the sun's azimuth (0) to the opposite one (1); v
+ * follows the square root of the elevation, above the horizon in [0, 0.5] and below it in
+ * (0.5, 1], so texels concentrate around the sun and along the horizon.
+ *
+ * @param direction The view direction, unit length; +Y is up.
+ * @param sun Towards the sun, unit length.
+ * @return Coordinates in [0, 1]^2.
+ */
+simd::float2 atmosphere_sky_view_uv(simd::float3 direction, simd::float3 sun);
+
+/**
+ * @brief Inverts atmosphere_sky_view_uv().
+ * @param uv Lookup coordinates.
+ * @param sun Towards the sun, unit length.
+ * @return The view direction; of the two mirrored about the vertical plane through the sun, the one
+ *         turning from the sun towards cross(sun, up).
+ */
+simd::float3 atmosphere_sky_view_direction(simd::float2 uv, simd::float3 sun);
+
+/// @return True if the sun moved far enough from where the sky view was computed for it to be recomputed.
+bool atmosphere_sun_moved(simd::float3 computed, simd::float3 sun);
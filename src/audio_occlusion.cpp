@@ -0,0 +1,60 @@
+#include "audio_occlusion.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Segments per job slice; a segment walks tens of cells, so slices are kept short
+    constexpr uint32_t AUDIO_OCCLUSION_GRAIN = 64;
+
+    bool moved(simd::float3 from, simd::float3 to, float tolerance) {
+        return simd::length_squared(to - from) > tolerance * tolerance;
+    }
+}
+
+uint32_t audio_occlusion_update(AudioOcclusion& occlusion, const HeightField& field, JobSystem& jobs,
+                                simd::float3 listener, const AudioOcclusionSettings& settings) {
+    const uint32_t count = occlusion.size();
+    // New emitters start untested
+    occlusion.occlusion.resize(count, 0.0f);
+    occlusion.testedPositions.resize(count);
+    occlusion.testedListeners.resize(count);
+    occlusion.tested.resize(count, 0);
+
+    occlusion.stale.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!occlusion.tested[i] ||
+            moved(occlusion.testedPositions[i], occlusion.positions[i], settings.emitterTolerance) ||
+            moved(occlusion.testedListeners[i], listener, settings.listenerTolerance)) {
+            occlusion.stale.push_back(i);
+        }
+    }
+
+    const uint32_t stale = (uint32_t)occlusion.stale.size();
+    occlusion.starts.resize(stale);
+    occlusion.ends.resize(stale);
+    occlusion.depths.resize(stale);
+    const simd::float3 lift = { 0.0f, settings.clearance, 0.0f };
+    const float fullDepth = std::max(settings.fullDepth, 1e-6f);
+    jobs.parallel_for(stale, AUDIO_OCCLUSION_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t s = begin; s < end; ++s) {
+            occlusion.starts[s] = occlusion.positions[occlusion.stale[s]] + lift;
+            occlusion.ends[s] = listener + lift;
+        }
+        // Nothing deeper than full occlusion changes the result, so the walk stops there
+        height_field_segment_depths(field, occlusion.starts.data() + begin, occlusion.ends.data() + begin, fullDepth,
+                                    occlusion.depths.data() + begin, end - begin);
+        for (uint32_t s = begin; s < end; ++s) {
+            const uint32_t i = occlusion.stale[s];
+            occlusion.occlusion[i] = occlusion.depths[s] / fullDepth;
+            occlusion.testedPositions[i] = occlusion.positions[i];
+            occlusion.testedListeners[i] = listener;
+            occlusion.tested[i] = 1;
+        }
+    });
+    occlusion.lastTested = stale;
+    return stale;
+}
+
+void audio_occlusion_invalidate(AudioOcclusion& occlusion) {
+    std::fill(occlusion.tested.begin(), occlusion.tested.end(), 0);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file audio_occlusion.hpp
+ * @brief Line-of-sight occlusion between sound emitters and the listener, batched against the height field.
+ *
+ * Positional audio muffles a sound the terrain stands between. Each audio tick tests the
+ * segment from every emitter to the listener with height_field_segment_depths(), which walks
+ * the cells it crosses four segments at a time; how deep the segment runs under the ground
+ * sets how occluded the sound is, so a sound fades in as its source comes round a ridge
+ * rather than switching on. The segments are split across the job system in slices.
+ *
+ * Most emitters stand still between ticks, and so does the listener more often than not: an
+ * emitter keeps its last result while neither it nor the listener has moved further than a
+ * tolerance since it was tested, and only the others are tested again. A terrain edit drops
+ * every result.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "height_field.hpp"
+#include "job_system.hpp"
+
+/**
+ * @struct AudioOcclusionSettings
+ * @brief How depth under the terrain turns into occlusion, and when results are reused.
+ */
+struct AudioOcclusionSettings {
+    float fullDepth = 2.0f;             ///< Depth of the segment under the ground at which a sound is fully occluded.
+    float clearance = 0.5f;             ///< Lift of both ends, so the ground a source rests on does not hide it.
+    float emitterTolerance = 0.05f;     ///< Distance an emitter moves before it is tested again.
+    float listenerTolerance = 0.5f;     ///< Distance the listener moves before every emitter is tested again.
+};
+
+/**
+ * @struct AudioOcclusion
+ * @brief The emitters, one element per emitter in every array, and their cached results.
+ *
+ * The caller owns positions, growing, shrinking and moving the emitters between updates;
+ * the other arrays follow its size on the next update.
+ */
+struct AudioOcclusion {
+    std::vector<simd::float3> positions;        ///< World position of each emitter.
+    std::vector<float> occlusion;               ///< 0 for a clear line to the listener, 1 fully occluded.
+    std::vector<simd::float3> testedPositions;  ///< Where each emitter was when last tested.
+    std::vector<simd::float3> testedListeners;  ///< Where the listener was when each emitter was last tested.
+    std::vector<uint8_t> tested;                ///< 1 if the emitter's result is still cached.
+
+    // --- Scratch kept across ticks ---
+    std::vector<uint32_t> stale;                ///< Emitters tested this tick.
+    std::vector<simd::float3> starts;           ///< Lifted emitter end of each stale segment.
+    std::vector<simd::float3> ends;             ///< Lifted listener end of each stale segment.
+    std::vector<float> depths;                  ///< Depth of each stale segment.
+
+    uint32_t lastTested = 0;                    ///< Emitters the last update tested; the rest were cached.
+
+    /// @return The number of emitters.
+    uint32_t size() const { return (uint32_t)positions.size(); }
+};
+
+/**
+ * @brief Updates every emitter's occlusion for this audio tick.
+ * @param occlusion The emitters; only the stale ones are tested.
+ * @param field The terrain; must not change meanwhile.
+ * @param jobs Tests the stale emitters in slices.
+ * @param listener World position of the listener.
+ * @param settings Depth scale and tolerances.
+ * @return The number of emitters tested.
+ */
+uint32_t audio_occlusion_update(AudioOcclusion& occlusion, const HeightField& field, JobSystem& jobs,
+                                simd::float3 listener, const AudioOcclusionSettings& settings);
+
+/// Drops every cached result, e.g. after a terrain edit; the next update tests every emitter.
+void audio_occlusion_invalidate(AudioOcclusion& occlusion);
@@ -0,0 +1,130 @@
+#include "biome.hpp"
+
+#include <algorithm>
+
+#include "noise.hpp"
+
+namespace {
+    // Offsets the moisture noise away from the temperature noise so the two do not line up
+    const float MOISTURE_NOISE_OFFSET_X = -517.0f;
+    const float MOISTURE_NOISE_OFFSET_Z = 269.0f;
+
+    const BiomeProfile PROFILES[BIOME_COUNT] = {
+        // Tundra: pale moss, bare rock, snow from just above the lowlands, hardly a tree
+        { { 0.55f, 0.55f, 0.42f, 1.0f }, { 0.45f, 0.45f, 0.47f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 1.0f, 0.05f, 2.0f },
+        // Taiga: dark needles over grey rock
+        { { 0.2f, 0.38f, 0.22f, 1.0f }, { 0.45f, 0.45f, 0.45f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 3.0f, 1.2f, 1.0f },
+        // Grassland: the height bands the untextured shader draws
+        { { 0.3f, 0.6f, 0.2f, 1.0f }, { 0.5f, 0.5f, 0.5f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 4.0f, 0.3f, 1.0f },
+        // Forest
+        { { 0.22f, 0.5f, 0.15f, 1.0f }, { 0.5f, 0.5f, 0.5f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 4.0f, 1.0f, 0.6f },
+        // Desert: sand and red rock, never snow
+        { { 0.85f, 0.75f, 0.5f, 1.0f }, { 0.7f, 0.5f, 0.35f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 1e4f, 0.0f, 1.5f },
+        // Savanna: dry grass, a few trees
+        { { 0.62f, 0.6f, 0.3f, 1.0f }, { 0.6f, 0.5f, 0.4f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 8.0f, 0.15f, 0.5f },
+        // Jungle: dense green, snow only on the highest peaks
+        { { 0.15f, 0.45f, 0.12f, 1.0f }, { 0.4f, 0.42f, 0.36f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, 8.0f, 1.6f, 0.2f },
+    };
+
+    float climate_noise(uint32_t seed, float x, float z) {
+        const NoiseSettings noise = { seed, NoiseBasis::Value, NoiseInterpolation::Smoothstep, 0.0f, 3, 0.5f };
+        return std::clamp(fractal_noise(x, z, noise) + 0.5f, 0.0f, 1.0f);
+    }
+
+    simd::float4 lerp(simd::float4 a, simd::float4 b, float t) {
+        return a + (b - a) * t;
+    }
+
+    BiomeProfile blend(const BiomeProfile& a, const BiomeProfile& b, float t) {
+        BiomeProfile out;
+        out.ground = lerp(a.ground, b.ground, t);
+        out.rock = lerp(a.rock, b.rock, t);
+        out.snow = lerp(a.snow, b.snow, t);
+        out.snowline = a.snowline + (b.snowline - a.snowline) * t;
+        out.treeDensity = a.treeDensity + (b.treeDensity - a.treeDensity) * t;
+        out.rockDensity = a.rockDensity + (b.rockDensity - a.rockDensity) * t;
+        return out;
+    }
+}
+
+const BiomeProfile* biome_profiles() {
+    return PROFILES;
+}
+
+BiomeClimate biome_climate(const BiomeSettings& settings, float x, float z, float height) {
+    const float s = settings.climateScale;
+    const float warmth = climate_noise(settings.seed, x * s, z * s);
+    const float moisture = climate_noise(settings.seed + 1,
+                                         (x + MOISTURE_NOISE_OFFSET_X) * s, (z + MOISTURE_NOISE_OFFSET_Z) * s);
+    const float chill = settings.lapseRate * std::max(height, 0.0f);
+    return { std::clamp(warmth - chill, 0.0f, 1.0f), moisture };
+}
+
+const char* biome_name(Biome biome) {
+    switch (biome) {
+        case Biome::Tundra: return "tundra";
+        case Biome::Taiga: return "taiga";
+        case Biome::Grassland: return "grassland";
+        case Biome::Forest: return "forest";
+        case Biome::Desert: return "desert";
+        case Biome::Savanna: return "savanna";
+        case Biome::Jungle: return "jungle";
+        default: return "unknown";
+    }
+}
+
+Biome biome_classify(BiomeClimate climate) {
+    if (climate.temperature < 0.25f) {
+        return climate.moisture < 0.5f ? Biome::Tundra : Biome::Taiga;
+    }
+    if (climate.temperature < 0.65f) {
+        return climate.moisture < 0.45f ? Biome::Grassland : Biome::Forest;
+    }
+    if (climate.moisture < 0.3f) {
+        return Biome::Desert;
+    }
+    return climate.moisture < 0.6f ? Biome::Savanna : Biome::Jungle;
+}
+
+BiomeMap generate_biome_map(const BiomeSettings& settings, ChunkKey key, float chunkSize,
+                            const TerrainParams& terrain) {
+    BiomeMap map;
+    map.cellsPerEdge = std::min(settings.cellsPerEdge, BIOME_MAX_CELLS);
+    if (map.cellsPerEdge == 0) {
+        return map;
+    }
+    const uint32_t corners = map.cellsPerEdge + 1;
+    const float step = chunkSize / (float)map.cellsPerEdge;
+    map.ids.resize((size_t)corners * corners);
+    for (uint32_t z = 0; z < corners; ++z) {
+        for (uint32_t x = 0; x < corners; ++x) {
+            // Computed from the world position alone, so a shared edge gets the same IDs in both chunks
+            const float wx = key.x * chunkSize + x * step;
+            const float wz = key.z * chunkSize + z * step;
+            const BiomeClimate climate = biome_climate(settings, wx, wz, get_terrain_height(wx, wz, terrain));
+            map.ids[z * corners + x] = (uint8_t)biome_classify(climate);
+        }
+    }
+    return map;
+}
+
+BiomeProfile biome_profile_at(const BiomeMap& map, float u, float v) {
+    const uint32_t cells = map.cellsPerEdge;
+    const float gx = std::clamp(u, 0.0f, 1.0f) * cells;
+    const float gz = std::clamp(v, 0.0f, 1.0f) * cells;
+    const uint32_t x = std::min((uint32_t)gx, cells - 1);
+    const uint32_t z = std::min((uint32_t)gz, cells - 1);
+    const float fx = gx - x;
+    const float fz = gz - z;
+    const BiomeProfile* profiles = biome_profiles();
+    const BiomeProfile row0 = blend(profiles[(int)map.at(x, z)], profiles[(int)map.at(x + 1, z)], fx);
+    const BiomeProfile row1 = blend(profiles[(int)map.at(x, z + 1)], profiles[(int)map.at(x + 1, z + 1)], fx);
+    return blend(row0, row1, fz);
+}
+
+simd::float3 biome_band_albedo(const BiomeProfile& profile, float height) {
+    const simd::float4 sloped = lerp(profile.ground, profile.rock, std::clamp(height / 4.0f, 0.0f, 1.0f));
+    const float snow = std::clamp((height - profile.snowline) / 4.0f, 0.0f, 1.0f);
+    const simd::float4 albedo = lerp(sloped, profile.snow, snow);
+    return { albedo.x, albedo.y, albedo.z };
+}
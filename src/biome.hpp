@@ -0,0 +1,144 @@
+/**
+ * @file biome.hpp
+ * @brief Biomes picked from a low-resolution climate, and what each one shades and grows.
+ *
+ * Two noise fields over the world give a temperature and a moisture; the temperature also
+ * falls with the height of the terrain, so peaks turn to tundra. Each (temperature,
+ * moisture) pair falls into one cell of a Whittaker-style table that names the biome. A
+ * chunk keeps its biomes as a BiomeMap of 8-bit IDs at the corners of a coarse grid of biome
+ * cells, one byte each, built on the chunk's generation job. The corners on a chunk edge
+ * are the same world positions as its neighbour's, so anything blended between the four
+ * corners around a point, i.e. the baked terrain colours and the foliage densities of
+ * BiomeProfile, is continuous across chunks.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "landscape.hpp"
+
+/**
+ * @enum Biome
+ * @brief The biome of a climate; indexes biome_profiles().
+ */
+enum class Biome : uint8_t {
+    Tundra = 0,
+    Taiga = 1,
+    Grassland = 2,
+    Forest = 3,
+    Desert = 4,
+    Savanna = 5,
+    Jungle = 6,
+};
+
+/// Number of Biome values.
+constexpr uint32_t BIOME_COUNT = 7;
+
+/// @return The lowercase name of a biome.
+const char* biome_name(Biome biome);
+
+/// Most biome cells along a chunk edge; a map's IDs then fit the 4 KB setBytes limit.
+constexpr uint32_t BIOME_MAX_CELLS = 32;
+
+/**
+ * @struct BiomeSettings
+ * @brief Tunables of the climate.
+ */
+struct BiomeSettings {
+    uint32_t cellsPerEdge = 0;      ///< Biome cells along each chunk edge; 0 turns biomes off.
+    uint32_t seed = 4242;           ///< Changes every climate.
+    float climateScale = 0.004f;    ///< Frequency of the temperature and moisture noise.
+    float lapseRate = 0.03f;        ///< Temperature lost per world unit of terrain height above 0.
+};
+
+/**
+ * @struct BiomeClimate
+ * @brief The climate at a point.
+ */
+struct BiomeClimate {
+    float temperature;  ///< 0 freezing, 1 hot.
+    float moisture;     ///< 0 arid, 1 wet.
+};
+
+/**
+ * @struct BiomeProfile
+ * @brief How a biome is shaded and what grows in it; matches BiomeProfile in shaders.metal.
+ *
+ * The colours replace the fixed grass, rock and snow height bands: ground below height 0,
+ * rock at 4, and snow from snowline up over 4 world units.
+ */
+struct BiomeProfile {
+    simd::float4 ground;    ///< rgb: colour of the low ground.
+    simd::float4 rock;      ///< rgb: colour of the slopes at height 4.
+    simd::float4 snow;      ///< rgb: colour of the peaks.
+    float snowline;         ///< Height snow starts to cover the rock.
+    float treeDensity;      ///< Scales FoliageSettings::treeDensity.
+    float rockDensity;      ///< Scales FoliageSettings::rockDensity.
+    float padding = 0.0f;
+};
+
+/// @return The profile of every biome, indexed by Biome; BIOME_COUNT entries.
+const BiomeProfile* biome_profiles();
+
+/**
+ * @brief Returns the climate at a world position.
+ * @param settings The climate's tunables.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @param height The terrain height there.
+ * @return Temperature and moisture, each in [0, 1].
+ */
+BiomeClimate biome_climate(const BiomeSettings& settings, float x, float z, float height);
+
+/// @return The biome of a climate.
+Biome biome_classify(BiomeClimate climate);
+
+/**
+ * @struct BiomeMap
+ * @brief A chunk's biome IDs at the corners of its biome cells, row-major by z.
+ */
+struct BiomeMap {
+    uint32_t cellsPerEdge = 0;  ///< Biome cells along each chunk edge; 0 for a chunk without biomes.
+    std::vector<uint8_t> ids;   ///< (cellsPerEdge + 1)^2 Biome values.
+
+    /// @return True if the chunk has biomes.
+    bool empty() const { return ids.empty(); }
+
+    /// @return The biome at corner (x, z).
+    Biome at(uint32_t x, uint32_t z) const { return (Biome)ids[z * (cellsPerEdge + 1) + x]; }
+
+    /// @return CPU bytes of the IDs.
+    size_t bytes() const { return ids.capacity(); }
+};
+
+/**
+ * @brief Picks the biomes of a chunk.
+ * @param settings The climate's tunables; cellsPerEdge is clamped to BIOME_MAX_CELLS.
+ * @param key The chunk.
+ * @param chunkSize The chunk edge length in world units.
+ * @param terrain The terrain generator's tunables, for the heights the temperature falls with.
+ * @return The map; empty if settings.cellsPerEdge is 0.
+ */
+BiomeMap generate_biome_map(const BiomeSettings& settings, ChunkKey key, float chunkSize,
+                            const TerrainParams& terrain = {});
+
+/**
+ * @brief Blends the profiles of the four corners around a point of a chunk.
+ * @param map The chunk's biomes; not empty.
+ * @param u The point's x inside the chunk, 0 on its -x edge and 1 on its +x edge.
+ * @param v The point's z inside the chunk, likewise.
+ * @return The bilinear blend of the four corner profiles.
+ */
+BiomeProfile biome_profile_at(const BiomeMap& map, float u, float v);
+
+/**
+ * @brief Returns the colour the baked terrain materials give a height; the shaders' biome_band_albedo.
+ * @param profile The profile at the point, e.g. from biome_profile_at().
+ * @param height The world height.
+ * @return The albedo.
+ */
+simd::float3 biome_band_albedo(const BiomeProfile& profile, float height);
@@ -0,0 +1,80 @@
+#include "build_trace.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+    // Finds a report's costs by name while a profile is added
+    struct CostIndex {
+        std::vector<BuildTraceCost>& costs;
+        std::unordered_map<std::string, size_t> indices;
+
+        explicit CostIndex(std::vector<BuildTraceCost>& target) : costs(target) {
+            for (size_t i = 0; i < costs.size(); ++i) {
+                indices.emplace(costs[i].name, i);
+            }
+        }
+
+        void add(const std::string& name, double ms) {
+            const auto [found, inserted] = indices.emplace(name, costs.size());
+            if (inserted) {
+                costs.push_back({ name, 0.0, 0 });
+            }
+            BuildTraceCost& cost = costs[found->second];
+            cost.ms += ms;
+            cost.count++;
+        }
+    };
+
+    void sort_costs(std::vector<BuildTraceCost>& costs) {
+        std::stable_sort(costs.begin(), costs.end(),
+                         [](const BuildTraceCost& a, const BuildTraceCost& b) { return a.ms > b.ms; });
+    }
+}
+
+bool add_build_trace(const JsonValue& trace, const std::string& name, BuildTraceReport& report, std::string& error) {
+    const JsonValue* events = trace.find("traceEvents");
+    if (!events || events->type != JsonValue::ARRAY) {
+        error = "no traceEvents array";
+        return false;
+    }
+    CostIndex headers(report.headers);
+    CostIndex templates(report.templates);
+
+    BuildTraceUnit unit;
+    unit.name = name;
+    for (const JsonValue& event : events->array) {
+        const JsonValue* kind = event.find("name");
+        const JsonValue* duration = event.find("dur");
+        const JsonValue* phase = event.find("ph");
+        // Complete events only; the "Total ..." summaries at the end are complete events too, so skip those
+        if (!kind || kind->type != JsonValue::STRING || !duration || duration->type != JsonValue::NUMBER ||
+            !phase || phase->string != "X" || kind->string.compare(0, 6, "Total ") == 0) {
+            continue;
+        }
+        const double ms = duration->number / 1000.0;
+        const JsonValue* args = event.find("args");
+        const JsonValue* detail = args ? args->find("detail") : nullptr;
+        if (kind->string == "ExecuteCompiler") {
+            unit.totalMs += ms;
+        } else if (kind->string == "Frontend") {
+            unit.frontendMs += ms;
+        } else if (kind->string == "Backend") {
+            unit.backendMs += ms;
+        } else if (kind->string == "Source" && detail) {
+            headers.add(detail->string, ms);
+        } else if ((kind->string == "InstantiateClass" || kind->string == "InstantiateFunction") && detail) {
+            templates.add(detail->string, ms);
+        }
+    }
+    report.totalMs += unit.totalMs;
+    report.units.push_back(std::move(unit));
+    return true;
+}
+
+void finish_build_trace(BuildTraceReport& report) {
+    std::stable_sort(report.units.begin(), report.units.end(),
+                     [](const BuildTraceUnit& a, const BuildTraceUnit& b) { return a.totalMs > b.totalMs; });
+    sort_costs(report.headers);
+    sort_costs(report.templates);
+}
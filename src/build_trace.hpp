@@ -0,0 +1,63 @@
+/**
+ * @file build_trace.hpp
+ * @brief Sums clang -ftime-trace compile profiles into the sources, headers and templates that cost the most.
+ *
+ * Each profile is a Chrome trace of one translation unit. Its "ExecuteCompiler", "Frontend" and
+ * "Backend" events give the unit's compile time and how it splits between parsing and code
+ * generation; every "Source" event is one inclusion of a header, timed including the headers it
+ * includes in turn, and "InstantiateClass" and "InstantiateFunction" events are template
+ * instantiations. Headers and templates are summed over all units, so a header parsed by fifty
+ * sources shows its whole cost, the number a precompiled header or a removed include saves.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+/**
+ * @struct BuildTraceUnit
+ * @brief The compile time of one translation unit.
+ */
+struct BuildTraceUnit {
+    std::string name;           ///< What the profile was loaded as, usually its path.
+    double totalMs = 0.0;       ///< The whole compile.
+    double frontendMs = 0.0;    ///< Preprocessing, parsing and semantic analysis.
+    double backendMs = 0.0;     ///< Optimization and code generation.
+};
+
+/**
+ * @struct BuildTraceCost
+ * @brief The summed cost of one header or template over every unit.
+ */
+struct BuildTraceCost {
+    std::string name;           ///< Header path or template signature.
+    double ms = 0.0;            ///< Summed time, inclusive of nested headers or instantiations.
+    uint32_t count = 0;         ///< How often it was included or instantiated.
+};
+
+/**
+ * @struct BuildTraceReport
+ * @brief The profiles of a build, summed.
+ */
+struct BuildTraceReport {
+    std::vector<BuildTraceUnit> units;          ///< One per profile, slowest first after finish_build_trace().
+    std::vector<BuildTraceCost> headers;        ///< Most expensive first after finish_build_trace().
+    std::vector<BuildTraceCost> templates;      ///< Most expensive first after finish_build_trace().
+    double totalMs = 0.0;                       ///< Sum of the units' compile times.
+};
+
+/**
+ * @brief Adds one -ftime-trace profile to a report.
+ * @param trace The parsed profile.
+ * @param name The name the unit is listed under.
+ * @param report The report to add to.
+ * @param error Receives a description of the problem on failure.
+ * @return False if the document is not a time trace.
+ */
+bool add_build_trace(const JsonValue& trace, const std::string& name, BuildTraceReport& report, std::string& error);
+
+/// Sorts the units, headers and templates of a report by cost, most expensive first.
+void finish_build_trace(BuildTraceReport& report);
@@ -0,0 +1,321 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    float surface_area(const BoundingBox& box) {
+        simd::float3 d = box.max - box.min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool contains(const BoundingBox& outer, const BoundingBox& inner) {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+               inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+    }
+
+    bool overlaps(const BoundingBox& a, const BoundingBox& b) {
+        return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+               a.min.z <= b.max.z && b.min.z <= a.max.z;
+    }
+
+    bool same_box(const BoundingBox& a, const BoundingBox& b) {
+        return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+               a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+    }
+
+    BoundingBox fatten(const BoundingBox& box, float margin) {
+        return { box.min - margin, box.max + margin };
+    }
+
+    // -1 outside a plane, 1 inside all of them, 0 straddling
+    int classify(const Frustum& frustum, const BoundingBox& box) {
+        simd::float3 center = (box.min + box.max) * 0.5f;
+        simd::float3 extent = (box.max - box.min) * 0.5f;
+        int result = 1;
+        for (const simd::float4& plane : frustum.planes) {
+            float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+            float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+            if (distance < -radius) {
+                return -1;
+            }
+            if (distance < radius) {
+                result = 0;
+            }
+        }
+        return result;
+    }
+
+    uint32_t allocate_node(Bvh& bvh) {
+        if (bvh.freeList == BVH_NULL) {
+            bvh.nodes.emplace_back();
+            return (uint32_t)bvh.nodes.size() - 1;
+        }
+        uint32_t node = bvh.freeList;
+        bvh.freeList = bvh.nodes[node].parent;
+        bvh.nodes[node] = BvhNode{};
+        return node;
+    }
+
+    void free_node(Bvh& bvh, uint32_t node) {
+        bvh.nodes[node].parent = bvh.freeList;
+        bvh.nodes[node].height = -1;
+        bvh.freeList = node;
+    }
+
+    // Rotates the taller child of a up if a's children differ in height by more than one
+    uint32_t balance(Bvh& bvh, uint32_t a) {
+        BvhNode& A = bvh.nodes[a];
+        if (A.left == BVH_NULL || A.height < 2) {
+            return a;
+        }
+        const uint32_t b = A.left;
+        const uint32_t c = A.right;
+        const int32_t difference = bvh.nodes[c].height - bvh.nodes[b].height;
+        if (difference >= -1 && difference <= 1) {
+            return a;
+        }
+
+        // Promote the taller child "up" of a, moving a down on the other side
+        const uint32_t up = difference > 1 ? c : b;
+        BvhNode& U = bvh.nodes[up];
+        const uint32_t f = U.left;
+        const uint32_t g = U.right;
+
+        U.left = a;
+        U.parent = A.parent;
+        A.parent = up;
+        if (U.parent != BVH_NULL) {
+            BvhNode& P = bvh.nodes[U.parent];
+            (P.left == a ? P.left : P.right) = up;
+        } else {
+            bvh.root = up;
+        }
+
+        // The taller grandchild stays under up; the shorter one replaces up under a
+        const bool keepF = bvh.nodes[f].height > bvh.nodes[g].height;
+        const uint32_t kept = keepF ? f : g;
+        const uint32_t moved = keepF ? g : f;
+        U.right = kept;
+        (difference > 1 ? A.right : A.left) = moved;
+        bvh.nodes[moved].parent = a;
+
+        A.box = merge_bounds(bvh.nodes[A.left].box, bvh.nodes[A.right].box);
+        A.height = 1 + std::max(bvh.nodes[A.left].height, bvh.nodes[A.right].height);
+        U.box = merge_bounds(A.box, bvh.nodes[kept].box);
+        U.height = 1 + std::max(A.height, bvh.nodes[kept].height);
+        return up;
+    }
+
+    // Refits and rebalances every ancestor of a node, up to the root
+    void fix_upwards(Bvh& bvh, uint32_t node) {
+        while (node != BVH_NULL) {
+            node = balance(bvh, node);
+            BvhNode& N = bvh.nodes[node];
+            const BvhNode& l = bvh.nodes[N.left];
+            const BvhNode& r = bvh.nodes[N.right];
+            N.height = 1 + std::max(l.height, r.height);
+            N.box = merge_bounds(l.box, r.box);
+            node = N.parent;
+        }
+    }
+
+    void insert_leaf(Bvh& bvh, uint32_t leaf) {
+        if (bvh.root == BVH_NULL) {
+            bvh.root = leaf;
+            bvh.nodes[leaf].parent = BVH_NULL;
+            return;
+        }
+
+        // Descend towards the sibling whose merge adds the least surface area
+        const BoundingBox box = bvh.nodes[leaf].box;
+        uint32_t index = bvh.root;
+        while (bvh.nodes[index].left != BVH_NULL) {
+            const BvhNode& node = bvh.nodes[index];
+            const float area = surface_area(node.box);
+            const float combined = surface_area(merge_bounds(node.box, box));
+            const float cost = 2.0f * combined;            // Pair with this node
+            const float inheritance = 2.0f * (combined - area); // Growth every descendant pays
+
+            float childCost[2];
+            const uint32_t children[2] = { node.left, node.right };
+            for (int i = 0; i < 2; ++i) {
+                const BvhNode& child = bvh.nodes[children[i]];
+                const float merged = surface_area(merge_bounds(child.box, box));
+                childCost[i] = child.left == BVH_NULL ? merged + inheritance
+                                                      : merged - surface_area(child.box) + inheritance;
+            }
+            if (cost < childCost[0] && cost < childCost[1]) {
+                break;
+            }
+            index = childCost[0] < childCost[1] ? node.left : node.right;
+        }
+
+        const uint32_t sibling = index;
+        const uint32_t oldParent = bvh.nodes[sibling].parent;
+        const uint32_t newParent = allocate_node(bvh);
+        BvhNode& P = bvh.nodes[newParent];
+        P.parent = oldParent;
+        P.box = merge_bounds(box, bvh.nodes[sibling].box);
+        P.height = bvh.nodes[sibling].height + 1;
+        P.left = sibling;
+        P.right = leaf;
+        bvh.nodes[sibling].parent = newParent;
+        bvh.nodes[leaf].parent = newParent;
+
+        if (oldParent != BVH_NULL) {
+            BvhNode& O = bvh.nodes[oldParent];
+            (O.left == sibling ? O.left : O.right) = newParent;
+        } else {
+            bvh.root = newParent;
+        }
+        fix_upwards(bvh, oldParent);
+    }
+
+    void remove_leaf(Bvh& bvh, uint32_t leaf) {
+        if (leaf == bvh.root) {
+            bvh.root = BVH_NULL;
+            return;
+        }
+
+        // The sibling takes the parent's place
+        const uint32_t parent = bvh.nodes[leaf].parent;
+        const uint32_t grandParent = bvh.nodes[parent].parent;
+        const uint32_t sibling = bvh.nodes[parent].left == leaf ? bvh.nodes[parent].right : bvh.nodes[parent].left;
+        bvh.nodes[sibling].parent = grandParent;
+        if (grandParent != BVH_NULL) {
+            BvhNode& G = bvh.nodes[grandParent];
+            (G.left == parent ? G.left : G.right) = sibling;
+        } else {
+            bvh.root = sibling;
+        }
+        free_node(bvh, parent);
+        fix_upwards(bvh, grandParent);
+    }
+}
+
+void bvh_reserve(Bvh& bvh, size_t items) {
+    // n leaves need n - 1 internal nodes
+    bvh.nodes.reserve(items ? 2 * items - 1 : 0);
+    bvh.refitQueue.reserve(items);
+}
+
+uint32_t bvh_insert(Bvh& bvh, const BoundingBox& box, uint32_t item) {
+    const uint32_t leaf = allocate_node(bvh);
+    BvhNode& node = bvh.nodes[leaf];
+    node.box = fatten(box, bvh.margin);
+    node.item = item;
+    node.height = 0;
+    insert_leaf(bvh, leaf);
+    bvh.leafCount++;
+    return leaf;
+}
+
+void bvh_remove(Bvh& bvh, uint32_t leaf) {
+    remove_leaf(bvh, leaf);
+    free_node(bvh, leaf);
+    bvh.leafCount--;
+}
+
+bool bvh_update(Bvh& bvh, uint32_t leaf, const BoundingBox& box) {
+    if (contains(bvh.nodes[leaf].box, box)) {
+        return false;
+    }
+    remove_leaf(bvh, leaf);
+    bvh.nodes[leaf].box = fatten(box, bvh.margin);
+    insert_leaf(bvh, leaf);
+    return true;
+}
+
+void bvh_move(Bvh& bvh, uint32_t leaf, const BoundingBox& box) {
+    if (contains(bvh.nodes[leaf].box, box)) {
+        return;
+    }
+    bvh.nodes[leaf].box = fatten(box, bvh.margin);
+    bvh.refitQueue.push_back(leaf);
+}
+
+size_t bvh_refit(Bvh& bvh) {
+    // Each walk stops where a box comes out unchanged, so shared ancestors are not redone for every leaf
+    size_t changed = 0;
+    for (uint32_t leaf : bvh.refitQueue) {
+        if (bvh.nodes[leaf].height != 0) {
+            continue; // Removed since it was queued
+        }
+        for (uint32_t node = bvh.nodes[leaf].parent; node != BVH_NULL; node = bvh.nodes[node].parent) {
+            BvhNode& N = bvh.nodes[node];
+            const BoundingBox box = merge_bounds(bvh.nodes[N.left].box, bvh.nodes[N.right].box);
+            if (same_box(box, N.box)) {
+                break;
+            }
+            N.box = box;
+            ++changed;
+        }
+    }
+    bvh.refitQueue.clear();
+    return changed;
+}
+
+void bvh_query_frustum(const Bvh& bvh, const Frustum& frustum, std::vector<uint32_t>& items) {
+    items.clear();
+    if (bvh.root == BVH_NULL) {
+        return;
+    }
+
+    // The sign bit of a stack entry marks a subtree already known to be inside
+    constexpr uint32_t INSIDE = 0x80000000u;
+    uint32_t stack[128];
+    int top = 0;
+    stack[top++] = bvh.root;
+    while (top > 0) {
+        const uint32_t entry = stack[--top];
+        const BvhNode& node = bvh.nodes[entry & ~INSIDE];
+        uint32_t inside = entry & INSIDE;
+        if (!inside) {
+            int side = classify(frustum, node.box);
+            if (side < 0) {
+                continue;
+            }
+            inside = side > 0 ? INSIDE : 0;
+        }
+        if (node.left == BVH_NULL) {
+            items.push_back(node.item);
+        } else {
+            stack[top++] = node.right | inside;
+            stack[top++] = node.left | inside;
+        }
+    }
+}
+
+void bvh_query_box(const Bvh& bvh, const BoundingBox& box, std::vector<uint32_t>& items) {
+    items.clear();
+    if (bvh.root == BVH_NULL) {
+        return;
+    }
+    uint32_t stack[128];
+    int top = 0;
+    stack[top++] = bvh.root;
+    while (top > 0) {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (!overlaps(node.box, box)) {
+            continue;
+        }
+        if (node.left == BVH_NULL) {
+            items.push_back(node.item);
+        } else {
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        }
+    }
+}
+
+float ray_box_distance(const BoundingBox& box, simd::float3 origin, simd::float3 inverseDirection, float maxDistance) {
+    // Slab test: the ray is inside the box between the last slab entry and the first slab exit
+    simd::float3 t0 = (box.min - origin) * inverseDirection;
+    simd::float3 t1 = (box.max - origin) * inverseDirection;
+    simd::float3 tmin = simd::min(t0, t1);
+    simd::float3 tmax = simd::max(t0, t1);
+    float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+    float exit = std::min(std::min(tmax.x, tmax.y), std::min(tmax.z, maxDistance));
+    return enter <= exit ? enter : -1.0f;
+}
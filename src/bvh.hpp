@@ -0,0 +1,186 @@
+/**
+ * @file bvh.hpp
+ * @brief Dynamic bounding volume hierarchy over axis-aligned boxes.
+ *
+ * Leaves keep a box enlarged by a margin, so an object that moves a little stays
+ * inside its leaf and costs nothing. New leaves are placed next to the sibling that
+ * grows the tree's total surface area least, and AVL-style rotations keep the height
+ * logarithmic. Objects that move further are handled in two steps: their leaves are
+ * widened first, and then bvh_refit() updates every affected ancestor in one pass.
+ * Leaf indices are stable for the lifetime of a leaf, so callers can keep them as
+ * handles.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "frustum.hpp"
+#include "objects.hpp"
+
+/// Index of no node.
+constexpr uint32_t BVH_NULL = UINT32_MAX;
+
+/**
+ * @struct BvhNode
+ * @brief A leaf holding one item, or an internal node with two children.
+ */
+struct BvhNode {
+    BoundingBox box;                ///< Leaves: the item's box plus the margin. Internal nodes: both children.
+    uint32_t parent = BVH_NULL;     ///< Parent node; also links the free list.
+    uint32_t left = BVH_NULL;       ///< First child, or BVH_NULL for a leaf.
+    uint32_t right = BVH_NULL;      ///< Second child.
+    uint32_t item = 0;              ///< Caller's identifier of a leaf.
+    int32_t height = 0;             ///< 0 for leaves, -1 for free nodes.
+};
+
+/**
+ * @struct Bvh
+ * @brief Node pool and root of the hierarchy.
+ */
+struct Bvh {
+    std::vector<BvhNode> nodes;             ///< Node pool; free nodes are chained through parent.
+    uint32_t root = BVH_NULL;               ///< Root node.
+    uint32_t freeList = BVH_NULL;           ///< First free node.
+    uint32_t leafCount = 0;                 ///< Number of items.
+    float margin = 0.2f;                    ///< Distance leaves are enlarged by on every side.
+    std::vector<uint32_t> refitQueue;       ///< Leaves widened since the last bvh_refit().
+};
+
+/**
+ * @brief Reserves nodes for a number of items so inserting up to it does not reallocate.
+ * @param bvh The hierarchy.
+ * @param items The item count to make room for.
+ */
+void bvh_reserve(Bvh& bvh, size_t items);
+
+/**
+ * @brief Adds an item.
+ * @param bvh The hierarchy.
+ * @param box The item's bounds.
+ * @param item The identifier queries report.
+ * @return The leaf, which stays valid until bvh_remove().
+ */
+uint32_t bvh_insert(Bvh& bvh, const BoundingBox& box, uint32_t item);
+
+/**
+ * @brief Removes an item.
+ * @param bvh The hierarchy.
+ * @param leaf The leaf returned by bvh_insert().
+ */
+void bvh_remove(Bvh& bvh, uint32_t leaf);
+
+/**
+ * @brief Moves an item right away, reinserting its leaf if the box left the enlarged one.
+ * @param bvh The hierarchy.
+ * @param leaf The item's leaf.
+ * @param box The item's new bounds.
+ * @return True if the leaf was reinserted.
+ */
+bool bvh_update(Bvh& bvh, uint32_t leaf, const BoundingBox& box);
+
+/**
+ * @brief Widens a leaf to a new box without restructuring; bvh_refit() then fixes its ancestors.
+ *
+ * Meant for many objects moving at once, such as after a transform update: the ancestors
+ * shared by the moved leaves are refit once instead of the tree changing shape per leaf.
+ *
+ * @param bvh The hierarchy.
+ * @param leaf The item's leaf.
+ * @param box The item's new bounds.
+ */
+void bvh_move(Bvh& bvh, uint32_t leaf, const BoundingBox& box);
+
+/**
+ * @brief Recomputes the boxes of every ancestor of the leaves moved since the last call.
+ * @param bvh The hierarchy.
+ * @return The number of internal nodes whose box changed.
+ */
+size_t bvh_refit(Bvh& bvh);
+
+/**
+ * @brief Collects the items whose leaves may be inside a frustum.
+ *
+ * Subtrees entirely inside the frustum are collected without further plane tests.
+ *
+ * @param bvh The hierarchy.
+ * @param frustum The frustum.
+ * @param items Receives the items; cleared first.
+ */
+void bvh_query_frustum(const Bvh& bvh, const Frustum& frustum, std::vector<uint32_t>& items);
+
+/**
+ * @brief Collects the items whose leaves overlap a box.
+ * @param bvh The hierarchy.
+ * @param box The query box.
+ * @param items Receives the items; cleared first.
+ */
+void bvh_query_box(const Bvh& bvh, const BoundingBox& box, std::vector<uint32_t>& items);
+
+/**
+ * @brief Returns the distance along a ray at which it enters a box.
+ * @param box The box.
+ * @param origin The ray origin.
+ * @param inverseDirection 1 / direction, per component.
+ * @param maxDistance The end of the ray.
+ * @return The entry distance, 0 if the origin is inside, or a negative value for a miss.
+ */
+float ray_box_distance(const BoundingBox& box, simd::float3 origin, simd::float3 inverseDirection, float maxDistance);
+
+/**
+ * @brief Finds the closest item hit by a ray, visiting nearer subtrees first.
+ *
+ * Leaves are only candidates: hit(item, maxDistance) makes the exact test and returns the hit
+ * distance, or a negative value for a miss. Subtrees beyond the closest hit so far are skipped.
+ *
+ * @param bvh The hierarchy.
+ * @param origin The ray origin.
+ * @param direction The ray direction; need not be normalized, distances are in its units.
+ * @param maxDistance The end of the ray.
+ * @param hit The exact test.
+ * @param distance Receives the distance of the closest hit.
+ * @return The item hit, or BVH_NULL.
+ */
+template <typename HitFn>
+uint32_t bvh_raycast(const Bvh& bvh, simd::float3 origin, simd::float3 direction, float maxDistance, HitFn hit,
+                     float& distance) {
+    if (bvh.root == BVH_NULL) {
+        return BVH_NULL;
+    }
+    const simd::float3 inverse = 1.0f / direction;
+    uint32_t closest = BVH_NULL;
+    distance = maxDistance;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = bvh.root;
+    while (top > 0) {
+        const BvhNode& node = bvh.nodes[stack[--top]];
+        if (node.left == BVH_NULL) {
+            float t = hit(node.item, distance);
+            if (t >= 0.0f && t < distance) {
+                distance = t;
+                closest = node.item;
+            }
+            continue;
+        }
+        // Push the farther child first so the nearer one is popped next
+        float tl = ray_box_distance(bvh.nodes[node.left].box, origin, inverse, distance);
+        float tr = ray_box_distance(bvh.nodes[node.right].box, origin, inverse, distance);
+        uint32_t nearChild = node.left, farChild = node.right;
+        if (tr >= 0.0f && (tl < 0.0f || tr < tl)) {
+            std::swap(nearChild, farChild);
+            std::swap(tl, tr);
+        }
+        if (tr >= 0.0f) {
+            stack[top++] = farChild;
+        }
+        if (tl >= 0.0f) {
+            stack[top++] = nearChild;
+        }
+    }
+    return closest;
+}
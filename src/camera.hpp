@@ -7,6 +7,8 @@
 #include <simd/simd.h>
 #include <cmath>
 
+#include "approx_math.hpp"
+
 // --- Matrix utilities ---
 
 /**
@@ -19,6 +21,32 @@
  */
 simd::float4x4 matrix_perspective_right_hand(float fovyRadians, float aspect, float nearZ, float farZ);
 
+/**
+ * @brief Creates a right-handed reverse-Z perspective projection with the far plane at infinity.
+ *
+ * View depth nearZ maps to depth 1 and infinity to 0. Float depth is densest near 0, which
+ * offsets the 1/z falloff of perspective, so precision stays roughly even at any distance.
+ * Draw with a Greater depth test and clear depth to 0.
+ *
+ * @param fovyRadians The field of view in radians.
+ * @param aspect The aspect ratio.
+ * @param nearZ The near clipping plane.
+ * @return The projection matrix.
+ */
+simd::float4x4 matrix_perspective_reverse_z_infinite(float fovyRadians, float aspect, float nearZ);
+
+/**
+ * @brief Creates a right-handed orthographic projection matrix mapping view depth [nearZ, farZ] to [0, 1].
+ * @param left The view x mapped to -1.
+ * @param right The view x mapped to 1.
+ * @param bottom The view y mapped to -1.
+ * @param top The view y mapped to 1.
+ * @param nearZ The near clipping plane.
+ * @param farZ The far clipping plane.
+ * @return The projection matrix.
+ */
+simd::float4x4 matrix_orthographic_right_hand(float left, float right, float bottom, float top, float nearZ, float farZ);
+
 /**
  * @brief Creates a right-handed look-at view matrix.
  * @param eye The position of the camera.
@@ -53,6 +81,17 @@ simd::float4x4 matrix_rotation_y(float angleRadians);
  */
 simd::float4x4 matrix_scale(float sx, float sy, float sz);
 
+/**
+ * @brief Creates the matrix that carries normals through a model transform.
+ *
+ * The inverse transpose of the upper 3x3, so normals stay perpendicular to their surface
+ * under non-uniform scale, where transforming them by the model matrix would tilt them.
+ *
+ * @param model The model matrix; its upper 3x3 must be invertible.
+ * @return The 3x3 normal matrix.
+ */
+simd::float3x3 matrix_normal(const simd::float4x4& model);
+
 
 
 /**
@@ -67,58 +106,147 @@ struct Camera {
     float moveSpeed = 8.0f;     ///< The movement speed of the camera.
     float lookSpeed = 0.005f;   ///< The look sensitivity of the camera.
 
+    // Unbounded by default: streaming decides what exists around the camera; see set_camera_world()
+    simd::float3 minBounds = { -INFINITY, -INFINITY, -INFINITY }; ///< Lowest position update_camera() allows.
+    simd::float3 maxBounds = { INFINITY, INFINITY, INFINITY };    ///< Highest position update_camera() allows.
+
+    float nearZ = 0.1f;         ///< The near clipping plane.
+    float farZ = 100.0f;        ///< The far clipping plane; unused with reverseZ, whose far plane is at infinity.
+    bool reverseZ = false;      ///< Projects with matrix_perspective_reverse_z_infinite() instead of a finite far plane.
+
     simd::float4x4 viewMatrix;  ///< The view matrix.
     simd::float4x4 projectionMatrix; ///< The projection matrix.
+
+    // Derived from yaw and pitch by update_camera_basis(), which skips the trigonometry when neither changed
+    float basisYaw = NAN;       ///< Yaw forward and right were computed for; NaN until the first update.
+    float basisPitch = NAN;     ///< Pitch forward and right were computed for.
+    simd::float3 forward;       ///< Unit view direction, camera_forward(basisYaw, basisPitch).
+    simd::float3 right;         ///< Unit right vector, horizontal.
 };
 
+/**
+ * @brief Rebuilds the projection for a viewport aspect ratio from the camera's depth settings.
+ * @param cam The camera to update.
+ * @param aspect The viewport width divided by its height.
+ */
+inline void update_camera_projection(Camera& cam, float aspect) {
+    cam.projectionMatrix = cam.reverseZ ? matrix_perspective_reverse_z_infinite(M_PI / 3.0f, aspect, cam.nearZ)
+                                        : matrix_perspective_right_hand(M_PI / 3.0f, aspect, cam.nearZ, cam.farZ);
+}
+
+/// @return The depth the depth buffer is cleared to: the far plane, 0 with reverse-Z and 1 otherwise.
+inline float camera_clear_depth(const Camera& cam) {
+    return cam.reverseZ ? 0.0f : 1.0f;
+}
+
 /**
  * @brief Creates a new Camera instance.
  * @param width The width of the viewport.
  * @param height The height of the viewport.
+ * @param reverseZ True for a reverse-Z projection with the far plane at infinity.
  * @return A new Camera instance.
  */
-inline Camera make_camera(int width, int height) {
+inline Camera make_camera(int width, int height, bool reverseZ = false) {
     Camera cam{};
     cam.position = {0.0f, 0.0f, 3.0f};
-    cam.projectionMatrix = matrix_perspective_right_hand(M_PI / 3.0f, (float)width / (float)height, 0.1f, 100.0f);
+    cam.reverseZ = reverseZ;
+    update_camera_projection(cam, (float)width / (float)height);
     return cam;
 }
 
+/**
+ * @brief Fits a camera to the world it moves through.
+ *
+ * The horizontal position is left unbounded, since the world streams in around the camera,
+ * and the projection is rebuilt for the new far plane at the current aspect ratio.
+ *
+ * @param cam The camera to update.
+ * @param viewDistance Distance to the far plane; where the streamed world ends.
+ * @param minHeight Lowest height the camera may move to.
+ * @param maxHeight Highest height the camera may move to.
+ * @param moveSpeed Movement speed in world units per second.
+ */
+inline void set_camera_world(Camera& cam, float viewDistance, float minHeight, float maxHeight, float moveSpeed) {
+    cam.farZ = viewDistance;
+    cam.minBounds = { -INFINITY, minHeight, -INFINITY };
+    cam.maxBounds = { INFINITY, maxHeight, INFINITY };
+    cam.moveSpeed = moveSpeed;
+    update_camera_projection(cam, cam.projectionMatrix.columns[1][1] / cam.projectionMatrix.columns[0][0]);
+}
+
+/**
+ * @brief Rebuilds the projection for a new viewport size, keeping the vertical field of view.
+ * @param cam The camera to update.
+ * @param width The width of the viewport; ignored with height if either is zero.
+ * @param height The height of the viewport.
+ */
+inline void set_camera_viewport(Camera& cam, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    update_camera_projection(cam, (float)width / (float)height);
+}
+
+/// @return The unit view direction for a yaw and pitch in radians; yaw 0 looks down -Z.
+inline simd::float3 camera_forward(float yaw, float pitch) {
+    // Renormalised below, so the polynomial trig's error only tilts the basis by about 1e-7 radians
+    float sin_yaw, cos_yaw, sin_pitch, cos_pitch;
+    approx_sincos(yaw, sin_yaw, cos_yaw);
+    approx_sincos(pitch, sin_pitch, cos_pitch);
+    return simd::normalize(simd::float3{ sin_yaw * cos_pitch, sin_pitch, -cos_yaw * cos_pitch });
+}
+
+/**
+ * @brief Brings the camera's forward and right vectors up to date with its yaw and pitch.
+ *
+ * The vectors are cached in the camera itself, not in function statics, so any number of
+ * cameras can be updated on any threads; they are recomputed only when yaw or pitch differ
+ * from the values they were computed for, which also catches angles assigned directly.
+ *
+ * @param cam The camera to update.
+ */
+inline void update_camera_basis(Camera& cam) {
+    if (cam.yaw == cam.basisYaw && cam.pitch == cam.basisPitch) {
+        return;
+    }
+    cam.basisYaw = cam.yaw;
+    cam.basisPitch = cam.pitch;
+    cam.forward = camera_forward(cam.yaw, cam.pitch);
+    cam.right = simd::normalize(simd::cross(cam.forward, simd::float3{0, 1, 0}));
+}
+
+/**
+ * @brief Rebuilds the view matrix from the camera's position, yaw and pitch.
+ * @param cam The camera to update.
+ */
+inline void update_camera_view(Camera& cam) {
+    update_camera_basis(cam);
+    cam.viewMatrix = matrix_look_at_right_hand(cam.position, cam.position + cam.forward, simd::float3{0, 1, 0});
+}
+
 /**
  * @brief Updates the camera's state based on user input.
+ *
+ * Reads and writes nothing but the camera, so cameras can be updated concurrently; the
+ * caller owns the input (see InputState in input.hpp).
+ *
  * @param cam The camera to update.
- * @param dt The delta time since the last frame.
+ * @param dt The delta time since the last update.
  * @param keys The state of the keyboard keys.
- * @param mouseX The current mouse X position.
- * @param mouseY The current mouse Y position.
- */
-inline void update_camera(Camera& cam, float dt, bool keys[1024], double mouseX, double mouseY) {
-    static double lastMouseX;
-    static double lastMouseY;
-    static bool firstMouse = true;
-
-    if (firstMouse) {
-        lastMouseX = mouseX;
-        lastMouseY = mouseY;
-        firstMouse = false;
-    }
-    
-    float deltaX = float(mouseX - lastMouseX);
-    float deltaY = float(mouseY - lastMouseY);
-    
-    lastMouseX = mouseX;
-    lastMouseY = mouseY;
-    
-    cam.yaw += deltaX * cam.lookSpeed;
-    cam.pitch -= deltaY * cam.lookSpeed;
+ * @param mouseDeltaX The cursor X motion since the last update, in pixels.
+ * @param mouseDeltaY The cursor Y motion since the last update, in pixels.
+ */
+inline void update_camera(Camera& cam, float dt, const bool keys[1024], float mouseDeltaX, float mouseDeltaY) {
+    cam.yaw += mouseDeltaX * cam.lookSpeed;
+    cam.pitch -= mouseDeltaY * cam.lookSpeed;
     
     // Clamp pitch to prevent flipping
     if (cam.pitch > 1.5708f) cam.pitch = 1.5708f;
     if (cam.pitch < -1.5708f) cam.pitch = -1.5708f;
     
-    float cos_pitch = cosf(cam.pitch);
-    simd::float3 forward = simd::normalize(simd::float3{ sinf(cam.yaw) * cos_pitch, sinf(cam.pitch), -cosf(cam.yaw) * cos_pitch });
-    simd::float3 right = simd::normalize(simd::cross(forward, simd::float3{0, 1, 0}));
+    update_camera_basis(cam);
+    const simd::float3 forward = cam.forward;
+    const simd::float3 right = cam.right;
 
     simd::float3 moveDir = {0, 0, 0};
     if (keys['W']) moveDir += forward;
@@ -132,12 +260,9 @@ inline void update_camera(Camera& cam, float dt, bool keys[1024], double mouseX,
         cam.position += simd::normalize(moveDir) * cam.moveSpeed * dt;
     }
     
-    // Clamp position to a bounding box
-    simd::float3 minBounds = {-20.0f, 0.0f, -20.0f};
-    simd::float3 maxBounds = {20.0f, 20.0f, 20.0f};
-    cam.position = simd::clamp(cam.position, minBounds, maxBounds);
+    cam.position = simd::clamp(cam.position, cam.minBounds, cam.maxBounds);
 
-    cam.viewMatrix = matrix_look_at_right_hand(cam.position, cam.position + forward, simd::float3{0, 1, 0});
+    update_camera_view(cam);
 }
 
 // --- Matrix implementations ---
@@ -154,6 +279,30 @@ inline simd::float4x4 matrix_perspective_right_hand(float fovyRadians, float asp
     );
 }
 
+inline simd::float4x4 matrix_perspective_reverse_z_infinite(float fovyRadians, float aspect, float nearZ) {
+    float ys = 1.0f / tanf(fovyRadians * 0.5f);
+    float xs = ys / aspect;
+    return simd::float4x4(
+        simd::float4{xs, 0.0f, 0.0f, 0.0f},
+        simd::float4{0.0f, ys, 0.0f, 0.0f},
+        simd::float4{0.0f, 0.0f, 0.0f, -1.0f},
+        simd::float4{0.0f, 0.0f, nearZ, 0.0f}
+    );
+}
+
+inline simd::float4x4 matrix_orthographic_right_hand(float left, float right, float bottom, float top, float nearZ,
+                                                     float farZ) {
+    float xs = 2.0f / (right - left);
+    float ys = 2.0f / (top - bottom);
+    float zs = 1.0f / (nearZ - farZ);
+    return simd::float4x4(
+        simd::float4{xs, 0.0f, 0.0f, 0.0f},
+        simd::float4{0.0f, ys, 0.0f, 0.0f},
+        simd::float4{0.0f, 0.0f, zs, 0.0f},
+        simd::float4{-(right + left) / (right - left), -(top + bottom) / (top - bottom), zs * nearZ, 1.0f}
+    );
+}
+
 inline simd::float4x4 matrix_look_at_right_hand(simd::float3 eye, simd::float3 center, simd::float3 up) {
     simd::float3 f = simd::normalize(center - eye);
     simd::float3 s = simd::normalize(simd::cross(f, up));
@@ -196,3 +345,12 @@ inline simd::float4x4 matrix_scale(float sx, float sy, float sz) {
     );
 }
 
+inline simd::float3x3 matrix_normal(const simd::float4x4& model) {
+    const simd::float3 c0 = { model.columns[0].x, model.columns[0].y, model.columns[0].z };
+    const simd::float3 c1 = { model.columns[1].x, model.columns[1].y, model.columns[1].z };
+    const simd::float3 c2 = { model.columns[2].x, model.columns[2].y, model.columns[2].z };
+    // The columns of the inverse transpose are the cross products of the columns over the determinant
+    const simd::float3 n0 = simd::cross(c1, c2);
+    const float invDet = 1.0f / simd::dot(c0, n0);
+    return simd::float3x3(n0 * invDet, simd::cross(c2, c0) * invDet, simd::cross(c0, c1) * invDet);
+}
@@ -0,0 +1,134 @@
+#include "camera_path.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "json.hpp"
+
+namespace {
+    bool read_number(const JsonValue& object, const char* key, float& out, bool required, std::string& error) {
+        auto it = object.object.find(key);
+        if (it == object.object.end()) {
+            if (required) error = std::string("missing \"") + key + "\"";
+            return !required;
+        }
+        if (it->second.type != JsonValue::NUMBER) {
+            error = std::string("\"") + key + "\" must be a number";
+            return false;
+        }
+        out = (float)it->second.number;
+        return true;
+    }
+
+    simd::float3 catmull_rom(simd::float3 p0, simd::float3 p1, simd::float3 p2, simd::float3 p3, float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+}
+
+bool parse_camera_path(const std::string& text, CameraPath& path, std::string& error) {
+    JsonValue root;
+    if (!parse_json(text, root, error)) {
+        return false;
+    }
+    if (root.type != JsonValue::OBJECT) {
+        error = "camera path must be a JSON object";
+        return false;
+    }
+
+    float width = (float)path.width, height = (float)path.height;
+    float frames = (float)path.frames, warmupFrames = (float)path.warmupFrames;
+    if (!read_number(root, "width", width, false, error) || !read_number(root, "height", height, false, error) ||
+        !read_number(root, "frames", frames, false, error) || !read_number(root, "warmupFrames", warmupFrames, false, error)) {
+        return false;
+    }
+    path.width = (int)width;
+    path.height = (int)height;
+    path.frames = (int)frames;
+    path.warmupFrames = (int)warmupFrames;
+    if (path.width <= 0 || path.height <= 0 || path.frames <= 0 || path.warmupFrames < 0) {
+        error = "width, height and frames must be positive";
+        return false;
+    }
+
+    auto keyframes = root.object.find("keyframes");
+    if (keyframes == root.object.end() || keyframes->second.type != JsonValue::ARRAY || keyframes->second.array.empty()) {
+        error = "\"keyframes\" must be a non-empty array";
+        return false;
+    }
+
+    path.keyframes.clear();
+    for (const auto& entry : keyframes->second.array) {
+        CameraKeyframe key;
+        if (entry.type != JsonValue::OBJECT || !read_number(entry, "time", key.time, true, error) ||
+            !read_number(entry, "yaw", key.yaw, false, error) || !read_number(entry, "pitch", key.pitch, false, error)) {
+            if (error.empty()) error = "keyframes must be objects";
+            return false;
+        }
+
+        auto position = entry.object.find("position");
+        if (position == entry.object.end() || position->second.type != JsonValue::ARRAY || position->second.array.size() != 3) {
+            error = "keyframe \"position\" must be an array of three numbers";
+            return false;
+        }
+        const std::vector<JsonValue>& xyz = position->second.array;
+        key.position = { (float)xyz[0].number, (float)xyz[1].number, (float)xyz[2].number };
+        path.keyframes.push_back(key);
+    }
+
+    std::stable_sort(path.keyframes.begin(), path.keyframes.end(),
+                     [](const CameraKeyframe& a, const CameraKeyframe& b) { return a.time < b.time; });
+    return true;
+}
+
+bool load_camera_path(const char* filename, CameraPath& path, std::string& error) {
+    std::ifstream file(filename);
+    if (!file) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse_camera_path(text.str(), path, error);
+}
+
+float camera_path_duration(const CameraPath& path) {
+    return path.keyframes.back().time;
+}
+
+CameraKeyframe sample_camera_path(const CameraPath& path, float time) {
+    const std::vector<CameraKeyframe>& keys = path.keyframes;
+    if (time <= keys.front().time) return keys.front();
+    if (time >= keys.back().time) return keys.back();
+
+    size_t i = 1;
+    while (keys[i].time < time) ++i;
+    const CameraKeyframe& a = keys[i - 1];
+    const CameraKeyframe& b = keys[i];
+    float span = b.time - a.time;
+    float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+
+    // Missing neighbours at the ends are mirrored so the spline stays inside the path
+    simd::float3 before = i >= 2 ? keys[i - 2].position : 2.0f * a.position - b.position;
+    simd::float3 after = i + 1 < keys.size() ? keys[i + 1].position : 2.0f * b.position - a.position;
+
+    CameraKeyframe pose;
+    pose.time = time;
+    pose.position = catmull_rom(before, a.position, b.position, after, t);
+    pose.yaw = a.yaw + (b.yaw - a.yaw) * t;
+    pose.pitch = a.pitch + (b.pitch - a.pitch) * t;
+    return pose;
+}
+
+void apply_camera_pose(Camera& cam, const CameraKeyframe& pose, float dt) {
+    static const bool noKeys[1024] = {};
+
+    // A still mouse and no keys leave the pose untouched apart from the usual clamping
+    cam.position = pose.position;
+    cam.yaw = pose.yaw;
+    cam.pitch = pose.pitch;
+    update_camera(cam, dt, noKeys, 0.0f, 0.0f);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file camera_path.hpp
+ * @brief Recorded camera splines for the headless benchmark mode.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+
+/**
+ * @struct CameraKeyframe
+ * @brief A camera pose at a point in time.
+ */
+struct CameraKeyframe {
+    float time = 0.0f;          ///< Seconds since the start of the path.
+    simd::float3 position;      ///< The camera position in world space.
+    float yaw = 0.0f;           ///< The yaw in radians.
+    float pitch = 0.0f;         ///< The pitch in radians.
+};
+
+/**
+ * @struct CameraPath
+ * @brief A benchmark run: the spline to follow and how to render it.
+ */
+struct CameraPath {
+    std::vector<CameraKeyframe> keyframes;  ///< Poses sorted by time; at least one.
+    int width = 1280;                       ///< Offscreen render width in pixels.
+    int height = 720;                       ///< Offscreen render height in pixels.
+    int frames = 600;                       ///< Measured frames, spread evenly over the path.
+    int warmupFrames = 60;                  ///< Unmeasured frames rendered at the first pose.
+};
+
+/**
+ * @brief Parses a camera path from JSON text.
+ *
+ * The document is an object with optional "width", "height", "frames" and "warmupFrames"
+ * numbers and a required "keyframes" array of {"time", "position": [x, y, z], "yaw", "pitch"}.
+ *
+ * @param text The JSON document.
+ * @param path Receives the parsed path.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool parse_camera_path(const std::string& text, CameraPath& path, std::string& error);
+
+/**
+ * @brief Reads and parses a camera path file.
+ * @param filename The JSON file to read.
+ * @param path Receives the parsed path.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool load_camera_path(const char* filename, CameraPath& path, std::string& error);
+
+/// @return The time of the last keyframe.
+float camera_path_duration(const CameraPath& path);
+
+/**
+ * @brief Evaluates the path at a time.
+ *
+ * Positions follow a Catmull-Rom spline through the keyframes; yaw and pitch are
+ * interpolated linearly. Times outside the path clamp to its ends.
+ *
+ * @param path The path.
+ * @param time Seconds since the start of the path.
+ * @return The interpolated pose.
+ */
+CameraKeyframe sample_camera_path(const CameraPath& path, float time);
+
+/**
+ * @brief Moves a camera to a pose and refreshes its view matrix through update_camera.
+ * @param cam The camera to drive.
+ * @param pose The pose to apply.
+ * @param dt The delta time passed on to update_camera.
+ */
+void apply_camera_pose(Camera& cam, const CameraKeyframe& pose, float dt);
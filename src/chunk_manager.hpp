@@ -0,0 +1,455 @@
+/**
+ * @file chunk_manager.hpp
+ * @brief Streams terrain chunks around the camera as background jobs.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "asset_loader.hpp"
+#include "biome.hpp"
+#include "chunk_schedule.hpp"
+#include "frame_arena.hpp"
+#include "gpu_heap.hpp"
+#include "gpu_residency.hpp"
+#include "gpu_terrain_erosion.hpp"
+#include "job_system.hpp"
+#include "landscape.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+#include "terrain_bake.hpp"
+#include "terrain_edit.hpp"
+#include "terrain_edit_history.hpp"
+#include "terrain_erosion.hpp"
+#include "terrain_lod.hpp"
+#include "volume_terrain.hpp"
+
+/**
+ * @struct ChunkManagerConfig
+ * @brief Tunables for terrain streaming.
+ */
+struct ChunkManagerConfig {
+    float chunkSize = 32.0f;               ///< Edge length of a chunk in world units.
+    int resolution = 33;                   ///< Vertices along each chunk edge.
+    int loadRadius = 4;                    ///< Chunks within this radius (in chunks) are loaded.
+    int unloadRadius = 6;                  ///< Chunks beyond this radius are evicted.
+    size_t memoryBudget = 64 * 1024 * 1024; ///< Maximum GPU bytes held by resident chunks; at most a quarter of the
+                                            ///< device's recommended working set.
+    uint32_t workerCount = 2;              ///< Most chunks generated at once by background jobs.
+    float lodPixelError = 2.0f;            ///< Screen-space error allowed when picking chunk LODs.
+    float vertexLitPixels = 4.0f;          ///< Chunks whose cells project smaller than this are marked vertexLit.
+    bool generateOnGpu = true;             ///< Build vertices with the compute kernel instead of on the CPU.
+    VertexFormat vertexFormat = VertexFormat::Packed; ///< Layout of chunk vertex buffers.
+    bool cacheTiles = true;                ///< Keep generated chunks as tile files and map them in on later visits.
+    bool compressTiles = false;            ///< Encode tiles to shrink reads; they are decoded and uploaded, not mapped.
+    bool heightMaps = false;               ///< Keep heights and normals in textures instead of vertex buffers.
+    TerrainParams terrain;                 ///< Terrain generator tunables, for every chunk, height query and tile key.
+    ErosionSettings erosion;               ///< Erosion of the generated terrain; off while erosion.iterations is 0.
+    BiomeSettings biomes;                  ///< Climate of each chunk's biome map; off while biomes.cellsPerEdge is 0.
+    ChunkScheduleSettings schedule;        ///< Order chunks are generated in and the upload bytes started per frame.
+    UploadBudgetSettings uploads;          ///< Frame budget of the chunk uploads, for the ResourceUploader given to it.
+    VolumeTerrainSettings volume;          ///< Caves and overhangs where its mask allows; off unless volume.enabled.
+};
+
+/// @return The root of the terrain tile cache in the user's caches directory.
+NSString* default_terrain_tile_cache_path();
+
+/**
+ * @struct ChunkVolume
+ * @brief The volumetric mesh a chunk with caves or overhangs draws instead of its height field.
+ */
+struct ChunkVolume {
+    id<MTLBuffer> vertexBuffer;         ///< Vertices in the chunks' VertexFormat; nil for a height-field chunk.
+    id<MTLBuffer> indexBuffer;          ///< 32-bit triangle list.
+    uint32_t indexCount = 0;            ///< Indices in indexBuffer.
+    simd::float4x4 modelMatrix;         ///< Unpacks the vertices' quantization box; the identity for float vertices.
+    uint32_t bricks = 0;                ///< Surface bricks the mesh was built from.
+};
+
+/**
+ * @struct ChunkDraw
+ * @brief What to bind to draw a chunk.
+ */
+struct ChunkDraw {
+    id<MTLBuffer> vertexBuffer;         ///< The chunk's vertices; nil for a height-map chunk.
+    id<MTLBuffer> indexBuffer;          ///< The LOD index buffer, or the volume's own.
+    MTLIndexType indexType;             ///< Width of the indices.
+    IndexRange range;                   ///< Indices drawn, in indices from the start of indexBuffer.
+    simd::float4x4 modelMatrix;         ///< The chunk's or the volume's.
+    bool volume = false;                ///< True for a volumetric chunk, which has no LODs or height map.
+};
+
+/**
+ * @struct ResidentChunk
+ * @brief A chunk whose mesh has been generated and uploaded.
+ */
+struct ResidentChunk {
+    ChunkKey key;               ///< Position on the chunk grid.
+    GpuMesh mesh;               ///< GPU buffers of the chunk; the index buffer is shared by all chunks.
+    id<MTLTexture> heightMap;   ///< r16Float heights of a height-map chunk, which has no vertex buffer; else nil.
+    id<MTLTexture> normalMap;   ///< rg8Snorm normals of a height-map chunk; else nil.
+    simd::float4x4 modelMatrix; ///< Maps vertex positions to world space; undoes quantization for packed chunks.
+    size_t bytes;               ///< GPU memory used by the chunk's own buffers.
+    ChunkLodInfo lod;           ///< Error metrics used for LOD selection.
+    BoundingBox bounds;         ///< World space bounds of the chunk's vertices.
+    int lodLevel = 0;           ///< Level selected by the last update_lods().
+    uint32_t stitchMask = 0;    ///< Edges stitched to coarser neighbours.
+    bool vertexLit = false;     ///< Cells few enough pixels on screen to light per vertex, by the last update_lods().
+    uint64_t uploadValue = 0;   ///< ResourceUploader value the vertex buffer waits for; 0 if none.
+    AssetLoad tileLoad;         ///< Load streaming the vertex buffer from a tile; nil commands if none.
+    uint64_t editVersion = 0;   ///< Number of terrain edits applied when the chunk was built.
+    uint32_t heapSlot = NO_SLOT; ///< Slot of the vertex buffer in the chunk heap; NO_SLOT if it has its own.
+    BiomeMap biomes;            ///< Biome IDs at the chunk's biome cell corners; empty without biomes.
+    ChunkVolume volume;         ///< Drawn instead of the height field if its vertex buffer is set.
+};
+
+/**
+ * @class ChunkManager
+ * @brief Loads chunks near the camera asynchronously and evicts distant ones.
+ *
+ * Background jobs on the JobSystem either dispatch the generate_terrain_chunk kernel into a private vertex
+ * buffer or build the mesh on the CPU and upload it through the ResourceUploader, so
+ * the render thread only swaps finished chunks in during update(). Chunks are published
+ * once their upload has landed. Vertices are stored in the configured
+ * VertexFormat; packed chunks are quantized into terrain_chunk_quantization_box().
+ *
+ * With heightMaps, chunks are built on the CPU and kept as a height and a normal texture
+ * (see terrain_height_map.hpp); they draw with the LOD index buffer and
+ * ShaderProgram::LandscapeHeightMap, which rebuilds each grid position from its vertex ID.
+ *
+ * With cacheTiles, every generated chunk is also written to a tile file (see
+ * terrain_tile_cache.hpp), and a chunk whose tile exists is mapped into a shared
+ * buffer instead of being generated, so revisited terrain costs file I/O and no copy.
+ * Given an AssetLoader, tiles are instead streamed into private buffers on the GPU's IO
+ * queues, chunks next to the camera at high priority, and loads of chunks the camera has
+ * left are cancelled. With compressTiles, tiles are encoded with mesh_codec.hpp to a fraction
+ * of the bytes, and the generation jobs read and decode them in parallel and upload the
+ * result like generated vertices, spending CPU time to save read bandwidth.
+ *
+ * Private vertex buffers are placed in a BufferHeap rather than allocated one by one, and
+ * an evicted chunk's slot is reused once the frames that may still draw it have completed. The
+ * evicted chunk's buffers and textures are held as long, so command buffers need not retain them.
+ *
+ * edit() layers brush edits over the procedural terrain (see terrain_edit.hpp). It patches
+ * only the grid points the brush changed and the normals around them in the resident
+ * chunks, and chunks built afterwards apply the edits on the CPU and skip the tile cache.
+ * write_edit_offsets() takes offsets computed elsewhere, e.g. by the GPU brush, the same way.
+ * Changes between begin_edit_stroke() and end_edit_stroke() form one stroke of the edit
+ * history (see terrain_edit_history.hpp), which undo_edit() and redo_edit() step through.
+ *
+ * With erosion on, the terrain is eroded in windows around the chunk grid corners (see
+ * terrain_erosion.hpp). A generation job erodes the windows its chunk needs on the GPU, or with
+ * the CPU reference if the erosion pipelines are missing, and builds the chunk on the CPU from
+ * the noise plus the blended window offsets, under any edits. Windows are written to the tile
+ * directory next to the chunks, whose generator key includes the erosion settings, so a seed's
+ * terrain is eroded once: later runs map the chunk tiles, and only edits or chunks without a
+ * tile read the window tiles back. Terrain drawn without chunks, i.e. the clipmap, the
+ * tessellated patches and the GPU foliage, follows the noise alone, as it does for edits.
+ *
+ * With biomes on, the generation job also picks the chunk's BiomeMap (see biome.hpp), which
+ * the baked terrain materials and the foliage scatter read from the resident chunk.
+ *
+ * With the volumetric layer on (see volume_terrain.hpp), the generation job also meshes the
+ * caves and overhangs of chunks inside its feature mask from the chunk's eroded, edited heights,
+ * and chunk_draw() draws that mesh instead of the height field, which is still kept for the
+ * height queries, tiles and edits. An edit that reaches a volumetric chunk evicts it, so it is
+ * generated again around the edit. Volumetric chunks have a single detail level, and the
+ * clipmap, tessellated patches, GPU culling and ray tracing still see the height field.
+ */
+class ChunkManager {
+public:
+    ChunkManager(const MetalContext& metal, ResourceUploader& uploader, JobSystem& jobs,
+                 const ChunkManagerConfig& config = {}, AssetLoader* assets = nullptr);
+    ~ChunkManager();
+
+    ChunkManager(const ChunkManager&) = delete;
+    ChunkManager& operator=(const ChunkManager&) = delete;
+
+    /**
+     * @brief Requests chunks around the camera, publishes finished ones and evicts far ones.
+     *
+     * Missing chunks within the load radius of the camera, or of where its velocity takes it
+     * within the schedule's lookahead, are queued in chunk_request_priority() order, and queued
+     * chunks that are no longer wanted are dropped. Jobs stop taking requests once they have
+     * started the schedule's uploadBytesPerFrame since the last update().
+     *
+     * @param view The camera; see chunk_streaming_view().
+     * @param arena The render thread's frame arena, for the request bookkeeping.
+     * @param viewDistance Chunks entirely farther away are not requested, e.g. fog_cull_distance();
+     *                     resident ones still stay until they leave the unload radius.
+     */
+    void update(const ChunkStreamingView& view, FrameArena& arena, float viewDistance = INFINITY);
+
+    /// @brief Updates for a camera at a position, still and without a frustum; requests go nearest first.
+    void update(simd::float3 cameraPosition, FrameArena& arena, float viewDistance = INFINITY);
+
+    /**
+     * @brief Counts the chunks the camera should see that are not resident, i.e. the holes drawn as pop-in.
+     * @param view The camera; without a frustum every direction counts.
+     * @param viewDistance Chunks entirely farther away do not count.
+     * @return Chunks within the load radius, the view distance and the frustum that are not resident.
+     */
+    size_t missing_visible_chunks(const ChunkStreamingView& view, float viewDistance = INFINITY) const;
+
+    /// @return Queued requests dropped before a job started them, since the manager was created.
+    size_t cancelled_requests() const;
+
+    /**
+     * @brief Selects a LOD level and stitch mask for every resident chunk, and whether it may be lit per vertex.
+     * @param cameraPosition The camera position in world space.
+     * @param projectionScale Viewport height / (2 * tan(fovy / 2)), in pixels.
+     * @param arena The render thread's frame arena, for the selection inputs and results.
+     */
+    void update_lods(simd::float3 cameraPosition, float projectionScale, FrameArena& arena);
+
+    /// @return The range of lod_index_buffer() to draw a chunk with.
+    const IndexRange& index_range(const ResidentChunk& chunk) const {
+        return m_lodIndices.range(chunk.lodLevel, chunk.stitchMask);
+    }
+
+    /// @return The range of lod_index_buffer() holding a detail level with the given edges stitched.
+    const IndexRange& lod_index_range(int lod, uint32_t stitchMask) const {
+        return m_lodIndices.range(lod, stitchMask);
+    }
+
+    /// @return The buffers, indices and transform to draw a chunk with: its volume or its selected LOD.
+    ChunkDraw chunk_draw(const ResidentChunk& chunk) const;
+
+    /// @return The index buffer shared by all chunks, 16-bit when the resolution allows.
+    id<MTLBuffer> lod_index_buffer() const { return m_lodIndexBuffer; }
+
+    /// @return The index type of lod_index_buffer().
+    MTLIndexType lod_index_type() const { return m_lodIndexType; }
+
+    /// @return Chunks that are ready to draw.
+    const std::vector<ResidentChunk>& resident() const { return m_resident; }
+
+    /// @return GPU bytes held by resident chunks.
+    size_t resident_bytes() const { return m_residentBytes; }
+
+    /// @return GPU bytes allocated for terrain: the chunk heaps, standalone chunk resources and the LOD indices.
+    size_t allocated_bytes() const;
+
+    /// @return CPU bytes of the erosion window offsets held; 0 without erosion.
+    size_t erosion_bytes() const;
+
+    /// @return CPU bytes of the resident chunks' biome maps; 0 without biomes.
+    size_t biome_bytes() const;
+
+    /// @return Number of chunks queued or being generated.
+    size_t pending_count() const;
+
+    /// @brief Replaces out with the chunks queued or being generated; out keeps its capacity.
+    void pending_keys(std::vector<ChunkKey>& out) const;
+
+    /// @return Upper bound on the number of chunks resident at once.
+    size_t max_resident_chunks() const;
+
+    /// @return The render pipeline matching the chunks' vertex format.
+    id<MTLRenderPipelineState> render_pipeline() const { return m_renderPipeline; }
+
+    /**
+     * @brief Switches to the terrain pipelines of another context, e.g. after a shader reload.
+     *
+     * Generation jobs already running finish with the old pipeline.
+     *
+     * @param metal The context; its pipelines must exist wherever the creating context's did.
+     */
+    void set_pipelines(const MetalContext& metal);
+
+    /**
+     * @brief Keeps the terrain in a residency set: the chunk heaps, the LOD indices and the chunks' own resources.
+     *
+     * Chunks join it when they are published and leave it once the frames that may draw them
+     * have completed. Call from the thread that calls update(), before drawing without
+     * useResources.
+     *
+     * @param residency The set; must outlive the manager.
+     */
+    void set_residency(GpuResidency* residency);
+
+    /// @return The heap chunk vertex buffers are placed in; nil for height-map chunks.
+    const BufferHeap* vertex_heap() const { return m_vertexHeap.get(); }
+
+    /// @return The configuration the manager was created with.
+    const ChunkManagerConfig& config() const { return m_config; }
+
+    /**
+     * @brief Applies a brush to the terrain and patches the resident chunks it reaches.
+     *
+     * The changed heights and the normals one grid point around them are copied into the
+     * chunks' vertex buffers or height maps through the ResourceUploader, and the touched
+     * chunks' LOD metrics and bounds are remeasured, so the cost follows the brush area.
+     * Draws that read the patches wait for edit_upload_value(). Call from the thread that
+     * calls update().
+     *
+     * @param brush The brush.
+     * @return What the brush changed.
+     */
+    TerrainEditResult edit(const TerrainBrush& brush);
+
+    /**
+     * @brief Replaces every terrain edit, e.g. with those of a saved world, and patches the resident chunks.
+     *
+     * Costs what one brush over the area of the old and new edits would. Call from the thread
+     * that calls update().
+     *
+     * @param points The edited points, e.g. as listed by TerrainEdits::points().
+     * @param count The number of points.
+     * @return The grid points whose height may have changed.
+     */
+    TerrainGridRect restore_edits(const TerrainEditPoint* points, size_t count);
+
+    /**
+     * @brief Replaces the offsets of a rectangle and patches the resident chunks, as edit() does.
+     *
+     * Call from the thread that calls update().
+     *
+     * @param rect The grid points.
+     * @param offsets Their new offsets, row-major, e.g. read back from a GpuTerrainBrush.
+     * @return The grid points whose offset changed.
+     */
+    TerrainGridRect write_edit_offsets(const TerrainGridRect& rect, const float* offsets);
+
+    /// Starts a stroke of the edit history; edits until end_edit_stroke() undo together.
+    void begin_edit_stroke();
+
+    /// Ends the stroke; it can be undone if it changed anything.
+    void end_edit_stroke();
+
+    /**
+     * @brief Reverts the last stroke and patches the resident chunks.
+     * @return The grid points whose height changed; empty if there was nothing to undo.
+     */
+    TerrainGridRect undo_edit();
+
+    /**
+     * @brief Applies the last undone stroke again and patches the resident chunks.
+     * @return The grid points whose height changed; empty if there was nothing to redo.
+     */
+    TerrainGridRect redo_edit();
+
+    /// @return The strokes so far; read them on the thread that calls edit().
+    const TerrainEditHistory& edit_history() const { return m_editHistory; }
+
+    /**
+     * @brief Samples the eroded terrain without the edits, which the edits' offsets are relative to.
+     *
+     * Erodes the windows the rectangle needs first, so call it from the thread that calls update().
+     *
+     * @param rect The grid points.
+     * @param out Receives their heights, row-major.
+     */
+    void sample_base_heights(const TerrainGridRect& rect, float* out);
+
+    /// @return The ResourceUploader value the patches of the last edit() are covered by; 0 before any.
+    uint64_t edit_upload_value() const { return m_editUploadValue; }
+
+    /// @return The edits so far; read them on the thread that calls edit().
+    const TerrainEdits& edits() const { return m_edits; }
+
+    /**
+     * @brief Returns the edited terrain height; safe from any thread.
+     * @param x The world x.
+     * @param z The world z.
+     * @return get_terrain_height() of config().terrain plus the erosion of the windows eroded so far and the edits
+     *         at (x, z).
+     */
+    float terrain_height(float x, float z) const;
+
+    /**
+     * @brief Resamples a height field from the eroded, edited terrain inside a world-space box.
+     *
+     * Erodes the windows the box needs first, so call it from the thread that calls update(),
+     * e.g. once after creating the manager and after each edit().
+     *
+     * @param field The height field.
+     * @param minX The smallest world x to update.
+     * @param minZ The smallest world z to update.
+     * @param maxX The largest world x to update.
+     * @param maxZ The largest world z to update.
+     */
+    void resample_height_field(HeightField& field, float minX = -INFINITY, float minZ = -INFINITY,
+                               float maxX = INFINITY, float maxZ = INFINITY);
+
+private:
+    void generate_requests();
+    ResidentChunk generate_chunk(ChunkKey key, AssetPriority priority);
+    void generate_on_gpu(ResidentChunk& chunk);
+    void generate_on_cpu(ResidentChunk& chunk, bool edited);
+    void generate_in_place(ResidentChunk& chunk, bool edited);
+    bool load_tile(ResidentChunk& chunk, AssetPriority priority);
+    void store_tile(const ResidentChunk& chunk, const void* payload);
+    void upload_height_map(ResidentChunk& chunk, const uint16_t* heights, const int8_t* normals);
+    void build_volume(ResidentChunk& chunk);
+    void retire_buffers(const ResidentChunk& chunk);
+    void update_residency(const ResidentChunk& chunk, bool resident);
+    size_t chunk_bytes() const;
+    TerrainBakeSettings bake_settings() const;
+    TerrainGridRect chunk_grid_rect(ChunkKey key) const;
+    void sample_noise_heights(const TerrainGridRect& rect, float* out) const;
+    void erode_windows(const TerrainGridRect& rect);
+    std::vector<float> erode_window(ChunkKey corner);
+    bool load_erosion_window(ChunkKey corner, std::vector<float>& offsets) const;
+    void store_erosion_window(ChunkKey corner, const std::vector<float>& offsets) const;
+    void apply_edits_locked(ChunkKey key, Vertex* vertices);
+    void patch_edits_locked(const TerrainGridRect& changed);
+    void patch_chunk_locked(ResidentChunk& chunk, const TerrainGridRect& normalRect, const float* heights,
+                            const TerrainGridRect& sampleRect, const simd::float3* normals);
+
+    id<MTLDevice> m_device;
+    ResourceUploader& m_uploader;
+    JobSystem& m_jobs;
+    AssetLoader* m_assets;                                        ///< Streams tiles in when set; otherwise they are mapped.
+    id<MTLCommandQueue> m_generationQueue;
+    id<MTLComputePipelineState> m_generationPipeline;              ///< Guarded by m_mutex; read by generation jobs.
+    id<MTLRenderPipelineState> m_renderPipeline;
+    ChunkManagerConfig m_config;
+    TerrainLodIndices m_lodIndices;
+    id<MTLBuffer> m_lodIndexBuffer;
+    MTLIndexType m_lodIndexType = MTLIndexTypeUInt32;
+    std::unique_ptr<BufferHeap> m_vertexHeap;                     ///< Null with heightMaps.
+    bool m_sharedVertices = false;                                ///< Chunk buffers are shared and filled in place.
+    std::string m_tileDirectory;                                  ///< Empty without cacheTiles.
+    uint64_t m_tileGeneratorKey = 0;
+
+    std::vector<ResidentChunk> m_resident;
+    size_t m_residentBytes = 0;
+    std::deque<std::pair<uint64_t, ResidentChunk>> m_retired;    ///< Evicted chunks and the update() that drops them.
+    uint64_t m_frame = 0;                                         ///< Number of update() calls.
+    GpuResidency* m_residency = nullptr;                          ///< Holds the published chunks if set.
+
+    mutable std::mutex m_mutex;
+    std::deque<ChunkKey> m_requests;                              ///< Chunks waiting for a job.
+    std::unordered_set<ChunkKey, ChunkKeyHash> m_pending;         ///< Requested but not yet resident.
+    std::vector<ResidentChunk> m_finished;                        ///< Uploaded, waiting for update().
+    uint32_t m_activeJobs = 0;                                    ///< Generation jobs draining m_requests.
+    JobCounter m_jobCounter;                                      ///< Outstanding generation jobs.
+    ChunkKey m_center{ 0, 0 };                                    ///< Camera chunk of the last update().
+    size_t m_frameUploadBytes = 0;                                ///< Chunk bytes started since the last update().
+    size_t m_cancelledRequests = 0;                               ///< Queued requests dropped since construction.
+    bool m_stopping = false;
+
+    mutable std::mutex m_editMutex;                               ///< Guards the edits; taken after m_mutex.
+    TerrainEdits m_edits;
+    TerrainEditHistory m_editHistory;                             ///< Guarded by m_editMutex.
+    uint64_t m_editVersion = 0;                                   ///< Number of edit() calls that changed the terrain.
+    std::unordered_map<ChunkKey, uint64_t, ChunkKeyHash> m_chunkEditVersions; ///< Last edit that reached each chunk.
+    uint64_t m_editUploadValue = 0;
+
+    mutable std::mutex m_erosionMutex;                            ///< Guards the erosion windows; taken last.
+    TerrainErosion m_erosion;                                     ///< Its settings never change, so read them freely.
+    GpuErosion m_gpuErosion;                                      ///< Guarded by m_erosionMutex; CPU erosion if nil.
+};
@@ -0,0 +1,1112 @@
+#import "chunk_manager.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "camera.hpp"
+#include "chunk_schedule.hpp"
+#include "frame_ring.hpp"
+#include "landscape.hpp"
+#include "terrain_height_map.hpp"
+#include "terrain_tile_cache.hpp"
+#include "trace.hpp"
+#include "vertex_packing.hpp"
+
+namespace {
+    // Chunk keys collected during one update
+    using ArenaKeySet = std::unordered_set<ChunkKey, ChunkKeyHash, std::equal_to<ChunkKey>, ArenaAllocator<ChunkKey>>;
+
+    // Several hundred chunks of the default size per heap
+    constexpr size_t CHUNK_HEAP_BYTES = 8 * 1024 * 1024;
+
+    int chunk_distance_sq(const ChunkKey& a, const ChunkKey& b) {
+        int dx = a.x - b.x;
+        int dz = a.z - b.z;
+        return dx * dx + dz * dz;
+    }
+
+    // Matches TerrainGenParams in shaders.metal
+    struct TerrainGenParams {
+        simd::float2 origin;
+        float step;
+        uint32_t resolution;
+        float noiseOffset;
+        float noiseScale;
+        float heightScale;
+        float quantMinY;
+        float quantExtentY;
+        NoiseSettings noise;
+    };
+}
+
+NSString* default_terrain_tile_cache_path() {
+    NSArray<NSString*>* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+    NSString* base = caches.count > 0 ? caches[0] : NSTemporaryDirectory();
+    return [[base stringByAppendingPathComponent:@"glfw_metal"] stringByAppendingPathComponent:@"terrain"];
+}
+
+ChunkManager::ChunkManager(const MetalContext& metal, ResourceUploader& uploader, JobSystem& jobs,
+                           const ChunkManagerConfig& config, AssetLoader* assets)
+    : m_device(metal.device), m_uploader(uploader), m_jobs(jobs), m_assets(assets),
+      m_generationQueue([metal.device newCommandQueue]), m_config(config),
+      m_edits(config.chunkSize / (float)(config.resolution - 1), terrain_height_bound(config.terrain)),
+      m_erosion(config.erosion, config.resolution - 1, config.chunkSize / (float)(config.resolution - 1)) {
+    const bool packed = m_config.vertexFormat == VertexFormat::Packed;
+    m_generationPipeline = packed ? metal.terrain_gen_packed_pipeline : metal.terrain_gen_pipeline;
+    if (gpu_erosion_supported(metal)) {
+        m_gpuErosion = create_gpu_erosion(metal);
+    }
+    m_renderPipeline = packed ? metal.landscape_packed_pipeline : metal.landscape_pipeline;
+    m_generationQueue.label = @"Terrain generation";
+    // Chunks share the device with everything else; past its working set the driver pages
+    const size_t recommended = gpu_memory_budget(m_device).recommended;
+    if (recommended > 0) {
+        m_config.memoryBudget = std::min(m_config.memoryBudget, recommended / 4);
+    }
+    // On unified memory the CPU writes chunk vertices straight into their buffers instead of staging them
+    if (!m_config.heightMaps) {
+        m_sharedVertices = m_device.hasUnifiedMemory;
+        m_vertexHeap = std::make_unique<BufferHeap>(m_device, chunk_bytes(), CHUNK_HEAP_BYTES, @"Terrain chunk",
+                                                    m_sharedVertices ? MTLStorageModeShared : MTLStorageModePrivate);
+    }
+    // The generation kernel writes vertices, so height maps are built on the CPU; so is eroded
+    // terrain, which adds the window offsets to the noise
+    if (!m_generationPipeline || m_config.heightMaps || m_erosion.enabled()) {
+        m_config.generateOnGpu = false;
+    }
+    // Height-map chunks draw from textures, with nothing to bind a volumetric mesh in their place
+    if (m_config.heightMaps) {
+        m_config.volume.enabled = false;
+    }
+    if (m_config.cacheTiles) {
+        // Uneroded terrain shares its directory with the tiles terrain_baker writes
+        TerrainTileParams tileParams = terrain_bake_tile_params(bake_settings());
+        tileParams.erosion = m_config.erosion;
+        m_tileGeneratorKey = terrain_tile_generator_key(tileParams);
+        m_tileDirectory = terrain_tile_directory(default_terrain_tile_cache_path().UTF8String, m_tileGeneratorKey);
+    }
+
+    m_lodIndices = build_terrain_lod_indices(m_config.resolution);
+    const std::vector<uint32_t>& lodIndices = m_lodIndices.indices;
+    if (index_format_for((size_t)m_config.resolution * m_config.resolution) == IndexFormat::UInt16) {
+        std::vector<uint16_t> narrow(lodIndices.begin(), lodIndices.end());
+        m_lodIndexType = MTLIndexTypeUInt16;
+        m_lodIndexBuffer = m_uploader.upload(narrow.data(), narrow.size() * sizeof(uint16_t), @"Terrain LOD indices");
+    } else {
+        m_lodIndexBuffer = m_uploader.upload(lodIndices.data(), lodIndices.size() * sizeof(uint32_t), @"Terrain LOD indices");
+    }
+    // Every chunk upload is flushed after this one, so waiting for a chunk covers the indices too
+    m_uploader.flush();
+}
+
+ChunkManager::~ChunkManager() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    // A job finishes the chunk it is generating, then sees m_stopping
+    m_jobs.wait(m_jobCounter);
+}
+
+void ChunkManager::update(simd::float3 cameraPosition, FrameArena& arena, float viewDistance) {
+    ChunkStreamingView view;
+    view.position = cameraPosition;
+    update(view, arena, viewDistance);
+}
+
+void ChunkManager::update(const ChunkStreamingView& view, FrameArena& arena, float viewDistance) {
+    const simd::float3 cameraPosition = view.position;
+    const simd::float3 predicted = predict_camera_position(view, m_config.schedule.lookahead);
+    ChunkKey center{ (int)floorf(cameraPosition.x / m_config.chunkSize),
+                     (int)floorf(cameraPosition.z / m_config.chunkSize) };
+    ChunkKey ahead{ (int)floorf(predicted.x / m_config.chunkSize), (int)floorf(predicted.z / m_config.chunkSize) };
+    const int loadSq = m_config.loadRadius * m_config.loadRadius;
+    const int unloadSq = m_config.unloadRadius * m_config.unloadRadius;
+
+    if (m_erosion.enabled()) {
+        // Chunks inside the unload radius, with their aprons, only read corners this close
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        m_erosion.trim(center, m_config.unloadRadius + 3);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_center = center;
+        m_frameUploadBytes = 0;
+
+        // Tiles still streaming in for chunks the camera has left are not worth finishing
+        for (const auto& chunk : m_finished) {
+            if (chunk_distance_sq(chunk.key, center) > unloadSq) {
+                AssetLoader::cancel(chunk.tileLoad);
+            }
+        }
+
+        // Publish chunks the jobs finished since the last update; uploads still in flight wait
+        auto landed = std::stable_partition(m_finished.begin(), m_finished.end(), [&](const ResidentChunk& chunk) {
+            return !m_uploader.is_complete(chunk.uploadValue) ||
+                   (chunk.tileLoad.commands && AssetLoader::status(chunk.tileLoad) == AssetLoadStatus::Pending);
+        });
+        std::unique_lock<std::mutex> editLock(m_editMutex);
+        for (auto it = landed; it != m_finished.end(); ++it) {
+            m_pending.erase(it->key);
+            // A cancelled or failed tile load leaves the chunk missing, so it is requested again
+            const bool loaded = !it->tileLoad.commands || AssetLoader::status(it->tileLoad) == AssetLoadStatus::Complete;
+            // So does a chunk an edit reached after it was built
+            auto edited = m_chunkEditVersions.find(it->key);
+            const bool current = edited == m_chunkEditVersions.end() || edited->second <= it->editVersion;
+            if (loaded && current && chunk_distance_sq(it->key, center) <= unloadSq) {
+                it->tileLoad = {};
+                m_residentBytes += it->bytes;
+                update_residency(*it, true);
+                m_resident.push_back(*it);
+            } else {
+                retire_buffers(*it);
+            }
+        }
+        m_finished.erase(landed, m_finished.end());
+        editLock.unlock();
+
+        // Queued requests are ranked afresh with the missing chunks, so the ones the camera moved away
+        // from are dropped before a job starts them, and the ones it now heads for move up
+        ArenaVector<ChunkKey> queued(m_requests.begin(), m_requests.end(), ArenaAllocator<ChunkKey>(arena));
+        for (const ChunkKey& key : queued) {
+            m_pending.erase(key);
+        }
+        m_requests.clear();
+
+        ArenaKeySet residentKeys(m_resident.size(), ChunkKeyHash(), std::equal_to<ChunkKey>(),
+                                 ArenaAllocator<ChunkKey>(arena));
+        for (const auto& chunk : m_resident) {
+            residentKeys.insert(chunk.key);
+        }
+
+        // Missing chunks within the load radius of the camera or of its predicted position, and within
+        // the view distance of either; only inside the unload radius, or they would be evicted on arrival
+        const float heightBound = terrain_height_bound(m_config.terrain);
+        ArenaVector<std::pair<float, ChunkKey>> missing{ ArenaAllocator<std::pair<float, ChunkKey>>(arena) };
+        for (int dz = -m_config.unloadRadius; dz <= m_config.unloadRadius; ++dz) {
+            for (int dx = -m_config.unloadRadius; dx <= m_config.unloadRadius; ++dx) {
+                ChunkKey key{center.x + dx, center.z + dz};
+                const bool inRange = dx * dx + dz * dz <= loadSq || chunk_distance_sq(key, ahead) <= loadSq;
+                const float distance = std::min(chunk_distance(key, m_config.chunkSize, cameraPosition),
+                                                chunk_distance(key, m_config.chunkSize, predicted));
+                if (inRange && dx * dx + dz * dz <= unloadSq && distance <= viewDistance && !residentKeys.count(key) &&
+                    !m_pending.count(key)) {
+                    const float priority =
+                        chunk_request_priority(key, m_config.chunkSize, heightBound, view, m_config.schedule);
+                    missing.emplace_back(priority, key);
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        // Never request more than the memory budget can hold, or eviction would thrash
+        size_t capacity = max_resident_chunks();
+        for (const auto& [priority, key] : missing) {
+            if (m_resident.size() + m_pending.size() >= capacity) break;
+            m_pending.insert(key);
+            m_requests.push_back(key);
+        }
+        for (const ChunkKey& key : queued) {
+            m_cancelledRequests += !m_pending.count(key);
+        }
+
+        // Each job drains requests until none are left, so at most workerCount run at once
+        while (m_activeJobs < std::min<size_t>(m_config.workerCount, m_requests.size())) {
+            m_activeJobs++;
+            m_jobs.run([this] { generate_requests(); }, &m_jobCounter, JobPriority::Background);
+        }
+    }
+
+    // Evict chunks outside the unload radius, then the farthest ones while over budget
+    auto outside = std::remove_if(m_resident.begin(), m_resident.end(), [&](const ResidentChunk& chunk) {
+        if (chunk_distance_sq(chunk.key, center) <= unloadSq) return false;
+        m_residentBytes -= chunk.bytes;
+        retire_buffers(chunk);
+        return true;
+    });
+    m_resident.erase(outside, m_resident.end());
+
+    if (m_residentBytes > m_config.memoryBudget) {
+        std::sort(m_resident.begin(), m_resident.end(), [&](const ResidentChunk& a, const ResidentChunk& b) {
+            return chunk_distance_sq(a.key, center) < chunk_distance_sq(b.key, center);
+        });
+        while (m_residentBytes > m_config.memoryBudget && !m_resident.empty()) {
+            m_residentBytes -= m_resident.back().bytes;
+            retire_buffers(m_resident.back());
+            m_resident.pop_back();
+        }
+    }
+    if (m_vertexHeap) {
+        m_vertexHeap->end_frame();
+    }
+    m_frame++;
+    while (!m_retired.empty() && m_retired.front().first <= m_frame) {
+        update_residency(m_retired.front().second, false);
+        m_retired.pop_front();
+    }
+}
+
+void ChunkManager::update_lods(simd::float3 cameraPosition, float projectionScale, FrameArena& arena) {
+    ChunkLodInput* inputs = arena.allocate_array<ChunkLodInput>(m_resident.size());
+    int* levels = arena.allocate_array<int>(m_resident.size());
+    uint32_t* masks = arena.allocate_array<uint32_t>(m_resident.size());
+    bool* vertexLit = arena.allocate_array<bool>(m_resident.size());
+    for (size_t i = 0; i < m_resident.size(); ++i) {
+        inputs[i] = { m_resident[i].key, &m_resident[i].lod };
+    }
+
+    select_terrain_lods(inputs, m_resident.size(), m_config.chunkSize, cameraPosition,
+                        projectionScale, m_config.lodPixelError, levels, masks);
+    select_vertex_lit_chunks(inputs, m_resident.size(), levels, m_config.resolution, m_config.chunkSize, cameraPosition,
+                             projectionScale, m_config.vertexLitPixels, vertexLit);
+
+    for (size_t i = 0; i < m_resident.size(); ++i) {
+        m_resident[i].lodLevel = levels[i];
+        m_resident[i].stitchMask = masks[i];
+        m_resident[i].vertexLit = vertexLit[i];
+    }
+}
+
+void ChunkManager::retire_buffers(const ResidentChunk& chunk) {
+    if (m_vertexHeap) {
+        m_vertexHeap->retire(chunk.heapSlot);
+    }
+    // Like the heap slot, for frames drawn with command buffers that do not retain what they bind
+    m_retired.emplace_back(m_frame + DEFAULT_FRAMES_IN_FLIGHT, chunk);
+}
+
+void ChunkManager::set_residency(GpuResidency* residency) {
+    m_residency = residency;
+    if (m_vertexHeap) {
+        m_vertexHeap->set_residency(residency);
+    }
+    if (m_residency) {
+        m_residency->add(m_lodIndexBuffer);
+        for (const ResidentChunk& chunk : m_resident) {
+            update_residency(chunk, true);
+        }
+    }
+}
+
+void ChunkManager::update_residency(const ResidentChunk& chunk, bool resident) {
+    if (!m_residency) {
+        return;
+    }
+    // Heap-placed vertex buffers are resident with their heap
+    id<MTLResource> resources[] = { chunk.heapSlot == NO_SLOT ? chunk.mesh.vertexBuffer : nil, chunk.heightMap,
+                                    chunk.normalMap, chunk.volume.vertexBuffer, chunk.volume.indexBuffer };
+    for (id<MTLResource> resource : resources) {
+        if (resident) {
+            m_residency->add(resource);
+        } else {
+            m_residency->remove(resource);
+        }
+    }
+}
+
+void ChunkManager::set_pipelines(const MetalContext& metal) {
+    const bool packed = m_config.vertexFormat == VertexFormat::Packed;
+    m_renderPipeline = packed ? metal.landscape_packed_pipeline : metal.landscape_pipeline;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_generationPipeline = packed ? metal.terrain_gen_packed_pipeline : metal.terrain_gen_pipeline;
+    if (gpu_erosion_supported(metal)) {
+        std::lock_guard<std::mutex> erosionLock(m_erosionMutex);
+        m_gpuErosion = create_gpu_erosion(metal);
+    }
+}
+
+size_t ChunkManager::allocated_bytes() const {
+    size_t bytes = m_lodIndexBuffer.allocatedSize + (m_vertexHeap ? m_vertexHeap->heap_bytes() : 0);
+    for (const ResidentChunk& chunk : m_resident) {
+        // Heap-placed buffers are already counted in their heap
+        if (chunk.heapSlot == NO_SLOT) {
+            bytes += chunk.mesh.vertexBuffer.allocatedSize;
+        }
+        bytes += chunk.heightMap.allocatedSize + chunk.normalMap.allocatedSize;
+        bytes += chunk.volume.vertexBuffer.allocatedSize + chunk.volume.indexBuffer.allocatedSize;
+    }
+    return bytes;
+}
+
+ChunkDraw ChunkManager::chunk_draw(const ResidentChunk& chunk) const {
+    ChunkDraw draw;
+    if (chunk.volume.vertexBuffer) {
+        draw.vertexBuffer = chunk.volume.vertexBuffer;
+        draw.indexBuffer = chunk.volume.indexBuffer;
+        draw.indexType = MTLIndexTypeUInt32;
+        draw.range = { 0, chunk.volume.indexCount };
+        draw.modelMatrix = chunk.volume.modelMatrix;
+        draw.volume = true;
+        return draw;
+    }
+    draw.vertexBuffer = chunk.mesh.vertexBuffer;
+    draw.indexBuffer = chunk.mesh.indexBuffer;
+    draw.indexType = chunk.mesh.indexType;
+    draw.range = index_range(chunk);
+    draw.modelMatrix = chunk.modelMatrix;
+    return draw;
+}
+
+size_t ChunkManager::erosion_bytes() const {
+    std::lock_guard<std::mutex> lock(m_erosionMutex);
+    return m_erosion.bytes();
+}
+
+size_t ChunkManager::biome_bytes() const {
+    size_t bytes = 0;
+    for (const ResidentChunk& chunk : m_resident) {
+        bytes += chunk.biomes.bytes();
+    }
+    return bytes;
+}
+
+size_t ChunkManager::missing_visible_chunks(const ChunkStreamingView& view, float viewDistance) const {
+    const ChunkKey center{ (int)floorf(view.position.x / m_config.chunkSize),
+                           (int)floorf(view.position.z / m_config.chunkSize) };
+    const int loadSq = m_config.loadRadius * m_config.loadRadius;
+    const float heightBound = terrain_height_bound(m_config.terrain);
+    auto wanted = [&](ChunkKey key) {
+        const BoundingBox box = { { key.x * m_config.chunkSize, -heightBound, key.z * m_config.chunkSize },
+                                  { (key.x + 1) * m_config.chunkSize, heightBound, (key.z + 1) * m_config.chunkSize } };
+        return chunk_distance_sq(key, center) <= loadSq &&
+               chunk_distance(key, m_config.chunkSize, view.position) <= viewDistance &&
+               (!view.hasFrustum || frustum_intersects(view.frustum, box));
+    };
+    // Every resident chunk is a distinct key, so the wanted ones not resident are the difference of the counts
+    size_t count = 0;
+    for (int dz = -m_config.loadRadius; dz <= m_config.loadRadius; ++dz) {
+        for (int dx = -m_config.loadRadius; dx <= m_config.loadRadius; ++dx) {
+            count += wanted({ center.x + dx, center.z + dz });
+        }
+    }
+    for (const ResidentChunk& chunk : m_resident) {
+        count -= wanted(chunk.key);
+    }
+    return count;
+}
+
+size_t ChunkManager::cancelled_requests() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cancelledRequests;
+}
+
+size_t ChunkManager::pending_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+void ChunkManager::pending_keys(std::vector<ChunkKey>& out) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out.assign(m_pending.begin(), m_pending.end());
+}
+
+size_t ChunkManager::max_resident_chunks() const {
+    size_t side = 2 * m_config.unloadRadius + 1;
+    return std::min(side * side, std::max<size_t>(m_config.memoryBudget / chunk_bytes(), 1));
+}
+
+size_t ChunkManager::chunk_bytes() const {
+    return terrain_bake_payload_bytes(bake_settings());
+}
+
+TerrainBakeSettings ChunkManager::bake_settings() const {
+    TerrainBakeSettings settings;
+    settings.chunkSize = m_config.chunkSize;
+    settings.resolution = m_config.resolution;
+    settings.vertexFormat = m_config.vertexFormat;
+    settings.heightMaps = m_config.heightMaps;
+    settings.compressed = m_config.compressTiles;
+    settings.terrain = m_config.terrain;
+    return settings;
+}
+
+TerrainEditResult ChunkManager::edit(const TerrainBrush& brush) {
+    TRACE_SCOPE("Edit terrain");
+    // The patches read the normals two points past the brush; erode their windows before taking the lock
+    const TerrainGridRect brushRect = m_edits.brush_rect(brush);
+    erode_windows(terrain_grid_rect_expand(brushRect, 2));
+    std::lock_guard<std::mutex> lock(m_editMutex);
+
+    // The brush works on the unedited heights under it; the edits hold its result as offsets
+    std::vector<float> base((size_t)brushRect.width() * brushRect.depth());
+    sample_base_heights(brushRect, base.data());
+    m_editHistory.touch(m_edits, brushRect);
+    const TerrainEditResult result = m_edits.apply(brush, base.data());
+    if (!result.changed.empty()) {
+        patch_edits_locked(result.changed);
+    }
+    return result;
+}
+
+TerrainGridRect ChunkManager::restore_edits(const TerrainEditPoint* points, size_t count) {
+    TRACE_SCOPE("Restore terrain edits");
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    // Strokes of the old edits would undo into the new ones
+    m_editHistory.clear();
+    const TerrainGridRect changed = m_edits.assign(points, count);
+    if (!changed.empty()) {
+        patch_edits_locked(changed);
+    }
+    return changed;
+}
+
+TerrainGridRect ChunkManager::write_edit_offsets(const TerrainGridRect& rect, const float* offsets) {
+    TRACE_SCOPE("Write terrain edits");
+    // As in edit(), the patches read the normals two points past the change
+    erode_windows(terrain_grid_rect_expand(rect, 2));
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    m_editHistory.touch(m_edits, rect);
+    const TerrainGridRect changed = m_edits.write_offsets(rect, offsets);
+    if (!changed.empty()) {
+        patch_edits_locked(changed);
+    }
+    return changed;
+}
+
+void ChunkManager::begin_edit_stroke() {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    m_editHistory.begin_stroke();
+}
+
+void ChunkManager::end_edit_stroke() {
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    m_editHistory.end_stroke(m_edits);
+}
+
+TerrainGridRect ChunkManager::undo_edit() {
+    TRACE_SCOPE("Undo terrain edit");
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    const TerrainGridRect changed = m_editHistory.undo(m_edits);
+    if (!changed.empty()) {
+        patch_edits_locked(changed);
+    }
+    return changed;
+}
+
+TerrainGridRect ChunkManager::redo_edit() {
+    TRACE_SCOPE("Redo terrain edit");
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    const TerrainGridRect changed = m_editHistory.redo(m_edits);
+    if (!changed.empty()) {
+        patch_edits_locked(changed);
+    }
+    return changed;
+}
+
+void ChunkManager::patch_edits_locked(const TerrainGridRect& changed) {
+    // Normals read their four neighbours, so they change one point past the heights
+    const TerrainGridRect normalRect = terrain_grid_rect_expand(changed, 1);
+    const TerrainGridRect sampleRect = terrain_grid_rect_expand(changed, 2);
+    std::vector<float> heights((size_t)sampleRect.width() * sampleRect.depth());
+    sample_base_heights(sampleRect, heights.data());
+    m_edits.apply_offsets(sampleRect, heights.data());
+    std::vector<simd::float3> normals((size_t)normalRect.width() * normalRect.depth());
+    terrain_grid_normals(heights.data(), sampleRect.width(), sampleRect.depth(), m_edits.spacing(), normals.data());
+
+    // Chunks whose grid holds a changed normal, including those being built right now, are stale
+    m_editVersion++;
+    const int cells = m_config.resolution - 1;
+    for (int kz = (int)floorf((normalRect.z0 - 1) / (float)cells); kz * cells <= normalRect.z1; ++kz) {
+        for (int kx = (int)floorf((normalRect.x0 - 1) / (float)cells); kx * cells <= normalRect.x1; ++kx) {
+            m_chunkEditVersions[{ kx, kz }] = m_editVersion;
+        }
+    }
+
+    // Volumetric chunks are meshed from all their columns at once, so they are evicted and built again
+    const TerrainGridRect volumeRect = terrain_grid_rect_expand(changed, 1);
+    auto remeshed = std::remove_if(m_resident.begin(), m_resident.end(), [&](const ResidentChunk& chunk) {
+        if (!chunk.volume.vertexBuffer ||
+            terrain_grid_rect_intersect(terrain_grid_rect_expand(chunk_grid_rect(chunk.key), 1), volumeRect).empty()) {
+            return false;
+        }
+        retire_buffers(chunk);
+        return true;
+    });
+    m_resident.erase(remeshed, m_resident.end());
+
+    size_t residentBytes = 0;
+    for (ResidentChunk& chunk : m_resident) {
+        if (!terrain_grid_rect_intersect(chunk_grid_rect(chunk.key), normalRect).empty()) {
+            patch_chunk_locked(chunk, normalRect, heights.data(), sampleRect, normals.data());
+            chunk.editVersion = m_editVersion;
+        }
+        residentBytes += chunk.bytes;
+    }
+    m_residentBytes = residentBytes;
+    m_editUploadValue = m_uploader.flush();
+}
+
+float ChunkManager::terrain_height(float x, float z) const {
+    float height = get_terrain_height(x, z, m_config.terrain);
+    if (m_erosion.enabled()) {
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        height += m_erosion.offset_at(x, z);
+    }
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    return height + m_edits.offset_at(x, z);
+}
+
+void ChunkManager::resample_height_field(HeightField& field, float minX, float minZ, float maxX, float maxZ) {
+    minX = std::max(minX, field.originX);
+    minZ = std::max(minZ, field.originZ);
+    maxX = std::min(maxX, field.originX + (field.width - 1) * field.spacing);
+    maxZ = std::min(maxZ, field.originZ + (field.depth - 1) * field.spacing);
+    if (maxX < minX || maxZ < minZ) {
+        return;
+    }
+    // Field samples between grid points blend the offsets of the points around them
+    const float spacing = m_edits.spacing();
+    erode_windows({ (int)floorf(minX / spacing), (int)floorf(minZ / spacing), (int)floorf(maxX / spacing) + 1,
+                    (int)floorf(maxZ / spacing) + 1 });
+    std::lock_guard<std::mutex> lock(m_editMutex);
+    std::lock_guard<std::mutex> erosionLock(m_erosionMutex);
+    height_field_apply_edits(field, minX, minZ, maxX, maxZ, m_edits, m_config.terrain,
+                             m_erosion.enabled() ? &m_erosion : nullptr);
+}
+
+TerrainGridRect ChunkManager::chunk_grid_rect(ChunkKey key) const {
+    // Neighbouring chunks share their border points
+    const int cells = m_config.resolution - 1;
+    return { key.x * cells, key.z * cells, (key.x + 1) * cells, (key.z + 1) * cells };
+}
+
+void ChunkManager::sample_noise_heights(const TerrainGridRect& rect, float* out) const {
+    const size_t count = (size_t)rect.width() * rect.depth();
+    const float spacing = m_edits.spacing();
+    std::vector<float> xs(count), zs(count);
+    for (int z = rect.z0, i = 0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x, ++i) {
+            xs[i] = x * spacing;
+            zs[i] = z * spacing;
+        }
+    }
+    get_terrain_heights(xs.data(), zs.data(), out, count, m_config.terrain);
+}
+
+void ChunkManager::sample_base_heights(const TerrainGridRect& rect, float* out) {
+    sample_noise_heights(rect, out);
+    if (m_erosion.enabled()) {
+        erode_windows(rect);
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        m_erosion.apply_offsets(rect, out);
+    }
+}
+
+void ChunkManager::erode_windows(const TerrainGridRect& rect) {
+    std::vector<ChunkKey> missing;
+    {
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        m_erosion.missing_windows(rect, missing);
+    }
+    // Two jobs may erode the same window at once; both get the same offsets
+    for (const ChunkKey& corner : missing) {
+        std::vector<float> offsets;
+        if (!load_erosion_window(corner, offsets)) {
+            offsets = erode_window(corner);
+            store_erosion_window(corner, offsets);
+        }
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        m_erosion.store(corner, std::move(offsets));
+    }
+}
+
+std::vector<float> ChunkManager::erode_window(ChunkKey corner) {
+    TRACE_SCOPE("Erode terrain window");
+    const TerrainGridRect rect = m_erosion.simulated_rect(corner);
+    std::vector<float> uneroded((size_t)rect.width() * rect.depth());
+    sample_noise_heights(rect, uneroded.data());
+    std::vector<float> eroded = uneroded;
+
+    GpuErosion gpuErosion;
+    {
+        std::lock_guard<std::mutex> lock(m_erosionMutex);
+        gpuErosion = m_gpuErosion;
+    }
+    if (gpuErosion.flux) {
+        gpu_erode_heights(gpuErosion, m_generationQueue, eroded.data(), rect.width(), rect.depth(), m_edits.spacing(),
+                          m_config.erosion);
+    } else {
+        erode_heights(eroded.data(), rect.width(), rect.depth(), m_edits.spacing(), m_config.erosion);
+    }
+    return erosion_window_offsets(uneroded.data(), eroded.data(), m_config.resolution - 1, m_config.erosion.margin);
+}
+
+bool ChunkManager::load_erosion_window(ChunkKey corner, std::vector<float>& offsets) const {
+    if (m_tileDirectory.empty()) {
+        return false;
+    }
+    const size_t count = (size_t)(2 * m_config.resolution - 1) * (2 * m_config.resolution - 1);
+    TerrainTile tile;
+    if (!map_terrain_tile(terrain_erosion_tile_path(m_tileDirectory, corner), m_tileGeneratorKey, corner,
+                          count * sizeof(float), tile)) {
+        return false;
+    }
+    offsets.assign((const float*)tile.data, (const float*)tile.data + count);
+    unmap_terrain_tile(tile);
+    return true;
+}
+
+void ChunkManager::store_erosion_window(ChunkKey corner, const std::vector<float>& offsets) const {
+    if (m_tileDirectory.empty()) {
+        return;
+    }
+    TerrainTileFooter footer;
+    footer.generatorKey = m_tileGeneratorKey;
+    footer.chunkX = corner.x;
+    footer.chunkZ = corner.z;
+    footer.vertexBytes = offsets.size() * sizeof(float);
+    if (!write_terrain_tile(terrain_erosion_tile_path(m_tileDirectory, corner), footer, offsets.data())) {
+        NSLog(@"Failed to write the erosion tile of corner %d, %d", corner.x, corner.z);
+    }
+}
+
+void ChunkManager::apply_edits_locked(ChunkKey key, Vertex* vertices) {
+    // Same one-point apron as build_terrain_chunk_vertices(), so border normals match the neighbours
+    const int res = m_config.resolution;
+    const TerrainGridRect apron = terrain_grid_rect_expand(chunk_grid_rect(key), 1);
+    std::vector<float> heights((size_t)apron.width() * apron.depth());
+    sample_base_heights(apron, heights.data());
+    m_edits.apply_offsets(apron, heights.data());
+    std::vector<simd::float3> normals((size_t)res * res);
+    terrain_grid_normals(heights.data(), apron.width(), apron.depth(), m_edits.spacing(), normals.data());
+
+    for (int z = 0; z < res; ++z) {
+        for (int x = 0; x < res; ++x) {
+            Vertex& vertex = vertices[z * res + x];
+            vertex.position.y = heights[(z + 1) * apron.width() + x + 1];
+            vertex.normal = normals[z * res + x];
+        }
+    }
+}
+
+void ChunkManager::patch_chunk_locked(ResidentChunk& chunk, const TerrainGridRect& normalRect, const float* heights,
+                                      const TerrainGridRect& sampleRect, const simd::float3* normals) {
+    const int res = m_config.resolution;
+    const TerrainGridRect chunkRect = chunk_grid_rect(chunk.key);
+    const TerrainGridRect rect = terrain_grid_rect_intersect(chunkRect, normalRect);
+    const float step = m_config.chunkSize / (float)(res - 1);
+    auto height_at = [&](int x, int z) {
+        return heights[(z - sampleRect.z0) * sampleRect.width() + (x - sampleRect.x0)];
+    };
+    auto normal_at = [&](int x, int z) {
+        return normals[(z - normalRect.z0) * normalRect.width() + (x - normalRect.x0)];
+    };
+
+    if (m_config.heightMaps) {
+        std::vector<uint16_t> texelHeights((size_t)rect.width() * rect.depth());
+        std::vector<int8_t> texelNormals(texelHeights.size() * 2);
+        for (int z = rect.z0, i = 0; z <= rect.z1; ++z) {
+            for (int x = rect.x0; x <= rect.x1; ++x, ++i) {
+                texelHeights[i] = float_to_half(height_at(x, z));
+                encode_terrain_normal(normal_at(x, z), &texelNormals[i * 2]);
+            }
+        }
+        const MTLRegion region = MTLRegionMake2D(rect.x0 - chunkRect.x0, rect.z0 - chunkRect.z0, rect.width(),
+                                                 rect.depth());
+        m_uploader.update_texture(chunk.heightMap, region, texelHeights.data(), rect.width() * sizeof(uint16_t));
+        m_uploader.update_texture(chunk.normalMap, region, texelNormals.data(), rect.width() * 2);
+    } else if (chunk.mesh.vertexBuffer.storageMode != MTLStorageModePrivate) {
+        // A mapped tile is read-only and would be stale anyway, so the chunk is rebuilt into a private buffer
+        std::vector<Vertex> vertices((size_t)res * res);
+        build_terrain_chunk_vertices(chunk.key.x, chunk.key.z, res, m_config.chunkSize, vertices.data(),
+                                     m_config.terrain);
+        apply_edits_locked(chunk.key, vertices.data());
+        const size_t vertexBytes = vertices.size() * vertex_stride(m_config.vertexFormat);
+        if (m_config.vertexFormat == VertexFormat::Packed) {
+            std::vector<PackedVertex> packed(vertices.size());
+            pack_vertices(vertices.data(), vertices.size(),
+                          terrain_chunk_quantization_box(chunk.key.x, chunk.key.z, m_config.chunkSize, m_config.terrain),
+                          packed.data());
+            chunk.mesh.vertexBuffer = m_uploader.upload(packed.data(), vertexBytes, @"Terrain chunk");
+        } else {
+            chunk.mesh.vertexBuffer = m_uploader.upload(vertices.data(), vertexBytes, @"Terrain chunk");
+        }
+        chunk.bytes = vertexBytes;
+    } else {
+        // One copy per row of the patch, straight into the chunk's vertex buffer
+        const QuantizationBox box =
+            terrain_chunk_quantization_box(chunk.key.x, chunk.key.z, m_config.chunkSize, m_config.terrain);
+        const size_t stride = vertex_stride(m_config.vertexFormat);
+        std::vector<Vertex> row(rect.width());
+        std::vector<PackedVertex> packedRow(m_config.vertexFormat == VertexFormat::Packed ? row.size() : 0);
+        for (int z = rect.z0; z <= rect.z1; ++z) {
+            for (int x = rect.x0; x <= rect.x1; ++x) {
+                row[x - rect.x0] = { { chunk.key.x * m_config.chunkSize + (x - chunkRect.x0) * step, height_at(x, z),
+                                       chunk.key.z * m_config.chunkSize + (z - chunkRect.z0) * step },
+                                     normal_at(x, z) };
+            }
+            const void* data = row.data();
+            if (!packedRow.empty()) {
+                pack_vertices(row.data(), row.size(), box, packedRow.data());
+                data = packedRow.data();
+            }
+            const size_t first = (size_t)(z - chunkRect.z0) * res + (rect.x0 - chunkRect.x0);
+            m_uploader.update(chunk.mesh.vertexBuffer, first * stride, data, row.size() * stride);
+        }
+    }
+
+    // Remeasure the LOD metrics; they depend on every height of the chunk
+    std::vector<float> chunkHeights((size_t)res * res);
+    sample_base_heights(chunkRect, chunkHeights.data());
+    m_edits.apply_offsets(chunkRect, chunkHeights.data());
+    chunk.lod = compute_chunk_lod_info(chunkHeights.data(), res);
+    chunk.bounds.min.y = chunk.lod.minHeight;
+    chunk.bounds.max.y = chunk.lod.maxHeight;
+}
+
+void ChunkManager::generate_requests() {
+    for (;;) {
+        ChunkKey key;
+        AssetPriority priority;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // Over the frame's upload budget the job stops; update() starts jobs again next frame
+            const size_t budget = m_config.schedule.uploadBytesPerFrame;
+            if (m_stopping || m_requests.empty() || (budget > 0 && m_frameUploadBytes >= budget)) {
+                m_activeJobs--;
+                return;
+            }
+            key = m_requests.front();
+            m_requests.pop_front();
+            m_frameUploadBytes += chunk_bytes();
+            // The camera's chunk and its neighbours are what the next frames draw
+            priority = chunk_distance_sq(key, m_center) <= 2 ? AssetPriority::High : AssetPriority::Normal;
+        }
+
+        ResidentChunk chunk = generate_chunk(key, priority);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished.push_back(chunk);
+    }
+}
+
+ResidentChunk ChunkManager::generate_chunk(ChunkKey key, AssetPriority priority) {
+    ResidentChunk chunk;
+    chunk.key = key;
+    if (m_config.heightMaps) {
+        chunk.modelMatrix = terrain_height_map_matrix(key.x, key.z, m_config.resolution, m_config.chunkSize);
+    } else if (m_config.vertexFormat == VertexFormat::Packed) {
+        chunk.modelMatrix =
+            quantization_matrix(terrain_chunk_quantization_box(key.x, key.z, m_config.chunkSize, m_config.terrain));
+    } else {
+        chunk.modelMatrix = matrix_translation(0, 0, 0);
+    }
+    chunk.biomes = generate_biome_map(m_config.biomes, key, m_config.chunkSize, m_config.terrain);
+    // Tiles and the generation kernel only know the unedited terrain
+    bool edited;
+    {
+        std::lock_guard<std::mutex> lock(m_editMutex);
+        chunk.editVersion = m_editVersion;
+        edited = m_edits.touches(terrain_grid_rect_expand(chunk_grid_rect(key), 1));
+    }
+    @autoreleasepool {
+        if (!edited && load_tile(chunk, priority)) {
+            // Read from the tile cache; nothing to generate or upload
+        } else if (!edited && m_config.generateOnGpu) {
+            generate_on_gpu(chunk);
+        } else {
+            if (m_erosion.enabled()) {
+                // Outside the edit lock, which height queries take
+                erode_windows(terrain_grid_rect_expand(chunk_grid_rect(key), 1));
+            }
+            generate_on_cpu(chunk, edited);
+        }
+        chunk.mesh.indexBuffer = m_lodIndexBuffer;
+        chunk.mesh.indexCount = m_lodIndices.range(0, 0).count;
+        chunk.mesh.indexType = m_lodIndexType;
+        chunk.bounds = { { key.x * m_config.chunkSize, chunk.lod.minHeight, key.z * m_config.chunkSize },
+                         { (key.x + 1) * m_config.chunkSize, chunk.lod.maxHeight, (key.z + 1) * m_config.chunkSize } };
+        if (m_config.volume.enabled) {
+            build_volume(chunk);
+        }
+    }
+    return chunk;
+}
+
+void ChunkManager::generate_on_gpu(ResidentChunk& chunk) {
+    const uint32_t res = m_config.resolution;
+    const size_t count = res * res;
+    const bool packed = m_config.vertexFormat == VertexFormat::Packed;
+    TerrainNoiseMapping mapping = terrain_noise_mapping(m_config.terrain);
+    QuantizationBox box =
+        terrain_chunk_quantization_box(chunk.key.x, chunk.key.z, m_config.chunkSize, m_config.terrain);
+
+    TerrainGenParams params;
+    params.origin = { chunk.key.x * m_config.chunkSize, chunk.key.z * m_config.chunkSize };
+    params.step = m_config.chunkSize / (float)(res - 1);
+    params.resolution = res;
+    params.noiseOffset = mapping.offset;
+    params.noiseScale = mapping.scale;
+    params.heightScale = mapping.heightScale;
+    params.quantMinY = box.origin.y;
+    params.quantExtentY = box.extent.y;
+    params.noise = mapping.noise;
+
+    const size_t vertexBytes = count * vertex_stride(m_config.vertexFormat);
+    chunk.mesh.vertexBuffer = m_vertexHeap->allocate(chunk.heapSlot);
+    id<MTLBuffer> heights = [m_device newBufferWithLength:count * sizeof(float)
+                                                  options:MTLResourceStorageModeShared];
+    // A private vertex buffer is copied back only to write its tile; a shared one is read in place
+    id<MTLBuffer> readback = m_tileDirectory.empty() || m_sharedVertices ? nil
+        : [m_device newBufferWithLength:vertexBytes options:MTLResourceStorageModeShared];
+
+    id<MTLComputePipelineState> pipeline = nil;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pipeline = m_generationPipeline;
+    }
+    id<MTLCommandBuffer> cmd = [m_generationQueue commandBuffer];
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    [enc setComputePipelineState:pipeline];
+    [enc setBytes:&params length:sizeof(params) atIndex:0];
+    [enc setBuffer:chunk.mesh.vertexBuffer offset:0 atIndex:packed ? 3 : 1];
+    [enc setBuffer:heights offset:0 atIndex:2];
+    [enc dispatchThreads:MTLSizeMake(res, res, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    [enc endEncoding];
+    if (readback) {
+        id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+        [blit copyFromBuffer:chunk.mesh.vertexBuffer sourceOffset:0 toBuffer:readback destinationOffset:0
+                        size:vertexBytes];
+        [blit endEncoding];
+    }
+    [cmd commit];
+
+    // Only this job waits; the heights feed the LOD error metrics
+    [cmd waitUntilCompleted];
+
+    chunk.lod = compute_chunk_lod_info((const float*)heights.contents, res);
+    chunk.bytes = vertexBytes;
+    if (readback) {
+        store_tile(chunk, readback.contents);
+    } else if (!m_tileDirectory.empty()) {
+        store_tile(chunk, chunk.mesh.vertexBuffer.contents);
+    }
+}
+
+void ChunkManager::generate_on_cpu(ResidentChunk& chunk, bool edited) {
+    TRACE_SCOPE("Generate chunk");
+    if (m_sharedVertices) {
+        generate_in_place(chunk, edited);
+        return;
+    }
+    const int res = m_config.resolution;
+    // Chunks draw with the LOD index buffer, so only vertices are built
+    std::vector<Vertex> vertices(terrain_chunk_mesh_size(res).vertexCount);
+    build_terrain_chunk_vertices(chunk.key.x, chunk.key.z, res, m_config.chunkSize, vertices.data(),
+                                 m_config.terrain);
+    // Eroded heights and normals replace the generated ones the same way edited ones do
+    if (edited || m_erosion.enabled()) {
+        std::lock_guard<std::mutex> lock(m_editMutex);
+        apply_edits_locked(chunk.key, vertices.data());
+    }
+
+    // The payload is the tile's: height-map texels or vertices in the chunk's format
+    std::vector<uint8_t> payload;
+    chunk.lod = encode_terrain_bake_payload(chunk.key, vertices.data(), bake_settings(), payload);
+    if (m_config.heightMaps) {
+        const size_t heightBytes = (size_t)res * res * sizeof(uint16_t);
+        upload_height_map(chunk, (const uint16_t*)payload.data(), (const int8_t*)(payload.data() + heightBytes));
+    } else {
+        chunk.mesh.vertexBuffer = m_vertexHeap->allocate(chunk.heapSlot);
+        m_uploader.update(chunk.mesh.vertexBuffer, 0, payload.data(), payload.size());
+        chunk.uploadValue = m_uploader.flush_throttled();
+        chunk.bytes = payload.size();
+    }
+    if (!m_tileDirectory.empty() && !edited) {
+        store_tile(chunk, payload.data());
+    }
+}
+
+// The chunk's shared buffer is fresh from the heap and the GPU does not see it before the chunk is published,
+// so the vertices are written into it directly: float ones are built there, packed ones are packed there
+// from a single scratch copy, and nothing is staged, blitted or kept on the CPU
+void ChunkManager::generate_in_place(ResidentChunk& chunk, bool edited) {
+    const int res = m_config.resolution;
+    chunk.mesh.vertexBuffer = m_vertexHeap->allocate(chunk.heapSlot);
+    void* contents = chunk.mesh.vertexBuffer.contents;
+    std::vector<Vertex> scratch;
+    Vertex* vertices = (Vertex*)contents;
+    if (m_config.vertexFormat == VertexFormat::Packed) {
+        scratch.resize(terrain_chunk_mesh_size(res).vertexCount);
+        vertices = scratch.data();
+    }
+    build_terrain_chunk_vertices(chunk.key.x, chunk.key.z, res, m_config.chunkSize, vertices, m_config.terrain);
+    if (edited || m_erosion.enabled()) {
+        std::lock_guard<std::mutex> lock(m_editMutex);
+        apply_edits_locked(chunk.key, vertices);
+    }
+    chunk.lod = encode_terrain_bake_payload(chunk.key, vertices, bake_settings(), contents);
+    chunk.bytes = chunk_bytes();
+    if (!m_tileDirectory.empty() && !edited) {
+        store_tile(chunk, contents);
+    }
+}
+
+bool ChunkManager::load_tile(ResidentChunk& chunk, AssetPriority priority) {
+    if (m_tileDirectory.empty()) {
+        return false;
+    }
+    const size_t vertexBytes = chunk_bytes();
+    const std::string path = terrain_tile_path(m_tileDirectory, chunk.key);
+
+    if (m_config.compressTiles && m_sharedVertices) {
+        // Decoded on this job straight into the chunk's shared buffer
+        TerrainTileFooter footer;
+        chunk.mesh.vertexBuffer = m_vertexHeap->allocate(chunk.heapSlot);
+        if (!read_terrain_tile(path, m_tileGeneratorKey, chunk.key, vertexBytes, chunk.mesh.vertexBuffer.contents,
+                               footer)) {
+            m_vertexHeap->release(chunk.heapSlot);
+            chunk.heapSlot = NO_SLOT;
+            chunk.mesh.vertexBuffer = nil;
+            return false;
+        }
+        chunk.lod = footer.lod;
+        chunk.bytes = vertexBytes;
+        return true;
+    }
+    if (m_config.compressTiles) {
+        // Decoded on this job and uploaded as if generated
+        std::vector<uint8_t> decoded(vertexBytes);
+        TerrainTileFooter footer;
+        if (!read_terrain_tile(path, m_tileGeneratorKey, chunk.key, vertexBytes, decoded.data(), footer)) {
+            return false;
+        }
+        chunk.lod = footer.lod;
+        if (m_config.heightMaps) {
+            const size_t heightBytes = (size_t)m_config.resolution * m_config.resolution * sizeof(uint16_t);
+            upload_height_map(chunk, (const uint16_t*)decoded.data(), (const int8_t*)(decoded.data() + heightBytes));
+            return true;
+        }
+        chunk.mesh.vertexBuffer = m_vertexHeap->allocate(chunk.heapSlot);
+        m_uploader.update(chunk.mesh.vertexBuffer, 0, decoded.data(), vertexBytes);
+        chunk.uploadValue = m_uploader.flush_throttled();
+        chunk.bytes = vertexBytes;
+        return true;
+    }
+
+    if (m_config.heightMaps) {
+        // Textures cannot alias the mapping, so the texels are copied out and the tile unmapped
+        TerrainTile tile;
+        if (!map_terrain_tile(path, m_tileGeneratorKey, chunk.key, vertexBytes, tile)) {
+            return false;
+        }
+        const size_t heightBytes = (size_t)m_config.resolution * m_config.resolution * sizeof(uint16_t);
+        upload_height_map(chunk, (const uint16_t*)tile.data, (const int8_t*)((const uint8_t*)tile.data + heightBytes));
+        chunk.lod = tile.footer.lod;
+        unmap_terrain_tile(tile);
+        return true;
+    }
+
+    if (m_assets) {
+        // Stream the vertices straight into a private buffer; update() publishes the chunk once they land
+        TerrainTileFooter footer;
+        if (!read_terrain_tile_footer(path, m_tileGeneratorKey, chunk.key, vertexBytes, footer)) {
+            return false;
+        }
+        id<MTLBuffer> buffer = m_vertexHeap->allocate(chunk.heapSlot);
+        AssetLoad load = m_assets->load_buffer(path, 0, vertexBytes, buffer, 0, priority);
+        if (!load.commands) {
+            m_vertexHeap->release(chunk.heapSlot);
+            chunk.heapSlot = NO_SLOT;
+            return false;
+        }
+        chunk.mesh.vertexBuffer = buffer;
+        chunk.tileLoad = load;
+        chunk.lod = footer.lod;
+        chunk.bytes = vertexBytes;
+        return true;
+    }
+
+    TerrainTile tile;
+    if (!map_terrain_tile(path, m_tileGeneratorKey, chunk.key, vertexBytes, tile)) {
+        return false;
+    }
+
+    // The buffer reads the mapped pages in place and unmaps them when it is released
+    chunk.mesh.vertexBuffer = [m_device newBufferWithBytesNoCopy:tile.data
+                                                          length:tile.length
+                                                         options:MTLResourceStorageModeShared
+                                                     deallocator:^(void* pointer, NSUInteger length) {
+                                                         munmap(pointer, length);
+                                                     }];
+    if (!chunk.mesh.vertexBuffer) {
+        unmap_terrain_tile(tile);
+        return false;
+    }
+    chunk.lod = tile.footer.lod;
+    chunk.bytes = tile.length;
+    return true;
+}
+
+void ChunkManager::upload_height_map(ResidentChunk& chunk, const uint16_t* heights, const int8_t* normals) {
+    const NSUInteger res = (NSUInteger)m_config.resolution;
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR16Float
+                                                                                    width:res
+                                                                                   height:res
+                                                                                mipmapped:NO];
+    desc.usage = MTLTextureUsageShaderRead;
+    chunk.heightMap = m_uploader.upload_texture(desc, heights, res * sizeof(uint16_t), @"Terrain heights");
+    desc.pixelFormat = MTLPixelFormatRG8Snorm;
+    chunk.normalMap = m_uploader.upload_texture(desc, normals, res * 2, @"Terrain normals");
+    chunk.uploadValue = m_uploader.flush_throttled();
+    chunk.bytes = chunk_bytes();
+}
+
+void ChunkManager::build_volume(ResidentChunk& chunk) {
+    TRACE_SCOPE("Mesh chunk volume");
+    // The columns one point around the chunk, eroded and edited as its height field is
+    const TerrainGridRect rect = terrain_grid_rect_expand(chunk_grid_rect(chunk.key), 1);
+    std::vector<float> heights((size_t)rect.width() * rect.depth());
+    sample_base_heights(rect, heights.data());
+    {
+        std::lock_guard<std::mutex> lock(m_editMutex);
+        m_edits.apply_offsets(rect, heights.data());
+    }
+
+    VolumeChunkInput input;
+    input.cells = m_config.resolution - 1;
+    input.spacing = m_edits.spacing();
+    input.gridX = chunk.key.x * input.cells;
+    input.gridZ = chunk.key.z * input.cells;
+    input.origin = { chunk.key.x * m_config.chunkSize, chunk.key.z * m_config.chunkSize };
+    input.heights = heights.data();
+    VolumeMesh mesh;
+    if (!build_volume_mesh(m_config.volume, input, mesh) || mesh.indices.empty()) {
+        return;
+    }
+
+    // The mesh reaches half a cell past the chunk where it overlaps a height-field neighbour
+    const simd::float3 boxMin = { input.origin.x - input.spacing, mesh.minY, input.origin.y - input.spacing };
+    const simd::float3 boxMax = { input.origin.x + m_config.chunkSize + input.spacing, mesh.maxY,
+                                   input.origin.y + m_config.chunkSize + input.spacing };
+    const size_t vertexBytes = mesh.vertices.size() * vertex_stride(m_config.vertexFormat);
+    if (m_config.vertexFormat == VertexFormat::Packed) {
+        QuantizationBox box;
+        box.origin = boxMin;
+        box.extent = simd::max(boxMax - boxMin, 1e-3f);
+        std::vector<PackedVertex> packed(mesh.vertices.size());
+        pack_vertices(mesh.vertices.data(), mesh.vertices.size(), box, packed.data());
+        chunk.volume.vertexBuffer = m_uploader.upload(packed.data(), vertexBytes, @"Terrain volume");
+        chunk.volume.modelMatrix = quantization_matrix(box);
+    } else {
+        chunk.volume.vertexBuffer = m_uploader.upload(mesh.vertices.data(), vertexBytes, @"Terrain volume");
+        chunk.volume.modelMatrix = matrix_translation(0, 0, 0);
+    }
+    const size_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+    chunk.volume.indexBuffer = m_uploader.upload(mesh.indices.data(), indexBytes, @"Terrain volume indices");
+    chunk.volume.indexCount = (uint32_t)mesh.indices.size();
+    chunk.volume.bricks = mesh.bricks;
+    chunk.uploadValue = std::max(chunk.uploadValue, m_uploader.flush_throttled());
+    chunk.bytes += vertexBytes + indexBytes;
+    chunk.bounds.min = simd::min(chunk.bounds.min, boxMin);
+    chunk.bounds.max = simd::max(chunk.bounds.max, boxMax);
+}
+
+void ChunkManager::store_tile(const ResidentChunk& chunk, const void* payload) {
+    const TerrainTileFooter footer = terrain_bake_footer(bake_settings(), m_tileGeneratorKey, chunk.key, chunk.lod);
+    if (!write_terrain_tile(terrain_tile_path(m_tileDirectory, chunk.key), footer, payload)) {
+        NSLog(@"Failed to write the terrain tile of chunk %d, %d", chunk.key.x, chunk.key.z);
+    }
+}
@@ -0,0 +1,101 @@
+#include "chunk_schedule.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Along the predicted path every chunk is at distance 0, so a share of the distance to the camera breaks ties
+    constexpr float CAMERA_DISTANCE_SHARE = 0.1f;
+
+    float point_segment_distance(simd::float2 p, simd::float2 a, simd::float2 b) {
+        const simd::float2 ab = b - a;
+        const float lengthSq = simd::dot(ab, ab);
+        const float t = lengthSq > 0.0f ? std::clamp(simd::dot(p - a, ab) / lengthSq, 0.0f, 1.0f) : 0.0f;
+        return simd::length(p - (a + ab * t));
+    }
+
+    // Clips the segment against the square's slabs
+    bool segment_crosses_square(simd::float2 a, simd::float2 b, simd::float2 lo, simd::float2 hi) {
+        float enter = 0.0f, leave = 1.0f;
+        for (int axis = 0; axis < 2; ++axis) {
+            const float d = b[axis] - a[axis];
+            if (fabsf(d) < 1e-9f) {
+                if (a[axis] < lo[axis] || a[axis] > hi[axis]) {
+                    return false;
+                }
+                continue;
+            }
+            float t0 = (lo[axis] - a[axis]) / d;
+            float t1 = (hi[axis] - a[axis]) / d;
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            enter = std::max(enter, t0);
+            leave = std::min(leave, t1);
+            if (enter > leave) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float square_segment_distance(simd::float2 lo, simd::float2 hi, simd::float2 a, simd::float2 b) {
+        if (segment_crosses_square(a, b, lo, hi)) {
+            return 0.0f;
+        }
+        // Apart, the nearest pair is an end of the segment against the square or a corner against the segment
+        auto to_square = [&](simd::float2 p) {
+            const float dx = std::max({ lo.x - p.x, p.x - hi.x, 0.0f });
+            const float dz = std::max({ lo.y - p.y, p.y - hi.y, 0.0f });
+            return sqrtf(dx * dx + dz * dz);
+        };
+        float distance = std::min(to_square(a), to_square(b));
+        const simd::float2 corners[4] = { lo, { hi.x, lo.y }, { lo.x, hi.y }, hi };
+        for (const simd::float2& corner : corners) {
+            distance = std::min(distance, point_segment_distance(corner, a, b));
+        }
+        return distance;
+    }
+}
+
+ChunkStreamingView chunk_streaming_view(simd::float3 position, simd::float3 previous, float dt,
+                                        const simd::float4x4& viewProjection) {
+    ChunkStreamingView view;
+    view.position = position;
+    if (dt > 0.0f) {
+        view.velocity = (position - previous) / dt;
+    }
+    view.frustum = extract_frustum(viewProjection);
+    view.hasFrustum = true;
+    return view;
+}
+
+simd::float3 predict_camera_position(const ChunkStreamingView& view, float lookahead) {
+    return { view.position.x + view.velocity.x * lookahead, view.position.y,
+             view.position.z + view.velocity.z * lookahead };
+}
+
+float chunk_distance(ChunkKey key, float chunkSize, simd::float3 position) {
+    const float x0 = key.x * chunkSize;
+    const float z0 = key.z * chunkSize;
+    const float dx = std::max({ x0 - position.x, position.x - (x0 + chunkSize), 0.0f });
+    const float dz = std::max({ z0 - position.z, position.z - (z0 + chunkSize), 0.0f });
+    return sqrtf(dx * dx + dz * dz);
+}
+
+float chunk_request_priority(ChunkKey key, float chunkSize, float heightBound, const ChunkStreamingView& view,
+                             const ChunkScheduleSettings& settings) {
+    const simd::float3 predicted = predict_camera_position(view, settings.lookahead);
+    const simd::float2 lo = { key.x * chunkSize, key.z * chunkSize };
+    const simd::float2 hi = { lo.x + chunkSize, lo.y + chunkSize };
+    const float path = square_segment_distance(lo, hi, { view.position.x, view.position.z },
+                                               { predicted.x, predicted.z });
+    float priority = path + CAMERA_DISTANCE_SHARE * chunk_distance(key, chunkSize, view.position);
+    if (view.hasFrustum) {
+        const BoundingBox box = { { lo.x, -heightBound, lo.y }, { hi.x, heightBound, hi.y } };
+        if (!frustum_intersects(view.frustum, box)) {
+            priority *= settings.offscreenFactor;
+        }
+    }
+    return priority;
+}
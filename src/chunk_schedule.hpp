@@ -0,0 +1,71 @@
+/**
+ * @file chunk_schedule.hpp
+ * @brief The order ChunkManager generates chunks in, from where the camera is going and where it looks.
+ *
+ * Loading by distance alone lets a fast camera outrun the terrain: the chunks ahead of it are
+ * requested only once they come within the load radius, and then queue behind the ones at its
+ * sides and back. The scheduler instead extrapolates the camera's velocity over a lookahead,
+ * wants the chunks within the load radius of that predicted position as well, and ranks every
+ * request by its distance to the path between the two positions, so chunks the camera is
+ * about to cross come first. Chunks outside the view frustum count as farther, and requests
+ * that left both load circles are dropped before a job picks them up.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+
+#include "frustum.hpp"
+#include "landscape.hpp"
+
+/**
+ * @struct ChunkScheduleSettings
+ * @brief Tunables of the chunk scheduler.
+ */
+struct ChunkScheduleSettings {
+    float lookahead = 1.0f;                 ///< Seconds of camera motion predicted; 0 schedules by distance alone.
+    float offscreenFactor = 2.0f;           ///< Chunks outside the frustum count as this many times farther.
+    size_t uploadBytesPerFrame = 1 << 20;   ///< Chunk bytes jobs may start generating per update(); 0 for no cap.
+};
+
+/**
+ * @struct ChunkStreamingView
+ * @brief What the scheduler knows about the camera in one update.
+ */
+struct ChunkStreamingView {
+    simd::float3 position = { 0.0f, 0.0f, 0.0f };   ///< The camera position in world space.
+    simd::float3 velocity = { 0.0f, 0.0f, 0.0f };   ///< World units per second; zero for a still camera.
+    Frustum frustum = {};                           ///< The view frustum; only used with hasFrustum.
+    bool hasFrustum = false;                        ///< Rank chunks outside the frustum lower.
+};
+
+/**
+ * @brief Describes a camera from two consecutive positions.
+ * @param position The camera position this frame.
+ * @param previous The camera position last frame.
+ * @param dt Seconds between the two; the velocity is zero unless positive.
+ * @param viewProjection The camera's projectionMatrix * viewMatrix.
+ * @return The view, with a frustum.
+ */
+ChunkStreamingView chunk_streaming_view(simd::float3 position, simd::float3 previous, float dt,
+                                        const simd::float4x4& viewProjection);
+
+/// @return Where the camera is predicted to be after the lookahead; only x and z move.
+simd::float3 predict_camera_position(const ChunkStreamingView& view, float lookahead);
+
+/// @return The horizontal distance from a point to the nearest point of a chunk's square.
+float chunk_distance(ChunkKey key, float chunkSize, simd::float3 position);
+
+/**
+ * @brief Ranks a chunk request; lower values are generated first.
+ * @param key The chunk.
+ * @param chunkSize The chunk edge length in world units.
+ * @param heightBound The largest terrain height magnitude, which bounds the chunk's box for the frustum test.
+ * @param view The camera.
+ * @param settings The scheduler's tunables.
+ * @return The horizontal distance in world units from the chunk to the camera's predicted path, scaled by
+ *         offscreenFactor if the chunk lies outside the frustum.
+ */
+float chunk_request_priority(ChunkKey key, float chunkSize, float heightBound, const ChunkStreamingView& view,
+                             const ChunkScheduleSettings& settings);
@@ -0,0 +1,73 @@
+#include "clipmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ClipmapGrid clipmap_grid(uint32_t gridSize) {
+    ClipmapGrid grid;
+    const uint32_t stride = gridSize + 1;
+    const uint32_t holeStart = gridSize / 4;
+    const uint32_t holeEnd = gridSize - gridSize / 4;
+    for (int ring = 0; ring < 2; ++ring) {
+        for (uint32_t row = 0; row < gridSize; ++row) {
+            for (uint32_t column = 0; column < gridSize; ++column) {
+                if (ring && row >= holeStart && row < holeEnd && column >= holeStart && column < holeEnd) {
+                    continue;
+                }
+                // Every quad is split along the same diagonal, so a level whose odd vertices have
+                // slid away is triangulated exactly like the next one
+                const uint16_t a = (uint16_t)(row * stride + column);
+                const uint16_t b = (uint16_t)(a + 1);
+                const uint16_t c = (uint16_t)(a + stride);
+                const uint16_t d = (uint16_t)(c + 1);
+                grid.indices.insert(grid.indices.end(), { a, c, d, a, d, b });
+            }
+        }
+        if (!ring) {
+            grid.fullCount = (uint32_t)grid.indices.size();
+        }
+    }
+    grid.ringCount = (uint32_t)grid.indices.size() - grid.fullCount;
+    return grid;
+}
+
+uint32_t clipmap_level_count(uint32_t gridSize, float cellSize, float extent) {
+    uint32_t count = 1;
+    float reach = 0.5f * gridSize * cellSize;
+    while (reach < extent && count < CLIPMAP_MAX_LEVELS) {
+        reach *= 2.0f;
+        count++;
+    }
+    return count;
+}
+
+void clipmap_place(float cellSize, uint32_t levelCount, simd::float2 eye, float texelSize, ClipmapLevel* levels) {
+    for (uint32_t l = 0; l < levelCount; ++l) {
+        ClipmapLevel& level = levels[l];
+        level.cellSize = cellSize * (float)(1u << l);
+        // Snapped to twice the cell, so the odd vertices of the outer edge can slide onto the next lattice
+        const float snap = 2.0f * level.cellSize;
+        level.center = { roundf(eye.x / snap) * snap, roundf(eye.y / snap) * snap };
+        level.innerShift = l == 0 ? simd::float2{ 0.0f, 0.0f } : (levels[l - 1].center - level.center) / level.cellSize;
+        level.lod = std::max(log2f(level.cellSize / texelSize), 0.0f);
+        level.nextLod = std::max(log2f(2.0f * level.cellSize / texelSize), 0.0f);
+    }
+}
+
+simd::float3 clipmap_point(const ClipmapLevel& level, uint32_t gridSize, uint32_t vertex) {
+    const int half = (int)gridSize / 2;
+    const int quarter = (int)gridSize / 4;
+    const int i = (int)(vertex % (gridSize + 1)) - half;
+    const int j = (int)(vertex / (gridSize + 1)) - half;
+
+    // The ring's inner edge, and the band of vertices in line with it, follow the inner level
+    float x = (float)i + (std::abs(i) <= quarter ? level.innerShift.x : 0.0f);
+    float z = (float)j + (std::abs(j) <= quarter ? level.innerShift.y : 0.0f);
+
+    // Across the outer quarter the odd vertices slide onto their even neighbours, reaching them at the edge
+    const float r = (float)std::max(std::abs(i), std::abs(j));
+    const float morph = std::clamp((r - 0.375f * gridSize) / (0.125f * gridSize), 0.0f, 1.0f);
+    x -= morph * (x - 2.0f * floorf(0.5f * x));
+    z -= morph * (z - 2.0f * floorf(0.5f * z));
+    return { level.center.x + x * level.cellSize, level.center.y + z * level.cellSize, morph };
+}
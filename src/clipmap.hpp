@@ -0,0 +1,81 @@
+/**
+ * @file clipmap.hpp
+ * @brief The nested grids of a geometry clipmap, shared by the ocean and the clipmap terrain.
+ *
+ * A geometry clipmap draws a surface as nested square grids around the camera, each with cells
+ * twice as large as the one inside it and a hole where that one lies. Every level is snapped to
+ * its own coarser lattice, so vertices only ever sit on fixed world positions and what they
+ * sample does not swim. The ring vertices bordering the inner level move with it, and across the
+ * outer quarter of each level the odd vertices slide onto the lattice of the next one, so
+ * neighbouring levels meet without cracks. Every level draws the same index list and places its
+ * vertices from their IDs, so the whole surface is two draws however large it is.
+ *
+ * The functions here are a reference for clipmap_point in shaders.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+/// Most levels a clipmap may have.
+constexpr uint32_t CLIPMAP_MAX_LEVELS = 8;
+
+/**
+ * @struct ClipmapLevel
+ * @brief Where one clipmap level lies this frame; matches ClipmapLevel in shaders.metal.
+ */
+struct ClipmapLevel {
+    simd::float2 center;        ///< World x/z of the grid centre, a multiple of twice cellSize.
+    simd::float2 innerShift;    ///< Offset of the inner level's centre from this one, in cells: -1, 0 or 1.
+    float cellSize;             ///< World side of one grid cell.
+    float lod;                  ///< Mip level of a texture matching the cell size.
+    float nextLod;              ///< lod of the next coarser level, which the outer edge blends to.
+    float padding = 0.0f;
+};
+
+/**
+ * @struct ClipmapGrid
+ * @brief The shared index list of the clipmap grid: every level draws the same vertices by vertex ID.
+ */
+struct ClipmapGrid {
+    std::vector<uint16_t> indices;  ///< The full grid's triangles first, then the ring's.
+    uint32_t fullCount = 0;         ///< Indices of the full grid, drawn by the innermost level.
+    uint32_t ringCount = 0;         ///< Indices of the ring, which leaves out the centre half; drawn by the others.
+};
+
+/**
+ * @brief Builds the index list every clipmap level draws.
+ * @param gridSize Cells per side of a level; a multiple of 8 up to 248.
+ * @return The full grid and the ring, both over (gridSize + 1)^2 vertices addressed row by row.
+ */
+ClipmapGrid clipmap_grid(uint32_t gridSize);
+
+/**
+ * @brief Returns how many levels reach a distance from the camera.
+ * @param gridSize Cells per side of a level.
+ * @param cellSize World side of a cell of the innermost level.
+ * @param extent The distance every direction must reach.
+ * @return The level count, at most CLIPMAP_MAX_LEVELS.
+ */
+uint32_t clipmap_level_count(uint32_t gridSize, float cellSize, float extent);
+
+/**
+ * @brief Places the clipmap levels around the camera.
+ * @param cellSize World side of a cell of the innermost level.
+ * @param levelCount The number of levels; at most CLIPMAP_MAX_LEVELS.
+ * @param eye World x/z of the camera.
+ * @param texelSize World side of a texel of the finest mip the levels sample.
+ * @param levels Receives levelCount levels, finest first.
+ */
+void clipmap_place(float cellSize, uint32_t levelCount, simd::float2 eye, float texelSize, ClipmapLevel* levels);
+
+/**
+ * @brief Returns where a grid vertex of a level lies, as clipmap_point in shaders.metal does.
+ * @param level The level.
+ * @param gridSize Cells per side of a level.
+ * @param vertex The vertex, numbered row by row over (gridSize + 1)^2.
+ * @return World x and z in x and y; in z, how far the vertex has slid onto the next level's lattice.
+ */
+simd::float3 clipmap_point(const ClipmapLevel& level, uint32_t gridSize, uint32_t vertex);
@@ -0,0 +1,52 @@
+/**
+ * @file command_buffers.hpp
+ * @brief The frame loop's command buffers, optionally without retained references and with per-encoder fault reports.
+ *
+ * By default a command buffer retains every buffer, texture and heap bound while encoding it,
+ * and releases them all when it completes: a few atomic operations for each bound resource,
+ * on the render thread and again on the completion thread. The frame loop's resources already
+ * outlive the frames that use them without that: the frame ring, the render graph's heaps and
+ * BufferHeap slots are only reused once the frames in flight have completed, and evicted chunks
+ * are kept for as many frames. With unretainedReferences the command buffers skip the retains.
+ *
+ * Whatever is released while a frame still reads it then becomes a use-after-free on the GPU,
+ * which shows up as a page fault of the command buffer at best. With validate, every command
+ * buffer reports its encoders' execution status, and a failed one logs which encoders faulted
+ * or were affected, by label. Debug builds validate by default; run with MTL_DEBUG_LAYER=1 as
+ * well for Metal's own API checks.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+/**
+ * @struct CommandBuffers
+ * @brief How the frame loop creates its command buffers.
+ */
+struct CommandBuffers {
+    MTLCommandBufferDescriptor* descriptor; ///< Reused for every command buffer.
+    bool unretainedReferences = false;      ///< Leave resource lifetimes to their owners; may change between frames.
+    bool validate = false;                  ///< Log the encoders of command buffers that fail.
+};
+
+/// @return Settings creating command buffers like [MTLCommandQueue commandBuffer], validated in Debug builds.
+CommandBuffers create_command_buffers();
+
+/**
+ * @brief Creates a command buffer with the current settings.
+ * @param buffers The settings.
+ * @param queue The queue it will be committed to.
+ * @param label Its label, also used in fault reports.
+ * @return The command buffer.
+ */
+id<MTLCommandBuffer> command_buffer_new(CommandBuffers& buffers, id<MTLCommandQueue> queue, NSString* label);
+
+/**
+ * @brief Blocks until every command buffer committed to a queue so far has completed.
+ *
+ * With unretained references, call it before replacing resources the frames in flight may
+ * still read, e.g. render targets on a resize.
+ *
+ * @param queue The queue; nil is ignored.
+ */
+void command_queue_wait_idle(id<MTLCommandQueue> queue);
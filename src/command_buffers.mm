@@ -0,0 +1,71 @@
+#import "command_buffers.hpp"
+
+namespace {
+    const char* encoder_state_name(MTLCommandEncoderErrorState state) {
+        switch (state) {
+            case MTLCommandEncoderErrorStateCompleted: return "completed";
+            case MTLCommandEncoderErrorStateAffected: return "affected";
+            case MTLCommandEncoderErrorStateNotAffected: return "not affected";
+            case MTLCommandEncoderErrorStatePending: return "pending";
+            case MTLCommandEncoderErrorStateFaulted: return "faulted";
+            default: return "unknown";
+        }
+    }
+
+    // Names the encoders that faulted, and those that ran into the fault, of a failed command buffer
+    void report_failure(id<MTLCommandBuffer> cmd, bool unretainedReferences) {
+        NSError* error = cmd.error;
+        NSLog(@"Command buffer \"%@\" failed (%@ references): %@", cmd.label,
+              unretainedReferences ? @"unretained" : @"retained", error.localizedDescription);
+        NSArray<id<MTLCommandBufferEncoderInfo>>* encoders = error.userInfo[MTLCommandBufferEncoderInfoErrorKey];
+        for (id<MTLCommandBufferEncoderInfo> info in encoders) {
+            if (info.errorState == MTLCommandEncoderErrorStateCompleted ||
+                info.errorState == MTLCommandEncoderErrorStateNotAffected) {
+                continue;
+            }
+            NSLog(@"  encoder \"%@\": %s %@", info.label, encoder_state_name(info.errorState),
+                  [info.debugSignposts componentsJoinedByString:@" / "]);
+        }
+        // A page fault with unretained references usually means something was released while the GPU read it
+        if (unretainedReferences && error.code == MTLCommandBufferErrorPageFault) {
+            NSLog(@"  a resource the frame bound may have been released before the frame completed");
+        }
+    }
+}
+
+CommandBuffers create_command_buffers() {
+    CommandBuffers buffers;
+    buffers.descriptor = [MTLCommandBufferDescriptor new];
+#ifdef VALIDATE_COMMAND_BUFFERS
+    buffers.validate = true;
+#endif
+    return buffers;
+}
+
+id<MTLCommandBuffer> command_buffer_new(CommandBuffers& buffers, id<MTLCommandQueue> queue, NSString* label) {
+    buffers.descriptor.retainedReferences = !buffers.unretainedReferences;
+    buffers.descriptor.errorOptions =
+        buffers.validate ? MTLCommandBufferErrorOptionEncoderExecutionStatus : MTLCommandBufferErrorOptionNone;
+    id<MTLCommandBuffer> cmd = [queue commandBufferWithDescriptor:buffers.descriptor];
+    cmd.label = label;
+    if (buffers.validate) {
+        const bool unretainedReferences = buffers.unretainedReferences;
+        [cmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+            if (completed.status == MTLCommandBufferStatusError) {
+                report_failure(completed, unretainedReferences);
+            }
+        }];
+    }
+    return cmd;
+}
+
+void command_queue_wait_idle(id<MTLCommandQueue> queue) {
+    if (!queue) {
+        return;
+    }
+    // The queue runs its command buffers in order, so an empty one completes after all of them
+    id<MTLCommandBuffer> cmd = [queue commandBuffer];
+    cmd.label = @"Wait for idle";
+    [cmd commit];
+    [cmd waitUntilCompleted];
+}
@@ -0,0 +1,212 @@
+/**
+ * @file concurrent_map.hpp
+ * @brief Sharded hash map with lock-free lookups, for state shared by streaming threads, e.g. per ChunkKey.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "epoch.hpp"
+
+/**
+ * @class ConcurrentMap
+ * @brief A hash map whose lookups take no lock and whose writers lock one shard of it.
+ *
+ * Keys hash to one of Shards shards, each a fixed array of buckets holding singly linked
+ * nodes. Writers take their shard's mutex, so writers of different shards never meet, and
+ * publish with release stores; readers take no lock at all and walk the chains under an
+ * EpochGuard. A node's value never changes once published: assigning replaces the node and
+ * erasing unlinks it, and the old node is retired to the map's EpochDomain, freed once no
+ * reader can still be walking it. Lookups therefore copy a consistent value out rather than
+ * hand out references.
+ *
+ * The bucket count is fixed at construction; size it for the expected entries, since chains
+ * lengthen rather than the table growing.
+ *
+ * @tparam K The key type; copyable and equality-comparable.
+ * @tparam V The value type; copyable.
+ * @tparam Hash Hashes a K; the map mixes the result, so an identity hash is fine.
+ * @tparam Shards The number of shards; a power of two.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>, size_t Shards = 16>
+class ConcurrentMap {
+    static_assert(Shards >= 1 && (Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+public:
+    /// @param bucketsPerShard Chains per shard, rounded up to a power of two.
+    explicit ConcurrentMap(size_t bucketsPerShard = 64) {
+        m_bucketMask = 1;
+        while (m_bucketMask < bucketsPerShard) {
+            m_bucketMask <<= 1;
+        }
+        for (Shard& shard : m_shards) {
+            shard.buckets = std::make_unique<std::atomic<Node*>[]>(m_bucketMask);
+        }
+        m_bucketMask -= 1;
+    }
+
+    ~ConcurrentMap() {
+        for (Shard& shard : m_shards) {
+            for (size_t i = 0; i <= m_bucketMask; ++i) {
+                Node* node = shard.buckets[i].load(std::memory_order_relaxed);
+                while (node) {
+                    delete std::exchange(node, node->next.load(std::memory_order_relaxed));
+                }
+            }
+        }
+    }
+
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    /**
+     * @brief Looks a key up without locking.
+     * @param key The key.
+     * @param value Receives a copy of the value if the key is present.
+     * @return True if the key is present.
+     */
+    bool find(const K& key, V& value) const {
+        const Location at = locate(key);
+        EpochGuard guard(m_epochs);
+        for (Node* node = at.bucket->load(std::memory_order_acquire); node;
+             node = node->next.load(std::memory_order_acquire)) {
+            if (node->key == key) {
+                value = node->value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @return True if the key is present.
+    bool contains(const K& key) const {
+        V value;
+        return find(key, value);
+    }
+
+    /**
+     * @brief Inserts a key, or replaces its value if present.
+     * @return True if the key was inserted rather than replaced.
+     */
+    bool insert_or_assign(const K& key, const V& value) {
+        const Location at = locate(key);
+        std::lock_guard<std::mutex> lock(at.shard->mutex);
+        std::atomic<Node*>* link = find_link(at.bucket, key);
+        Node* old = link->load(std::memory_order_relaxed);
+        Node* node = new Node{ key, value, old ? old->next.load(std::memory_order_relaxed) : nullptr };
+        link->store(node, std::memory_order_release);
+        if (old) {
+            retire(old);
+            return false;
+        }
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Inserts a key if it is absent.
+     * @return True if the key was inserted; false leaves the present value as it is.
+     */
+    bool insert(const K& key, const V& value) {
+        const Location at = locate(key);
+        std::lock_guard<std::mutex> lock(at.shard->mutex);
+        std::atomic<Node*>* link = find_link(at.bucket, key);
+        if (link->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        link->store(new Node{ key, value, nullptr }, std::memory_order_release);
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Removes a key.
+     * @return True if the key was present.
+     */
+    bool erase(const K& key) {
+        const Location at = locate(key);
+        std::lock_guard<std::mutex> lock(at.shard->mutex);
+        std::atomic<Node*>* link = find_link(at.bucket, key);
+        Node* old = link->load(std::memory_order_relaxed);
+        if (!old) {
+            return false;
+        }
+        link->store(old->next.load(std::memory_order_relaxed), std::memory_order_release);
+        retire(old);
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Calls fn(key, value) for every entry, without locking.
+     *
+     * Entries inserted or erased meanwhile may or may not be visited; every other entry is
+     * visited once, with the value it held at some point during the call.
+     */
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        EpochGuard guard(m_epochs);
+        for (const Shard& shard : m_shards) {
+            for (size_t i = 0; i <= m_bucketMask; ++i) {
+                for (Node* node = shard.buckets[i].load(std::memory_order_acquire); node;
+                     node = node->next.load(std::memory_order_acquire)) {
+                    fn(node->key, node->value);
+                }
+            }
+        }
+    }
+
+    /// @return The entries; only a hint while other threads write.
+    size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+    /// @return Replaced or erased nodes waiting for readers to move on.
+    size_t retired() const { return m_epochs.retired(); }
+
+private:
+    struct Node {
+        K key;
+        V value;
+        std::atomic<Node*> next;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;                               ///< Held by writers.
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+    };
+
+    struct Location {
+        Shard* shard;
+        std::atomic<Node*>* bucket;
+    };
+
+    Location locate(const K& key) const {
+        // Fibonacci hashing: the high bits pick the shard, the low bits of the mix the bucket
+        const uint64_t mixed = (uint64_t)Hash()(key) * 0x9E3779B97F4A7C15ull;
+        Shard& shard = m_shards[Shards > 1 ? (size_t)(mixed >> 32) & (Shards - 1) : 0];
+        return { &shard, &shard.buckets[(size_t)(mixed >> 40 ^ mixed) & m_bucketMask] };
+    }
+
+    // The link pointing at the key's node, or at null after the chain's last node; writers only
+    static std::atomic<Node*>* find_link(std::atomic<Node*>* link, const K& key) {
+        for (Node* node = link->load(std::memory_order_relaxed); node && !(node->key == key);
+             node = link->load(std::memory_order_relaxed)) {
+            link = &node->next;
+        }
+        return link;
+    }
+
+    void retire(Node* node) {
+        m_epochs.retire(node, [](void* unlinked) { delete (Node*)unlinked; });
+    }
+
+    mutable Shard m_shards[Shards];
+    size_t m_bucketMask = 0;
+    std::atomic<size_t> m_size{ 0 };
+    mutable EpochDomain m_epochs;
+};
@@ -0,0 +1,255 @@
+#include "cpu_sampler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <ptrauth.h>
+#include <pthread.h>
+#include <sys/qos.h>
+#endif
+
+namespace {
+    double steady_seconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifdef __APPLE__
+    // Reads the stack of a running thread; false if it is blocked, not a pthread or could not be read
+    bool capture_thread(thread_act_t thread, CpuStackSample& sample) {
+        pthread_t pthread = pthread_from_mach_thread_np(thread);
+        if (!pthread) {
+            return false;
+        }
+        thread_basic_info_data_t info;
+        mach_msg_type_number_t infoCount = THREAD_BASIC_INFO_COUNT;
+        if (thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &infoCount) != KERN_SUCCESS ||
+            info.run_state != TH_STATE_RUNNING || (info.flags & TH_FLAGS_IDLE)) {
+            return false;
+        }
+        const uintptr_t stackTop = (uintptr_t)pthread_get_stackaddr_np(pthread);
+        const uintptr_t stackBottom = stackTop - pthread_get_stacksize_np(pthread);
+        pthread_threadid_np(pthread, &sample.thread);
+
+        if (thread_suspend(thread) != KERN_SUCCESS) {
+            return false;
+        }
+        uintptr_t pc = 0;
+        uintptr_t fp = 0;
+#if defined(__arm64__)
+        arm_thread_state64_t state;
+        mach_msg_type_number_t stateCount = ARM_THREAD_STATE64_COUNT;
+        const bool read = thread_get_state(thread, ARM_THREAD_STATE64, (thread_state_t)&state, &stateCount) ==
+                          KERN_SUCCESS;
+        if (read) {
+            pc = (uintptr_t)arm_thread_state64_get_pc(state);
+            fp = (uintptr_t)arm_thread_state64_get_fp(state);
+        }
+#elif defined(__x86_64__)
+        x86_thread_state64_t state;
+        mach_msg_type_number_t stateCount = x86_THREAD_STATE64_COUNT;
+        const bool read = thread_get_state(thread, x86_THREAD_STATE64, (thread_state_t)&state, &stateCount) ==
+                          KERN_SUCCESS;
+        if (read) {
+            pc = (uintptr_t)state.__rip;
+            fp = (uintptr_t)state.__rbp;
+        }
+#else
+        const bool read = false;
+#endif
+        sample.depth = 0;
+        if (read && pc) {
+            sample.pcs[sample.depth++] = pc;
+            // A frame record is { caller's record, return address }; each lies above the last on the stack,
+            // and anything outside the stack ends the walk rather than being read
+            while (sample.depth < CPU_SAMPLE_MAX_DEPTH && fp % sizeof(uintptr_t) == 0 && fp >= stackBottom &&
+                   fp + 2 * sizeof(uintptr_t) <= stackTop) {
+                const uintptr_t* record = (const uintptr_t*)fp;
+                const uintptr_t returnAddress = (uintptr_t)ptrauth_strip((void*)record[1], ptrauth_key_return_address);
+                if (!returnAddress) {
+                    break;
+                }
+                sample.pcs[sample.depth++] = returnAddress;
+                if (record[0] <= fp) {
+                    break;
+                }
+                fp = record[0];
+            }
+        }
+        thread_resume(thread);
+        return sample.depth > 0;
+    }
+
+    std::string thread_name(thread_act_t thread, uint64_t id) {
+        char name[64] = {};
+        pthread_t pthread = pthread_from_mach_thread_np(thread);
+        if (pthread && pthread_getname_np(pthread, name, sizeof(name)) == 0 && name[0]) {
+            return name;
+        }
+        return "thread " + std::to_string(id);
+    }
+#endif
+}
+
+CpuSampleRing::CpuSampleRing(size_t capacity) : m_samples(std::max<size_t>(capacity, 1)) {}
+
+void CpuSampleRing::push(const CpuStackSample& sample) {
+    m_samples[m_head] = sample;
+    m_head = (m_head + 1) % m_samples.size();
+    m_count = std::min(m_count + 1, m_samples.size());
+}
+
+std::vector<CpuStackSample> CpuSampleRing::collect(double since) const {
+    std::vector<CpuStackSample> samples;
+    const size_t oldest = (m_head + m_samples.size() - m_count) % m_samples.size();
+    for (size_t i = 0; i < m_count; ++i) {
+        const CpuStackSample& sample = m_samples[(oldest + i) % m_samples.size()];
+        if (sample.time >= since) {
+            samples.push_back(sample);
+        }
+    }
+    return samples;
+}
+
+std::string symbolize_address(uintptr_t address) {
+    Dl_info info;
+    if (!dladdr((const void*)address, &info) || !info.dli_fname) {
+        char hex[32];
+        snprintf(hex, sizeof(hex), "0x%" PRIxPTR, address);
+        return hex;
+    }
+    if (info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+        free(demangled);
+        return name;
+    }
+    // Stripped or static functions: the image and the offset into it, for atos or addr2line
+    const char* image = strrchr(info.dli_fname, '/');
+    char offset[32];
+    snprintf(offset, sizeof(offset), "+0x%" PRIxPTR, address - (uintptr_t)info.dli_fbase);
+    return std::string(image ? image + 1 : info.dli_fname) + offset;
+}
+
+std::map<std::string, uint32_t> fold_cpu_samples(const CpuProfile& profile, const CpuSymbolizer& symbolize) {
+    std::unordered_map<uintptr_t, std::string> names;
+    auto name = [&](uintptr_t address) -> const std::string& {
+        auto it = names.find(address);
+        if (it == names.end()) {
+            std::string symbol = symbolize(address);
+            // ';' separates frames and the last space the count, so neither may appear in a frame
+            std::replace(symbol.begin(), symbol.end(), ';', ':');
+            it = names.emplace(address, std::move(symbol)).first;
+        }
+        return it->second;
+    };
+
+    std::map<std::string, uint32_t> stacks;
+    std::string stack;
+    for (const CpuStackSample& sample : profile.samples) {
+        auto thread = profile.threadNames.find(sample.thread);
+        stack = thread != profile.threadNames.end() ? thread->second : "thread " + std::to_string(sample.thread);
+        for (uint32_t i = sample.depth; i-- > 0;) {
+            stack += ';';
+            stack += name(i == 0 ? sample.pcs[i] : sample.pcs[i] - 1);
+        }
+        ++stacks[stack];
+    }
+    return stacks;
+}
+
+void write_folded_stacks(const std::map<std::string, uint32_t>& stacks, std::ostream& out) {
+    for (const auto& stack : stacks) {
+        out << stack.first << ' ' << stack.second << '\n';
+    }
+}
+
+bool write_cpu_profile(const CpuProfile& profile, const char* path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    write_folded_stacks(fold_cpu_samples(profile), file);
+    return (bool)file;
+}
+
+CpuSampler::CpuSampler(const CpuSamplerConfig& config)
+    : m_config(config),
+      m_ring((size_t)(config.windowSeconds * 1000.0f / std::max(config.intervalMs, 0.01f)) * config.threadsPerSample) {
+#ifdef __APPLE__
+    m_thread = std::thread(&CpuSampler::thread_main, this);
+#endif
+}
+
+CpuSampler::~CpuSampler() {
+    m_stopping = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+CpuProfile CpuSampler::snapshot(float seconds) const {
+    CpuProfile profile;
+    const double since = steady_seconds() - std::min(seconds, m_config.windowSeconds);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    profile.samples = m_ring.collect(since);
+    profile.threadNames = m_threadNames;
+    return profile;
+}
+
+void CpuSampler::thread_main() {
+#ifdef __APPLE__
+    pthread_setname_np("CPU sampler");
+    // Late samples bunch up around whatever delayed them, so the sampler runs ahead of the threads it samples
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    const thread_act_t self = mach_thread_self();
+    const auto interval = std::chrono::duration<float, std::milli>(m_config.intervalMs);
+    std::vector<CpuStackSample> captured;
+    std::vector<thread_act_t> capturedThreads;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        thread_act_array_t threads = nullptr;
+        mach_msg_type_number_t threadCount = 0;
+        if (task_threads(mach_task_self(), &threads, &threadCount) == KERN_SUCCESS) {
+            // Sized before any thread is suspended
+            captured.resize(threadCount);
+            capturedThreads.resize(threadCount);
+            size_t capturedCount = 0;
+            const double time = steady_seconds();
+            for (mach_msg_type_number_t t = 0; t < threadCount; ++t) {
+                if (threads[t] != self && capture_thread(threads[t], captured[capturedCount])) {
+                    captured[capturedCount].time = time;
+                    capturedThreads[capturedCount++] = threads[t];
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (size_t i = 0; i < capturedCount; ++i) {
+                    m_ring.push(captured[i]);
+                    // Threads name themselves as they start, before they have run long enough to be sampled
+                    if (m_threadNames.count(captured[i].thread) == 0) {
+                        m_threadNames.emplace(captured[i].thread, thread_name(capturedThreads[i], captured[i].thread));
+                    }
+                }
+            }
+            for (mach_msg_type_number_t t = 0; t < threadCount; ++t) {
+                mach_port_deallocate(mach_task_self(), threads[t]);
+            }
+            vm_deallocate(mach_task_self(), (vm_address_t)threads, threadCount * sizeof(thread_act_t));
+        }
+        std::this_thread::sleep_for(interval);
+    }
+    mach_port_deallocate(mach_task_self(), self);
+#endif
+}
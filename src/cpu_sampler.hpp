@@ -0,0 +1,151 @@
+/**
+ * @file cpu_sampler.hpp
+ * @brief In-process sampling profiler: periodic call stacks of every running thread, kept for the last seconds.
+ *
+ * For machines without Instruments, like kiosks in the field. A sampler thread wakes every
+ * interval, suspends each other thread of the process that is running, reads its program
+ * counter and frame pointer, walks the frame records within the thread's stack and resumes
+ * it. Threads that are blocked are skipped, so the samples show where CPU time goes rather
+ * than where threads wait. Nothing allocates while a thread is suspended, since it may hold
+ * the malloc lock.
+ *
+ * Samples go into a ring sized for the window, so a snapshot of the last seconds can be taken
+ * at any time, e.g. right after a hitch, and written as folded stacks ("thread;outer;inner
+ * count" per line), the input of flamegraph.pl and speedscope. Symbolizing happens when
+ * writing, not when sampling. Walking frame pointers misses frames of code built without
+ * them; Apple's ABIs keep them by default.
+ *
+ * Only macOS is sampled; elsewhere the sampler starts no thread and snapshots are empty.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Frames kept per sample; deeper stacks lose their outermost frames.
+constexpr uint32_t CPU_SAMPLE_MAX_DEPTH = 48;
+
+/**
+ * @struct CpuStackSample
+ * @brief One call stack of one thread.
+ */
+struct CpuStackSample {
+    double time = 0.0;                      ///< Seconds on the steady clock.
+    uint64_t thread = 0;                    ///< System thread id.
+    uint32_t depth = 0;                     ///< Frames in pcs.
+    uintptr_t pcs[CPU_SAMPLE_MAX_DEPTH];    ///< Program counter, then return addresses, innermost first.
+};
+
+/**
+ * @class CpuSampleRing
+ * @brief The newest samples, overwriting the oldest once full. Not thread-safe.
+ */
+class CpuSampleRing {
+public:
+    /// @param capacity Samples kept; allocated up front.
+    explicit CpuSampleRing(size_t capacity);
+
+    /// @brief Stores a sample, replacing the oldest once the ring is full.
+    void push(const CpuStackSample& sample);
+
+    /// @return The samples taken at or after since, oldest first.
+    std::vector<CpuStackSample> collect(double since) const;
+
+    /// @return Samples stored, at most the capacity.
+    size_t size() const { return m_count; }
+
+private:
+    std::vector<CpuStackSample> m_samples;
+    size_t m_head = 0;      ///< Next slot to write.
+    size_t m_count = 0;
+};
+
+/**
+ * @struct CpuProfile
+ * @brief A snapshot of samples with the names of their threads.
+ */
+struct CpuProfile {
+    std::vector<CpuStackSample> samples;            ///< Oldest first.
+    std::map<uint64_t, std::string> threadNames;    ///< Name of each thread id seen.
+};
+
+/// Turns an address into a function name.
+using CpuSymbolizer = std::function<std::string(uintptr_t address)>;
+
+/**
+ * @brief Names the function holding an address, demangled, or its image and offset if it has no symbol.
+ * @param address A code address in this process.
+ * @return The name; the hex address if it lies in no loaded image.
+ */
+std::string symbolize_address(uintptr_t address);
+
+/**
+ * @brief Counts the samples of each distinct stack, outermost frame first and the thread name as the root.
+ *
+ * Return addresses point after their call, so they are symbolized one byte earlier, inside it.
+ *
+ * @param profile The samples.
+ * @param symbolize Names each address; called once per distinct address.
+ * @return Count of each folded stack, frames separated by ';'.
+ */
+std::map<std::string, uint32_t> fold_cpu_samples(const CpuProfile& profile,
+                                                 const CpuSymbolizer& symbolize = symbolize_address);
+
+/// @brief Writes folded stacks, one "stack count" line each.
+void write_folded_stacks(const std::map<std::string, uint32_t>& stacks, std::ostream& out);
+
+/**
+ * @brief Folds a profile and writes it to a file.
+ * @return False if the file could not be written.
+ */
+bool write_cpu_profile(const CpuProfile& profile, const char* path);
+
+/**
+ * @struct CpuSamplerConfig
+ * @brief How often to sample and how much to keep.
+ */
+struct CpuSamplerConfig {
+    float intervalMs = 2.0f;        ///< Time between samples of all threads.
+    float windowSeconds = 10.0f;    ///< Seconds of samples kept.
+    uint32_t threadsPerSample = 4;  ///< Running threads per sample the ring is sized for; 8 MB for 10 seconds.
+};
+
+/**
+ * @class CpuSampler
+ * @brief Samples the process on a thread of its own from construction to destruction.
+ */
+class CpuSampler {
+public:
+    explicit CpuSampler(const CpuSamplerConfig& config = {});
+    ~CpuSampler();
+
+    CpuSampler(const CpuSampler&) = delete;
+    CpuSampler& operator=(const CpuSampler&) = delete;
+
+    /// @return False where sampling is not supported; snapshots are then empty.
+    bool running() const { return m_thread.joinable(); }
+
+    /**
+     * @brief Copies the newest samples; cheap enough for the render thread, folding is left to the caller.
+     * @param seconds How far back to go; at most the window.
+     */
+    CpuProfile snapshot(float seconds) const;
+
+private:
+    void thread_main();
+
+    CpuSamplerConfig m_config;
+    mutable std::mutex m_mutex;                     ///< Guards the ring and the names.
+    CpuSampleRing m_ring;
+    std::map<uint64_t, std::string> m_threadNames;
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,213 @@
+#include "creature.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cube.hpp"
+
+namespace {
+    enum Joint : uint32_t {
+        HIPS, CHEST, HEAD,
+        FRONT_LEFT_UPPER, FRONT_LEFT_LOWER, FRONT_RIGHT_UPPER, FRONT_RIGHT_LOWER,
+        BACK_LEFT_UPPER, BACK_LEFT_LOWER, BACK_RIGHT_UPPER, BACK_RIGHT_LOWER,
+        JOINT_COUNT
+    };
+
+    // Bind pose joint positions in model space, and their parents
+    const simd::float3 JOINT_POSITIONS[JOINT_COUNT] = {
+        { 0.0f, 1.0f, -0.35f }, { 0.0f, 1.0f, 0.35f }, { 0.0f, 1.15f, 0.6f },
+        { 0.22f, 0.95f, 0.4f }, { 0.22f, 0.5f, 0.4f }, { -0.22f, 0.95f, 0.4f }, { -0.22f, 0.5f, 0.4f },
+        { 0.22f, 0.95f, -0.4f }, { 0.22f, 0.5f, -0.4f }, { -0.22f, 0.95f, -0.4f }, { -0.22f, 0.5f, -0.4f },
+    };
+    const uint32_t JOINT_PARENTS[JOINT_COUNT] = {
+        JOINT_ROOT, HIPS, CHEST,
+        CHEST, FRONT_LEFT_UPPER, CHEST, FRONT_RIGHT_UPPER,
+        HIPS, BACK_LEFT_UPPER, HIPS, BACK_RIGHT_UPPER,
+    };
+
+    // Where a leg is in the walk cycle; diagonal legs move together
+    const float LEG_PHASES[4] = { 0.0f, (float)M_PI, (float)M_PI, 0.0f };
+
+    // Creatures rest and walk in turns about every half minute
+    constexpr double HERD_CYCLE_RATE = 0.2;
+
+    const simd::float3 X_AXIS = { 1.0f, 0.0f, 0.0f };
+
+    // A box from lo to hi whose vertices behind splitZ follow rear and the others front
+    void add_box(SkinnedMesh& out, std::vector<uint32_t>& indices, simd::float3 lo, simd::float3 hi, uint32_t rear,
+                 uint32_t front, float splitZ) {
+        Vertex vertices[CUBE_VERTEX_COUNT];
+        uint32_t cube[CUBE_INDEX_COUNT];
+        build_cube(vertices, cube);
+        const uint32_t base = (uint32_t)out.mesh.vertices.size();
+        for (Vertex vertex : vertices) {
+            vertex.position = lo + (vertex.position + simd::float3{ 0.5f, 0.5f, 0.5f }) * (hi - lo);
+            const uint8_t joint = (uint8_t)(vertex.position.z < splitZ ? rear : front);
+            out.mesh.vertices.push_back(vertex);
+            out.skin.push_back({ { joint, 0, 0, 0 }, { 255, 0, 0, 0 } });
+        }
+        for (uint32_t index : cube) {
+            indices.push_back(base + index);
+        }
+    }
+
+    void add_box(SkinnedMesh& out, std::vector<uint32_t>& indices, simd::float3 lo, simd::float3 hi, uint32_t joint) {
+        add_box(out, indices, lo, hi, joint, joint, 0.0f);
+    }
+
+    simd::float3 bind_translation(uint32_t joint) {
+        const uint32_t parent = JOINT_PARENTS[joint];
+        return parent == JOINT_ROOT ? JOINT_POSITIONS[joint] : JOINT_POSITIONS[joint] - JOINT_POSITIONS[parent];
+    }
+
+    // Every joint in its bind pose; the clips then key what moves
+    void key_bind_pose(AnimationClip& clip, uint32_t frame) {
+        for (uint32_t joint = 0; joint < JOINT_COUNT; ++joint) {
+            animation_set_key(clip, frame, joint, simd_quaternion(0.0f, X_AXIS), bind_translation(joint));
+        }
+    }
+
+    AnimationClip idle_clip() {
+        AnimationClip clip;
+        clip.sampleRate = 15.0f;
+        animation_clip_resize(clip, JOINT_COUNT, 31);
+        for (uint32_t frame = 0; frame < clip.frameCount; ++frame) {
+            const float angle = 2.0f * (float)M_PI * frame / (clip.frameCount - 1);
+            key_bind_pose(clip, frame);
+            // A slow nod, and the chest rising and falling twice a cycle
+            animation_set_key(clip, frame, HEAD, simd_quaternion(0.15f + 0.15f * sinf(angle), X_AXIS),
+                              bind_translation(HEAD));
+            animation_set_key(clip, frame, CHEST, simd_quaternion(0.0f, X_AXIS),
+                              bind_translation(CHEST) + simd::float3{ 0.0f, 0.015f * sinf(2.0f * angle), 0.0f });
+        }
+        return clip;
+    }
+
+    AnimationClip walk_clip() {
+        AnimationClip clip;
+        clip.sampleRate = 30.0f;
+        animation_clip_resize(clip, JOINT_COUNT, 31);
+        const uint32_t uppers[4] = { FRONT_LEFT_UPPER, FRONT_RIGHT_UPPER, BACK_LEFT_UPPER, BACK_RIGHT_UPPER };
+        for (uint32_t frame = 0; frame < clip.frameCount; ++frame) {
+            const float angle = 2.0f * (float)M_PI * frame / (clip.frameCount - 1);
+            key_bind_pose(clip, frame);
+            for (uint32_t leg = 0; leg < 4; ++leg) {
+                const float legAngle = angle + LEG_PHASES[leg];
+                // The knee bends while the leg swings forward, so the foot clears the ground
+                const float swing = 0.45f * sinf(legAngle);
+                const float knee = -0.5f * std::max(cosf(legAngle), 0.0f);
+                animation_set_key(clip, frame, uppers[leg], simd_quaternion(swing, X_AXIS),
+                                  bind_translation(uppers[leg]));
+                animation_set_key(clip, frame, uppers[leg] + 1, simd_quaternion(knee, X_AXIS),
+                                  bind_translation(uppers[leg] + 1));
+            }
+            // The body rises over each stride and the head bobs against it
+            animation_set_key(clip, frame, HIPS, simd_quaternion(0.0f, X_AXIS),
+                              bind_translation(HIPS) + simd::float3{ 0.0f, 0.03f * fabsf(sinf(angle)), 0.0f });
+            animation_set_key(clip, frame, HEAD, simd_quaternion(0.08f * sinf(2.0f * angle), X_AXIS),
+                              bind_translation(HEAD));
+        }
+        return clip;
+    }
+
+    // A small xorshift, so placement is the same on every platform
+    float next_random(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xFFFFFF) / (float)0x1000000;
+    }
+
+    float smoothstep(float edge0, float edge1, float x) {
+        const float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+}
+
+SkinnedMesh create_creature_mesh() {
+    SkinnedMesh out;
+    std::vector<uint32_t> indices;
+    // The torso bends between hips and chest; everything else is rigid on its joint
+    add_box(out, indices, { -0.3f, 0.8f, -0.55f }, { 0.3f, 1.2f, 0.55f }, HIPS, CHEST, 0.0f);
+    add_box(out, indices, { -0.13f, 1.1f, 0.55f }, { 0.13f, 1.4f, 0.95f }, HEAD);
+    for (uint32_t upper : { FRONT_LEFT_UPPER, FRONT_RIGHT_UPPER, BACK_LEFT_UPPER, BACK_RIGHT_UPPER }) {
+        const simd::float3 p = JOINT_POSITIONS[upper];
+        add_box(out, indices, { p.x - 0.07f, 0.5f, p.z - 0.07f }, { p.x + 0.07f, 0.95f, p.z + 0.07f }, upper);
+        add_box(out, indices, { p.x - 0.06f, 0.0f, p.z - 0.06f }, { p.x + 0.06f, 0.5f, p.z + 0.06f }, upper + 1);
+    }
+
+    out.mesh.indices.resize(indices.size(), out.mesh.vertices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        if (out.mesh.indices.format == IndexFormat::UInt16) {
+            out.mesh.indices.indices16[i] = (uint16_t)indices[i];
+        } else {
+            out.mesh.indices.indices32[i] = indices[i];
+        }
+    }
+    out.mesh.bounds = compute_bounds(out.mesh.vertices.data(), out.mesh.vertices.size());
+    return out;
+}
+
+AnimationSet create_creature_animations() {
+    AnimationSet set;
+    for (uint32_t joint = 0; joint < JOINT_COUNT; ++joint) {
+        const simd::float3 p = JOINT_POSITIONS[joint];
+        set.skeleton.parents.push_back(JOINT_PARENTS[joint]);
+        set.skeleton.inverseBind.push_back(affine_translation(-p.x, -p.y, -p.z));
+    }
+    set.clips.resize(2);
+    set.clips[CREATURE_CLIP_IDLE] = idle_clip();
+    set.clips[CREATURE_CLIP_WALK] = walk_clip();
+    return set;
+}
+
+Herd create_herd(const HeightField& field, const SkinnedMesh& mesh, uint32_t count, uint32_t seed) {
+    Herd herd;
+    herd.animation = create_creature_animations();
+    herd.poseBounds = animation_bounds(mesh, herd.animation);
+    // Blends bulge slightly past the keys they mix
+    const simd::float3 pad = { 0.05f, 0.05f, 0.05f };
+    herd.poseBounds.min -= pad;
+    herd.poseBounds.max += pad;
+
+    // Circles stay a margin inside the field, so no creature walks off its edge
+    const float margin = 16.0f;
+    const float extentX = std::max((field.width - 1) * field.spacing - 2.0f * margin, 0.0f);
+    const float extentZ = std::max((field.depth - 1) * field.spacing - 2.0f * margin, 0.0f);
+    uint32_t state = seed * 747796405u + 1u;
+    for (uint32_t i = 0; i < count; ++i) {
+        Animator animator;
+        animator.clips[0] = CREATURE_CLIP_IDLE;
+        animator.clips[1] = CREATURE_CLIP_WALK;
+        animator.phase = next_random(state);
+        herd.animators.push_back(animator);
+        herd.centers.push_back({ field.originX + margin + next_random(state) * extentX, 0.0f,
+                                 field.originZ + margin + next_random(state) * extentZ });
+        herd.radii.push_back(4.0f + 6.0f * next_random(state));
+        herd.angles.push_back(2.0f * (float)M_PI * next_random(state));
+        herd.offsets.push_back(2.0f * (float)M_PI * next_random(state));
+        const float shade = 0.8f + 0.4f * next_random(state);
+        herd.colors.push_back(simd::float3{ 0.55f, 0.4f, 0.28f } * shade);
+        cull_bounds_add(herd.bounds, herd.poseBounds);
+    }
+    herd.world.resize(count, affine_identity());
+    herd.palettes.resize((size_t)count * herd.animation.skeleton.size(), affine_identity());
+    return herd;
+}
+
+void herd_update(Herd& herd, JobSystem& jobs, const HeightField& field, double time, float dt) {
+    for (uint32_t i = 0; i < herd.size(); ++i) {
+        const float cycle = 0.5f + 0.5f * sinf((float)(time * HERD_CYCLE_RATE) + herd.offsets[i]);
+        const float walk = smoothstep(0.35f, 0.65f, cycle);
+        herd.animators[i].blend = walk;
+        herd.angles[i] += dt * CREATURE_WALK_SPEED * walk / herd.radii[i];
+
+        const float angle = herd.angles[i];
+        const float x = herd.centers[i].x + herd.radii[i] * cosf(angle);
+        const float z = herd.centers[i].z + herd.radii[i] * sinf(angle);
+        // Facing along the circle: the yaw -angle turns +Z onto its tangent (-sin, 0, cos)
+        herd.world[i] = affine_trs_y({ x, height_field_height(field, x, z), z }, -angle, { 1.0f, 1.0f, 1.0f });
+        cull_bounds_set(herd.bounds, i, transform_bounds(herd.poseBounds, affine_matrix(herd.world[i])));
+    }
+    animate(jobs, herd.animation, herd.animators.data(), herd.size(), dt, herd.palettes.data());
+}
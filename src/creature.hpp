@@ -0,0 +1,79 @@
+/**
+ * @file creature.hpp
+ * @brief A skinned four-legged creature and a herd of them grazing and walking over the terrain.
+ *
+ * The creature is built from boxes around an eleven-joint skeleton: hips and chest, a head, and
+ * two joints per leg. The torso's rear follows the hips and its front the chest, so it bends
+ * between them, and every other box follows one joint. It has an idle clip, a slow nod with
+ * breathing, and a walk cycle whose diagonal legs swing together; the herd blends from one to
+ * the other as each creature sets off along its circle and back as it stops.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "animation.hpp"
+#include "frustum.hpp"
+#include "height_field.hpp"
+#include "job_system.hpp"
+
+/// Clip index of the idle cycle in create_creature_animations().
+constexpr uint32_t CREATURE_CLIP_IDLE = 0;
+/// Clip index of the walk cycle in create_creature_animations().
+constexpr uint32_t CREATURE_CLIP_WALK = 1;
+/// Ground speed of a creature at full walk, in world units per second.
+constexpr float CREATURE_WALK_SPEED = 1.2f;
+
+/// @return The creature's bind pose mesh, standing on y = 0 and facing +Z.
+SkinnedMesh create_creature_mesh();
+
+/// @return The creature's skeleton with its idle and walk clips.
+AnimationSet create_creature_animations();
+
+/**
+ * @struct Herd
+ * @brief Creatures walking circles around fixed centres, and their skinning palettes.
+ */
+struct Herd {
+    AnimationSet animation;                 ///< Skeleton and clips every creature plays.
+    BoundingBox poseBounds;                 ///< Model space box around every pose.
+    std::vector<Animator> animators;        ///< Idle blended towards walk by how fast each creature moves.
+    std::vector<simd::float3> centers;      ///< Centre of each creature's circle.
+    std::vector<float> radii;               ///< Radius of each circle.
+    std::vector<float> angles;              ///< Where on its circle each creature stands.
+    std::vector<float> offsets;             ///< Shifts each creature's walk and rest periods.
+    std::vector<simd::float3> colors;       ///< Flat colour of each creature.
+    std::vector<Affine> world;              ///< Model to world transforms, set by herd_update().
+    std::vector<Affine> palettes;           ///< animation.skeleton.size() entries per creature, set by herd_update().
+    CullBounds bounds;                      ///< World bounds of each creature, set by herd_update().
+
+    /// @return The number of creatures.
+    uint32_t size() const { return (uint32_t)animators.size(); }
+};
+
+/**
+ * @brief Places creatures on circles inside a height field.
+ * @param field The terrain they walk on.
+ * @param mesh The creature mesh, for the pose bounds.
+ * @param count The number of creatures.
+ * @param seed Changes every placement.
+ * @return The herd in its bind pose at the origin; herd_update() places and poses it.
+ */
+Herd create_herd(const HeightField& field, const SkinnedMesh& mesh, uint32_t count, uint32_t seed = 7);
+
+/**
+ * @brief Moves every creature along its circle, stands it on the terrain and animates it.
+ *
+ * Each creature alternates between resting and walking on a cycle of its own; its walk weight
+ * sets both its ground speed and the blend from idle to walk, so feet and ground keep pace.
+ *
+ * @param herd The herd.
+ * @param jobs Samples the animations.
+ * @param field The terrain.
+ * @param time Seconds since start; picks where each creature is in its rest and walk cycle.
+ * @param dt Seconds since the last update.
+ */
+void herd_update(Herd& herd, JobSystem& jobs, const HeightField& field, double time, float dt);
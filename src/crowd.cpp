@@ -0,0 +1,237 @@
+#include "crowd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "affine.hpp"
+
+namespace {
+    // Agents per job slice: enough for the steering to outweigh the scheduling
+    constexpr uint32_t CROWD_GRAIN = 2048;
+
+    // xorshift32, as the debris uses; returns [-1, 1]
+    float next_signed(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)(state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    int32_t cell_of(float v, float cellSize) {
+        return (int32_t)std::floor(v / cellSize);
+    }
+
+    uint32_t cell_bucket(int32_t cx, int32_t cz, uint32_t mask) {
+        uint32_t h = (uint32_t)cx * 0x8da6b343u ^ (uint32_t)cz * 0xd8163841u;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        return h & mask;
+    }
+
+    // The distinct buckets of the 3 x 3 cells around a point; any point within a cell of it lies in one
+    uint32_t neighbour_buckets(const Crowd& crowd, float x, float z, uint32_t* buckets) {
+        const int32_t cx = cell_of(x, crowd.cellSize);
+        const int32_t cz = cell_of(z, crowd.cellSize);
+        uint32_t count = 0;
+        for (int32_t dz = -1; dz <= 1; ++dz) {
+            for (int32_t dx = -1; dx <= 1; ++dx) {
+                const uint32_t bucket = cell_bucket(cx + dx, cz + dz, crowd.bucketMask);
+                if (std::find(buckets, buckets + count, bucket) == buckets + count) {
+                    buckets[count++] = bucket;
+                }
+            }
+        }
+        return count;
+    }
+
+    void hash_agents(Crowd& crowd, uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            crowd.buckets[i] = cell_bucket(cell_of(crowd.xs[i], crowd.cellSize), cell_of(crowd.zs[i], crowd.cellSize),
+                                           crowd.bucketMask);
+        }
+    }
+
+    // Counting sort by bucket; walking the agents backwards leaves each run in agent order
+    void sort_agents(Crowd& crowd) {
+        std::vector<uint32_t>& starts = crowd.bucketStarts;
+        std::fill(starts.begin(), starts.end(), 0u);
+        for (uint32_t bucket : crowd.buckets) {
+            ++starts[bucket];
+        }
+        for (size_t b = 1; b < starts.size(); ++b) {
+            starts[b] += starts[b - 1];
+        }
+        for (uint32_t i = crowd.size(); i-- > 0;) {
+            const uint32_t slot = --starts[crowd.buckets[i]];
+            crowd.cellAgents[slot] = i;
+            crowd.cellXs[slot] = crowd.xs[i];
+            crowd.cellZs[slot] = crowd.zs[i];
+        }
+    }
+
+    // The push away from every neighbour inside the radius, each weighted by how deep it is inside
+    simd::float2 separation(const Crowd& crowd, float x, float z, float radius) {
+        const simd::float4 lanes = { 0.0f, 1.0f, 2.0f, 3.0f };
+        const simd::float4 zero = 0.0f;
+        const simd::float4 one = 1.0f;
+        simd::float4 pushX = 0.0f;
+        simd::float4 pushZ = 0.0f;
+        uint32_t buckets[9];
+        const uint32_t bucketCount = neighbour_buckets(crowd, x, z, buckets);
+        for (uint32_t b = 0; b < bucketCount; ++b) {
+            const uint32_t end = crowd.bucketStarts[buckets[b] + 1];
+            for (uint32_t j = crowd.bucketStarts[buckets[b]]; j < end; j += 4) {
+                const float* qx = &crowd.cellXs[j];
+                const float* qz = &crowd.cellZs[j];
+                const simd::float4 dx = x - simd::float4{ qx[0], qx[1], qx[2], qx[3] };
+                const simd::float4 dz = z - simd::float4{ qz[0], qz[1], qz[2], qz[3] };
+                // Lanes past the run read the next one, or the padding, and count for nothing
+                const simd::float4 live = simd::min(simd::max((float)(end - j) - lanes, zero), one);
+                const simd::float4 d = simd::sqrt(dx * dx + dz * dz + 1e-12f);
+                // The agent itself is at distance zero and adds nothing
+                const simd::float4 w = simd::max(radius - d, zero) * live / (d * radius);
+                pushX += dx * w;
+                pushZ += dz * w;
+            }
+        }
+        return { pushX[0] + pushX[1] + pushX[2] + pushX[3], pushZ[0] + pushZ[1] + pushZ[2] + pushZ[3] };
+    }
+
+    void steer_agents(Crowd& crowd, const CrowdSettings& settings, float dt, uint32_t begin, uint32_t end) {
+        const float follow = std::min(settings.agility * dt, 1.0f);
+        const float centerX = 0.5f * (crowd.minX + crowd.maxX);
+        const float centerZ = 0.5f * (crowd.minZ + crowd.maxZ);
+        const float margin = crowd.cellSize;
+        for (uint32_t i = begin; i < end; ++i) {
+            float x = crowd.xs[i];
+            float z = crowd.zs[i];
+            float heading = crowd.headings[i] + settings.wander * dt * next_signed(crowd.seeds[i]);
+            if (x < crowd.minX + margin || x > crowd.maxX - margin || z < crowd.minZ + margin ||
+                z > crowd.maxZ - margin) {
+                heading = std::atan2(centerZ - z, centerX - x);
+            }
+            crowd.headings[i] = heading;
+
+            const simd::float2 gradient = crowd.ground[i].gradient;
+            const simd::float2 push = separation(crowd, x, z, settings.radius);
+            const float aimX = settings.speed * (std::cos(heading) - settings.slope * gradient.x +
+                                                 settings.separation * push.x);
+            const float aimZ = settings.speed * (std::sin(heading) - settings.slope * gradient.y +
+                                                 settings.separation * push.y);
+            crowd.velocityXs[i] += (aimX - crowd.velocityXs[i]) * follow;
+            crowd.velocityZs[i] += (aimZ - crowd.velocityZs[i]) * follow;
+            x += crowd.velocityXs[i] * dt;
+            z += crowd.velocityZs[i] * dt;
+            crowd.xs[i] = std::clamp(x, crowd.minX, crowd.maxX);
+            crowd.zs[i] = std::clamp(z, crowd.minZ, crowd.maxZ);
+        }
+    }
+
+    // Samples the ground in one batch, then faces each agent along its velocity, or its heading when still
+    void place_agents(Crowd& crowd, const HeightField& field, float size, uint32_t begin, uint32_t end) {
+        height_field_samples(field, &crowd.xs[begin], &crowd.zs[begin], &crowd.ground[begin], end - begin);
+        for (uint32_t i = begin; i < end; ++i) {
+            float fx = crowd.velocityXs[i];
+            float fz = crowd.velocityZs[i];
+            float length = std::sqrt(fx * fx + fz * fz);
+            if (length < 1e-4f) {
+                fx = std::cos(crowd.headings[i]);
+                fz = std::sin(crowd.headings[i]);
+                length = 1.0f;
+            }
+            // The yaw that turns +Z onto the facing has sine fx and cosine fz
+            const float s = fx / length * size;
+            const float c = fz / length * size;
+            const float y = crowd.ground[i].height + crowd.footOffset;
+            const Affine world = { { simd::float4{ c, 0.0f, s, crowd.xs[i] }, simd::float4{ 0.0f, size, 0.0f, y },
+                                     simd::float4{ -s, 0.0f, c, crowd.zs[i] } } };
+            crowd.transforms[i] = affine_matrix(world);
+        }
+    }
+}
+
+Crowd create_crowd(SceneStore& scene, const HeightField& field, uint32_t count, uint32_t mesh,
+                   const BoundingBox& meshBounds, const CrowdSettings& settings, uint32_t seed) {
+    Crowd crowd;
+    crowd.cellSize = std::max(settings.radius, 1e-3f);
+    crowd.minX = field.originX;
+    crowd.minZ = field.originZ;
+    crowd.maxX = field.originX + (float)(field.width - 1) * field.spacing;
+    crowd.maxZ = field.originZ + (float)(field.depth - 1) * field.spacing;
+    crowd.footOffset = -meshBounds.min.y * settings.size;
+
+    uint32_t bucketCount = 64;
+    while (bucketCount < count) {
+        bucketCount *= 2;
+    }
+    crowd.bucketMask = bucketCount - 1;
+    crowd.bucketStarts.resize(bucketCount + 1);
+
+    crowd.entities.resize(count);
+    crowd.xs.resize(count);
+    crowd.zs.resize(count);
+    crowd.velocityXs.resize(count, 0.0f);
+    crowd.velocityZs.resize(count, 0.0f);
+    crowd.headings.resize(count);
+    crowd.seeds.resize(count);
+    crowd.ground.resize(count);
+    crowd.transforms.resize(count);
+    crowd.buckets.resize(count);
+    crowd.cellAgents.resize(count);
+    crowd.cellXs.resize((size_t)count + 3, 0.0f);
+    crowd.cellZs.resize((size_t)count + 3, 0.0f);
+
+    uint32_t state = seed * 2654435761u | 1u;
+    for (uint32_t i = 0; i < count; ++i) {
+        crowd.xs[i] = crowd.minX + (0.5f + 0.5f * next_signed(state)) * (crowd.maxX - crowd.minX);
+        crowd.zs[i] = crowd.minZ + (0.5f + 0.5f * next_signed(state)) * (crowd.maxZ - crowd.minZ);
+        crowd.headings[i] = (float)M_PI * next_signed(state);
+        crowd.seeds[i] = (state ^ (i * 0x9e3779b9u)) | 1u;
+    }
+    place_agents(crowd, field, settings.size, 0, count);
+
+    scene_reserve(scene, scene.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const float shade = 0.45f + 0.1f * next_signed(state);
+        crowd.entities[i] = scene_create(scene, mesh, meshBounds, crowd.transforms[i],
+                                         { shade * 1.3f, shade, shade * 0.7f });
+    }
+    hash_agents(crowd, 0, count);
+    sort_agents(crowd);
+    return crowd;
+}
+
+void crowd_update(Crowd& crowd, SceneStore& scene, JobSystem& jobs, const HeightField& field,
+                  const CrowdSettings& settings, float dt) {
+    jobs.parallel_for(crowd.size(), CROWD_GRAIN, [&](uint32_t begin, uint32_t end) {
+        hash_agents(crowd, begin, end);
+    });
+    // A pass over one array; the steering that follows is where the time goes
+    sort_agents(crowd);
+
+    // Steering reads the positions in cell order and writes only its own agents, so slices never race
+    jobs.parallel_for(crowd.size(), CROWD_GRAIN, [&](uint32_t begin, uint32_t end) {
+        steer_agents(crowd, settings, dt, begin, end);
+        place_agents(crowd, field, settings.size, begin, end);
+    });
+
+    for (uint32_t i = 0; i < crowd.size(); ++i) {
+        scene_set_transform(scene, crowd.entities[i], crowd.transforms[i]);
+    }
+}
+
+void crowd_neighbours(const Crowd& crowd, float x, float z, float radius, std::vector<uint32_t>& agents) {
+    agents.clear();
+    uint32_t buckets[9];
+    const uint32_t bucketCount = neighbour_buckets(crowd, x, z, buckets);
+    for (uint32_t b = 0; b < bucketCount; ++b) {
+        for (uint32_t j = crowd.bucketStarts[buckets[b]]; j < crowd.bucketStarts[buckets[b] + 1]; ++j) {
+            const float dx = crowd.cellXs[j] - x;
+            const float dz = crowd.cellZs[j] - z;
+            if (dx * dx + dz * dz < radius * radius) {
+                agents.push_back(crowd.cellAgents[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file crowd.hpp
+ * @brief Large numbers of wandering animals, steered apart from each other over the terrain.
+ *
+ * Agent state is kept one array per field, so each pass streams only what it reads. Every
+ * update first files the agents into a spatial hash of square cells one separation radius
+ * wide, copying their positions into cell order; an agent's neighbours are then the runs of
+ * at most nine buckets, scanned four at a time. Steering reads only that copy and writes only
+ * the agent's own state, so the agents are split across the job system in independent slices
+ * whose results do not depend on the number of threads. Each slice samples the height field
+ * for its agents in one batch and builds their transforms; the agents are ordinary scene
+ * entities, so they are culled, LOD-selected and drawn instanced by mesh like the rest.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "height_field.hpp"
+#include "job_system.hpp"
+#include "scene.hpp"
+
+/**
+ * @struct CrowdSettings
+ * @brief Steering tunables.
+ */
+struct CrowdSettings {
+    float speed = 1.0f;         ///< Cruising speed in world units per second.
+    float wander = 2.0f;        ///< Largest random turn of the heading, in radians per second.
+    float radius = 1.5f;        ///< Separation radius; also the edge of a hash cell.
+    float separation = 3.0f;    ///< Strength of the push away from neighbours inside the radius.
+    float slope = 2.0f;         ///< Strength of the pull downhill, per unit of gradient.
+    float agility = 4.0f;       ///< Rate at which the velocity follows the steering, per second.
+    float size = 0.6f;          ///< Edge scale of each agent's mesh.
+};
+
+/**
+ * @struct Crowd
+ * @brief The agents, one element per agent in every array, and the spatial hash over them.
+ */
+struct Crowd {
+    // --- Agent state ---
+    std::vector<Entity> entities;           ///< Scene entity of each agent.
+    std::vector<float> xs;                  ///< World x positions.
+    std::vector<float> zs;                  ///< World z positions.
+    std::vector<float> velocityXs;          ///< World x velocities.
+    std::vector<float> velocityZs;          ///< World z velocities.
+    std::vector<float> headings;            ///< Direction each agent wanders towards, in radians from +X.
+    std::vector<uint32_t> seeds;            ///< State of each agent's turn generator.
+    std::vector<TerrainSample> ground;      ///< Terrain under each agent as of the last update.
+    std::vector<simd::float4x4> transforms; ///< Model to world matrices, set by crowd_update().
+
+    // --- Spatial hash, rebuilt by every update ---
+    float cellSize = 1.0f;                  ///< Edge of a hash cell in world units.
+    uint32_t bucketMask = 0;                ///< Bucket count - 1; the count is a power of two.
+    std::vector<uint32_t> buckets;          ///< Bucket of each agent.
+    std::vector<uint32_t> bucketStarts;     ///< Start of each bucket's run in cell order, then the agent count.
+    std::vector<uint32_t> cellAgents;       ///< Agents in cell order.
+    std::vector<float> cellXs;              ///< Positions in cell order, padded by three so runs load four at a time.
+    std::vector<float> cellZs;              ///< As cellXs.
+
+    // --- Placement ---
+    float minX = 0.0f;                      ///< Lowest x an agent may reach.
+    float minZ = 0.0f;                      ///< Lowest z an agent may reach.
+    float maxX = 0.0f;                      ///< Highest x an agent may reach.
+    float maxZ = 0.0f;                      ///< Highest z an agent may reach.
+    float footOffset = 0.0f;                ///< Height of the mesh's origin above its lowest point, at the agent scale.
+
+    /// @return The number of agents.
+    uint32_t size() const { return (uint32_t)entities.size(); }
+};
+
+/**
+ * @brief Scatters agents over a height field and adds an entity for each to the scene.
+ * @param scene The scene; reserved for its current size plus count.
+ * @param field The terrain the agents walk on; they stay inside its grid.
+ * @param count The number of agents.
+ * @param mesh The mesh handle of every agent.
+ * @param meshBounds The model space bounds of the mesh.
+ * @param settings The tunables; radius and size are fixed from here on.
+ * @param seed Changes every placement and every agent's turns.
+ * @return The crowd, standing on the terrain with its hash built.
+ */
+Crowd create_crowd(SceneStore& scene, const HeightField& field, uint32_t count, uint32_t mesh,
+                   const BoundingBox& meshBounds, const CrowdSettings& settings, uint32_t seed = 11);
+
+/**
+ * @brief Steers and moves every agent, stands it on the terrain and moves its entity.
+ *
+ * Each agent turns its heading at random, aims along it, is pulled downhill on steep ground
+ * and pushed away from neighbours closer than the radius; its velocity follows that aim at the
+ * agility rate. Agents reaching the edge of the field turn back towards its centre.
+ *
+ * @param crowd The crowd.
+ * @param scene The scene; the entities get their bounds on the next scene_update_bounds().
+ * @param jobs Runs the hash positions, the steering and the transforms in slices.
+ * @param field The terrain.
+ * @param settings The tunables.
+ * @param dt Seconds since the last update.
+ */
+void crowd_update(Crowd& crowd, SceneStore& scene, JobSystem& jobs, const HeightField& field,
+                  const CrowdSettings& settings, float dt);
+
+/**
+ * @brief Finds the agents near a point as of the last hash build.
+ * @param crowd The crowd.
+ * @param x The world x of the point.
+ * @param z The world z of the point.
+ * @param radius The search radius; at most crowd.cellSize.
+ * @param agents Receives the agents strictly within the radius, in cell order; cleared first.
+ */
+void crowd_neighbours(const Crowd& crowd, float x, float z, float radius, std::vector<uint32_t>& agents);
@@ -1,9 +1,10 @@
 
 #include "cube.hpp"
 
-GameObject create_cube() {
-    GameObject cube;
-    cube.vertices = {
+#include <algorithm>
+
+namespace {
+    const Vertex CUBE_VERTICES[CUBE_VERTEX_COUNT] = {
         // Front face
         { { -0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } },
         { {  0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } },
@@ -41,14 +42,32 @@ GameObject create_cube() {
         { { -0.5f, -0.5f, -0.5f }, { 0.0f, -1.0f, 0.0f } }
     };
 
-    cube.indices = {
+    // Counter-clockwise seen from outside
+    const uint32_t CUBE_INDICES[CUBE_INDEX_COUNT] = {
         0, 1, 2, 0, 2, 3, // Front
-        4, 5, 6, 4, 6, 7, // Back
+        4, 6, 5, 4, 7, 6, // Back
         8, 9, 10, 8, 10, 11, // Left
-        12, 13, 14, 12, 14, 15, // Right
+        12, 14, 13, 12, 15, 14, // Right
         16, 17, 18, 16, 18, 19, // Top
-        20, 21, 22, 20, 22, 23  // Bottom
+        20, 22, 21, 20, 23, 22  // Bottom
     };
-    
+}
+
+void build_cube(Vertex* vertices, uint32_t* indices) {
+    std::copy(CUBE_VERTICES, CUBE_VERTICES + CUBE_VERTEX_COUNT, vertices);
+    std::copy(CUBE_INDICES, CUBE_INDICES + CUBE_INDEX_COUNT, indices);
+}
+
+void build_cube(Vertex* vertices, uint16_t* indices) {
+    std::copy(CUBE_VERTICES, CUBE_VERTICES + CUBE_VERTEX_COUNT, vertices);
+    std::copy(CUBE_INDICES, CUBE_INDICES + CUBE_INDEX_COUNT, indices);
+}
+
+MeshData create_cube() {
+    MeshData cube;
+    cube.vertices.resize(CUBE_VERTEX_COUNT);
+    cube.indices.resize(CUBE_INDEX_COUNT, CUBE_VERTEX_COUNT);
+    build_cube(cube.vertices.data(), cube.indices.indices16.data());
+    cube.bounds = compute_bounds(cube.vertices.data(), cube.vertices.size());
     return cube;
 }
@@ -3,4 +3,20 @@
 
 #include "objects.hpp"
 
-GameObject create_cube();
+/// Vertices of the cube mesh: four per face so every face has its own normal.
+constexpr size_t CUBE_VERTEX_COUNT = 24;
+
+/// Indices of the cube mesh: two triangles per face.
+constexpr size_t CUBE_INDEX_COUNT = 36;
+
+/**
+ * @brief Writes the unit cube into caller-provided storage.
+ * @param vertices Receives CUBE_VERTEX_COUNT vertices.
+ * @param indices Receives CUBE_INDEX_COUNT indices.
+ */
+void build_cube(Vertex* vertices, uint32_t* indices);
+
+/// @copydoc build_cube(Vertex*, uint32_t*)
+void build_cube(Vertex* vertices, uint16_t* indices);
+
+MeshData create_cube();
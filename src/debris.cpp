@@ -0,0 +1,90 @@
+#include "debris.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "affine.hpp"
+
+namespace {
+    // xorshift32: cheap and plenty for scattering launch directions; returns [-1, 1]
+    float next_signed(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (float)(state >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    simd::float4x4 piece_transform(simd::float3 position, float size) {
+        return affine_matrix(affine_translation_scale(position.x, position.y, position.z, size, size, size));
+    }
+
+    template <typename T>
+    void remove_swap(std::vector<T>& array, size_t index) {
+        array[index] = array.back();
+        array.pop_back();
+    }
+}
+
+DebrisPool create_debris_pool(SceneStore& scene, uint32_t capacity) {
+    DebrisPool pool;
+    pool.capacity = capacity;
+    pool.entities.reserve(capacity);
+    pool.positions.reserve(capacity);
+    pool.velocities.reserve(capacity);
+    pool.ages.reserve(capacity);
+    scene_reserve(scene, scene.size() + capacity);
+    return pool;
+}
+
+uint32_t debris_update(DebrisPool& pool, SceneStore& scene, const DebrisSettings& settings, float dt,
+                       simd::float3 origin, simd::float3 direction, uint32_t mesh, const BoundingBox& meshBounds) {
+    // Walking backwards, each removal pulls in a piece that was already updated
+    for (size_t i = pool.size(); i-- > 0;) {
+        pool.ages[i] += dt;
+        if (pool.ages[i] >= settings.lifetime) {
+            scene_destroy(scene, pool.entities[i]);
+            remove_swap(pool.entities, i);
+            remove_swap(pool.positions, i);
+            remove_swap(pool.velocities, i);
+            remove_swap(pool.ages, i);
+            continue;
+        }
+        pool.velocities[i].y -= settings.gravity * dt;
+        pool.positions[i] += pool.velocities[i] * dt;
+        scene_set_transform(scene, pool.entities[i], piece_transform(pool.positions[i], settings.size));
+    }
+
+    pool.pending += std::max(settings.rate, 0.0f) * dt;
+    const uint32_t wanted = (uint32_t)pool.pending;
+    pool.pending -= (float)wanted;
+    const uint32_t spawned = std::min(wanted, pool.capacity - (uint32_t)pool.size());
+
+    const float directionLength = simd::length(direction);
+    const simd::float3 forward = directionLength > 0.0f ? direction / directionLength : simd::float3{ 0.0f, 1.0f, 0.0f };
+    for (uint32_t i = 0; i < spawned; ++i) {
+        simd::float3 launch = forward + settings.spread * simd::float3{ next_signed(pool.seed), next_signed(pool.seed),
+                                                                        next_signed(pool.seed) };
+        const float launchLength = simd::length(launch);
+        launch = launchLength > 0.0f ? launch / launchLength : forward;
+        const float speed = settings.speed * (1.0f + 0.25f * next_signed(pool.seed));
+        const float shade = 0.35f + 0.1f * next_signed(pool.seed);
+
+        pool.entities.push_back(scene_create(scene, mesh, meshBounds, piece_transform(origin, settings.size),
+                                             { shade * 1.2f, shade, shade * 0.8f }));
+        pool.positions.push_back(origin);
+        pool.velocities.push_back(launch * speed);
+        pool.ages.push_back(0.0f);
+    }
+    return spawned;
+}
+
+void debris_clear(DebrisPool& pool, SceneStore& scene) {
+    for (Entity entity : pool.entities) {
+        scene_destroy(scene, entity);
+    }
+    pool.entities.clear();
+    pool.positions.clear();
+    pool.velocities.clear();
+    pool.ages.clear();
+    pool.pending = 0.0f;
+}
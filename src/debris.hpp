@@ -0,0 +1,78 @@
+/**
+ * @file debris.hpp
+ * @brief Short-lived scene entities spawned and expired in large numbers.
+ *
+ * Debris pieces are ordinary scene entities, so they are culled, batched and drawn like
+ * everything else. The pool reserves room for its capacity in the SceneStore and in its own
+ * arrays up front; spawning reuses the scene's free handle slots and despawning swap-removes,
+ * so thousands of pieces a second come and go without a heap allocation, and the handles
+ * of surviving entities keep working throughout.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+
+/**
+ * @struct DebrisSettings
+ * @brief Emission and motion tunables.
+ */
+struct DebrisSettings {
+    float rate = 0.0f;          ///< Pieces spawned per second; 0 stops emission.
+    float lifetime = 3.0f;      ///< Seconds a piece lives.
+    float speed = 10.0f;        ///< Launch speed in world units per second.
+    float spread = 0.4f;        ///< Random deviation of the launch direction, per axis.
+    float gravity = 9.8f;       ///< Downward acceleration.
+    float size = 0.15f;         ///< Edge scale of each piece.
+};
+
+/**
+ * @struct DebrisPool
+ * @brief The live pieces, in spawn order up to swap-removals.
+ */
+struct DebrisPool {
+    std::vector<Entity> entities;           ///< Scene entity of each piece.
+    std::vector<simd::float3> positions;    ///< World positions.
+    std::vector<simd::float3> velocities;   ///< World velocities.
+    std::vector<float> ages;                ///< Seconds since each piece spawned.
+    uint32_t capacity = 0;                  ///< Most pieces alive at once; spawns past it are dropped.
+    float pending = 0.0f;                   ///< Fraction of a piece carried to the next update.
+    uint32_t seed = 1;                      ///< State of the launch direction generator.
+
+    /// @return The number of live pieces.
+    size_t size() const { return entities.size(); }
+};
+
+/**
+ * @brief Creates an empty pool and reserves room for its pieces in the scene.
+ * @param scene The scene the pieces will live in; reserved for its current size plus capacity.
+ * @param capacity The most pieces alive at once.
+ * @return The pool.
+ */
+DebrisPool create_debris_pool(SceneStore& scene, uint32_t capacity);
+
+/**
+ * @brief Ages and moves the pieces, removes expired ones and spawns new ones.
+ * @param pool The pool.
+ * @param scene The scene; moved pieces get their bounds on the next scene_update_bounds().
+ * @param settings The tunables.
+ * @param dt Seconds since the last update.
+ * @param origin Where new pieces appear.
+ * @param direction The mean launch direction; need not be normalized.
+ * @param mesh The mesh handle of new pieces.
+ * @param meshBounds The model space bounds of the mesh.
+ * @return The number of pieces spawned.
+ */
+uint32_t debris_update(DebrisPool& pool, SceneStore& scene, const DebrisSettings& settings, float dt,
+                       simd::float3 origin, simd::float3 direction, uint32_t mesh, const BoundingBox& meshBounds);
+
+/**
+ * @brief Destroys every piece.
+ * @param pool The pool.
+ * @param scene The scene holding the pieces.
+ */
+void debris_clear(DebrisPool& pool, SceneStore& scene);
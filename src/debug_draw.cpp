@@ -0,0 +1,99 @@
+#include "debug_draw.hpp"
+
+#include <algorithm>
+
+#include "fog.hpp"
+
+namespace {
+    // Corner pairs of the 12 edges; the corners of each pair differ in one bit. Matches shaders.metal.
+    constexpr uint8_t SHAPE_EDGES[DEBUG_SHAPE_VERTICES] = {
+        0, 1, 2, 3, 4, 5, 6, 7,     // Along x
+        0, 2, 1, 3, 4, 6, 5, 7,     // Along y
+        0, 4, 1, 5, 2, 6, 3, 7,     // Along z
+    };
+
+    constexpr simd::float4 LOD_COLORS[] = {
+        { 0.1f, 0.9f, 0.2f, 1.0f },
+        { 0.7f, 0.9f, 0.1f, 1.0f },
+        { 1.0f, 0.8f, 0.1f, 1.0f },
+        { 1.0f, 0.5f, 0.1f, 1.0f },
+        { 1.0f, 0.15f, 0.1f, 1.0f },
+    };
+
+    DebugShape* add_shape(DebugDraw& draw) {
+        if (draw.shapes.size() >= DEBUG_DRAW_MAX_SHAPES) {
+            return nullptr;
+        }
+        draw.shapes.emplace_back();
+        return &draw.shapes.back();
+    }
+
+    simd::float3 unproject(const simd::float4x4& inverseViewProjection, float x, float y, float z) {
+        const simd::float4 world = inverseViewProjection * simd::float4{ x, y, z, 1.0f };
+        return simd::float3{ world.x, world.y, world.z } / world.w;
+    }
+}
+
+void debug_draw_clear(DebugDraw& draw) {
+    draw.shapes.clear();
+}
+
+void debug_draw_box(DebugDraw& draw, const BoundingBox& box, simd::float4 color) {
+    DebugShape* shape = add_shape(draw);
+    if (!shape) {
+        return;
+    }
+    for (uint32_t i = 0; i < DEBUG_SHAPE_CORNERS; ++i) {
+        shape->corners[i] = simd::float3{ (i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                                          (i & 4) ? box.max.z : box.min.z };
+    }
+    shape->color = color;
+}
+
+void debug_draw_frustum(DebugDraw& draw, const simd::float4x4& viewProjection, simd::float3 eye, float distance,
+                        simd::float4 color) {
+    DebugShape* shape = add_shape(draw);
+    if (!shape) {
+        return;
+    }
+    // Clip depth 0.5 lies strictly between the planes whether depth is reversed or the far plane
+    // infinite, so the corner rays come from there rather than from the far plane
+    const simd::float4x4 inverse = simd::inverse(viewProjection);
+    const simd::float3 centre = unproject(inverse, 0.0f, 0.0f, 0.5f);
+    const simd::float3 forward = simd::normalize(centre - eye);
+    for (uint32_t i = 0; i < 4; ++i) {
+        const simd::float3 corner = unproject(inverse, (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, 0.5f);
+        const simd::float3 ray = corner - eye;
+        shape->corners[i] = eye;
+        shape->corners[i + 4] = eye + ray * (distance / simd::dot(ray, forward));
+    }
+    shape->color = color;
+}
+
+uint32_t debug_shape_corner(uint32_t vertex) {
+    return SHAPE_EDGES[vertex];
+}
+
+DebugCull debug_cull(const Frustum& frustum, simd::float3 eye, float fogDistance, const BoundingBox& box) {
+    if (!frustum_intersects(frustum, box)) {
+        return DebugCull::FrustumCulled;
+    }
+    return box_distance(box, eye) > fogDistance ? DebugCull::FogCulled : DebugCull::Visible;
+}
+
+simd::float4 debug_cull_color(DebugCull cull) {
+    switch (cull) {
+    case DebugCull::Visible:
+        return { 0.1f, 0.9f, 0.2f, 1.0f };
+    case DebugCull::FogCulled:
+        return { 0.2f, 0.5f, 1.0f, 1.0f };
+    case DebugCull::FrustumCulled:
+        return { 1.0f, 0.15f, 0.1f, 1.0f };
+    }
+    return {};
+}
+
+simd::float4 debug_lod_color(int level) {
+    const int count = (int)(sizeof(LOD_COLORS) / sizeof(LOD_COLORS[0]));
+    return LOD_COLORS[std::clamp(level, 0, count - 1)];
+}
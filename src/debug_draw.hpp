@@ -0,0 +1,120 @@
+/**
+ * @file debug_draw.hpp
+ * @brief Wireframe boxes and frustums drawn over the frame, to see what culling, LOD and streaming did.
+ *
+ * Every shape is a hexahedron of eight corners: an axis-aligned box, or a view frustum whose
+ * near face has shrunk to the eye. Corner i of a box takes its x from max if bit 0 of i is
+ * set, y from bit 1 and z from bit 2; a frustum numbers its corners the same way, x right,
+ * y up and z away from the eye. GpuDebugDraw draws all the frame's shapes with one instanced
+ * draw of DEBUG_SHAPE_VERTICES line-list vertices per shape, which debug_draw_vertex in
+ * shaders.metal maps to corners through the same edge table as debug_shape_corner().
+ *
+ * Nothing here runs unless one of DebugDrawSettings' layers is on.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "frustum.hpp"
+#include "objects.hpp"
+
+/// Corners of every shape.
+constexpr uint32_t DEBUG_SHAPE_CORNERS = 8;
+/// Line-list vertices drawn per shape: its 12 edges.
+constexpr uint32_t DEBUG_SHAPE_VERTICES = 24;
+/// Shapes drawn in one frame; the rest are dropped.
+constexpr uint32_t DEBUG_DRAW_MAX_SHAPES = 32768;
+
+/// Chunks requested but not yet resident, drawn flat at the terrain height of their centre.
+constexpr simd::float4 DEBUG_PENDING_COLOR = { 0.6f, 0.6f, 0.6f, 1.0f };
+/// The frozen culling frustum.
+constexpr simd::float4 DEBUG_FRUSTUM_COLOR = { 1.0f, 1.0f, 1.0f, 1.0f };
+/// The picked entity's bounds.
+constexpr simd::float4 DEBUG_SELECTED_COLOR = { 1.0f, 0.5f, 0.0f, 1.0f };
+/// Navigation mesh polygons, drawn flat on the ground of their centre.
+constexpr simd::float4 DEBUG_NAV_MESH_COLOR = { 0.2f, 0.6f, 1.0f, 1.0f };
+
+/**
+ * @struct DebugShape
+ * @brief One wireframe hexahedron; the layout debug_draw_vertex reads.
+ */
+struct DebugShape {
+    simd::float3 corners[DEBUG_SHAPE_CORNERS]; ///< World space corners, numbered as in the file comment.
+    simd::float4 color;                        ///< Line colour.
+};
+
+/**
+ * @struct DebugDrawSettings
+ * @brief The debug layers toggled in the overlay.
+ */
+struct DebugDrawSettings {
+    bool chunks = false;        ///< Chunk bounds coloured by LOD, and the chunks still streaming in.
+    bool objects = false;       ///< Scene entity bounds coloured by their cull result.
+    bool freezeFrustum = false; ///< Culling keeps the frustum of the frame it was frozen on, which is drawn.
+    bool navMesh = false;       ///< Navigation mesh polygons around the camera.
+};
+
+/// @return True if any layer draws shapes.
+inline bool debug_draw_enabled(const DebugDrawSettings& settings) {
+    return settings.chunks || settings.objects || settings.freezeFrustum || settings.navMesh;
+}
+
+/**
+ * @enum DebugCull
+ * @brief Why an entity was or was not drawn.
+ */
+enum class DebugCull : uint8_t {
+    Visible,        ///< Drawn.
+    FogCulled,      ///< In the frustum, but entirely hidden by fog.
+    FrustumCulled,  ///< Outside the frustum.
+};
+
+/**
+ * @struct DebugDraw
+ * @brief The shapes of one frame; the array keeps its capacity from frame to frame.
+ */
+struct DebugDraw {
+    std::vector<DebugShape> shapes;
+};
+
+/// @brief Drops the last frame's shapes.
+void debug_draw_clear(DebugDraw& draw);
+
+/// @brief Adds the wireframe of an axis-aligned box; ignored beyond DEBUG_DRAW_MAX_SHAPES.
+void debug_draw_box(DebugDraw& draw, const BoundingBox& box, simd::float4 color);
+
+/**
+ * @brief Adds the wireframe of a view frustum, cut off at a distance.
+ * @param draw The shapes.
+ * @param viewProjection The frustum's world to clip transform; the far plane may be at infinity.
+ * @param eye The frustum's eye.
+ * @param distance View depth the far face is drawn at.
+ * @param color Line colour.
+ */
+void debug_draw_frustum(DebugDraw& draw, const simd::float4x4& viewProjection, simd::float3 eye, float distance,
+                        simd::float4 color);
+
+/// @return The corner a line-list vertex of a shape is at; vertex is below DEBUG_SHAPE_VERTICES.
+uint32_t debug_shape_corner(uint32_t vertex);
+
+/**
+ * @brief Returns what the scene's culling makes of a box.
+ *
+ * Matches queue_scene_objects: the frustum test first, then the fog distance.
+ *
+ * @param frustum The culling frustum.
+ * @param eye The eye fog is measured from.
+ * @param fogDistance Distance beyond which fog hides everything; infinite if it never does.
+ * @param box The world space box.
+ * @return The cull result.
+ */
+DebugCull debug_cull(const Frustum& frustum, simd::float3 eye, float fogDistance, const BoundingBox& box);
+
+/// @return The colour of a cull result: green drawn, blue fogged, red outside the frustum.
+simd::float4 debug_cull_color(DebugCull cull);
+
+/// @return The colour of a chunk LOD level, from green at full detail through yellow to red.
+simd::float4 debug_lod_color(int level);
@@ -0,0 +1,81 @@
+/**
+ * @file deferred.hpp
+ * @brief Tile-based deferred shading inside the scene pass, with the G-buffer kept in tile memory.
+ *
+ * In deferred mode surfaces are not lit as they are drawn. They write albedo, an octahedral
+ * normal and their depth into memoryless attachments, which only ever exist in the GPU's tile
+ * memory. After the last surface, one full-screen triangle in the same pass reads the tile's
+ * G-buffer through programmable blending and lights every covered pixel once, so lighting costs
+ * one evaluation per pixel instead of one per drawn fragment, and no G-buffer bytes reach memory.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstdint>
+
+#include "camera.hpp"
+#include "frame_stats.hpp"
+
+/// Surface colour; colour attachment 1 of the deferred pass.
+constexpr MTLPixelFormat GBUFFER_ALBEDO_FORMAT = MTLPixelFormatRGBA8Unorm;
+/// Octahedral world-space normal; colour attachment 2.
+constexpr MTLPixelFormat GBUFFER_NORMAL_FORMAT = MTLPixelFormatRG16Snorm;
+/// Clip-space depth, from which the lighting pass rebuilds the position; colour attachment 3.
+constexpr MTLPixelFormat GBUFFER_DEPTH_FORMAT = MTLPixelFormatR32Float;
+
+/**
+ * @struct GBuffer
+ * @brief The memoryless G-buffer attachments and the lighting pass state.
+ */
+struct GBuffer {
+    id<MTLTexture> albedo;                      ///< Colour attachment 1.
+    id<MTLTexture> normal;                      ///< Colour attachment 2.
+    id<MTLTexture> depth;                       ///< Colour attachment 3.
+    id<MTLDepthStencilState> lightingDepthState; ///< Passes in front of the far plane, without writes: the sky stays.
+    uint32_t width = 0;                         ///< Width of the attachments in pixels.
+    uint32_t height = 0;                        ///< Height of the attachments in pixels.
+    uint32_t sampleCount = 1;                   ///< Samples per pixel; above 1 the lighting runs per sample.
+};
+
+/// @return True if the device has memoryless attachments and programmable blending.
+bool deferred_supported(id<MTLDevice> device);
+
+/**
+ * @brief Creates a G-buffer without attachments; gbuffer_resize() allocates them.
+ * @param device The Metal device.
+ * @param reverseZ True if the scene is drawn with a reverse-Z projection, whose far plane is at depth 0.
+ * @return The G-buffer.
+ */
+GBuffer create_gbuffer(id<MTLDevice> device, bool reverseZ = false);
+
+/**
+ * @brief Reallocates the attachments if the scene target changed size or sample count.
+ *
+ * Memoryless textures hold no memory, so this only costs the texture objects.
+ *
+ * @param gbuffer The G-buffer.
+ * @param device The Metal device.
+ * @param width The scene target width in pixels.
+ * @param height The scene target height in pixels.
+ * @param sampleCount Samples per pixel of the scene pass.
+ */
+void gbuffer_resize(GBuffer& gbuffer, id<MTLDevice> device, uint32_t width, uint32_t height, uint32_t sampleCount = 1);
+
+/**
+ * @brief Adds the G-buffer attachments to a scene pass. They are neither loaded nor stored.
+ * @param gbuffer The G-buffer, sized like the pass's colour target.
+ * @param passDesc The scene pass.
+ */
+void gbuffer_attach(const GBuffer& gbuffer, MTLRenderPassDescriptor* passDesc);
+
+/**
+ * @brief Lights the G-buffer into colour attachment 0. Must be the last draw of the pass.
+ * @param enc The render encoder, with the shadow map bound if the pipeline samples it.
+ * @param pipeline The ShaderProgram::DeferredLighting variant.
+ * @param gbuffer The G-buffer the pass writes.
+ * @param cam The camera the surfaces were drawn with.
+ * @param frameStats Receives the draw.
+ */
+void deferred_encode_lighting(id<MTLRenderCommandEncoder> enc, id<MTLRenderPipelineState> pipeline,
+                              const GBuffer& gbuffer, const Camera& cam, FrameStats& frameStats);
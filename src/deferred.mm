@@ -0,0 +1,82 @@
+#import "deferred.hpp"
+
+#include "trace.hpp"
+
+namespace {
+    // Matches DeferredUniforms in shaders.metal
+    struct DeferredUniforms {
+        simd::float4x4 inverseViewProjection;
+        float farDepth;
+    };
+
+    id<MTLTexture> create_attachment(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                                     uint32_t sampleCount, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        if (sampleCount > 1) {
+            desc.textureType = MTLTextureType2DMultisample;
+            desc.sampleCount = sampleCount;
+        }
+        desc.storageMode = MTLStorageModeMemoryless;
+        desc.usage = MTLTextureUsageRenderTarget;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+
+    void attach(MTLRenderPassDescriptor* passDesc, NSUInteger index, id<MTLTexture> texture) {
+        // Every pixel the lighting pass reads was written by a surface first
+        passDesc.colorAttachments[index].texture = texture;
+        passDesc.colorAttachments[index].loadAction = MTLLoadActionDontCare;
+        passDesc.colorAttachments[index].storeAction = MTLStoreActionDontCare;
+    }
+}
+
+bool deferred_supported(id<MTLDevice> device) {
+    return [device supportsFamily:MTLGPUFamilyApple1];
+}
+
+GBuffer create_gbuffer(id<MTLDevice> device, bool reverseZ) {
+    GBuffer gbuffer;
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = reverseZ ? MTLCompareFunctionLess : MTLCompareFunctionGreater;
+    depthDesc.depthWriteEnabled = NO;
+    gbuffer.lightingDepthState = [device newDepthStencilStateWithDescriptor:depthDesc];
+    return gbuffer;
+}
+
+void gbuffer_resize(GBuffer& gbuffer, id<MTLDevice> device, uint32_t width, uint32_t height, uint32_t sampleCount) {
+    if (gbuffer.albedo && gbuffer.width == width && gbuffer.height == height && gbuffer.sampleCount == sampleCount) {
+        return;
+    }
+    gbuffer.albedo = create_attachment(device, GBUFFER_ALBEDO_FORMAT, width, height, sampleCount, @"G-buffer albedo");
+    gbuffer.normal = create_attachment(device, GBUFFER_NORMAL_FORMAT, width, height, sampleCount, @"G-buffer normal");
+    gbuffer.depth = create_attachment(device, GBUFFER_DEPTH_FORMAT, width, height, sampleCount, @"G-buffer depth");
+    gbuffer.width = width;
+    gbuffer.height = height;
+    gbuffer.sampleCount = sampleCount;
+}
+
+void gbuffer_attach(const GBuffer& gbuffer, MTLRenderPassDescriptor* passDesc) {
+    attach(passDesc, 1, gbuffer.albedo);
+    attach(passDesc, 2, gbuffer.normal);
+    attach(passDesc, 3, gbuffer.depth);
+}
+
+void deferred_encode_lighting(id<MTLRenderCommandEncoder> enc, id<MTLRenderPipelineState> pipeline,
+                              const GBuffer& gbuffer, const Camera& cam, FrameStats& frameStats) {
+    DeferredUniforms uniforms;
+    uniforms.inverseViewProjection = simd::inverse(cam.projectionMatrix * cam.viewMatrix);
+    uniforms.farDepth = camera_clear_depth(cam);
+
+    TRACE_PUSH_GROUP(enc, "Deferred lighting");
+    [enc setRenderPipelineState:pipeline];
+    [enc setDepthStencilState:gbuffer.lightingDepthState];
+    [enc setVertexBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+    [enc setFragmentBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+    [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+    TRACE_POP_GROUP(enc);
+    frame_stats_count_draw(frameStats, 3);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file display_link.hpp
+ * @brief Refresh timing of the window's display and paced presentation through CAMetalLayer.
+ */
+
+#pragma once
+#import <CoreVideo/CoreVideo.h>
+#import <Metal/Metal.h>
+#import <QuartzCore/CAMetalLayer.h>
+
+#include <atomic>
+
+#include "frame_pacing.hpp"
+
+/**
+ * @class DisplayLink
+ * @brief Tracks the refresh period of one display with a CVDisplayLink.
+ *
+ * The link runs a callback on its own thread at every vertical blank, which stores the
+ * measured period; ProMotion and external displays report their real rate there rather
+ * than the nominal one. The render thread only reads the stored values.
+ */
+class DisplayLink {
+public:
+    /// Starts a link for the main display.
+    DisplayLink();
+    ~DisplayLink();
+
+    DisplayLink(const DisplayLink&) = delete;
+    DisplayLink& operator=(const DisplayLink&) = delete;
+
+    /**
+     * @brief Follows another display, e.g. after the window moved screens.
+     * @param display The display; no-op if it is the current one.
+     */
+    void set_display(CGDirectDisplayID display);
+
+    /// @return The refresh period in seconds, 1/60 until the display has reported one.
+    double refresh_period() const { return m_period.load(std::memory_order_relaxed); }
+
+    /// @return The next refresh the link reported, on simulation_clock(); negative until it has reported one.
+    double vsync_time() const { return m_vsync.load(std::memory_order_relaxed); }
+
+private:
+    static CVReturn on_vsync(CVDisplayLinkRef link, const CVTimeStamp* now, const CVTimeStamp* output,
+                             CVOptionFlags flags, CVOptionFlags* flagsOut, void* context);
+    void read_nominal_period();
+
+    CVDisplayLinkRef m_link = nullptr;
+    CGDirectDisplayID m_display = 0;
+    std::atomic<double> m_period{ 1.0 / 60.0 };
+    std::atomic<double> m_vsync{ -1.0 };
+};
+
+/**
+ * @brief Applies the display sync and drawable count of a present mode to a layer.
+ * @param layer The window's layer.
+ * @param settings The present mode.
+ */
+void apply_present_mode(CAMetalLayer* layer, const FramePacingSettings& settings);
+
+/**
+ * @brief Schedules a drawable's presentation according to the present mode.
+ * @param cmd The frame's command buffer, before commit.
+ * @param drawable The drawable to present.
+ * @param settings The present mode.
+ * @param refreshPeriod The display refresh period in seconds.
+ */
+void present_paced(id<MTLCommandBuffer> cmd, id<CAMetalDrawable> drawable, const FramePacingSettings& settings,
+                   double refreshPeriod);
@@ -0,0 +1,68 @@
+#import "display_link.hpp"
+
+#include "simulation.hpp"
+
+DisplayLink::DisplayLink() {
+    if (CVDisplayLinkCreateWithActiveCGDisplays(&m_link) != kCVReturnSuccess) {
+        NSLog(@"Failed to create a display link; assuming 60 Hz");
+        m_link = nullptr;
+        return;
+    }
+    m_display = CVDisplayLinkGetCurrentCGDisplay(m_link);
+    read_nominal_period();
+    CVDisplayLinkSetOutputCallback(m_link, &DisplayLink::on_vsync, this);
+    CVDisplayLinkStart(m_link);
+}
+
+DisplayLink::~DisplayLink() {
+    if (m_link) {
+        // Stop waits for a callback in progress, so this is not touched afterwards
+        CVDisplayLinkStop(m_link);
+        CVDisplayLinkRelease(m_link);
+    }
+}
+
+void DisplayLink::set_display(CGDirectDisplayID display) {
+    if (!m_link || display == m_display) {
+        return;
+    }
+    m_display = display;
+    CVDisplayLinkSetCurrentCGDisplay(m_link, display);
+    read_nominal_period();
+}
+
+void DisplayLink::read_nominal_period() {
+    CVTime nominal = CVDisplayLinkGetNominalOutputVideoRefreshPeriod(m_link);
+    if (!(nominal.flags & kCVTimeIsIndefinite) && nominal.timeValue > 0) {
+        m_period.store((double)nominal.timeValue / nominal.timeScale, std::memory_order_relaxed);
+    }
+}
+
+CVReturn DisplayLink::on_vsync(CVDisplayLinkRef link, const CVTimeStamp* now, const CVTimeStamp* output,
+                               CVOptionFlags flags, CVOptionFlags* flagsOut, void* context) {
+    DisplayLink* self = (DisplayLink*)context;
+    double actual = CVDisplayLinkGetActualOutputVideoRefreshPeriod(link);
+    if (actual > 0.0) {
+        self->m_period.store(actual, std::memory_order_relaxed);
+    }
+    // The output time is on the host clock; moved onto the steady clock the frame loop reads
+    const int64_t ticks = (int64_t)output->hostTime - (int64_t)CVGetCurrentHostTime();
+    const double ahead = (double)ticks / CVGetHostClockFrequency();
+    self->m_vsync.store(simulation_clock() + ahead, std::memory_order_relaxed);
+    return kCVReturnSuccess;
+}
+
+void apply_present_mode(CAMetalLayer* layer, const FramePacingSettings& settings) {
+    layer.displaySyncEnabled = settings.mode != PresentMode::Uncapped;
+    layer.maximumDrawableCount = settings.drawableCount;
+}
+
+void present_paced(id<MTLCommandBuffer> cmd, id<CAMetalDrawable> drawable, const FramePacingSettings& settings,
+                   double refreshPeriod) {
+    if (settings.mode == PresentMode::FixedRate) {
+        // Holding each frame for the whole interval also throttles nextDrawable, so the CPU idles
+        [cmd presentDrawable:drawable afterMinimumDuration:frame_pacing_interval(settings, refreshPeriod)];
+    } else {
+        [cmd presentDrawable:drawable];
+    }
+}
@@ -0,0 +1,88 @@
+#include "draw_costs.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Sign-extends a 12-bit chunk coordinate
+    int chunk_coordinate(uint32_t bits) {
+        return (int)(bits << 20) >> 20;
+    }
+
+    void add(std::unordered_map<uint32_t, DrawCost>& sums, uint32_t id, float ms) {
+        DrawCost& sum = sums[id];
+        sum.id = id;
+        sum.ms += ms;
+        sum.draws++;
+    }
+}
+
+std::string draw_object_name(uint32_t object) {
+    const uint32_t index = object & 0xFFFFFF;
+    switch ((DrawObjectKind)(object >> 24)) {
+    case DrawObjectKind::Chunk:
+        return "chunk (" + std::to_string(chunk_coordinate(index & 0xFFF)) + ", " +
+               std::to_string(chunk_coordinate(index >> 12)) + ")";
+    case DrawObjectKind::Mesh:
+        return "mesh " + std::to_string(index >> 4) + " lod " + std::to_string(index & 0xF);
+    case DrawObjectKind::Foliage:
+        return "foliage";
+    case DrawObjectKind::Impostors:
+        return "impostors";
+    case DrawObjectKind::Skinned:
+        return "creature " + std::to_string(index);
+    default:
+        return "untagged";
+    }
+}
+
+bool draw_costs_sample_frame(const DrawCostSettings& settings, uint64_t frame) {
+    return settings.periodFrames > 0 && frame % settings.periodFrames < settings.sampledFrames;
+}
+
+std::vector<DrawCost> top_draw_costs(const std::unordered_map<uint32_t, DrawCost>& sums, uint32_t frames,
+                                     uint32_t count) {
+    std::vector<DrawCost> top;
+    top.reserve(sums.size());
+    for (const auto& [id, sum] : sums) {
+        top.push_back(sum);
+    }
+    const auto costlier = [](const DrawCost& a, const DrawCost& b) {
+        return a.ms != b.ms ? a.ms > b.ms : a.id < b.id;
+    };
+    const size_t kept = std::min<size_t>(count, top.size());
+    std::partial_sort(top.begin(), top.begin() + kept, top.end(), costlier);
+    top.resize(kept);
+    frames = std::max(frames, 1u);
+    for (DrawCost& cost : top) {
+        cost.ms /= (float)frames;
+        cost.draws = (cost.draws + frames - 1) / frames;
+    }
+    return top;
+}
+
+void draw_costs_record_frame(DrawCosts& costs, const DrawTag* tags, const float* ms, uint32_t count) {
+    std::lock_guard<std::mutex> lock(costs.mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (ms[i] < 0.0f) {
+            continue;
+        }
+        add(costs.objectSums, tags[i].object, ms[i]);
+        add(costs.materialSums, tags[i].material, ms[i]);
+    }
+    if (++costs.windowFrames < std::max(costs.settings.sampledFrames, 1u)) {
+        return;
+    }
+    costs.topObjects = top_draw_costs(costs.objectSums, costs.windowFrames, costs.settings.topCount);
+    costs.topMaterials = top_draw_costs(costs.materialSums, costs.windowFrames, costs.settings.topCount);
+    costs.objectSums.clear();
+    costs.materialSums.clear();
+    costs.windowFrames = 0;
+    costs.windows++;
+}
+
+uint64_t draw_costs_top(const DrawCosts& costs, std::vector<DrawCost>& objects, std::vector<DrawCost>& materials) {
+    std::lock_guard<std::mutex> lock(costs.mutex);
+    objects = costs.topObjects;
+    materials = costs.topMaterials;
+    return costs.windows;
+}
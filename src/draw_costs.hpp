@@ -0,0 +1,127 @@
+/**
+ * @file draw_costs.hpp
+ * @brief GPU time per draw, summed by object and material over a few sampled frames.
+ *
+ * The whole-frame and per-pass GPU times do not say which objects are expensive. On GPUs that
+ * sample timestamps at draw boundaries (see gpu_draw_costs.hpp), the render queue brackets
+ * every draw of a sampled frame with two timestamps and records its DrawTag. The draws of a
+ * few consecutive frames are summed per object and per material, and the most expensive of
+ * each, in milliseconds per frame, replace the previous window's. Sampling serializes the
+ * draws, so only sampledFrames of every periodFrames are timed; the times are an upper bound
+ * of what the draws cost when they overlap.
+ *
+ * Nothing here touches Metal, so the bookkeeping is tested on its own.
+ */
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @enum DrawObjectKind
+ * @brief What a tagged draw shows; the top byte of a draw's object identifier.
+ */
+enum class DrawObjectKind : uint32_t {
+    Untagged,   ///< Nothing told the queue what the draw is.
+    Chunk,      ///< A terrain chunk; the index packs its grid coordinates.
+    Mesh,       ///< One detail level of a scene mesh, all its instances; the index packs both.
+    Foliage,    ///< The foliage instances.
+    Impostors,  ///< The foliage impostor quads.
+    Skinned,    ///< One skinned creature; the index is its instance.
+};
+
+/// @return An object identifier, the kind in the top byte and 24 bits of index.
+constexpr uint32_t make_draw_object(DrawObjectKind kind, uint32_t index) {
+    return (uint32_t)kind << 24 | (index & 0xFFFFFF);
+}
+
+/// @return The object identifier of a terrain chunk; coordinates wrap past +-2048.
+constexpr uint32_t make_chunk_draw_object(int x, int z) {
+    return make_draw_object(DrawObjectKind::Chunk, ((uint32_t)x & 0xFFF) | ((uint32_t)z & 0xFFF) << 12);
+}
+
+/// @return The object identifier of one detail level of a mesh; meshes wrap past 2^20.
+constexpr uint32_t make_mesh_draw_object(uint32_t mesh, uint32_t lod) {
+    return make_draw_object(DrawObjectKind::Mesh, mesh << 4 | (lod & 0xF));
+}
+
+/// @return A readable name for an object identifier, e.g. "chunk (3, -2)" or "mesh 5 lod 1".
+std::string draw_object_name(uint32_t object);
+
+/**
+ * @struct DrawTag
+ * @brief What a timed draw drew.
+ */
+struct DrawTag {
+    uint32_t object = 0;    ///< See make_draw_object().
+    uint32_t material = 0;  ///< DrawCommand::material.
+};
+
+/**
+ * @struct DrawCost
+ * @brief GPU time of the draws of one object or material.
+ */
+struct DrawCost {
+    uint32_t id = 0;        ///< Object identifier or material.
+    float ms = 0.0f;        ///< Milliseconds per sampled frame.
+    uint32_t draws = 0;     ///< Draws per sampled frame, rounded up.
+};
+
+/**
+ * @struct DrawCostSettings
+ * @brief How often draws are timed and how many results are kept.
+ */
+struct DrawCostSettings {
+    uint32_t sampledFrames = 4;     ///< Consecutive frames timed per window.
+    uint32_t periodFrames = 60;     ///< Frames from the start of one window to the next.
+    uint32_t topCount = 8;          ///< Most expensive objects and materials kept.
+};
+
+/// @return True if a frame's draws are timed: the first sampledFrames of every periodFrames.
+bool draw_costs_sample_frame(const DrawCostSettings& settings, uint64_t frame);
+
+/**
+ * @brief The most expensive entries of a sum, by time.
+ * @param sums Summed costs by identifier.
+ * @param frames Frames summed; times and draw counts are divided by it.
+ * @param count Entries kept.
+ * @return Up to count entries, most expensive first; ties go to the lower identifier.
+ */
+std::vector<DrawCost> top_draw_costs(const std::unordered_map<uint32_t, DrawCost>& sums, uint32_t frames,
+                                     uint32_t count);
+
+/**
+ * @struct DrawCosts
+ * @brief The window being summed and the last finished one's results.
+ *
+ * Frames are recorded from command buffer completion handlers and read by the overlay, so
+ * everything but the settings is guarded by the mutex.
+ */
+struct DrawCosts {
+    DrawCostSettings settings;
+    std::unordered_map<uint32_t, DrawCost> objectSums;      ///< The current window, by object.
+    std::unordered_map<uint32_t, DrawCost> materialSums;    ///< The current window, by material.
+    uint32_t windowFrames = 0;          ///< Frames summed in the current window.
+    std::vector<DrawCost> topObjects;   ///< The last window's most expensive objects.
+    std::vector<DrawCost> topMaterials; ///< The last window's most expensive materials.
+    uint64_t windows = 0;               ///< Windows finished.
+    mutable std::mutex mutex;
+};
+
+/**
+ * @brief Adds a frame's timed draws to the window, finishing it after sampledFrames frames.
+ * @param costs The costs.
+ * @param tags The tag of each draw.
+ * @param ms The GPU time of each draw; negative for draws that could not be timed.
+ * @param count Draws timed.
+ */
+void draw_costs_record_frame(DrawCosts& costs, const DrawTag* tags, const float* ms, uint32_t count);
+
+/**
+ * @brief Copies the last finished window's results.
+ * @return Windows finished so far; 0 if objects and materials are still empty.
+ */
+uint64_t draw_costs_top(const DrawCosts& costs, std::vector<DrawCost>& objects, std::vector<DrawCost>& materials);
@@ -0,0 +1,81 @@
+
+#include "draw_sort.hpp"
+
+#include <algorithm>
+#include <utility>
+
+void radix_sort_draws(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+    const size_t count = packets.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    // Build every histogram in one read of the keys
+    uint32_t histograms[8][256] = {};
+    for (const auto& packet : packets) {
+        for (int pass = 0; pass < 8; ++pass) {
+            histograms[pass][(packet.key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    DrawPacket* src = packets.data();
+    DrawPacket* dst = scratch.data();
+    for (int pass = 0; pass < 8; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        const uint32_t firstByte = (src[0].key >> (pass * 8)) & 0xFF;
+        if (histogram[firstByte] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            uint32_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            dst[histogram[(src[i].key >> (pass * 8)) & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != packets.data()) {
+        packets.swap(scratch);
+    }
+}
+
+void sort_front_to_back(const CullBounds& bounds, simd::float3 eye, uint32_t* visible, size_t count,
+                        uint64_t* scratch) {
+    // Squared distances are non-negative, so their bits order like them; the index breaks ties
+    for (size_t v = 0; v < count; ++v) {
+        const uint32_t i = visible[v];
+        const float dx = bounds.centerX[i] - eye.x;
+        const float dy = bounds.centerY[i] - eye.y;
+        const float dz = bounds.centerZ[i] - eye.z;
+        const float distance2 = dx * dx + dy * dy + dz * dz;
+        uint32_t bits;
+        memcpy(&bits, &distance2, sizeof(bits));
+        scratch[v] = ((uint64_t)bits << 32) | i;
+    }
+    std::sort(scratch, scratch + count);
+    for (size_t v = 0; v < count; ++v) {
+        visible[v] = (uint32_t)scratch[v];
+    }
+}
+
+uint32_t slice_draws(uint32_t drawCount, uint32_t maxSlices, uint32_t minDrawsPerSlice, DrawSlice* slices) {
+    if (drawCount == 0) {
+        return 0;
+    }
+    uint32_t count = std::min(std::max(maxSlices, 1u), std::max(drawCount / std::max(minDrawsPerSlice, 1u), 1u));
+
+    // The first drawCount % count slices take one extra draw
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t size = drawCount / count + (i < drawCount % count ? 1 : 0);
+        slices[i] = { begin, begin + size };
+        begin += size;
+    }
+    return count;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file draw_sort.hpp
+ * @brief 64-bit draw sort keys and a radix sort that groups draws by render state.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "frustum.hpp"
+
+/// Bits of the sort key holding each field, from most to least significant.
+constexpr int DRAW_KEY_PIPELINE_BITS = 8;
+constexpr int DRAW_KEY_DEPTH_STATE_BITS = 4;
+constexpr int DRAW_KEY_MATERIAL_BITS = 20;
+constexpr int DRAW_KEY_VERTEX_BUFFER_BITS = 32;
+
+/**
+ * @struct DrawPacket
+ * @brief A draw to be sorted: its key and the index of the command it refers to.
+ */
+struct DrawPacket {
+    uint64_t key = 0;       ///< Sort key from make_draw_key().
+    uint32_t command = 0;   ///< Index of the draw in the caller's command list.
+};
+
+/**
+ * @brief Packs the render state of a draw into a key whose order groups equal state together.
+ *
+ * The pipeline is most significant because it is the most expensive change, followed
+ * by the depth state, the material and the vertex buffer. Each field is truncated to its
+ * DRAW_KEY_*_BITS width.
+ *
+ * @param pipeline Small identifier of the render pipeline.
+ * @param depthState Small identifier of the depth stencil state.
+ * @param material Identifier of the material.
+ * @param vertexBuffer Identifier of the vertex buffer.
+ * @return The sort key.
+ */
+inline uint64_t make_draw_key(uint32_t pipeline, uint32_t depthState, uint32_t material, uint32_t vertexBuffer) {
+    constexpr uint64_t MATERIAL_MASK = (1ull << DRAW_KEY_MATERIAL_BITS) - 1;
+    constexpr uint64_t DEPTH_STATE_MASK = (1ull << DRAW_KEY_DEPTH_STATE_BITS) - 1;
+    constexpr uint64_t PIPELINE_MASK = (1ull << DRAW_KEY_PIPELINE_BITS) - 1;
+    return ((pipeline & PIPELINE_MASK) << (DRAW_KEY_DEPTH_STATE_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_VERTEX_BUFFER_BITS)) |
+           ((depthState & DEPTH_STATE_MASK) << (DRAW_KEY_MATERIAL_BITS + DRAW_KEY_VERTEX_BUFFER_BITS)) |
+           ((material & MATERIAL_MASK) << DRAW_KEY_VERTEX_BUFFER_BITS) |
+           (uint64_t)vertexBuffer;
+}
+
+/**
+ * @brief Quantizes a distance from the eye into the material field, for front-to-back order.
+ *
+ * Keeps the top DRAW_KEY_MATERIAL_BITS bits of the float, which order like the distances
+ * for everything non-negative and resolve about one part in 2000. Passed as the material of
+ * make_draw_key(), it orders draws of one pipeline and depth state near to far, so the depth
+ * test rejects more of the fragments behind them before they are shaded.
+ *
+ * @param viewDepth Distance from the eye; negative and NaN count as 0.
+ * @return The material field.
+ */
+inline uint32_t draw_depth_key(float viewDepth) {
+    if (!(viewDepth > 0.0f)) {
+        return 0;
+    }
+    uint32_t bits;
+    memcpy(&bits, &viewDepth, sizeof(bits));
+    return bits >> (32 - DRAW_KEY_MATERIAL_BITS);
+}
+
+/**
+ * @brief Orders a list of visible boxes by the distance of their centres from the eye, nearest first.
+ *
+ * Instanced draws take their instances in list order, so sorting the list before the
+ * instances are written draws the near ones first within each instanced draw too.
+ *
+ * @param bounds The boxes.
+ * @param eye The viewpoint.
+ * @param visible Indices into bounds, sorted in place; equal distances keep the lower index first.
+ * @param count The number of indices.
+ * @param scratch Working storage for count keys.
+ */
+void sort_front_to_back(const CullBounds& bounds, simd::float3 eye, uint32_t* visible, size_t count,
+                        uint64_t* scratch);
+
+/**
+ * @brief Sorts draws by key with a stable 8-bit LSD radix sort.
+ *
+ * Passes over bytes that are equal in every key are skipped, so a frame with one
+ * pipeline and depth state costs four passes rather than eight.
+ *
+ * @param packets The draws to sort in place.
+ * @param scratch Working storage, resized as needed; keep it across frames to avoid allocating.
+ */
+void radix_sort_draws(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+/**
+ * @struct DrawSlice
+ * @brief A contiguous range of a sorted draw list, encoded by one thread.
+ */
+struct DrawSlice {
+    uint32_t begin = 0; ///< First draw of the slice.
+    uint32_t end = 0;   ///< One past the last draw of the slice.
+};
+
+/**
+ * @brief Splits a draw list into contiguous slices of near-equal size, in order.
+ *
+ * Every slice re-binds its state from scratch, so lists are only split as far as each
+ * slice keeps at least minDrawsPerSlice draws.
+ *
+ * @param drawCount The number of draws.
+ * @param maxSlices The most slices to return, e.g. the number of encoding threads.
+ * @param minDrawsPerSlice The fewest draws worth a slice of their own.
+ * @param slices Receives the slices covering [0, drawCount); needs max(maxSlices, 1) entries.
+ * @return The number of slices written; 0 if there are no draws.
+ */
+uint32_t slice_draws(uint32_t drawCount, uint32_t maxSlices, uint32_t minDrawsPerSlice, DrawSlice* slices);
@@ -0,0 +1,32 @@
+/**
+ * @file engine_pch.hpp
+ * @brief The engine's precompiled header: the large system and metal-cpp headers most sources include.
+ *
+ * CMake compiles it once per language, C++ and Objective-C++, and force-includes it into every
+ * engine source (ENABLE_PCH), so metal-cpp's Foundation and Metal headers, simd and the Objective-C
+ * Metal headers are parsed once per build rather than once per source. Only headers that change
+ * with the SDK belong here; a project header in it would rebuild everything on every edit.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Foundation/Foundation.hpp>
+#include <Metal/Metal.hpp>
+
+#ifdef __OBJC__
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+#import <QuartzCore/CAMetalLayer.h>
+#endif
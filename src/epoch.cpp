@@ -0,0 +1,79 @@
+#include "epoch.hpp"
+
+#include <functional>
+#include <thread>
+
+namespace {
+    // Retires between collections; each collection scans every slot
+    constexpr size_t COLLECT_INTERVAL = 64;
+}
+
+EpochDomain::~EpochDomain() {
+    for (const Retired& retired : m_retired) {
+        retired.free(retired.node);
+    }
+}
+
+size_t EpochDomain::pin() {
+    // Start from a slot of the thread's own so that threads rarely contend for one
+    size_t slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS;
+    for (;;) {
+        for (size_t i = 0; i < SLOTS; ++i, slot = (slot + 1) % SLOTS) {
+            uint64_t idle = IDLE;
+            // The epoch read here may already be stale, which only pins more than needed
+            if (m_slots[slot].epoch.compare_exchange_strong(idle, m_epoch.load(std::memory_order_seq_cst),
+                                                            std::memory_order_seq_cst)) {
+                // Pairs with the fence in retire(): a node retired before this pin is unlinked for this reader
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                return slot;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void EpochDomain::retire(void* node, void (*free)(void*)) {
+    // The node was unlinked before the epoch is read, so readers pinning later cannot reach it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+    bool due = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_retired.push_back({ node, free, epoch });
+        due = m_retired.size() % COLLECT_INTERVAL == 0;
+    }
+    if (due) {
+        collect();
+    }
+}
+
+void EpochDomain::collect() {
+    std::vector<Retired> freed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        bool caughtUp = true;
+        for (const Slot& slot : m_slots) {
+            const uint64_t pinned = slot.epoch.load(std::memory_order_seq_cst);
+            caughtUp &= pinned == IDLE || pinned == epoch;
+        }
+        if (caughtUp) {
+            // Only collectors advance the epoch, and they hold the mutex
+            m_epoch.store(++epoch, std::memory_order_seq_cst);
+        }
+        size_t count = 0;
+        while (count < m_retired.size() && m_retired[count].epoch + 2 <= epoch) {
+            ++count;
+        }
+        freed.assign(m_retired.begin(), m_retired.begin() + count);
+        m_retired.erase(m_retired.begin(), m_retired.begin() + count);
+    }
+    for (const Retired& retired : freed) {
+        retired.free(retired.node);
+    }
+}
+
+size_t EpochDomain::retired() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_retired.size();
+}
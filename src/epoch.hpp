@@ -0,0 +1,86 @@
+/**
+ * @file epoch.hpp
+ * @brief Epoch-based reclamation: frees memory unlinked from a lock-free structure once no reader can hold it.
+ *
+ * Readers pin the current epoch with an EpochGuard for the duration of a traversal. Writers
+ * unlink a node and retire() it rather than deleting it; the node is tagged with the epoch it
+ * was retired in. The epoch only advances when every pinned reader has seen the current one,
+ * so once it has advanced twice past a node's tag, every reader that could have reached the
+ * node has unpinned and the node is freed. Pinning is a store to a reader slot, which keeps
+ * reads cheap; the cost is that one long-pinned reader holds back every retired node.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @class EpochDomain
+ * @brief The epoch counter, reader slots and retired nodes shared by the readers and writers of one structure.
+ */
+class EpochDomain {
+public:
+    static constexpr size_t SLOTS = 64;             ///< Readers pinned at once; more wait for a free slot.
+
+    EpochDomain() = default;
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    /**
+     * @brief Schedules an unlinked node to be freed once no reader can reach it.
+     * @param node The node; no longer reachable by readers that pin from now on.
+     * @param free Frees it, e.g. a captureless lambda calling delete.
+     */
+    void retire(void* node, void (*free)(void*));
+
+    /// Advances the epoch if every pinned reader has caught up and frees what that made safe.
+    void collect();
+
+    /// @return Retired nodes not freed yet.
+    size_t retired() const;
+
+private:
+    friend class EpochGuard;
+
+    static constexpr uint64_t IDLE = ~0ull;         ///< Slot value of no reader.
+
+    struct Retired {
+        void* node;
+        void (*free)(void*);
+        uint64_t epoch;
+    };
+
+    size_t pin();
+    void unpin(size_t slot) { m_slots[slot].epoch.store(IDLE, std::memory_order_release); }
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{ IDLE };
+    };
+
+    std::atomic<uint64_t> m_epoch{ 0 };
+    Slot m_slots[SLOTS];
+    mutable std::mutex m_mutex;
+    std::vector<Retired> m_retired;                 ///< Guarded by m_mutex, in the order retired.
+};
+
+/**
+ * @class EpochGuard
+ * @brief Pins the current epoch of a domain while in scope; nodes reached meanwhile stay allocated.
+ */
+class EpochGuard {
+public:
+    explicit EpochGuard(EpochDomain& domain) : m_domain(domain), m_slot(domain.pin()) {}
+    ~EpochGuard() { m_domain.unpin(m_slot); }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+private:
+    EpochDomain& m_domain;
+    size_t m_slot;
+};
@@ -0,0 +1,167 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// --- Terrain erosion (compute) ---
+// Built into an erosion.metallib of its own, which metal_erosion_pipelines() loads when a
+// ChunkManager first erodes the terrain; shaders.metal does not use any of it.
+// The virtual-pipe shallow-water model with sediment transport; see terrain_erosion.hpp. One
+// thread per grid point, one kernel per stage of a step, each matching the stage of the same
+// name in terrain_erosion.cpp: erosion_flux, erosion_water, erosion_sediment, erosion_transport
+// and erosion_thermal. Every stage reads the previous one's output, so a step is five dispatches.
+
+constant float EROSION_MIN_FLOW_DEPTH = 1e-4;
+
+// Matches ErosionParams in terrain_erosion.hpp
+struct ErosionParams {
+    uint width;
+    uint depth;
+    float spacing;
+    float timeStep;
+    float rain;
+    float evaporation;
+    float capacity;
+    float dissolving;
+    float deposition;
+    float minTilt;
+    float talus;
+    float thermalRate;
+    float gravity;
+};
+
+static bool erosion_inside(constant ErosionParams& p, int2 point) {
+    return point.x >= 0 && point.y >= 0 && point.x < int(p.width) && point.y < int(p.depth);
+}
+
+static uint erosion_index(constant ErosionParams& p, int2 point) {
+    return uint(point.y) * p.width + uint(point.x);
+}
+
+// Outside the grid the ground continues at the same height without water, so water drains over the edges
+kernel void erosion_flux(constant ErosionParams& p [[buffer(0)]],
+                         device const float* terrain [[buffer(1)]],
+                         device const float* water [[buffer(2)]],
+                         device const float4* flux [[buffer(3)]],
+                         device float4* fluxOut [[buffer(4)]],
+                         uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const int2 point = int2(gid);
+    const uint i = erosion_index(p, point);
+    const float rain = p.rain * p.timeStep;
+    const float depth = water[i] + rain;
+    const float surface = terrain[i] + depth;
+    const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+    float4 out = 0.0;
+    for (int n = 0; n < 4; ++n) {
+        const int2 neighbour = point + offsets[n];
+        float other = terrain[i];
+        if (erosion_inside(p, neighbour)) {
+            const uint j = erosion_index(p, neighbour);
+            other = terrain[j] + water[j] + rain;
+        }
+        out[n] = max(0.0, flux[i][n] + p.timeStep * p.gravity * p.spacing * (surface - other));
+    }
+    const float total = out.x + out.y + out.z + out.w;
+    if (total > 0.0) {
+        out *= min(1.0, depth * p.spacing * p.spacing / (total * p.timeStep));
+    }
+    fluxOut[i] = out;
+}
+
+kernel void erosion_water(constant ErosionParams& p [[buffer(0)]],
+                          device const float* water [[buffer(1)]],
+                          device const float4* flux [[buffer(2)]],
+                          device float* waterOut [[buffer(3)]],
+                          device float2* velocity [[buffer(4)]],
+                          uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const uint i = gid.y * p.width + gid.x;
+    const float4 f = flux[i];
+    const float fromLeft = gid.x > 0 ? flux[i - 1].y : 0.0;
+    const float fromRight = gid.x + 1 < p.width ? flux[i + 1].x : 0.0;
+    const float fromDown = gid.y > 0 ? flux[i - p.width].w : 0.0;
+    const float fromUp = gid.y + 1 < p.depth ? flux[i + p.width].z : 0.0;
+    const float before = water[i] + p.rain * p.timeStep;
+    const float net = fromLeft + fromRight + fromDown + fromUp - (f.x + f.y + f.z + f.w);
+    const float after = max(0.0, before + p.timeStep * net / (p.spacing * p.spacing));
+    waterOut[i] = after;
+
+    const float mean = 0.5 * (before + after);
+    const float2 throughput = float2(0.5 * (fromLeft - f.x + f.y - fromRight), 0.5 * (fromDown - f.z + f.w - fromUp));
+    velocity[i] = mean > EROSION_MIN_FLOW_DEPTH ? throughput / (p.spacing * mean) : float2(0.0);
+}
+
+kernel void erosion_sediment(constant ErosionParams& p [[buffer(0)]],
+                             device const float* terrain [[buffer(1)]],
+                             device const float* sediment [[buffer(2)]],
+                             device const float2* velocity [[buffer(3)]],
+                             device float* terrainOut [[buffer(4)]],
+                             device float* sedimentOut [[buffer(5)]],
+                             uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const int2 point = int2(gid);
+    const uint i = erosion_index(p, point);
+    const int x0 = max(point.x - 1, 0), x1 = min(point.x + 1, int(p.width) - 1);
+    const int z0 = max(point.y - 1, 0), z1 = min(point.y + 1, int(p.depth) - 1);
+    const float left = terrain[erosion_index(p, int2(x0, point.y))];
+    const float right = terrain[erosion_index(p, int2(x1, point.y))];
+    const float down = terrain[erosion_index(p, int2(point.x, z0))];
+    const float up = terrain[erosion_index(p, int2(point.x, z1))];
+    const float slopeX = (right - left) / (float(x1 - x0) * p.spacing);
+    const float slopeZ = (up - down) / (float(z1 - z0) * p.spacing);
+    const float slopeSq = slopeX * slopeX + slopeZ * slopeZ;
+    const float tilt = max(sqrt(slopeSq / (1.0 + slopeSq)), p.minTilt);
+    const float capacity = p.capacity * tilt * length(velocity[i]);
+
+    const float carried = sediment[i];
+    const float moved = capacity > carried ? p.dissolving * p.timeStep * (capacity - carried)
+                                           : -p.deposition * p.timeStep * (carried - capacity);
+    terrainOut[i] = terrain[i] - moved;
+    sedimentOut[i] = carried + moved;
+}
+
+kernel void erosion_transport(constant ErosionParams& p [[buffer(0)]],
+                              device const float* sediment [[buffer(1)]],
+                              device const float2* velocity [[buffer(2)]],
+                              device const float* water [[buffer(3)]],
+                              device float* sedimentOut [[buffer(4)]],
+                              device float* waterOut [[buffer(5)]],
+                              uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const uint i = gid.y * p.width + gid.x;
+    const float2 from = float2(gid) - velocity[i] * (p.timeStep / p.spacing);
+    const float fx = clamp(from.x, 0.0, float(p.width - 1));
+    const float fz = clamp(from.y, 0.0, float(p.depth - 1));
+    const int x0 = min(int(fx), int(p.width) - 2);
+    const int z0 = min(int(fz), int(p.depth) - 2);
+    const float tx = fx - float(x0);
+    const float tz = fz - float(z0);
+    const float s0 = sediment[erosion_index(p, int2(x0, z0))] * (1.0 - tx) +
+                     sediment[erosion_index(p, int2(x0 + 1, z0))] * tx;
+    const float s1 = sediment[erosion_index(p, int2(x0, z0 + 1))] * (1.0 - tx) +
+                     sediment[erosion_index(p, int2(x0 + 1, z0 + 1))] * tx;
+    sedimentOut[i] = s0 * (1.0 - tz) + s1 * tz;
+    waterOut[i] = water[i] * max(0.0, 1.0 - p.evaporation * p.timeStep);
+}
+
+// Each point gathers along the pipes its neighbours compute, so the terrain is conserved
+kernel void erosion_thermal(constant ErosionParams& p [[buffer(0)]],
+                            device const float* terrain [[buffer(1)]],
+                            device float* terrainOut [[buffer(2)]],
+                            uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const int2 point = int2(gid);
+    const uint i = erosion_index(p, point);
+    const float rate = 0.25 * min(p.thermalRate * p.timeStep, 1.0);
+    const float limit = p.talus * p.spacing;
+    const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+    float change = 0.0;
+    for (int n = 0; n < 4; ++n) {
+        const int2 neighbour = point + offsets[n];
+        if (!erosion_inside(p, neighbour)) {
+            continue;
+        }
+        const float difference = terrain[erosion_index(p, neighbour)] - terrain[i];
+        change += rate * (max(0.0, difference - limit) - max(0.0, -difference - limit));
+    }
+    terrainOut[i] = terrain[i] + change;
+}
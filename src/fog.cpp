@@ -0,0 +1,52 @@
+#include "fog.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+float fog_visibility(const FogSettings& fog, float distance) {
+    float visibility = 1.0f;
+    if (fog.density > 0.0f) {
+        const float d = fog.density * distance;
+        visibility = expf(-d * d);
+    }
+    if (std::isfinite(fog.fadeEnd)) {
+        // Same as the shader's saturate((fadeEnd - distance) / (fadeEnd - fadeStart))
+        const float range = std::max(fog.fadeEnd - fog.fadeStart, 1e-6f);
+        visibility *= std::clamp((fog.fadeEnd - distance) / range, 0.0f, 1.0f);
+    }
+    return visibility;
+}
+
+float fog_cull_distance(const FogSettings& fog) {
+    // Each term alone drops below the threshold at its own distance; the product only sooner
+    float distance = INFINITY;
+    if (fog.density > 0.0f) {
+        distance = sqrtf(-logf(FOG_CULL_VISIBILITY)) / fog.density;
+    }
+    return std::min(distance, fog.fadeEnd);
+}
+
+float box_distance(const BoundingBox& box, simd::float3 eye) {
+    const simd::float3 nearest = simd::clamp(eye, box.min, box.max);
+    return simd::length(nearest - eye);
+}
+
+size_t fog_cull(const CullBounds& bounds, simd::float3 eye, float maxDistance, uint32_t* visible, size_t count) {
+    if (!std::isfinite(maxDistance)) {
+        return count;
+    }
+    const float maxSq = maxDistance * maxDistance;
+    size_t kept = 0;
+    for (size_t v = 0; v < count; ++v) {
+        const uint32_t i = visible[v];
+        // Per axis, how far the eye lies outside the slab of the box
+        const float dx = std::max(fabsf(eye.x - bounds.centerX[i]) - bounds.extentX[i], 0.0f);
+        const float dy = std::max(fabsf(eye.y - bounds.centerY[i]) - bounds.extentY[i], 0.0f);
+        const float dz = std::max(fabsf(eye.z - bounds.centerZ[i]) - bounds.extentZ[i], 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= maxSq) {
+            std::swap(visible[kept++], visible[v]);
+        }
+    }
+    return kept;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file fog.hpp
+ * @brief Distance fog and the far fade, and culling of the geometry they hide completely.
+ *
+ * Surfaces blend towards the sky colour with squared exponential fog, and between fadeStart
+ * and fadeEnd they also fade into it linearly, so the edge of the streamed terrain dissolves
+ * instead of cutting off. Both depend only on the distance from the eye, which matches
+ * apply_fog() in shaders.metal. Once a surface keeps less than FOG_CULL_VISIBILITY of its
+ * colour it rounds to the sky colour, so anything entirely beyond fog_cull_distance() can
+ * be culled, and chunks there need not be streamed, without a visible change.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "frustum.hpp"
+
+/// Surfaces keeping less than this fraction of their colour are indistinguishable from the sky in 8 bits.
+constexpr float FOG_CULL_VISIBILITY = 0.5f / 255.0f;
+
+/**
+ * @struct FogSettings
+ * @brief Fog tunables; mirrored into FrameUniforms.
+ */
+struct FogSettings {
+    float density = 0.012f;     ///< Squared exponential density per world unit; 0 disables the fog.
+    float fadeStart = 72.0f;    ///< Distance where the far fade begins.
+    float fadeEnd = 96.0f;      ///< Distance where surfaces are fully faded; infinite disables the fade.
+};
+
+/**
+ * @brief Returns the fraction of a surface's colour the fog leaves at a distance.
+ * @param fog The fog.
+ * @param distance The distance from the eye.
+ * @return The visibility in [0, 1]; the shader mixes from the sky colour by it.
+ */
+float fog_visibility(const FogSettings& fog, float distance);
+
+/**
+ * @brief Returns the distance beyond which the fog hides every surface.
+ * @param fog The fog.
+ * @return The distance where visibility drops below FOG_CULL_VISIBILITY; infinite if it never does.
+ */
+float fog_cull_distance(const FogSettings& fog);
+
+/// @return The distance from eye to the nearest point of the box; 0 if the eye is inside it.
+float box_distance(const BoundingBox& box, simd::float3 eye);
+
+/**
+ * @brief Drops the boxes that lie entirely beyond a distance from a list of candidates.
+ * @param bounds The world space boxes.
+ * @param eye The eye position.
+ * @param maxDistance Boxes with no point this close are dropped; infinite keeps every box.
+ * @param visible Indices into bounds, e.g. from frustum_cull(). Reordered in place: the kept ones first,
+ *                in their original order, then the dropped ones in no particular order.
+ * @param count The number of indices.
+ * @return The number of indices kept.
+ */
+size_t fog_cull(const CullBounds& bounds, simd::float3 eye, float maxDistance, uint32_t* visible, size_t count);
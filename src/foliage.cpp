@@ -0,0 +1,134 @@
+#include "foliage.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "noise.hpp"
+
+namespace {
+    // Offsets the forest noise away from the terrain noise so forests do not follow the hills
+    const float FOREST_NOISE_OFFSET_X = 311.0f;
+    const float FOREST_NOISE_OFFSET_Z = -173.0f;
+
+    // Top 24 bits as a float in [0, 1)
+    float unit_float(uint32_t bits) {
+        return (float)(bits >> 8) * (1.0f / 16777216.0f);
+    }
+}
+
+uint32_t foliage_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t foliage_cell_hash(uint32_t seed, ChunkKey key, uint32_t cellX, uint32_t cellZ) {
+    uint32_t h = foliage_hash(seed);
+    h = foliage_hash(h ^ (uint32_t)key.x);
+    h = foliage_hash(h ^ (uint32_t)key.z);
+    return foliage_hash(h ^ ((cellZ << 16) | cellX));
+}
+
+float foliage_forest_density(const FoliageSettings& settings, float x, float z) {
+    // Polynomial blending so the GPU scatter pass sees the same forests
+    const NoiseSettings noise = { settings.seed, NoiseBasis::Value, NoiseInterpolation::Smoothstep, 0.0f };
+    float n = fractal_noise((x + FOREST_NOISE_OFFSET_X) * settings.forestScale,
+                            (z + FOREST_NOISE_OFFSET_Z) * settings.forestScale, noise);
+    return std::clamp(n + 0.5f, 0.0f, 1.0f);
+}
+
+bool foliage_candidate(const FoliageSettings& settings, ChunkKey key, uint32_t cellX, uint32_t cellZ,
+                       float chunkSize, int resolution, FoliageInstance& instance, const TerrainParams& terrain,
+                       const BiomeMap* biomes) {
+    const uint32_t h = foliage_cell_hash(settings.seed, key, cellX, cellZ);
+    const float cellSize = chunkSize / (float)settings.cellsPerEdge;
+    const float originX = key.x * chunkSize;
+    const float originZ = key.z * chunkSize;
+    const float x = originX + (cellX + unit_float(foliage_hash(h + 1))) * cellSize;
+    const float z = originZ + (cellZ + unit_float(foliage_hash(h + 2))) * cellSize;
+
+    // One roll picks the kind: trees take the low end, scaled by the forest, rocks the band above
+    const float roll = unit_float(h);
+    float treeChance = settings.treeDensity * foliage_forest_density(settings, x, z);
+    float rockChance = settings.rockDensity;
+    if (biomes && !biomes->empty()) {
+        const BiomeProfile profile = biome_profile_at(*biomes, (x - originX) / chunkSize, (z - originZ) / chunkSize);
+        treeChance *= profile.treeDensity;
+        rockChance *= profile.rockDensity;
+    }
+    FoliageKind kind;
+    if (roll < treeChance) {
+        kind = FoliageKind::Tree;
+    } else if (roll < treeChance + rockChance) {
+        kind = FoliageKind::Rock;
+    } else {
+        return false;
+    }
+
+    // Bilinear over the four vertices of the chunk grid cell around the point
+    const float step = chunkSize / (float)(resolution - 1);
+    const float gx = (x - originX) / step;
+    const float gz = (z - originZ) / step;
+    const int ix = std::min((int)gx, resolution - 2);
+    const int iz = std::min((int)gz, resolution - 2);
+    const float fx = gx - ix;
+    const float fz = gz - iz;
+    const float x0 = originX + ix * step;
+    const float z0 = originZ + iz * step;
+    const float h00 = get_terrain_height(x0, z0, terrain);
+    const float h10 = get_terrain_height(x0 + step, z0, terrain);
+    const float h01 = get_terrain_height(x0, z0 + step, terrain);
+    const float h11 = get_terrain_height(x0 + step, z0 + step, terrain);
+    const float y = (h00 * (1.0f - fx) + h10 * fx) * (1.0f - fz) + (h01 * (1.0f - fx) + h11 * fx) * fz;
+
+    if (kind == FoliageKind::Tree && y > settings.treeline) {
+        return false;
+    }
+
+    const float variation = unit_float(foliage_hash(h + 3));
+    const float scale = kind == FoliageKind::Tree ? 0.8f + 0.5f * variation : 0.6f + 1.0f * variation;
+    instance.position = { x, y, z, scale };
+    instance.yaw = unit_float(foliage_hash(h + 4)) * 6.2831853f;
+    instance.kind = kind;
+    instance.shade = unit_float(foliage_hash(h + 5));
+    instance.padding = 0;
+    return true;
+}
+
+FoliageLod foliage_lod(const FoliageSettings& settings, FoliageKind kind, float distance) {
+    const bool tree = kind == FoliageKind::Tree;
+    if (distance < (tree ? settings.treeDetailDistance : settings.rockDetailDistance)) {
+        return FoliageLod::Full;
+    }
+    return distance < (tree ? settings.treeDrawDistance : settings.rockDrawDistance) ? FoliageLod::Impostor
+                                                                                      : FoliageLod::Hidden;
+}
+
+float foliage_impostor_fade(const FoliageSettings& settings, FoliageKind kind, float distance) {
+    const float detail = kind == FoliageKind::Tree ? settings.treeDetailDistance : settings.rockDetailDistance;
+    return std::clamp((distance - detail) / settings.impostorFadeDistance + 1.0f, 0.0f, 1.0f);
+}
+
+simd::float4 foliage_wind(const WindSettings& settings, double time) {
+    const float angle = (float)fmod(time * settings.frequency, (double)FOLIAGE_WIND_PERIOD);
+    const simd::float2 push = settings.direction * settings.strength;
+    return { push.x, push.y, angle, 0.0f };
+}
+
+simd::float4 foliage_sway_params(const FoliageInstance& instance) {
+    // Bigger trees bend less per metre, so every tree's crown leans about as far
+    const float k = instance.position.w;
+    const float bend = instance.kind == FoliageKind::Tree ? 1.0f / (k * k) : 0.0f;
+    return { instance.position.y, instance.yaw, bend, 0.0f };
+}
+
+simd::float3 foliage_sway(simd::float4 wind, simd::float4 sway, simd::float3 position) {
+    const float height = std::max(position.y - sway.x, 0.0f);
+    const float wave = 0.5f + 0.5f * sinf(wind.z + sway.y);
+    const float gust = 0.7f + 0.3f * sinf(0.25f * wind.z + sway.y);
+    const float amount = sway.z * height * height * wave * gust;
+    return { wind.x * amount, 0.0f, wind.y * amount };
+}
@@ -0,0 +1,182 @@
+/**
+ * @file foliage.hpp
+ * @brief Procedural placement of trees and rocks on the terrain chunk grid.
+ *
+ * Every chunk is divided into a grid of placement cells. Each cell holds at most one
+ * candidate, jittered inside the cell by a hash of the seed, the chunk and the cell, and
+ * kept or dropped by comparing another hash against a density function. The result only
+ * depends on those inputs, so a chunk scatters the same instances every time it streams in
+ * and the scatter_foliage kernel can place them without any CPU state. These functions are
+ * the reference the kernel is ported from.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "biome.hpp"
+#include "landscape.hpp"
+
+/**
+ * @enum FoliageKind
+ * @brief What a foliage instance is.
+ */
+enum class FoliageKind : uint32_t {
+    Tree = 0,
+    Rock = 1,
+};
+
+/**
+ * @enum FoliageLod
+ * @brief How a foliage instance is drawn at a given distance.
+ */
+enum class FoliageLod : uint32_t {
+    Full = 0,       ///< Trees as trunk and crown, rocks as a box.
+    Impostor = 1,   ///< A quad of the impostor atlas (impostor.hpp); without one, trees as one box, rocks as Full.
+    Hidden = 2,     ///< Not drawn.
+};
+
+/**
+ * @struct FoliageSettings
+ * @brief Density and draw distances of the scattered foliage.
+ */
+struct FoliageSettings {
+    uint32_t seed = 1337;               ///< Changes every placement.
+    uint32_t cellsPerEdge = 64;         ///< Placement cells along each chunk edge; at most one instance per cell.
+    float treeDensity = 0.45f;          ///< Chance a cell holds a tree in the densest forest.
+    float rockDensity = 0.03f;          ///< Chance a cell holds a rock, anywhere.
+    float forestScale = 0.015f;         ///< Frequency of the noise that shapes forests and clearings.
+    float treeline = 9.0f;              ///< No trees grow above this height.
+    float treeDetailDistance = 60.0f;   ///< Trees beyond this draw as impostors.
+    float treeDrawDistance = 180.0f;    ///< Trees beyond this are not drawn.
+    float rockDetailDistance = 35.0f;   ///< Rocks beyond this draw as impostors, where there is an atlas.
+    float rockDrawDistance = 70.0f;     ///< Rocks beyond this are not drawn.
+    float impostorFadeDistance = 8.0f;  ///< Stretch before the detail distance over which both levels are drawn.
+};
+
+/// Range the wind angle wraps in: whole cycles of both the sway and the slower gusts.
+constexpr float FOLIAGE_WIND_PERIOD = 8.0f * (float)M_PI;
+
+/**
+ * @struct WindSettings
+ * @brief The wind every tree sways in.
+ */
+struct WindSettings {
+    simd::float2 direction = { 0.8f, 0.6f };    ///< Horizontal direction the wind blows towards, unit length.
+    float strength = 0.04f;     ///< Sway at a gust's peak per square metre of height above a unit tree's base.
+    float frequency = 1.3f;     ///< Sway rate in radians a second; gusts come at a quarter of it.
+};
+
+/**
+ * @struct FoliageInstance
+ * @brief One placed tree or rock; matches `FoliageInstance` in shaders.metal.
+ */
+struct FoliageInstance {
+    simd::float4 position;  ///< xyz: base on the terrain, w: uniform scale.
+    float yaw = 0.0f;       ///< Rotation about +Y in radians.
+    FoliageKind kind = FoliageKind::Tree; ///< Tree or rock.
+    float shade = 0.0f;     ///< [0, 1) colour variation.
+    uint32_t padding = 0;
+};
+
+/**
+ * @brief Mixes the bits of a 32-bit value; the GPU uses the same function.
+ * @param x The value.
+ * @return The hashed value.
+ */
+uint32_t foliage_hash(uint32_t x);
+
+/**
+ * @brief Returns the hash every random choice of a placement cell is derived from.
+ * @param seed The placement seed.
+ * @param key The chunk.
+ * @param cellX The cell column inside the chunk.
+ * @param cellZ The cell row inside the chunk.
+ * @return The cell's hash.
+ */
+uint32_t foliage_cell_hash(uint32_t seed, ChunkKey key, uint32_t cellX, uint32_t cellZ);
+
+/**
+ * @brief Returns the density of forest at a world position.
+ * @param settings The foliage settings.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @return 0 in clearings, up to 1 in dense forest.
+ */
+float foliage_forest_density(const FoliageSettings& settings, float x, float z);
+
+/**
+ * @brief Places the candidate of one cell, if it is kept.
+ *
+ * The instance is snapped to the bilinear surface of the chunk's vertex grid, the same
+ * surface HeightField interpolates.
+ *
+ * @param settings The foliage settings.
+ * @param key The chunk.
+ * @param cellX The cell column, below cellsPerEdge.
+ * @param cellZ The cell row, below cellsPerEdge.
+ * @param chunkSize The chunk edge length in world units.
+ * @param resolution The vertices along each chunk edge.
+ * @param instance Receives the instance.
+ * @param terrain The terrain generator's tunables.
+ * @param biomes The chunk's biomes, whose profiles scale the tree and rock densities; null or empty for none.
+ * @return True if the cell holds an instance.
+ */
+bool foliage_candidate(const FoliageSettings& settings, ChunkKey key, uint32_t cellX, uint32_t cellZ,
+                       float chunkSize, int resolution, FoliageInstance& instance, const TerrainParams& terrain = {},
+                       const BiomeMap* biomes = nullptr);
+
+/**
+ * @brief Picks how an instance is drawn at a distance from the camera.
+ * @param settings The foliage settings.
+ * @param kind The instance kind.
+ * @param distance The distance from the camera to the instance.
+ * @return The level to draw.
+ */
+FoliageLod foliage_lod(const FoliageSettings& settings, FoliageKind kind, float distance);
+
+/**
+ * @brief Returns how far an instance has dissolved from its full level into its impostor.
+ *
+ * Over the impostorFadeDistance before the detail distance both levels are drawn, each keeping
+ * the pixels of an ordered dither the other drops, so together they cover the instance once.
+ *
+ * @param settings The foliage settings.
+ * @param kind The instance kind.
+ * @param distance The distance from the camera to the instance.
+ * @return 0 where only the full level is drawn, up to 1 where only the impostor is.
+ */
+float foliage_impostor_fade(const FoliageSettings& settings, FoliageKind kind, float distance);
+
+/**
+ * @brief Returns the wind constant of a frame, as the vertex shader reads it from FrameUniforms.
+ *
+ * The angle wraps in FOLIAGE_WIND_PERIOD, so it keeps full float precision however long the
+ * program runs and the sway stays continuous across the wrap.
+ *
+ * @param settings The wind.
+ * @param time Seconds since start.
+ * @return xy: direction times strength, z: wind angle, w: 0.
+ */
+simd::float4 foliage_wind(const WindSettings& settings, double time);
+
+/**
+ * @brief Returns how the parts of an instance sway, as select_foliage writes it beside each part.
+ * @param instance The instance.
+ * @return x: height of its base, y: its phase, z: bend per square metre above the base, 0 for rocks; w: 0.
+ */
+simd::float4 foliage_sway_params(const FoliageInstance& instance);
+
+/**
+ * @brief Moves a vertex of a foliage part with the wind; the foliage_wind shader variant does the same.
+ *
+ * The offset grows with the square of the height above the base, so trunks stay rooted and
+ * crowns lean furthest, and every part of one instance shares a phase, so they move together.
+ *
+ * @param wind The frame's wind constant, from foliage_wind().
+ * @param sway The part's sway, from foliage_sway_params().
+ * @param position The vertex in world space.
+ * @return The horizontal world space offset.
+ */
+simd::float3 foliage_sway(simd::float4 wind, simd::float4 sway, simd::float3 position);
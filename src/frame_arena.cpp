@@ -0,0 +1,124 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    size_t align_offset(const uint8_t* block, size_t offset, size_t alignment) {
+        const uintptr_t address = (uintptr_t)block + offset;
+        return offset + ((alignment - address % alignment) % alignment);
+    }
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+    thread_local uint64_t t_heapAllocations = 0;
+#endif
+}
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+// Aligned and nothrow forms keep their default implementations, which are not counted
+void* operator new(size_t size) {
+    ++t_heapAllocations;
+    if (void* pointer = malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+#endif
+
+FrameArena::FrameArena(size_t capacity)
+    : m_block(capacity ? new uint8_t[capacity] : nullptr), m_capacity(capacity) {}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    size_t begin = align_offset(m_block.get(), m_offset, alignment);
+    if (m_block && begin + bytes <= m_capacity) {
+        m_used += begin + bytes - m_offset;
+        m_offset = begin + bytes;
+        m_peak = std::max(m_peak, m_used);
+        return m_block.get() + begin;
+    }
+
+    if (m_overflow.empty() || align_offset(m_overflow.back().get(), m_overflowOffset, alignment) + bytes > m_overflowCapacity) {
+        // Doubling keeps the number of overflow blocks in one frame logarithmic
+        m_overflowCapacity = std::max({ bytes + alignment, m_capacity, m_overflowCapacity * 2, (size_t)4096 });
+        m_overflow.emplace_back(new uint8_t[m_overflowCapacity]);
+        m_overflowBytes += m_overflowCapacity;
+        m_overflowOffset = 0;
+    }
+    uint8_t* block = m_overflow.back().get();
+    begin = align_offset(block, m_overflowOffset, alignment);
+    m_used += begin + bytes - m_overflowOffset;
+    m_overflowOffset = begin + bytes;
+    m_peak = std::max(m_peak, m_used);
+    return block + begin;
+}
+
+void FrameArena::reset() {
+    if (!m_overflow.empty()) {
+        m_overflow.clear();
+        m_capacity += m_overflowBytes;
+        m_block.reset(new uint8_t[m_capacity]);
+        m_overflowBytes = 0;
+        m_overflowOffset = 0;
+        m_overflowCapacity = 0;
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+FrameArenas create_frame_arenas(uint32_t framesInFlight, uint32_t threads, size_t bytesPerArena) {
+    FrameArenas arenas;
+    arenas.threads = std::max(threads, 1u);
+    for (uint32_t i = 0; i < std::max(framesInFlight, 1u) * arenas.threads; ++i) {
+        arenas.arenas.emplace_back(bytesPerArena);
+    }
+    return arenas;
+}
+
+void frame_arenas_begin_frame(FrameArenas& arenas, uint32_t frameIndex) {
+    const uint32_t frames = (uint32_t)arenas.arenas.size() / arenas.threads;
+    arenas.frameIndex = frameIndex % frames;
+    for (uint32_t t = 0; t < arenas.threads; ++t) {
+        arenas.arenas[arenas.frameIndex * arenas.threads + t].reset();
+    }
+}
+
+FrameArena& frame_arena(FrameArenas& arenas, uint32_t thread) {
+    return arenas.arenas[arenas.frameIndex * arenas.threads + thread];
+}
+
+size_t frame_arenas_peak(const FrameArenas& arenas) {
+    size_t peak = 0;
+    for (const FrameArena& arena : arenas.arenas) {
+        peak = std::max(peak, arena.peak());
+    }
+    return peak;
+}
+
+uint64_t heap_allocation_count() {
+#ifdef TRACK_HEAP_ALLOCATIONS
+    return t_heapAllocations;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,160 @@
+/**
+ * @file frame_arena.hpp
+ * @brief Bump allocators for CPU data that only lives for a frame, and a check for heap allocations.
+ *
+ * A FrameArena hands out memory by advancing an offset and frees everything at once on
+ * reset(). When a frame needs more than the arena holds, the extra comes from overflow
+ * blocks and the next reset() replaces them with one block large enough for both, so
+ * after the first frames the arena no longer touches the heap.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @class FrameArena
+ * @brief A linear allocator reset once per frame; used by one thread at a time.
+ */
+class FrameArena {
+public:
+    /// @param capacity Bytes of the first block; grows to the largest frame seen.
+    explicit FrameArena(size_t capacity = 0);
+
+    FrameArena(FrameArena&&) = default;
+    FrameArena& operator=(FrameArena&&) = default;
+
+    /**
+     * @brief Allocates memory that stays valid until the next reset().
+     * @param bytes The size.
+     * @param alignment A power of two.
+     * @return The memory; never null.
+     */
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+    /// @return Uninitialized storage for count elements, valid until the next reset().
+    template <typename T>
+    T* allocate_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena memory is released without destructors");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /// @brief Frees everything allocated, merging overflow blocks into one block for the next frame.
+    void reset();
+
+    /// @return Bytes handed out since the last reset(), including alignment padding.
+    size_t used() const { return m_used; }
+
+    /// @return Bytes the arena holds.
+    size_t capacity() const { return m_capacity + m_overflowBytes; }
+
+    /// @return The most bytes used between two resets.
+    size_t peak() const { return m_peak; }
+
+private:
+    std::unique_ptr<uint8_t[]> m_block;
+    size_t m_capacity = 0;
+    size_t m_offset = 0;                                ///< Next free byte of m_block.
+    std::vector<std::unique_ptr<uint8_t[]>> m_overflow; ///< Blocks added since the last reset, newest last.
+    size_t m_overflowBytes = 0;
+    size_t m_overflowOffset = 0;                        ///< Next free byte of the newest overflow block.
+    size_t m_overflowCapacity = 0;                      ///< Size of the newest overflow block.
+    size_t m_used = 0;
+    size_t m_peak = 0;
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief Standard allocator drawing from a FrameArena; deallocation is a no-op.
+ *
+ * Containers using it must be destroyed before the arena is reset.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    /// @return The arena allocated from.
+    FrameArena* arena() const { return m_arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.arena(); }
+
+private:
+    FrameArena* m_arena;
+};
+
+/// A vector whose storage comes from a FrameArena; it must not outlive the frame.
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * @struct FrameArenas
+ * @brief One FrameArena per in-flight frame and per frame thread.
+ *
+ * Frames take turns through the sets of arenas like the FrameRing buffers, so what the
+ * previous frames allocated is still intact while the current one is built. Each thread
+ * allocates only from its own arena, so frame jobs need no locking.
+ */
+struct FrameArenas {
+    std::vector<FrameArena> arenas; ///< framesInFlight * threads arenas, grouped by frame.
+    uint32_t threads = 1;           ///< Arenas per frame: the render thread, then each frame worker.
+    uint32_t frameIndex = 0;        ///< Frame whose arenas are current.
+};
+
+/**
+ * @brief Creates the arenas.
+ * @param framesInFlight The number of frames the CPU may run ahead of the GPU.
+ * @param threads The render thread plus the job system's frame workers.
+ * @param bytesPerArena Initial capacity of each arena.
+ * @return The arenas, with frame 0 current.
+ */
+FrameArenas create_frame_arenas(uint32_t framesInFlight, uint32_t threads, size_t bytesPerArena);
+
+/**
+ * @brief Makes a frame's arenas current and resets them.
+ * @param arenas The arenas.
+ * @param frameIndex The frame, e.g. FrameRing::frameIndex once its buffer is free.
+ */
+void frame_arenas_begin_frame(FrameArenas& arenas, uint32_t frameIndex);
+
+/**
+ * @brief Returns a thread's arena for the current frame.
+ * @param arenas The arenas.
+ * @param thread JobSystem::thread_index() of the calling thread; below FrameArenas::threads.
+ * @return The arena.
+ */
+FrameArena& frame_arena(FrameArenas& arenas, uint32_t thread = 0);
+
+/// @return The most bytes any arena used in one frame.
+size_t frame_arenas_peak(const FrameArenas& arenas);
+
+/// True when the build counts heap allocations; see heap_allocation_count().
+#ifdef TRACK_HEAP_ALLOCATIONS
+constexpr bool HEAP_ALLOCATION_TRACKING = true;
+#else
+constexpr bool HEAP_ALLOCATION_TRACKING = false;
+#endif
+
+/**
+ * @brief Counts operator new calls made by the calling thread.
+ *
+ * Only counts with TRACK_HEAP_ALLOCATIONS defined, which replaces the global operator new;
+ * otherwise always 0. Compare two readings to find allocations a stretch of code made.
+ *
+ * @return The number of allocations so far.
+ */
+uint64_t heap_allocation_count();
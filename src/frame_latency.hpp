@@ -0,0 +1,38 @@
+/**
+ * @file frame_latency.hpp
+ * @brief Records how long a frame waits for the GPU and the display, from command buffer and drawable handlers.
+ *
+ * GPU time alone does not show a backlog: a frame can take 5 ms on the GPU yet start 30 ms
+ * after it was committed. The handlers registered here run on Metal's completion threads and
+ * report each FrameLatency with frame_stats_record_latency(). CACurrentMediaTime(),
+ * GPUStartTime and presentedTime share one clock, so the differences need no calibration.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#import <QuartzCore/QuartzCore.h>
+
+#include <cstdint>
+
+#include "frame_stats.hpp"
+
+/**
+ * @brief Reports LATENCY_SCHEDULE and LATENCY_QUEUE of a command buffer; call just before committing it.
+ * @param stats The stats to record into; must outlive the command buffer.
+ * @param frame The FrameStats frame number of the command buffer.
+ * @param cmd The uncommitted command buffer.
+ */
+void frame_latency_track_commit(FrameStats& stats, uint64_t frame, id<MTLCommandBuffer> cmd);
+
+/**
+ * @brief Reports LATENCY_PRESENT of a drawable; call before presenting it.
+ *
+ * Drawables that are dropped instead of shown report nothing.
+ *
+ * @param stats The stats to record into; must outlive the drawable.
+ * @param frame The FrameStats frame number of the drawable.
+ * @param drawable The drawable about to be presented.
+ * @param frameBegin CACurrentMediaTime() when the frame began, before its input was read.
+ */
+void frame_latency_track_present(FrameStats& stats, uint64_t frame, id<MTLDrawable> drawable,
+                                 CFTimeInterval frameBegin);
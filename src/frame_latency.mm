@@ -0,0 +1,30 @@
+#import "frame_latency.hpp"
+
+#include <algorithm>
+
+void frame_latency_track_commit(FrameStats& stats, uint64_t frame, id<MTLCommandBuffer> cmd) {
+    FrameStats* statsPtr = &stats;
+    const CFTimeInterval committed = CACurrentMediaTime();
+    [cmd addScheduledHandler:^(id<MTLCommandBuffer>) {
+        frame_stats_record_latency(*statsPtr, frame, LATENCY_SCHEDULE, (CACurrentMediaTime() - committed) * 1000.0);
+    }];
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+        // GPUStartTime is 0 when the command buffer failed before it ran
+        if (completed.status == MTLCommandBufferStatusCompleted && completed.GPUStartTime > 0.0) {
+            const double ms = std::max(completed.GPUStartTime - committed, 0.0) * 1000.0;
+            frame_stats_record_latency(*statsPtr, frame, LATENCY_QUEUE, (float)ms);
+        }
+    }];
+}
+
+void frame_latency_track_present(FrameStats& stats, uint64_t frame, id<MTLDrawable> drawable,
+                                 CFTimeInterval frameBegin) {
+    FrameStats* statsPtr = &stats;
+    [drawable addPresentedHandler:^(id<MTLDrawable> presented) {
+        // A drawable that was never shown reports a presentedTime of 0
+        if (presented.presentedTime > 0.0) {
+            frame_stats_record_latency(*statsPtr, frame, LATENCY_PRESENT,
+                                       (presented.presentedTime - frameBegin) * 1000.0);
+        }
+    }];
+}
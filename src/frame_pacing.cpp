@@ -0,0 +1,58 @@
+#include "frame_pacing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+double frame_pacing_interval(const FramePacingSettings& settings, double refreshPeriod) {
+    switch (settings.mode) {
+    case PresentMode::VSync:
+        return refreshPeriod;
+    case PresentMode::FixedRate: {
+        // A minimum on-screen duration is rounded up to the next refresh
+        double requested = 1.0 / std::max(settings.targetFps, 1.0f);
+        return std::max(1.0, std::ceil(requested / refreshPeriod - 1e-3)) * refreshPeriod;
+    }
+    case PresentMode::Uncapped:
+        break;
+    }
+    return 0.0;
+}
+
+float frame_pacer_tick(FramePacer& pacer, const FramePacingSettings& settings, double refreshPeriod, double now) {
+    if (pacer.lastTime < 0.0) {
+        pacer.lastTime = now;
+        pacer.carry = 0.0;
+        pacer.dt = 0.0f;
+        return 0.0f;
+    }
+    double raw = std::min(now - pacer.lastTime, (double)settings.maxDt);
+    pacer.lastTime = now;
+
+    double interval = frame_pacing_interval(settings, refreshPeriod);
+    if (interval <= 0.0) {
+        pacer.carry = 0.0;
+        pacer.dt = pacer.dt > 0.0f ? pacer.dt + ((float)raw - pacer.dt) * settings.smoothing : (float)raw;
+        return pacer.dt;
+    }
+
+    // Hand out whole intervals; what is left over stays in carry for the next frame
+    double elapsed = raw + pacer.carry;
+    double intervals = std::max(1.0, std::round(elapsed / interval));
+    double dt = std::min(intervals * interval, (double)settings.maxDt);
+    pacer.carry = std::clamp(elapsed - dt, -interval, interval);
+    pacer.dt = (float)dt;
+    return pacer.dt;
+}
+
+double frame_vsync_time(double vsync, double refreshPeriod, double now) {
+    if (vsync < 0.0 || refreshPeriod <= 0.0) {
+        return now;
+    }
+    return vsync + std::floor((now - vsync) / refreshPeriod) * refreshPeriod;
+}
+
+float game_clock_advance(GameClock& clock, const GameClockSettings& settings, float dt) {
+    clock.dt = settings.paused ? 0.0f : dt * std::max(settings.timeScale, 0.0f);
+    clock.time += clock.dt;
+    return clock.dt;
+}
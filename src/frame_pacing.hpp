@@ -0,0 +1,108 @@
+/**
+ * @file frame_pacing.hpp
+ * @brief Present modes and the smoothed frame delta that snapshots are sampled with.
+ *
+ * Raw wall-clock deltas jitter by a millisecond or two around the refresh period, which
+ * shows up as camera judder even when every frame is presented on time. When frames
+ * are paced to the display, the delta is instead snapped to a whole number of
+ * presentation intervals, and the rounding error is carried into the next frame so the
+ * sampled time never drifts from wall-clock time.
+ *
+ * The world's own clock, which animates the creatures, wind, water and particles, runs off
+ * the same delta in double precision, scaled for slow motion or stopped while paused. The
+ * camera and streaming keep the real delta, so a paused world can still be flown through.
+ */
+
+#pragma once
+#include <cstdint>
+
+/**
+ * @enum PresentMode
+ * @brief How frames are presented.
+ */
+enum class PresentMode {
+    VSync,      ///< One frame per display refresh.
+    Uncapped,   ///< Present as soon as a frame is done; tears, for measuring throughput.
+    FixedRate,  ///< Every frame stays on screen for at least 1 / targetFps.
+};
+
+/**
+ * @struct FramePacingSettings
+ * @brief The present mode and its parameters.
+ */
+struct FramePacingSettings {
+    PresentMode mode = PresentMode::VSync;  ///< How frames are presented.
+    float targetFps = 60.0f;                ///< Frame rate of PresentMode::FixedRate.
+    uint32_t drawableCount = 3;             ///< CAMetalLayer.maximumDrawableCount: 2 for latency, 3 for throughput.
+    float maxDt = 0.1f;                     ///< Longest delta handed out, so a stall does not teleport the camera.
+    float smoothing = 0.2f;                 ///< Weight of a new sample in the uncapped moving average.
+};
+
+/**
+ * @struct FramePacer
+ * @brief Timing state carried between frames.
+ */
+struct FramePacer {
+    double lastTime = -1.0;     ///< Time of the previous tick in seconds, negative before the first.
+    double carry = 0.0;         ///< Wall-clock time not yet handed out as delta.
+    float dt = 0.0f;            ///< Delta returned by the last tick.
+};
+
+/**
+ * @brief Returns the time each frame is meant to stay on screen.
+ * @param settings The present mode.
+ * @param refreshPeriod The display refresh period in seconds.
+ * @return The interval in seconds, a whole number of refreshes, or 0 if frames are not paced.
+ */
+double frame_pacing_interval(const FramePacingSettings& settings, double refreshPeriod);
+
+/**
+ * @brief Measures the frame that starts now and returns the delta to simulate.
+ * @param pacer The timing state.
+ * @param settings The present mode.
+ * @param refreshPeriod The display refresh period in seconds.
+ * @param now The current time in seconds on a monotonic clock.
+ * @return The delta in seconds; 0 on the first tick.
+ */
+float frame_pacer_tick(FramePacer& pacer, const FramePacingSettings& settings, double refreshPeriod, double now);
+
+/**
+ * @brief Returns the display refresh a frame starting now is sampled at.
+ *
+ * The display link reports refreshes on its own thread, so the one it last reported may be a
+ * few periods old by the time a frame starts; it is carried forward by whole periods. Frames
+ * sampled at refreshes move by whole periods, however late the CPU started them.
+ *
+ * @param vsync A refresh the display link reported, on the clock of now; negative if none yet.
+ * @param refreshPeriod The display refresh period in seconds.
+ * @param now The current time in seconds.
+ * @return The last refresh at or before now, or now without a reported refresh.
+ */
+double frame_vsync_time(double vsync, double refreshPeriod, double now);
+
+/**
+ * @struct GameClockSettings
+ * @brief How fast world time runs against real time.
+ */
+struct GameClockSettings {
+    bool paused = false;        ///< Stops world time; the camera still moves.
+    float timeScale = 1.0f;     ///< World seconds per real second, below 1 for slow motion.
+};
+
+/**
+ * @struct GameClock
+ * @brief World time, which animations and world simulation read instead of the frame delta.
+ */
+struct GameClock {
+    double time = 0.0;          ///< World seconds since start; double, so it does not lose precision over a session.
+    float dt = 0.0f;            ///< World delta of the last advance.
+};
+
+/**
+ * @brief Advances world time by a frame.
+ * @param clock The world time.
+ * @param settings The pause state and time scale.
+ * @param dt The frame's real delta, from frame_pacer_tick().
+ * @return The world delta: dt scaled, or 0 while paused.
+ */
+float game_clock_advance(GameClock& clock, const GameClockSettings& settings, float dt);
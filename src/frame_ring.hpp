@@ -0,0 +1,91 @@
+/**
+ * @file frame_ring.hpp
+ * @brief Per-frame ring of shared buffers for transient GPU data such as uniforms.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <vector>
+
+/// Default number of frames the CPU may encode ahead of the GPU.
+constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 3;
+
+/// Alignment of sub-allocations; satisfies the constant buffer offset rules on all Macs.
+constexpr size_t FRAME_RING_ALIGNMENT = 256;
+
+/**
+ * @struct FrameAllocation
+ * @brief A slice of the current frame's ring buffer.
+ */
+struct FrameAllocation {
+    id<MTLBuffer> buffer;   ///< The buffer backing the slice.
+    size_t offset;          ///< Byte offset of the slice within the buffer.
+    void* contents;         ///< CPU pointer to the start of the slice.
+};
+
+/**
+ * @struct FrameRing
+ * @brief One shared buffer per in-flight frame, gated by a semaphore.
+ *
+ * The CPU writes frame N+1 into its own buffer while the GPU still reads frame N,
+ * and only blocks once all buffers are in use.
+ */
+struct FrameRing {
+    std::vector<id<MTLBuffer>> buffers; ///< One buffer per in-flight frame.
+    dispatch_semaphore_t inFlight;      ///< Counts buffers the CPU may write to.
+    uint32_t frameIndex = 0;            ///< Buffer used by the frame being encoded.
+    size_t capacity = 0;                ///< Size of each buffer in bytes.
+    size_t offset = 0;                  ///< Next free byte in the current buffer.
+};
+
+/**
+ * @brief Creates a frame ring.
+ * @param device The Metal device.
+ * @param bytesPerFrame The capacity of each per-frame buffer.
+ * @param framesInFlight The number of frames the CPU may run ahead of the GPU.
+ * @return A new FrameRing.
+ */
+FrameRing create_frame_ring(id<MTLDevice> device, size_t bytesPerFrame, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+/**
+ * @brief Waits for a free buffer and makes it current.
+ *
+ * Must be paired with either frame_ring_end_frame or frame_ring_abort_frame.
+ * @param ring The frame ring.
+ */
+void frame_ring_begin_frame(FrameRing& ring);
+
+/**
+ * @brief Sub-allocates an aligned slice from the current frame's buffer.
+ * @param ring The frame ring.
+ * @param size The number of bytes required.
+ * @return The allocated slice.
+ */
+FrameAllocation frame_ring_allocate(FrameRing& ring, size_t size);
+
+/**
+ * @brief Releases the current buffer once the command buffer has completed.
+ * @param ring The frame ring.
+ * @param cmd The command buffer that reads this frame's data. Must not be committed yet.
+ */
+void frame_ring_end_frame(FrameRing& ring, id<MTLCommandBuffer> cmd);
+
+/**
+ * @brief Releases the current buffer immediately, e.g. when no drawable was available.
+ *
+ * The next frame_ring_begin_frame takes the same buffer again, since the one after it may still
+ * be in use by the GPU.
+ * @param ring The frame ring.
+ */
+void frame_ring_abort_frame(FrameRing& ring);
+
+/**
+ * @brief Binds a pass's FrameUniforms at FRAME_UNIFORMS_BUFFER_INDEX of the vertex and fragment stages.
+ *
+ * Meshlet draws carry their own view-projection in MeshletUniforms, so the object and mesh
+ * stages are left alone.
+ *
+ * @param frame The frame ring slot holding the FrameUniforms.
+ * @param enc The render encoder; every encoder of the pass needs them bound.
+ */
+void frame_uniforms_bind(const FrameAllocation& frame, id<MTLRenderCommandEncoder> enc);
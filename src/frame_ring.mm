@@ -0,0 +1,58 @@
+#import "frame_ring.hpp"
+
+#include "frame_slots.hpp"
+#include "objects.hpp"
+
+FrameRing create_frame_ring(id<MTLDevice> device, size_t bytesPerFrame, uint32_t framesInFlight) {
+    FrameRing ring;
+    ring.capacity = bytesPerFrame;
+    ring.inFlight = dispatch_semaphore_create(framesInFlight);
+
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        id<MTLBuffer> buffer = [device newBufferWithLength:bytesPerFrame
+                                                   options:MTLResourceStorageModeShared];
+        buffer.label = [NSString stringWithFormat:@"Frame ring %u", i];
+        ring.buffers.push_back(buffer);
+    }
+
+    // Start one before the first buffer so the first begin_frame lands on index 0.
+    ring.frameIndex = frame_slot_initial(framesInFlight);
+    return ring;
+}
+
+void frame_ring_begin_frame(FrameRing& ring) {
+    dispatch_semaphore_wait(ring.inFlight, DISPATCH_TIME_FOREVER);
+    frame_slot_begin(ring.frameIndex, (uint32_t)ring.buffers.size());
+    ring.offset = 0;
+}
+
+FrameAllocation frame_ring_allocate(FrameRing& ring, size_t size) {
+    size_t aligned = (size + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    if (ring.offset + aligned > ring.capacity) {
+        NSLog(@"Frame ring overflow: %zu of %zu bytes requested", ring.offset + aligned, ring.capacity);
+        abort();
+    }
+
+    id<MTLBuffer> buffer = ring.buffers[ring.frameIndex];
+    FrameAllocation alloc{buffer, ring.offset, (uint8_t*)buffer.contents + ring.offset};
+    ring.offset += aligned;
+    return alloc;
+}
+
+void frame_ring_end_frame(FrameRing& ring, id<MTLCommandBuffer> cmd) {
+    dispatch_semaphore_t semaphore = ring.inFlight;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+}
+
+void frame_ring_abort_frame(FrameRing& ring) {
+    // The next buffer may still be read by the oldest frame in flight; this one is not
+    frame_slot_abort(ring.frameIndex, (uint32_t)ring.buffers.size());
+    dispatch_semaphore_signal(ring.inFlight);
+}
+
+void frame_uniforms_bind(const FrameAllocation& frame, id<MTLRenderCommandEncoder> enc) {
+    [enc setVertexBuffer:frame.buffer offset:frame.offset atIndex:FRAME_UNIFORMS_BUFFER_INDEX];
+    [enc setFragmentBuffer:frame.buffer offset:frame.offset atIndex:FRAME_UNIFORMS_BUFFER_INDEX];
+}
@@ -0,0 +1,37 @@
+/**
+ * @file frame_slots.hpp
+ * @brief Which slot of a per-frame ring the next frame writes; FrameRing's bookkeeping without Metal.
+ *
+ * Frames take the slots in turn, and a semaphore holds the CPU back while every slot is in
+ * flight. A frame abandoned before it committed anything releases its slot at once, but the
+ * slot after it may still be read by the oldest frame in flight, so the next frame has to take
+ * the abandoned slot again rather than move on.
+ */
+
+#pragma once
+#include <cstdint>
+
+/// @return The index to start a ring of count slots at, so the first frame_slot_begin() takes slot 0.
+inline uint32_t frame_slot_initial(uint32_t count) {
+    return count - 1;
+}
+
+/**
+ * @brief Moves on to the slot the next frame writes; call once a slot is free.
+ * @param index The current slot, updated.
+ * @param count The number of slots.
+ * @return The new current slot.
+ */
+inline uint32_t frame_slot_begin(uint32_t& index, uint32_t count) {
+    index = (index + 1) % count;
+    return index;
+}
+
+/**
+ * @brief Gives the current slot back for a frame that committed nothing, so the next frame takes it again.
+ * @param index The current slot, moved back to the one before it.
+ * @param count The number of slots.
+ */
+inline void frame_slot_abort(uint32_t& index, uint32_t count) {
+    index = (index + count - 1) % count;
+}
@@ -0,0 +1,264 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace {
+    float elapsed_ms(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration<float, std::milli>(to - from).count();
+    }
+}
+
+const char* frame_phase_name(FramePhase phase) {
+    switch (phase) {
+        case PHASE_INPUT: return "input";
+        case PHASE_CAMERA: return "camera";
+        case PHASE_STREAMING: return "streaming";
+        case PHASE_WAIT: return "wait";
+        case PHASE_ENCODE: return "encode";
+        case PHASE_IMGUI: return "imgui";
+        case PHASE_SUBMIT: return "submit";
+        default: return "unknown";
+    }
+}
+
+const char* gpu_pass_name(GpuPass pass) {
+    switch (pass) {
+        case GPU_PASS_SHADOWS: return "shadows";
+        case GPU_PASS_SCENE: return "scene";
+        case GPU_PASS_AMBIENT_OCCLUSION: return "ao";
+        case GPU_PASS_TRANSPARENT: return "transparent";
+        case GPU_PASS_OVERLAY: return "overlay";
+        default: return "unknown";
+    }
+}
+
+const char* frame_latency_name(FrameLatency latency) {
+    switch (latency) {
+        case LATENCY_SCHEDULE: return "schedule";
+        case LATENCY_QUEUE: return "queue";
+        case LATENCY_PRESENT: return "present";
+        default: return "unknown";
+    }
+}
+
+void frame_stats_begin_frame(FrameStats& stats) {
+    stats.current = FrameSample{};
+    stats.current.frame = ++stats.frameCount;
+    stats.frameStart = std::chrono::steady_clock::now();
+    stats.phaseStart = stats.frameStart;
+}
+
+void frame_stats_end_phase(FrameStats& stats, FramePhase phase) {
+    auto now = std::chrono::steady_clock::now();
+    stats.current.phaseMs[phase] += elapsed_ms(stats.phaseStart, now);
+    stats.phaseStart = now;
+}
+
+void frame_stats_count_draw(FrameStats& stats, uint32_t indexCount, uint32_t instanceCount) {
+    stats.current.drawCalls++;
+    stats.current.triangles += (uint64_t)(indexCount / 3) * instanceCount;
+}
+
+void frame_stats_count_fog_culled(FrameStats& stats, uint32_t indexCount, uint32_t instanceCount) {
+    stats.current.fogCulledTriangles += (uint64_t)(indexCount / 3) * instanceCount;
+}
+
+void frame_stats_count_occlusion(FrameStats& stats, uint32_t tested, uint32_t culled) {
+    stats.current.occlusionTested += tested;
+    stats.current.occlusionCulled += culled;
+}
+
+void frame_stats_count_pass(FrameStats& stats, const PassTraffic& traffic) {
+    stats.current.attachmentBytes += traffic.loadedBytes + traffic.storedBytes;
+    stats.current.savedAttachmentBytes += traffic.savedBytes;
+    stats.current.memorylessBytes += traffic.memorylessBytes;
+}
+
+void frame_stats_count_rasterization(FrameStats& stats, uint64_t screenPixels, uint64_t shadedPixels) {
+    stats.current.screenPixels += screenPixels;
+    stats.current.shadedPixels += shadedPixels;
+}
+
+void frame_stats_end_frame(FrameStats& stats) {
+    stats.current.cpuMs = elapsed_ms(stats.frameStart, std::chrono::steady_clock::now());
+
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    for (auto it = stats.earlyGpu.begin(); it != stats.earlyGpu.end(); ++it) {
+        if (it->first == stats.current.frame) {
+            stats.current.gpuMs = it->second;
+            stats.earlyGpu.erase(it);
+            break;
+        }
+    }
+    for (auto it = stats.earlyGpuPasses.begin(); it != stats.earlyGpuPasses.end(); ++it) {
+        if (it->first == stats.current.frame) {
+            stats.current.gpuPassMs = it->second;
+            stats.current.hasGpuPasses = true;
+            stats.earlyGpuPasses.erase(it);
+            break;
+        }
+    }
+    auto ownLatency = [&](const std::pair<uint64_t, std::pair<FrameLatency, float>>& early) {
+        if (early.first != stats.current.frame) {
+            return false;
+        }
+        stats.current.latencyMs[early.second.first] = early.second.second;
+        return true;
+    };
+    stats.earlyLatency.erase(std::remove_if(stats.earlyLatency.begin(), stats.earlyLatency.end(), ownLatency),
+                             stats.earlyLatency.end());
+
+    if (stats.history.size() < FRAME_STATS_HISTORY) {
+        stats.history.reserve(FRAME_STATS_HISTORY); // Allocates once, on the first frame
+        stats.history.push_back(stats.current);
+    } else {
+        stats.history[stats.head] = stats.current;
+    }
+    stats.head = (stats.head + 1) % FRAME_STATS_HISTORY;
+}
+
+void frame_stats_record_gpu(FrameStats& stats, uint64_t frame, float gpuMs) {
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    for (auto& sample : stats.history) {
+        if (sample.frame == frame) {
+            sample.gpuMs = gpuMs;
+            return;
+        }
+    }
+    // The command buffer can complete before the render thread ends the frame
+    stats.earlyGpu.emplace_back(frame, gpuMs);
+}
+
+void frame_stats_record_gpu_passes(FrameStats& stats, uint64_t frame, const GpuPassTimes& passMs) {
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    for (auto& sample : stats.history) {
+        if (sample.frame == frame) {
+            sample.gpuPassMs = passMs;
+            sample.hasGpuPasses = true;
+            return;
+        }
+    }
+    stats.earlyGpuPasses.emplace_back(frame, passMs);
+}
+
+void frame_stats_record_latency(FrameStats& stats, uint64_t frame, FrameLatency latency, float ms) {
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    uint64_t newest = 0;
+    for (auto& sample : stats.history) {
+        if (sample.frame == frame) {
+            sample.latencyMs[latency] = ms;
+            return;
+        }
+        newest = std::max(newest, sample.frame);
+    }
+    // A finished frame that is not in the history any more has been overwritten
+    if (frame > newest) {
+        stats.earlyLatency.emplace_back(frame, std::make_pair(latency, ms));
+    }
+}
+
+FrameTimeSummary frame_stats_summarize_latency(const FrameStats& stats, FrameLatency latency, uint64_t firstFrame) {
+    std::vector<float> ms;
+    {
+        std::lock_guard<std::mutex> lock(stats.historyMutex);
+        ms.reserve(stats.history.size());
+        for (const auto& sample : stats.history) {
+            if (sample.frame >= firstFrame) {
+                ms.push_back(sample.latencyMs[latency]);
+            }
+        }
+    }
+    return summarize_frame_times(std::move(ms));
+}
+
+std::vector<FrameSample> frame_stats_history(const FrameStats& stats) {
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    if (stats.history.size() < FRAME_STATS_HISTORY) {
+        return stats.history;
+    }
+
+    std::vector<FrameSample> ordered(stats.history.begin() + stats.head, stats.history.end());
+    ordered.insert(ordered.end(), stats.history.begin(), stats.history.begin() + stats.head);
+    return ordered;
+}
+
+float frame_stats_latest_gpu(const FrameStats& stats, uint64_t& frame) {
+    std::lock_guard<std::mutex> lock(stats.historyMutex);
+    frame = 0;
+    float gpuMs = -1.0f;
+    for (const auto& sample : stats.history) {
+        if (sample.gpuMs >= 0.0f && sample.frame > frame) {
+            frame = sample.frame;
+            gpuMs = sample.gpuMs;
+        }
+    }
+    return gpuMs;
+}
+
+void frame_stats_write_csv(const FrameStats& stats, std::ostream& out) {
+    out << "frame,cpu_ms,gpu_ms";
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        out << ',' << frame_phase_name((FramePhase)p) << "_ms";
+    }
+    for (int p = 0; p < GPU_PASS_COUNT; ++p) {
+        out << ',' << gpu_pass_name((GpuPass)p) << "_gpu_ms";
+    }
+    out << ",draw_calls,state_changes,triangles,fog_culled_triangles,occlusion_tested,occlusion_culled,transient_bytes,"
+           "resident_bytes,attachment_bytes,saved_attachment_bytes,memoryless_bytes";
+    for (int l = 0; l < LATENCY_COUNT; ++l) {
+        out << ',' << frame_latency_name((FrameLatency)l) << "_ms";
+    }
+    out << '\n';
+
+    for (const auto& sample : frame_stats_history(stats)) {
+        out << sample.frame << ',' << sample.cpuMs << ',' << sample.gpuMs;
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            out << ',' << sample.phaseMs[p];
+        }
+        // -1 like gpu_ms when the passes were not timed
+        for (int p = 0; p < GPU_PASS_COUNT; ++p) {
+            out << ',' << (sample.hasGpuPasses ? sample.gpuPassMs[p] : -1.0f);
+        }
+        out << ',' << sample.drawCalls << ',' << sample.stateChanges << ',' << sample.triangles << ','
+            << sample.fogCulledTriangles << ',' << sample.occlusionTested << ',' << sample.occlusionCulled << ','
+            << sample.transientBytes << ',' << sample.residentBytes << ',' << sample.attachmentBytes << ','
+            << sample.savedAttachmentBytes << ',' << sample.memorylessBytes;
+        for (int l = 0; l < LATENCY_COUNT; ++l) {
+            out << ',' << sample.latencyMs[l];
+        }
+        out << '\n';
+    }
+}
+
+bool frame_stats_write_csv(const FrameStats& stats, const char* path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    frame_stats_write_csv(stats, file);
+    return (bool)file;
+}
+
+FrameTimeSummary summarize_frame_times(std::vector<float> ms) {
+    ms.erase(std::remove_if(ms.begin(), ms.end(), [](float v) { return v < 0.0f; }), ms.end());
+
+    FrameTimeSummary summary;
+    summary.count = ms.size();
+    if (ms.empty()) {
+        return summary;
+    }
+
+    std::sort(ms.begin(), ms.end());
+    auto rank = [&](float p) { return ms[std::min(ms.size() - 1, (size_t)std::max(std::ceil(p * ms.size()) - 1.0f, 0.0f))]; };
+
+    summary.mean = std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    summary.p50 = rank(0.50f);
+    summary.p95 = rank(0.95f);
+    summary.p99 = rank(0.99f);
+    summary.max = ms.back();
+    summary.spikes = ms.end() - std::upper_bound(ms.begin(), ms.end(), 2.0f * summary.p50);
+    return summary;
+}
@@ -0,0 +1,277 @@
+/**
+ * @file frame_stats.hpp
+ * @brief Per-frame CPU phase timings, GPU time and draw counters with a rolling history.
+ */
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "memory_report.hpp"
+
+/// Number of frames kept for the overlay histograms and CSV export.
+constexpr size_t FRAME_STATS_HISTORY = 240;
+
+/**
+ * @enum FramePhase
+ * @brief CPU work of a frame, in the order it runs.
+ */
+enum FramePhase {
+    PHASE_INPUT,      ///< Polling window events.
+    PHASE_CAMERA,     ///< update_camera and terrain clamping.
+    PHASE_STREAMING,  ///< Chunk streaming and LOD selection.
+    PHASE_WAIT,       ///< Waiting for a free uniform buffer and, late in the frame, a drawable.
+    PHASE_ENCODE,     ///< Encoding scene draws.
+    PHASE_IMGUI,      ///< Building and encoding the ImGui overlay.
+    PHASE_SUBMIT,     ///< Ending the encoder, presenting and committing.
+    PHASE_COUNT
+};
+
+/// @return A short name for a phase, used as its CSV column and overlay label.
+const char* frame_phase_name(FramePhase phase);
+
+/**
+ * @enum GpuPass
+ * @brief Groups of GPU passes timed by the GpuProfiler.
+ */
+enum GpuPass {
+    GPU_PASS_SHADOWS,       ///< Every shadow cascade redrawn this frame.
+    GPU_PASS_SCENE,         ///< The scene pass: terrain, objects and, in deferred mode, lighting.
+    GPU_PASS_AMBIENT_OCCLUSION, ///< The occlusion kernel and its upsample; see gpu_ambient_occlusion.hpp.
+    GPU_PASS_TRANSPARENT,   ///< The ocean simulation and the transparent pass: water and the OIT composite.
+    GPU_PASS_OVERLAY,       ///< The composite pass: the scene copy and ImGui.
+    GPU_PASS_COUNT
+};
+
+/// @return A short name for a GPU pass, used in its CSV column and overlay label.
+const char* gpu_pass_name(GpuPass pass);
+
+/// GPU milliseconds of each GpuPass in one frame.
+using GpuPassTimes = std::array<float, GPU_PASS_COUNT>;
+
+/**
+ * @enum FrameLatency
+ * @brief Delays of a frame reported by its command buffer's and drawable's handlers.
+ */
+enum FrameLatency {
+    LATENCY_SCHEDULE, ///< Commit of the scene's command buffer until Metal scheduled it.
+    LATENCY_QUEUE,    ///< Commit until the GPU started it; grows while the GPU is behind the CPU.
+    LATENCY_PRESENT,  ///< Start of the frame, where input is read, until its drawable was on screen.
+    LATENCY_COUNT
+};
+
+/// @return A short name for a latency, used as its CSV column and report key.
+const char* frame_latency_name(FrameLatency latency);
+
+/**
+ * @struct FrameSample
+ * @brief Everything measured for one frame.
+ */
+struct FrameSample {
+    uint64_t frame = 0;                 ///< Frame number, starting at 1.
+    float phaseMs[PHASE_COUNT] = {};    ///< CPU milliseconds spent in each phase.
+    float cpuMs = 0.0f;                 ///< CPU milliseconds from begin to end of the frame.
+    float gpuMs = -1.0f;                ///< GPU milliseconds, or negative until the command buffer completes.
+    GpuPassTimes gpuPassMs = {};        ///< GPU milliseconds per pass; only valid with hasGpuPasses.
+    bool hasGpuPasses = false;          ///< True once the frame's pass timestamps were resolved.
+    float latencyMs[LATENCY_COUNT] = { -1.0f, -1.0f, -1.0f }; ///< Each FrameLatency, negative until it arrives.
+    uint32_t drawCalls = 0;             ///< Draw calls encoded.
+    uint32_t stateChanges = 0;          ///< Pipeline, depth state and buffer bindings encoded.
+    uint64_t triangles = 0;             ///< Triangles submitted, counting every instance.
+    uint64_t fogCulledTriangles = 0;    ///< Triangles not submitted because fog hid them; see fog.hpp.
+    uint32_t occlusionTested = 0;       ///< Entities tested against the terrain; see occlusion_buffer.hpp.
+    uint32_t occlusionCulled = 0;       ///< Of those, entities not submitted because the terrain hid them.
+    uint64_t transientBytes = 0;        ///< Bytes written to per-frame buffers.
+    uint64_t residentBytes = 0;         ///< GPU bytes allocated by every subsystem; see MemoryReport.
+    uint64_t attachmentBytes = 0;       ///< Bytes render pass attachments loaded from and stored to memory.
+    uint64_t savedAttachmentBytes = 0;  ///< Attachment bytes not moved because they were cleared or discarded.
+    uint64_t memorylessBytes = 0;       ///< Attachment memory not allocated because it is memoryless.
+    uint64_t screenPixels = 0;          ///< Pixels of the scene pass's view; 0 unless a rate map shaded it.
+    uint64_t shadedPixels = 0;          ///< Pixels the rate map had it shade instead; see rasterization_rate.hpp.
+    uint32_t heapAllocations = 0;       ///< operator new calls while streaming and encoding; see heap_allocation_count().
+    uint32_t autoreleasedBlocks = 0;    ///< malloc blocks freed by the frame's autorelease pool; tracked builds only.
+};
+
+/**
+ * @struct PassTraffic
+ * @brief Attachment memory traffic of one render pass.
+ */
+struct PassTraffic {
+    uint64_t loadedBytes = 0;           ///< Read from memory by Load actions.
+    uint64_t storedBytes = 0;           ///< Written to memory by Store and resolve actions.
+    uint64_t savedBytes = 0;            ///< Not moved, compared to loading and storing every attachment.
+    uint64_t memorylessBytes = 0;       ///< Size of the attachments that only exist in tile memory.
+};
+
+/**
+ * @struct FrameTimeSummary
+ * @brief Distribution of a series of frame times.
+ */
+struct FrameTimeSummary {
+    size_t count = 0;       ///< Number of samples.
+    float mean = 0.0f;      ///< Mean in milliseconds.
+    float p50 = 0.0f;       ///< Median in milliseconds.
+    float p95 = 0.0f;       ///< 95th percentile in milliseconds.
+    float p99 = 0.0f;       ///< 99th percentile in milliseconds.
+    float max = 0.0f;       ///< Slowest sample in milliseconds.
+    size_t spikes = 0;      ///< Samples over twice the median: the hitches a player notices.
+};
+
+/**
+ * @struct FrameStats
+ * @brief The frame being measured plus a ring of finished frames.
+ *
+ * GPU times arrive from command buffer completion handlers on another thread, so the
+ * history is guarded by a mutex; everything else is only touched by the render thread.
+ */
+struct FrameStats {
+    FrameSample current;                                ///< The frame being measured.
+    std::vector<FrameSample> history;                   ///< Finished frames, used as a ring.
+    size_t head = 0;                                    ///< Next slot of history to overwrite.
+    uint64_t frameCount = 0;                            ///< Frames begun so far.
+    std::chrono::steady_clock::time_point frameStart;   ///< When the current frame began.
+    std::chrono::steady_clock::time_point phaseStart;   ///< When the current phase began.
+    std::vector<std::pair<uint64_t, float>> earlyGpu;   ///< GPU times that arrived before their frame ended.
+    std::vector<std::pair<uint64_t, GpuPassTimes>> earlyGpuPasses; ///< Pass times that arrived before their frame ended.
+    std::vector<std::pair<uint64_t, std::pair<FrameLatency, float>>> earlyLatency; ///< Likewise for latencies.
+    mutable std::mutex historyMutex;                    ///< Guards history, head and the early GPU times and latencies.
+    MemoryReport memory;                                ///< Memory per subsystem as of the current frame.
+};
+
+/**
+ * @brief Starts measuring a new frame.
+ * @param stats The stats to record into.
+ */
+void frame_stats_begin_frame(FrameStats& stats);
+
+/**
+ * @brief Attributes the time since the previous phase ended to a phase.
+ * @param stats The stats to record into.
+ * @param phase The phase that just finished.
+ */
+void frame_stats_end_phase(FrameStats& stats, FramePhase phase);
+
+/**
+ * @brief Counts one draw call.
+ * @param stats The stats to record into.
+ * @param indexCount The number of indices drawn per instance.
+ * @param instanceCount The number of instances drawn.
+ */
+void frame_stats_count_draw(FrameStats& stats, uint32_t indexCount, uint32_t instanceCount = 1);
+
+/**
+ * @brief Counts the triangles of a draw dropped because fog hid it completely.
+ * @param stats The stats to record into.
+ * @param indexCount The number of indices the draw would have drawn per instance.
+ * @param instanceCount The number of instances dropped.
+ */
+void frame_stats_count_fog_culled(FrameStats& stats, uint32_t indexCount, uint32_t instanceCount = 1);
+
+/**
+ * @brief Counts the entities tested against the terrain occluders.
+ * @param stats The stats to record into.
+ * @param tested The number of entities tested.
+ * @param culled The number of them the terrain hid.
+ */
+void frame_stats_count_occlusion(FrameStats& stats, uint32_t tested, uint32_t culled);
+
+/**
+ * @brief Adds the attachment traffic of one render pass.
+ * @param stats The stats to record into.
+ * @param traffic The pass's traffic, from audit_render_pass().
+ */
+void frame_stats_count_pass(FrameStats& stats, const PassTraffic& traffic);
+
+/**
+ * @brief Records the pixels a pass drawn through a rasterization rate map covered and shaded.
+ * @param stats The stats to record into.
+ * @param screenPixels The pixels of the screen the pass covers.
+ * @param shadedPixels The pixels of its physical target.
+ */
+void frame_stats_count_rasterization(FrameStats& stats, uint64_t screenPixels, uint64_t shadedPixels);
+
+/**
+ * @brief Finishes the current frame and stores it in the history.
+ * @param stats The stats to record into.
+ */
+void frame_stats_end_frame(FrameStats& stats);
+
+/**
+ * @brief Stores the GPU time of a finished frame. Safe to call from any thread.
+ * @param stats The stats to record into.
+ * @param frame The frame number the command buffer belonged to.
+ * @param gpuMs The GPU time in milliseconds.
+ */
+void frame_stats_record_gpu(FrameStats& stats, uint64_t frame, float gpuMs);
+
+/**
+ * @brief Stores the per-pass GPU times of a finished frame. Safe to call from any thread.
+ * @param stats The stats to record into.
+ * @param frame The frame number the passes belonged to.
+ * @param passMs The GPU time of each pass in milliseconds.
+ */
+void frame_stats_record_gpu_passes(FrameStats& stats, uint64_t frame, const GpuPassTimes& passMs);
+
+/**
+ * @brief Stores one latency of a frame. Safe to call from any thread.
+ *
+ * The present latency usually arrives frames after the frame ended; once the frame has left
+ * the history it is dropped.
+ *
+ * @param stats The stats to record into.
+ * @param frame The frame number the latency belongs to.
+ * @param latency Which latency.
+ * @param ms The latency in milliseconds.
+ */
+void frame_stats_record_latency(FrameStats& stats, uint64_t frame, FrameLatency latency, float ms);
+
+/**
+ * @brief Summarizes one latency over the frames in the history.
+ * @param stats The stats to read.
+ * @param latency Which latency.
+ * @param firstFrame Frames before this one are left out, e.g. a benchmark's warm-up.
+ * @return The summary of the frames the latency arrived for.
+ */
+FrameTimeSummary frame_stats_summarize_latency(const FrameStats& stats, FrameLatency latency, uint64_t firstFrame = 0);
+
+/**
+ * @brief Copies the finished frames, oldest first.
+ * @param stats The stats to read.
+ * @return Up to FRAME_STATS_HISTORY samples.
+ */
+std::vector<FrameSample> frame_stats_history(const FrameStats& stats);
+
+/**
+ * @brief Finds the newest finished frame whose GPU time has arrived.
+ * @param stats The stats to read.
+ * @param frame Receives the frame number, or 0 if there is none.
+ * @return Its GPU time in milliseconds, or -1 if there is none.
+ */
+float frame_stats_latest_gpu(const FrameStats& stats, uint64_t& frame);
+
+/**
+ * @brief Writes the history as CSV with a header row, oldest frame first.
+ * @param stats The stats to export.
+ * @param out The stream to write to.
+ */
+void frame_stats_write_csv(const FrameStats& stats, std::ostream& out);
+
+/**
+ * @brief Writes the history as CSV to a file.
+ * @param stats The stats to export.
+ * @param path The file to create or overwrite.
+ * @return True if the file was written.
+ */
+bool frame_stats_write_csv(const FrameStats& stats, const char* path);
+
+/**
+ * @brief Summarizes frame times with nearest-rank percentiles.
+ * @param ms The samples in milliseconds; negative values are ignored.
+ * @return The summary, all zero if there are no samples.
+ */
+FrameTimeSummary summarize_frame_times(std::vector<float> ms);
@@ -0,0 +1,138 @@
+#include "frame_stats_overlay.hpp"
+
+#include <algorithm>
+
+#include "frame_arena.hpp"
+#include "imgui.h"
+
+namespace {
+    const float HISTOGRAM_HEIGHT = 40.0f;
+
+    void plot(const char* label, const std::vector<float>& values) {
+        float maxValue = values.empty() ? 1.0f : *std::max_element(values.begin(), values.end());
+        ImGui::PlotHistogram(label, values.data(), (int)values.size(), 0, nullptr,
+                             0.0f, std::max(maxValue, 1.0f) * 1.1f, ImVec2(0, HISTOGRAM_HEIGHT));
+    }
+
+    void draw_cost_table(const char* title, const std::vector<DrawCost>& costs, bool objects) {
+        ImGui::Text("%-24s %8s %6s", title, "GPU ms", "draws");
+        for (const DrawCost& cost : costs) {
+            const std::string name = objects ? draw_object_name(cost.id) : "material " + std::to_string(cost.id);
+            ImGui::Text("%-24s %8.3f %6u", name.c_str(), cost.ms, cost.draws);
+        }
+    }
+}
+
+void draw_frame_stats_overlay(const FrameStats& stats, const char* csvPath, const DrawCosts* drawCosts) {
+    std::vector<FrameSample> samples = frame_stats_history(stats);
+
+    ImGui::Begin("Frame Stats");
+    if (samples.empty()) {
+        ImGui::Text("Waiting for the first frame");
+        ImGui::End();
+        return;
+    }
+
+    std::vector<float> cpu, gpu;
+    cpu.reserve(samples.size());
+    gpu.reserve(samples.size());
+    for (const auto& sample : samples) {
+        cpu.push_back(sample.cpuMs);
+        gpu.push_back(std::max(sample.gpuMs, 0.0f));
+    }
+
+    // The newest frame rarely has its GPU time yet, so report the newest completed one
+    const FrameSample& last = samples.back();
+    float lastGpu = -1.0f;
+    for (auto it = samples.rbegin(); it != samples.rend() && lastGpu < 0.0f; ++it) {
+        lastGpu = it->gpuMs;
+    }
+
+    ImGui::Text("CPU %.2f ms   GPU %.2f ms", last.cpuMs, std::max(lastGpu, 0.0f));
+    plot("CPU ms", cpu);
+    plot("GPU ms", gpu);
+
+    if (ImGui::CollapsingHeader("CPU phases")) {
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            ImGui::Text("%-10s %6.3f ms", frame_phase_name((FramePhase)p), last.phaseMs[p]);
+        }
+    }
+
+    // Pass timings only exist while the GPU profiler samples them
+    const FrameSample* timed = nullptr;
+    for (auto it = samples.rbegin(); it != samples.rend() && !timed; ++it) {
+        timed = it->hasGpuPasses && it->gpuMs >= 0.0f ? &*it : nullptr;
+    }
+    if (timed && ImGui::CollapsingHeader("GPU passes")) {
+        float passTotal = 0.0f;
+        for (int p = 0; p < GPU_PASS_COUNT; ++p) {
+            ImGui::Text("%-10s %6.3f ms", gpu_pass_name((GpuPass)p), timed->gpuPassMs[p]);
+            passTotal += timed->gpuPassMs[p];
+        }
+        // Compute work, and the gaps between passes
+        ImGui::Text("%-10s %6.3f ms", "other", std::max(timed->gpuMs - passTotal, 0.0f));
+    }
+
+    // Per sampled frame, as of the last finished window
+    if (drawCosts && ImGui::CollapsingHeader("GPU draw costs")) {
+        std::vector<DrawCost> objects, materials;
+        if (draw_costs_top(*drawCosts, objects, materials) == 0) {
+            ImGui::Text("Waiting for the first sampled frames");
+        } else {
+            draw_cost_table("Object", objects, true);
+            draw_cost_table("Material", materials, false);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Latency")) {
+        ImGui::Text("%-10s %8s %8s", "", "p50 ms", "p95 ms");
+        for (int l = 0; l < LATENCY_COUNT; ++l) {
+            const FrameTimeSummary summary = frame_stats_summarize_latency(stats, (FrameLatency)l);
+            if (summary.count > 0) {
+                ImGui::Text("%-10s %8.2f %8.2f", frame_latency_name((FrameLatency)l), summary.p50, summary.p95);
+            }
+        }
+    }
+
+    ImGui::Text("Draw calls: %u", last.drawCalls);
+    ImGui::Text("State changes: %u", last.stateChanges);
+    ImGui::Text("Triangles: %llu", (unsigned long long)last.triangles);
+    if (last.fogCulledTriangles > 0) {
+        ImGui::Text("Fog culled: %llu triangles", (unsigned long long)last.fogCulledTriangles);
+    }
+    if (last.occlusionTested > 0) {
+        ImGui::Text("Terrain occluded: %u of %u entities (%.0f%%)", last.occlusionCulled, last.occlusionTested,
+                    100.0 * last.occlusionCulled / last.occlusionTested);
+    }
+    if (last.screenPixels > 0) {
+        ImGui::Text("Variable rate: %.0f%% of scene pixels shaded", 100.0 * last.shadedPixels / last.screenPixels);
+    }
+    ImGui::Text("Transient: %.1f KB", last.transientBytes / 1024.0);
+    ImGui::Text("Resident: %.1f MB", last.residentBytes / (1024.0 * 1024.0));
+    ImGui::Text("Attachments: %.1f MB moved, %.1f MB saved", last.attachmentBytes / (1024.0 * 1024.0),
+                last.savedAttachmentBytes / (1024.0 * 1024.0));
+    ImGui::Text("Memoryless: %.1f MB", last.memorylessBytes / (1024.0 * 1024.0));
+    if (HEAP_ALLOCATION_TRACKING) {
+        ImGui::Text("Heap allocations: %u", last.heapAllocations);
+        ImGui::Text("Autoreleased blocks: %u", last.autoreleasedBlocks);
+    }
+
+    if (ImGui::CollapsingHeader("Memory")) {
+        const double mb = 1024.0 * 1024.0;
+        ImGui::Text("%-10s %9s %9s", "", "GPU MB", "CPU MB");
+        for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+            ImGui::Text("%-10s %9.2f %9.2f", memory_tag_name((MemoryTag)t), stats.memory.gpuBytes[t] / mb,
+                        stats.memory.cpuBytes[t] / mb);
+        }
+        ImGui::Text("%-10s %9.2f %9.2f", "total", memory_report_gpu_total(stats.memory) / mb,
+                    memory_report_cpu_total(stats.memory) / mb);
+    }
+
+    if (ImGui::Button("Export CSV")) {
+        frame_stats_write_csv(stats, csvPath);
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", csvPath);
+
+    ImGui::End();
+}
@@ -0,0 +1,18 @@
+/**
+ * @file frame_stats_overlay.hpp
+ * @brief ImGui window that shows FrameStats.
+ */
+
+#pragma once
+#include "draw_costs.hpp"
+#include "frame_stats.hpp"
+
+/**
+ * @brief Draws the "Frame Stats" window with rolling histograms and a CSV export button.
+ *
+ * Must be called between ImGui::NewFrame and ImGui::Render.
+ * @param stats The stats to show.
+ * @param csvPath Where the export button writes the history.
+ * @param drawCosts The most expensive draws, or nullptr while they are not timed.
+ */
+void draw_frame_stats_overlay(const FrameStats& stats, const char* csvPath, const DrawCosts* drawCosts = nullptr);
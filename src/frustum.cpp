@@ -0,0 +1,161 @@
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+    simd::float4 matrix_row(const simd::float4x4& m, int row) {
+        return { m.columns[0][row], m.columns[1][row], m.columns[2][row], m.columns[3][row] };
+    }
+
+    simd::float4 normalize_plane(simd::float4 plane) {
+        float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length == 0.0f) {
+            // The far plane of an infinite projection: every point is inside
+            return { 0.0f, 0.0f, 0.0f, 1.0f };
+        }
+        return plane / length;
+    }
+}
+
+Frustum extract_frustum(const simd::float4x4& viewProjection) {
+    simd::float4 r0 = matrix_row(viewProjection, 0);
+    simd::float4 r1 = matrix_row(viewProjection, 1);
+    simd::float4 r2 = matrix_row(viewProjection, 2);
+    simd::float4 r3 = matrix_row(viewProjection, 3);
+
+    Frustum frustum;
+    frustum.planes[0] = normalize_plane(r3 + r0);
+    frustum.planes[1] = normalize_plane(r3 - r0);
+    frustum.planes[2] = normalize_plane(r3 + r1);
+    frustum.planes[3] = normalize_plane(r3 - r1);
+    frustum.planes[4] = normalize_plane(r2);        // Clip z >= 0
+    frustum.planes[5] = normalize_plane(r3 - r2);
+    return frustum;
+}
+
+BoundingBox transform_bounds(const BoundingBox& box, const simd::float4x4& transform) {
+    // Arvo's method: each matrix column widens the box by its extent along that axis
+    simd::float3 center = (box.min + box.max) * 0.5f;
+    simd::float3 extent = (box.max - box.min) * 0.5f;
+
+    simd::float4 c = transform * simd::float4{ center.x, center.y, center.z, 1.0f };
+    simd::float3 worldCenter = { c.x, c.y, c.z };
+    simd::float3 worldExtent = { 0.0f, 0.0f, 0.0f };
+    for (int axis = 0; axis < 3; ++axis) {
+        simd::float4 column = transform.columns[axis];
+        worldExtent += simd::abs(simd::float3{ column.x, column.y, column.z }) * extent[axis];
+    }
+    return { worldCenter - worldExtent, worldCenter + worldExtent };
+}
+
+BoundingBox merge_bounds(const BoundingBox& a, const BoundingBox& b) {
+    return { simd::min(a.min, b.min), simd::max(a.max, b.max) };
+}
+
+void cull_bounds_clear(CullBounds& bounds) {
+    bounds.centerX.clear();
+    bounds.centerY.clear();
+    bounds.centerZ.clear();
+    bounds.extentX.clear();
+    bounds.extentY.clear();
+    bounds.extentZ.clear();
+}
+
+void cull_bounds_reserve(CullBounds& bounds, size_t capacity) {
+    bounds.centerX.reserve(capacity);
+    bounds.centerY.reserve(capacity);
+    bounds.centerZ.reserve(capacity);
+    bounds.extentX.reserve(capacity);
+    bounds.extentY.reserve(capacity);
+    bounds.extentZ.reserve(capacity);
+}
+
+void cull_bounds_add(CullBounds& bounds, const BoundingBox& box) {
+    bounds.centerX.push_back((box.min.x + box.max.x) * 0.5f);
+    bounds.centerY.push_back((box.min.y + box.max.y) * 0.5f);
+    bounds.centerZ.push_back((box.min.z + box.max.z) * 0.5f);
+    bounds.extentX.push_back((box.max.x - box.min.x) * 0.5f);
+    bounds.extentY.push_back((box.max.y - box.min.y) * 0.5f);
+    bounds.extentZ.push_back((box.max.z - box.min.z) * 0.5f);
+}
+
+void cull_bounds_set(CullBounds& bounds, size_t index, const BoundingBox& box) {
+    bounds.centerX[index] = (box.min.x + box.max.x) * 0.5f;
+    bounds.centerY[index] = (box.min.y + box.max.y) * 0.5f;
+    bounds.centerZ[index] = (box.min.z + box.max.z) * 0.5f;
+    bounds.extentX[index] = (box.max.x - box.min.x) * 0.5f;
+    bounds.extentY[index] = (box.max.y - box.min.y) * 0.5f;
+    bounds.extentZ[index] = (box.max.z - box.min.z) * 0.5f;
+}
+
+void cull_bounds_remove_swap(CullBounds& bounds, size_t index) {
+    for (std::vector<float>* array : { &bounds.centerX, &bounds.centerY, &bounds.centerZ,
+                                       &bounds.extentX, &bounds.extentY, &bounds.extentZ }) {
+        (*array)[index] = array->back();
+        array->pop_back();
+    }
+}
+
+bool frustum_intersects(const Frustum& frustum, const BoundingBox& box) {
+    simd::float3 center = (box.min + box.max) * 0.5f;
+    simd::float3 extent = (box.max - box.min) * 0.5f;
+    for (const simd::float4& plane : frustum.planes) {
+        // Distance of the box corner furthest along the plane normal
+        float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w +
+                  fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (d < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t frustum_cull(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible) {
+    return frustum_cull_any(&frustum, 1, bounds, visible);
+}
+
+size_t frustum_cull_any(const Frustum* frustums, size_t frustumCount, const CullBounds& bounds, uint32_t* visible) {
+    const size_t n = bounds.size();
+    size_t count = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        simd::float4 cx = { bounds.centerX[i], bounds.centerX[i + 1], bounds.centerX[i + 2], bounds.centerX[i + 3] };
+        simd::float4 cy = { bounds.centerY[i], bounds.centerY[i + 1], bounds.centerY[i + 2], bounds.centerY[i + 3] };
+        simd::float4 cz = { bounds.centerZ[i], bounds.centerZ[i + 1], bounds.centerZ[i + 2], bounds.centerZ[i + 3] };
+        simd::float4 ex = { bounds.extentX[i], bounds.extentX[i + 1], bounds.extentX[i + 2], bounds.extentX[i + 3] };
+        simd::float4 ey = { bounds.extentY[i], bounds.extentY[i + 1], bounds.extentY[i + 2], bounds.extentY[i + 3] };
+        simd::float4 ez = { bounds.extentZ[i], bounds.extentZ[i + 1], bounds.extentZ[i + 2], bounds.extentZ[i + 3] };
+
+        // The nearest distance per lane over a frustum's planes is negative outside it;
+        // the best over the frustums is negative only outside all of them
+        simd::float4 best = -FLT_MAX;
+        for (size_t f = 0; f < frustumCount; ++f) {
+            simd::float4 nearest = FLT_MAX;
+            for (const simd::float4& plane : frustums[f].planes) {
+                simd::float4 d = cx * plane.x + cy * plane.y + cz * plane.z + plane.w +
+                                 ex * fabsf(plane.x) + ey * fabsf(plane.y) + ez * fabsf(plane.z);
+                nearest = simd::min(nearest, d);
+            }
+            best = simd::max(best, nearest);
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[count] = (uint32_t)(i + lane);
+            count += best[lane] >= 0.0f;
+        }
+    }
+
+    for (; i < n; ++i) {
+        BoundingBox box = { { bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i], bounds.centerZ[i] - bounds.extentZ[i] },
+                            { bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i], bounds.centerZ[i] + bounds.extentZ[i] } };
+        for (size_t f = 0; f < frustumCount; ++f) {
+            if (frustum_intersects(frustums[f], box)) {
+                visible[count++] = (uint32_t)i;
+                break;
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file frustum.hpp
+ * @brief View frustum extraction and batched bounding box culling.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "objects.hpp"
+
+/**
+ * @struct Frustum
+ * @brief Six inward-facing planes (xyz = normal, w = distance); a point p is inside plane i when dot(xyz, p) + w >= 0.
+ */
+struct Frustum {
+    simd::float4 planes[6]; ///< Left, right, bottom, top, near, far.
+};
+
+/**
+ * @struct CullBounds
+ * @brief Bounding boxes stored as separate center and extent arrays for 4-wide plane tests.
+ */
+struct CullBounds {
+    std::vector<float> centerX, centerY, centerZ;   ///< Box centers.
+    std::vector<float> extentX, extentY, extentZ;   ///< Box half sizes.
+
+    /// @return The number of boxes.
+    size_t size() const { return centerX.size(); }
+};
+
+/**
+ * @brief Extracts the frustum planes of a view-projection matrix with Metal's [0, 1] clip depth.
+ * @param viewProjection projectionMatrix * viewMatrix.
+ * @return The normalized frustum planes.
+ */
+Frustum extract_frustum(const simd::float4x4& viewProjection);
+
+/**
+ * @brief Transforms a box and returns the axis-aligned box around the result.
+ * @param box The box in model space.
+ * @param transform The model matrix.
+ * @return The box in world space.
+ */
+BoundingBox transform_bounds(const BoundingBox& box, const simd::float4x4& transform);
+
+/// @return The smallest box containing both boxes.
+BoundingBox merge_bounds(const BoundingBox& a, const BoundingBox& b);
+
+/// Removes every box.
+void cull_bounds_clear(CullBounds& bounds);
+
+/// Reserves room for a number of boxes so adding up to it does not reallocate.
+void cull_bounds_reserve(CullBounds& bounds, size_t capacity);
+
+/// Appends a box; its position in the arrays is the index frustum_cull reports.
+void cull_bounds_add(CullBounds& bounds, const BoundingBox& box);
+
+/// Replaces the box at an index.
+void cull_bounds_set(CullBounds& bounds, size_t index, const BoundingBox& box);
+
+/// Removes the box at an index by moving the last box into its place.
+void cull_bounds_remove_swap(CullBounds& bounds, size_t index);
+
+/**
+ * @brief Tests one box against the frustum.
+ * @param frustum The frustum.
+ * @param box The world space box.
+ * @return False only if the box is entirely outside one of the planes.
+ */
+bool frustum_intersects(const Frustum& frustum, const BoundingBox& box);
+
+/**
+ * @brief Tests every box against the frustum, four at a time.
+ * @param frustum The frustum.
+ * @param bounds The world space boxes.
+ * @param visible Receives the indices of the boxes that may be visible, in order; needs bounds.size() slots.
+ * @return The number of indices written.
+ */
+size_t frustum_cull(const Frustum& frustum, const CullBounds& bounds, uint32_t* visible);
+
+/**
+ * @brief Tests every box against several frustums, keeping the boxes inside any of them.
+ * @param frustums The frustums, e.g. the views of a multi-view pass.
+ * @param frustumCount The number of frustums.
+ * @param bounds The world space boxes.
+ * @param visible Receives the indices of the boxes that may be visible in any frustum, in order; needs bounds.size() slots.
+ * @return The number of indices written.
+ */
+size_t frustum_cull_any(const Frustum* frustums, size_t frustumCount, const CullBounds& bounds, uint32_t* visible);
@@ -0,0 +1,85 @@
+/**
+ * @file geometry_pool.hpp
+ * @brief Sub-allocates the vertices and indices of static meshes from a few large shared buffers.
+ *
+ * A block is one private vertex buffer and one private index buffer, each managed by a
+ * RangeAllocator. A mesh takes a range of each from the first block with room, adding a
+ * block when none has, and is drawn with its base vertex and index offset, so meshes in a
+ * block never rebind the vertex buffer between draws. Indices are allocated in 4 byte units,
+ * which keeps every offset valid for Metal and lets 16 and 32 bit meshes share a buffer.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "objects.hpp"
+#include "range_allocator.hpp"
+#include "resource_uploader.hpp"
+
+/// Vertices of a block; a larger mesh gets a block of its own size.
+constexpr uint32_t GEOMETRY_BLOCK_VERTICES = 1u << 18;
+/// Index bytes of a block; a larger mesh gets a block of its own size.
+constexpr uint32_t GEOMETRY_BLOCK_INDEX_BYTES = 8u << 20;
+
+/**
+ * @struct GeometryAllocation
+ * @brief The ranges one mesh holds in a GeometryPool block.
+ */
+struct GeometryAllocation {
+    uint32_t block = NO_RANGE;      ///< Index of the block; NO_RANGE if nothing is allocated.
+    uint32_t baseVertex = 0;        ///< First vertex in the block's vertex buffer.
+    uint32_t vertexCount = 0;       ///< Vertices allocated.
+    uint32_t indexOffset = 0;       ///< Byte offset of the first index in the block's index buffer.
+    uint32_t indexBytes = 0;        ///< Index bytes allocated, rounded up to 4.
+};
+
+/**
+ * @class GeometryPool
+ * @brief The blocks, created on demand with the uploader's device.
+ */
+class GeometryPool {
+public:
+    /**
+     * @brief Allocates ranges for a mesh and schedules the upload of its vertices and indices.
+     *
+     * Follows the rules of ResourceUploader::update(): flush the uploader before drawing.
+     *
+     * @param uploader Uploads into the blocks and provides the device for new ones.
+     * @param vertices The vertices.
+     * @param vertexCount The number of vertices.
+     * @param indices The raw indices, counted from the mesh's own first vertex.
+     * @param indexBytes The size of indices in bytes.
+     * @return The ranges; block is NO_RANGE if a new block could not be created.
+     */
+    GeometryAllocation allocate(ResourceUploader& uploader, const Vertex* vertices, uint32_t vertexCount,
+                                const void* indices, size_t indexBytes);
+
+    /// @brief Frees a mesh's ranges; the GPU must be done drawing it.
+    void release(const GeometryAllocation& allocation);
+
+    /// @return The vertex buffer of a block.
+    id<MTLBuffer> vertex_buffer(uint32_t block) const { return m_blocks[block].vertices; }
+
+    /// @return The index buffer of a block.
+    id<MTLBuffer> index_buffer(uint32_t block) const { return m_blocks[block].indices; }
+
+    /// @return Number of blocks.
+    uint32_t block_count() const { return (uint32_t)m_blocks.size(); }
+
+    /// @return GPU bytes of every block, used or not.
+    size_t bytes() const;
+
+private:
+    struct Block {
+        id<MTLBuffer> vertices;
+        id<MTLBuffer> indices;
+        RangeAllocator vertexRanges;    ///< In vertices.
+        RangeAllocator indexRanges;     ///< In 4 byte units.
+    };
+
+    std::vector<Block> m_blocks;
+};
@@ -0,0 +1,80 @@
+#import "geometry_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+GeometryAllocation GeometryPool::allocate(ResourceUploader& uploader, const Vertex* vertices, uint32_t vertexCount,
+                                          const void* indices, size_t indexBytes) {
+    GeometryAllocation allocation;
+    const uint32_t indexUnits = (uint32_t)((indexBytes + 3) / 4);
+    uint32_t baseVertex = NO_RANGE;
+    uint32_t indexUnit = NO_RANGE;
+    for (uint32_t i = 0; i < m_blocks.size() && allocation.block == NO_RANGE; ++i) {
+        Block& block = m_blocks[i];
+        baseVertex = block.vertexRanges.allocate(vertexCount);
+        if (baseVertex == NO_RANGE) {
+            continue;
+        }
+        indexUnit = block.indexRanges.allocate(indexUnits);
+        if (indexUnit == NO_RANGE) {
+            block.vertexRanges.release(baseVertex, vertexCount);
+            continue;
+        }
+        allocation.block = i;
+    }
+
+    if (allocation.block == NO_RANGE) {
+        id<MTLDevice> device = uploader.device();
+        Block block;
+        const uint32_t blockVertices = std::max(vertexCount, GEOMETRY_BLOCK_VERTICES);
+        const uint32_t blockUnits = std::max(indexUnits, GEOMETRY_BLOCK_INDEX_BYTES / 4);
+        block.vertices = [device newBufferWithLength:(size_t)blockVertices * sizeof(Vertex)
+                                             options:MTLResourceStorageModePrivate];
+        block.indices = [device newBufferWithLength:(size_t)blockUnits * 4 options:MTLResourceStorageModePrivate];
+        if (!block.vertices || !block.indices) {
+            return allocation;
+        }
+        block.vertices.label = @"Geometry pool vertices";
+        block.indices.label = @"Geometry pool indices";
+        block.vertexRanges = RangeAllocator(blockVertices);
+        block.indexRanges = RangeAllocator(blockUnits);
+        baseVertex = block.vertexRanges.allocate(vertexCount);
+        indexUnit = block.indexRanges.allocate(indexUnits);
+        allocation.block = (uint32_t)m_blocks.size();
+        m_blocks.push_back(std::move(block));
+    }
+
+    allocation.baseVertex = baseVertex;
+    allocation.vertexCount = vertexCount;
+    allocation.indexOffset = indexUnit * 4;
+    allocation.indexBytes = indexUnits * 4;
+    const Block& block = m_blocks[allocation.block];
+    uploader.update(block.vertices, (size_t)baseVertex * sizeof(Vertex), vertices,
+                    (size_t)vertexCount * sizeof(Vertex));
+    if (indexBytes == allocation.indexBytes) {
+        uploader.update(block.indices, allocation.indexOffset, indices, indexBytes);
+    } else {
+        // Blits copy whole words, so an odd number of 16 bit indices gets a padding index
+        std::vector<uint8_t> padded(allocation.indexBytes, 0);
+        memcpy(padded.data(), indices, indexBytes);
+        uploader.update(block.indices, allocation.indexOffset, padded.data(), padded.size());
+    }
+    return allocation;
+}
+
+void GeometryPool::release(const GeometryAllocation& allocation) {
+    if (allocation.block == NO_RANGE) {
+        return;
+    }
+    Block& block = m_blocks[allocation.block];
+    block.vertexRanges.release(allocation.baseVertex, allocation.vertexCount);
+    block.indexRanges.release(allocation.indexOffset / 4, allocation.indexBytes / 4);
+}
+
+size_t GeometryPool::bytes() const {
+    size_t bytes = 0;
+    for (const Block& block : m_blocks) {
+        bytes += block.vertices.allocatedSize + block.indices.allocatedSize;
+    }
+    return bytes;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file gpu_ambient_occlusion.hpp
+ * @brief The ambient occlusion passes of ambient_occlusion.hpp: a half-resolution kernel and an upsample.
+ *
+ * After the scene pass, gpu_ambient_occlusion_add_passes() adds two passes to the frame's render
+ * graph: a dispatch of ambient_occlusion over a half-resolution RG16Float transient, one thread
+ * per pixel reading the stored scene depth, then a render pass that loads the scene colour and
+ * draws one full-screen triangle upsampling the occlusion into it through programmable blending.
+ * The transient only lives between the two, so the graph lends its memory to other transients
+ * for the rest of the frame. The scene pass must store its depth while occlusion is on. Both
+ * passes are timed as GPU_PASS_AMBIENT_OCCLUSION.
+ *
+ * Given the acceleration structures of gpu_ray_tracing.hpp, the kernel is ray_traced_ambient_occlusion
+ * instead, which traces short rays over each pixel's hemisphere rather than searching the depth,
+ * so geometry off screen or hidden behind a silhouette occludes too.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ambient_occlusion.hpp"
+#include "camera.hpp"
+#include "frame_stats.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_ray_tracing.hpp"
+#include "gpu_render_graph.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct GpuAmbientOcclusion
+ * @brief The two pipelines and their settings.
+ */
+struct GpuAmbientOcclusion {
+    id<MTLComputePipelineState> pipeline;       ///< ambient_occlusion.
+    id<MTLRenderPipelineState> applyPipeline;   ///< composite_vertex / ambient_occlusion_apply_fragment.
+    id<MTLComputePipelineState> tracedPipeline; ///< ray_traced_ambient_occlusion; nil without ray tracing.
+    AmbientOcclusionSettings settings;          ///< Radius and intensity.
+};
+
+/// @return True if the device has programmable blending and both pipelines compiled.
+bool gpu_ambient_occlusion_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the occlusion passes; their target is a render graph transient.
+ * @param metal The Metal context; its ambient occlusion pipelines must exist.
+ * @return The passes.
+ */
+GpuAmbientOcclusion create_gpu_ambient_occlusion(const MetalContext& metal);
+
+/**
+ * @brief Occludes the ambient light of a finished scene.
+ *
+ * Must be encoded after the scene pass, drawn with ShaderVariant::ambientOcclusion pipelines,
+ * and before anything that writes the scene colour's alpha, e.g. the transparent pass.
+ *
+ * @param ao The occlusion passes.
+ * @param rg The frame's render graph.
+ * @param color The imported single-sample scene colour, darkened in place.
+ * @param depth The imported, stored scene depth.
+ * @param cam The camera of the scene pass, with the projection it rendered with.
+ * @param profiler Times both passes as GPU_PASS_AMBIENT_OCCLUSION; may be null.
+ * @param frameStats Receives the upsample's draw; must outlive the graph's execution.
+ * @param rayTracing Ready acceleration structures to trace the occlusion against, if ao has the
+ *        traced pipeline; null to search the depth. Must outlive the graph's execution.
+ */
+void gpu_ambient_occlusion_add_passes(const GpuAmbientOcclusion& ao, GpuRenderGraph& rg, uint32_t color,
+                                      uint32_t depth, const Camera& cam, GpuProfiler* profiler,
+                                      FrameStats& frameStats, const GpuRayTracing* rayTracing = nullptr);
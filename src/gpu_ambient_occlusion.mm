@@ -0,0 +1,85 @@
+#import "gpu_ambient_occlusion.hpp"
+
+#include "deferred.hpp"
+#include "trace.hpp"
+
+bool gpu_ambient_occlusion_supported(const MetalContext& metal) {
+    return deferred_supported(metal.device) && metal.ambient_occlusion_pipeline &&
+           metal.ambient_occlusion_apply_pipeline;
+}
+
+GpuAmbientOcclusion create_gpu_ambient_occlusion(const MetalContext& metal) {
+    GpuAmbientOcclusion ao;
+    ao.pipeline = metal.ambient_occlusion_pipeline;
+    ao.applyPipeline = metal.ambient_occlusion_apply_pipeline;
+    ao.tracedPipeline = metal.ray_traced_occlusion_pipeline;
+    return ao;
+}
+
+void gpu_ambient_occlusion_add_passes(const GpuAmbientOcclusion& ao, GpuRenderGraph& rg, uint32_t color,
+                                      uint32_t depth, const Camera& cam, GpuProfiler* profiler,
+                                      FrameStats& frameStats, const GpuRayTracing* rayTracing) {
+    const uint32_t width = (uint32_t)gpu_render_graph_resolve(rg, color).width;
+    const uint32_t height = (uint32_t)gpu_render_graph_resolve(rg, color).height;
+    const AmbientOcclusionUniforms uniforms =
+        ambient_occlusion_uniforms(cam.projectionMatrix, width, height, camera_clear_depth(cam), ao.settings);
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRG16Float
+                                                                                    width:(width + 1) / 2
+                                                                                   height:(height + 1) / 2
+                                                                                mipmapped:NO];
+    desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+    const uint32_t occlusion = gpu_render_graph_texture(rg, desc, "Ambient occlusion");
+    const GpuRenderGraph* graph = &rg;
+    FrameStats* stats = &frameStats;
+    const GpuRayTracing* traced = rayTracing && ao.tracedPipeline ? rayTracing : nullptr;
+    id<MTLComputePipelineState> pipeline = traced ? ao.tracedPipeline : ao.pipeline;
+    const simd::float4x4 viewToWorld = simd_inverse(cam.viewMatrix);
+    id<MTLRenderPipelineState> applyPipeline = ao.applyPipeline;
+
+    gpu_render_graph_compute_pass(
+        rg, "Ambient occlusion",
+        ^(MTLComputePassDescriptor* passDesc) {
+            gpu_profiler_sample_compute_pass(profiler, passDesc, GPU_PASS_AMBIENT_OCCLUSION);
+        },
+        ^(id<MTLComputeCommandEncoder> enc) {
+            id<MTLTexture> target = gpu_render_graph_resolve(*graph, occlusion);
+            TRACE_PUSH_GROUP(enc, "Ambient occlusion");
+            [enc setComputePipelineState:pipeline];
+            [enc setTexture:gpu_render_graph_resolve(*graph, depth) atIndex:0];
+            [enc setTexture:target atIndex:1];
+            [enc setBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+            if (traced) {
+                [enc setBytes:&viewToWorld length:sizeof(viewToWorld) atIndex:1];
+                gpu_ray_tracing_bind(*traced, enc, 2);
+            }
+            [enc dispatchThreads:MTLSizeMake(target.width, target.height, 1)
+                threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+            TRACE_POP_GROUP(enc);
+        });
+    render_graph_read(rg.graph, depth);
+    render_graph_write(rg.graph, occlusion);
+
+    // Loads and stores the colour once; the depth is only read as a texture
+    gpu_render_graph_render_pass(
+        rg, "Ambient occlusion upsample",
+        ^(MTLRenderPassDescriptor* passDesc) {
+            passDesc.colorAttachments[0].texture = gpu_render_graph_resolve(*graph, color);
+            passDesc.colorAttachments[0].loadAction = MTLLoadActionLoad;
+            passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+            gpu_profiler_sample_pass(profiler, passDesc, GPU_PASS_AMBIENT_OCCLUSION);
+        },
+        ^(id<MTLRenderCommandEncoder> enc) {
+            TRACE_PUSH_GROUP(enc, "Ambient occlusion upsample");
+            [enc setRenderPipelineState:applyPipeline];
+            [enc setFragmentTexture:gpu_render_graph_resolve(*graph, depth) atIndex:0];
+            [enc setFragmentTexture:gpu_render_graph_resolve(*graph, occlusion) atIndex:1];
+            [enc setFragmentBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+            [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+            TRACE_POP_GROUP(enc);
+            frame_stats_count_draw(*stats, 3);
+        });
+    render_graph_read(rg.graph, depth);
+    render_graph_read(rg.graph, occlusion);
+    render_graph_read(rg.graph, color);
+    render_graph_write(rg.graph, color);
+}
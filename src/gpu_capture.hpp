@@ -0,0 +1,30 @@
+/**
+ * @file gpu_capture.hpp
+ * @brief Programmatic Metal captures of whole frames into .gputrace documents, for the hitch detector.
+ *
+ * A capture records every command buffer the device's queues commit between
+ * gpu_capture_begin() and gpu_capture_end(), with their resources, into a document Xcode
+ * opens for replay. Capturing into a document needs MTL_CAPTURE_ENABLED=1 in the
+ * environment, or MetalCaptureEnabled in the app's Info.plist; without it
+ * gpu_capture_supported() is false and nothing is captured.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <string>
+
+/// @return True if captures can be written to .gputrace documents in this process.
+bool gpu_capture_supported();
+
+/**
+ * @brief Starts capturing everything the device's queues commit.
+ * @param device The device to capture.
+ * @param path The .gputrace document to write; must not exist yet.
+ * @param error Receives why capturing did not start.
+ * @return False if capturing did not start, e.g. because another capture is running.
+ */
+bool gpu_capture_begin(id<MTLDevice> device, const std::string& path, std::string& error);
+
+/// @brief Stops the running capture and writes its document; does nothing if none is running.
+void gpu_capture_end();
@@ -0,0 +1,30 @@
+#import "gpu_capture.hpp"
+
+bool gpu_capture_supported() {
+    return [[MTLCaptureManager sharedCaptureManager] supportsDestination:MTLCaptureDestinationGPUTraceDocument];
+}
+
+bool gpu_capture_begin(id<MTLDevice> device, const std::string& path, std::string& error) {
+    MTLCaptureManager* manager = [MTLCaptureManager sharedCaptureManager];
+    if (manager.isCapturing) {
+        error = "a capture is already running";
+        return false;
+    }
+    MTLCaptureDescriptor* descriptor = [[MTLCaptureDescriptor alloc] init];
+    descriptor.captureObject = device;
+    descriptor.destination = MTLCaptureDestinationGPUTraceDocument;
+    descriptor.outputURL = [NSURL fileURLWithPath:[NSString stringWithUTF8String:path.c_str()]];
+    NSError* nsError = nil;
+    if (![manager startCaptureWithDescriptor:descriptor error:&nsError]) {
+        error = nsError ? nsError.localizedDescription.UTF8String : "capture did not start";
+        return false;
+    }
+    return true;
+}
+
+void gpu_capture_end() {
+    MTLCaptureManager* manager = [MTLCaptureManager sharedCaptureManager];
+    if (manager.isCapturing) {
+        [manager stopCapture];
+    }
+}
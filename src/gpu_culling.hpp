@@ -0,0 +1,113 @@
+/**
+ * @file gpu_culling.hpp
+ * @brief GPU-driven terrain chunk culling into indirect command buffers.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <vector>
+
+#include "camera.hpp"
+#include "chunk_manager.hpp"
+#include "frame_arena.hpp"
+#include "frame_ring.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct GpuCulling
+ * @brief Indirect command buffers and the Hi-Z pyramid used to cull chunks on the GPU.
+ *
+ * Each frame the CPU writes one small record per resident chunk; cull_terrain_chunks
+ * tests it against the frustum and against the depth pyramid of the previous frame
+ * and encodes the surviving draws into that frame's MTLIndirectCommandBuffer, which
+ * the render encoder then executes with a single call.
+ */
+struct GpuCulling {
+    id<MTLComputePipelineState> cullPipeline;           ///< cull_terrain_chunks.
+    id<MTLComputePipelineState> hizCopyPipeline;        ///< hiz_copy_depth.
+    id<MTLComputePipelineState> hizReducePipeline;      ///< hiz_reduce.
+    std::vector<id<MTLIndirectCommandBuffer>> commands; ///< One per in-flight frame.
+    std::vector<id<MTLBuffer>> commandArguments;        ///< Argument buffers holding each entry of commands.
+    id<MTLTexture> hiz;                                 ///< Farthest-depth pyramid of the previous frame.
+    std::vector<id<MTLTexture>> hizLevels;              ///< Single-level views of hiz.
+    uint32_t maxDraws = 0;                              ///< Capacity of each command buffer.
+    uint32_t drawCount = 0;                             ///< Chunks submitted by the last gpu_culling_encode.
+    uint32_t vertexLitStart = 0;                        ///< First of the draws for ResidentChunk::vertexLit chunks.
+    uint32_t slot = 0;                                  ///< Command buffer used by the current frame.
+    simd::float4x4 previousViewProjection;              ///< Matrix hiz was rendered with.
+    bool reverseZ = false;                              ///< hiz holds reverse-Z depth, so farther is smaller.
+    bool hasHistory = false;                            ///< False until hiz holds a rendered frame.
+    bool resident = false;  ///< The chunks, LOD indices and frame ring are in a GpuResidency; draws declare none.
+};
+
+/// @return True if the device can encode draws from compute through indirect command buffers.
+bool gpu_culling_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the culling resources.
+ * @param metal The Metal context; its cull and Hi-Z pipelines must exist.
+ * @param maxDraws The most chunks drawn in one frame.
+ * @param width The depth buffer width.
+ * @param height The depth buffer height.
+ * @param framesInFlight The number of frames the CPU may run ahead of the GPU.
+ * @return The culling state.
+ */
+GpuCulling create_gpu_culling(const MetalContext& metal, uint32_t maxDraws, uint32_t width, uint32_t height,
+                              uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+/**
+ * @brief Reallocates the Hi-Z pyramid for a new depth buffer size and drops the occlusion history.
+ * @param culling The culling state.
+ * @param metal The Metal context.
+ * @param width The new depth buffer width.
+ * @param height The new depth buffer height.
+ */
+void gpu_culling_resize(GpuCulling& culling, const MetalContext& metal, uint32_t width, uint32_t height);
+
+/// @return Frame ring bytes gpu_culling_encode needs per frame for maxDraws chunks, on top of their uniforms.
+size_t gpu_culling_frame_bytes(uint32_t maxDraws);
+
+/**
+ * @brief Writes the per-chunk records and dispatches the culling kernel.
+ *
+ * Must be encoded before the render pass that calls gpu_culling_draw.
+ *
+ * @param culling The culling state.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks and their LOD index ranges.
+ * @param uniformRing The frame ring that receives the records and the chunks' uniforms.
+ * @param cam The camera of this frame.
+ * @param frameUniforms The FrameUniforms the scene pass is drawn with, bound by every encoded draw.
+ * @param fogDistance Chunks entirely farther from the camera are hidden by fog and not drawn; see fog_cull_distance().
+ * @param shadowUniforms This frame's shadow_map_encode uniforms, bound for the chunks' fragments; null without shadows.
+ * @param skip Per resident chunk, nonzero for chunks drawn by another path this frame; null to draw all.
+ * @param materialUniforms TerrainMaterialUniforms bound for the chunks' fragments; nil without baked materials.
+ */
+void gpu_culling_encode(GpuCulling& culling, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                        FrameRing& uniformRing, const Camera& cam, const FrameAllocation& frameUniforms,
+                        float fogDistance, const FrameAllocation* shadowUniforms = nullptr,
+                        const uint8_t* skip = nullptr, id<MTLBuffer> materialUniforms = nil);
+
+/**
+ * @brief Executes the draws the culling kernel encoded.
+ * @param culling The culling state.
+ * @param enc The render encoder, with the chunks' pipeline already set.
+ * @param chunkManager The chunk manager passed to gpu_culling_encode.
+ * @param uniformRing The frame ring passed to gpu_culling_encode.
+ * @param arena The calling thread's frame arena, for the list of resources the draws read unless resident.
+ * @param vertexLitPipeline Set for the draws of ResidentChunk::vertexLit chunks; nil draws them like the rest.
+ */
+void gpu_culling_draw(const GpuCulling& culling, id<MTLRenderCommandEncoder> enc,
+                      const ChunkManager& chunkManager, const FrameRing& uniformRing, FrameArena& arena,
+                      id<MTLRenderPipelineState> vertexLitPipeline = nil);
+
+/**
+ * @brief Rebuilds the Hi-Z pyramid from this frame's depth for the next frame's occlusion test.
+ * @param culling The culling state.
+ * @param cmd The frame's command buffer, after the render pass.
+ * @param depth The depth texture the frame rendered into; must be stored and shader-readable.
+ * @param cam The camera of this frame.
+ */
+void gpu_culling_update_hiz(GpuCulling& culling, id<MTLCommandBuffer> cmd, id<MTLTexture> depth, const Camera& cam);
@@ -0,0 +1,239 @@
+#import "gpu_culling.hpp"
+
+#include <algorithm>
+
+#include "fog.hpp"
+#include "frustum.hpp"
+#include "terrain_material.hpp"
+
+namespace {
+    // Matches ChunkDrawArgs in shaders.metal
+    struct ChunkDrawArgs {
+        simd::float4 boundsMin;
+        simd::float4 boundsMax;
+        uint64_t vertices;
+        uint32_t indexStart;
+        uint32_t indexCount;
+    };
+
+    // Matches CullParams in shaders.metal
+    struct CullParams {
+        simd::float4 planes[6];
+        simd::float4x4 previousViewProjection;
+        simd::float2 hizSize;
+        uint32_t chunkCount;
+        uint32_t hizLevels;
+        uint32_t index16;
+        uint32_t reverseZ;
+        uint64_t draws;
+        uint64_t frame;
+        uint64_t shadow;
+        uint64_t materials;
+    };
+
+    MTLSize threadgroups_for(NSUInteger width, NSUInteger height, NSUInteger groupSize) {
+        return MTLSizeMake((width + groupSize - 1) / groupSize, (height + groupSize - 1) / groupSize, 1);
+    }
+}
+
+bool gpu_culling_supported(const MetalContext& metal) {
+    // Compute-encoded draws with GPU addresses in argument buffers need Metal 3
+    return metal.cull_chunks_pipeline && metal.hiz_copy_pipeline && metal.hiz_reduce_pipeline &&
+           [metal.device supportsFamily:MTLGPUFamilyMetal3];
+}
+
+GpuCulling create_gpu_culling(const MetalContext& metal, uint32_t maxDraws, uint32_t width, uint32_t height,
+                              uint32_t framesInFlight) {
+    GpuCulling culling;
+    culling.cullPipeline = metal.cull_chunks_pipeline;
+    culling.hizCopyPipeline = metal.hiz_copy_pipeline;
+    culling.hizReducePipeline = metal.hiz_reduce_pipeline;
+    culling.maxDraws = maxDraws;
+    culling.slot = framesInFlight - 1;
+
+    MTLIndirectCommandBufferDescriptor* icbDesc = [MTLIndirectCommandBufferDescriptor new];
+    icbDesc.commandTypes = MTLIndirectCommandTypeDrawIndexed;
+    icbDesc.inheritPipelineState = YES;
+    icbDesc.inheritBuffers = NO;
+    icbDesc.maxVertexBufferBindCount = FRAME_UNIFORMS_BUFFER_INDEX + 1;
+    // ShadowUniforms at 3, FrameUniforms at 5, TerrainMaterialUniforms at 8
+    icbDesc.maxFragmentBufferBindCount = TERRAIN_MATERIAL_BUFFER_INDEX + 1;
+
+    id<MTLFunction> cullFn = [metal.library newFunctionWithName:@"cull_terrain_chunks"];
+    id<MTLArgumentEncoder> argumentEncoder = [cullFn newArgumentEncoderWithBufferIndex:2];
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        id<MTLIndirectCommandBuffer> icb = [metal.device newIndirectCommandBufferWithDescriptor:icbDesc
+                                                                                maxCommandCount:std::max(maxDraws, 1u)
+                                                                                        options:MTLResourceStorageModePrivate];
+        icb.label = [NSString stringWithFormat:@"Chunk draws %u", i];
+
+        id<MTLBuffer> arguments = [metal.device newBufferWithLength:argumentEncoder.encodedLength
+                                                            options:MTLResourceStorageModeShared];
+        [argumentEncoder setArgumentBuffer:arguments offset:0];
+        [argumentEncoder setIndirectCommandBuffer:icb atIndex:0];
+
+        culling.commands.push_back(icb);
+        culling.commandArguments.push_back(arguments);
+    }
+
+    gpu_culling_resize(culling, metal, width, height);
+    return culling;
+}
+
+void gpu_culling_resize(GpuCulling& culling, const MetalContext& metal, uint32_t width, uint32_t height) {
+    // In-flight frames keep the old pyramid alive through their command buffers
+    culling.hizLevels.clear();
+    culling.hasHistory = false;
+
+    MTLTextureDescriptor* hizDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR32Float
+                                                                                       width:width
+                                                                                      height:height
+                                                                                   mipmapped:YES];
+    hizDesc.storageMode = MTLStorageModePrivate;
+    hizDesc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite | MTLTextureUsagePixelFormatView;
+    culling.hiz = [metal.device newTextureWithDescriptor:hizDesc];
+    culling.hiz.label = @"Hi-Z";
+    for (NSUInteger level = 0; level < culling.hiz.mipmapLevelCount; ++level) {
+        culling.hizLevels.push_back([culling.hiz newTextureViewWithPixelFormat:MTLPixelFormatR32Float
+                                                                   textureType:MTLTextureType2D
+                                                                        levels:NSMakeRange(level, 1)
+                                                                        slices:NSMakeRange(0, 1)]);
+    }
+}
+
+size_t gpu_culling_frame_bytes(uint32_t maxDraws) {
+    return ((maxDraws * sizeof(ChunkDrawArgs) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1)) +
+           ((sizeof(CullParams) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1));
+}
+
+void gpu_culling_encode(GpuCulling& culling, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                        FrameRing& uniformRing, const Camera& cam, const FrameAllocation& frameUniforms,
+                        float fogDistance, const FrameAllocation* shadowUniforms, const uint8_t* skip,
+                        id<MTLBuffer> materialUniforms) {
+    const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+    const uint32_t count = (uint32_t)std::min<size_t>(chunks.size(), culling.maxDraws);
+    culling.slot = (culling.slot + 1) % culling.commands.size();
+    culling.drawCount = count;
+    culling.vertexLitStart = count;
+    if (count == 0) {
+        return;
+    }
+
+    // Draw i reads entry i of one uniform array, so every encoded draw binds the same buffer
+    FrameAllocation records = frame_ring_allocate(uniformRing, count * sizeof(ChunkDrawArgs));
+    FrameAllocation draws = frame_ring_allocate(uniformRing, count * sizeof(Uniforms));
+    ChunkDrawArgs* args = (ChunkDrawArgs*)records.contents;
+    Uniforms* uniforms = (Uniforms*)draws.contents;
+    // Chunks lit per vertex go last, so gpu_culling_draw can switch pipelines once between two ranges
+    uint32_t draw = 0;
+    for (const bool vertexLit : { false, true }) {
+        if (vertexLit) {
+            culling.vertexLitStart = draw;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            const ResidentChunk& chunk = chunks[i];
+            if (chunk.vertexLit != vertexLit) {
+                continue;
+            }
+            const IndexRange& range = chunkManager.index_range(chunk);
+
+            uniforms[draw].modelMatrix = chunk.modelMatrix;
+            uniforms[draw].normalMatrix = matrix_normal(chunk.modelMatrix);
+
+            args[draw].boundsMin = { chunk.bounds.min.x, chunk.bounds.min.y, chunk.bounds.min.z, 0.0f };
+            args[draw].boundsMax = { chunk.bounds.max.x, chunk.bounds.max.y, chunk.bounds.max.z, 0.0f };
+            args[draw].vertices = chunk.mesh.vertexBuffer.gpuAddress;
+            args[draw].indexStart = range.offset;
+            // An empty draw is reset by the kernel; fully fogged chunks are dropped here
+            const bool fogged = box_distance(chunk.bounds, cam.position) > fogDistance;
+            args[draw].indexCount = (skip && skip[i]) || fogged ? 0 : range.count;
+            ++draw;
+        }
+    }
+
+    FrameAllocation paramsSlot = frame_ring_allocate(uniformRing, sizeof(CullParams));
+    CullParams* params = (CullParams*)paramsSlot.contents;
+    Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+    std::copy(frustum.planes, frustum.planes + 6, params->planes);
+    params->previousViewProjection = culling.previousViewProjection;
+    params->hizSize = { (float)culling.hiz.width, (float)culling.hiz.height };
+    params->chunkCount = count;
+    params->hizLevels = culling.hasHistory ? (uint32_t)culling.hizLevels.size() : 0;
+    params->index16 = chunkManager.lod_index_type() == MTLIndexTypeUInt16;
+    params->reverseZ = culling.reverseZ;
+    params->draws = draws.buffer.gpuAddress + draws.offset;
+    params->frame = frameUniforms.buffer.gpuAddress + frameUniforms.offset;
+    params->shadow = shadowUniforms ? shadowUniforms->buffer.gpuAddress + shadowUniforms->offset : 0;
+    params->materials = materialUniforms ? materialUniforms.gpuAddress : 0;
+
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Cull terrain chunks";
+    [enc setComputePipelineState:culling.cullPipeline];
+    [enc setBuffer:paramsSlot.buffer offset:paramsSlot.offset atIndex:0];
+    [enc setBuffer:records.buffer offset:records.offset atIndex:1];
+    [enc setBuffer:culling.commandArguments[culling.slot] offset:0 atIndex:2];
+    [enc setBuffer:chunkManager.lod_index_buffer() offset:0 atIndex:3];
+    [enc setTexture:culling.hiz atIndex:0];
+    [enc useResource:culling.commands[culling.slot] usage:MTLResourceUsageWrite];
+    NSUInteger group = std::min<NSUInteger>(culling.cullPipeline.maxTotalThreadsPerThreadgroup, 64);
+    [enc dispatchThreads:MTLSizeMake(count, 1, 1) threadsPerThreadgroup:MTLSizeMake(group, 1, 1)];
+    [enc endEncoding];
+}
+
+void gpu_culling_draw(const GpuCulling& culling, id<MTLRenderCommandEncoder> enc,
+                      const ChunkManager& chunkManager, const FrameRing& uniformRing, FrameArena& arena,
+                      id<MTLRenderPipelineState> vertexLitPipeline) {
+    if (culling.drawCount == 0) {
+        return;
+    }
+
+    // The encoded draws reach these buffers only through GPU addresses, unless a residency set holds them
+    if (!culling.resident) {
+        ArenaVector<id<MTLResource>> resources{ ArenaAllocator<id<MTLResource>>(arena) };
+        resources.reserve(culling.drawCount + 2);
+        const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+        for (uint32_t i = 0; i < culling.drawCount; ++i) {
+            resources.push_back(chunks[i].mesh.vertexBuffer);
+        }
+        resources.push_back(chunkManager.lod_index_buffer());
+        resources.push_back(uniformRing.buffers[uniformRing.frameIndex]);
+        [enc useResources:resources.data() count:resources.size() usage:MTLResourceUsageRead
+                   stages:MTLRenderStageVertex | MTLRenderStageFragment];
+    }
+
+    if (!vertexLitPipeline || culling.vertexLitStart == culling.drawCount) {
+        [enc executeCommandsInBuffer:culling.commands[culling.slot] withRange:NSMakeRange(0, culling.drawCount)];
+        return;
+    }
+    [enc executeCommandsInBuffer:culling.commands[culling.slot] withRange:NSMakeRange(0, culling.vertexLitStart)];
+    [enc setRenderPipelineState:vertexLitPipeline];
+    [enc executeCommandsInBuffer:culling.commands[culling.slot]
+                       withRange:NSMakeRange(culling.vertexLitStart, culling.drawCount - culling.vertexLitStart)];
+}
+
+void gpu_culling_update_hiz(GpuCulling& culling, id<MTLCommandBuffer> cmd, id<MTLTexture> depth, const Camera& cam) {
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Build Hi-Z";
+
+    [enc setComputePipelineState:culling.hizCopyPipeline];
+    [enc setTexture:depth atIndex:0];
+    [enc setTexture:culling.hizLevels[0] atIndex:1];
+    [enc dispatchThreadgroups:threadgroups_for(culling.hiz.width, culling.hiz.height, 8)
+        threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+
+    const uint32_t reverseZ = cam.reverseZ;
+    [enc setComputePipelineState:culling.hizReducePipeline];
+    [enc setBytes:&reverseZ length:sizeof(reverseZ) atIndex:0];
+    for (size_t level = 1; level < culling.hizLevels.size(); ++level) {
+        id<MTLTexture> dst = culling.hizLevels[level];
+        [enc setTexture:culling.hizLevels[level - 1] atIndex:0];
+        [enc setTexture:dst atIndex:1];
+        [enc dispatchThreadgroups:threadgroups_for(dst.width, dst.height, 8)
+            threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    }
+    [enc endEncoding];
+
+    culling.previousViewProjection = cam.projectionMatrix * cam.viewMatrix;
+    culling.reverseZ = cam.reverseZ;
+    culling.hasHistory = true;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file gpu_debug_draw.hpp
+ * @brief The debug shapes of debug_draw.hpp, drawn as lines over the finished frame.
+ *
+ * gpu_debug_draw_encode() copies the frame's DebugShape array into a shared buffer of its own
+ * per in-flight frame and draws every shape with one instanced line-list draw in a pass that
+ * loads the frame's output colour, without depth, so bounds hidden behind terrain still show.
+ * It draws after the upscaler with the unjittered camera, so the lines stay still. The buffers
+ * are only allocated, and grown, when shapes are drawn.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "camera.hpp"
+#include "debug_draw.hpp"
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct GpuDebugDraw
+ * @brief The line pipeline, the frame's shapes and their buffers.
+ */
+struct GpuDebugDraw {
+    id<MTLRenderPipelineState> pipeline;    ///< debug_draw_vertex / debug_draw_fragment.
+    std::vector<id<MTLBuffer>> buffers;     ///< Shapes of each in-flight frame, indexed like FrameRing::buffers.
+    uint32_t capacity = 0;                  ///< Shapes each buffer holds.
+    DebugDraw draw;                         ///< This frame's shapes.
+    DebugDrawSettings settings;             ///< The layers shown.
+};
+
+/// @return True if the line pipeline compiled.
+bool gpu_debug_draw_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the debug layer without buffers.
+ * @param metal The Metal context; its debug draw pipeline must exist.
+ * @return The layer, with every layer off.
+ */
+GpuDebugDraw create_gpu_debug_draw(const MetalContext& metal);
+
+/// @return GPU bytes held by the shape buffers.
+size_t gpu_debug_draw_bytes(const GpuDebugDraw& debug);
+
+/**
+ * @brief Draws the shapes in debug.draw over a colour target; does nothing if there are none.
+ * @param debug The debug layer.
+ * @param cmd The frame's command buffer; must be the one frame_ring_end_frame() is given.
+ * @param uniformRing The frame ring, whose current frame picks the shape buffer.
+ * @param color The frame's output colour, at the drawable's size.
+ * @param cam The unjittered camera.
+ * @param frameStats Receives the pass traffic and the draw.
+ */
+void gpu_debug_draw_encode(GpuDebugDraw& debug, id<MTLCommandBuffer> cmd, const FrameRing& uniformRing,
+                           id<MTLTexture> color, const Camera& cam, FrameStats& frameStats);
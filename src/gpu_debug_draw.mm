@@ -0,0 +1,72 @@
+#import "gpu_debug_draw.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "render_targets.hpp"
+#include "trace.hpp"
+
+namespace {
+    // Buffers start this large and double, so a steady scene stops reallocating after a few frames
+    constexpr uint32_t MIN_SHAPE_CAPACITY = 1024;
+}
+
+bool gpu_debug_draw_supported(const MetalContext& metal) {
+    return metal.debug_draw_pipeline != nil;
+}
+
+GpuDebugDraw create_gpu_debug_draw(const MetalContext& metal) {
+    GpuDebugDraw debug;
+    debug.pipeline = metal.debug_draw_pipeline;
+    return debug;
+}
+
+size_t gpu_debug_draw_bytes(const GpuDebugDraw& debug) {
+    size_t bytes = 0;
+    for (id<MTLBuffer> buffer : debug.buffers) {
+        bytes += buffer.allocatedSize;
+    }
+    return bytes;
+}
+
+void gpu_debug_draw_encode(GpuDebugDraw& debug, id<MTLCommandBuffer> cmd, const FrameRing& uniformRing,
+                           id<MTLTexture> color, const Camera& cam, FrameStats& frameStats) {
+    const uint32_t count = (uint32_t)debug.draw.shapes.size();
+    if (count == 0) {
+        return;
+    }
+    if (count > debug.capacity) {
+        // Every frame's buffer is replaced; the ones the GPU still reads stay alive with their command buffers
+        uint32_t capacity = std::max(debug.capacity, MIN_SHAPE_CAPACITY);
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        debug.buffers.assign(uniformRing.buffers.size(), nil);
+        for (id<MTLBuffer>& buffer : debug.buffers) {
+            buffer = [cmd.device newBufferWithLength:capacity * sizeof(DebugShape)
+                                             options:MTLResourceStorageModeShared];
+            buffer.label = @"Debug shapes";
+        }
+        debug.capacity = capacity;
+    }
+    id<MTLBuffer> shapes = debug.buffers[uniformRing.frameIndex];
+    memcpy(shapes.contents, debug.draw.shapes.data(), count * sizeof(DebugShape));
+    const simd::float4x4 viewProjection = cam.projectionMatrix * cam.viewMatrix;
+
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = color;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionLoad;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Debug draw"));
+
+    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+    enc.label = @"Debug draw";
+    TRACE_PUSH_GROUP(enc, "Debug shapes");
+    [enc setRenderPipelineState:debug.pipeline];
+    [enc setVertexBuffer:shapes offset:0 atIndex:0];
+    [enc setVertexBytes:&viewProjection length:sizeof(viewProjection) atIndex:1];
+    [enc drawPrimitives:MTLPrimitiveTypeLine vertexStart:0 vertexCount:DEBUG_SHAPE_VERTICES instanceCount:count];
+    TRACE_POP_GROUP(enc);
+    frame_stats_count_draw(frameStats, DEBUG_SHAPE_VERTICES, count);
+    [enc endEncoding];
+}
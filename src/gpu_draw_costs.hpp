@@ -0,0 +1,79 @@
+/**
+ * @file gpu_draw_costs.hpp
+ * @brief Times the scene's draws at draw boundaries in sampled frames and sums them into DrawCosts.
+ *
+ * Needs counter sampling at draw boundaries, which AMD and Intel GPUs offer; Apple GPUs only
+ * sample at stage boundaries, where gpu_profiler.hpp times whole passes instead. A sampled
+ * frame hands DrawTimestamps to the scene's render queues, which bracket each draw with two
+ * samples; when the frame's command buffer completes, the samples are resolved on the
+ * completion thread, and each draw's time is recorded with its tag by draw_costs_record_frame().
+ *
+ * Every function takes a nullable pointer and does nothing without one.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "draw_costs.hpp"
+#include "gpu_profiler.hpp"
+#include "render_queue.hpp"
+
+/// Frames whose samples can be in flight at once; a sampled frame finding its slot busy is skipped.
+constexpr uint32_t GPU_DRAW_COST_FRAMES = 3;
+/// Draws a frame can time; later draws are not timed.
+constexpr uint32_t GPU_DRAW_COST_MAX_DRAWS = 4096;
+
+/**
+ * @struct GpuDrawCostFrame
+ * @brief The tags of one frame's timed draws, in the order of their samples.
+ */
+struct GpuDrawCostFrame {
+    DrawTag tags[GPU_DRAW_COST_MAX_DRAWS];      ///< Tag of each timed draw.
+    uint32_t count = 0;                         ///< Draws timed.
+    double nsPerTick = 1.0;                     ///< GPU timestamp period when the frame began.
+    std::atomic<bool> pending{ false };         ///< True from a sampled begin_frame until resolved.
+};
+
+/**
+ * @struct GpuDrawCosts
+ * @brief A timestamp sample buffer shared by a ring of frames, and the costs they add up to.
+ */
+struct GpuDrawCosts {
+    GpuClock clock;                                 ///< Converts the samples' ticks to nanoseconds.
+    id<MTLCounterSampleBuffer> samples;             ///< Two samples per draw, GPU_DRAW_COST_MAX_DRAWS draws per frame.
+    std::shared_ptr<GpuDrawCostFrame[]> frames;     ///< GPU_DRAW_COST_FRAMES slots, shared with completion handlers.
+    std::shared_ptr<DrawCosts> costs;               ///< The summed results, shared with completion handlers.
+    DrawTimestamps timestamps;                      ///< Handed to the render queues of a sampled frame.
+    uint32_t slot = 0;                              ///< Slot of the frame being encoded.
+    bool active = false;                            ///< True if the frame being encoded is sampled.
+};
+
+/// @return True if the device can sample timestamps between draws.
+bool gpu_draw_costs_supported(id<MTLDevice> device);
+
+/**
+ * @brief Creates the sample buffer and an empty DrawCosts.
+ * @param device The Metal device; must be supported.
+ * @param settings How often frames are sampled and how many results are kept.
+ * @return The draw costs.
+ */
+GpuDrawCosts create_gpu_draw_costs(id<MTLDevice> device, const DrawCostSettings& settings);
+
+/**
+ * @brief Starts timing a frame's draws if the frame is sampled and its slot is free.
+ * @param costs The draw costs, or nullptr.
+ * @param frame The FrameStats frame number.
+ * @return The timestamps to hand to the frame's render queues, or nullptr if the frame is not timed.
+ */
+DrawTimestamps* gpu_draw_costs_begin_frame(GpuDrawCosts* costs, uint64_t frame);
+
+/**
+ * @brief Records the frame's draw times once its command buffer completes.
+ * @param costs The draw costs, or nullptr.
+ * @param cmd The command buffer holding the timed draws, or one committed after it on the same queue.
+ */
+void gpu_draw_costs_end_frame(GpuDrawCosts* costs, id<MTLCommandBuffer> cmd);
@@ -0,0 +1,86 @@
+#import "gpu_draw_costs.hpp"
+
+#include <vector>
+
+bool gpu_draw_costs_supported(id<MTLDevice> device) {
+    return gpu_timestamp_counter_set(device) != nil &&
+           [device supportsCounterSampling:MTLCounterSamplingPointAtDrawBoundary];
+}
+
+GpuDrawCosts create_gpu_draw_costs(id<MTLDevice> device, const DrawCostSettings& settings) {
+    GpuDrawCosts costs;
+    costs.clock.device = device;
+    costs.frames = std::shared_ptr<GpuDrawCostFrame[]>(new GpuDrawCostFrame[GPU_DRAW_COST_FRAMES]);
+    costs.costs = std::make_shared<DrawCosts>();
+    costs.costs->settings = settings;
+
+    MTLCounterSampleBufferDescriptor* desc = [MTLCounterSampleBufferDescriptor new];
+    desc.counterSet = gpu_timestamp_counter_set(device);
+    desc.storageMode = MTLStorageModeShared;
+    desc.sampleCount = GPU_DRAW_COST_FRAMES * GPU_DRAW_COST_MAX_DRAWS * 2;
+    desc.label = @"Draw timestamps";
+    NSError* error = nil;
+    costs.samples = [device newCounterSampleBufferWithDescriptor:desc error:&error];
+    if (!costs.samples) {
+        NSLog(@"Failed to create the draw timestamp sample buffer: %@", error);
+    }
+    gpu_clock_calibrate(costs.clock);
+    return costs;
+}
+
+DrawTimestamps* gpu_draw_costs_begin_frame(GpuDrawCosts* costs, uint64_t frame) {
+    if (!costs || !costs->samples || !draw_costs_sample_frame(costs->costs->settings, frame)) {
+        return nullptr;
+    }
+    const uint32_t next = (costs->slot + 1) % GPU_DRAW_COST_FRAMES;
+    GpuDrawCostFrame& slot = costs->frames[next];
+    if (slot.pending.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    costs->slot = next;
+    costs->active = true;
+    gpu_clock_calibrate(costs->clock);
+    slot.count = 0;
+    slot.nsPerTick = costs->clock.nsPerTick;
+    slot.pending.store(true, std::memory_order_relaxed);
+
+    costs->timestamps.samples = to_mtl(costs->samples);
+    costs->timestamps.first = next * GPU_DRAW_COST_MAX_DRAWS * 2;
+    costs->timestamps.capacity = GPU_DRAW_COST_MAX_DRAWS;
+    costs->timestamps.tags = slot.tags;
+    costs->timestamps.count = 0;
+    return &costs->timestamps;
+}
+
+void gpu_draw_costs_end_frame(GpuDrawCosts* costs, id<MTLCommandBuffer> cmd) {
+    if (!costs || !costs->active) {
+        return;
+    }
+    costs->active = false;
+
+    // The handler keeps the slots, sample buffer and sums alive if the draw costs go away first
+    std::shared_ptr<GpuDrawCostFrame[]> frames = costs->frames;
+    std::shared_ptr<DrawCosts> sums = costs->costs;
+    id<MTLCounterSampleBuffer> samples = costs->samples;
+    const uint32_t index = costs->slot;
+    frames[index].count = costs->timestamps.count;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+        GpuDrawCostFrame& slot = frames[index];
+        const NSRange range = NSMakeRange(index * GPU_DRAW_COST_MAX_DRAWS * 2, slot.count * 2);
+        NSData* data = slot.count > 0 ? [samples resolveCounterRange:range] : nil;
+        const MTLCounterResultTimestamp* timestamps = (const MTLCounterResultTimestamp*)data.bytes;
+        if (timestamps) {
+            std::vector<float> ms(slot.count, -1.0f);
+            for (uint32_t i = 0; i < slot.count; ++i) {
+                const uint64_t start = timestamps[i * 2].timestamp;
+                const uint64_t end = timestamps[i * 2 + 1].timestamp;
+                // Draws the GPU could not sample report an error value
+                if (start != MTLCounterErrorValue && end != MTLCounterErrorValue && end >= start) {
+                    ms[i] = (float)((end - start) * slot.nsPerTick * 1e-6);
+                }
+            }
+            draw_costs_record_frame(*sums, slot.tags, ms.data(), slot.count);
+        }
+        slot.pending.store(false, std::memory_order_release);
+    }];
+}
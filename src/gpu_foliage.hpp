@@ -0,0 +1,126 @@
+/**
+ * @file gpu_foliage.hpp
+ * @brief Trees and rocks scattered, culled and LOD-selected on the GPU.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "camera.hpp"
+#include "chunk_manager.hpp"
+#include "foliage.hpp"
+#include "frame_arena.hpp"
+#include "frame_ring.hpp"
+#include "frustum.hpp"
+#include "gpu_impostors.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct GpuFoliage
+ * @brief The foliage instance pool and the buffers the instanced draw reads.
+ *
+ * Every resident chunk owns a fixed-size slot of the pool. When a chunk becomes resident,
+ * scatter_foliage fills its slot from the FoliageSettings, with the densities scaled by the
+ * profiles of the chunk's biomes if it has any, and the slot is kept until the chunk is
+ * evicted. Each frame select_foliage culls the whole pool against the frustum, picks a level
+ * per instance by distance and appends the visible parts to one instance buffer; the draw's
+ * instance count is written on the GPU too, so the CPU never touches individual instances.
+ * With impostors on, far instances are appended to a second buffer as quads of the impostor
+ * atlas instead of boxes, drawn with its own indirect arguments.
+ */
+struct GpuFoliage {
+    id<MTLComputePipelineState> scatterPipeline;    ///< scatter_foliage.
+    id<MTLComputePipelineState> selectPipeline;     ///< select_foliage.
+    id<MTLComputePipelineState> finishPipeline;     ///< finish_foliage_draw.
+    FoliageSettings settings;                       ///< Placement and draw distances.
+    id<MTLBuffer> pool;                             ///< slotCount * capacity FoliageInstance entries.
+    id<MTLBuffer> counts;                           ///< Instances placed in each slot.
+    id<MTLBuffer> instances;                        ///< InstanceData of the visible parts, rewritten every frame.
+    id<MTLBuffer> sway;                             ///< Sway of each part in instances; see foliage_sway_params.
+    id<MTLBuffer> shadowInstances;                  ///< InstanceData of the parts casting into one shadow cascade.
+    id<MTLBuffer> impostorInstances;                ///< Impostor quads of the far instances, rewritten every frame.
+    GpuImpostors atlas;                             ///< Impostor atlas; nil textures until one is baked.
+    bool impostors = false;                         ///< Far instances as atlas quads; needs the atlas.
+    std::unordered_map<ChunkKey, uint32_t, ChunkKeyHash> slots; ///< Slot of each scattered chunk.
+    std::vector<uint32_t> freeSlots;                ///< Slots no chunk uses.
+    std::vector<uint32_t> lastSeen;                 ///< Frame each slot's chunk was last resident.
+    uint32_t frame = 0;                             ///< Frames encoded so far.
+    uint32_t capacity = 0;                          ///< Pool entries per slot: one per placement cell.
+    uint32_t slotCount = 0;                         ///< Slots in the pool.
+    uint32_t maxInstances = 0;                      ///< Capacity of instances.
+    uint32_t maxShadowInstances = 0;                ///< Capacity of shadowInstances.
+    uint32_t maxImpostors = 0;                      ///< Capacity of impostorInstances.
+    FrameAllocation draw = {};                      ///< This frame's draw arguments, written by the GPU.
+    FrameAllocation impostorDraw = {};              ///< This frame's impostor draw arguments, written by the GPU.
+    FrameAllocation shadowDraw = {};                ///< Draw arguments of the last gpu_foliage_encode_shadow.
+};
+
+/// Vertex buffer index of the part sway the foliage_wind variant reads.
+constexpr uint32_t FOLIAGE_SWAY_BUFFER_INDEX = 3;
+
+/// @return True if the foliage kernels compiled.
+bool gpu_foliage_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the foliage pool.
+ * @param metal The Metal context; its foliage pipelines must exist.
+ * @param maxChunks The most chunks resident at once.
+ * @param settings Placement and draw distances.
+ * @param maxInstances The most instanced parts drawn in one frame; a near tree takes two.
+ * @return The foliage state.
+ */
+GpuFoliage create_gpu_foliage(const MetalContext& metal, uint32_t maxChunks, const FoliageSettings& settings = {},
+                              uint32_t maxInstances = 1u << 18);
+
+/// @return Frame ring bytes gpu_foliage_encode needs per frame, and gpu_foliage_encode_shadow per call.
+size_t gpu_foliage_frame_bytes();
+
+/// @return GPU bytes held by the pool, the instance buffers and the impostor atlas.
+size_t gpu_foliage_bytes(const GpuFoliage& foliage);
+
+/**
+ * @brief Binds the part sway for pipelines built with the foliageWind variant.
+ * @param foliage The foliage state.
+ * @param enc The scene's render encoder.
+ */
+void gpu_foliage_bind(const GpuFoliage& foliage, id<MTLRenderCommandEncoder> enc);
+
+/**
+ * @brief Scatters chunks that became resident, frees the slots of evicted ones, and selects this frame's instances.
+ *
+ * Must be encoded before the render pass that draws foliage.instances with the arguments in foliage.draw,
+ * and, with impostors on, foliage.impostorInstances with those in foliage.impostorDraw.
+ *
+ * @param foliage The foliage state.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks.
+ * @param uniformRing The frame ring that receives the draw arguments.
+ * @param cam The camera of this frame.
+ * @param mesh The mesh drawn per instance; its index count and base vertex go into the draw arguments.
+ * @param arena The calling thread's frame arena, for the list of chunks to scatter.
+ */
+void gpu_foliage_encode(GpuFoliage& foliage, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                        FrameRing& uniformRing, const Camera& cam, const GpuMesh& mesh, FrameArena& arena);
+
+/**
+ * @brief Selects the parts casting into a shadow cascade into shadowInstances.
+ *
+ * Every tree is taken as its far box and no impostor quads are drawn, so the casters only
+ * change with the pool, not with the camera. Must be encoded after this frame's
+ * gpu_foliage_encode and before the shadow pass
+ * that draws shadowInstances with the arguments in foliage.shadowDraw; the next call reuses both.
+ *
+ * @param foliage The foliage state.
+ * @param cmd The frame's command buffer.
+ * @param uniformRing The frame ring that receives the draw arguments.
+ * @param frustum The cascade's light frustum.
+ * @param center The centre of the cascade.
+ * @param distance Instances farther than this from center are skipped.
+ * @param mesh The mesh drawn per instance.
+ */
+void gpu_foliage_encode_shadow(GpuFoliage& foliage, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                               const Frustum& frustum, simd::float3 center, float distance, const GpuMesh& mesh);
@@ -0,0 +1,291 @@
+#import "gpu_foliage.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Matches FoliageScatterParams in shaders.metal
+    struct FoliageScatterParams {
+        simd::float2 origin;
+        simd::int2 chunk;
+        float cellSize;
+        uint32_t cellsPerEdge;
+        float gridStep;
+        uint32_t gridResolution;
+        uint32_t seed;
+        float treeDensity;
+        float rockDensity;
+        float forestScale;
+        float treeline;
+        float noiseOffset;
+        float noiseScale;
+        float heightScale;
+        uint32_t firstInstance;
+        uint32_t slot;
+        NoiseSettings noise;
+        uint32_t biomeCells;
+    };
+
+    // Matches FoliageSelectParams in shaders.metal
+    struct FoliageSelectParams {
+        simd::float4 planes[6];
+        simd::float3 camera;
+        float treeDetailDistance;
+        float treeDrawDistance;
+        float rockDrawDistance;
+        uint32_t capacity;
+        uint32_t slotCount;
+        uint32_t maxInstances;
+        float rockDetailDistance;
+        float fadeDistance;
+        uint32_t impostors;
+        uint32_t maxImpostors;
+        uint32_t sway;
+        simd::float4 impostorBounds[IMPOSTOR_KINDS];
+    };
+
+    // Matches ImpostorInstance in shaders.metal
+    struct ImpostorInstance {
+        simd::float4 center;
+        simd::float4 color;
+        float yaw;
+        uint32_t kind;
+        simd::float2 padding;
+    };
+
+    // The indexed draw select_foliage fills in, then the count it appended before clamping
+    struct FoliageDrawArgs {
+        MTLDrawIndexedPrimitivesIndirectArguments draw;
+        uint32_t appended;
+    };
+
+    NSUInteger group_width(id<MTLComputePipelineState> pipeline) {
+        return std::min<NSUInteger>(pipeline.maxTotalThreadsPerThreadgroup, 64);
+    }
+
+    size_t draw_bytes() {
+        return (sizeof(FoliageDrawArgs) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    }
+
+    FrameAllocation allocate_draw(FrameRing& uniformRing, uint32_t indexCount, uint32_t baseVertex) {
+        FrameAllocation draw = frame_ring_allocate(uniformRing, sizeof(FoliageDrawArgs));
+        FoliageDrawArgs* args = (FoliageDrawArgs*)draw.contents;
+        *args = {};
+        args->draw.indexCount = indexCount;
+        args->draw.baseVertex = (int32_t)baseVertex;
+        return draw;
+    }
+
+    // Serial dispatches: selection sees earlier scatters, and the clamp sees every append. The impostor
+    // and sway buffers are always bound; with select.impostors or select.sway clear nothing is written to them.
+    void encode_select(id<MTLComputeCommandEncoder> enc, const GpuFoliage& foliage, const FoliageSelectParams& select,
+                       id<MTLBuffer> instances, const FrameAllocation& draw) {
+        [enc setComputePipelineState:foliage.selectPipeline];
+        [enc setBytes:&select length:sizeof(select) atIndex:0];
+        [enc setBuffer:foliage.pool offset:0 atIndex:1];
+        [enc setBuffer:foliage.counts offset:0 atIndex:2];
+        [enc setBuffer:instances offset:0 atIndex:3];
+        [enc setBuffer:draw.buffer offset:draw.offset atIndex:4];
+        [enc setBuffer:foliage.impostorInstances offset:0 atIndex:5];
+        [enc setBuffer:foliage.impostorDraw.buffer offset:foliage.impostorDraw.offset atIndex:6];
+        [enc setBuffer:foliage.sway offset:0 atIndex:7];
+        [enc dispatchThreads:MTLSizeMake((NSUInteger)foliage.slotCount * foliage.capacity, 1, 1)
+            threadsPerThreadgroup:MTLSizeMake(group_width(foliage.selectPipeline), 1, 1)];
+
+        [enc setComputePipelineState:foliage.finishPipeline];
+        [enc dispatchThreads:MTLSizeMake(1, 1, 1) threadsPerThreadgroup:MTLSizeMake(1, 1, 1)];
+    }
+}
+
+bool gpu_foliage_supported(const MetalContext& metal) {
+    return metal.scatter_foliage_pipeline && metal.select_foliage_pipeline && metal.finish_foliage_pipeline;
+}
+
+GpuFoliage create_gpu_foliage(const MetalContext& metal, uint32_t maxChunks, const FoliageSettings& settings,
+                              uint32_t maxInstances) {
+    GpuFoliage foliage;
+    foliage.scatterPipeline = metal.scatter_foliage_pipeline;
+    foliage.selectPipeline = metal.select_foliage_pipeline;
+    foliage.finishPipeline = metal.finish_foliage_pipeline;
+    foliage.settings = settings;
+    foliage.capacity = settings.cellsPerEdge * settings.cellsPerEdge;
+    foliage.slotCount = std::max(maxChunks, 1u);
+    foliage.maxInstances = maxInstances;
+    foliage.maxShadowInstances = std::max(maxInstances / 4, 1u);
+    foliage.maxImpostors = std::max(maxInstances / 4, 1u);
+
+    foliage.pool = [metal.device newBufferWithLength:(size_t)foliage.slotCount * foliage.capacity * sizeof(FoliageInstance)
+                                             options:MTLResourceStorageModePrivate];
+    foliage.pool.label = @"Foliage pool";
+    foliage.counts = [metal.device newBufferWithLength:foliage.slotCount * sizeof(uint32_t)
+                                               options:MTLResourceStorageModePrivate];
+    foliage.counts.label = @"Foliage counts";
+    foliage.instances = [metal.device newBufferWithLength:(size_t)maxInstances * sizeof(InstanceData)
+                                                  options:MTLResourceStorageModePrivate];
+    foliage.instances.label = @"Foliage instances";
+    foliage.sway = [metal.device newBufferWithLength:(size_t)maxInstances * sizeof(simd::float4)
+                                             options:MTLResourceStorageModePrivate];
+    foliage.sway.label = @"Foliage sway";
+    foliage.shadowInstances = [metal.device newBufferWithLength:(size_t)foliage.maxShadowInstances * sizeof(InstanceData)
+                                                        options:MTLResourceStorageModePrivate];
+    foliage.shadowInstances.label = @"Foliage shadow instances";
+    foliage.impostorInstances =
+        [metal.device newBufferWithLength:(size_t)foliage.maxImpostors * sizeof(ImpostorInstance)
+                                  options:MTLResourceStorageModePrivate];
+    foliage.impostorInstances.label = @"Foliage impostor instances";
+
+    foliage.lastSeen.assign(foliage.slotCount, 0);
+    for (uint32_t slot = foliage.slotCount; slot-- > 0;) {
+        foliage.freeSlots.push_back(slot);
+    }
+
+    // Free slots must read as empty; the queue orders this before any frame uses the pool
+    id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    [blit fillBuffer:foliage.counts range:NSMakeRange(0, foliage.counts.length) value:0];
+    [blit endEncoding];
+    [cmd commit];
+    return foliage;
+}
+
+size_t gpu_foliage_frame_bytes() {
+    return 2 * draw_bytes();
+}
+
+size_t gpu_foliage_bytes(const GpuFoliage& foliage) {
+    return foliage.pool.allocatedSize + foliage.counts.allocatedSize + foliage.instances.allocatedSize +
+           foliage.sway.allocatedSize + foliage.shadowInstances.allocatedSize +
+           foliage.impostorInstances.allocatedSize + gpu_impostors_bytes(foliage.atlas);
+}
+
+void gpu_foliage_bind(const GpuFoliage& foliage, id<MTLRenderCommandEncoder> enc) {
+    [enc setVertexBuffer:foliage.sway offset:0 atIndex:FOLIAGE_SWAY_BUFFER_INDEX];
+}
+
+void gpu_foliage_encode(GpuFoliage& foliage, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                        FrameRing& uniformRing, const Camera& cam, const GpuMesh& mesh, FrameArena& arena) {
+    const uint32_t frame = ++foliage.frame;
+    const FoliageSettings& settings = foliage.settings;
+
+    // Chunks without a slot are scattered this frame; a full pool retries them once slots free up
+    using Arrival = std::pair<const ResidentChunk*, uint32_t>;
+    ArenaVector<Arrival> arrived{ ArenaAllocator<Arrival>(arena) };
+    for (const ResidentChunk& chunk : chunkManager.resident()) {
+        auto it = foliage.slots.find(chunk.key);
+        if (it != foliage.slots.end()) {
+            foliage.lastSeen[it->second] = frame;
+        } else if (!foliage.freeSlots.empty()) {
+            const uint32_t slot = foliage.freeSlots.back();
+            foliage.freeSlots.pop_back();
+            foliage.slots.emplace(chunk.key, slot);
+            foliage.lastSeen[slot] = frame;
+            arrived.emplace_back(&chunk, slot);
+        }
+    }
+
+    id<MTLBlitCommandEncoder> blit = nil;
+    for (auto it = foliage.slots.begin(); it != foliage.slots.end();) {
+        if (foliage.lastSeen[it->second] == frame) {
+            ++it;
+            continue;
+        }
+        if (!blit) {
+            blit = [cmd blitCommandEncoder];
+            blit.label = @"Free foliage slots";
+        }
+        [blit fillBuffer:foliage.counts range:NSMakeRange(it->second * sizeof(uint32_t), sizeof(uint32_t)) value:0];
+        foliage.freeSlots.push_back(it->second);
+        it = foliage.slots.erase(it);
+    }
+    [blit endEncoding];
+
+    foliage.draw = allocate_draw(uniformRing, mesh.indexCount, mesh.baseVertex);
+    foliage.impostorDraw = allocate_draw(uniformRing, 6, 0);
+
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Foliage";
+
+    if (!arrived.empty()) {
+        const ChunkManagerConfig& config = chunkManager.config();
+        const TerrainNoiseMapping mapping = terrain_noise_mapping(config.terrain);
+        FoliageScatterParams params;
+        params.cellSize = config.chunkSize / (float)settings.cellsPerEdge;
+        params.cellsPerEdge = settings.cellsPerEdge;
+        params.gridStep = config.chunkSize / (float)(config.resolution - 1);
+        params.gridResolution = (uint32_t)config.resolution;
+        params.seed = settings.seed;
+        params.treeDensity = settings.treeDensity;
+        params.rockDensity = settings.rockDensity;
+        params.forestScale = settings.forestScale;
+        params.treeline = settings.treeline;
+        params.noiseOffset = mapping.offset;
+        params.noiseScale = mapping.scale;
+        params.heightScale = mapping.heightScale;
+        params.noise = mapping.noise;
+
+        [enc setComputePipelineState:foliage.scatterPipeline];
+        [enc setBuffer:foliage.pool offset:0 atIndex:1];
+        [enc setBuffer:foliage.counts offset:0 atIndex:2];
+        [enc setBytes:biome_profiles() length:BIOME_COUNT * sizeof(BiomeProfile) atIndex:4];
+        for (const auto& [chunk, slot] : arrived) {
+            const ChunkKey key = chunk->key;
+            params.origin = { key.x * config.chunkSize, key.z * config.chunkSize };
+            params.chunk = { key.x, key.z };
+            params.firstInstance = slot * foliage.capacity;
+            params.slot = slot;
+            params.biomeCells = chunk->biomes.cellsPerEdge;
+            [enc setBytes:&params length:sizeof(params) atIndex:0];
+            // The kernel only reads the IDs with biomeCells set, but every buffer it declares is bound
+            const uint8_t noBiomes = 0;
+            [enc setBytes:chunk->biomes.empty() ? &noBiomes : chunk->biomes.ids.data()
+                   length:std::max<size_t>(chunk->biomes.ids.size(), 1) atIndex:3];
+            [enc dispatchThreads:MTLSizeMake(settings.cellsPerEdge, settings.cellsPerEdge, 1)
+                threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+        }
+    }
+
+    FoliageSelectParams select;
+    Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+    std::copy(frustum.planes, frustum.planes + 6, select.planes);
+    select.camera = cam.position;
+    select.treeDetailDistance = settings.treeDetailDistance;
+    select.treeDrawDistance = settings.treeDrawDistance;
+    select.rockDrawDistance = settings.rockDrawDistance;
+    select.capacity = foliage.capacity;
+    select.slotCount = foliage.slotCount;
+    select.maxInstances = foliage.maxInstances;
+    select.rockDetailDistance = settings.rockDetailDistance;
+    select.fadeDistance = settings.impostorFadeDistance;
+    select.impostors = foliage.impostors && foliage.atlas.albedo != nil;
+    select.maxImpostors = foliage.maxImpostors;
+    select.sway = 1;
+    for (uint32_t kind = 0; kind < IMPOSTOR_KINDS; ++kind) {
+        const ImpostorBounds bounds = impostor_bounds((FoliageKind)kind);
+        select.impostorBounds[kind] = { bounds.center.x, bounds.center.y, bounds.center.z, bounds.radius };
+    }
+
+    encode_select(enc, foliage, select, foliage.instances, foliage.draw);
+    [enc endEncoding];
+}
+
+void gpu_foliage_encode_shadow(GpuFoliage& foliage, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                               const Frustum& frustum, simd::float3 center, float distance, const GpuMesh& mesh) {
+    foliage.shadowDraw = allocate_draw(uniformRing, mesh.indexCount, mesh.baseVertex);
+
+    // Casters stay boxes, so the impostor fields only need to be valid
+    FoliageSelectParams select = {};
+    std::copy(frustum.planes, frustum.planes + 6, select.planes);
+    select.camera = center;
+    select.treeDetailDistance = 0.0f;
+    select.treeDrawDistance = distance;
+    select.rockDrawDistance = distance;
+    select.capacity = foliage.capacity;
+    select.slotCount = foliage.slotCount;
+    select.maxInstances = foliage.maxShadowInstances;
+    select.fadeDistance = foliage.settings.impostorFadeDistance;
+    select.maxImpostors = foliage.maxImpostors;
+
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Foliage shadow casters";
+    encode_select(enc, foliage, select, foliage.shadowInstances, foliage.shadowDraw);
+    [enc endEncoding];
+}
@@ -0,0 +1,103 @@
+/**
+ * @file gpu_heap.hpp
+ * @brief Equal-sized private buffers sub-allocated from placement heaps, and the device's memory budget.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "slot_allocator.hpp"
+
+class GpuResidency;
+
+/**
+ * @struct GpuMemoryBudget
+ * @brief What the device has allocated against what it can keep resident without paging.
+ */
+struct GpuMemoryBudget {
+    size_t allocated = 0;   ///< MTLDevice currentAllocatedSize.
+    size_t recommended = 0; ///< MTLDevice recommendedMaxWorkingSetSize.
+};
+
+/// @return The device's current allocation and recommended working set.
+GpuMemoryBudget gpu_memory_budget(id<MTLDevice> device);
+
+/**
+ * @class BufferHeap
+ * @brief Hands out buffers of one length from a growing list of placement heaps.
+ *
+ * Creating a buffer from a heap only places it at an offset, so streaming chunks in and
+ * out no longer allocates and frees device memory per chunk. Each heap holds a fixed
+ * number of slots; the SlotAllocator keeps live buffers in the first heaps, and heaps
+ * left empty at the end are released. Resources in the heaps are hazard tracked like
+ * standalone buffers. allocate() is safe from any thread; retire() and end_frame() are
+ * called from the render thread.
+ */
+class BufferHeap {
+public:
+    /**
+     * @param device The Metal device.
+     * @param bufferLength The length of every buffer.
+     * @param heapBytes Roughly the size of each heap; at least one buffer fits.
+     * @param label Debug label of the heaps and buffers.
+     * @param storageMode Private, or shared on unified memory for buffers the CPU fills in place.
+     */
+    BufferHeap(id<MTLDevice> device, size_t bufferLength, size_t heapBytes, NSString* label,
+               MTLStorageMode storageMode = MTLStorageModePrivate);
+
+    BufferHeap(const BufferHeap&) = delete;
+    BufferHeap& operator=(const BufferHeap&) = delete;
+
+    /**
+     * @brief Places a buffer in a free slot, adding a heap if every slot is taken.
+     * @param slot Receives the slot to retire the buffer with; NO_SLOT if the buffer is not in a heap.
+     * @return The buffer; if no heap could be created, a standalone one.
+     */
+    id<MTLBuffer> allocate(uint32_t& slot);
+
+    /// @brief Frees a slot whose buffer the GPU never used, e.g. after a failed load.
+    void release(uint32_t slot);
+
+    /// @brief Frees a slot once the frames that may still draw its buffer have completed.
+    void retire(uint32_t slot);
+
+    /// @brief Advances the frame count, reclaims slots and releases empty heaps; call once per frame.
+    void end_frame();
+
+    /// @brief Keeps the heaps in a residency set, from the existing ones on; nullptr stops adding them.
+    void set_residency(GpuResidency* residency);
+
+    /// @return Bytes held by the heaps, used or not.
+    size_t heap_bytes() const;
+
+    /// @return Number of heaps.
+    uint32_t heap_count() const;
+
+    /// @return Slots in use, retired ones included.
+    uint32_t used_slots() const;
+
+    /// @return Slots in all heaps.
+    uint32_t capacity() const;
+
+private:
+    /// Drops the heaps of the pages the SlotAllocator trimmed; m_mutex must be held.
+    void trim_heaps();
+
+    id<MTLDevice> m_device;
+    NSString* m_label;
+    size_t m_bufferLength;
+    size_t m_stride;                    ///< Bytes between slots, aligned for heap placement.
+    MTLHeapDescriptor* m_heapDesc;
+    MTLResourceOptions m_options;
+
+    mutable std::mutex m_mutex;         ///< Guards the members below.
+    SlotAllocator m_slots;
+    std::vector<id<MTLHeap>> m_heaps;   ///< One per SlotAllocator page.
+    GpuResidency* m_residency = nullptr; ///< Holds every heap in m_heaps if set.
+    uint64_t m_frame = 0;
+};
@@ -0,0 +1,140 @@
+#import "gpu_heap.hpp"
+
+#include <algorithm>
+
+#import "frame_ring.hpp"
+#import "gpu_residency.hpp"
+
+namespace {
+    uint32_t slots_per_heap(size_t stride, size_t heapBytes) {
+        return (uint32_t)std::max<size_t>(heapBytes / stride, 1);
+    }
+}
+
+GpuMemoryBudget gpu_memory_budget(id<MTLDevice> device) {
+    GpuMemoryBudget budget;
+    budget.allocated = device.currentAllocatedSize;
+    budget.recommended = device.recommendedMaxWorkingSetSize;
+    return budget;
+}
+
+BufferHeap::BufferHeap(id<MTLDevice> device, size_t bufferLength, size_t heapBytes, NSString* label,
+                       MTLStorageMode storageMode)
+    : m_device(device), m_label(label), m_bufferLength(bufferLength),
+      m_options(((MTLResourceOptions)storageMode << MTLResourceStorageModeShift) |
+                MTLResourceHazardTrackingModeTracked),
+      m_slots(1) {
+    const MTLSizeAndAlign sizeAndAlign = [device heapBufferSizeAndAlignWithLength:bufferLength options:m_options];
+    m_stride = (sizeAndAlign.size + sizeAndAlign.align - 1) / sizeAndAlign.align * sizeAndAlign.align;
+    m_slots = SlotAllocator(slots_per_heap(m_stride, heapBytes));
+
+    m_heapDesc = [MTLHeapDescriptor new];
+    m_heapDesc.type = MTLHeapTypePlacement;
+    m_heapDesc.storageMode = storageMode;
+    m_heapDesc.hazardTrackingMode = MTLHazardTrackingModeTracked;
+    m_heapDesc.size = m_stride * m_slots.slots_per_page();
+}
+
+id<MTLBuffer> BufferHeap::allocate(uint32_t& slot) {
+    id<MTLHeap> heap = nil;
+    size_t offset = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot = m_slots.allocate();
+        const uint32_t page = slot / m_slots.slots_per_page();
+        if (page == m_heaps.size()) {
+            id<MTLHeap> added = [m_device newHeapWithDescriptor:m_heapDesc];
+            if (!added) {
+                m_slots.release(slot);
+                m_slots.trim();
+                trim_heaps();
+                slot = NO_SLOT;
+            } else {
+                added.label = m_label;
+                m_heaps.push_back(added);
+                if (m_residency) {
+                    m_residency->add(added);
+                }
+            }
+        }
+        if (slot != NO_SLOT) {
+            heap = m_heaps[page];
+            offset = (slot % m_slots.slots_per_page()) * m_stride;
+        }
+    }
+
+    id<MTLBuffer> buffer = heap ? [heap newBufferWithLength:m_bufferLength options:m_options offset:offset]
+                                : [m_device newBufferWithLength:m_bufferLength options:m_options];
+    buffer.label = m_label;
+    return buffer;
+}
+
+void BufferHeap::release(uint32_t slot) {
+    if (slot == NO_SLOT) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots.release(slot);
+}
+
+void BufferHeap::retire(uint32_t slot) {
+    if (slot == NO_SLOT) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Frames encoded before this one may still draw the buffer; the frame ring lets at most
+    // DEFAULT_FRAMES_IN_FLIGHT of them run, and has waited for all of them that many frames later
+    m_slots.retire(slot, m_frame + DEFAULT_FRAMES_IN_FLIGHT);
+}
+
+void BufferHeap::end_frame() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frame++;
+    if (m_slots.reclaim(m_frame) > 0) {
+        // One empty heap stays, so a chunk streaming in right after does not create it again
+        m_slots.trim(1);
+        trim_heaps();
+    }
+}
+
+void BufferHeap::set_residency(GpuResidency* residency) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_residency = residency;
+    if (!m_residency) {
+        return;
+    }
+    for (id<MTLHeap> heap : m_heaps) {
+        m_residency->add(heap);
+    }
+}
+
+void BufferHeap::trim_heaps() {
+    for (size_t i = m_slots.page_count(); i < m_heaps.size() && m_residency; ++i) {
+        m_residency->remove(m_heaps[i]);
+    }
+    m_heaps.resize(m_slots.page_count());
+}
+
+size_t BufferHeap::heap_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t bytes = 0;
+    for (id<MTLHeap> heap : m_heaps) {
+        bytes += heap.size;
+    }
+    return bytes;
+}
+
+uint32_t BufferHeap::heap_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_heaps.size();
+}
+
+uint32_t BufferHeap::used_slots() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_slots.used();
+}
+
+uint32_t BufferHeap::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_heaps.size() * m_slots.slots_per_page();
+}
@@ -0,0 +1,55 @@
+/**
+ * @file gpu_impostors.hpp
+ * @brief The impostor atlas of the foliage kinds, baked on the GPU at load time.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "impostor.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+
+/// Albedo and coverage of the atlas.
+constexpr MTLPixelFormat IMPOSTOR_ALBEDO_FORMAT = MTLPixelFormatRGBA8Unorm;
+/// Instance space normal and coverage of the atlas.
+constexpr MTLPixelFormat IMPOSTOR_NORMAL_FORMAT = MTLPixelFormatRGBA8Unorm;
+
+/**
+ * @struct GpuImpostors
+ * @brief The atlas textures and the quad the ShaderProgram::FoliageImpostor pipelines draw per instance.
+ *
+ * Each texture is an array with one IMPOSTOR_ATLAS_SIZE slice per FoliageKind, holding
+ * IMPOSTOR_FRAMES x IMPOSTOR_FRAMES frames rendered by impostor_frame_view_projection. The
+ * frames are rendered once, from the same cube parts select_foliage draws up close, and
+ * mipmapped; nothing is rebaked afterwards.
+ */
+struct GpuImpostors {
+    id<MTLTexture> albedo;      ///< IMPOSTOR_ALBEDO_FORMAT array, bound at fragment texture 8.
+    id<MTLTexture> normals;     ///< IMPOSTOR_NORMAL_FORMAT array, bound at fragment texture 9.
+    id<MTLBuffer> quadIndices;  ///< Six 16-bit indices of two triangles over the corners impostor_vertex numbers.
+};
+
+/// @return True if the bake pipeline compiled.
+bool gpu_impostors_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the atlas and commits the command buffer that bakes it.
+ *
+ * The queue orders the bake before any frame that samples the atlas, so nothing waits for it.
+ *
+ * @param metal The Metal context; its impostor bake pipeline must exist.
+ * @param cube The unit cube every foliage part is drawn with.
+ * @param uploader The uploader the cube went through.
+ * @param uploadValue A flush() value covering the cube's upload; the bake waits for it on the GPU.
+ * @return The atlas.
+ */
+GpuImpostors create_gpu_impostors(const MetalContext& metal, const GpuMesh& cube, const ResourceUploader& uploader,
+                                  uint64_t uploadValue);
+
+/// @return GPU bytes held by the atlas.
+size_t gpu_impostors_bytes(const GpuImpostors& impostors);
+
+/// @brief Binds the atlas for the impostor fragments.
+void gpu_impostors_bind(const GpuImpostors& impostors, id<MTLRenderCommandEncoder> enc);
@@ -0,0 +1,112 @@
+#import "gpu_impostors.hpp"
+
+namespace {
+    id<MTLTexture> create_atlas(id<MTLDevice> device, MTLPixelFormat format, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:IMPOSTOR_ATLAS_SIZE
+                                                                                       height:IMPOSTOR_ATLAS_SIZE
+                                                                                    mipmapped:YES];
+        desc.textureType = MTLTextureType2DArray;
+        desc.arrayLength = IMPOSTOR_KINDS;
+        desc.mipmapLevelCount = IMPOSTOR_MIP_LEVELS;
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageRenderTarget;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+}
+
+bool gpu_impostors_supported(const MetalContext& metal) {
+    return metal.impostor_bake_pipeline != nil;
+}
+
+GpuImpostors create_gpu_impostors(const MetalContext& metal, const GpuMesh& cube, const ResourceUploader& uploader,
+                                  uint64_t uploadValue) {
+    GpuImpostors impostors;
+    impostors.albedo = create_atlas(metal.device, IMPOSTOR_ALBEDO_FORMAT, @"Impostor albedo");
+    impostors.normals = create_atlas(metal.device, IMPOSTOR_NORMAL_FORMAT, @"Impostor normals");
+
+    const uint16_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+    impostors.quadIndices = [metal.device newBufferWithBytes:quad length:sizeof(quad)
+                                                     options:MTLResourceStorageModeShared];
+    impostors.quadIndices.label = @"Impostor quad";
+
+    // Only needed while baking; released with the command buffer
+    MTLTextureDescriptor* depthDesc = [MTLTextureDescriptor new];
+    depthDesc.pixelFormat = MTLPixelFormatDepth32Float;
+    depthDesc.width = IMPOSTOR_ATLAS_SIZE;
+    depthDesc.height = IMPOSTOR_ATLAS_SIZE;
+    depthDesc.storageMode = MTLStorageModePrivate;
+    depthDesc.usage = MTLTextureUsageRenderTarget;
+    id<MTLTexture> depth = [metal.device newTextureWithDescriptor:depthDesc];
+
+    MTLDepthStencilDescriptor* depthStateDesc = [MTLDepthStencilDescriptor new];
+    depthStateDesc.depthCompareFunction = MTLCompareFunctionLess;
+    depthStateDesc.depthWriteEnabled = YES;
+    id<MTLDepthStencilState> depthState = [metal.device newDepthStencilStateWithDescriptor:depthStateDesc];
+
+    id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+    cmd.label = @"Bake impostors";
+    uploader.encode_wait(cmd, uploadValue);
+    for (uint32_t kind = 0; kind < IMPOSTOR_KINDS; ++kind) {
+        // Cleared to zero, so the coverage is zero wherever no part was drawn
+        MTLRenderPassDescriptor* pass = [MTLRenderPassDescriptor renderPassDescriptor];
+        pass.colorAttachments[0].texture = impostors.albedo;
+        pass.colorAttachments[1].texture = impostors.normals;
+        for (NSUInteger i = 0; i < 2; ++i) {
+            pass.colorAttachments[i].slice = kind;
+            pass.colorAttachments[i].loadAction = MTLLoadActionClear;
+            pass.colorAttachments[i].clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 0.0);
+            pass.colorAttachments[i].storeAction = MTLStoreActionStore;
+        }
+        pass.depthAttachment.texture = depth;
+        pass.depthAttachment.loadAction = MTLLoadActionClear;
+        pass.depthAttachment.clearDepth = 1.0;
+        pass.depthAttachment.storeAction = MTLStoreActionDontCare;
+
+        InstanceData parts[IMPOSTOR_MAX_PARTS];
+        const uint32_t partCount = impostor_parts((FoliageKind)kind, parts);
+
+        id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:pass];
+        enc.label = kind == (uint32_t)FoliageKind::Tree ? @"Tree impostor" : @"Rock impostor";
+        [enc setRenderPipelineState:metal.impostor_bake_pipeline];
+        [enc setDepthStencilState:depthState];
+        [enc setVertexBuffer:cube.vertexBuffer offset:0 atIndex:0];
+        [enc setVertexBytes:parts length:partCount * sizeof(InstanceData) atIndex:2];
+        // Frames never overlap, so one clear serves them all
+        for (uint32_t y = 0; y < IMPOSTOR_FRAMES; ++y) {
+            for (uint32_t x = 0; x < IMPOSTOR_FRAMES; ++x) {
+                const simd::float4x4 viewProjection = impostor_frame_view_projection((FoliageKind)kind, x, y);
+                [enc setViewport:(MTLViewport){ (double)x * IMPOSTOR_FRAME_SIZE, (double)y * IMPOSTOR_FRAME_SIZE,
+                                                IMPOSTOR_FRAME_SIZE, IMPOSTOR_FRAME_SIZE, 0.0, 1.0 }];
+                [enc setVertexBytes:&viewProjection length:sizeof(viewProjection) atIndex:1];
+                [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                                indexCount:cube.indexCount
+                                 indexType:cube.indexType
+                               indexBuffer:cube.indexBuffer
+                         indexBufferOffset:gpu_mesh_index_offset(cube)
+                             instanceCount:partCount
+                                baseVertex:cube.baseVertex
+                              baseInstance:0];
+            }
+        }
+        [enc endEncoding];
+    }
+
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    [blit generateMipmapsForTexture:impostors.albedo];
+    [blit generateMipmapsForTexture:impostors.normals];
+    [blit endEncoding];
+    [cmd commit];
+    return impostors;
+}
+
+size_t gpu_impostors_bytes(const GpuImpostors& impostors) {
+    return impostors.albedo.allocatedSize + impostors.normals.allocatedSize + impostors.quadIndices.allocatedSize;
+}
+
+void gpu_impostors_bind(const GpuImpostors& impostors, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:impostors.albedo atIndex:8];
+    [enc setFragmentTexture:impostors.normals atIndex:9];
+}
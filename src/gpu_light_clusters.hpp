@@ -0,0 +1,72 @@
+/**
+ * @file gpu_light_clusters.hpp
+ * @brief Point lights binned into the cluster grid of light_clusters.hpp on the GPU every frame.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "camera.hpp"
+#include "frame_ring.hpp"
+#include "light_clusters.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct GpuLightClusters
+ * @brief The cluster lists and the frame's lights.
+ *
+ * gpu_light_clusters_encode copies the frame's lights and the cluster uniforms into the frame
+ * ring and dispatches cluster_lights, one thread per cluster, which rewrites every cluster's
+ * count and list. The ShaderVariant::pointLights fragments then find their cluster from the
+ * pixel and the view depth and light the surface with the listed lights only. The lists stay
+ * on the GPU; nothing is read back.
+ */
+struct GpuLightClusters {
+    id<MTLComputePipelineState> pipeline;   ///< cluster_lights.
+    id<MTLBuffer> counts;                   ///< LIGHT_CLUSTER_COUNT uint: lights touching each cluster, possibly above the list size.
+    id<MTLBuffer> indices;                  ///< LIGHT_CLUSTER_MAX_LIGHTS ushort light indices per cluster.
+    FrameAllocation uniforms = {};          ///< This frame's LightClusterUniforms.
+    FrameAllocation lights = {};            ///< This frame's PointLight array.
+    uint32_t lightCount = 0;                ///< Lights binned this frame.
+};
+
+/// @return True if the clustering kernel compiled.
+bool gpu_light_clusters_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the cluster lists.
+ * @param metal The Metal context; its cluster_lights pipeline must exist.
+ * @return The clusters, with no lights.
+ */
+GpuLightClusters create_gpu_light_clusters(const MetalContext& metal);
+
+/// @return Frame ring bytes gpu_light_clusters_encode needs per frame.
+size_t gpu_light_clusters_frame_bytes();
+
+/// @return GPU bytes held by the cluster lists.
+size_t gpu_light_clusters_bytes(const GpuLightClusters& clusters);
+
+/**
+ * @brief Bins this frame's lights into the clusters of a camera.
+ *
+ * Must be encoded before the render pass whose fragments read the clusters.
+ *
+ * @param clusters The clusters.
+ * @param cmd The frame's command buffer.
+ * @param uniformRing Receives the lights and the uniforms.
+ * @param cam The camera of the pass, with the projection it renders with.
+ * @param width Render target width in pixels.
+ * @param height Render target height in pixels.
+ * @param farZ View depth where clustering ends; surfaces beyond it get no point light.
+ * @param lights The lights; at most MAX_POINT_LIGHTS are used.
+ * @param count Lights in the array.
+ */
+void gpu_light_clusters_encode(GpuLightClusters& clusters, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                               const Camera& cam, uint32_t width, uint32_t height, float farZ,
+                               const PointLight* lights, uint32_t count);
+
+/// @brief Binds the uniforms, lights and lists for the ShaderVariant::pointLights fragments.
+void gpu_light_clusters_bind(const GpuLightClusters& clusters, id<MTLRenderCommandEncoder> enc);
@@ -0,0 +1,71 @@
+#import "gpu_light_clusters.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "trace.hpp"
+
+namespace {
+    // Matches LIGHT_CLUSTER_BATCH in shaders.metal: the kernel loads one light per thread of a group
+    constexpr uint32_t CLUSTER_THREADS = 64;
+
+    size_t ring_size(size_t bytes) {
+        return (bytes + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    }
+}
+
+bool gpu_light_clusters_supported(const MetalContext& metal) {
+    return metal.cluster_lights_pipeline != nil;
+}
+
+GpuLightClusters create_gpu_light_clusters(const MetalContext& metal) {
+    GpuLightClusters clusters;
+    clusters.pipeline = metal.cluster_lights_pipeline;
+    // Only the kernel and the fragments touch the lists
+    clusters.counts = [metal.device newBufferWithLength:LIGHT_CLUSTER_COUNT * sizeof(uint32_t)
+                                                options:MTLResourceStorageModePrivate];
+    clusters.counts.label = @"Light cluster counts";
+    clusters.indices = [metal.device newBufferWithLength:LIGHT_CLUSTER_COUNT * LIGHT_CLUSTER_MAX_LIGHTS * sizeof(uint16_t)
+                                                 options:MTLResourceStorageModePrivate];
+    clusters.indices.label = @"Light cluster lists";
+    return clusters;
+}
+
+size_t gpu_light_clusters_frame_bytes() {
+    return ring_size(sizeof(LightClusterUniforms)) + ring_size(MAX_POINT_LIGHTS * sizeof(PointLight));
+}
+
+size_t gpu_light_clusters_bytes(const GpuLightClusters& clusters) {
+    return clusters.counts.allocatedSize + clusters.indices.allocatedSize;
+}
+
+void gpu_light_clusters_encode(GpuLightClusters& clusters, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                               const Camera& cam, uint32_t width, uint32_t height, float farZ,
+                               const PointLight* lights, uint32_t count) {
+    clusters.lightCount = std::min(count, MAX_POINT_LIGHTS);
+    clusters.uniforms = frame_ring_allocate(uniformRing, sizeof(LightClusterUniforms));
+    *(LightClusterUniforms*)clusters.uniforms.contents =
+        light_cluster_uniforms(cam.viewMatrix, cam.projectionMatrix, width, height, cam.nearZ, farZ, clusters.lightCount);
+    // Never empty, so the fragments always have a buffer bound
+    clusters.lights = frame_ring_allocate(uniformRing, std::max(clusters.lightCount, 1u) * sizeof(PointLight));
+    memcpy(clusters.lights.contents, lights, clusters.lightCount * sizeof(PointLight));
+
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Light clusters";
+    TRACE_PUSH_GROUP(enc, "Cluster lights");
+    [enc setComputePipelineState:clusters.pipeline];
+    [enc setBuffer:clusters.uniforms.buffer offset:clusters.uniforms.offset atIndex:0];
+    [enc setBuffer:clusters.lights.buffer offset:clusters.lights.offset atIndex:1];
+    [enc setBuffer:clusters.counts offset:0 atIndex:2];
+    [enc setBuffer:clusters.indices offset:0 atIndex:3];
+    [enc dispatchThreads:MTLSizeMake(LIGHT_CLUSTER_COUNT, 1, 1) threadsPerThreadgroup:MTLSizeMake(CLUSTER_THREADS, 1, 1)];
+    TRACE_POP_GROUP(enc);
+    [enc endEncoding];
+}
+
+void gpu_light_clusters_bind(const GpuLightClusters& clusters, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentBuffer:clusters.uniforms.buffer offset:clusters.uniforms.offset atIndex:9];
+    [enc setFragmentBuffer:clusters.lights.buffer offset:clusters.lights.offset atIndex:10];
+    [enc setFragmentBuffer:clusters.counts offset:0 atIndex:11];
+    [enc setFragmentBuffer:clusters.indices offset:0 atIndex:12];
+}
@@ -0,0 +1,75 @@
+/**
+ * @file gpu_look_at.hpp
+ * @brief The depth readback of look_at.hpp: one texel of the scene depth copied out every frame.
+ *
+ * After the scene pass, gpu_look_at_encode() blits the depth texel under the point into a slot
+ * of a small shared buffer, together with the LookAtQuery of the camera that drew it, and the
+ * command buffer's completion marks the slot landed. gpu_look_at_poll() takes the newest landed
+ * slot on a later frame, usually the next one, so the readout trails the view by a frame or two
+ * and nothing ever waits. Slots cover the frames in flight; a frame whose slot is still busy
+ * skips its copy.
+ *
+ * The copy needs the scene depth stored, so the frame keeps depth while the query is on; most
+ * configurations already store it for Hi-Z, ambient occlusion, water or the temporal scaler.
+ * A rate-mapped scene has no depth in screen pixels, so the query does not run over it.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "camera.hpp"
+#include "frame_ring.hpp"
+#include "look_at.hpp"
+#include "metal_context.hpp"
+
+/// Readback slots: one per frame in flight plus the one being polled.
+constexpr uint32_t LOOK_AT_SLOTS = DEFAULT_FRAMES_IN_FLIGHT + 1;
+
+/**
+ * @struct GpuLookAt
+ * @brief The readback buffer and the queries of the copies in flight.
+ */
+struct GpuLookAt {
+    id<MTLBuffer> readback;                                 ///< One float depth per slot, shared.
+    LookAtQuery queries[LOOK_AT_SLOTS];                     ///< The query of each slot's copy.
+    std::shared_ptr<std::atomic<bool>> done[LOOK_AT_SLOTS]; ///< Set by each copy's command buffer; null when free.
+    uint32_t next = 0;                                      ///< Slot the next copy goes to.
+    uint64_t landedFrame = 0;                               ///< Frame of the newest depth polled.
+};
+
+/**
+ * @brief Creates the readback buffer.
+ * @param metal The Metal context.
+ * @return The query, idle.
+ */
+GpuLookAt create_gpu_look_at(const MetalContext& metal);
+
+/**
+ * @brief Copies the depth under a point out of the frame's scene depth.
+ * @param lookAt The query.
+ * @param cmd The command buffer of the scene pass, after it; the copy lands when it completes.
+ * @param depth The scene depth, stored by the scene pass; resolved if multisampled.
+ * @param cam The camera the scene was drawn with, jitter included.
+ * @param point The point, in [0, 1] across the view with y down.
+ * @param frame The frame number.
+ */
+void gpu_look_at_encode(GpuLookAt& lookAt, id<MTLCommandBuffer> cmd, id<MTLTexture> depth, const Camera& cam,
+                        simd::float2 point, uint64_t frame);
+
+/**
+ * @brief Takes the newest copy that has landed since the last poll; never waits.
+ * @param lookAt The query.
+ * @param query Receives the query the copy was made for.
+ * @param depth Receives the depth.
+ * @return True if a newer copy landed.
+ */
+bool gpu_look_at_poll(GpuLookAt& lookAt, LookAtQuery& query, float& depth);
+
+/// @return GPU bytes of the readback.
+size_t gpu_look_at_bytes(const GpuLookAt& lookAt);
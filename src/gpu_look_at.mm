@@ -0,0 +1,67 @@
+#import "gpu_look_at.hpp"
+
+#include <algorithm>
+
+GpuLookAt create_gpu_look_at(const MetalContext& metal) {
+    GpuLookAt lookAt;
+    lookAt.readback = [metal.device newBufferWithLength:LOOK_AT_SLOTS * sizeof(float)
+                                                options:MTLResourceStorageModeShared];
+    lookAt.readback.label = @"Look-at readback";
+    return lookAt;
+}
+
+void gpu_look_at_encode(GpuLookAt& lookAt, id<MTLCommandBuffer> cmd, id<MTLTexture> depth, const Camera& cam,
+                        simd::float2 point, uint64_t frame) {
+    const uint32_t slot = lookAt.next;
+    if (lookAt.done[slot] || depth.width == 0 || depth.height == 0) {
+        return;
+    }
+    lookAt.next = (slot + 1) % LOOK_AT_SLOTS;
+    lookAt.queries[slot] = look_at_query(cam, point, frame);
+
+    // The texel under the point; a scaled scene's depth is smaller than the view but covers all of it
+    const NSUInteger x = std::min((NSUInteger)(std::clamp(point.x, 0.0f, 1.0f) * depth.width), depth.width - 1);
+    const NSUInteger y = std::min((NSUInteger)(std::clamp(point.y, 0.0f, 1.0f) * depth.height), depth.height - 1);
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    blit.label = @"Look-at readback";
+    [blit copyFromTexture:depth
+                     sourceSlice:0
+                     sourceLevel:0
+                    sourceOrigin:MTLOriginMake(x, y, 0)
+                      sourceSize:MTLSizeMake(1, 1, 1)
+                        toBuffer:lookAt.readback
+               destinationOffset:slot * sizeof(float)
+          destinationBytesPerRow:sizeof(float)
+        destinationBytesPerImage:sizeof(float)];
+    [blit endEncoding];
+
+    // As with picking, the handler only flips the flag and gpu_look_at_poll() reads the slot
+    std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+    lookAt.done[slot] = done;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+        done->store(true, std::memory_order_release);
+    }];
+}
+
+bool gpu_look_at_poll(GpuLookAt& lookAt, LookAtQuery& query, float& depth) {
+    // Every landed slot is freed; only the newest of them is worth reporting
+    bool landed = false;
+    const float* depths = (const float*)lookAt.readback.contents;
+    for (uint32_t slot = 0; slot < LOOK_AT_SLOTS; ++slot) {
+        if (!lookAt.done[slot] || !lookAt.done[slot]->load(std::memory_order_acquire)) {
+            continue;
+        }
+        lookAt.done[slot].reset();
+        if (lookAt.queries[slot].frame > lookAt.landedFrame) {
+            lookAt.landedFrame = lookAt.queries[slot].frame;
+            query = lookAt.queries[slot];
+            depth = depths[slot];
+            landed = true;
+        }
+    }
+    return landed;
+}
+
+size_t gpu_look_at_bytes(const GpuLookAt& lookAt) {
+    return lookAt.readback.allocatedSize;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file gpu_ocean.hpp
+ * @brief The ocean wave field, simulated each frame by compute kernels; see ocean.hpp.
+ *
+ * ocean_spectrum turns the starting amplitudes to the current time, ocean_fft brings them back
+ * to space one row and then one column per threadgroup, and ocean_resolve writes the
+ * displacement and a normal texture whose alpha is foam wherever the choppy displacement
+ * folds the surface over. Both are mipmapped, so the coarse clipmap levels and distant pixels
+ * read pre-filtered waves. The patch tiles, so the work is the same however much sea is drawn.
+ * The kernels run in one compute pass of the frame's render graph, followed by a blit pass for
+ * the mip chains. Nothing in them depends on the scene, so they can run on the compute queue
+ * while the render queue rasterises the shadows and the scene; on the render queue the compute
+ * pass is timed as GPU_PASS_TRANSPARENT, with the water it feeds.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "clipmap.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_render_graph.hpp"
+#include "metal_context.hpp"
+#include "ocean.hpp"
+#include "resource_uploader.hpp"
+
+/**
+ * @struct GpuOcean
+ * @brief The wave field's tables and textures and the clipmap grid that draws it.
+ */
+struct GpuOcean {
+    id<MTLComputePipelineState> spectrumPipeline;   ///< ocean_spectrum.
+    id<MTLComputePipelineState> fftPipeline;        ///< ocean_fft.
+    id<MTLComputePipelineState> resolvePipeline;    ///< ocean_resolve.
+    id<MTLBuffer> initial;                          ///< ocean_initial_spectrum(), one float4 per texel.
+    id<MTLBuffer> butterflies;                      ///< ocean_butterflies() of the resolution.
+    id<MTLTexture> fields;                          ///< The spectrum, and after both FFT passes the transformed fields.
+    id<MTLTexture> scratch;                         ///< The fields between the row and the column pass.
+    id<MTLTexture> displacement;                    ///< x/z displacement and height, mipmapped.
+    id<MTLTexture> normals;                         ///< rgb: surface normal, a: foam; mipmapped.
+    id<MTLBuffer> grid;                             ///< clipmap_grid() indices.
+    uint32_t fullCount = 0;                         ///< Indices of the full grid.
+    uint32_t ringCount = 0;                         ///< Indices of the ring, after the full grid's.
+    uint32_t gridSize = 64;                         ///< Cells per side of a clipmap level.
+    float cellSize = 0.5f;                          ///< World side of a cell of the innermost level.
+    uint32_t levelCount = 1;                        ///< Clipmap levels drawn.
+    OceanSettings settings;                         ///< The spectrum; only choppiness may change afterwards.
+};
+
+/// @return True if metal_ocean_pipelines() compiled the kernels and a threadgroup holds one FFT line by default.
+bool gpu_ocean_supported(const MetalContext& metal);
+
+/**
+ * @brief Uploads the spectrum, the FFT tables and the grid, and creates the textures.
+ * @param metal The Metal context; its ocean pipelines must exist.
+ * @param uploader Uploads the tables and the grid; must be flushed before the first update.
+ * @param settings The spectrum; resolution is lowered to what a threadgroup can transform.
+ * @param extent The distance from the camera the clipmap must cover.
+ * @return The ocean.
+ */
+GpuOcean create_gpu_ocean(const MetalContext& metal, ResourceUploader& uploader, const OceanSettings& settings,
+                          float extent);
+
+/// @return GPU bytes held by the tables, the textures and the grid.
+size_t gpu_ocean_bytes(const GpuOcean& ocean);
+
+/**
+ * @struct GpuOceanResources
+ * @brief The render graph handles of the textures the water is drawn from.
+ */
+struct GpuOceanResources {
+    uint32_t displacement = RENDER_GRAPH_NONE;  ///< GpuOcean::displacement.
+    uint32_t normals = RENDER_GRAPH_NONE;       ///< GpuOcean::normals.
+};
+
+/**
+ * @brief Declares the simulation of the wave field at a moment and the rebuild of its mip chains.
+ *
+ * Every texture the passes write is imported, so the graph orders them against the last frame's
+ * passes even when the queue changes between frames.
+ *
+ * @param ocean The ocean; must outlive the graph's execution.
+ * @param rg The frame's render graph; declared before the pass that draws the water.
+ * @param time Seconds; kept in double and wrapped to the loop period here, so long sessions keep their precision.
+ * @param queue RENDER_GRAPH_COMPUTE_QUEUE to overlap the render queue, or RENDER_GRAPH_RENDER_QUEUE.
+ * @param profiler Times the simulation as GPU_PASS_TRANSPARENT on the render queue; may be null.
+ * @return The handles the drawing pass reads.
+ */
+GpuOceanResources gpu_ocean_add_passes(const GpuOcean& ocean, GpuRenderGraph& rg, double time, uint32_t queue,
+                                       GpuProfiler* profiler);
@@ -0,0 +1,146 @@
+#import "gpu_ocean.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "trace.hpp"
+
+namespace {
+    // Matches OceanSimulationParams in ocean.metal
+    struct OceanSimulationParams {
+        uint32_t resolution;
+        uint32_t stages;
+        float patchSize;
+        float time;
+        float loopFrequency;
+        float choppiness;
+    };
+
+    id<MTLTexture> create_field(id<MTLDevice> device, MTLPixelFormat format, uint32_t size, bool mipmapped,
+                                NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:size
+                                                                                       height:size
+                                                                                    mipmapped:mipmapped];
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+}
+
+bool gpu_ocean_supported(const MetalContext& metal) {
+    return metal.ocean_spectrum_pipeline && metal.ocean_fft_pipeline && metal.ocean_resolve_pipeline &&
+           metal.ocean_fft_pipeline.maxTotalThreadsPerThreadgroup >= OceanSettings{}.resolution;
+}
+
+GpuOcean create_gpu_ocean(const MetalContext& metal, ResourceUploader& uploader, const OceanSettings& settings,
+                          float extent) {
+    GpuOcean ocean;
+    ocean.spectrumPipeline = metal.ocean_spectrum_pipeline;
+    ocean.fftPipeline = metal.ocean_fft_pipeline;
+    ocean.resolvePipeline = metal.ocean_resolve_pipeline;
+    ocean.settings = settings;
+    // One thread per point of a line, all in one threadgroup
+    const uint32_t limit = std::min<uint32_t>((uint32_t)ocean.fftPipeline.maxTotalThreadsPerThreadgroup,
+                                              OCEAN_MAX_RESOLUTION);
+    while (ocean.settings.resolution > limit) {
+        ocean.settings.resolution /= 2;
+    }
+    const uint32_t n = ocean.settings.resolution;
+
+    const std::vector<simd::float4> initial = ocean_initial_spectrum(ocean.settings);
+    ocean.initial = uploader.upload(initial.data(), initial.size() * sizeof(simd::float4), @"Ocean spectrum");
+    const std::vector<OceanButterfly> butterflies = ocean_butterflies(n);
+    ocean.butterflies = uploader.upload(butterflies.data(), butterflies.size() * sizeof(OceanButterfly),
+                                        @"Ocean butterflies");
+    const ClipmapGrid grid = clipmap_grid(ocean.gridSize);
+    ocean.grid = uploader.upload(grid.indices.data(), grid.indices.size() * sizeof(uint16_t), @"Water grid");
+    ocean.fullCount = grid.fullCount;
+    ocean.ringCount = grid.ringCount;
+    ocean.levelCount = clipmap_level_count(ocean.gridSize, ocean.cellSize, extent);
+
+    ocean.fields = create_field(metal.device, MTLPixelFormatRGBA32Float, n, false, @"Ocean fields");
+    ocean.scratch = create_field(metal.device, MTLPixelFormatRGBA32Float, n, false, @"Ocean FFT scratch");
+    ocean.displacement = create_field(metal.device, MTLPixelFormatRGBA16Float, n, true, @"Ocean displacement");
+    ocean.normals = create_field(metal.device, MTLPixelFormatRGBA16Float, n, true, @"Ocean normals");
+    return ocean;
+}
+
+size_t gpu_ocean_bytes(const GpuOcean& ocean) {
+    return ocean.initial.allocatedSize + ocean.butterflies.allocatedSize + ocean.grid.allocatedSize +
+           ocean.fields.allocatedSize + ocean.scratch.allocatedSize + ocean.displacement.allocatedSize +
+           ocean.normals.allocatedSize;
+}
+
+GpuOceanResources gpu_ocean_add_passes(const GpuOcean& ocean, GpuRenderGraph& rg, double time, uint32_t queue,
+                                       GpuProfiler* profiler) {
+    const uint32_t n = ocean.settings.resolution;
+    OceanSimulationParams params;
+    params.resolution = n;
+    params.stages = (uint32_t)log2((double)n);
+    params.patchSize = ocean.settings.patchSize;
+    params.time = (float)fmod(time, (double)ocean.settings.loopPeriod);
+    params.loopFrequency = 2.0f * (float)M_PI / ocean.settings.loopPeriod;
+    params.choppiness = ocean.settings.choppiness;
+
+    const GpuOcean* sea = &ocean;
+    // The profiler resolves its samples on the render queue's command buffer
+    GpuProfiler* timer = queue == RENDER_GRAPH_RENDER_QUEUE ? profiler : nullptr;
+    const uint32_t fields = gpu_render_graph_import(rg, ocean.fields, "Ocean fields");
+    const uint32_t scratch = gpu_render_graph_import(rg, ocean.scratch, "Ocean FFT scratch");
+    GpuOceanResources resources;
+    resources.displacement = gpu_render_graph_import(rg, ocean.displacement, "Ocean displacement");
+    resources.normals = gpu_render_graph_import(rg, ocean.normals, "Ocean normals");
+
+    gpu_render_graph_compute_pass(
+        rg, "Ocean",
+        ^(MTLComputePassDescriptor* passDesc) {
+            gpu_profiler_sample_compute_pass(timer, passDesc, GPU_PASS_TRANSPARENT);
+        },
+        ^(id<MTLComputeCommandEncoder> compute) {
+            TRACE_PUSH_GROUP(compute, "Ocean simulation");
+            [compute setBytes:&params length:sizeof(params) atIndex:0];
+
+            [compute setComputePipelineState:sea->spectrumPipeline];
+            [compute setBuffer:sea->initial offset:0 atIndex:1];
+            [compute setTexture:sea->fields atIndex:0];
+            [compute dispatchThreads:MTLSizeMake(n, n, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+
+            // Rows into the scratch texture, then columns back; dispatches of a serial encoder run in order
+            [compute setComputePipelineState:sea->fftPipeline];
+            [compute setBuffer:sea->butterflies offset:0 atIndex:2];
+            for (uint32_t vertical = 0; vertical < 2; ++vertical) {
+                [compute setBytes:&vertical length:sizeof(vertical) atIndex:1];
+                [compute setTexture:vertical ? sea->scratch : sea->fields atIndex:0];
+                [compute setTexture:vertical ? sea->fields : sea->scratch atIndex:1];
+                [compute dispatchThreadgroups:MTLSizeMake(1, n, 1) threadsPerThreadgroup:MTLSizeMake(n, 1, 1)];
+            }
+
+            [compute setComputePipelineState:sea->resolvePipeline];
+            [compute setTexture:sea->fields atIndex:0];
+            [compute setTexture:sea->displacement atIndex:1];
+            [compute setTexture:sea->normals atIndex:2];
+            [compute dispatchThreads:MTLSizeMake(n, n, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+            TRACE_POP_GROUP(compute);
+        },
+        queue);
+    render_graph_write(rg.graph, fields);
+    render_graph_write(rg.graph, scratch);
+    render_graph_write(rg.graph, resources.displacement);
+    render_graph_write(rg.graph, resources.normals);
+
+    gpu_render_graph_blit_pass(
+        rg, "Ocean mipmaps",
+        ^(id<MTLBlitCommandEncoder> blit) {
+            [blit generateMipmapsForTexture:sea->displacement];
+            [blit generateMipmapsForTexture:sea->normals];
+        },
+        queue);
+    render_graph_read(rg.graph, resources.displacement);
+    render_graph_read(rg.graph, resources.normals);
+    render_graph_write(rg.graph, resources.displacement);
+    render_graph_write(rg.graph, resources.normals);
+    return resources;
+}
@@ -0,0 +1,111 @@
+/**
+ * @file gpu_particles.hpp
+ * @brief The particle pool, emitted, simulated, compacted and sorted by compute kernels; see particles.hpp.
+ *
+ * Everything about the particles stays on the GPU: the pool, the dead and alive lists, the
+ * counters and the sort keys. Each frame one compute pass emits the new particles, steps the
+ * alive ones against a copy of the terrain's height field, compacts the survivors and sorts
+ * them back to front, and the transparent pass then draws them with one indirect draw after
+ * its composite. The counts only ever reach the GPU's own indirect arguments, so the CPU
+ * encodes the same dispatches and the same draw whether none or all of the pool is alive; only
+ * their thread counts follow the particles. On the render queue the pass is timed as
+ * GPU_PASS_TRANSPARENT, with the draw it feeds.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "camera.hpp"
+#include "frame_stats.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_render_graph.hpp"
+#include "height_field.hpp"
+#include "metal_context.hpp"
+#include "particles.hpp"
+#include "resource_uploader.hpp"
+
+/**
+ * @struct GpuParticles
+ * @brief The pool's buffers, the terrain they collide with and the emitter's state.
+ */
+struct GpuParticles {
+    id<MTLComputePipelineState> emitPipeline;       ///< particles_emit.
+    id<MTLComputePipelineState> preparePipeline;    ///< particles_prepare.
+    id<MTLComputePipelineState> simulatePipeline;   ///< particles_simulate.
+    id<MTLComputePipelineState> prepareSortPipeline; ///< particles_prepare_sort.
+    id<MTLComputePipelineState> padPipeline;        ///< particles_pad.
+    id<MTLComputePipelineState> sortPipeline;       ///< particles_sort.
+    id<MTLRenderPipelineState> drawPipeline;        ///< particle_vertex / particle_fragment.
+    id<MTLBuffer> particles;                        ///< The pool, one Particle per entry.
+    id<MTLBuffer> deadList;                         ///< Free pool entries; starts with all of them.
+    id<MTLBuffer> aliveLists;                       ///< Two lists of capacity entries each, taking turns.
+    id<MTLBuffer> keys;                             ///< Sort key and pool entry of each survivor.
+    id<MTLBuffer> counters;                         ///< Dead and alive counts and the sort size.
+    id<MTLBuffer> arguments;                        ///< The simulation and sort dispatches and the draw.
+    id<MTLTexture> heights;                         ///< R32Float copy of the height field.
+    simd::float2 heightOrigin = 0.0f;               ///< World xz of the first height texel.
+    float heightSpacing = 1.0f;                     ///< World distance between height texels.
+    uint32_t capacity = 0;                          ///< Pool entries, a power of two.
+    std::vector<simd::uint2> sortPasses;            ///< particle_sort_passes() of the capacity.
+    ParticleSettings settings;                      ///< Emission, motion and looks; may change at any time.
+    float pending = 0.0f;                           ///< Fraction of a particle carried to the next frame.
+    uint32_t parity = 0;                            ///< Alive list the next frame starts from.
+    uint32_t frame = 0;                             ///< Frames simulated; seeds the emission.
+};
+
+/// @return True if metal_particle_pipelines() compiled the kernels and the billboard pipeline exists.
+bool gpu_particles_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates an empty pool and uploads the height field it collides with.
+ * @param metal The Metal context; its particle pipelines must exist.
+ * @param uploader Uploads the lists, the counters and the heights; must be flushed before the first frame.
+ * @param field The terrain; must be at least 2 x 2 samples.
+ * @param capacity Pool entries; rounded up to a power of two.
+ * @return The particles.
+ */
+GpuParticles create_gpu_particles(const MetalContext& metal, ResourceUploader& uploader, const HeightField& field,
+                                  uint32_t capacity = 1u << 18);
+
+/**
+ * @brief Uploads the height field again after the terrain changed.
+ * @param particles The particles; the field must have the size it was created with.
+ * @param uploader Uploads the heights; the next flush() covers them.
+ * @param field The terrain.
+ */
+void gpu_particles_update_heights(GpuParticles& particles, ResourceUploader& uploader, const HeightField& field);
+
+/// @return GPU bytes held by the pool, its lists and the heights.
+size_t gpu_particles_bytes(const GpuParticles& particles);
+
+/**
+ * @brief Declares this frame's emission, simulation, compaction and sort.
+ *
+ * The pass writes only buffers, which the graph does not track, so it is declared with side
+ * effects; declare it before the transparent pass, which draws what it leaves.
+ *
+ * @param particles The particles; must outlive the graph's execution.
+ * @param rg The frame's render graph.
+ * @param cam The camera the particles are sorted for.
+ * @param dt Seconds since the last frame.
+ * @param emitterPosition Where new particles start.
+ * @param emitterDirection Unit direction new particles leave in, before the spread.
+ * @param profiler Times the pass as GPU_PASS_TRANSPARENT; may be null.
+ */
+void gpu_particles_add_passes(GpuParticles& particles, GpuRenderGraph& rg, const Camera& cam, float dt,
+                              simd::float3 emitterPosition, simd::float3 emitterDirection, GpuProfiler* profiler);
+
+/**
+ * @brief Draws the sorted survivors of the last gpu_particles_add_passes() as billboards.
+ * @param particles The particles.
+ * @param enc The transparent pass, after its composite; the depth state must test without writing.
+ * @param cam The camera the particles were sorted for.
+ * @param frameStats Receives the draw; its instance count stays on the GPU.
+ */
+void gpu_particles_draw(const GpuParticles& particles, id<MTLRenderCommandEncoder> enc, const Camera& cam,
+                        FrameStats& frameStats);
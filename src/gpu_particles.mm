@@ -0,0 +1,214 @@
+#import "gpu_particles.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "trace.hpp"
+
+namespace {
+    // Matches ParticleParams in particles.metal
+    struct ParticleParams {
+        simd::float3 emitterPosition;
+        simd::float3 emitterDirection;
+        simd::float3 cameraPosition;
+        simd::float2 heightOrigin;
+        float heightSpacing;
+        simd::uint2 heightSize;
+        float dt;
+        float gravity;
+        float drag;
+        float bounce;
+        float friction;
+        float lifetime;
+        float speed;
+        float spread;
+        uint32_t emitCount;
+        uint32_t seed;
+        uint32_t capacity;
+        uint32_t parity;
+    };
+
+    // Matches ParticleCounters in particles.metal
+    struct ParticleCounters {
+        int32_t dead;
+        uint32_t alive[2];
+        uint32_t sortCount;
+    };
+
+    // Matches ParticleArguments in particles.metal
+    struct ParticleArguments {
+        MTLDispatchThreadgroupsIndirectArguments simulate;
+        MTLDispatchThreadgroupsIndirectArguments sort;
+        MTLDrawPrimitivesIndirectArguments draw;
+    };
+
+    // Matches ParticleDrawUniforms in shaders.metal
+    struct ParticleDrawUniforms {
+        simd::float4 color;
+        simd::float3 right;
+        simd::float3 up;
+        float startSize;
+        float endSize;
+    };
+
+    id<MTLBuffer> create_buffer(id<MTLDevice> device, size_t length, NSString* label) {
+        id<MTLBuffer> buffer = [device newBufferWithLength:length options:MTLResourceStorageModePrivate];
+        buffer.label = label;
+        return buffer;
+    }
+
+    MTLRegion height_region(const GpuParticles& particles) {
+        return MTLRegionMake2D(0, 0, particles.heights.width, particles.heights.height);
+    }
+}
+
+bool gpu_particles_supported(const MetalContext& metal) {
+    return metal.particles_emit_pipeline && metal.particles_prepare_pipeline && metal.particles_simulate_pipeline &&
+           metal.particles_prepare_sort_pipeline && metal.particles_pad_pipeline && metal.particles_sort_pipeline &&
+           metal.particle_pipeline;
+}
+
+GpuParticles create_gpu_particles(const MetalContext& metal, ResourceUploader& uploader, const HeightField& field,
+                                  uint32_t capacity) {
+    GpuParticles particles;
+    particles.emitPipeline = metal.particles_emit_pipeline;
+    particles.preparePipeline = metal.particles_prepare_pipeline;
+    particles.simulatePipeline = metal.particles_simulate_pipeline;
+    particles.prepareSortPipeline = metal.particles_prepare_sort_pipeline;
+    particles.padPipeline = metal.particles_pad_pipeline;
+    particles.sortPipeline = metal.particles_sort_pipeline;
+    particles.drawPipeline = metal.particle_pipeline;
+    particles.capacity = particle_sort_size(std::max(capacity, 2u));
+    particles.sortPasses = particle_sort_passes(particles.capacity);
+    const uint32_t n = particles.capacity;
+
+    particles.particles = create_buffer(metal.device, (size_t)n * sizeof(Particle), @"Particle pool");
+    particles.aliveLists = create_buffer(metal.device, (size_t)n * 2 * sizeof(uint32_t), @"Particle alive lists");
+    particles.keys = create_buffer(metal.device, (size_t)n * sizeof(simd::uint2), @"Particle sort keys");
+    particles.arguments = create_buffer(metal.device, sizeof(ParticleArguments), @"Particle arguments");
+    std::vector<uint32_t> dead(n);
+    std::iota(dead.begin(), dead.end(), 0u);
+    particles.deadList = uploader.upload(dead.data(), dead.size() * sizeof(uint32_t), @"Particle dead list");
+    const ParticleCounters counters = { (int32_t)n, { 0, 0 }, 0 };
+    particles.counters = uploader.upload(&counters, sizeof(counters), @"Particle counters");
+
+    particles.heightOrigin = { field.originX, field.originZ };
+    particles.heightSpacing = field.spacing;
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR32Float
+                                                                                    width:field.width
+                                                                                   height:field.depth
+                                                                                mipmapped:NO];
+    desc.usage = MTLTextureUsageShaderRead;
+    particles.heights = uploader.upload_texture(desc, field.heights.data(), field.width * sizeof(float),
+                                                @"Particle heights");
+    return particles;
+}
+
+void gpu_particles_update_heights(GpuParticles& particles, ResourceUploader& uploader, const HeightField& field) {
+    uploader.update_texture(particles.heights, height_region(particles), field.heights.data(),
+                            field.width * sizeof(float));
+}
+
+size_t gpu_particles_bytes(const GpuParticles& particles) {
+    return particles.particles.allocatedSize + particles.deadList.allocatedSize +
+           particles.aliveLists.allocatedSize + particles.keys.allocatedSize + particles.counters.allocatedSize +
+           particles.arguments.allocatedSize + particles.heights.allocatedSize;
+}
+
+void gpu_particles_add_passes(GpuParticles& particles, GpuRenderGraph& rg, const Camera& cam, float dt,
+                              simd::float3 emitterPosition, simd::float3 emitterDirection, GpuProfiler* profiler) {
+    const ParticleSettings& settings = particles.settings;
+    ParticleParams params;
+    params.emitterPosition = emitterPosition;
+    params.emitterDirection = emitterDirection;
+    params.cameraPosition = cam.position;
+    params.heightOrigin = particles.heightOrigin;
+    params.heightSpacing = particles.heightSpacing;
+    params.heightSize = { (uint32_t)particles.heights.width, (uint32_t)particles.heights.height };
+    params.dt = dt;
+    params.gravity = settings.gravity;
+    params.drag = settings.drag;
+    params.bounce = settings.bounce;
+    params.friction = settings.friction;
+    params.lifetime = settings.lifetime;
+    params.speed = settings.speed;
+    params.spread = settings.spread;
+    params.emitCount = particle_emit_count(particles.pending, settings.rate, dt, particles.capacity);
+    params.seed = ++particles.frame * 2654435761u;
+    params.capacity = particles.capacity;
+    params.parity = particles.parity;
+    // The survivors go to the other list, which the next frame starts from
+    particles.parity ^= 1u;
+
+    const GpuParticles* pool = &particles;
+    const uint32_t heights = gpu_render_graph_import(rg, particles.heights, "Particle heights");
+    const uint32_t pass = gpu_render_graph_compute_pass(
+        rg, "Particles",
+        ^(MTLComputePassDescriptor* passDesc) {
+            gpu_profiler_sample_compute_pass(profiler, passDesc, GPU_PASS_TRANSPARENT);
+        },
+        ^(id<MTLComputeCommandEncoder> compute) {
+            TRACE_PUSH_GROUP(compute, "Particle simulation");
+            const MTLSize group = MTLSizeMake(PARTICLE_GROUP_SIZE, 1, 1);
+            [compute setBytes:&params length:sizeof(params) atIndex:0];
+            [compute setBuffer:pool->particles offset:0 atIndex:1];
+            [compute setBuffer:pool->deadList offset:0 atIndex:2];
+            [compute setBuffer:pool->aliveLists offset:0 atIndex:3];
+            [compute setBuffer:pool->counters offset:0 atIndex:4];
+            [compute setBuffer:pool->keys offset:0 atIndex:5];
+            [compute setBuffer:pool->arguments offset:0 atIndex:6];
+            [compute setTexture:pool->heights atIndex:0];
+
+            // Dispatches of a serial encoder run in order; every count after the emission stays on the GPU
+            if (params.emitCount > 0) {
+                [compute setComputePipelineState:pool->emitPipeline];
+                [compute dispatchThreads:MTLSizeMake(params.emitCount, 1, 1) threadsPerThreadgroup:group];
+            }
+            [compute setComputePipelineState:pool->preparePipeline];
+            [compute dispatchThreadgroups:MTLSizeMake(1, 1, 1) threadsPerThreadgroup:MTLSizeMake(1, 1, 1)];
+            [compute setComputePipelineState:pool->simulatePipeline];
+            [compute dispatchThreadgroupsWithIndirectBuffer:pool->arguments
+                                       indirectBufferOffset:offsetof(ParticleArguments, simulate)
+                                      threadsPerThreadgroup:group];
+            [compute setComputePipelineState:pool->prepareSortPipeline];
+            [compute dispatchThreadgroups:MTLSizeMake(1, 1, 1) threadsPerThreadgroup:MTLSizeMake(1, 1, 1)];
+            [compute setComputePipelineState:pool->padPipeline];
+            [compute dispatchThreadgroupsWithIndirectBuffer:pool->arguments
+                                       indirectBufferOffset:offsetof(ParticleArguments, sort)
+                                      threadsPerThreadgroup:group];
+
+            // Every pass of the pool's sort, each sized to the survivors; see particle_sort_passes()
+            [compute setComputePipelineState:pool->sortPipeline];
+            for (const simd::uint2& sortPass : pool->sortPasses) {
+                [compute setBytes:&sortPass length:sizeof(sortPass) atIndex:0];
+                [compute dispatchThreadgroupsWithIndirectBuffer:pool->arguments
+                                           indirectBufferOffset:offsetof(ParticleArguments, sort)
+                                          threadsPerThreadgroup:group];
+            }
+            TRACE_POP_GROUP(compute);
+        });
+    render_graph_read(rg.graph, heights);
+    rg.graph.passes[pass].sideEffects = true;
+}
+
+void gpu_particles_draw(const GpuParticles& particles, id<MTLRenderCommandEncoder> enc, const Camera& cam,
+                        FrameStats& frameStats) {
+    ParticleDrawUniforms draw;
+    draw.color = particles.settings.color;
+    draw.right = cam.right;
+    draw.up = simd::normalize(simd::cross(cam.right, cam.forward));
+    draw.startSize = particles.settings.startSize;
+    draw.endSize = particles.settings.endSize;
+
+    TRACE_PUSH_GROUP(enc, "Particles");
+    [enc setRenderPipelineState:particles.drawPipeline];
+    [enc setVertexBytes:&draw length:sizeof(draw) atIndex:0];
+    [enc setVertexBuffer:particles.particles offset:0 atIndex:1];
+    [enc setVertexBuffer:particles.keys offset:0 atIndex:2];
+    [enc drawPrimitives:MTLPrimitiveTypeTriangleStrip
+              indirectBuffer:particles.arguments
+        indirectBufferOffset:offsetof(ParticleArguments, draw)];
+    TRACE_POP_GROUP(enc);
+    // The instance count stays on the GPU
+    frame_stats_count_draw(frameStats, 4, 0);
+}
@@ -0,0 +1,116 @@
+/**
+ * @file gpu_picking.hpp
+ * @brief The ID pass of picking.hpp: entities around a point drawn into a small target and read back.
+ *
+ * Nothing is drawn until a pick is requested. The next gpu_picking_encode() then culls the
+ * scene's entities against the magnified frustum of pick_projection(), draws the few that
+ * remain with one instanced draw per mesh into a PICK_TARGET_SIZE square of PickIds with a
+ * depth buffer of its own, and copies the IDs into a shared buffer at the end of the frame's
+ * command buffer. The frame never waits for it: the command buffer's completion marks the
+ * readback done, and gpu_picking_poll() resolves it on a later frame. One pick is in flight at
+ * a time; requests made meanwhile replace each other and go out once it has landed.
+ *
+ * Entities are drawn at full detail. Terrain, foliage and creatures are not drawn, so the
+ * picked entity is checked against the height field afterwards (pick_hidden_by_terrain()).
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "camera.hpp"
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "picking.hpp"
+#include "render_targets.hpp"
+#include "scene.hpp"
+
+/**
+ * @struct PickInstance
+ * @brief One entity of the ID pass; matches PickInstance in shaders.metal.
+ */
+struct PickInstance {
+    simd::float4x4 modelMatrix;     ///< Object to world transform.
+    PickId id;                      ///< Written to every texel the entity covers.
+    uint32_t padding[2];            ///< Keeps the stride a multiple of the matrix alignment.
+};
+
+/**
+ * @struct GpuPicking
+ * @brief The ID target, its readback and the pick in flight.
+ */
+struct GpuPicking {
+    id<MTLRenderPipelineState> pipeline;    ///< picking_vertex / picking_fragment.
+    id<MTLDepthStencilState> depthState;    ///< Nearest surface wins, for the camera's depth mapping.
+    id<MTLTexture> ids;                     ///< PICK_TARGET_SIZE square of PickIds.
+    TransientTarget depth;                  ///< Never kept, so memoryless where supported.
+    id<MTLBuffer> readback;                 ///< Shared copy of ids.
+    float clearDepth = 1.0f;                ///< The camera's far depth.
+
+    bool requested = false;                 ///< A pick waits to be encoded.
+    simd::float2 point = { 0.5f, 0.5f };    ///< Where the waiting pick looks, in [0, 1] across the view, y down.
+    std::shared_ptr<std::atomic<bool>> done; ///< Set by the command buffer of the pick in flight; null when idle.
+    PickRay ray;                            ///< The ray through the point of the pick in flight.
+
+    std::vector<uint32_t> visible;          ///< Entities inside the magnified frustum; keeps its capacity.
+    std::vector<uint32_t> meshRuns;         ///< First instance of each mesh's run, then the end; keeps its capacity.
+    uint32_t drawn = 0;                     ///< Entities drawn by the last pick.
+};
+
+/// @return True if the picking pipeline compiled.
+bool gpu_picking_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the ID target and its readback.
+ * @param metal The Metal context; its picking pipeline must exist.
+ * @param reverseZ True if the camera projects with reverse-Z.
+ * @return The picker, idle.
+ */
+GpuPicking create_gpu_picking(const MetalContext& metal, bool reverseZ);
+
+/**
+ * @brief Asks for the entity under a point; encoded by the next gpu_picking_encode() with no pick in flight.
+ * @param picking The picker.
+ * @param point The point, in [0, 1] across the view with y down.
+ */
+void gpu_picking_request(GpuPicking& picking, simd::float2 point);
+
+/**
+ * @brief Draws the ID pass of a waiting request and queues its readback; does nothing otherwise.
+ * @param picking The picker.
+ * @param cmd The frame's command buffer; the readback completes with it.
+ * @param scene The scene, with bounds up to date.
+ * @param meshRegistry The meshes the entities draw.
+ * @param uniformRing The frame ring the instances are written to.
+ * @param cam The unjittered camera.
+ * @param width Width of the view in pixels.
+ * @param height Height of the view in pixels.
+ * @param frameStats Receives the pass traffic and the draws.
+ */
+void gpu_picking_encode(GpuPicking& picking, id<MTLCommandBuffer> cmd, const SceneStore& scene,
+                        const MeshRegistry& meshRegistry, FrameRing& uniformRing, const Camera& cam, float width,
+                        float height, FrameStats& frameStats);
+
+/**
+ * @brief Collects the pick in flight if its readback has landed; never waits.
+ * @param picking The picker.
+ * @param scene The scene, to check the ID still names a live entity.
+ * @param picked Receives the entity, or a default Entity if nothing live was under the point.
+ * @param ray Receives the ray through the point, for pick_hidden_by_terrain().
+ * @return True if a pick landed.
+ */
+bool gpu_picking_poll(GpuPicking& picking, const SceneStore& scene, Entity& picked, PickRay& ray);
+
+/// @return True while a pick waits to be encoded or for its readback.
+inline bool gpu_picking_busy(const GpuPicking& picking) { return picking.requested || picking.done != nullptr; }
+
+/// @return GPU bytes of the ID target and its readback.
+size_t gpu_picking_bytes(const GpuPicking& picking);
@@ -0,0 +1,151 @@
+#import "gpu_picking.hpp"
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+bool gpu_picking_supported(const MetalContext& metal) {
+    return metal.picking_pipeline != nil;
+}
+
+GpuPicking create_gpu_picking(const MetalContext& metal, bool reverseZ) {
+    GpuPicking picking;
+    picking.pipeline = metal.picking_pipeline;
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = reverseZ ? MTLCompareFunctionGreater : MTLCompareFunctionLess;
+    depthDesc.depthWriteEnabled = YES;
+    picking.depthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+    picking.clearDepth = reverseZ ? 0.0f : 1.0f;
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRG32Uint
+                                                                                    width:PICK_TARGET_SIZE
+                                                                                   height:PICK_TARGET_SIZE
+                                                                                mipmapped:NO];
+    desc.usage = MTLTextureUsageRenderTarget;
+    desc.storageMode = MTLStorageModePrivate;
+    picking.ids = [metal.device newTextureWithDescriptor:desc];
+    picking.ids.label = @"Pick IDs";
+    picking.depth = create_transient_target(metal.device, MTLPixelFormatDepth32Float, PICK_TARGET_SIZE,
+                                            PICK_TARGET_SIZE, MTLTextureUsageRenderTarget, @"Pick depth");
+    picking.readback = [metal.device newBufferWithLength:PICK_TARGET_SIZE * PICK_TARGET_SIZE * sizeof(PickId)
+                                                 options:MTLResourceStorageModeShared];
+    picking.readback.label = @"Pick readback";
+    return picking;
+}
+
+void gpu_picking_request(GpuPicking& picking, simd::float2 point) {
+    picking.requested = true;
+    picking.point = point;
+}
+
+void gpu_picking_encode(GpuPicking& picking, id<MTLCommandBuffer> cmd, const SceneStore& scene,
+                        const MeshRegistry& meshRegistry, FrameRing& uniformRing, const Camera& cam, float width,
+                        float height, FrameStats& frameStats) {
+    if (!picking.requested || picking.done) {
+        return;
+    }
+    TRACE_SCOPE("Picking");
+    picking.requested = false;
+    const simd::float4x4 viewProjection =
+        pick_projection(cam.projectionMatrix, picking.point, width, height) * cam.viewMatrix;
+    picking.ray = pick_ray(cam.projectionMatrix * cam.viewMatrix, picking.point, cam.reverseZ);
+
+    // Sorted by mesh, so each mesh's entities are one run of instances
+    picking.visible.resize(scene.size());
+    picking.visible.resize(scene_cull(scene, extract_frustum(viewProjection), picking.visible.data()));
+    std::sort(picking.visible.begin(), picking.visible.end(),
+              [&](uint32_t a, uint32_t b) { return scene.meshes[a] < scene.meshes[b]; });
+    const uint32_t count = (uint32_t)picking.visible.size();
+    picking.meshRuns.clear();
+    FrameAllocation instances = {};
+    if (count > 0) {
+        instances = frame_ring_allocate(uniformRing, count * sizeof(PickInstance));
+        PickInstance* out = (PickInstance*)instances.contents;
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t index = picking.visible[i];
+            out[i].modelMatrix = scene.transforms[index];
+            out[i].id.slot = scene.owners[index] + 1;
+            out[i].id.generation = scene.generations[scene.owners[index]];
+            if (i == 0 || scene.meshes[index] != scene.meshes[picking.visible[i - 1]]) {
+                picking.meshRuns.push_back(i);
+            }
+        }
+        picking.meshRuns.push_back(count);
+    }
+    picking.drawn = count;
+
+    // Cleared to no entity, so an empty pass still reads back as a miss
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = picking.ids;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 0.0);
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    passDesc.depthAttachment.texture = transient_target_texture(picking.depth, false);
+    passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+    passDesc.depthAttachment.clearDepth = picking.clearDepth;
+    passDesc.depthAttachment.storeAction = MTLStoreActionDontCare;
+    frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Picking"));
+
+    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+    enc.label = @"Picking";
+    if (count > 0) {
+        TRACE_PUSH_GROUP(enc, "Entity IDs");
+        [enc setRenderPipelineState:picking.pipeline];
+        [enc setDepthStencilState:picking.depthState];
+        [enc setVertexBytes:&viewProjection length:sizeof(viewProjection) atIndex:1];
+        [enc setVertexBuffer:instances.buffer offset:instances.offset atIndex:2];
+        for (size_t run = 0; run + 1 < picking.meshRuns.size(); ++run) {
+            const uint32_t first = picking.meshRuns[run];
+            const uint32_t runCount = picking.meshRuns[run + 1] - first;
+            const GpuMesh& mesh = meshRegistry.meshes[scene.meshes[picking.visible[first]]];
+            [enc setVertexBuffer:mesh.vertexBuffer offset:0 atIndex:0];
+            [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                            indexCount:mesh.indexCount
+                             indexType:mesh.indexType
+                           indexBuffer:mesh.indexBuffer
+                     indexBufferOffset:gpu_mesh_index_offset(mesh)
+                         instanceCount:runCount
+                            baseVertex:mesh.baseVertex
+                          baseInstance:first];
+            frame_stats_count_draw(frameStats, mesh.indexCount, runCount);
+        }
+        TRACE_POP_GROUP(enc);
+    }
+    [enc endEncoding];
+
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    blit.label = @"Pick readback";
+    [blit copyFromTexture:picking.ids
+                     sourceSlice:0
+                     sourceLevel:0
+                    sourceOrigin:MTLOriginMake(0, 0, 0)
+                      sourceSize:MTLSizeMake(PICK_TARGET_SIZE, PICK_TARGET_SIZE, 1)
+                        toBuffer:picking.readback
+               destinationOffset:0
+          destinationBytesPerRow:PICK_TARGET_SIZE * sizeof(PickId)
+        destinationBytesPerImage:PICK_TARGET_SIZE * PICK_TARGET_SIZE * sizeof(PickId)];
+    [blit endEncoding];
+
+    // The handler only flips the flag; the readback is resolved on the main thread by gpu_picking_poll()
+    std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+    picking.done = done;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+        done->store(true, std::memory_order_release);
+    }];
+}
+
+bool gpu_picking_poll(GpuPicking& picking, const SceneStore& scene, Entity& picked, PickRay& ray) {
+    if (!picking.done || !picking.done->load(std::memory_order_acquire)) {
+        return false;
+    }
+    picking.done.reset();
+    const PickId* ids = (const PickId*)picking.readback.contents;
+    const uint32_t texel = pick_resolve(ids);
+    picked = texel == UINT32_MAX ? Entity{} : pick_entity(scene, ids[texel]);
+    ray = picking.ray;
+    return true;
+}
+
+size_t gpu_picking_bytes(const GpuPicking& picking) {
+    return picking.ids.allocatedSize + transient_target_bytes(picking.depth) + picking.readback.allocatedSize;
+}
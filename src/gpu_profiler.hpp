@@ -0,0 +1,115 @@
+/**
+ * @file gpu_profiler.hpp
+ * @brief Per-pass GPU times from timestamp counters sampled at render pass boundaries.
+ *
+ * Render passes tagged with a GpuPass sample the GPU timestamp counter when their vertex stage
+ * starts and their fragment stage ends, compute passes when they start and end. When the frame's last command buffer completes, its
+ * samples are resolved on the completion thread, summed per GpuPass and recorded with
+ * frame_stats_record_gpu_passes(). Apple GPUs only sample at stage boundaries, so passes that
+ * share a render pass, like terrain and objects, are timed together.
+ *
+ * Every function takes a nullable profiler and does nothing without one, so passing nullptr
+ * while profiling is off adds no sampling and no completion handlers.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "frame_stats.hpp"
+
+/// Frames whose samples can be in flight at once; a frame finding its slot busy is not timed.
+constexpr uint32_t GPU_PROFILER_FRAMES = 4;
+/// Render passes a frame can time; later passes are not sampled.
+constexpr uint32_t GPU_PROFILER_MAX_PASSES = 16;
+
+/**
+ * @struct GpuProfilerFrame
+ * @brief The passes one frame sampled into its range of the sample buffer.
+ */
+struct GpuProfilerFrame {
+    GpuPass passes[GPU_PROFILER_MAX_PASSES];    ///< Pass of each sampled render pass, in encoding order.
+    uint32_t passCount = 0;                     ///< Render passes sampled.
+    uint64_t frame = 0;                         ///< FrameStats frame number.
+    double nsPerTick = 1.0;                     ///< GPU timestamp period when the frame began.
+    std::atomic<bool> pending{ false };         ///< True from gpu_profiler_begin_frame until resolved.
+};
+
+/**
+ * @struct GpuClock
+ * @brief The GPU timestamp period, measured against the CPU clock.
+ */
+struct GpuClock {
+    id<MTLDevice> device;                       ///< Used to calibrate GPU against CPU timestamps.
+    MTLTimestamp calibrationCpu = 0;            ///< CPU nanoseconds of the last calibration.
+    MTLTimestamp calibrationGpu = 0;            ///< GPU ticks of the last calibration.
+    double nsPerTick = 1.0;                     ///< GPU timestamp period measured between calibrations.
+};
+
+/**
+ * @struct GpuProfiler
+ * @brief A timestamp sample buffer shared by a ring of frames.
+ */
+struct GpuProfiler {
+    GpuClock clock;                             ///< Converts the samples' ticks to nanoseconds.
+    id<MTLCounterSampleBuffer> samples;         ///< Two samples per pass, GPU_PROFILER_MAX_PASSES passes per frame.
+    std::shared_ptr<GpuProfilerFrame[]> frames; ///< GPU_PROFILER_FRAMES slots, shared with completion handlers.
+    uint32_t slot = 0;                          ///< Slot of the frame being encoded.
+    bool active = false;                        ///< True if the frame being encoded is sampled.
+};
+
+/// @return The device's timestamp counter set, or nil if it has none.
+id<MTLCounterSet> gpu_timestamp_counter_set(id<MTLDevice> device);
+
+/**
+ * @brief Measures the timestamp period again, at most twice a second; the period only drifts with clock changes.
+ * @param clock The clock; its first call only records the starting point.
+ */
+void gpu_clock_calibrate(GpuClock& clock);
+
+/// @return True if the device can sample timestamps at render stage boundaries.
+bool gpu_profiler_supported(id<MTLDevice> device);
+
+/**
+ * @brief Creates the profiler and its sample buffer.
+ * @param device The Metal device; must be supported.
+ * @return The profiler.
+ */
+GpuProfiler create_gpu_profiler(id<MTLDevice> device);
+
+/**
+ * @brief Starts sampling a frame, unless the frame's slot is still in flight.
+ * @param profiler The profiler, or nullptr.
+ * @param frame The FrameStats frame number.
+ */
+void gpu_profiler_begin_frame(GpuProfiler* profiler, uint64_t frame);
+
+/**
+ * @brief Makes a render pass sample the timestamps around its vertex and fragment stages.
+ * @param profiler The profiler, or nullptr.
+ * @param passDesc The render pass, before its encoder is created.
+ * @param pass The group the pass's time is added to.
+ */
+void gpu_profiler_sample_pass(GpuProfiler* profiler, MTLRenderPassDescriptor* passDesc, GpuPass pass);
+
+/**
+ * @brief Makes a compute pass sample the timestamps at its start and end.
+ * @param profiler The profiler, or nullptr.
+ * @param passDesc The compute pass, before its encoder is created.
+ * @param pass The group the pass's time is added to.
+ */
+void gpu_profiler_sample_compute_pass(GpuProfiler* profiler, MTLComputePassDescriptor* passDesc, GpuPass pass);
+
+/**
+ * @brief Resolves the frame's samples into stats once the frame's last command buffer completes.
+ *
+ * Command buffers of one queue complete in order, so this must be the last one the frame commits.
+ *
+ * @param profiler The profiler, or nullptr.
+ * @param cmd The last command buffer of the frame, before it is committed.
+ * @param stats Receives the pass times; must outlive the command buffer.
+ */
+void gpu_profiler_end_frame(GpuProfiler* profiler, id<MTLCommandBuffer> cmd, FrameStats& stats);
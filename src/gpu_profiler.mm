@@ -0,0 +1,144 @@
+#import "gpu_profiler.hpp"
+
+namespace {
+    // Recalibrate at most this often; the period only drifts with clock changes
+    const MTLTimestamp CALIBRATION_INTERVAL_NS = 500000000;
+
+    // Claims the next two samples of the frame for a pass; false if the frame is not sampled or full
+    bool reserve_samples(GpuProfiler* profiler, GpuPass pass, NSUInteger& first) {
+        if (!profiler || !profiler->active) {
+            return false;
+        }
+        GpuProfilerFrame& slot = profiler->frames[profiler->slot];
+        if (slot.passCount == GPU_PROFILER_MAX_PASSES) {
+            return false;
+        }
+        first = (profiler->slot * GPU_PROFILER_MAX_PASSES + slot.passCount) * 2;
+        slot.passes[slot.passCount++] = pass;
+        return true;
+    }
+}
+
+id<MTLCounterSet> gpu_timestamp_counter_set(id<MTLDevice> device) {
+    for (id<MTLCounterSet> set in device.counterSets) {
+        if ([set.name isEqualToString:MTLCommonCounterSetTimestamp]) {
+            return set;
+        }
+    }
+    return nil;
+}
+
+void gpu_clock_calibrate(GpuClock& clock) {
+    MTLTimestamp cpu = 0;
+    MTLTimestamp gpu = 0;
+    [clock.device sampleTimestamps:&cpu gpuTimestamp:&gpu];
+    if (clock.calibrationCpu != 0 && cpu - clock.calibrationCpu < CALIBRATION_INTERVAL_NS) {
+        return;
+    }
+    if (clock.calibrationCpu != 0 && gpu > clock.calibrationGpu) {
+        clock.nsPerTick = (double)(cpu - clock.calibrationCpu) / (double)(gpu - clock.calibrationGpu);
+    }
+    clock.calibrationCpu = cpu;
+    clock.calibrationGpu = gpu;
+}
+
+bool gpu_profiler_supported(id<MTLDevice> device) {
+    return gpu_timestamp_counter_set(device) != nil &&
+           [device supportsCounterSampling:MTLCounterSamplingPointAtStageBoundary];
+}
+
+GpuProfiler create_gpu_profiler(id<MTLDevice> device) {
+    GpuProfiler profiler;
+    profiler.clock.device = device;
+    profiler.frames = std::shared_ptr<GpuProfilerFrame[]>(new GpuProfilerFrame[GPU_PROFILER_FRAMES]);
+
+    MTLCounterSampleBufferDescriptor* desc = [MTLCounterSampleBufferDescriptor new];
+    desc.counterSet = gpu_timestamp_counter_set(device);
+    desc.storageMode = MTLStorageModeShared;
+    desc.sampleCount = GPU_PROFILER_FRAMES * GPU_PROFILER_MAX_PASSES * 2;
+    desc.label = @"GPU pass timestamps";
+    NSError* error = nil;
+    profiler.samples = [device newCounterSampleBufferWithDescriptor:desc error:&error];
+    if (!profiler.samples) {
+        NSLog(@"Failed to create the timestamp sample buffer: %@", error);
+    }
+    gpu_clock_calibrate(profiler.clock);
+    return profiler;
+}
+
+void gpu_profiler_begin_frame(GpuProfiler* profiler, uint64_t frame) {
+    if (!profiler || !profiler->samples) {
+        return;
+    }
+    profiler->slot = (profiler->slot + 1) % GPU_PROFILER_FRAMES;
+    GpuProfilerFrame& slot = profiler->frames[profiler->slot];
+    profiler->active = !slot.pending.load(std::memory_order_acquire);
+    if (!profiler->active) {
+        return;
+    }
+    gpu_clock_calibrate(profiler->clock);
+    slot.passCount = 0;
+    slot.frame = frame;
+    slot.nsPerTick = profiler->clock.nsPerTick;
+    slot.pending.store(true, std::memory_order_relaxed);
+}
+
+void gpu_profiler_sample_pass(GpuProfiler* profiler, MTLRenderPassDescriptor* passDesc, GpuPass pass) {
+    NSUInteger first = 0;
+    if (!reserve_samples(profiler, pass, first)) {
+        return;
+    }
+
+    // The vertex stage starts and the fragment stage ends the pass, even where tiles overlap them
+    MTLRenderPassSampleBufferAttachmentDescriptor* attachment = passDesc.sampleBufferAttachments[0];
+    attachment.sampleBuffer = profiler->samples;
+    attachment.startOfVertexSampleIndex = first;
+    attachment.endOfVertexSampleIndex = MTLCounterDontSample;
+    attachment.startOfFragmentSampleIndex = MTLCounterDontSample;
+    attachment.endOfFragmentSampleIndex = first + 1;
+}
+
+void gpu_profiler_sample_compute_pass(GpuProfiler* profiler, MTLComputePassDescriptor* passDesc, GpuPass pass) {
+    NSUInteger first = 0;
+    if (!reserve_samples(profiler, pass, first)) {
+        return;
+    }
+    MTLComputePassSampleBufferAttachmentDescriptor* attachment = passDesc.sampleBufferAttachments[0];
+    attachment.sampleBuffer = profiler->samples;
+    attachment.startOfEncoderSampleIndex = first;
+    attachment.endOfEncoderSampleIndex = first + 1;
+}
+
+void gpu_profiler_end_frame(GpuProfiler* profiler, id<MTLCommandBuffer> cmd, FrameStats& stats) {
+    if (!profiler || !profiler->active) {
+        return;
+    }
+    profiler->active = false;
+
+    // The handler keeps the slots and sample buffer alive if the profiler goes away first
+    std::shared_ptr<GpuProfilerFrame[]> frames = profiler->frames;
+    id<MTLCounterSampleBuffer> samples = profiler->samples;
+    const uint32_t index = profiler->slot;
+    FrameStats* statsPtr = &stats;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+        GpuProfilerFrame& slot = frames[index];
+        const NSRange range = NSMakeRange(index * GPU_PROFILER_MAX_PASSES * 2, slot.passCount * 2);
+        NSData* data = slot.passCount > 0 ? [samples resolveCounterRange:range] : nil;
+        const MTLCounterResultTimestamp* timestamps = (const MTLCounterResultTimestamp*)data.bytes;
+
+        GpuPassTimes passMs = {};
+        for (uint32_t i = 0; timestamps && i < slot.passCount; ++i) {
+            const uint64_t start = timestamps[i * 2].timestamp;
+            const uint64_t end = timestamps[i * 2 + 1].timestamp;
+            // Passes the GPU skipped or could not sample report an error value
+            if (start == MTLCounterErrorValue || end == MTLCounterErrorValue || end < start) {
+                continue;
+            }
+            passMs[slot.passes[i]] += (float)((end - start) * slot.nsPerTick * 1e-6);
+        }
+        if (timestamps) {
+            frame_stats_record_gpu_passes(*statsPtr, slot.frame, passMs);
+        }
+        slot.pending.store(false, std::memory_order_release);
+    }];
+}
@@ -0,0 +1,84 @@
+/**
+ * @file gpu_rasterization_rate.hpp
+ * @brief The scene pass drawn through a rasterization rate map and stretched back to the screen.
+ *
+ * With a rate map set on its descriptor, the scene pass keeps the screen's coordinates (its
+ * default viewport and the fragments' positions) but rasterizes into physical targets smaller
+ * than the screen, shading each zone of rasterization_rate.hpp's profile at its rate. The
+ * result is not viewable as it is: gpu_rasterization_rate_resolve() draws it into a
+ * screen-sized target, mapping every screen pixel to its physical position through the map's
+ * parameter buffer, before anything reads the scene in screen space.
+ *
+ * Every attachment of a rate-mapped pass must have the physical size, and passes after it that
+ * read its depth or colour in screen space would need the map too, so the caller keeps the
+ * screen-space passes (Hi-Z culling, ambient occlusion, the transparent pass, the light
+ * clusters and the shading cache) and the upscaler off while it is used.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_stats.hpp"
+#include "metal_context.hpp"
+#include "rasterization_rate.hpp"
+#include "render_targets.hpp"
+
+/**
+ * @struct GpuRasterizationRate
+ * @brief The rate map, the physical targets it is drawn into and the resolve.
+ *
+ * Recreated together whenever the screen size or the settings change; frames in flight keep
+ * the old ones alive through their command buffers.
+ */
+struct GpuRasterizationRate {
+    id<MTLDevice> device;                       ///< Device the map and targets are created on.
+    id<MTLRenderPipelineState> resolvePipeline; ///< composite_vertex / rate_map_resolve_fragment.
+    RasterizationRateSettings settings;         ///< The profile the next configure builds.
+    RasterizationRateSettings built;            ///< The profile map was built with.
+    id<MTLRasterizationRateMap> map;            ///< nil until configured.
+    id<MTLBuffer> parameters;                   ///< The map's parameter data, read by the resolve.
+    id<MTLTexture> color;                       ///< Scene colour at the physical size.
+    TransientTarget depth;                      ///< Scene depth at the physical size.
+    uint32_t screenWidth = 0;                   ///< Width the map covers, in screen pixels.
+    uint32_t screenHeight = 0;                  ///< Height the map covers, in screen pixels.
+    uint32_t physicalWidth = 0;                 ///< Width of the targets.
+    uint32_t physicalHeight = 0;                ///< Height of the targets.
+};
+
+/// @return True if the device can rasterize through a rate map and the resolve pipeline compiled.
+bool gpu_rasterization_rate_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the rate map holder without a map; gpu_rasterization_rate_configure() builds it.
+ * @param metal The Metal context; gpu_rasterization_rate_supported() must be true.
+ * @return The holder.
+ */
+GpuRasterizationRate create_gpu_rasterization_rate(const MetalContext& metal);
+
+/// @return True if the map and targets match a screen size and the current settings.
+bool gpu_rasterization_rate_current(const GpuRasterizationRate& rr, uint32_t width, uint32_t height);
+
+/**
+ * @brief Builds the map and its targets for a screen size and the current settings, unless they match already.
+ * @param rr The holder.
+ * @param width The screen width in pixels.
+ * @param height The screen height in pixels.
+ * @return True if anything was recreated.
+ */
+bool gpu_rasterization_rate_configure(GpuRasterizationRate& rr, uint32_t width, uint32_t height);
+
+/**
+ * @brief Stretches the scene colour back to the screen.
+ * @param rr The holder, configured for output's size.
+ * @param cmd The command buffer, after the scene pass and anything else that draws through the map.
+ * @param output The screen-sized colour target; every pixel is written.
+ * @param frameStats Receives the pass traffic and the shaded pixels.
+ */
+void gpu_rasterization_rate_resolve(const GpuRasterizationRate& rr, id<MTLCommandBuffer> cmd, id<MTLTexture> output,
+                                    FrameStats& frameStats);
+
+/// @return GPU bytes of the physical targets and the parameter buffer.
+size_t gpu_rasterization_rate_bytes(const GpuRasterizationRate& rr);
@@ -0,0 +1,97 @@
+#import "gpu_rasterization_rate.hpp"
+
+#include "trace.hpp"
+
+bool gpu_rasterization_rate_supported(const MetalContext& metal) {
+    return metal.rate_map_resolve_pipeline != nil && [metal.device supportsRasterizationRateMapWithLayerCount:1];
+}
+
+GpuRasterizationRate create_gpu_rasterization_rate(const MetalContext& metal) {
+    GpuRasterizationRate rr;
+    rr.device = metal.device;
+    rr.resolvePipeline = metal.rate_map_resolve_pipeline;
+    return rr;
+}
+
+bool gpu_rasterization_rate_current(const GpuRasterizationRate& rr, uint32_t width, uint32_t height) {
+    const RasterizationRateSettings& a = rr.settings;
+    const RasterizationRateSettings& b = rr.built;
+    return rr.map && rr.screenWidth == width && rr.screenHeight == height && a.edgeRate == b.edgeRate &&
+           a.skyRate == b.skyRate && a.fovea == b.fovea && a.skyBand == b.skyBand;
+}
+
+bool gpu_rasterization_rate_configure(GpuRasterizationRate& rr, uint32_t width, uint32_t height) {
+    if (gpu_rasterization_rate_current(rr, width, height)) {
+        return false;
+    }
+    rr.built = rr.settings;
+    rr.screenWidth = width;
+    rr.screenHeight = height;
+    rr.map = nil;
+    rr.parameters = nil;
+    rr.color = nil;
+    rr.depth = {};
+
+    float horizontal[RATE_MAP_ZONES];
+    float vertical[RATE_MAP_ZONES];
+    rasterization_rate_profile(rr.settings, horizontal, vertical);
+    const MTLSize zones = MTLSizeMake(RATE_MAP_ZONES, RATE_MAP_ZONES, 0);
+    MTLRasterizationRateLayerDescriptor* layer = [[MTLRasterizationRateLayerDescriptor alloc] initWithSampleCount:zones];
+    for (uint32_t i = 0; i < RATE_MAP_ZONES; ++i) {
+        layer.horizontalSampleStorage[i] = horizontal[i];
+        layer.verticalSampleStorage[i] = vertical[i];
+    }
+    MTLRasterizationRateMapDescriptor* desc =
+        [MTLRasterizationRateMapDescriptor rasterizationRateMapDescriptorWithScreenSize:MTLSizeMake(width, height, 0)
+                                                                                  layer:layer];
+    desc.label = @"Scene rate map";
+    rr.map = [rr.device newRasterizationRateMapWithDescriptor:desc];
+    if (!rr.map) {
+        NSLog(@"Failed to create the rasterization rate map for %ux%u", width, height);
+        return true;
+    }
+
+    const MTLSizeAndAlign parameterSize = rr.map.parameterBufferSizeAndAlign;
+    rr.parameters = [rr.device newBufferWithLength:parameterSize.size options:MTLResourceStorageModeShared];
+    rr.parameters.label = @"Rate map parameters";
+    [rr.map copyParameterDataToBuffer:rr.parameters offset:0];
+
+    const MTLSize physical = [rr.map physicalSizeForLayer:0];
+    rr.physicalWidth = (uint32_t)physical.width;
+    rr.physicalHeight = (uint32_t)physical.height;
+    MTLTextureDescriptor* colorDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                                                         width:rr.physicalWidth
+                                                                                        height:rr.physicalHeight
+                                                                                     mipmapped:NO];
+    colorDesc.storageMode = MTLStorageModePrivate;
+    colorDesc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+    rr.color = [rr.device newTextureWithDescriptor:colorDesc];
+    rr.color.label = @"Rate-mapped scene colour";
+    rr.depth = create_transient_target(rr.device, MTLPixelFormatDepth32Float, rr.physicalWidth, rr.physicalHeight,
+                                       MTLTextureUsageRenderTarget, @"Rate-mapped scene depth");
+    return true;
+}
+
+void gpu_rasterization_rate_resolve(const GpuRasterizationRate& rr, id<MTLCommandBuffer> cmd, id<MTLTexture> output,
+                                    FrameStats& frameStats) {
+    TRACE_SCOPE("Rate map resolve");
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = output;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionDontCare;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Rate map resolve"));
+    frame_stats_count_rasterization(frameStats, (uint64_t)rr.screenWidth * rr.screenHeight,
+                                    (uint64_t)rr.physicalWidth * rr.physicalHeight);
+
+    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+    enc.label = @"Rate map resolve";
+    [enc setRenderPipelineState:rr.resolvePipeline];
+    [enc setFragmentBuffer:rr.parameters offset:0 atIndex:0];
+    [enc setFragmentTexture:rr.color atIndex:0];
+    [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+    [enc endEncoding];
+}
+
+size_t gpu_rasterization_rate_bytes(const GpuRasterizationRate& rr) {
+    return rr.color.allocatedSize + transient_target_bytes(rr.depth) + rr.parameters.allocatedSize;
+}
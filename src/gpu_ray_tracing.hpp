@@ -0,0 +1,155 @@
+/**
+ * @file gpu_ray_tracing.hpp
+ * @brief Acceleration structures over the terrain and the entities, for ray-traced shadows and occlusion.
+ *
+ * The high quality tier of the shadows and the ambient occlusion, on GPUs that can trace rays
+ * from render pipelines. Every resident chunk within RayTracingSettings::radius of the camera
+ * gets a primitive acceleration structure over its full-detail triangles, read in place from its
+ * vertex buffer and the shared LOD index buffer, and every mesh an entity draws gets one too.
+ * One instance acceleration structure places them in the world: chunks by their model matrix,
+ * which also undoes the quantization of packed vertices, entities by their transforms.
+ *
+ * Building is amortized over frames. Chunks streamed in wait nearest first, and at most
+ * buildsPerFrame primitive structures are built a frame, so a burst of streaming spreads over
+ * several frames and the chunks not yet built cast no shadow meanwhile. An edit patches a chunk
+ * without changing its triangles, so its structure is refit in place instead of rebuilt. The
+ * instance structure is rebuilt when the set of structures or the entity count changes and
+ * refit to the moved entities otherwise. Structures of chunks that were evicted or left the
+ * radius are released once the frames that may still trace them have completed.
+ *
+ * ShaderVariant::rayTracedShadows fragments trace one ray towards the sun through the instance
+ * structure at RAY_TRACING_BUFFER_INDEX instead of sampling the shadow map, and given one,
+ * gpu_ambient_occlusion_add_passes() traces short hemisphere rays instead of searching the
+ * depth. Height-map chunks have no vertex buffer, and foliage and creatures are placed on the
+ * GPU; neither casts ray-traced shadows.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "chunk_manager.hpp"
+#include "frame_ring.hpp"
+#include "gpu_residency.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "scene.hpp"
+
+/// Fragment buffer index of the instance acceleration structure; matches shaders.metal.
+constexpr uint32_t RAY_TRACING_BUFFER_INDEX = 13;
+
+/**
+ * @struct RayTracingSettings
+ * @brief How much of the world is traced and how fast it is built.
+ */
+struct RayTracingSettings {
+    float radius = 768.0f;          ///< World distance from the camera within which chunks get a structure.
+    uint32_t buildsPerFrame = 4;    ///< Primitive structures built per frame at most; refits are not counted.
+};
+
+/**
+ * @struct RayTracedChunk
+ * @brief The primitive acceleration structure of one resident chunk.
+ */
+struct RayTracedChunk {
+    ChunkKey key;                               ///< The chunk.
+    id<MTLAccelerationStructure> structure;     ///< Its triangles in the chunk's vertex space.
+    id<MTLBuffer> vertexBuffer;                 ///< The buffer it was built from; a rebuilt chunk has another.
+    uint64_t editVersion = 0;                   ///< ResidentChunk::editVersion it was built or last refit at.
+    simd::float4x4 modelMatrix;                 ///< ResidentChunk::modelMatrix, its instance transform.
+    uint64_t seen = 0;                          ///< Last update that found the chunk resident and in reach.
+};
+
+/**
+ * @struct RayTracingBuild
+ * @brief One build or refit gpu_ray_tracing_update() encodes.
+ */
+struct RayTracingBuild {
+    MTLAccelerationStructureDescriptor* descriptor; ///< The geometry or instances.
+    id<MTLAccelerationStructure> structure;         ///< Built into, or refit in place.
+    bool refit = false;                             ///< Refit rather than build.
+    NSUInteger scratchSize = 0;                     ///< Scratch bytes it needs.
+};
+
+/**
+ * @struct GpuRayTracing
+ * @brief The acceleration structures and what they were built from.
+ */
+struct GpuRayTracing {
+    id<MTLDevice> device;
+    RayTracingSettings settings;
+    std::vector<RayTracedChunk> chunks;                     ///< Built chunks.
+    std::unordered_map<ChunkKey, uint32_t, ChunkKeyHash> chunkSlots; ///< Index of each built chunk in chunks.
+    std::vector<id<MTLAccelerationStructure>> meshes;       ///< Per MeshRegistry mesh; nil until built.
+    std::vector<uint32_t> meshSlots;                        ///< Index of each built mesh's structure in instanced.
+    id<MTLAccelerationStructure> instances;                 ///< Over chunks and entities; nil until first built.
+    NSArray<id<MTLAccelerationStructure>>* instanced;       ///< Structures instances indexes: chunks, then meshes.
+    std::vector<id<MTLResource>> resources;                 ///< instanced, for encoders to declare.
+    uint32_t instanceCount = 0;                             ///< Instances of the last instance build.
+    bool changed = true;                                    ///< instanced is out of date.
+    id<MTLBuffer> scratch;                                  ///< Shared by the builds and refits of a frame.
+    std::vector<RayTracingBuild> builds;                    ///< This frame's builds; keeps its capacity.
+    std::vector<std::pair<float, uint32_t>> pending;        ///< Distance and resident index of unbuilt chunks.
+    std::deque<std::pair<uint64_t, id<MTLResource>>> retired; ///< Replaced resources and the update that drops them.
+    uint64_t frame = 0;                                     ///< Number of gpu_ray_tracing_update() calls.
+    GpuResidency* residency = nullptr;                      ///< Holds the structures if set; encoders declare none.
+};
+
+/// @return True if the OS and device can trace rays from compute and render pipelines.
+bool gpu_ray_tracing_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the tracker; nothing is built until the first update.
+ * @param metal The Metal context; gpu_ray_tracing_supported() must be true.
+ * @return The tracker.
+ */
+GpuRayTracing create_gpu_ray_tracing(const MetalContext& metal);
+
+/**
+ * @brief Brings the structures up to date with the streamed chunks and the entities.
+ *
+ * Encodes this frame's share of the primitive builds and refits into cmd, then the instance
+ * structure's build or refit in an encoder of its own, after them. Must be encoded after the
+ * waits on the chunks' uploads and the edit patches, and before anything that traces rays.
+ * Call once per frame.
+ *
+ * @param rt The tracker.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager The terrain.
+ * @param meshRegistry The meshes the entities draw.
+ * @param scene The entities.
+ * @param uniformRing The frame ring the instance descriptors are written to.
+ * @param eye The camera position chunks are kept and built by distance from.
+ */
+void gpu_ray_tracing_update(GpuRayTracing& rt, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                            const MeshRegistry& meshRegistry, const SceneStore& scene, FrameRing& uniformRing,
+                            simd::float3 eye);
+
+/// @return True once an instance structure exists for shaders to trace.
+inline bool gpu_ray_tracing_ready(const GpuRayTracing& rt) { return rt.instances != nil; }
+
+/// @brief Binds the instance structure for the fragment stage at RAY_TRACING_BUFFER_INDEX; must be ready.
+void gpu_ray_tracing_bind(const GpuRayTracing& rt, id<MTLRenderCommandEncoder> enc);
+
+/// @brief Binds the instance structure for a kernel at a buffer index; must be ready.
+void gpu_ray_tracing_bind(const GpuRayTracing& rt, id<MTLComputeCommandEncoder> enc, uint32_t index);
+
+/**
+ * @brief Keeps the structures resident through a residency set from now on.
+ * @param rt The tracker.
+ * @param residency The set; the structures built so far are added to it.
+ */
+void gpu_ray_tracing_set_residency(GpuRayTracing& rt, GpuResidency* residency);
+
+/// @return Chunks in reach that have no structure yet, as of the last update.
+inline size_t gpu_ray_tracing_pending_count(const GpuRayTracing& rt) { return rt.pending.size(); }
+
+/// @return GPU bytes of the structures and the scratch buffer.
+size_t gpu_ray_tracing_bytes(const GpuRayTracing& rt);
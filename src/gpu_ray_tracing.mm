@@ -0,0 +1,362 @@
+#import "gpu_ray_tracing.hpp"
+
+#include <algorithm>
+
+#include "fog.hpp"
+#include "objects.hpp"
+#include "trace.hpp"
+
+namespace {
+    // Builds of one encoder run concurrently, so each gets its own aligned part of the scratch buffer
+    constexpr NSUInteger SCRATCH_ALIGNMENT = 256;
+
+    NSUInteger align_scratch(NSUInteger size) {
+        return (size + SCRATCH_ALIGNMENT - 1) & ~(SCRATCH_ALIGNMENT - 1);
+    }
+
+    // Kept until the frames that may still trace or build with it have completed
+    void retire(GpuRayTracing& rt, id<MTLResource> resource) {
+        if (resource) {
+            rt.retired.emplace_back(rt.frame + DEFAULT_FRAMES_IN_FLIGHT, resource);
+        }
+    }
+
+    MTLPrimitiveAccelerationStructureDescriptor* triangle_descriptor(id<MTLBuffer> vertices, NSUInteger vertexOffset,
+                                                                     NSUInteger stride, MTLAttributeFormat format,
+                                                                     id<MTLBuffer> indices, NSUInteger indexOffset,
+                                                                     MTLIndexType indexType, uint32_t indexCount)
+        API_AVAILABLE(macos(13.0)) {
+        MTLAccelerationStructureTriangleGeometryDescriptor* geometry =
+            [MTLAccelerationStructureTriangleGeometryDescriptor descriptor];
+        geometry.vertexBuffer = vertices;
+        geometry.vertexBufferOffset = vertexOffset;
+        geometry.vertexStride = stride;
+        geometry.vertexFormat = format;
+        geometry.indexBuffer = indices;
+        geometry.indexBufferOffset = indexOffset;
+        geometry.indexType = indexType;
+        geometry.triangleCount = indexCount / 3;
+        geometry.opaque = YES;
+        MTLPrimitiveAccelerationStructureDescriptor* desc = [MTLPrimitiveAccelerationStructureDescriptor descriptor];
+        desc.geometryDescriptors = @[ geometry ];
+        return desc;
+    }
+
+    // The full-detail triangles of a chunk; packed positions are read as unorm, like the vertex fetch does
+    MTLPrimitiveAccelerationStructureDescriptor* chunk_descriptor(const ChunkManager& chunkManager,
+                                                                  const ResidentChunk& chunk)
+        API_AVAILABLE(macos(13.0)) {
+        const VertexFormat format = chunkManager.config().vertexFormat;
+        const IndexRange& range = chunkManager.lod_index_range(0, 0);
+        MTLPrimitiveAccelerationStructureDescriptor* desc = triangle_descriptor(
+            chunk.mesh.vertexBuffer, 0, vertex_stride(format),
+            format == VertexFormat::Packed ? MTLAttributeFormatUShort4Normalized : MTLAttributeFormatFloat3,
+            chunkManager.lod_index_buffer(), range.offset * metal_index_size(chunkManager.lod_index_type()),
+            chunkManager.lod_index_type(), range.count);
+        // Edits move vertices but keep the triangles, which a refit handles
+        desc.usage = MTLAccelerationStructureUsageRefit;
+        return desc;
+    }
+
+    MTLPrimitiveAccelerationStructureDescriptor* mesh_descriptor(const GpuMesh& mesh) API_AVAILABLE(macos(13.0)) {
+        // The acceleration structure has no base vertex, so a shared buffer is offset to the mesh's first vertex
+        return triangle_descriptor(mesh.vertexBuffer, mesh.baseVertex * sizeof(Vertex), sizeof(Vertex),
+                                   MTLAttributeFormatFloat3, mesh.indexBuffer, gpu_mesh_index_offset(mesh),
+                                   mesh.indexType, mesh.indexCount);
+    }
+
+    // Queues a build into a new structure of the size the descriptor needs
+    id<MTLAccelerationStructure> queue_build(GpuRayTracing& rt, MTLAccelerationStructureDescriptor* desc) {
+        const MTLAccelerationStructureSizes sizes = [rt.device accelerationStructureSizesWithDescriptor:desc];
+        id<MTLAccelerationStructure> structure =
+            [rt.device newAccelerationStructureWithSize:sizes.accelerationStructureSize];
+        if (rt.residency) {
+            rt.residency->add(structure);
+        }
+        rt.builds.push_back({ desc, structure, false, sizes.buildScratchBufferSize });
+        return structure;
+    }
+
+    void queue_refit(GpuRayTracing& rt, MTLAccelerationStructureDescriptor* desc,
+                     id<MTLAccelerationStructure> structure) {
+        const MTLAccelerationStructureSizes sizes = [rt.device accelerationStructureSizesWithDescriptor:desc];
+        rt.builds.push_back({ desc, structure, true, sizes.refitScratchBufferSize });
+    }
+
+    void encode_build(id<MTLAccelerationStructureCommandEncoder> enc, const RayTracingBuild& build,
+                      id<MTLBuffer> scratch, NSUInteger offset) {
+        if (build.refit) {
+            [enc refitAccelerationStructure:build.structure descriptor:build.descriptor destination:nil
+                              scratchBuffer:scratch scratchBufferOffset:offset];
+        } else {
+            [enc buildAccelerationStructure:build.structure descriptor:build.descriptor scratchBuffer:scratch
+                        scratchBufferOffset:offset];
+        }
+    }
+
+    MTLAccelerationStructureInstanceDescriptor instance_descriptor(const simd::float4x4& transform, uint32_t index) {
+        MTLAccelerationStructureInstanceDescriptor instance = {};
+        for (int c = 0; c < 4; ++c) {
+            instance.transformationMatrix.columns[c] =
+                MTLPackedFloat3Make(transform.columns[c].x, transform.columns[c].y, transform.columns[c].z);
+        }
+        // Shadow and occlusion rays only ask whether anything is in the way, from either side
+        instance.options =
+            MTLAccelerationStructureInstanceOptionOpaque | MTLAccelerationStructureInstanceOptionDisableTriangleCulling;
+        instance.mask = 0xFF;
+        instance.accelerationStructureIndex = index;
+        return instance;
+    }
+}
+
+bool gpu_ray_tracing_supported(const MetalContext& metal) {
+    if (@available(macOS 13.0, *)) {
+        return metal.device.supportsRaytracing && metal.device.supportsRaytracingFromRender;
+    }
+    return false;
+}
+
+GpuRayTracing create_gpu_ray_tracing(const MetalContext& metal) {
+    GpuRayTracing rt;
+    rt.device = metal.device;
+    return rt;
+}
+
+void gpu_ray_tracing_update(GpuRayTracing& rt, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                            const MeshRegistry& meshRegistry, const SceneStore& scene, FrameRing& uniformRing,
+                            simd::float3 eye) {
+    if (@available(macOS 13.0, *)) {
+        TRACE_SCOPE("Update acceleration structures");
+        rt.frame++;
+        while (!rt.retired.empty() && rt.retired.front().first <= rt.frame) {
+            if (rt.residency) {
+                rt.residency->remove(rt.retired.front().second);
+            }
+            rt.retired.pop_front();
+        }
+        rt.builds.clear();
+        rt.pending.clear();
+
+        // Refit the chunks an edit patched; queue the ones in reach without a structure
+        const std::vector<ResidentChunk>& resident = chunkManager.resident();
+        for (uint32_t i = 0; i < (uint32_t)resident.size(); ++i) {
+            const ResidentChunk& chunk = resident[i];
+            // Height-map chunks have no triangles to build from
+            if (!chunk.mesh.vertexBuffer) {
+                continue;
+            }
+            const float distance = box_distance(chunk.bounds, eye);
+            if (distance > rt.settings.radius) {
+                continue;
+            }
+            auto slot = rt.chunkSlots.find(chunk.key);
+            if (slot == rt.chunkSlots.end()) {
+                rt.pending.push_back({ distance, i });
+                continue;
+            }
+            RayTracedChunk& built = rt.chunks[slot->second];
+            if (built.vertexBuffer != chunk.mesh.vertexBuffer) {
+                // Regenerated into another buffer; the old structure is dropped below
+                rt.pending.push_back({ distance, i });
+                continue;
+            }
+            built.seen = rt.frame;
+            if (built.editVersion != chunk.editVersion) {
+                queue_refit(rt, chunk_descriptor(chunkManager, chunk), built.structure);
+                built.editVersion = chunk.editVersion;
+            }
+        }
+
+        // Drop the chunks that were evicted, regenerated or left the radius
+        for (size_t i = 0; i < rt.chunks.size();) {
+            if (rt.chunks[i].seen == rt.frame) {
+                ++i;
+                continue;
+            }
+            retire(rt, rt.chunks[i].structure);
+            rt.chunkSlots.erase(rt.chunks[i].key);
+            if (i + 1 < rt.chunks.size()) {
+                rt.chunks[i] = rt.chunks.back();
+                rt.chunkSlots[rt.chunks[i].key] = (uint32_t)i;
+            }
+            rt.chunks.pop_back();
+            rt.changed = true;
+        }
+
+        // This frame's share of the builds: the entities' meshes first, there are few of them, then
+        // the nearest chunks
+        uint32_t budget = rt.settings.buildsPerFrame;
+        if (rt.meshes.size() != meshRegistry.meshes.size()) {
+            rt.meshes.resize(meshRegistry.meshes.size());
+            rt.changed = true;
+        }
+        for (uint32_t mesh : scene.meshes) {
+            if (budget == 0) {
+                break;
+            }
+            if (!rt.meshes[mesh]) {
+                rt.meshes[mesh] = queue_build(rt, mesh_descriptor(meshRegistry.meshes[mesh]));
+                rt.changed = true;
+                budget--;
+            }
+        }
+        const size_t chunkBuilds = std::min<size_t>(rt.pending.size(), budget);
+        std::partial_sort(rt.pending.begin(), rt.pending.begin() + chunkBuilds, rt.pending.end());
+        for (size_t i = 0; i < chunkBuilds; ++i) {
+            const ResidentChunk& chunk = resident[rt.pending[i].second];
+            RayTracedChunk built;
+            built.key = chunk.key;
+            built.structure = queue_build(rt, chunk_descriptor(chunkManager, chunk));
+            built.vertexBuffer = chunk.mesh.vertexBuffer;
+            built.editVersion = chunk.editVersion;
+            built.modelMatrix = chunk.modelMatrix;
+            built.seen = rt.frame;
+            rt.chunkSlots[chunk.key] = (uint32_t)rt.chunks.size();
+            rt.chunks.push_back(built);
+            rt.changed = true;
+        }
+        rt.pending.erase(rt.pending.begin(), rt.pending.begin() + chunkBuilds);
+
+        if (rt.changed) {
+            NSMutableArray<id<MTLAccelerationStructure>>* instanced = [NSMutableArray array];
+            rt.resources.clear();
+            for (const RayTracedChunk& chunk : rt.chunks) {
+                [instanced addObject:chunk.structure];
+                rt.resources.push_back(chunk.structure);
+            }
+            rt.meshSlots.assign(rt.meshes.size(), UINT32_MAX);
+            for (size_t mesh = 0; mesh < rt.meshes.size(); ++mesh) {
+                if (rt.meshes[mesh]) {
+                    rt.meshSlots[mesh] = (uint32_t)instanced.count;
+                    [instanced addObject:rt.meshes[mesh]];
+                    rt.resources.push_back(rt.meshes[mesh]);
+                }
+            }
+            rt.instanced = instanced;
+        }
+        uint32_t instanceCount = (uint32_t)rt.chunks.size();
+        for (uint32_t mesh : scene.meshes) {
+            instanceCount += rt.meshSlots[mesh] != UINT32_MAX ? 1 : 0;
+        }
+
+        // Nothing left to trace: the old structure may reference released ones, so it goes too
+        if (instanceCount == 0) {
+            retire(rt, rt.instances);
+            rt.instances = nil;
+            rt.instanceCount = 0;
+        }
+        const bool rebuild = instanceCount > 0 && (rt.changed || instanceCount != rt.instanceCount);
+        // Moved entities and refit chunks change the bounds the instance structure was built over
+        const bool refit = instanceCount > 0 && !rebuild && (scene.size() > 0 || !rt.builds.empty());
+        rt.changed = false;
+        if (rt.builds.empty() && !rebuild && !refit) {
+            return;
+        }
+
+        RayTracingBuild instances;
+        if (rebuild || refit) {
+            FrameAllocation slot =
+                frame_ring_allocate(uniformRing, instanceCount * sizeof(MTLAccelerationStructureInstanceDescriptor));
+            auto* out = (MTLAccelerationStructureInstanceDescriptor*)slot.contents;
+            uint32_t count = 0;
+            for (uint32_t i = 0; i < (uint32_t)rt.chunks.size(); ++i) {
+                out[count++] = instance_descriptor(rt.chunks[i].modelMatrix, i);
+            }
+            for (size_t i = 0; i < scene.size(); ++i) {
+                const uint32_t index = rt.meshSlots[scene.meshes[i]];
+                if (index != UINT32_MAX) {
+                    out[count++] = instance_descriptor(scene.transforms[i], index);
+                }
+            }
+            MTLInstanceAccelerationStructureDescriptor* desc = [MTLInstanceAccelerationStructureDescriptor descriptor];
+            desc.instancedAccelerationStructures = rt.instanced;
+            desc.instanceCount = instanceCount;
+            desc.instanceDescriptorBuffer = slot.buffer;
+            desc.instanceDescriptorBufferOffset = slot.offset;
+            desc.instanceDescriptorType = MTLAccelerationStructureInstanceDescriptorTypeDefault;
+            desc.usage = MTLAccelerationStructureUsageRefit;
+            const MTLAccelerationStructureSizes sizes = [rt.device accelerationStructureSizesWithDescriptor:desc];
+            if (rebuild && (!rt.instances || rt.instances.size < sizes.accelerationStructureSize)) {
+                retire(rt, rt.instances);
+                rt.instances = [rt.device newAccelerationStructureWithSize:sizes.accelerationStructureSize];
+                rt.instances.label = @"Scene instances";
+                if (rt.residency) {
+                    rt.residency->add(rt.instances);
+                }
+            }
+            instances = { desc, rt.instances, refit,
+                          refit ? sizes.refitScratchBufferSize : sizes.buildScratchBufferSize };
+            rt.instanceCount = instanceCount;
+        }
+
+        NSUInteger scratchBytes = align_scratch(instances.scratchSize);
+        for (const RayTracingBuild& build : rt.builds) {
+            scratchBytes += align_scratch(build.scratchSize);
+        }
+        if (!rt.scratch || rt.scratch.length < scratchBytes) {
+            retire(rt, rt.scratch);
+            rt.scratch = [rt.device newBufferWithLength:std::max<NSUInteger>(scratchBytes, 2 * rt.scratch.length)
+                                                options:MTLResourceStorageModePrivate];
+            rt.scratch.label = @"Acceleration structure scratch";
+        }
+
+        NSUInteger offset = 0;
+        if (!rt.builds.empty()) {
+            id<MTLAccelerationStructureCommandEncoder> enc = [cmd accelerationStructureCommandEncoder];
+            enc.label = @"Chunk and mesh structures";
+            for (const RayTracingBuild& build : rt.builds) {
+                encode_build(enc, build, rt.scratch, offset);
+                offset += align_scratch(build.scratchSize);
+            }
+            [enc endEncoding];
+        }
+        // The instance build reads the structures above, so it waits for their encoder to finish
+        if (instances.structure) {
+            id<MTLAccelerationStructureCommandEncoder> enc = [cmd accelerationStructureCommandEncoder];
+            enc.label = @"Instance structure";
+            encode_build(enc, instances, rt.scratch, offset);
+            [enc endEncoding];
+        }
+    }
+}
+
+void gpu_ray_tracing_bind(const GpuRayTracing& rt, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentAccelerationStructure:rt.instances atBufferIndex:RAY_TRACING_BUFFER_INDEX];
+    // Rays reach the chunk and mesh structures only through the instance structure
+    if (!rt.residency) {
+        [enc useResources:rt.resources.data() count:rt.resources.size() usage:MTLResourceUsageRead
+                   stages:MTLRenderStageFragment];
+    }
+}
+
+void gpu_ray_tracing_bind(const GpuRayTracing& rt, id<MTLComputeCommandEncoder> enc, uint32_t index) {
+    [enc setAccelerationStructure:rt.instances atBufferIndex:index];
+    if (!rt.residency) {
+        [enc useResources:rt.resources.data() count:rt.resources.size() usage:MTLResourceUsageRead];
+    }
+}
+
+void gpu_ray_tracing_set_residency(GpuRayTracing& rt, GpuResidency* residency) {
+    rt.residency = residency;
+    if (!residency) {
+        return;
+    }
+    for (const RayTracedChunk& chunk : rt.chunks) {
+        residency->add(chunk.structure);
+    }
+    for (id<MTLAccelerationStructure> mesh : rt.meshes) {
+        residency->add(mesh);
+    }
+    residency->add(rt.instances);
+}
+
+size_t gpu_ray_tracing_bytes(const GpuRayTracing& rt) {
+    size_t bytes = rt.instances.allocatedSize + rt.scratch.allocatedSize;
+    for (const RayTracedChunk& chunk : rt.chunks) {
+        bytes += chunk.structure.allocatedSize;
+    }
+    for (id<MTLAccelerationStructure> mesh : rt.meshes) {
+        bytes += mesh.allocatedSize;
+    }
+    return bytes;
+}
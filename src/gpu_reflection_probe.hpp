@@ -0,0 +1,74 @@
+/**
+ * @file gpu_reflection_probe.hpp
+ * @brief An environment reflection probe captured a face at a time and prefiltered for roughness.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "metal_context.hpp"
+#include "reflection_probe.hpp"
+
+/**
+ * @struct GpuReflectionProbe
+ * @brief The capture cube, the prefiltered cube reflections sample, and the schedule between them.
+ *
+ * Each frame reflection_probe_step() names the faces to render, if any; the caller renders them
+ * through encode_multi_view() into the pass gpu_reflection_probe_pass() makes, which clears and
+ * draws only those slices of the capture. After the last face gpu_reflection_probe_prefilter()
+ * mips the capture and dispatches prefilter_reflection_probe once per mip of the filtered cube,
+ * so the filtered cube only ever changes from one whole capture to the next.
+ */
+struct GpuReflectionProbe {
+    id<MTLComputePipelineState> prefilterPipeline; ///< prefilter_reflection_probe.
+    id<MTLTexture> capture;                         ///< BGRA8 cube with a full mip chain; the faces rendered so far.
+    id<MTLTexture> depth;                           ///< Depth32Float 2D array, a slice a face; memoryless if possible.
+    id<MTLTexture> filtered;                        ///< RGBA8 cube, rougher with each mip; what reflections sample.
+    std::vector<id<MTLTexture>> filteredMips;       ///< A single-mip cube view of each filtered mip, for writing.
+    uint32_t mipCount = 0;                          ///< Mips of filtered.
+    ReflectionProbeSettings settings;               ///< Resolution, time slicing and refresh.
+    ReflectionProbeSchedule schedule;               ///< The capture in progress and the published probe.
+};
+
+/// @return True if the prefilter kernel compiled.
+bool gpu_reflection_probe_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the probe's cubes, with nothing captured.
+ * @param metal The Metal context; its prefilter pipeline must exist.
+ * @param settings Resolution, time slicing and refresh; faceSize must be a power of two.
+ * @return The probe.
+ */
+GpuReflectionProbe create_gpu_reflection_probe(const MetalContext& metal, const ReflectionProbeSettings& settings = {});
+
+/**
+ * @brief Makes a pass that clears and renders the step's faces of the capture.
+ *
+ * Slice i of the pass is face step.firstFace + i, so the views rendered into it must have their
+ * RenderView::slice offset by step.firstFace.
+ *
+ * @param probe The probe.
+ * @param step The frame's step; faceCount must be at least 1.
+ * @param clearDepth The far depth, see camera_clear_depth().
+ * @return The pass descriptor.
+ */
+MTLRenderPassDescriptor* gpu_reflection_probe_pass(const GpuReflectionProbe& probe, const ReflectionProbeStep& step,
+                                                   float clearDepth);
+
+/**
+ * @brief Mips the whole capture and convolves it into every mip of the filtered cube.
+ *
+ * Must be encoded after the pass that rendered the capture's last face, and before the passes
+ * that sample the filtered cube.
+ *
+ * @param probe The probe.
+ * @param cmd The frame's command buffer.
+ */
+void gpu_reflection_probe_prefilter(const GpuReflectionProbe& probe, id<MTLCommandBuffer> cmd);
+
+/// @return GPU bytes held by the probe.
+size_t gpu_reflection_probe_bytes(const GpuReflectionProbe& probe);
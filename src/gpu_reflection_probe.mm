@@ -0,0 +1,113 @@
+#import "gpu_reflection_probe.hpp"
+
+#include <algorithm>
+
+#include "render_targets.hpp"
+
+namespace {
+    // Matches ReflectionProbeFilterParams in shaders.metal
+    struct ReflectionProbeFilterParams {
+        uint32_t size;
+        float roughness;
+        uint32_t sourceSize;
+        uint32_t sampleCount;
+    };
+}
+
+bool gpu_reflection_probe_supported(const MetalContext& metal) {
+    return metal.prefilter_probe_pipeline != nil;
+}
+
+GpuReflectionProbe create_gpu_reflection_probe(const MetalContext& metal, const ReflectionProbeSettings& settings) {
+    GpuReflectionProbe probe;
+    probe.prefilterPipeline = metal.prefilter_probe_pipeline;
+    probe.settings = settings;
+    probe.mipCount = reflection_probe_mip_count(settings.faceSize);
+
+    // The whole chain, so each lobe sample can read texels as large as its share of the lobe
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor textureCubeDescriptorWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                                                       size:settings.faceSize
+                                                                                  mipmapped:YES];
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead | MTLTextureUsagePixelFormatView;
+    probe.capture = [metal.device newTextureWithDescriptor:desc];
+    probe.capture.label = @"Reflection probe capture";
+
+    // A pass renders at most facesPerFrame faces, but a 2D array of every face keeps any step in range
+    desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatDepth32Float
+                                                              width:settings.faceSize
+                                                             height:settings.faceSize
+                                                          mipmapped:NO];
+    desc.textureType = MTLTextureType2DArray;
+    desc.arrayLength = CUBE_FACE_COUNT;
+    desc.storageMode = memoryless_supported(metal.device) ? MTLStorageModeMemoryless : MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageRenderTarget;
+    probe.depth = [metal.device newTextureWithDescriptor:desc];
+    probe.depth.label = @"Reflection probe depth";
+
+    desc = [MTLTextureDescriptor textureCubeDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                                                                 size:settings.faceSize
+                                                            mipmapped:YES];
+    desc.mipmapLevelCount = probe.mipCount;
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite | MTLTextureUsagePixelFormatView;
+    probe.filtered = [metal.device newTextureWithDescriptor:desc];
+    probe.filtered.label = @"Reflection probe";
+    for (uint32_t mip = 0; mip < probe.mipCount; ++mip) {
+        probe.filteredMips.push_back([probe.filtered newTextureViewWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                                                                       textureType:MTLTextureTypeCube
+                                                                            levels:NSMakeRange(mip, 1)
+                                                                            slices:NSMakeRange(0, CUBE_FACE_COUNT)]);
+    }
+    return probe;
+}
+
+MTLRenderPassDescriptor* gpu_reflection_probe_pass(const GpuReflectionProbe& probe, const ReflectionProbeStep& step,
+                                                   float clearDepth) {
+    // Only this step's faces are cleared; the rest of the capture keeps what earlier frames rendered
+    id<MTLTexture> faces = [probe.capture newTextureViewWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                            textureType:MTLTextureType2DArray
+                                                                 levels:NSMakeRange(0, 1)
+                                                                 slices:NSMakeRange(step.firstFace, step.faceCount)];
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = faces;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.6, 0.8, 1.0, 1.0); // Sky blue
+
+    passDesc.depthAttachment.texture = probe.depth;
+    passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+    passDesc.depthAttachment.storeAction = MTLStoreActionDontCare;
+    passDesc.depthAttachment.clearDepth = clearDepth;
+    passDesc.renderTargetArrayLength = step.faceCount;
+    return passDesc;
+}
+
+void gpu_reflection_probe_prefilter(const GpuReflectionProbe& probe, id<MTLCommandBuffer> cmd) {
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    blit.label = @"Reflection probe mips";
+    [blit generateMipmapsForTexture:probe.capture];
+    [blit endEncoding];
+
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Prefilter reflection probe";
+    [enc setComputePipelineState:probe.prefilterPipeline];
+    [enc setTexture:probe.capture atIndex:0];
+    for (uint32_t mip = 0; mip < probe.mipCount; ++mip) {
+        ReflectionProbeFilterParams params = {};
+        params.size = std::max(probe.settings.faceSize >> mip, 1u);
+        params.roughness = reflection_probe_mip_roughness(mip, probe.mipCount);
+        params.sourceSize = probe.settings.faceSize;
+        params.sampleCount = probe.settings.sampleCount;
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        [enc setTexture:probe.filteredMips[mip] atIndex:1];
+        [enc dispatchThreads:MTLSizeMake(params.size, params.size, CUBE_FACE_COUNT)
+            threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    }
+    [enc endEncoding];
+}
+
+size_t gpu_reflection_probe_bytes(const GpuReflectionProbe& probe) {
+    // Memoryless depth reports no allocation
+    return probe.capture.allocatedSize + probe.depth.allocatedSize + probe.filtered.allocatedSize;
+}
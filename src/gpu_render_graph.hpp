@@ -0,0 +1,157 @@
+/**
+ * @file gpu_render_graph.hpp
+ * @brief Runs the render graph of render_graph.hpp on Metal: transients in per-frame heaps, one
+ *        encoder per kept pass, and the fences and events the plan calls for.
+ *
+ * Each frame the passes are declared again with gpu_render_graph_begin() and the pass functions
+ * below, followed by their render_graph_read() and render_graph_write() calls on
+ * GpuRenderGraph::graph. gpu_render_graph_execute() compiles the frame, places the transients
+ * in the heap of the frame slot, and encodes each kept pass into its own encoder, which the
+ * executor creates: a pass only describes its attachments or sample buffers and encodes its
+ * commands, reaching its textures through gpu_render_graph_resolve().
+ *
+ * The heaps are untracked, so every hazard on a transient is covered by the plan's fences, or by
+ * the shared events for passes on another queue. Where a render pass is the first or last use of
+ * a transient attachment, its load or store action becomes don't-care. There is one heap per
+ * frame in flight, since the GPU may still read the last frame's transients while this one is
+ * encoded, and each heap only grows, to the largest frame it has held.
+ *
+ * Passes may run on MetalContext::computeQueue (RENDER_GRAPH_COMPUTE_QUEUE) to overlap the
+ * render queue's rasterisation. Metal tracks imported resources within a queue only, so the
+ * graph also orders them across queues from one frame to the next: at the end of each frame,
+ * every queue that used an imported texture signals its shared event, and the next pass on
+ * another queue that uses the texture waits for that value unless the GPU has already passed it.
+ * Each queue signals an event of its own, so the values each one waits for only ever grow.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "render_graph.hpp"
+
+/// Index of the render queue's command buffer in the array given to gpu_render_graph_execute().
+constexpr uint32_t RENDER_GRAPH_RENDER_QUEUE = 0;
+/// Index of the compute queue's command buffer.
+constexpr uint32_t RENDER_GRAPH_COMPUTE_QUEUE = 1;
+
+/// Sets the attachments of a render pass, and its sample buffer if timed.
+typedef void (^RenderGraphDescribeRender)(MTLRenderPassDescriptor* passDesc);
+/// Sets the sample buffer of a compute pass if timed.
+typedef void (^RenderGraphDescribeCompute)(MTLComputePassDescriptor* passDesc);
+/// Encodes a render pass's draws.
+typedef void (^RenderGraphEncodeRender)(id<MTLRenderCommandEncoder> enc);
+/// Encodes a compute pass's dispatches.
+typedef void (^RenderGraphEncodeCompute)(id<MTLComputeCommandEncoder> enc);
+/// Encodes a blit pass's copies.
+typedef void (^RenderGraphEncodeBlit)(id<MTLBlitCommandEncoder> enc);
+
+/**
+ * @struct GpuRenderGraphPass
+ * @brief The blocks of one declared pass; only those of its type are set.
+ */
+struct GpuRenderGraphPass {
+    RenderGraphDescribeRender describeRender;   ///< Render passes.
+    RenderGraphDescribeCompute describeCompute; ///< Compute passes; may be nil.
+    RenderGraphEncodeRender encodeRender;       ///< Render passes.
+    RenderGraphEncodeCompute encodeCompute;     ///< Compute passes.
+    RenderGraphEncodeBlit encodeBlit;           ///< Blit passes.
+};
+
+/**
+ * @struct GpuRenderGraphUse
+ * @brief The last frame an imported texture was used on a queue, and the value its event signalled after it.
+ */
+struct GpuRenderGraphUse {
+    id<MTLTexture> texture;     ///< The imported texture.
+    uint32_t queue = 0;         ///< The queue that used it.
+    uint64_t value = 0;         ///< Value the queue's event signalled after its passes that frame.
+};
+
+/**
+ * @struct GpuRenderGraph
+ * @brief The declared frame, its compiled plan, and the heaps, fences and event that run it.
+ */
+struct GpuRenderGraph {
+    id<MTLDevice> device;                           ///< Device the heaps are created on.
+    RenderGraph graph;                              ///< This frame's declarations.
+    RenderGraphPlan plan;                           ///< This frame's compiled plan.
+    std::vector<GpuRenderGraphPass> passes;         ///< Indexed like RenderGraph::passes.
+    std::vector<MTLTextureDescriptor*> descriptors; ///< Indexed like RenderGraph::resources; nil if imported.
+    std::vector<id<MTLTexture>> textures;           ///< This frame's texture of each resource.
+    std::vector<id<MTLHeap>> heaps;                 ///< Transient heap of each frame slot.
+    std::vector<std::vector<id<MTLTexture>>> placed; ///< Textures made in each heap, reused while they match.
+    std::vector<id<MTLFence>> fences;               ///< Fence of each step, made as plans need them.
+    std::vector<uint64_t> signals;                  ///< Value each step signalled on its queue's event this frame.
+    std::vector<GpuRenderGraphUse> uses;            ///< Imported textures' last uses on each queue, until passed.
+    std::vector<id<MTLSharedEvent>> events;         ///< Signalled by each queue; orders passes across queues.
+    std::vector<uint64_t> eventValues;              ///< Last value signalled on each event.
+    uint32_t frame = 0;                             ///< Frame slot being declared.
+};
+
+/**
+ * @brief Creates an empty graph.
+ * @param device The Metal device.
+ * @param framesInFlight Frames the CPU may encode ahead of the GPU; one heap is kept for each.
+ * @return The graph.
+ */
+GpuRenderGraph create_gpu_render_graph(id<MTLDevice> device, uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+/**
+ * @brief Starts declaring a frame.
+ * @param rg The graph.
+ * @param frameIndex The frame slot, e.g. FrameRing::frameIndex; its previous frame must have completed.
+ */
+void gpu_render_graph_begin(GpuRenderGraph& rg, uint32_t frameIndex);
+
+/**
+ * @brief Declares a texture that only lives within the frame.
+ * @param rg The graph.
+ * @param desc Its descriptor; the storage mode is made private.
+ * @param name The debug name and texture label; must outlive the frame.
+ * @return Its handle.
+ */
+uint32_t gpu_render_graph_texture(GpuRenderGraph& rg, MTLTextureDescriptor* desc, const char* name);
+
+/// @return The handle of a texture that outlives the frame.
+uint32_t gpu_render_graph_import(GpuRenderGraph& rg, id<MTLTexture> texture, const char* name);
+
+/**
+ * @brief Declares a render pass.
+ * @param rg The graph.
+ * @param name The debug name and encoder label; must outlive the frame.
+ * @param describe Sets the attachments.
+ * @param encode Encodes the draws.
+ * @param queue Index of the pass's command buffer in the array given to gpu_render_graph_execute().
+ * @return Its index.
+ */
+uint32_t gpu_render_graph_render_pass(GpuRenderGraph& rg, const char* name, RenderGraphDescribeRender describe,
+                                      RenderGraphEncodeRender encode, uint32_t queue = 0);
+
+/// Declares a compute pass; describe may be nil. See gpu_render_graph_render_pass().
+uint32_t gpu_render_graph_compute_pass(GpuRenderGraph& rg, const char* name, RenderGraphDescribeCompute describe,
+                                       RenderGraphEncodeCompute encode, uint32_t queue = 0);
+
+/// Declares a blit pass. See gpu_render_graph_render_pass().
+uint32_t gpu_render_graph_blit_pass(GpuRenderGraph& rg, const char* name, RenderGraphEncodeBlit encode,
+                                    uint32_t queue = 0);
+
+/// @return The texture of a resource: at any time for imported ones, within the pass blocks for transients.
+id<MTLTexture> gpu_render_graph_resolve(const GpuRenderGraph& rg, uint32_t resource);
+
+/**
+ * @brief Compiles the frame and encodes its kept passes.
+ * @param rg The graph.
+ * @param commandBuffers The command buffer of each queue a pass runs on, in queue order; none committed yet.
+ * @param frameStats Receives the traffic of each render pass.
+ */
+void gpu_render_graph_execute(GpuRenderGraph& rg, NSArray<id<MTLCommandBuffer>>* commandBuffers,
+                              FrameStats& frameStats);
+
+/// @return GPU bytes held by the transient heaps.
+size_t gpu_render_graph_bytes(const GpuRenderGraph& rg);
@@ -0,0 +1,275 @@
+#import "gpu_render_graph.hpp"
+
+#include <algorithm>
+
+#include "render_targets.hpp"
+
+namespace {
+    bool texture_matches(id<MTLTexture> texture, MTLTextureDescriptor* desc, uint64_t offset) {
+        return texture && texture.heapOffset == offset && texture.pixelFormat == desc.pixelFormat &&
+               texture.textureType == desc.textureType && texture.width == desc.width &&
+               texture.height == desc.height && texture.depth == desc.depth &&
+               texture.arrayLength == desc.arrayLength && texture.mipmapLevelCount == desc.mipmapLevelCount &&
+               texture.sampleCount == desc.sampleCount && texture.usage == desc.usage;
+    }
+
+    // The transient a texture belongs to; RENDER_GRAPH_NONE for imported textures and nil
+    uint32_t transient_of(const GpuRenderGraph& rg, id<MTLTexture> texture) {
+        for (uint32_t r = 0; texture && r < (uint32_t)rg.textures.size(); ++r) {
+            if (!rg.graph.resources[r].imported && rg.textures[r] == texture) {
+                return r;
+            }
+        }
+        return RENDER_GRAPH_NONE;
+    }
+
+    // A transient has no contents before its first use and none worth keeping after its last
+    void trim_attachment(const GpuRenderGraph& rg, uint32_t step, MTLRenderPassAttachmentDescriptor* attachment) {
+        const uint32_t r = transient_of(rg, attachment.texture);
+        if (r == RENDER_GRAPH_NONE) {
+            return;
+        }
+        const RenderGraphLifetime& lifetime = rg.plan.lifetimes[r];
+        if (lifetime.first == step && attachment.loadAction == MTLLoadActionLoad) {
+            attachment.loadAction = MTLLoadActionDontCare;
+        }
+        if (lifetime.last == step && attachment.storeAction == MTLStoreActionStore) {
+            attachment.storeAction = MTLStoreActionDontCare;
+        }
+    }
+
+    uint32_t add_pass(GpuRenderGraph& rg, const char* name, RenderGraphPassType type, uint32_t queue) {
+        rg.passes.emplace_back();
+        return render_graph_add_pass(rg.graph, name, type, queue);
+    }
+
+    // Places the frame's transients in the frame slot's heap, growing it if the plan needs more
+    void place_transients(GpuRenderGraph& rg) {
+        id<MTLHeap> heap = rg.heaps[rg.frame];
+        std::vector<id<MTLTexture>>& placed = rg.placed[rg.frame];
+        if (rg.plan.heapSize > 0 && (!heap || heap.size < rg.plan.heapSize)) {
+            MTLHeapDescriptor* desc = [MTLHeapDescriptor new];
+            desc.type = MTLHeapTypePlacement;
+            desc.storageMode = MTLStorageModePrivate;
+            desc.hazardTrackingMode = MTLHazardTrackingModeUntracked;
+            desc.size = rg.plan.heapSize;
+            heap = [rg.device newHeapWithDescriptor:desc];
+            heap.label = @"Render graph transients";
+            rg.heaps[rg.frame] = heap;
+            placed.clear();
+        }
+        placed.resize(std::max(placed.size(), rg.graph.resources.size()));
+        for (uint32_t r = 0; r < (uint32_t)rg.graph.resources.size(); ++r) {
+            const RenderGraphLifetime& lifetime = rg.plan.lifetimes[r];
+            if (rg.graph.resources[r].imported || lifetime.first == RENDER_GRAPH_NONE) {
+                continue;
+            }
+            MTLTextureDescriptor* desc = rg.descriptors[r];
+            if (!texture_matches(placed[r], desc, lifetime.offset)) {
+                placed[r] = [heap newTextureWithDescriptor:desc offset:lifetime.offset];
+                placed[r].label = @(rg.graph.resources[r].name);
+            }
+            rg.textures[r] = placed[r];
+        }
+    }
+
+    // Signals the end of the frame's passes on each queue that used an imported texture, and remembers
+    // the value for the next frame's passes on other queues
+    void record_imported_uses(GpuRenderGraph& rg, NSArray<id<MTLCommandBuffer>>* commandBuffers) {
+        for (uint32_t queue = 0; queue < (uint32_t)commandBuffers.count; ++queue) {
+            uint64_t value = 0;
+            for (const RenderGraphStep& step : rg.plan.steps) {
+                const RenderGraphPass& pass = rg.graph.passes[step.pass];
+                for (uint32_t a = pass.firstAccess; pass.queue == queue && a < pass.firstAccess + pass.accessCount;
+                     ++a) {
+                    const uint32_t r = rg.graph.accesses[a].resource;
+                    if (!rg.graph.resources[r].imported || !rg.textures[r]) {
+                        continue;
+                    }
+                    if (value == 0) {
+                        value = ++rg.eventValues[queue];
+                        [commandBuffers[queue] encodeSignalEvent:rg.events[queue] value:value];
+                    }
+                    auto use = std::find_if(rg.uses.begin(), rg.uses.end(), [&](const GpuRenderGraphUse& u) {
+                        return u.texture == rg.textures[r] && u.queue == queue;
+                    });
+                    if (use == rg.uses.end()) {
+                        rg.uses.push_back({ rg.textures[r], queue, value });
+                    } else {
+                        use->value = value;
+                    }
+                }
+            }
+        }
+    }
+}
+
+GpuRenderGraph create_gpu_render_graph(id<MTLDevice> device, uint32_t framesInFlight) {
+    GpuRenderGraph rg;
+    rg.device = device;
+    rg.heaps.resize(framesInFlight);
+    rg.placed.resize(framesInFlight);
+    return rg;
+}
+
+void gpu_render_graph_begin(GpuRenderGraph& rg, uint32_t frameIndex) {
+    rg.frame = frameIndex % (uint32_t)rg.heaps.size();
+    render_graph_reset(rg.graph);
+    rg.passes.clear();
+    rg.descriptors.clear();
+    rg.textures.clear();
+}
+
+uint32_t gpu_render_graph_texture(GpuRenderGraph& rg, MTLTextureDescriptor* desc, const char* name) {
+    desc.storageMode = MTLStorageModePrivate;
+    const MTLSizeAndAlign sizeAndAlign = [rg.device heapTextureSizeAndAlignWithDescriptor:desc];
+    rg.descriptors.push_back(desc);
+    rg.textures.push_back(nil);
+    return render_graph_transient(rg.graph, name, sizeAndAlign.size, sizeAndAlign.align);
+}
+
+uint32_t gpu_render_graph_import(GpuRenderGraph& rg, id<MTLTexture> texture, const char* name) {
+    rg.descriptors.push_back(nil);
+    rg.textures.push_back(texture);
+    return render_graph_import(rg.graph, name);
+}
+
+uint32_t gpu_render_graph_render_pass(GpuRenderGraph& rg, const char* name, RenderGraphDescribeRender describe,
+                                      RenderGraphEncodeRender encode, uint32_t queue) {
+    const uint32_t pass = add_pass(rg, name, RenderGraphPassType::Render, queue);
+    rg.passes[pass].describeRender = describe;
+    rg.passes[pass].encodeRender = encode;
+    return pass;
+}
+
+uint32_t gpu_render_graph_compute_pass(GpuRenderGraph& rg, const char* name, RenderGraphDescribeCompute describe,
+                                       RenderGraphEncodeCompute encode, uint32_t queue) {
+    const uint32_t pass = add_pass(rg, name, RenderGraphPassType::Compute, queue);
+    rg.passes[pass].describeCompute = describe;
+    rg.passes[pass].encodeCompute = encode;
+    return pass;
+}
+
+uint32_t gpu_render_graph_blit_pass(GpuRenderGraph& rg, const char* name, RenderGraphEncodeBlit encode,
+                                    uint32_t queue) {
+    const uint32_t pass = add_pass(rg, name, RenderGraphPassType::Blit, queue);
+    rg.passes[pass].encodeBlit = encode;
+    return pass;
+}
+
+id<MTLTexture> gpu_render_graph_resolve(const GpuRenderGraph& rg, uint32_t resource) {
+    return rg.textures[resource];
+}
+
+void gpu_render_graph_execute(GpuRenderGraph& rg, NSArray<id<MTLCommandBuffer>>* commandBuffers,
+                              FrameStats& frameStats) {
+    compile_render_graph(rg.graph, rg.plan);
+    place_transients(rg);
+    const std::vector<RenderGraphStep>& steps = rg.plan.steps;
+    while (rg.fences.size() < steps.size()) {
+        rg.fences.push_back([rg.device newFence]);
+    }
+    rg.signals.assign(steps.size(), 0);
+    while (rg.events.size() < commandBuffers.count) {
+        rg.events.push_back([rg.device newSharedEvent]);
+        rg.events.back().label = [NSString stringWithFormat:@"Render graph queue %zu", rg.events.size() - 1];
+        rg.eventValues.push_back(0);
+    }
+    // Uses the GPU has already passed need no wait
+    rg.uses.erase(std::remove_if(rg.uses.begin(), rg.uses.end(),
+                                 [&](const GpuRenderGraphUse& use) {
+                                     return use.value <= rg.events[use.queue].signaledValue;
+                                 }),
+                  rg.uses.end());
+
+    for (uint32_t s = 0; s < (uint32_t)steps.size(); ++s) {
+        const RenderGraphStep& step = steps[s];
+        const RenderGraphPass& pass = rg.graph.passes[step.pass];
+        const GpuRenderGraphPass& blocks = rg.passes[step.pass];
+        id<MTLCommandBuffer> cmd = commandBuffers[pass.queue];
+        const RenderGraphWait* waits = rg.plan.waits.data() + step.firstWait;
+        // Events are waited for between encoders, fences at the start of the encoder
+        for (uint32_t w = 0; w < step.waitCount; ++w) {
+            if (waits[w].event) {
+                const uint32_t producer = rg.graph.passes[steps[waits[w].step].pass].queue;
+                [cmd encodeWaitForEvent:rg.events[producer] value:rg.signals[waits[w].step]];
+            }
+        }
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            const uint32_t r = rg.graph.accesses[a].resource;
+            for (const GpuRenderGraphUse& use : rg.uses) {
+                if (rg.graph.resources[r].imported && use.texture == rg.textures[r] && use.queue != pass.queue) {
+                    [cmd encodeWaitForEvent:rg.events[use.queue] value:use.value];
+                }
+            }
+        }
+
+        NSString* label = @(pass.name);
+        if (pass.type == RenderGraphPassType::Render) {
+            MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+            blocks.describeRender(passDesc);
+            for (NSUInteger i = 0; i < 8; ++i) {
+                trim_attachment(rg, s, passDesc.colorAttachments[i]);
+            }
+            trim_attachment(rg, s, passDesc.depthAttachment);
+            trim_attachment(rg, s, passDesc.stencilAttachment);
+            frame_stats_count_pass(frameStats, audit_render_pass(passDesc, pass.name));
+            id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+            enc.label = label;
+            for (uint32_t w = 0; w < step.waitCount; ++w) {
+                if (!waits[w].event) {
+                    [enc waitForFence:rg.fences[waits[w].step] beforeStages:MTLRenderStageVertex];
+                }
+            }
+            blocks.encodeRender(enc);
+            if (step.updateFence) {
+                [enc updateFence:rg.fences[s] afterStages:MTLRenderStageFragment];
+            }
+            [enc endEncoding];
+        } else if (pass.type == RenderGraphPassType::Compute) {
+            MTLComputePassDescriptor* passDesc = [MTLComputePassDescriptor computePassDescriptor];
+            if (blocks.describeCompute) {
+                blocks.describeCompute(passDesc);
+            }
+            id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoderWithDescriptor:passDesc];
+            enc.label = label;
+            for (uint32_t w = 0; w < step.waitCount; ++w) {
+                if (!waits[w].event) {
+                    [enc waitForFence:rg.fences[waits[w].step]];
+                }
+            }
+            blocks.encodeCompute(enc);
+            if (step.updateFence) {
+                [enc updateFence:rg.fences[s]];
+            }
+            [enc endEncoding];
+        } else {
+            id<MTLBlitCommandEncoder> enc = [cmd blitCommandEncoder];
+            enc.label = label;
+            for (uint32_t w = 0; w < step.waitCount; ++w) {
+                if (!waits[w].event) {
+                    [enc waitForFence:rg.fences[waits[w].step]];
+                }
+            }
+            blocks.encodeBlit(enc);
+            if (step.updateFence) {
+                [enc updateFence:rg.fences[s]];
+            }
+            [enc endEncoding];
+        }
+
+        if (step.signalEvent) {
+            rg.signals[s] = ++rg.eventValues[pass.queue];
+            [cmd encodeSignalEvent:rg.events[pass.queue] value:rg.signals[s]];
+        }
+    }
+    record_imported_uses(rg, commandBuffers);
+}
+
+size_t gpu_render_graph_bytes(const GpuRenderGraph& rg) {
+    size_t bytes = 0;
+    for (id<MTLHeap> heap : rg.heaps) {
+        bytes += heap ? heap.size : 0;
+    }
+    return bytes;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file gpu_residency.hpp
+ * @brief A residency set that keeps the streamed terrain and the buffers shaders reach by address resident.
+ *
+ * Resources a shader only reaches through a GPU address, like the chunk vertex buffers of bindless
+ * and GPU-culled draws, are otherwise declared to each encoder with useResources, every frame and
+ * for every chunk drawn. With a residency set attached to the command queues, they are made
+ * resident once, when they are created or streamed in, and leave the set when they are released,
+ * so the encoders declare nothing. The set only changes residency: the resources keep the hazard
+ * tracking of their heap or buffer, and the uploads that fill them are waited for as before.
+ *
+ * Residency sets need macOS 15; older systems keep the useResources path.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// @return True if the OS and device support MTLResidencySet.
+bool residency_sets_supported(id<MTLDevice> device);
+
+/**
+ * @class GpuResidency
+ * @brief One residency set, attached to the queues that draw with its allocations.
+ *
+ * add() and remove() are safe from any thread, e.g. from BufferHeap::allocate() on a streaming
+ * job; they take effect at the next commit(). An allocation must stay in the set until the
+ * frames that may still use it have completed.
+ */
+class GpuResidency {
+public:
+    /**
+     * @param device The Metal device; residency_sets_supported() must be true.
+     * @param initialCapacity Allocations to reserve room for.
+     */
+    GpuResidency(id<MTLDevice> device, uint32_t initialCapacity);
+    ~GpuResidency();
+
+    GpuResidency(const GpuResidency&) = delete;
+    GpuResidency& operator=(const GpuResidency&) = delete;
+
+    /// Makes the set resident for every command buffer later committed to a queue; nil is ignored.
+    void attach(id<MTLCommandQueue> queue);
+
+    /// Adds a buffer or texture; nil is ignored.
+    void add(id<MTLResource> resource);
+
+    /// Adds a heap, and with it every resource placed in it; nil is ignored.
+    void add(id<MTLHeap> heap);
+
+    /// Removes a buffer or texture added before; nil is ignored.
+    void remove(id<MTLResource> resource);
+
+    /// Removes a heap added before; nil is ignored.
+    void remove(id<MTLHeap> heap);
+
+    /// Applies the additions and removals since the last call; call once per frame before committing it.
+    void commit();
+
+    /// @return Allocations in the set, as of the last commit().
+    uint32_t allocation_count() const;
+
+    /// @return Bytes the set keeps resident, as of the last commit().
+    uint64_t allocated_size() const;
+
+private:
+    id m_set;                                   ///< The id<MTLResidencySet>; nil if it could not be created.
+    std::vector<id<MTLCommandQueue>> m_queues;  ///< Queues the set is attached to.
+    mutable std::mutex m_mutex;                 ///< Guards m_set's pending changes and m_dirty.
+    bool m_dirty = false;                       ///< Changes are waiting for commit().
+};
@@ -0,0 +1,107 @@
+#import "gpu_residency.hpp"
+
+namespace {
+    // Buffers, textures and heaps are all allocations from macOS 15 on
+    void add_allocation(id set, std::mutex& mutex, bool& dirty, id allocation) {
+        if (@available(macOS 15.0, *)) {
+            if (!allocation || !set) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            [(id<MTLResidencySet>)set addAllocation:(id<MTLAllocation>)allocation];
+            dirty = true;
+        }
+    }
+
+    void remove_allocation(id set, std::mutex& mutex, bool& dirty, id allocation) {
+        if (@available(macOS 15.0, *)) {
+            if (!allocation || !set) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            [(id<MTLResidencySet>)set removeAllocation:(id<MTLAllocation>)allocation];
+            dirty = true;
+        }
+    }
+}
+
+bool residency_sets_supported(id<MTLDevice> device) {
+    if (@available(macOS 15.0, *)) {
+        return [device respondsToSelector:@selector(newResidencySetWithDescriptor:error:)];
+    }
+    return false;
+}
+
+GpuResidency::GpuResidency(id<MTLDevice> device, uint32_t initialCapacity) {
+    if (@available(macOS 15.0, *)) {
+        MTLResidencySetDescriptor* desc = [MTLResidencySetDescriptor new];
+        desc.label = @"Streamed resources";
+        desc.initialCapacity = initialCapacity;
+        NSError* error = nil;
+        m_set = [device newResidencySetWithDescriptor:desc error:&error];
+        if (!m_set) {
+            NSLog(@"Failed to create residency set: %@", error);
+        }
+    }
+}
+
+GpuResidency::~GpuResidency() {
+    if (@available(macOS 15.0, *)) {
+        for (id<MTLCommandQueue> queue : m_queues) {
+            [queue removeResidencySet:m_set];
+        }
+    }
+}
+
+void GpuResidency::attach(id<MTLCommandQueue> queue) {
+    if (@available(macOS 15.0, *)) {
+        if (!queue || !m_set) {
+            return;
+        }
+        [queue addResidencySet:m_set];
+        m_queues.push_back(queue);
+        [(id<MTLResidencySet>)m_set requestResidency];
+    }
+}
+
+void GpuResidency::add(id<MTLResource> resource) {
+    add_allocation(m_set, m_mutex, m_dirty, resource);
+}
+
+void GpuResidency::add(id<MTLHeap> heap) {
+    add_allocation(m_set, m_mutex, m_dirty, heap);
+}
+
+void GpuResidency::remove(id<MTLResource> resource) {
+    remove_allocation(m_set, m_mutex, m_dirty, resource);
+}
+
+void GpuResidency::remove(id<MTLHeap> heap) {
+    remove_allocation(m_set, m_mutex, m_dirty, heap);
+}
+
+void GpuResidency::commit() {
+    if (@available(macOS 15.0, *)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_dirty && m_set) {
+            [(id<MTLResidencySet>)m_set commit];
+            m_dirty = false;
+        }
+    }
+}
+
+uint32_t GpuResidency::allocation_count() const {
+    if (@available(macOS 15.0, *)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (uint32_t)((id<MTLResidencySet>)m_set).allocationCount;
+    }
+    return 0;
+}
+
+uint64_t GpuResidency::allocated_size() const {
+    if (@available(macOS 15.0, *)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return ((id<MTLResidencySet>)m_set).allocatedSize;
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file gpu_scene_instances.hpp
+ * @brief Every scene entity's instance data kept resident on the GPU, updated only where it changed.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_ring.hpp"
+#include "scene.hpp"
+
+/// Unchanged instances a copy may span to join the next changed range; two ranges closer than this share a copy.
+constexpr uint32_t SCENE_INSTANCE_MERGE_GAP = 4;
+
+/**
+ * @struct GpuSceneInstances
+ * @brief A private buffer holding the InstanceData of every entity, in the scene's dense order.
+ *
+ * Each frame gpu_scene_instances_upload() takes the ranges scene.hpp marked as changed, writes
+ * them into the frame ring, and blits each range into place, so the bytes sent scale with the
+ * entities that moved, were recoloured, created or moved into a destroyed one's slot, and a
+ * static world sends none. Scene draws then bind the buffer whole and pick their instances
+ * through a list of dense positions in the ring (see scene_order_instances() and
+ * ShaderVariant::indexedInstances): four bytes per visible instance instead of its InstanceData.
+ */
+struct GpuSceneInstances {
+    id<MTLBuffer> buffer;               ///< capacity InstanceData, in dense order.
+    uint32_t capacity = 0;              ///< Entities the buffer holds.
+    std::vector<SceneRange> ranges;     ///< The last upload's ranges; kept to reuse its memory.
+    size_t uploadedBytes = 0;           ///< Bytes the last upload sent.
+};
+
+/**
+ * @brief Creates the buffer.
+ * @param device The Metal device.
+ * @param capacity The most entities the scene will hold, e.g. what it was reserved for.
+ * @return The resident instances, all of them to be sent by the first upload.
+ */
+GpuSceneInstances create_gpu_scene_instances(id<MTLDevice> device, uint32_t capacity);
+
+/// @return Ring bytes an upload may take per frame, when every instance changed.
+size_t gpu_scene_instances_frame_bytes(uint32_t capacity);
+
+/**
+ * @brief Sends the instances that changed since the last upload.
+ *
+ * Must be encoded before the passes that draw the scene. Takes the scene's changed ranges even
+ * when the buffer is not drawn from, so the scene does not collect them indefinitely.
+ *
+ * @param instances The resident instances.
+ * @param scene The scene.
+ * @param cmd The frame's command buffer.
+ * @param uniformRing The frame ring the changed instances are staged in.
+ */
+void gpu_scene_instances_upload(GpuSceneInstances& instances, SceneStore& scene, id<MTLCommandBuffer> cmd,
+                                FrameRing& uniformRing);
+
+/// @return True if the buffer holds every entity of the scene, so draws may read it.
+bool gpu_scene_instances_ready(const GpuSceneInstances& instances, const SceneStore& scene);
+
+/// @return GPU bytes held by the buffer.
+size_t gpu_scene_instances_bytes(const GpuSceneInstances& instances);
@@ -0,0 +1,57 @@
+#import "gpu_scene_instances.hpp"
+
+#include <algorithm>
+
+GpuSceneInstances create_gpu_scene_instances(id<MTLDevice> device, uint32_t capacity) {
+    GpuSceneInstances instances;
+    instances.capacity = capacity;
+    instances.buffer = [device newBufferWithLength:(size_t)std::max(capacity, 1u) * sizeof(InstanceData)
+                                           options:MTLResourceStorageModePrivate];
+    instances.buffer.label = @"Scene instances";
+    instances.ranges.reserve(capacity);
+    return instances;
+}
+
+size_t gpu_scene_instances_frame_bytes(uint32_t capacity) {
+    return ((size_t)capacity * sizeof(InstanceData) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+}
+
+void gpu_scene_instances_upload(GpuSceneInstances& instances, SceneStore& scene, id<MTLCommandBuffer> cmd,
+                                FrameRing& uniformRing) {
+    const size_t count = scene_take_instance_ranges(scene, SCENE_INSTANCE_MERGE_GAP, instances.ranges);
+    instances.uploadedBytes = 0;
+    if (count == 0) {
+        return;
+    }
+
+    // One staging slice for every range, packed back to back
+    FrameAllocation staging = frame_ring_allocate(uniformRing, count * sizeof(InstanceData));
+    InstanceData* written = (InstanceData*)staging.contents;
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    blit.label = @"Upload scene instances";
+    size_t offset = 0;
+    for (const SceneRange& range : instances.ranges) {
+        // Entities past the capacity are never drawn from the buffer; see gpu_scene_instances_ready()
+        if (range.first >= instances.capacity) {
+            break;
+        }
+        const SceneRange kept = { range.first, std::min(range.count, instances.capacity - range.first) };
+        scene_write_instances(scene, kept, written + offset);
+        [blit copyFromBuffer:staging.buffer
+                 sourceOffset:staging.offset + offset * sizeof(InstanceData)
+                     toBuffer:instances.buffer
+            destinationOffset:(size_t)kept.first * sizeof(InstanceData)
+                         size:(size_t)kept.count * sizeof(InstanceData)];
+        offset += kept.count;
+    }
+    [blit endEncoding];
+    instances.uploadedBytes = offset * sizeof(InstanceData);
+}
+
+bool gpu_scene_instances_ready(const GpuSceneInstances& instances, const SceneStore& scene) {
+    return scene.size() <= instances.capacity;
+}
+
+size_t gpu_scene_instances_bytes(const GpuSceneInstances& instances) {
+    return instances.buffer.allocatedSize;
+}
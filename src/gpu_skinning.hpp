@@ -0,0 +1,102 @@
+/**
+ * @file gpu_skinning.hpp
+ * @brief Skinned meshes posed once a frame by a compute pre-pass, for every pass that draws them.
+ *
+ * The skin_vertices kernel moves every vertex of every instance from the bind pose into its
+ * instance's pose, reading the palettes animate() wrote, and stores the result as plain Vertex
+ * data in a transient buffer. The scene pass and each shadow cascade then draw that buffer with
+ * the ordinary instanced pipelines, so an instance is skinned once however many passes draw it.
+ * Instance i's vertices start at vertex i * vertexCount, which its draw passes as the base vertex.
+ * There is one output buffer per frame in flight, so a frame never overwrites vertices an earlier
+ * one is still drawing.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <vector>
+
+#include "affine.hpp"
+#include "animation.hpp"
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "frustum.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+
+/**
+ * @struct GpuSkinning
+ * @brief A skinned mesh's bind pose and skin, and the vertices of this frame's instances.
+ */
+struct GpuSkinning {
+    id<MTLComputePipelineState> pipeline;   ///< skin_vertices.
+    GpuMesh mesh;                           ///< Bind pose vertices and the indices every instance draws.
+    id<MTLBuffer> skin;                     ///< VertexSkin per vertex.
+    std::vector<id<MTLBuffer>> outputs;     ///< maxInstances posed copies of the vertices per frame in flight.
+    uint32_t vertexCount = 0;               ///< Vertices of the mesh.
+    uint32_t jointCount = 0;                ///< Palette entries per instance.
+    uint32_t maxInstances = 0;              ///< Instances an output buffer holds.
+    BoundingBox poseBounds;                 ///< Model space box around every pose.
+    id<MTLBuffer> output;                   ///< This frame's posed vertices, after gpu_skinning_encode.
+    FrameAllocation instances = {};         ///< This frame's InstanceData, after gpu_skinning_encode.
+    uint32_t instanceCount = 0;             ///< Instances posed this frame.
+    CullBounds bounds;                      ///< World bounds of this frame's instances.
+    std::vector<uint32_t> visible;          ///< Instances a pass sees; sized once, so drawing never allocates.
+};
+
+/// @return True if the skinning kernel compiled.
+bool gpu_skinning_supported(const MetalContext& metal);
+
+/**
+ * @brief Uploads a skinned mesh and creates its output buffers.
+ * @param metal The Metal context; its skinning pipeline must exist.
+ * @param uploader Uploads the bind pose and the skin.
+ * @param source The mesh and its skin.
+ * @param jointCount Joints of the skeleton it is played with; at most ANIMATION_MAX_JOINTS.
+ * @param poseBounds Model space box around every pose, e.g. from animation_bounds().
+ * @param maxInstances The most instances posed in one frame.
+ * @param framesInFlight The frames the CPU may encode ahead of the GPU; one output buffer each.
+ * @return The skinning state.
+ */
+GpuSkinning create_gpu_skinning(const MetalContext& metal, ResourceUploader& uploader, const SkinnedMesh& source,
+                                uint32_t jointCount, const BoundingBox& poseBounds, uint32_t maxInstances,
+                                uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+
+/// @return Frame ring bytes gpu_skinning_encode needs per frame.
+size_t gpu_skinning_frame_bytes(uint32_t maxInstances, uint32_t jointCount);
+
+/// @return GPU bytes held by the bind pose, the skin and the output buffers.
+size_t gpu_skinning_bytes(const GpuSkinning& skinning);
+
+/**
+ * @brief Poses this frame's instances into the output buffer of the ring's current frame.
+ *
+ * Copies the palettes and the instance data into the frame ring and dispatches skin_vertices.
+ * Must be encoded, after the uploader's wait, before any pass that draws the instances.
+ *
+ * @param skinning The skinning state.
+ * @param cmd The frame's command buffer.
+ * @param uniformRing The frame ring; its current frame picks the output buffer.
+ * @param palettes jointCount palette entries per instance.
+ * @param world Model to world transform of each instance.
+ * @param colors Flat colour of each instance.
+ * @param count The number of instances; those past maxInstances are not posed.
+ */
+void gpu_skinning_encode(GpuSkinning& skinning, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                         const Affine* palettes, const Affine* world, const simd::float3* colors, uint32_t count);
+
+/**
+ * @brief Draws the posed instances whose bounds are inside a frustum, with an instanced pipeline bound.
+ *
+ * For passes that encode directly, such as the shadow cascades; the scene pass queues the same
+ * draws through its render queue instead.
+ *
+ * @param skinning The skinning state, after gpu_skinning_encode.
+ * @param enc The render encoder; the pipeline and the pass's FrameUniforms must be bound.
+ * @param frustum The pass's frustum.
+ * @param frameStats Receives the draws.
+ */
+void gpu_skinning_draw(GpuSkinning& skinning, id<MTLRenderCommandEncoder> enc, const Frustum& frustum,
+                       FrameStats& frameStats);
@@ -0,0 +1,125 @@
+#import "gpu_skinning.hpp"
+
+#include <algorithm>
+
+#include "objects.hpp"
+
+namespace {
+    // Matches SkinParams in shaders.metal
+    struct SkinParams {
+        uint32_t vertexCount;
+        uint32_t jointCount;
+        uint32_t instanceCount;
+        uint32_t padding;
+    };
+
+    size_t aligned(size_t bytes) {
+        return (bytes + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    }
+}
+
+bool gpu_skinning_supported(const MetalContext& metal) {
+    return metal.skin_vertices_pipeline != nil;
+}
+
+GpuSkinning create_gpu_skinning(const MetalContext& metal, ResourceUploader& uploader, const SkinnedMesh& source,
+                                uint32_t jointCount, const BoundingBox& poseBounds, uint32_t maxInstances,
+                                uint32_t framesInFlight) {
+    GpuSkinning skinning;
+    skinning.pipeline = metal.skin_vertices_pipeline;
+    skinning.mesh.vertexBuffer = uploader.upload(source.mesh.vertices.data(),
+                                                 source.mesh.vertices.size() * sizeof(Vertex), @"Skinned mesh");
+    skinning.mesh.indexBuffer = uploader.upload(source.mesh.indices.data(), source.mesh.indices.byte_size(),
+                                                @"Skinned mesh");
+    skinning.mesh.indexCount = (uint32_t)source.mesh.indices.size();
+    skinning.mesh.indexType = metal_index_type(source.mesh.indices.format);
+    skinning.mesh.bounds = source.mesh.bounds;
+    skinning.skin = uploader.upload(source.skin.data(), source.skin.size() * sizeof(VertexSkin), @"Skinned mesh skin");
+    skinning.vertexCount = (uint32_t)source.mesh.vertices.size();
+    skinning.jointCount = std::min(jointCount, ANIMATION_MAX_JOINTS);
+    skinning.maxInstances = std::max(maxInstances, 1u);
+    skinning.poseBounds = poseBounds;
+
+    const size_t outputBytes = (size_t)skinning.maxInstances * skinning.vertexCount * sizeof(Vertex);
+    for (uint32_t frame = 0; frame < std::max(framesInFlight, 1u); ++frame) {
+        id<MTLBuffer> output = [metal.device newBufferWithLength:outputBytes options:MTLResourceStorageModePrivate];
+        output.label = @"Skinned vertices";
+        skinning.outputs.push_back(output);
+    }
+    skinning.output = skinning.outputs[0];
+    cull_bounds_reserve(skinning.bounds, skinning.maxInstances);
+    skinning.visible.resize(skinning.maxInstances);
+    return skinning;
+}
+
+size_t gpu_skinning_frame_bytes(uint32_t maxInstances, uint32_t jointCount) {
+    return aligned((size_t)maxInstances * jointCount * sizeof(Affine)) + aligned(maxInstances * sizeof(InstanceData));
+}
+
+size_t gpu_skinning_bytes(const GpuSkinning& skinning) {
+    size_t bytes = skinning.mesh.vertexBuffer.allocatedSize + skinning.mesh.indexBuffer.allocatedSize +
+                   skinning.skin.allocatedSize;
+    for (id<MTLBuffer> output : skinning.outputs) {
+        bytes += output.allocatedSize;
+    }
+    return bytes;
+}
+
+void gpu_skinning_encode(GpuSkinning& skinning, id<MTLCommandBuffer> cmd, FrameRing& uniformRing,
+                         const Affine* palettes, const Affine* world, const simd::float3* colors, uint32_t count) {
+    const uint32_t instanceCount = std::min(count, skinning.maxInstances);
+    skinning.output = skinning.outputs[uniformRing.frameIndex % skinning.outputs.size()];
+    skinning.instanceCount = instanceCount;
+    cull_bounds_clear(skinning.bounds);
+    if (instanceCount == 0) {
+        return;
+    }
+
+    const size_t paletteBytes = (size_t)instanceCount * skinning.jointCount * sizeof(Affine);
+    FrameAllocation palette = frame_ring_allocate(uniformRing, paletteBytes);
+    std::copy(palettes, palettes + (size_t)instanceCount * skinning.jointCount, (Affine*)palette.contents);
+
+    skinning.instances = frame_ring_allocate(uniformRing, instanceCount * sizeof(InstanceData));
+    InstanceData* instances = (InstanceData*)skinning.instances.contents;
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        const simd::float4x4 model = affine_matrix(world[i]);
+        instances[i] = { model, simd::float4{ colors[i].x, colors[i].y, colors[i].z, 0.0f } };
+        cull_bounds_add(skinning.bounds, transform_bounds(skinning.poseBounds, model));
+    }
+
+    const SkinParams params = { skinning.vertexCount, skinning.jointCount, instanceCount, 0 };
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Skinning";
+    [enc setComputePipelineState:skinning.pipeline];
+    [enc setBytes:&params length:sizeof(params) atIndex:0];
+    [enc setBuffer:skinning.mesh.vertexBuffer offset:0 atIndex:1];
+    [enc setBuffer:skinning.skin offset:0 atIndex:2];
+    [enc setBuffer:palette.buffer offset:palette.offset atIndex:3];
+    [enc setBuffer:skinning.output offset:0 atIndex:4];
+    const NSUInteger width = std::min<NSUInteger>(skinning.pipeline.maxTotalThreadsPerThreadgroup, 64);
+    [enc dispatchThreads:MTLSizeMake(skinning.vertexCount, instanceCount, 1)
+        threadsPerThreadgroup:MTLSizeMake(width, 1, 1)];
+    [enc endEncoding];
+}
+
+void gpu_skinning_draw(GpuSkinning& skinning, id<MTLRenderCommandEncoder> enc, const Frustum& frustum,
+                       FrameStats& frameStats) {
+    if (skinning.instanceCount == 0) {
+        return;
+    }
+    [enc setVertexBuffer:skinning.output offset:0 atIndex:0];
+    [enc setVertexBuffer:skinning.instances.buffer offset:skinning.instances.offset atIndex:2];
+    const uint32_t count = (uint32_t)frustum_cull(frustum, skinning.bounds, skinning.visible.data());
+    for (uint32_t k = 0; k < count; ++k) {
+        const uint32_t i = skinning.visible[k];
+        [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                        indexCount:skinning.mesh.indexCount
+                         indexType:skinning.mesh.indexType
+                       indexBuffer:skinning.mesh.indexBuffer
+                 indexBufferOffset:0
+                     instanceCount:1
+                        baseVertex:(NSInteger)i * skinning.vertexCount
+                      baseInstance:i];
+        frame_stats_count_draw(frameStats, skinning.mesh.indexCount);
+    }
+}
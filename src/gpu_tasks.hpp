@@ -0,0 +1,67 @@
+/**
+ * @file gpu_tasks.hpp
+ * @brief Awaitables for GPU completion events and Metal IO loads, for coroutine tasks (task.hpp).
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "asset_loader.hpp"
+#include "resource_uploader.hpp"
+#include "task.hpp"
+
+/**
+ * @struct GpuEventAwaiter
+ * @brief Continues the awaiting task as a job once a shared event reaches a value.
+ *
+ * Woken by an MTLSharedEventListener notification rather than polled. Not cancellable: the
+ * GPU always gets there, and a flow that no longer wants the result checks its token after.
+ */
+struct GpuEventAwaiter {
+    TaskScheduler& scheduler;
+    id<MTLSharedEvent> event;
+    uint64_t value;
+    JobPriority priority;
+
+    bool await_ready() const { return event.signaledValue >= value; }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() noexcept {}
+};
+
+/**
+ * @brief Returns an awaitable for a shared event value, e.g. one a command buffer signals.
+ * @param scheduler Queues the continuation.
+ * @param event The event.
+ * @param value The value to wait for.
+ * @param priority The pool to continue on.
+ */
+inline GpuEventAwaiter gpu_event(TaskScheduler& scheduler, id<MTLSharedEvent> event, uint64_t value,
+                                 JobPriority priority = JobPriority::Background) {
+    return { scheduler, event, value, priority };
+}
+
+/**
+ * @brief Returns an awaitable for the uploads covered by a ResourceUploader::flush() or flush_throttled() value.
+ * @param scheduler Queues the continuation.
+ * @param uploader The uploader that returned the value.
+ * @param value The value.
+ * @param priority The pool to continue on.
+ */
+inline GpuEventAwaiter uploads_landed(TaskScheduler& scheduler, const ResourceUploader& uploader, uint64_t value,
+                                      JobPriority priority = JobPriority::Background) {
+    return { scheduler, uploader.event(), value, priority };
+}
+
+/**
+ * @brief Waits for an IO load; polled by TaskScheduler::poll().
+ *
+ * A cancelled wait cancels the load too, and still returns only once the IO queue has let go
+ * of the destination, so the caller can hand it to someone else straight away.
+ * @param scheduler Polls the load.
+ * @param load The load.
+ * @param priority The pool to continue on.
+ * @param cancel Cancels the wait and the load.
+ * @return Complete, or Failed if the load failed or was cancelled.
+ */
+Task<AssetLoadStatus> asset_loaded(TaskScheduler& scheduler, AssetLoad load,
+                                   JobPriority priority = JobPriority::Background, CancelToken cancel = {});
@@ -0,0 +1,29 @@
+#import "gpu_tasks.hpp"
+
+namespace {
+    // One listener, and so one dispatch queue, for every event; its blocks only queue jobs
+    MTLSharedEventListener* shared_listener() {
+        static MTLSharedEventListener* listener = [[MTLSharedEventListener alloc] init];
+        return listener;
+    }
+}
+
+void GpuEventAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    TaskScheduler* target = &scheduler;
+    const JobPriority continueOn = priority;
+    // Fires at once if the value was reached since await_ready()
+    [event notifyListener:shared_listener() atValue:value block:^(id<MTLSharedEvent>, uint64_t) {
+        target->resume(handle, continueOn);
+    }];
+}
+
+Task<AssetLoadStatus> asset_loaded(TaskScheduler& scheduler, AssetLoad load, JobPriority priority,
+                                   CancelToken cancel) {
+    const auto finished = [load] { return AssetLoader::status(load) != AssetLoadStatus::Pending; };
+    if (!co_await scheduler.until(finished, priority, cancel)) {
+        AssetLoader::cancel(load);
+        co_await scheduler.until(finished, priority);
+        co_return AssetLoadStatus::Failed;
+    }
+    co_return AssetLoader::status(load);
+}
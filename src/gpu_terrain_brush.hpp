@@ -0,0 +1,142 @@
+/**
+ * @file gpu_terrain_brush.hpp
+ * @brief Terrain brushes run by the kernel of terrain_brush.metal, read back to the CPU edits tile by tile.
+ *
+ * A window of the edit grid lives on the GPU as two R32Float textures: the unedited heights
+ * and the edit offsets over them. The window is large, so its tiles of TERRAIN_EDIT_TILE
+ * points are uploaded only when a brush first reaches them. Each brush is one dispatch over
+ * its rectangle on a command buffer of its own, which copies the offsets of the tiles it
+ * touched into a shared buffer; the frame never waits for it. gpu_terrain_brush_collect()
+ * hands finished readbacks to ChunkManager::write_edit_offsets() in the order they were
+ * applied, so the chunks, the height field and the edit history see the same offsets as the
+ * GPU, a frame or two later.
+ *
+ * Brushes too large for the scratch texture, or outside the window while readbacks are in
+ * flight, are left to the caller, which runs them on the CPU with ChunkManager::edit() once
+ * nothing is pending. Any change to the edits made elsewhere, such as an undo, must drop the
+ * tiles it covers with gpu_terrain_brush_invalidate().
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "chunk_manager.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+#include "terrain_edit.hpp"
+#include "terrain_edit_history.hpp"
+
+/**
+ * @struct TerrainBrushParams
+ * @brief One brush application; matches TerrainBrushParams in terrain_brush.metal.
+ */
+struct TerrainBrushParams {
+    int32_t originX;        ///< First column of the brush rectangle, in window texels.
+    int32_t originZ;        ///< First row of the brush rectangle, in window texels.
+    int32_t pointX;         ///< First column of the brush rectangle on the edit grid.
+    int32_t pointZ;         ///< First row of the brush rectangle on the edit grid.
+    uint32_t width;         ///< Columns of the brush rectangle.
+    uint32_t depth;         ///< Rows of the brush rectangle.
+    uint32_t mode;          ///< TerrainBrushMode.
+    float spacing;          ///< World distance between grid points.
+    float centerX;          ///< World x of the brush centre.
+    float centerZ;          ///< World z of the brush centre.
+    float radius;           ///< Brush radius.
+    float strength;         ///< As TerrainBrush::strength.
+    float targetHeight;     ///< Height Flatten moves towards.
+    float talus;            ///< Slope past which Erode slides.
+    float heightLimit;      ///< Edited heights are kept in [-heightLimit, heightLimit].
+};
+
+/**
+ * @struct GpuTerrainBrushReadback
+ * @brief The offsets of the tiles one brush touched, on their way back to the CPU.
+ */
+struct GpuTerrainBrushReadback {
+    id<MTLBuffer> offsets;              ///< Shared copy of rect's offsets, row-major.
+    TerrainGridRect rect;               ///< Grid points copied; whole tiles.
+    std::atomic<bool> done{ false };    ///< Set when the command buffer completes.
+    std::atomic<bool> failed{ false };  ///< Set with done if the command buffer did not complete.
+};
+
+/**
+ * @struct GpuTerrainBrush
+ * @brief The window textures, which of their tiles are resident, and the readbacks in flight.
+ */
+struct GpuTerrainBrush {
+    id<MTLComputePipelineState> pipeline;   ///< terrain_brush_apply.
+    id<MTLTexture> base;                    ///< Unedited heights of the window.
+    id<MTLTexture> offsets;                 ///< Edit offsets of the window.
+    id<MTLTexture> scratch;                 ///< New offsets of the brush rectangle, copied into offsets.
+    int size = 0;                           ///< Points along each side of the window; whole tiles.
+    int maxBrush = 0;                       ///< Points along each side of the largest brush rectangle.
+    TerrainGridRect window;                 ///< Grid points the textures cover.
+    std::vector<uint8_t> resident;          ///< 1 per window tile whose texels are uploaded, row-major.
+    uint64_t uploadValue = 0;               ///< Uploader value of the last tile upload.
+    std::deque<std::shared_ptr<GpuTerrainBrushReadback>> pending; ///< Oldest first.
+    std::vector<id<MTLBuffer>> spareReadbacks; ///< Readback buffers of collected brushes, for the next ones.
+    uint32_t applied = 0;                   ///< Brushes run on the GPU.
+    uint32_t tilesUploaded = 0;             ///< Window tiles uploaded since the window was placed.
+    uint32_t tilesRead = 0;                 ///< Tiles read back by the last collect that wrote any.
+};
+
+/// @return True if metal_terrain_brush_pipelines() compiled the kernel.
+bool gpu_terrain_brush_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the window textures, with nothing resident.
+ * @param metal The Metal context; its terrain brush pipeline must exist.
+ * @param size Points along each side of the window; rounded up to whole tiles.
+ * @param maxBrush Points along each side of the largest brush the GPU runs.
+ * @return The brush, its window not yet placed.
+ */
+GpuTerrainBrush create_gpu_terrain_brush(const MetalContext& metal, int size = 4096, int maxBrush = 256);
+
+/**
+ * @brief Runs a brush on the GPU.
+ *
+ * Uploads the window tiles the brush reaches that are not yet resident, through the uploader,
+ * and commits the brush's command buffer to metal.queue after them. With nothing pending, a
+ * brush outside the window first moves the window to centre on it.
+ *
+ * @param gpuBrush The brush textures.
+ * @param metal The Metal context.
+ * @param uploader Uploads the tiles; flushed here when any were.
+ * @param chunkManager Samples the unedited heights and holds the current offsets.
+ * @param brush The brush.
+ * @return False if the brush must run on the CPU instead; see the file comment.
+ */
+bool gpu_terrain_brush_apply(GpuTerrainBrush& gpuBrush, const MetalContext& metal, ResourceUploader& uploader,
+                             ChunkManager& chunkManager, const TerrainBrush& brush);
+
+/**
+ * @brief Writes the finished readbacks into the chunk manager's edits, oldest first.
+ *
+ * Stops at the first readback still in flight. A failed readback drops its tiles, so they
+ * are uploaded again from the CPU edits, which never saw that brush.
+ *
+ * @param gpuBrush The brush textures.
+ * @param chunkManager Receives the offsets with ChunkManager::write_edit_offsets().
+ * @return The grid points whose offset changed; empty if none did.
+ */
+TerrainGridRect gpu_terrain_brush_collect(GpuTerrainBrush& gpuBrush, ChunkManager& chunkManager);
+
+/**
+ * @brief Drops the window tiles a change made elsewhere covers; the next brush to reach them uploads them again.
+ * @param gpuBrush The brush textures.
+ * @param rect The grid points whose offsets changed.
+ */
+void gpu_terrain_brush_invalidate(GpuTerrainBrush& gpuBrush, const TerrainGridRect& rect);
+
+/// @return True while readbacks are in flight.
+inline bool gpu_terrain_brush_pending(const GpuTerrainBrush& gpuBrush) { return !gpuBrush.pending.empty(); }
+
+/// @return GPU bytes of the textures and the readbacks in flight.
+size_t gpu_terrain_brush_bytes(const GpuTerrainBrush& gpuBrush);
@@ -0,0 +1,236 @@
+#import "gpu_terrain_brush.hpp"
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+namespace {
+    bool contains(const TerrainGridRect& outer, const TerrainGridRect& inner) {
+        return !outer.empty() && inner.x0 >= outer.x0 && inner.z0 >= outer.z0 && inner.x1 <= outer.x1 &&
+               inner.z1 <= outer.z1;
+    }
+
+    int tiles_per_side(const GpuTerrainBrush& gpuBrush) {
+        return gpuBrush.size / TERRAIN_EDIT_TILE;
+    }
+
+    // The window starts on a tile, so its tiles are the history's tiles
+    size_t resident_index(const GpuTerrainBrush& gpuBrush, int tileX, int tileZ) {
+        return (size_t)(tileZ - gpuBrush.window.z0 / TERRAIN_EDIT_TILE) * tiles_per_side(gpuBrush) +
+               (tileX - gpuBrush.window.x0 / TERRAIN_EDIT_TILE);
+    }
+
+    void place_window(GpuTerrainBrush& gpuBrush, const TerrainGridRect& rect) {
+        const TerrainGridRect centre = terrain_edit_tiles({ (rect.x0 + rect.x1) / 2, (rect.z0 + rect.z1) / 2,
+                                                            (rect.x0 + rect.x1) / 2, (rect.z0 + rect.z1) / 2 });
+        const int x0 = (centre.x0 - tiles_per_side(gpuBrush) / 2) * TERRAIN_EDIT_TILE;
+        const int z0 = (centre.z0 - tiles_per_side(gpuBrush) / 2) * TERRAIN_EDIT_TILE;
+        gpuBrush.window = { x0, z0, x0 + gpuBrush.size - 1, z0 + gpuBrush.size - 1 };
+        std::fill(gpuBrush.resident.begin(), gpuBrush.resident.end(), 0);
+        gpuBrush.tilesUploaded = 0;
+    }
+
+    // Covers the whole tiles of any brush rectangle up to maxBrush points a side
+    size_t readback_bytes(const GpuTerrainBrush& gpuBrush) {
+        const size_t tiles = (size_t)(gpuBrush.maxBrush + TERRAIN_EDIT_TILE - 1) / TERRAIN_EDIT_TILE + 1;
+        const size_t side = tiles * TERRAIN_EDIT_TILE;
+        return side * side * sizeof(float);
+    }
+}
+
+bool gpu_terrain_brush_supported(const MetalContext& metal) {
+    return metal.terrain_brush_pipeline != nil;
+}
+
+GpuTerrainBrush create_gpu_terrain_brush(const MetalContext& metal, int size, int maxBrush) {
+    GpuTerrainBrush gpuBrush;
+    gpuBrush.pipeline = metal.terrain_brush_pipeline;
+    gpuBrush.size = (std::max(size, TERRAIN_EDIT_TILE) + TERRAIN_EDIT_TILE - 1) / TERRAIN_EDIT_TILE * TERRAIN_EDIT_TILE;
+    gpuBrush.maxBrush = std::max(maxBrush, 1);
+    gpuBrush.resident.assign((size_t)tiles_per_side(gpuBrush) * tiles_per_side(gpuBrush), 0);
+
+    auto make_texture = [&](int side, MTLTextureUsage usage, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR32Float
+                                                                                        width:side
+                                                                                       height:side
+                                                                                    mipmapped:NO];
+        desc.usage = usage;
+        desc.storageMode = MTLStorageModePrivate;
+        id<MTLTexture> texture = [metal.device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    };
+    gpuBrush.base = make_texture(gpuBrush.size, MTLTextureUsageShaderRead, @"Terrain brush heights");
+    gpuBrush.offsets = make_texture(gpuBrush.size, MTLTextureUsageShaderRead, @"Terrain brush offsets");
+    gpuBrush.scratch = make_texture(gpuBrush.maxBrush, MTLTextureUsageShaderWrite, @"Terrain brush scratch");
+    return gpuBrush;
+}
+
+bool gpu_terrain_brush_apply(GpuTerrainBrush& gpuBrush, const MetalContext& metal, ResourceUploader& uploader,
+                             ChunkManager& chunkManager, const TerrainBrush& brush) {
+    TRACE_SCOPE("Terrain brush on GPU");
+    const TerrainEdits& edits = chunkManager.edits();
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    if (rect.empty()) {
+        return true;
+    }
+    if (rect.width() > gpuBrush.maxBrush || rect.depth() > gpuBrush.maxBrush) {
+        return false;
+    }
+    // Moving the window would drop tiles readbacks in flight still copy from
+    if (!contains(gpuBrush.window, rect)) {
+        if (!gpuBrush.pending.empty() || rect.width() > gpuBrush.size || rect.depth() > gpuBrush.size) {
+            return false;
+        }
+        place_window(gpuBrush, rect);
+    }
+
+    // Tiles come from the CPU edits the first time a brush reaches them; after that the GPU's copy is ahead
+    const TerrainGridRect tiles = terrain_edit_tiles(rect);
+    std::vector<float> base;
+    std::vector<float> offsets;
+    bool uploaded = false;
+    for (int z = tiles.z0; z <= tiles.z1; ++z) {
+        for (int x = tiles.x0; x <= tiles.x1; ++x) {
+            uint8_t& resident = gpuBrush.resident[resident_index(gpuBrush, x, z)];
+            if (resident) {
+                continue;
+            }
+            const TerrainGridRect tile = terrain_edit_tile_rect(x, z);
+            base.resize((size_t)TERRAIN_EDIT_TILE * TERRAIN_EDIT_TILE);
+            offsets.resize(base.size());
+            chunkManager.sample_base_heights(tile, base.data());
+            edits.read_offsets(tile, offsets.data());
+            const MTLRegion region = MTLRegionMake2D(tile.x0 - gpuBrush.window.x0, tile.z0 - gpuBrush.window.z0,
+                                                     TERRAIN_EDIT_TILE, TERRAIN_EDIT_TILE);
+            uploader.update_texture(gpuBrush.base, region, base.data(), TERRAIN_EDIT_TILE * sizeof(float));
+            uploader.update_texture(gpuBrush.offsets, region, offsets.data(), TERRAIN_EDIT_TILE * sizeof(float));
+            resident = 1;
+            ++gpuBrush.tilesUploaded;
+            uploaded = true;
+        }
+    }
+    if (uploaded) {
+        gpuBrush.uploadValue = uploader.flush();
+    }
+
+    TerrainBrushParams params;
+    params.originX = rect.x0 - gpuBrush.window.x0;
+    params.originZ = rect.z0 - gpuBrush.window.z0;
+    params.pointX = rect.x0;
+    params.pointZ = rect.z0;
+    params.width = (uint32_t)rect.width();
+    params.depth = (uint32_t)rect.depth();
+    params.mode = (uint32_t)brush.mode;
+    params.spacing = edits.spacing();
+    params.centerX = brush.centerX;
+    params.centerZ = brush.centerZ;
+    params.radius = brush.radius;
+    params.strength = brush.strength;
+    params.targetHeight = brush.targetHeight;
+    params.talus = brush.talus;
+    params.heightLimit = edits.height_limit();
+
+    id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+    cmd.label = @"Terrain brush";
+    uploader.encode_wait(cmd, gpuBrush.uploadValue);
+
+    // Smooth and Erode read the neighbours as they were, so the brush writes to scratch and is copied in after
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    [enc setComputePipelineState:gpuBrush.pipeline];
+    [enc setBytes:&params length:sizeof(params) atIndex:0];
+    [enc setTexture:gpuBrush.base atIndex:0];
+    [enc setTexture:gpuBrush.offsets atIndex:1];
+    [enc setTexture:gpuBrush.scratch atIndex:2];
+    [enc dispatchThreads:MTLSizeMake(params.width, params.depth, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    [enc endEncoding];
+
+    auto readback = std::make_shared<GpuTerrainBrushReadback>();
+    readback->rect = { tiles.x0 * TERRAIN_EDIT_TILE, tiles.z0 * TERRAIN_EDIT_TILE,
+                       (tiles.x1 + 1) * TERRAIN_EDIT_TILE - 1, (tiles.z1 + 1) * TERRAIN_EDIT_TILE - 1 };
+    if (!gpuBrush.spareReadbacks.empty()) {
+        readback->offsets = gpuBrush.spareReadbacks.back();
+        gpuBrush.spareReadbacks.pop_back();
+    } else {
+        readback->offsets = [metal.device newBufferWithLength:readback_bytes(gpuBrush)
+                                                      options:MTLResourceStorageModeShared];
+        readback->offsets.label = @"Terrain brush readback";
+    }
+
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    [blit copyFromTexture:gpuBrush.scratch
+              sourceSlice:0
+              sourceLevel:0
+             sourceOrigin:MTLOriginMake(0, 0, 0)
+               sourceSize:MTLSizeMake(params.width, params.depth, 1)
+                toTexture:gpuBrush.offsets
+         destinationSlice:0
+         destinationLevel:0
+        destinationOrigin:MTLOriginMake(params.originX, params.originZ, 0)];
+    // Whole tiles go back, so the CPU edits and the history see the same tiles the GPU holds
+    const TerrainGridRect& back = readback->rect;
+    [blit copyFromTexture:gpuBrush.offsets
+                     sourceSlice:0
+                     sourceLevel:0
+                    sourceOrigin:MTLOriginMake(back.x0 - gpuBrush.window.x0, back.z0 - gpuBrush.window.z0, 0)
+                      sourceSize:MTLSizeMake(back.width(), back.depth(), 1)
+                        toBuffer:readback->offsets
+               destinationOffset:0
+          destinationBytesPerRow:back.width() * sizeof(float)
+        destinationBytesPerImage:(size_t)back.width() * back.depth() * sizeof(float)];
+    [blit endEncoding];
+
+    // The handler only flips the flags; gpu_terrain_brush_collect() writes the offsets on the main thread
+    std::shared_ptr<GpuTerrainBrushReadback> landed = readback;
+    [cmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+        landed->failed.store(completed.status != MTLCommandBufferStatusCompleted, std::memory_order_relaxed);
+        landed->done.store(true, std::memory_order_release);
+    }];
+    [cmd commit];
+    gpuBrush.pending.push_back(std::move(readback));
+    ++gpuBrush.applied;
+    return true;
+}
+
+TerrainGridRect gpu_terrain_brush_collect(GpuTerrainBrush& gpuBrush, ChunkManager& chunkManager) {
+    TerrainGridRect changed;
+    uint32_t tilesRead = 0;
+    while (!gpuBrush.pending.empty() && gpuBrush.pending.front()->done.load(std::memory_order_acquire)) {
+        std::shared_ptr<GpuTerrainBrushReadback> readback = std::move(gpuBrush.pending.front());
+        gpuBrush.pending.pop_front();
+        if (readback->failed.load(std::memory_order_relaxed)) {
+            gpu_terrain_brush_invalidate(gpuBrush, readback->rect);
+        } else {
+            TRACE_SCOPE("Collect terrain brush");
+            changed = terrain_grid_rect_union(changed, chunkManager.write_edit_offsets(
+                                                           readback->rect, (const float*)readback->offsets.contents));
+            tilesRead += (uint32_t)(readback->rect.width() / TERRAIN_EDIT_TILE *
+                                             (readback->rect.depth() / TERRAIN_EDIT_TILE));
+        }
+        gpuBrush.spareReadbacks.push_back(readback->offsets);
+    }
+    if (tilesRead > 0) {
+        gpuBrush.tilesRead = tilesRead;
+    }
+    return changed;
+}
+
+void gpu_terrain_brush_invalidate(GpuTerrainBrush& gpuBrush, const TerrainGridRect& rect) {
+    const TerrainGridRect tiles = terrain_edit_tiles(terrain_grid_rect_intersect(rect, gpuBrush.window));
+    for (int z = tiles.z0; z <= tiles.z1; ++z) {
+        for (int x = tiles.x0; x <= tiles.x1; ++x) {
+            gpuBrush.resident[resident_index(gpuBrush, x, z)] = 0;
+        }
+    }
+}
+
+size_t gpu_terrain_brush_bytes(const GpuTerrainBrush& gpuBrush) {
+    size_t bytes = gpuBrush.base.allocatedSize + gpuBrush.offsets.allocatedSize + gpuBrush.scratch.allocatedSize;
+    for (const std::shared_ptr<GpuTerrainBrushReadback>& readback : gpuBrush.pending) {
+        bytes += readback->offsets.allocatedSize;
+    }
+    for (id<MTLBuffer> buffer : gpuBrush.spareReadbacks) {
+        bytes += buffer.allocatedSize;
+    }
+    return bytes;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file gpu_terrain_clipmap.hpp
+ * @brief The terrain drawn as a geometry clipmap, an alternative to the streamed chunks.
+ *
+ * Each frame gpu_terrain_clipmap_encode places the levels around the camera (clipmap.hpp) and
+ * dispatches update_terrain_clipmap over the strips of lattice points that entered each level's
+ * window (terrain_clipmap.hpp), writing their noise heights into the level's slice of an
+ * r16Float texture array. landscape_vertex_clipmap then draws every level from one shared grid
+ * with the ordinary landscape fragment shader. The work per frame depends on how far the camera
+ * moved, not on the size of the world or the view distance, and the chunks are only drawn where
+ * the other terrain paths are used; streaming carries on for the foliage, shadows and physics.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "camera.hpp"
+#include "chunk_manager.hpp"
+#include "clipmap.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+#include "terrain_clipmap.hpp"
+
+/**
+ * @struct GpuTerrainClipmap
+ * @brief The clipmap grid, the height slices and where each slice's window lies.
+ */
+struct GpuTerrainClipmap {
+    id<MTLComputePipelineState> updatePipeline;     ///< update_terrain_clipmap.
+    id<MTLTexture> heights;                         ///< r16Float array, one toroidal slice per level.
+    id<MTLBuffer> grid;                             ///< clipmap_grid() indices.
+    uint32_t fullCount = 0;                         ///< Indices of the full grid.
+    uint32_t ringCount = 0;                         ///< Indices of the ring, after the full grid's.
+    uint32_t gridSize = 128;                        ///< Cells per side of a level.
+    uint32_t textureSize = 0;                       ///< terrain_clipmap_texture_size() of the grid.
+    float cellSize = 1.0f;                          ///< World side of a cell of the innermost level.
+    uint32_t levelCount = 1;                        ///< Levels drawn.
+    TerrainParams terrain;                          ///< The terrain whose noise the slices hold.
+    ClipmapLevel levels[CLIPMAP_MAX_LEVELS] = {};   ///< This frame's levels, after gpu_terrain_clipmap_encode.
+    simd::int2 origins[CLIPMAP_MAX_LEVELS] = {};    ///< Window origin each slice holds.
+    bool valid = false;                             ///< False until the slices were first filled.
+    uint32_t refreshedTexels = 0;                   ///< Lattice points the last encode recomputed.
+};
+
+/// @return True if the height update kernel compiled.
+bool gpu_terrain_clipmap_supported(const MetalContext& metal);
+
+/**
+ * @brief Uploads the grid and creates the height slices.
+ * @param metal The Metal context; its clipmap update pipeline must exist.
+ * @param uploader Uploads the grid; must be flushed before the first draw.
+ * @param config The streamed terrain: its noise, the spacing of its vertices for the innermost
+ *        cells, and its load radius for the reach.
+ * @return The clipmap.
+ */
+GpuTerrainClipmap create_gpu_terrain_clipmap(const MetalContext& metal, ResourceUploader& uploader,
+                                             const ChunkManagerConfig& config);
+
+/// @return GPU bytes held by the height slices and the grid.
+size_t gpu_terrain_clipmap_bytes(const GpuTerrainClipmap& clipmap);
+
+/**
+ * @brief Moves the levels to the camera and refreshes the heights that entered their windows.
+ * @param clipmap The clipmap.
+ * @param cmd The frame's command buffer; encoded before the pass that draws the terrain.
+ * @param cam The camera of this frame.
+ */
+void gpu_terrain_clipmap_encode(GpuTerrainClipmap& clipmap, id<MTLCommandBuffer> cmd, const Camera& cam);
+
+/**
+ * @brief Draws every level.
+ * @param clipmap The clipmap, after gpu_terrain_clipmap_encode.
+ * @param enc The render encoder, set up like one drawing chunks.
+ * @param pipeline A ShaderProgram::LandscapeClipmap pipeline.
+ * @param depthState The depth state of the pass.
+ * @return The number of indices drawn.
+ */
+uint32_t gpu_terrain_clipmap_draw(const GpuTerrainClipmap& clipmap, id<MTLRenderCommandEncoder> enc,
+                                  id<MTLRenderPipelineState> pipeline, id<MTLDepthStencilState> depthState);
@@ -0,0 +1,146 @@
+#import "gpu_terrain_clipmap.hpp"
+
+#include <algorithm>
+
+#include "trace.hpp"
+
+namespace {
+    // Matches TerrainClipmapUpdate in shaders.metal
+    struct TerrainClipmapUpdate {
+        simd::int2 origin;
+        simd::uint2 size;
+        float cellSize;
+        uint32_t level;
+        uint32_t textureSize;
+        float noiseOffset;
+        float noiseScale;
+        float heightScale;
+        NoiseSettings noise;
+    };
+
+    // Matches TerrainClipmapUniforms in shaders.metal
+    struct TerrainClipmapUniforms {
+        uint32_t gridSize;
+        uint32_t textureSize;
+        uint32_t levelCount;
+        uint32_t padding;
+        ClipmapLevel levels[CLIPMAP_MAX_LEVELS];
+    };
+}
+
+bool gpu_terrain_clipmap_supported(const MetalContext& metal) {
+    return metal.update_terrain_clipmap_pipeline != nil;
+}
+
+GpuTerrainClipmap create_gpu_terrain_clipmap(const MetalContext& metal, ResourceUploader& uploader,
+                                             const ChunkManagerConfig& config) {
+    GpuTerrainClipmap clipmap;
+    clipmap.updatePipeline = metal.update_terrain_clipmap_pipeline;
+    clipmap.terrain = config.terrain;
+    // The innermost cells match the chunks' vertex spacing
+    clipmap.cellSize = config.chunkSize / (float)(config.resolution - 1);
+    clipmap.textureSize = terrain_clipmap_texture_size(clipmap.gridSize);
+    clipmap.levelCount = clipmap_level_count(clipmap.gridSize, clipmap.cellSize, config.loadRadius * config.chunkSize);
+
+    const ClipmapGrid grid = clipmap_grid(clipmap.gridSize);
+    clipmap.grid =
+        uploader.upload(grid.indices.data(), grid.indices.size() * sizeof(uint16_t), @"Terrain clipmap grid");
+    clipmap.fullCount = grid.fullCount;
+    clipmap.ringCount = grid.ringCount;
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR16Float
+                                                                                    width:clipmap.textureSize
+                                                                                   height:clipmap.textureSize
+                                                                                mipmapped:NO];
+    desc.textureType = MTLTextureType2DArray;
+    desc.arrayLength = clipmap.levelCount;
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+    clipmap.heights = [metal.device newTextureWithDescriptor:desc];
+    clipmap.heights.label = @"Terrain clipmap heights";
+    return clipmap;
+}
+
+size_t gpu_terrain_clipmap_bytes(const GpuTerrainClipmap& clipmap) {
+    return clipmap.heights.allocatedSize + clipmap.grid.allocatedSize;
+}
+
+void gpu_terrain_clipmap_encode(GpuTerrainClipmap& clipmap, id<MTLCommandBuffer> cmd, const Camera& cam) {
+    // Each level's lattice is its cell size, so the slices need no mips
+    clipmap_place(clipmap.cellSize, clipmap.levelCount, { cam.position.x, cam.position.z }, clipmap.cellSize,
+                  clipmap.levels);
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(clipmap.terrain);
+    TerrainClipmapUpdate update;
+    update.textureSize = clipmap.textureSize;
+    update.noiseOffset = mapping.offset;
+    update.noiseScale = mapping.scale;
+    update.heightScale = mapping.heightScale;
+    update.noise = mapping.noise;
+
+    clipmap.refreshedTexels = 0;
+    id<MTLComputeCommandEncoder> enc = nil;
+    for (uint32_t l = 0; l < clipmap.levelCount; ++l) {
+        const simd::int2 origin = terrain_clipmap_origin(clipmap.levels[l], clipmap.textureSize);
+        TerrainClipmapRegion regions[2];
+        const uint32_t count =
+            terrain_clipmap_dirty_regions(clipmap.origins[l], origin, clipmap.valid, clipmap.textureSize, regions);
+        clipmap.origins[l] = origin;
+        for (uint32_t r = 0; r < count; ++r) {
+            // Most frames nothing moved, so the encoder is only opened for the first region
+            if (!enc) {
+                enc = [cmd computeCommandEncoder];
+                enc.label = @"Terrain clipmap";
+                TRACE_PUSH_GROUP(enc, "Terrain clipmap update");
+                [enc setComputePipelineState:clipmap.updatePipeline];
+                [enc setTexture:clipmap.heights atIndex:0];
+            }
+            update.origin = regions[r].origin;
+            update.size = regions[r].size;
+            update.cellSize = clipmap.levels[l].cellSize;
+            update.level = l;
+            [enc setBytes:&update length:sizeof(update) atIndex:0];
+            [enc dispatchThreads:MTLSizeMake(update.size.x, update.size.y, 1)
+                threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+            clipmap.refreshedTexels += update.size.x * update.size.y;
+        }
+    }
+    clipmap.valid = true;
+    if (enc) {
+        TRACE_POP_GROUP(enc);
+        [enc endEncoding];
+    }
+}
+
+uint32_t gpu_terrain_clipmap_draw(const GpuTerrainClipmap& clipmap, id<MTLRenderCommandEncoder> enc,
+                                  id<MTLRenderPipelineState> pipeline, id<MTLDepthStencilState> depthState) {
+    TerrainClipmapUniforms uniforms;
+    uniforms.gridSize = clipmap.gridSize;
+    uniforms.textureSize = clipmap.textureSize;
+    uniforms.levelCount = clipmap.levelCount;
+    uniforms.padding = 0;
+    std::copy(clipmap.levels, clipmap.levels + CLIPMAP_MAX_LEVELS, uniforms.levels);
+
+    [enc setRenderPipelineState:pipeline];
+    [enc setDepthStencilState:depthState];
+    [enc setVertexBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+    [enc setVertexTexture:clipmap.heights atIndex:0];
+    // The innermost level is the full grid; every other level is one instance of the ring around it
+    [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                    indexCount:clipmap.fullCount
+                     indexType:MTLIndexTypeUInt16
+                   indexBuffer:clipmap.grid
+             indexBufferOffset:0];
+    uint32_t indices = clipmap.fullCount;
+    if (clipmap.levelCount > 1) {
+        [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                        indexCount:clipmap.ringCount
+                         indexType:MTLIndexTypeUInt16
+                       indexBuffer:clipmap.grid
+                 indexBufferOffset:clipmap.fullCount * sizeof(uint16_t)
+                     instanceCount:clipmap.levelCount - 1
+                        baseVertex:0
+                      baseInstance:1];
+        indices += clipmap.ringCount * (clipmap.levelCount - 1);
+    }
+    return indices;
+}
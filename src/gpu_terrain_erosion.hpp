@@ -0,0 +1,46 @@
+/**
+ * @file gpu_terrain_erosion.hpp
+ * @brief The erosion simulation of terrain_erosion.hpp, run by the kernels of erosion.metal.
+ *
+ * A grid is uploaded once, then every step is five dispatches in one compute pass, with the
+ * flux buffers swapped between steps, and only the terrain is read back, so hundreds of
+ * iterations cost one command buffer. The caller waits for it: the chunk generation jobs
+ * erode the windows, and they already wait for their own command buffers.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "metal_context.hpp"
+#include "terrain_erosion.hpp"
+
+/**
+ * @struct GpuErosion
+ * @brief The erosion pipelines, one per stage of a step.
+ */
+struct GpuErosion {
+    id<MTLComputePipelineState> flux;       ///< erosion_flux.
+    id<MTLComputePipelineState> water;      ///< erosion_water.
+    id<MTLComputePipelineState> sediment;   ///< erosion_sediment.
+    id<MTLComputePipelineState> transport;  ///< erosion_transport.
+    id<MTLComputePipelineState> thermal;    ///< erosion_thermal.
+};
+
+/// @return True if metal_erosion_pipelines() compiled the kernels.
+bool gpu_erosion_supported(const MetalContext& metal);
+
+/// @return The context's erosion pipelines.
+GpuErosion create_gpu_erosion(const MetalContext& metal);
+
+/**
+ * @brief Erodes a height grid on the GPU, as erode_heights() does on the CPU.
+ * @param erosion The pipelines.
+ * @param queue The queue to run on; blocks until its command buffer completes.
+ * @param heights width * depth heights, row-major; receives the eroded ones.
+ * @param width Points along X; at least 2.
+ * @param depth Points along Z; at least 2.
+ * @param spacing The world distance between points.
+ * @param settings The simulation; runs settings.iterations steps.
+ */
+void gpu_erode_heights(const GpuErosion& erosion, id<MTLCommandQueue> queue, float* heights, int width, int depth,
+                       float spacing, const ErosionSettings& settings);
@@ -0,0 +1,98 @@
+#import "gpu_terrain_erosion.hpp"
+
+#include <cstring>
+
+#include "trace.hpp"
+
+bool gpu_erosion_supported(const MetalContext& metal) {
+    return metal.erosion_flux_pipeline && metal.erosion_water_pipeline && metal.erosion_sediment_pipeline &&
+           metal.erosion_transport_pipeline && metal.erosion_thermal_pipeline;
+}
+
+GpuErosion create_gpu_erosion(const MetalContext& metal) {
+    GpuErosion erosion;
+    erosion.flux = metal.erosion_flux_pipeline;
+    erosion.water = metal.erosion_water_pipeline;
+    erosion.sediment = metal.erosion_sediment_pipeline;
+    erosion.transport = metal.erosion_transport_pipeline;
+    erosion.thermal = metal.erosion_thermal_pipeline;
+    return erosion;
+}
+
+void gpu_erode_heights(const GpuErosion& erosion, id<MTLCommandQueue> queue, float* heights, int width, int depth,
+                       float spacing, const ErosionSettings& settings) {
+    TRACE_SCOPE("Erode terrain on GPU");
+    const ErosionParams params = erosion_params(settings, width, depth, spacing);
+    const size_t count = (size_t)width * depth;
+    id<MTLDevice> device = queue.device;
+
+    // Every buffer starts dry and still, as in create_erosion_grid()
+    auto make_buffer = [&](size_t stride) {
+        id<MTLBuffer> buffer = [device newBufferWithLength:count * stride options:MTLResourceStorageModeShared];
+        memset(buffer.contents, 0, count * stride);
+        return buffer;
+    };
+    id<MTLBuffer> terrain[2] = { make_buffer(sizeof(float)), make_buffer(sizeof(float)) };
+    id<MTLBuffer> water[2] = { make_buffer(sizeof(float)), make_buffer(sizeof(float)) };
+    id<MTLBuffer> sediment[2] = { make_buffer(sizeof(float)), make_buffer(sizeof(float)) };
+    id<MTLBuffer> flux[2] = { make_buffer(sizeof(simd::float4)), make_buffer(sizeof(simd::float4)) };
+    id<MTLBuffer> velocity = make_buffer(sizeof(simd::float2));
+    memcpy(terrain[0].contents, heights, count * sizeof(float));
+
+    // The serial encoder finishes each dispatch before the next reads its output
+    id<MTLCommandBuffer> cmd = [queue commandBuffer];
+    cmd.label = @"Terrain erosion";
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    [enc setBytes:&params length:sizeof(params) atIndex:0];
+    const MTLSize grid = MTLSizeMake(width, depth, 1);
+    const MTLSize group = MTLSizeMake(8, 8, 1);
+    for (uint32_t step = 0; step < settings.iterations; ++step) {
+        id<MTLBuffer> fluxIn = flux[step & 1];
+        id<MTLBuffer> fluxOut = flux[(step + 1) & 1];
+
+        [enc setComputePipelineState:erosion.flux];
+        [enc setBuffer:terrain[0] offset:0 atIndex:1];
+        [enc setBuffer:water[0] offset:0 atIndex:2];
+        [enc setBuffer:fluxIn offset:0 atIndex:3];
+        [enc setBuffer:fluxOut offset:0 atIndex:4];
+        [enc dispatchThreads:grid threadsPerThreadgroup:group];
+
+        [enc setComputePipelineState:erosion.water];
+        [enc setBuffer:water[0] offset:0 atIndex:1];
+        [enc setBuffer:fluxOut offset:0 atIndex:2];
+        [enc setBuffer:water[1] offset:0 atIndex:3];
+        [enc setBuffer:velocity offset:0 atIndex:4];
+        [enc dispatchThreads:grid threadsPerThreadgroup:group];
+
+        [enc setComputePipelineState:erosion.sediment];
+        [enc setBuffer:terrain[0] offset:0 atIndex:1];
+        [enc setBuffer:sediment[0] offset:0 atIndex:2];
+        [enc setBuffer:velocity offset:0 atIndex:3];
+        [enc setBuffer:terrain[1] offset:0 atIndex:4];
+        [enc setBuffer:sediment[1] offset:0 atIndex:5];
+        [enc dispatchThreads:grid threadsPerThreadgroup:group];
+
+        [enc setComputePipelineState:erosion.transport];
+        [enc setBuffer:sediment[1] offset:0 atIndex:1];
+        [enc setBuffer:velocity offset:0 atIndex:2];
+        [enc setBuffer:water[1] offset:0 atIndex:3];
+        [enc setBuffer:sediment[0] offset:0 atIndex:4];
+        [enc setBuffer:water[0] offset:0 atIndex:5];
+        [enc dispatchThreads:grid threadsPerThreadgroup:group];
+
+        [enc setComputePipelineState:erosion.thermal];
+        [enc setBuffer:terrain[1] offset:0 atIndex:1];
+        [enc setBuffer:terrain[0] offset:0 atIndex:2];
+        [enc dispatchThreads:grid threadsPerThreadgroup:group];
+    }
+    [enc endEncoding];
+    [cmd commit];
+    [cmd waitUntilCompleted];
+
+    if (cmd.status == MTLCommandBufferStatusCompleted) {
+        memcpy(heights, terrain[0].contents, count * sizeof(float));
+    } else {
+        // The CPU reference erodes the same way, only slower
+        erode_heights(heights, width, depth, spacing, settings);
+    }
+}
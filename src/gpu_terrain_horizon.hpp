@@ -0,0 +1,66 @@
+/**
+ * @file gpu_terrain_horizon.hpp
+ * @brief Terrain self-shadowing from horizon maps baked once per chunk, for the ground past the shadow cascades.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "chunk_manager.hpp"
+#include "metal_context.hpp"
+#include "terrain_horizon.hpp"
+#include "terrain_material.hpp"
+
+/**
+ * @struct GpuTerrainHorizons
+ * @brief The horizon atlas and the kernel that bakes chunks into it.
+ *
+ * Each frame gpu_terrain_horizons_encode finds the resident chunks whose tile does not hold
+ * them yet and dispatches bake_terrain_horizons for each: one thread per texel marches the
+ * terrain's noise in HORIZON_DIRECTIONS directions and writes the horizon's sines into the
+ * chunk's tile (see terrain_horizon.hpp). The march leaves the chunk, so it samples the noise
+ * rather than any chunk's vertices, and edits do not rebake a tile. The
+ * ShaderVariant::horizonShadows landscape pipelines then take the sun's visibility from two
+ * taps of the tile where the cascades end, or everywhere without them.
+ */
+struct GpuTerrainHorizons {
+    id<MTLComputePipelineState> bakePipeline;   ///< bake_terrain_horizons.
+    id<MTLTexture> atlas;                       ///< Two RGBA8 slices, directions 0-3 and 4-7, HORIZON_TILE_TEXELS per tile edge.
+    TerrainHorizonUniforms uniforms = {};       ///< Bound at TERRAIN_HORIZON_BUFFER_INDEX; cascadeEnd set by each encode.
+    HorizonSettings settings;                   ///< March length and penumbra.
+    TerrainParams terrain;                      ///< The terrain the noise is sampled from.
+    TerrainMaterialSlots slots;                 ///< What each tile was baked for.
+    uint32_t baked = 0;                         ///< Chunks the last gpu_terrain_horizons_encode baked.
+};
+
+/// @return True if the bake kernel compiled.
+bool gpu_terrain_horizons_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the atlas for the chunks a ChunkManager keeps resident.
+ * @param metal The Metal context; its bake pipeline must exist.
+ * @param config The chunk manager's configuration; sizes the atlas and gives the terrain.
+ * @param settings March length and penumbra.
+ * @return The horizon state, with every tile unbaked.
+ */
+GpuTerrainHorizons create_gpu_terrain_horizons(const MetalContext& metal, const ChunkManagerConfig& config,
+                                               const HorizonSettings& settings = {});
+
+/// @return GPU bytes held by the atlas.
+size_t gpu_terrain_horizons_bytes(const GpuTerrainHorizons& horizons);
+
+/**
+ * @brief Bakes the resident chunks whose tile is missing, and sets where the horizon takes over.
+ *
+ * Must be encoded before the render pass that samples the atlas.
+ *
+ * @param horizons The horizon state.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks.
+ * @param cascadeEnd View depth the frame's shadow cascades cover; 0 if it has none.
+ */
+void gpu_terrain_horizons_encode(GpuTerrainHorizons& horizons, id<MTLCommandBuffer> cmd,
+                                 const ChunkManager& chunkManager, float cascadeEnd);
+
+/// @brief Binds the atlas and its uniforms for the landscape fragments.
+void gpu_terrain_horizons_bind(const GpuTerrainHorizons& horizons, id<MTLRenderCommandEncoder> enc);
@@ -0,0 +1,96 @@
+#import "gpu_terrain_horizon.hpp"
+
+namespace {
+    // Matches TerrainHorizonBakeParams in shaders.metal
+    struct TerrainHorizonBakeParams {
+        simd::float2 origin;    // World position of texel (0, 0)
+        simd::uint2 tileOrigin; // Atlas texel of the chunk's texel (0, 0)
+        uint32_t tileTexels;
+        float texelSpacing;
+        uint32_t steps;
+        float firstStep;
+        float stepGrowth;
+        float noiseOffset;
+        float noiseScale;
+        float heightScale;
+        NoiseSettings noise;
+    };
+}
+
+bool gpu_terrain_horizons_supported(const MetalContext& metal) {
+    return metal.bake_horizons_pipeline != nil;
+}
+
+GpuTerrainHorizons create_gpu_terrain_horizons(const MetalContext& metal, const ChunkManagerConfig& config,
+                                               const HorizonSettings& settings) {
+    GpuTerrainHorizons horizons;
+    horizons.bakePipeline = metal.bake_horizons_pipeline;
+    horizons.settings = settings;
+    horizons.terrain = config.terrain;
+    const uint32_t tiles = terrain_material_atlas_tiles(config.unloadRadius);
+    horizons.slots = TerrainMaterialSlots(tiles);
+    horizons.uniforms = terrain_horizon_uniforms(config.chunkSize, tiles, 0.0f, settings);
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor new];
+    desc.textureType = MTLTextureType2DArray;
+    desc.pixelFormat = MTLPixelFormatRGBA8Unorm;
+    desc.width = (NSUInteger)horizons.uniforms.atlasTexels;
+    desc.height = (NSUInteger)horizons.uniforms.atlasTexels;
+    desc.arrayLength = HORIZON_DIRECTIONS / 4;
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+    horizons.atlas = [metal.device newTextureWithDescriptor:desc];
+    horizons.atlas.label = @"Terrain horizon atlas";
+    return horizons;
+}
+
+size_t gpu_terrain_horizons_bytes(const GpuTerrainHorizons& horizons) {
+    return horizons.atlas.allocatedSize;
+}
+
+void gpu_terrain_horizons_encode(GpuTerrainHorizons& horizons, id<MTLCommandBuffer> cmd,
+                                 const ChunkManager& chunkManager, float cascadeEnd) {
+    horizons.uniforms = terrain_horizon_uniforms(horizons.uniforms.chunkSize, horizons.slots.tiles(), cascadeEnd,
+                                                 horizons.settings);
+    horizons.baked = 0;
+
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(horizons.terrain);
+    const float chunkSize = horizons.uniforms.chunkSize;
+    id<MTLComputeCommandEncoder> enc = nil;
+    for (const ResidentChunk& chunk : chunkManager.resident()) {
+        // The noise is all the kernel reads, so an edited chunk keeps its tile
+        if (!horizons.slots.claim(chunk.key, 0)) {
+            continue;
+        }
+        if (!enc) {
+            enc = [cmd computeCommandEncoder];
+            enc.label = @"Bake terrain horizons";
+            [enc setComputePipelineState:horizons.bakePipeline];
+            [enc setTexture:horizons.atlas atIndex:0];
+        }
+
+        const TerrainMaterialTile tile = terrain_material_tile(chunk.key, horizons.slots.tiles());
+        TerrainHorizonBakeParams params = {};
+        params.origin = { chunk.key.x * chunkSize, chunk.key.z * chunkSize };
+        params.tileOrigin = { tile.x * HORIZON_TILE_TEXELS, tile.z * HORIZON_TILE_TEXELS };
+        params.tileTexels = HORIZON_TILE_TEXELS;
+        params.texelSpacing = chunkSize / (float)(HORIZON_TILE_TEXELS - 1);
+        params.steps = horizons.settings.steps;
+        params.firstStep = horizons.settings.firstStep;
+        params.stepGrowth = horizons.settings.stepGrowth;
+        params.noiseOffset = mapping.offset;
+        params.noiseScale = mapping.scale;
+        params.heightScale = mapping.heightScale;
+        params.noise = mapping.noise;
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        [enc dispatchThreads:MTLSizeMake(HORIZON_TILE_TEXELS, HORIZON_TILE_TEXELS, 1)
+            threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+        ++horizons.baked;
+    }
+    [enc endEncoding];
+}
+
+void gpu_terrain_horizons_bind(const GpuTerrainHorizons& horizons, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:horizons.atlas atIndex:5];
+    [enc setFragmentBytes:&horizons.uniforms length:sizeof(horizons.uniforms) atIndex:TERRAIN_HORIZON_BUFFER_INDEX];
+}
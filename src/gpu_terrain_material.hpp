@@ -0,0 +1,62 @@
+/**
+ * @file gpu_terrain_material.hpp
+ * @brief Terrain albedo baked once per chunk into a material atlas, instead of blended per pixel.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "chunk_manager.hpp"
+#include "metal_context.hpp"
+#include "terrain_material.hpp"
+
+/**
+ * @struct GpuTerrainMaterials
+ * @brief The material atlas and the kernel that bakes chunks into it.
+ *
+ * Each frame gpu_terrain_materials_encode finds the resident chunks whose tile does not
+ * hold them yet, because they just arrived or an edit reached them, and dispatches
+ * bake_terrain_materials for each: it reads the heights from the chunk's vertex buffer and
+ * writes the grass, rock and snow blend the untextured shader computes into the chunk's
+ * tile (see terrain_material.hpp), or, for a chunk with biomes, the same bands in the
+ * colours of the biome profiles blended at each vertex (see biome.hpp). The
+ * ShaderVariant::bakedMaterials landscape pipelines then sample the tile once per pixel.
+ * Chunks that stay resident are never baked again.
+ */
+struct GpuTerrainMaterials {
+    id<MTLComputePipelineState> bakePipeline;   ///< bake_terrain_materials for the chunks' vertex format.
+    id<MTLTexture> atlas;                       ///< RGBA8 albedo, one tile of resolution x resolution texels per chunk.
+    id<MTLBuffer> uniforms;                     ///< TerrainMaterialUniforms, bound at TERRAIN_MATERIAL_BUFFER_INDEX.
+    TerrainMaterialSlots slots;                 ///< What each tile was baked for.
+    uint32_t baked = 0;                         ///< Chunks the last gpu_terrain_materials_encode baked.
+};
+
+/// @return True if the bake kernels compiled and the chunks keep vertex buffers, which the kernel reads.
+bool gpu_terrain_materials_supported(const MetalContext& metal, const ChunkManagerConfig& config);
+
+/**
+ * @brief Creates the atlas for the chunks a ChunkManager keeps resident.
+ * @param metal The Metal context; its bake pipelines must exist.
+ * @param config The chunk manager's configuration; sizes the atlas and picks the vertex format.
+ * @return The material state, with every tile unbaked.
+ */
+GpuTerrainMaterials create_gpu_terrain_materials(const MetalContext& metal, const ChunkManagerConfig& config);
+
+/// @return GPU bytes held by the atlas and its uniforms.
+size_t gpu_terrain_materials_bytes(const GpuTerrainMaterials& materials);
+
+/**
+ * @brief Bakes the resident chunks whose tile is missing or stale.
+ *
+ * Must be encoded before the render pass that samples the atlas, and after the command
+ * buffer waits for ChunkManager::edit_upload_value(), so edited heights are baked.
+ *
+ * @param materials The material state.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks.
+ */
+void gpu_terrain_materials_encode(GpuTerrainMaterials& materials, id<MTLCommandBuffer> cmd,
+                                  const ChunkManager& chunkManager);
+
+/// @brief Binds the atlas and its uniforms for the landscape fragments.
+void gpu_terrain_materials_bind(const GpuTerrainMaterials& materials, id<MTLRenderCommandEncoder> enc);
@@ -0,0 +1,89 @@
+#import "gpu_terrain_material.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Matches TerrainMaterialBakeParams in shaders.metal
+    struct TerrainMaterialBakeParams {
+        simd::uint2 tileOrigin;
+        uint32_t resolution;
+        float heightScale;
+        float heightOffset;
+        uint32_t biomeCells;
+    };
+}
+
+bool gpu_terrain_materials_supported(const MetalContext& metal, const ChunkManagerConfig& config) {
+    return !config.heightMaps && metal.bake_materials_pipeline && metal.bake_materials_packed_pipeline;
+}
+
+GpuTerrainMaterials create_gpu_terrain_materials(const MetalContext& metal, const ChunkManagerConfig& config) {
+    GpuTerrainMaterials materials;
+    materials.bakePipeline = config.vertexFormat == VertexFormat::Packed ? metal.bake_materials_packed_pipeline
+                                                                         : metal.bake_materials_pipeline;
+    const uint32_t tiles = terrain_material_atlas_tiles(config.unloadRadius);
+    materials.slots = TerrainMaterialSlots(tiles);
+
+    const TerrainMaterialUniforms uniforms = terrain_material_uniforms(config.chunkSize, config.resolution, tiles);
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                                                                                    width:(NSUInteger)uniforms.atlasTexels
+                                                                                   height:(NSUInteger)uniforms.atlasTexels
+                                                                                mipmapped:NO];
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+    materials.atlas = [metal.device newTextureWithDescriptor:desc];
+    materials.atlas.label = @"Terrain material atlas";
+
+    materials.uniforms = [metal.device newBufferWithBytes:&uniforms length:sizeof(uniforms)
+                                                  options:MTLResourceStorageModeShared];
+    materials.uniforms.label = @"Terrain material uniforms";
+    return materials;
+}
+
+size_t gpu_terrain_materials_bytes(const GpuTerrainMaterials& materials) {
+    return materials.atlas.allocatedSize + materials.uniforms.allocatedSize;
+}
+
+void gpu_terrain_materials_encode(GpuTerrainMaterials& materials, id<MTLCommandBuffer> cmd,
+                                  const ChunkManager& chunkManager) {
+    const uint32_t resolution = (uint32_t)chunkManager.config().resolution;
+    const bool packed = chunkManager.config().vertexFormat == VertexFormat::Packed;
+    materials.baked = 0;
+
+    id<MTLComputeCommandEncoder> enc = nil;
+    for (const ResidentChunk& chunk : chunkManager.resident()) {
+        if (!materials.slots.claim(chunk.key, chunk.editVersion)) {
+            continue;
+        }
+        if (!enc) {
+            enc = [cmd computeCommandEncoder];
+            enc.label = @"Bake terrain materials";
+            [enc setComputePipelineState:materials.bakePipeline];
+            [enc setTexture:materials.atlas atIndex:0];
+            [enc setBytes:biome_profiles() length:BIOME_COUNT * sizeof(BiomeProfile) atIndex:4];
+        }
+
+        // The model matrix only translates and scales, so world height is a multiply-add of the vertex's y
+        const TerrainMaterialTile tile = terrain_material_tile(chunk.key, materials.slots.tiles());
+        TerrainMaterialBakeParams params;
+        params.tileOrigin = { tile.x * resolution, tile.z * resolution };
+        params.resolution = resolution;
+        params.heightScale = chunk.modelMatrix.columns[1].y;
+        params.heightOffset = chunk.modelMatrix.columns[3].y;
+        params.biomeCells = chunk.biomes.cellsPerEdge;
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        // The kernel only reads the IDs with biomeCells set, but every buffer it declares is bound
+        const uint8_t noBiomes = 0;
+        [enc setBytes:chunk.biomes.empty() ? &noBiomes : chunk.biomes.ids.data()
+               length:std::max<size_t>(chunk.biomes.ids.size(), 1) atIndex:3];
+        [enc setBuffer:chunk.mesh.vertexBuffer offset:0 atIndex:packed ? 2 : 1];
+        [enc dispatchThreads:MTLSizeMake(resolution, resolution, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+        ++materials.baked;
+    }
+    [enc endEncoding];
+}
+
+void gpu_terrain_materials_bind(const GpuTerrainMaterials& materials, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:materials.atlas atIndex:3];
+    [enc setFragmentBuffer:materials.uniforms offset:0 atIndex:TERRAIN_MATERIAL_BUFFER_INDEX];
+}
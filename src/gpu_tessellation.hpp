@@ -0,0 +1,84 @@
+/**
+ * @file gpu_tessellation.hpp
+ * @brief Hardware-tessellated terrain chunks near the camera, displaced onto the terrain noise.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <vector>
+
+#include "camera.hpp"
+#include "chunk_manager.hpp"
+#include "frame_ring.hpp"
+#include "frustum.hpp"
+#include "metal_context.hpp"
+#include "terrain_tessellation.hpp"
+
+/**
+ * @struct GpuTessellation
+ * @brief This frame's tessellated chunks and the kernel that sizes their patches.
+ *
+ * Each frame gpu_tessellation_encode picks the chunks terrain_chunk_tessellated() accepts
+ * and dispatches terrain_tessellation_factors, which writes a factor per edge of every grid
+ * cell into the frame ring. The chunks are then drawn with one quad patch per cell;
+ * terrain_tessellated_vertex places every generated vertex on the same GPU noise the chunk
+ * generator uses, so the chunk's vertex buffer is not read. Other chunks are drawn as
+ * usual and must skip the ones in `tessellated`.
+ */
+struct GpuTessellation {
+    id<MTLComputePipelineState> factorsPipeline;    ///< terrain_tessellation_factors.
+    TerrainTessellationSettings settings;           ///< Target edge length and reach.
+    uint32_t maxChunks = 0;                         ///< Most chunks tessellated in one frame.
+    std::vector<uint8_t> tessellated;               ///< Per resident chunk: nonzero if drawn here this frame.
+    std::vector<uint32_t> chunks;                   ///< Resident indices of this frame's tessellated chunks.
+    std::vector<FrameAllocation> factors;           ///< Tessellation factors of each entry of chunks.
+};
+
+/// @return True if the device supports tessellation and the factor kernel compiled.
+bool gpu_tessellation_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the tessellation state.
+ * @param metal The Metal context; its factor pipeline must exist.
+ * @param maxChunks The most chunks tessellated in one frame; the nearest ones win.
+ * @param settings Target edge length and reach.
+ * @return The tessellation state.
+ */
+GpuTessellation create_gpu_tessellation(const MetalContext& metal, uint32_t maxChunks,
+                                        const TerrainTessellationSettings& settings = {});
+
+/// @return Frame ring bytes gpu_tessellation_encode needs per frame for maxChunks chunks of a resolution.
+size_t gpu_tessellation_frame_bytes(uint32_t maxChunks, int resolution);
+
+/**
+ * @brief Picks this frame's tessellated chunks and computes their tessellation factors.
+ *
+ * Must be encoded before the render pass that calls gpu_tessellation_draw, and after
+ * ChunkManager::update_lods.
+ *
+ * @param tessellation The tessellation state.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks and their LOD levels.
+ * @param uniformRing The frame ring that receives the factors.
+ * @param cam The camera of this frame.
+ * @param frustum The view frustum of cam; chunks outside it are left to the other paths to drop.
+ * @param projectionScale Viewport height / (2 * tan(fovy / 2)), in pixels.
+ */
+void gpu_tessellation_encode(GpuTessellation& tessellation, id<MTLCommandBuffer> cmd,
+                             const ChunkManager& chunkManager, FrameRing& uniformRing, const Camera& cam,
+                             const Frustum& frustum, float projectionScale);
+
+/**
+ * @brief Draws the chunks gpu_tessellation_encode picked.
+ * @param tessellation The tessellation state.
+ * @param enc The render encoder, with the scene's FrameUniforms bound, and the shadow map if the pipeline samples it.
+ * @param pipeline A ShaderProgram::LandscapeTessellated pipeline.
+ * @param depthState The depth state of the pass.
+ * @param chunkManager The chunk manager passed to gpu_tessellation_encode.
+ * @return The number of patches drawn.
+ */
+uint32_t gpu_tessellation_draw(const GpuTessellation& tessellation, id<MTLRenderCommandEncoder> enc,
+                               id<MTLRenderPipelineState> pipeline, id<MTLDepthStencilState> depthState,
+                               const ChunkManager& chunkManager);
@@ -0,0 +1,142 @@
+#import "gpu_tessellation.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Matches TerrainPatchParams in shaders.metal
+    struct TerrainPatchParams {
+        simd::float2 origin;
+        float step;
+        uint32_t cellsPerEdge;
+        simd::float3 camera;
+        float projectionScale;
+        float targetEdgePixels;
+        float maxFactor;
+        float noiseOffset;
+        float noiseScale;
+        float heightScale;
+        NoiseSettings noise;
+    };
+
+    TerrainPatchParams patch_params(const GpuTessellation& tessellation, const ChunkManagerConfig& config,
+                                    ChunkKey key) {
+        const TerrainNoiseMapping mapping = terrain_noise_mapping(config.terrain);
+        TerrainPatchParams params = {};
+        params.origin = { key.x * config.chunkSize, key.z * config.chunkSize };
+        params.step = config.chunkSize / (float)(config.resolution - 1);
+        params.cellsPerEdge = (uint32_t)config.resolution - 1;
+        params.targetEdgePixels = tessellation.settings.targetEdgePixels;
+        params.maxFactor = tessellation.settings.maxFactor;
+        params.noiseOffset = mapping.offset;
+        params.noiseScale = mapping.scale;
+        params.heightScale = mapping.heightScale;
+        params.noise = mapping.noise;
+        return params;
+    }
+
+    size_t factor_bytes(int resolution) {
+        return (size_t)(resolution - 1) * (resolution - 1) * sizeof(MTLQuadTessellationFactorsHalf);
+    }
+}
+
+bool gpu_tessellation_supported(const MetalContext& metal) {
+    // Tessellation factors written by compute need an Apple3 or Mac2 GPU
+    return metal.tessellation_factors_pipeline != nil &&
+           ([metal.device supportsFamily:MTLGPUFamilyApple3] || [metal.device supportsFamily:MTLGPUFamilyMac2]);
+}
+
+GpuTessellation create_gpu_tessellation(const MetalContext& metal, uint32_t maxChunks,
+                                        const TerrainTessellationSettings& settings) {
+    GpuTessellation tessellation;
+    tessellation.factorsPipeline = metal.tessellation_factors_pipeline;
+    tessellation.settings = settings;
+    tessellation.maxChunks = maxChunks;
+    return tessellation;
+}
+
+size_t gpu_tessellation_frame_bytes(uint32_t maxChunks, int resolution) {
+    const size_t factors = (factor_bytes(resolution) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    return maxChunks * factors;
+}
+
+void gpu_tessellation_encode(GpuTessellation& tessellation, id<MTLCommandBuffer> cmd,
+                             const ChunkManager& chunkManager, FrameRing& uniformRing, const Camera& cam,
+                             const Frustum& frustum, float projectionScale) {
+    const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+    tessellation.tessellated.assign(chunks.size(), 0);
+    tessellation.chunks.clear();
+    tessellation.factors.clear();
+
+    for (uint32_t i = 0; i < chunks.size(); ++i) {
+        const ResidentChunk& chunk = chunks[i];
+        // Volumetric chunks draw their own mesh; the patches would only know the height field
+        if (!chunk.volume.vertexBuffer &&
+            terrain_chunk_tessellated(chunk.bounds, chunk.lodLevel, chunk.stitchMask, cam.position,
+                                      tessellation.settings) &&
+            frustum_intersects(frustum, chunk.bounds)) {
+            tessellation.chunks.push_back(i);
+        }
+    }
+    // Over the limit, the chunks nearest the camera keep the detail
+    auto distance = [&](uint32_t i) {
+        const BoundingBox& bounds = chunks[i].bounds;
+        return simd::length(simd::clamp(cam.position, bounds.min, bounds.max) - cam.position);
+    };
+    if (tessellation.chunks.size() > tessellation.maxChunks) {
+        std::sort(tessellation.chunks.begin(), tessellation.chunks.end(),
+                  [&](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+        tessellation.chunks.resize(tessellation.maxChunks);
+    }
+    if (tessellation.chunks.empty()) {
+        return;
+    }
+
+    const ChunkManagerConfig& config = chunkManager.config();
+    const uint32_t cells = (uint32_t)config.resolution - 1;
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Terrain tessellation factors";
+    [enc setComputePipelineState:tessellation.factorsPipeline];
+    for (uint32_t i : tessellation.chunks) {
+        tessellation.tessellated[i] = 1;
+
+        FrameAllocation factors = frame_ring_allocate(uniformRing, factor_bytes(config.resolution));
+        tessellation.factors.push_back(factors);
+
+        TerrainPatchParams params = patch_params(tessellation, config, chunks[i].key);
+        params.camera = cam.position;
+        params.projectionScale = projectionScale;
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        [enc setBuffer:factors.buffer offset:factors.offset atIndex:1];
+        [enc dispatchThreads:MTLSizeMake(cells, cells, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    }
+    [enc endEncoding];
+}
+
+uint32_t gpu_tessellation_draw(const GpuTessellation& tessellation, id<MTLRenderCommandEncoder> enc,
+                               id<MTLRenderPipelineState> pipeline, id<MTLDepthStencilState> depthState,
+                               const ChunkManager& chunkManager) {
+    if (tessellation.chunks.empty()) {
+        return 0;
+    }
+
+    const ChunkManagerConfig& config = chunkManager.config();
+    const uint32_t patchCount = (uint32_t)((config.resolution - 1) * (config.resolution - 1));
+    [enc setRenderPipelineState:pipeline];
+    [enc setDepthStencilState:depthState];
+    for (size_t i = 0; i < tessellation.chunks.size(); ++i) {
+        const ResidentChunk& chunk = chunkManager.resident()[tessellation.chunks[i]];
+        const TerrainPatchParams params = patch_params(tessellation, config, chunk.key);
+        const FrameAllocation& factors = tessellation.factors[i];
+        [enc setVertexBytes:&params length:sizeof(params) atIndex:0];
+        [enc setTessellationFactorBuffer:factors.buffer offset:factors.offset instanceStride:0];
+        // No control points are read: every vertex is placed from its patch ID and the noise
+        [enc drawPatches:4
+                   patchStart:0
+                   patchCount:patchCount
+             patchIndexBuffer:nil
+       patchIndexBufferOffset:0
+                instanceCount:1
+                 baseInstance:0];
+    }
+    return patchCount * (uint32_t)tessellation.chunks.size();
+}
@@ -0,0 +1,29 @@
+/**
+ * @file gpu_texture_compression.hpp
+ * @brief The Metal pixel formats of the block formats of texture_compression.hpp, and which a device samples.
+ *
+ * Apple GPUs sample ASTC; Macs sample BC, and Apple silicon Macs sample both. The streamed
+ * textures ask for a format and fall back to the other family, then to uncompressed texels.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include "texture_compression.hpp"
+
+/// @return The pixel format of a block format; BGRA8Unorm for None.
+MTLPixelFormat texture_compression_pixel_format(TextureCompression compression);
+
+/// @return The block format a pixel format holds; None for any uncompressed or other format.
+TextureCompression texture_compression_of(MTLPixelFormat format);
+
+/// @return True if the device can sample textures in the block format.
+bool texture_compression_supported(id<MTLDevice> device, TextureCompression compression);
+
+/**
+ * @brief Picks the block format to store a texture in on a device.
+ * @param device The Metal device.
+ * @param requested The preferred format.
+ * @return requested if the device samples it, else ASTC 4x4 or BC1, whichever it samples, else None.
+ */
+TextureCompression pick_texture_compression(id<MTLDevice> device, TextureCompression requested);
@@ -0,0 +1,58 @@
+#import "gpu_texture_compression.hpp"
+
+MTLPixelFormat texture_compression_pixel_format(TextureCompression compression) {
+    switch (compression) {
+    case TextureCompression::Astc4x4:
+        return MTLPixelFormatASTC_4x4_LDR;
+    case TextureCompression::Astc6x6:
+        return MTLPixelFormatASTC_6x6_LDR;
+    case TextureCompression::Astc8x8:
+        return MTLPixelFormatASTC_8x8_LDR;
+    case TextureCompression::Bc1:
+        return MTLPixelFormatBC1_RGBA;
+    case TextureCompression::None:
+        break;
+    }
+    return MTLPixelFormatBGRA8Unorm;
+}
+
+TextureCompression texture_compression_of(MTLPixelFormat format) {
+    switch (format) {
+    case MTLPixelFormatASTC_4x4_LDR:
+        return TextureCompression::Astc4x4;
+    case MTLPixelFormatASTC_6x6_LDR:
+        return TextureCompression::Astc6x6;
+    case MTLPixelFormatASTC_8x8_LDR:
+        return TextureCompression::Astc8x8;
+    case MTLPixelFormatBC1_RGBA:
+        return TextureCompression::Bc1;
+    default:
+        return TextureCompression::None;
+    }
+}
+
+bool texture_compression_supported(id<MTLDevice> device, TextureCompression compression) {
+    switch (compression) {
+    case TextureCompression::Astc4x4:
+    case TextureCompression::Astc6x6:
+    case TextureCompression::Astc8x8:
+        return [device supportsFamily:MTLGPUFamilyApple2];
+    case TextureCompression::Bc1:
+        return device.supportsBCTextureCompression;
+    case TextureCompression::None:
+        break;
+    }
+    return true;
+}
+
+TextureCompression pick_texture_compression(id<MTLDevice> device, TextureCompression requested) {
+    if (texture_compression_supported(device, requested)) {
+        return requested;
+    }
+    for (TextureCompression fallback : { TextureCompression::Astc4x4, TextureCompression::Bc1 }) {
+        if (texture_compression_supported(device, fallback)) {
+            return fallback;
+        }
+    }
+    return TextureCompression::None;
+}
@@ -0,0 +1,436 @@
+#include "height_field.hpp"
+#include "landscape.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    /// The four samples around a query point and its position inside their cell.
+    struct Cell {
+        float h00, h10, h01, h11;
+        float fx, fz;
+    };
+
+    Cell find_cell(const HeightField& field, float x, float z) {
+        float gx = std::clamp((x - field.originX) / field.spacing, 0.0f, (float)(field.width - 1));
+        float gz = std::clamp((z - field.originZ) / field.spacing, 0.0f, (float)(field.depth - 1));
+
+        // The last row and column use the cell before them, with a fraction of one
+        int cx = std::min((int)gx, field.width - 2);
+        int cz = std::min((int)gz, field.depth - 2);
+
+        const float* row0 = field.heights.data() + cz * field.width + cx;
+        const float* row1 = row0 + field.width;
+        return { row0[0], row0[1], row1[0], row1[1], gx - cx, gz - cz };
+    }
+
+    float cell_height(const Cell& c) {
+        float h0 = c.h00 + (c.h10 - c.h00) * c.fx;
+        float h1 = c.h01 + (c.h11 - c.h01) * c.fx;
+        return h0 + (h1 - h0) * c.fz;
+    }
+
+    simd::float2 cell_gradient(const Cell& c, float spacing) {
+        float dhdx = ((c.h10 - c.h00) * (1.0f - c.fz) + (c.h11 - c.h01) * c.fz) / spacing;
+        float dhdz = ((c.h01 - c.h00) * (1.0f - c.fx) + (c.h11 - c.h10) * c.fx) / spacing;
+        return { dhdx, dhdz };
+    }
+
+    simd::float3 cell_normal(const Cell& c, float spacing) {
+        const simd::float2 gradient = cell_gradient(c, spacing);
+        return simd::normalize(simd::float3{ -gradient.x, 1.0f, -gradient.y });
+    }
+}
+
+HeightField create_height_field(float originX, float originZ, int width, int depth, float spacing,
+                                const TerrainParams& terrain) {
+    HeightField field;
+    field.originX = originX;
+    field.originZ = originZ;
+    field.spacing = spacing;
+    field.width = width;
+    field.depth = depth;
+
+    std::vector<float> xs(width * depth), zs(width * depth);
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < width; ++x) {
+            xs[z * width + x] = originX + x * spacing;
+            zs[z * width + x] = originZ + z * spacing;
+        }
+    }
+    field.heights.resize(width * depth);
+    get_terrain_heights(xs.data(), zs.data(), field.heights.data(), field.heights.size(), terrain);
+
+    return field;
+}
+
+HeightField create_height_field(const MeshData& landscape, int width, int depth) {
+    HeightField field;
+    field.originX = landscape.vertices[0].position.x;
+    field.originZ = landscape.vertices[0].position.z;
+    field.spacing = landscape.vertices[1].position.x - landscape.vertices[0].position.x;
+    field.width = width;
+    field.depth = depth;
+
+    field.heights.reserve(width * depth);
+    for (const auto& v : landscape.vertices) {
+        field.heights.push_back(v.position.y);
+    }
+
+    return field;
+}
+
+bool height_field_contains(const HeightField& field, float x, float z) {
+    float gx = (x - field.originX) / field.spacing;
+    float gz = (z - field.originZ) / field.spacing;
+    return gx >= 0.0f && gz >= 0.0f && gx <= field.width - 1 && gz <= field.depth - 1;
+}
+
+float height_field_height(const HeightField& field, float x, float z) {
+    return cell_height(find_cell(field, x, z));
+}
+
+simd::float3 height_field_normal(const HeightField& field, float x, float z) {
+    return cell_normal(find_cell(field, x, z), field.spacing);
+}
+
+TerrainSample height_field_sample(const HeightField& field, float x, float z) {
+    const Cell cell = find_cell(field, x, z);
+    return { cell_height(cell), cell_gradient(cell, field.spacing) };
+}
+
+void height_field_heights(const HeightField& field, const float* xs, const float* zs, float* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = cell_height(find_cell(field, xs[i], zs[i]));
+    }
+}
+
+void height_field_normals(const HeightField& field, const float* xs, const float* zs, simd::float3* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = cell_normal(find_cell(field, xs[i], zs[i]), field.spacing);
+    }
+}
+
+void height_field_samples(const HeightField& field, const float* xs, const float* zs, TerrainSample* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const Cell cell = find_cell(field, xs[i], zs[i]);
+        out[i] = { cell_height(cell), cell_gradient(cell, field.spacing) };
+    }
+}
+
+namespace {
+    /// Progress of a ray through the grid cells, in grid units: the ray's xz is g0 + b * t.
+    struct RayWalk {
+        float gx0, gz0, bx, bz;
+        float t, tExit;             ///< Start of the current segment, and where the ray leaves the grid.
+        float tMaxX, tMaxZ;         ///< Where the ray crosses the next cell boundary along each axis.
+        float tDeltaX, tDeltaZ;     ///< Ray parameter per cell along each axis.
+        int cx, cz, stepX, stepZ;
+    };
+
+    // Clips one axis of the ray to [0, last]; false if the ray runs parallel to the axis outside it
+    bool clip_axis(float g0, float b, float last, float& tEnter, float& tExit) {
+        if (b == 0.0f) {
+            return g0 >= 0.0f && g0 <= last;
+        }
+        float ta = -g0 / b;
+        float tb = (last - g0) / b;
+        tEnter = std::max(tEnter, std::min(ta, tb));
+        tExit = std::min(tExit, std::max(ta, tb));
+        return true;
+    }
+
+    void start_axis(float g0, float b, float t, int cells, int& cell, int& step, float& tMax, float& tDelta) {
+        cell = std::clamp((int)std::floor(g0 + b * t), 0, cells - 1);
+        step = b > 0.0f ? 1 : -1;
+        if (b == 0.0f) {
+            tMax = tDelta = INFINITY;
+            return;
+        }
+        tMax = ((float)(b > 0.0f ? cell + 1 : cell) - g0) / b;
+        tDelta = 1.0f / std::fabs(b);
+    }
+
+    bool start_walk(const HeightField& field, simd::float3 origin, simd::float3 direction, float maxDistance,
+                    RayWalk& walk) {
+        walk.gx0 = (origin.x - field.originX) / field.spacing;
+        walk.gz0 = (origin.z - field.originZ) / field.spacing;
+        walk.bx = direction.x / field.spacing;
+        walk.bz = direction.z / field.spacing;
+
+        walk.t = 0.0f;
+        walk.tExit = maxDistance;
+        if (!clip_axis(walk.gx0, walk.bx, (float)(field.width - 1), walk.t, walk.tExit) ||
+            !clip_axis(walk.gz0, walk.bz, (float)(field.depth - 1), walk.t, walk.tExit) || walk.t > walk.tExit) {
+            return false;
+        }
+        start_axis(walk.gx0, walk.bx, walk.t, field.width - 1, walk.cx, walk.stepX, walk.tMaxX, walk.tDeltaX);
+        start_axis(walk.gz0, walk.bz, walk.t, field.depth - 1, walk.cz, walk.stepZ, walk.tMaxZ, walk.tDeltaZ);
+        return true;
+    }
+
+    float segment_end(const RayWalk& walk) {
+        return std::min(std::min(walk.tMaxX, walk.tMaxZ), walk.tExit);
+    }
+
+    // Steps into the next cell; false once the ray has left the grid or ended
+    bool advance_walk(const HeightField& field, RayWalk& walk) {
+        if (segment_end(walk) >= walk.tExit) {
+            return false;
+        }
+        if (walk.tMaxX < walk.tMaxZ) {
+            walk.cx += walk.stepX;
+            walk.t = walk.tMaxX;
+            walk.tMaxX += walk.tDeltaX;
+        } else {
+            walk.cz += walk.stepZ;
+            walk.t = walk.tMaxZ;
+            walk.tMaxZ += walk.tDeltaZ;
+        }
+        return walk.cx >= 0 && walk.cx < field.width - 1 && walk.cz >= 0 && walk.cz < field.depth - 1;
+    }
+
+    // Skips the cells the ray passes entirely above; false if it ends first
+    bool find_candidate(const HeightField& field, float originY, float directionY, RayWalk& walk) {
+        for (;;) {
+            const float* row0 = field.heights.data() + walk.cz * field.width + walk.cx;
+            const float* row1 = row0 + field.width;
+            const float highest = std::max(std::max(row0[0], row0[1]), std::max(row1[0], row1[1]));
+            const float lowest = originY + directionY * (directionY < 0.0f ? segment_end(walk) : walk.t);
+            if (lowest <= highest) {
+                return true;
+            }
+            if (!advance_walk(field, walk)) {
+                return false;
+            }
+        }
+    }
+
+    // The smaller of two roots inside (t0, t1], or -1
+    float pick_root(float r1, float r2, float t0, float t1) {
+        float best = -1.0f;
+        for (float r : { r1, r2 }) {
+            if (r > t0 && r <= t1 && (best < 0.0f || r < best)) {
+                best = r;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Along the ray, height above the bilinear surface of a cell is a quadratic a t^2 + b t + c:
+     * the cell fractions are linear in t, and the surface is bilinear in them. This is the
+     * first t in [t0, t1] where it reaches zero, or -1.
+     */
+    float first_contact(float a, float b, float c, float t0, float t1) {
+        if ((a * t0 + b) * t0 + c <= 0.0f) {
+            return t0;
+        }
+        float disc = b * b - 4.0f * a * c;
+        if (disc < 0.0f) {
+            return -1.0f;
+        }
+        // The stable form of the two roots; a == 0 leaves the linear root in c / q
+        float q = -0.5f * (b + std::copysign(std::sqrt(disc), b));
+        return pick_root(q / a, c / q, t0, t1);
+    }
+
+    void finish_hit(const HeightField& field, simd::float3 origin, simd::float3 direction, float t, TerrainHit& hit) {
+        hit.distance = t;
+        hit.position = origin + direction * t;
+        hit.normal = height_field_normal(field, hit.position.x, hit.position.z);
+    }
+}
+
+bool height_field_raycast(const HeightField& field, simd::float3 origin, simd::float3 direction, float maxDistance,
+                          TerrainHit& hit) {
+    hit = TerrainHit{};
+    RayWalk walk;
+    if (!start_walk(field, origin, direction, maxDistance, walk)) {
+        return false;
+    }
+
+    while (find_candidate(field, origin.y, direction.y, walk)) {
+        const float* row0 = field.heights.data() + walk.cz * field.width + walk.cx;
+        const float* row1 = row0 + field.width;
+        const float h00 = row0[0], h10 = row0[1], h01 = row1[0], h11 = row1[1];
+
+        const float ax = walk.gx0 - walk.cx, az = walk.gz0 - walk.cz;
+        const float e = h10 - h00, g = h01 - h00, k = h00 - h10 - h01 + h11;
+        const float c = origin.y - h00 - e * ax - g * az - k * ax * az;
+        const float b = direction.y - e * walk.bx - g * walk.bz - k * (ax * walk.bz + az * walk.bx);
+        const float a = -k * walk.bx * walk.bz;
+        const float t = first_contact(a, b, c, walk.t, segment_end(walk));
+        if (t >= 0.0f) {
+            finish_hit(field, origin, direction, t, hit);
+            return true;
+        }
+        if (!advance_walk(field, walk)) {
+            break;
+        }
+    }
+    return false;
+}
+
+simd::float3 height_field_move(const HeightField& field, simd::float3 position, simd::float3 motion, float clearance) {
+    // Sweeping the point below the body against the surface equals sweeping the body against the raised surface
+    const simd::float3 lift = { 0.0f, clearance, 0.0f };
+    const float skin = 1e-3f; // Keeps the body off the surface so the next sweep does not start in contact
+
+    simd::float3 remaining = motion;
+    for (int i = 0; i < 4 && simd::length_squared(remaining) > 0.0f; ++i) {
+        TerrainHit hit;
+        if (!height_field_raycast(field, position - lift, remaining, 1.0f, hit)) {
+            position += remaining;
+            break;
+        }
+        position = hit.position + lift + hit.normal * skin;
+        remaining *= 1.0f - hit.distance;
+        remaining -= hit.normal * simd::dot(remaining, hit.normal);
+    }
+
+    if (height_field_contains(field, position.x, position.z)) {
+        position.y = std::max(position.y, height_field_height(field, position.x, position.z) + clearance);
+    }
+    return position;
+}
+
+size_t height_field_raycasts(const HeightField& field, const simd::float3* origins, const simd::float3* directions,
+                             const float* maxDistances, TerrainHit* hits, size_t n) {
+    size_t hitCount = 0;
+    for (size_t i = 0; i < n; i += 4) {
+        // Each lane walks its own ray to the next cell it may hit; those four cells are solved together
+        const size_t lanes = std::min<size_t>(4, n - i);
+        RayWalk walks[4];
+        bool active[4] = { false, false, false, false };
+        simd::float4 oy = 0.0f, dy = 0.0f, bx = 0.0f, bz = 0.0f;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            hits[i + lane] = TerrainHit{};
+            active[lane] = start_walk(field, origins[i + lane], directions[i + lane], maxDistances[i + lane], walks[lane]) &&
+                           find_candidate(field, origins[i + lane].y, directions[i + lane].y, walks[lane]);
+            oy[lane] = origins[i + lane].y;
+            dy[lane] = directions[i + lane].y;
+            bx[lane] = walks[lane].bx;
+            bz[lane] = walks[lane].bz;
+        }
+
+        while (active[0] || active[1] || active[2] || active[3]) {
+            simd::float4 h00 = 0.0f, h10 = 0.0f, h01 = 0.0f, h11 = 0.0f, ax = 0.0f, az = 0.0f, t0 = 0.0f, t1 = 0.0f;
+            for (int lane = 0; lane < 4; ++lane) {
+                if (!active[lane]) {
+                    continue;
+                }
+                const RayWalk& walk = walks[lane];
+                const float* row0 = field.heights.data() + walk.cz * field.width + walk.cx;
+                h00[lane] = row0[0];
+                h10[lane] = row0[1];
+                h01[lane] = row0[field.width];
+                h11[lane] = row0[field.width + 1];
+                ax[lane] = walk.gx0 - walk.cx;
+                az[lane] = walk.gz0 - walk.cz;
+                t0[lane] = walk.t;
+                t1[lane] = segment_end(walk);
+            }
+
+            const simd::float4 e = h10 - h00, g = h01 - h00, k = h00 - h10 - h01 + h11;
+            const simd::float4 c = oy - h00 - e * ax - g * az - k * ax * az;
+            const simd::float4 b = dy - e * bx - g * bz - k * (ax * bz + az * bx);
+            const simd::float4 a = -k * bx * bz;
+            const simd::float4 f0 = (a * t0 + b) * t0 + c;
+            const simd::float4 disc = b * b - 4.0f * a * c;
+            const simd::float4 zero = 0.0f;
+            simd::float4 root = simd::sqrt(simd::max(disc, zero));
+            for (int lane = 0; lane < 4; ++lane) {
+                root[lane] = std::copysign(root[lane], b[lane]);
+            }
+            const simd::float4 q = -0.5f * (b + root);
+            const simd::float4 r1 = q / a, r2 = c / q;
+
+            for (int lane = 0; lane < 4; ++lane) {
+                if (!active[lane]) {
+                    continue;
+                }
+                float t = f0[lane] <= 0.0f ? t0[lane]
+                        : disc[lane] >= 0.0f ? pick_root(r1[lane], r2[lane], t0[lane], t1[lane]) : -1.0f;
+                if (t >= 0.0f) {
+                    finish_hit(field, origins[i + lane], directions[i + lane], t, hits[i + lane]);
+                    active[lane] = false;
+                    ++hitCount;
+                } else {
+                    active[lane] = advance_walk(field, walks[lane]) &&
+                                   find_candidate(field, origins[i + lane].y, directions[i + lane].y, walks[lane]);
+                }
+            }
+        }
+    }
+    return hitCount;
+}
+
+void height_field_segment_depths(const HeightField& field, const simd::float3* starts, const simd::float3* ends,
+                                 float maxDepth, float* depths, size_t n) {
+    for (size_t i = 0; i < n; i += 4) {
+        // As height_field_raycasts: each lane walks its own segment, and the four cells are solved together
+        const size_t lanes = std::min<size_t>(4, n - i);
+        RayWalk walks[4];
+        bool active[4] = { false, false, false, false };
+        simd::float4 oy = 0.0f, dy = 0.0f, bx = 0.0f, bz = 0.0f, depth = 0.0f;
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const simd::float3 direction = ends[i + lane] - starts[i + lane];
+            active[lane] = start_walk(field, starts[i + lane], direction, 1.0f, walks[lane]) &&
+                           find_candidate(field, starts[i + lane].y, direction.y, walks[lane]);
+            oy[lane] = starts[i + lane].y;
+            dy[lane] = direction.y;
+            bx[lane] = walks[lane].bx;
+            bz[lane] = walks[lane].bz;
+        }
+
+        while (active[0] || active[1] || active[2] || active[3]) {
+            simd::float4 h00 = 0.0f, h10 = 0.0f, h01 = 0.0f, h11 = 0.0f, ax = 0.0f, az = 0.0f, t0 = 0.0f, t1 = 0.0f;
+            for (int lane = 0; lane < 4; ++lane) {
+                if (!active[lane]) {
+                    continue;
+                }
+                const RayWalk& walk = walks[lane];
+                const float* row0 = field.heights.data() + walk.cz * field.width + walk.cx;
+                h00[lane] = row0[0];
+                h10[lane] = row0[1];
+                h01[lane] = row0[field.width];
+                h11[lane] = row0[field.width + 1];
+                ax[lane] = walk.gx0 - walk.cx;
+                az[lane] = walk.gz0 - walk.cz;
+                t0[lane] = walk.t;
+                t1[lane] = segment_end(walk);
+            }
+
+            // Height above the surface along the segment, a t^2 + b t + c, as in height_field_raycast
+            const simd::float4 e = h10 - h00, g = h01 - h00, k = h00 - h10 - h01 + h11;
+            const simd::float4 c = oy - h00 - e * ax - g * az - k * ax * az;
+            const simd::float4 b = dy - e * bx - g * bz - k * (ax * bz + az * bx);
+            const simd::float4 a = -k * bx * bz;
+            // Only an upward-opening quadratic dips between the crossings; the others use t0 again
+            simd::float4 tv = t0;
+            for (int lane = 0; lane < 4; ++lane) {
+                if (a[lane] > 0.0f) {
+                    tv[lane] = std::clamp(-b[lane] / (2.0f * a[lane]), t0[lane], t1[lane]);
+                }
+            }
+            const simd::float4 f0 = (a * t0 + b) * t0 + c;
+            const simd::float4 f1 = (a * t1 + b) * t1 + c;
+            const simd::float4 fv = (a * tv + b) * tv + c;
+            const simd::float4 lowest = simd::min(simd::min(f0, f1), fv);
+
+            for (int lane = 0; lane < 4; ++lane) {
+                if (active[lane]) {
+                    depth[lane] = std::max(depth[lane], -lowest[lane]);
+                    const simd::float3 direction = ends[i + lane] - starts[i + lane];
+                    active[lane] = depth[lane] < maxDepth && advance_walk(field, walks[lane]) &&
+                                   find_candidate(field, starts[i + lane].y, direction.y, walks[lane]);
+                }
+            }
+        }
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            depths[i + lane] = std::min(depth[lane], maxDepth);
+        }
+    }
+}
+
@@ -0,0 +1,194 @@
+/**
+ * @file height_field.hpp
+ * @brief Cached terrain heights with constant-time bilinear height and normal queries, and swept ray queries.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "landscape.hpp"
+#include "objects.hpp"
+
+/**
+ * @struct HeightField
+ * @brief A regular grid of terrain heights in world space.
+ *
+ * Sample (x, z) lies at (originX + x * spacing, originZ + z * spacing). Queries outside
+ * the grid are clamped to its border.
+ */
+struct HeightField {
+    float originX = 0.0f;          ///< World x of the first sample.
+    float originZ = 0.0f;          ///< World z of the first sample.
+    float spacing = 1.0f;          ///< World distance between neighbouring samples.
+    int width = 0;                 ///< Samples along X.
+    int depth = 0;                 ///< Samples along Z.
+    std::vector<float> heights;    ///< width * depth heights, row-major by z.
+};
+
+/**
+ * @brief Samples get_terrain_height on a regular grid.
+ * @param originX The world x of the first sample.
+ * @param originZ The world z of the first sample.
+ * @param width The number of samples along X (at least 2).
+ * @param depth The number of samples along Z (at least 2).
+ * @param spacing The world distance between samples.
+ * @param terrain The terrain generator's tunables.
+ * @return The new HeightField.
+ */
+HeightField create_height_field(float originX, float originZ, int width, int depth, float spacing,
+                                const TerrainParams& terrain = {});
+
+/**
+ * @brief Wraps the vertex grid produced by create_landscape.
+ * @param landscape A mesh returned by create_landscape(width, depth).
+ * @param width The width passed to create_landscape.
+ * @param depth The depth passed to create_landscape.
+ * @return A HeightField over the same grid.
+ */
+HeightField create_height_field(const MeshData& landscape, int width, int depth);
+
+/**
+ * @brief Checks whether a world position lies inside the grid.
+ * @param field The height field.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @return True if (x, z) is covered without clamping.
+ */
+bool height_field_contains(const HeightField& field, float x, float z);
+
+/**
+ * @brief Bilinearly interpolates the height at a world position.
+ * @param field The height field.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @return The interpolated height.
+ */
+float height_field_height(const HeightField& field, float x, float z);
+
+/**
+ * @brief Returns the normal of the bilinear surface at a world position.
+ * @param field The height field.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @return The unit surface normal.
+ */
+simd::float3 height_field_normal(const HeightField& field, float x, float z);
+
+/**
+ * @brief Returns the height and gradient of the bilinear surface at a world position.
+ *
+ * Both come from one cell lookup, in the form get_terrain_sample() returns for the exact
+ * terrain, so slope consumers can take either the cached or the analytic surface.
+ *
+ * @param field The height field.
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @return The interpolated height and its slope along x and z.
+ */
+TerrainSample height_field_sample(const HeightField& field, float x, float z);
+
+/**
+ * @brief Interpolates heights at many world positions at once.
+ * @param field The height field.
+ * @param xs The x-coordinates in world space.
+ * @param zs The z-coordinates in world space.
+ * @param out Receives n heights.
+ * @param n The number of points.
+ */
+void height_field_heights(const HeightField& field, const float* xs, const float* zs, float* out, size_t n);
+
+/**
+ * @brief Computes normals at many world positions at once.
+ * @param field The height field.
+ * @param xs The x-coordinates in world space.
+ * @param zs The z-coordinates in world space.
+ * @param out Receives n unit normals.
+ * @param n The number of points.
+ */
+void height_field_normals(const HeightField& field, const float* xs, const float* zs, simd::float3* out, size_t n);
+
+/**
+ * @brief Samples heights and gradients at many world positions at once.
+ * @param field The height field.
+ * @param xs The x-coordinates in world space.
+ * @param zs The z-coordinates in world space.
+ * @param out Receives n samples.
+ * @param n The number of points.
+ */
+void height_field_samples(const HeightField& field, const float* xs, const float* zs, TerrainSample* out, size_t n);
+
+/**
+ * @struct TerrainHit
+ * @brief Where a ray first meets the height field surface.
+ */
+struct TerrainHit {
+    float distance = -1.0f;                 ///< Ray parameter of the hit, in units of the direction; negative for a miss.
+    simd::float3 position = { 0, 0, 0 };    ///< World position of the hit.
+    simd::float3 normal = { 0, 1, 0 };      ///< Surface normal at the hit.
+};
+
+/**
+ * @brief Finds the first point where a ray meets the bilinear surface.
+ *
+ * Walks the grid cells the ray crosses in order (a 2D DDA), so nothing between the
+ * endpoints is skipped however long the ray is, and solves the ray against each cell's
+ * surface exactly. The part of the ray outside the grid never hits.
+ *
+ * @param field The height field.
+ * @param origin The ray origin; an origin below the surface hits at distance 0.
+ * @param direction The ray direction; need not be normalized, distances are in its units.
+ * @param maxDistance The end of the ray.
+ * @param hit Receives the hit.
+ * @return True if the ray hits the surface within maxDistance.
+ */
+bool height_field_raycast(const HeightField& field, simd::float3 origin, simd::float3 direction, float maxDistance,
+                          TerrainHit& hit);
+
+/**
+ * @brief Moves a body kept a clearance above the surface, sliding along slopes it runs into.
+ *
+ * The motion is swept against the surface raised by the clearance, so fast bodies cannot
+ * pass through ridges between the start and end. On contact the rest of the motion is
+ * projected onto the slope and swept again.
+ *
+ * @param field The height field.
+ * @param position The body's position before the move.
+ * @param motion The full displacement of the move.
+ * @param clearance The height of the body's reference point above its contact with the ground.
+ * @return The position after the move; at least the clearance above the surface inside the grid.
+ */
+simd::float3 height_field_move(const HeightField& field, simd::float3 position, simd::float3 motion, float clearance);
+
+/**
+ * @brief Casts many rays at once, four at a time.
+ * @param field The height field.
+ * @param origins The ray origins.
+ * @param directions The ray directions.
+ * @param maxDistances The end of each ray.
+ * @param hits Receives n hits; misses have a negative distance.
+ * @param n The number of rays.
+ * @return The number of rays that hit.
+ */
+size_t height_field_raycasts(const HeightField& field, const simd::float3* origins, const simd::float3* directions,
+                             const float* maxDistances, TerrainHit* hits, size_t n);
+
+/**
+ * @brief Measures how deep many segments run under the surface, four at a time.
+ *
+ * Each segment walks the grid cells it crosses like height_field_raycast(), skipping the cells
+ * it passes entirely above. In the others its height above the bilinear surface is a quadratic
+ * along it, so the deepest point is exact: one of the cell's two crossings or the quadratic's
+ * vertex. The part of a segment outside the grid is clear.
+ *
+ * @param field The height field.
+ * @param starts The first end of each segment.
+ * @param ends The other end of each segment.
+ * @param maxDepth Depth at which a segment stops walking; deeper segments report it.
+ * @param depths Receives n vertical depths below the surface, 0 for segments that stay above it.
+ * @param n The number of segments.
+ */
+void height_field_segment_depths(const HeightField& field, const simd::float3* starts, const simd::float3* ends,
+                                 float maxDepth, float* depths, size_t n);
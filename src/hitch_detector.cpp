@@ -0,0 +1,35 @@
+#include "hitch_detector.hpp"
+
+#include <algorithm>
+
+bool hitch_detector_update(HitchDetector& detector, uint64_t frame, float cpuMs, uint64_t gpuFrame, float gpuMs,
+                           double now, HitchReport& report) {
+    const HitchSettings& settings = detector.settings;
+    // Each GPU time is looked at once, whether or not it could be reported
+    const bool gpuOver = gpuFrame > detector.lastGpuFrame && gpuMs > settings.budgetMs;
+    detector.lastGpuFrame = std::max(detector.lastGpuFrame, gpuFrame);
+    if (settings.budgetMs <= 0.0f || detector.reports >= settings.maxReports ||
+        now - detector.lastReport < settings.cooldownSeconds) {
+        return false;
+    }
+    const bool cpuOver = cpuMs > settings.budgetMs;
+    if (!cpuOver && !gpuOver) {
+        return false;
+    }
+
+    // The CPU time is of this frame, so it wins when both are over
+    report.gpu = !cpuOver;
+    report.frame = cpuOver ? frame : gpuFrame;
+    report.ms = cpuOver ? cpuMs : gpuMs;
+    report.prefix = settings.directory + "/hitch_" + std::to_string(report.frame);
+    detector.pendingCapture = report.prefix + ".gputrace";
+    detector.lastReport = now;
+    ++detector.reports;
+    return true;
+}
+
+std::string hitch_detector_take_capture(HitchDetector& detector) {
+    std::string path;
+    path.swap(detector.pendingCapture);
+    return path;
+}
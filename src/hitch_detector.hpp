@@ -0,0 +1,76 @@
+/**
+ * @file hitch_detector.hpp
+ * @brief Watches frame times for frames over a budget and decides when to write a hitch report.
+ *
+ * Sporadic spikes rarely happen while someone is watching with Instruments. Every frame the
+ * detector is given the CPU time of the frame that just ended and the newest GPU time that
+ * arrived, which trails by a few frames. A frame over budget on either starts a report: the
+ * caller writes the last seconds of the CPU sampler and the frame stats history under
+ * HitchReport::prefix, and the next frame is captured with MTLCaptureManager as a
+ * .gputrace document (see gpu_capture.hpp). The slow frame itself is over before it is
+ * known to be slow, so the capture is of its successor; spikes that repeat are caught.
+ *
+ * Reports are rate limited: one per cooldown, so a run of slow frames writes one, and at
+ * most maxReports per run, since a capture can take hundreds of megabytes.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * @struct HitchSettings
+ * @brief What counts as a hitch and how often one is reported.
+ */
+struct HitchSettings {
+    float budgetMs = 0.0f;          ///< CPU or GPU time a frame may take; 0 disables detection.
+    float cooldownSeconds = 10.0f;  ///< Minimum time between two reports.
+    uint32_t maxReports = 8;        ///< Reports per run.
+    std::string directory = ".";    ///< Where reports are written; must exist.
+};
+
+/**
+ * @struct HitchReport
+ * @brief A frame that went over budget.
+ */
+struct HitchReport {
+    uint64_t frame = 0;     ///< The slow frame.
+    float ms = 0.0f;        ///< Its time over the budget's measure, CPU or GPU.
+    bool gpu = false;       ///< True if its GPU time rather than its CPU time went over.
+    std::string prefix;     ///< Report files without their extension: directory/hitch_<frame>.
+};
+
+/**
+ * @struct HitchDetector
+ * @brief Rate limiting state and the capture armed for the next frame. Render thread only.
+ */
+struct HitchDetector {
+    HitchSettings settings;
+    uint64_t lastGpuFrame = 0;      ///< Newest frame whose GPU time was checked, so each is checked once.
+    double lastReport = -1.0e9;     ///< When the last report started, in seconds.
+    uint32_t reports = 0;           ///< Reports started so far.
+    std::string pendingCapture;     ///< .gputrace path for the next frame; empty if none is armed.
+};
+
+/**
+ * @brief Checks the frame that just ended and the newest GPU time against the budget.
+ *
+ * When a report starts, the capture of the next frame is armed; see hitch_detector_take_capture().
+ *
+ * @param detector The detector.
+ * @param frame The frame that just ended.
+ * @param cpuMs Its CPU time.
+ * @param gpuFrame Newest frame whose GPU time arrived, 0 if none has.
+ * @param gpuMs That frame's GPU time.
+ * @param now Current time in seconds.
+ * @param report Receives the hitch when a report starts.
+ * @return True if a report starts now.
+ */
+bool hitch_detector_update(HitchDetector& detector, uint64_t frame, float cpuMs, uint64_t gpuFrame, float gpuMs,
+                           double now, HitchReport& report);
+
+/**
+ * @brief Disarms the pending capture; call as a frame begins.
+ * @return Path of the .gputrace to capture this frame into, or empty if none is armed.
+ */
+std::string hitch_detector_take_capture(HitchDetector& detector);
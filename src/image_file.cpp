@@ -0,0 +1,368 @@
+#include "image_file.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    constexpr size_t TGA_HEADER_BYTES = 18;
+    constexpr uint8_t TGA_TRUE_COLOR = 2;
+    constexpr uint8_t TGA_TOP_LEFT = 0x20;  // Descriptor bit: rows run top to bottom
+    constexpr uint8_t TGA_ALPHA_BITS = 8;
+
+    void put_u16(uint8_t* out, uint32_t value) {
+        out[0] = (uint8_t)(value & 0xFF);
+        out[1] = (uint8_t)(value >> 8);
+    }
+
+    uint32_t get_u16(const uint8_t* in) {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8);
+    }
+
+    // --- PNG ---
+
+    constexpr uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    constexpr uint8_t PNG_COLOR_RGB = 2;
+    constexpr uint8_t PNG_FILTER_NONE = 0, PNG_FILTER_SUB = 1, PNG_FILTER_UP = 2;
+
+    // Deflate's LZ77 parameters: matches of 3 to 258 bytes up to 32 KB back
+    constexpr uint32_t DEFLATE_MIN_MATCH = 3;
+    constexpr uint32_t DEFLATE_MAX_MATCH = 258;
+    constexpr uint32_t DEFLATE_WINDOW = 32768;
+    constexpr uint32_t DEFLATE_HASH_BITS = 15;
+    constexpr uint32_t DEFLATE_MAX_CHAIN = 32;   // Candidates tried per position; more trades speed for ratio
+
+    constexpr uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                           3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                             193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                             6145, 8193, 12289, 16385, 24577 };
+    constexpr uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                             6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t size) {
+        static const auto table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    uint32_t adler32(const uint8_t* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // 5552 bytes is the most that cannot overflow b before the modulo
+            const size_t block = std::min(size, (size_t)5552);
+            for (size_t i = 0; i < block; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += block;
+            size -= block;
+        }
+        return (b << 16) | a;
+    }
+
+    void put_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back((uint8_t)(value >> 24));
+        out.push_back((uint8_t)(value >> 16));
+        out.push_back((uint8_t)(value >> 8));
+        out.push_back((uint8_t)value);
+    }
+
+    // Appends a chunk: length, type, data, then the CRC of type and data
+    void put_png_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+        put_u32_be(out, (uint32_t)size);
+        const size_t typeOffset = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        put_u32_be(out, crc32_update(0xFFFFFFFFu, out.data() + typeOffset, size + 4) ^ 0xFFFFFFFFu);
+    }
+
+    // Deflate packs bits from the least significant end; Huffman codes go most significant bit first
+    struct BitWriter {
+        std::vector<uint8_t>& out;
+        uint64_t bits = 0;
+        uint32_t count = 0;
+
+        void put(uint32_t value, uint32_t length) {
+            bits |= (uint64_t)value << count;
+            count += length;
+            while (count >= 8) {
+                out.push_back((uint8_t)bits);
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+
+        void put_code(uint32_t code, uint32_t length) {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < length; ++i) {
+                reversed |= ((code >> i) & 1) << (length - 1 - i);
+            }
+            put(reversed, length);
+        }
+
+        void flush() {
+            if (count > 0) {
+                out.push_back((uint8_t)bits);
+            }
+            bits = 0;
+            count = 0;
+        }
+    };
+
+    // The fixed literal/length code of deflate block type 1
+    void put_fixed_symbol(BitWriter& writer, uint32_t symbol) {
+        if (symbol < 144) {
+            writer.put_code(0x30 + symbol, 8);
+        } else if (symbol < 256) {
+            writer.put_code(0x190 + symbol - 144, 9);
+        } else if (symbol < 280) {
+            writer.put_code(symbol - 256, 7);
+        } else {
+            writer.put_code(0xC0 + symbol - 280, 8);
+        }
+    }
+
+    void put_match(BitWriter& writer, uint32_t length, uint32_t distance) {
+        uint32_t code = 28;
+        while (LENGTH_BASE[code] > length) {
+            --code;
+        }
+        put_fixed_symbol(writer, 257 + code);
+        writer.put(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+        code = 29;
+        while (DISTANCE_BASE[code] > distance) {
+            --code;
+        }
+        writer.put_code(code, 5);
+        writer.put(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+    }
+
+    uint32_t hash3(const uint8_t* p) {
+        return ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+    }
+
+    // Compresses into a zlib stream holding one fixed-Huffman block, taking the longest match of a hash chain
+    void deflate_fixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        out.push_back(0x78); // Deflate with a 32 KB window
+        out.push_back(0x01); // Fastest compression; makes the header a multiple of 31
+
+        BitWriter writer{ out };
+        writer.put(1, 1); // Final block
+        writer.put(1, 2); // Fixed Huffman codes
+
+        std::vector<int32_t> head((size_t)1 << DEFLATE_HASH_BITS, -1);
+        std::vector<int32_t> previous(size, -1);
+        size_t i = 0;
+        auto insert = [&](size_t position) {
+            const uint32_t h = hash3(data + position);
+            previous[position] = head[h];
+            head[h] = (int32_t)position;
+        };
+        while (i < size) {
+            uint32_t bestLength = 0, bestDistance = 0;
+            if (i + DEFLATE_MIN_MATCH <= size) {
+                const uint32_t maxLength = (uint32_t)std::min((size_t)DEFLATE_MAX_MATCH, size - i);
+                int32_t candidate = head[hash3(data + i)];
+                for (uint32_t chain = 0; candidate >= 0 && chain < DEFLATE_MAX_CHAIN; ++chain) {
+                    const size_t distance = i - (size_t)candidate;
+                    if (distance > DEFLATE_WINDOW) {
+                        break;
+                    }
+                    uint32_t length = 0;
+                    while (length < maxLength && data[candidate + length] == data[i + length]) {
+                        ++length;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = (uint32_t)distance;
+                        if (length == maxLength) {
+                            break;
+                        }
+                    }
+                    candidate = previous[candidate];
+                }
+            }
+
+            if (bestLength >= DEFLATE_MIN_MATCH) {
+                put_match(writer, bestLength, bestDistance);
+                for (size_t end = i + bestLength; i < end; ++i) {
+                    if (i + DEFLATE_MIN_MATCH <= size) {
+                        insert(i);
+                    }
+                }
+            } else {
+                put_fixed_symbol(writer, data[i]);
+                if (i + DEFLATE_MIN_MATCH <= size) {
+                    insert(i);
+                }
+                ++i;
+            }
+        }
+        put_fixed_symbol(writer, 256); // End of block
+        writer.flush();
+        put_u32_be(out, adler32(data, size));
+    }
+
+    // Sum of the filtered bytes as signed values; the usual cheap estimate of how well a row compresses
+    uint32_t filter_cost(const uint8_t* row, size_t size) {
+        uint32_t cost = 0;
+        for (size_t i = 0; i < size; ++i) {
+            cost += (uint32_t)std::abs((int)(int8_t)row[i]);
+        }
+        return cost;
+    }
+}
+
+bool write_tga(const char* filename, const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes,
+               std::string& error) {
+    if (width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF || rowBytes < 4 * (size_t)width) {
+        error = "image size not representable in TGA";
+        return false;
+    }
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = std::string("cannot write ") + filename;
+        return false;
+    }
+
+    uint8_t header[TGA_HEADER_BYTES] = {};
+    header[2] = TGA_TRUE_COLOR;
+    put_u16(header + 12, width);
+    put_u16(header + 14, height);
+    header[16] = 32;
+    header[17] = TGA_TOP_LEFT | TGA_ALPHA_BITS;
+    file.write((const char*)header, sizeof(header));
+    for (uint32_t y = 0; y < height; ++y) {
+        file.write((const char*)(bgra + y * rowBytes), 4 * (std::streamsize)width);
+    }
+    if (!file) {
+        error = std::string("failed writing ") + filename;
+        return false;
+    }
+    return true;
+}
+
+bool read_tga(const char* filename, std::vector<uint8_t>& bgra, uint32_t& width, uint32_t& height, std::string& error) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    uint8_t header[TGA_HEADER_BYTES];
+    if (!file.read((char*)header, sizeof(header))) {
+        error = "truncated TGA header";
+        return false;
+    }
+    if (header[1] != 0 || header[2] != TGA_TRUE_COLOR || header[16] != 32) {
+        error = "only uncompressed 32-bit true-colour TGA is supported";
+        return false;
+    }
+    width = get_u16(header + 12);
+    height = get_u16(header + 14);
+    file.seekg(header[0], std::ios::cur); // Skip the image ID
+
+    bgra.resize((size_t)width * height * 4);
+    const size_t rowBytes = (size_t)width * 4;
+    const bool topDown = (header[17] & TGA_TOP_LEFT) != 0;
+    for (uint32_t row = 0; row < height; ++row) {
+        const uint32_t y = topDown ? row : height - 1 - row;
+        if (!file.read((char*)bgra.data() + y * rowBytes, (std::streamsize)rowBytes)) {
+            error = "truncated TGA pixels";
+            return false;
+        }
+    }
+    return true;
+}
+
+void encode_png(const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes, std::vector<uint8_t>& png) {
+    const size_t rgbRow = (size_t)width * 3;
+
+    // Each row is its filter type byte and the filtered RGB bytes
+    std::vector<uint8_t> filtered((rgbRow + 1) * height);
+    std::vector<uint8_t> current(rgbRow), previous(rgbRow, 0), sub(rgbRow), up(rgbRow);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* in = bgra + y * rowBytes;
+        for (uint32_t x = 0; x < width; ++x) {
+            current[3 * x + 0] = in[4 * x + 2];
+            current[3 * x + 1] = in[4 * x + 1];
+            current[3 * x + 2] = in[4 * x + 0];
+        }
+        for (size_t i = 0; i < rgbRow; ++i) {
+            sub[i] = (uint8_t)(current[i] - (i >= 3 ? current[i - 3] : 0));
+            up[i] = (uint8_t)(current[i] - previous[i]);
+        }
+
+        uint8_t filter = PNG_FILTER_NONE;
+        const uint8_t* chosen = current.data();
+        uint32_t cost = filter_cost(current.data(), rgbRow);
+        if (const uint32_t subCost = filter_cost(sub.data(), rgbRow); subCost < cost) {
+            filter = PNG_FILTER_SUB;
+            chosen = sub.data();
+            cost = subCost;
+        }
+        if (y > 0 && filter_cost(up.data(), rgbRow) < cost) {
+            filter = PNG_FILTER_UP;
+            chosen = up.data();
+        }
+        uint8_t* out = filtered.data() + y * (rgbRow + 1);
+        out[0] = filter;
+        memcpy(out + 1, chosen, rgbRow);
+        std::swap(current, previous);
+    }
+
+    uint8_t header[13] = {};
+    for (int i = 0; i < 4; ++i) {
+        header[i] = (uint8_t)(width >> (24 - 8 * i));
+        header[4 + i] = (uint8_t)(height >> (24 - 8 * i));
+    }
+    header[8] = 8; // Bits per channel
+    header[9] = PNG_COLOR_RGB;
+
+    std::vector<uint8_t> compressed;
+    deflate_fixed(filtered.data(), filtered.size(), compressed);
+
+    png.assign(PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+    put_png_chunk(png, "IHDR", header, sizeof(header));
+    put_png_chunk(png, "IDAT", compressed.data(), compressed.size());
+    put_png_chunk(png, "IEND", nullptr, 0);
+}
+
+bool write_png(const char* filename, const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes,
+               std::string& error) {
+    if (width == 0 || height == 0 || rowBytes < 4 * (size_t)width) {
+        error = "image size not representable in PNG";
+        return false;
+    }
+    std::vector<uint8_t> png;
+    encode_png(bgra, width, height, rowBytes, png);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = std::string("cannot write ") + filename;
+        return false;
+    }
+    if (!file.write((const char*)png.data(), (std::streamsize)png.size())) {
+        error = std::string("failed writing ") + filename;
+        return false;
+    }
+    return true;
+}
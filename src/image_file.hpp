@@ -0,0 +1,63 @@
+/**
+ * @file image_file.hpp
+ * @brief Writes rendered images to disk without an image library.
+ *
+ * Images are saved as uncompressed 32-bit TGA, whose pixel layout is the BGRA8 of the
+ * render targets, so rows are written as they come back from the GPU, or as PNG for files
+ * that are kept. The PNG encoder is self-contained: rows are filtered with the cheapest of
+ * None, Sub and Up, and compressed with greedy LZ77 and deflate's fixed Huffman codes,
+ * which gives up some ratio against zlib for speed and no dependency.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes BGRA8 pixels to an uncompressed TGA file, top row first.
+ * @param filename The file to write.
+ * @param bgra The pixels, top row first.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param rowBytes Bytes from one row to the next; at least 4 * width.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool write_tga(const char* filename, const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes,
+               std::string& error);
+
+/**
+ * @brief Reads a file written by write_tga().
+ * @param filename The file to read.
+ * @param bgra Receives width * height * 4 bytes, top row first.
+ * @param width Receives the width.
+ * @param height Receives the height.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success; only 32-bit uncompressed true-colour files are accepted.
+ */
+bool read_tga(const char* filename, std::vector<uint8_t>& bgra, uint32_t& width, uint32_t& height, std::string& error);
+
+/**
+ * @brief Encodes BGRA8 pixels as an 8-bit RGB PNG; alpha is dropped, as rendered scenes are opaque.
+ * @param bgra The pixels, top row first.
+ * @param width The width in pixels; not 0.
+ * @param height The height in pixels; not 0.
+ * @param rowBytes Bytes from one row to the next; at least 4 * width.
+ * @param png Receives the file contents.
+ */
+void encode_png(const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes, std::vector<uint8_t>& png);
+
+/**
+ * @brief Writes BGRA8 pixels to a PNG file with encode_png().
+ * @param filename The file to write.
+ * @param bgra The pixels, top row first.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param rowBytes Bytes from one row to the next; at least 4 * width.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool write_png(const char* filename, const uint8_t* bgra, uint32_t width, uint32_t height, size_t rowBytes,
+               std::string& error);
@@ -0,0 +1,105 @@
+#include "image_gate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+    // CIELAB of every pixel, so the neighbourhood search converts each pixel once
+    typedef std::array<float, 3> Lab;
+
+    float srgb_to_linear(uint8_t value) {
+        const float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float lab_f(float t) {
+        return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f;
+    }
+
+    Lab bgra_to_lab(const uint8_t* bgra) {
+        const float r = srgb_to_linear(bgra[2]);
+        const float g = srgb_to_linear(bgra[1]);
+        const float b = srgb_to_linear(bgra[0]);
+        // Linear sRGB to XYZ, relative to the D65 white point
+        const float x = (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f;
+        const float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+        const float z = (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f;
+        const float fx = lab_f(x), fy = lab_f(y), fz = lab_f(z);
+        return { 116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz) };
+    }
+
+    float lab_distance(const Lab& a, const Lab& b) {
+        const float dl = a[0] - b[0], da = a[1] - b[1], db = a[2] - b[2];
+        return std::sqrt(dl * dl + da * da + db * db);
+    }
+
+    std::vector<Lab> to_lab(const uint8_t* bgra, size_t pixels) {
+        std::vector<Lab> lab(pixels);
+        for (size_t i = 0; i < pixels; ++i) {
+            lab[i] = bgra_to_lab(bgra + 4 * i);
+        }
+        return lab;
+    }
+
+    // The smallest difference between a colour and the pixels within one texel of (x, y) in an image
+    float nearest_difference(const Lab& colour, const std::vector<Lab>& image, uint32_t width, uint32_t height,
+                             uint32_t x, uint32_t y) {
+        float nearest = INFINITY;
+        for (uint32_t ny = y > 0 ? y - 1 : 0; ny <= std::min(y + 1, height - 1); ++ny) {
+            for (uint32_t nx = x > 0 ? x - 1 : 0; nx <= std::min(x + 1, width - 1); ++nx) {
+                nearest = std::min(nearest, lab_distance(colour, image[(size_t)ny * width + nx]));
+            }
+        }
+        return nearest;
+    }
+}
+
+float bgra_delta_e(const uint8_t* a, const uint8_t* b) {
+    return lab_distance(bgra_to_lab(a), bgra_to_lab(b));
+}
+
+ImageComparison compare_images(const uint8_t* golden, const uint8_t* current, uint32_t width, uint32_t height,
+                               const ImageGateSettings& settings, std::vector<uint8_t>* diff) {
+    ImageComparison result;
+    const size_t pixels = (size_t)width * height;
+    if (diff) {
+        diff->assign(pixels * 4, 0);
+    }
+    if (pixels == 0) {
+        result.passed = true;
+        return result;
+    }
+    const std::vector<Lab> goldenLab = to_lab(golden, pixels);
+    const std::vector<Lab> currentLab = to_lab(current, pixels);
+
+    double sum = 0.0;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const size_t i = (size_t)y * width + x;
+            const float direct = lab_distance(goldenLab[i], currentLab[i]);
+            sum += direct;
+            // Both ways, so a feature that appeared is caught as well as one that went missing
+            float difference = direct;
+            if (difference >= settings.deltaE) {
+                difference = std::max(nearest_difference(goldenLab[i], currentLab, width, height, x, y),
+                                      nearest_difference(currentLab[i], goldenLab, width, height, x, y));
+            }
+            result.maxDeltaE = std::max(result.maxDeltaE, difference);
+            const bool changed = difference >= settings.deltaE;
+            result.changedPixels += changed;
+            if (diff) {
+                uint8_t* out = diff->data() + 4 * i;
+                const uint8_t grey = (uint8_t)std::clamp(goldenLab[i][0] * 0.5f * 2.55f, 0.0f, 255.0f);
+                out[0] = changed ? 0 : grey;
+                out[1] = changed ? 0 : grey;
+                out[2] = changed ? 255 : grey;
+                out[3] = 255;
+            }
+        }
+    }
+    result.meanDeltaE = (float)(sum / pixels);
+    result.changedFraction = (float)result.changedPixels / pixels;
+    result.passed = result.changedFraction <= settings.maxFraction && result.meanDeltaE <= settings.maxMeanDeltaE;
+    return result;
+}
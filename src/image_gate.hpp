@@ -0,0 +1,60 @@
+/**
+ * @file image_gate.hpp
+ * @brief Compares rendered images with stored golden images, within a perceptual tolerance.
+ *
+ * Exact comparison fails on any change of rounding, and every GPU family, driver and
+ * optimization like packed vertices or approximate trigonometry rounds a little differently.
+ * Pixels are therefore compared by their CIE76 colour difference in CIELAB, where a difference
+ * of about 2.3 is just noticeable, and a pixel only counts as changed if no pixel within one
+ * texel of it in the other image comes within the tolerance, so edges that moved by a texel
+ * pass. An image fails when more than a set fraction of its pixels changed, or when its mean
+ * difference, which catches a faint shift over the whole frame, grew past a limit.
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct ImageGateSettings
+ * @brief How much an image may differ from its golden image.
+ */
+struct ImageGateSettings {
+    float deltaE = 2.3f;            ///< Colour difference from which a pixel counts as changed.
+    float maxFraction = 0.002f;     ///< Largest fraction of changed pixels that passes.
+    float maxMeanDeltaE = 1.0f;     ///< Largest mean colour difference over all pixels that passes.
+};
+
+/**
+ * @struct ImageComparison
+ * @brief One image compared with its golden image.
+ */
+struct ImageComparison {
+    float meanDeltaE = 0.0f;        ///< Mean colour difference of the pixels at the same position.
+    float maxDeltaE = 0.0f;         ///< Largest difference left after the one-texel search.
+    uint64_t changedPixels = 0;     ///< Pixels whose difference is at least ImageGateSettings::deltaE.
+    float changedFraction = 0.0f;   ///< changedPixels over the pixel count.
+    bool passed = false;            ///< True if both limits hold.
+};
+
+/**
+ * @brief Returns the CIE76 colour difference of two sRGB pixels.
+ * @param a A pixel, BGRA8.
+ * @param b Another pixel, BGRA8; alpha is ignored.
+ * @return The Euclidean distance of their CIELAB coordinates under D65.
+ */
+float bgra_delta_e(const uint8_t* a, const uint8_t* b);
+
+/**
+ * @brief Compares an image with its golden image.
+ * @param golden The golden image, BGRA8, top row first and tightly packed.
+ * @param current The new image, laid out the same.
+ * @param width The width of both images.
+ * @param height The height of both images.
+ * @param settings The tolerance.
+ * @param diff If not null, receives a BGRA8 image of the comparison: the golden image dimmed to grey,
+ *             with changed pixels in red.
+ * @return The comparison.
+ */
+ImageComparison compare_images(const uint8_t* golden, const uint8_t* current, uint32_t width, uint32_t height,
+                               const ImageGateSettings& settings, std::vector<uint8_t>* diff = nullptr);
@@ -0,0 +1,115 @@
+#include "impostor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "camera.hpp"
+
+namespace {
+    // The shade the atlas is baked at
+    constexpr float BAKED_SHADE = 0.5f;
+
+    InstanceData part(simd::float3 offset, simd::float3 size, simd::float3 color) {
+        InstanceData data;
+        data.modelMatrix = matrix_translation(offset.x, offset.y, offset.z) * matrix_scale(size.x, size.y, size.z);
+        data.color = { color.x, color.y, color.z, 0.0f };
+        return data;
+    }
+
+    // +Y pushed away from the direction; the quad in impostor_vertex is built the same way
+    simd::float3 frame_right(simd::float3 direction) {
+        const simd::float3 right = simd::cross(simd::float3{ 0.0f, 1.0f, 0.0f }, direction);
+        const float length = simd::length(right);
+        return length > 1e-4f ? right / length : simd::float3{ 1.0f, 0.0f, 0.0f };
+    }
+}
+
+simd::float2 impostor_octahedral_encode(simd::float3 direction) {
+    direction.y = std::max(direction.y, 0.0f);
+    const float sum = fabsf(direction.x) + direction.y + fabsf(direction.z);
+    if (sum <= 0.0f) {
+        return { 0.5f, 0.5f };
+    }
+    direction = direction / sum;
+    // The diamond |x| + |z| <= 1 turned by 45 degrees to fill the square
+    return { (direction.x + direction.z) * 0.5f + 0.5f, (direction.x - direction.z) * 0.5f + 0.5f };
+}
+
+simd::float3 impostor_octahedral_decode(simd::float2 uv) {
+    const float px = uv.x * 2.0f - 1.0f;
+    const float py = uv.y * 2.0f - 1.0f;
+    const float x = (px + py) * 0.5f;
+    const float z = (px - py) * 0.5f;
+    return simd::normalize(simd::float3{ x, std::max(1.0f - fabsf(x) - fabsf(z), 0.0f), z });
+}
+
+simd::float3 impostor_frame_direction(uint32_t x, uint32_t y) {
+    const float scale = 1.0f / (IMPOSTOR_FRAMES - 1);
+    return impostor_octahedral_decode({ x * scale, y * scale });
+}
+
+ImpostorBlend impostor_frame_blend(simd::float3 direction) {
+    const simd::float2 uv = impostor_octahedral_encode(direction);
+    const float last = (float)(IMPOSTOR_FRAMES - 1);
+    const float gx = std::clamp(uv.x * last, 0.0f, last);
+    const float gy = std::clamp(uv.y * last, 0.0f, last);
+    const uint32_t x = std::min((uint32_t)gx, IMPOSTOR_FRAMES - 2);
+    const uint32_t y = std::min((uint32_t)gy, IMPOSTOR_FRAMES - 2);
+    const float fx = gx - x;
+    const float fy = gy - y;
+
+    ImpostorBlend blend;
+    blend.frames[0] = y * IMPOSTOR_FRAMES + x;
+    blend.frames[1] = blend.frames[0] + 1;
+    blend.frames[2] = blend.frames[0] + IMPOSTOR_FRAMES;
+    blend.frames[3] = blend.frames[2] + 1;
+    blend.weights[0] = (1.0f - fx) * (1.0f - fy);
+    blend.weights[1] = fx * (1.0f - fy);
+    blend.weights[2] = (1.0f - fx) * fy;
+    blend.weights[3] = fx * fy;
+    return blend;
+}
+
+uint32_t impostor_parts(FoliageKind kind, InstanceData* parts) {
+    const float s = BAKED_SHADE;
+    if (kind == FoliageKind::Rock) {
+        const float grey = 0.4f + 0.2f * s;
+        parts[0] = part({ 0.0f, 0.3f, 0.0f }, { 1.2f, 0.8f, 1.6f }, { grey, grey, grey });
+        return 1;
+    }
+    const simd::float3 bark = simd::float3{ 0.5f, 0.35f, 0.26f } * (0.85f + 0.3f * s);
+    parts[0] = part({ 0.0f, 1.0f, 0.0f }, { 0.2f, 2.0f, 0.2f }, bark);
+    parts[1] = part({ 0.0f, 2.5f, 0.0f }, { 1.5f, 1.5f, 1.5f }, { 0.05f * s, 0.65f + 0.25f * s, 0.15f + 0.1f * s });
+    return 2;
+}
+
+ImpostorBounds impostor_bounds(FoliageKind kind) {
+    InstanceData parts[IMPOSTOR_MAX_PARTS];
+    const uint32_t count = impostor_parts(kind, parts);
+    // The parts are axis-aligned, so their boxes come straight from the transforms
+    simd::float3 lo = { INFINITY, INFINITY, INFINITY };
+    simd::float3 hi = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = 0; i < count; ++i) {
+        const simd::float4x4& m = parts[i].modelMatrix;
+        const simd::float3 center = { m.columns[3].x, m.columns[3].y, m.columns[3].z };
+        const simd::float3 half = simd::float3{ m.columns[0].x, m.columns[1].y, m.columns[2].z } * 0.5f;
+        lo = simd::min(lo, center - half);
+        hi = simd::max(hi, center + half);
+    }
+    ImpostorBounds bounds;
+    bounds.center = (lo + hi) * 0.5f;
+    bounds.radius = simd::length(hi - lo) * 0.5f;
+    return bounds;
+}
+
+simd::float4x4 impostor_frame_view_projection(FoliageKind kind, uint32_t x, uint32_t y) {
+    const ImpostorBounds bounds = impostor_bounds(kind);
+    const simd::float3 direction = impostor_frame_direction(x, y);
+    const simd::float3 right = frame_right(direction);
+    const simd::float3 up = simd::cross(direction, right);
+    // Looking against the direction from outside the sphere, with right and up as the view's x and y
+    const simd::float3 eye = bounds.center + direction * (2.0f * bounds.radius);
+    const simd::float4x4 view = matrix_look_at_right_hand(eye, bounds.center, up);
+    const float r = bounds.radius;
+    return matrix_orthographic_right_hand(-r, r, -r, r, r, 3.0f * r) * view;
+}
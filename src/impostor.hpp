@@ -0,0 +1,109 @@
+/**
+ * @file impostor.hpp
+ * @brief Octahedral impostors: far trees and rocks drawn as one camera-facing quad.
+ *
+ * At load time each foliage kind is rendered from IMPOSTOR_FRAMES x IMPOSTOR_FRAMES directions
+ * over the upper hemisphere into the frames of an atlas, albedo and coverage in one texture and
+ * the object space normal in another. A frame's direction is the hemi-octahedral decode of its
+ * grid position, so neighbouring frames are neighbouring directions. Far instances become a
+ * quad the size of the kind's bounding sphere, facing the camera, which samples the four frames
+ * around the direction it is seen from and blends them bilinearly; between the detailed mesh
+ * and the impostor both are drawn for a stretch, each dissolving into the other through the
+ * same ordered dither, so neither pops.
+ *
+ * The frame's basis and the quad's are built the same way, from the view direction and +Y, so
+ * a quad seen from exactly a frame's direction reproduces that frame. These functions are the
+ * reference impostor_vertex in shaders.metal is ported from.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "foliage.hpp"
+#include "objects.hpp"
+
+/// Frames along each edge of an impostor atlas.
+constexpr uint32_t IMPOSTOR_FRAMES = 8;
+/// Pixels along each edge of a frame.
+constexpr uint32_t IMPOSTOR_FRAME_SIZE = 64;
+/// Pixels along each edge of an atlas; one atlas slice per FoliageKind.
+constexpr uint32_t IMPOSTOR_ATLAS_SIZE = IMPOSTOR_FRAMES * IMPOSTOR_FRAME_SIZE;
+/// Foliage kinds with an atlas slice.
+constexpr uint32_t IMPOSTOR_KINDS = 2;
+/// Mip levels of the atlas; more would blend neighbouring frames together.
+constexpr uint32_t IMPOSTOR_MIP_LEVELS = 4;
+/// Most boxes a foliage kind is built from.
+constexpr uint32_t IMPOSTOR_MAX_PARTS = 2;
+
+/**
+ * @struct ImpostorBounds
+ * @brief The sphere an impostor's frames are fitted to, in the instance's unscaled space.
+ */
+struct ImpostorBounds {
+    simd::float3 center;    ///< Centre above the instance's base.
+    float radius = 0.0f;    ///< Half the edge of every frame.
+};
+
+/**
+ * @struct ImpostorBlend
+ * @brief The frames a view direction falls between and how much each contributes.
+ */
+struct ImpostorBlend {
+    uint32_t frames[4];     ///< Frame indices, row * IMPOSTOR_FRAMES + column.
+    float weights[4];       ///< Bilinear weights; they sum to 1.
+};
+
+/**
+ * @brief Maps a direction on the upper hemisphere to the unit square.
+ * @param direction The direction; a negative y is taken as 0.
+ * @return Its hemi-octahedral coordinates in [0, 1].
+ */
+simd::float2 impostor_octahedral_encode(simd::float3 direction);
+
+/// @return The unit direction impostor_octahedral_encode() maps to uv.
+simd::float3 impostor_octahedral_decode(simd::float2 uv);
+
+/**
+ * @brief Returns the direction a frame is rendered from, pointing from the object to the viewer.
+ * @param x The frame column.
+ * @param y The frame row.
+ * @return The unit direction.
+ */
+simd::float3 impostor_frame_direction(uint32_t x, uint32_t y);
+
+/**
+ * @brief Picks the frames to blend for a view direction.
+ * @param direction Unit direction from the object to the viewer, in the object's space.
+ * @return The four frames around it.
+ */
+ImpostorBlend impostor_frame_blend(simd::float3 direction);
+
+/**
+ * @brief Returns the boxes a foliage kind is drawn with up close; matches select_foliage in shaders.metal.
+ *
+ * The instance is unscaled and unrotated, and the colours are those of the middle shade, which
+ * the impostor tints towards the instance's own.
+ *
+ * @param kind The foliage kind.
+ * @param parts Receives up to IMPOSTOR_MAX_PARTS boxes as transforms of the unit cube.
+ * @return The number of boxes.
+ */
+uint32_t impostor_parts(FoliageKind kind, InstanceData* parts);
+
+/// @return The sphere around every box of a foliage kind.
+ImpostorBounds impostor_bounds(FoliageKind kind);
+
+/**
+ * @brief Returns the orthographic transform a frame is rendered with.
+ *
+ * The view looks at the bounds' centre against the frame's direction and spans the sphere in
+ * x, y and depth; clip space y is the frame's up, which is +Y pushed away from the direction.
+ *
+ * @param kind The foliage kind.
+ * @param x The frame column.
+ * @param y The frame row.
+ * @return The unscaled instance space to clip space transform.
+ */
+simd::float4x4 impostor_frame_view_projection(FoliageKind kind, uint32_t x, uint32_t y);
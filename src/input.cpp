@@ -0,0 +1,45 @@
+#include "input.hpp"
+
+void apply_input_event(InputState& state, const InputEvent& event) {
+    switch (event.type) {
+    case InputEventType::KeyDown:
+    case InputEventType::KeyUp:
+        if (event.key >= 0 && event.key < 1024) {
+            state.keys[event.key] = event.type == InputEventType::KeyDown;
+        }
+        break;
+    case InputEventType::MouseMove:
+        if (state.hasMouse) {
+            state.mouseDeltaX += float(event.x - state.mouseX);
+            state.mouseDeltaY += float(event.y - state.mouseY);
+        }
+        state.mouseX = event.x;
+        state.mouseY = event.y;
+        state.hasMouse = true;
+        break;
+    case InputEventType::CursorLock:
+    case InputEventType::CursorRelease:
+        state.cursorLocked = event.type == InputEventType::CursorLock;
+        state.hasMouse = false;
+        break;
+    }
+}
+
+uint32_t drain_input(InputQueue& queue, InputState& state, double until, std::vector<InputEvent>* applied) {
+    uint32_t count = 0;
+    InputEvent event;
+    for (const InputEvent* next = queue.peek(); next && next->time <= until; next = queue.peek()) {
+        queue.pop(event);
+        apply_input_event(state, event);
+        if (applied) {
+            applied->push_back(event);
+        }
+        ++count;
+    }
+    return count;
+}
+
+void clear_input_deltas(InputState& state) {
+    state.mouseDeltaX = 0.0f;
+    state.mouseDeltaY = 0.0f;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file input.hpp
+ * @brief Timestamped input events and the state the simulation builds from them.
+ *
+ * The window callbacks push events on the main thread and the simulation thread drains
+ * them before each step, so the simulation never reads state another thread is writing.
+ * Mouse motion reaches the camera as the delta accumulated over one step, which keeps
+ * the last cursor position out of the camera code and makes a recorded event stream
+ * replayable step for step.
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "spsc_queue.hpp"
+
+/**
+ * @enum InputEventType
+ * @brief What an InputEvent reports.
+ */
+enum class InputEventType : uint8_t {
+    KeyDown,        ///< InputEvent::key was pressed.
+    KeyUp,          ///< InputEvent::key was released.
+    MouseMove,      ///< The cursor moved to InputEvent::x, InputEvent::y.
+    CursorLock,     ///< The cursor was captured for mouse-look.
+    CursorRelease,  ///< The cursor was released to the UI.
+};
+
+/**
+ * @struct InputEvent
+ * @brief One input change and when it happened.
+ */
+struct InputEvent {
+    double time = 0.0;                              ///< simulation_clock() time of the event, in seconds.
+    InputEventType type = InputEventType::KeyDown;  ///< The kind of event.
+    int key = 0;                                    ///< The GLFW key code of key events.
+    double x = 0.0;                                 ///< The cursor X position of MouseMove.
+    double y = 0.0;                                 ///< The cursor Y position of MouseMove.
+};
+
+/// Events the main thread can queue before the simulation drains them; a second of fast mouse motion.
+constexpr size_t INPUT_QUEUE_CAPACITY = 1024;
+
+/// The queue the window callbacks push to and the simulation thread drains.
+typedef SpscQueue<InputEvent, INPUT_QUEUE_CAPACITY> InputQueue;
+
+/**
+ * @struct InputState
+ * @brief Input as seen by one simulation step.
+ */
+struct InputState {
+    bool keys[1024] = {};       ///< Held keys, indexed by GLFW key code.
+    bool cursorLocked = true;   ///< False while the cursor is released to the UI.
+    float mouseDeltaX = 0.0f;   ///< Cursor X motion since the deltas were last cleared, in pixels.
+    float mouseDeltaY = 0.0f;   ///< Cursor Y motion since the deltas were last cleared, in pixels.
+    double mouseX = 0.0;        ///< The last cursor X position, the origin of the next delta.
+    double mouseY = 0.0;        ///< The last cursor Y position.
+    bool hasMouse = false;      ///< False until a position is known; the first move only sets it.
+};
+
+/**
+ * @brief Applies one event to the state.
+ *
+ * Capturing or releasing the cursor moves it, so the move after either only sets a new
+ * origin rather than turning the camera.
+ *
+ * @param state The state to update.
+ * @param event The event.
+ */
+void apply_input_event(InputState& state, const InputEvent& event);
+
+/**
+ * @brief Applies every queued event that happened up to a time. Consumer thread only.
+ * @param queue The queue to drain.
+ * @param state The state to update.
+ * @param until Events after this time stay queued for a later step.
+ * @param applied If not null, receives a copy of every event applied, appended in order.
+ * @return The number of events applied.
+ */
+uint32_t drain_input(InputQueue& queue, InputState& state, double until, std::vector<InputEvent>* applied = nullptr);
+
+/// @brief Zeroes the accumulated mouse deltas, after a step has consumed them.
+void clear_input_deltas(InputState& state);
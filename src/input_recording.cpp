@@ -0,0 +1,227 @@
+#include "input_recording.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+    constexpr size_t HEADER_BYTES = 5 * 4 + 8 + 5 * 4 + 2 * 8;
+
+    class Writer {
+    public:
+        void u8(uint8_t value) { m_bytes.push_back(value); }
+
+        void u32(uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                u8((uint8_t)(value >> (8 * i)));
+            }
+        }
+
+        void u64(uint64_t value) {
+            u32((uint32_t)value);
+            u32((uint32_t)(value >> 32));
+        }
+
+        void f32(float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            u32(bits);
+        }
+
+        void f64(double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            u64(bits);
+        }
+
+        void varint(uint64_t value) {
+            for (; value >= 0x80; value >>= 7) {
+                u8((uint8_t)(value | 0x80));
+            }
+            u8((uint8_t)value);
+        }
+
+        const std::vector<uint8_t>& bytes() const { return m_bytes; }
+
+    private:
+        std::vector<uint8_t> m_bytes;
+    };
+
+    // Every read past the end yields zero and clears ok, so a truncated file is caught once at the end
+    class Reader {
+    public:
+        Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+        uint8_t u8() {
+            if (m_offset >= m_size) {
+                m_ok = false;
+                return 0;
+            }
+            return m_data[m_offset++];
+        }
+
+        uint32_t u32() {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= (uint32_t)u8() << (8 * i);
+            }
+            return value;
+        }
+
+        uint64_t u64() {
+            const uint64_t low = u32();
+            return low | ((uint64_t)u32() << 32);
+        }
+
+        float f32() {
+            const uint32_t bits = u32();
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        double f64() {
+            const uint64_t bits = u64();
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                const uint8_t byte = u8();
+                value |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            m_ok = false;
+            return 0;
+        }
+
+        bool ok() const { return m_ok; }
+        size_t remaining() const { return m_size - m_offset; }
+
+    private:
+        const uint8_t* m_data;
+        size_t m_size;
+        size_t m_offset = 0;
+        bool m_ok = true;
+    };
+
+    // Key codes are small and GLFW_KEY_UNKNOWN is -1; zigzag keeps both to one or two bytes
+    uint64_t zigzag(int value) {
+        return ((uint64_t)(uint32_t)value << 1) ^ (uint64_t)(int64_t)(value >> 31);
+    }
+
+    int unzigzag(uint64_t value) {
+        return (int)((uint32_t)(value >> 1) ^ (uint32_t)-(int32_t)(value & 1));
+    }
+
+    bool has_key(InputEventType type) {
+        return type == InputEventType::KeyDown || type == InputEventType::KeyUp;
+    }
+}
+
+bool write_input_recording(const std::string& path, const InputRecording& recording, std::string& error) {
+    Writer out;
+    out.u32(INPUT_RECORDING_MAGIC);
+    out.u32(INPUT_RECORDING_VERSION);
+    out.u32(recording.terrainSeed);
+    out.u32(recording.debrisSeed);
+    out.u32(recording.herdSeed);
+    out.f64(recording.step);
+    for (float value : recording.camera) {
+        out.f32(value);
+    }
+    out.u64(recording.inputs.size());
+    out.u64(recording.frames.size());
+
+    uint64_t tick = 0;
+    for (const RecordedInput& input : recording.inputs) {
+        out.varint(input.tick - tick);
+        tick = input.tick;
+        out.u8((uint8_t)input.event.type);
+        if (has_key(input.event.type)) {
+            out.varint(zigzag(input.event.key));
+        } else if (input.event.type == InputEventType::MouseMove) {
+            out.f64(input.event.x);
+            out.f64(input.event.y);
+        }
+    }
+    tick = 0;
+    for (const RecordedFrame& frame : recording.frames) {
+        out.f32(frame.dt);
+        out.varint(frame.tick - tick);
+        tick = frame.tick;
+        out.f32(frame.alpha);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write((const char*)out.bytes().data(), out.bytes().size())) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool read_input_recording(const std::string& path, InputRecording& recording, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader in(bytes.data(), bytes.size());
+    if (bytes.size() < HEADER_BYTES || in.u32() != INPUT_RECORDING_MAGIC || in.u32() != INPUT_RECORDING_VERSION) {
+        error = path + " is not an input recording of this version";
+        return false;
+    }
+    recording.terrainSeed = in.u32();
+    recording.debrisSeed = in.u32();
+    recording.herdSeed = in.u32();
+    recording.step = in.f64();
+    for (float& value : recording.camera) {
+        value = in.f32();
+    }
+    const uint64_t inputCount = in.u64();
+    const uint64_t frameCount = in.u64();
+    // Every input takes at least two bytes and every frame nine, which bounds the counts before reserving
+    if (inputCount > in.remaining() / 2 || frameCount > in.remaining() / 9) {
+        error = path + " is truncated";
+        return false;
+    }
+
+    recording.inputs.resize(inputCount);
+    uint64_t tick = 0;
+    for (RecordedInput& input : recording.inputs) {
+        tick += in.varint();
+        input.tick = tick;
+        input.event = InputEvent();
+        input.event.type = (InputEventType)in.u8();
+        if (has_key(input.event.type)) {
+            input.event.key = unzigzag(in.varint());
+        } else if (input.event.type == InputEventType::MouseMove) {
+            input.event.x = in.f64();
+            input.event.y = in.f64();
+        } else if (input.event.type != InputEventType::CursorLock &&
+                   input.event.type != InputEventType::CursorRelease) {
+            error = path + " holds an unknown event";
+            return false;
+        }
+    }
+    recording.frames.resize(frameCount);
+    tick = 0;
+    for (RecordedFrame& frame : recording.frames) {
+        frame.dt = in.f32();
+        tick += in.varint();
+        frame.tick = tick;
+        frame.alpha = in.f32();
+    }
+    if (!in.ok()) {
+        error = path + " is truncated";
+        return false;
+    }
+    return true;
+}
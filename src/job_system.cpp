@@ -0,0 +1,206 @@
+#include "job_system.hpp"
+
+#include <random>
+
+#ifdef __APPLE__
+#include <pthread.h>
+#include <sys/qos.h>
+#include <sys/sysctl.h>
+#endif
+
+namespace {
+    // Index of the calling thread's deque in the job system that owns it
+    thread_local const JobSystem* t_owner = nullptr;
+    thread_local int t_deque = -1;
+
+    // Returns 0 where the count is unknown
+    uint32_t cpu_count(const char* name) {
+#ifdef __APPLE__
+        int value = 0;
+        size_t size = sizeof(value);
+        if (sysctlbyname(name, &value, &size, nullptr, 0) == 0 && value > 0) {
+            return (uint32_t)value;
+        }
+#else
+        (void)name;
+#endif
+        return 0;
+    }
+
+    // Performance cores are perflevel0 on Apple silicon; elsewhere half the cores stand in
+    uint32_t performance_cores() {
+        uint32_t count = cpu_count("hw.perflevel0.logicalcpu");
+        return count ? count : std::max(std::thread::hardware_concurrency() / 2, 1u);
+    }
+
+    uint32_t efficiency_cores() {
+        return cpu_count("hw.perflevel1.logicalcpu");
+    }
+
+    void set_thread_qos(JobPriority priority) {
+#ifdef __APPLE__
+        // Named for the CPU sampler's stacks and for debuggers
+        pthread_setname_np(priority == JobPriority::Frame ? "Frame jobs" : "Background jobs");
+        // The scheduler places user-interactive threads on P cores and utility threads on E cores
+        pthread_set_qos_class_self_np(priority == JobPriority::Frame ? QOS_CLASS_USER_INTERACTIVE : QOS_CLASS_UTILITY, 0);
+#else
+        (void)priority;
+#endif
+    }
+}
+
+JobSystem::JobSystem(const JobSystemConfig& config) {
+    uint32_t frameWorkers = config.frameWorkers ? config.frameWorkers : std::max(performance_cores(), 2u) - 1;
+    uint32_t backgroundWorkers = config.backgroundWorkers ? config.backgroundWorkers : std::max(efficiency_cores(), 1u);
+
+    for (uint32_t i = 0; i <= frameWorkers; ++i) {
+        m_deques.push_back(std::make_unique<Deque>());
+    }
+    for (uint32_t i = 0; i < frameWorkers; ++i) {
+        m_frameThreads.emplace_back(&JobSystem::frame_worker_main, this, i);
+    }
+    for (uint32_t i = 0; i < backgroundWorkers; ++i) {
+        m_backgroundThreads.emplace_back(&JobSystem::background_worker_main, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> sleepLock(m_sleepMutex);
+        std::lock_guard<std::mutex> backgroundLock(m_backgroundMutex);
+        m_stopping = true;
+    }
+    m_frameWake.notify_all();
+    m_backgroundWake.notify_all();
+    for (auto& thread : m_frameThreads) {
+        thread.join();
+    }
+    for (auto& thread : m_backgroundThreads) {
+        thread.join();
+    }
+}
+
+void JobSystem::run(std::function<void()> job, JobCounter* counter, JobPriority priority) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (priority == JobPriority::Background) {
+        {
+            std::lock_guard<std::mutex> lock(m_backgroundMutex);
+            m_background.push_back({ std::move(job), counter });
+        }
+        m_backgroundWake.notify_one();
+        return;
+    }
+
+    // Frame threads keep what they spawn; everyone else uses the injection deque
+    int target = t_owner == this && t_deque >= 0 ? t_deque : (int)m_deques.size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(m_deques[target]->mutex);
+        m_deques[target]->jobs.push_back({ std::move(job), counter });
+    }
+    m_frameQueued.fetch_add(1, std::memory_order_release);
+    {
+        // Taking the lock orders this against a worker that just found nothing and is about to sleep
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_frameWake.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    const int self = t_owner == this ? t_deque : -1;
+    while (!counter.done()) {
+        if (!try_run_frame_job(self)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+uint32_t JobSystem::worker_count(JobPriority priority) const {
+    return (uint32_t)(priority == JobPriority::Frame ? m_frameThreads.size() : m_backgroundThreads.size());
+}
+
+uint32_t JobSystem::thread_index() const {
+    return t_owner == this ? (uint32_t)t_deque + 1 : 0;
+}
+
+void JobSystem::frame_worker_main(uint32_t index) {
+    t_owner = this;
+    t_deque = (int)index;
+    set_thread_qos(JobPriority::Frame);
+
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        if (try_run_frame_job(t_deque)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_frameWake.wait(lock, [&] {
+            return m_stopping.load(std::memory_order_acquire) || m_frameQueued.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+void JobSystem::background_worker_main() {
+    set_thread_qos(JobPriority::Background);
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_backgroundMutex);
+            m_backgroundWake.wait(lock, [&] { return m_stopping || !m_background.empty(); });
+            if (m_stopping) return;
+            job = std::move(m_background.front());
+            m_background.pop_front();
+        }
+        execute(job);
+    }
+}
+
+bool JobSystem::try_run_frame_job(int self) {
+    Job job;
+    if (!pop_or_steal(self, job)) {
+        return false;
+    }
+    m_frameQueued.fetch_sub(1, std::memory_order_relaxed);
+    execute(job);
+    return true;
+}
+
+bool JobSystem::pop_or_steal(int self, Job& job) {
+    if (self >= 0) {
+        Deque& own = *m_deques[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // Start at a random victim so thieves spread out instead of all hitting deque 0
+    thread_local std::minstd_rand rng(std::random_device{}());
+    const size_t count = m_deques.size();
+    const size_t start = rng() % count;
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if ((int)victim == self) {
+            continue;
+        }
+        Deque& other = *m_deques[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.jobs.empty()) {
+            job = std::move(other.jobs.front());
+            other.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Job& job) {
+    job.fn();
+    if (job.counter) {
+        job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
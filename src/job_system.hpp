@@ -0,0 +1,138 @@
+/**
+ * @file job_system.hpp
+ * @brief Work-stealing job scheduler with counters, shared by every engine subsystem.
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @enum JobPriority
+ * @brief Which pool runs a job.
+ */
+enum class JobPriority {
+    Frame,      ///< Work the current frame waits for; user-interactive threads, i.e. performance cores.
+    Background, ///< Streaming and other latency-tolerant work; utility threads, i.e. efficiency cores.
+};
+
+/**
+ * @struct JobCounter
+ * @brief Counts unfinished jobs; a job that depends on others waits for their counter.
+ */
+struct JobCounter {
+    std::atomic<uint32_t> pending{ 0 };  ///< Jobs started with this counter that have not finished.
+
+    /// @return True once every job started with this counter has finished.
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/**
+ * @struct JobSystemConfig
+ * @brief Thread counts; zero picks a count from the CPU topology.
+ */
+struct JobSystemConfig {
+    uint32_t frameWorkers = 0;          ///< Frame threads besides the caller; defaults to performance cores - 1.
+    uint32_t backgroundWorkers = 0;     ///< Background threads; defaults to the efficiency core count, at least 1.
+};
+
+/**
+ * @class JobSystem
+ * @brief Runs jobs on a pool of frame threads with per-thread deques and a background pool.
+ *
+ * A frame thread pushes the jobs it spawns onto its own deque and pops them LIFO, which
+ * keeps nested work hot in its cache; idle threads steal FIFO from the other end of a
+ * random victim's deque. Jobs submitted from outside the pool go to a shared injection
+ * deque every frame thread steals from. wait() executes frame jobs until the counter
+ * drains, so the waiting thread, usually the render thread, works rather than sleeps.
+ * Background jobs go to a plain FIFO served by lower-QoS threads that never take frame work.
+ */
+class JobSystem {
+public:
+    explicit JobSystem(const JobSystemConfig& config = {});
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /**
+     * @brief Schedules a job. Safe to call from any thread, including from inside a job.
+     * @param job The work to run.
+     * @param counter Incremented now and decremented when the job finishes; may be null.
+     * @param priority The pool to run on.
+     */
+    void run(std::function<void()> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::Frame);
+
+    /**
+     * @brief Returns once every job of a counter has finished, running frame jobs meanwhile.
+     * @param counter The counter to wait for.
+     */
+    void wait(JobCounter& counter);
+
+    /**
+     * @brief Calls fn(begin, end) over [0, count) in slices of at least grain items and waits.
+     * @param count The number of items.
+     * @param grain The fewest items per job.
+     * @param fn The body, called concurrently for disjoint ranges.
+     */
+    template <typename Fn>
+    void parallel_for(uint32_t count, uint32_t grain, Fn fn) {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max(grain, 1u);
+        JobCounter counter;
+        for (uint32_t begin = grain; begin < count; begin += grain) {
+            uint32_t end = std::min(begin + grain, count);
+            run([&fn, begin, end] { fn(begin, end); }, &counter);
+        }
+        // The caller takes the first slice itself
+        fn(0, std::min(grain, count));
+        wait(counter);
+    }
+
+    /// @return The number of threads serving a pool, not counting waiting callers.
+    uint32_t worker_count(JobPriority priority) const;
+
+    /// @return 1 + the index of the calling frame worker of this system; 0 on any other thread.
+    uint32_t thread_index() const;
+
+private:
+    struct Job {
+        std::function<void()> fn;
+        JobCounter* counter;
+    };
+
+    struct Deque {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void frame_worker_main(uint32_t index);
+    void background_worker_main();
+    bool try_run_frame_job(int self);
+    bool pop_or_steal(int self, Job& job);
+    static void execute(Job& job);
+
+    std::vector<std::unique_ptr<Deque>> m_deques;   ///< One per frame thread, then the injection deque.
+    std::vector<std::thread> m_frameThreads;
+    std::vector<std::thread> m_backgroundThreads;
+    std::atomic<uint32_t> m_frameQueued{ 0 };        ///< Frame jobs sitting in deques.
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_frameWake;
+
+    std::mutex m_backgroundMutex;
+    std::condition_variable m_backgroundWake;
+    std::deque<Job> m_background;                   ///< Guarded by m_backgroundMutex.
+
+    std::atomic<bool> m_stopping{ false };
+};
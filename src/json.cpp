@@ -0,0 +1,130 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    struct JsonParser {
+        const std::string& text;
+        size_t pos = 0;
+        std::string error;
+
+        void skip_whitespace() {
+            while (pos < text.size() &&
+                   (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+                ++pos;
+            }
+        }
+
+        bool fail(const std::string& message) {
+            if (error.empty()) {
+                error = message + " at offset " + std::to_string(pos);
+            }
+            return false;
+        }
+
+        bool expect(char c) {
+            skip_whitespace();
+            if (pos >= text.size() || text[pos] != c) {
+                return fail(std::string("expected '") + c + "'");
+            }
+            ++pos;
+            return true;
+        }
+
+        bool parse_string(std::string& out) {
+            if (!expect('"')) return false;
+            while (pos < text.size() && text[pos] != '"') {
+                if (text[pos] == '\\' && pos + 1 < text.size()) ++pos;
+                out += text[pos++];
+            }
+            return expect('"');
+        }
+
+        bool parse_value(JsonValue& value) {
+            skip_whitespace();
+            if (pos >= text.size()) return fail("unexpected end of input");
+
+            char c = text[pos];
+            if (c == '{') {
+                value.type = JsonValue::OBJECT;
+                ++pos;
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == '}') { ++pos; return true; }
+                for (;;) {
+                    std::string key;
+                    if (!parse_string(key) || !expect(':') || !parse_value(value.object[key])) return false;
+                    skip_whitespace();
+                    if (pos >= text.size() || text[pos] != ',') break;
+                    ++pos;
+                }
+                return expect('}');
+            }
+            if (c == '[') {
+                value.type = JsonValue::ARRAY;
+                ++pos;
+                skip_whitespace();
+                if (pos < text.size() && text[pos] == ']') { ++pos; return true; }
+                for (;;) {
+                    value.array.emplace_back();
+                    if (!parse_value(value.array.back())) return false;
+                    skip_whitespace();
+                    if (pos >= text.size() || text[pos] != ',') break;
+                    ++pos;
+                }
+                return expect(']');
+            }
+            if (c == '"') {
+                value.type = JsonValue::STRING;
+                return parse_string(value.string);
+            }
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                char* end = nullptr;
+                value.type = JsonValue::NUMBER;
+                value.number = strtod(text.c_str() + pos, &end);
+                pos = end - text.c_str();
+                return true;
+            }
+            for (const char* literal : { "true", "false", "null" }) {
+                size_t length = strlen(literal);
+                if (text.compare(pos, length, literal) == 0) {
+                    value.type = JsonValue::LITERAL;
+                    value.string = literal;
+                    pos += length;
+                    return true;
+                }
+            }
+            return fail("unexpected character");
+        }
+    };
+}
+
+const JsonValue* JsonValue::find(const std::string& key) const {
+    if (type != OBJECT) {
+        return nullptr;
+    }
+    auto it = object.find(key);
+    return it == object.end() ? nullptr : &it->second;
+}
+
+bool parse_json(const std::string& text, JsonValue& value, std::string& error) {
+    JsonParser parser{text};
+    if (!parser.parse_value(value)) {
+        error = parser.error;
+        return false;
+    }
+    return true;
+}
+
+bool load_json(const char* filename, JsonValue& value, std::string& error) {
+    std::ifstream file(filename);
+    if (!file) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return parse_json(text.str(), value, error);
+}
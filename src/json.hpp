@@ -0,0 +1,46 @@
+/**
+ * @file json.hpp
+ * @brief A small JSON reader for the files the tools exchange: camera paths and benchmark reports.
+ */
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @struct JsonValue
+ * @brief A parsed JSON value; true, false and null are kept as LITERAL with their text in string.
+ */
+struct JsonValue {
+    enum Type { NUMBER, STRING, ARRAY, OBJECT, LITERAL } type = LITERAL;
+    double number = 0.0;                        ///< The value of a NUMBER.
+    std::string string;                         ///< The text of a STRING or LITERAL.
+    std::vector<JsonValue> array;               ///< The elements of an ARRAY.
+    std::map<std::string, JsonValue> object;    ///< The members of an OBJECT.
+
+    /// @return The member named key, or nullptr if this is not an object or has no such member.
+    const JsonValue* find(const std::string& key) const;
+};
+
+/**
+ * @brief Parses a JSON document.
+ *
+ * Just enough JSON for the repo's own files: escapes in strings keep the escaped character
+ * as is, and nothing after the first value is looked at.
+ *
+ * @param text The document.
+ * @param value Receives the root value.
+ * @param error Receives a description of the problem and its offset on failure.
+ * @return True on success.
+ */
+bool parse_json(const std::string& text, JsonValue& value, std::string& error);
+
+/**
+ * @brief Reads and parses a JSON file.
+ * @param filename The file to read.
+ * @param value Receives the root value.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool load_json(const char* filename, JsonValue& value, std::string& error);
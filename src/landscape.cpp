@@ -1,111 +1,347 @@
 
 #include "landscape.hpp"
 #include "camera.hpp"
-#include <cstdlib>
-#include <ctime>
+#include "frustum.hpp"
+#include "job_system.hpp"
+#include "noise.hpp"
+#include "trace.hpp"
+#include "vertex_cache.hpp"
+#include <algorithm>
 #include <cmath>
 
-// --- Noise functions ---
 namespace {
-    const int LANDSCAPE_WIDTH = 50;
-    const int LANDSCAPE_DEPTH = 50;
-    const float TERRAIN_SCALE = 5.0f;
-    const float TERRAIN_HEIGHT = 12.0f;
+    // Two triangles per cell of a width x depth vertex grid, in either index width. Cells are
+    // walked in vertical stripes narrow enough that a stripe row's vertices are still cached
+    // when the next row reuses them
+    // Writes stripes [firstStripe, lastStripe); stripe s starts at index s * stripe_index_count(depth)
+    template <typename Index>
+    void write_grid_stripes(int width, int depth, int firstStripe, int lastStripe, Index* indices) {
+        indices += (size_t)firstStripe * GRID_STRIPE_WIDTH * (depth - 1) * 6;
+        for (int stripe = firstStripe * GRID_STRIPE_WIDTH; stripe < std::min(lastStripe * GRID_STRIPE_WIDTH, width - 1);
+             stripe += GRID_STRIPE_WIDTH) {
+            const int stripeEnd = std::min(stripe + GRID_STRIPE_WIDTH, width - 1);
+            for (int z = 0; z < depth - 1; ++z) {
+                for (int x = stripe; x < stripeEnd; ++x) {
+                    Index i0 = z * width + x;
+                    Index i1 = z * width + x + 1;
+                    Index i2 = (z + 1) * width + x;
+                    Index i3 = (z + 1) * width + x + 1;
+
+                    *indices++ = i0;
+                    *indices++ = i2;
+                    *indices++ = i1;
+
+                    *indices++ = i1;
+                    *indices++ = i2;
+                    *indices++ = i3;
+                }
+            }
+        }
+    }
+
+    int grid_stripe_count(int width) {
+        return (width - 1 + GRID_STRIPE_WIDTH - 1) / GRID_STRIPE_WIDTH;
+    }
+
+    template <typename Index>
+    void write_grid_indices(int width, int depth, Index* indices) {
+        write_grid_stripes(width, depth, 0, grid_stripe_count(width), indices);
+    }
+
+    // Writes the vertices of grid points [x0, x1) x [z0, z1), at most LANDSCAPE_TILE_SIZE on a
+    // side. Heights for the tile and a one-sample apron around it are evaluated as one noise
+    // grid, which hashes each lattice corner under the tile once per octave, into a block of
+    // about 17 KB, then every vertex takes its height and a central-difference normal from the
+    // block while it is still in L1; full rows of a wide grid would have pushed the rows above
+    // and below out of cache before the normals read them. The apron samples the terrain itself,
+    // so edge normals match whatever is built next to the grid, and any split into tiles writes
+    // the same vertices. The mapping matches get_terrain_heights(), so the mesh samples the same
+    // terrain
+    void build_landscape_tile(int width, int depth, int x0, int z0, int x1, int z1, Vertex* vertices,
+                              const TerrainNoiseMapping& mapping) {
+        constexpr int APRON_SIZE = LANDSCAPE_TILE_SIZE + 2;
+        float noiseX[APRON_SIZE], noiseZ[APRON_SIZE], heights[APRON_SIZE * APRON_SIZE];
+        const int apronWidth = x1 - x0 + 2;
+        for (int x = x0 - 1; x <= x1; ++x) {
+            noiseX[x - x0 + 1] = ((float)x - width/2.0f + mapping.offset) * mapping.scale;
+        }
+        const int apronDepth = z1 - z0 + 2;
+        for (int z = z0 - 1; z <= z1; ++z) {
+            noiseZ[z - z0 + 1] = ((float)z - depth/2.0f + mapping.offset) * mapping.scale;
+        }
+        fractal_noise_grid(noiseX, apronWidth, noiseZ, apronDepth, heights, mapping.noise);
+        for (int i = 0; i < apronWidth * apronDepth; ++i) {
+            heights[i] *= mapping.heightScale;
+        }
+
+        for (int z = z0; z < z1; ++z) {
+            // Row z's sample x is at current[x - x0], for x in [x0 - 1, x1]
+            const float* down = heights + (z - z0) * apronWidth + 1;
+            const float* current = down + apronWidth;
+            const float* up = current + apronWidth;
+            Vertex* out = vertices + (size_t)z * width;
+            for (int x = x0; x < x1; ++x) {
+                const int i = x - x0;
+                simd::float3 normal =
+                    simd::normalize(simd::float3{current[i - 1] - current[i + 1], 2.0f, down[i] - up[i]});
+                out[x] = {{ (float)x - width/2.0f, current[i], (float)z - depth/2.0f }, normal};
+            }
+        }
+    }
+
+    int landscape_tile_count(int size) {
+        return (size + LANDSCAPE_TILE_SIZE - 1) / LANDSCAPE_TILE_SIZE;
+    }
+
+    // Builds tiles [firstTile, lastTile) in row-major order of the tile grid
+    void build_landscape_tiles(int width, int depth, uint32_t firstTile, uint32_t lastTile, Vertex* vertices,
+                               const TerrainNoiseMapping& mapping) {
+        const uint32_t tilesX = (uint32_t)landscape_tile_count(width);
+        for (uint32_t tile = firstTile; tile < lastTile; ++tile) {
+            const int x0 = (int)(tile % tilesX) * LANDSCAPE_TILE_SIZE;
+            const int z0 = (int)(tile / tilesX) * LANDSCAPE_TILE_SIZE;
+            build_landscape_tile(width, depth, x0, z0, std::min(x0 + LANDSCAPE_TILE_SIZE, width),
+                                 std::min(z0 + LANDSCAPE_TILE_SIZE, depth), vertices, mapping);
+        }
+    }
+
+    template <typename Index>
+    void build_landscape_parallel(int width, int depth, Vertex* vertices, Index* indices, JobSystem& jobs,
+                                  const TerrainParams& params) {
+        const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+        const uint32_t tileCount = (uint32_t)(landscape_tile_count(width) * landscape_tile_count(depth));
+        jobs.parallel_for(tileCount, 1, [&](uint32_t begin, uint32_t end) {
+            build_landscape_tiles(width, depth, begin, end, vertices, mapping);
+        });
+        // Index stripes are disjoint ranges of the index array, so they fill in parallel too
+        const uint32_t stripesPerJob =
+            std::max(LANDSCAPE_BAND_ROWS * GRID_STRIPE_WIDTH / (uint32_t)std::max(depth - 1, 1), 1u);
+        jobs.parallel_for((uint32_t)grid_stripe_count(width), stripesPerJob, [&](uint32_t begin, uint32_t end) {
+            write_grid_stripes(width, depth, (int)begin, (int)end, indices);
+        });
+    }
 }
 
-float simple_noise(int x, int z) {
-    int n = x + z * 57;
-    n = (n << 13) ^ n;
-    return (1.0f - ((n * (n * n * 15731 + 789221) + 1376312589) & 0x7fffffff) / 1073741824.0f);
+MeshSize landscape_mesh_size(int width, int depth) {
+    return { (size_t)width * depth, (size_t)(width - 1) * (depth - 1) * 6 };
 }
 
-float cosine_interpolate(float a, float b, float blend) {
-    float ft = blend * 3.1415927f;
-    float f = (1.0f - cosf(ft)) * 0.5f;
-    return a * (1.0f - f) + b * f;
+void build_landscape(int width, int depth, Vertex* vertices, uint32_t* indices, const TerrainParams& params) {
+    build_landscape_vertices(width, depth, vertices, params);
+    write_grid_indices(width, depth, indices);
 }
 
-float smoothed_noise(float x, float z) {
-    int int_x = static_cast<int>(floorf(x));
-    int int_z = static_cast<int>(floorf(z));
-    float frac_x = x - int_x;
-    float frac_z = z - int_z;
+void build_landscape(int width, int depth, Vertex* vertices, uint16_t* indices, const TerrainParams& params) {
+    build_landscape_vertices(width, depth, vertices, params);
+    write_grid_indices(width, depth, indices);
+}
 
-    float v1 = simple_noise(int_x, int_z);
-    float v2 = simple_noise(int_x + 1, int_z);
-    float v3 = simple_noise(int_x, int_z + 1);
-    float v4 = simple_noise(int_x + 1, int_z + 1);
+void build_landscape(int width, int depth, Vertex* vertices, uint32_t* indices, JobSystem& jobs,
+                     const TerrainParams& params) {
+    build_landscape_parallel(width, depth, vertices, indices, jobs, params);
+}
 
-    float i1 = cosine_interpolate(v1, v2, frac_x);
-    float i2 = cosine_interpolate(v3, v4, frac_x);
+void build_landscape(int width, int depth, Vertex* vertices, uint16_t* indices, JobSystem& jobs,
+                     const TerrainParams& params) {
+    build_landscape_parallel(width, depth, vertices, indices, jobs, params);
+}
 
-    return cosine_interpolate(i1, i2, frac_z);
+void build_landscape_vertices(int width, int depth, Vertex* vertices, const TerrainParams& params) {
+    const uint32_t tileCount = (uint32_t)(landscape_tile_count(width) * landscape_tile_count(depth));
+    build_landscape_tiles(width, depth, 0, tileCount, vertices, terrain_noise_mapping(params));
 }
 
-float fractal_noise(float x, float z) {
-    float total = 0;
-    float frequency = 1.0f;
-    float amplitude = 1.0f;
-    float persistence = 0.45f;
-    int octaves = 5;
+MeshData create_landscape(int width, int depth, const TerrainParams& params) {
+    TRACE_SCOPE("Create landscape");
+    MeshData landscape;
 
-    for(int i = 0; i < octaves; i++) {
-        total += smoothed_noise(x * frequency, z * frequency) * amplitude;
-        amplitude *= persistence;
-        frequency *= 2.0f;
+    MeshSize size = landscape_mesh_size(width, depth);
+    landscape.vertices.resize(size.vertexCount);
+    landscape.indices.resize(size.indexCount, size.vertexCount);
+    if (landscape.indices.format == IndexFormat::UInt16) {
+        build_landscape(width, depth, landscape.vertices.data(), landscape.indices.indices16.data(), params);
+    } else {
+        build_landscape(width, depth, landscape.vertices.data(), landscape.indices.indices32.data(), params);
     }
-    return total;
+
+    landscape.bounds = compute_bounds(landscape.vertices.data(), landscape.vertices.size());
+
+    return landscape;
 }
 
-GameObject create_landscape(int width, int depth) {
-    GameObject landscape;
+MeshData create_landscape(int width, int depth, JobSystem& jobs, const TerrainParams& params) {
+    TRACE_SCOPE("Create landscape");
+    MeshData landscape;
+
+    MeshSize size = landscape_mesh_size(width, depth);
+    landscape.vertices.resize(size.vertexCount);
+    landscape.indices.resize(size.indexCount, size.vertexCount);
+    if (landscape.indices.format == IndexFormat::UInt16) {
+        build_landscape(width, depth, landscape.vertices.data(), landscape.indices.indices16.data(), jobs, params);
+    } else {
+        build_landscape(width, depth, landscape.vertices.data(), landscape.indices.indices32.data(), jobs, params);
+    }
 
-    for (int z = 0; z < depth; ++z) {
-        for (int x = 0; x < width; ++x) {
-            float y = fractal_noise(((float)x / (float)width) * TERRAIN_SCALE, ((float)z / (float)depth) * TERRAIN_SCALE) * TERRAIN_HEIGHT;
-            landscape.vertices.push_back({{ (float)x - width/2.0f, y, (float)z - depth/2.0f }, {0.0f, 1.0f, 0.0f}});
+    // Min and max do not depend on the order boxes are merged in, so the bands merge to the serial bounds
+    const uint32_t bandCount = ((uint32_t)depth + LANDSCAPE_BAND_ROWS - 1) / LANDSCAPE_BAND_ROWS;
+    std::vector<BoundingBox> bands(bandCount);
+    jobs.parallel_for(bandCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t band = begin; band < end; ++band) {
+            const size_t first = (size_t)band * LANDSCAPE_BAND_ROWS * width;
+            const size_t count = std::min((size_t)LANDSCAPE_BAND_ROWS * width, landscape.vertices.size() - first);
+            bands[band] = compute_bounds(landscape.vertices.data() + first, count);
         }
+    });
+    landscape.bounds = bands[0];
+    for (uint32_t band = 1; band < bandCount; ++band) {
+        landscape.bounds = merge_bounds(landscape.bounds, bands[band]);
     }
 
-    // Calculate normals
-    for (int z = 0; z < depth; ++z) {
-        for (int x = 0; x < width; ++x) {
-            float heightL = landscape.vertices[z * width + (x > 0 ? x - 1 : x)].position.y;
-            float heightR = landscape.vertices[z * width + (x < width - 1 ? x + 1 : x)].position.y;
-            float heightD = landscape.vertices[(z > 0 ? z - 1 : z) * width + x].position.y;
-            float heightU = landscape.vertices[(z < depth - 1 ? z + 1 : z) * width + x].position.y;
+    return landscape;
+}
 
-            simd::float3 normal = simd::normalize(simd::float3{heightL - heightR, 2.0f, heightD - heightU});
-            landscape.vertices[z * width + x].normal = normal;
-        }
+MeshSize terrain_chunk_mesh_size(int resolution) {
+    return { (size_t)resolution * resolution, (size_t)(resolution - 1) * (resolution - 1) * 6 };
+}
+
+void build_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices, uint32_t* indices,
+                         const TerrainParams& params) {
+    build_terrain_chunk_vertices(chunkX, chunkZ, resolution, chunkSize, vertices, params);
+    if (indices) {
+        write_grid_indices(resolution, resolution, indices);
     }
+}
 
-    for (int z = 0; z < depth - 1; ++z) {
-        for (int x = 0; x < width - 1; ++x) {
-            int i0 = z * width + x;
-            int i1 = z * width + x + 1;
-            int i2 = (z + 1) * width + x;
-            int i3 = (z + 1) * width + x + 1;
+void build_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices, uint16_t* indices,
+                         const TerrainParams& params) {
+    build_terrain_chunk_vertices(chunkX, chunkZ, resolution, chunkSize, vertices, params);
+    if (indices) {
+        write_grid_indices(resolution, resolution, indices);
+    }
+}
 
-            landscape.indices.push_back(i0);
-            landscape.indices.push_back(i2);
-            landscape.indices.push_back(i1);
+void build_terrain_chunk_vertices(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices,
+                                  const TerrainParams& params) {
+    // Heights are sampled with a one-cell apron so border normals match the neighbouring chunk
+    const int apronWidth = resolution + 2;
+    const float step = chunkSize / (float)(resolution - 1);
+    const float originX = chunkX * chunkSize;
+    const float originZ = chunkZ * chunkSize;
 
-            landscape.indices.push_back(i1);
-            landscape.indices.push_back(i2);
-            landscape.indices.push_back(i3);
+    std::vector<float> sampleX(apronWidth * apronWidth), sampleZ(apronWidth * apronWidth);
+    for (int z = 0; z < apronWidth; ++z) {
+        for (int x = 0; x < apronWidth; ++x) {
+            sampleX[z * apronWidth + x] = originX + (x - 1) * step;
+            sampleZ[z * apronWidth + x] = originZ + (z - 1) * step;
         }
     }
+    std::vector<float> heights(apronWidth * apronWidth);
+    get_terrain_heights(sampleX.data(), sampleZ.data(), heights.data(), heights.size(), params);
 
-    landscape.modelMatrix = matrix_translation(0, 0, 0);
-    landscape.color = {0.3f, 0.6f, 0.2f};
+    for (int z = 0; z < resolution; ++z) {
+        for (int x = 0; x < resolution; ++x) {
+            int a = (z + 1) * apronWidth + (x + 1);
+            float heightL = heights[a - 1];
+            float heightR = heights[a + 1];
+            float heightD = heights[a - apronWidth];
+            float heightU = heights[a + apronWidth];
 
-    return landscape;
+            simd::float3 normal = simd::normalize(simd::float3{(heightL - heightR) / step, 2.0f, (heightD - heightU) / step});
+            *vertices++ = {{ originX + x * step, heights[a], originZ + z * step }, normal};
+        }
+    }
 }
 
-float get_terrain_height(float x, float z) {
-    float noise_x = (x + LANDSCAPE_WIDTH / 2.0f) / (float)LANDSCAPE_WIDTH * TERRAIN_SCALE;
-    float noise_z = (z + LANDSCAPE_DEPTH / 2.0f) / (float)LANDSCAPE_DEPTH * TERRAIN_SCALE;
-    return fractal_noise(noise_x, noise_z) * TERRAIN_HEIGHT;
+MeshData create_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize, const TerrainParams& params) {
+    MeshData chunk;
+
+    MeshSize size = terrain_chunk_mesh_size(resolution);
+    chunk.vertices.resize(size.vertexCount);
+    chunk.indices.resize(size.indexCount, size.vertexCount);
+    if (chunk.indices.format == IndexFormat::UInt16) {
+        build_terrain_chunk(chunkX, chunkZ, resolution, chunkSize, chunk.vertices.data(), chunk.indices.indices16.data(),
+                            params);
+    } else {
+        build_terrain_chunk(chunkX, chunkZ, resolution, chunkSize, chunk.vertices.data(), chunk.indices.indices32.data(),
+                            params);
+    }
+
+    chunk.bounds = compute_bounds(chunk.vertices.data(), chunk.vertices.size());
+
+    return chunk;
+}
+
+TerrainNoiseMapping terrain_noise_mapping(const TerrainParams& params) {
+    return { params.worldSize / 2.0f, params.noiseSize / params.worldSize, params.height, params.noise };
+}
+
+float get_terrain_height(float x, float z, const TerrainParams& params) {
+    // Same operations as gpu_noise_height in shaders.metal
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    float noise_x = (x + mapping.offset) * mapping.scale;
+    float noise_z = (z + mapping.offset) * mapping.scale;
+    return fractal_noise(noise_x, noise_z, mapping.noise) * mapping.heightScale;
 }
 
+simd::float4 get_terrain_height4(simd::float4 x, simd::float4 z, const TerrainParams& params) {
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    return fractal_noise4((x + mapping.offset) * mapping.scale, (z + mapping.offset) * mapping.scale, mapping.noise) *
+           mapping.heightScale;
+}
+
+simd::float8 get_terrain_height8(simd::float8 x, simd::float8 z, const TerrainParams& params) {
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    return fractal_noise8((x + mapping.offset) * mapping.scale, (z + mapping.offset) * mapping.scale, mapping.noise) *
+           mapping.heightScale;
+}
+
+float terrain_height_bound(const TerrainParams& params) {
+    return fractal_noise_bound(params.noise) * fabsf(params.height);
+}
+
+void get_terrain_heights(const float* xs, const float* zs, float* out, size_t n, const TerrainParams& params) {
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    // Mapped in blocks on the stack, so batched queries in the frame never touch the heap
+    constexpr size_t BLOCK = 256;
+    float noiseX[BLOCK], noiseZ[BLOCK];
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t count = std::min(BLOCK, n - start);
+        for (size_t i = 0; i < count; ++i) {
+            noiseX[i] = (xs[start + i] + mapping.offset) * mapping.scale;
+            noiseZ[i] = (zs[start + i] + mapping.offset) * mapping.scale;
+        }
+        fractal_noise_batch(noiseX, noiseZ, out + start, count, mapping.noise);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        out[i] *= mapping.heightScale;
+    }
+}
+
+TerrainSample get_terrain_sample(float x, float z, const TerrainParams& params) {
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    const NoiseSample noise =
+        fractal_noise_sample((x + mapping.offset) * mapping.scale, (z + mapping.offset) * mapping.scale, mapping.noise);
+    // World to noise scales every derivative by scale, noise to height by heightScale
+    const float slope = mapping.scale * mapping.heightScale;
+    return { noise.value * mapping.heightScale, { noise.dx * slope, noise.dz * slope } };
+}
+
+void get_terrain_samples(const float* xs, const float* zs, TerrainSample* out, size_t n,
+                         const TerrainParams& params) {
+    const TerrainNoiseMapping mapping = terrain_noise_mapping(params);
+    const float slope = mapping.scale * mapping.heightScale;
+    constexpr size_t BLOCK = 256;
+    float noiseX[BLOCK], noiseZ[BLOCK];
+    NoiseSample noise[BLOCK];
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t count = std::min(BLOCK, n - start);
+        for (size_t i = 0; i < count; ++i) {
+            noiseX[i] = (xs[start + i] + mapping.offset) * mapping.scale;
+            noiseZ[i] = (zs[start + i] + mapping.offset) * mapping.scale;
+        }
+        fractal_noise_sample_batch(noiseX, noiseZ, noise, count, mapping.noise);
+        for (size_t i = 0; i < count; ++i) {
+            out[start + i] = { noise[i].value * mapping.heightScale, { noise[i].dx * slope, noise[i].dz * slope } };
+        }
+    }
+}
@@ -1,20 +1,210 @@
 
 #pragma once
 
+#include "noise.hpp"
 #include "objects.hpp"
 
+#include <functional>
+
+class JobSystem;
+
+/// Rows of the landscape grid per job when computing its bounds on the job system.
+constexpr uint32_t LANDSCAPE_BAND_ROWS = 64;
+
+/// Side of the square tiles landscape vertices are built in; a tile's heights stay in L1.
+constexpr int LANDSCAPE_TILE_SIZE = 64;
+
 /**
- * @brief Creates a 3D landscape as a GameObject using fractal noise.
+ * @struct ChunkKey
+ * @brief Integer coordinates of a terrain chunk on the chunk grid.
+ */
+struct ChunkKey {
+    int x = 0; ///< Chunk coordinate along X.
+    int z = 0; ///< Chunk coordinate along Z.
+
+    bool operator==(const ChunkKey& other) const { return x == other.x && z == other.z; }
+};
+
+/**
+ * @brief Hash for ChunkKey so it can be used in unordered containers.
+ */
+struct ChunkKeyHash {
+    size_t operator()(const ChunkKey& key) const {
+        return std::hash<uint64_t>()(((uint64_t)(uint32_t)key.x << 32) | (uint32_t)key.z);
+    }
+};
+
+/**
+ * @struct TerrainParams
+ * @brief Tunables of the terrain generator.
+ *
+ * Every height query, generated mesh and cached tile depends on these, so the same
+ * params must reach all of them; the defaults are the standard terrain.
+ */
+struct TerrainParams {
+    float worldSize = 50.0f;    ///< World extent, centred on the origin, that spans noiseSize noise units.
+    float noiseSize = 5.0f;     ///< Noise units across worldSize; larger values give narrower features.
+    float height = 12.0f;       ///< World height of a noise value of 1.
+    NoiseSettings noise = { 1, NoiseBasis::Value, NoiseInterpolation::Smoothstep, 0.0f, 5, 0.45f }; ///< Field sampled.
+};
+
+/**
+ * @struct TerrainNoiseMapping
+ * @brief Maps world coordinates into noise space: noise = (world + offset) * scale.
+ *
+ * Shared with the GPU generator so both sample the same terrain.
+ */
+struct TerrainNoiseMapping {
+    float offset;       ///< Added to world x/z before scaling.
+    float scale;        ///< World units to noise units.
+    float heightScale;  ///< Noise value to world height.
+    NoiseSettings noise; ///< The fractal noise field sampled.
+};
+
+/**
+ * @brief Returns the world-to-noise mapping used by get_terrain_height.
+ * @param params The terrain generator's tunables.
+ * @return The mapping.
+ */
+TerrainNoiseMapping terrain_noise_mapping(const TerrainParams& params = {});
+
+/**
+ * @brief Returns the vertex and index counts build_landscape writes.
+ * @param width The width of the landscape grid.
+ * @param depth The depth of the landscape grid.
+ * @return The mesh size.
+ */
+MeshSize landscape_mesh_size(int width, int depth);
+
+/**
+ * @brief Builds the landscape mesh into caller-provided storage.
+ *
+ * Heights and normals are computed in one pass over a rolling window of three rows,
+ * so the only allocations are a few rows of scratch regardless of the grid size.
+ * Normals are central differences of the terrain one sample around each vertex, the
+ * edges included, so they do not depend on the grid's extent.
+ *
+ * @param width The width of the landscape grid.
+ * @param depth The depth of the landscape grid.
+ * @param vertices Receives landscape_mesh_size().vertexCount vertices.
+ * @param indices Receives landscape_mesh_size().indexCount indices.
+ * @param params The terrain generator's tunables.
+ */
+void build_landscape(int width, int depth, Vertex* vertices, uint32_t* indices, const TerrainParams& params = {});
+
+/// @copydoc build_landscape(int, int, Vertex*, uint32_t*, const TerrainParams&)
+void build_landscape(int width, int depth, Vertex* vertices, uint16_t* indices, const TerrainParams& params = {});
+
+/**
+ * @brief Builds the landscape mesh on the job system.
+ *
+ * Vertices are built one LANDSCAPE_TILE_SIZE tile per job and indices in groups of stripes,
+ * each job writing its own part of the output, so no job waits on another. The result is
+ * identical to build_landscape() without jobs.
+ *
+ * @param width The width of the landscape grid.
+ * @param depth The depth of the landscape grid.
+ * @param vertices Receives landscape_mesh_size().vertexCount vertices.
+ * @param indices Receives landscape_mesh_size().indexCount indices.
+ * @param jobs The job system; the caller takes part and returns when all is written.
+ * @param params The terrain generator's tunables.
+ */
+void build_landscape(int width, int depth, Vertex* vertices, uint32_t* indices, JobSystem& jobs,
+                     const TerrainParams& params = {});
+
+/// @copydoc build_landscape(int, int, Vertex*, uint32_t*, JobSystem&, const TerrainParams&)
+void build_landscape(int width, int depth, Vertex* vertices, uint16_t* indices, JobSystem& jobs,
+                     const TerrainParams& params = {});
+
+/**
+ * @brief Builds only the vertices of the landscape mesh.
+ * @param width The width of the landscape grid.
+ * @param depth The depth of the landscape grid.
+ * @param vertices Receives landscape_mesh_size().vertexCount vertices.
+ * @param params The terrain generator's tunables.
+ */
+void build_landscape_vertices(int width, int depth, Vertex* vertices, const TerrainParams& params = {});
+
+/**
+ * @brief Creates a 3D landscape mesh using fractal noise.
  *
  * This function generates a mesh representing a terrain with mountains and valleys.
- * The height of the terrain is determined by a fractal noise algorithm, and
- * normals are calculated for proper lighting.
+ * Vertices are one world unit apart and centred on the origin, and their heights are
+ * get_terrain_height() at their positions, whatever the grid size. Normals are
+ * calculated for proper lighting. Triangles are emitted in stripes of
+ * GRID_STRIPE_WIDTH cells for vertex cache reuse.
  *
  * @param width The width of the landscape grid.
  * @param depth The depth of the landscape grid.
- * @return A GameObject representing the generated landscape.
+ * @param params The terrain generator's tunables.
+ * @return The generated landscape mesh.
  */
-GameObject create_landscape(int width, int depth);
+MeshData create_landscape(int width, int depth, const TerrainParams& params = {});
+
+/**
+ * @brief Creates the landscape mesh on the job system; identical to create_landscape() without jobs.
+ * @param width The width of the landscape grid.
+ * @param depth The depth of the landscape grid.
+ * @param jobs The job system.
+ * @param params The terrain generator's tunables.
+ * @return The generated landscape mesh.
+ */
+MeshData create_landscape(int width, int depth, JobSystem& jobs, const TerrainParams& params = {});
+
+/**
+ * @brief Returns the vertex and index counts build_terrain_chunk writes.
+ * @param resolution The number of vertices along each edge.
+ * @return The mesh size.
+ */
+MeshSize terrain_chunk_mesh_size(int resolution);
+
+/**
+ * @brief Builds one terrain chunk into caller-provided storage, such as a shared MTLBuffer.
+ * @param chunkX The chunk coordinate along X.
+ * @param chunkZ The chunk coordinate along Z.
+ * @param resolution The number of vertices along each edge (at least 2).
+ * @param chunkSize The edge length of the chunk in world units.
+ * @param vertices Receives terrain_chunk_mesh_size().vertexCount vertices.
+ * @param indices Receives terrain_chunk_mesh_size().indexCount indices, or nullptr to skip them.
+ * @param params The terrain generator's tunables.
+ */
+void build_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices, uint32_t* indices,
+                         const TerrainParams& params = {});
+
+/// @copydoc build_terrain_chunk(int, int, int, float, Vertex*, uint32_t*, const TerrainParams&)
+void build_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices, uint16_t* indices,
+                         const TerrainParams& params = {});
+
+/**
+ * @brief Builds only the vertices of one terrain chunk, e.g. for chunks drawn with shared LOD indices.
+ * @param chunkX The chunk coordinate along X.
+ * @param chunkZ The chunk coordinate along Z.
+ * @param resolution The number of vertices along each edge (at least 2).
+ * @param chunkSize The edge length of the chunk in world units.
+ * @param vertices Receives terrain_chunk_mesh_size().vertexCount vertices.
+ * @param params The terrain generator's tunables.
+ */
+void build_terrain_chunk_vertices(int chunkX, int chunkZ, int resolution, float chunkSize, Vertex* vertices,
+                                  const TerrainParams& params = {});
+
+/**
+ * @brief Creates one square tile of the infinite terrain in world space.
+ *
+ * Chunk (chunkX, chunkZ) covers [chunkX * chunkSize, (chunkX + 1) * chunkSize] on both
+ * axes, so neighbouring chunks share their border vertices. Normals are computed from
+ * a one-cell apron of extra height samples, which keeps lighting seamless across
+ * chunk borders without the neighbours being loaded. Triangles are emitted in
+ * vertex cache friendly stripes like create_landscape().
+ *
+ * @param chunkX The chunk coordinate along X.
+ * @param chunkZ The chunk coordinate along Z.
+ * @param resolution The number of vertices along each edge (at least 2).
+ * @param chunkSize The edge length of the chunk in world units.
+ * @param params The terrain generator's tunables.
+ * @return A MeshData holding the chunk mesh in world coordinates.
+ */
+MeshData create_terrain_chunk(int chunkX, int chunkZ, int resolution, float chunkSize,
+                              const TerrainParams& params = {});
 
 /**
  * @brief Gets the terrain height at a specific world coordinate.
@@ -25,7 +215,88 @@ GameObject create_landscape(int width, int depth);
  *
  * @param x The x-coordinate in world space.
  * @param z The z-coordinate in world space.
+ * @param params The terrain generator's tunables.
  * @return The height (y-coordinate) of the terrain at the specified (x, z) position.
  */
-float get_terrain_height(float x, float z);
+float get_terrain_height(float x, float z, const TerrainParams& params = {});
+
+/**
+ * @brief Gets the terrain height at four world coordinates held in SIMD lanes.
+ *
+ * For callers with a handful of queries at hand, such as the corners of a footprint, where
+ * gathering them into arrays for get_terrain_heights would cost more than it saves. Lane i
+ * equals get_terrain_height(x[i], z[i], params) bit for bit.
+ *
+ * @param x The x-coordinates in world space.
+ * @param z The z-coordinates in world space.
+ * @param params The terrain generator's tunables.
+ * @return The four heights.
+ */
+simd::float4 get_terrain_height4(simd::float4 x, simd::float4 z, const TerrainParams& params = {});
+
+/// get_terrain_height4 over eight lanes.
+simd::float8 get_terrain_height8(simd::float8 x, simd::float8 z, const TerrainParams& params = {});
+
+/**
+ * @brief Returns the largest magnitude get_terrain_height can produce.
+ * @param params The terrain generator's tunables.
+ * @return The bound in world units; every height lies in [-bound, bound].
+ */
+float terrain_height_bound(const TerrainParams& params = {});
+
+/**
+ * @brief Gets the terrain height at many world coordinates at once.
+ *
+ * Equivalent to calling get_terrain_height for each point, bit for bit, but
+ * evaluates the noise through the SIMD batch kernel.
+ *
+ * @param xs The x-coordinates in world space.
+ * @param zs The z-coordinates in world space.
+ * @param out Receives n heights.
+ * @param n The number of points.
+ * @param params The terrain generator's tunables.
+ */
+void get_terrain_heights(const float* xs, const float* zs, float* out, size_t n, const TerrainParams& params = {});
+
+/**
+ * @struct TerrainSample
+ * @brief The terrain height at a point together with its slope there.
+ */
+struct TerrainSample {
+    float height = 0.0f;                ///< Equal to get_terrain_height at the point.
+    simd::float2 gradient = { 0, 0 };   ///< Height change per world unit along x and z.
+};
+
+/**
+ * @brief Gets the terrain height and its analytic gradient at a world coordinate.
+ *
+ * One evaluation of the noise with its derivatives, where a slope from central
+ * differences takes four more height queries; prefer it wherever normals or
+ * slopes are needed at scattered points.
+ *
+ * @param x The x-coordinate in world space.
+ * @param z The z-coordinate in world space.
+ * @param params The terrain generator's tunables.
+ * @return The sample.
+ */
+TerrainSample get_terrain_sample(float x, float z, const TerrainParams& params = {});
+
+/**
+ * @brief Gets terrain samples at many world coordinates at once.
+ *
+ * Equivalent to calling get_terrain_sample for each point, bit for bit, but
+ * evaluates the noise through the SIMD batch kernel.
+ *
+ * @param xs The x-coordinates in world space.
+ * @param zs The z-coordinates in world space.
+ * @param out Receives n samples.
+ * @param n The number of points.
+ * @param params The terrain generator's tunables.
+ */
+void get_terrain_samples(const float* xs, const float* zs, TerrainSample* out, size_t n,
+                         const TerrainParams& params = {});
 
+/// @return The unit surface normal of a terrain sample.
+inline simd::float3 terrain_sample_normal(const TerrainSample& sample) {
+    return simd::normalize(simd::float3{ -sample.gradient.x, 1.0f, -sample.gradient.y });
+}
@@ -0,0 +1,168 @@
+#include "light_clusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "approx_math.hpp"
+
+namespace {
+    uint32_t emitter_hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    float unit_float(uint32_t h) {
+        return (float)(h >> 8) / 16777216.0f;
+    }
+
+    // View-space x or y of a normalized device coordinate at a view depth, offset included
+    float view_coordinate(float ndc, float depth, float scale, float offset) {
+        return depth * (ndc + offset) / scale;
+    }
+}
+
+LightClusterUniforms light_cluster_uniforms(const simd::float4x4& view, const simd::float4x4& projection,
+                                            uint32_t width, uint32_t height, float nearZ, float farZ,
+                                            uint32_t lightCount) {
+    LightClusterUniforms uniforms;
+    uniforms.view = view;
+    uniforms.projection = { projection.columns[0].x, projection.columns[1].y, projection.columns[2].x,
+                            projection.columns[2].y };
+    uniforms.viewport = { (float)width, (float)height };
+    uniforms.nearZ = nearZ;
+    uniforms.farZ = farZ;
+    uniforms.lightCount = std::min(lightCount, MAX_POINT_LIGHTS);
+    return uniforms;
+}
+
+uint32_t light_cluster_slice(const LightClusterUniforms& uniforms, float viewDepth) {
+    if (viewDepth <= uniforms.nearZ) {
+        return 0;
+    }
+    const float slice = logf(viewDepth / uniforms.nearZ) / logf(uniforms.farZ / uniforms.nearZ) * LIGHT_CLUSTER_Z;
+    return (uint32_t)std::min(slice, (float)LIGHT_CLUSTER_Z);
+}
+
+float light_cluster_slice_depth(const LightClusterUniforms& uniforms, uint32_t slice) {
+    return uniforms.nearZ * powf(uniforms.farZ / uniforms.nearZ, (float)slice / LIGHT_CLUSTER_Z);
+}
+
+uint32_t light_cluster_of(const LightClusterUniforms& uniforms, simd::float2 pixel, float viewDepth) {
+    const uint32_t slice = light_cluster_slice(uniforms, viewDepth);
+    if (slice >= LIGHT_CLUSTER_Z) {
+        return LIGHT_CLUSTER_COUNT;
+    }
+    const uint32_t x = std::min((uint32_t)(pixel.x / uniforms.viewport.x * LIGHT_CLUSTER_X), LIGHT_CLUSTER_X - 1);
+    const uint32_t y = std::min((uint32_t)(pixel.y / uniforms.viewport.y * LIGHT_CLUSTER_Y), LIGHT_CLUSTER_Y - 1);
+    return light_cluster_index(x, y, slice);
+}
+
+LightClusterBox light_cluster_box(const LightClusterUniforms& uniforms, uint32_t x, uint32_t y, uint32_t slice) {
+    // Tile rows count down from the top of the screen, where NDC y is 1
+    const float ndcX[2] = { -1.0f + 2.0f * x / LIGHT_CLUSTER_X, -1.0f + 2.0f * (x + 1) / LIGHT_CLUSTER_X };
+    const float ndcY[2] = { 1.0f - 2.0f * (y + 1) / LIGHT_CLUSTER_Y, 1.0f - 2.0f * y / LIGHT_CLUSTER_Y };
+    const float depths[2] = { light_cluster_slice_depth(uniforms, slice), light_cluster_slice_depth(uniforms, slice + 1) };
+
+    LightClusterBox box = { { INFINITY, INFINITY, -depths[1] }, { -INFINITY, -INFINITY, -depths[0] } };
+    for (float depth : depths) {
+        for (int i = 0; i < 2; ++i) {
+            const float vx = view_coordinate(ndcX[i], depth, uniforms.projection.x, uniforms.projection.z);
+            const float vy = view_coordinate(ndcY[i], depth, uniforms.projection.y, uniforms.projection.w);
+            box.min.x = std::min(box.min.x, vx);
+            box.max.x = std::max(box.max.x, vx);
+            box.min.y = std::min(box.min.y, vy);
+            box.max.y = std::max(box.max.y, vy);
+        }
+    }
+    return box;
+}
+
+bool light_sphere_touches_box(simd::float3 center, float radius, const LightClusterBox& box) {
+    const simd::float3 closest = simd::clamp(center, box.min, box.max);
+    const simd::float3 d = center - closest;
+    return simd::dot(d, d) <= radius * radius;
+}
+
+float light_attenuation(float distance, float radius) {
+    const float ratio = distance / radius;
+    const float window = std::clamp(1.0f - ratio * ratio * ratio * ratio, 0.0f, 1.0f);
+    return window * window / (distance * distance + 1.0f);
+}
+
+LightClusterGrid light_clusters_build(const LightClusterUniforms& uniforms, const PointLight* lights) {
+    LightClusterGrid grid;
+    grid.counts.assign(LIGHT_CLUSTER_COUNT, 0);
+    grid.lights.assign(LIGHT_CLUSTER_COUNT * LIGHT_CLUSTER_MAX_LIGHTS, 0);
+    for (uint32_t slice = 0; slice < LIGHT_CLUSTER_Z; ++slice) {
+        for (uint32_t y = 0; y < LIGHT_CLUSTER_Y; ++y) {
+            for (uint32_t x = 0; x < LIGHT_CLUSTER_X; ++x) {
+                const uint32_t cluster = light_cluster_index(x, y, slice);
+                const LightClusterBox box = light_cluster_box(uniforms, x, y, slice);
+                for (uint32_t i = 0; i < uniforms.lightCount; ++i) {
+                    const simd::float4 p = uniforms.view * simd::float4{ lights[i].position.x, lights[i].position.y,
+                                                                         lights[i].position.z, 1.0f };
+                    if (!light_sphere_touches_box({ p.x, p.y, p.z }, lights[i].radius, box)) {
+                        continue;
+                    }
+                    uint32_t& count = grid.counts[cluster];
+                    if (count < LIGHT_CLUSTER_MAX_LIGHTS) {
+                        grid.lights[cluster * LIGHT_CLUSTER_MAX_LIGHTS + count] = (uint16_t)i;
+                    }
+                    ++count;
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+std::vector<LightEmitter> scatter_light_emitters(uint32_t count, simd::float2 center, float extent, uint32_t seed,
+                                                 const std::function<float(float, float)>& height) {
+    std::vector<LightEmitter> emitters(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t h = emitter_hash(emitter_hash(seed) ^ i);
+        LightEmitter& emitter = emitters[i];
+        const float x = center.x + (2.0f * unit_float(emitter_hash(h + 1)) - 1.0f) * extent;
+        const float z = center.y + (2.0f * unit_float(emitter_hash(h + 2)) - 1.0f) * extent;
+        emitter.phase = 2.0f * (float)M_PI * unit_float(emitter_hash(h + 3));
+        if (i % 4 == 3) {
+            // A vehicle's lamp, circling low over the ground at its anchor's height
+            emitter.anchor = { x, height(x, z) + 1.0f, z };
+            emitter.color = { 5.0f, 5.0f, 5.5f };
+            emitter.radius = 14.0f;
+            emitter.orbit = 6.0f + 14.0f * unit_float(emitter_hash(h + 4));
+            emitter.speed = 0.3f + 0.5f * unit_float(emitter_hash(h + 5));
+        } else {
+            emitter.anchor = { x, height(x, z) + 1.5f, z };
+            emitter.color = { 4.0f, 2.2f, 0.8f };
+            emitter.radius = 8.0f;
+            emitter.orbit = 0.0f;
+            emitter.speed = 7.0f + 6.0f * unit_float(emitter_hash(h + 4));
+        }
+    }
+    return emitters;
+}
+
+void light_emitters_evaluate(const LightEmitter* emitters, uint32_t count, double time, PointLight* lights) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const LightEmitter& emitter = emitters[i];
+        // Wrapped per emitter so float angles stay precise however long the program runs, and
+        // within the polynomial trig's range: thousands of lights are moved every frame
+        const float angle = (float)fmod(time * emitter.speed + emitter.phase, 2.0 * M_PI * 1000.0);
+        float s, c;
+        approx_sincos(angle, s, c);
+        PointLight& light = lights[i];
+        light.radius = emitter.radius;
+        if (emitter.orbit > 0.0f) {
+            light.position = emitter.anchor + simd::float3{ c, 0.0f, s } * emitter.orbit;
+            light.color = emitter.color;
+        } else {
+            light.position = emitter.anchor;
+            light.color = emitter.color * (0.85f + 0.15f * s * approx_sin(1.7f * angle));
+        }
+    }
+}
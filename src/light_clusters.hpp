@@ -0,0 +1,167 @@
+/**
+ * @file light_clusters.hpp
+ * @brief Clustered forward shading: point lights binned into a froxel grid over the view frustum.
+ *
+ * The view frustum is cut into LIGHT_CLUSTER_X x LIGHT_CLUSTER_Y screen tiles and
+ * LIGHT_CLUSTER_Z depth slices, spaced exponentially between nearZ and farZ so every cluster is
+ * about as deep as it is wide. Each frame a compute kernel (see gpu_light_clusters.hpp) lists the
+ * lights whose sphere of influence touches each cluster's view-space box, and a fragment only
+ * loops over the list of the cluster it falls in. Shading cost follows the lights near a pixel
+ * rather than the lights in the scene. Fragments beyond farZ get no point light.
+ *
+ * These functions mirror cluster_lights and point_lighting in shaders.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// Screen tiles across, down, and depth slices of the cluster grid.
+constexpr uint32_t LIGHT_CLUSTER_X = 16;
+constexpr uint32_t LIGHT_CLUSTER_Y = 9;
+constexpr uint32_t LIGHT_CLUSTER_Z = 24;
+constexpr uint32_t LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+/// Lights one cluster lists; any further ones are dropped from it.
+constexpr uint32_t LIGHT_CLUSTER_MAX_LIGHTS = 64;
+/// Lights a frame can hold; light indices in the lists are 16 bits.
+constexpr uint32_t MAX_POINT_LIGHTS = 4096;
+
+/**
+ * @struct PointLight
+ * @brief A light radiating equally in every direction; matches PointLight in shaders.metal.
+ */
+struct PointLight {
+    simd::float3 position;  ///< World position.
+    simd::float3 color;     ///< Colour times intensity.
+    float radius;           ///< Distance at which the light's contribution reaches zero.
+};
+
+/**
+ * @struct LightClusterUniforms
+ * @brief What the kernel and the fragments need to map between pixels and clusters; matches shaders.metal.
+ */
+struct LightClusterUniforms {
+    simd::float4x4 view;        ///< World to view space.
+    simd::float4 projection;    ///< The projection's x and y scales and x and y offsets: columns[0].x, columns[1].y, columns[2].x, columns[2].y.
+    simd::float2 viewport;      ///< Size of the render target in pixels.
+    float nearZ;                ///< View depth where the first slice starts.
+    float farZ;                 ///< View depth where the last slice ends.
+    uint32_t lightCount;        ///< Lights in the frame's light array.
+};
+
+/**
+ * @struct LightClusterBox
+ * @brief A cluster's bounds in view space, which looks down -Z.
+ */
+struct LightClusterBox {
+    simd::float3 min;   ///< Smallest corner.
+    simd::float3 max;   ///< Largest corner.
+};
+
+/**
+ * @brief Fills the uniforms for a camera.
+ * @param view The camera's view matrix.
+ * @param projection The camera's perspective projection, possibly jittered; any depth mapping.
+ * @param width Render target width in pixels.
+ * @param height Render target height in pixels.
+ * @param nearZ View depth where clustering starts, e.g. the near plane.
+ * @param farZ View depth where clustering ends; lights are not shaded beyond it.
+ * @param lightCount Lights in the frame.
+ * @return The uniforms.
+ */
+LightClusterUniforms light_cluster_uniforms(const simd::float4x4& view, const simd::float4x4& projection,
+                                            uint32_t width, uint32_t height, float nearZ, float farZ,
+                                            uint32_t lightCount);
+
+/// @return The depth slice containing a view depth: 0 in front of nearZ, LIGHT_CLUSTER_Z at or beyond farZ.
+uint32_t light_cluster_slice(const LightClusterUniforms& uniforms, float viewDepth);
+
+/// @return The view depth where a slice starts; slice LIGHT_CLUSTER_Z gives farZ.
+float light_cluster_slice_depth(const LightClusterUniforms& uniforms, uint32_t slice);
+
+/// @return The index of a cluster in the grid's arrays: x fastest, then y, then the slice.
+inline uint32_t light_cluster_index(uint32_t x, uint32_t y, uint32_t slice) {
+    return x + LIGHT_CLUSTER_X * (y + LIGHT_CLUSTER_Y * slice);
+}
+
+/**
+ * @brief Returns the cluster a fragment falls in.
+ * @param uniforms The cluster uniforms.
+ * @param pixel Fragment position in pixels, y down.
+ * @param viewDepth Fragment view depth.
+ * @return The cluster index, or LIGHT_CLUSTER_COUNT beyond farZ.
+ */
+uint32_t light_cluster_of(const LightClusterUniforms& uniforms, simd::float2 pixel, float viewDepth);
+
+/// @return The view-space box around a cluster's frustum piece.
+LightClusterBox light_cluster_box(const LightClusterUniforms& uniforms, uint32_t x, uint32_t y, uint32_t slice);
+
+/// @return True if a sphere touches a box.
+bool light_sphere_touches_box(simd::float3 center, float radius, const LightClusterBox& box);
+
+/**
+ * @brief Returns the fraction of a point light's colour that reaches a distance.
+ *
+ * Inverse square falloff, softened by 1 near the light, times a window that takes it smoothly
+ * to zero at the light's radius so the cluster bounds cut nothing visible.
+ *
+ * @param distance Distance from the light.
+ * @param radius The light's radius.
+ * @return The attenuation, 0 at and beyond the radius.
+ */
+float light_attenuation(float distance, float radius);
+
+/**
+ * @struct LightClusterGrid
+ * @brief A CPU build of the kernel's output: how many lights each cluster touches and which.
+ */
+struct LightClusterGrid {
+    std::vector<uint32_t> counts;   ///< Per cluster, the lights touching it, which may exceed LIGHT_CLUSTER_MAX_LIGHTS.
+    std::vector<uint16_t> lights;   ///< LIGHT_CLUSTER_MAX_LIGHTS light indices per cluster, in light order.
+};
+
+/**
+ * @brief Bins lights into clusters the way cluster_lights does on the GPU.
+ * @param uniforms The cluster uniforms; lightCount lights are read.
+ * @param lights The lights.
+ * @return The grid.
+ */
+LightClusterGrid light_clusters_build(const LightClusterUniforms& uniforms, const PointLight* lights);
+
+/**
+ * @struct LightEmitter
+ * @brief Something in the world that carries a point light: a torch that flickers in place, or a
+ *        vehicle's lamp that circles its anchor.
+ */
+struct LightEmitter {
+    simd::float3 anchor;    ///< World position of a torch, or the centre of a vehicle's circuit.
+    simd::float3 color;     ///< Colour times intensity.
+    float radius;           ///< The light's radius.
+    float orbit;            ///< Radius of the circuit; 0 for a torch.
+    float speed;            ///< Radians per second around the circuit, or flicker rate of a torch.
+    float phase;            ///< Offset of the motion, so emitters do not move in step.
+};
+
+/**
+ * @brief Scatters emitters over a square, standing on the terrain.
+ * @param count Emitters to place; one in four is a vehicle.
+ * @param center World x and z of the square's centre.
+ * @param extent Half the square's side.
+ * @param seed Varies the placement.
+ * @param height Returns the terrain height at a world x and z.
+ * @return The emitters.
+ */
+std::vector<LightEmitter> scatter_light_emitters(uint32_t count, simd::float2 center, float extent, uint32_t seed,
+                                                 const std::function<float(float, float)>& height);
+
+/**
+ * @brief Writes the lights of emitters at a time.
+ * @param emitters The emitters.
+ * @param count Emitters to evaluate.
+ * @param time Seconds since an arbitrary start.
+ * @param lights Receives count lights.
+ */
+void light_emitters_evaluate(const LightEmitter* emitters, uint32_t count, double time, PointLight* lights);
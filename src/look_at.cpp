@@ -0,0 +1,54 @@
+#include "look_at.hpp"
+
+#include <cmath>
+
+LookAtQuery look_at_query(const Camera& cam, simd::float2 point, uint64_t frame) {
+    // The view moved back to the eye: only its rotation is left, so clip space maps to eye offsets
+    const simd::float4x4 relativeView =
+        cam.viewMatrix * matrix_translation(cam.position.x, cam.position.y, cam.position.z);
+    LookAtQuery query;
+    query.inverseViewProjection = simd::inverse(cam.projectionMatrix * relativeView);
+    query.eye = cam.position;
+    query.point = point;
+    query.clearDepth = camera_clear_depth(cam);
+    query.frame = frame;
+    return query;
+}
+
+bool look_at_unproject(const LookAtQuery& query, float depth, simd::float3& position) {
+    if (depth == query.clearDepth) {
+        return false;
+    }
+    const simd::float2 ndc = { 2.0f * query.point.x - 1.0f, 1.0f - 2.0f * query.point.y };
+    const simd::float4 offset = query.inverseViewProjection * simd::float4{ ndc.x, ndc.y, depth, 1.0f };
+    if (std::abs(offset.w) < 1e-20f) {
+        return false;
+    }
+    position = query.eye + simd::float3{ offset.x, offset.y, offset.z } / offset.w;
+    return true;
+}
+
+LookAtResult look_at_resolve(const LookAtQuery& query, float depth, const HeightField& field,
+                             const BiomeSettings& biomes) {
+    LookAtResult result;
+    result.frame = query.frame;
+    result.hit = look_at_unproject(query, depth, result.position);
+    if (!result.hit) {
+        return result;
+    }
+    const simd::float3 position = result.position;
+    result.distance = simd::length(position - query.eye);
+    result.terrainHeight = position.y;
+    // Beyond the cached height field nothing says whether the surface is terrain
+    if (height_field_contains(field, position.x, position.z)) {
+        const TerrainSample sample = height_field_sample(field, position.x, position.z);
+        result.terrainHeight = sample.height;
+        result.onTerrain = std::abs(position.y - sample.height) <= LOOK_AT_TERRAIN_TOLERANCE;
+        result.slopeDegrees = std::atan(simd::length(sample.gradient)) * (180.0f / (float)M_PI);
+    }
+    if (biomes.cellsPerEdge > 0) {
+        result.hasBiome = true;
+        result.biome = biome_classify(biome_climate(biomes, position.x, position.z, result.terrainHeight));
+    }
+    return result;
+}
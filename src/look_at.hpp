@@ -0,0 +1,84 @@
+/**
+ * @file look_at.hpp
+ * @brief The terrain point under the crosshair or cursor, reconstructed from the frame's depth buffer.
+ *
+ * Instead of marching a ray through the height field every frame, the GPU already knows the
+ * answer: the depth of the nearest surface under the point. GpuLookAt copies that one depth
+ * texel out after the scene pass, and a frame or two later, once the copy has landed, the
+ * point is unprojected with the inverse of the view projection the frame was drawn with. The
+ * CPU cost is one 4x4 multiply and a few height field lookups to describe what was hit.
+ *
+ * The inverse is taken of a camera-relative view projection, the view without its translation,
+ * so the reconstruction adds a short offset to the eye rather than cancelling two large world
+ * coordinates against each other; far from the world origin the point stays as precise as
+ * the depth it came from.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "biome.hpp"
+#include "camera.hpp"
+#include "height_field.hpp"
+
+/// Largest gap between the reconstructed point and the height field for the point to count as terrain.
+constexpr float LOOK_AT_TERRAIN_TOLERANCE = 0.5f;
+
+/**
+ * @struct LookAtQuery
+ * @brief Everything needed to unproject one depth value; captured when the frame is encoded.
+ */
+struct LookAtQuery {
+    simd::float4x4 inverseViewProjection;   ///< Inverse of the camera-relative view projection.
+    simd::float3 eye;                       ///< Camera position in world space.
+    simd::float2 point = { 0.5f, 0.5f };    ///< In [0, 1] across the view, y down.
+    float clearDepth = 1.0f;                ///< Depth of empty sky: the camera's far depth.
+    uint64_t frame = 0;                     ///< Frame the depth was drawn in.
+};
+
+/**
+ * @struct LookAtResult
+ * @brief What lies under the point.
+ */
+struct LookAtResult {
+    bool hit = false;               ///< False for empty sky; nothing below is valid then.
+    simd::float3 position = {};     ///< The surface point in world space.
+    float distance = 0.0f;          ///< From the eye.
+    bool onTerrain = false;         ///< True if the surface is the terrain, not an object on it or past the field.
+    float terrainHeight = 0.0f;     ///< Height field height at the point's x and z.
+    float slopeDegrees = 0.0f;      ///< Terrain slope there, 0 for flat.
+    bool hasBiome = false;          ///< True if biomes are on.
+    Biome biome = Biome::Grassland; ///< The terrain's biome there.
+    uint64_t frame = 0;             ///< Frame the depth was drawn in.
+};
+
+/**
+ * @brief Captures the query for a frame about to be drawn.
+ * @param cam The camera the frame is drawn with, jitter included.
+ * @param point The point, in [0, 1] across the view with y down.
+ * @param frame The frame number.
+ * @return The query.
+ */
+LookAtQuery look_at_query(const Camera& cam, simd::float2 point, uint64_t frame);
+
+/**
+ * @brief Reconstructs the world position of the depth under a query's point.
+ * @param query The query.
+ * @param depth The depth read back.
+ * @param position Receives the world position.
+ * @return False if the depth is the clear depth, i.e. nothing was drawn there.
+ */
+bool look_at_unproject(const LookAtQuery& query, float depth, simd::float3& position);
+
+/**
+ * @brief Resolves a read back depth into a description of the surface.
+ * @param query The query the depth belongs to.
+ * @param depth The depth read back.
+ * @param field The height field, for the terrain height and slope.
+ * @param biomes The climate's tunables; cellsPerEdge 0 leaves the biome out.
+ * @return The result; hit false for sky.
+ */
+LookAtResult look_at_resolve(const LookAtQuery& query, float depth, const HeightField& field,
+                             const BiomeSettings& biomes);
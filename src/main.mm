@@ -4,74 +4,2648 @@
 
 #import <Cocoa/Cocoa.h>
 #import <QuartzCore/CAMetalLayer.h>
+#include <malloc/malloc.h>
+#include <pthread.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #import "metal_context.hpp"
+#import "frame_ring.hpp"
+#import "command_buffers.hpp"
+#import "gpu_heap.hpp"
+#import "gpu_residency.hpp"
+#import "gpu_ray_tracing.hpp"
+#import "gpu_look_at.hpp"
+#import "gpu_picking.hpp"
+#import "gpu_rasterization_rate.hpp"
+#import "quality_governor.hpp"
 #import "camera.hpp"
 #import "objects.hpp"
 #import "landscape.hpp"
+#import "noise.hpp"
+#import "height_field.hpp"
+#import "terrain_edit.hpp"
 #import "cube.hpp"
+#import "mesh_registry.hpp"
+#import "chunk_manager.hpp"
+#import "resource_uploader.hpp"
+#import "asset_loader.hpp"
+#import "frustum.hpp"
+#import "fog.hpp"
+#import "gpu_culling.hpp"
+#import "foliage.hpp"
+#import "gpu_foliage.hpp"
+#import "creature.hpp"
+#import "gpu_skinning.hpp"
+#import "gpu_tessellation.hpp"
+#import "gpu_terrain_clipmap.hpp"
+#import "shadow_map.hpp"
+#import "deferred.hpp"
+#import "msaa.hpp"
+#import "meshlet_draw.hpp"
+#import "render_queue.hpp"
+#import "shader_variant.hpp"
+#import "shader_reload.hpp"
+#import "scene_arguments.hpp"
+#import "swapchain.hpp"
+#import "upscaler.hpp"
+#import "render_scale.hpp"
+#import "display_link.hpp"
+#import "cpu_sampler.hpp"
+#import "hitch_detector.hpp"
+#import "gpu_capture.hpp"
+#import "frame_latency.hpp"
+#import "frame_stats.hpp"
+#import "frame_stats_overlay.hpp"
+#import "memory_report.hpp"
+#import "metrics.hpp"
+#import "offscreen_target.hpp"
+#import "frame_arena.hpp"
+#import "gpu_profiler.hpp"
+#import "gpu_draw_costs.hpp"
+#import "trace.hpp"
+#import "camera_path.hpp"
+#import "job_system.hpp"
+#import "simulation.hpp"
+#import "scene.hpp"
+#import "transform_graph.hpp"
+#import "debris.hpp"
+#import "crowd.hpp"
+#import "stress_scene.hpp"
+#import "nav_mesh.hpp"
+#import "audio_occlusion.hpp"
+#import "physics.hpp"
+#import "replication_session.hpp"
+#import "world_save.hpp"
+#import "scene_cells.hpp"
+#import "input_recording.hpp"
+#import "multi_view.hpp"
+#import "multi_view_target.hpp"
+#import "map_tiles.hpp"
+#import "terrain_virtual_texture.hpp"
+#import "gpu_terrain_material.hpp"
+#import "gpu_terrain_horizon.hpp"
+#import "gpu_reflection_probe.hpp"
+#import "gpu_scene_instances.hpp"
+#import "transparency.hpp"
+#import "gpu_particles.hpp"
+#import "gpu_terrain_brush.hpp"
+#import "sky.hpp"
+#import "gpu_light_clusters.hpp"
+#import "gpu_ambient_occlusion.hpp"
+#import "gpu_render_graph.hpp"
+#import "queue_overlap.hpp"
+#include "tuning.hpp"
+#import "ui_overlay.hpp"
+#import "gpu_debug_draw.hpp"
+#import "occlusion_buffer.hpp"
+#import "reprojection.hpp"
+#import "shading_cache.hpp"
 
 #import "imgui.h"
 #import "imgui_impl_glfw.h"
 #import "imgui_impl_metal.h"
+#import "imgui_internal.h"
 
-// Shader uniform structure
-struct Uniforms {
-    simd::float4x4 modelMatrix;
-    simd::float4x4 viewMatrix;
-    simd::float4x4 projectionMatrix;
-    simd::float3 color;
+// Input events from the GLFW callbacks, drained by the simulation thread
+InputQueue g_inputEvents;
+bool g_cursor_locked = true;
+
+// A full queue means the simulation has stalled for a second; dropping the event is the least harm
+void push_input_event(InputEventType type, int key, double x, double y) {
+    InputEvent event;
+    event.time = simulation_clock();
+    event.type = type;
+    event.key = key;
+    event.x = x;
+    event.y = y;
+    g_inputEvents.push(event);
+}
+
+// GLFW callbacks
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_PRESS) {
+        if (key == GLFW_KEY_ESCAPE) {
+            glfwSetWindowShouldClose(window, true);
+        }
+        if (key == GLFW_KEY_TAB) {
+            g_cursor_locked = !g_cursor_locked;
+            glfwSetInputMode(window, GLFW_CURSOR, g_cursor_locked ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+            push_input_event(g_cursor_locked ? InputEventType::CursorLock : InputEventType::CursorRelease, 0, 0.0, 0.0);
+        }
+    }
+
+    if (key >= 0 && key < 1024) {
+        if (action == GLFW_PRESS) push_input_event(InputEventType::KeyDown, key, 0.0, 0.0);
+        if (action == GLFW_RELEASE) push_input_event(InputEventType::KeyUp, key, 0.0, 0.0);
+    }
+}
+
+void cursor_callback(GLFWwindow* window, double xpos, double ypos) {
+    push_input_event(InputEventType::MouseMove, 0, xpos, ypos);
+}
+
+// Records the new pixel size; the swapchain reallocates its targets at the start of the next frame
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    Swapchain* swapchain = (Swapchain*)glfwGetWindowUserPointer(window);
+    swapchain_resize(*swapchain, (uint32_t)width, (uint32_t)height, glfwGetCocoaWindow(window).backingScaleFactor);
+}
+
+// Moving to a display with another scale may keep the pixel size, so re-read it here too
+void content_scale_callback(GLFWwindow* window, float xscale, float yscale) {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    framebuffer_size_callback(window, width, height);
+}
+
+// The point picking and the look-at query aim at: the cursor once released with Tab, the crosshair while locked
+simd::float2 view_point(GLFWwindow* window) {
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    if (g_cursor_locked || windowWidth <= 0 || windowHeight <= 0) {
+        return { 0.5f, 0.5f };
+    }
+    double x = 0.0, y = 0.0;
+    glfwGetCursorPos(window, &x, &y);
+    return { (float)(x / windowWidth), (float)(y / windowHeight) };
+}
+
+// Adds a scene entity driven by a new node of the transform graph
+TransformNode add_part(SceneStore& scene, TransformGraph& graph, TransformNode parent, uint32_t mesh,
+                       const BoundingBox& meshBounds, const Affine& local, simd::float3 color) {
+    Entity entity = scene_create(scene, mesh, meshBounds, affine_matrix(local), color);
+    return transform_graph_create(graph, parent, local, entity);
+}
+
+// A tree is a root node at its base with the trunk and the leaves as children; select_foliage draws the same parts
+void add_tree(SceneStore& scene, TransformGraph& graph, const GpuMesh& cube, uint32_t cubeMesh,
+              const FoliageInstance& instance) {
+    const float k = instance.position.w;
+    TransformNode tree = transform_graph_create(
+        graph, {}, affine_trs_y({ instance.position.x, instance.position.y, instance.position.z }, instance.yaw, { k, k, k }));
+    add_part(scene, graph, tree, cubeMesh, cube.bounds, affine_translation_scale(0.0f, 1.0f, 0.0f, 0.2f, 2.0f, 0.2f),
+             {0.5f, 0.35f, 0.26f});
+    add_part(scene, graph, tree, cubeMesh, cube.bounds, affine_translation_scale(0.0f, 2.5f, 0.0f, 1.5f, 1.5f, 1.5f),
+             {0.0f, 0.8f, 0.2f});
+}
+
+void add_rock(SceneStore& scene, TransformGraph& graph, const GpuMesh& rock, uint32_t rockMesh,
+              const FoliageInstance& instance) {
+    const float k = instance.position.w;
+    add_part(scene, graph, {}, rockMesh, rock.bounds,
+             affine_trs_y({ instance.position.x, instance.position.y + 0.3f * k, instance.position.z }, instance.yaw,
+                          { 1.2f * k, 0.8f * k, 1.6f * k }),
+             {0.5f, 0.5f, 0.5f});
+}
+
+// Foliage cells along a chunk edge of the sparse placement that becomes scene entities
+constexpr uint32_t SCATTER_CELLS_PER_EDGE = 8;
+// Most entities a chunk's placement creates: a tree is a trunk and a crown
+constexpr uint32_t SCATTER_MAX_CHUNK_ENTITIES = 2 * SCATTER_CELLS_PER_EDGE * SCATTER_CELLS_PER_EDGE;
+
+// Registers the shared meshes. Trees and rocks are scattered by GpuFoliage; without it a sparse copy of
+// the same placement over the height field becomes scene entities instead. Rocks use the mesh cooked from
+// assets/rock.obj next to the executable, or the cube when it is missing.
+SceneStore create_scene_objects(ResourceUploader& uploader, MeshRegistry& meshRegistry, const HeightField& heightField,
+                                TransformGraph& graph, bool scatterFoliage, const ChunkManagerConfig& chunks) {
+    SceneStore scene;
+
+    NSString* executableDirectory = [[[NSBundle mainBundle] executablePath] stringByDeletingLastPathComponent];
+    const std::string rockPath = [executableDirectory stringByAppendingPathComponent:@"rock.mesh"].UTF8String;
+    mesh_registry_add_primitives(meshRegistry, uploader);
+    const uint32_t cubeMesh = mesh_registry_primitive(meshRegistry, Primitive::Cube);
+    const uint32_t rockMesh = mesh_registry_get_or_load(meshRegistry, uploader, "rock", rockPath, create_cube);
+    const GpuMesh& cube = meshRegistry.meshes[cubeMesh];
+    const GpuMesh& rock = meshRegistry.meshes[rockMesh];
+
+    if (scatterFoliage) {
+        const float chunkSize = chunks.chunkSize;
+        FoliageSettings sparse;
+        sparse.cellsPerEdge = SCATTER_CELLS_PER_EDGE;
+        const float extentX = (heightField.width - 1) * heightField.spacing;
+        const float extentZ = (heightField.depth - 1) * heightField.spacing;
+        for (int cz = (int)floorf(heightField.originZ / chunkSize); cz * chunkSize < heightField.originZ + extentZ; ++cz) {
+            for (int cx = (int)floorf(heightField.originX / chunkSize); cx * chunkSize < heightField.originX + extentX; ++cx) {
+                const BiomeMap biomes = generate_biome_map(chunks.biomes, { cx, cz }, chunkSize, chunks.terrain);
+                for (uint32_t cell = 0; cell < sparse.cellsPerEdge * sparse.cellsPerEdge; ++cell) {
+                    FoliageInstance instance;
+                    if (!foliage_candidate(sparse, { cx, cz }, cell % sparse.cellsPerEdge, cell / sparse.cellsPerEdge,
+                                           chunkSize, chunks.resolution, instance, chunks.terrain, &biomes)) {
+                        continue;
+                    }
+                    if (instance.kind == FoliageKind::Tree) {
+                        add_tree(scene, graph, cube, cubeMesh, instance);
+                    } else {
+                        add_rock(scene, graph, rock, rockMesh, instance);
+                    }
+                }
+            }
+        }
+    }
+
+    transform_graph_update(graph, scene);
+    scene_update_bounds(scene);
+    return scene;
+}
+
+// The sparse placement of one chunk as the objects of its scene cell. Streamed entities have no transform
+// graph nodes, so a tree's parts are placed in world space directly, as add_tree's graph would.
+void scatter_scene_cell(ChunkKey key, const ChunkManagerConfig& chunks, const MeshRegistry& meshRegistry,
+                        uint32_t cubeMesh, uint32_t rockMesh, SceneCellObjects& objects) {
+    FoliageSettings sparse;
+    sparse.cellsPerEdge = SCATTER_CELLS_PER_EDGE;
+    const BiomeMap biomes = generate_biome_map(chunks.biomes, key, chunks.chunkSize, chunks.terrain);
+    const auto add = [&](uint32_t mesh, const Affine& world, simd::float3 color) {
+        objects.transforms.push_back(affine_matrix(world));
+        objects.colors.push_back(color);
+        objects.meshes.push_back(mesh);
+        objects.localBounds.push_back(meshRegistry.meshes[mesh].bounds);
+    };
+    for (uint32_t cell = 0; cell < sparse.cellsPerEdge * sparse.cellsPerEdge; ++cell) {
+        FoliageInstance instance;
+        if (!foliage_candidate(sparse, key, cell % sparse.cellsPerEdge, cell / sparse.cellsPerEdge, chunks.chunkSize,
+                               chunks.resolution, instance, chunks.terrain, &biomes)) {
+            continue;
+        }
+        const float k = instance.position.w;
+        const simd::float3 base = { instance.position.x, instance.position.y, instance.position.z };
+        if (instance.kind == FoliageKind::Tree) {
+            const Affine tree = affine_trs_y(base, instance.yaw, { k, k, k });
+            add(cubeMesh, affine_multiply(tree, affine_translation_scale(0.0f, 1.0f, 0.0f, 0.2f, 2.0f, 0.2f)),
+                {0.5f, 0.35f, 0.26f});
+            add(cubeMesh, affine_multiply(tree, affine_translation_scale(0.0f, 2.5f, 0.0f, 1.5f, 1.5f, 1.5f)),
+                {0.0f, 0.8f, 0.2f});
+        } else {
+            add(rockMesh,
+                affine_trs_y(base + simd::float3{ 0.0f, 0.3f * k, 0.0f }, instance.yaw,
+                             { 1.2f * k, 0.8f * k, 1.6f * k }),
+                {0.5f, 0.5f, 0.5f});
+        }
+    }
+}
+
+// Adds the objects of a stress scene as trees and rocks like create_scene_objects' own
+void add_stress_objects(SceneStore& scene, TransformGraph& graph, const MeshRegistry& meshRegistry,
+                        const StressSceneSettings& stress, const ChunkManagerConfig& chunks) {
+    const uint32_t cubeMesh = mesh_registry_primitive(meshRegistry, Primitive::Cube);
+    const uint32_t rockMesh = meshRegistry.lookup.at("rock");
+    const GpuMesh& cube = meshRegistry.meshes[cubeMesh];
+    for (const FoliageInstance& instance :
+         scatter_stress_objects(stress, chunks.chunkSize, chunks.resolution, chunks.terrain)) {
+        if (instance.kind == FoliageKind::Tree) {
+            add_tree(scene, graph, cube, cubeMesh, instance);
+        } else {
+            add_rock(scene, graph, meshRegistry.meshes[rockMesh], rockMesh, instance);
+        }
+    }
+    transform_graph_update(graph, scene);
+    scene_update_bounds(scene);
+}
+
+// Per-frame ring space: the frame uniforms, a uniform slot per chunk and mesh, every scene instance,
+// the culling and foliage buffers, and the shadow casters; maxEntities counts entities spawned later too
+size_t scene_frame_bytes(uint32_t maxChunks, const MeshRegistry& meshRegistry, size_t maxEntities,
+                         const ShadowSettings& shadowSettings) {
+    const size_t uniformBytes = std::max(sizeof(Uniforms), sizeof(MeshletUniforms));
+    const size_t uniformStride = (uniformBytes + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    const size_t frameBytes = (sizeof(FrameUniforms) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    const size_t instanceBytes = (maxEntities * sizeof(InstanceData) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    return frameBytes + uniformStride * (maxChunks + meshRegistry.meshes.size()) + instanceBytes +
+           gpu_culling_frame_bytes(maxChunks) + gpu_foliage_frame_bytes() +
+           shadow_map_frame_bytes(shadowSettings, maxChunks);
+}
+
+// Ring space of a multi-view pass: per group, its views' frame uniforms, a uniform slot per chunk and mesh,
+// and every scene instance, since each group culls and queues the scene on its own
+size_t multi_view_frame_bytes(uint32_t maxChunks, const MeshRegistry& meshRegistry, size_t maxEntities,
+                              uint32_t groups) {
+    const size_t uniformBytes = std::max(sizeof(Uniforms), sizeof(MeshletUniforms));
+    const size_t uniformStride = (uniformBytes + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    const size_t viewBytes = (MULTI_VIEW_MAX_VIEWS * sizeof(FrameUniforms) + FRAME_RING_ALIGNMENT - 1) &
+                             ~(FRAME_RING_ALIGNMENT - 1);
+    const size_t instanceBytes = (maxEntities * sizeof(InstanceData) + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    return groups * (viewBytes + uniformStride * (maxChunks + meshRegistry.meshes.size()) + instanceBytes);
+}
+
+// ImGui allocates through these so its CPU memory is charged to the UI
+void* imgui_alloc(size_t bytes, void*) {
+    return memory_tag_alloc(bytes, MEMORY_UI);
+}
+
+void imgui_free(void* pointer, void*) {
+    memory_tag_free(pointer);
+}
+
+// GPU bytes of the render targets that are allocated; memoryless ones hold none
+size_t render_target_bytes(const Swapchain& swapchain, const MsaaTargets& msaa, const GBuffer* gbuffer,
+                           const Upscaler* upscaler) {
+    size_t bytes = swapchain.color.allocatedSize + transient_target_bytes(swapchain.depth) +
+                   msaa.color.allocatedSize + msaa.depth.allocatedSize;
+    if (gbuffer) {
+        bytes += gbuffer->albedo.allocatedSize + gbuffer->normal.allocatedSize + gbuffer->depth.allocatedSize;
+    }
+    if (upscaler) {
+        bytes += upscaler->color.allocatedSize + transient_target_bytes(upscaler->depth) +
+                 upscaler->motion.allocatedSize + upscaler->output.allocatedSize + upscaler->history.allocatedSize +
+                 upscaler->accumulated.allocatedSize;
+    }
+    return bytes;
+}
+
+// Memory of every subsystem, from the allocatedSize of its resources and the capacity of its containers
+MemoryReport gather_memory_report(const ChunkManager& chunkManager, const HeightField& heightField,
+                                  const MeshRegistry& meshRegistry, const SceneStore& scene, const GpuFoliage* foliage,
+                                  const GpuSkinning* skinning, const ShadowMap* shadowMap, const FrameRing& uniformRing,
+                                  const ResourceUploader& uploader, const GpuCulling* culling,
+                                  const TerrainVirtualTexture* virtualTexture, const GpuTerrainMaterials* materials,
+                                  size_t targetBytes) {
+    MemoryReport report;
+    report.gpuBytes[MEMORY_TERRAIN] = chunkManager.allocated_bytes();
+    if (virtualTexture) {
+        report.gpuBytes[MEMORY_TERRAIN] += terrain_virtual_texture_bytes(*virtualTexture);
+    }
+    if (materials) {
+        report.gpuBytes[MEMORY_TERRAIN] += gpu_terrain_materials_bytes(*materials);
+    }
+    report.cpuBytes[MEMORY_TERRAIN] =
+        vector_bytes(heightField.heights) + vector_bytes(chunkManager.resident()) + chunkManager.erosion_bytes() +
+        chunkManager.biome_bytes();
+    report.gpuBytes[MEMORY_MESHES] += meshRegistry.geometry.bytes();
+    for (const GpuMesh& mesh : meshRegistry.meshes) {
+        if (mesh.geometry.block == NO_RANGE) {
+            report.gpuBytes[MEMORY_MESHES] += mesh.vertexBuffer.allocatedSize + mesh.indexBuffer.allocatedSize;
+        }
+        report.gpuBytes[MEMORY_MESHES] += mesh.meshletData.allocatedSize;
+    }
+    if (skinning) {
+        report.gpuBytes[MEMORY_MESHES] += gpu_skinning_bytes(*skinning);
+    }
+    report.cpuBytes[MEMORY_MESHES] = vector_bytes(meshRegistry.meshes);
+    report.cpuBytes[MEMORY_SCENE] = scene_memory_bytes(scene);
+    if (foliage) {
+        report.gpuBytes[MEMORY_FOLIAGE] = gpu_foliage_bytes(*foliage);
+    }
+    if (shadowMap) {
+        report.gpuBytes[MEMORY_SHADOWS] = shadow_map_bytes(*shadowMap);
+    }
+    for (id<MTLBuffer> buffer : uniformRing.buffers) {
+        report.gpuBytes[MEMORY_UNIFORMS] += buffer.allocatedSize;
+    }
+    report.gpuBytes[MEMORY_UNIFORMS] += uploader.staging_bytes();
+    report.gpuBytes[MEMORY_TARGETS] = targetBytes;
+    if (culling) {
+        report.gpuBytes[MEMORY_TARGETS] += culling->hiz.allocatedSize;
+        for (size_t i = 0; i < culling->commands.size(); ++i) {
+            report.gpuBytes[MEMORY_TARGETS] += culling->commands[i].allocatedSize + culling->commandArguments[i].allocatedSize;
+        }
+    }
+    // The backend creates the font atlas on the first frame
+    if (id<MTLTexture> fontTexture = (__bridge id<MTLTexture>)ImGui::GetIO().Fonts->TexID) {
+        report.gpuBytes[MEMORY_UI] = fontTexture.allocatedSize;
+    }
+    report.cpuBytes[MEMORY_UI] = memory_tag_cpu_bytes(MEMORY_UI);
+    return report;
+}
+
+// Reverse-Z keeps the nearest surface by keeping the largest depth
+id<MTLDepthStencilState> create_depth_state(id<MTLDevice> device, bool reverseZ) {
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = reverseZ ? MTLCompareFunctionGreater : MTLCompareFunctionLess;
+    depthDesc.depthWriteEnabled = YES;
+    return [device newDepthStencilStateWithDescriptor:depthDesc];
+}
+
+id<MTLTexture> create_render_target(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                                    MTLTextureUsage usage = MTLTextureUsageRenderTarget) {
+    MTLTextureDescriptor* desc =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                           width:width
+                                                          height:height
+                                                       mipmapped:NO];
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = usage;
+    return [device newTextureWithDescriptor:desc];
+}
+
+// Fills passDesc, which is kept across frames, for the scene pass
+MTLRenderPassDescriptor* make_scene_pass(MTLRenderPassDescriptor* passDesc, id<MTLTexture> color, id<MTLTexture> depth,
+                                         bool keepDepth, float clearDepth) {
+    render_pass_reset(passDesc);
+    passDesc.colorAttachments[0].texture = color;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.6, 0.8, 1.0, 1.0); // Sky blue
+
+    passDesc.depthAttachment.texture = depth;
+    passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+    passDesc.depthAttachment.storeAction = keepDepth ? MTLStoreActionStore : MTLStoreActionDontCare;
+    passDesc.depthAttachment.clearDepth = clearDepth;
+    return passDesc;
+}
+
+// Copies the finished scene into color under the UI overlay; every pixel is written
+MTLRenderPassDescriptor* make_composite_pass(MTLRenderPassDescriptor* passDesc, id<MTLTexture> color) {
+    render_pass_reset(passDesc);
+    passDesc.colorAttachments[0].texture = color;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionDontCare;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    return passDesc;
+}
+
+// Room for the visible lists of a few thousand chunks and entities; arenas grow past it on their own
+constexpr size_t FRAME_ARENA_BYTES = 256 * 1024;
+
+// Frames streaming in the start area may allocate; heap allocations after them are reported
+constexpr uint64_t HEAP_CHECK_WARMUP_FRAMES = 120;
+
+// Debris alive at once: 5000 a second for a 3 second lifetime, with headroom
+constexpr uint32_t MAX_DEBRIS = 16384;
+
+// Rigid spheres alive at once, and how many one drop adds
+constexpr uint32_t MAX_PHYSICS_BODIES = 20000;
+constexpr uint32_t PHYSICS_DROP = 1000;
+
+// Skinned creatures walking the terrain around the start
+constexpr uint32_t HERD_SIZE = 24;
+constexpr uint32_t HERD_SEED = 7;
+
+// Placement of the wandering crowd --crowd asks for
+constexpr uint32_t CROWD_SEED = 11;
+
+// World distance from the eye out to which the navigation mesh's debug layer draws polygons
+constexpr float NAV_MESH_DEBUG_RADIUS = 48.0f;
+
+// Length of an audio tick, at which sound occlusion is updated
+constexpr float AUDIO_TICK_SECONDS = 1.0f / 30.0f;
+
+// Edge length in pixels of each face of the cube map probe
+constexpr uint32_t PROBE_FACE_SIZE = 256;
+
+FrameArenas create_scene_arenas(const JobSystem& jobs) {
+    return create_frame_arenas(DEFAULT_FRAMES_IN_FLIGHT, jobs.worker_count(JobPriority::Frame) + 1, FRAME_ARENA_BYTES);
+}
+
+// Records the heap allocations made since a heap_allocation_count() reading and, with tracking
+// built in, reports them once the warmup is over; at most one line a second at 60 Hz
+void check_frame_allocations(FrameStats& frameStats, uint64_t countBefore) {
+    static uint64_t lastReported = 0;
+    const uint64_t allocations = heap_allocation_count() - countBefore;
+    const uint64_t frame = frameStats.current.frame;
+    frameStats.current.heapAllocations = (uint32_t)allocations;
+    if (HEAP_ALLOCATION_TRACKING && allocations > 0 && frame > HEAP_CHECK_WARMUP_FRAMES &&
+        (lastReported == 0 || frame >= lastReported + 60)) {
+        fprintf(stderr, "Frame %llu: %llu heap allocations while streaming and encoding\n",
+                (unsigned long long)frame, (unsigned long long)allocations);
+        lastReported = frame;
+    }
+}
+
+// Blocks held by the malloc zones, which Objective-C objects come from rather than operator new. Only
+// read when allocations are tracked, since it walks every zone.
+uint64_t malloc_blocks_in_use() {
+    if (!HEAP_ALLOCATION_TRACKING) {
+        return 0;
+    }
+    malloc_statistics_t stats;
+    malloc_zone_statistics(nullptr, &stats);
+    return stats.blocks_in_use;
+}
+
+// Records the blocks the frame's autorelease pool freed as it drained: the autoreleased descriptors,
+// encoders and temporaries the frame left behind. Other threads allocate meanwhile, so it is a trend
+// to watch rather than an exact count.
+void check_frame_autoreleases(FrameStats& frameStats, uint64_t blocksBeforeDrain) {
+    const uint64_t blocks = malloc_blocks_in_use();
+    frameStats.current.autoreleasedBlocks = (uint32_t)(blocksBeforeDrain > blocks ? blocksBeforeDrain - blocks : 0);
+}
+
+// Per-frame scratch, kept across frames so encode_scene does not allocate
+struct SceneScratch {
+    CullBounds bounds;
+    std::vector<SceneBatch> batches;
+    RenderQueue queue;
+    RenderQueue prepass;    // Depth-only terrain draws, encoded before queue with the depth pre-pass
+    BindlessFrame bindless;
+    FrameArena* arena = nullptr; // The render thread's arena of the current frame, for the visible lists
 };
 
-// Global state for input handling
-struct InputState {
-    bool keys[1024] = {};
-    double mouseX = 0.0;
-    double mouseY = 0.0;
-};
+// Shading options picked in the overlay; every combination is its own pipeline variant
+struct SceneShading {
+    LightingModel lighting = LightingModel::Lambert;
+    bool fog = false;
+    bool farFade = false;   // Fades into the sky where streaming ends, see scene_fog()
+    bool shadows = false;   // Needs a shadow map; set where one was created
+    bool deferred = false;  // Tile-based deferred pass; needs a GBuffer
+    uint32_t sampleCount = 1; // MSAA samples; above 1 the scene pass renders into MsaaTargets
+    bool meshlets = false;  // Cooked meshes drawn per meshlet; needs meshlet_draw_supported()
+    bool tessellation = false; // Near chunks drawn as displaced patches; needs gpu_tessellation_supported()
+    bool clipmap = false;   // Terrain drawn as a geometry clipmap instead of chunks; needs a GpuTerrainClipmap
+    bool virtualTexture = false; // Terrain albedo streamed into a sparse texture; needs a TerrainVirtualTexture
+    bool bakedMaterials = false; // Terrain albedo read from per-chunk baked tiles; needs GpuTerrainMaterials
+    bool horizonShadows = false; // Terrain shadowed past the cascades by baked horizons; needs GpuTerrainHorizons
+    bool sky = false;       // Atmosphere drawn behind the surfaces and fog fading into it; needs a Sky
+    bool pointLights = false; // Torch and vehicle lights shaded per cluster; needs GpuLightClusters
+    bool shadingCache = false; // Terrain shadowing reused from last frame where valid; needs a ShadingCache
+    bool ambientOcclusion = false; // Ambient light occluded from the scene depth; needs GpuAmbientOcclusion
+    bool impostors = false; // Far foliage as impostor quads; needs GpuFoliage::atlas
+    bool wind = false;      // Foliage sways in FrameUniforms::wind; needs a GpuFoliage
+    bool rayTracing = false; // Shadows and occlusion traced against acceleration structures; needs a GpuRayTracing
+    bool variableRate = false; // Scene pass shaded through a rasterization rate map; needs a GpuRasterizationRate
+    bool vertexLighting = false; // Chunks with cells a few pixels on screen lit per vertex; forward only
+    bool depthPrepass = false; // Terrain chunks lay their depth first and shade only the fragments left visible
+    bool overdraw = false;  // Surfaces add up their shaded fragments as a heat map instead of lighting; forward only
+    bool residentInstances = false; // Entities read from GpuSceneInstances through per-draw index lists
+};
+
+struct ScenePipelines {
+    id<MTLRenderPipelineState> terrain;         // Reads height maps instead of vertices if the chunks have them
+    id<MTLRenderPipelineState> terrainBindless; // nil without argument buffer support or with height maps
+    id<MTLRenderPipelineState> terrainVertexLit; // terrain, lit per vertex for ResidentChunk::vertexLit; nil if off
+    id<MTLRenderPipelineState> terrainBindlessVertexLit; // terrainBindless, likewise
+    id<MTLRenderPipelineState> terrainDepthOnly; // terrain's vertex stage alone, for the depth pre-pass; nil if off
+    id<MTLRenderPipelineState> terrainBindlessDepthOnly; // terrainBindless, likewise
+    id<MTLDepthStencilState> depthEqual;        // Shades the pre-passed terrain where its depth won; nil if off
+    id<MTLRenderPipelineState> instanced;
+    id<MTLRenderPipelineState> skinned;         // instanced reading its own instance buffer, for the skinned draws
+    id<MTLRenderPipelineState> foliage;         // Foliage parts, swaying and dissolving into their impostors if on
+    id<MTLRenderPipelineState> impostors;       // Impostor quads of the far foliage; nil if off
+    id<MTLRenderPipelineState> meshlets;        // Culls and draws meshes with meshlets; nil if off
+    id<MTLRenderPipelineState> terrainTessellated; // Displaced terrain patches; nil if off
+    id<MTLRenderPipelineState> terrainClipmap;  // Clipmap levels in place of the chunks; nil if off
+    id<MTLRenderPipelineState> lighting;        // Deferred lighting; nil in forward mode
+    id<MTLRenderPipelineState> sky;             // Sky behind the surfaces; nil without the atmosphere
+    id<MTLBuffer> materials;                    // Material table read by terrainBindless
+    id<MTLBuffer> sceneInstances;               // GpuSceneInstances::buffer instanced and meshlets index; nil if off
+};
+
+// rayTraced once the acceleration structures exist; until then the shadows come from the shadow map. Without
+// wait, variants still compiling draw with their unlit placeholders; see metal_pipeline_or_placeholder().
+ScenePipelines scene_pipelines(MetalContext& metal, const ChunkManager& chunkManager, const SceneShading& shading,
+                               bool rayTraced = false, bool wait = true) {
+    // Deferred surfaces only write the G-buffer, so the shading options go to the lighting pass alone
+    ShaderVariant lit;
+    lit.lighting = shading.lighting;
+    lit.fog = shading.fog;
+    lit.farFade = shading.farFade;
+    lit.shadows = shading.shadows && !rayTraced;
+    lit.rayTracedShadows = shading.shadows && rayTraced;
+    lit.skyFog = shading.sky;
+    lit.pointLights = shading.pointLights;
+    lit.shadingCache = shading.shadingCache && lit.shadows;
+    lit.ambientOcclusion = shading.ambientOcclusion;
+    lit.sampleCount = shading.sampleCount;
+
+    const bool heightMaps = chunkManager.config().heightMaps;
+    ShaderVariant terrain = shading.deferred ? ShaderVariant{} : lit;
+    terrain.program = heightMaps ? ShaderProgram::LandscapeHeightMap : ShaderProgram::Landscape;
+    terrain.vertexFormat = heightMaps ? VertexFormat::Float : chunkManager.config().vertexFormat;
+    terrain.deferred = shading.deferred;
+    terrain.sampleCount = shading.sampleCount;
+    terrain.virtualTexture = shading.virtualTexture;
+    terrain.bakedMaterials = shading.bakedMaterials;
+    // Forward only, and traced shadows already reach as far as the scene does
+    terrain.horizonShadows = shading.horizonShadows && !shading.deferred && !rayTraced;
+    terrain.overdraw = shading.overdraw && !shading.deferred; // Every surface below inherits it
+
+    ShaderVariant terrainBindless = terrain;
+    terrainBindless.program = ShaderProgram::LandscapeBindless;
+
+    ShaderVariant instanced = terrain;
+    instanced.program = ShaderProgram::Instanced;
+    instanced.vertexFormat = VertexFormat::Float;
+    instanced.virtualTexture = false;
+    instanced.bakedMaterials = false;
+    instanced.horizonShadows = false;
+    instanced.shadingCache = false; // Only the terrain and the lighting pass fill the cache
+    instanced.indexedInstances = shading.residentInstances;
+
+    const auto pipeline = [&](const ShaderVariant& variant) {
+        return metal_pipeline_or_placeholder(metal, variant, wait);
+    };
+    ScenePipelines pipelines;
+    pipelines.terrain = pipeline(terrain);
+    pipelines.terrainBindless = metal.bindless && !heightMaps ? pipeline(terrainBindless) : nil;
+    if (shading.vertexLighting && !shading.deferred) {
+        ShaderVariant vertexLit = terrain;
+        vertexLit.vertexLighting = true;
+        pipelines.terrainVertexLit = pipeline(vertexLit);
+        vertexLit.program = ShaderProgram::LandscapeBindless;
+        pipelines.terrainBindlessVertexLit = pipelines.terrainBindless ? pipeline(vertexLit) : nil;
+    }
+    if (shading.depthPrepass) {
+        // The positions are invariant, so the vertex-lit chunks share these and Equal finds every pixel they won
+        ShaderVariant depthOnly = terrain;
+        depthOnly.overdraw = false;
+        depthOnly.depthOnly = true;
+        pipelines.terrainDepthOnly = pipeline(depthOnly);
+        depthOnly.program = ShaderProgram::LandscapeBindless;
+        pipelines.terrainBindlessDepthOnly = pipelines.terrainBindless ? pipeline(depthOnly) : nil;
+        pipelines.depthEqual = metal_depth_equal_state(metal);
+    }
+    pipelines.instanced = pipeline(instanced);
+    ShaderVariant skinned = instanced;
+    skinned.indexedInstances = false; // Skinned instances are posed on the GPU, not kept by the scene
+    pipelines.skinned = pipeline(skinned);
+    if (shading.meshlets) {
+        ShaderVariant meshlets = instanced;
+        meshlets.program = ShaderProgram::InstancedMeshlets;
+        pipelines.meshlets = pipeline(meshlets);
+    }
+    // Foliage is also written on the GPU; with both options off this is the skinned pipeline again
+    ShaderVariant foliage = skinned;
+    foliage.foliageWind = shading.wind;
+    foliage.lodDissolve = shading.impostors;
+    pipelines.foliage = pipeline(foliage);
+    if (shading.impostors) {
+        // Quads keep the rest pose; they are too far for the sway to show
+        ShaderVariant impostors = foliage;
+        impostors.foliageWind = false;
+        impostors.program = ShaderProgram::FoliageImpostor;
+        pipelines.impostors = pipeline(impostors);
+    }
+    if (shading.tessellation) {
+        // Patches are placed from the noise, so no vertex format applies
+        ShaderVariant tessellated = terrain;
+        tessellated.program = ShaderProgram::LandscapeTessellated;
+        tessellated.vertexFormat = VertexFormat::Float;
+        pipelines.terrainTessellated = pipeline(tessellated);
+    }
+    if (shading.clipmap) {
+        // Heights come from the clipmap's slices; the albedo paths index per-chunk data it has none of
+        ShaderVariant clipmap = terrain;
+        clipmap.program = ShaderProgram::LandscapeClipmap;
+        clipmap.vertexFormat = VertexFormat::Float;
+        clipmap.virtualTexture = false;
+        clipmap.bakedMaterials = false;
+        clipmap.horizonShadows = false;
+        pipelines.terrainClipmap = pipeline(clipmap);
+    }
+    if (shading.deferred) {
+        lit.program = ShaderProgram::DeferredLighting;
+        lit.deferred = true;
+        pipelines.lighting = pipeline(lit);
+    }
+    if (shading.sky && !terrain.overdraw) {
+        pipelines.sky = metal_sky_pipeline(metal, shading.sampleCount, shading.deferred);
+    }
+    pipelines.materials = metal.materials;
+    return pipelines;
+}
+
+// Fog whose far fade ends about where chunk streaming does in every direction, so the edge of the
+// terrain dissolves into the sky instead of popping
+FogSettings scene_fog(const ChunkManagerConfig& chunks) {
+    FogSettings fog;
+    fog.fadeEnd = (float)(chunks.loadRadius - 1) * chunks.chunkSize;
+    fog.fadeStart = 0.75f * fog.fadeEnd;
+    return fog;
+}
+
+// The camera sees to where chunk streaming ends, may climb half that far above the highest terrain
+// and crosses a chunk in four seconds; across the ground the streamed world has no edge
+void fit_camera_to_world(Camera& cam, const ChunkManagerConfig& chunks) {
+    const float viewDistance = (float)chunks.loadRadius * chunks.chunkSize;
+    const float heightBound = terrain_height_bound(chunks.terrain);
+    set_camera_world(cam, viewDistance, -heightBound, heightBound + 0.5f * viewDistance, 0.25f * chunks.chunkSize);
+}
+
+// The parts of the fog the shading variants apply; a part they leave out hides nothing
+FogSettings active_fog(const FogSettings& fog, const SceneShading& shading) {
+    FogSettings active = fog;
+    if (!shading.fog) {
+        active.density = 0.0f;
+    }
+    if (!shading.farFade) {
+        active.fadeStart = INFINITY;
+        active.fadeEnd = INFINITY;
+    }
+    return active;
+}
+
+// What the system reports about heat and power; both are plain property reads, cheap enough every frame
+PowerState current_power_state() {
+    NSProcessInfo* info = NSProcessInfo.processInfo;
+    PowerState power;
+    power.thermal = (ThermalState)info.thermalState;
+    if (@available(macOS 12.0, *)) {
+        power.lowPower = info.lowPowerModeEnabled;
+    }
+    return power;
+}
+
+// Keeps the streamed terrain, the meshes, the material table and the frame ring resident on the queues, so the
+// bindless and GPU-culled draws stop declaring the buffers they reach by address
+void use_residency_set(GpuResidency& residency, const MetalContext& metal, ChunkManager& chunkManager,
+                       const MeshRegistry& meshRegistry, const FrameRing& uniformRing, GpuCulling* culling,
+                       SceneScratch& scratch) {
+    residency.attach(metal.queue);
+    residency.attach(metal.computeQueue);
+    chunkManager.set_residency(&residency);
+    for (const GpuMesh& mesh : meshRegistry.meshes) {
+        residency.add(mesh.vertexBuffer);
+        residency.add(mesh.indexBuffer);
+        residency.add(mesh.meshletData);
+    }
+    for (id<MTLBuffer> buffer : uniformRing.buffers) {
+        residency.add(buffer);
+    }
+    residency.add(metal.materials);
+    residency.commit();
+    if (culling) {
+        culling->resident = true;
+    }
+    scratch.bindless.resident = true;
+}
+
+// Hands the pipelines of a reloaded context to everything that copied them out of the old one
+void use_reloaded_pipelines(const MetalContext& metal, ChunkManager& chunkManager, GpuCulling* culling,
+                            GpuFoliage* foliage, GpuSkinning* skinning, GpuTessellation* tessellation,
+                            GpuTerrainClipmap* clipmap, ShadowMap* shadowMap, Upscaler* upscaler,
+                            Transparency* transparency, GpuParticles* particles, Sky* sky,
+                            GpuLightClusters* lightClusters, GpuAmbientOcclusion* ambientOcclusion,
+                            GpuDebugDraw* debugDraw) {
+    chunkManager.set_pipelines(metal);
+    if (culling) {
+        culling->cullPipeline = metal.cull_chunks_pipeline;
+        culling->hizCopyPipeline = metal.hiz_copy_pipeline;
+        culling->hizReducePipeline = metal.hiz_reduce_pipeline;
+    }
+    if (foliage) {
+        foliage->scatterPipeline = metal.scatter_foliage_pipeline;
+        foliage->selectPipeline = metal.select_foliage_pipeline;
+        foliage->finishPipeline = metal.finish_foliage_pipeline;
+    }
+    if (skinning) {
+        skinning->pipeline = metal.skin_vertices_pipeline;
+    }
+    if (tessellation) {
+        tessellation->factorsPipeline = metal.tessellation_factors_pipeline;
+    }
+    if (clipmap) {
+        clipmap->updatePipeline = metal.update_terrain_clipmap_pipeline;
+    }
+    if (shadowMap) {
+        shadowMap->landscapePipeline = chunkManager.config().vertexFormat == VertexFormat::Packed
+                                           ? metal.shadow_landscape_packed_pipeline
+                                           : metal.shadow_landscape_pipeline;
+        shadowMap->heightMapPipeline = metal.shadow_landscape_heightmap_pipeline;
+        shadowMap->instancedPipeline = metal.shadow_instanced_pipeline;
+    }
+    if (upscaler) {
+        upscaler->motionPipeline = metal.motion_vectors_pipeline;
+        upscaler->resolvePipeline = metal.temporal_aa_pipeline;
+    }
+    if (transparency) {
+        transparency->waterPipeline = metal.water_pipeline;
+        transparency->compositePipeline = metal.oit_composite_pipeline;
+        transparency->ocean.spectrumPipeline = metal.ocean_spectrum_pipeline;
+        transparency->ocean.fftPipeline = metal.ocean_fft_pipeline;
+        transparency->ocean.resolvePipeline = metal.ocean_resolve_pipeline;
+    }
+    if (particles) {
+        particles->drawPipeline = metal.particle_pipeline;
+    }
+    if (sky) {
+        sky->transmittancePipeline = metal.atmosphere_transmittance_pipeline;
+        sky->multiScatteringPipeline = metal.atmosphere_multiscattering_pipeline;
+        sky->skyViewPipeline = metal.atmosphere_sky_view_pipeline;
+        sky_invalidate(*sky); // The kernels may compute something else now
+    }
+    if (lightClusters) {
+        lightClusters->pipeline = metal.cluster_lights_pipeline;
+    }
+    if (ambientOcclusion) {
+        ambientOcclusion->pipeline = metal.ambient_occlusion_pipeline;
+        ambientOcclusion->applyPipeline = metal.ambient_occlusion_apply_pipeline;
+        ambientOcclusion->tracedPipeline = metal.ray_traced_occlusion_pipeline;
+    }
+    if (debugDraw) {
+        debugDraw->pipeline = metal.debug_draw_pipeline;
+    }
+}
+
+// Writes the constants every draw of a pass shares, one FrameUniforms per view
+FrameAllocation write_view_uniforms(FrameRing& uniformRing, const RenderView* views, uint32_t count,
+                                    const FogSettings& fog) {
+    FrameAllocation slot = frame_ring_allocate(uniformRing, count * sizeof(FrameUniforms));
+    for (uint32_t i = 0; i < count; ++i) {
+        FrameUniforms* frame = (FrameUniforms*)slot.contents + i;
+        frame->viewProjection = views[i].viewProjection;
+        frame->previousViewProjection = views[i].viewProjection;
+        frame->cameraPosition = views[i].eye;
+        frame->lightDirection = LIGHT_DIRECTION;
+        frame->fogDensity = fog.density;
+        frame->fadeStart = fog.fadeStart;
+        frame->fadeEnd = fog.fadeEnd;
+        frame->frameIndex = 0;
+        frame->wind = {};
+    }
+    return slot;
+}
+
+// Writes the constants every draw of the camera's passes shares. Without a previous view-projection
+// the camera is taken to have stood still, as on the first frame, and without wind foliage stands still.
+FrameAllocation write_frame_uniforms(FrameRing& uniformRing, const Camera& cam, const FogSettings& fog,
+                                     const simd::float4x4* previousViewProjection = nullptr, uint32_t frameIndex = 0,
+                                     simd::float4 wind = {}) {
+    const RenderView view = camera_render_view(cam);
+    FrameAllocation slot = write_view_uniforms(uniformRing, &view, 1, fog);
+    FrameUniforms* frame = (FrameUniforms*)slot.contents;
+    if (previousViewProjection) {
+        frame->previousViewProjection = *previousViewProjection;
+    }
+    frame->frameIndex = frameIndex;
+    frame->wind = wind;
+    return slot;
+}
+
+// Frustum- and fog-culls the terrain chunks on the CPU and queues the survivors. Their uniforms go into one
+// array bound once for all of them, and each draw picks its entry with its base instance. With a
+// bindless pipeline the chunks find their transform and vertices through SceneArguments instead, so
+// the height-field chunks of one pipeline differ only in their index range and draw ID: each gets an
+// argument record in one frame-ring array and the pipeline queues one indirect batch over them. Timed
+// frames keep a draw per chunk, so the draw costs still name the chunk.
+// Chunks in any of the views are kept, and fog is measured from the first view's eye.
+// Chunks flagged in skip (per resident chunk, may be null) are drawn elsewhere this frame.
+// With a depth pre-pass every chunk is also queued depth-only into scratch.prepass, and its
+// colour draw only shades where that depth won.
+void queue_chunks(SceneScratch& scratch, const ChunkManager& chunkManager, const ScenePipelines& pipelines,
+                  id<MTLDepthStencilState> depthState, FrameRing& uniformRing, const RenderView* views,
+                  uint32_t viewCount, float fogDistance, const uint8_t* skip, FrameStats& frameStats) {
+    const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+
+    cull_bounds_clear(scratch.bounds);
+    for (const auto& chunk : chunks) {
+        cull_bounds_add(scratch.bounds, chunk.bounds);
+    }
+    uint32_t* visible = scratch.arena->allocate_array<uint32_t>(scratch.bounds.size());
+    const size_t inFrustum = multi_view_cull(views, viewCount, scratch.bounds, visible);
+    size_t visibleCount = fog_cull(scratch.bounds, views[0].eye, fogDistance, visible, inFrustum);
+    for (size_t v = visibleCount; v < inFrustum; ++v) {
+        if (!skip || !skip[visible[v]]) {
+            frame_stats_count_fog_culled(frameStats, chunkManager.chunk_draw(chunks[visible[v]]).range.count);
+        }
+    }
+
+    const bool bindless = pipelines.terrainBindless != nil;
+    FrameAllocation drawSlots = {};
+    uint32_t drawCount = 0;
+    if (bindless) {
+        bindless_begin_frame(scratch.bindless, uniformRing, pipelines.materials, (uint32_t)visibleCount);
+    } else if (visibleCount > 0) {
+        drawSlots = frame_ring_allocate(uniformRing, visibleCount * sizeof(Uniforms));
+    }
+
+    // Batches draw in record order, so near to far is sorted here rather than by the queue
+    const bool batched = bindless && !scratch.queue.timestamps && visibleCount > 0;
+    FrameAllocation arguments = {};
+    uint32_t batchFirst[2] = {};   // Per-pixel lit, then vertex-lit records
+    uint32_t batchCount[2] = {};
+    float batchDepth[2] = { INFINITY, INFINITY };
+    if (batched) {
+        if (scratch.queue.frontToBack) {
+            uint64_t* keys = scratch.arena->allocate_array<uint64_t>(visibleCount);
+            sort_front_to_back(scratch.bounds, views[0].eye, visible, visibleCount, keys);
+        }
+        for (size_t v = 0; v < visibleCount; ++v) {
+            const bool drawn = !skip || !skip[visible[v]];
+            batchFirst[1] += drawn && !(chunks[visible[v]].vertexLit && pipelines.terrainVertexLit);
+        }
+        arguments = frame_ring_allocate(uniformRing, visibleCount * sizeof(MTLDrawIndexedPrimitivesIndirectArguments));
+    }
+
+    for (size_t v = 0; v < visibleCount; ++v) {
+        if (skip && skip[visible[v]]) {
+            continue;
+        }
+        const ResidentChunk& chunk = chunks[visible[v]];
+        // The selected LOD of the height field, or the caves and overhangs of a volumetric chunk
+        const ChunkDraw geometry = chunkManager.chunk_draw(chunk);
+        const IndexRange& range = geometry.range;
+
+        DrawCommand draw;
+        draw.depthState = to_mtl(depthState);
+        draw.material = MATERIAL_TERRAIN;
+        draw.object = make_chunk_draw_object(chunk.key.x, chunk.key.z);
+        draw.viewDepth = box_distance(chunk.bounds, views[0].eye);
+        // Chunks whose cells cover a few pixels take their lighting from the vertices
+        const bool vertexLit = chunk.vertexLit && pipelines.terrainVertexLit;
+        if (bindless) {
+            draw.pipeline = to_mtl(vertexLit ? pipelines.terrainBindlessVertexLit : pipelines.terrainBindless);
+            draw.baseInstance = bindless_add_draw(scratch.bindless, geometry.vertexBuffer, MATERIAL_TERRAIN,
+                                                  geometry.modelMatrix);
+            // Volumetric chunks bring their own index buffer and stay single draws
+            if (batched && geometry.indexBuffer == chunkManager.lod_index_buffer()) {
+                MTLDrawIndexedPrimitivesIndirectArguments& record =
+                    ((MTLDrawIndexedPrimitivesIndirectArguments*)arguments.contents)[batchFirst[vertexLit] +
+                                                                                    batchCount[vertexLit]++];
+                record.indexCount = range.count;
+                record.instanceCount = 1;
+                record.indexStart = range.offset;
+                record.baseVertex = 0;
+                record.baseInstance = draw.baseInstance;
+                batchDepth[vertexLit] = std::min(batchDepth[vertexLit], draw.viewDepth);
+                frame_stats_count_draw(frameStats, range.count);
+                if (pipelines.depthEqual) {
+                    frame_stats_count_draw(frameStats, range.count);
+                }
+                continue;
+            }
+        } else {
+            Uniforms& uniforms = ((Uniforms*)drawSlots.contents)[drawCount];
+            uniforms.modelMatrix = geometry.modelMatrix;
+            uniforms.normalMatrix = matrix_normal(geometry.modelMatrix);
+
+            draw.pipeline = to_mtl(vertexLit ? pipelines.terrainVertexLit : pipelines.terrain);
+            draw.vertexBuffer = to_mtl(geometry.vertexBuffer);
+            draw.vertexTextures[0] = to_mtl(chunk.heightMap);
+            draw.vertexTextures[1] = to_mtl(chunk.normalMap);
+            draw.uniformBuffer = to_mtl(drawSlots.buffer);
+            draw.uniformOffset = drawSlots.offset;
+            draw.baseInstance = drawCount++;
+        }
+        draw.indexBuffer = to_mtl(geometry.indexBuffer);
+        draw.indexOffset = range.offset * metal_index_size(geometry.indexType);
+        draw.indexCount = range.count;
+        draw.indexType = to_mtl(geometry.indexType);
+        if (pipelines.depthEqual) {
+            DrawCommand depthOnly = draw;
+            depthOnly.pipeline = to_mtl(bindless ? pipelines.terrainBindlessDepthOnly : pipelines.terrainDepthOnly);
+            render_queue_push(scratch.prepass, depthOnly);
+            frame_stats_count_draw(frameStats, range.count);
+            draw.depthState = to_mtl(pipelines.depthEqual);
+        }
+        render_queue_push(scratch.queue, draw);
+        frame_stats_count_draw(frameStats, range.count);
+    }
+
+    for (uint32_t b = 0; b < 2; ++b) {
+        if (batchCount[b] == 0) {
+            continue;
+        }
+        DrawCommand batch;
+        batch.pipeline = to_mtl(b ? pipelines.terrainBindlessVertexLit : pipelines.terrainBindless);
+        batch.depthState = to_mtl(depthState);
+        batch.material = MATERIAL_TERRAIN;
+        batch.viewDepth = batchDepth[b];
+        batch.indexBuffer = to_mtl(chunkManager.lod_index_buffer());
+        batch.indexType = to_mtl(chunkManager.lod_index_type());
+        batch.indirectBuffer = to_mtl(arguments.buffer);
+        batch.indirectOffset = arguments.offset + batchFirst[b] * sizeof(MTLDrawIndexedPrimitivesIndirectArguments);
+        batch.indirectCount = batchCount[b];
+        if (pipelines.depthEqual) {
+            DrawCommand depthOnly = batch;
+            depthOnly.pipeline = to_mtl(pipelines.terrainBindlessDepthOnly);
+            render_queue_push(scratch.prepass, depthOnly);
+            batch.depthState = to_mtl(pipelines.depthEqual);
+        }
+        render_queue_push(scratch.queue, batch);
+    }
+}
+
+// Frustum- and fog-culls the scene entities, picks each survivor's detail level from its projected size in the
+// first view, writes their instance data into the frame ring grouped by mesh and level, and queues one instanced
+// draw per group over that level's index range. Full-detail meshes with meshlets go through the meshlet pipeline
+// when there is one, which also culls each instance's meshlets on the GPU for the first view; the others
+// need no uniform slot. Culling keeps entities in any of the views, as queue_chunks does, or in
+// cullView if one is given, e.g. a frozen frustum. With an occlusion buffer, drawn from that same
+// view, the entities the terrain hides are dropped too.
+void queue_scene_objects(SceneScratch& scratch, const SceneStore& scene, const MeshRegistry& meshRegistry,
+                         const ScenePipelines& pipelines, id<MTLDepthStencilState> depthState,
+                         FrameRing& uniformRing, const RenderView* views, uint32_t viewCount, float fogDistance,
+                         FrameStats& frameStats, const RenderView* cullView = nullptr,
+                         const OcclusionBuffer* occlusion = nullptr) {
+    const RenderView* culled = cullView ? cullView : views;
+    uint32_t* visible = scratch.arena->allocate_array<uint32_t>(scene.size());
+    const size_t inFrustum = multi_view_cull(culled, cullView ? 1 : viewCount, scene.worldBounds, visible);
+    size_t visibleCount = fog_cull(scene.worldBounds, culled[0].eye, fogDistance, visible, inFrustum);
+    for (size_t v = visibleCount; v < inFrustum; ++v) {
+        frame_stats_count_fog_culled(frameStats, meshRegistry.meshes[scene.meshes[visible[v]]].indexCount);
+    }
+    if (occlusion) {
+        const size_t unoccluded = occlusion_cull(*occlusion, scene.worldBounds, visible, visibleCount);
+        frame_stats_count_occlusion(frameStats, (uint32_t)visibleCount, (uint32_t)(visibleCount - unoccluded));
+        visibleCount = unoccluded;
+    }
+    if (visibleCount == 0) {
+        return;
+    }
+    if (scratch.queue.frontToBack) {
+        // Batches keep visible order, so their instances go near to far as well
+        uint64_t* keys = scratch.arena->allocate_array<uint64_t>(visibleCount);
+        sort_front_to_back(scene.worldBounds, culled[0].eye, visible, visibleCount, keys);
+    }
+
+    uint8_t* lods = scratch.arena->allocate_array<uint8_t>(visibleCount);
+    scene_select_lods(scene, visible, visibleCount, meshRegistry.lods.data(), culled[0].eye,
+                      mesh_lod_projection_scale(culled[0].viewProjection), lods);
+    // With resident instances only their dense positions are written; otherwise the instances themselves
+    const bool resident = pipelines.sceneInstances != nil;
+    const size_t instanceStride = resident ? sizeof(uint32_t) : sizeof(InstanceData);
+    FrameAllocation instanceSlot = frame_ring_allocate(uniformRing, visibleCount * instanceStride);
+    const uint32_t* order = (const uint32_t*)instanceSlot.contents;
+    const InstanceData* instances = (const InstanceData*)instanceSlot.contents;
+    if (resident) {
+        scene_order_instances(scene, visible, visibleCount, (uint32_t*)instanceSlot.contents, scratch.batches, lods);
+    } else {
+        scene_fill_instances(scene, visible, visibleCount, (InstanceData*)instanceSlot.contents, scratch.batches,
+                             lods);
+    }
+
+    for (const SceneBatch& batch : scratch.batches) {
+        const GpuMesh& mesh = meshRegistry.meshes[batch.mesh];
+        const MeshLod& lod = meshRegistry.lods[batch.mesh].levels[batch.lod];
+
+        DrawCommand draw;
+        // The batch's first instance is its nearest when the list was sorted
+        const simd::float4 nearest = resident ? scene.transforms[order[batch.first]].columns[3]
+                                              : instances[batch.first].modelMatrix.columns[3];
+        draw.viewDepth = simd::distance(simd::float3{ nearest.x, nearest.y, nearest.z }, culled[0].eye);
+        if (pipelines.meshlets && mesh.meshletCount > 0 && batch.lod == 0) {
+            FrameAllocation slot = frame_ring_allocate(uniformRing, sizeof(MeshletUniforms));
+            *(MeshletUniforms*)slot.contents = make_meshlet_uniforms(
+                views[0].viewProjection, extract_frustum(views[0].viewProjection), views[0].eye, mesh, batch.count);
+            draw.pipeline = to_mtl(pipelines.meshlets);
+            draw.uniformBuffer = to_mtl(slot.buffer);
+            draw.uniformOffset = slot.offset;
+            draw.meshletBuffer = to_mtl(mesh.meshletData);
+            draw.meshletCount = mesh.meshletCount;
+        } else {
+            draw.pipeline = to_mtl(pipelines.instanced);
+        }
+        draw.depthState = to_mtl(depthState);
+        draw.vertexBuffer = to_mtl(mesh.vertexBuffer);
+        if (resident) {
+            draw.instanceBuffer = to_mtl(pipelines.sceneInstances);
+            draw.instanceIndexBuffer = to_mtl(instanceSlot.buffer);
+            draw.instanceIndexOffset = instanceSlot.offset + batch.first * sizeof(uint32_t);
+        } else {
+            draw.instanceBuffer = to_mtl(instanceSlot.buffer);
+            draw.instanceOffset = instanceSlot.offset + batch.first * sizeof(InstanceData);
+        }
+        draw.indexBuffer = to_mtl(mesh.indexBuffer);
+        draw.indexOffset = gpu_mesh_index_offset(mesh, lod.indexOffset);
+        draw.indexCount = lod.indexCount;
+        draw.indexType = to_mtl(mesh.indexType);
+        draw.instanceCount = batch.count;
+        draw.baseVertex = mesh.baseVertex;
+        draw.material = batch.mesh;
+        draw.object = make_mesh_draw_object(batch.mesh, batch.lod);
+        render_queue_push(scratch.queue, draw);
+        frame_stats_count_draw(frameStats, lod.indexCount, draw.instanceCount);
+    }
+}
+
+// Queues the instanced cube draw whose instances and count select_foliage wrote this frame, and with
+// impostors on the quads of the far instances, whose parts then dissolve into them. The parts' sway
+// is bound with the rest of the encoder state.
+void queue_foliage(SceneScratch& scratch, const GpuFoliage& foliage, const MeshRegistry& meshRegistry,
+                   const ScenePipelines& pipelines, id<MTLDepthStencilState> depthState, FrameStats& frameStats) {
+    const uint32_t cubeMesh = mesh_registry_primitive(meshRegistry, Primitive::Cube);
+    const GpuMesh& mesh = meshRegistry.meshes[cubeMesh];
+    const bool impostors = foliage.impostors && pipelines.impostors;
+
+    DrawCommand draw;
+    draw.pipeline = to_mtl(pipelines.foliage);
+    draw.depthState = to_mtl(depthState);
+    draw.vertexBuffer = to_mtl(mesh.vertexBuffer);
+    draw.instanceBuffer = to_mtl(foliage.instances);
+    draw.indexBuffer = to_mtl(mesh.indexBuffer);
+    draw.indexOffset = gpu_mesh_index_offset(mesh);
+    draw.indexType = to_mtl(mesh.indexType);
+    draw.indirectBuffer = to_mtl(foliage.draw.buffer);
+    draw.indirectOffset = foliage.draw.offset;
+    draw.material = cubeMesh;
+    draw.object = make_draw_object(DrawObjectKind::Foliage, 0);
+    render_queue_push(scratch.queue, draw);
+    // The instance count stays on the GPU
+    frame_stats_count_draw(frameStats, mesh.indexCount, 0);
+
+    if (impostors) {
+        // The quad's corners come from the vertex ID
+        DrawCommand quads;
+        quads.pipeline = to_mtl(pipelines.impostors);
+        quads.depthState = to_mtl(depthState);
+        quads.instanceBuffer = to_mtl(foliage.impostorInstances);
+        quads.indexBuffer = to_mtl(foliage.atlas.quadIndices);
+        quads.indexCount = 6;
+        quads.indexType = MTL::IndexTypeUInt16;
+        quads.indirectBuffer = to_mtl(foliage.impostorDraw.buffer);
+        quads.indirectOffset = foliage.impostorDraw.offset;
+        quads.material = cubeMesh;
+        quads.object = make_draw_object(DrawObjectKind::Impostors, 0);
+        render_queue_push(scratch.queue, quads);
+        frame_stats_count_draw(frameStats, 6, 0);
+    }
+}
+
+// Queues one draw per posed skinned instance in the view, each picking its copy of the vertices
+// with its base vertex and its InstanceData with its base instance
+void queue_skinned(SceneScratch& scratch, const GpuSkinning& skinning, const ScenePipelines& pipelines,
+                   id<MTLDepthStencilState> depthState, const RenderView& view, float fogDistance,
+                   FrameStats& frameStats) {
+    if (skinning.instanceCount == 0) {
+        return;
+    }
+    uint32_t* visible = scratch.arena->allocate_array<uint32_t>(skinning.bounds.size());
+    const size_t inFrustum = frustum_cull(extract_frustum(view.viewProjection), skinning.bounds, visible);
+    const size_t visibleCount = fog_cull(skinning.bounds, view.eye, fogDistance, visible, inFrustum);
+    for (size_t k = 0; k < visibleCount; ++k) {
+        const uint32_t i = visible[k];
+        DrawCommand draw;
+        draw.pipeline = to_mtl(pipelines.skinned);
+        draw.depthState = to_mtl(depthState);
+        draw.vertexBuffer = to_mtl(skinning.output);
+        draw.instanceBuffer = to_mtl(skinning.instances.buffer);
+        draw.instanceOffset = skinning.instances.offset;
+        draw.indexBuffer = to_mtl(skinning.mesh.indexBuffer);
+        draw.indexCount = skinning.mesh.indexCount;
+        draw.indexType = to_mtl(skinning.mesh.indexType);
+        draw.baseVertex = i * skinning.vertexCount;
+        draw.baseInstance = i;
+        draw.object = make_draw_object(DrawObjectKind::Skinned, i);
+        draw.viewDepth = simd::distance(simd::float3{ skinning.bounds.centerX[i], skinning.bounds.centerY[i],
+                                                      skinning.bounds.centerZ[i] }, view.eye);
+        render_queue_push(scratch.queue, draw);
+        frame_stats_count_draw(frameStats, skinning.mesh.indexCount);
+    }
+}
+
+// Draws the resident chunks a view sees into the occlusion buffer as their coarse occluder grids. A chunk whose
+// grid is missing or predates an edit has one sampled from the edited terrain, up to OCCLUDER_BUILDS_PER_FRAME
+// of them per frame. The buffer keeps the aspect of the render target.
+void draw_terrain_occluders(OcclusionBuffer& buffer, TerrainOccluderCache& cache, const ChunkManager& chunkManager,
+                            const RenderView& view, float fogDistance, uint32_t width, uint32_t height,
+                            uint64_t frame) {
+    TRACE_SCOPE("Terrain occluders");
+    occlusion_buffer_begin(buffer, view.viewProjection, OCCLUSION_BUFFER_WIDTH,
+                           std::max(OCCLUSION_BUFFER_WIDTH * height / std::max(width, 1u), 1u));
+    const Frustum frustum = extract_frustum(view.viewProjection);
+    const float chunkSize = chunkManager.config().chunkSize;
+    const auto height_at = [&chunkManager](float x, float z) { return chunkManager.terrain_height(x, z); };
+    uint32_t builds = 0;
+    for (const ResidentChunk& chunk : chunkManager.resident()) {
+        if (!frustum_intersects(frustum, chunk.bounds) || box_distance(chunk.bounds, view.eye) > fogDistance) {
+            continue;
+        }
+        const simd::float2 origin = { chunk.key.x * chunkSize, chunk.key.z * chunkSize };
+        const TerrainOccluder* occluder = terrain_occluder_find(cache, chunk.key, chunk.editVersion, frame);
+        if (!occluder) {
+            if (builds == OCCLUDER_BUILDS_PER_FRAME) {
+                continue;
+            }
+            TerrainOccluder& built = terrain_occluder_slot(cache, chunk.key, chunk.editVersion, frame);
+            terrain_occluder_build(built, origin, chunkSize, height_at);
+            occluder = &built;
+            builds++;
+        }
+        occlusion_buffer_grid(buffer, occluder->heights, OCCLUDER_GRID, origin, chunkSize / (OCCLUDER_GRID - 1));
+    }
+}
+
+// Fills the debug layer's shapes for this frame: the resident chunks coloured by LOD and the ones still
+// streaming in, the entities coloured by what culling against cullView made of them, the frozen
+// frustum out to the streamed radius, the navigation mesh's polygons around the eye, and the selected
+// entity. pending is scratch kept across frames.
+void collect_debug_shapes(GpuDebugDraw& debug, const ChunkManager& chunkManager, const SceneStore& scene,
+                          const NavMesh& navMesh, const RenderView& cullView, float fogDistance,
+                          std::vector<ChunkKey>& pending, Entity selected) {
+    debug_draw_clear(debug.draw);
+    const float chunkSize = chunkManager.config().chunkSize;
+    if (debug.settings.chunks) {
+        for (const ResidentChunk& chunk : chunkManager.resident()) {
+            debug_draw_box(debug.draw, chunk.bounds, debug_lod_color(chunk.lodLevel));
+        }
+        // Nothing bounds a chunk before it is built, so it is drawn flat at the height of its centre
+        chunkManager.pending_keys(pending);
+        for (const ChunkKey& key : pending) {
+            const float x = key.x * chunkSize;
+            const float z = key.z * chunkSize;
+            const float y = chunkManager.terrain_height(x + 0.5f * chunkSize, z + 0.5f * chunkSize);
+            debug_draw_box(debug.draw, { { x, y, z }, { x + chunkSize, y, z + chunkSize } }, DEBUG_PENDING_COLOR);
+        }
+    }
+    if (debug.settings.objects) {
+        const Frustum frustum = extract_frustum(cullView.viewProjection);
+        const CullBounds& bounds = scene.worldBounds;
+        for (size_t i = 0; i < scene.size(); ++i) {
+            const simd::float3 center = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+            const simd::float3 extent = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+            const BoundingBox box = { center - extent, center + extent };
+            debug_draw_box(debug.draw, box, debug_cull_color(debug_cull(frustum, cullView.eye, fogDistance, box)));
+        }
+    }
+    if (debug.settings.freezeFrustum) {
+        const float streamed = chunkManager.config().loadRadius * chunkSize;
+        debug_draw_frustum(debug.draw, cullView.viewProjection, cullView.eye, std::min(streamed, fogDistance),
+                           DEBUG_FRUSTUM_COLOR);
+    }
+    if (debug.settings.navMesh) {
+        const float cell = navMesh.settings.cellSize;
+        const float tileSize = navMesh.settings.tileCells * cell;
+        for (size_t t = 0; t < navMesh.tiles.size(); ++t) {
+            const float tileX = navMesh.originX + (float)(t % navMesh.tilesX) * tileSize;
+            const float tileZ = navMesh.originZ + (float)(t / navMesh.tilesX) * tileSize;
+            for (const NavPoly& poly : navMesh.tiles[t].polys) {
+                if (simd::distance(poly.center, cullView.eye) > NAV_MESH_DEBUG_RADIUS) {
+                    continue;
+                }
+                const simd::float3 lo = { tileX + poly.x0 * cell, poly.center.y, tileZ + poly.z0 * cell };
+                const simd::float3 hi = { tileX + (poly.x1 + 1) * cell, poly.center.y, tileZ + (poly.z1 + 1) * cell };
+                debug_draw_box(debug.draw, { lo, hi }, DEBUG_NAV_MESH_COLOR);
+            }
+        }
+    }
+    const uint32_t index = scene_index(scene, selected);
+    if (index != UINT32_MAX) {
+        const CullBounds& bounds = scene.worldBounds;
+        const simd::float3 center = { bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index] };
+        const simd::float3 extent = { bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index] };
+        debug_draw_box(debug.draw, { center - extent, center + extent }, DEBUG_SELECTED_COLOR);
+    }
+}
+
+// Executes the chunk draws cull_terrain_chunks encoded on the GPU
+void encode_culled_chunks(id<MTLRenderCommandEncoder> enc, const ScenePipelines& pipelines,
+                          const ChunkManager& chunkManager, id<MTLDepthStencilState> depthState,
+                          const FrameRing& uniformRing, const GpuCulling& gpuCulling, const ShadowMap* shadowMap,
+                          const GpuTerrainMaterials* materials, const GpuTerrainHorizons* horizons, const Sky* sky,
+                          const ShadingCache* shadingCache, FrameArena& arena) {
+    // The encoded draws bind the uniforms themselves and inherit the pipeline, so the depth pre-pass
+    // executes them once depth-only before they are shaded where that depth won
+    if (pipelines.depthEqual) {
+        [enc setRenderPipelineState:pipelines.terrainDepthOnly];
+        [enc setDepthStencilState:depthState];
+        gpu_culling_draw(gpuCulling, enc, chunkManager, uniformRing, arena);
+        depthState = pipelines.depthEqual;
+    }
+    [enc setRenderPipelineState:pipelines.terrain];
+    [enc setDepthStencilState:depthState];
+    // The textures come from the encoder
+    if (shadowMap) {
+        shadow_map_bind(*shadowMap, enc);
+    }
+    if (materials) {
+        gpu_terrain_materials_bind(*materials, enc);
+    }
+    if (horizons) {
+        gpu_terrain_horizons_bind(*horizons, enc);
+    }
+    if (sky) {
+        sky_bind(*sky, enc);
+    }
+    if (shadingCache) {
+        shading_cache_bind(*shadingCache, enc);
+    }
+    gpu_culling_draw(gpuCulling, enc, chunkManager, uniformRing, arena, pipelines.terrainVertexLit);
+}
+
+// Encodes the scene pass; above one encode thread the sorted draws are split over a parallel encoder.
+// Every encoder gets the frame uniforms write_frame_uniforms wrote for cam, so draws only carry
+// their own transform. Geometry entirely beyond fogDistance is hidden by fog and not drawn.
+// With a G-buffer the pass must have it attached, and it ends by lighting it. With a sky the pass
+// also ends by filling what no surface covered, and the fog fades into it. With light clusters
+// the lit fragments add the point lights gpu_light_clusters_encode binned this frame. With a shading
+// cache the terrain or the lighting reuses last frame's shadowing through it. With a cull view the CPU
+// culling keeps what that view sees instead of what cam does, while everything still draws from cam.
+// With an occlusion buffer the entities the terrain hides from the culling view are not drawn.
+// With a clipmap its levels are the terrain and no chunk is drawn. With a depth pre-pass the chunks'
+// depth-only draws go first, ahead of every other surface.
+void encode_scene(id<MTLCommandBuffer> cmd, MTLRenderPassDescriptor* passDesc, const ScenePipelines& pipelines,
+                  const ChunkManager& chunkManager, const MeshRegistry& meshRegistry,
+                  const SceneStore& scene, id<MTLDepthStencilState> depthState,
+                  FrameRing& uniformRing, const Camera& cam, const FrameAllocation& frameUniforms,
+                  float fogDistance, SceneScratch& scratch, const GpuCulling* gpuCulling,
+                  const GpuFoliage* foliage, const GpuSkinning* skinning, const GpuTessellation* tessellation,
+                  const ShadowMap* shadowMap, const TerrainVirtualTexture* virtualTexture,
+                  const GpuTerrainMaterials* materials, const Sky* sky, const GpuLightClusters* lightClusters,
+                  const ShadingCache* shadingCache, const GBuffer* gbuffer, JobSystem& jobs, uint32_t encodeThreads,
+                  FrameStats& frameStats, const RenderView* cullView = nullptr,
+                  const OcclusionBuffer* occlusion = nullptr, const GpuTerrainClipmap* clipmap = nullptr,
+                  const GpuRayTracing* rayTracing = nullptr, const GpuTerrainHorizons* horizons = nullptr) {
+    TRACE_SCOPE("Encode scene");
+    const RenderView view = camera_render_view(cam);
+    render_queue_clear(scratch.queue);
+    render_queue_clear(scratch.prepass);
+
+    // Tessellated chunks are drawn as patches, so the other terrain paths skip them
+    const bool clipmapped = clipmap && pipelines.terrainClipmap;
+    const bool tessellated =
+        !clipmapped && tessellation && pipelines.terrainTessellated && !tessellation->chunks.empty();
+    const uint8_t* skip = tessellated ? tessellation->tessellated.data() : nullptr;
+    if (clipmapped) {
+        // The clipmap replaces every chunk
+    } else if (gpuCulling) {
+        // The visible count stays on the GPU; count what was submitted to the culler, which
+        // gpu_culling_encode already spared the fully fogged chunks
+        const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+        for (uint32_t i = 0; i < gpuCulling->drawCount; ++i) {
+            if (skip && skip[i]) {
+                continue;
+            }
+            const uint32_t indexCount = chunkManager.index_range(chunks[i]).count;
+            if (box_distance(chunks[i].bounds, cam.position) > fogDistance) {
+                frame_stats_count_fog_culled(frameStats, indexCount);
+            } else {
+                frame_stats_count_draw(frameStats, indexCount);
+            }
+        }
+    } else {
+        queue_chunks(scratch, chunkManager, pipelines, depthState, uniformRing, cullView ? cullView : &view, 1,
+                     fogDistance, skip, frameStats);
+    }
+
+    queue_scene_objects(scratch, scene, meshRegistry, pipelines, depthState, uniformRing, &view, 1, fogDistance,
+                        frameStats, cullView, occlusion);
+    if (foliage) {
+        queue_foliage(scratch, *foliage, meshRegistry, pipelines, depthState, frameStats);
+    }
+    if (skinning) {
+        queue_skinned(scratch, *skinning, pipelines, depthState, cullView ? *cullView : view, fogDistance, frameStats);
+    }
+
+    // Every encoder needs the frame uniforms, the scene argument buffer if it draws bindless chunks,
+    // the shadow map or acceleration structure, virtual texture, material atlas and sky view if the
+    // surfaces sample them, and the light clusters and shading cache if they or the lighting read them
+    const BindlessFrame* bindless =
+        !gpuCulling && !clipmapped && pipelines.terrainBindless ? &scratch.bindless : nullptr;
+    const FrameAllocation frame = frameUniforms;
+    void (^setup)(id<MTLRenderCommandEncoder>) = ^(id<MTLRenderCommandEncoder> enc) {
+        frame_uniforms_bind(frame, enc);
+        if (bindless) {
+            bindless_bind(*bindless, enc);
+        }
+        if (shadowMap) {
+            shadow_map_bind(*shadowMap, enc);
+        }
+        if (rayTracing) {
+            gpu_ray_tracing_bind(*rayTracing, enc);
+        }
+        if (virtualTexture) {
+            terrain_virtual_texture_bind(*virtualTexture, enc);
+        }
+        if (materials) {
+            gpu_terrain_materials_bind(*materials, enc);
+        }
+        if (horizons) {
+            gpu_terrain_horizons_bind(*horizons, enc);
+        }
+        if (sky) {
+            sky_bind(*sky, enc);
+        }
+        if (lightClusters) {
+            gpu_light_clusters_bind(*lightClusters, enc);
+        }
+        if (shadingCache) {
+            shading_cache_bind(*shadingCache, enc);
+        }
+        if (foliage) {
+            gpu_foliage_bind(*foliage, enc);
+        }
+        if (foliage && foliage->impostors) {
+            gpu_impostors_bind(foliage->atlas, enc);
+        }
+    };
+
+    // Without pipelines.sky the overdraw view is on, which leaves the uncovered pixels black
+    const Sky* drawnSky = pipelines.sky ? sky : nullptr;
+    RenderQueueStats queueStats;
+    if (encodeThreads > 1) {
+        id<MTLParallelRenderCommandEncoder> parallel = [cmd parallelRenderCommandEncoderWithDescriptor:passDesc];
+        queueStats = render_queue_submit_parallel(scratch.prepass, to_mtl(parallel), jobs, *scratch.arena,
+                                                  encodeThreads, [setup](MTL::RenderCommandEncoder* sliceEnc) {
+                                                      setup(to_objc(sliceEnc));
+                                                  });
+        if (gpuCulling) {
+            id<MTLRenderCommandEncoder> enc = [parallel renderCommandEncoder];
+            TRACE_PUSH_GROUP(enc, "GPU-culled chunks");
+            encode_culled_chunks(enc, pipelines, chunkManager, depthState, uniformRing, *gpuCulling, shadowMap,
+                                 materials, horizons, sky, shadingCache, *scratch.arena);
+            TRACE_POP_GROUP(enc);
+            [enc endEncoding];
+        }
+        if (tessellated) {
+            id<MTLRenderCommandEncoder> enc = [parallel renderCommandEncoder];
+            setup(enc);
+            TRACE_PUSH_GROUP(enc, "Tessellated terrain");
+            uint32_t patches = gpu_tessellation_draw(*tessellation, enc, pipelines.terrainTessellated, depthState,
+                                                     chunkManager);
+            TRACE_POP_GROUP(enc);
+            [enc endEncoding];
+            frame_stats_count_draw(frameStats, patches * 6);
+        }
+        if (clipmapped) {
+            id<MTLRenderCommandEncoder> enc = [parallel renderCommandEncoder];
+            setup(enc);
+            TRACE_PUSH_GROUP(enc, "Clipmap terrain");
+            const uint32_t indices = gpu_terrain_clipmap_draw(*clipmap, enc, pipelines.terrainClipmap, depthState);
+            TRACE_POP_GROUP(enc);
+            [enc endEncoding];
+            frame_stats_count_draw(frameStats, indices);
+        }
+        const RenderQueueStats sceneStats =
+            render_queue_submit_parallel(scratch.queue, to_mtl(parallel), jobs, *scratch.arena, encodeThreads,
+                                         [setup](MTL::RenderCommandEncoder* sliceEnc) { setup(to_objc(sliceEnc)); });
+        queueStats.stateChanges += sceneStats.stateChanges;
+        if (gbuffer || drawnSky) {
+            // Created after every surface encoder, so it executes last
+            id<MTLRenderCommandEncoder> enc = [parallel renderCommandEncoder];
+            setup(enc);
+            if (drawnSky) {
+                sky_encode(*drawnSky, enc, pipelines.sky, cam, frameStats);
+            }
+            if (gbuffer) {
+                deferred_encode_lighting(enc, pipelines.lighting, *gbuffer, cam, frameStats);
+            }
+            [enc endEncoding];
+        }
+        [parallel endEncoding];
+    } else {
+        id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+        if (gpuCulling) {
+            TRACE_PUSH_GROUP(enc, "GPU-culled chunks");
+            encode_culled_chunks(enc, pipelines, chunkManager, depthState, uniformRing, *gpuCulling, shadowMap,
+                                 materials, horizons, sky, shadingCache, *scratch.arena);
+            TRACE_POP_GROUP(enc);
+        }
+        setup(enc);
+        if (!scratch.prepass.commands.empty()) {
+            TRACE_PUSH_GROUP(enc, "Depth pre-pass");
+            queueStats = render_queue_submit(scratch.prepass, to_mtl(enc));
+            TRACE_POP_GROUP(enc);
+        }
+        if (tessellated) {
+            TRACE_PUSH_GROUP(enc, "Tessellated terrain");
+            uint32_t patches = gpu_tessellation_draw(*tessellation, enc, pipelines.terrainTessellated, depthState,
+                                                     chunkManager);
+            TRACE_POP_GROUP(enc);
+            frame_stats_count_draw(frameStats, patches * 6);
+        }
+        if (clipmapped) {
+            TRACE_PUSH_GROUP(enc, "Clipmap terrain");
+            const uint32_t indices = gpu_terrain_clipmap_draw(*clipmap, enc, pipelines.terrainClipmap, depthState);
+            TRACE_POP_GROUP(enc);
+            frame_stats_count_draw(frameStats, indices);
+        }
+        queueStats.stateChanges += render_queue_submit(scratch.queue, to_mtl(enc)).stateChanges;
+        // After the surfaces, so the depth test rejects every covered pixel before the sky shades it
+        if (drawnSky) {
+            sky_encode(*drawnSky, enc, pipelines.sky, cam, frameStats);
+        }
+        if (gbuffer) {
+            deferred_encode_lighting(enc, pipelines.lighting, *gbuffer, cam, frameStats);
+        }
+        [enc endEncoding];
+    }
+    frameStats.current.stateChanges += queueStats.stateChanges;
+}
+
+// The amplified variants of the forward terrain and instanced pipelines, lit like the main view but
+// without shadows or MSAA. Nil terrain when the chunks are height maps, which have no multi-view variant.
+// With sceneInstances the entities are read from that GpuSceneInstances::buffer. Variants an option
+// toggle asks for compile off the main thread and stay nil until they are built, so their draws skip.
+ScenePipelines multi_view_pipelines(MetalContext& metal, const ChunkManager& chunkManager, const SceneShading& shading,
+                                    id<MTLBuffer> sceneInstances = nil) {
+    ShaderVariant instanced;
+    instanced.program = ShaderProgram::Instanced;
+    instanced.lighting = shading.lighting;
+    instanced.fog = shading.fog;
+    instanced.farFade = shading.farFade;
+    instanced.multiView = true;
+    instanced.indexedInstances = sceneInstances != nil;
+
+    ShaderVariant terrain = instanced;
+    terrain.program = ShaderProgram::Landscape;
+    terrain.vertexFormat = chunkManager.config().vertexFormat;
+
+    ScenePipelines pipelines;
+    pipelines.terrain = chunkManager.config().heightMaps ? nil : metal_request_pipeline(metal, terrain);
+    pipelines.instanced = metal_request_pipeline(metal, instanced);
+    pipelines.sceneInstances = sceneInstances;
+    return pipelines;
+}
+
+// Renders several views of the terrain and scene objects into the slices of a layered pass. Each
+// group of views the device amplifies to is culled against the union of their frustums and queued
+// once, so every object is submitted once per group rather than once per view.
+void encode_multi_view(id<MTLCommandBuffer> cmd, MTLRenderPassDescriptor* passDesc, const RenderView* views,
+                       uint32_t viewCount, uint32_t amplification, const ScenePipelines& pipelines,
+                       const ChunkManager& chunkManager, const MeshRegistry& meshRegistry, const SceneStore& scene,
+                       id<MTLDepthStencilState> depthState, FrameRing& uniformRing, const FogSettings& fog,
+                       float fogDistance, SceneScratch& scratch, FrameStats& frameStats) {
+    TRACE_SCOPE("Encode multi-view");
+    MultiViewGroup groups[MULTI_VIEW_MAX_VIEWS];
+    const uint32_t groupCount = multi_view_groups(std::min(viewCount, MULTI_VIEW_MAX_VIEWS), amplification, groups);
+
+    frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Multi-view"));
+    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+    enc.label = @"Multi-view";
+    for (uint32_t g = 0; g < groupCount; ++g) {
+        const RenderView* group = views + groups[g].first;
+        const float groupFogDistance = multi_view_fog_distance(group, groups[g].count, fogDistance);
+
+        render_queue_clear(scratch.queue);
+        if (pipelines.terrain) {
+            queue_chunks(scratch, chunkManager, pipelines, depthState, uniformRing, group, groups[g].count,
+                         groupFogDistance, nullptr, frameStats);
+        }
+        if (pipelines.instanced) {
+            queue_scene_objects(scratch, scene, meshRegistry, pipelines, depthState, uniformRing, group,
+                                groups[g].count, groupFogDistance, frameStats);
+        }
+
+        multi_view_bind_group(enc, views, groups[g], write_view_uniforms(uniformRing, group, groups[g].count, fog));
+        frameStats.current.stateChanges += render_queue_submit(scratch.queue, to_mtl(enc)).stateChanges;
+    }
+    [enc endEncoding];
+}
+
+// Leaves half the cores to the chunk workers and the GPU driver
+uint32_t default_encode_threads() {
+    return std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+}
+
+void write_summary_json(FILE* out, const char* name, const FrameTimeSummary& summary) {
+    fprintf(out, "  \"%s\": { \"count\": %zu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+                 "\"max\": %.4f, \"spikes\": %zu }",
+            name, summary.count, summary.mean, summary.p50, summary.p95, summary.p99, summary.max, summary.spikes);
+}
+
+// Every sample of a series, for perf_gate to test against a baseline
+void write_samples_json(FILE* out, const char* name, const std::vector<float>& ms) {
+    fprintf(out, "    \"%s\": [", name);
+    for (size_t i = 0; i < ms.size(); ++i) {
+        fprintf(out, i ? ", %.4f" : "%.4f", ms[i]);
+    }
+    fprintf(out, "]");
+}
+
+// One widget per knob, grouped by section; edits are staged and land with the next frame's apply()
+void draw_tuning_panel(TuningRegistry& tuning, const std::string& path, std::string& status) {
+    ImGui::Begin("Tuning");
+    const char* group = nullptr;
+    bool open = false;
+    for (uint32_t i = 0; i < tuning.size(); ++i) {
+        const Tunable& tunable = tuning[i];
+        if (!group || tunable.group != group) {
+            group = tunable.group.c_str();
+            open = ImGui::CollapsingHeader(group, ImGuiTreeNodeFlags_DefaultOpen);
+        }
+        if (!open) {
+            continue;
+        }
+        const std::string label = tunable.startup ? tunable.name + " (next run)" : tunable.name;
+        if (tunable.type == TunableType::Float) {
+            float value = (float)tunable.value;
+            if (ImGui::SliderFloat(label.c_str(), &value, (float)tunable.min, (float)tunable.max, "%.3g")) {
+                tuning.set(i, value);
+            }
+        } else if (tunable.type == TunableType::Int) {
+            int value = (int)tunable.value;
+            if (ImGui::SliderInt(label.c_str(), &value, (int)tunable.min, (int)tunable.max)) {
+                tuning.set(i, value);
+            }
+        } else {
+            bool value = tunable.value != 0.0;
+            if (ImGui::Checkbox(label.c_str(), &value)) {
+                tuning.set(i, value ? 1.0 : 0.0);
+            }
+        }
+    }
+    ImGui::Separator();
+    if (ImGui::Button("Save")) {
+        status = tuning.save(path.c_str()) ? "Saved " + path : "Cannot write " + path;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load")) {
+        std::string error;
+        status = tuning.load(path.c_str(), error) ? "Loaded " + path : error;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Defaults")) {
+        tuning.reset();
+    }
+    if (!status.empty()) {
+        ImGui::TextUnformatted(status.c_str());
+    }
+    ImGui::End();
+}
+
+// Evaluates every noise configuration and its derivatives on the GPU and compares them with the CPU
+// batch paths. Every field must match bit for bit, the cosine interpolant's polynomial included.
+int run_noise_check() {
+    MetalContext metal = create_metal_context();
+    if (!metal.library) {
+        return 1;
+    }
+    if (!metal.noise_pipeline) {
+        fprintf(stderr, "Noise check: evaluate_noise failed to compile\n");
+        return 1;
+    }
+
+    const uint32_t count = 1 << 16;
+    id<MTLBuffer> points = [metal.device newBufferWithLength:count * sizeof(simd::float2)
+                                                     options:MTLResourceStorageModeShared];
+    id<MTLBuffer> values = [metal.device newBufferWithLength:count * sizeof(float)
+                                                     options:MTLResourceStorageModeShared];
+    id<MTLBuffer> derivatives = [metal.device newBufferWithLength:count * sizeof(simd::float2)
+                                                          options:MTLResourceStorageModeShared];
+    simd::float2* p = (simd::float2*)points.contents;
+    std::vector<float> xs(count), zs(count), expected(count);
+    std::vector<NoiseSample> expectedSamples(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        // Spread over positive and negative lattice cells, including far from the origin
+        xs[i] = ((float)(i % 256) - 128.0f) * 0.731f + (float)(i / 4096) * 97.0f;
+        zs[i] = ((float)(i / 256 % 256) - 128.0f) * 0.413f - (float)(i / 8192) * 211.0f;
+        p[i] = { xs[i], zs[i] };
+    }
+
+    int failures = 0;
+    for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+        for (NoiseInterpolation interpolation : { NoiseInterpolation::Smoothstep, NoiseInterpolation::Cosine }) {
+            if (basis != NoiseBasis::Value && interpolation == NoiseInterpolation::Cosine) {
+                continue; // Only value noise interpolates
+            }
+            for (float warp : { 0.0f, 0.8f }) {
+                const NoiseSettings settings = { 1, basis, interpolation, warp };
+                fractal_noise_batch(xs.data(), zs.data(), expected.data(), count, settings);
+                fractal_noise_sample_batch(xs.data(), zs.data(), expectedSamples.data(), count, settings);
+
+                id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+                id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+                [enc setComputePipelineState:metal.noise_pipeline];
+                [enc setBytes:&settings length:sizeof(settings) atIndex:0];
+                [enc setBuffer:points offset:0 atIndex:1];
+                [enc setBuffer:values offset:0 atIndex:2];
+                [enc setBytes:&count length:sizeof(count) atIndex:3];
+                [enc setBuffer:derivatives offset:0 atIndex:4];
+                [enc dispatchThreads:MTLSizeMake(count, 1, 1) threadsPerThreadgroup:MTLSizeMake(64, 1, 1)];
+                [enc endEncoding];
+                [cmd commit];
+                [cmd waitUntilCompleted];
+
+                const float* gpu = (const float*)values.contents;
+                const simd::float2* gpuDerivatives = (const simd::float2*)derivatives.contents;
+                uint32_t mismatches = 0;
+                uint32_t derivativeMismatches = 0;
+                float maxError = 0.0f;
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (gpu[i] != expected[i]) {
+                        ++mismatches;
+                        maxError = std::max(maxError, fabsf(gpu[i] - expected[i]));
+                    }
+                    const NoiseSample& sample = expectedSamples[i];
+                    if (sample.value != expected[i] || gpuDerivatives[i].x != sample.dx ||
+                        gpuDerivatives[i].y != sample.dz) {
+                        ++derivativeMismatches;
+                    }
+                }
+                const bool smooth = interpolation == NoiseInterpolation::Smoothstep;
+                printf("basis %u, %s, warp %.1f: %u of %u differ (max %g), %u derivatives differ\n",
+                       (uint32_t)basis, smooth ? "smoothstep" : "cosine", warp, mismatches, count, maxError,
+                       derivativeMismatches);
+                failures += mismatches > 0 || derivativeMismatches > 0;
+            }
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
+
+// Replays a camera path into an offscreen target and reports frame time percentiles as JSON
+int run_benchmark(const char* pathFile, const char* outputFile, uint32_t encodeThreads, bool deferred,
+                  uint32_t sampleCount, bool bakedMaterials, bool vertexLighting, bool depthPrepass, bool frontToBack,
+                  const ChunkManagerConfig& chunkConfig, bool reverseZ, bool residencySets,
+                  const StressSceneSettings& stress) {
+    CameraPath path;
+    std::string error;
+    if (!load_camera_path(pathFile, path, error)) {
+        fprintf(stderr, "Benchmark: %s\n", error.c_str());
+        return 1;
+    }
+
+    MetalContext metal = create_metal_context();
+    if (!metal.library) {
+        return 1;
+    }
+    HeightField heightField = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f, chunkConfig.terrain);
+    JobSystem jobs;
+    ResourceUploader uploader(metal.device, DEFAULT_STAGING_CAPACITY, chunkConfig.uploads);
+    MeshRegistry meshRegistry;
+    TransformGraph transformGraph;
+    std::unique_ptr<AssetLoader> assets;
+    if (asset_loader_supported(metal.device)) {
+        assets = std::make_unique<AssetLoader>(metal.device);
+    }
+    // Declared before the chunk manager, whose streaming jobs may add heaps to it until it is destroyed
+    std::unique_ptr<GpuResidency> residency;
+    if (residencySets && residency_sets_supported(metal.device)) {
+        residency = std::make_unique<GpuResidency>(metal.device, 1024);
+    }
+    if (chunkConfig.erosion.iterations > 0) {
+        metal_erosion_pipelines(metal);
+    }
+    ChunkManager chunkManager(metal, uploader, jobs, chunkConfig, assets.get());
+    if (chunkConfig.erosion.iterations > 0) {
+        chunkManager.resample_height_field(heightField);
+    }
+    const uint32_t maxChunks = (uint32_t)chunkManager.max_resident_chunks();
+    std::unique_ptr<GpuFoliage> foliage;
+    if (gpu_foliage_supported(metal)) {
+        foliage = std::make_unique<GpuFoliage>(create_gpu_foliage(metal, maxChunks));
+    }
+    SceneStore scene = create_scene_objects(uploader, meshRegistry, heightField, transformGraph, !foliage,
+                                            chunkManager.config());
+    if (stress.objects > 0) {
+        add_stress_objects(scene, transformGraph, meshRegistry, stress, chunkManager.config());
+    }
+    const uint64_t staticUploads = uploader.flush();
+    std::unique_ptr<ShadowMap> shadowMap;
+    if (shadow_map_supported(metal)) {
+        shadowMap = std::make_unique<ShadowMap>(create_shadow_map(metal, chunkManager.config().vertexFormat));
+    }
+
+    // A stress scene's point lights, spread over its square and binned into view clusters every frame
+    std::unique_ptr<GpuLightClusters> lightClusters;
+    std::vector<LightEmitter> lightEmitters;
+    std::vector<PointLight> pointLights;
+    if (stress.lights > 0 && gpu_light_clusters_supported(metal)) {
+        lightClusters = std::make_unique<GpuLightClusters>(create_gpu_light_clusters(metal));
+        lightEmitters = scatter_light_emitters(stress.lights, { 0.0f, 0.0f }, 0.5f * stress.worldSize, stress.seed,
+                                               [&](float x, float z) { return chunkManager.terrain_height(x, z); });
+        pointLights.resize(stress.lights);
+    }
+
+    FrameRing uniformRing =
+        create_frame_ring(metal.device, scene_frame_bytes(maxChunks, meshRegistry, scene.size(), ShadowSettings{}) +
+                                            (lightClusters ? gpu_light_clusters_frame_bytes() : 0));
+
+    id<MTLDepthStencilState> depthState = create_depth_state(metal.device, reverseZ);
+    id<MTLTexture> colorTexture = create_render_target(metal.device, MTLPixelFormatBGRA8Unorm, path.width, path.height);
+
+    // Culled chunks are drawn from their LOD ranges, which height-map and volumetric chunks do not have,
+    // and as in the interactive view they are not culled on the GPU while point lights shade
+    std::unique_ptr<GpuCulling> gpuCulling;
+    if (gpu_culling_supported(metal) && !chunkConfig.heightMaps && !chunkConfig.volume.enabled && !lightClusters) {
+        gpuCulling = std::make_unique<GpuCulling>(create_gpu_culling(metal, maxChunks, path.width, path.height));
+    }
+    TransientTarget depthTarget = create_transient_target(metal.device, MTLPixelFormatDepth32Float, path.width,
+                                                          path.height,
+                                                          MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead,
+                                                          @"Depth");
+    id<MTLTexture> depthTexture = transient_target_texture(depthTarget, gpuCulling != nullptr);
+    std::unique_ptr<GpuTerrainMaterials> materials;
+    if (bakedMaterials && gpu_terrain_materials_supported(metal, chunkConfig)) {
+        materials = std::make_unique<GpuTerrainMaterials>(create_gpu_terrain_materials(metal, chunkConfig));
+    }
+
+    Camera cam = make_camera(path.width, path.height, reverseZ);
+    fit_camera_to_world(cam, chunkConfig);
+    const float projectionScale = path.height / (2.0f * tanf(M_PI / 6.0f));
+    const float duration = camera_path_duration(path);
+    const float dt = duration / path.frames;
+
+    // Stream in everything around the start pose so the first measured frames are not empty
+    apply_camera_pose(cam, sample_camera_path(path, 0.0f), 0.0f);
+    FrameArenas frameArenas = create_scene_arenas(jobs);
+    uint32_t arenaFrame = 0;
+    do {
+        frame_arenas_begin_frame(frameArenas, arenaFrame++);
+        uploader.begin_frame();
+        chunkManager.update(cam.position, frame_arena(frameArenas));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (chunkManager.pending_count() > 0);
+    frame_arenas_begin_frame(frameArenas, arenaFrame++);
+    uploader.begin_frame();
+    chunkManager.update(cam.position, frame_arena(frameArenas));
+
+    FrameStats frameStats;
+    std::unique_ptr<GpuProfiler> profiler;
+    if (gpu_profiler_supported(metal.device)) {
+        profiler = std::make_unique<GpuProfiler>(create_gpu_profiler(metal.device));
+    }
+    SceneScratch scratch;
+    if (residency) {
+        use_residency_set(*residency, metal, chunkManager, meshRegistry, uniformRing, gpuCulling.get(), scratch);
+    }
+    if (sampleCount > 1 && !msaa_supported(metal.device, sampleCount)) {
+        fprintf(stderr, "Benchmark: %ux MSAA is not supported, rendering without it\n", sampleCount);
+        sampleCount = 1;
+    }
+    MsaaTargets msaa;
+    if (sampleCount > 1) {
+        msaa_resize(msaa, metal.device, sampleCount, path.width, path.height);
+    }
+    std::unique_ptr<GBuffer> gbuffer;
+    if (deferred && deferred_supported(metal.device)) {
+        gbuffer = std::make_unique<GBuffer>(create_gbuffer(metal.device, reverseZ));
+        gbuffer_resize(*gbuffer, metal.device, path.width, path.height, sampleCount);
+    }
+    SceneShading shading;
+    shading.shadows = shadowMap != nullptr;
+    shading.deferred = gbuffer != nullptr;
+    shading.sampleCount = sampleCount;
+    shading.meshlets = meshlet_draw_supported(metal.device);
+    shading.bakedMaterials = materials != nullptr;
+    shading.vertexLighting = vertexLighting && !shading.deferred;
+    shading.depthPrepass = depthPrepass;
+    shading.pointLights = lightClusters != nullptr;
+    scratch.queue.frontToBack = frontToBack;
+    const ScenePipelines pipelines = scene_pipelines(metal, chunkManager, shading);
+    const FogSettings fog = active_fog(scene_fog(chunkConfig), shading);
+    const float fogDistance = fog_cull_distance(fog);
+    std::vector<float> cpuMs;
+    std::vector<float> gpuMs(path.frames, -1.0f);
+    cpuMs.reserve(path.frames);
+    // The phases a benchmark frame runs; input and ImGui never do
+    const FramePhase phases[] = { PHASE_CAMERA, PHASE_STREAMING, PHASE_WAIT, PHASE_ENCODE, PHASE_SUBMIT };
+    std::vector<float> phaseMs[PHASE_COUNT];
+    uint64_t firstMeasuredFrame = 0;
+    float* gpuSlots = gpuMs.data();
+    uint64_t drawCalls = 0;
+    uint64_t triangles = 0;
+    uint64_t stateChanges = 0;
+    uint64_t heapAllocations = 0;
+    // Pop-in: chunks in view that were not resident when the frame was drawn
+    uint64_t missingChunks = 0;
+    size_t maxMissingChunks = 0;
+    int framesWithHoles = 0;
+    const size_t cancelledBefore = chunkManager.cancelled_requests();
+    // Throttled uploads: bytes committed per frame and the deepest the queue got
+    uint64_t uploadBytes = 0;
+    UploadQueueStats deepestUploads;
+    simd::float3 streamedPosition = cam.position;
+    id<MTLCommandBuffer> lastCmd = nil;
+
+    MTLRenderPassDescriptor* scenePass = [MTLRenderPassDescriptor new];
+    for (int i = 0; i < path.warmupFrames + path.frames; ++i) {
+        const int measured = i - path.warmupFrames;
+        const float time = measured < 0 ? 0.0f : duration * measured / std::max(path.frames - 1, 1);
+
+        frame_stats_begin_frame(frameStats);
+        if (measured == 0) {
+            firstMeasuredFrame = frameStats.current.frame;
+        }
+        frame_arenas_begin_frame(frameArenas, arenaFrame++);
+        scratch.arena = &frame_arena(frameArenas);
+        apply_camera_pose(cam, sample_camera_path(path, time), dt);
+        frame_stats_end_phase(frameStats, PHASE_CAMERA);
+
+        const uint64_t allocationsBefore = heap_allocation_count();
+        const ChunkStreamingView view =
+            chunk_streaming_view(cam.position, streamedPosition, dt, cam.projectionMatrix * cam.viewMatrix);
+        streamedPosition = cam.position;
+        uploader.begin_frame();
+        chunkManager.update(view, *scratch.arena, fogDistance);
+        if (residency) {
+            residency->commit();
+        }
+        chunkManager.update_lods(cam.position, projectionScale, *scratch.arena);
+        transform_graph_update(transformGraph, scene);
+        scene_update_bounds(scene);
+        frame_stats_end_phase(frameStats, PHASE_STREAMING);
+
+        frame_ring_begin_frame(uniformRing);
+        frame_stats_end_phase(frameStats, PHASE_WAIT);
+
+        @autoreleasepool {
+            id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+            uploader.encode_wait(cmd, staticUploads);
+            gpu_profiler_begin_frame(profiler.get(), frameStats.current.frame);
+            const GpuMesh& cube = meshRegistry.meshes[mesh_registry_primitive(meshRegistry, Primitive::Cube)];
+            if (foliage) {
+                gpu_foliage_encode(*foliage, cmd, chunkManager, uniformRing, cam, cube, *scratch.arena);
+            }
+            if (shadowMap) {
+                shadow_map_encode(*shadowMap, cmd, chunkManager, uniformRing, cam, foliage.get(), cube, nullptr,
+                                  frameStats, profiler.get());
+            }
+            if (materials) {
+                gpu_terrain_materials_encode(*materials, cmd, chunkManager);
+            }
+            if (lightClusters) {
+                const float streamed = chunkConfig.loadRadius * chunkConfig.chunkSize;
+                light_emitters_evaluate(lightEmitters.data(), stress.lights, time, pointLights.data());
+                gpu_light_clusters_encode(*lightClusters, cmd, uniformRing, cam, path.width, path.height,
+                                          std::min(streamed, fogDistance), pointLights.data(), stress.lights);
+            }
+            const FrameAllocation frameUniforms = write_frame_uniforms(uniformRing, cam, fog);
+            if (gpuCulling) {
+                gpu_culling_encode(*gpuCulling, cmd, chunkManager, uniformRing, cam, frameUniforms, fogDistance,
+                                   shadowMap ? &shadowMap->uniforms : nullptr, nullptr,
+                                   materials ? materials->uniforms : nil);
+            }
+            MTLRenderPassDescriptor* passDesc =
+                make_scene_pass(scenePass, colorTexture, depthTexture, gpuCulling != nullptr,
+                                camera_clear_depth(cam));
+            if (gbuffer) {
+                gbuffer_attach(*gbuffer, passDesc);
+            }
+            if (sampleCount > 1) {
+                msaa_attach(msaa, passDesc, reverseZ);
+            }
+            frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Scene"));
+            gpu_profiler_sample_pass(profiler.get(), passDesc, GPU_PASS_SCENE);
+            encode_scene(cmd, passDesc, pipelines, chunkManager, meshRegistry, scene, depthState, uniformRing, cam,
+                         frameUniforms, fogDistance, scratch, gpuCulling.get(), foliage.get(), nullptr, nullptr,
+                         shadowMap.get(), nullptr, materials.get(), nullptr, lightClusters.get(), nullptr,
+                         gbuffer.get(), jobs, encodeThreads, frameStats);
+            if (gpuCulling) {
+                gpu_culling_update_hiz(*gpuCulling, cmd, depthTexture, cam);
+            }
+            frame_stats_end_phase(frameStats, PHASE_ENCODE);
+            check_frame_allocations(frameStats, allocationsBefore);
+
+            if (measured >= 0) {
+                [cmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+                    gpuSlots[measured] = (completed.GPUEndTime - completed.GPUStartTime) * 1000.0;
+                }];
+            }
+            gpu_profiler_end_frame(profiler.get(), cmd, frameStats);
+            frame_ring_end_frame(uniformRing, cmd);
+            frame_latency_track_commit(frameStats, frameStats.current.frame, cmd);
+            [cmd commit];
+            lastCmd = cmd;
+            frame_stats_end_phase(frameStats, PHASE_SUBMIT);
+        }
+
+        frame_stats_end_frame(frameStats);
+        if (measured >= 0) {
+            cpuMs.push_back(frameStats.current.cpuMs);
+            for (FramePhase phase : phases) {
+                phaseMs[phase].push_back(frameStats.current.phaseMs[phase]);
+            }
+            drawCalls += frameStats.current.drawCalls;
+            triangles += frameStats.current.triangles;
+            stateChanges += frameStats.current.stateChanges;
+            heapAllocations += frameStats.current.heapAllocations;
+            const size_t missing = chunkManager.missing_visible_chunks(view, fogDistance);
+            missingChunks += missing;
+            maxMissingChunks = std::max(maxMissingChunks, missing);
+            framesWithHoles += missing > 0;
+            const UploadQueueStats uploads = uploader.queue_stats();
+            uploadBytes += uploads.frameBytes;
+            if (uploads.queuedBytes > deepestUploads.queuedBytes) {
+                deepestUploads = uploads;
+            }
+        }
+    }
+    [lastCmd waitUntilCompleted];
+    // Pass times are only kept for the last FRAME_STATS_HISTORY frames, so longer paths sample their end
+    std::vector<float> gpuPassMs[GPU_PASS_COUNT];
+    for (const FrameSample& sample : frame_stats_history(frameStats)) {
+        for (int p = 0; p < GPU_PASS_COUNT && sample.hasGpuPasses && sample.frame >= firstMeasuredFrame; ++p) {
+            gpuPassMs[p].push_back(sample.gpuPassMs[p]);
+        }
+    }
+
+    FILE* out = outputFile ? fopen(outputFile, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Benchmark: cannot write %s\n", outputFile);
+        return 1;
+    }
+    fprintf(out, "{\n  \"path\": \"%s\",\n  \"device\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n"
+                 "  \"frames\": %d,\n  \"encode_threads\": %u,\n  \"deferred\": %s,\n  \"msaa\": %u,\n"
+                 "  \"height_maps\": %s,\n  \"baked_materials\": %s,\n  \"vertex_lighting\": %s,\n"
+                 "  \"depth_prepass\": %s,\n  \"front_to_back\": %s,\n"
+                 "  \"residency_sets\": %s,\n  \"terrain_bytes\": %zu,\n",
+            pathFile, metal.device.name.UTF8String, path.width, path.height, path.frames, encodeThreads,
+            gbuffer ? "true" : "false", sampleCount, chunkConfig.heightMaps ? "true" : "false",
+            materials ? "true" : "false", shading.vertexLighting ? "true" : "false",
+            depthPrepass ? "true" : "false", frontToBack ? "true" : "false", residency ? "true" : "false",
+            chunkManager.resident_bytes());
+    // What a stress run loaded the scene with, so the reports of a sweep can be ordered by it
+    if (stress.objects > 0 || stress.lights > 0) {
+        fprintf(out, "  \"stress\": { \"objects\": %u, \"lights\": %u, \"world_size\": %.1f, \"entities\": %zu },\n",
+                stress.objects, lightClusters ? stress.lights : 0, stress.worldSize, scene.size());
+    }
+    write_summary_json(out, "cpu_ms", summarize_frame_times(cpuMs));
+    fprintf(out, ",\n");
+    write_summary_json(out, "gpu_ms", summarize_frame_times(gpuMs));
+    // Nothing is presented, so only the command buffer's latencies; a queue latency that grows over the
+    // run means the CPU got ahead of the GPU and frames waited in the queue
+    for (FrameLatency latency : { LATENCY_SCHEDULE, LATENCY_QUEUE }) {
+        fprintf(out, ",\n");
+        write_summary_json(out, (std::string(frame_latency_name(latency)) + "_latency_ms").c_str(),
+                           frame_stats_summarize_latency(frameStats, latency, firstMeasuredFrame));
+    }
+    fprintf(out, ",\n  \"avg_draw_calls\": %.1f,\n  \"avg_state_changes\": %.1f,\n  \"avg_triangles\": %.1f",
+            (double)drawCalls / path.frames, (double)stateChanges / path.frames, (double)triangles / path.frames);
+    fprintf(out, ",\n  \"pop_in\": { \"frames_with_holes\": %d, \"avg_missing_chunks\": %.2f, "
+                 "\"max_missing_chunks\": %zu, \"cancelled_requests\": %zu }",
+            framesWithHoles, (double)missingChunks / path.frames, maxMissingChunks,
+            chunkManager.cancelled_requests() - cancelledBefore);
+    fprintf(out, ",\n  \"uploads\": { \"avg_bytes_per_frame\": %.0f, \"max_queued_batches\": %zu, "
+                 "\"max_queued_bytes\": %zu }",
+            (double)uploadBytes / path.frames, deepestUploads.queuedBatches, deepestUploads.queuedBytes);
+    // A run that ended throttled measured a slower machine than it started on
+    const PowerState power = current_power_state();
+    fprintf(out, ",\n  \"thermal_state\": \"%s\",\n  \"low_power_mode\": %s", thermal_state_name(power.thermal),
+            power.lowPower ? "true" : "false");
+    if (HEAP_ALLOCATION_TRACKING) {
+        fprintf(out, ",\n  \"heap_allocations\": %llu", (unsigned long long)heapAllocations);
+    }
+    fprintf(out, ",\n  \"samples\": {\n");
+    write_samples_json(out, "cpu_ms", cpuMs);
+    fprintf(out, ",\n");
+    write_samples_json(out, "gpu_ms", gpuMs);
+    for (FramePhase phase : phases) {
+        fprintf(out, ",\n");
+        write_samples_json(out, (std::string(frame_phase_name(phase)) + "_cpu_ms").c_str(), phaseMs[phase]);
+    }
+    for (int p = 0; p < GPU_PASS_COUNT; ++p) {
+        if (!gpuPassMs[p].empty()) {
+            fprintf(out, ",\n");
+            write_samples_json(out, (std::string(gpu_pass_name((GpuPass)p)) + "_gpu_ms").c_str(), gpuPassMs[p]);
+        }
+    }
+    fprintf(out, "\n  }\n}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
+
+// Renders every keyframe of a camera path as a still image, with no window or display
+int run_headless(const char* viewsFile, const char* outputDir, uint32_t encodeThreads, bool deferred,
+                 uint32_t sampleCount, const ChunkManagerConfig& chunkConfig, bool reverseZ) {
+    CameraPath views;
+    std::string error;
+    if (!load_camera_path(viewsFile, views, error)) {
+        fprintf(stderr, "Headless: %s\n", error.c_str());
+        return 1;
+    }
+
+    MetalContext metal = create_metal_context();
+    if (!metal.library) {
+        return 1;
+    }
+    HeightField heightField = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f, chunkConfig.terrain);
+    JobSystem jobs;
+    ResourceUploader uploader(metal.device, DEFAULT_STAGING_CAPACITY, chunkConfig.uploads);
+    MeshRegistry meshRegistry;
+    TransformGraph transformGraph;
+    std::unique_ptr<AssetLoader> assets;
+    if (asset_loader_supported(metal.device)) {
+        assets = std::make_unique<AssetLoader>(metal.device);
+    }
+    if (chunkConfig.erosion.iterations > 0) {
+        metal_erosion_pipelines(metal);
+    }
+    ChunkManager chunkManager(metal, uploader, jobs, chunkConfig, assets.get());
+    if (chunkConfig.erosion.iterations > 0) {
+        chunkManager.resample_height_field(heightField);
+    }
+    const uint32_t maxChunks = (uint32_t)chunkManager.max_resident_chunks();
+    std::unique_ptr<GpuFoliage> foliage;
+    if (gpu_foliage_supported(metal)) {
+        foliage = std::make_unique<GpuFoliage>(create_gpu_foliage(metal, maxChunks));
+    }
+    SceneStore scene = create_scene_objects(uploader, meshRegistry, heightField, transformGraph, !foliage,
+                                            chunkManager.config());
+    const uint64_t staticUploads = uploader.flush();
+    std::unique_ptr<ShadowMap> shadowMap;
+    if (shadow_map_supported(metal)) {
+        shadowMap = std::make_unique<ShadowMap>(create_shadow_map(metal, chunkManager.config().vertexFormat));
+    }
+
+    FrameRing uniformRing =
+        create_frame_ring(metal.device, scene_frame_bytes(maxChunks, meshRegistry, scene.size(), ShadowSettings{}));
+    id<MTLDepthStencilState> depthState = create_depth_state(metal.device, reverseZ);
+
+    // One target per in-flight frame: the GPU renders views while the CPU encodes the next and saves the oldest.
+    // GPU culling is left out, since its Hi-Z comes from the previous frame and views need not be related
+    std::vector<OffscreenTarget> targets;
+    for (uint32_t i = 0; i < DEFAULT_FRAMES_IN_FLIGHT; ++i) {
+        targets.push_back(create_offscreen_target(metal.device, views.width, views.height));
+    }
+    std::vector<std::string> filenames(targets.size());
+
+    if (sampleCount > 1 && !msaa_supported(metal.device, sampleCount)) {
+        fprintf(stderr, "Headless: %ux MSAA is not supported, rendering without it\n", sampleCount);
+        sampleCount = 1;
+    }
+    MsaaTargets msaa;
+    if (sampleCount > 1) {
+        msaa_resize(msaa, metal.device, sampleCount, views.width, views.height);
+    }
+    std::unique_ptr<GBuffer> gbuffer;
+    if (deferred && deferred_supported(metal.device)) {
+        gbuffer = std::make_unique<GBuffer>(create_gbuffer(metal.device, reverseZ));
+        gbuffer_resize(*gbuffer, metal.device, views.width, views.height, sampleCount);
+    }
+    SceneShading shading;
+    shading.shadows = shadowMap != nullptr;
+    shading.deferred = gbuffer != nullptr;
+    shading.sampleCount = sampleCount;
+    shading.meshlets = meshlet_draw_supported(metal.device);
+    const ScenePipelines pipelines = scene_pipelines(metal, chunkManager, shading);
+    const FogSettings fog = active_fog(scene_fog(chunkConfig), shading);
+    const float fogDistance = fog_cull_distance(fog);
+
+    Camera cam = make_camera(views.width, views.height, reverseZ);
+    fit_camera_to_world(cam, chunkConfig);
+    const float projectionScale = views.height / (2.0f * tanf(M_PI / 6.0f));
+    FrameArenas frameArenas = create_scene_arenas(jobs);
+    uint32_t arenaFrame = 0;
+    FrameStats frameStats;
+    SceneScratch scratch;
+    int failures = 0;
+    auto save = [&](size_t slot) {
+        if (targets[slot].pending && !offscreen_target_save(targets[slot], filenames[slot].c_str(), error)) {
+            fprintf(stderr, "Headless: %s: %s\n", filenames[slot].c_str(), error.c_str());
+            ++failures;
+        }
+    };
+
+    MTLRenderPassDescriptor* scenePass = [MTLRenderPassDescriptor new];
+    for (size_t view = 0; view < views.keyframes.size(); ++view) {
+        frame_stats_begin_frame(frameStats);
+        frame_arenas_begin_frame(frameArenas, arenaFrame++);
+        scratch.arena = &frame_arena(frameArenas);
+        apply_camera_pose(cam, views.keyframes[view], 0.0f);
+
+        // A view away from the previous ones streams its chunks in before it renders. The views in
+        // flight finish first, as the updates while waiting could reuse buffers they still read
+        uploader.begin_frame();
+        chunkManager.update(cam.position, *scratch.arena, fogDistance);
+        if (chunkManager.pending_count() > 0) {
+            for (size_t slot = 0; slot < targets.size(); ++slot) {
+                save(slot);
+            }
+            while (chunkManager.pending_count() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                frame_arenas_begin_frame(frameArenas, arenaFrame++);
+                scratch.arena = &frame_arena(frameArenas);
+                uploader.begin_frame();
+                chunkManager.update(cam.position, *scratch.arena, fogDistance);
+            }
+        }
+        chunkManager.update_lods(cam.position, projectionScale, *scratch.arena);
+        transform_graph_update(transformGraph, scene);
+        scene_update_bounds(scene);
+
+        const size_t slot = view % targets.size();
+        save(slot);
+        char filename[32];
+        snprintf(filename, sizeof(filename), "/view_%04zu.tga", view);
+        filenames[slot] = std::string(outputDir) + filename;
+        OffscreenTarget& target = targets[slot];
+
+        frame_ring_begin_frame(uniformRing);
+        @autoreleasepool {
+            id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+            uploader.encode_wait(cmd, staticUploads);
+            const GpuMesh& cube = meshRegistry.meshes[mesh_registry_primitive(meshRegistry, Primitive::Cube)];
+            if (foliage) {
+                gpu_foliage_encode(*foliage, cmd, chunkManager, uniformRing, cam, cube, *scratch.arena);
+            }
+            if (shadowMap) {
+                shadow_map_encode(*shadowMap, cmd, chunkManager, uniformRing, cam, foliage.get(), cube, nullptr,
+                                  frameStats, nullptr);
+            }
+            const FrameAllocation frameUniforms = write_frame_uniforms(uniformRing, cam, fog);
+            MTLRenderPassDescriptor* passDesc =
+                make_scene_pass(scenePass, target.color, transient_target_texture(target.depth, false), false,
+                                camera_clear_depth(cam));
+            if (gbuffer) {
+                gbuffer_attach(*gbuffer, passDesc);
+            }
+            if (sampleCount > 1) {
+                msaa_attach(msaa, passDesc, reverseZ);
+            }
+            encode_scene(cmd, passDesc, pipelines, chunkManager, meshRegistry, scene, depthState, uniformRing, cam,
+                         frameUniforms, fogDistance, scratch, nullptr, foliage.get(), nullptr, nullptr, shadowMap.get(),
+                         nullptr, nullptr, nullptr, nullptr, nullptr, gbuffer.get(), jobs, encodeThreads, frameStats);
+            offscreen_target_encode_readback(target, cmd);
+            frame_ring_end_frame(uniformRing, cmd);
+            [cmd commit];
+        }
+        frame_stats_end_frame(frameStats);
+    }
+    for (size_t slot = 0; slot < targets.size(); ++slot) {
+        save(slot);
+    }
+
+    printf("Rendered %zu views of %dx%d into %s\n", views.keyframes.size(), views.width, views.height, outputDir);
+    return failures ? 1 : 0;
+}
+
+// Renders a pyramid of top-down map tiles into outputDir, resuming where an earlier run stopped.
+// Tiles of the finest level render in Morton order while the oldest in flight is read back, the
+// coarser levels are downsampled from them, and the PNG encoding runs on the job system.
+int run_map_tiles(const char* outputDir, uint32_t levels, uint32_t tileSize, uint32_t encodeThreads,
+                  const ChunkManagerConfig& chunkConfig) {
+    MapTileSettings settings;
+    settings.levels = levels;
+    settings.tileSize = tileSize;
+    settings.finestTileWorld = 2.0f * chunkConfig.chunkSize;
+    // Centred on the origin, where the scene objects stand
+    const float extent = map_tile_world_size(settings, 0);
+    settings.originX = -0.5f * extent;
+    settings.originZ = -0.5f * extent;
+    settings.minHeight = -4.0f * chunkConfig.terrain.height;
+    settings.maxHeight = 4.0f * chunkConfig.terrain.height + chunkConfig.chunkSize;
+
+    const std::string directory = outputDir;
+    const std::vector<MapTile> tiles = map_tile_schedule(settings, [&](const MapTile& tile) {
+        return std::filesystem::exists(map_tile_path(directory, tile));
+    });
+    const size_t finestCount = (size_t)1 << (2 * (levels - 1));
+    if (tiles.empty()) {
+        printf("Map tiles: all %zu tiles of %u levels are already in %s\n", finestCount, levels, outputDir);
+        return 0;
+    }
+    printf("Map tiles: rendering %zu of %zu finest tiles\n", tiles.size(), finestCount);
+
+    MetalContext metal = create_metal_context();
+    if (!metal.library) {
+        return 1;
+    }
+    HeightField heightField = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f, chunkConfig.terrain);
+    JobSystem jobs;
+    ResourceUploader uploader(metal.device, DEFAULT_STAGING_CAPACITY, chunkConfig.uploads);
+    MeshRegistry meshRegistry;
+    TransformGraph transformGraph;
+    std::unique_ptr<AssetLoader> assets;
+    if (asset_loader_supported(metal.device)) {
+        assets = std::make_unique<AssetLoader>(metal.device);
+    }
+    if (chunkConfig.erosion.iterations > 0) {
+        metal_erosion_pipelines(metal);
+    }
+    ChunkManager chunkManager(metal, uploader, jobs, chunkConfig, assets.get());
+    if (chunkConfig.erosion.iterations > 0) {
+        chunkManager.resample_height_field(heightField);
+    }
+    const uint32_t maxChunks = (uint32_t)chunkManager.max_resident_chunks();
+    SceneStore scene = create_scene_objects(uploader, meshRegistry, heightField, transformGraph, true,
+                                            chunkManager.config());
+    const uint64_t staticUploads = uploader.flush();
+    transform_graph_update(transformGraph, scene);
+    scene_update_bounds(scene);
+
+    FrameRing uniformRing =
+        create_frame_ring(metal.device, scene_frame_bytes(maxChunks, meshRegistry, scene.size(), ShadowSettings{}));
+    // Map tiles are plain forward renders: no shadows, fog or far fade, and never reverse-Z
+    id<MTLDepthStencilState> depthState = create_depth_state(metal.device, false);
+    SceneShading shading;
+    shading.meshlets = meshlet_draw_supported(metal.device);
+    const ScenePipelines pipelines = scene_pipelines(metal, chunkManager, shading);
+    const FogSettings fog = active_fog(scene_fog(chunkConfig), shading);
+    const float fogDistance = fog_cull_distance(fog);
+
+    std::vector<OffscreenTarget> targets;
+    for (uint32_t i = 0; i < DEFAULT_FRAMES_IN_FLIGHT; ++i) {
+        targets.push_back(create_offscreen_target(metal.device, tileSize, tileSize));
+    }
+    std::vector<MapTile> rendered(targets.size());
+
+    FrameArenas frameArenas = create_scene_arenas(jobs);
+    uint32_t arenaFrame = 0;
+    FrameStats frameStats;
+    SceneScratch scratch;
+    MapPyramid pyramid(settings);
+    std::vector<MapTileImage> finished;
+    JobCounter encoding;
+    std::atomic<int> failures{ 0 };
+    size_t written = 0;
+    // Bounds the images waiting for an encoder, which otherwise grow while the GPU outpaces them
+    const uint32_t maxEncoding = 2 * std::max(jobs.worker_count(JobPriority::Frame), 1u);
+
+    auto collect = [&](size_t slot) {
+        if (!targets[slot].pending) {
+            return;
+        }
+        MapTileImage image;
+        image.tile = rendered[slot];
+        std::string error;
+        if (!offscreen_target_read(targets[slot], image.bgra, error)) {
+            fprintf(stderr, "Map tiles: %s: %s\n", map_tile_path(directory, image.tile).c_str(), error.c_str());
+            ++failures;
+            return;
+        }
+        finished.clear();
+        pyramid.add(std::move(image), finished);
+        for (MapTileImage& done : finished) {
+            // A tile an earlier run finished was only rendered again to rebuild its ancestors
+            if (std::filesystem::exists(map_tile_path(directory, done.tile))) {
+                continue;
+            }
+            while (encoding.pending.load(std::memory_order_acquire) >= maxEncoding) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            auto job = std::make_shared<MapTileImage>(std::move(done));
+            jobs.run([&, job] {
+                std::string saveError;
+                if (!save_map_tile(directory, *job, tileSize, saveError)) {
+                    fprintf(stderr, "Map tiles: %s\n", saveError.c_str());
+                    ++failures;
+                }
+            }, &encoding, JobPriority::Frame);
+            ++written;
+        }
+    };
+
+    // Collects every slot oldest first, the pyramid needing the tiles in the order they were rendered
+    auto drain = [&](size_t nextTile) {
+        for (size_t k = 0; k < targets.size(); ++k) {
+            collect((nextTile + k) % targets.size());
+        }
+    };
 
-InputState g_inputState;
-bool g_cursor_locked = true;
+    const auto start = std::chrono::steady_clock::now();
+    MTLRenderPassDescriptor* scenePass = [MTLRenderPassDescriptor new];
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const MapTile& tile = tiles[i];
+        const Camera cam = map_tile_camera(settings, tile);
+        frame_stats_begin_frame(frameStats);
+        frame_arenas_begin_frame(frameArenas, arenaFrame++);
+        scratch.arena = &frame_arena(frameArenas);
 
-// GLFW callbacks
-void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (action == GLFW_PRESS) {
-        if (key == GLFW_KEY_ESCAPE) {
-            glfwSetWindowShouldClose(window, true);
+        // Consecutive tiles are neighbours, so most of their chunks are already resident. As in
+        // run_headless, the tiles in flight finish before the updates that wait for the rest
+        uploader.begin_frame();
+        chunkManager.update(cam.position, *scratch.arena, fogDistance);
+        if (chunkManager.pending_count() > 0) {
+            drain(i);
+            while (chunkManager.pending_count() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                frame_arenas_begin_frame(frameArenas, arenaFrame++);
+                scratch.arena = &frame_arena(frameArenas);
+                uploader.begin_frame();
+                chunkManager.update(cam.position, *scratch.arena, fogDistance);
+            }
         }
-        if (key == GLFW_KEY_TAB) {
-            g_cursor_locked = !g_cursor_locked;
-            glfwSetInputMode(window, GLFW_CURSOR, g_cursor_locked ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+        // The finest LOD everywhere: a top-down tile has no distant parts to simplify
+        chunkManager.update_lods(cam.position, 1e9f, *scratch.arena);
+
+        const size_t slot = i % targets.size();
+        collect(slot);
+        rendered[slot] = tile;
+        OffscreenTarget& target = targets[slot];
+
+        frame_ring_begin_frame(uniformRing);
+        @autoreleasepool {
+            id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+            uploader.encode_wait(cmd, staticUploads);
+            const FrameAllocation frameUniforms = write_frame_uniforms(uniformRing, cam, fog);
+            MTLRenderPassDescriptor* passDesc =
+                make_scene_pass(scenePass, target.color, transient_target_texture(target.depth, false), false,
+                                camera_clear_depth(cam));
+            encode_scene(cmd, passDesc, pipelines, chunkManager, meshRegistry, scene, depthState, uniformRing, cam,
+                         frameUniforms, fogDistance, scratch, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                         nullptr, nullptr, nullptr, nullptr, nullptr, jobs, encodeThreads, frameStats);
+            offscreen_target_encode_readback(target, cmd);
+            frame_ring_end_frame(uniformRing, cmd);
+            [cmd commit];
         }
-    }
+        frame_stats_end_frame(frameStats);
 
-    if (key >= 0 && key < 1024) {
-        if (action == GLFW_PRESS) g_inputState.keys[key] = true;
-        if (action == GLFW_RELEASE) g_inputState.keys[key] = false;
+        if ((i + 1) % 64 == 0 || i + 1 == tiles.size()) {
+            printf("Map tiles: %zu/%zu rendered\n", i + 1, tiles.size());
+        }
     }
-}
+    drain(tiles.size());
+    jobs.wait(encoding);
 
-void cursor_callback(GLFWwindow* window, double xpos, double ypos) {
-    g_inputState.mouseX = xpos;
-    g_inputState.mouseY = ypos;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Map tiles: wrote %zu tiles of %ux%u into %s in %.1f s\n", written, tileSize, tileSize, outputDir,
+           seconds);
+    return failures ? 1 : 0;
 }
 
-void add_tree(std::vector<GameObject>& objects, simd::float3 position) {
-    GameObject trunk = create_cube();
-    trunk.modelMatrix = matrix_translation(position.x, position.y + 1.0f, position.z) * matrix_scale(0.2f, 2.0f, 0.2f);
-    trunk.color = {0.5f, 0.35f, 0.26f};
-    objects.push_back(trunk);
+int main(int argc, char** argv) {
+    const char* benchmarkPath = nullptr;
+    const char* benchmarkOutput = nullptr;
+    const char* headlessViews = nullptr;
+    const char* headlessOutput = ".";
+    const char* mapTilesOutput = nullptr;
+    uint32_t mapLevels = 5;
+    uint32_t mapTileSize = 256;
+    uint32_t encodeThreads = default_encode_threads();
+    bool deferred = false;
+    uint32_t sampleCount = 1;
+    bool bakedMaterials = false;
+    bool horizonShadows = false;
+    bool reflectionProbe = false;
+    bool residentInstances = false;
+    bool vertexLighting = false;
+    bool depthPrepass = false;
+    bool frontToBack = false;
+    bool temporalAA = false;
+    ChunkManagerConfig chunkConfig;
+    TextureCompression textureCompression = TextureCompression::Astc4x4;
+    bool verifyNoise = false;
+    bool reverseZ = false;
+    bool unretainedReferences = false;
+    bool validateCommandBuffers = false;
+    bool residencySets = false;
+    bool rayTracedShading = false;
+    bool variableRate = false;
+    bool qualityGovernor = false;
+    bool streamObjects = false;
+    int servePort = 0;
+    const char* connectAddress = nullptr;
+    std::string worldPath = "world.save";
+    std::string tuningPath = "tuning.json";
+    bool octavesGiven = false;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    uint32_t crowdAgents = 0;
+    StressSceneSettings stress;
+    float cpuProfileSeconds = 0.0f;
+    MetricsExporterConfig metricsConfig;
+    const char* statsdAddress = nullptr;
+    HitchSettings hitchSettings;
+    bool hitchCooldownGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmarkPath = argv[++i];
+        } else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc) {
+            benchmarkOutput = argv[++i];
+        } else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessViews = argv[++i];
+        } else if (strcmp(argv[i], "--headless-output") == 0 && i + 1 < argc) {
+            headlessOutput = argv[++i];
+        } else if (strcmp(argv[i], "--map-tiles") == 0 && i + 1 < argc) {
+            mapTilesOutput = argv[++i];
+        } else if (strcmp(argv[i], "--map-levels") == 0 && i + 1 < argc) {
+            mapLevels = (uint32_t)std::clamp(atoi(argv[++i]), 1, 12);
+        } else if (strcmp(argv[i], "--map-tile-size") == 0 && i + 1 < argc) {
+            // Even, so that four children fill their parent
+            mapTileSize = (uint32_t)std::clamp(atoi(argv[++i]), 16, 4096) & ~1u;
+        } else if (strcmp(argv[i], "--encode-threads") == 0 && i + 1 < argc) {
+            encodeThreads = (uint32_t)std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--deferred") == 0) {
+            deferred = true;
+        } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            const int samples = atoi(argv[++i]);
+            sampleCount = samples >= 4 ? 4 : samples >= 2 ? 2 : 1;
+        } else if (strcmp(argv[i], "--height-maps") == 0) {
+            chunkConfig.heightMaps = true;
+        } else if (strcmp(argv[i], "--volume-terrain") == 0) {
+            chunkConfig.volume.enabled = true;
+        } else if (strcmp(argv[i], "--baked-materials") == 0) {
+            bakedMaterials = true;
+        } else if (strcmp(argv[i], "--horizon-shadows") == 0) {
+            horizonShadows = true;
+        } else if (strcmp(argv[i], "--reflection-probe") == 0) {
+            reflectionProbe = true;
+        } else if (strcmp(argv[i], "--resident-instances") == 0) {
+            residentInstances = true;
+        } else if (strcmp(argv[i], "--vertex-lighting") == 0) {
+            vertexLighting = true;
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            depthPrepass = true;
+        } else if (strcmp(argv[i], "--front-to-back") == 0) {
+            frontToBack = true;
+        } else if (strcmp(argv[i], "--taa") == 0) {
+            temporalAA = true;
+        } else if (strcmp(argv[i], "--verify-noise") == 0) {
+            verifyNoise = true;
+        } else if (strcmp(argv[i], "--terrain-seed") == 0 && i + 1 < argc) {
+            chunkConfig.terrain.noise.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--terrain-octaves") == 0 && i + 1 < argc) {
+            chunkConfig.terrain.noise.octaves = (uint32_t)std::clamp(atoi(argv[++i]), 1, 16);
+            octavesGiven = true;
+        } else if (strcmp(argv[i], "--terrain-height") == 0 && i + 1 < argc) {
+            chunkConfig.terrain.height = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--erosion") == 0 && i + 1 < argc) {
+            chunkConfig.erosion.iterations = (uint32_t)std::clamp(atoi(argv[++i]), 0, 10000);
+        } else if (strcmp(argv[i], "--biomes") == 0 && i + 1 < argc) {
+            // The terrain is only shaded by biome through the baked materials
+            chunkConfig.biomes.cellsPerEdge = (uint32_t)std::clamp(atoi(argv[++i]), 0, (int)BIOME_MAX_CELLS);
+            bakedMaterials = bakedMaterials || chunkConfig.biomes.cellsPerEdge > 0;
+        } else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc) {
+            // 0 lifts the limit: every queued upload goes at the next frame
+            chunkConfig.uploads.bytesPerFrame = (size_t)std::max(atoi(argv[++i]), 0) * 1024;
+            if (chunkConfig.uploads.bytesPerFrame == 0) {
+                chunkConfig.uploads.millisecondsPerFrame = 0.0f;
+            }
+        } else if (strcmp(argv[i], "--compress-tiles") == 0) {
+            chunkConfig.compressTiles = true;
+        } else if (strcmp(argv[i], "--texture-compression") == 0 && i + 1 < argc &&
+                   parse_texture_compression(argv[i + 1], textureCompression)) {
+            ++i; // An unknown format falls through to the usage
+        } else if (strcmp(argv[i], "--reverse-z") == 0) {
+            reverseZ = true;
+        } else if (strcmp(argv[i], "--unretained-references") == 0) {
+            unretainedReferences = true;
+        } else if (strcmp(argv[i], "--validate-command-buffers") == 0) {
+            validateCommandBuffers = true;
+        } else if (strcmp(argv[i], "--residency-sets") == 0) {
+            residencySets = true;
+        } else if (strcmp(argv[i], "--ray-tracing") == 0) {
+            rayTracedShading = true;
+        } else if (strcmp(argv[i], "--variable-rate") == 0) {
+            variableRate = true;
+        } else if (strcmp(argv[i], "--quality-governor") == 0) {
+            qualityGovernor = true;
+        } else if (strcmp(argv[i], "--stream-objects") == 0) {
+            streamObjects = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            servePort = std::clamp(atoi(argv[++i]), 1, 65535);
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connectAddress = argv[++i];
+        } else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+            worldPath = argv[++i];
+        } else if (strcmp(argv[i], "--tuning") == 0 && i + 1 < argc) {
+            tuningPath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--crowd") == 0 && i + 1 < argc) {
+            crowdAgents = (uint32_t)std::max(atoi(argv[++i]), 0);
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            stress.objects = (uint32_t)std::max(atoi(argv[++i]), 0);
+        } else if (strcmp(argv[i], "--stress-lights") == 0 && i + 1 < argc) {
+            stress.lights = std::min((uint32_t)std::max(atoi(argv[++i]), 0), MAX_POINT_LIGHTS);
+        } else if (strcmp(argv[i], "--stress-world") == 0 && i + 1 < argc) {
+            stress.worldSize = std::max((float)atof(argv[++i]), 16.0f);
+        } else if (strcmp(argv[i], "--cpu-sampler") == 0 && i + 1 < argc) {
+            cpuProfileSeconds = std::clamp((float)atof(argv[++i]), 1.0f, 60.0f);
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            metricsConfig.httpPort = std::clamp(atoi(argv[++i]), 1, 65535);
+        } else if (strcmp(argv[i], "--statsd") == 0 && i + 1 < argc) {
+            statsdAddress = argv[++i];
+        } else if (strcmp(argv[i], "--statsd-interval") == 0 && i + 1 < argc) {
+            metricsConfig.intervalMs = std::max((float)atof(argv[++i]), 10.0f);
+        } else if (strcmp(argv[i], "--hitch-ms") == 0 && i + 1 < argc) {
+            hitchSettings.budgetMs = std::max((float)atof(argv[++i]), 0.0f);
+        } else if (strcmp(argv[i], "--hitch-dir") == 0 && i + 1 < argc) {
+            hitchSettings.directory = argv[++i];
+        } else if (strcmp(argv[i], "--hitch-cooldown") == 0 && i + 1 < argc) {
+            hitchSettings.cooldownSeconds = std::max((float)atof(argv[++i]), 0.0f);
+            hitchCooldownGiven = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--benchmark <path.json> [--benchmark-output <report.json>]] "
+                            "[--headless <views.json> [--headless-output <dir>]] "
+                            "[--map-tiles <dir> [--map-levels <n>] [--map-tile-size <px>]] "
+                            "[--encode-threads <n>] [--deferred] [--msaa <1|2|4>] [--height-maps] [--baked-materials] "
+                            "[--horizon-shadows] [--reflection-probe] [--vertex-lighting] [--depth-prepass] "
+                            "[--front-to-back] [--resident-instances] [--taa] "
+                            "[--verify-noise] "
+                            "[--terrain-seed <n>] [--terrain-octaves <n>] "
+                            "[--terrain-height <h>] [--erosion <iterations>] [--biomes <cells>] [--volume-terrain] "
+                            "[--upload-budget <KB>] [--texture-compression <none|astc4x4|astc6x6|astc8x8|bc1>] "
+                            "[--compress-tiles] [--reverse-z] "
+                            "[--unretained-references] "
+                            "[--validate-command-buffers] [--residency-sets] [--ray-tracing] [--variable-rate] "
+                            "[--quality-governor] [--stream-objects] [--crowd <agents>] "
+                            "[--stress <objects> [--stress-lights <n>] [--stress-world <size>]] "
+                            "[--cpu-sampler <seconds>] "
+                            "[--metrics-port <port>] [--statsd <host:port> [--statsd-interval <ms>]] "
+                            "[--hitch-ms <ms> [--hitch-dir <dir>] [--hitch-cooldown <seconds>]] "
+                            "[--serve <port> | --connect <host:port>] "
+                            "[--world <path.save>] [--tuning <path.json>] [--record <path.rec> | --replay <path.rec> "
+                            "[--benchmark-output <report.json>]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (verifyNoise) {
+        return run_noise_check();
+    }
+    // A stress scene without a path of its own flies the fixed stress path
+    if (!benchmarkPath && (stress.objects > 0 || stress.lights > 0)) {
+        benchmarkPath = "benchmarks/paths/stress.json";
+    }
+    if (benchmarkPath) {
+        return run_benchmark(benchmarkPath, benchmarkOutput, encodeThreads, deferred, sampleCount, bakedMaterials,
+                             vertexLighting, depthPrepass, frontToBack, chunkConfig, reverseZ, residencySets, stress);
+    }
+    if (mapTilesOutput) {
+        return run_map_tiles(mapTilesOutput, mapLevels, mapTileSize, encodeThreads, chunkConfig);
+    }
 
-    GameObject leaves = create_cube();
-    leaves.modelMatrix = matrix_translation(position.x, position.y + 2.5f, position.z) * matrix_scale(1.5f, 1.5f, 1.5f);
-    leaves.color = {0.0f, 0.8f, 0.2f};
-    objects.push_back(leaves);
-}
+    // --- A replay starts from the recorded seeds; the recorded input and frame times drive it below ---
+    InputRecording recording;
+    if (replayPath) {
+        std::string error;
+        if (!read_input_recording(replayPath, recording, error)) {
+            fprintf(stderr, "Replay: %s\n", error.c_str());
+            return 1;
+        }
+        chunkConfig.terrain.noise.seed = recording.terrainSeed;
+    }
+    if (headlessViews) {
+        return run_headless(headlessViews, headlessOutput, encodeThreads, deferred, sampleCount, chunkConfig,
+                            reverseZ);
+    }
 
-int main() {
     const uint32_t WIDTH  = 800;
     const uint32_t HEIGHT = 600;
 
@@ -82,6 +2656,11 @@ int main() {
         glfwCreateWindow(WIDTH, HEIGHT, "OpenWorld Simulation", nullptr, nullptr);
 
     MetalContext metal = create_metal_context();
+    if (!metal.library) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
 
     glfwSetKeyCallback(window, key_callback);
     glfwSetCursorPosCallback(window, cursor_callback);
@@ -94,158 +2673,2007 @@ int main() {
     layer.device = metal.device;
     layer.pixelFormat = MTLPixelFormatBGRA8Unorm;
     layer.framebufferOnly = YES;
-    layer.drawableSize = CGSizeMake(WIDTH, HEIGHT);
     nsWindow.contentView.layer = layer;
 
+    // --- Frame pacing: vsync by default; the display link reports the real refresh rate ---
+    FramePacingSettings pacingSettings;
+    FramePacer pacer;
+    DisplayLink displayLink;
+    GameClockSettings gameClockSettings;
+    GameClock gameClock;
+    apply_present_mode(layer, pacingSettings);
+
+    // Render at the framebuffer's pixel size, which is larger than the window on Retina displays
+    int framebufferWidth = 0, framebufferHeight = 0;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    Swapchain swapchain = create_swapchain(metal.device, layer, framebufferWidth, framebufferHeight,
+                                           nsWindow.backingScaleFactor,
+                                           MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead);
+    glfwSetWindowUserPointer(window, &swapchain);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowContentScaleCallback(window, content_scale_callback);
+
     // --- ImGui Setup ---
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     ImGui::StyleColorsDark();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplMetal_Init(metal.device);
+    UiOverlay uiOverlay; // The UI as last rendered, composited over every frame
 
-    std::vector<GameObject> gameObjects;
+    // Cached heights around the play area for camera clamping and object placement
+    HeightField heightField = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f, chunkConfig.terrain);
+    std::mutex heightFieldMutex; // The simulation thread reads the field while terrain edits rewrite it
 
-    GameObject landscape = create_landscape(50, 50);
-    gameObjects.push_back(landscape);
+    // --- Frame work is split over performance cores, streaming runs on efficiency cores ---
+    JobSystem jobs;
+    FrameArenas frameArenas = create_scene_arenas(jobs);
 
-    add_tree(gameObjects, simd::float3{5.0f, get_terrain_height(5.0f, 5.0f), 5.0f});
-    add_tree(gameObjects, simd::float3{-8.0f, get_terrain_height(-8.0f, -10.0f), -10.0f});
-    add_tree(gameObjects, simd::float3{10.0f, get_terrain_height(10.0f, -5.0f), -5.0f});
+    // --- Navigation mesh over the cached heights, rebuilt tile by tile where the terrain is edited ---
+    NavMesh navMesh = create_nav_mesh(heightField, NavMeshSettings{}, jobs);
+    uint32_t navTilesRebuilt = 0;
+    double navRebuildMs = 0.0;
 
-    GameObject rock = create_cube();
-    rock.modelMatrix = matrix_translation(-5.0f, get_terrain_height(-5.0f, -5.0f) + 0.5f, -5.0f) * matrix_scale(1.5f, 1.0f, 2.5f);
-    rock.color = {0.5f, 0.5f, 0.5f};
-    gameObjects.push_back(rock);
+    // --- Static geometry lives in private buffers, uploaded on a separate blit queue ---
+    ResourceUploader uploader(metal.device, DEFAULT_STAGING_CAPACITY, chunkConfig.uploads);
 
-    // --- Create Metal Buffers for GameObjects ---
-    std::vector<id<MTLBuffer>> vertexBuffers;
-    std::vector<id<MTLBuffer>> indexBuffers;
+    // --- Scene entities: one mesh copy per mesh type, one instanced draw per visible mesh ---
+    MeshRegistry meshRegistry;
+    TransformGraph transformGraph;
 
-    for (const auto& go : gameObjects) {
-        id<MTLBuffer> vertexBuffer =
-            [metal.device newBufferWithBytes:go.vertices.data()
-                                      length:go.vertices.size() * sizeof(Vertex)
-                                     options:MTLResourceStorageModeShared];
-        vertexBuffers.push_back(vertexBuffer);
+    // --- Performance knobs: staged by the tuning panel or the tuning file, applied at the top of a frame ---
+    // The quality tier's limits are scaled by these, so the governor still steps down from the tuned values
+    TuningRegistry tuning;
+    std::string tuningStatus;
+    bool showTuning = false;
+    int32_t terrainOctaves = (int32_t)chunkConfig.terrain.noise.octaves;
+    float lodBias = 1.0f;
+    float viewDistance = 1.0f;
+    float renderScaleCap = 1.0f;
+    float renderScaleFloor = RenderScaleSettings{}.minScale;
+    ShadowSettings shadowSettings;
+    int32_t shadowResolution = (int32_t)shadowSettings.resolution;
+    int32_t shadowUpdates = (int32_t)shadowSettings.maxUpdatesPerFrame;
+    const uint32_t octavesKnob = tuning.add("Terrain", "Noise octaves", &terrainOctaves, 1, 16, true);
+    tuning.add("Terrain", "LOD bias", &lodBias, 0.25f, 4.0f);
+    tuning.add("Terrain", "View distance", &viewDistance, 0.1f, 1.0f);
+    tuning.add("Rendering", "Render scale cap", &renderScaleCap, 0.25f, 1.0f);
+    tuning.add("Rendering", "Render scale floor", &renderScaleFloor, 0.25f, 1.0f);
+    const uint32_t shadowResolutionKnob = tuning.add("Shadows", "Shadow resolution", &shadowResolution, 256, 8192);
+    const uint32_t shadowDistanceKnob = tuning.add("Shadows", "Shadow distance", &shadowSettings.maxDistance, 20.0f,
+                                                   400.0f);
+    const uint32_t shadowUpdatesKnob = tuning.add("Shadows", "Cascades redrawn per frame", &shadowUpdates, 1,
+                                                  (int32_t)MAX_SHADOW_CASCADES);
+    {
+        // No file is the usual case; a broken one is worth a warning
+        std::string error;
+        if (!tuning.load(tuningPath.c_str(), error) && std::filesystem::exists(tuningPath)) {
+            fprintf(stderr, "%s: %s\n", tuningPath.c_str(), error.c_str());
+        }
+        // The command line wins over the file
+        if (octavesGiven) {
+            tuning.set(octavesKnob, chunkConfig.terrain.noise.octaves);
+        }
+        tuning.apply();
+        chunkConfig.terrain.noise.octaves = (uint32_t)terrainOctaves;
+        shadowSettings.resolution = (uint32_t)shadowResolution;
+        shadowSettings.maxUpdatesPerFrame = (uint32_t)shadowUpdates;
+    }
 
-        id<MTLBuffer> indexBuffer =
-            [metal.device newBufferWithBytes:go.indices.data()
-                                      length:go.indices.size() * sizeof(uint32_t)
-                                     options:MTLResourceStorageModeShared];
-        indexBuffers.push_back(indexBuffer);
+    // --- Streamed terrain; cached tiles stream in on the GPU's IO queues where supported ---
+    std::unique_ptr<AssetLoader> assets;
+    if (asset_loader_supported(metal.device)) {
+        assets = std::make_unique<AssetLoader>(metal.device);
+    }
+    // Declared before the chunk manager, whose streaming jobs may add heaps to it until it is destroyed
+    std::unique_ptr<GpuResidency> residency;
+    if (residencySets && residency_sets_supported(metal.device)) {
+        residency = std::make_unique<GpuResidency>(metal.device, 1024);
+    }
+    if (chunkConfig.erosion.iterations > 0) {
+        metal_erosion_pipelines(metal);
+    }
+    ChunkManager chunkManager(metal, uploader, jobs, chunkConfig, assets.get());
+    if (chunkConfig.erosion.iterations > 0) {
+        chunkManager.resample_height_field(heightField);
     }
+    const uint32_t maxChunks = (uint32_t)chunkManager.max_resident_chunks();
 
+    // --- Trees and rocks are scattered per resident chunk and LOD-selected on the GPU, or, with
+    // --stream-objects, become scene entities in cells that stream in and out with their chunk ---
+    std::unique_ptr<GpuFoliage> foliage;
+    if (gpu_foliage_supported(metal) && !streamObjects) {
+        foliage = std::make_unique<GpuFoliage>(create_gpu_foliage(metal, maxChunks));
+    }
+    SceneStore scene = create_scene_objects(uploader, meshRegistry, heightField, transformGraph,
+                                            !foliage && !streamObjects, chunkManager.config());
+    SceneCells sceneCells;
+    SceneCellGenerator scatterCell;
+    if (streamObjects) {
+        // The cells are the part of the world its save file does not hold, so they live next to it
+        sceneCells.directory = std::filesystem::path(worldPath).replace_extension("cells").string();
+        sceneCells.meshCount = (uint32_t)meshRegistry.meshes.size();
+        const uint32_t cubeMesh = mesh_registry_primitive(meshRegistry, Primitive::Cube);
+        const uint32_t rockMesh = meshRegistry.lookup.at("rock");
+        scatterCell = [&, cubeMesh, rockMesh](ChunkKey key, SceneCellObjects& objects) {
+            scatter_scene_cell(key, chunkManager.config(), meshRegistry, cubeMesh, rockMesh, objects);
+        };
+    }
 
-    id<MTLBuffer> uniformBuffer =
-        [metal.device newBufferWithLength:sizeof(Uniforms)
-                                  options:MTLResourceStorageModeShared];
-                                  
-    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
-    depthDesc.depthCompareFunction = MTLCompareFunctionLess;
-    depthDesc.depthWriteEnabled = YES;
-    id<MTLDepthStencilState> depthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+    // --- A herd of skinned creatures, animated on the job system and posed by a compute pre-pass ---
+    const SkinnedMesh creature = create_creature_mesh();
+    Herd herd = create_herd(heightField, creature, HERD_SIZE, replayPath ? recording.herdSeed : HERD_SEED);
+    std::unique_ptr<GpuSkinning> skinning;
+    if (gpu_skinning_supported(metal)) {
+        skinning = std::make_unique<GpuSkinning>(create_gpu_skinning(metal, uploader, creature,
+                                                                     herd.animation.skeleton.size(), herd.poseBounds,
+                                                                     herd.size()));
+    }
+    bool drawCreatures = skinning != nullptr;
+    // --- Line of sight from the creatures, the planned sound sources, to the camera; tested once per audio tick ---
+    AudioOcclusion audioOcclusion;
+    const AudioOcclusionSettings audioOcclusionSettings;
+    float audioTickTime = 0.0f;
+    const uint32_t sphereMesh = mesh_registry_primitive(meshRegistry, Primitive::Sphere);
 
-    MTLTextureDescriptor* depthTexDesc = 
-        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatDepth32Float
-                                                           width:WIDTH
-                                                          height:HEIGHT
-                                                       mipmapped:NO];
-    depthTexDesc.storageMode = MTLStorageModePrivate;
-    depthTexDesc.usage = MTLTextureUsageRenderTarget;
-    id<MTLTexture> depthTexture = [metal.device newTextureWithDescriptor:depthTexDesc];
+    // --- A saved world replaces the generated scene and the terrain edits; its camera is applied below ---
+    WorldSaveFile savedWorld;
+    bool worldLoaded = false;
+    {
+        const double loadStart = simulation_clock();
+        if (map_world_save(worldPath, savedWorld)) {
+            const uint32_t* meshes = (const uint32_t*)savedWorld.sections[WORLD_SAVE_MESHES];
+            const uint32_t count = savedWorld.header.sections[WORLD_SAVE_MESHES].count;
+            worldLoaded = std::all_of(meshes, meshes + count,
+                                      [&](uint32_t mesh) { return mesh < meshRegistry.meshes.size(); });
+        }
+        if (worldLoaded) {
+            world_save_restore_scene(savedWorld, scene);
+            // Edits made on another grid would land on the wrong points
+            if (savedWorld.header.terrainSpacing == chunkManager.edits().spacing()) {
+                const TerrainGridRect changed = chunkManager.restore_edits(
+                    world_save_terrain_edits(savedWorld), savedWorld.header.sections[WORLD_SAVE_TERRAIN_EDITS].count);
+                const TerrainGridRect dirty = terrain_grid_rect_expand(changed, 1);
+                const float spacing = chunkManager.edits().spacing();
+                if (!dirty.empty()) {
+                    chunkManager.resample_height_field(heightField, dirty.x0 * spacing, dirty.z0 * spacing,
+                                                       dirty.x1 * spacing, dirty.z1 * spacing);
+                }
+            }
+            printf("Loaded %s: %zu entities, %zu terrain edits in %.2f ms\n", worldPath.c_str(), scene.size(),
+                   chunkManager.edits().size(), (simulation_clock() - loadStart) * 1000.0);
+        } else if (savedWorld.data) {
+            fprintf(stderr, "%s was saved with other meshes; starting a new world\n", worldPath.c_str());
+            unmap_world_save(savedWorld);
+        }
+    }
+
+    // --- FFT ocean waves in a transparent pass of their own, blended order-independently in tile memory ---
+    // The ocean kernels come from a library of their own, compiled here rather than with the startup pipelines
+    std::unique_ptr<Transparency> transparency;
+    if (metal_ocean_pipelines(metal) && transparency_supported(metal)) {
+        const float streamed = chunkManager.config().loadRadius * chunkManager.config().chunkSize;
+        transparency = std::make_unique<Transparency>(create_transparency(metal, uploader, streamed, reverseZ));
+    }
+    bool drawWater = transparency != nullptr;
+    // --- Particles emitted, simulated, compacted and sorted in compute kernels; drawn in the transparent pass ---
+    std::unique_ptr<GpuParticles> particles;
+    uint64_t particleHeightUploads = 0;
+    if (transparency && metal_particle_pipelines(metal) && gpu_particles_supported(metal)) {
+        std::lock_guard<std::mutex> lock(heightFieldMutex);
+        particles = std::make_unique<GpuParticles>(create_gpu_particles(metal, uploader, heightField));
+        transparency->particles = particles.get();
+    }
+    // The ocean's FFT runs on the compute queue, next to the shadow and scene rasterisation
+    bool asyncCompute = metal.computeQueue != nil;
+    QueueOverlap queueOverlap;
+
+    // --- The frame's command buffers; without retained references, resources stay alive through their owners ---
+    CommandBuffers commandBuffers = create_command_buffers();
+    commandBuffers.unretainedReferences = unretainedReferences;
+    commandBuffers.validate = commandBuffers.validate || validateCommandBuffers;
+    // Waits for the frames in flight before their targets are replaced, which they no longer keep alive themselves
+    auto waitForUnretainedFrames = [&] {
+        if (commandBuffers.unretainedReferences) {
+            command_queue_wait_idle(metal.queue);
+            command_queue_wait_idle(metal.computeQueue);
+        }
+    };
+    std::array<uint32_t, 6> targetsKey = {};
+
+    // --- The terrain as a geometry clipmap, its heights refreshed in strips as the camera moves ---
+    std::unique_ptr<GpuTerrainClipmap> terrainClipmap;
+    if (gpu_terrain_clipmap_supported(metal)) {
+        terrainClipmap = std::make_unique<GpuTerrainClipmap>(
+            create_gpu_terrain_clipmap(metal, uploader, chunkManager.config()));
+    }
+    const uint64_t staticUploads = uploader.flush();
+    // Far trees and rocks become quads of an atlas baked from the same cube parts
+    if (foliage && gpu_impostors_supported(metal)) {
+        const GpuMesh& cube = meshRegistry.meshes[mesh_registry_primitive(meshRegistry, Primitive::Cube)];
+        foliage->atlas = create_gpu_impostors(metal, cube, uploader, staticUploads);
+    }
+
+    // --- Debris thrown from the camera; reserved up front so spawning never allocates ---
+    DebrisPool debris = create_debris_pool(scene, MAX_DEBRIS);
+    DebrisSettings debrisSettings;
+    const uint32_t debrisMesh = mesh_registry_primitive(meshRegistry, Primitive::Cube);
+    if (replayPath) {
+        debris.seed = recording.debrisSeed;
+    }
+
+    // --- Animals wandering the terrain: scene entities steered on the job system and drawn instanced ---
+    CrowdSettings crowdSettings;
+    Crowd crowd = create_crowd(scene, heightField, crowdAgents, debrisMesh, meshRegistry.meshes[debrisMesh].bounds,
+                               crowdSettings, CROWD_SEED);
+
+    // --- Rigid spheres dropped in front of the camera, stepped at a fixed 60 Hz on the job system ---
+    PhysicsWorld physics = create_physics_world(MAX_PHYSICS_BODIES);
+    std::vector<Entity> physicsEntities;
+    physicsEntities.reserve(MAX_PHYSICS_BODIES);
+    const size_t maxEntities = scene.size() + debris.capacity + MAX_PHYSICS_BODIES +
+                               (streamObjects ? (size_t)maxChunks * SCATTER_MAX_CHUNK_ENTITIES : 0);
+    scene_reserve(scene, maxEntities);
+    uint32_t physicsDrops = 0;
+    bool physicsClear = false;
+
+    // --- Replication: stream the scene to observers, or observe another instance's ---
+    ReplicationSettings replicationSettings;
+    replicationSettings.chunkSize = chunkManager.config().chunkSize;
+    std::unique_ptr<ReplicationServer> replicationServer;
+    std::unique_ptr<ReplicationClient> replicationClient;
+    std::vector<BoundingBox> meshBounds;
+    for (const GpuMesh& mesh : meshRegistry.meshes) {
+        meshBounds.push_back(mesh.bounds);
+    }
+    std::string replicationError;
+
+    // --- Saving copies the world in the frame and writes the copy on a background thread ---
+    WorldSaveState worldSave;
+    std::vector<Entity> worldSaveTransient;
+    JobCounter worldSaveCounter;
+    bool saveWorld = false;
+    uint32_t worldSaves = 0;
+    bool worldSaveWritten = false;
+    double worldSaveSeconds = 0.0;
+
+    // --- Sampling profiler: the last seconds of every thread's stacks, written on request or after a hitch ---
+    std::unique_ptr<CpuSampler> cpuSampler;
+    if (cpuProfileSeconds > 0.0f) {
+        pthread_setname_np("Render");
+        CpuSamplerConfig samplerConfig;
+        samplerConfig.windowSeconds = cpuProfileSeconds;
+        cpuSampler = std::make_unique<CpuSampler>(samplerConfig);
+    }
+    JobCounter cpuProfileCounter;
+    bool writeCpuProfile = false;
+    std::string cpuProfilePath; // The last profile written, shown in the overlay
+
+    // --- Hitch detector: frames over budget write the sampler's stacks and the stats, then capture the next frame ---
+    HitchDetector hitchDetector;
+    bool gpuCapturing = false;
+    if (hitchSettings.budgetMs > 0.0f) {
+        // Reports do not overlap the seconds of stacks the previous one covered
+        if (!hitchCooldownGiven) {
+            hitchSettings.cooldownSeconds = std::max(hitchSettings.cooldownSeconds, cpuProfileSeconds);
+        }
+        std::error_code directoryError;
+        std::filesystem::create_directories(hitchSettings.directory, directoryError);
+        if (!gpu_capture_supported()) {
+            fprintf(stderr, "Hitch detector: GPU captures need MTL_CAPTURE_ENABLED=1, writing stats only\n");
+        }
+        hitchDetector.settings = hitchSettings;
+    }
+
+    // --- Telemetry without the overlay: frame times and memory served on localhost or pushed to statsd ---
+    MetricsRegistry metrics;
+    std::unique_ptr<MetricsExporter> metricsExporter;
+    if (statsdAddress) {
+        metricsConfig.statsd = udp_address_parse(statsdAddress, metricsConfig.statsdAddress);
+        if (!metricsConfig.statsd) {
+            fprintf(stderr, "Metrics: cannot resolve %s\n", statsdAddress);
+        }
+    }
+    if (metricsConfig.httpPort > 0 || metricsConfig.statsd) {
+        metricsExporter = std::make_unique<MetricsExporter>(metrics, metricsConfig);
+        if (!metricsExporter->running()) {
+            fprintf(stderr, "Metrics: %s\n", metricsExporter->error().c_str());
+            metricsExporter.reset();
+        }
+    }
+    uint64_t metricsGpuFrame = 0;
+    size_t metricsUploadedBytes = 0;
+    if (servePort > 0) {
+        replicationServer = std::make_unique<ReplicationServer>();
+        if (!replication_server_open(*replicationServer, (uint16_t)servePort, replicationSettings, replicationError)) {
+            fprintf(stderr, "Cannot serve on port %d: %s\n", servePort, replicationError.c_str());
+            replicationServer.reset();
+        }
+    } else if (connectAddress) {
+        UdpAddress address;
+        replicationClient = std::make_unique<ReplicationClient>();
+        if (!udp_address_parse(connectAddress, address)) {
+            fprintf(stderr, "Cannot resolve %s\n", connectAddress);
+            replicationClient.reset();
+        } else if (!replication_client_open(*replicationClient, address, replicationSettings, replicationError)) {
+            fprintf(stderr, "Cannot connect to %s: %s\n", connectAddress, replicationError.c_str());
+            replicationClient.reset();
+        }
+    }
+
+    // --- Cascaded shadows from terrain and foliage, redrawn only where casters or coverage changed ---
+    std::unique_ptr<ShadowMap> shadowMap;
+    if (shadow_map_supported(metal)) {
+        shadowMap = std::make_unique<ShadowMap>(create_shadow_map(metal, chunkManager.config().vertexFormat,
+                                                                  shadowSettings));
+    }
+
+    // --- Tessellated terrain around the camera: its chunk and the eight neighbours ---
+    const uint32_t maxTessellatedChunks = 9;
+    std::unique_ptr<GpuTessellation> tessellation;
+    if (gpu_tessellation_supported(metal)) {
+        tessellation = std::make_unique<GpuTessellation>(create_gpu_tessellation(metal, maxTessellatedChunks));
+    }
+
+    // --- Cube map probe: six views from the camera, rendered on request by one multi-view pass ---
+    const uint32_t amplification = multi_view_amplification(metal.device);
+    const uint32_t probeGroups = (CUBE_FACE_COUNT + amplification - 1) / amplification;
+    MultiViewTarget probe = create_multi_view_target(metal.device, PROBE_FACE_SIZE, CUBE_FACE_COUNT, true);
+    bool captureProbe = false;
+    bool probeCaptured = false;
+
+    // --- Environment reflections: a probe around the camera, re-captured a face per frame and prefiltered ---
+    std::unique_ptr<GpuReflectionProbe> reflections;
+    if (gpu_reflection_probe_supported(metal)) {
+        reflections = std::make_unique<GpuReflectionProbe>(create_gpu_reflection_probe(metal));
+    }
+    bool reflecting = reflectionProbe && reflections != nullptr;
+    const uint32_t reflectionGroups =
+        reflections ? (reflections->settings.facesPerFrame + amplification - 1) / amplification : 0;
+
+    // --- Resident instances: every entity's instance data on the GPU, sent again only where it changed ---
+    std::unique_ptr<GpuSceneInstances> sceneInstances;
+    if (residentInstances) {
+        sceneInstances = std::make_unique<GpuSceneInstances>(create_gpu_scene_instances(metal.device,
+                                                                                        (uint32_t)maxEntities));
+    }
+
+    // One uniform slot per draw plus the visible instances, per in-flight frame
+    FrameRing uniformRing =
+        create_frame_ring(metal.device, scene_frame_bytes(maxChunks, meshRegistry, maxEntities, ShadowSettings{}) +
+                                            (tessellation ? gpu_tessellation_frame_bytes(maxTessellatedChunks,
+                                                                                         chunkManager.config().resolution)
+                                                          : 0) +
+                                            multi_view_frame_bytes(maxChunks, meshRegistry, maxEntities,
+                                                                   probeGroups + reflectionGroups) +
+                                            gpu_light_clusters_frame_bytes() +
+                                            gpu_skinning_frame_bytes(herd.size(), herd.animation.skeleton.size()) +
+                                            (sceneInstances ? gpu_scene_instances_frame_bytes(sceneInstances->capacity)
+                                                            : 0));
+
+
+    id<MTLDepthStencilState> depthState = create_depth_state(metal.device, reverseZ);
+
+    // --- GPU-driven chunk culling, with the CPU frustum test as the fallback; not for height-map or volumetric chunks ---
+    std::unique_ptr<GpuCulling> gpuCulling;
+    if (gpu_culling_supported(metal) && !chunkConfig.heightMaps && !chunkConfig.volume.enabled) {
+        gpuCulling = std::make_unique<GpuCulling>(create_gpu_culling(metal, maxChunks, swapchain.width, swapchain.height));
+    }
+    bool useGpuCulling = gpuCulling != nullptr;
+
+    // --- Terrain albedo baked once per chunk into a material atlas, switchable against per-pixel bands ---
+    std::unique_ptr<GpuTerrainMaterials> materials;
+    if (gpu_terrain_materials_supported(metal, chunkConfig)) {
+        materials = std::make_unique<GpuTerrainMaterials>(create_gpu_terrain_materials(metal, chunkConfig));
+    }
+
+    // --- Soft terrain self-shadowing from horizons baked per chunk, where the shadow cascades end ---
+    std::unique_ptr<GpuTerrainHorizons> horizons;
+    if (gpu_terrain_horizons_supported(metal)) {
+        horizons = std::make_unique<GpuTerrainHorizons>(create_gpu_terrain_horizons(metal, chunkConfig));
+    }
+
+    // --- Terrain albedo streamed into a sparse texture from the pages the frames sample ---
+    std::unique_ptr<TerrainVirtualTexture> virtualTexture;
+    if (terrain_virtual_texture_supported(metal.device)) {
+        TerrainVirtualTextureSettings virtualTextureSettings;
+        virtualTextureSettings.world.terrain = chunkManager.config().terrain;
+        virtualTextureSettings.compression = textureCompression;
+        virtualTexture = std::make_unique<TerrainVirtualTexture>(
+            create_terrain_virtual_texture(metal.device, metal.queue, virtualTextureSettings));
+    }
+
+    // --- Tile-based deferred shading, switchable against the forward path ---
+    std::unique_ptr<GBuffer> gbuffer;
+    if (deferred_supported(metal.device)) {
+        gbuffer = std::make_unique<GBuffer>(create_gbuffer(metal.device, reverseZ));
+    }
+
+    // --- Physically based sky from atmosphere lookup tables, refilled only when the sun moves ---
+    std::unique_ptr<Sky> sky;
+    if (sky_supported(metal)) {
+        sky = std::make_unique<Sky>(create_sky(metal));
+    }
+
+    // --- Torches and vehicle lamps scattered around the start, binned into view clusters every frame ---
+    std::unique_ptr<GpuLightClusters> lightClusters;
+    std::vector<LightEmitter> lightEmitters;
+    std::vector<PointLight> pointLights;
+    int pointLightCount = 1024;
+    if (gpu_light_clusters_supported(metal)) {
+        lightClusters = std::make_unique<GpuLightClusters>(create_gpu_light_clusters(metal));
+        const float extent = 0.5f * chunkManager.config().loadRadius * chunkManager.config().chunkSize;
+        lightEmitters = scatter_light_emitters(MAX_POINT_LIGHTS, { cam.position.x, cam.position.z }, extent, 1,
+                                               [&](float x, float z) { return chunkManager.terrain_height(x, z); });
+        pointLights.resize(MAX_POINT_LIGHTS);
+    }
+
+    // --- Screen-space ambient occlusion at half resolution, upsampled over the scene colour ---
+    std::unique_ptr<GpuAmbientOcclusion> ambientOcclusion;
+    if (gpu_ambient_occlusion_supported(metal)) {
+        ambientOcclusion = std::make_unique<GpuAmbientOcclusion>(create_gpu_ambient_occlusion(metal));
+    }
+
+    // --- Ray-traced shadows and occlusion against per-chunk acceleration structures, where supported ---
+    std::unique_ptr<GpuRayTracing> rayTracing;
+    if (gpu_ray_tracing_supported(metal)) {
+        rayTracing = std::make_unique<GpuRayTracing>(create_gpu_ray_tracing(metal));
+    }
+
+    // --- Lower shading rate at the edges and the sky through a rasterization rate map, where supported ---
+    std::unique_ptr<GpuRasterizationRate> rasterizationRate;
+    if (gpu_rasterization_rate_supported(metal)) {
+        rasterizationRate = std::make_unique<GpuRasterizationRate>(create_gpu_rasterization_rate(metal));
+    }
+
+    // --- Render graph: the passes after the scene declare what they use; their transients share heaps ---
+    GpuRenderGraph renderGraph = create_gpu_render_graph(metal.device, (uint32_t)uniformRing.buffers.size());
+
+    // --- Debug wireframes of chunks, entity bounds and a frozen culling frustum; idle until a layer is on ---
+    std::unique_ptr<GpuDebugDraw> debugDraw;
+    if (gpu_debug_draw_supported(metal)) {
+        debugDraw = std::make_unique<GpuDebugDraw>(create_gpu_debug_draw(metal));
+    }
+    std::vector<ChunkKey> debugPending;
+    RenderView frozenView; // The view culling keeps while the frustum is frozen
+
+    // --- Selection: a right click picks an entity through a small ID pass, or the BVH without one ---
+    std::unique_ptr<GpuPicking> picking;
+    if (gpu_picking_supported(metal)) {
+        picking = std::make_unique<GpuPicking>(create_gpu_picking(metal, reverseZ));
+    }
+    bool pickOnGpu = picking != nullptr;
+    bool pickButtonHeld = false;
+    Entity selected;
+    uint64_t pickRequestFrame = 0;
+    uint64_t pickLatency = 0; // Frames from the click to the readback of the last GPU pick
+
+    // --- Look-at: the surface under the point, from the depth buffer a frame or two late ---
+    GpuLookAt lookAtReadback = create_gpu_look_at(metal);
+    bool lookAtOn = true;
+    LookAtResult lookAt; // The newest readout; placement tools aim with it too
+
+    // --- Entities hidden behind the terrain, tested against a software depth buffer of coarse chunk grids ---
+    bool terrainOcclusion = false;
+    OcclusionBuffer occlusionBuffer;
+    TerrainOccluderCache terrainOccluders;
+    terrainOccluders.occluders.reserve(chunkManager.max_resident_chunks());
+
+    // --- Reverse reprojection: the terrain reuses last frame's shadowing where it saw the same surface ---
+    std::unique_ptr<ShadingCache> shadingCache;
+    if (shading_cache_supported(metal.device)) {
+        shadingCache = std::make_unique<ShadingCache>();
+    }
+    ViewHistory viewHistory;
+
+    // --- MSAA resolved in tile memory; 1 means the device supports neither 2x nor 4x ---
+    MsaaTargets msaa;
+    const uint32_t maxSampleCount =
+        msaa_supported(metal.device, 4) ? 4 : msaa_supported(metal.device, 2) ? 2 : 1;
+
+    // --- Per-pass GPU timing; passes are only sampled while the overlay turns it on ---
+    std::unique_ptr<GpuProfiler> gpuProfiler;
+    if (gpu_profiler_supported(metal.device)) {
+        gpuProfiler = std::make_unique<GpuProfiler>(create_gpu_profiler(metal.device));
+    }
+    bool profileGpuPasses = false;
 
+    // --- Per-draw GPU costs: a few frames of draws timed every 60, where the GPU samples between draws ---
+    std::unique_ptr<GpuDrawCosts> gpuDrawCosts;
+    if (gpu_draw_costs_supported(metal.device)) {
+        gpuDrawCosts = std::make_unique<GpuDrawCosts>(create_gpu_draw_costs(metal.device, DrawCostSettings{}));
+    }
+    bool timeDraws = false;
+
+    // --- Dynamic resolution: the GPU budget is one paced frame, 8.3 ms on a 120 Hz ProMotion display ---
+    // --- Temporal anti-aliasing: the same targets, jitter and motion vectors at full scale, see temporal_aa.hpp ---
+    const bool canUpscale = upscaler_supported(metal.device, UpscalerMode::Spatial);
+    const bool canAntiAlias = metal.temporal_aa_pipeline != nil;
+    std::unique_ptr<Upscaler> upscaler;
+    if (canUpscale || canAntiAlias) {
+        upscaler = std::make_unique<Upscaler>(create_upscaler(metal));
+    }
+    const bool canUpscaleTemporally = canUpscale && upscaler_supported(metal.device, UpscalerMode::Temporal);
+    bool dynamicResolution = canUpscale;
+    bool antiAliasing = temporalAA && canAntiAlias;
+    UpscalerMode upscalerMode = UpscalerMode::Spatial;
+    RenderScaleSettings renderScaleSettings;
+    RenderScaleController renderScale;
+    uint64_t lastScaledFrame = 0;
+
+    // --- Quality governor: heat, low power mode and GPU time cap the scale, cascades, view distance and LODs ---
+    bool governing = qualityGovernor;
+    QualityGovernorSettings governorSettings;
+    QualityGovernor governor;
+    uint64_t lastGovernedFrame = 0;
+
+    Camera cam = make_camera(swapchain.width, swapchain.height, reverseZ);
+    fit_camera_to_world(cam, chunkConfig);
+    if (worldLoaded) {
+        set_camera_pose(cam, world_save_camera(savedWorld));
+        unmap_world_save(savedWorld);
+    }
+
+    // --- Camera movement runs at a fixed rate on its own thread; frames draw interpolated snapshots ---
+    const Simulation::StepFunction stepCamera = [&](Camera& simCam, const InputState& input, float step) {
+        if (!input.cursorLocked) {
+            return;
+        }
+        const simd::float3 from = simCam.position;
+        update_camera(simCam, step, input.keys, input.mouseDeltaX, input.mouseDeltaY);
+
+        // Sweep the move against the terrain so fast flights cannot pass through ridges
+        const float eyeHeight = 1.5f;
+        std::lock_guard<std::mutex> lock(heightFieldMutex);
+        simCam.position = height_field_move(heightField, from, simCam.position - from, eyeHeight);
+        if (!height_field_contains(heightField, simCam.position.x, simCam.position.z)) {
+            float terrain_height = chunkManager.terrain_height(simCam.position.x, simCam.position.z);
+            simCam.position.y = std::max(simCam.position.y, terrain_height + eyeHeight);
+        }
+    };
+    if (replayPath) {
+        set_camera_pose(cam, { { recording.camera[0], recording.camera[1], recording.camera[2] }, recording.camera[3],
+                               recording.camera[4] });
+    } else if (recordPath) {
+        const CameraPose start = camera_pose(cam);
+        const float camera[5] = { start.position.x, start.position.y, start.position.z, start.yaw, start.pitch };
+        std::copy(camera, camera + 5, recording.camera);
+        recording.terrainSeed = chunkConfig.terrain.noise.seed;
+        recording.debrisSeed = debris.seed;
+        recording.herdSeed = HERD_SEED;
+    }
+    Simulation simulation(cam, g_inputEvents, stepCamera, {}, recordPath ? &recording.inputs : nullptr);
+    if (recordPath) {
+        recording.step = simulation.settings().step;
+    }
+    // A replay steps its own camera in lockstep with the recorded frames; the thread's runs unused
+    SimulationReplay replay = create_simulation_replay(cam);
+    size_t replayFrame = 0;
+    std::vector<float> replayCpuMs;
+    double renderTime = -1.0;
+    simd::float3 streamedPosition = cam.position; // Camera position at the last chunk update, for its velocity
+
+    FrameStats frameStats;
+    SceneScratch scratch;
+    if (residency) {
+        use_residency_set(*residency, metal, chunkManager, meshRegistry, uniformRing, gpuCulling.get(), scratch);
+        if (rayTracing) {
+            gpu_ray_tracing_set_residency(*rayTracing, residency.get());
+        }
+    }
+    SceneShading shading;
+    shading.shadows = shadowMap != nullptr;
+    shading.deferred = deferred && gbuffer != nullptr;
+    const bool canDrawMeshlets = meshlet_draw_supported(metal.device);
+    shading.meshlets = canDrawMeshlets;
+    shading.virtualTexture = virtualTexture != nullptr;
+    shading.bakedMaterials = bakedMaterials && materials != nullptr;
+    shading.horizonShadows = horizonShadows && horizons != nullptr;
+    shading.vertexLighting = vertexLighting && !shading.deferred;
+    shading.depthPrepass = depthPrepass;
+    shading.residentInstances = sceneInstances != nullptr;
+    scratch.queue.frontToBack = frontToBack;
+    shading.sky = sky != nullptr;
+    shading.impostors = foliage && foliage->atlas.albedo != nil;
+    shading.wind = foliage != nullptr;
+    shading.rayTracing = rayTracedShading && rayTracing != nullptr;
+    shading.variableRate = variableRate && rasterizationRate != nullptr;
+    WindSettings windSettings;
+    FogSettings fogSettings = scene_fog(chunkManager.config());
+    const float streamedFadeEnd = fogSettings.fadeEnd; // Where the governor's view distance is measured against
+
+    // --- Development builds reload shaders.metal when it is saved, without stalling a frame ---
+    std::unique_ptr<ShaderReloader> shaderReloader;
+    if (NSString* shaderSource = metal_shader_source_path()) {
+        shaderReloader = std::make_unique<ShaderReloader>(shaderSource, metal);
+    }
 
-    Camera cam = make_camera(WIDTH, HEIGHT);
-    
-    auto lastTime = std::chrono::high_resolution_clock::now();
+    // --- Terrain painting: the brush follows the view ray while the left button is held ---
+    // A press starts a stroke of the edit history and the release ends it, once the GPU brush's readbacks are in
+    bool paintTerrain = false;
+    TerrainBrush brush;
+    float brushRate = 2.0f; // Strength per second
+    std::unique_ptr<GpuTerrainBrush> gpuBrush; // Created when painting is first turned on
+    bool brushOnGpu = true;
+    bool stroking = false;
+    int historyStep = 0; // -1 to undo a stroke, 1 to redo one, applied with the next edits
+    double brushCollectMs = 0.0;
 
+    // Filled again every frame rather than made anew; see render_pass_reset()
+    MTLRenderPassDescriptor* scenePass = [MTLRenderPassDescriptor new];
+    MTLRenderPassDescriptor* compositePass = [MTLRenderPassDescriptor new];
     while (!glfwWindowShouldClose(window)) {
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float dt = std::chrono::duration<float>(currentTime - lastTime).count();
-        lastTime = currentTime;
-
-        glfwPollEvents();
-        if (g_cursor_locked) {
-            update_camera(cam, dt, g_inputState.keys, g_inputState.mouseX, g_inputState.mouseY);
-
-            // Clamp camera to terrain
-            float terrain_height = get_terrain_height(cam.position.x, cam.position.z);
-            if (cam.position.y < terrain_height + 1.5f) { // 1.5f is camera height above ground
-                cam.position.y = terrain_height + 1.5f;
-            }
-        }
-
-        id<CAMetalDrawable> drawable = [layer nextDrawable];
-        if (drawable) {
-            MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
-            passDesc.colorAttachments[0].texture = drawable.texture;
-            passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
-            passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
-            passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.6, 0.8, 1.0, 1.0); // Sky blue
-            
-            passDesc.depthAttachment.texture = depthTexture;
-            passDesc.depthAttachment.loadAction = MTLLoadActionClear;
-            passDesc.depthAttachment.storeAction = MTLStoreActionDontCare;
-            passDesc.depthAttachment.clearDepth = 1.0;
+        if (replayPath && replayFrame == recording.frames.size()) {
+            break;
+        }
+        uint64_t blocksBeforeDrain = 0;
+        @autoreleasepool {
+            TRACE_SCOPE("Frame");
+            frame_stats_begin_frame(frameStats);
+            const CFTimeInterval frameBegin = CACurrentMediaTime();
+            // The frame after a hitch is captured whole, from its first command buffer to its last
+            const std::string gpuCapturePath = hitch_detector_take_capture(hitchDetector);
+            if (!gpuCapturePath.empty() && gpu_capture_supported()) {
+                std::string captureError;
+                gpuCapturing = gpu_capture_begin(metal.device, gpuCapturePath, captureError);
+                if (!gpuCapturing) {
+                    fprintf(stderr, "Hitch detector: cannot capture %s: %s\n", gpuCapturePath.c_str(),
+                            captureError.c_str());
+                }
+            }
+            frame_arenas_begin_frame(frameArenas, (uint32_t)frameStats.current.frame);
+            scratch.arena = &frame_arena(frameArenas);
 
-            id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
-            id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+            glfwPollEvents();
+            // Between frames, so every pass of a frame draws with pipelines of the same library
+            if (shaderReloader && shaderReloader->apply(metal)) {
+                use_reloaded_pipelines(metal, chunkManager, gpuCulling.get(), foliage.get(), skinning.get(),
+                                       tessellation.get(), terrainClipmap.get(), shadowMap.get(), upscaler.get(),
+                                       transparency.get(), particles.get(), sky.get(), lightClusters.get(),
+                                       ambientOcclusion.get(), debugDraw.get());
+            }
+            if (swapchain.pendingWidth != swapchain.width || swapchain.pendingHeight != swapchain.height) {
+                waitForUnretainedFrames();
+            }
+            // Knobs edited last frame land here, before anything of this frame reads them
+            if (tuning.apply() > 0 && shadowMap) {
+                if (tuning.changed(shadowResolutionKnob)) {
+                    waitForUnretainedFrames();
+                    shadowSettings.resolution = (uint32_t)shadowResolution;
+                    shadowSettings.maxUpdatesPerFrame = (uint32_t)shadowUpdates;
+                    shadowMap = std::make_unique<ShadowMap>(create_shadow_map(
+                        metal, chunkManager.config().vertexFormat, shadowSettings));
+                } else if (tuning.changed(shadowDistanceKnob) || tuning.changed(shadowUpdatesKnob)) {
+                    shadowMap->cascades.settings.maxDistance = shadowSettings.maxDistance;
+                    shadowMap->cascades.settings.maxUpdatesPerFrame = (uint32_t)shadowUpdates;
+                    for (ShadowCascade& cascade : shadowMap->cascades.cascades) {
+                        cascade.valid = false;
+                    }
+                }
+            }
+            if (swapchain_begin_frame(swapchain)) {
+                set_camera_viewport(cam, swapchain.width, swapchain.height);
+            }
+
+            displayLink.set_display([nsWindow.screen.deviceDescription[@"NSScreenNumber"] unsignedIntValue]);
+            const double refreshPeriod = displayLink.refresh_period();
+            const double now = simulation_clock();
+            float dt = frame_pacer_tick(pacer, pacingSettings, refreshPeriod, now);
+            if (replayPath) {
+                dt = recording.frames[replayFrame].dt;
+            }
+            const double frameInterval = frame_pacing_interval(pacingSettings, refreshPeriod);
+            renderScaleSettings.targetMs = (float)((frameInterval > 0.0 ? frameInterval : refreshPeriod) * 1000.0);
 
-            [enc setRenderPipelineState:metal.pipeline];
-            [enc setDepthStencilState:depthState];
-            [enc setVertexBuffer:uniformBuffer offset:0 atIndex:1];
+            // Each GPU time is fed once, as soon as its command buffer has completed
+            uint64_t gpuFrame = 0;
+            float gpuMs = frame_stats_latest_gpu(frameStats, gpuFrame);
+            // Ahead of the render scale, whose ceiling the tier sets
+            governorSettings.targetMs = renderScaleSettings.targetMs;
+            if (governing) {
+                quality_governor_update(governor, governorSettings, current_power_state(),
+                                        gpuFrame > lastGovernedFrame ? gpuMs : -1.0f);
+                lastGovernedFrame = gpuFrame;
+            }
+            QualityTier tier = governing ? quality_governor_tier(governor, governorSettings)
+                                         : governorSettings.tiers[0];
+            tier.maxRenderScale = std::min(tier.maxRenderScale, renderScaleCap);
+            tier.viewDistance *= viewDistance;
+            tier.lodBias *= lodBias;
+            renderScaleSettings.minScale = std::min(renderScaleFloor, tier.maxRenderScale);
+            renderScaleSettings.maxScale = tier.maxRenderScale;
+            renderScale.scale = std::min(renderScale.scale, renderScaleSettings.maxScale);
+            if (dynamicResolution && gpuFrame > lastScaledFrame) {
+                lastScaledFrame = gpuFrame;
+                render_scale_update(renderScale, renderScaleSettings, gpuMs);
+            }
+            if (shadowMap) {
+                // The map's array was created for the full count; the cascades are refitted to the new splits
+                const uint32_t cascades = std::min(tier.shadowCascades, (uint32_t)shadowMap->texture.arrayLength);
+                if (shadowMap->cascades.settings.cascadeCount != cascades) {
+                    shadowMap->cascades.settings.cascadeCount = cascades;
+                    for (ShadowCascade& cascade : shadowMap->cascades.cascades) {
+                        cascade.valid = false;
+                    }
+                }
+            }
+            // The options the upscaler's, MSAA, G-buffer, depth and Hi-Z targets are allocated for below
+            const uint32_t targetOptions = (dynamicResolution ? 1u : 0u) | (shading.deferred ? 2u : 0u) |
+                                           (useGpuCulling ? 4u : 0u) | (drawWater ? 8u : 0u) |
+                                           (shading.ambientOcclusion ? 16u : 0u) | (shading.virtualTexture ? 32u : 0u) |
+                                           (shading.pointLights ? 64u : 0u) | (shading.clipmap ? 128u : 0u) |
+                                           (debugDraw && debugDraw->settings.freezeFrustum ? 256u : 0u) |
+                                           (shading.variableRate ? 512u : 0u) | (antiAliasing ? 1024u : 0u);
+            uint32_t scaleBits = 0;
+            memcpy(&scaleBits, &renderScale.scale, sizeof(scaleBits));
+            const std::array<uint32_t, 6> frameTargetsKey = { swapchain.width, swapchain.height, scaleBits,
+                                                              (uint32_t)upscalerMode, shading.sampleCount,
+                                                              targetOptions };
+            if (frameTargetsKey != targetsKey) {
+                waitForUnretainedFrames();
+                targetsKey = frameTargetsKey;
+            }
 
-            for (size_t i = 0; i < gameObjects.size(); ++i) {
-                const auto& go = gameObjects[i];
+            // Below full scale the scene renders into the upscaler's targets instead of the drawable, and at full
+            // scale too with TAA on, which resolves out of them. Scaling with TAA on goes through the temporal
+            // scaler, which anti-aliases as it accumulates, so the two never cost two passes.
+            bool upscaling = false;
+            const bool scaled = dynamicResolution && renderScale.scale < 1.0f;
+            if (upscaler && (scaled || antiAliasing) && swapchain_has_area(swapchain)) {
+                const UpscalerMode mode = !scaled                                 ? UpscalerMode::TemporalAA
+                                          : antiAliasing && canUpscaleTemporally ? UpscalerMode::Temporal
+                                                                                 : upscalerMode;
+                const float scale = scaled ? renderScale.scale : 1.0f;
+                upscaler_configure(*upscaler, render_scale_dimension(swapchain.width, scale),
+                                   render_scale_dimension(swapchain.height, scale), swapchain.width, swapchain.height,
+                                   mode);
+                upscaling = upscaler->output != nil;
+            }
+            if (upscaler && !upscaling) {
+                upscaler->hasHistory = false; // Whatever it accumulated is stale by the time it runs again
+            }
+            // The rate map is another way of shading fewer pixels than the screen has, so it stands down while
+            // the upscaler runs. Its profile changes from the overlay rebuild it outside the targets key.
+            GpuRasterizationRate* rateMapped =
+                shading.variableRate && !upscaling && swapchain_has_area(swapchain) ? rasterizationRate.get() : nullptr;
+            if (rateMapped && !gpu_rasterization_rate_current(*rateMapped, swapchain.width, swapchain.height)) {
+                waitForUnretainedFrames();
+                gpu_rasterization_rate_configure(*rateMapped, swapchain.width, swapchain.height);
+            }
+            rateMapped = rateMapped && rateMapped->map ? rateMapped : nullptr;
+            // The culled draws bind only the fragment buffers they were encoded with, which stop short of
+            // the virtual texture's and the light clusters', so their terrain takes the CPU-culled path. So does
+            // a frozen frustum, which only the CPU culling keeps, and ray tracing, whose acceleration structure
+            // they cannot bind either. The clipmap draws no chunks to cull, and a rate-mapped depth buffer is not
+            // laid out in screen pixels as the Hi-Z pyramid expects.
+            const bool frozen = debugDraw && debugDraw->settings.freezeFrustum;
+            GpuCulling* culling = useGpuCulling && !shading.virtualTexture && !shading.pointLights && !frozen &&
+                                          !shading.clipmap && !shading.rayTracing && !rateMapped
+                                      ? gpuCulling.get()
+                                      : nullptr;
+            GpuProfiler* profiler = profileGpuPasses ? gpuProfiler.get() : nullptr;
+            // Depth only leaves tile memory when Hi-Z, the temporal scaler, ambient occlusion or the look-at
+            // readback reads it, or the transparent pass tests against it. All read the scene in screen pixels, so
+            // none runs over a rate-mapped scene.
+            Transparency* transparent = drawWater && !rateMapped ? transparency.get() : nullptr;
+            if (transparent) {
+                transparent->reflections =
+                    reflecting && reflections->schedule.published ? reflections->filtered : nil;
+            }
+            GpuAmbientOcclusion* occlusion =
+                shading.ambientOcclusion && !rateMapped ? ambientOcclusion.get() : nullptr;
+            const bool readDepth = culling != nullptr || (upscaling && upscaler->mode != UpscalerMode::Spatial);
+            const bool readLookAt = lookAtOn && !rateMapped;
+            const bool keepDepth = readDepth || transparent != nullptr || occlusion != nullptr || readLookAt;
+            TransientTarget& depthTarget = upscaling    ? upscaler->depth
+                                           : rateMapped ? rateMapped->depth
+                                                        : swapchain.depth;
+            id<MTLTexture> sceneDepth =
+                swapchain_has_area(swapchain) ? transient_target_texture(depthTarget, keepDepth) : nil;
+            const uint32_t sceneWidth = upscaling ? upscaler->inputWidth : swapchain.width;
+            const uint32_t sceneHeight = upscaling ? upscaler->inputHeight : swapchain.height;
+            if (culling && sceneDepth &&
+                (gpuCulling->hiz.width != sceneDepth.width || gpuCulling->hiz.height != sceneDepth.height)) {
+                gpu_culling_resize(*gpuCulling, metal, (uint32_t)sceneDepth.width, (uint32_t)sceneDepth.height);
+            }
+            frame_stats_end_phase(frameStats, PHASE_INPUT);
 
-                if (i == 0) { // Index 0 is the landscape
-                    [enc setRenderPipelineState:metal.landscape_pipeline];
-                } else {
-                    [enc setRenderPipelineState:metal.pipeline];
+            // Paced deltas keep the sampled time on the presentation grid, which starts at a refresh the display
+            // link reported rather than whenever this frame woke up; a stall resynchronizes it
+            const double vsync = frame_pacing_interval(pacingSettings, refreshPeriod) > 0.0
+                                     ? frame_vsync_time(displayLink.vsync_time(), refreshPeriod, now)
+                                     : now;
+            renderTime = renderTime < 0.0 || std::abs(renderTime + dt - vsync) > simulation.settings().step
+                             ? vsync
+                             : renderTime + dt;
+            // World time: what animates and simulates the world, as opposed to the camera
+            const float worldDt = game_clock_advance(gameClock, gameClockSettings, dt);
+            if (replayPath) {
+                const RecordedFrame& frame = recording.frames[replayFrame++];
+                set_camera_pose(cam, simulation_replay_frame(replay, recording, frame, stepCamera));
+            } else {
+                const SimulationSnapshot& latest = simulation.latest();
+                const float alpha = snapshot_alpha(latest, simulation.settings(), renderTime);
+                set_camera_pose(cam, interpolate_pose(latest.previous, latest.current, alpha));
+                if (recordPath) {
+                    recording.frames.push_back({ dt, latest.tick, alpha });
                 }
+            }
 
-                [enc setVertexBuffer:vertexBuffers[i] offset:0 atIndex:0];
+            frame_stats_end_phase(frameStats, PHASE_CAMERA);
 
-                Uniforms uniforms;
-                uniforms.modelMatrix = go.modelMatrix;
-                uniforms.viewMatrix = cam.viewMatrix;
-                uniforms.projectionMatrix = cam.projectionMatrix;
-                uniforms.color = go.color;
-                memcpy(uniformBuffer.contents, &uniforms, sizeof(Uniforms));
-                
-                [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
-                                indexCount:go.indices.size()
-                                 indexType:MTLIndexTypeUInt32
-                               indexBuffer:indexBuffers[i]
-                         indexBufferOffset:0];
+            // Nothing the fog hides completely is streamed in or drawn. A tier that shortens the view distance
+            // brings the far fade in, and turns it on for the scene pass if it was off.
+            FogSettings fog = active_fog(fogSettings, shading);
+            const bool viewLimited = tier.viewDistance < 1.0f;
+            if (viewLimited) {
+                fog.fadeEnd = std::min(fog.fadeEnd, tier.viewDistance * streamedFadeEnd);
+                fog.fadeStart = std::min(fog.fadeStart, 0.75f * fog.fadeEnd);
             }
+            const float fogDistance = fog_cull_distance(fog);
 
-            // --- ImGui Rendering ---
-            ImGui_ImplMetal_NewFrame(passDesc);
-            ImGui_ImplGlfw_NewFrame();
-            ImGui::NewFrame();
+            const uint64_t allocationsBefore = heap_allocation_count();
+            {
+                TRACE_SCOPE("Streaming");
+                uploader.begin_frame();
+                chunkManager.update(chunk_streaming_view(cam.position, streamedPosition, dt,
+                                                         cam.projectionMatrix * cam.viewMatrix),
+                                    *scratch.arena, fogDistance);
+                streamedPosition = cam.position;
+                if (streamObjects) {
+                    const std::vector<ResidentChunk>& resident = chunkManager.resident();
+                    ChunkKey* keys = scratch.arena->allocate_array<ChunkKey>(resident.size());
+                    for (size_t i = 0; i < resident.size(); ++i) {
+                        keys[i] = resident[i].key;
+                    }
+                    scene_cells_update(sceneCells, scene, keys, resident.size(), scatterCell);
+                }
+                if (residency) {
+                    residency->commit();
+                }
+                const bool painting = paintTerrain && !io.WantCaptureMouse &&
+                                      glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+                TerrainGridRect edited;
+                if (gpuBrush) {
+                    const size_t inFlight = gpuBrush->pending.size();
+                    const auto collectStart = std::chrono::steady_clock::now();
+                    edited = gpu_terrain_brush_collect(*gpuBrush, chunkManager);
+                    if (gpuBrush->pending.size() != inFlight) {
+                        brushCollectMs = std::chrono::duration<double, std::milli>(
+                                             std::chrono::steady_clock::now() - collectStart).count();
+                    }
+                }
+                // Strokes open and close, and undo steps, only with every brush of the stroke written back
+                const bool brushPending = gpuBrush && gpu_terrain_brush_pending(*gpuBrush);
+                if (painting != stroking && !brushPending) {
+                    if (painting) {
+                        chunkManager.begin_edit_stroke();
+                    } else {
+                        chunkManager.end_edit_stroke();
+                    }
+                    stroking = painting;
+                }
+                if (historyStep != 0 && !stroking && !brushPending) {
+                    const TerrainGridRect changed = historyStep < 0 ? chunkManager.undo_edit()
+                                                                    : chunkManager.redo_edit();
+                    if (gpuBrush) {
+                        gpu_terrain_brush_invalidate(*gpuBrush, changed);
+                    }
+                    edited = terrain_grid_rect_union(edited, changed);
+                    historyStep = 0;
+                }
+                TerrainHit hit;
+                if (painting && stroking) {
+                    std::lock_guard<std::mutex> lock(heightFieldMutex);
+                    if (height_field_raycast(heightField, cam.position, cam.forward, 256.0f, hit)) {
+                        brush.centerX = hit.position.x;
+                        brush.centerZ = hit.position.z;
+                        brush.targetHeight = hit.position.y;
+                        brush.strength = brushRate * dt;
+                        // The CPU takes the brushes the GPU cannot, once nothing it read back could overwrite them
+                        const bool onGpu = brushOnGpu && gpuBrush &&
+                                           gpu_terrain_brush_apply(*gpuBrush, metal, uploader, chunkManager, brush);
+                        if (!onGpu && !brushPending) {
+                            const TerrainGridRect changed = chunkManager.edit(brush).changed;
+                            if (gpuBrush) {
+                                gpu_terrain_brush_invalidate(*gpuBrush, changed);
+                            }
+                            edited = terrain_grid_rect_union(edited, changed);
+                        }
+                    }
+                }
+                if (!edited.empty()) {
+                    std::lock_guard<std::mutex> lock(heightFieldMutex);
+                    // Only field samples within a grid cell of the changed points are resampled
+                    const TerrainGridRect dirty = terrain_grid_rect_expand(edited, 1);
+                    const float spacing = chunkManager.edits().spacing();
+                    chunkManager.resample_height_field(heightField, dirty.x0 * spacing, dirty.z0 * spacing,
+                                                       dirty.x1 * spacing, dirty.z1 * spacing);
+                    const auto navStart = std::chrono::steady_clock::now();
+                    navTilesRebuilt = nav_mesh_rebuild(navMesh, heightField, jobs, dirty.x0 * spacing,
+                                                       dirty.z0 * spacing, dirty.x1 * spacing, dirty.z1 * spacing);
+                    navRebuildMs = std::chrono::duration<double, std::milli>(
+                                       std::chrono::steady_clock::now() - navStart).count();
+                    audio_occlusion_invalidate(audioOcclusion);
+                    if (particles) {
+                        gpu_particles_update_heights(*particles, uploader, heightField);
+                        particleHeightUploads = uploader.flush();
+                    }
+                }
+                // A coarser LOD bias allows that many times the pixel error, as if the view were that much smaller
+                chunkManager.update_lods(cam.position,
+                                         std::max(sceneHeight, 1u) / (2.0f * tanf(M_PI / 6.0f)) / tier.lodBias,
+                                         *scratch.arena);
+                // An observer's entities move only as the server says
+                if (replicationClient) {
+                    debrisSettings.rate = 0.0f;
+                    physicsDrops = 0;
+                    replication_client_update(*replicationClient, scene, meshBounds, cam.position, simulation_clock());
+                }
+                debris_update(debris, scene, debrisSettings, worldDt, cam.position, cam.forward,
+                              debrisMesh, meshRegistry.meshes[debrisMesh].bounds);
+                if (crowd.size() > 0 && !replicationClient) {
+                    std::lock_guard<std::mutex> lock(heightFieldMutex);
+                    crowd_update(crowd, scene, jobs, heightField, crowdSettings, worldDt);
+                }
+                if (physicsClear) {
+                    for (Entity entity : physicsEntities) {
+                        scene_destroy(scene, entity);
+                    }
+                    physicsEntities.clear();
+                    physics_clear(physics);
+                    physicsClear = false;
+                }
+                // A drop is a loose block of spheres in the air ahead of the camera
+                for (; physicsDrops > 0; --physicsDrops) {
+                    const simd::float3 forward = camera_forward(cam.yaw, 0.0f);
+                    const simd::float3 center = cam.position + forward * 20.0f + simd::float3{ 0.0f, 8.0f, 0.0f };
+                    for (uint32_t i = 0; i < PHYSICS_DROP && physics.size() < MAX_PHYSICS_BODIES; ++i) {
+                        const uint32_t hash = foliage_hash((uint32_t)physics.size());
+                        const simd::float3 offset = { (float)(i % 10) - 4.5f, (float)(i / 100),
+                                                      (float)(i / 10 % 10) - 4.5f };
+                        const uint32_t body = physics_add_sphere(physics, center + offset * 1.25f,
+                                                                 0.3f + 0.25f * (float)(hash & 255) / 255.0f);
+                        const simd::float3 color = { 0.3f + 0.6f * (float)((hash >> 8) & 255) / 255.0f,
+                                                     0.3f + 0.6f * (float)((hash >> 16) & 255) / 255.0f, 0.8f };
+                        physicsEntities.push_back(scene_create(scene, sphereMesh,
+                                                               meshRegistry.meshes[sphereMesh].bounds,
+                                                               physics_body_matrix(physics, body, 1.0f), color));
+                    }
+                }
+                if (physics.size() > 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(heightFieldMutex);
+                        physics_update(physics, jobs, heightField, worldDt);
+                    }
+                    // The bodies of the last step, those that just fell asleep included, blend towards it
+                    const float alpha = physics_alpha(physics);
+                    for (uint32_t i : physics.active) {
+                        scene_set_transform(scene, physicsEntities[i], physics_body_matrix(physics, i, alpha));
+                    }
+                }
+                transform_graph_update(transformGraph, scene);
+                scene_update_bounds(scene);
+                if (replicationServer) {
+                    replication_server_update(*replicationServer, scene, simulation_clock());
+                }
+                if (saveWorld && worldSaveCounter.done()) {
+                    saveWorld = false;
+                    ++worldSaves;
+                    world_save_capture(scene, camera_pose(cam), chunkManager.edits(), worldSave);
+                    // Debris, spheres and the crowd only last as long as their simulation, which is not saved
+                    worldSaveTransient.assign(debris.entities.begin(), debris.entities.end());
+                    worldSaveTransient.insert(worldSaveTransient.end(), physicsEntities.begin(), physicsEntities.end());
+                    worldSaveTransient.insert(worldSaveTransient.end(), crowd.entities.begin(), crowd.entities.end());
+                    // Streamed objects are saved in their cells instead
+                    scene_cells_entities(sceneCells, worldSaveTransient);
+                    if (scene_cells_flush(sceneCells, scene) > 0) {
+                        fprintf(stderr, "Cannot write the object cells to %s\n", sceneCells.directory.c_str());
+                    }
+                    jobs.run([&] {
+                        const double start = simulation_clock();
+                        for (Entity entity : worldSaveTransient) {
+                            scene_destroy(worldSave.scene, entity);
+                        }
+                        worldSaveWritten = write_world_save(worldPath, worldSave);
+                        worldSaveSeconds = simulation_clock() - start;
+                    }, &worldSaveCounter, JobPriority::Background);
+                }
+                if (drawCreatures) {
+                    std::lock_guard<std::mutex> lock(heightFieldMutex);
+                    herd_update(herd, jobs, heightField, gameClock.time, worldDt);
+                }
+                audioTickTime += dt;
+                if (drawCreatures && audioTickTime >= AUDIO_TICK_SECONDS) {
+                    audioTickTime = std::fmod(audioTickTime, AUDIO_TICK_SECONDS);
+                    audioOcclusion.positions.resize(herd.size());
+                    for (uint32_t i = 0; i < herd.size(); ++i) {
+                        audioOcclusion.positions[i] = { herd.bounds.centerX[i], herd.bounds.centerY[i],
+                                                        herd.bounds.centerZ[i] };
+                    }
+                    std::lock_guard<std::mutex> lock(heightFieldMutex);
+                    audio_occlusion_update(audioOcclusion, heightField, jobs, cam.position, audioOcclusionSettings);
+                }
+                // The cursor picks once released with Tab, the crosshair while it is locked. The BVH answers
+                // at once with the entity's bounds; the ID pass answers a few frames later, exactly
+                const bool pickButton = !io.WantCaptureMouse &&
+                                        glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+                const float pickDistance = chunkManager.config().loadRadius * chunkManager.config().chunkSize;
+                if (pickButton && !pickButtonHeld) {
+                    const simd::float2 point = view_point(window);
+                    if (picking && pickOnGpu) {
+                        gpu_picking_request(*picking, point);
+                        pickRequestFrame = frameStats.current.frame;
+                    } else {
+                        const PickRay ray = pick_ray(cam.projectionMatrix * cam.viewMatrix, point, cam.reverseZ);
+                        std::lock_guard<std::mutex> lock(heightFieldMutex);
+                        selected = pick_raycast(scene, &heightField, ray, pickDistance);
+                    }
+                }
+                pickButtonHeld = pickButton;
+                Entity picked;
+                PickRay pickedRay;
+                if (picking && gpu_picking_poll(*picking, scene, picked, pickedRay)) {
+                    pickLatency = frameStats.current.frame - pickRequestFrame;
+                    if (scene_alive(scene, picked)) {
+                        std::lock_guard<std::mutex> lock(heightFieldMutex);
+                        if (pick_hidden_by_terrain(scene, heightField, pickedRay, picked, pickDistance)) {
+                            picked = Entity{};
+                        }
+                    }
+                    selected = picked;
+                }
+            }
+            LookAtQuery lookAtQuery;
+            float lookAtDepth = 0.0f;
+            if (gpu_look_at_poll(lookAtReadback, lookAtQuery, lookAtDepth)) {
+                std::lock_guard<std::mutex> lock(heightFieldMutex);
+                lookAt = look_at_resolve(lookAtQuery, lookAtDepth, heightField, chunkManager.config().biomes);
+            }
+            frame_stats_end_phase(frameStats, PHASE_STREAMING);
 
-            ImGui::Begin("Controls");
-            ImGui::Text("Move: W, A, S, D");
-            ImGui::Text("Look: Mouse");
-            ImGui::Text("Up/Down: Space/C");
-            ImGui::Text("Toggle Cursor Lock: Tab");
-            ImGui::Text("Exit: Esc");
-            ImGui::End();
+            frame_ring_begin_frame(uniformRing);
+            frame_stats_end_phase(frameStats, PHASE_WAIT);
 
-            ImGui::Render();
-            ImGui_ImplMetal_RenderDrawData(ImGui::GetDrawData(), cmd, enc);
+            // Nothing to draw into while minimized
+            if (!swapchain_has_area(swapchain)) {
+                frame_ring_abort_frame(uniformRing);
+            } else {
+                gpu_profiler_begin_frame(profiler, frameStats.current.frame);
 
+                // --- Offscreen passes: committed before a drawable is requested ---
+                // The temporal scaler and TAA need a sub-pixel offset every frame; culling and Hi-Z follow the
+                // jittered camera
+                const Camera renderCam = upscaling ? upscaler_begin_frame(*upscaler, cam) : cam;
+                id<MTLTexture> sceneColor = upscaling    ? upscaler->color
+                                            : rateMapped ? rateMapped->color
+                                                         : swapchain.color;
+                MTLRenderPassDescriptor* passDesc =
+                    make_scene_pass(scenePass, sceneColor, sceneDepth, keepDepth, camera_clear_depth(renderCam));
+                // The G-buffer and MSAA targets follow sceneColor below, so they take the physical size too
+                if (rateMapped) {
+                    passDesc.rasterizationRateMap = rateMapped->map;
+                }
+                if (shading.overdraw && !shading.deferred) {
+                    // The heat map starts from nothing shaded
+                    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 1.0);
+                }
+                GBuffer* deferredTarget = shading.deferred ? gbuffer.get() : nullptr;
+                if (deferredTarget) {
+                    gbuffer_resize(*deferredTarget, metal.device, (uint32_t)sceneColor.width,
+                                   (uint32_t)sceneColor.height, shading.sampleCount);
+                    gbuffer_attach(*deferredTarget, passDesc);
+                }
+                if (shading.sampleCount > 1) {
+                    msaa_resize(msaa, metal.device, shading.sampleCount, (uint32_t)sceneColor.width,
+                                (uint32_t)sceneColor.height);
+                    msaa_attach(msaa, passDesc, reverseZ);
+                }
+                frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Scene"));
+                gpu_profiler_sample_pass(profiler, passDesc, GPU_PASS_SCENE);
 
-            [enc endEncoding];
+                id<MTLCommandBuffer> sceneCmd = command_buffer_new(commandBuffers, metal.queue, @"Scene");
+                // Upload values only grow, so waiting for the later one covers both
+                uploader.encode_wait(sceneCmd, std::max({ staticUploads, chunkManager.edit_upload_value(),
+                                                          particleHeightUploads }));
+                // Sent even while drawn the old way, so the changes do not pile up; before every pass reading it
+                if (sceneInstances) {
+                    gpu_scene_instances_upload(*sceneInstances, scene, sceneCmd, uniformRing);
+                }
+                id<MTLBuffer> residentBuffer =
+                    shading.residentInstances && sceneInstances && gpu_scene_instances_ready(*sceneInstances, scene)
+                        ? sceneInstances->buffer
+                        : nil;
+                // Built after the uploads and patches it reads; the shadow map stands in until there is something
+                // to trace
+                GpuRayTracing* traced = shading.rayTracing ? rayTracing.get() : nullptr;
+                if (traced) {
+                    gpu_ray_tracing_update(*traced, sceneCmd, chunkManager, meshRegistry, scene, uniformRing,
+                                           renderCam.position);
+                    traced = gpu_ray_tracing_ready(*traced) ? traced : nullptr;
+                }
+                // The light clusters and the shading cache are indexed by screen pixel, which a rate-mapped pass's
+                // fragments do not land on one to one; the occlusion was turned off above
+                SceneShading passShading = shading;
+                passShading.farFade = shading.farFade || viewLimited;
+                if (rateMapped) {
+                    passShading.pointLights = false;
+                    passShading.shadingCache = false;
+                    passShading.ambientOcclusion = false;
+                }
+                passShading.residentInstances = residentBuffer != nil;
+                ScenePipelines pipelines = scene_pipelines(metal, chunkManager, passShading, traced != nullptr, false);
+                pipelines.sceneInstances = residentBuffer;
+                const GpuMesh& cube = meshRegistry.meshes[mesh_registry_primitive(meshRegistry, Primitive::Cube)];
+                if (foliage) {
+                    foliage->impostors = shading.impostors;
+                    gpu_foliage_encode(*foliage, sceneCmd, chunkManager, uniformRing, renderCam, cube,
+                                       *scratch.arena);
+                }
+                GpuSkinning* skinned = drawCreatures ? skinning.get() : nullptr;
+                if (skinned) {
+                    gpu_skinning_encode(*skinned, sceneCmd, uniformRing, herd.palettes.data(), herd.world.data(),
+                                        herd.colors.data(), herd.size());
+                }
+                ShadowMap* shadows = shading.shadows && !traced ? shadowMap.get() : nullptr;
+                if (shadows) {
+                    shadow_map_encode(*shadows, sceneCmd, chunkManager, uniformRing, renderCam, foliage.get(), cube,
+                                      skinned, frameStats, profiler);
+                }
+                GpuTerrainClipmap* clipmapped = shading.clipmap ? terrainClipmap.get() : nullptr;
+                if (clipmapped) {
+                    gpu_terrain_clipmap_encode(*clipmapped, sceneCmd, renderCam);
+                }
+                GpuTessellation* tessellated = shading.tessellation && !clipmapped ? tessellation.get() : nullptr;
+                if (tessellated) {
+                    const Frustum frustum = extract_frustum(renderCam.projectionMatrix * renderCam.viewMatrix);
+                    gpu_tessellation_encode(*tessellated, sceneCmd, chunkManager, uniformRing, renderCam, frustum,
+                                            sceneHeight / (2.0f * tanf(M_PI / 6.0f)));
+                }
+                // Reprojection goes through the unjittered matrices, like the temporal scaler's motion vectors
+                const simd::float4x4 viewProjection = cam.projectionMatrix * cam.viewMatrix;
+                const simd::float4x4 previousViewProjection =
+                    view_history_previous(viewHistory, viewProjection, sceneWidth, sceneHeight);
+                const FrameAllocation frameUniforms =
+                    write_frame_uniforms(uniformRing, renderCam, fog, &previousViewProjection,
+                                         (uint32_t)frameStats.current.frame,
+                                         foliage_wind(windSettings, gameClock.time));
+                ShadingCache* cached = passShading.shadingCache && shadows ? shadingCache.get() : nullptr;
+                if (cached) {
+                    shading_cache_begin_frame(*cached, metal.device, sceneCmd, sceneWidth, sceneHeight,
+                                              frameStats.current.frame);
+                }
+                TerrainVirtualTexture* albedoPages = shading.virtualTexture ? virtualTexture.get() : nullptr;
+                if (albedoPages) {
+                    terrain_virtual_texture_update(*albedoPages, sceneCmd, jobs);
+                }
+                GpuTerrainMaterials* baked = shading.bakedMaterials ? materials.get() : nullptr;
+                if (baked) {
+                    gpu_terrain_materials_encode(*baked, sceneCmd, chunkManager);
+                }
+                GpuTerrainHorizons* horizoned =
+                    passShading.horizonShadows && !passShading.deferred && !traced ? horizons.get() : nullptr;
+                if (horizoned) {
+                    // The horizon takes over where the cascades end, which is at most the far plane
+                    float cascadeEnd = 0.0f;
+                    if (shadows) {
+                        float nearZ = 0.0f, farZ = 0.0f;
+                        camera_depth_range(renderCam.projectionMatrix, nearZ, farZ);
+                        cascadeEnd = std::min(farZ, shadows->cascades.settings.maxDistance);
+                    }
+                    gpu_terrain_horizons_encode(*horizoned, sceneCmd, chunkManager, cascadeEnd);
+                }
+                // The sun is fixed for now, so after the first frame this only compares directions
+                Sky* atmosphere = shading.sky ? sky.get() : nullptr;
+                if (atmosphere) {
+                    sky_update(*atmosphere, sceneCmd, LIGHT_DIRECTION);
+                }
+                GpuLightClusters* clustered = passShading.pointLights ? lightClusters.get() : nullptr;
+                if (clustered) {
+                    // No light reaches past the streamed terrain, and none is seen through opaque fog
+                    const float streamed = chunkManager.config().loadRadius * chunkManager.config().chunkSize;
+                    light_emitters_evaluate(lightEmitters.data(), (uint32_t)pointLightCount, gameClock.time,
+                                            pointLights.data());
+                    gpu_light_clusters_encode(*clustered, sceneCmd, uniformRing, renderCam, (uint32_t)sceneColor.width,
+                                              (uint32_t)sceneColor.height, std::min(streamed, fogDistance),
+                                              pointLights.data(), (uint32_t)pointLightCount);
+                }
+                if (culling) {
+                    gpu_culling_encode(*culling, sceneCmd, chunkManager, uniformRing, renderCam, frameUniforms,
+                                       fogDistance, shadows ? &shadows->uniforms : nullptr,
+                                       tessellated ? tessellated->tessellated.data() : nullptr,
+                                       baked ? baked->uniforms : nil);
+                }
+                OcclusionBuffer* occluders = terrainOcclusion ? &occlusionBuffer : nullptr;
+                if (occluders) {
+                    draw_terrain_occluders(*occluders, terrainOccluders, chunkManager,
+                                           frozen ? frozenView : camera_render_view(renderCam), fogDistance, sceneWidth,
+                                           sceneHeight, frameStats.current.frame);
+                }
+                // The scene's draws are bracketed by timestamps in sampled frames, the pre-pass's too
+                GpuDrawCosts* drawCosts = timeDraws ? gpuDrawCosts.get() : nullptr;
+                DrawTimestamps* drawTimestamps = gpu_draw_costs_begin_frame(drawCosts, frameStats.current.frame);
+                scratch.queue.timestamps = drawTimestamps;
+                scratch.prepass.timestamps = drawTimestamps;
+                encode_scene(sceneCmd, passDesc, pipelines, chunkManager, meshRegistry, scene, depthState,
+                             uniformRing, renderCam, frameUniforms, fogDistance, scratch, culling, foliage.get(),
+                             skinned, tessellated, shadows, albedoPages, baked, atmosphere, clustered, cached,
+                             deferredTarget, jobs, encodeThreads, frameStats, frozen ? &frozenView : nullptr,
+                             occluders, clipmapped, traced, horizoned);
+                gpu_draw_costs_end_frame(drawCosts, sceneCmd);
+                scratch.queue.timestamps = nullptr;
+                scratch.prepass.timestamps = nullptr;
+                // Before the water, which has no depth of its own and would be darkened by what lies below it
+                gpu_render_graph_begin(renderGraph, uniformRing.frameIndex);
+                const uint32_t colorResource = gpu_render_graph_import(renderGraph, sceneColor, "Scene colour");
+                const uint32_t depthResource = gpu_render_graph_import(renderGraph, sceneDepth, "Scene depth");
+                if (occlusion) {
+                    gpu_ambient_occlusion_add_passes(*occlusion, renderGraph, colorResource, depthResource, renderCam,
+                                                     profiler, frameStats, traced);
+                }
+                id<MTLCommandBuffer> computeCmd = nil;
+                if (transparent) {
+                    if (asyncCompute) {
+                        computeCmd = command_buffer_new(commandBuffers, metal.computeQueue, @"Async compute");
+                    }
+                    if (particles) {
+                        // A fountain on the ground ahead of the camera; right is horizontal, so this is too
+                        const simd::float3 ahead = simd::cross(simd::float3{ 0.0f, 1.0f, 0.0f }, renderCam.right);
+                        simd::float3 emitter = renderCam.position + 15.0f * ahead;
+                        {
+                            std::lock_guard<std::mutex> lock(heightFieldMutex);
+                            emitter.y = height_field_height(heightField, emitter.x, emitter.z) + 0.5f;
+                        }
+                        gpu_particles_add_passes(*particles, renderGraph, renderCam, worldDt, emitter,
+                                                 { 0.0f, 1.0f, 0.0f }, profiler);
+                    }
+                    transparency_add_passes(*transparent, renderGraph, colorResource, depthResource, readDepth,
+                                            renderCam, frameUniforms, gameClock.time,
+                                            computeCmd ? RENDER_GRAPH_COMPUTE_QUEUE : RENDER_GRAPH_RENDER_QUEUE,
+                                            profiler, frameStats);
+                }
+                gpu_render_graph_execute(renderGraph, computeCmd ? @[ sceneCmd, computeCmd ] : @[ sceneCmd ],
+                                         frameStats);
+                // Back to screen pixels before the debug lines, the picking and the composite
+                if (rateMapped) {
+                    gpu_rasterization_rate_resolve(*rateMapped, sceneCmd, swapchain.color, frameStats);
+                }
+                if (captureProbe) {
+                    const ScenePipelines probePipelines =
+                        multi_view_pipelines(metal, chunkManager, shading, residentBuffer);
+                    // A one-off capture waits for its variants to compile rather than leaving them out
+                    if (probePipelines.instanced && (probePipelines.terrain || chunkManager.config().heightMaps)) {
+                        RenderView faces[CUBE_FACE_COUNT];
+                        cube_map_views(renderCam.position, renderCam.nearZ, renderCam.farZ, reverseZ, faces);
+                        encode_multi_view(sceneCmd, make_multi_view_pass(probe, camera_clear_depth(renderCam)),
+                                          faces, CUBE_FACE_COUNT, amplification, probePipelines, chunkManager,
+                                          meshRegistry, scene, depthState, uniformRing, fog, fogDistance, scratch,
+                                          frameStats);
+                        captureProbe = false;
+                        probeCaptured = true;
+                    }
+                }
+                // After the transparent pass, so the water reads the published probe and sees the new one next frame
+                if (reflecting) {
+                    const ReflectionProbeStep step =
+                        reflection_probe_step(reflections->schedule, reflections->settings, renderCam.position);
+                    if (step.faceCount > 0) {
+                        RenderView faces[CUBE_FACE_COUNT];
+                        cube_map_views(step.eye, renderCam.nearZ, renderCam.farZ, reverseZ, faces);
+                        // Slice i of the pass is face firstFace + i
+                        for (uint32_t i = 0; i < step.faceCount; ++i) {
+                            faces[step.firstFace + i].slice = i;
+                        }
+                        encode_multi_view(sceneCmd,
+                                          gpu_reflection_probe_pass(*reflections, step, camera_clear_depth(renderCam)),
+                                          faces + step.firstFace, step.faceCount, amplification,
+                                          multi_view_pipelines(metal, chunkManager, shading, residentBuffer),
+                                          chunkManager, meshRegistry, scene, depthState, uniformRing, fog,
+                                          fogDistance, scratch, frameStats);
+                    }
+                    if (step.prefilter) {
+                        gpu_reflection_probe_prefilter(*reflections, sceneCmd);
+                    }
+                }
+                if (culling) {
+                    gpu_culling_update_hiz(*culling, sceneCmd, sceneDepth, renderCam);
+                }
+                if (upscaling) {
+                    upscaler_encode(*upscaler, sceneCmd, renderCam, cam, previousViewProjection);
+                }
+                view_history_push(viewHistory, viewProjection, sceneWidth, sceneHeight);
+                id<MTLTexture> sceneOutput = upscaling ? upscaler->output : swapchain.color;
+                if (picking) {
+                    gpu_picking_encode(*picking, sceneCmd, scene, meshRegistry, uniformRing, cam,
+                                       (float)swapchain.width, (float)swapchain.height, frameStats);
+                }
+                if (readLookAt) {
+                    gpu_look_at_encode(lookAtReadback, sceneCmd, sceneDepth, renderCam, view_point(window),
+                                       frameStats.current.frame);
+                }
+                if (debugDraw && (debug_draw_enabled(debugDraw->settings) || scene_alive(scene, selected))) {
+                    const RenderView cullView = frozen ? frozenView : camera_render_view(renderCam);
+                    collect_debug_shapes(*debugDraw, chunkManager, scene, navMesh, cullView, fogDistance,
+                                         debugPending, selected);
+                    gpu_debug_draw_encode(*debugDraw, sceneCmd, uniformRing, sceneOutput, cam, frameStats);
+                }
 
-            [cmd presentDrawable:drawable];
-            [cmd commit];
+                frameStats.current.transientBytes = uniformRing.offset;
+                frameStats.memory = gather_memory_report(
+                    chunkManager, heightField, meshRegistry, scene, foliage.get(), skinning.get(), shadowMap.get(),
+                    uniformRing, uploader, gpuCulling.get(), virtualTexture.get(), materials.get(),
+                    render_target_bytes(swapchain, msaa, gbuffer.get(), upscaler.get()) +
+                        multi_view_target_bytes(probe) +
+                        (reflections ? gpu_reflection_probe_bytes(*reflections) : 0) +
+                        (sceneInstances ? gpu_scene_instances_bytes(*sceneInstances) : 0) +
+                        (sky ? sky_bytes(*sky) : 0) + (lightClusters ? gpu_light_clusters_bytes(*lightClusters) : 0) +
+                        (shadingCache ? shading_cache_bytes(*shadingCache) : 0) +
+                        gpu_render_graph_bytes(renderGraph) +
+                        (transparency ? gpu_ocean_bytes(transparency->ocean) : 0) +
+                        (particles ? gpu_particles_bytes(*particles) : 0) +
+                        (terrainClipmap ? gpu_terrain_clipmap_bytes(*terrainClipmap) : 0) +
+                        (rayTracing ? gpu_ray_tracing_bytes(*rayTracing) : 0) +
+                        (picking ? gpu_picking_bytes(*picking) : 0) + gpu_look_at_bytes(lookAtReadback) +
+                        (rasterizationRate ? gpu_rasterization_rate_bytes(*rasterizationRate) : 0) +
+                        ui_overlay_bytes(uiOverlay) + (debugDraw ? gpu_debug_draw_bytes(*debugDraw) : 0));
+                if (horizons) {
+                    frameStats.memory.gpuBytes[MEMORY_TERRAIN] += gpu_terrain_horizons_bytes(*horizons);
+                }
+                frameStats.current.residentBytes = memory_report_gpu_total(frameStats.memory);
+
+                // Replaced by the composite's handler below, which covers the whole frame, if one is presented
+                FrameStats* statsPtr = &frameStats;
+                uint64_t frame = frameStats.current.frame;
+                QueueOverlap* overlapPtr = &queueOverlap;
+                [sceneCmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+                    frame_stats_record_gpu(*statsPtr, frame, (completed.GPUEndTime - completed.GPUStartTime) * 1000.0);
+                    queue_overlap_record(*overlapPtr, GPU_QUEUE_RENDER, completed.GPUStartTime, completed.GPUEndTime);
+                }];
+                if (computeCmd) {
+                    [computeCmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+                        queue_overlap_record(*overlapPtr, GPU_QUEUE_COMPUTE, completed.GPUStartTime,
+                                             completed.GPUEndTime);
+                    }];
+                    // First, so its FFT can start while the render queue works through the shadows and the scene
+                    [computeCmd commit];
+                }
+                frame_ring_end_frame(uniformRing, sceneCmd);
+                frame_latency_track_commit(frameStats, frame, sceneCmd);
+                [sceneCmd commit];
+                frame_stats_end_phase(frameStats, PHASE_ENCODE);
+                check_frame_allocations(frameStats, allocationsBefore);
+
+                // --- ImGui: laid out and rendered into the overlay only when it may have changed; see ui_refresh ---
+                MTLRenderPassDescriptor* overlayPass =
+                    ui_overlay_pass(uiOverlay, metal.device, layer.pixelFormat, swapchain.width, swapchain.height);
+                // Events wait in ImGui's queue until its next frame; a locked cursor steers the camera, not the UI
+                const bool uiInput = !g_cursor_locked && ImGui::GetCurrentContext()->InputEventsQueue.Size > 0;
+                if (ui_refresh_due(uiOverlay.refresh, now, uiInput, swapchain.width, swapchain.height)) {
+                    ImGui_ImplMetal_NewFrame(overlayPass);
+                    ImGui_ImplGlfw_NewFrame();
+                    ImGui::NewFrame();
+
+                    ImGui::Begin("Controls");
+                    ImGui::Text("Move: W, A, S, D");
+                    ImGui::Text("Look: Mouse");
+                    ImGui::Text("Up/Down: Space/C");
+                    ImGui::Text("Toggle Cursor Lock: Tab");
+                    ImGui::Text("Exit: Esc");
+
+                    // Each combination compiles its own pipeline variant the first time it is picked
+                    const char* lightingModels[] = { "Unlit", "Lambert", "Half-Lambert" };
+                    int lighting = (int)shading.lighting;
+                    if (ImGui::Combo("Lighting", &lighting, lightingModels, IM_ARRAYSIZE(lightingModels))) {
+                        shading.lighting = (LightingModel)lighting;
+                    }
+                    ImGui::Checkbox("Fog", &shading.fog);
+                    if (shading.fog) {
+                        ImGui::SliderFloat("Fog density", &fogSettings.density, 0.002f, 0.05f, "%.3f");
+                    }
+                    ImGui::Checkbox("Far fade", &shading.farFade);
+                    if (shading.farFade) {
+                        const float streamed = chunkManager.config().loadRadius * chunkManager.config().chunkSize;
+                        ImGui::SliderFloat("Fade end", &fogSettings.fadeEnd, 16.0f, streamed, "%.0f");
+                        fogSettings.fadeStart = 0.75f * fogSettings.fadeEnd;
+                    }
+                    if (std::isfinite(fogDistance)) {
+                        ImGui::Text("Fog hides everything beyond %.0f", fogDistance);
+                    }
+                    if (shadowMap) {
+                        ImGui::Checkbox("Shadows", &shading.shadows);
+                        if (shading.shadows) {
+                            ImGui::Text("Shadow cascades redrawn: %d", __builtin_popcount(shadowMap->drawnMask));
+                            if (shadingCache) {
+                                ImGui::Checkbox("Reuse shadowing (reprojection cache)", &shading.shadingCache);
+                            }
+                        }
+                    }
+                    if (rayTracing) {
+                        if (ImGui::Checkbox("Ray-traced shadows and AO", &shading.rayTracing) && !shading.rayTracing &&
+                            gpuCulling) {
+                            gpuCulling->hasHistory = false; // GPU culling was off, so the Hi-Z pyramid is stale
+                        }
+                        if (shading.rayTracing) {
+                            int builds = (int)rayTracing->settings.buildsPerFrame;
+                            if (ImGui::SliderInt("Structure builds per frame", &builds, 1, 32)) {
+                                rayTracing->settings.buildsPerFrame = (uint32_t)builds;
+                            }
+                            ImGui::Text("Chunks waiting for a structure: %zu",
+                                        gpu_ray_tracing_pending_count(*rayTracing));
+                        }
+                    }
+                    if (gbuffer) {
+                        ImGui::Checkbox("Deferred shading", &shading.deferred);
+                    }
+                    if (rasterizationRate) {
+                        if (ImGui::Checkbox("Variable rate (edges and sky)", &shading.variableRate) &&
+                            !shading.variableRate && gpuCulling) {
+                            gpuCulling->hasHistory = false; // GPU culling was off, so the Hi-Z pyramid is stale
+                        }
+                        if (shading.variableRate) {
+                            RasterizationRateSettings& rates = rasterizationRate->settings;
+                            ImGui::SliderFloat("Edge rate", &rates.edgeRate, 0.25f, 1.0f, "%.2f");
+                            ImGui::SliderFloat("Sky rate", &rates.skyRate, 0.125f, 1.0f, "%.2f");
+                            ImGui::SliderFloat("Full-rate region", &rates.fovea, 0.0f, 1.0f, "%.2f");
+                            ImGui::SliderFloat("Sky band", &rates.skyBand, 0.0f, 0.5f, "%.2f");
+                            if (upscaling) {
+                                ImGui::TextDisabled("Off while dynamic resolution or TAA resolves the scene");
+                            } else {
+                                ImGui::TextDisabled("Off meanwhile: GPU culling, SSAO, water, point lights, "
+                                                    "shadowing reuse");
+                            }
+                        }
+                    }
+                    if (sky) {
+                        ImGui::Checkbox("Physically based sky", &shading.sky);
+                        if (shading.sky) {
+                            ImGui::Text("Sky view updates: %u", sky->skyViewUpdates);
+                        }
+                    }
+                    if (lightClusters) {
+                        if (ImGui::Checkbox("Point lights (clustered)", &shading.pointLights) && !shading.pointLights &&
+                            gpuCulling) {
+                            gpuCulling->hasHistory = false; // GPU culling was off, so the Hi-Z pyramid is stale
+                        }
+                        if (shading.pointLights) {
+                            ImGui::SliderInt("Point light count", &pointLightCount, 0, (int)MAX_POINT_LIGHTS);
+                        }
+                    }
+                    if (ambientOcclusion) {
+                        ImGui::Checkbox("Ambient occlusion (SSAO)", &shading.ambientOcclusion);
+                        if (shading.ambientOcclusion) {
+                            ImGui::SliderFloat("AO radius", &ambientOcclusion->settings.radius, 0.5f, 16.0f, "%.1f");
+                            ImGui::SliderFloat("AO intensity", &ambientOcclusion->settings.intensity, 0.5f, 4.0f,
+                                               "%.2f");
+                        }
+                    }
+                    if (transparency) {
+                        ImGui::Checkbox("Water (transparent pass)", &drawWater);
+                        if (drawWater) {
+                            ImGui::SliderFloat("Water level", &transparency->water.level, -6.0f, 4.0f, "%.1f");
+                            ImGui::SliderFloat("Water opacity", &transparency->water.color.w, 0.1f, 1.0f, "%.2f");
+                            ImGui::SliderFloat("Wave choppiness", &transparency->ocean.settings.choppiness, 0.0f, 2.5f,
+                                               "%.2f");
+                            if (particles) {
+                                ImGui::SliderFloat("Particles per second", &particles->settings.rate, 0.0f, 50000.0f,
+                                                   "%.0f", ImGuiSliderFlags_Logarithmic);
+                                ImGui::SliderFloat("Particle lifetime", &particles->settings.lifetime, 0.5f, 10.0f,
+                                                   "%.1f");
+                            }
+                            if (metal.computeQueue) {
+                                ImGui::Checkbox("Async compute (ocean)", &asyncCompute);
+                                const QueueOverlapSummary overlap = queue_overlap_summary(queueOverlap);
+                                if (overlap.computeMs > 0.0) {
+                                    ImGui::Text("Compute overlapped with rendering: %.0f%%",
+                                                100.0 * overlap.overlappedMs / overlap.computeMs);
+                                }
+                            }
+                        }
+                    }
+                    if (canDrawMeshlets) {
+                        ImGui::Checkbox("Meshlet culling", &shading.meshlets);
+                    }
+                    if (foliage && foliage->atlas.albedo) {
+                        ImGui::Checkbox("Foliage impostors", &shading.impostors);
+                    }
+                    if (foliage) {
+                        ImGui::Checkbox("Foliage wind", &shading.wind);
+                        if (shading.wind) {
+                            ImGui::SliderFloat("Wind strength", &windSettings.strength, 0.0f, 0.15f, "%.3f");
+                        }
+                    }
+                    if (skinning) {
+                        ImGui::Checkbox("Animated creatures", &drawCreatures);
+                        if (drawCreatures) {
+                            const size_t occluded = std::count_if(audioOcclusion.occlusion.begin(),
+                                                                  audioOcclusion.occlusion.end(),
+                                                                  [](float o) { return o >= 0.5f; });
+                            ImGui::Text("Creatures occluded by terrain: %zu / %u, %u tested last tick", occluded,
+                                        audioOcclusion.size(), audioOcclusion.lastTested);
+                        }
+                    }
+                    if (tessellation) {
+                        ImGui::Checkbox("Terrain tessellation", &shading.tessellation);
+                    }
+                    if (terrainClipmap) {
+                        ImGui::Checkbox("Terrain clipmap", &shading.clipmap);
+                        if (shading.clipmap) {
+                            ImGui::Text("Clipmap texels refreshed: %u", terrainClipmap->refreshedTexels);
+                        }
+                    }
+                    if (!shading.deferred) {
+                        ImGui::Checkbox("Per-vertex lighting for far chunks", &shading.vertexLighting);
+                        if (shading.vertexLighting) {
+                            const std::vector<ResidentChunk>& resident = chunkManager.resident();
+                            const size_t vertexLit = std::count_if(resident.begin(), resident.end(),
+                                                                   [](const ResidentChunk& c) { return c.vertexLit; });
+                            ImGui::Text("Chunks lit per vertex: %zu / %zu", vertexLit, resident.size());
+                        }
+                    }
+                    ImGui::Checkbox("Terrain depth pre-pass", &shading.depthPrepass);
+                    ImGui::Checkbox("Front-to-back draw order", &scratch.queue.frontToBack);
+                    if (sceneInstances) {
+                        ImGui::Checkbox("Resident instances", &shading.residentInstances);
+                        ImGui::Text("Instances uploaded: %zu in %zu ranges",
+                                    sceneInstances->uploadedBytes / sizeof(InstanceData),
+                                    sceneInstances->ranges.size());
+                    }
+                    if (!shading.deferred) {
+                        ImGui::Checkbox("Overdraw heat map", &shading.overdraw);
+                    }
+                    if (materials) {
+                        if (ImGui::Checkbox("Baked terrain materials", &shading.bakedMaterials) &&
+                            shading.bakedMaterials) {
+                            materials->slots.invalidate(); // Tiles were not kept up to date while it was off
+                        }
+                        if (shading.bakedMaterials) {
+                            ImGui::Text("Chunks baked this frame: %u", materials->baked);
+                        }
+                    }
+                    if (horizons && !shading.deferred) {
+                        // Tiles only depend on the noise, so those baked before it was turned off stay valid
+                        ImGui::Checkbox("Horizon shadows past the cascades", &shading.horizonShadows);
+                        if (shading.horizonShadows) {
+                            ImGui::Text("Horizons baked this frame: %u", horizons->baked);
+                        }
+                    }
+                    if (reflections) {
+                        // A probe turned back on recaptures from wherever the camera is then
+                        if (ImGui::Checkbox("Reflection probe", &reflecting) && reflecting) {
+                            reflections->schedule = ReflectionProbeSchedule{};
+                        }
+                        if (reflecting) {
+                            ImGui::Text("Probe captures: %u, next face: %u", reflections->schedule.captures,
+                                        reflections->schedule.nextFace);
+                        }
+                    }
+                    if (virtualTexture) {
+                        if (ImGui::Checkbox("Virtual texture", &shading.virtualTexture) && !shading.virtualTexture &&
+                            gpuCulling) {
+                            gpuCulling->hasHistory = false; // GPU culling was off, so the Hi-Z pyramid is stale
+                        }
+                        if (shading.virtualTexture) {
+                            ImGui::Text("Pages resident: %u / %u, %u loaded", virtualTexture->cache->resident_count(),
+                                        virtualTexture->cache->max_resident_pages(), virtualTexture->pagesLoaded);
+                            ImGui::Text("Page format: %s", texture_compression_name(virtualTexture->compression));
+                        }
+                    }
+                    if (picking) {
+                        ImGui::Checkbox("Pick with the ID pass (right mouse)", &pickOnGpu);
+                    }
+                    ImGui::Checkbox("Look-at readout", &lookAtOn);
+                    if (lookAtOn && lookAt.hit) {
+                        ImGui::Text("Look-at: (%.1f, %.1f, %.1f), %.0f m away", lookAt.position.x, lookAt.position.y,
+                                    lookAt.position.z, lookAt.distance);
+                        if (lookAt.onTerrain) {
+                            ImGui::Text("Terrain: height %.1f, slope %.0f deg%s%s", lookAt.terrainHeight,
+                                        lookAt.slopeDegrees, lookAt.hasBiome ? ", " : "",
+                                        lookAt.hasBiome ? biome_name(lookAt.biome) : "");
+                        } else {
+                            ImGui::Text("Terrain: none under the point, or past the height field");
+                        }
+                    } else if (lookAtOn) {
+                        ImGui::Text("Look-at: sky");
+                    }
+                    const uint32_t selectedIndex = scene_index(scene, selected);
+                    if (selectedIndex != UINT32_MAX) {
+                        const simd::float4 position = scene.transforms[selectedIndex].columns[3];
+                        ImGui::Text("Selected: entity %u, mesh %u at (%.1f, %.1f, %.1f)", selected.index,
+                                    scene.meshes[selectedIndex], position.x, position.y, position.z);
+                        if (pickOnGpu) {
+                            ImGui::Text("Picked %llu frames after the click", (unsigned long long)pickLatency);
+                        }
+                        simd::float3 color = scene.colors[selectedIndex];
+                        if (ImGui::ColorEdit3("Colour", &color.x)) {
+                            scene_set_color(scene, selected, color);
+                        }
+                        if (ImGui::Button("Clear selection")) {
+                            selected = Entity{};
+                        }
+                    }
+                    if (ImGui::Checkbox("Paint terrain (left mouse)", &paintTerrain) && paintTerrain && !gpuBrush &&
+                        metal_terrain_brush_pipelines(metal) && gpu_terrain_brush_supported(metal)) {
+                        gpuBrush = std::make_unique<GpuTerrainBrush>(create_gpu_terrain_brush(metal));
+                    }
+                    if (paintTerrain) {
+                        const char* brushModes[] = { "Raise", "Lower", "Flatten", "Smooth", "Erode" };
+                        int brushMode = (int)brush.mode;
+                        if (ImGui::Combo("Brush", &brushMode, brushModes, IM_ARRAYSIZE(brushModes))) {
+                            brush.mode = (TerrainBrushMode)brushMode;
+                        }
+                        ImGui::SliderFloat("Brush radius", &brush.radius, 1.0f, 16.0f, "%.1f");
+                        ImGui::SliderFloat("Brush strength", &brushRate, 0.5f, 8.0f, "%.1f / s");
+                        if (brush.mode == TerrainBrushMode::Erode) {
+                            ImGui::SliderFloat("Talus slope", &brush.talus, 0.0f, 4.0f, "%.2f");
+                        }
+                        if (gpuBrush) {
+                            ImGui::Checkbox("Brush on GPU", &brushOnGpu);
+                            ImGui::Text("GPU brushes: %u, %zu in flight, %u tiles uploaded, %.0f MB",
+                                        gpuBrush->applied, gpuBrush->pending.size(), gpuBrush->tilesUploaded,
+                                        gpu_terrain_brush_bytes(*gpuBrush) / (1024.0 * 1024.0));
+                            ImGui::Text("Last readback: %u tiles written back in %.2f ms", gpuBrush->tilesRead,
+                                        brushCollectMs);
+                        }
+                        const TerrainEditHistory& history = chunkManager.edit_history();
+                        if (ImGui::Button("Undo stroke") && history.can_undo()) {
+                            historyStep = -1;
+                        }
+                        ImGui::SameLine();
+                        if (ImGui::Button("Redo stroke") && history.can_redo()) {
+                            historyStep = 1;
+                        }
+                        ImGui::SameLine();
+                        ImGui::Text("%zu strokes, %.1f KB", history.undo_count(), history.bytes() / 1024.0);
+                        ImGui::Text("Edited points: %zu", chunkManager.edits().size());
+                        ImGui::Text("Navmesh: %u polygons, last edit rebuilt %u tiles in %.2f ms", navMesh.polyCount,
+                                    navTilesRebuilt, navRebuildMs);
+                    }
+                    ImGui::SliderFloat("Debris", &debrisSettings.rate, 0.0f, 5000.0f, "%.0f / s");
+                    if (debris.size() > 0) {
+                        ImGui::Text("Debris pieces: %zu / %u", debris.size(), debris.capacity);
+                    }
+                    if (crowd.size() > 0) {
+                        ImGui::SliderFloat("Crowd speed", &crowdSettings.speed, 0.0f, 4.0f, "%.1f");
+                        ImGui::SliderFloat("Crowd wander", &crowdSettings.wander, 0.0f, 6.0f, "%.1f");
+                        ImGui::Text("Crowd agents: %u", crowd.size());
+                    }
+                    if (streamObjects) {
+                        ImGui::Text("Object cells: %zu resident, %zu entities; %llu read, %llu generated",
+                                    sceneCells.resident.size(), scene_cells_entity_count(sceneCells, scene),
+                                    (unsigned long long)sceneCells.loaded, (unsigned long long)sceneCells.generated);
+                    }
+                    if (ImGui::Button("Drop spheres")) {
+                        ++physicsDrops;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear spheres")) {
+                        physicsClear = true;
+                    }
+                    if (physics.size() > 0) {
+                        ImGui::Text("Spheres: %zu, %u awake in %u islands, %u contacts", physics.size(),
+                                    physics.stats.awake, physics.stats.islands, physics.stats.contacts);
+                    }
+                    if (replicationServer) {
+                        ImGui::Text("Serving %zu observers on port %u, %zu bytes per send",
+                                    replicationServer->peers.size(), replicationServer->socket.port,
+                                    replicationServer->bytesSent);
+                    } else if (replicationClient) {
+                        ImGui::Text("Observing: %zu bytes this frame", replicationClient->bytesReceived);
+                    }
+                    if (ImGui::Button("Save world")) {
+                        saveWorld = true;
+                    }
+                    if (worldSaves > 0 && worldSaveCounter.done()) {
+                        ImGui::SameLine();
+                        if (worldSaveWritten) {
+                            ImGui::Text("Saved %s in %.1f ms", worldPath.c_str(), worldSaveSeconds * 1000.0);
+                        } else {
+                            ImGui::Text("Could not write %s", worldPath.c_str());
+                        }
+                    }
+                    if (cpuSampler) {
+                        if (ImGui::Button("Write CPU profile")) {
+                            writeCpuProfile = true;
+                        }
+                        if (!cpuProfilePath.empty()) {
+                            ImGui::SameLine();
+                            ImGui::Text("%s %s", cpuProfileCounter.done() ? "Wrote" : "Writing",
+                                        cpuProfilePath.c_str());
+                        }
+                    }
+                    if (ImGui::Button("Capture probe")) {
+                        captureProbe = true;
+                    }
+                    if (probeCaptured) {
+                        ImGui::SameLine();
+                        ImGui::Text("%u views per submission", amplification);
+                        // Faces in slice order, +X -X +Y on top; flipped back from the cube map's mirrored layout
+                        for (uint32_t face = 0; face < CUBE_FACE_COUNT; ++face) {
+                            if (face % 3 != 0) {
+                                ImGui::SameLine();
+                            }
+                            ImGui::Image((__bridge ImTextureID)probe.slices[face], ImVec2(64, 64), ImVec2(1, 0),
+                                         ImVec2(0, 1));
+                        }
+                    }
+                    if (maxSampleCount > 1) {
+                        // Item i renders 1 << i samples per pixel
+                        const char* antiAliasingModes[] = { "Off", "2x MSAA", "4x MSAA" };
+                        int antiAliasing = shading.sampleCount == 4 ? 2 : shading.sampleCount == 2 ? 1 : 0;
+                        if (ImGui::Combo("Anti-aliasing", &antiAliasing, antiAliasingModes,
+                                         maxSampleCount == 4 ? 3 : 2)) {
+                            shading.sampleCount = 1u << antiAliasing;
+                        }
+                    }
+
+                    const char* presentModes[] = { "VSync", "Uncapped", "Fixed rate" };
+                    int presentMode = (int)pacingSettings.mode;
+                    bool pacingChanged =
+                        ImGui::Combo("Present mode", &presentMode, presentModes, IM_ARRAYSIZE(presentModes));
+                    pacingSettings.mode = (PresentMode)presentMode;
+                    if (pacingSettings.mode == PresentMode::FixedRate) {
+                        ImGui::SliderFloat("Target FPS", &pacingSettings.targetFps, 24.0f, 120.0f, "%.0f");
+                    }
+                    int drawableCount = (int)pacingSettings.drawableCount;
+                    if (ImGui::SliderInt("Drawables", &drawableCount, 2, 3)) {
+                        pacingSettings.drawableCount = (uint32_t)drawableCount;
+                        pacingChanged = true;
+                    }
+                    if (pacingChanged) {
+                        apply_present_mode(layer, pacingSettings);
+                    }
+                    ImGui::Text("Display: %.1f Hz", 1.0 / refreshPeriod);
+                    ImGui::Checkbox("Pause world", &gameClockSettings.paused);
+                    ImGui::SliderFloat("World time scale", &gameClockSettings.timeScale, 0.05f, 2.0f, "%.2f");
+                    const GpuMemoryBudget memoryBudget = gpu_memory_budget(metal.device);
+                    ImGui::Text("GPU memory: %.0f of %.0f MB", memoryBudget.allocated / (1024.0 * 1024.0),
+                                memoryBudget.recommended / (1024.0 * 1024.0));
+                    ImGui::Text("Frame arenas: %.0f KB peak", frame_arenas_peak(frameArenas) / 1024.0);
+                    const UploadQueueStats uploads = uploader.queue_stats();
+                    ImGui::Text("Uploads: %.0f KB this frame, %zu batches (%.0f KB) queued",
+                                uploads.frameBytes / 1024.0, uploads.queuedBatches, uploads.queuedBytes / 1024.0);
+                    if (const BufferHeap* chunkHeap = chunkManager.vertex_heap()) {
+                        ImGui::Text("Chunk heaps: %u, %u of %u slots used", chunkHeap->heap_count(),
+                                    chunkHeap->used_slots(), chunkHeap->capacity());
+                    }
+                    if (shaderReloader) {
+                        const std::string reloadStatus = shaderReloader->status();
+                        ImGui::TextWrapped("Shaders: %s",
+                                           reloadStatus.empty() ? "watching shaders.metal" : reloadStatus.c_str());
+                    }
+                    if (!metal.pendingVariants.empty()) {
+                        ImGui::Text("Compiling %zu shader variants, drawn unlit meanwhile",
+                                    metal.pendingVariants.size());
+                    }
+                    int threads = (int)encodeThreads;
+                    if (ImGui::SliderInt("Encode threads", &threads, 1, 8)) {
+                        encodeThreads = (uint32_t)threads;
+                    }
+                    if (gpuProfiler) {
+                        ImGui::Checkbox("GPU pass timings", &profileGpuPasses);
+                    }
+                    if (gpuDrawCosts) {
+                        ImGui::Checkbox("GPU draw costs", &timeDraws);
+                    }
+                    ImGui::Checkbox("Unretained command buffer references", &commandBuffers.unretainedReferences);
+                    if (residency) {
+                        ImGui::Text("Residency set: %u allocations, %.0f MB", residency->allocation_count(),
+                                    residency->allocated_size() / (1024.0 * 1024.0));
+                    }
+                    if (gpuCulling && ImGui::Checkbox("GPU culling", &useGpuCulling) && useGpuCulling) {
+                        gpuCulling->hasHistory = false; // The Hi-Z pyramid was not updated while it was off
+                    }
+                    ImGui::Checkbox("Terrain occlusion culling (CPU)", &terrainOcclusion);
+                    if (debugDraw) {
+                        ImGui::Checkbox("Debug: chunk LOD and streaming", &debugDraw->settings.chunks);
+                        ImGui::Checkbox("Debug: entity culling", &debugDraw->settings.objects);
+                        ImGui::Checkbox("Debug: navigation mesh", &debugDraw->settings.navMesh);
+                        if (ImGui::Checkbox("Debug: freeze culling frustum", &debugDraw->settings.freezeFrustum)) {
+                            frozenView = camera_render_view(cam);
+                            if (gpuCulling) {
+                                gpuCulling->hasHistory = false; // GPU culling was off while frozen
+                            }
+                        }
+                    }
+                    if (upscaler) {
+                        if (canUpscale) {
+                            ImGui::Checkbox("Dynamic resolution", &dynamicResolution);
+                        }
+                        bool temporal = upscalerMode == UpscalerMode::Temporal;
+                        if (canUpscaleTemporally && ImGui::Checkbox("Temporal upscaling", &temporal)) {
+                            upscalerMode = temporal ? UpscalerMode::Temporal : UpscalerMode::Spatial;
+                        }
+                        if (canAntiAlias) {
+                            ImGui::Checkbox("Temporal anti-aliasing", &antiAliasing);
+                            if (antiAliasing && upscaling && upscaler->mode == UpscalerMode::Spatial) {
+                                ImGui::TextDisabled("Off while the spatial scaler upscales");
+                            }
+                        }
+                        ImGui::Text("Render scale: %.0f%% (%ux%u)",
+                                    (upscaling && scaled ? renderScale.scale : 1.0f) * 100.0f, sceneWidth, sceneHeight);
+                    }
+                    if (ImGui::Checkbox("Quality governor", &governing) && !governing) {
+                        governor = {};
+                    }
+                    ImGui::Checkbox("Tuning panel", &showTuning);
+                    if (governing) {
+                        ImGui::Text("Tier %u of %u, thermal state %s%s", governor.tier, QUALITY_TIER_COUNT - 1,
+                                    thermal_state_name(governor.power.thermal),
+                                    governor.power.lowPower ? ", low power mode" : "");
+                        ImGui::Text("Scale cap %.0f%%, %u cascades, view %.0f%%, LOD bias %.1fx",
+                                    tier.maxRenderScale * 100.0f, tier.shadowCascades, tier.viewDistance * 100.0f,
+                                    tier.lodBias);
+                        ImGui::Text("GPU %.2f ms of %.2f ms, %u tier changes", std::max(governor.smoothedMs, 0.0f),
+                                    governorSettings.targetMs, governor.changes);
+                    }
+                    ImGui::End();
+                    if (showTuning) {
+                        draw_tuning_panel(tuning, tuningPath, tuningStatus);
+                    }
+
+                    draw_frame_stats_overlay(frameStats, "frame_stats.csv",
+                                             timeDraws && gpuDrawCosts ? gpuDrawCosts->costs.get() : nullptr);
+
+                    ImGui::Render();
+
+                    id<MTLCommandBuffer> uiCmd = command_buffer_new(commandBuffers, metal.queue, @"UI overlay");
+                    ui_overlay_render(uiOverlay, uiCmd, overlayPass, ImGui::GetDrawData(), profiler, frameStats);
+                    [uiCmd commit];
+                    ui_refresh_laid_out(uiOverlay.refresh, now, uiInput, swapchain.width, swapchain.height);
+                }
+                frame_stats_end_phase(frameStats, PHASE_IMGUI);
+
+                // --- Composite: the only pass that touches the drawable ---
+                id<CAMetalDrawable> drawable = nil;
+                {
+                    TRACE_SCOPE("Wait for drawable");
+                    drawable = [layer nextDrawable];
+                }
+                frame_stats_end_phase(frameStats, PHASE_WAIT);
+
+                if (drawable) {
+                    id<MTLCommandBuffer> cmd = command_buffer_new(commandBuffers, metal.queue, @"Composite");
+                    MTLRenderPassDescriptor* compositeDesc = make_composite_pass(compositePass, drawable.texture);
+                    frame_stats_count_pass(frameStats, audit_render_pass(compositeDesc, "Composite"));
+                    gpu_profiler_sample_pass(profiler, compositeDesc, GPU_PASS_OVERLAY);
+                    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:compositeDesc];
+                    [enc setRenderPipelineState:metal.composite_pipeline];
+                    [enc setFragmentTexture:sceneOutput atIndex:0];
+                    [enc setFragmentTexture:uiOverlay.texture atIndex:1];
+                    [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+                    [enc endEncoding];
+
+                    [cmd addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+                        frame_stats_record_gpu(*statsPtr, frame,
+                                               (completed.GPUEndTime - sceneCmd.GPUStartTime) * 1000.0);
+                    }];
+                    gpu_profiler_end_frame(profiler, cmd, frameStats);
+                    frame_latency_track_present(frameStats, frame, drawable, frameBegin);
+                    present_paced(cmd, drawable, pacingSettings, refreshPeriod);
+                    [cmd commit];
+                } else if (profiler) {
+                    // Nothing is presented, but the scene's samples still need resolving after it completes
+                    id<MTLCommandBuffer> cmd = command_buffer_new(commandBuffers, metal.queue, @"Resolve samples");
+                    gpu_profiler_end_frame(profiler, cmd, frameStats);
+                    [cmd commit];
+                }
+                frame_stats_end_phase(frameStats, PHASE_SUBMIT);
+            }
+            blocksBeforeDrain = malloc_blocks_in_use();
+        }
+        check_frame_autoreleases(frameStats, blocksBeforeDrain);
+
+        frame_stats_end_frame(frameStats);
+        if (replayPath) {
+            replayCpuMs.push_back(frameStats.current.cpuMs);
+        }
+        // A captured frame is slowed by the capture itself, so it does not count as a hitch
+        const bool captured = gpuCapturing;
+        if (gpuCapturing) {
+            gpu_capture_end();
+            gpuCapturing = false;
+        }
+        uint64_t hitchGpuFrame = 0;
+        const float hitchGpuMs = frame_stats_latest_gpu(frameStats, hitchGpuFrame);
+        HitchReport hitch;
+        const bool hitchReported = !captured && hitch_detector_update(hitchDetector, frameStats.current.frame,
+                                                         frameStats.current.cpuMs, hitchGpuFrame, hitchGpuMs,
+                                                         simulation_clock(), hitch);
+        if (metricsExporter) {
+            // Relaxed atomics only; the exporter thread reads and formats them. GPU times arrive
+            // frames late, so each is recorded once, when its frame is the newest that completed.
+            metrics_add(metrics, METRIC_FRAMES);
+            metrics_observe(metrics, METRIC_FRAME_MS, frameStats.current.cpuMs);
+            if (hitchGpuFrame > metricsGpuFrame) {
+                metrics_observe(metrics, METRIC_GPU_MS, hitchGpuMs);
+                metricsGpuFrame = hitchGpuFrame;
+            }
+            if (hitchReported) {
+                metrics_add(metrics, METRIC_HITCHES);
+            }
+            // The uploader's own lock, which it takes every frame anyway, covers these two reads
+            const size_t uploadedBytes = uploader.uploaded_bytes();
+            metrics_add(metrics, METRIC_UPLOAD_BYTES, uploadedBytes - metricsUploadedBytes);
+            metricsUploadedBytes = uploadedBytes;
+            const UploadQueueStats uploads = uploader.queue_stats();
+            metrics_set(metrics, METRIC_UPLOAD_QUEUED_BYTES, uploads.queuedBytes);
+            metrics_set(metrics, METRIC_UPLOAD_QUEUED_BATCHES, uploads.queuedBatches);
+            metrics_set(metrics, METRIC_CHUNKS_RESIDENT, chunkManager.resident().size());
+            metrics_set_memory(metrics, frameStats.memory);
+        }
+        // A profile asked for from the overlay waits for the previous one; a hitch's is written regardless
+        const bool writeProfile = cpuSampler && (hitchReported || (writeCpuProfile && cpuProfileCounter.done()));
+        if (hitchReported) {
+            fprintf(stderr, "Hitch detector: frame %llu took %.1f ms on the %s, writing %s.*\n",
+                    (unsigned long long)hitch.frame, hitch.ms, hitch.gpu ? "GPU" : "CPU", hitch.prefix.c_str());
+            // The stats history is copied under its lock, off the frame threads like the profile
+            jobs.run([&frameStats, path = hitch.prefix + ".csv"] {
+                if (!frame_stats_write_csv(frameStats, path.c_str())) {
+                    fprintf(stderr, "Hitch detector: cannot write %s\n", path.c_str());
+                }
+            }, &cpuProfileCounter, JobPriority::Background);
+        }
+        if (writeProfile) {
+            cpuProfilePath = hitchReported ? hitch.prefix + ".folded"
+                                           : "cpu_profile_" + std::to_string(frameStats.current.frame) + ".folded";
+            // Copied here, folded and symbolized off the frame threads
+            jobs.run([profile = cpuSampler->snapshot(cpuProfileSeconds), path = cpuProfilePath] {
+                if (!write_cpu_profile(profile, path.c_str())) {
+                    fprintf(stderr, "CPU sampler: cannot write %s\n", path.c_str());
+                }
+            }, &cpuProfileCounter, JobPriority::Background);
+            writeCpuProfile = false;
+        }
+    }
+    jobs.wait(worldSaveCounter);
+    jobs.wait(cpuProfileCounter);
+    if (scene_cells_flush(sceneCells, scene) > 0) {
+        fprintf(stderr, "Cannot write the object cells to %s\n", sceneCells.directory.c_str());
+    }
+    simulation.stop();
+    if (recordPath) {
+        std::string error;
+        if (!write_input_recording(recordPath, recording, error)) {
+            fprintf(stderr, "Record: %s\n", error.c_str());
+        }
+    }
+    if (replayPath) {
+        FILE* out = benchmarkOutput ? fopen(benchmarkOutput, "w") : stdout;
+        if (out) {
+            fprintf(out, "{\n  \"replay\": \"%s\",\n  \"frames\": %zu,\n", replayPath, replayCpuMs.size());
+            write_summary_json(out, "cpu_ms", summarize_frame_times(replayCpuMs));
+            // Over the frames still in the history; a replay presents, so it also has the present latency
+            for (int l = 0; l < LATENCY_COUNT; ++l) {
+                fprintf(out, ",\n");
+                write_summary_json(out, (std::string(frame_latency_name((FrameLatency)l)) + "_latency_ms").c_str(),
+                                   frame_stats_summarize_latency(frameStats, (FrameLatency)l));
+            }
+            if (governing) {
+                fprintf(out, ",\n  \"governor\": {\n    \"tier\": %u,\n    \"changes\": %u,\n"
+                             "    \"thermal_state\": \"%s\",\n    \"low_power_mode\": %s,\n    \"tier_frames\": [",
+                        governor.tier, governor.changes, thermal_state_name(governor.power.thermal),
+                        governor.power.lowPower ? "true" : "false");
+                for (uint32_t t = 0; t < QUALITY_TIER_COUNT; ++t) {
+                    fprintf(out, "%s%llu", t > 0 ? ", " : "", (unsigned long long)governor.tierFrames[t]);
+                }
+                fprintf(out, "]\n  }");
+            }
+            fprintf(out, "\n}\n");
+            if (out != stdout) {
+                fclose(out);
+            }
+        } else {
+            fprintf(stderr, "Replay: cannot write %s\n", benchmarkOutput);
         }
     }
 
+    // Let outstanding completion handlers finish before frameStats goes away
+    id<MTLCommandBuffer> drain = [metal.queue commandBuffer];
+    [drain commit];
+    [drain waitUntilCompleted];
+
     // --- ImGui Shutdown ---
     ImGui_ImplMetal_Shutdown();
     ImGui_ImplGlfw_Shutdown();
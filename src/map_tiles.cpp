@@ -0,0 +1,131 @@
+#include "map_tiles.hpp"
+
+#include <filesystem>
+#include <unistd.h>
+
+#include "image_file.hpp"
+
+namespace {
+    // Box-filters a child into its quadrant of the parent: each parent pixel averages 2x2 child pixels
+    void downsample_into(const std::vector<uint8_t>& child, std::vector<uint8_t>& parent, uint32_t tileSize,
+                         uint32_t quadrantX, uint32_t quadrantZ) {
+        const uint32_t half = tileSize / 2;
+        const size_t rowBytes = (size_t)tileSize * 4;
+        for (uint32_t y = 0; y < half; ++y) {
+            const uint8_t* top = child.data() + (2 * y) * rowBytes;
+            const uint8_t* bottom = top + rowBytes;
+            uint8_t* out = parent.data() + (quadrantZ * half + y) * rowBytes + quadrantX * half * 4;
+            for (uint32_t x = 0; x < half; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    const uint32_t sum = top[8 * x + c] + top[8 * x + 4 + c] + bottom[8 * x + c] + bottom[8 * x + 4 + c];
+                    out[4 * x + c] = (uint8_t)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    // Visits a tile's subtree in Morton order, collecting the finest tiles that need rendering
+    void schedule_subtree(const MapTileSettings& settings, const MapTile& tile, bool ancestorMissing,
+                          const std::function<bool(const MapTile&)>& done, std::vector<MapTile>& tiles) {
+        const bool missing = ancestorMissing || !done(tile);
+        if (tile.level + 1 == settings.levels) {
+            if (missing) {
+                tiles.push_back(tile);
+            }
+            return;
+        }
+        for (uint32_t child = 0; child < 4; ++child) {
+            schedule_subtree(settings, { tile.level + 1, 2 * tile.x + (child & 1), 2 * tile.z + (child >> 1) },
+                             missing, done, tiles);
+        }
+    }
+}
+
+float map_tile_world_size(const MapTileSettings& settings, uint32_t level) {
+    return settings.finestTileWorld * (float)(1u << (settings.levels - 1 - level));
+}
+
+BoundingBox map_tile_bounds(const MapTileSettings& settings, const MapTile& tile) {
+    const float size = map_tile_world_size(settings, tile.level);
+    const float x = settings.originX + tile.x * size;
+    const float z = settings.originZ + tile.z * size;
+    return { { x, settings.minHeight, z }, { x + size, settings.maxHeight, z + size } };
+}
+
+Camera map_tile_camera(const MapTileSettings& settings, const MapTile& tile) {
+    const BoundingBox bounds = map_tile_bounds(settings, tile);
+    const float half = 0.5f * (bounds.max.x - bounds.min.x);
+    const simd::float3 centre = (bounds.min + bounds.max) * 0.5f;
+
+    // Looking down with north (-Z) up puts east (+X) on the right
+    Camera cam{};
+    cam.nearZ = 1.0f;
+    cam.farZ = settings.maxHeight - settings.minHeight + 1.0f;
+    cam.position = { centre.x, settings.maxHeight + cam.nearZ, centre.z };
+    cam.pitch = -(float)M_PI / 2.0f;
+    cam.viewMatrix = matrix_look_at_right_hand(cam.position, cam.position - simd::float3{ 0.0f, 1.0f, 0.0f },
+                                               simd::float3{ 0.0f, 0.0f, -1.0f });
+    cam.projectionMatrix = matrix_orthographic_right_hand(-half, half, -half, half, cam.nearZ, cam.farZ);
+    return cam;
+}
+
+MapTile map_tile_parent(const MapTile& tile) {
+    return { tile.level - 1, tile.x / 2, tile.z / 2 };
+}
+
+std::string map_tile_path(const std::string& directory, const MapTile& tile) {
+    return (std::filesystem::path(directory) / std::to_string(tile.level) /
+            (std::to_string(tile.x) + "_" + std::to_string(tile.z) + ".png")).string();
+}
+
+std::vector<MapTile> map_tile_schedule(const MapTileSettings& settings,
+                                       const std::function<bool(const MapTile&)>& done) {
+    std::vector<MapTile> tiles;
+    if (settings.levels > 0) {
+        schedule_subtree(settings, MapTile{}, false, done, tiles);
+    }
+    return tiles;
+}
+
+MapPyramid::MapPyramid(const MapTileSettings& settings)
+    : m_settings(settings), m_partial(settings.levels > 0 ? settings.levels - 1 : 0) {}
+
+void MapPyramid::add(MapTileImage&& image, std::vector<MapTileImage>& finished) {
+    MapTileImage child = std::move(image);
+    while (child.tile.level > 0) {
+        Partial& partial = m_partial[child.tile.level - 1];
+        const MapTile parent = map_tile_parent(child.tile);
+        if (partial.children == 0 || partial.image.tile != parent) {
+            partial.image.tile = parent;
+            partial.image.bgra.assign((size_t)m_settings.tileSize * m_settings.tileSize * 4, 0);
+            partial.children = 0;
+        }
+        downsample_into(child.bgra, partial.image.bgra, m_settings.tileSize, child.tile.x & 1, child.tile.z & 1);
+        finished.push_back(std::move(child));
+        if (++partial.children < 4) {
+            return;
+        }
+        child = std::move(partial.image);
+        partial.children = 0;
+    }
+    finished.push_back(std::move(child));
+}
+
+bool save_map_tile(const std::string& directory, const MapTileImage& image, uint32_t tileSize, std::string& error) {
+    const std::string path = map_tile_path(directory, image.tile);
+    std::error_code directoryError;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), directoryError);
+
+    // An interrupted run leaves at most a temporary file, never a truncated tile
+    const std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+    if (!write_png(temporary.c_str(), image.bgra.data(), tileSize, tileSize, (size_t)tileSize * 4, error)) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        error = "cannot rename " + temporary + " to " + path;
+        return false;
+    }
+    return true;
+}
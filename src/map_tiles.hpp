@@ -0,0 +1,135 @@
+/**
+ * @file map_tiles.hpp
+ * @brief Addressing, scheduling and downsampling of top-down world map tiles at several zoom levels.
+ *
+ * Level 0 is one tile over the whole map and each further level splits every tile into four,
+ * as web maps do. Only the finest level is rendered; each coarser tile is the 2x2 box-filtered
+ * combination of its four children. The finest tiles are rendered in Morton order, so the
+ * four children of every tile arrive one after another, consecutive tiles are neighbours whose
+ * terrain chunks are mostly already streamed in, and a MapPyramid holds only one partial tile
+ * per level.
+ *
+ * A finished tile is written to a temporary file and renamed into place, so a tile file that
+ * exists is complete. A rerun skips the finest tiles whose file and every ancestor's file
+ * exist; whatever else is missing is rendered and rebuilt.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "objects.hpp"
+
+/**
+ * @struct MapTileSettings
+ * @brief The area a tile pyramid covers and how finely.
+ */
+struct MapTileSettings {
+    float originX = 0.0f;           ///< World X of the map's west edge.
+    float originZ = 0.0f;           ///< World Z of the map's north edge; tile rows run south towards +Z.
+    float finestTileWorld = 64.0f;  ///< World units across a tile of the finest level.
+    uint32_t levels = 5;            ///< Zoom levels; level levels - 1 is the finest.
+    uint32_t tileSize = 256;        ///< Tile edge in pixels; even, so that four children fill a parent.
+    float minHeight = -128.0f;      ///< Lowest world Y the top-down camera captures.
+    float maxHeight = 256.0f;       ///< Highest world Y the top-down camera captures.
+};
+
+/**
+ * @struct MapTile
+ * @brief A tile of the pyramid.
+ */
+struct MapTile {
+    uint32_t level = 0; ///< Zoom level; 2^level tiles per side.
+    uint32_t x = 0;     ///< Column, from west to east.
+    uint32_t z = 0;     ///< Row, from north to south.
+
+    bool operator==(const MapTile& other) const { return level == other.level && x == other.x && z == other.z; }
+    bool operator!=(const MapTile& other) const { return !(*this == other); }
+};
+
+/**
+ * @struct MapTileImage
+ * @brief The pixels of a finished tile.
+ */
+struct MapTileImage {
+    MapTile tile;               ///< The tile.
+    std::vector<uint8_t> bgra;  ///< tileSize * tileSize BGRA8 pixels, top (north) row first, rows packed.
+};
+
+/// @return World units across a tile of a level.
+float map_tile_world_size(const MapTileSettings& settings, uint32_t level);
+
+/// @return The world space box of a tile, spanning the settings' height range.
+BoundingBox map_tile_bounds(const MapTileSettings& settings, const MapTile& tile);
+
+/**
+ * @brief Makes the camera that renders a tile from straight above.
+ *
+ * The orthographic projection maps the tile to the whole viewport with north up and its
+ * height range to [0, 1] depth, near at the top; it is never reverse-Z.
+ *
+ * @param settings The pyramid settings.
+ * @param tile The tile.
+ * @return The camera; its position is above the tile's centre.
+ */
+Camera map_tile_camera(const MapTileSettings& settings, const MapTile& tile);
+
+/// @return The tile one level coarser that contains tile; tile must not be at level 0.
+MapTile map_tile_parent(const MapTile& tile);
+
+/// @return The file of a tile under a directory: <directory>/<level>/<x>_<z>.png.
+std::string map_tile_path(const std::string& directory, const MapTile& tile);
+
+/**
+ * @brief Lists the finest tiles to render, in Morton order.
+ * @param settings The pyramid settings.
+ * @param done Reports whether a tile was finished by an earlier run; not asked below a tile that was not.
+ * @return The finest tiles not done or with an ancestor not done.
+ */
+std::vector<MapTile> map_tile_schedule(const MapTileSettings& settings,
+                                       const std::function<bool(const MapTile&)>& done);
+
+/**
+ * @class MapPyramid
+ * @brief Builds the coarser tiles from the finest ones as they arrive in Morton order.
+ */
+class MapPyramid {
+public:
+    explicit MapPyramid(const MapTileSettings& settings);
+
+    /**
+     * @brief Adds a rendered tile of the finest level.
+     *
+     * A parent is finished once its four children were added one after another; a partial
+     * parent whose remaining children never come, e.g. because a rerun skipped them, is
+     * dropped when another parent of its level starts.
+     *
+     * @param image The tile's pixels; moved from.
+     * @param finished Receives the tile and every coarser tile it finished, finest first.
+     */
+    void add(MapTileImage&& image, std::vector<MapTileImage>& finished);
+
+private:
+    struct Partial {
+        MapTileImage image;     ///< Parent being filled.
+        uint32_t children = 0;  ///< Quadrants filled so far; 0 means none is in progress.
+    };
+
+    MapTileSettings m_settings;
+    std::vector<Partial> m_partial; ///< One per level except the finest, indexed by level.
+};
+
+/**
+ * @brief Writes a tile as a PNG, replacing the file only once the whole image is written.
+ * @param directory The pyramid's directory; the level directory is created as needed.
+ * @param image The tile.
+ * @param tileSize The tile edge in pixels.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool save_map_tile(const std::string& directory, const MapTileImage& image, uint32_t tileSize, std::string& error);
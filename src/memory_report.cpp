@@ -0,0 +1,68 @@
+#include "memory_report.hpp"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+    // Precedes every tagged allocation; its size keeps the memory after it aligned like malloc's
+    struct alignas(alignof(std::max_align_t)) AllocationHeader {
+        size_t bytes;
+        MemoryTag tag;
+    };
+
+    std::atomic<uint64_t> g_taggedBytes[MEMORY_TAG_COUNT];
+}
+
+const char* memory_tag_name(MemoryTag tag) {
+    switch (tag) {
+        case MEMORY_TERRAIN: return "terrain";
+        case MEMORY_MESHES: return "meshes";
+        case MEMORY_SCENE: return "scene";
+        case MEMORY_FOLIAGE: return "foliage";
+        case MEMORY_SHADOWS: return "shadows";
+        case MEMORY_UNIFORMS: return "uniforms";
+        case MEMORY_TARGETS: return "targets";
+        case MEMORY_UI: return "ui";
+        default: return "unknown";
+    }
+}
+
+uint64_t memory_report_gpu_total(const MemoryReport& report) {
+    uint64_t total = 0;
+    for (uint64_t bytes : report.gpuBytes) {
+        total += bytes;
+    }
+    return total;
+}
+
+uint64_t memory_report_cpu_total(const MemoryReport& report) {
+    uint64_t total = 0;
+    for (uint64_t bytes : report.cpuBytes) {
+        total += bytes;
+    }
+    return total;
+}
+
+void* memory_tag_alloc(size_t bytes, MemoryTag tag) {
+    AllocationHeader* header = (AllocationHeader*)malloc(sizeof(AllocationHeader) + bytes);
+    if (!header) {
+        return nullptr;
+    }
+    header->bytes = bytes;
+    header->tag = tag;
+    g_taggedBytes[tag].fetch_add(bytes, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void memory_tag_free(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+    AllocationHeader* header = (AllocationHeader*)pointer - 1;
+    g_taggedBytes[header->tag].fetch_sub(header->bytes, std::memory_order_relaxed);
+    free(header);
+}
+
+uint64_t memory_tag_cpu_bytes(MemoryTag tag) {
+    return g_taggedBytes[tag].load(std::memory_order_relaxed);
+}
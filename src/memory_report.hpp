@@ -0,0 +1,68 @@
+/**
+ * @file memory_report.hpp
+ * @brief CPU and GPU memory broken down by the subsystem that holds it.
+ *
+ * GPU memory is counted from the allocatedSize of each subsystem's resources, which
+ * includes the padding and alignment Metal adds to them. CPU memory is counted two ways:
+ * containers report their capacity, and allocators that accept hooks (ImGui) allocate
+ * through memory_tag_alloc(), which keeps a live total per tag.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @enum MemoryTag
+ * @brief The subsystem memory is charged to.
+ */
+enum MemoryTag {
+    MEMORY_TERRAIN,   ///< Streamed chunks, their LOD indices and the CPU height field.
+    MEMORY_MESHES,    ///< Object meshes in the MeshRegistry.
+    MEMORY_SCENE,     ///< Entity components and the BVH.
+    MEMORY_FOLIAGE,   ///< Foliage pools and instance buffers.
+    MEMORY_SHADOWS,   ///< The shadow map.
+    MEMORY_UNIFORMS,  ///< Per-frame uniform rings and the upload staging ring.
+    MEMORY_TARGETS,   ///< Render targets, the Hi-Z pyramid and culling command buffers.
+    MEMORY_UI,        ///< ImGui's allocations and font atlas.
+    MEMORY_TAG_COUNT
+};
+
+/// @return A short name for a tag, used as its overlay label.
+const char* memory_tag_name(MemoryTag tag);
+
+/**
+ * @struct MemoryReport
+ * @brief Bytes held per tag at one point in time.
+ */
+struct MemoryReport {
+    uint64_t gpuBytes[MEMORY_TAG_COUNT] = {}; ///< GPU resource bytes.
+    uint64_t cpuBytes[MEMORY_TAG_COUNT] = {}; ///< CPU heap bytes.
+};
+
+/// @return The GPU bytes of every tag.
+uint64_t memory_report_gpu_total(const MemoryReport& report);
+
+/// @return The CPU bytes of every tag.
+uint64_t memory_report_cpu_total(const MemoryReport& report);
+
+/// @return The heap bytes a vector holds, counting its spare capacity.
+template <typename T>
+size_t vector_bytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+/**
+ * @brief Allocates CPU memory charged to a tag; thread-safe.
+ * @param bytes The size.
+ * @param tag The tag.
+ * @return The memory, aligned like malloc's, or null if it failed.
+ */
+void* memory_tag_alloc(size_t bytes, MemoryTag tag);
+
+/// @brief Frees memory from memory_tag_alloc(); null is ignored.
+void memory_tag_free(void* pointer);
+
+/// @return The bytes allocated through memory_tag_alloc() under a tag and not yet freed.
+uint64_t memory_tag_cpu_bytes(MemoryTag tag);
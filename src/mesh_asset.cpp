@@ -0,0 +1,365 @@
+#include "mesh_asset.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mesh_codec.hpp"
+#include "vertex_cache.hpp"
+
+namespace {
+    size_t align_section(size_t offset) {
+        return (offset + MESH_ASSET_ALIGNMENT - 1) & ~(MESH_ASSET_ALIGNMENT - 1);
+    }
+
+    // Bounding sphere around the box of the meshlet's vertices; cheap and within a few percent of minimal
+    void meshlet_sphere(const std::vector<Vertex>& vertices, const uint32_t* meshletVertices, Meshlet& meshlet) {
+        float lo[3] = { INFINITY, INFINITY, INFINITY };
+        float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+            const simd::float3& p = vertices[meshletVertices[i]].position;
+            const float c[3] = { p.x, p.y, p.z };
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], c[k]);
+                hi[k] = std::max(hi[k], c[k]);
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            meshlet.center[k] = 0.5f * (lo[k] + hi[k]);
+        }
+        float radiusSq = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+            const simd::float3& p = vertices[meshletVertices[i]].position;
+            const float dx = p.x - meshlet.center[0];
+            const float dy = p.y - meshlet.center[1];
+            const float dz = p.z - meshlet.center[2];
+            radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+        }
+        meshlet.radius = sqrtf(radiusSq);
+    }
+
+    // Normal cone of the meshlet's triangles (the bound meshoptimizer uses). Triangles facing more than
+    // about 84 degrees apart, or degenerate ones only, leave the cone empty so the meshlet is never culled.
+    void meshlet_cone(const std::vector<Vertex>& vertices, const uint32_t* meshletVertices,
+                      const uint8_t* triangles, Meshlet& meshlet) {
+        std::vector<float> normals;
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+            const simd::float3& a = vertices[meshletVertices[triangles[t * 3]]].position;
+            const simd::float3& b = vertices[meshletVertices[triangles[t * 3 + 1]]].position;
+            const simd::float3& c = vertices[meshletVertices[triangles[t * 3 + 2]]].position;
+            const float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+            const float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0f) continue;
+            for (int k = 0; k < 3; ++k) {
+                n[k] /= length;
+                axis[k] += n[k];
+                normals.push_back(n[k]);
+            }
+        }
+
+        const float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minDot = 1.0f;
+        if (axisLength > 0.0f) {
+            for (int k = 0; k < 3; ++k) axis[k] /= axisLength;
+            for (size_t i = 0; i < normals.size(); i += 3) {
+                minDot = std::min(minDot, normals[i] * axis[0] + normals[i + 1] * axis[1] + normals[i + 2] * axis[2]);
+            }
+        }
+        if (axisLength == 0.0f || minDot <= 0.1f) {
+            return;
+        }
+        for (int k = 0; k < 3; ++k) meshlet.coneAxis[k] = axis[k];
+        meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+
+    // Header of a mesh with every section offset filled in
+    MeshAssetHeader layout_header(const CookedMesh& mesh) {
+        MeshAssetHeader header;
+        header.indexFormat = (uint32_t)mesh.indices.format;
+        header.vertexCount = (uint32_t)mesh.vertices.size();
+        header.indexCount = (uint32_t)mesh.indices.size();
+        header.meshletCount = (uint32_t)mesh.meshlets.size();
+        header.meshletVertexCount = (uint32_t)mesh.meshletVertices.size();
+        header.meshletTriangleBytes = (uint32_t)mesh.meshletTriangles.size();
+        header.boundsMin[0] = mesh.bounds.min.x;
+        header.boundsMin[1] = mesh.bounds.min.y;
+        header.boundsMin[2] = mesh.bounds.min.z;
+        header.boundsMax[0] = mesh.bounds.max.x;
+        header.boundsMax[1] = mesh.bounds.max.y;
+        header.boundsMax[2] = mesh.bounds.max.z;
+        header.lodCount = mesh.lods.count;
+        for (uint32_t i = 0; i < mesh.lods.count; ++i) {
+            header.lods[i] = mesh.lods.levels[i];
+        }
+
+        size_t offset = align_section(sizeof(MeshAssetHeader));
+        header.vertexOffset = offset;
+        offset = align_section(offset + mesh.vertices.size() * sizeof(Vertex));
+        header.indexOffset = offset;
+        offset = align_section(offset + mesh.indices.byte_size());
+        header.meshletOffset = offset;
+        offset = align_section(offset + mesh.meshlets.size() * sizeof(Meshlet));
+        header.meshletVertexOffset = offset;
+        offset = align_section(offset + mesh.meshletVertices.size() * sizeof(uint32_t));
+        header.meshletTriangleOffset = offset;
+        header.fileSize = align_section(offset + mesh.meshletTriangles.size());
+        return header;
+    }
+
+    // Meshlet triangles are encoded a triangle of three local indices at a time
+    constexpr size_t TRIANGLE_BYTES = 3;
+
+    bool stored_size_matches(const MeshAssetHeader& header, uint64_t fileSize) {
+        uint64_t size = sizeof(MeshAssetHeader);
+        for (uint64_t bytes : header.storedBytes) {
+            if (bytes > fileSize) {
+                return false;
+            }
+            size += bytes;
+        }
+        return size == fileSize;
+    }
+
+    // Decodes the sections that follow the header into a buffer laid out as the uncompressed file
+    bool decode_sections(const MeshAssetHeader& header, const uint8_t* stored, char* out) {
+        const uint64_t* sizes = header.storedBytes;
+        if (header.meshletTriangleBytes % TRIANGLE_BYTES != 0 ||
+            !decode_vertex_buffer(stored, sizes[0], out + header.vertexOffset, header.vertexCount, sizeof(Vertex))) {
+            return false;
+        }
+        stored += sizes[0];
+        if (!decode_index_buffer(stored, sizes[1], out + header.indexOffset, header.indexCount,
+                                 index_stride((IndexFormat)header.indexFormat))) {
+            return false;
+        }
+        stored += sizes[1];
+        if (!decode_vertex_buffer(stored, sizes[2], out + header.meshletOffset, header.meshletCount,
+                                  sizeof(Meshlet))) {
+            return false;
+        }
+        stored += sizes[2];
+        if (!decode_index_buffer(stored, sizes[3], out + header.meshletVertexOffset, header.meshletVertexCount,
+                                 sizeof(uint32_t))) {
+            return false;
+        }
+        stored += sizes[3];
+        return decode_vertex_buffer(stored, sizes[4], out + header.meshletTriangleOffset,
+                                    header.meshletTriangleBytes / TRIANGLE_BYTES, TRIANGLE_BYTES);
+    }
+
+    bool section_fits(uint64_t offset, uint64_t bytes, uint64_t fileSize) {
+        return offset % MESH_ASSET_ALIGNMENT == 0 && offset <= fileSize && bytes <= fileSize - offset;
+    }
+
+    bool lods_fit(const MeshAssetHeader& header) {
+        if (header.lodCount == 0 || header.lodCount > MESH_LOD_MAX_LEVELS) {
+            return false;
+        }
+        for (uint32_t i = 0; i < header.lodCount; ++i) {
+            const MeshLod& lod = header.lods[i];
+            if (lod.indexOffset > header.indexCount || lod.indexCount > header.indexCount - lod.indexOffset) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool meshlet_backfacing(const Meshlet& meshlet, const float viewpoint[3]) {
+    const float d[3] = { meshlet.center[0] - viewpoint[0], meshlet.center[1] - viewpoint[1],
+                         meshlet.center[2] - viewpoint[2] };
+    const float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    const float along = d[0] * meshlet.coneAxis[0] + d[1] * meshlet.coneAxis[1] + d[2] * meshlet.coneAxis[2];
+    return along >= meshlet.coneCutoff * distance + meshlet.radius;
+}
+
+void build_meshlets(const std::vector<Vertex>& vertices, const MeshIndices& indices, CookedMesh& mesh) {
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+
+    // Local index of each mesh vertex in the current meshlet, or 0xFF if it is not in it yet
+    std::vector<uint8_t> local(vertices.size(), 0xFF);
+    Meshlet current;
+
+    auto finish = [&] {
+        if (current.triangleCount == 0) return;
+        meshlet_sphere(vertices, mesh.meshletVertices.data() + current.vertexOffset, current);
+        meshlet_cone(vertices, mesh.meshletVertices.data() + current.vertexOffset,
+                     mesh.meshletTriangles.data() + current.triangleOffset, current);
+        for (uint32_t i = 0; i < current.vertexCount; ++i) {
+            local[mesh.meshletVertices[current.vertexOffset + i]] = 0xFF;
+        }
+        mesh.meshlets.push_back(current);
+        current = Meshlet();
+        current.vertexOffset = (uint32_t)mesh.meshletVertices.size();
+        current.triangleOffset = (uint32_t)mesh.meshletTriangles.size();
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        uint32_t added = 0;
+        for (int k = 0; k < 3; ++k) {
+            const bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+            added += local[corners[k]] == 0xFF && !repeated;
+        }
+        if (current.vertexCount + added > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES) {
+            finish();
+        }
+        for (int k = 0; k < 3; ++k) {
+            if (local[corners[k]] == 0xFF) {
+                local[corners[k]] = (uint8_t)current.vertexCount++;
+                mesh.meshletVertices.push_back(corners[k]);
+            }
+            mesh.meshletTriangles.push_back(local[corners[k]]);
+        }
+        current.triangleCount++;
+    }
+    finish();
+}
+
+CookedMesh cook_mesh(MeshData source) {
+    CookedMesh mesh;
+    const size_t vertexCount = source.vertices.size();
+    // Importers produce 32-bit indices; store them in the narrowest width the vertex count allows
+    if (index_format_for(vertexCount) != source.indices.format) {
+        MeshIndices narrowed;
+        narrowed.resize(source.indices.size(), vertexCount);
+        for (size_t i = 0; i < source.indices.size(); ++i) {
+            if (narrowed.format == IndexFormat::UInt16) {
+                narrowed.indices16[i] = (uint16_t)source.indices[i];
+            } else {
+                narrowed.indices32[i] = source.indices[i];
+            }
+        }
+        source.indices = std::move(narrowed);
+    }
+    optimize_vertex_cache(source.indices, vertexCount);
+
+    mesh.bounds = compute_bounds(source.vertices.data(), vertexCount);
+    build_meshlets(source.vertices, source.indices, mesh);
+    mesh.lods = build_mesh_lods(source.vertices, source.indices);
+    mesh.vertices = std::move(source.vertices);
+    mesh.indices = std::move(source.indices);
+    return mesh;
+}
+
+size_t mesh_asset_file_size(const CookedMesh& mesh) {
+    return layout_header(mesh).fileSize;
+}
+
+bool write_mesh_asset(const std::string& path, const CookedMesh& mesh, bool compress) {
+    MeshAssetHeader header = layout_header(mesh);
+    if (compress) {
+        const std::vector<uint8_t> sections[MESH_ASSET_SECTION_COUNT] = {
+            encode_vertex_buffer(mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex)),
+            encode_index_buffer(mesh.indices.data(), mesh.indices.size(), index_stride(mesh.indices.format)),
+            encode_vertex_buffer(mesh.meshlets.data(), mesh.meshlets.size(), sizeof(Meshlet)),
+            encode_index_buffer(mesh.meshletVertices.data(), mesh.meshletVertices.size(), sizeof(uint32_t)),
+            encode_vertex_buffer(mesh.meshletTriangles.data(), mesh.meshletTriangles.size() / TRIANGLE_BYTES,
+                                 TRIANGLE_BYTES),
+        };
+        header.compressed = 1;
+        std::vector<char> contents(sizeof(header));
+        for (size_t i = 0; i < MESH_ASSET_SECTION_COUNT; ++i) {
+            header.storedBytes[i] = sections[i].size();
+            contents.insert(contents.end(), sections[i].begin(), sections[i].end());
+        }
+        memcpy(contents.data(), &header, sizeof(header));
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        return (bool)file.write(contents.data(), contents.size());
+    }
+
+    std::vector<char> contents(header.fileSize, 0);
+    memcpy(contents.data(), &header, sizeof(header));
+    memcpy(contents.data() + header.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+    memcpy(contents.data() + header.indexOffset, mesh.indices.data(), mesh.indices.byte_size());
+    memcpy(contents.data() + header.meshletOffset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+    memcpy(contents.data() + header.meshletVertexOffset, mesh.meshletVertices.data(),
+           mesh.meshletVertices.size() * sizeof(uint32_t));
+    memcpy(contents.data() + header.meshletTriangleOffset, mesh.meshletTriangles.data(), mesh.meshletTriangles.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    return (bool)file.write(contents.data(), contents.size());
+}
+
+bool map_mesh_asset(const std::string& path, MeshAsset& asset) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MeshAssetHeader)) {
+        close(fd);
+        return false;
+    }
+    const size_t fileSize = (size_t)info.st_size;
+    void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    MeshAssetHeader header;
+    memcpy(&header, data, sizeof(header));
+    // The sections must fit the file as decoded
+    const uint64_t layoutSize = header.fileSize;
+    const uint64_t indexBytes = (uint64_t)header.indexCount * index_stride((IndexFormat)header.indexFormat);
+    const bool valid = header.magic == MESH_ASSET_MAGIC && header.version == MESH_ASSET_VERSION &&
+                       header.vertexStride == sizeof(Vertex) &&
+                       (header.compressed ? stored_size_matches(header, fileSize) : layoutSize == fileSize) &&
+                       header.indexFormat <= (uint32_t)IndexFormat::UInt32 &&
+                       section_fits(header.vertexOffset, (uint64_t)header.vertexCount * sizeof(Vertex), layoutSize) &&
+                       section_fits(header.indexOffset, indexBytes, layoutSize) &&
+                       section_fits(header.meshletOffset, (uint64_t)header.meshletCount * sizeof(Meshlet),
+                                    layoutSize) &&
+                       section_fits(header.meshletVertexOffset, (uint64_t)header.meshletVertexCount * sizeof(uint32_t),
+                                    layoutSize) &&
+                       section_fits(header.meshletTriangleOffset, header.meshletTriangleBytes, layoutSize) &&
+                       lods_fit(header);
+    if (!valid) {
+        munmap(data, fileSize);
+        return false;
+    }
+
+    asset.decoded = header.compressed != 0;
+    if (asset.decoded) {
+        char* decoded = (char*)calloc(layoutSize, 1);
+        const bool complete = decoded && decode_sections(header, (const uint8_t*)data + sizeof(header), decoded);
+        munmap(data, fileSize);
+        if (!complete) {
+            free(decoded);
+            return false;
+        }
+        memcpy(decoded, &header, sizeof(header));
+        data = decoded;
+    }
+
+    const char* bytes = (const char*)data;
+    asset.data = data;
+    asset.length = layoutSize;
+    asset.header = header;
+    asset.vertices = (const Vertex*)(bytes + header.vertexOffset);
+    asset.indices = bytes + header.indexOffset;
+    asset.meshlets = (const Meshlet*)(bytes + header.meshletOffset);
+    asset.meshletVertices = (const uint32_t*)(bytes + header.meshletVertexOffset);
+    asset.meshletTriangles = (const uint8_t*)(bytes + header.meshletTriangleOffset);
+    return true;
+}
+
+void unmap_mesh_asset(const MeshAsset& asset) {
+    if (asset.decoded) {
+        free(asset.data);
+    } else if (asset.data) {
+        munmap(asset.data, asset.length);
+    }
+}
@@ -0,0 +1,188 @@
+/**
+ * @file mesh_asset.hpp
+ * @brief Cooked meshes: a binary file laid out exactly as the renderer uses it.
+ *
+ * The mesh_cooker tool imports OBJ or glTF, reorders the indices with
+ * optimize_vertex_cache(), builds coarser detail levels (mesh_lod.hpp) after the full triangle
+ * list, splits the full list into meshlets and writes the result with
+ * write_mesh_asset(). At runtime map_mesh_asset() maps the file and only checks the header;
+ * vertices are stored in the `Vertex` layout and indices in their final width, so every
+ * section can be handed to the GPU as is. Loading costs one read of the file no matter how
+ * the mesh was authored.
+ *
+ * Sections follow a MeshAssetHeader at offset 0, each starting at a multiple of
+ * MESH_ASSET_ALIGNMENT: vertices, indices, meshlets, meshlet vertices, meshlet triangles.
+ *
+ * A compressed file stores the sections encoded with mesh_codec.hpp instead, back to back
+ * after the header, in the same order. map_mesh_asset() decodes them into memory laid out as
+ * the uncompressed file would be, so readers see no difference; the file is a fraction of the
+ * size at the cost of decoding on load.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_lod.hpp"
+#include "objects.hpp"
+
+/// "MESH" in little-endian byte order.
+constexpr uint32_t MESH_ASSET_MAGIC = 0x4853454d;
+/// Bump whenever files written by older cookers must not be read.
+constexpr uint32_t MESH_ASSET_VERSION = 4;
+/// Every section starts at a multiple of this.
+constexpr size_t MESH_ASSET_ALIGNMENT = 16;
+/// Sections of a cooked mesh file.
+constexpr size_t MESH_ASSET_SECTION_COUNT = 5;
+
+/// Most vertices a meshlet references; fits a threadgroup of a mesh shader.
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+/// Most triangles in a meshlet; 124 keeps the local index list under 384 bytes.
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+/// Meshlets tested per object threadgroup; one SIMD group, matching shaders.metal.
+constexpr uint32_t MESHLET_OBJECT_THREADS = 32;
+/// Threads per mesh threadgroup: one per meshlet vertex, looping over the triangle indices.
+constexpr uint32_t MESHLET_MESH_THREADS = 128;
+
+/**
+ * @struct Meshlet
+ * @brief A small cluster of triangles with its own vertex list, for cluster culling and mesh shaders.
+ */
+struct Meshlet {
+    uint32_t vertexOffset = 0;    ///< First entry of the meshlet in the meshlet vertex list.
+    uint32_t triangleOffset = 0;  ///< First byte of the meshlet in the meshlet triangle list.
+    uint32_t vertexCount = 0;     ///< Entries in the meshlet vertex list.
+    uint32_t triangleCount = 0;   ///< Triangles, each three bytes of local vertex indices.
+    float center[3] = {};         ///< Centre of the bounding sphere in model space.
+    float radius = 0.0f;          ///< Radius of the bounding sphere.
+    float coneAxis[3] = {};       ///< Average facing of the triangles; zero if they face too many ways to cull.
+    float coneCutoff = 1.0f;      ///< Sine of the largest angle between a triangle normal and coneAxis.
+};
+
+/**
+ * @brief Tests whether every triangle of a meshlet faces away from a viewpoint.
+ *
+ * The test is conservative for any viewpoint, so a culled meshlet has no front-facing
+ * triangle. Affine transforms keep which side of a triangle a point is on, so the test can be
+ * done in model space with the camera moved there, even under non-uniform scale.
+ *
+ * @param meshlet The meshlet, in model space.
+ * @param viewpoint The camera position in the same space.
+ * @return True if the meshlet can be skipped.
+ */
+bool meshlet_backfacing(const Meshlet& meshlet, const float viewpoint[3]);
+
+/**
+ * @struct MeshAssetHeader
+ * @brief The first bytes of a cooked mesh file.
+ */
+struct MeshAssetHeader {
+    uint32_t magic = MESH_ASSET_MAGIC;      ///< Identifies a cooked mesh.
+    uint32_t version = MESH_ASSET_VERSION;  ///< Format version the file was written with.
+    uint32_t vertexStride = sizeof(Vertex); ///< sizeof(Vertex) of the cooker; must match the reader's.
+    uint32_t indexFormat = 0;               ///< IndexFormat of the index section.
+    uint32_t vertexCount = 0;               ///< Vertices in the vertex section.
+    uint32_t indexCount = 0;                ///< Indices in the index section.
+    uint32_t meshletCount = 0;              ///< Entries in the meshlet section.
+    uint32_t meshletVertexCount = 0;        ///< uint32_t entries in the meshlet vertex section.
+    uint32_t meshletTriangleBytes = 0;      ///< Bytes in the meshlet triangle section.
+    float boundsMin[3] = {};                ///< Smallest corner of the model space bounds.
+    float boundsMax[3] = {};                ///< Largest corner of the model space bounds.
+    uint64_t vertexOffset = 0;              ///< Byte offset of the vertex section.
+    uint64_t indexOffset = 0;               ///< Byte offset of the index section.
+    uint64_t meshletOffset = 0;             ///< Byte offset of the meshlet section.
+    uint64_t meshletVertexOffset = 0;       ///< Byte offset of the meshlet vertex section.
+    uint64_t meshletTriangleOffset = 0;     ///< Byte offset of the meshlet triangle section.
+    uint64_t fileSize = 0;                  ///< Size of the whole file; once decoded if compressed.
+    uint32_t lodCount = 0;                  ///< Detail levels in lods; level 0 is the full mesh.
+    MeshLod lods[MESH_LOD_MAX_LEVELS] = {}; ///< Index ranges of the levels within the index section.
+    uint32_t compressed = 0;                ///< Nonzero if the sections are stored encoded.
+    uint64_t storedBytes[MESH_ASSET_SECTION_COUNT] = {}; ///< Encoded size of each section, in file order.
+};
+
+/**
+ * @struct CookedMesh
+ * @brief A mesh prepared for the runtime; what write_mesh_asset() stores.
+ */
+struct CookedMesh {
+    std::vector<Vertex> vertices;
+    MeshIndices indices;                    ///< Every detail level's triangle list, in vertex cache order.
+    MeshLodChain lods;                      ///< Index ranges of the detail levels.
+    BoundingBox bounds;                     ///< Model space bounds of vertices.
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletVertices;  ///< Mesh vertex indices, referenced by Meshlet::vertexOffset.
+    std::vector<uint8_t> meshletTriangles;  ///< Local vertex indices, three per triangle.
+};
+
+/**
+ * @struct MeshAsset
+ * @brief A cooked mesh file mapped into memory; the pointers point into the mapping.
+ */
+struct MeshAsset {
+    void* data = nullptr;                       ///< Start of the mapping, or of the decoded file.
+    size_t length = 0;                          ///< Length of the mapping or of the decoded file.
+    bool decoded = false;                       ///< data was decoded from a compressed file and is not a mapping.
+    MeshAssetHeader header;                     ///< Copy of the validated header.
+    const Vertex* vertices = nullptr;
+    const void* indices = nullptr;              ///< uint16_t or uint32_t, as header.indexFormat says.
+    const Meshlet* meshlets = nullptr;
+    const uint32_t* meshletVertices = nullptr;
+    const uint8_t* meshletTriangles = nullptr;
+};
+
+/**
+ * @brief Splits a triangle list into meshlets, keeping the triangle order.
+ *
+ * Triangles are added to the current meshlet until it would exceed MESHLET_MAX_VERTICES or
+ * MESHLET_MAX_TRIANGLES, so a list already ordered for the vertex cache gives meshlets
+ * whose triangles share most of their vertices. Each meshlet gets a bounding sphere and a
+ * normal cone for meshlet_backfacing().
+ *
+ * @param vertices The mesh vertices, for the bounding spheres and normal cones.
+ * @param indices The triangle list.
+ * @param mesh Receives meshlets, meshletVertices and meshletTriangles.
+ */
+void build_meshlets(const std::vector<Vertex>& vertices, const MeshIndices& indices, CookedMesh& mesh);
+
+/**
+ * @brief Prepares a mesh for the runtime.
+ *
+ * Narrows the indices if the vertex count allows, reorders them with
+ * optimize_vertex_cache(), builds meshlets, appends the coarser detail levels with
+ * build_mesh_lods() and computes the bounds. Meshlets cover level 0 only.
+ *
+ * @param source The imported mesh.
+ * @return The cooked mesh.
+ */
+CookedMesh cook_mesh(MeshData source);
+
+/// @return The size of the uncompressed file write_mesh_asset() writes for a mesh.
+size_t mesh_asset_file_size(const CookedMesh& mesh);
+
+/**
+ * @brief Writes a cooked mesh file.
+ * @param path The output path.
+ * @param mesh The mesh.
+ * @param compress Store the sections encoded.
+ * @return True if the file was written.
+ */
+bool write_mesh_asset(const std::string& path, const CookedMesh& mesh, bool compress = false);
+
+/**
+ * @brief Maps a cooked mesh file and checks its header.
+ *
+ * Nothing is parsed or converted; the sections are used where they lie in the mapping. A
+ * compressed file is decoded into memory instead and the mapping released.
+ *
+ * @param path The file to map.
+ * @param asset Receives the mapping and pointers to its sections.
+ * @return True if the file exists and was written for this Vertex layout and format version;
+ *         the mapping must be released with unmap_mesh_asset().
+ */
+bool map_mesh_asset(const std::string& path, MeshAsset& asset);
+
+/// Releases a mapping, or decoded file, made by map_mesh_asset().
+void unmap_mesh_asset(const MeshAsset& asset);
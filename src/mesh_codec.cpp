@@ -0,0 +1,377 @@
+#include "mesh_codec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // LZ4 block rules: matches are at least 4 bytes, the last 5 bytes are literals and no match
+    // starts in the last 12
+    constexpr size_t LZ_MIN_MATCH = 4;
+    constexpr size_t LZ_LAST_LITERALS = 5;
+    constexpr size_t LZ_MATCH_LIMIT = 12;
+    constexpr size_t LZ_MAX_OFFSET = 65535;
+    constexpr uint32_t LZ_HASH_BITS = 14;
+
+    // Values are bit-packed in groups of this many, at 0, 2, 4 or 8 bits each
+    constexpr size_t GROUP_SIZE = 16;
+    constexpr uint32_t GROUP_WIDTHS[4] = { 0, 2, 4, 8 };
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t lz_hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+    }
+
+    void write_length(std::vector<uint8_t>& out, size_t length) {
+        for (; length >= 255; length -= 255) {
+            out.push_back(255);
+        }
+        out.push_back((uint8_t)length);
+    }
+
+    bool read_length(const uint8_t* data, size_t size, size_t& pos, size_t& length) {
+        uint8_t byte;
+        do {
+            if (pos >= size) {
+                return false;
+            }
+            byte = data[pos++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // One LZ4 sequence: literals, then a match unless matchLength is 0
+    void emit_sequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset,
+                       size_t matchLength) {
+        const size_t matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+        out.push_back((uint8_t)(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(matchCode, 15)));
+        if (literalCount >= 15) {
+            write_length(out, literalCount - 15);
+        }
+        out.insert(out.end(), literals, literals + literalCount);
+        if (matchLength == 0) {
+            return;
+        }
+        out.push_back((uint8_t)(offset & 0xff));
+        out.push_back((uint8_t)(offset >> 8));
+        if (matchCode >= 15) {
+            write_length(out, matchCode - 15);
+        }
+    }
+
+    uint8_t zigzag8(uint8_t delta) {
+        return (uint8_t)(delta << 1 ^ (uint8_t)((int8_t)delta >> 7));
+    }
+
+    uint8_t unzigzag8(uint8_t value) {
+        return (uint8_t)(value >> 1 ^ (uint8_t)-(int)(value & 1));
+    }
+
+    uint16_t zigzag16(uint16_t delta) {
+        return (uint16_t)(delta << 1 ^ (uint16_t)((int16_t)delta >> 15));
+    }
+
+    uint16_t unzigzag16(uint16_t value) {
+        return (uint16_t)(value >> 1 ^ (uint16_t)-(int)(value & 1));
+    }
+
+    // Appends a header of 2-bit width codes, four groups to a byte, then each group at its width
+    void pack_groups(const uint8_t* values, size_t count, std::vector<uint8_t>& out) {
+        const size_t groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+        const size_t header = out.size();
+        out.resize(out.size() + (groups + 3) / 4, 0);
+        for (size_t g = 0; g < groups; ++g) {
+            uint8_t group[GROUP_SIZE] = {};
+            const size_t n = std::min(GROUP_SIZE, count - g * GROUP_SIZE);
+            memcpy(group, values + g * GROUP_SIZE, n);
+            const uint8_t largest = *std::max_element(group, group + GROUP_SIZE);
+            const uint32_t code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+            out[header + g / 4] |= (uint8_t)(code << (g % 4 * 2));
+            const uint32_t width = GROUP_WIDTHS[code];
+            if (width == 0) {
+                continue;
+            }
+            const size_t start = out.size();
+            out.resize(start + GROUP_SIZE * width / 8, 0);
+            for (size_t i = 0; i < GROUP_SIZE; ++i) {
+                const size_t bit = i * width;
+                out[start + bit / 8] |= (uint8_t)(group[i] << (bit % 8));
+            }
+        }
+    }
+
+    bool unpack_groups(const uint8_t* data, size_t size, size_t& pos, uint8_t* values, size_t count) {
+        const size_t groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+        const size_t headerBytes = (groups + 3) / 4;
+        if (size - pos < headerBytes) {
+            return false;
+        }
+        const uint8_t* header = data + pos;
+        pos += headerBytes;
+        for (size_t g = 0; g < groups; ++g) {
+            const uint32_t width = GROUP_WIDTHS[header[g / 4] >> (g % 4 * 2) & 3];
+            const size_t n = std::min(GROUP_SIZE, count - g * GROUP_SIZE);
+            uint8_t* group = values + g * GROUP_SIZE;
+            if (width == 0) {
+                memset(group, 0, n);
+                continue;
+            }
+            const size_t bytes = GROUP_SIZE * width / 8;
+            if (size - pos < bytes) {
+                return false;
+            }
+            const uint8_t mask = (uint8_t)((1u << width) - 1);
+            for (size_t i = 0; i < n; ++i) {
+                const size_t bit = i * width;
+                group[i] = data[pos + bit / 8] >> (bit % 8) & mask;
+            }
+            pos += bytes;
+        }
+        return true;
+    }
+
+    // Prefixes the LZ4 block with the size of the stream it holds
+    std::vector<uint8_t> compress_stream(const std::vector<uint8_t>& stream) {
+        std::vector<uint8_t> block;
+        lz_compress(stream.data(), stream.size(), block);
+        std::vector<uint8_t> out(sizeof(uint32_t));
+        const uint32_t size = (uint32_t)stream.size();
+        memcpy(out.data(), &size, sizeof(size));
+        out.insert(out.end(), block.begin(), block.end());
+        return out;
+    }
+
+    // Streams larger than the packing can make of the expected values are rejected before allocating
+    bool expand_stream(const uint8_t* data, size_t size, size_t maxSize, std::vector<uint8_t>& stream) {
+        uint32_t streamSize;
+        if (size < sizeof(streamSize)) {
+            return false;
+        }
+        memcpy(&streamSize, data, sizeof(streamSize));
+        if (streamSize > maxSize) {
+            return false;
+        }
+        stream.resize(streamSize);
+        return lz_decompress(data + sizeof(streamSize), size - sizeof(streamSize), stream.data(), streamSize);
+    }
+
+    // The most bytes pack_groups() writes for count values
+    size_t packed_bound(size_t count) {
+        const size_t groups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+        return (groups + 3) / 4 + groups * GROUP_SIZE;
+    }
+
+    uint32_t load_index(const void* indices, size_t i, size_t indexSize) {
+        if (indexSize == sizeof(uint16_t)) {
+            return ((const uint16_t*)indices)[i];
+        }
+        return ((const uint32_t*)indices)[i];
+    }
+
+    // The left, upper and upper-left samples predict a plane through them
+    uint16_t predict_sample(const uint16_t* samples, uint32_t width, uint32_t x, uint32_t y) {
+        const size_t i = (size_t)y * width + x;
+        if (x > 0 && y > 0) {
+            return (uint16_t)(samples[i - 1] + samples[i - width] - samples[i - width - 1]);
+        }
+        return x > 0 ? samples[i - 1] : y > 0 ? samples[i - width] : 0;
+    }
+}
+
+void lz_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    size_t anchor = 0;
+    if (size > LZ_MATCH_LIMIT) {
+        // Positions plus one, so zero is an empty slot
+        std::vector<uint32_t> table((size_t)1 << LZ_HASH_BITS, 0);
+        const size_t lastMatch = size - LZ_MATCH_LIMIT;
+        const size_t matchEnd = size - LZ_LAST_LITERALS;
+        size_t i = 0;
+        while (i < lastMatch) {
+            const uint32_t sequence = read32(data + i);
+            uint32_t& slot = table[lz_hash(sequence)];
+            const size_t candidate = slot;
+            slot = (uint32_t)(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET || read32(data + candidate - 1) != sequence) {
+                ++i;
+                continue;
+            }
+            const size_t match = candidate - 1;
+            size_t length = LZ_MIN_MATCH;
+            while (i + length < matchEnd && data[match + length] == data[i + length]) {
+                ++length;
+            }
+            emit_sequence(out, data + anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    emit_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool lz_decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+    size_t pos = 0, written = 0;
+    while (pos < size) {
+        const uint8_t token = data[pos++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !read_length(data, size, pos, literals)) {
+            return false;
+        }
+        if (literals > size - pos || literals > outSize - written) {
+            return false;
+        }
+        std::copy(data + pos, data + pos + literals, out + written);
+        pos += literals;
+        written += literals;
+        if (pos == size) {
+            break; // The last sequence has no match
+        }
+        if (size - pos < 2) {
+            return false;
+        }
+        const size_t offset = data[pos] | (size_t)data[pos + 1] << 8;
+        pos += 2;
+        size_t length = token & 15;
+        if (length == 15 && !read_length(data, size, pos, length)) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || length > outSize - written) {
+            return false;
+        }
+        // Byte by byte: a match may overlap the bytes it produces
+        for (size_t i = 0; i < length; ++i) {
+            out[written + i] = out[written + i - offset];
+        }
+        written += length;
+    }
+    return written == outSize;
+}
+
+std::vector<uint8_t> encode_vertex_buffer(const void* vertices, size_t count, size_t stride) {
+    const uint8_t* bytes = (const uint8_t*)vertices;
+    std::vector<uint8_t> plane(count), stream;
+    for (size_t b = 0; b < stride; ++b) {
+        uint8_t previous = 0;
+        for (size_t v = 0; v < count; ++v) {
+            const uint8_t byte = bytes[v * stride + b];
+            plane[v] = zigzag8((uint8_t)(byte - previous));
+            previous = byte;
+        }
+        pack_groups(plane.data(), count, stream);
+    }
+    return compress_stream(stream);
+}
+
+bool decode_vertex_buffer(const uint8_t* data, size_t size, void* vertices, size_t count, size_t stride) {
+    std::vector<uint8_t> stream;
+    if (!expand_stream(data, size, packed_bound(count) * stride, stream)) {
+        return false;
+    }
+    uint8_t* bytes = (uint8_t*)vertices;
+    std::vector<uint8_t> plane(count);
+    size_t pos = 0;
+    for (size_t b = 0; b < stride; ++b) {
+        if (!unpack_groups(stream.data(), stream.size(), pos, plane.data(), count)) {
+            return false;
+        }
+        uint8_t previous = 0;
+        for (size_t v = 0; v < count; ++v) {
+            previous = (uint8_t)(previous + unzigzag8(plane[v]));
+            bytes[v * stride + b] = previous;
+        }
+    }
+    return pos == stream.size();
+}
+
+std::vector<uint8_t> encode_index_buffer(const void* indices, size_t count, size_t indexSize) {
+    std::vector<uint8_t> stream;
+    stream.reserve(count * 2);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t index = load_index(indices, i, indexSize);
+        const uint32_t delta = index - previous;
+        uint32_t value = delta << 1 ^ (uint32_t)((int32_t)delta >> 31);
+        for (; value >= 0x80; value >>= 7) {
+            stream.push_back((uint8_t)(value | 0x80));
+        }
+        stream.push_back((uint8_t)value);
+        previous = index;
+    }
+    return compress_stream(stream);
+}
+
+bool decode_index_buffer(const uint8_t* data, size_t size, void* indices, size_t count, size_t indexSize) {
+    std::vector<uint8_t> stream;
+    // A 32-bit value takes at most five variable-length bytes
+    if (!expand_stream(data, size, count * 5, stream)) {
+        return false;
+    }
+    size_t pos = 0;
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            if (pos >= stream.size() || shift > 28) {
+                return false;
+            }
+            const uint8_t byte = stream[pos++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                break;
+            }
+        }
+        previous += value >> 1 ^ (uint32_t)-(int32_t)(value & 1);
+        if (indexSize == sizeof(uint16_t)) {
+            ((uint16_t*)indices)[i] = (uint16_t)previous;
+        } else {
+            ((uint32_t*)indices)[i] = previous;
+        }
+    }
+    return pos == stream.size();
+}
+
+std::vector<uint8_t> encode_height_grid(const uint16_t* samples, uint32_t width, uint32_t height) {
+    const size_t count = (size_t)width * height;
+    std::vector<uint8_t> low(count), high(count), stream;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const size_t i = (size_t)y * width + x;
+            const uint16_t residual = zigzag16((uint16_t)(samples[i] - predict_sample(samples, width, x, y)));
+            low[i] = (uint8_t)residual;
+            high[i] = (uint8_t)(residual >> 8);
+        }
+    }
+    pack_groups(low.data(), count, stream);
+    pack_groups(high.data(), count, stream);
+    return compress_stream(stream);
+}
+
+bool decode_height_grid(const uint8_t* data, size_t size, uint16_t* samples, uint32_t width, uint32_t height) {
+    const size_t count = (size_t)width * height;
+    std::vector<uint8_t> stream;
+    if (!expand_stream(data, size, packed_bound(count) * 2, stream)) {
+        return false;
+    }
+    std::vector<uint8_t> low(count), high(count);
+    size_t pos = 0;
+    if (!unpack_groups(stream.data(), stream.size(), pos, low.data(), count) ||
+        !unpack_groups(stream.data(), stream.size(), pos, high.data(), count) || pos != stream.size()) {
+        return false;
+    }
+    // Row by row, so every prediction reads samples already decoded
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const size_t i = (size_t)y * width + x;
+            const uint16_t residual = unzigzag16((uint16_t)(low[i] | high[i] << 8));
+            samples[i] = (uint16_t)(predict_sample(samples, width, x, y) + residual);
+        }
+    }
+    return true;
+}
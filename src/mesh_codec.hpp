@@ -0,0 +1,104 @@
+/**
+ * @file mesh_codec.hpp
+ * @brief Lossless codecs that shrink cooked meshes and terrain tiles on disk.
+ *
+ * Each codec first turns its data into small numbers that repeat, then packs and compresses
+ * them with an LZ4 block compressor:
+ *
+ * - Vertices are split into byte planes, one per byte of the stride, and each byte is stored
+ *   as its difference from the same byte of the previous vertex. Neighbouring vertices of a
+ *   grid or of a vertex cache ordered mesh differ little, so most differences need 0, 2 or 4
+ *   bits, and every group of 16 is bit-packed at the width its largest needs, as
+ *   meshoptimizer's vertex codec does.
+ * - Indices are stored as the difference from the previous index in variable-length bytes;
+ *   a vertex cache ordered list mostly steps by a few vertices.
+ * - Height grids predict each sample from its left, upper and upper-left neighbours, which a
+ *   smooth slope follows exactly, and pack the residuals like vertex bytes.
+ *
+ * Decoding is a single pass without allocation beyond the unpacked stream, fast enough to run
+ * on the jobs that stream chunks in, one chunk per job. Every decoder validates its input and
+ * fails rather than reading or writing out of bounds.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Compresses bytes into an LZ4 block.
+ * @param data The bytes.
+ * @param size Number of bytes.
+ * @param out Receives the block; readable by any LZ4 block decoder given the size.
+ */
+void lz_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+/**
+ * @brief Decompresses an LZ4 block.
+ * @param data The block.
+ * @param size Bytes of the block.
+ * @param out Receives exactly outSize bytes.
+ * @param outSize The decompressed size.
+ * @return False if the block is malformed or does not decompress to exactly outSize bytes.
+ */
+bool lz_decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
+/**
+ * @brief Encodes a vertex buffer.
+ * @param vertices count vertices, stride bytes apart.
+ * @param count Number of vertices.
+ * @param stride Bytes of a vertex.
+ * @return The encoded bytes.
+ */
+std::vector<uint8_t> encode_vertex_buffer(const void* vertices, size_t count, size_t stride);
+
+/**
+ * @brief Decodes what encode_vertex_buffer() wrote.
+ * @param data The encoded bytes.
+ * @param size Bytes of data.
+ * @param vertices Receives count * stride bytes.
+ * @param count Number of vertices encoded.
+ * @param stride Bytes of a vertex.
+ * @return False if data is malformed or holds a different amount of vertex data.
+ */
+bool decode_vertex_buffer(const uint8_t* data, size_t size, void* vertices, size_t count, size_t stride);
+
+/**
+ * @brief Encodes an index buffer.
+ * @param indices count indices of indexSize bytes.
+ * @param count Number of indices.
+ * @param indexSize 2 or 4.
+ * @return The encoded bytes.
+ */
+std::vector<uint8_t> encode_index_buffer(const void* indices, size_t count, size_t indexSize);
+
+/**
+ * @brief Decodes what encode_index_buffer() wrote.
+ * @param data The encoded bytes.
+ * @param size Bytes of data.
+ * @param indices Receives count indices of indexSize bytes.
+ * @param count Number of indices encoded.
+ * @param indexSize 2 or 4.
+ * @return False if data is malformed or holds a different number of indices.
+ */
+bool decode_index_buffer(const uint8_t* data, size_t size, void* indices, size_t count, size_t indexSize);
+
+/**
+ * @brief Encodes a grid of 16-bit samples, e.g. quantized or half-float heights.
+ * @param samples width * height samples, row after row.
+ * @param width Samples along X.
+ * @param height Samples along Y.
+ * @return The encoded bytes.
+ */
+std::vector<uint8_t> encode_height_grid(const uint16_t* samples, uint32_t width, uint32_t height);
+
+/**
+ * @brief Decodes what encode_height_grid() wrote.
+ * @param data The encoded bytes.
+ * @param size Bytes of data.
+ * @param samples Receives width * height samples.
+ * @param width Samples along X.
+ * @param height Samples along Y.
+ * @return False if data is malformed or holds a different number of samples.
+ */
+bool decode_height_grid(const uint8_t* data, size_t size, uint16_t* samples, uint32_t width, uint32_t height);
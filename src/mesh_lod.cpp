@@ -0,0 +1,375 @@
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "vertex_cache.hpp"
+
+namespace {
+    // Border edges weigh this much more than the faces beside them, so outlines move last
+    constexpr double BORDER_WEIGHT = 10.0;
+
+    // Sum of weighted squared distances to planes, as the upper half of their symmetric 4x4 matrix
+    struct Quadric {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double weight = 0.0;
+    };
+
+    void add_plane(Quadric& q, simd::float3 normal, float d, double weight) {
+        const double a = normal.x, b = normal.y, c = normal.z;
+        q.a2 += weight * a * a;
+        q.ab += weight * a * b;
+        q.ac += weight * a * c;
+        q.ad += weight * a * d;
+        q.b2 += weight * b * b;
+        q.bc += weight * b * c;
+        q.bd += weight * b * d;
+        q.c2 += weight * c * c;
+        q.cd += weight * c * d;
+        q.d2 += weight * d * d;
+        q.weight += weight;
+    }
+
+    Quadric sum(const Quadric& q, const Quadric& r) {
+        Quadric s;
+        s.a2 = q.a2 + r.a2;
+        s.ab = q.ab + r.ab;
+        s.ac = q.ac + r.ac;
+        s.ad = q.ad + r.ad;
+        s.b2 = q.b2 + r.b2;
+        s.bc = q.bc + r.bc;
+        s.bd = q.bd + r.bd;
+        s.c2 = q.c2 + r.c2;
+        s.cd = q.cd + r.cd;
+        s.d2 = q.d2 + r.d2;
+        s.weight = q.weight + r.weight;
+        return s;
+    }
+
+    // Weighted mean squared distance of a point to the planes
+    double evaluate(const Quadric& q, simd::float3 p) {
+        if (q.weight <= 0.0) {
+            return 0.0;
+        }
+        const double x = p.x, y = p.y, z = p.z;
+        const double value = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + q.d2 +
+                             2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z + q.ad * x + q.bd * y + q.cd * z);
+        return std::max(value, 0.0) / q.weight;
+    }
+
+    struct PositionKey {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct PositionHash {
+        size_t operator()(const PositionKey& key) const {
+            return ((size_t)key.bits[0] * 73856093u) ^ ((size_t)key.bits[1] * 19349663u) ^
+                   ((size_t)key.bits[2] * 83492791u);
+        }
+    };
+
+    struct Collapse {
+        uint32_t from = 0;  // Group that moves
+        uint32_t to = 0;    // Group it moves onto
+        double cost = 0.0;  // Mean squared distance of the merged quadric at the destination
+    };
+
+    // Vertices with the same position form a group; collapses move whole groups
+    struct Groups {
+        std::vector<uint32_t> ofVertex;     // Group of each vertex
+        std::vector<simd::float3> position; // Position of each group
+        std::vector<uint32_t> first;        // CSR offsets of each group's vertices; one more than the groups
+        std::vector<uint32_t> vertices;     // Vertices of each group
+    };
+
+    Groups group_vertices(const std::vector<Vertex>& vertices) {
+        Groups groups;
+        groups.ofVertex.resize(vertices.size());
+        std::unordered_map<PositionKey, uint32_t, PositionHash> lookup;
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            PositionKey key;
+            // Adding zero turns -0 into 0, so the two compare equal bitwise
+            const float p[3] = { vertices[v].position.x + 0.0f, vertices[v].position.y + 0.0f,
+                                 vertices[v].position.z + 0.0f };
+            memcpy(key.bits, p, sizeof(key.bits));
+            auto inserted = lookup.emplace(key, (uint32_t)groups.position.size());
+            if (inserted.second) {
+                groups.position.push_back(vertices[v].position);
+            }
+            groups.ofVertex[v] = inserted.first->second;
+        }
+        groups.first.assign(groups.position.size() + 1, 0);
+        for (uint32_t g : groups.ofVertex) {
+            groups.first[g + 1]++;
+        }
+        for (size_t g = 0; g < groups.position.size(); ++g) {
+            groups.first[g + 1] += groups.first[g];
+        }
+        groups.vertices.resize(vertices.size());
+        std::vector<uint32_t> cursor(groups.first.begin(), groups.first.end() - 1);
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            groups.vertices[cursor[groups.ofVertex[v]]++] = (uint32_t)v;
+        }
+        return groups;
+    }
+
+    uint64_t edge_key(uint32_t a, uint32_t b) {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // Face planes weighted by area, plus planes through the border edges standing up from their face
+    std::vector<Quadric> initial_quadrics(const Groups& groups, const std::vector<uint32_t>& triangles) {
+        std::vector<Quadric> quadrics(groups.position.size());
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                edgeUses[edge_key(groups.ofVertex[triangles[t + k]], groups.ofVertex[triangles[t + (k + 1) % 3]])]++;
+            }
+        }
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            const uint32_t g[3] = { groups.ofVertex[triangles[t]], groups.ofVertex[triangles[t + 1]],
+                                    groups.ofVertex[triangles[t + 2]] };
+            const simd::float3 p[3] = { groups.position[g[0]], groups.position[g[1]], groups.position[g[2]] };
+            const simd::float3 cross = simd::cross(p[1] - p[0], p[2] - p[0]);
+            const float length = simd::length(cross);
+            if (length <= 0.0f) {
+                continue;
+            }
+            const simd::float3 normal = cross / length;
+            const float d = -simd::dot(normal, p[0]);
+            for (int k = 0; k < 3; ++k) {
+                add_plane(quadrics[g[k]], normal, d, 0.5 * length);
+            }
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = g[k];
+                const uint32_t b = g[(k + 1) % 3];
+                if (edgeUses[edge_key(a, b)] != 1) {
+                    continue;
+                }
+                const simd::float3 edge = p[(k + 1) % 3] - p[k];
+                const float edgeLength = simd::length(edge);
+                if (edgeLength <= 0.0f) {
+                    continue;
+                }
+                const simd::float3 side = simd::cross(edge / edgeLength, normal);
+                const float sideD = -simd::dot(side, p[k]);
+                const double weight = BORDER_WEIGHT * edgeLength * edgeLength;
+                add_plane(quadrics[a], side, sideD, weight);
+                add_plane(quadrics[b], side, sideD, weight);
+            }
+        }
+        return quadrics;
+    }
+
+    // True if moving `from` onto `to` turns any remaining triangle around `from` over
+    bool flips(const Groups& groups, const std::vector<uint32_t>& triangles, const uint32_t* around, uint32_t count,
+               uint32_t from, uint32_t to) {
+        const simd::float3 target = groups.position[to];
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t t = around[i];
+            simd::float3 before[3], after[3];
+            bool collapsed = false;
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t g = groups.ofVertex[triangles[t * 3 + k]];
+                collapsed |= g == to;
+                before[k] = groups.position[g];
+                after[k] = g == from ? target : before[k];
+            }
+            const simd::float3 n0 = simd::cross(before[1] - before[0], before[2] - before[0]);
+            if (collapsed || simd::length_squared(n0) == 0.0f) {
+                continue; // Degenerates and is dropped, or has no side to flip
+            }
+            const simd::float3 n1 = simd::cross(after[1] - after[0], after[2] - after[0]);
+            if (simd::dot(n0, n1) <= 0.01f * simd::length(n0) * simd::length(n1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The vertex of a group whose normal is closest to a given one, so seams keep their sides
+    uint32_t matching_vertex(const Groups& groups, const std::vector<Vertex>& vertices, uint32_t group,
+                             simd::float3 normal) {
+        uint32_t best = groups.vertices[groups.first[group]];
+        float bestDot = -INFINITY;
+        for (uint32_t i = groups.first[group]; i < groups.first[group + 1]; ++i) {
+            const float d = simd::dot(vertices[groups.vertices[i]].normal, normal);
+            if (d > bestDot) {
+                bestDot = d;
+                best = groups.vertices[i];
+            }
+        }
+        return best;
+    }
+}
+
+std::vector<uint32_t> simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices,
+                                    size_t indexCount, size_t targetIndexCount, float& error) {
+    std::vector<uint32_t> triangles(indices, indices + indexCount);
+    error = 0.0f;
+    if (triangles.size() <= targetIndexCount) {
+        return triangles;
+    }
+    const Groups groups = group_vertices(vertices);
+    std::vector<Quadric> quadrics = initial_quadrics(groups, triangles);
+    const size_t groupCount = groups.position.size();
+    double worst = 0.0;
+
+    // Passes collapse the cheapest edges whose neighbourhoods do not touch, then rebuild the list
+    std::vector<uint32_t> aroundFirst, around, remap;
+    std::vector<uint8_t> locked;
+    std::vector<Collapse> collapses;
+    std::vector<uint64_t> edges;
+    while (triangles.size() > targetIndexCount) {
+        const size_t triangleCount = triangles.size() / 3;
+        aroundFirst.assign(groupCount + 1, 0);
+        for (uint32_t v : triangles) {
+            aroundFirst[groups.ofVertex[v] + 1]++;
+        }
+        for (size_t g = 0; g < groupCount; ++g) {
+            aroundFirst[g + 1] += aroundFirst[g];
+        }
+        around.resize(triangles.size());
+        std::vector<uint32_t> cursor(aroundFirst.begin(), aroundFirst.end() - 1);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            around[cursor[groups.ofVertex[triangles[i]]]++] = (uint32_t)(i / 3);
+        }
+
+        edges.clear();
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                edges.push_back(edge_key(groups.ofVertex[triangles[t + k]],
+                                         groups.ofVertex[triangles[t + (k + 1) % 3]]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        collapses.clear();
+        for (uint64_t edge : edges) {
+            const uint32_t a = (uint32_t)(edge >> 32);
+            const uint32_t b = (uint32_t)edge;
+            const Quadric merged = sum(quadrics[a], quadrics[b]);
+            const double toB = evaluate(merged, groups.position[b]);
+            const double toA = evaluate(merged, groups.position[a]);
+            collapses.push_back(toB <= toA ? Collapse{ a, b, toB } : Collapse{ b, a, toA });
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        locked.assign(groupCount, 0);
+        remap.resize(groupCount);
+        for (uint32_t g = 0; g < groupCount; ++g) {
+            remap[g] = g;
+        }
+        const size_t toRemove = triangleCount - targetIndexCount / 3;
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= toRemove) {
+                break;
+            }
+            if (locked[collapse.from] || locked[collapse.to]) {
+                continue;
+            }
+            const uint32_t* triangleList = around.data() + aroundFirst[collapse.from];
+            const uint32_t count = aroundFirst[collapse.from + 1] - aroundFirst[collapse.from];
+            if (flips(groups, triangles, triangleList, count, collapse.from, collapse.to)) {
+                continue;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] = sum(quadrics[collapse.to], quadrics[collapse.from]);
+            worst = std::max(worst, collapse.cost);
+            // Everything the collapse touched waits for the next pass, whose adjacency includes it
+            for (uint32_t i = 0; i < count; ++i) {
+                bool shared = false;
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t g = groups.ofVertex[triangles[triangleList[i] * 3 + k]];
+                    locked[g] = 1;
+                    shared |= g == collapse.to;
+                }
+                removed += shared;
+            }
+        }
+        if (removed == 0) {
+            break;
+        }
+
+        size_t kept = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            uint32_t corner[3], group[3];
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t v = triangles[t + k];
+                group[k] = remap[groups.ofVertex[v]];
+                corner[k] = group[k] == groups.ofVertex[v] ? v : matching_vertex(groups, vertices, group[k],
+                                                                                 vertices[v].normal);
+            }
+            if (group[0] == group[1] || group[1] == group[2] || group[0] == group[2]) {
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                triangles[kept++] = corner[k];
+            }
+        }
+        triangles.resize(kept);
+    }
+    error = (float)sqrt(worst);
+    return triangles;
+}
+
+MeshLodChain build_mesh_lods(const std::vector<Vertex>& vertices, MeshIndices& indices) {
+    MeshLodChain chain = mesh_lod_single((uint32_t)indices.size());
+    std::vector<uint32_t> full(indices.size());
+    for (size_t i = 0; i < full.size(); ++i) {
+        full[i] = indices[i];
+    }
+
+    size_t previous = full.size();
+    while (chain.count < MESH_LOD_MAX_LEVELS) {
+        // Every level is simplified from the full mesh, so its error is measured against it
+        const size_t target = previous / 6 * 3;
+        if (target / 3 < MESH_LOD_MIN_TRIANGLES) {
+            break;
+        }
+        float error = 0.0f;
+        std::vector<uint32_t> level = simplify_mesh(vertices, full.data(), full.size(), target, error);
+        if ((float)level.size() > MESH_LOD_MIN_REDUCTION * previous) {
+            break;
+        }
+        optimize_vertex_cache(level.data(), level.size(), vertices.size());
+
+        MeshLod& lod = chain.levels[chain.count];
+        lod.indexOffset = (uint32_t)indices.size();
+        lod.indexCount = (uint32_t)level.size();
+        lod.error = std::max(error, chain.levels[chain.count - 1].error);
+        chain.count++;
+        if (indices.format == IndexFormat::UInt16) {
+            indices.indices16.insert(indices.indices16.end(), level.begin(), level.end());
+        } else {
+            indices.indices32.insert(indices.indices32.end(), level.begin(), level.end());
+        }
+        previous = level.size();
+    }
+    return chain;
+}
+
+float mesh_lod_projection_scale(const simd::float4x4& viewProjection) {
+    const simd::float3 row = { viewProjection.columns[0].y, viewProjection.columns[1].y,
+                               viewProjection.columns[2].y };
+    return 0.5f * simd::length(row);
+}
+
+uint32_t mesh_lod_select(const MeshLodChain& chain, float projectedScale) {
+    uint32_t level = 0;
+    for (uint32_t i = 1; i < chain.count; ++i) {
+        if (chain.levels[i].error * projectedScale > MESH_LOD_SCREEN_ERROR) {
+            break;
+        }
+        level = i;
+    }
+    return level;
+}
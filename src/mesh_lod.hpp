@@ -0,0 +1,110 @@
+/**
+ * @file mesh_lod.hpp
+ * @brief Chains of coarser detail levels for a mesh, built by quadric error simplification.
+ *
+ * Every level indexes the same vertices, so a chain is one vertex buffer and one index buffer
+ * holding the full triangle list followed by each coarser list; a level is an index range. Levels
+ * are simplified from the full mesh to half the triangles of the one before, by collapsing edges
+ * in order of their quadric error (Garland and Heckbert), each vertex moving onto one of its
+ * neighbours so no vertex is added. Vertices sharing a position, such as both sides of a normal
+ * seam, move together, and open borders carry extra quadrics so their outline holds.
+ *
+ * Each level records the quadric error of its worst collapse as a distance in model units: the
+ * root mean square distance, weighted by area, from the merged vertex to the planes it stood on. At
+ * runtime mesh_lod_select() picks the coarsest level whose error, projected at the entity's
+ * distance, stays under MESH_LOD_SCREEN_ERROR of the view height.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "objects.hpp"
+
+/// Most levels a chain holds, the full mesh included.
+constexpr uint32_t MESH_LOD_MAX_LEVELS = 4;
+/// A level is not built below this many triangles.
+constexpr size_t MESH_LOD_MIN_TRIANGLES = 8;
+/// A level keeping more than this share of the previous level's triangles ends the chain.
+constexpr float MESH_LOD_MIN_REDUCTION = 0.75f;
+/// Largest projected error of a level, as a fraction of the view height; about a pixel at 1080p.
+constexpr float MESH_LOD_SCREEN_ERROR = 1.0f / 1080.0f;
+
+/**
+ * @struct MeshLod
+ * @brief One detail level: a range of the mesh's index buffer.
+ */
+struct MeshLod {
+    uint32_t indexOffset = 0;   ///< First index of the level.
+    uint32_t indexCount = 0;    ///< Indices in the level.
+    float error = 0.0f;         ///< Distance from the full surface in model units; 0 for the full mesh.
+};
+
+/**
+ * @struct MeshLodChain
+ * @brief The detail levels of a mesh, finest first.
+ */
+struct MeshLodChain {
+    MeshLod levels[MESH_LOD_MAX_LEVELS];    ///< Levels in order of increasing error.
+    uint32_t count = 0;                     ///< Levels in use; 1 for a mesh without coarser ones.
+};
+
+/// @return A chain with the full mesh as its only level.
+inline MeshLodChain mesh_lod_single(uint32_t indexCount) {
+    MeshLodChain chain;
+    chain.levels[0].indexCount = indexCount;
+    chain.count = 1;
+    return chain;
+}
+
+/**
+ * @brief Simplifies a triangle list by collapsing edges until it is at most a target size.
+ *
+ * Collapses that would flip a triangle are skipped, so the result can stay above the target
+ * when nothing more can be removed safely.
+ *
+ * @param vertices The vertices the indices refer to.
+ * @param indices The triangle list.
+ * @param indexCount Number of indices.
+ * @param targetIndexCount Number of indices to stop at.
+ * @param error Receives the quadric error of the worst collapse, as a distance in model units.
+ * @return The simplified triangle list, indexing the same vertices.
+ */
+std::vector<uint32_t> simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices,
+                                    size_t indexCount, size_t targetIndexCount, float& error);
+
+/**
+ * @brief Builds the detail levels of a mesh and appends them to its index list.
+ *
+ * The existing indices become level 0. Each coarser level is reordered with
+ * optimize_vertex_cache() before it is appended. The chain ends at MESH_LOD_MAX_LEVELS, below
+ * MESH_LOD_MIN_TRIANGLES, or when a level removes less than MESH_LOD_MIN_REDUCTION asks.
+ *
+ * @param vertices The mesh vertices.
+ * @param indices The mesh indices; the levels are appended in the same width.
+ * @return The chain.
+ */
+MeshLodChain build_mesh_lods(const std::vector<Vertex>& vertices, MeshIndices& indices);
+
+/**
+ * @brief Returns how large a model unit at view depth 1 appears, as a fraction of the view height.
+ *
+ * Read from the projection's y scale, which is the length of the second row of a
+ * view-projection matrix whose view part is rigid.
+ *
+ * @param viewProjection World to clip transform.
+ * @return Half the projection's y scale.
+ */
+float mesh_lod_projection_scale(const simd::float4x4& viewProjection);
+
+/**
+ * @brief Picks the coarsest level whose error stays under MESH_LOD_SCREEN_ERROR.
+ * @param chain The mesh's levels.
+ * @param projectedScale View height fractions per model unit at the entity: the model's scale
+ *        times mesh_lod_projection_scale() over the distance.
+ * @return The level index.
+ */
+uint32_t mesh_lod_select(const MeshLodChain& chain, float projectedScale);
@@ -0,0 +1,121 @@
+/**
+ * @file mesh_registry.hpp
+ * @brief Keeps a single GPU copy of each unique mesh; scene entities refer to them by index.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry_pool.hpp"
+#include "mesh_lod.hpp"
+#include "objects.hpp"
+#include "primitives.hpp"
+#include "resource_uploader.hpp"
+
+/**
+ * @struct GpuMesh
+ * @brief Vertex and index buffers of a mesh uploaded to the GPU.
+ *
+ * Meshes loaded from a cooked file also carry their meshlets for meshlet_draw.hpp, and their
+ * coarser detail levels after the full triangle list in indexBuffer (see MeshRegistry::lods).
+ * The vertex and index buffers are those of a MeshRegistry::geometry block shared with other
+ * meshes, so every draw selects the mesh with baseVertex and firstIndex.
+ */
+struct GpuMesh {
+    id<MTLBuffer> vertexBuffer; ///< Vertex data in the `Vertex` layout.
+    id<MTLBuffer> indexBuffer;  ///< Triangle list indices of every detail level.
+    uint32_t indexCount = 0;    ///< Number of indices of the full mesh, from firstIndex on.
+    uint32_t firstIndex = 0;    ///< First index of the mesh in indexBuffer; detail levels count from it.
+    uint32_t baseVertex = 0;    ///< First vertex of the mesh in vertexBuffer; added to every index.
+    GeometryAllocation geometry; ///< The pool ranges holding the mesh; block is NO_RANGE for buffers of its own.
+    MTLIndexType indexType = MTLIndexTypeUInt32; ///< Width of the indices in indexBuffer.
+    BoundingBox bounds;         ///< Model space bounds of the vertices.
+    id<MTLBuffer> meshletData;  ///< Meshlets, then the meshlet vertex and triangle lists; nil without meshlets.
+    uint32_t meshletCount = 0;  ///< Meshlets at the start of meshletData.
+    uint32_t meshletVertexOffset = 0;   ///< Byte offset of the meshlet vertex list in meshletData.
+    uint32_t meshletTriangleOffset = 0; ///< Byte offset of the meshlet triangle list in meshletData.
+};
+
+/// @return The Metal index type matching an IndexFormat.
+inline MTLIndexType metal_index_type(IndexFormat format) {
+    return format == IndexFormat::UInt16 ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32;
+}
+
+/// @return The size in bytes of one index of a Metal index type.
+inline size_t metal_index_size(MTLIndexType type) {
+    return type == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/**
+ * @brief Returns the byte offset of an index of a mesh in its index buffer.
+ * @param mesh The mesh.
+ * @param index Index position counted from the mesh's first index, e.g. a detail level's offset.
+ * @return The offset to draw from.
+ */
+inline size_t gpu_mesh_index_offset(const GpuMesh& mesh, uint32_t index = 0) {
+    return (size_t)(mesh.firstIndex + index) * metal_index_size(mesh.indexType);
+}
+
+/**
+ * @struct MeshRegistry
+ * @brief Maps mesh names to GPU meshes so each mesh is built and uploaded once.
+ */
+struct MeshRegistry {
+    std::unordered_map<std::string, uint32_t> lookup; ///< Mesh name to index into meshes.
+    std::vector<GpuMesh> meshes;                      ///< All registered meshes.
+    std::vector<MeshLodChain> lods;                   ///< Detail levels of each mesh, by the same index.
+    GeometryPool geometry;                            ///< Holds the vertices and indices of every mesh.
+    /// Mesh index of each Primitive; UINT32_MAX until mesh_registry_add_primitives().
+    uint32_t primitives[PRIMITIVE_COUNT] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+};
+
+/// @return The index of a primitive's mesh; mesh_registry_add_primitives() must have run.
+inline uint32_t mesh_registry_primitive(const MeshRegistry& registry, Primitive primitive) {
+    return registry.primitives[(uint32_t)primitive];
+}
+
+/**
+ * @brief Uploads the primitive library once and registers each primitive under its primitive_name().
+ *
+ * The primitives take one allocation of the geometry pool together. Later calls do nothing.
+ *
+ * @param registry The mesh registry; none of the primitive names may be taken.
+ * @param uploader Uploads the geometry into the geometry pool; flush it before drawing.
+ */
+void mesh_registry_add_primitives(MeshRegistry& registry, ResourceUploader& uploader);
+
+/**
+ * @brief Returns the mesh registered under a name, building and uploading it on first use.
+ *
+ * Indices are reordered with optimize_vertex_cache() before the upload.
+ *
+ * @param registry The mesh registry.
+ * @param uploader Uploads the geometry into the geometry pool; flush it before drawing.
+ * @param name The unique name of the mesh.
+ * @param build Function that builds the mesh geometry; only called if the name is new.
+ * @return The index of the mesh in the registry.
+ */
+uint32_t mesh_registry_get_or_create(MeshRegistry& registry, ResourceUploader& uploader,
+                                     const std::string& name, MeshData (*build)());
+
+/**
+ * @brief Returns the mesh registered under a name, loading it from a cooked mesh file on first use.
+ *
+ * The file (see mesh_asset.hpp) is mapped and its vertex, index and meshlet sections are
+ * uploaded as they lie, detail levels included, so loading does no parsing or index
+ * optimization. If the file is missing or was cooked for another format version, the mesh is
+ * built with the fallback instead.
+ *
+ * @param registry The mesh registry.
+ * @param uploader Uploads the geometry into the geometry pool; flush it before drawing.
+ * @param name The unique name of the mesh.
+ * @param path The cooked mesh file.
+ * @param fallback Builds the mesh when the file cannot be used.
+ * @return The index of the mesh in the registry.
+ */
+uint32_t mesh_registry_get_or_load(MeshRegistry& registry, ResourceUploader& uploader, const std::string& name,
+                                   const std::string& path, MeshData (*fallback)());
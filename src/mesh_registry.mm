@@ -0,0 +1,118 @@
+#import "mesh_registry.hpp"
+
+#include "mesh_asset.hpp"
+#include "vertex_cache.hpp"
+
+namespace {
+    // Places a mesh in the registry's geometry pool, or in buffers of its own if the pool cannot grow
+    void place_geometry(MeshRegistry& registry, ResourceUploader& uploader, GpuMesh& mesh, const Vertex* vertices,
+                        uint32_t vertexCount, const void* indices, size_t indexBytes, IndexFormat format,
+                        NSString* label) {
+        mesh.indexType = metal_index_type(format);
+        mesh.geometry = registry.geometry.allocate(uploader, vertices, vertexCount, indices, indexBytes);
+        if (mesh.geometry.block == NO_RANGE) {
+            mesh.vertexBuffer = uploader.upload(vertices, vertexCount * sizeof(Vertex), label);
+            mesh.indexBuffer = uploader.upload(indices, indexBytes, label);
+            return;
+        }
+        mesh.vertexBuffer = registry.geometry.vertex_buffer(mesh.geometry.block);
+        mesh.indexBuffer = registry.geometry.index_buffer(mesh.geometry.block);
+        mesh.baseVertex = mesh.geometry.baseVertex;
+        mesh.firstIndex = mesh.geometry.indexOffset / (uint32_t)index_stride(format);
+    }
+}
+
+uint32_t mesh_registry_get_or_create(MeshRegistry& registry, ResourceUploader& uploader,
+                                     const std::string& name, MeshData (*build)()) {
+    auto it = registry.lookup.find(name);
+    if (it != registry.lookup.end()) {
+        return it->second;
+    }
+
+    MeshData source = build();
+    optimize_vertex_cache(source.indices, source.vertices.size());
+
+    GpuMesh mesh;
+    NSString* label = [NSString stringWithUTF8String:name.c_str()];
+    place_geometry(registry, uploader, mesh, source.vertices.data(), (uint32_t)source.vertices.size(),
+                   source.indices.data(), source.indices.byte_size(), source.indices.format, label);
+    mesh.indexCount = (uint32_t)source.indices.size();
+    mesh.bounds = source.bounds;
+
+    uint32_t index = (uint32_t)registry.meshes.size();
+    registry.meshes.push_back(mesh);
+    registry.lods.push_back(mesh_lod_single(mesh.indexCount));
+    registry.lookup.emplace(name, index);
+    return index;
+}
+
+uint32_t mesh_registry_get_or_load(MeshRegistry& registry, ResourceUploader& uploader, const std::string& name,
+                                   const std::string& path, MeshData (*fallback)()) {
+    auto it = registry.lookup.find(name);
+    if (it != registry.lookup.end()) {
+        return it->second;
+    }
+
+    MeshAsset asset;
+    if (!map_mesh_asset(path, asset)) {
+        NSLog(@"No usable cooked mesh at %s; building %s instead", path.c_str(), name.c_str());
+        return mesh_registry_get_or_create(registry, uploader, name, fallback);
+    }
+
+    // The uploader copies out of the mapping, so it can be released right away
+    const MeshAssetHeader& header = asset.header;
+    const IndexFormat indexFormat = (IndexFormat)header.indexFormat;
+    GpuMesh mesh;
+    NSString* label = [NSString stringWithUTF8String:name.c_str()];
+    place_geometry(registry, uploader, mesh, asset.vertices, header.vertexCount, asset.indices,
+                   header.indexCount * index_stride(indexFormat), indexFormat, label);
+    mesh.indexCount = header.lods[0].indexCount;
+    mesh.bounds = { { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] },
+                    { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] } };
+    if (header.meshletCount > 0) {
+        // The three meshlet sections are the tail of the file; one buffer keeps their relative offsets
+        mesh.meshletData = uploader.upload(asset.meshlets, header.fileSize - header.meshletOffset, label);
+        mesh.meshletCount = header.meshletCount;
+        mesh.meshletVertexOffset = (uint32_t)(header.meshletVertexOffset - header.meshletOffset);
+        mesh.meshletTriangleOffset = (uint32_t)(header.meshletTriangleOffset - header.meshletOffset);
+    }
+    MeshLodChain lods;
+    lods.count = header.lodCount;
+    for (uint32_t i = 0; i < header.lodCount; ++i) {
+        lods.levels[i] = header.lods[i];
+    }
+    unmap_mesh_asset(asset);
+
+    uint32_t index = (uint32_t)registry.meshes.size();
+    registry.meshes.push_back(mesh);
+    registry.lods.push_back(lods);
+    registry.lookup.emplace(name, index);
+    return index;
+}
+
+void mesh_registry_add_primitives(MeshRegistry& registry, ResourceUploader& uploader) {
+    if (registry.primitives[0] != UINT32_MAX) {
+        return;
+    }
+
+    // One allocation for all of them, which every primitive names
+    const PrimitiveLibrary library = build_primitive_library();
+    GpuMesh shared;
+    place_geometry(registry, uploader, shared, library.mesh.vertices.data(), (uint32_t)library.mesh.vertices.size(),
+                   library.mesh.indices.data(), library.mesh.indices.byte_size(), library.mesh.indices.format,
+                   @"Primitives");
+    for (uint32_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        const PrimitiveRange& range = library.ranges[i];
+        GpuMesh mesh = shared;
+        mesh.indexCount = range.indexCount;
+        mesh.firstIndex += range.firstIndex;
+        mesh.baseVertex += range.baseVertex;
+        mesh.bounds = range.bounds;
+
+        const uint32_t index = (uint32_t)registry.meshes.size();
+        registry.meshes.push_back(mesh);
+        registry.lods.push_back(mesh_lod_single(mesh.indexCount));
+        registry.lookup.emplace(primitive_name((Primitive)i), index);
+        registry.primitives[i] = index;
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file meshlet_draw.hpp
+ * @brief Draws cooked meshes meshlet by meshlet with Metal object and mesh shaders.
+ *
+ * The object stage (`meshlet_object` in shaders.metal) runs one thread per meshlet and
+ * instance. It drops meshlets whose bounding sphere is outside the frustum or whose normal
+ * cone faces away from the camera (see meshlet_backfacing()), and launches a mesh
+ * threadgroup (`meshlet_mesh`) for each survivor. The mesh stage reads the meshlet's vertex
+ * and triangle lists straight from the sections mesh_asset.hpp wrote.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "frustum.hpp"
+#include "mesh_asset.hpp"
+
+struct GpuMesh;
+
+/**
+ * @struct MeshletUniforms
+ * @brief Per-draw constants of the meshlet stages; matches `MeshletUniforms` in shaders.metal.
+ *
+ * Bound where an instanced draw binds its Uniforms (slot 1).
+ */
+struct MeshletUniforms {
+    simd::float4x4 viewProjection;      ///< World to clip transform.
+    simd::float4 frustumPlanes[6];      ///< World space, inward facing; see Frustum.
+    simd::float3 cameraPosition;        ///< World space; moved into model space per instance for the cone test.
+    uint32_t meshletCount = 0;          ///< Meshlets in the mesh.
+    uint32_t instanceCount = 0;         ///< Instances drawn.
+    uint32_t vertexListOffset = 0;      ///< Byte offset of the meshlet vertex list in GpuMesh::meshletData.
+    uint32_t triangleListOffset = 0;    ///< Byte offset of the meshlet triangle list in GpuMesh::meshletData.
+    uint32_t baseVertex = 0;            ///< GpuMesh::baseVertex, added to the meshlet vertex list.
+};
+
+/// @return True if the device can run object and mesh shaders.
+bool meshlet_draw_supported(id<MTLDevice> device);
+
+/**
+ * @brief Fills the uniforms of a meshlet draw.
+ * @param viewProjection The camera's projection * view matrix.
+ * @param frustum The view frustum of viewProjection.
+ * @param cameraPosition The camera position in world space.
+ * @param mesh The mesh; must have meshlets.
+ * @param instanceCount Instances drawn.
+ * @return The uniforms.
+ */
+MeshletUniforms make_meshlet_uniforms(const simd::float4x4& viewProjection, const Frustum& frustum,
+                                      simd::float3 cameraPosition, const GpuMesh& mesh, uint32_t instanceCount);
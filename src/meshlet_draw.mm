@@ -0,0 +1,26 @@
+#import "meshlet_draw.hpp"
+
+#import "mesh_registry.hpp"
+
+bool meshlet_draw_supported(id<MTLDevice> device) {
+    if (@available(macOS 13.0, *)) {
+        return [device supportsFamily:MTLGPUFamilyMetal3];
+    }
+    return false;
+}
+
+MeshletUniforms make_meshlet_uniforms(const simd::float4x4& viewProjection, const Frustum& frustum,
+                                      simd::float3 cameraPosition, const GpuMesh& mesh, uint32_t instanceCount) {
+    MeshletUniforms uniforms;
+    uniforms.viewProjection = viewProjection;
+    for (int i = 0; i < 6; ++i) {
+        uniforms.frustumPlanes[i] = frustum.planes[i];
+    }
+    uniforms.cameraPosition = cameraPosition;
+    uniforms.meshletCount = mesh.meshletCount;
+    uniforms.instanceCount = instanceCount;
+    uniforms.vertexListOffset = mesh.meshletVertexOffset;
+    uniforms.triangleListOffset = mesh.meshletTriangleOffset;
+    uniforms.baseVertex = mesh.baseVertex;
+    return uniforms;
+}
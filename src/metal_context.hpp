@@ -1,12 +1,247 @@
 #pragma once
 #import <Metal/Metal.h>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "objects.hpp"
+#include "pipeline_requests.hpp"
+#include "shader_variant.hpp"
+
+class PipelineCache;
+
+/// Variants metal_request_pipeline() compiled, handed from the completion blocks to the context's thread.
+using MetalPipelineRequests = PipelineRequests<id<MTLRenderPipelineState>>;
+
 struct MetalContext {
     id<MTLDevice> device;               ///< The Metal device.
     id<MTLCommandQueue> queue;          ///< The Metal command queue.
+    id<MTLCommandQueue> computeQueue;   ///< Compute that may overlap the queue's rendering; see gpu_render_graph.hpp.
+    id<MTLLibrary> library;             ///< The library loaded from shaders.metallib.
+    std::unordered_map<std::string, id<MTLLibrary>> featureLibraries; ///< metal_feature_library() loads, by name.
     id<MTLRenderPipelineState> pipeline; ///< Default render pipeline for general objects.
     id<MTLRenderPipelineState> landscape_pipeline; ///< Render pipeline specifically for the landscape.
+    id<MTLRenderPipelineState> landscape_packed_pipeline; ///< Landscape pipeline reading PackedVertex meshes.
+    id<MTLRenderPipelineState> instanced_pipeline; ///< Render pipeline for instanced meshes.
+    id<MTLRenderPipelineState> composite_pipeline; ///< Copies the finished scene into the drawable under the UI overlay.
+    id<MTLRenderPipelineState> water_pipeline; ///< Water surface accumulated into the transparent pass.
+    id<MTLRenderPipelineState> oit_composite_pipeline; ///< Resolves the transparent pass over the scene colour.
+    id<MTLRenderPipelineState> particle_pipeline; ///< Sorted particle billboards over the composited transparent pass.
+    id<MTLRenderPipelineState> ambient_occlusion_apply_pipeline; ///< Upsamples ambient occlusion into the scene colour.
+    id<MTLRenderPipelineState> debug_draw_pipeline; ///< Debug wireframes over the frame's output colour.
+    id<MTLRenderPipelineState> picking_pipeline; ///< Entity IDs around the cursor, for selection.
+    id<MTLRenderPipelineState> rate_map_resolve_pipeline; ///< Stretches a rate-mapped scene back to the screen.
+    id<MTLRenderPipelineState> sky_pipeline; ///< Sky behind a single-sample forward scene pass; see metal_sky_pipeline().
+    id<MTLRenderPipelineState> shadow_landscape_pipeline; ///< Depth-only landscape chunks for the shadow map.
+    id<MTLRenderPipelineState> shadow_landscape_packed_pipeline; ///< Depth-only landscape chunks in PackedVertex format.
+    id<MTLRenderPipelineState> shadow_landscape_heightmap_pipeline; ///< Depth-only landscape chunks drawn from height maps.
+    id<MTLRenderPipelineState> shadow_instanced_pipeline; ///< Depth-only instanced meshes for the shadow map.
+    id<MTLRenderPipelineState> impostor_bake_pipeline; ///< Renders foliage into the frames of the impostor atlas.
+    id<MTLComputePipelineState> terrain_gen_pipeline; ///< Compute pipeline generating terrain chunk vertices.
+    id<MTLComputePipelineState> terrain_gen_packed_pipeline; ///< Terrain generation writing PackedVertex output.
+    id<MTLComputePipelineState> cull_chunks_pipeline; ///< Frustum and Hi-Z culling into an indirect command buffer.
+    id<MTLComputePipelineState> hiz_copy_pipeline;    ///< Copies the depth buffer into Hi-Z mip 0.
+    id<MTLComputePipelineState> hiz_reduce_pipeline;  ///< Builds one Hi-Z mip from the one above.
+    id<MTLComputePipelineState> motion_vectors_pipeline; ///< Camera motion vectors for temporal upscaling.
+    id<MTLComputePipelineState> temporal_aa_pipeline;    ///< Blends jittered frames into the TAA history.
+    id<MTLComputePipelineState> scatter_foliage_pipeline; ///< Places a chunk's trees and rocks.
+    id<MTLComputePipelineState> select_foliage_pipeline;  ///< Culls foliage and picks its LODs into instances.
+    id<MTLComputePipelineState> finish_foliage_pipeline;  ///< Clamps the foliage instance count for the draw.
+    id<MTLComputePipelineState> skin_vertices_pipeline;   ///< Poses skinned mesh instances for every pass drawing them.
+    id<MTLComputePipelineState> tessellation_factors_pipeline; ///< Per-patch factors of tessellated terrain chunks.
+    id<MTLComputePipelineState> bake_materials_pipeline; ///< Bakes a chunk's albedo into the material atlas.
+    id<MTLComputePipelineState> bake_materials_packed_pipeline; ///< Material baking reading PackedVertex chunks.
+    id<MTLComputePipelineState> bake_horizons_pipeline; ///< Bakes a chunk's horizon angles into the horizon atlas.
+    id<MTLComputePipelineState> prefilter_probe_pipeline; ///< Convolves a reflection probe capture into a roughness mip.
+    id<MTLComputePipelineState> atmosphere_transmittance_pipeline; ///< Fills the atmosphere's transmittance lookup.
+    id<MTLComputePipelineState> atmosphere_multiscattering_pipeline; ///< Fills the multiple scattering lookup.
+    id<MTLComputePipelineState> atmosphere_sky_view_pipeline; ///< Fills the sky view lookup for the current sun.
+    id<MTLComputePipelineState> cluster_lights_pipeline; ///< Bins the frame's point lights into the cluster grid.
+    id<MTLComputePipelineState> ambient_occlusion_pipeline; ///< Half-resolution ambient occlusion from the scene depth.
+    id<MTLComputePipelineState> ray_traced_occlusion_pipeline; ///< Ambient occlusion traced against acceleration structures; nil if unsupported.
+    id<MTLComputePipelineState> ocean_spectrum_pipeline; ///< Ocean waves in time; from metal_ocean_pipelines().
+    id<MTLComputePipelineState> ocean_fft_pipeline;      ///< One inverse FFT line of the ocean per threadgroup.
+    id<MTLComputePipelineState> ocean_resolve_pipeline;  ///< Ocean displacement, normals and foam from the FFT output.
+    id<MTLComputePipelineState> erosion_flux_pipeline;      ///< Terrain erosion pipes; from metal_erosion_pipelines().
+    id<MTLComputePipelineState> erosion_water_pipeline;     ///< Terrain erosion water depth and flow velocity.
+    id<MTLComputePipelineState> erosion_sediment_pipeline;  ///< Terrain erosion dissolving and deposition.
+    id<MTLComputePipelineState> erosion_transport_pipeline; ///< Terrain erosion sediment advection and evaporation.
+    id<MTLComputePipelineState> erosion_thermal_pipeline;   ///< Terrain erosion slides down steep slopes.
+    id<MTLComputePipelineState> particles_emit_pipeline;        ///< Particle emission; from metal_particle_pipelines().
+    id<MTLComputePipelineState> particles_prepare_pipeline;     ///< Sizes the particle simulation to the alive count.
+    id<MTLComputePipelineState> particles_simulate_pipeline;    ///< Steps and compacts the alive particles.
+    id<MTLComputePipelineState> particles_prepare_sort_pipeline; ///< Sizes the particle sort and draw to the survivors.
+    id<MTLComputePipelineState> particles_pad_pipeline;         ///< Pads the particle keys to a power of two.
+    id<MTLComputePipelineState> particles_sort_pipeline;        ///< One bitonic pass over the particle keys.
+    id<MTLComputePipelineState> terrain_brush_pipeline; ///< Terrain brushes; from metal_terrain_brush_pipelines().
+    id<MTLComputePipelineState> update_terrain_clipmap_pipeline; ///< Refreshes strips of the terrain clipmap's heights.
+    id<MTLComputePipelineState> noise_pipeline;  ///< Evaluates fractal noise at given points, to check it against the CPU.
+    id<MTLBuffer> materials;            ///< MaterialParams table indexed by SceneMaterial.
+    id<MTLDepthStencilState> depth_equal_state; ///< Created by metal_depth_equal_state() on first use.
+    bool bindless = false;              ///< True if SceneArguments can be used on this device.
+    std::unordered_map<uint32_t, id<MTLRenderPipelineState>> variants; ///< Render pipelines by shader_variant_key().
+    std::unordered_map<uint32_t, id<MTLRenderPipelineState>> sky_variants; ///< Sky pipelines by sample count and pass.
+    std::shared_ptr<PipelineCache> pipelineCache; ///< Compiles variants requested after startup.
+    std::unordered_set<uint32_t> pendingVariants; ///< Keys of variants metal_request_pipeline() is compiling.
+    std::shared_ptr<MetalPipelineRequests> pipelineRequests; ///< Requested variants that finished, until collected.
 };
 
+/// @return A vertex descriptor reading buffer 0 in the given layout as attributes 0 (position) and 1 (normal).
+MTLVertexDescriptor* make_vertex_descriptor(VertexFormat format);
+
+/**
+ * @brief Returns the render pipeline of a shader variant, compiling it on first use.
+ *
+ * The pipelines stored in MetalContext's fields are the default variants and are
+ * compiled by create_metal_context(); other variants block the caller while they compile.
+ *
+ * @param ctx The Metal context.
+ * @param variant The variant to look up.
+ * @return The pipeline state, or nil if it failed to compile.
+ */
+id<MTLRenderPipelineState> metal_pipeline(MetalContext& ctx, const ShaderVariant& variant);
+
+/**
+ * @brief Returns the render pipeline of a shader variant without waiting for it to compile.
+ *
+ * The first call for a variant ctx does not have starts compiling it on a Metal thread through
+ * the pipeline cache, which takes its binary from the archive if it is there, and returns nil.
+ * Later calls return nil until the compile has finished, then the pipeline, which joins
+ * ctx.variants as if metal_pipeline() had built it. The variant key covers everything the
+ * pipeline is built from: the vertex layout, the function constants and the sample count,
+ * and through deferred and sampleCount the attachments of the pass it is drawn in. Once no
+ * request is left compiling, new binaries are written to the archive.
+ *
+ * @param ctx The Metal context; call from the thread that owns it.
+ * @param variant The variant to look up.
+ * @return The pipeline state, or nil while it compiles or if it failed to.
+ */
+id<MTLRenderPipelineState> metal_request_pipeline(MetalContext& ctx, const ShaderVariant& variant);
+
+/// @return True while a variant metal_request_pipeline() started is still compiling.
+bool metal_pipeline_pending(const MetalContext& ctx, const ShaderVariant& variant);
+
+/**
+ * @brief Returns the pipeline of a variant, or its placeholder where the variant is not there.
+ *
+ * Without wait, a variant that has not compiled yet is requested with metal_request_pipeline()
+ * and its shader_variant_placeholder() draws meanwhile; with wait it compiles first. Either way
+ * a variant that failed to compile draws with the placeholder from then on, instead of not at
+ * all. Placeholders are shared by every variant of a pass, so only the first one a pass needs
+ * is compiled on the spot.
+ *
+ * @param ctx The Metal context.
+ * @param variant The variant to look up.
+ * @param wait Compile the variant before returning, e.g. for a benchmark that must draw it.
+ * @return The pipeline state, or nil only if the placeholder failed to compile as well.
+ */
+id<MTLRenderPipelineState> metal_pipeline_or_placeholder(MetalContext& ctx, const ShaderVariant& variant, bool wait);
+
+/**
+ * @brief Returns the sky pipeline for a scene pass, compiling it on first use.
+ * @param ctx The Metal context.
+ * @param sampleCount Raster samples per pixel of the pass.
+ * @param deferred True for the deferred pass, whose G-buffer attachments the sky leaves alone.
+ * @return The pipeline state, or nil if it failed to compile.
+ */
+id<MTLRenderPipelineState> metal_sky_pipeline(MetalContext& ctx, uint32_t sampleCount, bool deferred);
+
+/**
+ * @brief Returns the depth state of surfaces shaded after a depth pre-pass, creating it on first use.
+ *
+ * It passes only the fragments whose depth equals the one the pre-pass kept and writes nothing,
+ * which works for standard and reverse-Z alike.
+ *
+ * @param ctx The Metal context; keeps the state.
+ * @return The depth stencil state.
+ */
+id<MTLDepthStencilState> metal_depth_equal_state(MetalContext& ctx);
+
+/**
+ * @brief Loads a feature's shader library the first time it is asked for.
+ *
+ * Kernels that only some features run are built into libraries of their own rather than into
+ * shaders.metallib, e.g. ocean.metallib from src/ocean.metal, so startup neither loads nor
+ * compiles them. A library missing next to the executable is compiled from the source tree,
+ * as create_metal_context() does. Later calls return the same library, or nil again.
+ *
+ * @param ctx The Metal context; keeps the library.
+ * @param name The library's name without extension.
+ * @return The library, or nil if it could neither be loaded nor compiled.
+ */
+id<MTLLibrary> metal_feature_library(MetalContext& ctx, const char* name);
+
+/**
+ * @brief Compiles the ocean pipelines from ocean.metallib on first call, blocking until they are done.
+ * @param ctx The Metal context; receives ocean_spectrum_pipeline, ocean_fft_pipeline and ocean_resolve_pipeline.
+ * @return True if all three compiled.
+ */
+bool metal_ocean_pipelines(MetalContext& ctx);
+
+/**
+ * @brief Compiles the terrain erosion pipelines from erosion.metallib on first call, blocking until they are done.
+ * @param ctx The Metal context; receives the five erosion_*_pipeline states.
+ * @return True if all five compiled.
+ */
+bool metal_erosion_pipelines(MetalContext& ctx);
+
+/**
+ * @brief Compiles the particle kernels from particles.metallib on first call, blocking until they are done.
+ * @param ctx The Metal context; receives the six particles_*_pipeline states.
+ * @return True if all six compiled.
+ */
+bool metal_particle_pipelines(MetalContext& ctx);
+
+/**
+ * @brief Compiles the terrain brush kernel from terrain_brush.metallib on first call, blocking until it is done.
+ * @param ctx The Metal context; receives terrain_brush_pipeline.
+ * @return True if it compiled.
+ */
+bool metal_terrain_brush_pipelines(MetalContext& ctx);
+
+/// @return The options shaders.metal is compiled with at build time, for compiling it at runtime.
+MTLCompileOptions* metal_compile_options();
+
+/**
+ * @brief Reads a shader source for newLibraryWithSource:, with its local includes inlined.
+ *
+ * The runtime compiler has no search path, so every `#include "name"` line is replaced by
+ * the file of that name next to the source, e.g. noise_shared.hpp into shaders.metal. Each
+ * file is inlined once, as its `#pragma once` would have it.
+ *
+ * @param path The source file.
+ * @param error Receives the reason if the source or one of its includes could not be read.
+ * @return The source, or nil.
+ */
+NSString* metal_read_shader_source(NSString* path, NSError** error);
+
+/// @return The path of shaders.metal in the source tree if this build knows it and it exists, else nil.
+NSString* metal_shader_source_path();
+
+/**
+ * @brief Compiles every pipeline of a context again from another library.
+ *
+ * Blocks until all of them are compiled; meant to run off the render thread. The result
+ * shares ctx's device, queue, materials and feature libraries, with their pipelines, and gets
+ * a pipeline cache of its own without an archive.
+ *
+ * @param ctx The context whose pipelines are rebuilt; only read.
+ * @param library The library to compile from, e.g. one built from edited sources.
+ * @param variantKeys Keys of further variants to compile, e.g. those ctx compiled on demand.
+ * @param rebuilt Receives the new context.
+ * @return False if a pipeline ctx has, or one of variantKeys, failed to compile.
+ */
+bool metal_context_rebuild(const MetalContext& ctx, id<MTLLibrary> library, const std::vector<uint32_t>& variantKeys,
+                           MetalContext& rebuilt);
 
+/**
+ * @brief Creates the device, queue and all pipelines from shaders.metallib next to the executable.
+ *
+ * If the library is missing and metal_shader_source_path() is known, shaders.metal is compiled
+ * instead. If there is still no library the error is logged and the context comes back with a
+ * nil library and no pipelines, for the caller to exit on.
+ */
 MetalContext create_metal_context();
\ No newline at end of file
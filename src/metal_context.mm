@@ -1,62 +1,939 @@
 #import "metal_context.hpp"
-#import "objects.hpp"
 
-MetalContext create_metal_context() {
-    MetalContext ctx{};
-    ctx.device = MTLCreateSystemDefaultDevice();
-    ctx.queue = [ctx.device newCommandQueue];
+#include <vector>
 
-    NSError *error = nil;
+#import "deferred.hpp"
+#import "gpu_impostors.hpp"
+#import "meshlet_draw.hpp"
+#import "msaa.hpp"
+#import "multi_view_target.hpp"
+#import "pipeline_cache.hpp"
+#import "scene_arguments.hpp"
+#import "trace.hpp"
+#import "transparency.hpp"
+
+namespace {
+    // Specializes a function on the packed_vertices constant in shaders.metal
+    id<MTLFunction> make_vertex_format_function(id<MTLLibrary> lib, NSString* name, VertexFormat format) {
+        bool packed = format == VertexFormat::Packed;
+        MTLFunctionConstantValues* constants = [MTLFunctionConstantValues new];
+        [constants setConstantValue:&packed type:MTLDataTypeBool atIndex:0];
+
+        NSError* error = nil;
+        id<MTLFunction> fn = [lib newFunctionWithName:name constantValues:constants error:&error];
+        if (!fn) {
+            NSLog(@"Error specializing %@: %@", name, error);
+        }
+        return fn;
+    }
+}
+
+MTLVertexDescriptor* make_vertex_descriptor(VertexFormat format) {
+    MTLVertexDescriptor* vertexDesc = [MTLVertexDescriptor new];
+
+    if (format == VertexFormat::Packed) {
+        // Position: unorm16 xyzw inside the mesh's quantization box
+        vertexDesc.attributes[0].format = MTLVertexFormatUShort4Normalized;
+        vertexDesc.attributes[0].offset = offsetof(PackedVertex, position);
+        vertexDesc.attributes[0].bufferIndex = 0;
+
+        // Normal: octahedral snorm16 pair
+        vertexDesc.attributes[1].format = MTLVertexFormatShort2Normalized;
+        vertexDesc.attributes[1].offset = offsetof(PackedVertex, normal);
+        vertexDesc.attributes[1].bufferIndex = 0;
+    } else {
+        // Position
+        vertexDesc.attributes[0].format = MTLVertexFormatFloat3;
+        vertexDesc.attributes[0].offset = offsetof(Vertex, position);
+        vertexDesc.attributes[0].bufferIndex = 0;
+
+        // Normal
+        vertexDesc.attributes[1].format = MTLVertexFormatFloat3;
+        vertexDesc.attributes[1].offset = offsetof(Vertex, normal);
+        vertexDesc.attributes[1].bufferIndex = 0;
+    }
+
+    vertexDesc.layouts[0].stride = vertex_stride(format);
+    return vertexDesc;
+}
+
+namespace {
+    MTLFunctionConstantValues* make_variant_constants(const ShaderVariant& variant) {
+        bool packed = variant.vertexFormat == VertexFormat::Packed;
+        uint32_t lighting = (uint32_t)variant.lighting;
+        bool heightBands = variant.heightBands;
+        bool fog = variant.fog;
+        bool shadows = variant.shadows;
+        bool farFade = variant.farFade;
+        bool virtualTexture = variant.virtualTexture;
+        bool bakedMaterials = variant.bakedMaterials;
+        bool skyFog = variant.skyFog;
+        bool pointLights = variant.pointLights;
+        bool shadingCache = variant.shadingCache;
+        bool ambientOcclusion = variant.ambientOcclusion;
+        bool lodDissolve = variant.lodDissolve;
+        bool foliageWind = variant.foliageWind;
+        bool rayTracedShadows = variant.rayTracedShadows;
+        bool vertexLighting = variant.vertexLighting;
+        bool horizonShadows = variant.horizonShadows;
+        bool indexedInstances = variant.indexedInstances;
+
+        MTLFunctionConstantValues* constants = [MTLFunctionConstantValues new];
+        [constants setConstantValue:&packed type:MTLDataTypeBool atIndex:0];
+        [constants setConstantValue:&lighting type:MTLDataTypeUInt atIndex:1];
+        [constants setConstantValue:&heightBands type:MTLDataTypeBool atIndex:2];
+        [constants setConstantValue:&fog type:MTLDataTypeBool atIndex:3];
+        [constants setConstantValue:&shadows type:MTLDataTypeBool atIndex:4];
+        [constants setConstantValue:&farFade type:MTLDataTypeBool atIndex:5];
+        [constants setConstantValue:&virtualTexture type:MTLDataTypeBool atIndex:6];
+        [constants setConstantValue:&bakedMaterials type:MTLDataTypeBool atIndex:7];
+        [constants setConstantValue:&skyFog type:MTLDataTypeBool atIndex:8];
+        [constants setConstantValue:&pointLights type:MTLDataTypeBool atIndex:9];
+        [constants setConstantValue:&shadingCache type:MTLDataTypeBool atIndex:10];
+        [constants setConstantValue:&ambientOcclusion type:MTLDataTypeBool atIndex:11];
+        [constants setConstantValue:&lodDissolve type:MTLDataTypeBool atIndex:12];
+        [constants setConstantValue:&foliageWind type:MTLDataTypeBool atIndex:13];
+        [constants setConstantValue:&rayTracedShadows type:MTLDataTypeBool atIndex:14];
+        [constants setConstantValue:&vertexLighting type:MTLDataTypeBool atIndex:15];
+        [constants setConstantValue:&horizonShadows type:MTLDataTypeBool atIndex:16];
+        [constants setConstantValue:&indexedInstances type:MTLDataTypeBool atIndex:17];
+        return constants;
+    }
+
+    id<MTLFunction> make_variant_function(id<MTLLibrary> lib, NSString* name, const ShaderVariant& variant) {
+        NSError* error = nil;
+        id<MTLFunction> fn = [lib newFunctionWithName:name constantValues:make_variant_constants(variant) error:&error];
+        if (!fn) {
+            NSLog(@"Error specializing %@: %@", name, error);
+        }
+        return fn;
+    }
+
+    // Overdraw view: a fixed colour per shaded fragment, summed by the blender
+    id<MTLFunction> make_overdraw_fragment(id<MTLLibrary> lib, MTLRenderPipelineColorAttachmentDescriptor* color) {
+        color.blendingEnabled = YES;
+        color.sourceRGBBlendFactor = MTLBlendFactorOne;
+        color.destinationRGBBlendFactor = MTLBlendFactorOne;
+        color.sourceAlphaBlendFactor = MTLBlendFactorOne;
+        color.destinationAlphaBlendFactor = MTLBlendFactorOne;
+        return [lib newFunctionWithName:@"overdraw_fragment"];
+    }
+
+    MTLRenderPipelineDescriptor* make_variant_descriptor(id<MTLLibrary> lib, const ShaderVariant& variant) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.vertexDescriptor = make_vertex_descriptor(variant.vertexFormat);
+        desc.rasterSampleCount = variant.sampleCount;
+        if (variant.deferred) {
+            desc.colorAttachments[1].pixelFormat = GBUFFER_ALBEDO_FORMAT;
+            desc.colorAttachments[2].pixelFormat = GBUFFER_NORMAL_FORMAT;
+            desc.colorAttachments[3].pixelFormat = GBUFFER_DEPTH_FORMAT;
+        }
+
+        if (variant.multiView) {
+            // Amplified views pick their own slice and viewport, which needs the primitive class up front
+            desc.maxVertexAmplificationCount = multi_view_amplification(lib.device);
+            desc.inputPrimitiveTopology = MTLPrimitiveTopologyClassTriangle;
+        }
+
+        // Surfaces in the deferred pass write the G-buffer instead of a lit colour
+        const bool gbuffer = variant.deferred;
+        switch (variant.program) {
+        case ShaderProgram::Default:
+            desc.vertexFunction = make_variant_function(lib, @"vertex_main", variant);
+            desc.fragmentFunction = make_variant_function(lib, gbuffer ? @"gbuffer_fragment_main" : @"fragment_main", variant);
+            break;
+        case ShaderProgram::Instanced:
+            if (variant.multiView) {
+                desc.vertexFunction = make_variant_function(lib, @"vertex_instanced_multiview", variant);
+                desc.fragmentFunction = make_variant_function(lib, @"fragment_instanced_multiview", variant);
+                break;
+            }
+            desc.vertexFunction = make_variant_function(lib, @"vertex_instanced_main", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"gbuffer_instanced_fragment" : @"fragment_instanced_main", variant);
+            break;
+        case ShaderProgram::Landscape:
+            if (variant.multiView) {
+                desc.vertexFunction = make_variant_function(lib, @"landscape_vertex_multiview", variant);
+                desc.fragmentFunction = make_variant_function(lib, @"landscape_fragment_multiview", variant);
+                break;
+            }
+            desc.vertexFunction = make_variant_function(lib, @"landscape_vertex_main", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"landscape_gbuffer_fragment" : @"landscape_fragment_main", variant);
+            desc.supportIndirectCommandBuffers = YES; // Terrain chunks may be drawn by cull_terrain_chunks
+            break;
+        case ShaderProgram::LandscapeBindless:
+            // Vertices are fetched through DrawRecord pointers rather than a vertex descriptor
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"landscape_vertex_bindless", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"landscape_gbuffer_fragment" : @"landscape_fragment_main", variant);
+            break;
+        case ShaderProgram::DeferredLighting:
+            // A full-screen triangle generated from vertex_id
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"deferred_lighting_vertex", variant);
+            desc.fragmentFunction = make_variant_function(lib, @"deferred_lighting_fragment", variant);
+            break;
+        case ShaderProgram::LandscapeTessellated:
+            // Vertices come from the patch coordinates and the terrain noise, not a vertex buffer
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"terrain_tessellated_vertex", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"landscape_gbuffer_fragment" : @"landscape_fragment_main", variant);
+            desc.tessellationPartitionMode = MTLTessellationPartitionModeFractionalOdd;
+            desc.tessellationFactorStepFunction = MTLTessellationFactorStepFunctionPerPatch;
+            desc.tessellationFactorFormat = MTLTessellationFactorFormatHalf;
+            desc.maxTessellationFactor = 16;
+            break;
+        case ShaderProgram::LandscapeHeightMap:
+            // Grid positions come from the vertex ID, heights and normals from vertex texture fetches
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"landscape_vertex_heightmap", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"landscape_gbuffer_fragment" : @"landscape_fragment_main", variant);
+            break;
+        case ShaderProgram::LandscapeClipmap:
+            // Grid positions come from the vertex ID and the level instance, heights from the level's slice
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"landscape_vertex_clipmap", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"landscape_gbuffer_fragment" : @"landscape_fragment_main", variant);
+            break;
+        case ShaderProgram::FoliageImpostor:
+            // Quad corners come from the vertex ID, the quads from the impostor instances
+            desc.vertexDescriptor = nil;
+            desc.vertexFunction = make_variant_function(lib, @"impostor_vertex", variant);
+            desc.fragmentFunction = make_variant_function(
+                lib, gbuffer ? @"impostor_gbuffer_fragment" : @"impostor_fragment", variant);
+            break;
+        case ShaderProgram::InstancedMeshlets:
+            // Built by make_mesh_variant_descriptor instead
+            break;
+        }
+
+        if (variant.depthOnly) {
+            // The pass's attachments stay declared so the pipeline fits it, but only depth is written
+            desc.fragmentFunction = nil;
+            for (NSUInteger i = 0; i < (variant.deferred ? 4 : 1); ++i) {
+                desc.colorAttachments[i].writeMask = MTLColorWriteMaskNone;
+            }
+        } else if (variant.overdraw) {
+            desc.fragmentFunction = make_overdraw_fragment(lib, desc.colorAttachments[0]);
+        }
+        return desc;
+    }
+
+    // Object and mesh stages replace the vertex stage, so there is no vertex descriptor
+    MTLMeshRenderPipelineDescriptor* make_mesh_variant_descriptor(id<MTLLibrary> lib, const ShaderVariant& variant)
+        API_AVAILABLE(macos(13.0)) {
+        MTLMeshRenderPipelineDescriptor* desc = [MTLMeshRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.rasterSampleCount = variant.sampleCount;
+        if (variant.deferred) {
+            desc.colorAttachments[1].pixelFormat = GBUFFER_ALBEDO_FORMAT;
+            desc.colorAttachments[2].pixelFormat = GBUFFER_NORMAL_FORMAT;
+            desc.colorAttachments[3].pixelFormat = GBUFFER_DEPTH_FORMAT;
+        }
+        desc.objectFunction = make_variant_function(lib, @"meshlet_object", variant);
+        desc.meshFunction = make_variant_function(lib, @"meshlet_mesh", variant);
+        desc.fragmentFunction = variant.overdraw
+                                    ? make_overdraw_fragment(lib, desc.colorAttachments[0])
+                                    : make_variant_function(lib, variant.deferred ? @"gbuffer_instanced_fragment"
+                                                                                  : @"fragment_instanced_main",
+                                                            variant);
+        desc.maxTotalThreadsPerObjectThreadgroup = MESHLET_OBJECT_THREADS;
+        desc.maxTotalThreadsPerMeshThreadgroup = MESHLET_MESH_THREADS;
+        return desc;
+    }
+
+    // Shadow casters: depth only, into the Depth32Float cascades of the shadow map
+    MTLRenderPipelineDescriptor* make_shadow_descriptor(id<MTLLibrary> lib, NSString* vertexFunction, VertexFormat format) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.vertexDescriptor = make_vertex_descriptor(format);
+        desc.vertexFunction = [lib newFunctionWithName:vertexFunction];
+        desc.inputPrimitiveTopology = MTLPrimitiveTopologyClassTriangle;
+        return desc;
+    }
+
+    NSString* variant_name(const ShaderVariant& variant) {
+        return [NSString stringWithFormat:@"variant %#x", shader_variant_key(variant)];
+    }
+
+    // Full-screen pass with no depth: the copy into the drawable drawn together with ImGui, the
+    // ambient occlusion upsample over the scene colour and the rate map resolve
+    MTLRenderPipelineDescriptor* make_composite_descriptor(id<MTLLibrary> lib, NSString* fragmentFunction) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.vertexFunction = [lib newFunctionWithName:@"composite_vertex"];
+        desc.fragmentFunction = [lib newFunctionWithName:fragmentFunction];
+        return desc;
+    }
+
+    // Lines over the frame's output colour, with no depth; see gpu_debug_draw.hpp
+    MTLRenderPipelineDescriptor* make_debug_draw_descriptor(id<MTLLibrary> lib) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.vertexFunction = [lib newFunctionWithName:@"debug_draw_vertex"];
+        desc.fragmentFunction = [lib newFunctionWithName:@"debug_draw_fragment"];
+        desc.inputPrimitiveTopology = MTLPrimitiveTopologyClassLine;
+        return desc;
+    }
+
+    // Entity IDs around the cursor, with a depth buffer of its own; see gpu_picking.hpp
+    MTLRenderPipelineDescriptor* make_picking_descriptor(id<MTLLibrary> lib) {
+        MTLRenderPipelineDescriptor* desc = make_shadow_descriptor(lib, @"picking_vertex", VertexFormat::Float);
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatRG32Uint;
+        desc.fragmentFunction = [lib newFunctionWithName:@"picking_fragment"];
+        return desc;
+    }
+
+    // Cube parts into both impostor atlas attachments, with a depth buffer of its own; see gpu_impostors.hpp
+    MTLRenderPipelineDescriptor* make_impostor_bake_descriptor(id<MTLLibrary> lib) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = IMPOSTOR_ALBEDO_FORMAT;
+        desc.colorAttachments[1].pixelFormat = IMPOSTOR_NORMAL_FORMAT;
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.vertexDescriptor = make_vertex_descriptor(VertexFormat::Float);
+        desc.vertexFunction = [lib newFunctionWithName:@"impostor_bake_vertex"];
+        desc.fragmentFunction = [lib newFunctionWithName:@"impostor_bake_fragment"];
+        return desc;
+    }
+
+    // The sky behind the scene pass's surfaces; in the deferred pass it leaves the G-buffer alone
+    MTLRenderPipelineDescriptor* make_sky_descriptor(id<MTLLibrary> lib, uint32_t sampleCount, bool deferred) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.rasterSampleCount = sampleCount;
+        if (deferred) {
+            desc.colorAttachments[1].pixelFormat = GBUFFER_ALBEDO_FORMAT;
+            desc.colorAttachments[2].pixelFormat = GBUFFER_NORMAL_FORMAT;
+            desc.colorAttachments[3].pixelFormat = GBUFFER_DEPTH_FORMAT;
+            for (NSUInteger i = 1; i <= 3; ++i) {
+                desc.colorAttachments[i].writeMask = MTLColorWriteMaskNone;
+            }
+        }
+        desc.vertexFunction = [lib newFunctionWithName:@"deferred_lighting_vertex"];
+        desc.fragmentFunction = [lib newFunctionWithName:@"sky_fragment"];
+        return desc;
+    }
+
+    uint32_t sky_pipeline_key(uint32_t sampleCount, bool deferred) {
+        return sampleCount | ((uint32_t)deferred << 3);
+    }
+
+    // The transparent pass: scene colour and depth plus the memoryless OIT attachments. Surfaces only
+    // blend into the attachments; the closing composite only writes the scene colour.
+    MTLRenderPipelineDescriptor* make_transparency_descriptor(id<MTLLibrary> lib, NSString* vertexFunction,
+                                                              NSString* fragmentFunction, bool surface) {
+        MTLRenderPipelineDescriptor* desc = [MTLRenderPipelineDescriptor new];
+        desc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+        desc.colorAttachments[1].pixelFormat = OIT_ACCUM_FORMAT;
+        desc.colorAttachments[2].pixelFormat = OIT_REVEALAGE_FORMAT;
+        desc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+        desc.vertexFunction = [lib newFunctionWithName:vertexFunction];
+        desc.fragmentFunction = [lib newFunctionWithName:fragmentFunction];
+        if (surface) {
+            desc.colorAttachments[0].writeMask = MTLColorWriteMaskNone;
+            MTLRenderPipelineColorAttachmentDescriptor* accum = desc.colorAttachments[1];
+            accum.blendingEnabled = YES;
+            accum.sourceRGBBlendFactor = MTLBlendFactorOne;
+            accum.sourceAlphaBlendFactor = MTLBlendFactorOne;
+            accum.destinationRGBBlendFactor = MTLBlendFactorOne;
+            accum.destinationAlphaBlendFactor = MTLBlendFactorOne;
+            MTLRenderPipelineColorAttachmentDescriptor* revealage = desc.colorAttachments[2];
+            revealage.blendingEnabled = YES;
+            revealage.sourceRGBBlendFactor = MTLBlendFactorZero;
+            revealage.destinationRGBBlendFactor = MTLBlendFactorOneMinusSourceColor;
+        } else {
+            desc.colorAttachments[1].writeMask = MTLColorWriteMaskNone;
+            desc.colorAttachments[2].writeMask = MTLColorWriteMaskNone;
+        }
+        return desc;
+    }
+
+    // Particles drawn into the transparent pass after its composite, already sorted back to front: they
+    // blend premultiplied over the scene colour and leave the OIT attachments alone
+    MTLRenderPipelineDescriptor* make_particle_descriptor(id<MTLLibrary> lib) {
+        MTLRenderPipelineDescriptor* desc = make_transparency_descriptor(lib, @"particle_vertex",
+                                                                         @"particle_fragment", false);
+        MTLRenderPipelineColorAttachmentDescriptor* color = desc.colorAttachments[0];
+        color.blendingEnabled = YES;
+        color.sourceRGBBlendFactor = MTLBlendFactorOne;
+        color.sourceAlphaBlendFactor = MTLBlendFactorOne;
+        color.destinationRGBBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+        color.destinationAlphaBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+        return desc;
+    }
+}
+
+namespace {
+    // Starts compiling one variant; mesh variants are skipped where mesh pipelines are unavailable
+    void compile_variant(PipelineCache& cache, id<MTLLibrary> lib, const ShaderVariant& variant,
+                         void (^done)(id<MTLRenderPipelineState>)) {
+        if (variant.program == ShaderProgram::InstancedMeshlets) {
+            if (@available(macOS 13.0, *)) {
+                cache.compile(make_mesh_variant_descriptor(lib, variant), variant_name(variant), done);
+            }
+        } else {
+            cache.compile(make_variant_descriptor(lib, variant), variant_name(variant), done);
+        }
+    }
+
+    // Compiles every pipeline MetalContext holds from lib, plus extraVariants, and waits for them.
+    // Fills ctx's pipeline fields and variants; ctx.device must be set.
+    void compile_pipelines(MetalContext& ctx, id<MTLLibrary> lib, PipelineCache& cache,
+                           const std::vector<ShaderVariant>& extraVariants) {
+        // All pipelines compile concurrently; the blocks below fill ctx and wait() joins them
+        MetalContext* out = &ctx;
+
+        ShaderVariant objectVariant;
+        ShaderVariant instancedVariant;
+        instancedVariant.program = ShaderProgram::Instanced;
+        ShaderVariant landscapeVariant;
+        landscapeVariant.program = ShaderProgram::Landscape;
+        ShaderVariant landscapePackedVariant = landscapeVariant;
+        landscapePackedVariant.vertexFormat = VertexFormat::Packed;
+
+        cache.compile(make_variant_descriptor(lib, objectVariant), @"default",
+                      ^(id<MTLRenderPipelineState> state) { out->pipeline = state; });
+        cache.compile(make_variant_descriptor(lib, landscapeVariant), @"landscape",
+                      ^(id<MTLRenderPipelineState> state) { out->landscape_pipeline = state; });
+        cache.compile(make_variant_descriptor(lib, landscapePackedVariant), @"packed landscape",
+                      ^(id<MTLRenderPipelineState> state) { out->landscape_packed_pipeline = state; });
+        cache.compile(make_variant_descriptor(lib, instancedVariant), @"instanced",
+                      ^(id<MTLRenderPipelineState> state) { out->instanced_pipeline = state; });
+
+        // Multisampled copies of the default variants, so switching MSAA on does not stall a frame
+        std::vector<ShaderVariant> variants;
+        for (uint32_t sampleCount : { 2u, 4u }) {
+            if (!msaa_supported(ctx.device, sampleCount)) {
+                continue;
+            }
+            for (ShaderVariant variant : { objectVariant, instancedVariant, landscapeVariant, landscapePackedVariant }) {
+                variant.sampleCount = sampleCount;
+                variants.push_back(variant);
+            }
+        }
+        variants.insert(variants.end(), extraVariants.begin(), extraVariants.end());
+        std::vector<id<MTLRenderPipelineState>> variantPipelines(variants.size());
+        id<MTLRenderPipelineState>* variantOut = variantPipelines.data();
+        for (size_t i = 0; i < variants.size(); ++i) {
+            compile_variant(cache, lib, variants[i], ^(id<MTLRenderPipelineState> state) { variantOut[i] = state; });
+        }
+        cache.compile(make_composite_descriptor(lib, @"composite_fragment"), @"composite",
+                      ^(id<MTLRenderPipelineState> state) { out->composite_pipeline = state; });
+        cache.compile(make_transparency_descriptor(lib, @"water_vertex", @"water_fragment", true), @"water",
+                      ^(id<MTLRenderPipelineState> state) { out->water_pipeline = state; });
+        cache.compile(make_transparency_descriptor(lib, @"composite_vertex", @"oit_composite_fragment", false),
+                      @"transparency composite",
+                      ^(id<MTLRenderPipelineState> state) { out->oit_composite_pipeline = state; });
+        cache.compile(make_particle_descriptor(lib), @"particles",
+                      ^(id<MTLRenderPipelineState> state) { out->particle_pipeline = state; });
+        cache.compile(make_composite_descriptor(lib, @"ambient_occlusion_apply_fragment"), @"ambient occlusion upsample",
+                      ^(id<MTLRenderPipelineState> state) { out->ambient_occlusion_apply_pipeline = state; });
+        cache.compile(make_debug_draw_descriptor(lib), @"debug draw",
+                      ^(id<MTLRenderPipelineState> state) { out->debug_draw_pipeline = state; });
+        cache.compile(make_picking_descriptor(lib), @"picking",
+                      ^(id<MTLRenderPipelineState> state) { out->picking_pipeline = state; });
+        cache.compile(make_composite_descriptor(lib, @"rate_map_resolve_fragment"), @"rate map resolve",
+                      ^(id<MTLRenderPipelineState> state) { out->rate_map_resolve_pipeline = state; });
+        cache.compile(make_sky_descriptor(lib, 1, false), @"sky",
+                      ^(id<MTLRenderPipelineState> state) { out->sky_pipeline = state; });
+        cache.compile(make_shadow_descriptor(lib, @"shadow_landscape_vertex", VertexFormat::Float), @"shadow landscape",
+                      ^(id<MTLRenderPipelineState> state) { out->shadow_landscape_pipeline = state; });
+        cache.compile(make_shadow_descriptor(lib, @"shadow_landscape_vertex", VertexFormat::Packed), @"shadow packed landscape",
+                      ^(id<MTLRenderPipelineState> state) { out->shadow_landscape_packed_pipeline = state; });
+        MTLRenderPipelineDescriptor* heightMapShadow =
+            make_shadow_descriptor(lib, @"shadow_landscape_heightmap_vertex", VertexFormat::Float);
+        heightMapShadow.vertexDescriptor = nil;
+        cache.compile(heightMapShadow, @"shadow height-map landscape",
+                      ^(id<MTLRenderPipelineState> state) { out->shadow_landscape_heightmap_pipeline = state; });
+        cache.compile(make_shadow_descriptor(lib, @"shadow_instanced_vertex", VertexFormat::Float), @"shadow instanced",
+                      ^(id<MTLRenderPipelineState> state) { out->shadow_instanced_pipeline = state; });
+        cache.compile(make_impostor_bake_descriptor(lib), @"impostor baking",
+                      ^(id<MTLRenderPipelineState> state) { out->impostor_bake_pipeline = state; });
+
+        cache.compile(make_vertex_format_function(lib, @"generate_terrain_chunk", VertexFormat::Float), @"terrain generation",
+                      ^(id<MTLComputePipelineState> state) { out->terrain_gen_pipeline = state; });
+        cache.compile(make_vertex_format_function(lib, @"generate_terrain_chunk", VertexFormat::Packed), @"packed terrain generation",
+                      ^(id<MTLComputePipelineState> state) { out->terrain_gen_packed_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"cull_terrain_chunks"], @"chunk culling",
+                      ^(id<MTLComputePipelineState> state) { out->cull_chunks_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"hiz_copy_depth"], @"Hi-Z copy",
+                      ^(id<MTLComputePipelineState> state) { out->hiz_copy_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"hiz_reduce"], @"Hi-Z reduce",
+                      ^(id<MTLComputePipelineState> state) { out->hiz_reduce_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"camera_motion_vectors"], @"motion vectors",
+                      ^(id<MTLComputePipelineState> state) { out->motion_vectors_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"temporal_aa_resolve"], @"temporal anti-aliasing",
+                      ^(id<MTLComputePipelineState> state) { out->temporal_aa_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"scatter_foliage"], @"foliage scatter",
+                      ^(id<MTLComputePipelineState> state) { out->scatter_foliage_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"select_foliage"], @"foliage selection",
+                      ^(id<MTLComputePipelineState> state) { out->select_foliage_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"finish_foliage_draw"], @"foliage draw arguments",
+                      ^(id<MTLComputePipelineState> state) { out->finish_foliage_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"skin_vertices"], @"skinning",
+                      ^(id<MTLComputePipelineState> state) { out->skin_vertices_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"terrain_tessellation_factors"], @"tessellation factors",
+                      ^(id<MTLComputePipelineState> state) { out->tessellation_factors_pipeline = state; });
+        cache.compile(make_vertex_format_function(lib, @"bake_terrain_materials", VertexFormat::Float), @"material baking",
+                      ^(id<MTLComputePipelineState> state) { out->bake_materials_pipeline = state; });
+        cache.compile(make_vertex_format_function(lib, @"bake_terrain_materials", VertexFormat::Packed), @"packed material baking",
+                      ^(id<MTLComputePipelineState> state) { out->bake_materials_packed_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"bake_terrain_horizons"], @"horizon baking",
+                      ^(id<MTLComputePipelineState> state) { out->bake_horizons_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"prefilter_reflection_probe"], @"reflection probe prefilter",
+                      ^(id<MTLComputePipelineState> state) { out->prefilter_probe_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"atmosphere_transmittance_lut"], @"atmosphere transmittance",
+                      ^(id<MTLComputePipelineState> state) { out->atmosphere_transmittance_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"atmosphere_multiscattering_lut"], @"atmosphere multiple scattering",
+                      ^(id<MTLComputePipelineState> state) { out->atmosphere_multiscattering_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"atmosphere_sky_view_lut"], @"atmosphere sky view",
+                      ^(id<MTLComputePipelineState> state) { out->atmosphere_sky_view_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"cluster_lights"], @"light clustering",
+                      ^(id<MTLComputePipelineState> state) { out->cluster_lights_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"ambient_occlusion"], @"ambient occlusion",
+                      ^(id<MTLComputePipelineState> state) { out->ambient_occlusion_pipeline = state; });
+        // Kernels that trace rays only compile for devices that can
+        if (ctx.device.supportsRaytracing) {
+            cache.compile([lib newFunctionWithName:@"ray_traced_ambient_occlusion"], @"ray-traced ambient occlusion",
+                          ^(id<MTLComputePipelineState> state) { out->ray_traced_occlusion_pipeline = state; });
+        }
+        cache.compile([lib newFunctionWithName:@"update_terrain_clipmap"], @"terrain clipmap update",
+                      ^(id<MTLComputePipelineState> state) { out->update_terrain_clipmap_pipeline = state; });
+        cache.compile([lib newFunctionWithName:@"evaluate_noise"], @"noise evaluation",
+                      ^(id<MTLComputePipelineState> state) { out->noise_pipeline = state; });
+        cache.wait();
+
+        ctx.library = lib;
+        ctx.sky_variants.clear();
+        ctx.sky_variants[sky_pipeline_key(1, false)] = ctx.sky_pipeline;
+        ctx.variants.clear();
+        ctx.variants[shader_variant_key(objectVariant)] = ctx.pipeline;
+        ctx.variants[shader_variant_key(instancedVariant)] = ctx.instanced_pipeline;
+        ctx.variants[shader_variant_key(landscapeVariant)] = ctx.landscape_pipeline;
+        ctx.variants[shader_variant_key(landscapePackedVariant)] = ctx.landscape_packed_pipeline;
+        for (size_t i = 0; i < variants.size(); ++i) {
+            ctx.variants[shader_variant_key(variants[i])] = variantPipelines[i];
+        }
+    }
+
+    // True if every pipeline present in before is present in after
+    bool has_pipelines_of(const MetalContext& after, const MetalContext& before) {
+        auto kept = [](id a, id b) { return !b || a; };
+        return kept(after.pipeline, before.pipeline) &&
+               kept(after.landscape_pipeline, before.landscape_pipeline) &&
+               kept(after.landscape_packed_pipeline, before.landscape_packed_pipeline) &&
+               kept(after.instanced_pipeline, before.instanced_pipeline) &&
+               kept(after.composite_pipeline, before.composite_pipeline) &&
+               kept(after.water_pipeline, before.water_pipeline) &&
+               kept(after.oit_composite_pipeline, before.oit_composite_pipeline) &&
+               kept(after.particle_pipeline, before.particle_pipeline) &&
+               kept(after.ambient_occlusion_apply_pipeline, before.ambient_occlusion_apply_pipeline) &&
+               kept(after.debug_draw_pipeline, before.debug_draw_pipeline) &&
+               kept(after.picking_pipeline, before.picking_pipeline) &&
+               kept(after.rate_map_resolve_pipeline, before.rate_map_resolve_pipeline) &&
+               kept(after.sky_pipeline, before.sky_pipeline) &&
+               kept(after.shadow_landscape_pipeline, before.shadow_landscape_pipeline) &&
+               kept(after.shadow_landscape_packed_pipeline, before.shadow_landscape_packed_pipeline) &&
+               kept(after.shadow_landscape_heightmap_pipeline, before.shadow_landscape_heightmap_pipeline) &&
+               kept(after.shadow_instanced_pipeline, before.shadow_instanced_pipeline) &&
+               kept(after.impostor_bake_pipeline, before.impostor_bake_pipeline) &&
+               kept(after.terrain_gen_pipeline, before.terrain_gen_pipeline) &&
+               kept(after.terrain_gen_packed_pipeline, before.terrain_gen_packed_pipeline) &&
+               kept(after.cull_chunks_pipeline, before.cull_chunks_pipeline) &&
+               kept(after.hiz_copy_pipeline, before.hiz_copy_pipeline) &&
+               kept(after.hiz_reduce_pipeline, before.hiz_reduce_pipeline) &&
+               kept(after.motion_vectors_pipeline, before.motion_vectors_pipeline) &&
+               kept(after.temporal_aa_pipeline, before.temporal_aa_pipeline) &&
+               kept(after.scatter_foliage_pipeline, before.scatter_foliage_pipeline) &&
+               kept(after.select_foliage_pipeline, before.select_foliage_pipeline) &&
+               kept(after.finish_foliage_pipeline, before.finish_foliage_pipeline) &&
+               kept(after.skin_vertices_pipeline, before.skin_vertices_pipeline) &&
+               kept(after.tessellation_factors_pipeline, before.tessellation_factors_pipeline) &&
+               kept(after.bake_materials_pipeline, before.bake_materials_pipeline) &&
+               kept(after.bake_materials_packed_pipeline, before.bake_materials_packed_pipeline) &&
+               kept(after.bake_horizons_pipeline, before.bake_horizons_pipeline) &&
+               kept(after.prefilter_probe_pipeline, before.prefilter_probe_pipeline) &&
+               kept(after.atmosphere_transmittance_pipeline, before.atmosphere_transmittance_pipeline) &&
+               kept(after.atmosphere_multiscattering_pipeline, before.atmosphere_multiscattering_pipeline) &&
+               kept(after.atmosphere_sky_view_pipeline, before.atmosphere_sky_view_pipeline) &&
+               kept(after.cluster_lights_pipeline, before.cluster_lights_pipeline) &&
+               kept(after.ambient_occlusion_pipeline, before.ambient_occlusion_pipeline) &&
+               kept(after.ray_traced_occlusion_pipeline, before.ray_traced_occlusion_pipeline) &&
+               kept(after.ocean_spectrum_pipeline, before.ocean_spectrum_pipeline) &&
+               kept(after.ocean_fft_pipeline, before.ocean_fft_pipeline) &&
+               kept(after.ocean_resolve_pipeline, before.ocean_resolve_pipeline) &&
+               kept(after.erosion_flux_pipeline, before.erosion_flux_pipeline) &&
+               kept(after.erosion_water_pipeline, before.erosion_water_pipeline) &&
+               kept(after.erosion_sediment_pipeline, before.erosion_sediment_pipeline) &&
+               kept(after.erosion_transport_pipeline, before.erosion_transport_pipeline) &&
+               kept(after.erosion_thermal_pipeline, before.erosion_thermal_pipeline) &&
+               kept(after.particles_emit_pipeline, before.particles_emit_pipeline) &&
+               kept(after.particles_prepare_pipeline, before.particles_prepare_pipeline) &&
+               kept(after.particles_simulate_pipeline, before.particles_simulate_pipeline) &&
+               kept(after.particles_prepare_sort_pipeline, before.particles_prepare_sort_pipeline) &&
+               kept(after.particles_pad_pipeline, before.particles_pad_pipeline) &&
+               kept(after.particles_sort_pipeline, before.particles_sort_pipeline) &&
+               kept(after.terrain_brush_pipeline, before.terrain_brush_pipeline) &&
+               kept(after.update_terrain_clipmap_pipeline, before.update_terrain_clipmap_pipeline) &&
+               kept(after.noise_pipeline, before.noise_pipeline);
+    }
+}
+
+MTLCompileOptions* metal_compile_options() {
+    // Matches `metal -fno-fast-math -fpreserve-invariance` in CMakeLists.txt; the noise must match the CPU
+    // bit for bit, and the landscape's depth pre-pass its colour pass
+    MTLCompileOptions* options = [MTLCompileOptions new];
+    options.fastMathEnabled = NO;
+    if (@available(macOS 11.0, *)) {
+        options.preserveInvariance = YES;
+    }
+    return options;
+}
+
+id<MTLLibrary> metal_feature_library(MetalContext& ctx, const char* name) {
+    auto it = ctx.featureLibraries.find(name);
+    if (it != ctx.featureLibraries.end()) {
+        return it->second;
+    }
+    TRACE_SCOPE("Load feature library");
+    NSError* error = nil;
     NSString* executablePath = [[NSBundle mainBundle] executablePath];
-    NSString* libraryPath = [[executablePath stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"shaders.metallib"];
+    NSString* libraryPath = [[executablePath stringByDeletingLastPathComponent]
+        stringByAppendingPathComponent:[NSString stringWithFormat:@"%s.metallib", name]];
     id<MTLLibrary> lib = [ctx.device newLibraryWithFile:libraryPath error:&error];
+    NSString* sourcePath = metal_shader_source_path();
+    if (!lib && sourcePath) {
+        // Feature sources sit next to shaders.metal
+        sourcePath = [[sourcePath stringByDeletingLastPathComponent]
+            stringByAppendingPathComponent:[NSString stringWithFormat:@"%s.metal", name]];
+        NSLog(@"Failed to load library at path %@, compiling %@ instead", libraryPath, sourcePath);
+        NSString* source = metal_read_shader_source(sourcePath, &error);
+        lib = source ? [ctx.device newLibraryWithSource:source options:metal_compile_options() error:&error] : nil;
+        libraryPath = sourcePath;
+    }
     if (!lib) {
         NSLog(@"Failed to load library at path %@. Error: %@", libraryPath, error);
-        abort();
     }
-    id<MTLFunction> vertexFn = [lib newFunctionWithName:@"vertex_main"];
-    id<MTLFunction> fragmentFn = [lib newFunctionWithName:@"fragment_main"];
+    ctx.featureLibraries[name] = lib;
+    return lib;
+}
 
-    MTLRenderPipelineDescriptor* pipelineDesc = [MTLRenderPipelineDescriptor new];
-    pipelineDesc.vertexFunction = vertexFn;
-    pipelineDesc.fragmentFunction = fragmentFn;
-    pipelineDesc.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
-    pipelineDesc.depthAttachmentPixelFormat = MTLPixelFormatDepth32Float;
+bool metal_ocean_pipelines(MetalContext& ctx) {
+    if (!ctx.featureLibraries.count("ocean")) {
+        TRACE_SCOPE("Compile ocean pipelines");
+        if (id<MTLLibrary> lib = metal_feature_library(ctx, "ocean")) {
+            MetalContext* out = &ctx;
+            PipelineCache& cache = *ctx.pipelineCache;
+            cache.compile([lib newFunctionWithName:@"ocean_spectrum"], @"ocean spectrum",
+                          ^(id<MTLComputePipelineState> state) { out->ocean_spectrum_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"ocean_fft"], @"ocean FFT",
+                          ^(id<MTLComputePipelineState> state) { out->ocean_fft_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"ocean_resolve"], @"ocean resolve",
+                          ^(id<MTLComputePipelineState> state) { out->ocean_resolve_pipeline = state; });
+            cache.save();
+        }
+    }
+    return ctx.ocean_spectrum_pipeline && ctx.ocean_fft_pipeline && ctx.ocean_resolve_pipeline;
+}
 
-    MTLVertexDescriptor* vertexDesc = [MTLVertexDescriptor new];
-    
-    // Position
-    vertexDesc.attributes[0].format = MTLVertexFormatFloat3;
-    vertexDesc.attributes[0].offset = offsetof(Vertex, position);
-    vertexDesc.attributes[0].bufferIndex = 0;
+bool metal_erosion_pipelines(MetalContext& ctx) {
+    if (!ctx.featureLibraries.count("erosion")) {
+        TRACE_SCOPE("Compile erosion pipelines");
+        if (id<MTLLibrary> lib = metal_feature_library(ctx, "erosion")) {
+            MetalContext* out = &ctx;
+            PipelineCache& cache = *ctx.pipelineCache;
+            cache.compile([lib newFunctionWithName:@"erosion_flux"], @"erosion flux",
+                          ^(id<MTLComputePipelineState> state) { out->erosion_flux_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"erosion_water"], @"erosion water",
+                          ^(id<MTLComputePipelineState> state) { out->erosion_water_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"erosion_sediment"], @"erosion sediment",
+                          ^(id<MTLComputePipelineState> state) { out->erosion_sediment_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"erosion_transport"], @"erosion transport",
+                          ^(id<MTLComputePipelineState> state) { out->erosion_transport_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"erosion_thermal"], @"erosion thermal",
+                          ^(id<MTLComputePipelineState> state) { out->erosion_thermal_pipeline = state; });
+            cache.save();
+        }
+    }
+    return ctx.erosion_flux_pipeline && ctx.erosion_water_pipeline && ctx.erosion_sediment_pipeline &&
+           ctx.erosion_transport_pipeline && ctx.erosion_thermal_pipeline;
+}
+
+bool metal_particle_pipelines(MetalContext& ctx) {
+    if (!ctx.featureLibraries.count("particles")) {
+        TRACE_SCOPE("Compile particle pipelines");
+        if (id<MTLLibrary> lib = metal_feature_library(ctx, "particles")) {
+            MetalContext* out = &ctx;
+            PipelineCache& cache = *ctx.pipelineCache;
+            cache.compile([lib newFunctionWithName:@"particles_emit"], @"particles emit",
+                          ^(id<MTLComputePipelineState> state) { out->particles_emit_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"particles_prepare"], @"particles prepare",
+                          ^(id<MTLComputePipelineState> state) { out->particles_prepare_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"particles_simulate"], @"particles simulate",
+                          ^(id<MTLComputePipelineState> state) { out->particles_simulate_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"particles_prepare_sort"], @"particles prepare sort",
+                          ^(id<MTLComputePipelineState> state) { out->particles_prepare_sort_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"particles_pad"], @"particles pad",
+                          ^(id<MTLComputePipelineState> state) { out->particles_pad_pipeline = state; });
+            cache.compile([lib newFunctionWithName:@"particles_sort"], @"particles sort",
+                          ^(id<MTLComputePipelineState> state) { out->particles_sort_pipeline = state; });
+            cache.save();
+        }
+    }
+    return ctx.particles_emit_pipeline && ctx.particles_prepare_pipeline && ctx.particles_simulate_pipeline &&
+           ctx.particles_prepare_sort_pipeline && ctx.particles_pad_pipeline && ctx.particles_sort_pipeline;
+}
+
+bool metal_terrain_brush_pipelines(MetalContext& ctx) {
+    if (!ctx.featureLibraries.count("terrain_brush")) {
+        TRACE_SCOPE("Compile terrain brush pipeline");
+        if (id<MTLLibrary> lib = metal_feature_library(ctx, "terrain_brush")) {
+            MetalContext* out = &ctx;
+            PipelineCache& cache = *ctx.pipelineCache;
+            cache.compile([lib newFunctionWithName:@"terrain_brush_apply"], @"terrain brush apply",
+                          ^(id<MTLComputePipelineState> state) { out->terrain_brush_pipeline = state; });
+            cache.save();
+        }
+    }
+    return ctx.terrain_brush_pipeline != nil;
+}
+
+NSString* metal_read_shader_source(NSString* path, NSError** error) {
+    NSString* source = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:error];
+    if (!source) {
+        return nil;
+    }
+    NSString* directory = [path stringByDeletingLastPathComponent];
+    NSMutableSet<NSString*>* included = [NSMutableSet setWithObject:path.lastPathComponent];
+    NSMutableString* out = [NSMutableString stringWithCapacity:source.length];
+    // Included files may include others; they are expanded as the loop reaches them
+    NSMutableArray<NSString*>* lines = [[source componentsSeparatedByString:@"\n"] mutableCopy];
+    for (NSUInteger i = 0; i < lines.count; ++i) {
+        NSString* line = lines[i];
+        NSString* trimmed = [line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if (![trimmed hasPrefix:@"#include \""] || ![trimmed hasSuffix:@"\""]) {
+            [out appendString:line];
+            [out appendString:@"\n"];
+            continue;
+        }
+        NSString* name = [trimmed substringWithRange:NSMakeRange(10, trimmed.length - 11)];
+        if ([included containsObject:name]) {
+            continue;
+        }
+        [included addObject:name];
+        NSString* header = [NSString stringWithContentsOfFile:[directory stringByAppendingPathComponent:name]
+                                                     encoding:NSUTF8StringEncoding
+                                                        error:error];
+        if (!header) {
+            return nil;
+        }
+        // In a single source the header's #pragma once would only draw a warning
+        NSArray<NSString*>* headerLines = [[header componentsSeparatedByString:@"\n"]
+            filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"SELF != '#pragma once'"]];
+        [lines insertObjects:headerLines
+                   atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(i + 1, headerLines.count)]];
+    }
+    return out;
+}
+
+NSString* metal_shader_source_path() {
+#ifdef SHADER_SOURCE_PATH
+    NSString* path = @SHADER_SOURCE_PATH;
+    return [[NSFileManager defaultManager] fileExistsAtPath:path] ? path : nil;
+#else
+    return nil;
+#endif
+}
+
+id<MTLRenderPipelineState> metal_pipeline(MetalContext& ctx, const ShaderVariant& variant) {
+    const uint32_t key = shader_variant_key(variant);
+    auto it = ctx.variants.find(key);
+    if (it != ctx.variants.end()) {
+        return it->second;
+    }
+    if (ctx.pendingVariants.count(key)) {
+        // Requested earlier; let that compile finish rather than start a second one
+        ctx.pipelineCache->wait();
+        return metal_request_pipeline(ctx, variant);
+    }
+
+    __block id<MTLRenderPipelineState> pipeline = nil;
+    compile_variant(*ctx.pipelineCache, ctx.library, variant, ^(id<MTLRenderPipelineState> state) { pipeline = state; });
+    if (variant.program == ShaderProgram::InstancedMeshlets) {
+        ctx.pipelineCache->wait();
+    } else {
+        ctx.pipelineCache->save();
+    }
+    ctx.variants[key] = pipeline;
+    return pipeline;
+}
+
+id<MTLRenderPipelineState> metal_request_pipeline(MetalContext& ctx, const ShaderVariant& variant) {
+    const uint32_t key = shader_variant_key(variant);
+    auto it = ctx.variants.find(key);
+    if (it != ctx.variants.end()) {
+        return it->second;
+    }
+    if (!ctx.pipelineRequests) {
+        ctx.pipelineRequests = std::make_shared<MetalPipelineRequests>();
+    }
+
+    if (ctx.pendingVariants.count(key)) {
+        if (pipeline_request_collect(*ctx.pipelineRequests, ctx.pendingVariants, ctx.variants, key) ==
+            PipelineRequestState::Pending) {
+            return nil;
+        }
+        if (ctx.pendingVariants.empty()) {
+            // Nothing else compiles after startup, so this does not wait
+            ctx.pipelineCache->save();
+        }
+        return ctx.variants[key];
+    }
+
+    if (variant.program == ShaderProgram::InstancedMeshlets && !meshlet_draw_supported(ctx.device)) {
+        // compile_variant() would never call back
+        ctx.variants[key] = nil;
+        return nil;
+    }
+    // The block keeps the requests alive should the context be replaced, e.g. by a shader reload
+    std::shared_ptr<MetalPipelineRequests> requests = ctx.pipelineRequests;
+    ctx.pendingVariants.insert(key);
+    compile_variant(*ctx.pipelineCache, ctx.library, variant, ^(id<MTLRenderPipelineState> state) {
+        pipeline_request_finish(*requests, key, state);
+    });
+    return nil;
+}
+
+bool metal_pipeline_pending(const MetalContext& ctx, const ShaderVariant& variant) {
+    return ctx.pendingVariants.count(shader_variant_key(variant)) != 0;
+}
+
+id<MTLRenderPipelineState> metal_pipeline_or_placeholder(MetalContext& ctx, const ShaderVariant& variant, bool wait) {
+    id<MTLRenderPipelineState> pipeline = wait ? metal_pipeline(ctx, variant) : metal_request_pipeline(ctx, variant);
+    if (pipeline) {
+        return pipeline;
+    }
+    const ShaderVariant placeholder = shader_variant_placeholder(variant);
+    if (shader_variant_key(placeholder) == shader_variant_key(variant) && !metal_pipeline_pending(ctx, variant)) {
+        return nil; // The placeholder itself failed
+    }
+    return metal_pipeline(ctx, placeholder);
+}
+
+id<MTLRenderPipelineState> metal_sky_pipeline(MetalContext& ctx, uint32_t sampleCount, bool deferred) {
+    const uint32_t key = sky_pipeline_key(sampleCount, deferred);
+    auto it = ctx.sky_variants.find(key);
+    if (it != ctx.sky_variants.end()) {
+        return it->second;
+    }
+
+    __block id<MTLRenderPipelineState> pipeline = nil;
+    ctx.pipelineCache->compile(make_sky_descriptor(ctx.library, sampleCount, deferred), @"sky",
+                               ^(id<MTLRenderPipelineState> state) { pipeline = state; });
+    ctx.pipelineCache->save();
+    ctx.sky_variants[key] = pipeline;
+    return pipeline;
+}
+
+id<MTLDepthStencilState> metal_depth_equal_state(MetalContext& ctx) {
+    if (!ctx.depth_equal_state) {
+        MTLDepthStencilDescriptor* desc = [MTLDepthStencilDescriptor new];
+        desc.depthCompareFunction = MTLCompareFunctionEqual;
+        desc.depthWriteEnabled = NO;
+        ctx.depth_equal_state = [ctx.device newDepthStencilStateWithDescriptor:desc];
+    }
+    return ctx.depth_equal_state;
+}
 
-    // Normal
-    vertexDesc.attributes[1].format = MTLVertexFormatFloat3;
-    vertexDesc.attributes[1].offset = offsetof(Vertex, normal);
-    vertexDesc.attributes[1].bufferIndex = 0;
+bool metal_context_rebuild(const MetalContext& ctx, id<MTLLibrary> library, const std::vector<uint32_t>& variantKeys,
+                           MetalContext& rebuilt) {
+    rebuilt = MetalContext{};
+    rebuilt.device = ctx.device;
+    rebuilt.queue = ctx.queue;
+    rebuilt.computeQueue = ctx.computeQueue;
+    rebuilt.materials = ctx.materials;
+    rebuilt.bindless = ctx.bindless;
+    // Only shaders.metal is rebuilt; the feature libraries and their pipelines carry over
+    rebuilt.featureLibraries = ctx.featureLibraries;
+    rebuilt.ocean_spectrum_pipeline = ctx.ocean_spectrum_pipeline;
+    rebuilt.ocean_fft_pipeline = ctx.ocean_fft_pipeline;
+    rebuilt.ocean_resolve_pipeline = ctx.ocean_resolve_pipeline;
+    rebuilt.erosion_flux_pipeline = ctx.erosion_flux_pipeline;
+    rebuilt.erosion_water_pipeline = ctx.erosion_water_pipeline;
+    rebuilt.erosion_sediment_pipeline = ctx.erosion_sediment_pipeline;
+    rebuilt.erosion_transport_pipeline = ctx.erosion_transport_pipeline;
+    rebuilt.erosion_thermal_pipeline = ctx.erosion_thermal_pipeline;
+    rebuilt.particles_emit_pipeline = ctx.particles_emit_pipeline;
+    rebuilt.particles_prepare_pipeline = ctx.particles_prepare_pipeline;
+    rebuilt.particles_simulate_pipeline = ctx.particles_simulate_pipeline;
+    rebuilt.particles_prepare_sort_pipeline = ctx.particles_prepare_sort_pipeline;
+    rebuilt.particles_pad_pipeline = ctx.particles_pad_pipeline;
+    rebuilt.particles_sort_pipeline = ctx.particles_sort_pipeline;
+    rebuilt.terrain_brush_pipeline = ctx.terrain_brush_pipeline;
+    // The on-disk archive only holds binaries of the built library, so variants of this one never use it
+    rebuilt.pipelineCache = std::make_shared<PipelineCache>(ctx.device, nil, nil);
 
-    vertexDesc.layouts[0].stride = sizeof(Vertex);
-    
-    pipelineDesc.vertexDescriptor = vertexDesc;
+    std::vector<ShaderVariant> variants;
+    for (uint32_t key : variantKeys) {
+        variants.push_back(shader_variant_from_key(key));
+    }
+    compile_pipelines(rebuilt, library, *rebuilt.pipelineCache, variants);
 
-    NSError* err = nil;
-    ctx.pipeline = [ctx.device newRenderPipelineStateWithDescriptor:pipelineDesc error:&err];
-    
-    if (err) {
-        NSLog(@"Error creating pipeline state: %@", err);
+    if (!has_pipelines_of(rebuilt, ctx)) {
+        return false;
+    }
+    for (uint32_t key : variantKeys) {
+        if (!rebuilt.variants[key]) {
+            return false;
+        }
     }
+    return true;
+}
 
-    id<MTLFunction> landscapeVertexFn = [lib newFunctionWithName:@"landscape_vertex_main"];
-    id<MTLFunction> landscapeFragmentFn = [lib newFunctionWithName:@"landscape_fragment_main"];
-    pipelineDesc.vertexFunction = landscapeVertexFn;
-    pipelineDesc.fragmentFunction = landscapeFragmentFn;
-    
-    NSError* landscapeErr = nil;
-    ctx.landscape_pipeline = [ctx.device newRenderPipelineStateWithDescriptor:pipelineDesc error:&landscapeErr];
+MetalContext create_metal_context() {
+    TRACE_SCOPE("Create Metal context");
+    MetalContext ctx{};
+    ctx.device = MTLCreateSystemDefaultDevice();
+    ctx.queue = [ctx.device newCommandQueue];
+    ctx.queue.label = @"Render";
+    ctx.computeQueue = [ctx.device newCommandQueue];
+    ctx.computeQueue.label = @"Async compute";
 
-    if (landscapeErr) {
-        NSLog(@"Error creating landscape pipeline state: %@", landscapeErr);
+    NSError *error = nil;
+    NSString* executablePath = [[NSBundle mainBundle] executablePath];
+    NSString* libraryPath = [[executablePath stringByDeletingLastPathComponent] stringByAppendingPathComponent:@"shaders.metallib"];
+    id<MTLLibrary> lib = [ctx.device newLibraryWithFile:libraryPath error:&error];
+    NSString* sourcePath = metal_shader_source_path();
+    if (!lib && sourcePath) {
+        // Development builds can still start without the built library, at the cost of a compile
+        NSLog(@"Failed to load library at path %@, compiling %@ instead", libraryPath, sourcePath);
+        NSString* source = metal_read_shader_source(sourcePath, &error);
+        lib = source ? [ctx.device newLibraryWithSource:source options:metal_compile_options() error:&error] : nil;
+        libraryPath = sourcePath;
     }
+    if (!lib) {
+        NSLog(@"Failed to load library at path %@. Error: %@", libraryPath, error);
+        return ctx;
+    }
+    ctx.materials = create_material_buffer(ctx.device, default_scene_materials());
+    ctx.bindless = bindless_supported(ctx.device);
 
+    ctx.pipelineCache = std::make_shared<PipelineCache>(ctx.device, default_pipeline_archive_path(), libraryPath);
+    PipelineCache& cache = *ctx.pipelineCache;
+    compile_pipelines(ctx, lib, cache, {});
+    if (cache.miss_count() > 0) {
+        NSLog(@"Compiled %u pipelines missing from the pipeline archive", cache.miss_count());
+        cache.save();
+    }
     return ctx;
-}
\ No newline at end of file
+}
@@ -0,0 +1,53 @@
+/**
+ * @file metal_cpp.hpp
+ * @brief The metal-cpp API, and the casts that hand Objective-C Metal objects to code written against it.
+ *
+ * A metal-cpp pointer is the Objective-C object itself, so the casts below cost neither a message
+ * nor a retain. C++ code never owns what it is handed this way: the Objective-C side keeps each
+ * object alive for as long as the pointer is used, e.g. for the frame a DrawCommand is queued in.
+ */
+
+#pragma once
+#include <Foundation/Foundation.hpp>
+#include <Metal/Metal.hpp>
+
+#ifdef __OBJC__
+#import <Metal/Metal.h>
+
+inline MTL::Buffer* to_mtl(id<MTLBuffer> buffer) {
+    return (__bridge MTL::Buffer*)buffer;
+}
+
+inline MTL::Texture* to_mtl(id<MTLTexture> texture) {
+    return (__bridge MTL::Texture*)texture;
+}
+
+inline MTL::RenderPipelineState* to_mtl(id<MTLRenderPipelineState> pipeline) {
+    return (__bridge MTL::RenderPipelineState*)pipeline;
+}
+
+inline MTL::DepthStencilState* to_mtl(id<MTLDepthStencilState> depthState) {
+    return (__bridge MTL::DepthStencilState*)depthState;
+}
+
+inline MTL::RenderCommandEncoder* to_mtl(id<MTLRenderCommandEncoder> enc) {
+    return (__bridge MTL::RenderCommandEncoder*)enc;
+}
+
+inline MTL::ParallelRenderCommandEncoder* to_mtl(id<MTLParallelRenderCommandEncoder> parallel) {
+    return (__bridge MTL::ParallelRenderCommandEncoder*)parallel;
+}
+
+inline MTL::CounterSampleBuffer* to_mtl(id<MTLCounterSampleBuffer> samples) {
+    return (__bridge MTL::CounterSampleBuffer*)samples;
+}
+
+inline MTL::IndexType to_mtl(MTLIndexType type) {
+    return (MTL::IndexType)type;
+}
+
+/// @return The Objective-C object of a metal-cpp encoder, for functions not yet written against metal-cpp.
+inline id<MTLRenderCommandEncoder> to_objc(MTL::RenderCommandEncoder* enc) {
+    return (__bridge id<MTLRenderCommandEncoder>)enc;
+}
+#endif
@@ -0,0 +1,369 @@
+#include "metrics.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    // Longest wait before checking whether to stop
+    constexpr int POLL_MS = 100;
+    // Statsd payload per datagram, under a typical MTU
+    constexpr size_t STATSD_DATAGRAM = 1400;
+    // A request longer than this is answered from what arrived
+    constexpr size_t REQUEST_LIMIT = 4096;
+    // How long a slow client may take to send its request or read the response
+    constexpr int CLIENT_TIMEOUT_MS = 500;
+
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;  // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+    const char* const COUNTER_HELP[METRIC_COUNTER_COUNT] = {
+        "Frames finished.",
+        "Bytes the resource uploader copied to the GPU.",
+        "Frames the hitch detector reported.",
+    };
+
+    const char* const GAUGE_HELP[METRIC_GAUGE_COUNT] = {
+        "Terrain chunks with GPU meshes.",
+        "Bytes waiting in the upload queue.",
+        "Batches waiting in the upload queue.",
+    };
+
+    const char* const HISTOGRAM_HELP[METRIC_HISTOGRAM_COUNT] = {
+        "CPU milliseconds from begin to end of a frame.",
+        "GPU milliseconds of a frame.",
+    };
+
+    void append(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    void append(std::string& out, const char* format, ...) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        const int length = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        out.append(line, (size_t)std::clamp(length, 0, (int)sizeof(line) - 1));
+    }
+
+    void set_timeouts(int fd, int ms) {
+        timeval timeout;
+        timeout.tv_sec = ms / 1000;
+        timeout.tv_usec = (ms % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+        const int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+
+    void send_all(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t written = send(fd, data.data() + sent, data.size() - sent, SEND_FLAGS);
+            if (written <= 0) {
+                return;
+            }
+            sent += (size_t)written;
+        }
+    }
+}
+
+const char* metric_counter_name(MetricCounter counter) {
+    switch (counter) {
+        case METRIC_FRAMES: return "frames";
+        case METRIC_UPLOAD_BYTES: return "upload_bytes";
+        case METRIC_HITCHES: return "hitches";
+        default: return "unknown";
+    }
+}
+
+const char* metric_gauge_name(MetricGauge gauge) {
+    switch (gauge) {
+        case METRIC_CHUNKS_RESIDENT: return "chunks_resident";
+        case METRIC_UPLOAD_QUEUED_BYTES: return "upload_queued_bytes";
+        case METRIC_UPLOAD_QUEUED_BATCHES: return "upload_queued_batches";
+        default: return "unknown";
+    }
+}
+
+const char* metric_histogram_name(MetricHistogram histogram) {
+    switch (histogram) {
+        case METRIC_FRAME_MS: return "frame_ms";
+        case METRIC_GPU_MS: return "gpu_ms";
+        default: return "unknown";
+    }
+}
+
+void metrics_set_memory(MetricsRegistry& metrics, const MemoryReport& report) {
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        metrics.gpuBytes[tag].store(report.gpuBytes[tag], std::memory_order_relaxed);
+        metrics.cpuBytes[tag].store(report.cpuBytes[tag], std::memory_order_relaxed);
+    }
+}
+
+uint64_t MetricsSnapshot::Histogram::count() const {
+    uint64_t total = 0;
+    for (uint64_t bucket : buckets) {
+        total += bucket;
+    }
+    return total;
+}
+
+MetricsSnapshot metrics_snapshot(const MetricsRegistry& metrics) {
+    MetricsSnapshot snapshot;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+        snapshot.counters[i] = metrics.counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; ++i) {
+        snapshot.gauges[i] = metrics.gauges[i].load(std::memory_order_relaxed);
+    }
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        snapshot.memory.gpuBytes[tag] = metrics.gpuBytes[tag].load(std::memory_order_relaxed);
+        snapshot.memory.cpuBytes[tag] = metrics.cpuBytes[tag].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; ++i) {
+        for (size_t b = 0; b < METRIC_BUCKETS; ++b) {
+            snapshot.histograms[i].buckets[b] = metrics.histograms[i].buckets[b].load(std::memory_order_relaxed);
+        }
+        snapshot.histograms[i].sumMs = metrics.histograms[i].sumUs.load(std::memory_order_relaxed) / 1000.0;
+    }
+    return snapshot;
+}
+
+float metrics_histogram_quantile(const MetricsSnapshot::Histogram& now, const MetricsSnapshot::Histogram& before,
+                                 float quantile) {
+    const uint64_t total = now.count() - before.count();
+    if (total == 0) {
+        return 0.0f;
+    }
+    const uint64_t rank = std::max<uint64_t>((uint64_t)std::ceil(std::clamp(quantile, 0.0f, 1.0f) * total), 1);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < METRIC_BUCKETS - 1; ++b) {
+        seen += now.buckets[b] - before.buckets[b];
+        if (seen >= rank) {
+            return METRIC_BUCKET_MS[b];
+        }
+    }
+    return METRIC_BUCKET_MS[METRIC_BUCKETS - 2];
+}
+
+std::string metrics_format_prometheus(const MetricsSnapshot& snapshot, const char* prefix) {
+    std::string out;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+        const char* name = metric_counter_name((MetricCounter)i);
+        append(out, "# HELP %s_%s_total %s\n", prefix, name, COUNTER_HELP[i]);
+        append(out, "# TYPE %s_%s_total counter\n", prefix, name);
+        append(out, "%s_%s_total %llu\n", prefix, name, (unsigned long long)snapshot.counters[i]);
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; ++i) {
+        const char* name = metric_gauge_name((MetricGauge)i);
+        append(out, "# HELP %s_%s %s\n", prefix, name, GAUGE_HELP[i]);
+        append(out, "# TYPE %s_%s gauge\n", prefix, name);
+        append(out, "%s_%s %llu\n", prefix, name, (unsigned long long)snapshot.gauges[i]);
+    }
+    append(out, "# HELP %s_memory_bytes Bytes allocated, by kind and subsystem.\n", prefix);
+    append(out, "# TYPE %s_memory_bytes gauge\n", prefix);
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        const char* name = memory_tag_name((MemoryTag)tag);
+        append(out, "%s_memory_bytes{kind=\"gpu\",tag=\"%s\"} %llu\n", prefix, name,
+               (unsigned long long)snapshot.memory.gpuBytes[tag]);
+        append(out, "%s_memory_bytes{kind=\"cpu\",tag=\"%s\"} %llu\n", prefix, name,
+               (unsigned long long)snapshot.memory.cpuBytes[tag]);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; ++i) {
+        const char* name = metric_histogram_name((MetricHistogram)i);
+        const MetricsSnapshot::Histogram& histogram = snapshot.histograms[i];
+        append(out, "# HELP %s_%s %s\n", prefix, name, HISTOGRAM_HELP[i]);
+        append(out, "# TYPE %s_%s histogram\n", prefix, name);
+        // Prometheus buckets are cumulative
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < METRIC_BUCKETS - 1; ++b) {
+            cumulative += histogram.buckets[b];
+            append(out, "%s_%s_bucket{le=\"%g\"} %llu\n", prefix, name, METRIC_BUCKET_MS[b],
+                   (unsigned long long)cumulative);
+        }
+        cumulative += histogram.buckets[METRIC_BUCKETS - 1];
+        append(out, "%s_%s_bucket{le=\"+Inf\"} %llu\n", prefix, name, (unsigned long long)cumulative);
+        append(out, "%s_%s_sum %.3f\n", prefix, name, histogram.sumMs);
+        append(out, "%s_%s_count %llu\n", prefix, name, (unsigned long long)cumulative);
+    }
+    return out;
+}
+
+std::string metrics_format_statsd(const MetricsSnapshot& now, const MetricsSnapshot& before, const char* prefix) {
+    std::string out;
+    for (int i = 0; i < METRIC_COUNTER_COUNT; ++i) {
+        append(out, "%s.%s:%llu|c\n", prefix, metric_counter_name((MetricCounter)i),
+               (unsigned long long)(now.counters[i] - before.counters[i]));
+    }
+    for (int i = 0; i < METRIC_GAUGE_COUNT; ++i) {
+        append(out, "%s.%s:%llu|g\n", prefix, metric_gauge_name((MetricGauge)i), (unsigned long long)now.gauges[i]);
+    }
+    for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+        const char* name = memory_tag_name((MemoryTag)tag);
+        append(out, "%s.memory.gpu.%s:%llu|g\n", prefix, name, (unsigned long long)now.memory.gpuBytes[tag]);
+        append(out, "%s.memory.cpu.%s:%llu|g\n", prefix, name, (unsigned long long)now.memory.cpuBytes[tag]);
+    }
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; ++i) {
+        const char* name = metric_histogram_name((MetricHistogram)i);
+        const MetricsSnapshot::Histogram& current = now.histograms[i];
+        const MetricsSnapshot::Histogram& previous = before.histograms[i];
+        const uint64_t count = current.count() - previous.count();
+        append(out, "%s.%s.count:%llu|c\n", prefix, name, (unsigned long long)count);
+        if (count == 0) {
+            continue;
+        }
+        append(out, "%s.%s.mean:%.3f|g\n", prefix, name, (current.sumMs - previous.sumMs) / count);
+        append(out, "%s.%s.p50:%g|g\n", prefix, name, metrics_histogram_quantile(current, previous, 0.50f));
+        append(out, "%s.%s.p95:%g|g\n", prefix, name, metrics_histogram_quantile(current, previous, 0.95f));
+        append(out, "%s.%s.p99:%g|g\n", prefix, name, metrics_histogram_quantile(current, previous, 0.99f));
+    }
+    return out;
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& metrics, const MetricsExporterConfig& config)
+    : m_metrics(metrics), m_config(config) {
+    if (config.httpPort >= 0) {
+        m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenFd < 0) {
+            m_error = std::string("socket: ") + strerror(errno);
+            return;
+        }
+        const int on = 1;
+        setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        // Loopback only: the endpoint is for an agent on the same machine, not the network
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)config.httpPort);
+        if (bind(m_listenFd, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 4) != 0) {
+            m_error = std::string("bind: ") + strerror(errno);
+            close(m_listenFd);
+            m_listenFd = -1;
+            return;
+        }
+        socklen_t length = sizeof(addr);
+        getsockname(m_listenFd, (sockaddr*)&addr, &length);
+        fcntl(m_listenFd, F_SETFL, fcntl(m_listenFd, F_GETFL, 0) | O_NONBLOCK);
+        m_httpPort = ntohs(addr.sin_port);
+    }
+    if (config.statsd && !udp_socket_open(m_statsdSocket, 0, m_error)) {
+        if (m_listenFd >= 0) {
+            close(m_listenFd);
+            m_listenFd = -1;
+            m_httpPort = 0;
+        }
+        return;
+    }
+    if (m_listenFd >= 0 || config.statsd) {
+        m_thread = std::thread(&MetricsExporter::thread_main, this);
+    }
+}
+
+MetricsExporter::~MetricsExporter() {
+    m_stopping.store(true, std::memory_order_relaxed);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+    }
+    udp_socket_close(m_statsdSocket);
+}
+
+void MetricsExporter::thread_main() {
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::microseconds((int64_t)(std::max(m_config.intervalMs, 1.0f) * 1000.0f));
+    // The first report covers everything counted before the exporter started
+    MetricsSnapshot before;
+    Clock::time_point nextReport = Clock::now() + interval;
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        int waitMs = POLL_MS;
+        if (m_config.statsd) {
+            const auto untilReport = std::chrono::duration_cast<std::chrono::milliseconds>(nextReport - Clock::now());
+            waitMs = (int)std::clamp<int64_t>(untilReport.count(), 0, POLL_MS);
+        }
+        if (m_listenFd >= 0) {
+            pollfd listening = { m_listenFd, POLLIN, 0 };
+            if (poll(&listening, 1, waitMs) > 0 && (listening.revents & POLLIN)) {
+                serve_http();
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+        if (m_config.statsd && Clock::now() >= nextReport) {
+            send_statsd(before);
+            // A stall skips the reports it missed rather than sending them back to back
+            nextReport = std::max(nextReport + interval, Clock::now());
+        }
+    }
+}
+
+void MetricsExporter::serve_http() {
+    const int client = accept(m_listenFd, nullptr, nullptr);
+    if (client < 0) {
+        return;
+    }
+    // Accepted sockets inherit O_NONBLOCK on some systems; this one blocks, with timeouts
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) & ~O_NONBLOCK);
+    set_timeouts(client, CLIENT_TIMEOUT_MS);
+
+    std::string request;
+    char buffer[1024];
+    while (request.size() < REQUEST_LIMIT && request.find("\r\n\r\n") == std::string::npos) {
+        const ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            break;
+        }
+        request.append(buffer, (size_t)received);
+    }
+
+    const bool metrics = request.compare(0, 12, "GET /metrics") == 0 &&
+                         (request.size() > 12 && (request[12] == ' ' || request[12] == '?'));
+    const std::string body = metrics ? metrics_format_prometheus(metrics_snapshot(m_metrics), m_config.prefix.c_str())
+                                     : std::string("Not found; metrics are at /metrics\n");
+    std::string response;
+    append(response, "HTTP/1.1 %s\r\n", metrics ? "200 OK" : "404 Not Found");
+    append(response, "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+    append(response, "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+    response += body;
+    send_all(client, response);
+    close(client);
+}
+
+void MetricsExporter::send_statsd(MetricsSnapshot& before) {
+    const MetricsSnapshot now = metrics_snapshot(m_metrics);
+    const std::string lines = metrics_format_statsd(now, before, m_config.prefix.c_str());
+    before = now;
+    // Whole lines per datagram, so that no metric is split between two
+    size_t start = 0;
+    while (start < lines.size()) {
+        size_t end = start;
+        while (end < lines.size()) {
+            const size_t next = lines.find('\n', end) + 1;
+            if (next - start > STATSD_DATAGRAM && end > start) {
+                break;
+            }
+            end = next;
+        }
+        udp_socket_send(m_statsdSocket, m_config.statsdAddress, (const uint8_t*)lines.data() + start, end - start);
+        start = end;
+    }
+}
@@ -0,0 +1,230 @@
+/**
+ * @file metrics.hpp
+ * @brief Frame and memory telemetry for unattended machines, served over HTTP or pushed to statsd.
+ *
+ * Kiosks run without the ImGui overlay, so their frame times and memory have to leave the
+ * process. The render thread records into a MetricsRegistry, which is nothing but atomics:
+ * counters and gauges are one relaxed store or add, and a histogram observation is two adds,
+ * into the value's bucket and the running sum. Nothing locks, allocates or formats on the
+ * frame threads.
+ *
+ * A MetricsExporter thread copies the registry into a MetricsSnapshot whenever it reports and
+ * formats that: as Prometheus text for a GET of /metrics on a port bound to the loopback
+ * interface, and as statsd lines sent over UDP every interval. Counters and histograms are
+ * cumulative in the registry; statsd gets the change since the previous report.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "memory_report.hpp"
+#include "udp_socket.hpp"
+
+/**
+ * @enum MetricCounter
+ * @brief Totals that only grow.
+ */
+enum MetricCounter {
+    METRIC_FRAMES,                  ///< Frames finished.
+    METRIC_UPLOAD_BYTES,            ///< Bytes the resource uploader copied to the GPU.
+    METRIC_HITCHES,                 ///< Frames the hitch detector reported.
+    METRIC_COUNTER_COUNT
+};
+
+/**
+ * @enum MetricGauge
+ * @brief Values that are replaced each frame.
+ */
+enum MetricGauge {
+    METRIC_CHUNKS_RESIDENT,         ///< Terrain chunks with GPU meshes.
+    METRIC_UPLOAD_QUEUED_BYTES,     ///< Bytes waiting in the uploader's queue.
+    METRIC_UPLOAD_QUEUED_BATCHES,   ///< Batches waiting in the uploader's queue.
+    METRIC_GAUGE_COUNT
+};
+
+/**
+ * @enum MetricHistogram
+ * @brief Distributions of per-frame milliseconds.
+ */
+enum MetricHistogram {
+    METRIC_FRAME_MS,                ///< CPU milliseconds from begin to end of a frame.
+    METRIC_GPU_MS,                  ///< GPU milliseconds of a frame.
+    METRIC_HISTOGRAM_COUNT
+};
+
+/// @return The snake_case name of a counter, without prefix or suffix.
+const char* metric_counter_name(MetricCounter counter);
+
+/// @return The snake_case name of a gauge.
+const char* metric_gauge_name(MetricGauge gauge);
+
+/// @return The snake_case name of a histogram.
+const char* metric_histogram_name(MetricHistogram histogram);
+
+/// Upper bounds in milliseconds of the histogram buckets but the last, which takes everything slower.
+constexpr float METRIC_BUCKET_MS[] = { 2.0f, 4.0f, 8.0f, 12.0f, 16.7f, 20.0f, 25.0f, 33.4f, 50.0f, 100.0f, 250.0f };
+
+/// Buckets per histogram, counting the last, unbounded one.
+constexpr size_t METRIC_BUCKETS = sizeof(METRIC_BUCKET_MS) / sizeof(METRIC_BUCKET_MS[0]) + 1;
+
+/**
+ * @struct MetricsRegistry
+ * @brief The live values; written by any thread without locking, read by the exporter.
+ */
+struct MetricsRegistry {
+    /**
+     * @struct Histogram
+     * @brief Observations per bucket and their sum.
+     */
+    struct Histogram {
+        std::atomic<uint64_t> buckets[METRIC_BUCKETS] = {};
+        std::atomic<uint64_t> sumUs{ 0 };               ///< Sum in microseconds, to stay an integer.
+    };
+
+    alignas(64) std::atomic<uint64_t> counters[METRIC_COUNTER_COUNT] = {};
+    std::atomic<uint64_t> gauges[METRIC_GAUGE_COUNT] = {};
+    std::atomic<uint64_t> gpuBytes[MEMORY_TAG_COUNT] = {};  ///< MemoryReport::gpuBytes of the latest frame.
+    std::atomic<uint64_t> cpuBytes[MEMORY_TAG_COUNT] = {};  ///< MemoryReport::cpuBytes of the latest frame.
+    alignas(64) Histogram histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+/// Adds to a counter. Any thread.
+inline void metrics_add(MetricsRegistry& metrics, MetricCounter counter, uint64_t amount = 1) {
+    metrics.counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+/// Replaces a gauge. Any thread.
+inline void metrics_set(MetricsRegistry& metrics, MetricGauge gauge, uint64_t value) {
+    metrics.gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+/// Returns the histogram bucket a value falls in.
+inline size_t metric_bucket(float ms) {
+    size_t bucket = 0;
+    while (bucket < METRIC_BUCKETS - 1 && ms > METRIC_BUCKET_MS[bucket]) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+/// Records one value in a histogram; negative values count as 0. Any thread.
+inline void metrics_observe(MetricsRegistry& metrics, MetricHistogram histogram, float ms) {
+    ms = ms > 0.0f ? ms : 0.0f;
+    MetricsRegistry::Histogram& target = metrics.histograms[histogram];
+    target.buckets[metric_bucket(ms)].fetch_add(1, std::memory_order_relaxed);
+    target.sumUs.fetch_add((uint64_t)(ms * 1000.0f), std::memory_order_relaxed);
+}
+
+/// Replaces the memory gauges with a frame's report. Any thread.
+void metrics_set_memory(MetricsRegistry& metrics, const MemoryReport& report);
+
+/**
+ * @struct MetricsSnapshot
+ * @brief A plain copy of a registry. Values written meanwhile may or may not be in it.
+ */
+struct MetricsSnapshot {
+    /**
+     * @struct Histogram
+     * @brief Observations per bucket and their sum.
+     */
+    struct Histogram {
+        uint64_t buckets[METRIC_BUCKETS] = {};
+        double sumMs = 0.0;
+
+        /// @return Observations in every bucket.
+        uint64_t count() const;
+    };
+
+    uint64_t counters[METRIC_COUNTER_COUNT] = {};
+    uint64_t gauges[METRIC_GAUGE_COUNT] = {};
+    MemoryReport memory;
+    Histogram histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+/// @return The registry's current values.
+MetricsSnapshot metrics_snapshot(const MetricsRegistry& metrics);
+
+/**
+ * @brief Estimates a quantile of the observations between two snapshots of a histogram.
+ * @param now The later snapshot.
+ * @param before The earlier one; a default-constructed one covers everything.
+ * @param quantile In [0, 1].
+ * @return The upper bound of the bucket the quantile falls in, the last bound for the unbounded bucket,
+ *         or 0 without observations.
+ */
+float metrics_histogram_quantile(const MetricsSnapshot::Histogram& now, const MetricsSnapshot::Histogram& before,
+                                 float quantile);
+
+/**
+ * @brief Formats a snapshot in the Prometheus text exposition format.
+ * @param snapshot The values.
+ * @param prefix Prepended to every metric name, with an underscore.
+ * @return One HELP, TYPE and sample block per metric.
+ */
+std::string metrics_format_prometheus(const MetricsSnapshot& snapshot, const char* prefix);
+
+/**
+ * @brief Formats the change between two snapshots as statsd lines.
+ *
+ * Counters are sent as the increase, gauges as their value, and each histogram as the count of
+ * new observations plus gauges of their mean and estimated p50, p95 and p99. Histograms without
+ * new observations send only their count.
+ * @param now The later snapshot.
+ * @param before The previous report's snapshot.
+ * @param prefix Prepended to every metric name, with a dot.
+ * @return Newline-separated lines.
+ */
+std::string metrics_format_statsd(const MetricsSnapshot& now, const MetricsSnapshot& before, const char* prefix);
+
+/**
+ * @struct MetricsExporterConfig
+ * @brief Where to report and how often.
+ */
+struct MetricsExporterConfig {
+    int httpPort = -1;                  ///< Loopback port serving /metrics; 0 picks a free one, negative serves none.
+    bool statsd = false;                ///< Whether to push to statsdAddress.
+    UdpAddress statsdAddress;           ///< The statsd daemon.
+    float intervalMs = 1000.0f;         ///< Time between statsd reports.
+    std::string prefix = "glfw_metal";  ///< Prepended to every metric name.
+};
+
+/**
+ * @class MetricsExporter
+ * @brief Reports a registry on a thread of its own from construction to destruction.
+ */
+class MetricsExporter {
+public:
+    /// @param metrics The registry; outlives the exporter.
+    MetricsExporter(const MetricsRegistry& metrics, const MetricsExporterConfig& config);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    /// @return False if a socket could not be opened; error() says why and nothing is reported.
+    bool running() const { return m_thread.joinable(); }
+
+    /// @return Why the exporter is not running, or empty.
+    const std::string& error() const { return m_error; }
+
+    /// @return The port serving /metrics, or 0 if none does.
+    uint16_t http_port() const { return m_httpPort; }
+
+private:
+    void thread_main();
+    void serve_http();
+    void send_statsd(MetricsSnapshot& before);
+
+    const MetricsRegistry& m_metrics;
+    MetricsExporterConfig m_config;
+    std::string m_error;
+    int m_listenFd = -1;
+    uint16_t m_httpPort = 0;
+    UdpSocket m_statsdSocket;
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
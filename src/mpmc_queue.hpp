@@ -0,0 +1,105 @@
+/**
+ * @file mpmc_queue.hpp
+ * @brief Bounded lock-free queue between any number of producer and consumer threads.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * @class MpmcQueue
+ * @brief A fixed-size ring buffer any thread may push to and pop from.
+ *
+ * Every slot carries a sequence number that says whose turn it is: a producer claims the
+ * tail position with a compare-and-swap once the slot's sequence equals the position, writes
+ * the value and bumps the sequence for consumers, which claim the head the same way and hand
+ * the slot back a lap later. Threads only ever wait by retrying a failed swap, never on
+ * another thread part way through, except that a producer or consumer preempted between its
+ * claim and its sequence store delays that one slot. Like SpscQueue, a full queue rejects new
+ * values instead of overwriting old ones.
+ *
+ * @tparam T The value type; default-constructible and movable.
+ * @tparam Capacity The number of slots; a power of two.
+ */
+template <typename T, size_t Capacity>
+class MpmcQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpmcQueue() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief Appends a value. Any thread.
+     * @param value The value to copy in.
+     * @return False if the queue is full and the value was dropped.
+     */
+    bool push(const T& value) {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = m_slots[tail & (Capacity - 1)];
+            const int64_t lag = (int64_t)(slot.sequence.load(std::memory_order_acquire) - tail);
+            if (lag == 0) {
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                // The slot still holds the value from a lap ago
+                return false;
+            } else {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Removes the oldest value. Any thread.
+     * @param value Receives the value.
+     * @return False if the queue was empty.
+     */
+    bool pop(T& value) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = m_slots[head & (Capacity - 1)];
+            const int64_t lag = (int64_t)(slot.sequence.load(std::memory_order_acquire) - (head + 1));
+            if (lag == 0) {
+                if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                    value = std::move(slot.value);
+                    slot.sequence.store(head + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                head = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @return The values queued; only a hint while other threads push or pop.
+    size_t size_hint() const {
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        return tail > head ? (size_t)(tail - head) : 0;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        T value{};
+    };
+
+    Slot m_slots[Capacity];
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };  // Next position to pop
+    alignas(64) std::atomic<uint64_t> m_tail{ 0 };  // Next position to push
+};
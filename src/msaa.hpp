@@ -0,0 +1,51 @@
+/**
+ * @file msaa.hpp
+ * @brief Multisampled scene passes whose samples never leave tile memory.
+ *
+ * The multisampled colour and depth attachments are memoryless. At the end of the scene pass
+ * the GPU resolves each tile into the single-sample scene targets with
+ * MTLStoreActionMultisampleResolve, so only resolved pixels reach memory, and depth is resolved
+ * only on frames that keep it.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstdint>
+
+/**
+ * @struct MsaaTargets
+ * @brief The memoryless multisampled attachments of the scene pass.
+ */
+struct MsaaTargets {
+    id<MTLTexture> color;           ///< Multisampled scene colour.
+    id<MTLTexture> depth;           ///< Multisampled depth.
+    uint32_t sampleCount = 1;       ///< Samples per pixel of both.
+    uint32_t width = 0;             ///< Width in pixels.
+    uint32_t height = 0;            ///< Height in pixels.
+};
+
+/// @return True if the device can render sampleCount samples into memoryless targets and resolve depth.
+bool msaa_supported(id<MTLDevice> device, uint32_t sampleCount);
+
+/**
+ * @brief Reallocates the attachments if the sample count or the scene target size changed.
+ * @param msaa The targets.
+ * @param device The Metal device.
+ * @param sampleCount Samples per pixel; must be supported.
+ * @param width The scene target width in pixels.
+ * @param height The scene target height in pixels.
+ */
+void msaa_resize(MsaaTargets& msaa, id<MTLDevice> device, uint32_t sampleCount, uint32_t width, uint32_t height);
+
+/**
+ * @brief Makes a single-sample scene pass render into the multisampled attachments.
+ *
+ * The pass's colour and depth textures become the resolve targets. Colour is always resolved;
+ * depth only if the pass stored it, taking the farthest sample so Hi-Z culling stays conservative.
+ *
+ * @param msaa The targets, sized like the pass's colour target.
+ * @param passDesc The scene pass.
+ * @param reverseZ True if depth falls with distance, so the farthest sample is the smallest.
+ */
+void msaa_attach(const MsaaTargets& msaa, MTLRenderPassDescriptor* passDesc, bool reverseZ = false);
@@ -0,0 +1,49 @@
+#import "msaa.hpp"
+
+namespace {
+    id<MTLTexture> create_attachment(id<MTLDevice> device, MTLPixelFormat format, uint32_t sampleCount, uint32_t width,
+                                     uint32_t height, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.textureType = MTLTextureType2DMultisample;
+        desc.sampleCount = sampleCount;
+        desc.storageMode = MTLStorageModeMemoryless;
+        desc.usage = MTLTextureUsageRenderTarget;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+}
+
+bool msaa_supported(id<MTLDevice> device, uint32_t sampleCount) {
+    // Memoryless targets and depth resolve filters need an Apple GPU of family 3 or later
+    return [device supportsFamily:MTLGPUFamilyApple3] && [device supportsTextureSampleCount:sampleCount];
+}
+
+void msaa_resize(MsaaTargets& msaa, id<MTLDevice> device, uint32_t sampleCount, uint32_t width, uint32_t height) {
+    if (msaa.color && msaa.sampleCount == sampleCount && msaa.width == width && msaa.height == height) {
+        return;
+    }
+    msaa.color = create_attachment(device, MTLPixelFormatBGRA8Unorm, sampleCount, width, height, @"MSAA colour");
+    msaa.depth = create_attachment(device, MTLPixelFormatDepth32Float, sampleCount, width, height, @"MSAA depth");
+    msaa.sampleCount = sampleCount;
+    msaa.width = width;
+    msaa.height = height;
+}
+
+void msaa_attach(const MsaaTargets& msaa, MTLRenderPassDescriptor* passDesc, bool reverseZ) {
+    MTLRenderPassColorAttachmentDescriptor* color = passDesc.colorAttachments[0];
+    color.resolveTexture = color.texture;
+    color.texture = msaa.color;
+    color.storeAction = MTLStoreActionMultisampleResolve;
+
+    MTLRenderPassDepthAttachmentDescriptor* depth = passDesc.depthAttachment;
+    if (depth.storeAction == MTLStoreActionStore) {
+        depth.resolveTexture = depth.texture;
+        depth.storeAction = MTLStoreActionMultisampleResolve;
+        depth.depthResolveFilter = reverseZ ? MTLMultisampleDepthResolveFilterMin : MTLMultisampleDepthResolveFilterMax;
+    }
+    depth.texture = msaa.depth;
+}
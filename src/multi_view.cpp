@@ -0,0 +1,64 @@
+#include "multi_view.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Look direction and up vector of each cube face, following the cube map sampling convention
+    const simd::float3 FACE_FORWARD[CUBE_FACE_COUNT] = {
+        { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+        { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+    };
+    const simd::float3 FACE_UP[CUBE_FACE_COUNT] = {
+        { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f },
+        { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+    };
+}
+
+RenderView camera_render_view(const Camera& cam, uint32_t slice, uint32_t viewport) {
+    RenderView view;
+    view.viewProjection = cam.projectionMatrix * cam.viewMatrix;
+    view.eye = cam.position;
+    view.slice = slice;
+    view.viewport = viewport;
+    return view;
+}
+
+void cube_map_views(simd::float3 eye, float nearZ, float farZ, bool reverseZ, RenderView* faces) {
+    const float fovy = (float)M_PI / 2.0f;
+    // A right-handed camera sees each face mirrored relative to how a cube map is sampled
+    const simd::float4x4 mirror = matrix_scale(-1.0f, 1.0f, 1.0f);
+    const simd::float4x4 projection = mirror * (reverseZ ? matrix_perspective_reverse_z_infinite(fovy, 1.0f, nearZ)
+                                                         : matrix_perspective_right_hand(fovy, 1.0f, nearZ, farZ));
+    for (uint32_t face = 0; face < CUBE_FACE_COUNT; ++face) {
+        faces[face].viewProjection = projection * matrix_look_at_right_hand(eye, eye + FACE_FORWARD[face], FACE_UP[face]);
+        faces[face].eye = eye;
+        faces[face].slice = face;
+        faces[face].viewport = 0;
+    }
+}
+
+uint32_t multi_view_groups(uint32_t viewCount, uint32_t maxAmplification, MultiViewGroup* groups) {
+    const uint32_t perGroup = std::max(maxAmplification, 1u);
+    uint32_t groupCount = 0;
+    for (uint32_t first = 0; first < viewCount; first += perGroup) {
+        groups[groupCount++] = { first, std::min(perGroup, viewCount - first) };
+    }
+    return groupCount;
+}
+
+size_t multi_view_cull(const RenderView* views, uint32_t count, const CullBounds& bounds, uint32_t* visible) {
+    Frustum frustums[MULTI_VIEW_MAX_VIEWS];
+    count = std::min(count, MULTI_VIEW_MAX_VIEWS);
+    for (uint32_t i = 0; i < count; ++i) {
+        frustums[i] = extract_frustum(views[i].viewProjection);
+    }
+    return frustum_cull_any(frustums, count, bounds, visible);
+}
+
+float multi_view_fog_distance(const RenderView* views, uint32_t count, float fogDistance) {
+    float spread = 0.0f;
+    for (uint32_t i = 1; i < count; ++i) {
+        spread = std::max(spread, simd::distance(views[i].eye, views[0].eye));
+    }
+    return fogDistance + spread;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file multi_view.hpp
+ * @brief Views of the scene that share one geometry submission through vertex amplification.
+ *
+ * A multi-view pass draws every object once per group of views instead of once per view:
+ * the vertex stage runs once for each view of the group, reads that view's FrameUniforms
+ * and is routed to the view's render target array slice and viewport. Groups hold at most
+ * as many views as the device amplifies, and each group culls against the union of its
+ * views' frustums, so an object any of them sees is drawn for all of them.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "camera.hpp"
+#include "frustum.hpp"
+
+/// The most views one multi-view pass renders; enough for the faces of a cube map.
+constexpr uint32_t MULTI_VIEW_MAX_VIEWS = 6;
+
+/// Faces of a cube map, in Metal's slice order: +X, -X, +Y, -Y, +Z, -Z.
+constexpr uint32_t CUBE_FACE_COUNT = 6;
+
+/**
+ * @struct RenderView
+ * @brief One camera of a multi-view pass and where its pixels go.
+ */
+struct RenderView {
+    simd::float4x4 viewProjection;  ///< World to clip transform.
+    simd::float3 eye;               ///< World space eye position, for fog and lighting.
+    uint32_t slice = 0;             ///< Render target array slice drawn into.
+    uint32_t viewport = 0;          ///< Viewport array index drawn into, e.g. one half of a split screen.
+};
+
+/**
+ * @struct MultiViewGroup
+ * @brief A run of consecutive views drawn by the same submissions.
+ */
+struct MultiViewGroup {
+    uint32_t first = 0;     ///< Index of the first view.
+    uint32_t count = 0;     ///< Number of views; at most the amplification count.
+};
+
+/**
+ * @brief Makes the view of a camera.
+ * @param cam The camera; its view and projection matrices must be current.
+ * @param slice The render target array slice.
+ * @param viewport The viewport array index.
+ * @return The view.
+ */
+RenderView camera_render_view(const Camera& cam, uint32_t slice = 0, uint32_t viewport = 0);
+
+/**
+ * @brief Makes the six 90 degree views of a cube map probe.
+ *
+ * Each face's image is mirrored horizontally so that it samples correctly as a cube map;
+ * the mirror reverses the winding of triangles, which the scene pipelines do not cull by.
+ *
+ * @param eye The probe position.
+ * @param nearZ The near clipping plane.
+ * @param farZ The far clipping plane; unused with reverseZ.
+ * @param reverseZ True for reverse-Z projections with the far plane at infinity.
+ * @param faces Receives CUBE_FACE_COUNT views, face i drawing into slice i.
+ */
+void cube_map_views(simd::float3 eye, float nearZ, float farZ, bool reverseZ, RenderView* faces);
+
+/**
+ * @brief Splits views into consecutive groups of at most maxAmplification views.
+ * @param viewCount The number of views.
+ * @param maxAmplification The most views one draw is amplified to; treated as at least 1.
+ * @param groups Receives the groups; needs viewCount slots.
+ * @return The number of groups written.
+ */
+uint32_t multi_view_groups(uint32_t viewCount, uint32_t maxAmplification, MultiViewGroup* groups);
+
+/**
+ * @brief Collects the boxes that may be visible in any of a group's views.
+ * @param views The group's views.
+ * @param count The number of views; at most MULTI_VIEW_MAX_VIEWS.
+ * @param bounds The world space boxes.
+ * @param visible Receives the indices of the boxes, in order; needs bounds.size() slots.
+ * @return The number of indices written.
+ */
+size_t multi_view_cull(const RenderView* views, uint32_t count, const CullBounds& bounds, uint32_t* visible);
+
+/**
+ * @brief Widens a fog distance so that culling by distance from the first view's eye keeps
+ *        everything any of the views can see.
+ * @param views The group's views.
+ * @param count The number of views.
+ * @param fogDistance The distance beyond which each view sees only fog.
+ * @return fogDistance plus the furthest any eye is from the first.
+ */
+float multi_view_fog_distance(const RenderView* views, uint32_t count, float fogDistance);
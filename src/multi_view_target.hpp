@@ -0,0 +1,69 @@
+/**
+ * @file multi_view_target.hpp
+ * @brief Layered render targets for multi-view passes, and the encoder state that routes each
+ *        amplified view to its slice.
+ *
+ * The pass renders every slice at once: draws are amplified to the views of a group, and the
+ * view mappings send view i of the group to RenderView::slice and RenderView::viewport. Devices
+ * without vertex amplification still take the same path with one view per group.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frame_ring.hpp"
+#include "multi_view.hpp"
+
+/**
+ * @struct MultiViewTarget
+ * @brief Colour and depth with one slice per view.
+ */
+struct MultiViewTarget {
+    id<MTLTexture> color;               ///< BGRA8 2D array or cube texture.
+    id<MTLTexture> depth;               ///< Depth32Float of the same type; memoryless where supported.
+    std::vector<id<MTLTexture>> slices; ///< A 2D view of each colour slice, e.g. for display.
+    uint32_t size = 0;                  ///< Width and height in pixels.
+    uint32_t sliceCount = 0;            ///< Number of slices.
+};
+
+/**
+ * @brief Returns how many views one draw can be amplified to.
+ * @param device The Metal device.
+ * @return 2 where vertex amplification is supported, otherwise 1.
+ */
+uint32_t multi_view_amplification(id<MTLDevice> device);
+
+/**
+ * @brief Creates a target.
+ * @param device The Metal device.
+ * @param size The width and height in pixels.
+ * @param sliceCount The number of slices; must be CUBE_FACE_COUNT for a cube.
+ * @param cube True for a cube texture, false for a 2D array.
+ * @return The target.
+ */
+MultiViewTarget create_multi_view_target(id<MTLDevice> device, uint32_t size, uint32_t sliceCount, bool cube);
+
+/**
+ * @brief Makes a pass that clears and renders every slice of the target.
+ * @param target The target.
+ * @param clearDepth The far depth, see camera_clear_depth().
+ * @return The pass descriptor.
+ */
+MTLRenderPassDescriptor* make_multi_view_pass(const MultiViewTarget& target, float clearDepth);
+
+/**
+ * @brief Binds a group's FrameUniforms and amplifies the following draws to its views.
+ * @param enc The encoder.
+ * @param views Every view of the pass.
+ * @param group The group to draw.
+ * @param uniforms One FrameUniforms per view of the group, in view order.
+ */
+void multi_view_bind_group(id<MTLRenderCommandEncoder> enc, const RenderView* views, const MultiViewGroup& group,
+                           const FrameAllocation& uniforms);
+
+/// @return GPU bytes held by the target.
+size_t multi_view_target_bytes(const MultiViewTarget& target);
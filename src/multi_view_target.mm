@@ -0,0 +1,83 @@
+#import "multi_view_target.hpp"
+
+#include "frame_ring.hpp"
+#include "render_targets.hpp"
+
+namespace {
+    // Apple GPUs amplify to two views; larger counts are not offered by any current device
+    constexpr uint32_t MULTI_VIEW_AMPLIFICATION = 2;
+
+    id<MTLTexture> make_layered_texture(id<MTLDevice> device, MTLPixelFormat format, uint32_t size,
+                                        uint32_t sliceCount, bool cube, MTLStorageMode storage,
+                                        MTLTextureUsage usage) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor new];
+        desc.textureType = cube ? MTLTextureTypeCube : MTLTextureType2DArray;
+        desc.pixelFormat = format;
+        desc.width = size;
+        desc.height = size;
+        desc.arrayLength = cube ? 1 : sliceCount;
+        desc.storageMode = storage;
+        desc.usage = usage;
+        return [device newTextureWithDescriptor:desc];
+    }
+}
+
+uint32_t multi_view_amplification(id<MTLDevice> device) {
+    return [device supportsVertexAmplificationCount:MULTI_VIEW_AMPLIFICATION] ? MULTI_VIEW_AMPLIFICATION : 1;
+}
+
+MultiViewTarget create_multi_view_target(id<MTLDevice> device, uint32_t size, uint32_t sliceCount, bool cube) {
+    MultiViewTarget target;
+    target.size = size;
+    target.sliceCount = cube ? CUBE_FACE_COUNT : sliceCount;
+
+    target.color = make_layered_texture(device, MTLPixelFormatBGRA8Unorm, size, target.sliceCount, cube,
+                                        MTLStorageModePrivate, MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead);
+    target.color.label = @"Multi-view colour";
+    // No later pass reads the depth, so it can stay in tile memory
+    target.depth = make_layered_texture(device, MTLPixelFormatDepth32Float, size, target.sliceCount, cube,
+                                        memoryless_supported(device) ? MTLStorageModeMemoryless : MTLStorageModePrivate,
+                                        MTLTextureUsageRenderTarget);
+    target.depth.label = @"Multi-view depth";
+
+    for (uint32_t slice = 0; slice < target.sliceCount; ++slice) {
+        target.slices.push_back([target.color newTextureViewWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                                textureType:MTLTextureType2D
+                                                                     levels:NSMakeRange(0, 1)
+                                                                     slices:NSMakeRange(slice, 1)]);
+    }
+    return target;
+}
+
+MTLRenderPassDescriptor* make_multi_view_pass(const MultiViewTarget& target, float clearDepth) {
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = target.color;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.6, 0.8, 1.0, 1.0); // Sky blue
+
+    passDesc.depthAttachment.texture = target.depth;
+    passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+    passDesc.depthAttachment.storeAction = MTLStoreActionDontCare;
+    passDesc.depthAttachment.clearDepth = clearDepth;
+    passDesc.renderTargetArrayLength = target.sliceCount;
+    return passDesc;
+}
+
+void multi_view_bind_group(id<MTLRenderCommandEncoder> enc, const RenderView* views, const MultiViewGroup& group,
+                           const FrameAllocation& uniforms) {
+    // The shaders index the bound array by amplification ID
+    frame_uniforms_bind(uniforms, enc);
+
+    MTLVertexAmplificationViewMapping mappings[MULTI_VIEW_MAX_VIEWS];
+    for (uint32_t i = 0; i < group.count; ++i) {
+        mappings[i].renderTargetArrayIndexOffset = views[group.first + i].slice;
+        mappings[i].viewportArrayIndexOffset = views[group.first + i].viewport;
+    }
+    [enc setVertexAmplificationCount:group.count viewMappings:mappings];
+}
+
+size_t multi_view_target_bytes(const MultiViewTarget& target) {
+    // Memoryless depth reports no allocation
+    return target.color.allocatedSize + target.depth.allocatedSize;
+}
@@ -0,0 +1,506 @@
+#include "nav_mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+namespace {
+    constexpr uint16_t NAV_NO_CELL_POLY = UINT16_MAX;
+
+    // Queries per job slice: each one walks a few hundred polygons at most
+    constexpr uint32_t NAV_QUERY_GRAIN = 8;
+
+    uint32_t poly_ref(uint32_t tile, uint32_t poly) {
+        return tile << NAV_POLY_BITS | poly;
+    }
+
+    uint32_t ref_tile(uint32_t ref) {
+        return ref >> NAV_POLY_BITS;
+    }
+
+    uint32_t ref_poly(uint32_t ref) {
+        return ref & ((1u << NAV_POLY_BITS) - 1);
+    }
+
+    int32_t climb_voxels(const NavMeshSettings& settings) {
+        return (int32_t)std::floor(settings.maxClimb / settings.cellHeight);
+    }
+
+    // The tile and cell index of a mesh-wide cell, or false outside the mesh
+    bool locate_cell(const NavMesh& mesh, int64_t gx, int64_t gz, uint32_t& tile, uint32_t& cell) {
+        if (gx < 0 || gz < 0 || gx >= (int64_t)mesh.cellsX || gz >= (int64_t)mesh.cellsZ) {
+            return false;
+        }
+        const uint32_t n = mesh.settings.tileCells;
+        tile = (uint32_t)(gz / n) * mesh.tilesX + (uint32_t)(gx / n);
+        cell = (uint32_t)(gz % n) * n + (uint32_t)(gx % n);
+        return true;
+    }
+
+    bool connected(int32_t a, int32_t b, int32_t climb) {
+        return std::abs(a - b) <= climb;
+    }
+
+    // Voxelises the tile's cells and merges the connected ones into rectangles, growing each
+    // along x first and then row by row while the whole row joins it
+    void build_tile(NavMesh& mesh, const HeightField& field, uint32_t tx, uint32_t tz) {
+        const NavMeshSettings& settings = mesh.settings;
+        const uint32_t n = settings.tileCells;
+        NavTile& tile = mesh.tiles[tz * mesh.tilesX + tx];
+        tile.heights.assign((size_t)n * n, 0);
+        tile.cellPolys.assign((size_t)n * n, NAV_NO_CELL_POLY);
+        tile.polys.clear();
+        ++tile.builds;
+
+        std::vector<float> xs((size_t)n * n);
+        std::vector<float> zs((size_t)n * n);
+        for (uint32_t z = 0; z < n; ++z) {
+            for (uint32_t x = 0; x < n; ++x) {
+                xs[z * n + x] = mesh.originX + ((float)(tx * n + x) + 0.5f) * settings.cellSize;
+                zs[z * n + x] = mesh.originZ + ((float)(tz * n + z) + 0.5f) * settings.cellSize;
+            }
+        }
+        std::vector<TerrainSample> ground((size_t)n * n);
+        height_field_samples(field, xs.data(), zs.data(), ground.data(), ground.size());
+
+        const float maxGradient = std::tan(settings.maxSlope * (float)M_PI / 180.0f);
+        std::vector<uint8_t> walkable((size_t)n * n, 0);
+        for (uint32_t z = 0; z < n; ++z) {
+            for (uint32_t x = 0; x < n; ++x) {
+                const uint32_t i = z * n + x;
+                tile.heights[i] = (int32_t)std::floor(ground[i].height / settings.cellHeight);
+                const bool inside = tx * n + x < mesh.cellsX && tz * n + z < mesh.cellsZ;
+                walkable[i] = inside && simd::length_squared(ground[i].gradient) <= maxGradient * maxGradient;
+            }
+        }
+
+        const int32_t climb = climb_voxels(settings);
+        const auto open = [&](uint32_t i) { return walkable[i] && tile.cellPolys[i] == NAV_NO_CELL_POLY; };
+        for (uint32_t z0 = 0; z0 < n; ++z0) {
+            for (uint32_t x0 = 0; x0 < n; ++x0) {
+                if (!open(z0 * n + x0)) {
+                    continue;
+                }
+                uint32_t x1 = x0;
+                while (x1 + 1 < n && open(z0 * n + x1 + 1) &&
+                       connected(tile.heights[z0 * n + x1], tile.heights[z0 * n + x1 + 1], climb)) {
+                    ++x1;
+                }
+                uint32_t z1 = z0;
+                for (bool grow = true; grow && z1 + 1 < n;) {
+                    const uint32_t row = (z1 + 1) * n;
+                    for (uint32_t x = x0; x <= x1 && grow; ++x) {
+                        grow = open(row + x) && connected(tile.heights[row - n + x], tile.heights[row + x], climb) &&
+                               (x == x0 || connected(tile.heights[row + x - 1], tile.heights[row + x], climb));
+                    }
+                    z1 += grow ? 1 : 0;
+                }
+
+                const uint16_t index = (uint16_t)tile.polys.size();
+                for (uint32_t z = z0; z <= z1; ++z) {
+                    std::fill(&tile.cellPolys[z * n + x0], &tile.cellPolys[z * n + x1] + 1, index);
+                }
+                NavPoly poly;
+                poly.x0 = (uint16_t)x0;
+                poly.z0 = (uint16_t)z0;
+                poly.x1 = (uint16_t)x1;
+                poly.z1 = (uint16_t)z1;
+                const int32_t middle = tile.heights[(z0 + z1) / 2 * n + (x0 + x1) / 2];
+                poly.center = { mesh.originX + ((float)(tx * n) + 0.5f * (float)(x0 + x1 + 1)) * settings.cellSize,
+                                (float)middle * settings.cellHeight,
+                                mesh.originZ + ((float)(tz * n) + 0.5f * (float)(z0 + z1 + 1)) * settings.cellSize };
+                tile.polys.push_back(poly);
+            }
+        }
+    }
+
+    // Links each polygon of a tile to the polygons of the connected cells across its edges
+    void link_tile(NavMesh& mesh, uint32_t tx, uint32_t tz) {
+        const uint32_t n = mesh.settings.tileCells;
+        const int32_t climb = climb_voxels(mesh.settings);
+        const uint32_t self = tz * mesh.tilesX + tx;
+        NavTile& tile = mesh.tiles[self];
+        tile.links.clear();
+        const int64_t baseX = (int64_t)tx * n;
+        const int64_t baseZ = (int64_t)tz * n;
+        std::vector<uint32_t> found;
+        for (NavPoly& poly : tile.polys) {
+            found.clear();
+            const auto visit = [&](uint32_t x, uint32_t z, int64_t gx, int64_t gz) {
+                uint32_t otherTile, otherCell;
+                if (!locate_cell(mesh, gx, gz, otherTile, otherCell)) {
+                    return;
+                }
+                const NavTile& other = mesh.tiles[otherTile];
+                const uint16_t otherPoly = other.cellPolys[otherCell];
+                if (otherPoly != NAV_NO_CELL_POLY &&
+                    connected(tile.heights[z * n + x], other.heights[otherCell], climb)) {
+                    found.push_back(poly_ref(otherTile, otherPoly));
+                }
+            };
+            for (uint32_t x = poly.x0; x <= poly.x1; ++x) {
+                visit(x, poly.z0, baseX + x, baseZ + poly.z0 - 1);
+                visit(x, poly.z1, baseX + x, baseZ + poly.z1 + 1);
+            }
+            for (uint32_t z = poly.z0; z <= poly.z1; ++z) {
+                visit(poly.x0, z, baseX + poly.x0 - 1, baseZ + z);
+                visit(poly.x1, z, baseX + poly.x1 + 1, baseZ + z);
+            }
+            std::sort(found.begin(), found.end());
+            found.erase(std::unique(found.begin(), found.end()), found.end());
+            poly.firstLink = (uint32_t)tile.links.size();
+            poly.linkCount = (uint32_t)found.size();
+            tile.links.insert(tile.links.end(), found.begin(), found.end());
+        }
+    }
+
+    void count_polys(NavMesh& mesh) {
+        mesh.polyBase.resize(mesh.tiles.size());
+        mesh.polyCount = 0;
+        for (size_t t = 0; t < mesh.tiles.size(); ++t) {
+            mesh.polyBase[t] = mesh.polyCount;
+            mesh.polyCount += (uint32_t)mesh.tiles[t].polys.size();
+        }
+    }
+
+    // Builds the listed tiles, then relinks the other list, which must hold them and their neighbours
+    void build_tiles(NavMesh& mesh, const HeightField& field, JobSystem& jobs, const std::vector<uint32_t>& tiles,
+                     const std::vector<uint32_t>& relink) {
+        jobs.parallel_for((uint32_t)tiles.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                build_tile(mesh, field, tiles[i] % mesh.tilesX, tiles[i] / mesh.tilesX);
+            }
+        });
+        // Links read the neighbours' cells, which are all built by now, and write only their own tile
+        jobs.parallel_for((uint32_t)relink.size(), 4, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                link_tile(mesh, relink[i] % mesh.tilesX, relink[i] / mesh.tilesX);
+            }
+        });
+        count_polys(mesh);
+    }
+
+    /**
+     * One thread's A* state over the dense polygon indices. A polygon's entries are valid only
+     * when its stamp is the current query's, so nothing is cleared between queries.
+     */
+    struct NavQueryScratch {
+        std::vector<float> costs;
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> stamps;
+        std::vector<uint8_t> closed;
+        std::vector<std::pair<float, uint32_t>> open;
+        std::vector<simd::float2> lefts;
+        std::vector<simd::float2> rights;
+        uint32_t stamp = 0;
+    };
+
+    uint32_t dense_index(const NavMesh& mesh, uint32_t ref) {
+        return mesh.polyBase[ref_tile(ref)] + ref_poly(ref);
+    }
+
+    // The ground of a cell in voxels; the cell must be inside the mesh
+    int32_t cell_height(const NavMesh& mesh, int64_t gx, int64_t gz) {
+        uint32_t tile, cell;
+        locate_cell(mesh, gx, gz, tile, cell);
+        return mesh.tiles[tile].heights[cell];
+    }
+
+    // A point on the ground of the cell it lies in; points on the mesh's far edges use the last cells
+    simd::float3 ground_point(const NavMesh& mesh, simd::float2 xz) {
+        const int64_t gx = std::clamp<int64_t>((int64_t)std::floor((xz.x - mesh.originX) / mesh.settings.cellSize), 0,
+                                               (int64_t)mesh.cellsX - 1);
+        const int64_t gz = std::clamp<int64_t>((int64_t)std::floor((xz.y - mesh.originZ) / mesh.settings.cellSize), 0,
+                                               (int64_t)mesh.cellsZ - 1);
+        return { xz.x, (float)cell_height(mesh, gx, gz) * mesh.settings.cellHeight, xz.y };
+    }
+
+    struct CellRect {
+        int64_t x0, z0, x1, z1;
+    };
+
+    CellRect poly_cells(const NavMesh& mesh, uint32_t ref) {
+        const int64_t n = mesh.settings.tileCells;
+        const int64_t tx = ref_tile(ref) % mesh.tilesX;
+        const int64_t tz = ref_tile(ref) / mesh.tilesX;
+        const NavPoly& poly = nav_mesh_poly(mesh, ref);
+        return { tx * n + poly.x0, tz * n + poly.z0, tx * n + poly.x1, tz * n + poly.z1 };
+    }
+
+    /**
+     * The stretch of the edge between two linked polygons where their cells connect, as world xz
+     * endpoints; a is on the left walking from polygon a to polygon b, as the funnel expects.
+     */
+    void portal(const NavMesh& mesh, uint32_t from, uint32_t to, simd::float2& left, simd::float2& right) {
+        const CellRect a = poly_cells(mesh, from);
+        const CellRect b = poly_cells(mesh, to);
+        const int32_t climb = climb_voxels(mesh.settings);
+        const float cs = mesh.settings.cellSize;
+        const bool alongZ = a.x1 + 1 == b.x0 || b.x1 + 1 == a.x0;   // The edge runs along z
+        // The cells on either side of the edge, at each step along it
+        const int64_t sideA = alongZ ? (a.x1 + 1 == b.x0 ? a.x1 : a.x0) : (a.z1 + 1 == b.z0 ? a.z1 : a.z0);
+        const int64_t sideB = alongZ ? (a.x1 + 1 == b.x0 ? b.x0 : b.x1) : (a.z1 + 1 == b.z0 ? b.z0 : b.z1);
+        const int64_t lo = alongZ ? std::max(a.z0, b.z0) : std::max(a.x0, b.x0);
+        const int64_t hi = alongZ ? std::min(a.z1, b.z1) : std::min(a.x1, b.x1);
+        int64_t first = hi + 1;
+        int64_t last = lo - 1;
+        for (int64_t i = lo; i <= hi; ++i) {
+            const int32_t ha = alongZ ? cell_height(mesh, sideA, i) : cell_height(mesh, i, sideA);
+            const int32_t hb = alongZ ? cell_height(mesh, sideB, i) : cell_height(mesh, i, sideB);
+            if (connected(ha, hb, climb)) {
+                first = std::min(first, i);
+                last = i;
+            }
+        }
+        const float edge = (float)std::max(sideA, sideB) * cs;
+        const float begin = (float)first * cs;
+        const float end = (float)(last + 1) * cs;
+        simd::float2 p, q;
+        if (alongZ) {
+            p = { mesh.originX + edge, mesh.originZ + begin };
+            q = { mesh.originX + edge, mesh.originZ + end };
+        } else {
+            p = { mesh.originX + begin, mesh.originZ + edge };
+            q = { mesh.originX + end, mesh.originZ + edge };
+        }
+        // Walking towards +x the left is +z, and so on round
+        const bool forward = alongZ ? b.x0 > a.x0 : b.z0 > a.z0;
+        const bool pLeft = alongZ ? !forward : forward;
+        left = pLeft ? p : q;
+        right = pLeft ? q : p;
+    }
+
+    // Twice the signed area of abc on the xz plane; positive if c lies to the left of ab
+    float triangle_area(simd::float2 a, simd::float2 b, simd::float2 c) {
+        const simd::float2 ab = b - a;
+        const simd::float2 ac = c - a;
+        return ab.x * ac.y - ab.y * ac.x;
+    }
+
+    bool same_point(simd::float2 a, simd::float2 b) {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    // The simple stupid funnel: the shortest line through the portals, turning only at their ends
+    void string_pull(const NavMesh& mesh, const NavPathQuery& query, const std::vector<uint32_t>& polys,
+                     std::vector<simd::float2>& lefts, std::vector<simd::float2>& rights, NavPath& path) {
+        lefts.assign(1, query.start);
+        rights.assign(1, query.start);
+        for (size_t i = 1; i < polys.size(); ++i) {
+            simd::float2 left, right;
+            portal(mesh, polys[i - 1], polys[i], left, right);
+            lefts.push_back(left);
+            rights.push_back(right);
+        }
+        lefts.push_back(query.end);
+        rights.push_back(query.end);
+
+        path.points.push_back(ground_point(mesh, query.start));
+        simd::float2 apex = query.start;
+        simd::float2 left = query.start;
+        simd::float2 right = query.start;
+        size_t leftIndex = 0;
+        size_t rightIndex = 0;
+        for (size_t i = 1; i < lefts.size(); ++i) {
+            // Narrow the right side; crossing the left side makes the left corner the next turn
+            if (triangle_area(apex, right, rights[i]) >= 0.0f) {
+                if (same_point(apex, right) || triangle_area(apex, left, rights[i]) < 0.0f) {
+                    right = rights[i];
+                    rightIndex = i;
+                } else {
+                    apex = left;
+                    path.points.push_back(ground_point(mesh, apex));
+                    right = apex;
+                    rightIndex = leftIndex;
+                    i = leftIndex;
+                    continue;
+                }
+            }
+            if (triangle_area(apex, left, lefts[i]) <= 0.0f) {
+                if (same_point(apex, left) || triangle_area(apex, right, lefts[i]) > 0.0f) {
+                    left = lefts[i];
+                    leftIndex = i;
+                } else {
+                    apex = right;
+                    path.points.push_back(ground_point(mesh, apex));
+                    left = apex;
+                    leftIndex = rightIndex;
+                    i = rightIndex;
+                    continue;
+                }
+            }
+        }
+        path.points.push_back(ground_point(mesh, query.end));
+    }
+
+    void find_path(const NavMesh& mesh, const NavPathQuery& query, NavQueryScratch& scratch, NavPath& path) {
+        path.found = false;
+        path.points.clear();
+        path.polys.clear();
+        path.length = 0.0f;
+        const uint32_t startRef = nav_mesh_find_poly(mesh, query.start.x, query.start.y);
+        const uint32_t endRef = nav_mesh_find_poly(mesh, query.end.x, query.end.y);
+        if (startRef == NAV_NO_POLY || endRef == NAV_NO_POLY) {
+            return;
+        }
+        if (scratch.costs.size() < mesh.polyCount) {
+            scratch.costs.resize(mesh.polyCount);
+            scratch.parents.resize(mesh.polyCount);
+            scratch.stamps.assign(mesh.polyCount, 0);
+            scratch.closed.resize(mesh.polyCount);
+            scratch.stamp = 0;
+        }
+        ++scratch.stamp;
+        const simd::float3 goal = nav_mesh_poly(mesh, endRef).center;
+        // Straight-line distance never exceeds the path between centres, so the first pop of the goal is shortest
+        const auto heuristic = [&](const simd::float3& p) { return simd::distance(p, goal); };
+        const auto later = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+            return a.first > b.first;
+        };
+
+        scratch.open.clear();
+        const uint32_t startIndex = dense_index(mesh, startRef);
+        scratch.stamps[startIndex] = scratch.stamp;
+        scratch.costs[startIndex] = 0.0f;
+        scratch.parents[startIndex] = NAV_NO_POLY;
+        scratch.closed[startIndex] = 0;
+        scratch.open.push_back({ heuristic(nav_mesh_poly(mesh, startRef).center), startRef });
+        bool reached = false;
+        while (!scratch.open.empty()) {
+            std::pop_heap(scratch.open.begin(), scratch.open.end(), later);
+            const uint32_t ref = scratch.open.back().second;
+            scratch.open.pop_back();
+            const uint32_t index = dense_index(mesh, ref);
+            if (scratch.closed[index]) {
+                continue; // A stale entry left behind by a cheaper one
+            }
+            scratch.closed[index] = 1;
+            if (ref == endRef) {
+                reached = true;
+                break;
+            }
+            const NavTile& tile = mesh.tiles[ref_tile(ref)];
+            const NavPoly& poly = tile.polys[ref_poly(ref)];
+            for (uint32_t l = poly.firstLink; l < poly.firstLink + poly.linkCount; ++l) {
+                const uint32_t next = tile.links[l];
+                const uint32_t nextIndex = dense_index(mesh, next);
+                const simd::float3 center = nav_mesh_poly(mesh, next).center;
+                const float cost = scratch.costs[index] + simd::distance(poly.center, center);
+                const bool seen = scratch.stamps[nextIndex] == scratch.stamp;
+                if (seen && (scratch.closed[nextIndex] || cost >= scratch.costs[nextIndex])) {
+                    continue;
+                }
+                scratch.stamps[nextIndex] = scratch.stamp;
+                scratch.costs[nextIndex] = cost;
+                scratch.parents[nextIndex] = ref;
+                scratch.closed[nextIndex] = 0;
+                scratch.open.push_back({ cost + heuristic(center), next });
+                std::push_heap(scratch.open.begin(), scratch.open.end(), later);
+            }
+        }
+        if (!reached) {
+            return;
+        }
+
+        for (uint32_t ref = endRef; ref != NAV_NO_POLY; ref = scratch.parents[dense_index(mesh, ref)]) {
+            path.polys.push_back(ref);
+        }
+        std::reverse(path.polys.begin(), path.polys.end());
+        string_pull(mesh, query, path.polys, scratch.lefts, scratch.rights, path);
+        for (size_t i = 1; i < path.points.size(); ++i) {
+            path.length += simd::distance(path.points[i - 1], path.points[i]);
+        }
+        path.found = true;
+    }
+}
+
+NavMesh create_nav_mesh(const HeightField& field, const NavMeshSettings& settings, JobSystem& jobs) {
+    NavMesh mesh;
+    mesh.settings = settings;
+    mesh.settings.tileCells = std::clamp(settings.tileCells, 1u, NAV_MAX_TILE_CELLS);
+    mesh.originX = field.originX;
+    mesh.originZ = field.originZ;
+    mesh.cellsX = (uint32_t)std::max(std::floor((float)(field.width - 1) * field.spacing / settings.cellSize), 0.0f);
+    mesh.cellsZ = (uint32_t)std::max(std::floor((float)(field.depth - 1) * field.spacing / settings.cellSize), 0.0f);
+    const uint32_t n = mesh.settings.tileCells;
+    mesh.tilesX = (mesh.cellsX + n - 1) / n;
+    mesh.tilesZ = (mesh.cellsZ + n - 1) / n;
+    mesh.tiles.resize((size_t)mesh.tilesX * mesh.tilesZ);
+
+    std::vector<uint32_t> tiles(mesh.tiles.size());
+    for (uint32_t t = 0; t < tiles.size(); ++t) {
+        tiles[t] = t;
+    }
+    build_tiles(mesh, field, jobs, tiles, tiles);
+    return mesh;
+}
+
+uint32_t nav_mesh_rebuild(NavMesh& mesh, const HeightField& field, JobSystem& jobs, float minX, float minZ,
+                          float maxX, float maxZ) {
+    if (mesh.tiles.empty() || minX > maxX || minZ > maxZ) {
+        return 0;
+    }
+    // Cells whose centre lies within one spacing of the box
+    const float reach = field.spacing;
+    const float tileSize = mesh.settings.cellSize * (float)mesh.settings.tileCells;
+    const auto tile_of = [&](float v, float origin, uint32_t count) {
+        return (uint32_t)std::clamp(std::floor((v - origin) / tileSize), 0.0f, (float)count - 1.0f);
+    };
+    const uint32_t tx0 = tile_of(minX - reach, mesh.originX, mesh.tilesX);
+    const uint32_t tz0 = tile_of(minZ - reach, mesh.originZ, mesh.tilesZ);
+    const uint32_t tx1 = tile_of(maxX + reach, mesh.originX, mesh.tilesX);
+    const uint32_t tz1 = tile_of(maxZ + reach, mesh.originZ, mesh.tilesZ);
+
+    std::vector<uint32_t> tiles;
+    std::vector<uint32_t> relink;
+    for (uint32_t tz = tz0 > 0 ? tz0 - 1 : 0; tz <= std::min(tz1 + 1, mesh.tilesZ - 1); ++tz) {
+        for (uint32_t tx = tx0 > 0 ? tx0 - 1 : 0; tx <= std::min(tx1 + 1, mesh.tilesX - 1); ++tx) {
+            relink.push_back(tz * mesh.tilesX + tx);
+            if (tx >= tx0 && tx <= tx1 && tz >= tz0 && tz <= tz1) {
+                tiles.push_back(tz * mesh.tilesX + tx);
+            }
+        }
+    }
+    build_tiles(mesh, field, jobs, tiles, relink);
+    return (uint32_t)tiles.size();
+}
+
+uint32_t nav_mesh_find_poly(const NavMesh& mesh, float x, float z) {
+    uint32_t tile, cell;
+    if (!locate_cell(mesh, (int64_t)std::floor((x - mesh.originX) / mesh.settings.cellSize),
+                     (int64_t)std::floor((z - mesh.originZ) / mesh.settings.cellSize), tile, cell)) {
+        return NAV_NO_POLY;
+    }
+    const uint16_t poly = mesh.tiles[tile].cellPolys[cell];
+    return poly == NAV_NO_CELL_POLY ? NAV_NO_POLY : poly_ref(tile, poly);
+}
+
+const NavPoly& nav_mesh_poly(const NavMesh& mesh, uint32_t ref) {
+    return mesh.tiles[ref_tile(ref)].polys[ref_poly(ref)];
+}
+
+void nav_mesh_find_paths(const NavMesh& mesh, JobSystem& jobs, const NavPathQuery* queries, NavPath* paths,
+                         uint32_t count) {
+    // Slices borrow a scratch and hand it back, so there are only as many as run at once
+    std::mutex mutex;
+    std::vector<std::unique_ptr<NavQueryScratch>> idle;
+    jobs.parallel_for(count, NAV_QUERY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        std::unique_ptr<NavQueryScratch> scratch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty()) {
+                scratch = std::move(idle.back());
+                idle.pop_back();
+            }
+        }
+        if (!scratch) {
+            scratch = std::make_unique<NavQueryScratch>();
+        }
+        for (uint32_t i = begin; i < end; ++i) {
+            find_path(mesh, queries[i], *scratch, paths[i]);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(scratch));
+    });
+}
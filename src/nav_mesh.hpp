@@ -0,0 +1,159 @@
+/**
+ * @file nav_mesh.hpp
+ * @brief A navigation mesh over the terrain, built and rebuilt tile by tile, with batched A* path queries.
+ *
+ * The mesh is cut into square tiles of cells, the voxel columns Recast would rasterise. The
+ * terrain is a height field, so each column holds one solid span up to the ground: building a
+ * tile samples the ground at every cell centre, quantises it to whole voxels and keeps the cells
+ * no steeper than the walkable slope. Two neighbouring cells connect if the step between them
+ * is no higher than an agent climbs. The connected cells of a tile are then merged greedily
+ * into rectangles, the mesh's polygons, and every polygon links to the polygons across its edges,
+ * in its own tile or the next.
+ *
+ * Tiles only read the height field and write themselves, so they build in parallel on the job
+ * system, and an edit only rebuilds the tiles it reaches: nav_mesh_rebuild() builds those, then
+ * relinks them and their neighbours, whose links pointed at the polygons they replaced.
+ *
+ * Paths are found by A* over the polygons, from polygon centre to polygon centre, and the
+ * corridor of polygons found is then pulled straight through the edges between them with the
+ * funnel algorithm, so a path only turns at the corners it has to go round. A batch of
+ * queries runs in slices on the job system; each slice borrows a scratch of the mesh's size,
+ * stamped per query rather than cleared, so a query costs only the polygons it visits.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "height_field.hpp"
+#include "job_system.hpp"
+
+/// A polygon reference: the tile index above NAV_POLY_BITS, the polygon within the tile below.
+constexpr uint32_t NAV_POLY_BITS = 12;
+
+/// The reference of no polygon, e.g. of a point over unwalkable ground.
+constexpr uint32_t NAV_NO_POLY = 0xffffffffu;
+
+/// Largest NavMeshSettings::tileCells; a tile of single-cell polygons still fits NAV_POLY_BITS.
+constexpr uint32_t NAV_MAX_TILE_CELLS = 64;
+
+/**
+ * @struct NavMeshSettings
+ * @brief The voxel grid, the agent the mesh is walkable for and the tile size.
+ */
+struct NavMeshSettings {
+    float cellSize = 0.5f;      ///< World side of a cell.
+    float cellHeight = 0.1f;    ///< World height of a voxel; ground heights are rounded down to it.
+    float maxSlope = 40.0f;     ///< Steepest walkable ground, in degrees.
+    float maxClimb = 0.4f;      ///< Highest step between neighbouring cells an agent takes, up or down.
+    uint32_t tileCells = 32;    ///< Cells per tile side, at most NAV_MAX_TILE_CELLS.
+};
+
+/**
+ * @struct NavPoly
+ * @brief A rectangle of connected walkable cells.
+ */
+struct NavPoly {
+    uint16_t x0 = 0;            ///< First cell column within the tile.
+    uint16_t z0 = 0;            ///< First cell row within the tile.
+    uint16_t x1 = 0;            ///< Last cell column, inclusive.
+    uint16_t z1 = 0;            ///< Last cell row, inclusive.
+    uint32_t firstLink = 0;     ///< First of its neighbours in NavTile::links.
+    uint32_t linkCount = 0;     ///< Polygons across its edges.
+    simd::float3 center;        ///< World centre of the rectangle, on the ground of its middle cell.
+};
+
+/**
+ * @struct NavTile
+ * @brief The cells and polygons of one tile.
+ */
+struct NavTile {
+    std::vector<int32_t> heights;   ///< Ground of each cell in voxels, row-major.
+    std::vector<uint16_t> cellPolys; ///< Polygon of each cell; UINT16_MAX where unwalkable.
+    std::vector<NavPoly> polys;     ///< The tile's polygons.
+    std::vector<uint32_t> links;    ///< Polygon references of each polygon's neighbours, in polygon order.
+    uint32_t builds = 0;            ///< Times the tile was built.
+};
+
+/**
+ * @struct NavMesh
+ * @brief The tiles covering a height field.
+ */
+struct NavMesh {
+    NavMeshSettings settings;       ///< The settings it was created with; tileCells clamped.
+    float originX = 0.0f;           ///< World x of the first cell's corner.
+    float originZ = 0.0f;           ///< World z of the first cell's corner.
+    uint32_t cellsX = 0;            ///< Cells along x; those of the last tiles past it are unwalkable.
+    uint32_t cellsZ = 0;            ///< Cells along z.
+    uint32_t tilesX = 0;            ///< Tiles along x.
+    uint32_t tilesZ = 0;            ///< Tiles along z.
+    std::vector<NavTile> tiles;     ///< Row-major by z.
+    std::vector<uint32_t> polyBase; ///< Dense index of each tile's first polygon, for the query scratch.
+    uint32_t polyCount = 0;         ///< Polygons of every tile.
+};
+
+/**
+ * @struct NavPathQuery
+ * @brief A path to find, between two world positions on the xz plane.
+ */
+struct NavPathQuery {
+    simd::float2 start;         ///< World xz where the path starts.
+    simd::float2 end;           ///< World xz where it ends.
+};
+
+/**
+ * @struct NavPath
+ * @brief A found path.
+ */
+struct NavPath {
+    bool found = false;                 ///< False if either end is unwalkable or no polygons connect them.
+    std::vector<simd::float3> points;   ///< The start, the corners it turns at, the end; on the ground.
+    std::vector<uint32_t> polys;        ///< The polygons passed, from the start's to the end's.
+    float length = 0.0f;                ///< World length along the points.
+};
+
+/**
+ * @brief Builds the tiles over a height field in parallel.
+ * @param field The terrain; the mesh covers its extent.
+ * @param settings The grid and the agent.
+ * @param jobs Builds the tiles.
+ * @return The mesh.
+ */
+NavMesh create_nav_mesh(const HeightField& field, const NavMeshSettings& settings, JobSystem& jobs);
+
+/**
+ * @brief Rebuilds the tiles an edit of the height field can have changed.
+ *
+ * A cell's ground comes from the samples within one spacing of its centre, so the tiles of
+ * every cell within one spacing of the box are rebuilt; they and their neighbours are relinked.
+ *
+ * @param mesh The mesh.
+ * @param field The edited terrain; the one the mesh was created from.
+ * @param jobs Builds and links the tiles.
+ * @param minX The smallest world x of the changed samples.
+ * @param minZ The smallest world z of the changed samples.
+ * @param maxX The largest world x of the changed samples.
+ * @param maxZ The largest world z of the changed samples.
+ * @return The number of tiles rebuilt.
+ */
+uint32_t nav_mesh_rebuild(NavMesh& mesh, const HeightField& field, JobSystem& jobs, float minX, float minZ,
+                          float maxX, float maxZ);
+
+/// @return The polygon under a world position, or NAV_NO_POLY if it is outside the mesh or unwalkable.
+uint32_t nav_mesh_find_poly(const NavMesh& mesh, float x, float z);
+
+/// @return The polygon a reference names; the reference must be valid.
+const NavPoly& nav_mesh_poly(const NavMesh& mesh, uint32_t ref);
+
+/**
+ * @brief Finds a batch of shortest paths over the polygons in parallel.
+ * @param mesh The mesh; must not change meanwhile.
+ * @param jobs Runs the queries in slices.
+ * @param queries The paths to find.
+ * @param paths Receives one path per query.
+ * @param count The number of queries.
+ */
+void nav_mesh_find_paths(const NavMesh& mesh, JobSystem& jobs, const NavPathQuery* queries, NavPath* paths,
+                         uint32_t count);
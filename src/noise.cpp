@@ -0,0 +1,381 @@
+#include "noise.hpp"
+
+#include <simd/simd.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace {
+    using namespace noise_shared;
+
+    // The scalar and SIMD paths share one implementation in noise_shared.hpp, so all of them run
+    // the same operations in the same order as the GPU and round identically
+    struct Lanes {
+        using F = simd::float4;
+        using I = simd::int4;
+        using U = simd::uint4;
+    };
+
+    struct Lanes8 {
+        using F = simd::float8;
+        using I = simd::int8;
+        using U = simd::uint8;
+    };
+
+    template <uint32_t Octaves, typename Field>
+    void fractal_batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            simd::float4 x = { xs[i], xs[i + 1], xs[i + 2], xs[i + 3] };
+            simd::float4 z = { zs[i], zs[i + 1], zs[i + 2], zs[i + 3] };
+            simd::float4 r = fractal<Lanes, Octaves, Field>(x, z, settings);
+            out[i] = r[0]; out[i + 1] = r[1]; out[i + 2] = r[2]; out[i + 3] = r[3];
+        }
+
+        // Pad the tail into one more vector so every point takes the same code path
+        if (i < n) {
+            simd::float4 x = 0.0f;
+            simd::float4 z = 0.0f;
+            for (size_t j = 0; i + j < n; ++j) {
+                x[j] = xs[i + j];
+                z[j] = zs[i + j];
+            }
+            simd::float4 r = fractal<Lanes, Octaves, Field>(x, z, settings);
+            for (size_t j = 0; i + j < n; ++j) {
+                out[i + j] = r[j];
+            }
+        }
+    }
+
+    template <uint32_t Octaves, typename Field>
+    void fractal_sample_batch(const float* xs, const float* zs, NoiseSample* out, size_t n,
+                              const NoiseSettings& settings) {
+        for (size_t i = 0; i < n; i += 4) {
+            simd::float4 x = 0.0f;
+            simd::float4 z = 0.0f;
+            const size_t lanes = std::min<size_t>(4, n - i);
+            for (size_t j = 0; j < lanes; ++j) {
+                x[j] = xs[i + j];
+                z[j] = zs[i + j];
+            }
+            const Sample<simd::float4> r = fractal_derivative<Lanes, Octaves, Field>(x, z, settings);
+            for (size_t j = 0; j < lanes; ++j) {
+                out[i + j] = { r.value[j], r.dx[j], r.dz[j] };
+            }
+        }
+    }
+
+    // Every entry point of one field at one octave count
+    struct Kernels {
+        void (*batch)(const float*, const float*, float*, size_t, const NoiseSettings&);
+        float (*scalar)(float, float, NoiseSettings);
+        void (*sampleBatch)(const float*, const float*, NoiseSample*, size_t, const NoiseSettings&);
+        NoiseSample (*sample)(float, float, NoiseSettings);
+        simd::float4 (*lanes4)(simd::float4, simd::float4, NoiseSettings);
+        simd::float8 (*lanes8)(simd::float8, simd::float8, NoiseSettings);
+    };
+
+    template <uint32_t Octaves, typename Field>
+    constexpr Kernels make_kernels() {
+        return { fractal_batch<Octaves, Field>,        fractal<Scalar, Octaves, Field>,
+                 fractal_sample_batch<Octaves, Field>, fractal_derivative<Scalar, Octaves, Field>,
+                 fractal<Lanes, Octaves, Field>,       fractal<Lanes8, Octaves, Field> };
+    }
+
+    // Value noise with each interpolant, gradient and simplex; the last two ignore the interpolant
+    constexpr uint32_t FIELD_COUNT = 4;
+
+    constexpr uint32_t field_index(NoiseBasis basis, NoiseInterpolation interpolation) {
+        if (basis == NoiseBasis::Gradient) {
+            return 2;
+        }
+        if (basis == NoiseBasis::Simplex) {
+            return 3;
+        }
+        return interpolation == NoiseInterpolation::Smoothstep ? 1 : 0;
+    }
+
+    // Kernels for every field by octave count, entry 0 being the generic loop. Counts up to
+    // NOISE_UNROLLED_OCTAVES unroll; the registered fields also have their basis fixed
+    struct Registry {
+        Kernels kernels[FIELD_COUNT][NOISE_UNROLLED_OCTAVES + 1];
+        bool fixed[FIELD_COUNT][NOISE_UNROLLED_OCTAVES + 1];
+    };
+
+    template <uint32_t... Octaves>
+    constexpr Registry make_registry(std::integer_sequence<uint32_t, Octaves...>) {
+        constexpr Kernels unrolled[] = { make_kernels<Octaves, SettingsField>()... };
+        Registry registry = {};
+        for (uint32_t field = 0; field < FIELD_COUNT; ++field) {
+            for (uint32_t octaves = 0; octaves <= NOISE_UNROLLED_OCTAVES; ++octaves) {
+                registry.kernels[field][octaves] = unrolled[octaves];
+            }
+        }
+#define NOISE_REGISTER_FIELD(octaves, basis, interpolation)                                                    \
+        static_assert(octaves >= 1 && octaves <= NOISE_UNROLLED_OCTAVES, "registered octaves must unroll");    \
+        registry.kernels[field_index(basis, interpolation)][octaves] =                                         \
+            make_kernels<octaves, FixedField<basis, interpolation>>();                                         \
+        registry.fixed[field_index(basis, interpolation)][octaves] = true;
+        NOISE_REGISTERED_FIELDS(NOISE_REGISTER_FIELD)
+#undef NOISE_REGISTER_FIELD
+        return registry;
+    }
+
+    constexpr Registry REGISTRY =
+        make_registry(std::make_integer_sequence<uint32_t, NOISE_UNROLLED_OCTAVES + 1>());
+
+    const Kernels& kernels(const NoiseSettings& settings) {
+        const uint32_t octaves = settings.octaves <= NOISE_UNROLLED_OCTAVES ? settings.octaves : 0;
+        return REGISTRY.kernels[field_index(settings.basis, settings.interpolation)][octaves];
+    }
+
+    // One axis of a grid at one octave: each coordinate's lattice cell, counted from the lowest
+    // one, its offset into the cell and the basis' blend weight for that offset
+    struct GridAxis {
+        std::vector<uint32_t> cell;
+        std::vector<float> offset;
+        std::vector<float> weight;
+        uint32_t first = 0;     // Lattice coordinate of the lowest cell, wrapped as hash_point takes it
+        uint32_t cells = 0;
+    };
+
+    // The same floor, offset and blend value_noise() and perlin_noise() compute for every sample
+    void place_grid_axis(const float* coords, size_t n, float frequency, const NoiseSettings& settings,
+                         GridAxis& axis) {
+        axis.cell.resize(n);
+        axis.offset.resize(n);
+        axis.weight.resize(n);
+        int32_t low = INT32_MAX;
+        int32_t high = INT32_MIN;
+        for (size_t i = 0; i < n; ++i) {
+            const float p = coords[i] * frequency;
+            const int32_t cell = floor_to_int(p);
+            const float offset = p - to_float(cell);
+            axis.cell[i] = to_bits(cell);
+            axis.offset[i] = offset;
+            axis.weight[i] = settings.basis == NoiseBasis::Gradient ? quintic_fade(offset)
+                                                                     : blend_weight(offset, settings.interpolation);
+            low = std::min(low, cell);
+            high = std::max(high, cell);
+        }
+        axis.first = to_bits(low);
+        axis.cells = to_bits(high) - axis.first + 1;
+        for (uint32_t& cell : axis.cell) {
+            cell -= axis.first;
+        }
+    }
+
+    // Adds one value noise octave over the grid from a table of its lattice values
+    void add_value_octave(const GridAxis& axisX, const GridAxis& axisZ, const float* lattice, float amplitude,
+                          float* out) {
+        const size_t width = (size_t)axisX.cells + 1;
+        const size_t nx = axisX.cell.size();
+        for (size_t j = 0; j < axisZ.cell.size(); ++j) {
+            const float* bottom = lattice + axisZ.cell[j] * width;
+            const float* top = bottom + width;
+            const float wz = axisZ.weight[j];
+            float* row = out + j * nx;
+            for (size_t i = 0; i < nx; ++i) {
+                const uint32_t c = axisX.cell[i];
+                const float wx = axisX.weight[i];
+                const float v = lerp(lerp(bottom[c], bottom[c + 1], wx), lerp(top[c], top[c + 1], wx), wz);
+                row[i] = fused(v, amplitude, row[i]);
+            }
+        }
+    }
+
+    // Adds one gradient noise octave over the grid from a table of its lattice gradients
+    void add_gradient_octave(const GridAxis& axisX, const GridAxis& axisZ, const Gradient<float>* lattice,
+                             float amplitude, float* out) {
+        const size_t width = (size_t)axisX.cells + 1;
+        const size_t nx = axisX.cell.size();
+        for (size_t j = 0; j < axisZ.cell.size(); ++j) {
+            const Gradient<float>* bottom = lattice + axisZ.cell[j] * width;
+            const Gradient<float>* top = bottom + width;
+            const float fz = axisZ.offset[j];
+            const float v = axisZ.weight[j];
+            float* row = out + j * nx;
+            for (size_t i = 0; i < nx; ++i) {
+                const uint32_t c = axisX.cell[i];
+                const float fx = axisX.offset[i];
+                const float n00 = dot_gradient(bottom[c], fx, fz);
+                const float n10 = dot_gradient(bottom[c + 1], fx - 1.0f, fz);
+                const float n01 = dot_gradient(top[c], fx, fz - 1.0f);
+                const float n11 = dot_gradient(top[c + 1], fx - 1.0f, fz - 1.0f);
+                const float u = axisX.weight[i];
+                const float octave = lerp(lerp(n00, n10, u), lerp(n01, n11, u), v) * GRADIENT_SCALE;
+                row[i] = fused(octave, amplitude, row[i]);
+            }
+        }
+    }
+}
+
+uint32_t noise_hash(uint32_t seed, int x, int z) {
+    return hash_point(seed, (uint32_t)x, (uint32_t)z);
+}
+
+float lattice_noise(uint32_t seed, int x, int z) {
+    return unit_value<float>(noise_hash(seed, x, z));
+}
+
+float cosine_interpolate(float a, float b, float blend) {
+    return lerp(a, b, blend_weight(blend, NoiseInterpolation::Cosine));
+}
+
+float smoothed_noise(float x, float z, uint32_t seed, NoiseInterpolation interpolation) {
+    return value_noise<Scalar>(x, z, seed, interpolation);
+}
+
+float gradient_noise(float x, float z, uint32_t seed) {
+    return perlin_noise<Scalar>(x, z, seed);
+}
+
+float simplex_noise(float x, float z, uint32_t seed) {
+    return simplex<Scalar>(x, z, seed);
+}
+
+float gradient_noise3(float x, float y, float z, uint32_t seed) {
+    return perlin_noise3(x, y, z, seed);
+}
+
+float fractal_noise3(float x, float y, float z, const NoiseSettings& settings) {
+    return fractal3(x, y, z, settings);
+}
+
+float fractal_noise(float x, float z, const NoiseSettings& settings) {
+    return kernels(settings).scalar(x, z, settings);
+}
+
+NoiseSample fractal_noise_sample(float x, float z, const NoiseSettings& settings) {
+    return kernels(settings).sample(x, z, settings);
+}
+
+simd::float4 fractal_noise4(simd::float4 x, simd::float4 z, const NoiseSettings& settings) {
+    return kernels(settings).lanes4(x, z, settings);
+}
+
+simd::float8 fractal_noise8(simd::float8 x, simd::float8 z, const NoiseSettings& settings) {
+    return kernels(settings).lanes8(x, z, settings);
+}
+
+float fractal_noise_bound(const NoiseSettings& settings) {
+    float bound = 0.0f;
+    float amplitude = 1.0f;
+    for (uint32_t i = 0; i < settings.octaves; i++) {
+        bound += fabsf(amplitude);
+        amplitude *= settings.persistence;
+    }
+    return bound;
+}
+
+void fractal_noise_batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings) {
+    kernels(settings).batch(xs, zs, out, n, settings);
+}
+
+void fractal_noise_sample_batch(const float* xs, const float* zs, NoiseSample* out, size_t n,
+                                const NoiseSettings& settings) {
+    kernels(settings).sampleBatch(xs, zs, out, n, settings);
+}
+
+template <uint32_t Octaves>
+void fractal_noise_batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings) {
+    static_assert(Octaves >= 1 && Octaves <= NOISE_UNROLLED_OCTAVES, "no specialization for this octave count");
+    fractal_batch<Octaves, SettingsField>(xs, zs, out, n, settings);
+}
+
+template void fractal_noise_batch<1>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<2>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<3>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<4>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<5>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<6>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<7>(const float*, const float*, float*, size_t, const NoiseSettings&);
+template void fractal_noise_batch<8>(const float*, const float*, float*, size_t, const NoiseSettings&);
+
+void fractal_noise_grid(const float* xs, size_t nx, const float* zs, size_t nz, float* out,
+                        const NoiseSettings& settings) {
+    thread_local std::vector<float> rowZ;
+    if (settings.warp != 0.0f || settings.basis == NoiseBasis::Simplex) {
+        // Warped points leave the grid, and simplex cells are not aligned with it: row by row
+        rowZ.resize(nx);
+        for (size_t j = 0; j < nz; ++j) {
+            std::fill(rowZ.begin(), rowZ.end(), zs[j]);
+            fractal_noise_batch(xs, rowZ.data(), out + j * nx, nx, settings);
+        }
+        return;
+    }
+
+    thread_local GridAxis axisX, axisZ;
+    thread_local std::vector<float> values;
+    thread_local std::vector<Gradient<float>> gradients;
+    std::fill(out, out + nx * nz, 0.0f);
+    if (nx == 0 || nz == 0) {
+        return;
+    }
+    // The same octave loop as fractal(), so every sample accumulates the same terms in the same order
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    for (uint32_t octave = 0; octave < settings.octaves; ++octave) {
+        const uint32_t seed = settings.seed + octave * OCTAVE_SEED_STEP;
+        place_grid_axis(xs, nx, frequency, settings, axisX);
+        place_grid_axis(zs, nz, frequency, settings, axisZ);
+        const size_t width = (size_t)axisX.cells + 1;
+        const size_t height = (size_t)axisZ.cells + 1;
+        if (width * height > 4 * nx * nz) {
+            // Samples sparser than the lattice share no corners, so the table would only cost more hashes
+            for (size_t j = 0; j < nz; ++j) {
+                for (size_t i = 0; i < nx; ++i) {
+                    const float v = basis_noise<Scalar>(xs[i] * frequency, zs[j] * frequency, seed, settings);
+                    out[j * nx + i] = fused(v, amplitude, out[j * nx + i]);
+                }
+            }
+        } else if (settings.basis == NoiseBasis::Gradient) {
+            gradients.resize(width * height);
+            for (size_t z = 0; z < height; ++z) {
+                for (size_t x = 0; x < width; ++x) {
+                    const uint32_t h = hash_point(seed, axisX.first + (uint32_t)x, axisZ.first + (uint32_t)z);
+                    gradients[z * width + x] = lattice_gradient<float>(h);
+                }
+            }
+            add_gradient_octave(axisX, axisZ, gradients.data(), amplitude, out);
+        } else {
+            values.resize(width * height);
+            for (size_t z = 0; z < height; ++z) {
+                for (size_t x = 0; x < width; ++x) {
+                    const uint32_t h = hash_point(seed, axisX.first + (uint32_t)x, axisZ.first + (uint32_t)z);
+                    values[z * width + x] = unit_value<float>(h);
+                }
+            }
+            add_value_octave(axisX, axisZ, values.data(), amplitude, out);
+        }
+        amplitude *= settings.persistence;
+        frequency *= 2.0f;
+    }
+}
+
+bool fractal_noise_registered(const NoiseSettings& settings) {
+    return settings.octaves <= NOISE_UNROLLED_OCTAVES &&
+           REGISTRY.fixed[field_index(settings.basis, settings.interpolation)][settings.octaves];
+}
+
+template <uint32_t Octaves, NoiseBasis Basis, NoiseInterpolation Interpolation>
+float FractalNoise<Octaves, Basis, Interpolation>::evaluate(float x, float z, const NoiseSettings& settings) {
+    return fractal<Scalar, Octaves, Field>(x, z, settings);
+}
+
+template <uint32_t Octaves, NoiseBasis Basis, NoiseInterpolation Interpolation>
+NoiseSample FractalNoise<Octaves, Basis, Interpolation>::sample(float x, float z, const NoiseSettings& settings) {
+    return fractal_derivative<Scalar, Octaves, Field>(x, z, settings);
+}
+
+template <uint32_t Octaves, NoiseBasis Basis, NoiseInterpolation Interpolation>
+void FractalNoise<Octaves, Basis, Interpolation>::batch(const float* xs, const float* zs, float* out, size_t n,
+                                                        const NoiseSettings& settings) {
+    fractal_batch<Octaves, Field>(xs, zs, out, n, settings);
+}
+
+#define NOISE_INSTANTIATE_FIELD(octaves, basis, interpolation) \
+    template struct FractalNoise<octaves, basis, interpolation>;
+NOISE_REGISTERED_FIELDS(NOISE_INSTANTIATE_FIELD)
+#undef NOISE_INSTANTIATE_FIELD
@@ -0,0 +1,248 @@
+/**
+ * @file noise.hpp
+ * @brief Seeded lattice noise used to generate the terrain, in scalar and batched SIMD form.
+ *
+ * Lattice points are hashed with unsigned 32-bit arithmetic, which wraps identically in
+ * C++ and Metal, and every product that feeds a sum is written as an explicit fma, so no
+ * compiler is free to fuse or split it differently. The scalar, SIMD and Metal paths are all
+ * compiled from noise_shared.hpp, so they return the same bits on any thread, device or
+ * machine. The cosine interpolant included: it evaluates its cosine by a shared polynomial
+ * within 1e-7 of the exact value rather than through each platform's cos.
+ *
+ * Octave counts up to NOISE_UNROLLED_OCTAVES run through specializations with the count
+ * fixed at compile time, so the octave loop unrolls; larger counts take a generic loop
+ * that performs the same operations. The fields listed in NOISE_REGISTERED_FIELDS also fix
+ * their basis and interpolant, so each octave inlines one basis with no branch on the
+ * settings; FractalNoise names them directly. fractal_noise4() and fractal_noise8() take points
+ * already held in SIMD lanes, for callers with a few queries rather than arrays of them.
+ *
+ * fractal_noise_sample() returns the value together with its analytic partial derivatives,
+ * for one evaluation instead of the five that central differences take. Its value equals
+ * fractal_noise() bit for bit, and its derivatives match the GPU's too.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "noise_shared.hpp"
+
+/// Largest octave count with a compile-time specialization.
+const uint32_t NOISE_UNROLLED_OCTAVES = 8;
+
+/**
+ * The fields with a FractalNoise instantiation, as X(octaves, basis, interpolation): the
+ * terrain's default and the bases offered with it, the biome climate and the forest density.
+ * fractal_noise() and the batch functions pick these up from matching settings by themselves.
+ */
+#define NOISE_REGISTERED_FIELDS(X)                                                                             \
+    X(4, NoiseBasis::Value, NoiseInterpolation::Cosine)                                                        \
+    X(5, NoiseBasis::Value, NoiseInterpolation::Cosine)                                                        \
+    X(6, NoiseBasis::Value, NoiseInterpolation::Cosine)                                                        \
+    X(3, NoiseBasis::Value, NoiseInterpolation::Smoothstep)                                                    \
+    X(5, NoiseBasis::Value, NoiseInterpolation::Smoothstep)                                                    \
+    X(5, NoiseBasis::Gradient, NoiseInterpolation::Cosine)                                                     \
+    X(5, NoiseBasis::Simplex, NoiseInterpolation::Cosine)
+
+/// A noise value and its partial derivatives along x and z, in noise space.
+using NoiseSample = noise_shared::Sample<float>;
+
+/**
+ * @brief Hashes an integer lattice point without signed overflow.
+ * @param seed The noise seed.
+ * @param x The lattice x-coordinate.
+ * @param z The lattice z-coordinate.
+ * @return 32 well-mixed bits.
+ */
+uint32_t noise_hash(uint32_t seed, int x, int z);
+
+/**
+ * @brief Hashes an integer lattice point to a pseudo-random value.
+ * @param seed The noise seed.
+ * @param x The lattice x-coordinate.
+ * @param z The lattice z-coordinate.
+ * @return The value in (-1, 1].
+ */
+float lattice_noise(uint32_t seed, int x, int z);
+
+/**
+ * @brief Interpolates between two values with a cosine-shaped blend.
+ * @param a The value at blend = 0.
+ * @param b The value at blend = 1.
+ * @param blend The blend factor in [0, 1].
+ * @return The interpolated value.
+ */
+float cosine_interpolate(float a, float b, float blend);
+
+/**
+ * @brief Samples value noise between the four surrounding lattice points.
+ * @param x The x-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param seed The noise seed.
+ * @param interpolation The interpolant to use.
+ * @return The smoothed noise value in [-1, 1].
+ */
+float smoothed_noise(float x, float z, uint32_t seed = 0,
+                     NoiseInterpolation interpolation = NoiseInterpolation::Cosine);
+
+/**
+ * @brief Samples Perlin gradient noise.
+ * @param x The x-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param seed The noise seed.
+ * @return The noise value in [-1, 1]; 0 on every lattice point.
+ */
+float gradient_noise(float x, float z, uint32_t seed = 0);
+
+/**
+ * @brief Samples 2D simplex noise.
+ * @param x The x-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param seed The noise seed.
+ * @return The noise value in [-1, 1].
+ */
+float simplex_noise(float x, float z, uint32_t seed = 0);
+
+/**
+ * @brief Samples 3D Perlin gradient noise.
+ * @param x The x-coordinate in noise space.
+ * @param y The y-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param seed The noise seed.
+ * @return The noise value in [-1, 1]; 0 on every lattice point.
+ */
+float gradient_noise3(float x, float y, float z, uint32_t seed = 0);
+
+/**
+ * @brief Sums octaves of 3D Perlin noise, as the shaders' noise_shared::fractal3 does.
+ * @param x The x-coordinate in noise space.
+ * @param y The y-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param settings The seed, octave count and persistence; the basis, interpolant and warp are ignored.
+ * @return The fractal noise value, within +-fractal_noise_bound(settings).
+ */
+float fractal_noise3(float x, float y, float z, const NoiseSettings& settings = {});
+
+/**
+ * @brief Sums octaves of noise, after warping the point by the same basis when enabled.
+ * @param x The x-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param settings The noise field.
+ * @return The fractal noise value, within +-fractal_noise_bound(settings).
+ */
+float fractal_noise(float x, float z, const NoiseSettings& settings = {});
+
+/**
+ * @brief Evaluates fractal_noise together with its partial derivatives.
+ * @param x The x-coordinate in noise space.
+ * @param z The z-coordinate in noise space.
+ * @param settings The noise field.
+ * @return The value, equal to fractal_noise(x, z, settings), and its derivatives along x and z.
+ */
+NoiseSample fractal_noise_sample(float x, float z, const NoiseSettings& settings = {});
+
+/**
+ * @brief Evaluates fractal_noise at four points held in SIMD lanes.
+ *
+ * Every lane, the lattice hash and floor included, is computed together; lane i equals
+ * fractal_noise(x[i], z[i], settings) bit for bit.
+ *
+ * @param x The x-coordinates in noise space.
+ * @param z The z-coordinates in noise space.
+ * @param settings The noise field.
+ * @return The four noise values.
+ */
+simd::float4 fractal_noise4(simd::float4 x, simd::float4 z, const NoiseSettings& settings = {});
+
+/// fractal_noise4 over eight lanes.
+simd::float8 fractal_noise8(simd::float8 x, simd::float8 z, const NoiseSettings& settings = {});
+
+/**
+ * @brief Returns the largest magnitude fractal_noise can produce.
+ * @param settings The noise field.
+ * @return The sum of all octave amplitudes; every basis lies in [-1, 1].
+ */
+float fractal_noise_bound(const NoiseSettings& settings = {});
+
+/**
+ * @brief Tells whether a field runs through one of the NOISE_REGISTERED_FIELDS instantiations.
+ * @param settings The noise field.
+ * @return True if its octave count, basis and interpolant are all fixed at compile time.
+ */
+bool fractal_noise_registered(const NoiseSettings& settings);
+
+/**
+ * @brief A fractal noise field with its octave count, basis and interpolant fixed at compile time.
+ *
+ * Only the instantiations in NOISE_REGISTERED_FIELDS are defined. The settings supply the
+ * seed, warp and persistence; their octaves, basis and interpolation are ignored. Results
+ * equal fractal_noise, fractal_noise_sample and fractal_noise_batch with matching settings.
+ */
+template <uint32_t Octaves, NoiseBasis Basis, NoiseInterpolation Interpolation = NoiseInterpolation::Cosine>
+struct FractalNoise {
+    using Field = noise_shared::FixedField<Basis, Interpolation>;
+
+    static float evaluate(float x, float z, const NoiseSettings& settings);
+    static NoiseSample sample(float x, float z, const NoiseSettings& settings);
+    static void batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings);
+};
+
+/**
+ * @brief Evaluates fractal_noise for many points at once using 4-wide SIMD lanes.
+ *
+ * The results are bit-identical to calling fractal_noise for each point.
+ *
+ * @param xs The x-coordinates in noise space.
+ * @param zs The z-coordinates in noise space.
+ * @param out Receives n noise values; may alias neither xs nor zs.
+ * @param n The number of points.
+ * @param settings The noise field.
+ */
+void fractal_noise_batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings = {});
+
+/**
+ * @brief fractal_noise_batch with the octave count fixed at compile time.
+ *
+ * Instantiated for 1 to NOISE_UNROLLED_OCTAVES octaves; settings.octaves is ignored. The
+ * results equal fractal_noise_batch with settings.octaves = Octaves.
+ */
+template <uint32_t Octaves>
+void fractal_noise_batch(const float* xs, const float* zs, float* out, size_t n, const NoiseSettings& settings);
+
+/**
+ * @brief Evaluates fractal_noise at every point of a grid, reusing lattice corners between samples.
+ *
+ * Value and gradient noise hash the four lattice corners around every sample, and samples of
+ * a grid finer than the lattice share most of them with their neighbours. For each octave this
+ * hashes every corner under the grid once into a table, with each column's and row's cell and
+ * blend weight found once too, and interpolates every sample from the table, so a grid with
+ * several samples per cell takes close to a quarter of the hashes. Octaves whose lattice is
+ * finer than the grid are evaluated directly. Warped and simplex fields have no aligned
+ * corners to share and go through fractal_noise_batch row by row.
+ *
+ * The results are bit-identical to calling fractal_noise for each point.
+ *
+ * @param xs The x-coordinates of the grid's columns, in noise space.
+ * @param nx The number of columns.
+ * @param zs The z-coordinates of the grid's rows, in noise space.
+ * @param nz The number of rows.
+ * @param out Receives nx * nz values, row by row: out[j * nx + i] is the value at (xs[i], zs[j]).
+ * @param settings The noise field.
+ */
+void fractal_noise_grid(const float* xs, size_t nx, const float* zs, size_t nz, float* out,
+                        const NoiseSettings& settings = {});
+
+/**
+ * @brief Evaluates fractal_noise_sample for many points at once using 4-wide SIMD lanes.
+ *
+ * The results are bit-identical to calling fractal_noise_sample for each point.
+ *
+ * @param xs The x-coordinates in noise space.
+ * @param zs The z-coordinates in noise space.
+ * @param out Receives n samples.
+ * @param n The number of points.
+ * @param settings The noise field.
+ */
+void fractal_noise_sample_batch(const float* xs, const float* zs, NoiseSample* out, size_t n,
+                                const NoiseSettings& settings = {});
@@ -0,0 +1,624 @@
+/**
+ * @file noise_shared.hpp
+ * @brief The noise field and every operation of its evaluation, in one source for C++ and Metal.
+ *
+ * noise.cpp includes this for the CPU, in scalar, 4- and 8-wide SIMD form, and shaders.metal
+ * includes it for terrain generation, foliage scattering and the vertex stages that displace
+ * the terrain. Only the handful of primitives at the top differ between the two languages,
+ * and each maps to the same IEEE operation on both; everything after them is compiled from
+ * the same text, so a change to the noise cannot reach one side without the other.
+ *
+ * Every field also comes in a form that returns its partial derivatives along x and z with the
+ * value (fractal_derivative()), from the same lattice lookups, for normals and slopes that
+ * would otherwise take four more samples of central differences. Its value is computed with
+ * exactly the operations of the plain form, so the two agree bit for bit.
+ *
+ * fractal3() sums octaves of 3D Perlin noise for the volumetric terrain's caves and overhangs.
+ * It is scalar only and ignores the basis, interpolant and warp of its settings.
+ *
+ * The shared code sticks to what both languages compile: templates and aliases, but no
+ * references (Metal would need an address space on them), lambdas or standard library past
+ * the primitives. The enums are 32 bits wide in both, so NoiseSettings has the same six-word
+ * layout on either side.
+ */
+
+#pragma once
+
+#ifdef __METAL_VERSION__
+#include <metal_stdlib>
+#define NOISE_CONSTANT constant
+#else
+#include <simd/simd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#define NOISE_CONSTANT const
+#endif
+
+/**
+ * @brief Interpolant used between value-noise lattice points.
+ */
+enum class NoiseInterpolation : uint32_t {
+    Cosine,     ///< (1 - cos(pi * t)) / 2, with the cosine approximated by a shared polynomial.
+    Smoothstep, ///< Polynomial 3t^2 - 2t^3; a few operations cheaper than the cosine.
+};
+
+/**
+ * @brief The lattice function every octave samples.
+ */
+enum class NoiseBasis : uint32_t {
+    Value,      ///< Random values at lattice points, blended with the NoiseInterpolation.
+    Gradient,   ///< Perlin noise: random gradients at lattice points, quintic fade.
+    Simplex,    ///< 2D simplex noise: three corners per sample, no directional artifacts.
+};
+
+/**
+ * @struct NoiseSettings
+ * @brief Selects a fractal noise field.
+ *
+ * Laid out as six 32-bit words so GPU parameter structs can embed it as is.
+ */
+struct NoiseSettings {
+    uint32_t seed = 0;                                          ///< Different seeds give unrelated fields.
+    NoiseBasis basis = NoiseBasis::Value;                       ///< Lattice function.
+    NoiseInterpolation interpolation = NoiseInterpolation::Cosine; ///< Only used by NoiseBasis::Value.
+    float warp = 0.0f;                                          ///< Domain warp distance in noise units; 0 disables it.
+    uint32_t octaves = 5;                                       ///< Octaves summed, each at twice the frequency.
+    float persistence = 0.45f;                                  ///< Amplitude of each octave relative to the previous one.
+};
+
+namespace noise_shared {
+    NOISE_CONSTANT uint32_t OCTAVE_SEED_STEP = 0x9e3779b9u;
+
+    // Skew constants of 2D simplex noise: (sqrt(3) - 1) / 2 and (3 - sqrt(3)) / 6
+    NOISE_CONSTANT float SIMPLEX_F2 = 0.36602540f;
+    NOISE_CONSTANT float SIMPLEX_G2 = 0.21132487f;
+
+    // Keep each basis inside [-1, 1]: Perlin noise with these gradients peaks below 0.8 and
+    // the simplex corner sum near 0.0111
+    NOISE_CONSTANT float GRADIENT_SCALE = 1.25f;
+    // 3D Perlin noise with the cube-edge gradients peaks a little above 1
+    NOISE_CONSTANT float GRADIENT3_SCALE = 0.9f;
+    NOISE_CONSTANT float SIMPLEX_SCALE = 80.0f;
+
+    // The lane types every function below is written against; the SIMD path adds Lanes in noise.cpp
+    struct Scalar {
+        using F = float;
+        using I = int32_t;
+        using U = uint32_t;
+    };
+
+#ifdef __METAL_VERSION__
+    // Built without fast math (see metal_compile_options()), so these round like their C++ counterparts
+    inline float fused(float a, float b, float c) { return metal::fma(a, b, c); }
+    inline int32_t floor_to_int(float v) { return int32_t(metal::floor(v)); }
+    inline float to_float(int32_t v) { return float(v); }
+    inline float to_float(uint32_t v) { return float(v); }
+    inline uint32_t to_bits(int32_t v) { return uint32_t(v); }
+    inline float max_zero(float v) { return metal::max(v, 0.0f); }
+    inline int32_t greater(float a, float b) { return a > b ? 1 : 0; }
+#else
+    inline float fused(float a, float b, float c) { return std::fma(a, b, c); }
+    inline simd::float4 fused(simd::float4 a, simd::float4 b, simd::float4 c) { return simd::fma(a, b, c); }
+    inline simd::float8 fused(simd::float8 a, simd::float8 b, simd::float8 c) { return simd::fma(a, b, c); }
+    inline int32_t floor_to_int(float v) { return (int32_t)floorf(v); }
+    inline simd::int4 floor_to_int(simd::float4 v) { return simd_int(simd::floor(v)); }
+    inline simd::int8 floor_to_int(simd::float8 v) { return simd_int(simd::floor(v)); }
+    inline float to_float(int32_t v) { return (float)v; }
+    inline simd::float4 to_float(simd::int4 v) { return simd_float(v); }
+    inline simd::float8 to_float(simd::int8 v) { return simd_float(v); }
+    inline float to_float(uint32_t v) { return (float)v; }
+    inline simd::float4 to_float(simd::uint4 v) { return simd_float(v); }
+    inline simd::float8 to_float(simd::uint8 v) { return simd_float(v); }
+    inline uint32_t to_bits(int32_t v) { return (uint32_t)v; }
+    inline simd::uint4 to_bits(simd::int4 v) { return simd_uint(v); }
+    inline simd::uint8 to_bits(simd::int8 v) { return simd_uint(v); }
+    inline float max_zero(float v) { return std::max(v, 0.0f); }
+    inline simd::float4 max_zero(simd::float4 v) { return simd::max(v, 0.0f); }
+    inline simd::float8 max_zero(simd::float8 v) { return simd::max(v, 0.0f); }
+    inline int32_t greater(float a, float b) { return a > b ? 1 : 0; }
+    inline simd::int4 greater(simd::float4 a, simd::float4 b) { return 0 - (a > b); }
+    inline simd::int8 greater(simd::float8 a, simd::float8 b) { return 0 - (a > b); }
+#endif
+
+    // A field value and its partial derivatives, in the units of the point it was evaluated at
+    template <typename F>
+    struct Sample {
+        F value;
+        F dx;
+        F dz;
+    };
+
+    template <typename F>
+    struct Gradient {
+        F x;
+        F z;
+    };
+
+    template <typename U>
+    U mix_bits(U h) {
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    template <typename U>
+    U hash_point(uint32_t seed, U x, U z) {
+        U h = mix_bits(U(mix_bits(seed)) ^ (z * 0xd8163841u));
+        return mix_bits(h ^ (x * 0x8da6b343u));
+    }
+
+    template <typename F>
+    F lerp(F a, F b, F t) {
+        return fused(t, b - a, a);
+    }
+
+    template <typename F, typename U>
+    F unit_value(U h) {
+        // 31 bits scaled by 2^-30, so the product is exact
+        return fused(to_float(h & 0x7fffffffu), F(-1.0f / 1073741824.0f), F(1.0f));
+    }
+
+    // sin(pi u) and cos(pi u) for u in [-1/2, 1/2], by minimax polynomials within 1e-7 of the
+    // exact values. The cosine interpolant needs nothing wider, and unlike the platforms' sin
+    // and cos these are built from fused ops, so they round alike on every path
+    template <typename F>
+    F sin_half_turn(F u) {
+        const F z = u * u;
+        const F p = fused(fused(fused(fused(F(0.0772202611f), z, F(-0.598045230f)), z, F(2.55003142f)), z,
+                                F(-5.16770697f)), z, F(3.14159250f));
+        return u * p;
+    }
+
+    template <typename F>
+    F cos_half_turn(F u) {
+        const F z = u * u;
+        const F p = fused(fused(fused(F(0.219698206f), z, F(-1.33188093f)), z, F(4.05841208f)), z, F(-4.93479300f));
+        return fused(p, z, F(0.99999994f));
+    }
+
+    template <typename F>
+    F blend_weight(F t, NoiseInterpolation interpolation) {
+        if (interpolation == NoiseInterpolation::Smoothstep) {
+            return t * t * fused(t, F(-2.0f), F(3.0f));
+        }
+        // (1 - cos(pi t)) / 2, written as a sine about the middle of the cell
+        return fused(sin_half_turn(t - 0.5f), F(0.5f), F(0.5f));
+    }
+
+    // Derivative of blend_weight with respect to t
+    template <typename F>
+    F blend_slope(F t, NoiseInterpolation interpolation) {
+        if (interpolation == NoiseInterpolation::Smoothstep) {
+            return 6.0f * t * (1.0f - t);
+        }
+        return cos_half_turn(t - 0.5f) * 1.5707964f;
+    }
+
+    template <typename F>
+    F quintic_fade(F t) {
+        return t * t * t * fused(t, fused(t, F(6.0f), F(-15.0f)), F(10.0f));
+    }
+
+    // Derivative of quintic_fade: 30 t^2 (t - 1)^2
+    template <typename F>
+    F quintic_slope(F t) {
+        const F s = t * (t - 1.0f);
+        return 30.0f * s * s;
+    }
+
+    // One of eight gradients (+-1, +-0.5) or (+-0.5, +-1); the products with them are exact
+    template <typename F, typename U>
+    Gradient<F> lattice_gradient(U h) {
+        const F signX = fused(to_float(h & 1u), F(-2.0f), F(1.0f));
+        const F signZ = fused(to_float((h >> 1) & 1u), F(-2.0f), F(1.0f));
+        const F tall = to_float((h >> 2) & 1u);
+        Gradient<F> g;
+        g.x = signX * fused(tall, F(-0.5f), F(1.0f));
+        g.z = signZ * fused(tall, F(0.5f), F(0.5f));
+        return g;
+    }
+
+    template <typename F>
+    F dot_gradient(Gradient<F> g, F dx, F dz) {
+        return fused(g.x, dx, g.z * dz);
+    }
+
+    template <typename F, typename U>
+    F gradient_dot(U h, F dx, F dz) {
+        return dot_gradient(lattice_gradient<F>(h), dx, dz);
+    }
+
+    template <typename T>
+    typename T::F value_noise(typename T::F x, typename T::F z, uint32_t seed, NoiseInterpolation interpolation) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+        const I ix = floor_to_int(x);
+        const I iz = floor_to_int(z);
+        const F fx = x - to_float(ix);
+        const F fz = z - to_float(iz);
+        const U ux = to_bits(ix);
+        const U uz = to_bits(iz);
+
+        const F v1 = unit_value<F>(hash_point(seed, ux, uz));
+        const F v2 = unit_value<F>(hash_point(seed, ux + 1u, uz));
+        const F v3 = unit_value<F>(hash_point(seed, ux, uz + 1u));
+        const F v4 = unit_value<F>(hash_point(seed, ux + 1u, uz + 1u));
+
+        const F wx = blend_weight(fx, interpolation);
+        return lerp(lerp(v1, v2, wx), lerp(v3, v4, wx), blend_weight(fz, interpolation));
+    }
+
+    template <typename T>
+    Sample<typename T::F> value_noise_derivative(typename T::F x, typename T::F z, uint32_t seed,
+                                                 NoiseInterpolation interpolation) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+        const I ix = floor_to_int(x);
+        const I iz = floor_to_int(z);
+        const F fx = x - to_float(ix);
+        const F fz = z - to_float(iz);
+        const U ux = to_bits(ix);
+        const U uz = to_bits(iz);
+
+        const F v1 = unit_value<F>(hash_point(seed, ux, uz));
+        const F v2 = unit_value<F>(hash_point(seed, ux + 1u, uz));
+        const F v3 = unit_value<F>(hash_point(seed, ux, uz + 1u));
+        const F v4 = unit_value<F>(hash_point(seed, ux + 1u, uz + 1u));
+
+        const F wx = blend_weight(fx, interpolation);
+        const F wz = blend_weight(fz, interpolation);
+        const F bottom = lerp(v1, v2, wx);
+        const F top = lerp(v3, v4, wx);
+        Sample<F> s;
+        s.value = lerp(bottom, top, wz);
+        s.dx = lerp(v2 - v1, v4 - v3, wz) * blend_slope(fx, interpolation);
+        s.dz = (top - bottom) * blend_slope(fz, interpolation);
+        return s;
+    }
+
+    template <typename T>
+    typename T::F perlin_noise(typename T::F x, typename T::F z, uint32_t seed) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+        const I ix = floor_to_int(x);
+        const I iz = floor_to_int(z);
+        const F fx = x - to_float(ix);
+        const F fz = z - to_float(iz);
+        const U ux = to_bits(ix);
+        const U uz = to_bits(iz);
+
+        const F n00 = gradient_dot(hash_point(seed, ux, uz), fx, fz);
+        const F n10 = gradient_dot(hash_point(seed, ux + 1u, uz), fx - 1.0f, fz);
+        const F n01 = gradient_dot(hash_point(seed, ux, uz + 1u), fx, fz - 1.0f);
+        const F n11 = gradient_dot(hash_point(seed, ux + 1u, uz + 1u), fx - 1.0f, fz - 1.0f);
+
+        const F u = quintic_fade(fx);
+        return lerp(lerp(n00, n10, u), lerp(n01, n11, u), quintic_fade(fz)) * GRADIENT_SCALE;
+    }
+
+    template <typename T>
+    Sample<typename T::F> perlin_noise_derivative(typename T::F x, typename T::F z, uint32_t seed) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+        const I ix = floor_to_int(x);
+        const I iz = floor_to_int(z);
+        const F fx = x - to_float(ix);
+        const F fz = z - to_float(iz);
+        const U ux = to_bits(ix);
+        const U uz = to_bits(iz);
+
+        const Gradient<F> g00 = lattice_gradient<F>(hash_point(seed, ux, uz));
+        const Gradient<F> g10 = lattice_gradient<F>(hash_point(seed, ux + 1u, uz));
+        const Gradient<F> g01 = lattice_gradient<F>(hash_point(seed, ux, uz + 1u));
+        const Gradient<F> g11 = lattice_gradient<F>(hash_point(seed, ux + 1u, uz + 1u));
+        const F n00 = dot_gradient(g00, fx, fz);
+        const F n10 = dot_gradient(g10, fx - 1.0f, fz);
+        const F n01 = dot_gradient(g01, fx, fz - 1.0f);
+        const F n11 = dot_gradient(g11, fx - 1.0f, fz - 1.0f);
+
+        // Each row is lerp(n0, n1, u): its gradients blended by u, plus u' times the step between them
+        const F u = quintic_fade(fx);
+        const F v = quintic_fade(fz);
+        const F du = quintic_slope(fx);
+        const F bottom = lerp(n00, n10, u);
+        const F top = lerp(n01, n11, u);
+        const F bottomX = fused(du, n10 - n00, lerp(g00.x, g10.x, u));
+        const F topX = fused(du, n11 - n01, lerp(g01.x, g11.x, u));
+        const F bottomZ = lerp(g00.z, g10.z, u);
+        const F topZ = lerp(g01.z, g11.z, u);
+        Sample<F> s;
+        s.value = lerp(bottom, top, v) * GRADIENT_SCALE;
+        s.dx = lerp(bottomX, topX, v) * GRADIENT_SCALE;
+        s.dz = fused(quintic_slope(fz), top - bottom, lerp(bottomZ, topZ, v)) * GRADIENT_SCALE;
+        return s;
+    }
+
+    template <typename F, typename U>
+    F simplex_corner(U h, F dx, F dz) {
+        const F t = max_zero(fused(-dx, dx, fused(-dz, dz, F(0.5f))));
+        const F t2 = t * t;
+        return t2 * t2 * gradient_dot(h, dx, dz);
+    }
+
+    // d(t^4 n) = t^4 grad(n) - 8 t^3 n (dx, dz), with t = 0.5 - dx^2 - dz^2 clamped at 0
+    template <typename F, typename U>
+    Sample<F> simplex_corner_derivative(U h, F dx, F dz) {
+        const F t = max_zero(fused(-dx, dx, fused(-dz, dz, F(0.5f))));
+        const F t2 = t * t;
+        const Gradient<F> g = lattice_gradient<F>(h);
+        const F n = dot_gradient(g, dx, dz);
+        const F falloff = -8.0f * t2 * t * n;
+        Sample<F> s;
+        s.value = t2 * t2 * n;
+        s.dx = fused(falloff, dx, t2 * t2 * g.x);
+        s.dz = fused(falloff, dz, t2 * t2 * g.z);
+        return s;
+    }
+
+    template <typename T>
+    typename T::F simplex(typename T::F x, typename T::F z, uint32_t seed) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+
+        // Skew onto the square lattice to find the simplex cell, then unskew its corner
+        const F sum = x + z;
+        const I i = floor_to_int(fused(sum, F(SIMPLEX_F2), x));
+        const I j = floor_to_int(fused(sum, F(SIMPLEX_F2), z));
+        const F fi = to_float(i);
+        const F fj = to_float(j);
+        const F x0 = x - fused(-(fi + fj), F(SIMPLEX_G2), fi);
+        const F z0 = z - fused(-(fi + fj), F(SIMPLEX_G2), fj);
+
+        // The middle corner is one step along whichever axis the point is further along
+        const I i1 = greater(x0, z0);
+        const I j1 = 1 - i1;
+        const F x1 = (x0 - to_float(i1)) + SIMPLEX_G2;
+        const F z1 = (z0 - to_float(j1)) + SIMPLEX_G2;
+        const F x2 = x0 + (2.0f * SIMPLEX_G2 - 1.0f);
+        const F z2 = z0 + (2.0f * SIMPLEX_G2 - 1.0f);
+
+        const U ui = to_bits(i);
+        const U uj = to_bits(j);
+        const F n0 = simplex_corner(hash_point(seed, ui, uj), x0, z0);
+        const F n1 = simplex_corner(hash_point(seed, ui + to_bits(i1), uj + to_bits(j1)), x1, z1);
+        const F n2 = simplex_corner(hash_point(seed, ui + 1u, uj + 1u), x2, z2);
+        return (n0 + n1 + n2) * SIMPLEX_SCALE;
+    }
+
+    // The corner offsets move one for one with the point inside a cell, so each corner's
+    // derivative with respect to its offset is its derivative with respect to the point
+    template <typename T>
+    Sample<typename T::F> simplex_derivative(typename T::F x, typename T::F z, uint32_t seed) {
+        using F = typename T::F;
+        using I = typename T::I;
+        using U = typename T::U;
+
+        const F sum = x + z;
+        const I i = floor_to_int(fused(sum, F(SIMPLEX_F2), x));
+        const I j = floor_to_int(fused(sum, F(SIMPLEX_F2), z));
+        const F fi = to_float(i);
+        const F fj = to_float(j);
+        const F x0 = x - fused(-(fi + fj), F(SIMPLEX_G2), fi);
+        const F z0 = z - fused(-(fi + fj), F(SIMPLEX_G2), fj);
+
+        const I i1 = greater(x0, z0);
+        const I j1 = 1 - i1;
+        const F x1 = (x0 - to_float(i1)) + SIMPLEX_G2;
+        const F z1 = (z0 - to_float(j1)) + SIMPLEX_G2;
+        const F x2 = x0 + (2.0f * SIMPLEX_G2 - 1.0f);
+        const F z2 = z0 + (2.0f * SIMPLEX_G2 - 1.0f);
+
+        const U ui = to_bits(i);
+        const U uj = to_bits(j);
+        const Sample<F> n0 = simplex_corner_derivative(hash_point(seed, ui, uj), x0, z0);
+        const Sample<F> n1 = simplex_corner_derivative(hash_point(seed, ui + to_bits(i1), uj + to_bits(j1)), x1, z1);
+        const Sample<F> n2 = simplex_corner_derivative(hash_point(seed, ui + 1u, uj + 1u), x2, z2);
+        Sample<F> s;
+        s.value = (n0.value + n1.value + n2.value) * SIMPLEX_SCALE;
+        s.dx = (n0.dx + n1.dx + n2.dx) * SIMPLEX_SCALE;
+        s.dz = (n0.dz + n1.dz + n2.dz) * SIMPLEX_SCALE;
+        return s;
+    }
+
+    template <typename T>
+    typename T::F basis_noise(typename T::F x, typename T::F z, uint32_t seed, NoiseSettings settings) {
+        switch (settings.basis) {
+        case NoiseBasis::Gradient:
+            return perlin_noise<T>(x, z, seed);
+        case NoiseBasis::Simplex:
+            return simplex<T>(x, z, seed);
+        case NoiseBasis::Value:
+            break;
+        }
+        return value_noise<T>(x, z, seed, settings.interpolation);
+    }
+
+    template <typename T>
+    Sample<typename T::F> basis_noise_derivative(typename T::F x, typename T::F z, uint32_t seed,
+                                                 NoiseSettings settings) {
+        switch (settings.basis) {
+        case NoiseBasis::Gradient:
+            return perlin_noise_derivative<T>(x, z, seed);
+        case NoiseBasis::Simplex:
+            return simplex_derivative<T>(x, z, seed);
+        case NoiseBasis::Value:
+            break;
+        }
+        return value_noise_derivative<T>(x, z, seed, settings.interpolation);
+    }
+
+    inline uint32_t hash_point3(uint32_t seed, uint32_t x, uint32_t y, uint32_t z) {
+        uint32_t h = mix_bits(mix_bits(seed) ^ (y * 0x9e3779b1u));
+        h = mix_bits(h ^ (z * 0xd8163841u));
+        return mix_bits(h ^ (x * 0x8da6b343u));
+    }
+
+    // Dot product with one of the twelve cube-edge gradients, four of them twice; exact, as
+    // every component is 0 or +-1
+    inline float gradient_dot3(uint32_t h, float dx, float dy, float dz) {
+        const uint32_t c = h & 15u;
+        const float u = c < 8u ? dx : dy;
+        const float v = c < 4u ? dy : (c == 12u || c == 14u ? dx : dz);
+        return ((c & 1u) != 0u ? -u : u) + ((c & 2u) != 0u ? -v : v);
+    }
+
+    inline float perlin_noise3(float x, float y, float z, uint32_t seed) {
+        const int32_t ix = floor_to_int(x);
+        const int32_t iy = floor_to_int(y);
+        const int32_t iz = floor_to_int(z);
+        const float fx = x - to_float(ix);
+        const float fy = y - to_float(iy);
+        const float fz = z - to_float(iz);
+        const uint32_t ux = to_bits(ix);
+        const uint32_t uy = to_bits(iy);
+        const uint32_t uz = to_bits(iz);
+
+        const float n000 = gradient_dot3(hash_point3(seed, ux, uy, uz), fx, fy, fz);
+        const float n100 = gradient_dot3(hash_point3(seed, ux + 1u, uy, uz), fx - 1.0f, fy, fz);
+        const float n010 = gradient_dot3(hash_point3(seed, ux, uy + 1u, uz), fx, fy - 1.0f, fz);
+        const float n110 = gradient_dot3(hash_point3(seed, ux + 1u, uy + 1u, uz), fx - 1.0f, fy - 1.0f, fz);
+        const float n001 = gradient_dot3(hash_point3(seed, ux, uy, uz + 1u), fx, fy, fz - 1.0f);
+        const float n101 = gradient_dot3(hash_point3(seed, ux + 1u, uy, uz + 1u), fx - 1.0f, fy, fz - 1.0f);
+        const float n011 = gradient_dot3(hash_point3(seed, ux, uy + 1u, uz + 1u), fx, fy - 1.0f, fz - 1.0f);
+        const float n111 =
+            gradient_dot3(hash_point3(seed, ux + 1u, uy + 1u, uz + 1u), fx - 1.0f, fy - 1.0f, fz - 1.0f);
+
+        const float u = quintic_fade(fx);
+        const float v = quintic_fade(fy);
+        const float front = lerp(lerp(n000, n100, u), lerp(n010, n110, u), v);
+        const float back = lerp(lerp(n001, n101, u), lerp(n011, n111, u), v);
+        return lerp(front, back, quintic_fade(fz)) * GRADIENT3_SCALE;
+    }
+
+    // Octaves of perlin_noise3; the settings supply the seed, octave count and persistence
+    inline float fractal3(float x, float y, float z, NoiseSettings settings) {
+        float total = 0.0f;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        for (uint32_t i = 0; i < settings.octaves; i++) {
+            const uint32_t seed = settings.seed + i * OCTAVE_SEED_STEP;
+            total = fused(perlin_noise3(x * frequency, y * frequency, z * frequency, seed), amplitude, total);
+            amplitude *= settings.persistence;
+            frequency *= 2.0f;
+        }
+        return total;
+    }
+
+    // Where fractal() finds its basis and interpolant: in the settings, or fixed at compile time
+    // so every octave inlines a single basis with the interpolant's branch folded away
+    struct SettingsField {
+        template <typename T>
+        static typename T::F value(typename T::F x, typename T::F z, uint32_t seed, NoiseSettings settings) {
+            return basis_noise<T>(x, z, seed, settings);
+        }
+
+        template <typename T>
+        static Sample<typename T::F> derivative(typename T::F x, typename T::F z, uint32_t seed,
+                                                NoiseSettings settings) {
+            return basis_noise_derivative<T>(x, z, seed, settings);
+        }
+    };
+
+    template <NoiseBasis Basis, NoiseInterpolation Interpolation>
+    struct FixedField {
+        template <typename T>
+        static typename T::F value(typename T::F x, typename T::F z, uint32_t seed, NoiseSettings) {
+            if (Basis == NoiseBasis::Gradient) {
+                return perlin_noise<T>(x, z, seed);
+            }
+            if (Basis == NoiseBasis::Simplex) {
+                return simplex<T>(x, z, seed);
+            }
+            return value_noise<T>(x, z, seed, Interpolation);
+        }
+
+        template <typename T>
+        static Sample<typename T::F> derivative(typename T::F x, typename T::F z, uint32_t seed, NoiseSettings) {
+            if (Basis == NoiseBasis::Gradient) {
+                return perlin_noise_derivative<T>(x, z, seed);
+            }
+            if (Basis == NoiseBasis::Simplex) {
+                return simplex_derivative<T>(x, z, seed);
+            }
+            return value_noise_derivative<T>(x, z, seed, Interpolation);
+        }
+    };
+
+    // Octaves > 0 fixes the count at compile time so the loop unrolls, with every frequency a
+    // constant; 0 reads settings.octaves
+    template <typename T, uint32_t Octaves, typename Field = SettingsField>
+    typename T::F fractal(typename T::F x, typename T::F z, NoiseSettings settings) {
+        using F = typename T::F;
+        if (settings.warp != 0.0f) {
+            // Offset the point by two more samples of the basis, at unrelated positions and seeds
+            const F warpX = Field::template value<T>(x + 5.2f, z + 1.3f, settings.seed ^ 0x68bc21ebu, settings);
+            const F warpZ = Field::template value<T>(x + 1.7f, z + 9.2f, settings.seed ^ 0x02e5be93u, settings);
+            x = fused(warpX, F(settings.warp), x);
+            z = fused(warpZ, F(settings.warp), z);
+        }
+
+        const uint32_t octaves = Octaves > 0 ? Octaves : settings.octaves;
+        F total = 0.0f;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        for (uint32_t i = 0; i < octaves; i++) {
+            const uint32_t seed = settings.seed + i * OCTAVE_SEED_STEP;
+            total = fused(Field::template value<T>(x * frequency, z * frequency, seed, settings), F(amplitude), total);
+            amplitude *= settings.persistence;
+            frequency *= 2.0f;
+        }
+        return total;
+    }
+
+    // fractal() with its derivatives: each octave's scaled by its amplitude and frequency, then
+    // carried through the warp by the chain rule
+    template <typename T, uint32_t Octaves, typename Field = SettingsField>
+    Sample<typename T::F> fractal_derivative(typename T::F x, typename T::F z, NoiseSettings settings) {
+        using F = typename T::F;
+        // Derivatives of the warped point along x and z; the identity without warp
+        F xAlongX = 1.0f, xAlongZ = 0.0f, zAlongX = 0.0f, zAlongZ = 1.0f;
+        if (settings.warp != 0.0f) {
+            const Sample<F> warpX =
+                Field::template derivative<T>(x + 5.2f, z + 1.3f, settings.seed ^ 0x68bc21ebu, settings);
+            const Sample<F> warpZ =
+                Field::template derivative<T>(x + 1.7f, z + 9.2f, settings.seed ^ 0x02e5be93u, settings);
+            x = fused(warpX.value, F(settings.warp), x);
+            z = fused(warpZ.value, F(settings.warp), z);
+            xAlongX = fused(warpX.dx, F(settings.warp), F(1.0f));
+            xAlongZ = warpX.dz * settings.warp;
+            zAlongX = warpZ.dx * settings.warp;
+            zAlongZ = fused(warpZ.dz, F(settings.warp), F(1.0f));
+        }
+
+        const uint32_t octaves = Octaves > 0 ? Octaves : settings.octaves;
+        F total = 0.0f;
+        F totalX = 0.0f;
+        F totalZ = 0.0f;
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        for (uint32_t i = 0; i < octaves; i++) {
+            const uint32_t seed = settings.seed + i * OCTAVE_SEED_STEP;
+            const Sample<F> octave = Field::template derivative<T>(x * frequency, z * frequency, seed, settings);
+            total = fused(octave.value, F(amplitude), total);
+            totalX = fused(octave.dx, F(amplitude * frequency), totalX);
+            totalZ = fused(octave.dz, F(amplitude * frequency), totalZ);
+            amplitude *= settings.persistence;
+            frequency *= 2.0f;
+        }
+
+        Sample<F> s;
+        s.value = total;
+        s.dx = fused(totalX, xAlongX, totalZ * zAlongX);
+        s.dz = fused(totalX, xAlongZ, totalZ * zAlongZ);
+        return s;
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <simd/simd.h>
+#include <cfloat>
 #include <vector>
 
 
@@ -9,10 +10,167 @@ struct Vertex {
     simd::float3 normal;
 };
 
-struct GameObject {
-    simd::float4x4 modelMatrix;
-    simd::float3 color;
+/**
+ * @brief Compact vertex: 12 bytes instead of the 32 of Vertex.
+ *
+ * Positions are unorm16 inside a per-mesh QuantizationBox and normals are
+ * octahedral-encoded snorm16 pairs; see vertex_packing.hpp.
+ */
+struct PackedVertex {
+    uint16_t position[4];   ///< x, y, z as unorm16 within the mesh's box; w is always 65535.
+    int16_t normal[2];      ///< Octahedral-encoded unit normal.
+};
+
+/**
+ * @brief Vertex layouts a mesh can be uploaded in.
+ */
+enum class VertexFormat {
+    Float,  ///< Vertex: full-precision float3 position and normal.
+    Packed  ///< PackedVertex: quantized position and octahedral normal.
+};
+
+/// @return The size in bytes of one vertex in the given format.
+inline size_t vertex_stride(VertexFormat format) {
+    return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+/// Direction towards the sun in world space: normalize(0.8, 1.0, 0.5).
+constexpr simd::float3 LIGHT_DIRECTION = { 0.5819f, 0.7274f, 0.3637f };
+
+/// Vertex and fragment buffer index of FrameUniforms in every scene and shadow pipeline.
+constexpr uint32_t FRAME_UNIFORMS_BUFFER_INDEX = 5;
+
+/**
+ * @brief Per-pass shader constants; matches `FrameUniforms` in shaders.metal.
+ *
+ * Bound once per encoder at FRAME_UNIFORMS_BUFFER_INDEX, so draws only carry what differs
+ * between them and a vertex is moved to clip space with a single matrix product.
+ */
+struct FrameUniforms {
+    simd::float4x4 viewProjection;   ///< World to clip transform.
+    simd::float4x4 previousViewProjection; ///< Unjittered world to clip transform of the previous frame; see reprojection.hpp.
+    simd::float3 cameraPosition;     ///< World space eye position.
+    simd::float3 lightDirection;     ///< Towards the light, unit length.
+    float fogDensity;                ///< FogSettings::density; read by the distance_fog variants.
+    float fadeStart;                 ///< FogSettings::fadeStart; read by the far_fade variants.
+    float fadeEnd;                   ///< FogSettings::fadeEnd; read by the far_fade variants.
+    uint32_t frameIndex;             ///< Frames rendered before this one; picks the pixels the shading cache refreshes.
+    simd::float4 wind;               ///< foliage_wind(); read by the foliage_wind variants.
+};
+
+/**
+ * @brief Per-draw shader uniforms; matches `Uniforms` in shaders.metal.
+ */
+struct Uniforms {
+    simd::float4x4 modelMatrix;      ///< Object to world transform.
+    simd::float3x3 normalMatrix;     ///< Inverse transpose of the model 3x3; see matrix_normal().
+    simd::float3 color;              ///< Flat color of the object.
+};
+
+/**
+ * @brief Per-instance data for instanced draws; matches `InstanceData` in shaders.metal.
+ */
+struct InstanceData {
+    simd::float4x4 modelMatrix;    ///< Object to world transform.
+    simd::float4 color;             ///< rgb: flat colour; a: how far a foliage part has dissolved into its impostor.
+};
+
+/**
+ * @brief Vertex and index counts of a mesh, known before it is built.
+ *
+ * Lets callers size output buffers, or Metal buffers, once and build straight into them.
+ */
+struct MeshSize {
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+};
+
+/**
+ * @brief Index widths a mesh can be stored with.
+ */
+enum class IndexFormat {
+    UInt16, ///< uint16_t indices; addresses up to 65535 vertices (0xFFFF is left for primitive restart).
+    UInt32  ///< uint32_t indices.
+};
+
+/// @return The narrowest index format that can address vertexCount vertices.
+inline IndexFormat index_format_for(size_t vertexCount) {
+    return vertexCount <= 0xFFFF ? IndexFormat::UInt16 : IndexFormat::UInt32;
+}
+
+/// @return The size in bytes of one index in the given format.
+inline size_t index_stride(IndexFormat format) {
+    return format == IndexFormat::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+/**
+ * @brief Triangle list indices stored in the narrowest width the mesh allows.
+ *
+ * Only the vector matching format holds data; builders write into it directly.
+ */
+struct MeshIndices {
+    IndexFormat format = IndexFormat::UInt32; ///< Which of the two vectors is in use.
+    std::vector<uint16_t> indices16;          ///< Indices when format is UInt16.
+    std::vector<uint32_t> indices32;          ///< Indices when format is UInt32.
+
+    /// Sizes the storage for count indices and picks the format for vertexCount vertices.
+    void resize(size_t count, size_t vertexCount) {
+        format = index_format_for(vertexCount);
+        indices16.clear();
+        indices32.clear();
+        if (format == IndexFormat::UInt16) {
+            indices16.resize(count);
+        } else {
+            indices32.resize(count);
+        }
+    }
+
+    /// @return The number of indices.
+    size_t size() const { return format == IndexFormat::UInt16 ? indices16.size() : indices32.size(); }
+
+    /// @return The index at position i, widened to 32 bits.
+    uint32_t operator[](size_t i) const { return format == IndexFormat::UInt16 ? indices16[i] : indices32[i]; }
+
+    /// @return The raw index data, e.g. for uploading to an MTLBuffer.
+    const void* data() const {
+        return format == IndexFormat::UInt16 ? (const void*)indices16.data() : (const void*)indices32.data();
+    }
+
+    /// @return The size of the raw index data in bytes.
+    size_t byte_size() const { return size() * index_stride(format); }
+};
+
+/**
+ * @brief Axis-aligned bounding box.
+ */
+struct BoundingBox {
+    simd::float3 min;   ///< Smallest corner.
+    simd::float3 max;   ///< Largest corner.
+};
+
+/**
+ * @brief Returns the bounds of a vertex array.
+ * @param vertices The vertices.
+ * @param count The number of vertices.
+ * @return The tightest box around every position; empty (min > max) for no vertices.
+ */
+inline BoundingBox compute_bounds(const Vertex* vertices, size_t count) {
+    BoundingBox box = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+    for (size_t i = 0; i < count; ++i) {
+        box.min = simd::min(box.min, vertices[i].position);
+        box.max = simd::max(box.max, vertices[i].position);
+    }
+    return box;
+}
+
+/**
+ * @brief CPU-side geometry of one mesh, as built by the mesh builders.
+ *
+ * Placement and colour are per entity and live in SceneStore; a mesh is shared by handle.
+ */
+struct MeshData {
     std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    MeshIndices indices;
+    BoundingBox bounds;     ///< Model space bounds of vertices, set by the builder.
 };
 
@@ -0,0 +1,251 @@
+#include "occlusion_buffer.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+    struct ScreenVertex {
+        float x, y;         // Pixels, y down
+        float inverseDepth; // 1 / view depth
+    };
+
+    simd::float4 to_clip(const simd::float4x4& viewProjection, simd::float3 position) {
+        return viewProjection * simd::float4{ position.x, position.y, position.z, 1.0f };
+    }
+
+    ScreenVertex to_screen(const OcclusionBuffer& buffer, simd::float4 clip) {
+        const float inverseW = 1.0f / clip.w;
+        return { (clip.x * inverseW * 0.5f + 0.5f) * buffer.width, (0.5f - clip.y * inverseW * 0.5f) * buffer.height,
+                 inverseW };
+    }
+
+    void rasterize(OcclusionBuffer& buffer, const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2) {
+        const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (fabsf(area) < 1e-6f) {
+            return;
+        }
+        const int x0 = std::max((int)floorf(std::min({ v0.x, v1.x, v2.x })), 0);
+        const int x1 = std::min((int)ceilf(std::max({ v0.x, v1.x, v2.x })), (int)buffer.width);
+        const int y0 = std::max((int)floorf(std::min({ v0.y, v1.y, v2.y })), 0);
+        const int y1 = std::min((int)ceilf(std::max({ v0.y, v1.y, v2.y })), (int)buffer.height);
+        if (x0 >= x1 || y0 >= y1) {
+            return;
+        }
+
+        // Barycentrics as planes over the screen, divided by the area so either winding is inside where all are
+        // positive; the edge opposite each vertex runs between the other two
+        const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+        float dx[3], dy[3], c[3];
+        for (int i = 0; i < 3; ++i) {
+            const ScreenVertex& a = *v[(i + 1) % 3];
+            const ScreenVertex& b = *v[(i + 2) % 3];
+            dx[i] = (a.y - b.y) / area;
+            dy[i] = (b.x - a.x) / area;
+            c[i] = ((b.y - a.y) * a.x - (b.x - a.x) * a.y) / area;
+        }
+        // Inverse depth is affine in screen space
+        const float zdx = dx[0] * v0.inverseDepth + dx[1] * v1.inverseDepth + dx[2] * v2.inverseDepth;
+        const float zdy = dy[0] * v0.inverseDepth + dy[1] * v1.inverseDepth + dy[2] * v2.inverseDepth;
+        const float zc = c[0] * v0.inverseDepth + c[1] * v1.inverseDepth + c[2] * v2.inverseDepth;
+
+        for (int y = y0; y < y1; ++y) {
+            const float py = y + 0.5f;
+            float* row = buffer.inverseDepth.data() + (size_t)y * buffer.width;
+            for (int x = x0; x < x1; x += 4) {
+                const simd::float4 px = simd::float4{ 0.5f, 1.5f, 2.5f, 3.5f } + (float)x;
+                const simd::float4 l0 = px * dx[0] + (dy[0] * py + c[0]);
+                const simd::float4 l1 = px * dx[1] + (dy[1] * py + c[1]);
+                const simd::float4 l2 = px * dx[2] + (dy[2] * py + c[2]);
+                const simd::float4 inside = simd::min(simd::min(l0, l1), l2);
+                const simd::float4 z = px * zdx + (zdy * py + zc);
+                const int lanes = std::min(4, x1 - x);
+                for (int lane = 0; lane < lanes; ++lane) {
+                    if (inside[lane] >= 0.0f && z[lane] > row[x + lane]) {
+                        row[x + lane] = z[lane];
+                    }
+                }
+            }
+        }
+    }
+
+    simd::float4 clip_lerp(simd::float4 a, simd::float4 b) {
+        const float t = (OCCLUSION_NEAR - a.w) / (b.w - a.w);
+        return a + (b - a) * t;
+    }
+}
+
+void occlusion_buffer_begin(OcclusionBuffer& buffer, const simd::float4x4& viewProjection, uint32_t width,
+                            uint32_t height) {
+    buffer.width = width;
+    buffer.height = height;
+    buffer.viewProjection = viewProjection;
+    buffer.inverseDepth.assign((size_t)width * height, 0.0f);
+}
+
+void occlusion_buffer_triangle(OcclusionBuffer& buffer, simd::float3 a, simd::float3 b, simd::float3 c) {
+    const simd::float4 clip[3] = { to_clip(buffer.viewProjection, a), to_clip(buffer.viewProjection, b),
+                                   to_clip(buffer.viewProjection, c) };
+    // Clipped against the near plane in clip space, which leaves at most a quad
+    simd::float4 polygon[4];
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const simd::float4& from = clip[i];
+        const simd::float4& to = clip[(i + 1) % 3];
+        const bool fromInside = from.w >= OCCLUSION_NEAR;
+        const bool toInside = to.w >= OCCLUSION_NEAR;
+        if (fromInside) {
+            polygon[count++] = from;
+        }
+        if (fromInside != toInside) {
+            polygon[count++] = clip_lerp(from, to);
+        }
+    }
+    if (count < 3) {
+        return;
+    }
+    const ScreenVertex first = to_screen(buffer, polygon[0]);
+    for (int i = 1; i + 1 < count; ++i) {
+        rasterize(buffer, first, to_screen(buffer, polygon[i]), to_screen(buffer, polygon[i + 1]));
+    }
+}
+
+void occlusion_buffer_grid(OcclusionBuffer& buffer, const float* heights, uint32_t side, simd::float2 origin,
+                           float spacing) {
+    for (uint32_t j = 0; j + 1 < side; ++j) {
+        for (uint32_t i = 0; i + 1 < side; ++i) {
+            const float x0 = origin.x + i * spacing;
+            const float z0 = origin.y + j * spacing;
+            const simd::float3 p00 = { x0, heights[j * side + i], z0 };
+            const simd::float3 p10 = { x0 + spacing, heights[j * side + i + 1], z0 };
+            const simd::float3 p01 = { x0, heights[(j + 1) * side + i], z0 + spacing };
+            const simd::float3 p11 = { x0 + spacing, heights[(j + 1) * side + i + 1], z0 + spacing };
+            occlusion_buffer_triangle(buffer, p00, p01, p11);
+            occlusion_buffer_triangle(buffer, p00, p11, p10);
+        }
+    }
+}
+
+bool occlusion_buffer_occludes(const OcclusionBuffer& buffer, const BoundingBox& box) {
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearest = FLT_MAX;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const simd::float3 corner = { (i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                                      (i & 4) ? box.max.z : box.min.z };
+        const simd::float4 clip = to_clip(buffer.viewProjection, corner);
+        if (clip.w < OCCLUSION_NEAR) {
+            return false;
+        }
+        const ScreenVertex v = to_screen(buffer, clip);
+        minX = std::min(minX, v.x);
+        maxX = std::max(maxX, v.x);
+        minY = std::min(minY, v.y);
+        maxY = std::max(maxY, v.y);
+        nearest = std::min(nearest, clip.w);
+    }
+    // Grown by a pixel, since a pixel counts as covered when only its centre is
+    const int x0 = std::max((int)floorf(minX) - 1, 0);
+    const int x1 = std::min((int)floorf(maxX) + 1, (int)buffer.width - 1);
+    const int y0 = std::max((int)floorf(minY) - 1, 0);
+    const int y1 = std::min((int)floorf(maxY) + 1, (int)buffer.height - 1);
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    // Occluder depth * (1 + bias) < nearest, without dividing; empty pixels hold 0 and never pass
+    const float threshold = 1.0f + OCCLUSION_DEPTH_BIAS;
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = buffer.inverseDepth.data() + (size_t)y * buffer.width;
+        for (int x = x0; x <= x1; ++x) {
+            if (row[x] * nearest <= threshold) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t occlusion_cull(const OcclusionBuffer& buffer, const CullBounds& bounds, uint32_t* visible, size_t count) {
+    size_t kept = 0;
+    for (size_t v = 0; v < count; ++v) {
+        const uint32_t i = visible[v];
+        const simd::float3 center = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+        const simd::float3 extent = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+        if (!occlusion_buffer_occludes(buffer, { center - extent, center + extent })) {
+            std::swap(visible[kept++], visible[v]);
+        }
+    }
+    return kept;
+}
+
+void terrain_occluder_build(TerrainOccluder& occluder, simd::float2 origin, float chunkSize,
+                            const std::function<float(float, float)>& height) {
+    constexpr uint32_t CELLS = OCCLUDER_GRID - 1;
+    constexpr uint32_t SAMPLES = CELLS * OCCLUDER_CELL_SAMPLES + 1;
+    const float spacing = chunkSize / (SAMPLES - 1);
+
+    // The lowest sample of each cell, edges included
+    float cellMin[CELLS * CELLS];
+    std::fill(cellMin, cellMin + CELLS * CELLS, FLT_MAX);
+    for (uint32_t j = 0; j < SAMPLES; ++j) {
+        for (uint32_t i = 0; i < SAMPLES; ++i) {
+            const float h = height(origin.x + i * spacing, origin.y + j * spacing);
+            // A sample on a cell edge belongs to the cells on both sides
+            const uint32_t ci0 = i == 0 ? 0 : (i - 1) / OCCLUDER_CELL_SAMPLES;
+            const uint32_t ci1 = std::min(i / OCCLUDER_CELL_SAMPLES, CELLS - 1);
+            const uint32_t cj0 = j == 0 ? 0 : (j - 1) / OCCLUDER_CELL_SAMPLES;
+            const uint32_t cj1 = std::min(j / OCCLUDER_CELL_SAMPLES, CELLS - 1);
+            for (uint32_t cj = cj0; cj <= cj1; ++cj) {
+                for (uint32_t ci = ci0; ci <= ci1; ++ci) {
+                    cellMin[cj * CELLS + ci] = std::min(cellMin[cj * CELLS + ci], h);
+                }
+            }
+        }
+    }
+    // A vertex lies under every cell it is a corner of, so the triangles it spans do too
+    for (uint32_t j = 0; j < OCCLUDER_GRID; ++j) {
+        for (uint32_t i = 0; i < OCCLUDER_GRID; ++i) {
+            float lowest = FLT_MAX;
+            for (uint32_t cj = j == 0 ? 0 : j - 1; cj <= std::min(j, CELLS - 1); ++cj) {
+                for (uint32_t ci = i == 0 ? 0 : i - 1; ci <= std::min(i, CELLS - 1); ++ci) {
+                    lowest = std::min(lowest, cellMin[cj * CELLS + ci]);
+                }
+            }
+            occluder.heights[j * OCCLUDER_GRID + i] = lowest - OCCLUDER_HEIGHT_MARGIN;
+        }
+    }
+}
+
+const TerrainOccluder* terrain_occluder_find(TerrainOccluderCache& cache, ChunkKey key, uint64_t editVersion,
+                                             uint64_t frame) {
+    for (TerrainOccluder& occluder : cache.occluders) {
+        if (occluder.key == key) {
+            if (occluder.editVersion != editVersion) {
+                return nullptr;
+            }
+            occluder.lastUsed = frame;
+            return &occluder;
+        }
+    }
+    return nullptr;
+}
+
+TerrainOccluder& terrain_occluder_slot(TerrainOccluderCache& cache, ChunkKey key, uint64_t editVersion,
+                                       uint64_t frame) {
+    TerrainOccluder* slot = nullptr;
+    for (TerrainOccluder& occluder : cache.occluders) {
+        if (occluder.key == key) {
+            slot = &occluder;
+            break;
+        }
+        if (!slot && occluder.lastUsed != frame) {
+            slot = &occluder;
+        }
+    }
+    if (!slot) {
+        slot = &cache.occluders.emplace_back();
+    }
+    slot->key = key;
+    slot->editVersion = editVersion;
+    slot->lastUsed = frame;
+    return *slot;
+}
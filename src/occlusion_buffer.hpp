@@ -0,0 +1,163 @@
+/**
+ * @file occlusion_buffer.hpp
+ * @brief A low-resolution depth buffer of the terrain, rasterized on the CPU, that hides entities behind hills.
+ *
+ * Each frame the resident chunks in view are drawn as coarse grids of OCCLUDER_GRID x OCCLUDER_GRID
+ * vertices into a buffer OCCLUSION_BUFFER_WIDTH pixels wide, and every entity that survived
+ * frustum and fog culling is tested against it before its instance data is written: if the
+ * nearest point of its box lies behind the terrain over every pixel the box covers, the
+ * entity is not drawn. The rasterizer walks four pixels at a time with simd::float4 edge
+ * functions, like frustum_cull walks boxes, and keeps the inverse view depth, which is affine
+ * in screen space, so the nearest occluder is the largest value.
+ *
+ * Occluders must never stand in front of terrain that is not there, so a coarse vertex takes the
+ * lowest height sampled over the cells around it, less OCCLUDER_HEIGHT_MARGIN for what the samples
+ * miss; every occluder triangle then lies on or under the terrain it replaces. Pixels are covered
+ * by their centres, so a box is tested over its rectangle grown by one pixel; a gap narrower than
+ * a pixel of this buffer may still hide what is seen through it.
+ *
+ * Unlike the GPU culling's Hi-Z, which is last frame's depth, the buffer is drawn from this
+ * frame's camera, so nothing waits on the GPU and nothing pops in when the camera turns.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frustum.hpp"
+#include "landscape.hpp"
+#include "objects.hpp"
+
+/// Width of the occlusion buffer in pixels; its height follows the aspect of the view.
+constexpr uint32_t OCCLUSION_BUFFER_WIDTH = 256;
+/// View depth occluder triangles are clipped at; a box reaching nearer is never occluded.
+constexpr float OCCLUSION_NEAR = 0.5f;
+/// How much farther than the occluder a box must be, relative to the occluder's depth.
+constexpr float OCCLUSION_DEPTH_BIAS = 0.01f;
+/// Vertices along each edge of a chunk's occluder grid.
+constexpr uint32_t OCCLUDER_GRID = 5;
+/// Height samples along each edge of an occluder cell when looking for its lowest point.
+constexpr uint32_t OCCLUDER_CELL_SAMPLES = 4;
+/// World units occluder vertices are lowered by, for terrain that dips between the samples.
+constexpr float OCCLUDER_HEIGHT_MARGIN = 1.0f;
+/// Occluder grids sampled per frame at most; a chunk without one occludes nothing meanwhile.
+constexpr uint32_t OCCLUDER_BUILDS_PER_FRAME = 8;
+
+/**
+ * @struct OcclusionBuffer
+ * @brief Inverse view depth of the nearest occluder at each pixel.
+ */
+struct OcclusionBuffer {
+    uint32_t width = 0;                 ///< Pixels per row.
+    uint32_t height = 0;                ///< Rows.
+    std::vector<float> inverseDepth;    ///< Row-major, y down; 0 where no occluder was drawn.
+    simd::float4x4 viewProjection;      ///< World to clip transform the occluders are drawn with.
+};
+
+/**
+ * @brief Clears the buffer for a new view; it keeps its capacity, so the same size does not reallocate.
+ * @param buffer The buffer.
+ * @param viewProjection World to clip transform of the view.
+ * @param width Width in pixels.
+ * @param height Height in pixels.
+ */
+void occlusion_buffer_begin(OcclusionBuffer& buffer, const simd::float4x4& viewProjection, uint32_t width,
+                            uint32_t height);
+
+/// @brief Draws one world space occluder triangle of either winding.
+void occlusion_buffer_triangle(OcclusionBuffer& buffer, simd::float3 a, simd::float3 b, simd::float3 c);
+
+/**
+ * @brief Draws a height grid as occluder triangles.
+ * @param buffer The buffer.
+ * @param heights side * side heights, row-major with rows along +z.
+ * @param side Vertices along each edge.
+ * @param origin World x and z of the first vertex.
+ * @param spacing World distance between neighbouring vertices.
+ */
+void occlusion_buffer_grid(OcclusionBuffer& buffer, const float* heights, uint32_t side, simd::float2 origin,
+                           float spacing);
+
+/**
+ * @brief Tests a box against the occluders drawn so far.
+ * @param buffer The buffer.
+ * @param box The world space box.
+ * @return True only if the box lies behind an occluder over every pixel around it.
+ */
+bool occlusion_buffer_occludes(const OcclusionBuffer& buffer, const BoundingBox& box);
+
+/**
+ * @brief Removes the boxes the occluders hide from a list of visible boxes.
+ *
+ * Like fog_cull, the kept indices are moved to the front, in no particular order, and the
+ * occluded ones fill the rest of the list.
+ *
+ * @param buffer The buffer.
+ * @param bounds The boxes.
+ * @param visible Indices into bounds; reordered in place.
+ * @param count Number of indices.
+ * @return The number of kept indices.
+ */
+size_t occlusion_cull(const OcclusionBuffer& buffer, const CullBounds& bounds, uint32_t* visible, size_t count);
+
+/**
+ * @struct TerrainOccluder
+ * @brief The coarse occluder grid of one chunk.
+ */
+struct TerrainOccluder {
+    ChunkKey key;                                       ///< Chunk the grid stands for.
+    uint64_t editVersion = 0;                           ///< ResidentChunk::editVersion the heights were sampled at.
+    uint64_t lastUsed = 0;                              ///< Frame the grid was last looked up on.
+    float heights[OCCLUDER_GRID * OCCLUDER_GRID] = {};  ///< Row-major, rows along +z.
+};
+
+/**
+ * @struct TerrainOccluderCache
+ * @brief Occluder grids of the chunks seen lately.
+ *
+ * Grids are searched linearly, and a grid not looked up on the current frame is overwritten
+ * before the array grows, so once it holds as many grids as chunks are resident, streaming
+ * allocates nothing.
+ */
+struct TerrainOccluderCache {
+    std::vector<TerrainOccluder> occluders;  ///< Grids in no particular order.
+};
+
+/**
+ * @brief Samples the occluder grid of a chunk.
+ * @param occluder Receives the heights; its key and versions are left alone.
+ * @param origin World x and z of the chunk's corner.
+ * @param chunkSize Edge length of the chunk.
+ * @param height Terrain height at a world x and z.
+ */
+void terrain_occluder_build(TerrainOccluder& occluder, simd::float2 origin, float chunkSize,
+                            const std::function<float(float, float)>& height);
+
+/**
+ * @brief Finds the current grid of a chunk.
+ * @param cache The cache.
+ * @param key The chunk.
+ * @param editVersion The chunk's ResidentChunk::editVersion.
+ * @param frame The current frame number.
+ * @return The grid, marked used on frame; nullptr if there is none or it predates an edit.
+ */
+const TerrainOccluder* terrain_occluder_find(TerrainOccluderCache& cache, ChunkKey key, uint64_t editVersion,
+                                             uint64_t frame);
+
+/**
+ * @brief Returns where to build the grid of a chunk.
+ *
+ * That is the chunk's stale grid if it has one, else one not used on frame, else a new one.
+ *
+ * @param cache The cache.
+ * @param key The chunk.
+ * @param editVersion The version the grid will be built at.
+ * @param frame The current frame number.
+ * @return The grid, with key and versions set; the heights are the caller's to fill.
+ */
+TerrainOccluder& terrain_occluder_slot(TerrainOccluderCache& cache, ChunkKey key, uint64_t editVersion,
+                                       uint64_t frame);
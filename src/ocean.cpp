@@ -0,0 +1,187 @@
+#include "ocean.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+    simd::float2 complex_mul(simd::float2 a, simd::float2 b) {
+        return { a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x };
+    }
+
+    simd::float2 conjugate(simd::float2 a) {
+        return { a.x, -a.y };
+    }
+
+    uint32_t reverse_bits(uint32_t value, uint32_t bits) {
+        uint32_t reversed = 0;
+        for (uint32_t i = 0; i < bits; ++i) {
+            reversed = (reversed << 1) | ((value >> i) & 1);
+        }
+        return reversed;
+    }
+
+    uint32_t log2_of(uint32_t n) {
+        uint32_t bits = 0;
+        while ((1u << bits) < n) {
+            bits++;
+        }
+        return bits;
+    }
+
+    // One line of packed complex pairs through every stage, ping-ponging like the threadgroup rows of ocean_fft
+    void transform_line(const std::vector<OceanButterfly>& butterflies, uint32_t n, simd::float4* line,
+                        simd::float4* scratch) {
+        const uint32_t stages = log2_of(n);
+        simd::float4* from = line;
+        simd::float4* to = scratch;
+        for (uint32_t stage = 0; stage < stages; ++stage) {
+            for (uint32_t i = 0; i < n; ++i) {
+                const OceanButterfly& b = butterflies[stage * n + i];
+                const simd::float4 a = from[b.a];
+                const simd::float4 c = from[b.b];
+                const simd::float2 first = simd::float2{ a.x, a.y } + complex_mul(b.twiddle, { c.x, c.y });
+                const simd::float2 second = simd::float2{ a.z, a.w } + complex_mul(b.twiddle, { c.z, c.w });
+                to[i] = { first.x, first.y, second.x, second.y };
+            }
+            std::swap(from, to);
+        }
+        if (from != line) {
+            std::copy(from, from + n, line);
+        }
+    }
+
+    // Top 24 bits as a float in (0, 1], so the logarithm below stays finite
+    float unit_float(uint32_t bits) {
+        return (float)((bits >> 8) + 1) * (1.0f / 16777216.0f);
+    }
+}
+
+float ocean_phillips(const OceanSettings& settings, simd::float2 k) {
+    const float k2 = simd::dot(k, k);
+    if (k2 < 1e-12f) {
+        return 0.0f;
+    }
+    const float along = simd::dot(k, simd::normalize(settings.windDirection)) / sqrtf(k2);
+    if (along <= 0.0f) {
+        return 0.0f;
+    }
+    // Waves longer than the wind can raise fade out, and the damping removes the shortest ones
+    const float longest = settings.windSpeed * settings.windSpeed / OCEAN_GRAVITY;
+    const float damping = expf(-k2 * settings.shortestWave * settings.shortestWave);
+    return settings.amplitude * expf(-1.0f / (k2 * longest * longest)) / (k2 * k2) * along * along * damping;
+}
+
+float ocean_angular_frequency(const OceanSettings& settings, float k) {
+    const float base = 2.0f * (float)M_PI / settings.loopPeriod;
+    return floorf(sqrtf(OCEAN_GRAVITY * k) / base) * base;
+}
+
+simd::float2 ocean_wave_vector(const OceanSettings& settings, uint32_t x, uint32_t y) {
+    const float half = (float)(settings.resolution / 2);
+    return simd::float2{ (float)x - half, (float)y - half } * (2.0f * (float)M_PI / settings.patchSize);
+}
+
+std::vector<simd::float4> ocean_initial_spectrum(const OceanSettings& settings) {
+    const uint32_t n = settings.resolution;
+    // Each frequency's amplitude is a complex Gaussian scaled by the energy in its cell of the spectrum
+    const float cell = 2.0f * (float)M_PI / settings.patchSize;
+    std::mt19937 random(settings.seed);
+    std::vector<simd::float2> h0(n * n);
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            // Box-Muller, drawn for every texel so the sequence does not depend on which ones are zero
+            const float radius = sqrtf(-2.0f * logf(unit_float(random())));
+            const float angle = 2.0f * (float)M_PI * unit_float(random());
+            if (x == 0 || y == 0) {
+                continue;
+            }
+            const float scale = sqrtf(ocean_phillips(settings, ocean_wave_vector(settings, x, y)) * 0.5f) * cell;
+            h0[y * n + x] = simd::float2{ cosf(angle), sinf(angle) } * (radius * scale);
+        }
+    }
+
+    std::vector<simd::float4> initial(n * n);
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            // -k wraps to the mirrored texel; the Nyquist row and column are zero on both sides
+            const simd::float2 mirrored = conjugate(h0[((n - y) % n) * n + (n - x) % n]);
+            const simd::float2 own = h0[y * n + x];
+            initial[y * n + x] = { own.x, own.y, mirrored.x, mirrored.y };
+        }
+    }
+    return initial;
+}
+
+std::vector<simd::float4> ocean_spectrum_at(const OceanSettings& settings, const std::vector<simd::float4>& initial,
+                                            float time) {
+    const uint32_t n = settings.resolution;
+    const float loopTime = fmodf(time, settings.loopPeriod);
+    std::vector<simd::float4> fields(n * n);
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const simd::float2 k = ocean_wave_vector(settings, x, y);
+            const float length = simd::length(k);
+            const float phase = ocean_angular_frequency(settings, length) * loopTime;
+            const simd::float2 turn = { cosf(phase), sinf(phase) };
+            const simd::float4 h0 = initial[y * n + x];
+            const simd::float2 h = complex_mul({ h0.x, h0.y }, turn) + complex_mul({ h0.z, h0.w }, conjugate(turn));
+
+            // D(k) = -i k / |k| h(k); -i h is (h.y, -h.x) and i h is (-h.y, h.x)
+            const simd::float2 direction = length > 1e-6f ? k / length : simd::float2{ 0.0f, 0.0f };
+            const simd::float2 dx = simd::float2{ h.y, -h.x } * direction.x;
+            const simd::float2 dz = simd::float2{ h.y, -h.x } * direction.y;
+            const simd::float2 packed = dx + simd::float2{ -h.y, h.x };
+            fields[y * n + x] = { packed.x, packed.y, dz.x, dz.y };
+        }
+    }
+    return fields;
+}
+
+std::vector<OceanButterfly> ocean_butterflies(uint32_t n) {
+    const uint32_t stages = log2_of(n);
+    std::vector<OceanButterfly> butterflies(stages * n);
+    for (uint32_t stage = 0; stage < stages; ++stage) {
+        const uint32_t span = 1u << stage;
+        const uint32_t group = span << 1;
+        for (uint32_t i = 0; i < n; ++i) {
+            // The lower half of a group adds the twiddled upper input, the upper half subtracts it,
+            // which is the same as a twiddle half a turn further
+            const uint32_t k = i % group;
+            const float angle = 2.0f * (float)M_PI * (float)k / (float)group;
+            uint32_t a = k < span ? i : i - span;
+            uint32_t b = a + span;
+            if (stage == 0) {
+                a = reverse_bits(a, stages);
+                b = reverse_bits(b, stages);
+            }
+            butterflies[stage * n + i] = { { cosf(angle), sinf(angle) }, a, b };
+        }
+    }
+    return butterflies;
+}
+
+void ocean_inverse_fft_2d(const std::vector<OceanButterfly>& butterflies, uint32_t n, std::vector<simd::float4>& data) {
+    std::vector<simd::float4> line(n);
+    std::vector<simd::float4> scratch(n);
+    for (uint32_t y = 0; y < n; ++y) {
+        transform_line(butterflies, n, data.data() + y * n, scratch.data());
+    }
+    for (uint32_t x = 0; x < n; ++x) {
+        for (uint32_t y = 0; y < n; ++y) {
+            line[y] = data[y * n + x];
+        }
+        transform_line(butterflies, n, line.data(), scratch.data());
+        for (uint32_t y = 0; y < n; ++y) {
+            data[y * n + x] = line[y];
+        }
+    }
+}
+
+simd::float3 ocean_displacement(const OceanSettings& settings, const std::vector<simd::float4>& fields, uint32_t x,
+                                uint32_t y) {
+    // The spectrum is centred on texel n / 2, which flips the sign of every other spatial texel
+    const float sign = ((x + y) & 1) ? -1.0f : 1.0f;
+    const simd::float4 v = fields[y * settings.resolution + x];
+    return simd::float3{ v.x * settings.choppiness, v.y, v.z * settings.choppiness } * sign;
+}
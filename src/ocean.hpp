@@ -0,0 +1,133 @@
+/**
+ * @file ocean.hpp
+ * @brief The wave spectrum and FFT tables behind the GPU ocean; see gpu_ocean.hpp.
+ *
+ * The sea is a statistical wave field (Tessendorf, "Simulating Ocean Water"): every frequency of
+ * one square patch gets a random amplitude from the Phillips spectrum once, and each frame the
+ * amplitudes are turned by the deep water dispersion relation and brought back to heights and
+ * horizontal ("choppy") displacements by an inverse FFT. The patch tiles seamlessly, so the
+ * simulation costs the same however much sea is drawn.
+ *
+ * The surface is drawn as a geometry clipmap (see clipmap.hpp), whose levels read the
+ * displacement at the mip matching their cell size.
+ *
+ * The functions here are the CPU side of that and a reference for the kernels in ocean.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+/// Largest OceanSettings::resolution; one FFT line must fit in a threadgroup.
+constexpr uint32_t OCEAN_MAX_RESOLUTION = 512;
+
+/// Acceleration in the deep water dispersion relation, in metres per second squared.
+constexpr float OCEAN_GRAVITY = 9.81f;
+
+/**
+ * @struct OceanSettings
+ * @brief The wave spectrum and the patch it is simulated on.
+ */
+struct OceanSettings {
+    uint32_t resolution = 256;                      ///< FFT size per side; a power of two up to OCEAN_MAX_RESOLUTION.
+    float patchSize = 256.0f;                       ///< World side of the square patch the waves repeat over.
+    simd::float2 windDirection = { 0.8f, 0.6f };    ///< Waves run along this; need not be unit length.
+    float windSpeed = 12.0f;                        ///< Metres per second; the longest waves are speed^2 / g long.
+    float amplitude = 0.0008f;                      ///< Phillips constant; wave heights grow with its square root.
+    float shortestWave = 0.4f;                      ///< Waves much shorter than this many metres are damped.
+    float choppiness = 1.2f;                        ///< Scales the horizontal displacement that sharpens the crests.
+    float loopPeriod = 200.0f;                      ///< Seconds after which the surface repeats exactly.
+    uint32_t seed = 7;                              ///< Picks the random wave amplitudes.
+};
+
+/**
+ * @struct OceanButterfly
+ * @brief One output of one radix-2 stage: out[i] = in[a] + twiddle * in[b], all complex.
+ */
+struct OceanButterfly {
+    simd::float2 twiddle;   ///< Complex factor of in[b].
+    uint32_t a;             ///< First input.
+    uint32_t b;             ///< Second input.
+};
+
+/**
+ * @brief The Phillips spectrum: how much energy waves of one frequency carry.
+ * @param settings The spectrum.
+ * @param k The wave vector in radians per metre.
+ * @return The spectrum's value; 0 for k = 0 and for waves running against the wind.
+ */
+float ocean_phillips(const OceanSettings& settings, simd::float2 k);
+
+/**
+ * @brief Returns the angular frequency of a wave, quantized so the surface repeats every loopPeriod.
+ * @param settings The spectrum.
+ * @param k The length of the wave vector.
+ * @return Radians per second: sqrt(g k) rounded down to a multiple of 2 pi / loopPeriod.
+ */
+float ocean_angular_frequency(const OceanSettings& settings, float k);
+
+/**
+ * @brief Returns the wave vector of a spectrum texel.
+ * @param settings The spectrum.
+ * @param x Column of the texel; column resolution / 2 holds the zero frequency.
+ * @param y Row of the texel.
+ * @return The wave vector in radians per metre.
+ */
+simd::float2 ocean_wave_vector(const OceanSettings& settings, uint32_t x, uint32_t y);
+
+/**
+ * @brief Draws the random starting amplitude of every frequency.
+ *
+ * Each entry holds h0(k) in xy and conj(h0(-k)) in zw, so a frame needs one read per texel.
+ * The Nyquist row and column are left at zero, which keeps every transformed field real.
+ *
+ * @param settings The spectrum.
+ * @return resolution^2 entries, row by row.
+ */
+std::vector<simd::float4> ocean_initial_spectrum(const OceanSettings& settings);
+
+/**
+ * @brief Turns the starting amplitudes to a moment in time, as ocean_spectrum does on the GPU.
+ *
+ * Height and horizontal displacement are real, so they are packed two to a complex number: each
+ * entry holds the spectrum of (Dx + i height) in xy and of (Dz + i 0) in zw.
+ *
+ * @param settings The spectrum.
+ * @param initial ocean_initial_spectrum() for the same settings.
+ * @param time Seconds; only the time modulo loopPeriod matters.
+ * @return resolution^2 entries, row by row.
+ */
+std::vector<simd::float4> ocean_spectrum_at(const OceanSettings& settings, const std::vector<simd::float4>& initial,
+                                            float time);
+
+/**
+ * @brief Builds the stages of an inverse radix-2 FFT of n points.
+ *
+ * Stage s of output i is entry s * n + i. The first stage reads its inputs in bit-reversed
+ * order, so the data needs no reordering pass.
+ *
+ * @param n The transform size; a power of two.
+ * @return log2(n) * n entries.
+ */
+std::vector<OceanButterfly> ocean_butterflies(uint32_t n);
+
+/**
+ * @brief Runs an inverse FFT over every row and then every column of packed complex pairs, as ocean_fft does.
+ * @param butterflies ocean_butterflies(n).
+ * @param n The side of the square.
+ * @param data n^2 entries, row by row, each two complex numbers; transformed in place, without scaling.
+ */
+void ocean_inverse_fft_2d(const std::vector<OceanButterfly>& butterflies, uint32_t n, std::vector<simd::float4>& data);
+
+/**
+ * @brief Reads the displacement out of a transformed field, as ocean_resolve does.
+ * @param settings The spectrum.
+ * @param fields ocean_spectrum_at() after ocean_inverse_fft_2d().
+ * @param x Column of the spatial texel.
+ * @param y Row of the spatial texel.
+ * @return Horizontal x displacement, height and horizontal z displacement, choppiness applied.
+ */
+simd::float3 ocean_displacement(const OceanSettings& settings, const std::vector<simd::float4>& fields, uint32_t x,
+                                uint32_t y);
@@ -0,0 +1,121 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// --- Ocean (compute) ---
+// Built into an ocean.metallib of its own, which metal_ocean_pipelines() loads when the ocean is
+// first created; shaders.metal does not use any of it.
+// A Tessendorf wave field on one tiling patch; see ocean.hpp. Everything here matches ocean.cpp:
+// ocean_spectrum turns the starting amplitudes to the current time, ocean_fft runs one inverse
+// FFT line per threadgroup, and ocean_resolve writes displacement, normals and foam.
+
+constant float OCEAN_GRAVITY = 9.81;
+constant uint OCEAN_MAX_RESOLUTION = 512;
+
+// Matches OceanSimulationParams in gpu_ocean.mm
+struct OceanSimulationParams {
+    uint resolution;
+    uint stages;                    // log2(resolution)
+    float patchSize;
+    float time;                     // Already wrapped to the loop period
+    float loopFrequency;            // 2 pi / loop period; every angular frequency is a multiple of it
+    float choppiness;
+};
+
+// Matches OceanButterfly in ocean.hpp
+struct OceanButterfly {
+    float2 twiddle;
+    uint a;
+    uint b;
+};
+
+static float2 complex_mul(float2 a, float2 b) {
+    return float2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// Matches ocean_spectrum_at: each texel becomes (Dx + i height) in xy and (Dz + i 0) in zw
+kernel void ocean_spectrum(constant OceanSimulationParams &params [[buffer(0)]],
+                           const device float4 *initial [[buffer(1)]],
+                           texture2d<float, access::write> fields [[texture(0)]],
+                           uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.resolution || gid.y >= params.resolution) {
+        return;
+    }
+    float2 k = (float2(gid) - float(params.resolution / 2)) * (2.0 * M_PI_F / params.patchSize);
+    float len = length(k);
+    float omega = floor(sqrt(OCEAN_GRAVITY * len) / params.loopFrequency) * params.loopFrequency;
+    float2 turn = float2(cos(omega * params.time), sin(omega * params.time));
+    float4 h0 = initial[gid.y * params.resolution + gid.x];
+    float2 h = complex_mul(h0.xy, turn) + complex_mul(h0.zw, float2(turn.x, -turn.y));
+
+    // D(k) = -i k / |k| h(k)
+    float2 direction = len > 1e-6 ? k / len : float2(0.0);
+    float2 dx = float2(h.y, -h.x) * direction.x;
+    float2 dz = float2(h.y, -h.x) * direction.y;
+    fields.write(float4(dx + float2(-h.y, h.x), dz), gid);
+}
+
+// One row (or column) per threadgroup and one thread per point, ping-ponging between two
+// threadgroup lines through every stage. Matches transform_line in ocean.cpp.
+kernel void ocean_fft(constant OceanSimulationParams &params [[buffer(0)]],
+                      constant uint &vertical [[buffer(1)]],
+                      const device OceanButterfly *butterflies [[buffer(2)]],
+                      texture2d<float, access::read> input [[texture(0)]],
+                      texture2d<float, access::write> output [[texture(1)]],
+                      uint i [[thread_index_in_threadgroup]],
+                      uint2 group [[threadgroup_position_in_grid]]) {
+    threadgroup float4 lines[2][OCEAN_MAX_RESOLUTION];
+    uint2 texel = vertical ? uint2(group.y, i) : uint2(i, group.y);
+    lines[0][i] = input.read(texel);
+    threadgroup_barrier(mem_flags::mem_threadgroup);
+
+    uint from = 0;
+    for (uint stage = 0; stage < params.stages; ++stage) {
+        OceanButterfly b = butterflies[stage * params.resolution + i];
+        float4 a = lines[from][b.a];
+        float4 c = lines[from][b.b];
+        lines[1 - from][i] = float4(a.xy + complex_mul(b.twiddle, c.xy), a.zw + complex_mul(b.twiddle, c.zw));
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+        from = 1 - from;
+    }
+    output.write(lines[from][i], texel);
+}
+
+// Matches ocean_displacement: the centred spectrum flips the sign of every other texel
+static float3 ocean_displacement(texture2d<float, access::read> fields, int2 texel,
+                                 constant OceanSimulationParams &params) {
+    uint2 p = uint2(texel) & (params.resolution - 1);
+    float4 v = fields.read(p);
+    float sign = ((p.x + p.y) & 1) ? -1.0 : 1.0;
+    return float3(v.x * params.choppiness, v.y, v.z * params.choppiness) * sign;
+}
+
+kernel void ocean_resolve(constant OceanSimulationParams &params [[buffer(0)]],
+                          texture2d<float, access::read> fields [[texture(0)]],
+                          texture2d<float, access::write> displacement [[texture(1)]],
+                          texture2d<float, access::write> normals [[texture(2)]],
+                          uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.resolution || gid.y >= params.resolution) {
+        return;
+    }
+    int2 p = int2(gid);
+    float3 center = ocean_displacement(fields, p, params);
+    float3 left = ocean_displacement(fields, p - int2(1, 0), params);
+    float3 right = ocean_displacement(fields, p + int2(1, 0), params);
+    float3 back = ocean_displacement(fields, p - int2(0, 1), params);
+    float3 front = ocean_displacement(fields, p + int2(0, 1), params);
+
+    // Central differences of the displaced surface, per texel of the patch
+    float texel = params.patchSize / float(params.resolution);
+    float3 dPdx = float3(2.0 * texel, 0.0, 0.0) + right - left;
+    float3 dPdz = float3(0.0, 0.0, 2.0 * texel) + front - back;
+    float3 normal = normalize(cross(dPdz, dPdx));
+
+    // Where the Jacobian of the horizontal displacement shrinks, crests fold over and foam
+    float2 du = float2(right.x - left.x, right.z - left.z) / (2.0 * texel);
+    float2 dv = float2(front.x - back.x, front.z - back.z) / (2.0 * texel);
+    float jacobian = (1.0 + du.x) * (1.0 + dv.y) - du.y * dv.x;
+    float foam = saturate((0.8 - jacobian) * 2.5);
+
+    displacement.write(float4(center, 0.0), gid);
+    normals.write(float4(normal, foam), gid);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file offscreen_target.hpp
+ * @brief Scene render targets that are read back to the CPU instead of presented.
+ *
+ * An OffscreenTarget stands in for a drawable when there is no window: the scene renders
+ * into its private colour texture, a blit at the end of the same command buffer copies the
+ * pixels into a shared buffer, and once the command buffer completes they can be written to
+ * disk. Several targets let several views be in flight on the GPU while the CPU encodes the
+ * next one and saves the last.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "render_targets.hpp"
+
+/**
+ * @struct OffscreenTarget
+ * @brief Colour and depth for one view, and the buffer its pixels are read back into.
+ */
+struct OffscreenTarget {
+    id<MTLTexture> color;           ///< BGRA8 scene colour.
+    TransientTarget depth;          ///< Scene depth; memoryless since no later pass reads it.
+    id<MTLBuffer> readback;         ///< Shared copy of color, rowBytes per row.
+    id<MTLCommandBuffer> pending;   ///< The last command buffer reading back into the target, or nil.
+    uint32_t width = 0;             ///< Width in pixels.
+    uint32_t height = 0;            ///< Height in pixels.
+    size_t rowBytes = 0;            ///< Bytes per row of readback.
+};
+
+/**
+ * @brief Creates a target.
+ * @param device The Metal device.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @return The target.
+ */
+OffscreenTarget create_offscreen_target(id<MTLDevice> device, uint32_t width, uint32_t height);
+
+/**
+ * @brief Copies the colour texture into the readback buffer after everything encoded so far.
+ * @param target The target; remembers cmd as pending.
+ * @param cmd The command buffer that rendered into the target.
+ */
+void offscreen_target_encode_readback(OffscreenTarget& target, id<MTLCommandBuffer> cmd);
+
+/**
+ * @brief Waits for the pending readback and writes the pixels to a TGA file.
+ * @param target The target; pending is cleared.
+ * @param filename The file to write.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success; false if nothing was pending or the file could not be written.
+ */
+bool offscreen_target_save(OffscreenTarget& target, const char* filename, std::string& error);
+
+/**
+ * @brief Waits for the pending readback and copies the pixels out with the row padding removed.
+ * @param target The target; its readback is no longer pending afterwards.
+ * @param bgra Receives width * height BGRA8 pixels, top row first.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool offscreen_target_read(OffscreenTarget& target, std::vector<uint8_t>& bgra, std::string& error);
+
+/// @return GPU bytes held by the target.
+size_t offscreen_target_bytes(const OffscreenTarget& target);
@@ -0,0 +1,91 @@
+#import "offscreen_target.hpp"
+
+#include <cstring>
+
+#include "image_file.hpp"
+
+namespace {
+    // Blits to a buffer need row strides aligned for the pixel format; 256 suits every GPU
+    constexpr size_t READBACK_ROW_ALIGNMENT = 256;
+}
+
+OffscreenTarget create_offscreen_target(id<MTLDevice> device, uint32_t width, uint32_t height) {
+    OffscreenTarget target;
+    target.width = width;
+    target.height = height;
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatBGRA8Unorm
+                                                                                    width:width
+                                                                                   height:height
+                                                                                mipmapped:NO];
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageRenderTarget;
+    target.color = [device newTextureWithDescriptor:desc];
+    target.color.label = @"Offscreen colour";
+
+    target.depth = create_transient_target(device, MTLPixelFormatDepth32Float, width, height,
+                                           MTLTextureUsageRenderTarget, @"Offscreen depth");
+
+    target.rowBytes = (4 * (size_t)width + READBACK_ROW_ALIGNMENT - 1) & ~(READBACK_ROW_ALIGNMENT - 1);
+    target.readback = [device newBufferWithLength:target.rowBytes * height options:MTLResourceStorageModeShared];
+    target.readback.label = @"Offscreen readback";
+    return target;
+}
+
+void offscreen_target_encode_readback(OffscreenTarget& target, id<MTLCommandBuffer> cmd) {
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    blit.label = @"Readback";
+    [blit copyFromTexture:target.color
+                     sourceSlice:0
+                     sourceLevel:0
+                    sourceOrigin:MTLOriginMake(0, 0, 0)
+                      sourceSize:MTLSizeMake(target.width, target.height, 1)
+                        toBuffer:target.readback
+               destinationOffset:0
+          destinationBytesPerRow:target.rowBytes
+        destinationBytesPerImage:target.rowBytes * target.height];
+    [blit endEncoding];
+    target.pending = cmd;
+}
+
+namespace {
+    bool wait_for_readback(OffscreenTarget& target, std::string& error) {
+        if (!target.pending) {
+            error = "nothing was rendered into the target";
+            return false;
+        }
+        [target.pending waitUntilCompleted];
+        const bool failed = target.pending.status == MTLCommandBufferStatusError;
+        target.pending = nil;
+        if (failed) {
+            error = "the GPU failed to render the view";
+            return false;
+        }
+        return true;
+    }
+}
+
+bool offscreen_target_save(OffscreenTarget& target, const char* filename, std::string& error) {
+    if (!wait_for_readback(target, error)) {
+        return false;
+    }
+    return write_tga(filename, (const uint8_t*)target.readback.contents, target.width, target.height, target.rowBytes,
+                     error);
+}
+
+bool offscreen_target_read(OffscreenTarget& target, std::vector<uint8_t>& bgra, std::string& error) {
+    if (!wait_for_readback(target, error)) {
+        return false;
+    }
+    const size_t packedRow = (size_t)target.width * 4;
+    bgra.resize(packedRow * target.height);
+    const uint8_t* rows = (const uint8_t*)target.readback.contents;
+    for (uint32_t y = 0; y < target.height; ++y) {
+        memcpy(bgra.data() + y * packedRow, rows + y * target.rowBytes, packedRow);
+    }
+    return true;
+}
+
+size_t offscreen_target_bytes(const OffscreenTarget& target) {
+    return target.color.allocatedSize + transient_target_bytes(target.depth) + target.readback.allocatedSize;
+}
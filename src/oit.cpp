@@ -0,0 +1,24 @@
+#include "oit.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float oit_weight(float viewDepth, float alpha) {
+    // McGuire and Bavoil's depth weight: flat up close, falling steeply past a few hundred units
+    const float near = viewDepth / 5.0f;
+    const float far = viewDepth / 200.0f;
+    const float weight = 10.0f / (1e-5f + near * near + far * far * far * far * far * far);
+    return alpha * std::clamp(weight, 1e-2f, 3e3f);
+}
+
+void oit_accumulate(OitPixel& pixel, simd::float3 color, float alpha, float viewDepth) {
+    const float weight = oit_weight(viewDepth, alpha);
+    pixel.accum += simd::float4{ color.x * weight, color.y * weight, color.z * weight, weight };
+    pixel.revealage *= 1.0f - alpha;
+}
+
+simd::float3 oit_resolve(const OitPixel& pixel, simd::float3 background) {
+    const simd::float3 sum = { pixel.accum.x, pixel.accum.y, pixel.accum.z };
+    const simd::float3 average = sum / std::max(pixel.accum.w, 1e-5f);
+    return average * (1.0f - pixel.revealage) + background * pixel.revealage;
+}
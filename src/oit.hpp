@@ -0,0 +1,55 @@
+/**
+ * @file oit.hpp
+ * @brief Weighted blended order-independent transparency: the per-pixel sums and how they resolve.
+ *
+ * Transparent surfaces are not sorted. Each fragment adds its premultiplied colour, scaled by a
+ * weight that falls with view depth, into an accumulation sum, and multiplies a revealage
+ * product by (1 - alpha). Both are commutative, so the draw order does not matter and the
+ * fixed-function blender can do the work. Resolving divides the sum by its weight to get an
+ * average transparent colour and lays it over the opaque background by the revealage, which
+ * is exact for one layer and a depth-weighted approximation for several.
+ *
+ * These functions mirror oit_weight(), water_fragment and oit_composite_fragment in
+ * shaders.metal; see transparency.hpp for the pass that runs them.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+/**
+ * @struct OitPixel
+ * @brief What the transparent pass accumulates for one pixel.
+ */
+struct OitPixel {
+    simd::float4 accum = { 0.0f, 0.0f, 0.0f, 0.0f }; ///< Sum of colour * alpha * weight, and of alpha * weight in w.
+    float revealage = 1.0f;                          ///< Product of (1 - alpha): how much background shows through.
+};
+
+/**
+ * @brief Returns how much a fragment counts towards the average transparent colour.
+ *
+ * Near fragments weigh more, so the nearest layer dominates as it would when sorted. The
+ * weight is clamped to keep the sums inside half precision.
+ *
+ * @param viewDepth The fragment's distance along the view direction.
+ * @param alpha The fragment's coverage in [0, 1].
+ * @return alpha times the depth weight.
+ */
+float oit_weight(float viewDepth, float alpha);
+
+/**
+ * @brief Adds a transparent fragment to a pixel, as the blend states of the transparent pass do.
+ * @param pixel The pixel.
+ * @param color The fragment's colour, not premultiplied.
+ * @param alpha The fragment's coverage in [0, 1].
+ * @param viewDepth The fragment's distance along the view direction.
+ */
+void oit_accumulate(OitPixel& pixel, simd::float3 color, float alpha, float viewDepth);
+
+/**
+ * @brief Lays a pixel's transparent layers over the opaque colour behind them.
+ * @param pixel The accumulated pixel.
+ * @param background The opaque scene colour.
+ * @return The composited colour; background itself if nothing transparent covered the pixel.
+ */
+simd::float3 oit_resolve(const OitPixel& pixel, simd::float3 background);
@@ -0,0 +1,64 @@
+#include "particles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint32_t particle_emit_count(float& pending, float rate, float dt, uint32_t capacity) {
+    pending += std::max(rate, 0.0f) * dt;
+    const uint32_t count = (uint32_t)pending;
+    pending -= (float)count;
+    return std::min(count, capacity);
+}
+
+std::vector<simd::uint2> particle_sort_passes(uint32_t capacity) {
+    std::vector<simd::uint2> passes;
+    for (uint32_t k = 2; k <= capacity; k *= 2) {
+        for (uint32_t j = k / 2; j > 0; j /= 2) {
+            passes.push_back({ k, j });
+        }
+    }
+    return passes;
+}
+
+uint32_t particle_sort_size(uint32_t count) {
+    uint32_t size = count > 0 ? 1 : 0;
+    while (size < count) {
+        size *= 2;
+    }
+    return size;
+}
+
+uint32_t particle_sort_key(float distance) {
+    // Non-negative floats order like their bits; inverting them puts the farthest first
+    uint32_t bits;
+    const float clamped = std::max(distance, 1e-3f);
+    memcpy(&bits, &clamped, sizeof(bits));
+    return ~bits;
+}
+
+bool particle_step(Particle& particle, const ParticleSettings& settings, const HeightField& field, float dt) {
+    particle.position.w += dt;
+    if (particle.position.w >= particle.velocity.w) {
+        return false;
+    }
+    simd::float3 velocity = { particle.velocity.x, particle.velocity.y, particle.velocity.z };
+    velocity.y -= settings.gravity * dt;
+    velocity *= std::max(1.0f - settings.drag * dt, 0.0f);
+    simd::float3 position = simd::float3{ particle.position.x, particle.position.y, particle.position.z } +
+                            velocity * dt;
+
+    const float ground = height_field_height(field, position.x, position.z);
+    if (position.y < ground) {
+        position.y = ground;
+        const simd::float3 normal = height_field_normal(field, position.x, position.z);
+        const float into = simd::dot(velocity, normal);
+        if (into < 0.0f) {
+            const simd::float3 along = velocity - into * normal;
+            velocity = along * (1.0f - settings.friction) - into * settings.bounce * normal;
+        }
+    }
+    particle.position = { position.x, position.y, position.z, particle.position.w };
+    particle.velocity = { velocity.x, velocity.y, velocity.z, particle.velocity.w };
+    return true;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file particles.hpp
+ * @brief The particle state and rules behind the GPU particle system; see gpu_particles.hpp.
+ *
+ * Particles live in a fixed pool. A dead list holds the free entries and two alive lists take
+ * turns: each frame emission pops entries off the dead list onto the current alive list, and
+ * the simulation steps every particle of it, falls back onto the terrain's height texture,
+ * and either returns it to the dead list or appends it to the other alive list, which is the
+ * compaction. Each survivor also gets a sort key from its distance to the camera; a bitonic
+ * sort of the keys orders the alive particles back to front for the draw.
+ *
+ * The functions here are the CPU side of that and a reference for the kernels in particles.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "height_field.hpp"
+
+/// Threads per threadgroup of the particle kernels; the indirect dispatches are counted in these.
+constexpr uint32_t PARTICLE_GROUP_SIZE = 64;
+
+/// Sort key of the padding past the alive particles; every real key is smaller.
+constexpr uint32_t PARTICLE_PAD_KEY = 0xffffffffu;
+
+/**
+ * @struct Particle
+ * @brief One pool entry; matches Particle in particles.metal.
+ */
+struct Particle {
+    simd::float4 position;  ///< xyz: world position, w: seconds since emission.
+    simd::float4 velocity;  ///< xyz: world units per second, w: seconds the particle lives.
+};
+
+/**
+ * @struct ParticleSettings
+ * @brief Emission, motion and looks.
+ */
+struct ParticleSettings {
+    float rate = 0.0f;                                  ///< Particles emitted per second; 0 stops emission.
+    float lifetime = 4.0f;                              ///< Mean seconds a particle lives.
+    float speed = 9.0f;                                 ///< Launch speed in world units per second.
+    float spread = 0.35f;                               ///< Random deviation of the launch direction, per axis.
+    float gravity = 9.8f;                               ///< Downward acceleration.
+    float drag = 0.2f;                                  ///< Fraction of the velocity lost per second.
+    float bounce = 0.4f;                                ///< Fraction of the speed into the ground kept on impact.
+    float friction = 0.3f;                              ///< Fraction of the speed along the ground lost on impact.
+    float startSize = 0.12f;                            ///< Billboard edge at emission.
+    float endSize = 0.5f;                               ///< Billboard edge at the end of its life.
+    simd::float4 color = { 1.0f, 0.75f, 0.35f, 0.9f };  ///< Premultiplied at draw; alpha fades to 0 with age.
+};
+
+/**
+ * @brief Returns how many particles to emit this frame and carries the fraction to the next.
+ * @param pending The fraction carried from earlier frames; updated.
+ * @param rate Particles per second.
+ * @param dt Seconds since the last frame.
+ * @param capacity The pool size; no frame emits more.
+ * @return The number of particles to emit.
+ */
+uint32_t particle_emit_count(float& pending, float rate, float dt, uint32_t capacity);
+
+/**
+ * @brief Returns the (k, j) pairs of the bitonic sort passes over a pool.
+ *
+ * Pass (k, j) compares every key i with key i ^ j, ascending where i & k is 0. Sorting the
+ * keys below any power of two n <= capacity takes the same passes: those with k > n find
+ * the keys already merged and exchange nothing, and those with j >= n pair nothing below n.
+ * So the passes are fixed by the pool and only their thread counts follow the alive count.
+ *
+ * @param capacity The pool size, a power of two.
+ * @return The passes in order.
+ */
+std::vector<simd::uint2> particle_sort_passes(uint32_t capacity);
+
+/// @return The smallest power of two at least count; 0 for 0.
+uint32_t particle_sort_size(uint32_t count);
+
+/// @return The sort key of a particle at a distance from the camera; farther particles sort first.
+uint32_t particle_sort_key(float distance);
+
+/**
+ * @brief Advances one particle by a step and lets it bounce off the terrain.
+ *
+ * Gravity and drag act first; a particle that ends below the surface is put back on it and
+ * loses the bounce share of its speed into the ground and the friction share of its speed
+ * along it.
+ *
+ * @param particle The particle; its age grows by dt.
+ * @param settings The motion tunables.
+ * @param field The terrain, as the kernel reads it from the height texture.
+ * @param dt Seconds to advance.
+ * @return False if the particle outlived its lifetime.
+ */
+bool particle_step(Particle& particle, const ParticleSettings& settings, const HeightField& field, float dt);
@@ -0,0 +1,231 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// --- Particles (compute) ---
+// Built into a particles.metallib of its own, which metal_particle_pipelines() loads when the
+// particles are first created; shaders.metal only has the billboards that draw them.
+// A fixed pool with a dead list and two alive lists; see particles.hpp. Everything here matches
+// particles.cpp: particles_emit takes entries off the dead list, particles_simulate steps the
+// alive ones and compacts the survivors into the other list with their sort keys, and
+// particles_sort orders the keys back to front. The single-thread kernels between them turn
+// the counts into the arguments of the indirect dispatches and the draw, so the CPU encodes the
+// same commands whatever the number of particles.
+
+constant uint PARTICLE_GROUP_SIZE = 64;
+constant uint PARTICLE_PAD_KEY = 0xffffffff;
+
+// Matches Particle in particles.hpp
+struct Particle {
+    float4 position;                // xyz: world position, w: seconds since emission
+    float4 velocity;                // xyz: world units per second, w: seconds the particle lives
+};
+
+// Matches ParticleParams in gpu_particles.mm
+struct ParticleParams {
+    float3 emitterPosition;
+    float3 emitterDirection;        // Unit length
+    float3 cameraPosition;
+    float2 heightOrigin;            // World xz of the first height texel
+    float heightSpacing;
+    uint2 heightSize;               // Texels along x and z
+    float dt;
+    float gravity;
+    float drag;
+    float bounce;
+    float friction;
+    float lifetime;
+    float speed;
+    float spread;
+    uint emitCount;
+    uint seed;
+    uint capacity;
+    uint parity;                    // Alive list the frame starts from
+};
+
+// Matches ParticleCounters in gpu_particles.mm
+struct ParticleCounters {
+    atomic_int dead;                // Entries on the dead list; emission may take it below zero for a moment
+    atomic_uint alive[2];
+    uint sortCount;                 // The survivors rounded up to a power of two
+};
+
+// Matches ParticleArguments in gpu_particles.mm: two threadgroup dispatches and a draw
+struct ParticleArguments {
+    uint simulate[3];               // Threadgroups per grid
+    uint sort[3];
+    uint draw[4];                   // Vertex count, instance count, vertex start, base instance
+};
+
+// pcg hash; returns [-1, 1]
+static float particle_random(thread uint &state) {
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    word = (word >> 22u) ^ word;
+    return float(word >> 8) * (2.0 / 16777216.0) - 1.0;
+}
+
+static uint particle_groups(uint threads) {
+    return (threads + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE;
+}
+
+// Matches particle_sort_key in particles.cpp
+static uint particle_sort_key(float distance) {
+    return ~as_type<uint>(max(distance, 1e-3));
+}
+
+// The cell and fractions find_cell in height_field.cpp picks, read texel for texel
+struct ParticleGround {
+    float height;
+    float3 normal;
+};
+
+static ParticleGround particle_ground(constant ParticleParams &params, texture2d<float, access::read> heights,
+                                      float2 xz) {
+    float2 last = float2(params.heightSize - 1);
+    float2 g = clamp((xz - params.heightOrigin) / params.heightSpacing, float2(0.0), last);
+    uint2 c = min(uint2(g), params.heightSize - 2);
+    float2 f = g - float2(c);
+    float h00 = heights.read(c).r;
+    float h10 = heights.read(c + uint2(1, 0)).r;
+    float h01 = heights.read(c + uint2(0, 1)).r;
+    float h11 = heights.read(c + uint2(1, 1)).r;
+
+    float h0 = h00 + (h10 - h00) * f.x;
+    float h1 = h01 + (h11 - h01) * f.x;
+    float dhdx = ((h10 - h00) * (1.0 - f.y) + (h11 - h01) * f.y) / params.heightSpacing;
+    float dhdz = ((h01 - h00) * (1.0 - f.x) + (h11 - h10) * f.x) / params.heightSpacing;
+    ParticleGround ground;
+    ground.height = h0 + (h1 - h0) * f.y;
+    ground.normal = normalize(float3(-dhdx, 1.0, -dhdz));
+    return ground;
+}
+
+// One thread per particle asked for; those the dead list cannot serve give their claim back
+kernel void particles_emit(constant ParticleParams &params [[buffer(0)]],
+                           device Particle *particles [[buffer(1)]],
+                           const device uint *deadList [[buffer(2)]],
+                           device uint *aliveLists [[buffer(3)]],
+                           device ParticleCounters &counters [[buffer(4)]],
+                           uint tid [[thread_position_in_grid]]) {
+    if (tid >= params.emitCount) {
+        return;
+    }
+    int dead = atomic_fetch_sub_explicit(&counters.dead, 1, memory_order_relaxed);
+    if (dead <= 0) {
+        atomic_fetch_add_explicit(&counters.dead, 1, memory_order_relaxed);
+        return;
+    }
+    uint index = deadList[dead - 1];
+
+    uint state = params.seed ^ (tid * 0x9e3779b9u);
+    float3 jitter = float3(particle_random(state), particle_random(state), particle_random(state));
+    float3 direction = normalize(params.emitterDirection + params.spread * jitter);
+    Particle particle;
+    particle.position = float4(params.emitterPosition + 0.2 * jitter, 0.0);
+    particle.velocity = float4(direction * params.speed * (1.0 + 0.25 * particle_random(state)),
+                               params.lifetime * (1.0 + 0.5 * particle_random(state)));
+    particles[index] = particle;
+
+    uint slot = atomic_fetch_add_explicit(&counters.alive[params.parity], 1, memory_order_relaxed);
+    aliveLists[params.parity * params.capacity + slot] = index;
+}
+
+// One thread: sizes the simulation to this frame's alive list and empties the next one
+kernel void particles_prepare(constant ParticleParams &params [[buffer(0)]],
+                              device ParticleCounters &counters [[buffer(4)]],
+                              device ParticleArguments &arguments [[buffer(6)]]) {
+    uint alive = atomic_load_explicit(&counters.alive[params.parity], memory_order_relaxed);
+    arguments.simulate[0] = particle_groups(alive);
+    arguments.simulate[1] = 1;
+    arguments.simulate[2] = 1;
+    atomic_store_explicit(&counters.alive[1 - params.parity], 0, memory_order_relaxed);
+}
+
+// Matches particle_step in particles.cpp; survivors are compacted into the next alive list
+kernel void particles_simulate(constant ParticleParams &params [[buffer(0)]],
+                               device Particle *particles [[buffer(1)]],
+                               device uint *deadList [[buffer(2)]],
+                               device uint *aliveLists [[buffer(3)]],
+                               device ParticleCounters &counters [[buffer(4)]],
+                               device uint2 *keys [[buffer(5)]],
+                               texture2d<float, access::read> heights [[texture(0)]],
+                               uint tid [[thread_position_in_grid]]) {
+    if (tid >= atomic_load_explicit(&counters.alive[params.parity], memory_order_relaxed)) {
+        return;
+    }
+    uint index = aliveLists[params.parity * params.capacity + tid];
+    Particle particle = particles[index];
+    particle.position.w += params.dt;
+    if (particle.position.w >= particle.velocity.w) {
+        int slot = atomic_fetch_add_explicit(&counters.dead, 1, memory_order_relaxed);
+        deadList[slot] = index;
+        return;
+    }
+
+    float3 velocity = particle.velocity.xyz;
+    velocity.y -= params.gravity * params.dt;
+    velocity *= max(1.0 - params.drag * params.dt, 0.0);
+    float3 position = particle.position.xyz + velocity * params.dt;
+
+    ParticleGround ground = particle_ground(params, heights, position.xz);
+    if (position.y < ground.height) {
+        position.y = ground.height;
+        float into = dot(velocity, ground.normal);
+        if (into < 0.0) {
+            float3 along = velocity - into * ground.normal;
+            velocity = along * (1.0 - params.friction) - into * params.bounce * ground.normal;
+        }
+    }
+    particles[index] = Particle{ float4(position, particle.position.w), float4(velocity, particle.velocity.w) };
+
+    uint next = 1 - params.parity;
+    uint slot = atomic_fetch_add_explicit(&counters.alive[next], 1, memory_order_relaxed);
+    aliveLists[next * params.capacity + slot] = index;
+    keys[slot] = uint2(particle_sort_key(distance(position, params.cameraPosition)), index);
+}
+
+// One thread: sizes the sort and the draw to the survivors
+kernel void particles_prepare_sort(constant ParticleParams &params [[buffer(0)]],
+                                   device ParticleCounters &counters [[buffer(4)]],
+                                   device ParticleArguments &arguments [[buffer(6)]]) {
+    uint alive = atomic_load_explicit(&counters.alive[1 - params.parity], memory_order_relaxed);
+    // Matches particle_sort_size in particles.cpp
+    uint sortCount = alive > 1 ? 1u << (32 - clz(alive - 1)) : alive;
+    counters.sortCount = sortCount;
+    arguments.sort[0] = particle_groups(sortCount);
+    arguments.sort[1] = 1;
+    arguments.sort[2] = 1;
+    arguments.draw[0] = 4;
+    arguments.draw[1] = alive;
+    arguments.draw[2] = 0;
+    arguments.draw[3] = 0;
+}
+
+// Fills the keys between the survivors and the sort size with keys that sort last
+kernel void particles_pad(constant ParticleParams &params [[buffer(0)]],
+                          device ParticleCounters &counters [[buffer(4)]],
+                          device uint2 *keys [[buffer(5)]],
+                          uint tid [[thread_position_in_grid]]) {
+    uint alive = atomic_load_explicit(&counters.alive[1 - params.parity], memory_order_relaxed);
+    if (tid >= alive && tid < counters.sortCount) {
+        keys[tid] = uint2(PARTICLE_PAD_KEY, 0);
+    }
+}
+
+// One pass (k, j) of the bitonic sort over the first sortCount keys; see particle_sort_passes
+kernel void particles_sort(constant uint2 &pass [[buffer(0)]],
+                           device ParticleCounters &counters [[buffer(4)]],
+                           device uint2 *keys [[buffer(5)]],
+                           uint tid [[thread_position_in_grid]]) {
+    uint partner = tid ^ pass.y;
+    if (partner <= tid || partner >= counters.sortCount) {
+        return;
+    }
+    uint2 a = keys[tid];
+    uint2 b = keys[partner];
+    bool ascending = (tid & pass.x) == 0;
+    if ((a.x > b.x) == ascending) {
+        keys[tid] = b;
+        keys[partner] = a;
+    }
+}
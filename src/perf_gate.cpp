@@ -0,0 +1,218 @@
+#include "perf_gate.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <map>
+#include <utility>
+
+namespace {
+    float median(std::vector<float> samples) {
+        if (samples.empty()) {
+            return 0.0f;
+        }
+        const size_t mid = samples.size() / 2;
+        std::nth_element(samples.begin(), samples.begin() + mid, samples.end());
+        if (samples.size() % 2) {
+            return samples[mid];
+        }
+        return 0.5f * (samples[mid] + *std::max_element(samples.begin(), samples.begin() + mid));
+    }
+
+    double time_unit_ms(const std::string& unit) {
+        if (unit == "ns") return 1e-6;
+        if (unit == "us") return 1e-3;
+        if (unit == "s") return 1e3;
+        return 1.0;
+    }
+
+    bool parse_frame_report(const JsonValue& samples, std::vector<PerfMetric>& metrics, std::string& error) {
+        if (samples.type != JsonValue::OBJECT) {
+            error = "\"samples\" must be an object";
+            return false;
+        }
+        for (const auto& [name, series] : samples.object) {
+            if (series.type != JsonValue::ARRAY) {
+                error = "\"samples\" members must be arrays";
+                return false;
+            }
+            PerfMetric metric;
+            metric.name = name;
+            for (const JsonValue& sample : series.array) {
+                // Negative times mark frames whose GPU time never arrived
+                if (sample.type == JsonValue::NUMBER && sample.number >= 0.0) {
+                    metric.samples.push_back((float)sample.number);
+                }
+            }
+            metrics.push_back(std::move(metric));
+        }
+        return true;
+    }
+
+    bool parse_google_benchmark(const JsonValue& benchmarks, std::vector<PerfMetric>& metrics, std::string& error) {
+        if (benchmarks.type != JsonValue::ARRAY) {
+            error = "\"benchmarks\" must be an array";
+            return false;
+        }
+        std::map<std::string, size_t> byName;
+        for (const JsonValue& run : benchmarks.array) {
+            const JsonValue* name = run.find("run_name");
+            name = name ? name : run.find("name");
+            const JsonValue* type = run.find("run_type");
+            const JsonValue* failed = run.find("error_occurred");
+            const JsonValue* time = run.find("real_time");
+            if (!name || (type && type->string != "iteration") || (failed && failed->string == "true") || !time ||
+                time->type != JsonValue::NUMBER) {
+                continue;
+            }
+            const JsonValue* unit = run.find("time_unit");
+            auto [it, added] = byName.emplace(name->string, metrics.size());
+            if (added) {
+                metrics.push_back({ name->string, {} });
+            }
+            metrics[it->second].samples.push_back((float)(time->number * time_unit_ms(unit ? unit->string : "ns")));
+        }
+        return true;
+    }
+}
+
+const char* perf_verdict_name(PerfVerdict verdict) {
+    switch (verdict) {
+        case PerfVerdict::Unchanged: return "unchanged";
+        case PerfVerdict::Regressed: return "REGRESSED";
+        case PerfVerdict::Improved: return "improved";
+        case PerfVerdict::TooFewSamples: return "too few samples";
+        case PerfVerdict::NoBaseline: return "no baseline";
+        default: return "unknown";
+    }
+}
+
+MannWhitney mann_whitney_u(const std::vector<float>& baseline, const std::vector<float>& current) {
+    MannWhitney result;
+    const size_t n1 = current.size();
+    const size_t n2 = baseline.size();
+    if (n1 == 0 || n2 == 0) {
+        return result;
+    }
+
+    // Rank both sets together; a run of equal values shares the average of its ranks
+    std::vector<std::pair<float, bool>> all;
+    all.reserve(n1 + n2);
+    for (float sample : current) all.emplace_back(sample, true);
+    for (float sample : baseline) all.emplace_back(sample, false);
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    const double n = (double)all.size();
+    double rankSum = 0.0;
+    double tieTerm = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) ++j;
+        const double rank = 0.5 * (double)(i + 1 + j);
+        for (size_t k = i; k < j; ++k) {
+            rankSum += all[k].second ? rank : 0.0;
+        }
+        const double ties = (double)(j - i);
+        tieTerm += ties * ties * ties - ties;
+        i = j;
+    }
+
+    result.u = rankSum - (double)n1 * (n1 + 1) / 2.0;
+    const double mean = (double)n1 * n2 / 2.0;
+    const double variance = (double)n1 * n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+    if (variance <= 0.0) {
+        return result; // Every sample equal: no evidence either way
+    }
+    const double sd = std::sqrt(variance);
+    result.pGreater = 0.5 * std::erfc((result.u - mean - 0.5) / sd / std::sqrt(2.0));
+    result.pLess = 0.5 * std::erfc((mean - result.u - 0.5) / sd / std::sqrt(2.0));
+    return result;
+}
+
+bool parse_perf_report(const JsonValue& root, std::vector<PerfMetric>& metrics, std::string& error) {
+    metrics.clear();
+    if (const JsonValue* samples = root.find("samples")) {
+        return parse_frame_report(*samples, metrics, error);
+    }
+    if (const JsonValue* benchmarks = root.find("benchmarks")) {
+        return parse_google_benchmark(*benchmarks, metrics, error);
+    }
+    error = "neither a frame benchmark report with \"samples\" nor Google Benchmark JSON";
+    return false;
+}
+
+std::string perf_report_device(const JsonValue& root) {
+    const JsonValue* device = root.find("device");
+    return device && device->type == JsonValue::STRING ? device->string : std::string();
+}
+
+std::string perf_device_class(const std::string& device) {
+    std::string name;
+    for (char c : device) {
+        if (std::isalnum((unsigned char)c)) {
+            name += (char)std::tolower((unsigned char)c);
+        } else if (!name.empty() && name.back() != '-') {
+            name += '-';
+        }
+    }
+    while (!name.empty() && name.back() == '-') {
+        name.pop_back();
+    }
+    return name.empty() ? "default" : name;
+}
+
+std::vector<PerfComparison> compare_perf_metrics(const std::vector<PerfMetric>& baseline,
+                                                 const std::vector<PerfMetric>& current,
+                                                 const PerfGateSettings& settings) {
+    std::vector<PerfComparison> comparisons;
+    for (const PerfMetric& metric : current) {
+        PerfComparison comparison;
+        comparison.name = metric.name;
+        comparison.currentMedian = median(metric.samples);
+        auto old = std::find_if(baseline.begin(), baseline.end(),
+                                [&](const PerfMetric& candidate) { return candidate.name == metric.name; });
+        if (old == baseline.end()) {
+            comparison.verdict = PerfVerdict::NoBaseline;
+            comparisons.push_back(comparison);
+            continue;
+        }
+        comparison.baselineMedian = median(old->samples);
+        comparison.change = comparison.baselineMedian > 0.0f
+                                ? comparison.currentMedian / comparison.baselineMedian - 1.0f
+                                : 0.0f;
+        if (metric.samples.size() < settings.minSamples || old->samples.size() < settings.minSamples) {
+            comparison.verdict = PerfVerdict::TooFewSamples;
+            comparisons.push_back(comparison);
+            continue;
+        }
+
+        const MannWhitney test = mann_whitney_u(old->samples, metric.samples);
+        comparison.p = comparison.change >= 0.0f ? test.pGreater : test.pLess;
+        if (test.pGreater < settings.alpha && comparison.change > settings.threshold) {
+            comparison.verdict = PerfVerdict::Regressed;
+        } else if (test.pLess < settings.alpha && comparison.change < -settings.threshold) {
+            comparison.verdict = PerfVerdict::Improved;
+        }
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+PerfScaling perf_scaling(const std::vector<uint32_t>& sizes, const std::vector<float>& ms, float maxExponent,
+                         float minMs) {
+    PerfScaling scaling;
+    const size_t count = std::min(sizes.size(), ms.size());
+    scaling.exponents.assign(count, 0.0f);
+    scaling.knee = count;
+    for (size_t i = 1; i < count; ++i) {
+        if (sizes[i] <= sizes[i - 1] || sizes[i - 1] == 0 || (ms[i] < minMs && ms[i - 1] < minMs)) {
+            continue;
+        }
+        const float before = std::max(ms[i - 1], minMs);
+        const float after = std::max(ms[i], minMs);
+        scaling.exponents[i] = logf(after / before) / logf((float)sizes[i] / (float)sizes[i - 1]);
+        if (scaling.exponents[i] > maxExponent && scaling.knee == count) {
+            scaling.knee = i;
+        }
+    }
+    return scaling;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file perf_gate.hpp
+ * @brief Compares benchmark results with stored baselines and decides which metrics regressed.
+ *
+ * Both kinds of benchmark report are read: the frame benchmark's (`--benchmark`), whose
+ * "samples" object holds one time per measured frame for the whole frame, each CPU phase and
+ * each profiled GPU pass, and Google Benchmark's JSON output of run_benchmarks, where every
+ * repetition of a microbenchmark is one sample. A metric regressed when a one-sided
+ * Mann-Whitney U test finds its new samples stochastically larger than the baseline's at the
+ * chosen significance and its median also grew by more than the threshold. The rank test makes
+ * no assumption about the shape of the distributions, so a few stalls in either run do not
+ * decide the outcome; the threshold keeps significant but negligible shifts from failing it.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+/**
+ * @struct PerfMetric
+ * @brief One measured quantity of a report and its samples, lower being better.
+ */
+struct PerfMetric {
+    std::string name;           ///< Sample series name or microbenchmark run name.
+    std::vector<float> samples; ///< Milliseconds; missing measurements are left out.
+};
+
+/**
+ * @struct MannWhitney
+ * @brief The outcome of a Mann-Whitney U test of a current sample set against a baseline.
+ */
+struct MannWhitney {
+    double u = 0.0;             ///< U statistic of the current samples.
+    double pGreater = 1.0;      ///< One-sided p-value that the current samples tend to be larger.
+    double pLess = 1.0;         ///< One-sided p-value that the current samples tend to be smaller.
+};
+
+/**
+ * @enum PerfVerdict
+ * @brief What a comparison concluded about one metric.
+ */
+enum class PerfVerdict {
+    Unchanged,      ///< No significant shift, or one within the threshold.
+    Regressed,      ///< Significantly and noticeably slower.
+    Improved,       ///< Significantly and noticeably faster.
+    TooFewSamples,  ///< One side has fewer than PerfGateSettings::minSamples samples.
+    NoBaseline      ///< The baseline does not have the metric.
+};
+
+/**
+ * @struct PerfGateSettings
+ * @brief When a shift counts.
+ */
+struct PerfGateSettings {
+    float threshold = 0.05f;    ///< Relative growth of the median a regression must exceed.
+    double alpha = 0.01;        ///< Significance level of the one-sided test.
+    size_t minSamples = 5;      ///< Fewer samples on either side are not tested.
+};
+
+/**
+ * @struct PerfComparison
+ * @brief One metric of a report compared with its baseline.
+ */
+struct PerfComparison {
+    std::string name;                           ///< PerfMetric::name.
+    PerfVerdict verdict = PerfVerdict::Unchanged; ///< The conclusion.
+    float baselineMedian = 0.0f;                ///< Median of the baseline samples.
+    float currentMedian = 0.0f;                 ///< Median of the current samples.
+    float change = 0.0f;                        ///< currentMedian / baselineMedian - 1.
+    double p = 1.0;                             ///< p-value of the direction the medians moved in.
+};
+
+/// @return A short name for a verdict, used in the gate's report.
+const char* perf_verdict_name(PerfVerdict verdict);
+
+/**
+ * @brief Runs a Mann-Whitney U test with tied ranks averaged.
+ *
+ * Uses the normal approximation with tie and continuity corrections, which is close to the
+ * exact distribution from about five samples per side.
+ *
+ * @param baseline The baseline samples.
+ * @param current The current samples.
+ * @return The statistic and both one-sided p-values; p-values of 1 if either side is empty.
+ */
+MannWhitney mann_whitney_u(const std::vector<float>& baseline, const std::vector<float>& current);
+
+/**
+ * @brief Extracts the metrics of a frame benchmark or Google Benchmark report.
+ *
+ * Google Benchmark entries are grouped by run name; only "iteration" runs count, so the
+ * aggregates written with --benchmark_repetitions are skipped, and their real times are
+ * converted to milliseconds.
+ *
+ * @param root The parsed report.
+ * @param metrics Receives the metrics, in report order.
+ * @param error Receives a description of the problem on failure.
+ * @return True if the report is one of the two kinds.
+ */
+bool parse_perf_report(const JsonValue& root, std::vector<PerfMetric>& metrics, std::string& error);
+
+/// @return The "device" a frame benchmark report was measured on, or an empty string.
+std::string perf_report_device(const JsonValue& root);
+
+/**
+ * @brief Turns a device name into the directory its baselines are kept in.
+ * @param device A device name such as "Apple M1 Pro".
+ * @return Lower-case letters and digits joined by dashes, e.g. "apple-m1-pro"; "default" if empty.
+ */
+std::string perf_device_class(const std::string& device);
+
+/**
+ * @brief Compares every metric of a run with the baseline metric of the same name.
+ * @param baseline The baseline's metrics.
+ * @param current The new run's metrics.
+ * @param settings When a shift counts.
+ * @return One comparison per current metric, in its order.
+ */
+std::vector<PerfComparison> compare_perf_metrics(const std::vector<PerfMetric>& baseline,
+                                                 const std::vector<PerfMetric>& current,
+                                                 const PerfGateSettings& settings);
+
+/**
+ * @struct PerfScaling
+ * @brief How one metric grows with the size of the workload, e.g. the objects of `--stress` runs.
+ */
+struct PerfScaling {
+    std::vector<float> exponents;   ///< Per size, the exponent from the previous size; 0 for the first.
+    size_t knee = 0;                ///< First size whose exponent exceeds the limit; the size count if none does.
+};
+
+/**
+ * @brief Finds where a metric stops scaling with its workload.
+ *
+ * Between two sizes the scaling exponent is the ratio of the logs of the metric's growth and of
+ * the size's growth: about 0 for costs the size does not touch, 1 for linear costs. The knee is
+ * the first size at which it exceeds the limit.
+ *
+ * @param sizes The workload sizes, ascending.
+ * @param ms The metric's median at each size.
+ * @param maxExponent Largest exponent that still scales; above 1, the cost grows faster than the workload.
+ * @param minMs Steps between times both below this are noise and get an exponent of 0.
+ * @return The exponents and the knee.
+ */
+PerfScaling perf_scaling(const std::vector<uint32_t>& sizes, const std::vector<float>& ms, float maxExponent = 1.2f,
+                         float minMs = 0.05f);
@@ -0,0 +1,379 @@
+#include "physics.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "affine.hpp"
+
+namespace {
+    // Awake bodies per broadphase job, and islands per solver job
+    const uint32_t BROADPHASE_GRAIN = 256;
+    const uint32_t ISLAND_GRAIN = 16;
+
+    const uint32_t NO_ISLAND = UINT32_MAX;
+
+    BoundingBox sphere_box(simd::float3 center, float radius) {
+        return { { center.x - radius, center.y - radius, center.z - radius },
+                 { center.x + radius, center.y + radius, center.z + radius } };
+    }
+
+    uint32_t find_root(std::vector<uint32_t>& parents, uint32_t body) {
+        while (parents[body] != body) {
+            parents[body] = parents[parents[body]]; // Path halving
+            body = parents[body];
+        }
+        return body;
+    }
+
+    // q + dt/2 * (w, 0) * q, renormalized
+    simd::quatf integrate_rotation(simd::quatf q, simd::float3 w, float dt) {
+        const simd::float3 v = { q.vector.x, q.vector.y, q.vector.z };
+        const simd::float3 dv = (w * q.vector.w + simd::cross(w, v)) * (0.5f * dt);
+        const float ds = -simd::dot(w, v) * (0.5f * dt);
+        const simd::float4 r = { v.x + dv.x, v.y + dv.y, v.z + dv.z, q.vector.w + ds };
+        return simd::quatf{ r / sqrtf(simd::dot(r, r)) };
+    }
+
+    // The body's contacts: the terrain below it, and every body it overlaps that it is responsible for.
+    // Of two awake bodies the lower index finds the pair; sleeping bodies never search, so awake ones
+    // always report them.
+    void find_contacts(const PhysicsWorld& world, const HeightField& field, uint32_t i,
+                       std::vector<uint32_t>& items, std::vector<PhysicsContact>& contacts) {
+        const simd::float3 p = world.positions[i];
+        const float r = world.radii[i];
+
+        const simd::float3 n = height_field_normal(field, p.x, p.z);
+        const float depth = r - (p.y - height_field_height(field, p.x, p.z)) * n.y;
+        if (depth > 0.0f) {
+            PhysicsContact contact;
+            contact.a = i;
+            contact.b = PHYSICS_GROUND;
+            contact.normal = n;
+            contact.depth = depth;
+            contacts.push_back(contact);
+        }
+
+        bvh_query_box(world.bvh, sphere_box(p, r), items);
+        for (uint32_t j : items) {
+            if (j == i || (world.awake[j] && j < i)) {
+                continue;
+            }
+            const simd::float3 delta = p - world.positions[j];
+            const float reach = r + world.radii[j];
+            const float distanceSquared = simd::dot(delta, delta);
+            if (distanceSquared >= reach * reach) {
+                continue;
+            }
+            const float distance = sqrtf(distanceSquared);
+            PhysicsContact contact;
+            contact.a = i;
+            contact.b = j;
+            contact.normal = distance > 1e-6f ? delta / distance : simd::float3{ 0.0f, 1.0f, 0.0f };
+            contact.depth = reach - distance;
+            contacts.push_back(contact);
+        }
+    }
+
+    // Sequential impulses over one island's contacts; no other island shares its bodies
+    void solve_island(PhysicsWorld& world, PhysicsContact* contacts, uint32_t count) {
+        const PhysicsSettings& s = world.settings;
+        const float dt = s.step;
+        for (uint32_t c = 0; c < count; ++c) {
+            PhysicsContact& contact = contacts[c];
+            const simd::float3 vb = contact.b == PHYSICS_GROUND ? simd::float3{ 0.0f, 0.0f, 0.0f }
+                                                                : world.velocities[contact.b];
+            const float approach = simd::dot(world.velocities[contact.a] - vb, contact.normal);
+            contact.bias = s.correction / dt * std::max(contact.depth - s.slop, 0.0f);
+            if (approach < -s.bounceSpeed) {
+                contact.bias = std::max(contact.bias, -s.restitution * approach);
+            }
+        }
+
+        simd::float3 groundVelocity = { 0.0f, 0.0f, 0.0f };
+        simd::float3 groundSpin = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t pass = 0; pass < s.iterations; ++pass) {
+            for (uint32_t c = 0; c < count; ++c) {
+                PhysicsContact& contact = contacts[c];
+                const uint32_t a = contact.a;
+                const uint32_t b = contact.b;
+                const bool ground = b == PHYSICS_GROUND;
+                simd::float3& va = world.velocities[a];
+                simd::float3& wa = world.angularVelocities[a];
+                simd::float3& vb = ground ? groundVelocity : world.velocities[b];
+                simd::float3& wb = ground ? groundSpin : world.angularVelocities[b];
+                const float ma = world.inverseMasses[a];
+                const float mb = ground ? 0.0f : world.inverseMasses[b];
+                const float ia = world.inverseInertias[a];
+                const float ib = ground ? 0.0f : world.inverseInertias[b];
+                const float rA = world.radii[a];
+                const float rB = ground ? 0.0f : world.radii[b];
+                const simd::float3 n = contact.normal;
+
+                // Friction first, bounded by the normal impulse of the previous pass
+                const simd::float3 ra = n * -rA;
+                const simd::float3 rb = n * rB;
+                const simd::float3 slip = va + simd::cross(wa, ra) - vb - simd::cross(wb, rb);
+                const simd::float3 tangent = slip - n * simd::dot(slip, n);
+                const float tangentMass = ma + mb + ia * rA * rA + ib * rB * rB;
+                simd::float3 accumulated = contact.frictionImpulse - tangent / tangentMass;
+                const float limit = s.friction * contact.normalImpulse;
+                const float length = simd::length(accumulated);
+                if (length > limit) {
+                    accumulated *= limit / length;
+                }
+                const simd::float3 friction = accumulated - contact.frictionImpulse;
+                contact.frictionImpulse = accumulated;
+                va += friction * ma;
+                wa += simd::cross(ra, friction) * ia;
+                vb -= friction * mb;
+                wb -= simd::cross(rb, friction) * ib;
+
+                // The normal passes through both centres, so it never spins a sphere
+                const float separation = simd::dot(va - vb, n);
+                const float total = std::max(contact.normalImpulse + (contact.bias - separation) / (ma + mb), 0.0f);
+                const float impulse = total - contact.normalImpulse;
+                contact.normalImpulse = total;
+                va += n * (impulse * ma);
+                vb -= n * (impulse * mb);
+            }
+        }
+    }
+}
+
+PhysicsWorld create_physics_world(uint32_t capacity, const PhysicsSettings& settings) {
+    PhysicsWorld world;
+    world.settings = settings;
+    world.positions.reserve(capacity);
+    world.previousPositions.reserve(capacity);
+    world.orientations.reserve(capacity);
+    world.previousOrientations.reserve(capacity);
+    world.velocities.reserve(capacity);
+    world.angularVelocities.reserve(capacity);
+    world.radii.reserve(capacity);
+    world.inverseMasses.reserve(capacity);
+    world.inverseInertias.reserve(capacity);
+    world.restTimes.reserve(capacity);
+    world.awake.reserve(capacity);
+    world.proxies.reserve(capacity);
+    world.active.reserve(capacity);
+    world.islandParents.reserve(capacity);
+    world.islandOf.reserve(capacity);
+    world.islandBodies.reserve(capacity);
+    bvh_reserve(world.bvh, capacity);
+    return world;
+}
+
+uint32_t physics_add_sphere(PhysicsWorld& world, simd::float3 position, float radius, simd::float3 velocity,
+                            float density) {
+    const uint32_t body = (uint32_t)world.size();
+    const float mass = density * (4.0f / 3.0f) * (float)M_PI * radius * radius * radius;
+    const simd::quatf identity = simd::quatf{ simd::float4{ 0.0f, 0.0f, 0.0f, 1.0f } };
+    world.positions.push_back(position);
+    world.previousPositions.push_back(position);
+    world.orientations.push_back(identity);
+    world.previousOrientations.push_back(identity);
+    world.velocities.push_back(velocity);
+    world.angularVelocities.push_back({ 0.0f, 0.0f, 0.0f });
+    world.radii.push_back(radius);
+    world.inverseMasses.push_back(1.0f / mass);
+    world.inverseInertias.push_back(1.0f / (0.4f * mass * radius * radius));
+    world.restTimes.push_back(0.0f);
+    world.awake.push_back(1);
+    world.proxies.push_back(bvh_insert(world.bvh, sphere_box(position, radius), body));
+    return body;
+}
+
+void physics_wake(PhysicsWorld& world, uint32_t body) {
+    world.awake[body] = 1;
+    world.restTimes[body] = 0.0f;
+}
+
+void physics_clear(PhysicsWorld& world) {
+    const size_t capacity = world.positions.capacity();
+    const PhysicsSettings settings = world.settings;
+    world = create_physics_world((uint32_t)capacity, settings);
+}
+
+void physics_step(PhysicsWorld& world, JobSystem& jobs, const HeightField& field) {
+    const PhysicsSettings& s = world.settings;
+    const float dt = s.step;
+    const float linearKeep = std::max(1.0f - s.linearDamping * dt, 0.0f);
+    const float angularKeep = std::max(1.0f - s.angularDamping * dt, 0.0f);
+    world.stats = {};
+
+    world.active.clear();
+    for (uint32_t i = 0; i < world.size(); ++i) {
+        if (world.awake[i]) {
+            world.active.push_back(i);
+        }
+    }
+    const uint32_t searched = (uint32_t)world.active.size();
+
+    // Gravity, then the contacts at the current positions; slices only write their own lists
+    const uint32_t slices = (searched + BROADPHASE_GRAIN - 1) / BROADPHASE_GRAIN;
+    if (world.sliceContacts.size() < slices) {
+        world.sliceContacts.resize(slices);
+        world.sliceItems.resize(slices);
+    }
+    jobs.parallel_for(searched, BROADPHASE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        const uint32_t slice = begin / BROADPHASE_GRAIN;
+        std::vector<PhysicsContact>& contacts = world.sliceContacts[slice];
+        contacts.clear();
+        for (uint32_t k = begin; k < end; ++k) {
+            const uint32_t i = world.active[k];
+            world.velocities[i] = (world.velocities[i] + s.gravity * dt) * linearKeep;
+            world.angularVelocities[i] *= angularKeep;
+            find_contacts(world, field, i, world.sliceItems[slice], contacts);
+        }
+    });
+
+    // Sleeping bodies that were hit wake up and join this step's islands
+    for (uint32_t slice = 0; slice < slices; ++slice) {
+        for (const PhysicsContact& contact : world.sliceContacts[slice]) {
+            if (contact.b != PHYSICS_GROUND && !world.awake[contact.b]) {
+                physics_wake(world, contact.b);
+                world.active.push_back(contact.b);
+            }
+        }
+    }
+
+    // Islands: union-find over the body pairs, then awake bodies and contacts grouped by island
+    world.islandParents.resize(world.size());
+    world.islandOf.resize(world.size());
+    for (uint32_t i : world.active) {
+        world.islandParents[i] = i;
+        world.islandOf[i] = NO_ISLAND;
+    }
+    uint32_t contactCount = 0;
+    for (uint32_t slice = 0; slice < slices; ++slice) {
+        for (const PhysicsContact& contact : world.sliceContacts[slice]) {
+            if (contact.b != PHYSICS_GROUND) {
+                const uint32_t a = find_root(world.islandParents, contact.a);
+                const uint32_t b = find_root(world.islandParents, contact.b);
+                world.islandParents[std::max(a, b)] = std::min(a, b);
+            }
+        }
+        contactCount += (uint32_t)world.sliceContacts[slice].size();
+    }
+    uint32_t islands = 0;
+    for (uint32_t i : world.active) {
+        const uint32_t root = find_root(world.islandParents, i);
+        if (world.islandOf[root] == NO_ISLAND) {
+            world.islandOf[root] = islands++;
+        }
+    }
+    for (uint32_t i : world.active) {
+        world.islandOf[i] = world.islandOf[find_root(world.islandParents, i)];
+    }
+
+    world.islandBodyStarts.assign(islands + 1, 0);
+    world.islandContactStarts.assign(islands + 1, 0);
+    for (uint32_t i : world.active) {
+        ++world.islandBodyStarts[world.islandOf[i] + 1];
+    }
+    for (uint32_t slice = 0; slice < slices; ++slice) {
+        for (const PhysicsContact& contact : world.sliceContacts[slice]) {
+            ++world.islandContactStarts[world.islandOf[contact.a] + 1];
+        }
+    }
+    for (uint32_t island = 0; island < islands; ++island) {
+        world.islandBodyStarts[island + 1] += world.islandBodyStarts[island];
+        world.islandContactStarts[island + 1] += world.islandContactStarts[island];
+    }
+    world.islandBodies.resize(world.active.size());
+    world.contacts.resize(contactCount);
+    {
+        std::vector<uint32_t>& bodyCursor = world.islandParents; // Done with the forest; reused as cursors
+        std::copy(world.islandBodyStarts.begin(), world.islandBodyStarts.end() - 1, bodyCursor.begin());
+        for (uint32_t i : world.active) {
+            world.islandBodies[bodyCursor[world.islandOf[i]]++] = i;
+        }
+        std::copy(world.islandContactStarts.begin(), world.islandContactStarts.end() - 1, bodyCursor.begin());
+        for (uint32_t slice = 0; slice < slices; ++slice) {
+            for (const PhysicsContact& contact : world.sliceContacts[slice]) {
+                world.contacts[bodyCursor[world.islandOf[contact.a]]++] = contact;
+            }
+        }
+    }
+
+    // Islands share no body, so each is solved and put to sleep on its own
+    world.islandSleeps.assign(islands, 0);
+    jobs.parallel_for(islands, ISLAND_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t island = begin; island < end; ++island) {
+            const uint32_t first = world.islandContactStarts[island];
+            solve_island(world, world.contacts.data() + first, world.islandContactStarts[island + 1] - first);
+
+            float rested = s.sleepTime;
+            for (uint32_t k = world.islandBodyStarts[island]; k < world.islandBodyStarts[island + 1]; ++k) {
+                const uint32_t i = world.islandBodies[k];
+                const float speed = simd::length(world.velocities[i]);
+                const float spin = simd::length(world.angularVelocities[i]) * world.radii[i];
+                world.restTimes[i] = std::max(speed, spin) < s.sleepSpeed ? world.restTimes[i] + dt : 0.0f;
+                rested = std::min(rested, world.restTimes[i]);
+            }
+            world.islandSleeps[island] = rested >= s.sleepTime;
+        }
+    });
+
+    // Move the bodies; sleeping ones stop where they are, so their interpolation holds still too
+    jobs.parallel_for((uint32_t)world.active.size(), BROADPHASE_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t k = begin; k < end; ++k) {
+            const uint32_t i = world.active[k];
+            world.previousPositions[i] = world.positions[i];
+            world.previousOrientations[i] = world.orientations[i];
+            if (world.islandSleeps[world.islandOf[i]]) {
+                world.awake[i] = 0;
+                world.velocities[i] = { 0.0f, 0.0f, 0.0f };
+                world.angularVelocities[i] = { 0.0f, 0.0f, 0.0f };
+                continue;
+            }
+            world.positions[i] += world.velocities[i] * dt;
+            world.orientations[i] = integrate_rotation(world.orientations[i], world.angularVelocities[i], dt);
+        }
+    });
+
+    // Restructuring the hierarchy is serial, but bodies inside their enlarged leaves cost one box test
+    uint32_t slept = 0;
+    for (uint32_t i : world.active) {
+        if (world.awake[i]) {
+            bvh_update(world.bvh, world.proxies[i], sphere_box(world.positions[i], world.radii[i]));
+        } else {
+            ++slept;
+        }
+    }
+
+    ++world.steps;
+    world.stats.awake = (uint32_t)world.active.size();
+    world.stats.contacts = contactCount;
+    world.stats.islands = islands;
+    world.stats.slept = slept;
+}
+
+uint32_t physics_update(PhysicsWorld& world, JobSystem& jobs, const HeightField& field, float dt) {
+    const float step = world.settings.step;
+    world.accumulator += std::max(dt, 0.0f);
+    const uint32_t due = (uint32_t)(world.accumulator / step);
+    world.accumulator -= due * step;
+    const uint32_t run = std::min(due, world.settings.maxCatchUpSteps);
+    for (uint32_t i = 0; i < run; ++i) {
+        physics_step(world, jobs, field);
+    }
+    return run;
+}
+
+simd::float4x4 physics_body_matrix(const PhysicsWorld& world, uint32_t body, float alpha) {
+    const simd::float4 from = world.previousOrientations[body].vector;
+    simd::float4 to = world.orientations[body].vector;
+    // Blend along the shorter arc
+    if (simd::dot(from, to) < 0.0f) {
+        to = -to;
+    }
+    const simd::float4 q = from + (to - from) * alpha;
+
+    Trs trs;
+    trs.translation = world.previousPositions[body] + (world.positions[body] - world.previousPositions[body]) * alpha;
+    trs.rotation = simd::quatf{ q / sqrtf(simd::dot(q, q)) };
+    const float diameter = 2.0f * world.radii[body];
+    trs.scale = { diameter, diameter, diameter };
+    return affine_matrix(affine_from_trs(trs));
+}
@@ -0,0 +1,186 @@
+/**
+ * @file physics.hpp
+ * @brief Rigid spheres stepped at a fixed rate against each other and the terrain height field.
+ *
+ * Each step integrates gravity into the velocities, finds contacts, solves them, and then moves
+ * the bodies. Body pairs come from a dynamic Bvh over the bodies (the same hierarchy the scene
+ * uses as its spatial index): every leaf is enlarged by a margin, so a body that moves a little
+ * costs nothing, and the awake bodies query it in parallel slices on the job system. Bodies touch
+ * the terrain where the height field's surface plane below them cuts into their sphere.
+ *
+ * Bodies joined by contacts form islands. Islands share no body, so the job system solves them in
+ * parallel, each with sequential impulses for a fixed number of passes; restitution and friction
+ * are applied there too. An island whose every body stayed slow for PhysicsSettings::sleepTime
+ * falls asleep: its bodies stop being integrated, queried or solved until something awake touches
+ * one of them. Resting piles therefore cost nearly nothing, which is what lets tens of thousands
+ * of bodies run at 60 Hz.
+ *
+ * All arrays are indexed by body and contacts are gathered in a fixed slice order, so a step is
+ * deterministic however many threads run it.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "height_field.hpp"
+#include "job_system.hpp"
+
+/// Stands in for the body index of the terrain in a contact.
+constexpr uint32_t PHYSICS_GROUND = UINT32_MAX;
+
+/**
+ * @struct PhysicsSettings
+ * @brief Step rate, solver and material tunables.
+ */
+struct PhysicsSettings {
+    float step = 1.0f / 60.0f;      ///< Seconds simulated per step.
+    uint32_t maxCatchUpSteps = 4;   ///< Most steps one physics_update() runs; older time is dropped.
+    simd::float3 gravity = { 0.0f, -9.8f, 0.0f }; ///< Acceleration of every awake body.
+    uint32_t iterations = 8;        ///< Solver passes over each island's contacts per step.
+    float restitution = 0.3f;       ///< Share of the approach speed an impact bounces back with.
+    float bounceSpeed = 1.0f;       ///< Slower impacts do not bounce, so resting contacts settle.
+    float friction = 0.6f;          ///< Coulomb friction coefficient of every contact.
+    float linearDamping = 0.02f;    ///< Share of the linear velocity lost per second.
+    float angularDamping = 0.3f;    ///< Share of the angular velocity lost per second; stands in for rolling resistance.
+    float correction = 0.2f;        ///< Share of the penetration pushed out per step.
+    float slop = 0.01f;             ///< Penetration left alone, so resting contacts keep touching.
+    float sleepSpeed = 0.1f;        ///< Bodies slower than this, at their centre and their rim, count as resting.
+    float sleepTime = 0.5f;         ///< Seconds an island must rest before it sleeps.
+};
+
+/**
+ * @struct PhysicsContact
+ * @brief A touching pair and the impulses the solver accumulated for it this step.
+ */
+struct PhysicsContact {
+    uint32_t a = 0;                                 ///< First body.
+    uint32_t b = PHYSICS_GROUND;                    ///< Second body, or PHYSICS_GROUND for the terrain.
+    simd::float3 normal = { 0.0f, 1.0f, 0.0f };    ///< From b towards a, unit length.
+    float depth = 0.0f;                             ///< How far the two overlap.
+    float bias = 0.0f;                              ///< Separation speed the solver aims for: bounce plus push-out.
+    float normalImpulse = 0.0f;                     ///< Accumulated along the normal; never negative.
+    simd::float3 frictionImpulse = { 0.0f, 0.0f, 0.0f }; ///< Accumulated across the normal.
+};
+
+/**
+ * @struct PhysicsStats
+ * @brief What the last step did.
+ */
+struct PhysicsStats {
+    uint32_t awake = 0;     ///< Bodies integrated.
+    uint32_t contacts = 0;  ///< Contacts solved, terrain contacts included.
+    uint32_t islands = 0;   ///< Islands solved, single bodies included.
+    uint32_t slept = 0;     ///< Bodies that fell asleep.
+};
+
+/**
+ * @struct PhysicsWorld
+ * @brief The bodies, one element per body in every array, and the step's scratch space.
+ */
+struct PhysicsWorld {
+    PhysicsSettings settings;                   ///< Tunables; may be changed between steps.
+
+    // --- Bodies ---
+    std::vector<simd::float3> positions;        ///< Centres after the last step.
+    std::vector<simd::float3> previousPositions; ///< Centres before the last step, for interpolation.
+    std::vector<simd::quatf> orientations;      ///< Unit rotations after the last step.
+    std::vector<simd::quatf> previousOrientations; ///< Rotations before the last step.
+    std::vector<simd::float3> velocities;       ///< Linear velocities.
+    std::vector<simd::float3> angularVelocities; ///< Angular velocities in radians per second.
+    std::vector<float> radii;                   ///< Sphere radii.
+    std::vector<float> inverseMasses;           ///< 1 / mass.
+    std::vector<float> inverseInertias;         ///< 1 / moment of inertia of a solid sphere.
+    std::vector<float> restTimes;               ///< Seconds each body has been slow.
+    std::vector<uint8_t> awake;                 ///< 1 while a body is simulated.
+    std::vector<uint32_t> proxies;              ///< Leaf of each body in bvh.
+    Bvh bvh;                                    ///< Broadphase over the bodies; items are body indices.
+
+    // --- Per step scratch, kept to avoid reallocating ---
+    std::vector<uint32_t> active;               ///< Awake bodies in index order.
+    std::vector<std::vector<PhysicsContact>> sliceContacts; ///< Contacts found by each broadphase slice.
+    std::vector<std::vector<uint32_t>> sliceItems; ///< Bvh query results of each slice.
+    std::vector<PhysicsContact> contacts;       ///< This step's contacts, grouped by island.
+    std::vector<uint32_t> islandParents;        ///< Union-find forest over the bodies.
+    std::vector<uint32_t> islandBodies;         ///< Awake bodies grouped by island.
+    std::vector<uint32_t> islandBodyStarts;     ///< First entry of each island in islandBodies, plus an end.
+    std::vector<uint32_t> islandContactStarts;  ///< First entry of each island in contacts, plus an end.
+    std::vector<uint32_t> islandOf;             ///< Island of each awake body this step.
+    std::vector<uint8_t> islandSleeps;          ///< 1 for islands that fell asleep this step.
+
+    float accumulator = 0.0f;                   ///< Seconds waiting for a full step.
+    uint64_t steps = 0;                         ///< Steps run so far.
+    PhysicsStats stats;                         ///< What the last step did.
+
+    /// @return The number of bodies.
+    size_t size() const { return positions.size(); }
+};
+
+/**
+ * @brief Creates an empty world with room for a number of bodies.
+ * @param capacity The body count to reserve for; adding up to it does not reallocate.
+ * @param settings The tunables.
+ * @return The world.
+ */
+PhysicsWorld create_physics_world(uint32_t capacity, const PhysicsSettings& settings = {});
+
+/**
+ * @brief Adds an awake solid sphere.
+ * @param world The world.
+ * @param position The centre.
+ * @param radius The radius; positive.
+ * @param velocity The starting velocity.
+ * @param density Mass per cubic unit.
+ * @return The body's index, stable until physics_clear().
+ */
+uint32_t physics_add_sphere(PhysicsWorld& world, simd::float3 position, float radius,
+                            simd::float3 velocity = { 0.0f, 0.0f, 0.0f }, float density = 1.0f);
+
+/**
+ * @brief Wakes a body, e.g. after moving it or changing its velocity from outside.
+ * @param world The world.
+ * @param body The body.
+ */
+void physics_wake(PhysicsWorld& world, uint32_t body);
+
+/// @brief Removes every body.
+void physics_clear(PhysicsWorld& world);
+
+/**
+ * @brief Runs one step of PhysicsSettings::step seconds.
+ * @param world The world.
+ * @param jobs Runs the broadphase slices and the islands.
+ * @param field The terrain; queries outside it use its border heights.
+ */
+void physics_step(PhysicsWorld& world, JobSystem& jobs, const HeightField& field);
+
+/**
+ * @brief Runs the steps that became due after dt more seconds.
+ *
+ * Time that is not a whole step is carried to the next call; more than maxCatchUpSteps due at
+ * once are dropped, so a stall does not snowball into ever longer updates.
+ *
+ * @param world The world.
+ * @param jobs Runs the broadphase slices and the islands.
+ * @param field The terrain.
+ * @param dt Seconds since the last update.
+ * @return The number of steps run.
+ */
+uint32_t physics_update(PhysicsWorld& world, JobSystem& jobs, const HeightField& field, float dt);
+
+/**
+ * @brief Returns a body's model to world transform between its last two steps.
+ * @param world The world.
+ * @param body The body.
+ * @param alpha 0 for the pose before the last step, 1 for the pose after it.
+ * @return Translation, rotation and a scale of the diameter, for a mesh of unit diameter.
+ */
+simd::float4x4 physics_body_matrix(const PhysicsWorld& world, uint32_t body, float alpha);
+
+/// @return How far the carried time is into the next step, for physics_body_matrix().
+inline float physics_alpha(const PhysicsWorld& world) {
+    return world.accumulator / world.settings.step;
+}
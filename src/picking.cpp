@@ -0,0 +1,75 @@
+#include "picking.hpp"
+
+#include <cmath>
+
+simd::float4x4 pick_projection(const simd::float4x4& projection, simd::float2 point, float width, float height) {
+    // Scales clip space about the point's position so PICK_TARGET_SIZE pixels span the whole of it
+    const simd::float2 center = { 2.0f * point.x - 1.0f, 1.0f - 2.0f * point.y };
+    const simd::float2 scale = { width / (float)PICK_TARGET_SIZE, height / (float)PICK_TARGET_SIZE };
+    const simd::float4x4 magnify(simd::float4{ scale.x, 0.0f, 0.0f, 0.0f }, simd::float4{ 0.0f, scale.y, 0.0f, 0.0f },
+                                 simd::float4{ 0.0f, 0.0f, 1.0f, 0.0f },
+                                 simd::float4{ -center.x * scale.x, -center.y * scale.y, 0.0f, 1.0f });
+    return magnify * projection;
+}
+
+PickRay pick_ray(const simd::float4x4& viewProjection, simd::float2 point, bool reverseZ) {
+    // Depth 0.5 lies beyond the near plane with either depth mapping, even with the far plane at infinity
+    const simd::float4x4 inverse = simd::inverse(viewProjection);
+    const simd::float2 ndc = { 2.0f * point.x - 1.0f, 1.0f - 2.0f * point.y };
+    const simd::float4 nearPoint = inverse * simd::float4{ ndc.x, ndc.y, reverseZ ? 1.0f : 0.0f, 1.0f };
+    const simd::float4 farPoint = inverse * simd::float4{ ndc.x, ndc.y, 0.5f, 1.0f };
+    PickRay ray;
+    ray.origin = simd::float3{ nearPoint.x, nearPoint.y, nearPoint.z } / nearPoint.w;
+    ray.direction = simd::normalize(simd::float3{ farPoint.x, farPoint.y, farPoint.z } / farPoint.w - ray.origin);
+    return ray;
+}
+
+uint32_t pick_resolve(const PickId* ids) {
+    constexpr int center = (int)PICK_TARGET_SIZE / 2;
+    constexpr int radius = (int)PICK_RADIUS;
+    uint32_t best = UINT32_MAX;
+    int bestDistance = radius * radius + 1;
+    for (int y = center - radius; y <= center + radius; ++y) {
+        for (int x = center - radius; x <= center + radius; ++x) {
+            const uint32_t texel = (uint32_t)(y * (int)PICK_TARGET_SIZE + x);
+            const int distance = (x - center) * (x - center) + (y - center) * (y - center);
+            if (ids[texel].slot != 0 && distance < bestDistance) {
+                best = texel;
+                bestDistance = distance;
+            }
+        }
+    }
+    return best;
+}
+
+Entity pick_entity(const SceneStore& scene, PickId id) {
+    if (id.slot == 0) {
+        return Entity{};
+    }
+    Entity entity;
+    entity.index = id.slot - 1;
+    entity.generation = id.generation;
+    return scene_alive(scene, entity) ? entity : Entity{};
+}
+
+bool pick_hidden_by_terrain(const SceneStore& scene, const HeightField& field, const PickRay& ray, Entity entity,
+                            float maxDistance) {
+    const uint32_t index = scene_index(scene, entity);
+    const CullBounds& bounds = scene.worldBounds;
+    const simd::float3 center = { bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index] };
+    const simd::float3 extent = { bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index] };
+    const float enter = ray_box_distance({ center - extent, center + extent }, ray.origin, 1.0f / ray.direction,
+                                         maxDistance);
+    // An ID target texel may lie just outside the bounds the ray misses; the terrain cannot be in front then
+    TerrainHit hit;
+    return enter > 0.0f && height_field_raycast(field, ray.origin, ray.direction, enter, hit) && hit.distance < enter;
+}
+
+Entity pick_raycast(const SceneStore& scene, const HeightField* field, const PickRay& ray, float maxDistance) {
+    float distance = 0.0f;
+    const Entity entity = scene_raycast(scene, ray.origin, ray.direction, maxDistance, distance);
+    if (!scene_alive(scene, entity) || (field && pick_hidden_by_terrain(scene, *field, ray, entity, maxDistance))) {
+        return Entity{};
+    }
+    return entity;
+}
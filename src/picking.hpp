@@ -0,0 +1,100 @@
+/**
+ * @file picking.hpp
+ * @brief Selecting the scene entity under a point of the view, from an ID buffer or a ray.
+ *
+ * The exact answer comes from the GPU: GpuPicking draws the entities near the point into a
+ * PICK_TARGET_SIZE square target of IDs, through pick_projection(), which magnifies the
+ * PICK_TARGET_SIZE scene pixels around the point to fill it, so the pass costs a few hundred
+ * pixels whatever the resolution. Each texel holds a PickId of the entity drawn there, and
+ * pick_resolve() takes the texel under the point, or the covered texel nearest to it within
+ * PICK_RADIUS, so thin objects can still be selected.
+ *
+ * The readback arrives frames later, so the ID names the handle slot and its generation, and
+ * pick_entity() drops it if that entity has been destroyed meanwhile. Where the GPU pass is not
+ * available, pick_raycast() answers from the scene's BVH instead: the first entity whose world
+ * bounds the ray enters, which may be a box around empty space. Both hide entities the terrain
+ * is in front of, by casting the same ray against the height field.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "height_field.hpp"
+#include "scene.hpp"
+
+/// Side of the square ID target, in pixels of the scene view it covers; odd, so one texel is under the point.
+constexpr uint32_t PICK_TARGET_SIZE = 15;
+/// Texels from the point within which the nearest drawn entity is picked if none is under it.
+constexpr uint32_t PICK_RADIUS = 4;
+
+/**
+ * @struct PickId
+ * @brief What one texel of the ID target holds; matches the picking fragment in shaders.metal.
+ */
+struct PickId {
+    uint32_t slot = 0;          ///< Handle slot of the entity plus one; 0 where no entity was drawn.
+    uint32_t generation = 0;    ///< Generation of the slot when the entity was drawn.
+};
+
+/**
+ * @struct PickRay
+ * @brief A ray from the eye through a point of the view.
+ */
+struct PickRay {
+    simd::float3 origin;        ///< On the near plane.
+    simd::float3 direction;     ///< Unit length.
+};
+
+/**
+ * @brief Returns a projection that fills the ID target with the pixels around a point of the view.
+ * @param projection The camera's projection.
+ * @param point The point, in [0, 1] across the view with y down.
+ * @param width Width of the view in pixels.
+ * @param height Height of the view in pixels.
+ * @return The projection, with the same depth mapping as projection.
+ */
+simd::float4x4 pick_projection(const simd::float4x4& projection, simd::float2 point, float width, float height);
+
+/**
+ * @brief Returns the ray through a point of the view.
+ * @param viewProjection The camera's view projection.
+ * @param point The point, in [0, 1] across the view with y down.
+ * @param reverseZ True if the projection maps the near plane to depth 1.
+ * @return The ray.
+ */
+PickRay pick_ray(const simd::float4x4& viewProjection, simd::float2 point, bool reverseZ);
+
+/**
+ * @brief Chooses the texel of a read back ID target that counts as picked.
+ * @param ids The target's texels, row by row; PICK_TARGET_SIZE squared.
+ * @return Index of the texel under the centre, or of the nearest one within PICK_RADIUS that holds an
+ *         entity; UINT32_MAX if none does.
+ */
+uint32_t pick_resolve(const PickId* ids);
+
+/// @return The entity an ID names, or a default Entity for none or if it no longer exists.
+Entity pick_entity(const SceneStore& scene, PickId id);
+
+/**
+ * @brief Tells whether the terrain hides an entity from a ray.
+ * @param scene The scene, with bounds up to date.
+ * @param field The height field.
+ * @param ray The ray.
+ * @param entity A live entity.
+ * @param maxDistance The end of the ray.
+ * @return True if the ray meets the terrain before it enters the entity's world bounds.
+ */
+bool pick_hidden_by_terrain(const SceneStore& scene, const HeightField& field, const PickRay& ray, Entity entity,
+                            float maxDistance);
+
+/**
+ * @brief Picks on the CPU: the first entity whose world bounds a ray enters before the terrain.
+ * @param scene The scene, with bounds up to date.
+ * @param field The height field; nullptr to ignore the terrain.
+ * @param ray The ray.
+ * @param maxDistance The end of the ray.
+ * @return The entity, or a default Entity for none.
+ */
+Entity pick_raycast(const SceneStore& scene, const HeightField* field, const PickRay& ray, float maxDistance);
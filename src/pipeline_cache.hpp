@@ -0,0 +1,94 @@
+/**
+ * @file pipeline_cache.hpp
+ * @brief Compiles pipeline states concurrently and keeps their GPU binaries in an on-disk MTLBinaryArchive.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <mutex>
+
+/**
+ * @class PipelineCache
+ * @brief Creates pipelines through the asynchronous Metal API, backed by a binary archive.
+ *
+ * On the first run the archive is empty: every pipeline is compiled from the library and
+ * its functions are added to the archive, which save() writes to disk. Later runs load the
+ * archive and pipeline creation skips the backend compile. The archive is discarded when
+ * the shader library is newer than it. Completion blocks run on a Metal thread; call
+ * wait() before reading anything they write.
+ */
+class PipelineCache {
+public:
+    /**
+     * @brief Opens the archive at archivePath, or starts an empty one.
+     * @param device The Metal device.
+     * @param archivePath Where the archive is loaded from and saved to; nil compiles every pipeline
+     *                    from the library and keeps no archive, e.g. for a library built at runtime.
+     * @param libraryPath The shader library the pipelines come from; used to detect a stale archive.
+     */
+    PipelineCache(id<MTLDevice> device, NSString* archivePath, NSString* libraryPath);
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    /**
+     * @brief Starts compiling a render pipeline.
+     * @param desc The pipeline descriptor; copied, so the caller may change it afterwards.
+     * @param name Name used in error messages.
+     * @param done Receives the pipeline state, or nil if compilation failed.
+     */
+    void compile(MTLRenderPipelineDescriptor* desc, NSString* name, void (^done)(id<MTLRenderPipelineState>));
+
+    /**
+     * @brief Starts compiling a mesh render pipeline.
+     *
+     * Mesh pipelines are not added to the archive, which only takes them from macOS 14 on;
+     * they always compile from the library.
+     *
+     * @param desc The pipeline descriptor.
+     * @param name Name used in error messages.
+     * @param done Receives the pipeline state, or nil if compilation failed.
+     */
+    void compile(MTLMeshRenderPipelineDescriptor* desc, NSString* name, void (^done)(id<MTLRenderPipelineState>))
+        API_AVAILABLE(macos(13.0));
+
+    /**
+     * @brief Starts compiling a compute pipeline.
+     * @param function The kernel function.
+     * @param name Name used in error messages.
+     * @param done Receives the pipeline state, or nil if compilation failed.
+     */
+    void compile(id<MTLFunction> function, NSString* name, void (^done)(id<MTLComputePipelineState>));
+
+    /// Blocks until every compile() started so far has called its completion block.
+    void wait();
+
+    /**
+     * @brief Writes the archive to disk if pipelines were added to it.
+     * @return False if the archive could not be written.
+     */
+    bool save();
+
+    /// @return True if the archive was loaded from disk.
+    bool loaded() const { return m_loaded; }
+
+    /// @return Pipelines that were not found in the archive and had to be compiled.
+    uint32_t miss_count() const;
+
+private:
+    void record_miss();
+
+    id<MTLDevice> m_device;
+    id<MTLBinaryArchive> m_archive;
+    NSURL* m_url;
+    dispatch_group_t m_pending;
+    bool m_loaded = false;
+    mutable std::mutex m_mutex;       ///< Guards the archive additions and the miss counters.
+    uint32_t m_misses = 0;
+    uint32_t m_savedMisses = 0;       ///< m_misses when the archive was last written.
+};
+
+/// @return The default archive location, inside the user's cache directory.
+NSString* default_pipeline_archive_path();
@@ -0,0 +1,184 @@
+#import "pipeline_cache.hpp"
+
+namespace {
+    NSDate* modification_date(NSString* path) {
+        NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil];
+        return attributes ? attributes.fileModificationDate : nil;
+    }
+}
+
+NSString* default_pipeline_archive_path() {
+    NSArray<NSString*>* caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+    NSString* base = caches.count > 0 ? caches[0] : NSTemporaryDirectory();
+    return [[base stringByAppendingPathComponent:@"glfw_metal"] stringByAppendingPathComponent:@"pipelines.binarchive"];
+}
+
+PipelineCache::PipelineCache(id<MTLDevice> device, NSString* archivePath, NSString* libraryPath)
+    : m_device(device), m_url(archivePath ? [NSURL fileURLWithPath:archivePath] : nil),
+      m_pending(dispatch_group_create()) {
+    if (!archivePath) {
+        return;
+    }
+    NSDate* archiveDate = modification_date(archivePath);
+    NSDate* libraryDate = modification_date(libraryPath);
+    bool fresh = archiveDate && (!libraryDate || [archiveDate compare:libraryDate] != NSOrderedAscending);
+
+    NSError* error = nil;
+    MTLBinaryArchiveDescriptor* desc = [MTLBinaryArchiveDescriptor new];
+    if (fresh) {
+        desc.url = m_url;
+        m_archive = [device newBinaryArchiveWithDescriptor:desc error:&error];
+        if (m_archive) {
+            m_loaded = true;
+        } else {
+            NSLog(@"Discarding pipeline archive %@: %@", archivePath, error);
+            desc.url = nil;
+        }
+    }
+    if (!m_archive) {
+        m_archive = [device newBinaryArchiveWithDescriptor:desc error:&error];
+        if (!m_archive) {
+            NSLog(@"Error creating pipeline archive: %@", error);
+        }
+    }
+}
+
+PipelineCache::~PipelineCache() {
+    wait();
+}
+
+void PipelineCache::compile(MTLRenderPipelineDescriptor* desc, NSString* name, void (^done)(id<MTLRenderPipelineState>)) {
+    MTLRenderPipelineDescriptor* copy = [desc copy];
+    id<MTLBinaryArchive> archive = m_archive;
+    if (archive) {
+        copy.binaryArchives = @[archive];
+    }
+
+    // A loaded archive should hold every pipeline; fail fast on a miss and compile it properly below
+    const bool expectHit = m_loaded;
+    MTLPipelineOption options = expectHit ? MTLPipelineOptionFailOnBinaryArchiveMiss : MTLPipelineOptionNone;
+
+    dispatch_group_enter(m_pending);
+    [m_device newRenderPipelineStateWithDescriptor:copy options:options completionHandler:^(id<MTLRenderPipelineState> state, MTLRenderPipelineReflection*, NSError* error) {
+        if (state || !archive) {
+            if (!state) {
+                NSLog(@"Error creating %@ pipeline state: %@", name, error);
+            } else if (!expectHit) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                NSError* addError = nil;
+                if (![archive addRenderPipelineFunctionsWithDescriptor:copy error:&addError]) {
+                    NSLog(@"Error archiving %@ pipeline: %@", name, addError);
+                }
+                m_misses++;
+            }
+            done(state);
+            dispatch_group_leave(m_pending);
+            return;
+        }
+
+        // Missed the archive: compile from the library and add the result
+        record_miss();
+        NSError* compileError = nil;
+        id<MTLRenderPipelineState> compiled = [m_device newRenderPipelineStateWithDescriptor:copy error:&compileError];
+        if (!compiled) {
+            NSLog(@"Error creating %@ pipeline state: %@", name, compileError);
+        } else {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            [archive addRenderPipelineFunctionsWithDescriptor:copy error:nil];
+        }
+        done(compiled);
+        dispatch_group_leave(m_pending);
+    }];
+}
+
+void PipelineCache::compile(MTLMeshRenderPipelineDescriptor* desc, NSString* name,
+                            void (^done)(id<MTLRenderPipelineState>)) {
+    dispatch_group_enter(m_pending);
+    [m_device newRenderPipelineStateWithMeshDescriptor:desc options:MTLPipelineOptionNone completionHandler:^(id<MTLRenderPipelineState> state, MTLRenderPipelineReflection*, NSError* error) {
+        if (!state) {
+            NSLog(@"Error creating %@ pipeline state: %@", name, error);
+        }
+        done(state);
+        dispatch_group_leave(m_pending);
+    }];
+}
+
+void PipelineCache::compile(id<MTLFunction> function, NSString* name, void (^done)(id<MTLComputePipelineState>)) {
+    MTLComputePipelineDescriptor* desc = [MTLComputePipelineDescriptor new];
+    desc.computeFunction = function;
+    desc.label = name;
+    id<MTLBinaryArchive> archive = m_archive;
+    if (archive) {
+        desc.binaryArchives = @[archive];
+    }
+
+    const bool expectHit = m_loaded;
+    MTLPipelineOption options = expectHit ? MTLPipelineOptionFailOnBinaryArchiveMiss : MTLPipelineOptionNone;
+
+    dispatch_group_enter(m_pending);
+    [m_device newComputePipelineStateWithDescriptor:desc options:options completionHandler:^(id<MTLComputePipelineState> state, MTLComputePipelineReflection*, NSError* error) {
+        if (state || !archive) {
+            if (!state) {
+                NSLog(@"Error creating %@ pipeline state: %@", name, error);
+            } else if (!expectHit) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                NSError* addError = nil;
+                if (![archive addComputePipelineFunctionsWithDescriptor:desc error:&addError]) {
+                    NSLog(@"Error archiving %@ pipeline: %@", name, addError);
+                }
+                m_misses++;
+            }
+            done(state);
+            dispatch_group_leave(m_pending);
+            return;
+        }
+
+        record_miss();
+        NSError* compileError = nil;
+        id<MTLComputePipelineState> compiled = [m_device newComputePipelineStateWithDescriptor:desc
+                                                                                       options:MTLPipelineOptionNone
+                                                                                    reflection:nil
+                                                                                         error:&compileError];
+        if (!compiled) {
+            NSLog(@"Error creating %@ pipeline state: %@", name, compileError);
+        } else {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            [archive addComputePipelineFunctionsWithDescriptor:desc error:nil];
+        }
+        done(compiled);
+        dispatch_group_leave(m_pending);
+    }];
+}
+
+void PipelineCache::wait() {
+    dispatch_group_wait(m_pending, DISPATCH_TIME_FOREVER);
+}
+
+bool PipelineCache::save() {
+    wait();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_archive || m_misses == m_savedMisses) {
+        return true;
+    }
+
+    NSString* directory = [m_url.path stringByDeletingLastPathComponent];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSError* error = nil;
+    if (![m_archive serializeToURL:m_url error:&error]) {
+        NSLog(@"Error saving pipeline archive to %@: %@", m_url.path, error);
+        return false;
+    }
+    m_savedMisses = m_misses;
+    return true;
+}
+
+uint32_t PipelineCache::miss_count() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+}
+
+void PipelineCache::record_miss() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_misses++;
+}
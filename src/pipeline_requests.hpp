@@ -0,0 +1,75 @@
+/**
+ * @file pipeline_requests.hpp
+ * @brief Hands pipelines compiled on other threads back to the thread that requested them.
+ *
+ * metal_request_pipeline() starts a compile and returns at once; the compile finishes on a Metal
+ * thread, which records the result here. The requesting thread collects it on a later call and
+ * moves it into its own table, so only the hand-off itself is locked and the table is never
+ * touched from two threads. Kept apart from MetalContext so the states can be tested without a
+ * device.
+ */
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @enum PipelineRequestState
+ * @brief Where a requested pipeline is, as seen by the thread that requested it.
+ */
+enum class PipelineRequestState {
+    Pending,  ///< Still compiling.
+    Finished, ///< Compiled, and now in the requester's table.
+    Failed,   ///< Did not compile; the requester's table holds null for it.
+};
+
+/**
+ * @struct PipelineRequests
+ * @brief Requested pipelines that finished, handed from the compiling threads to the requester.
+ * @tparam Pipeline A nullable pipeline handle; null stands for a failed compile.
+ */
+template <typename Pipeline>
+struct PipelineRequests {
+    std::mutex mutex;
+    std::unordered_map<uint32_t, Pipeline> finished; ///< Null for those that failed.
+};
+
+/**
+ * @brief Records the result of a requested compile; call from the thread it finished on.
+ * @param requests The requests.
+ * @param key The requested pipeline's key.
+ * @param pipeline The pipeline, or null if it failed to compile.
+ */
+template <typename Pipeline>
+void pipeline_request_finish(PipelineRequests<Pipeline>& requests, uint32_t key, Pipeline pipeline) {
+    std::lock_guard<std::mutex> lock(requests.mutex);
+    requests.finished[key] = pipeline;
+}
+
+/**
+ * @brief Moves a requested pipeline into the requester's table once its compile has finished.
+ * @param requests The requests.
+ * @param pending Keys requested and not yet collected; key is dropped from it once finished.
+ * @param pipelines The requester's table, which the pipeline joins, null if it failed.
+ * @param key The requested pipeline's key, which must be in pending.
+ * @return Pending, with nothing changed, until the compile has finished; then Finished or Failed.
+ */
+template <typename Pipeline>
+PipelineRequestState pipeline_request_collect(PipelineRequests<Pipeline>& requests, std::unordered_set<uint32_t>& pending,
+                                              std::unordered_map<uint32_t, Pipeline>& pipelines, uint32_t key) {
+    Pipeline pipeline;
+    {
+        std::lock_guard<std::mutex> lock(requests.mutex);
+        auto done = requests.finished.find(key);
+        if (done == requests.finished.end()) {
+            return PipelineRequestState::Pending;
+        }
+        pipeline = done->second;
+        requests.finished.erase(done);
+    }
+    pending.erase(key);
+    pipelines[key] = pipeline;
+    return pipeline ? PipelineRequestState::Finished : PipelineRequestState::Failed;
+}
@@ -0,0 +1,414 @@
+/**
+ * @file simd.h
+ * @brief A portable stand-in for Apple's <simd/simd.h>, for building the engine core off Apple platforms.
+ *
+ * Only non-Apple builds put src/portable on the include path (see CMakeLists.txt), so the
+ * core's `#include <simd/simd.h>` finds this header on Linux and the system one on macOS.
+ * It covers the part of the simd library the portable modules use: the vector and matrix
+ * types, with the size and alignment of Apple's so structs written to files keep their
+ * layout, element-wise arithmetic, and the geometric and matrix functions. The types are
+ * plain structs of scalars rather than compiler vector extensions; the element-wise loops
+ * still vectorise, and the core spends its time in scalar code anyway.
+ *
+ * Swizzles other than .x, .y, .z and .w are not provided, so portable code spells them out.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace simd {
+
+struct alignas(8) float2 {
+    float x, y;
+    float& operator[](size_t i) { return (&x)[i]; }
+    float operator[](size_t i) const { return (&x)[i]; }
+};
+
+/// 16 bytes, as Apple's; the padding lane is kept zero.
+struct alignas(16) float3 {
+    float x, y, z, pad;
+    float& operator[](size_t i) { return (&x)[i]; }
+    float operator[](size_t i) const { return (&x)[i]; }
+};
+
+struct alignas(16) float4 {
+    float x, y, z, w;
+    float4() = default;
+    constexpr float4(float s) : x(s), y(s), z(s), w(s) {}
+    constexpr float4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+    float& operator[](size_t i) { return (&x)[i]; }
+    float operator[](size_t i) const { return (&x)[i]; }
+};
+
+/// Eight lanes, as the noise evaluates its widest batches.
+struct alignas(32) float8 {
+    float lanes[8];
+    float8() = default;
+    constexpr float8(float s) : lanes{ s, s, s, s, s, s, s, s } {}
+    constexpr float8(float a, float b, float c, float d, float e, float f, float g, float h)
+        : lanes{ a, b, c, d, e, f, g, h } {}
+    float& operator[](size_t i) { return lanes[i]; }
+    float operator[](size_t i) const { return lanes[i]; }
+};
+
+struct alignas(8) int2 {
+    int32_t x, y;
+};
+
+struct alignas(8) uint2 {
+    uint32_t x, y;
+};
+
+struct double3 {
+    double x, y, z;
+};
+
+/// Four or eight integer lanes, as the noise hashes its lattice corners.
+template <typename T, size_t N>
+struct alignas(N * sizeof(T)) integer_vector {
+    T lanes[N];
+    integer_vector() = default;
+    constexpr integer_vector(T s) : lanes{} {
+        for (size_t i = 0; i < N; ++i) {
+            lanes[i] = s;
+        }
+    }
+    template <typename... Rest, typename = std::enable_if_t<sizeof...(Rest) + 1 == N>>
+    constexpr integer_vector(T first, Rest... rest) : lanes{ first, T(rest)... } {}
+    T& operator[](size_t i) { return lanes[i]; }
+    T operator[](size_t i) const { return lanes[i]; }
+};
+
+typedef integer_vector<int32_t, 4> int4;
+typedef integer_vector<uint32_t, 4> uint4;
+typedef integer_vector<int32_t, 8> int8;
+typedef integer_vector<uint32_t, 8> uint8;
+
+struct float3x3 {
+    float3 columns[3];
+    float3x3() = default;
+    float3x3(float3 c0, float3 c1, float3 c2) : columns{ c0, c1, c2 } {}
+};
+
+struct float4x4 {
+    float4 columns[4];
+    float4x4() = default;
+    float4x4(float4 c0, float4 c1, float4 c2, float4 c3) : columns{ c0, c1, c2, c3 } {}
+};
+
+struct quatf {
+    float4 vector; ///< Imaginary parts in x, y and z, the real part in w.
+};
+
+namespace detail {
+    inline float2 map(float2 a, float2 b, float (*f)(float, float)) { return { f(a.x, b.x), f(a.y, b.y) }; }
+    inline float3 map(float3 a, float3 b, float (*f)(float, float)) {
+        return { f(a.x, b.x), f(a.y, b.y), f(a.z, b.z), 0.0f };
+    }
+    inline float4 map(float4 a, float4 b, float (*f)(float, float)) {
+        return { f(a.x, b.x), f(a.y, b.y), f(a.z, b.z), f(a.w, b.w) };
+    }
+    inline float8 map(float8 a, float8 b, float (*f)(float, float)) {
+        float8 r;
+        for (size_t i = 0; i < 8; ++i) {
+            r[i] = f(a[i], b[i]);
+        }
+        return r;
+    }
+    inline float2 map(float2 a, float (*f)(float)) { return { f(a.x), f(a.y) }; }
+    inline float3 map(float3 a, float (*f)(float)) { return { f(a.x), f(a.y), f(a.z), 0.0f }; }
+    inline float4 map(float4 a, float (*f)(float)) { return { f(a.x), f(a.y), f(a.z), f(a.w) }; }
+    inline float8 map(float8 a, float (*f)(float)) {
+        float8 r;
+        for (size_t i = 0; i < 8; ++i) {
+            r[i] = f(a[i]);
+        }
+        return r;
+    }
+    inline float2 splat(float2, float s) { return { s, s }; }
+    inline float3 splat(float3, float s) { return { s, s, s, 0.0f }; }
+    inline float4 splat(float4, float s) { return { s, s, s, s }; }
+    inline float8 splat(float8, float s) { return float8(s); }
+    inline float add(float a, float b) { return a + b; }
+    inline float sub(float a, float b) { return a - b; }
+    inline float mul(float a, float b) { return a * b; }
+    inline float div(float a, float b) { return a / b; }
+    inline float minimum(float a, float b) { return b < a ? b : a; }
+    inline float maximum(float a, float b) { return a < b ? b : a; }
+    inline float absolute(float a) { return std::fabs(a); }
+    inline float square_root(float a) { return std::sqrt(a); }
+    inline float round_down(float a) { return std::floor(a); }
+}
+
+// ---- Float vectors ----
+// Every operator and function takes any of float2, float3, float4 and float8; a scalar operand is splat.
+
+#define SIMD_PORTABLE_FLOAT_VECTOR(V)                                                                          \
+    inline V operator+(V a, V b) { return detail::map(a, b, detail::add); }                                    \
+    inline V operator-(V a, V b) { return detail::map(a, b, detail::sub); }                                    \
+    inline V operator*(V a, V b) { return detail::map(a, b, detail::mul); }                                    \
+    inline V operator/(V a, V b) { return detail::map(a, b, detail::div); }                                    \
+    inline V operator+(V a, float s) { return a + detail::splat(a, s); }                                       \
+    inline V operator-(V a, float s) { return a - detail::splat(a, s); }                                       \
+    inline V operator*(V a, float s) { return a * detail::splat(a, s); }                                       \
+    inline V operator/(V a, float s) { return a / detail::splat(a, s); }                                       \
+    inline V operator+(float s, V a) { return detail::splat(a, s) + a; }                                       \
+    inline V operator-(float s, V a) { return detail::splat(a, s) - a; }                                       \
+    inline V operator*(float s, V a) { return detail::splat(a, s) * a; }                                       \
+    inline V operator/(float s, V a) { return detail::splat(a, s) / a; }                                       \
+    inline V operator-(V a) { return detail::splat(a, 0.0f) - a; }                                             \
+    inline V& operator+=(V& a, V b) { return a = a + b; }                                                      \
+    inline V& operator-=(V& a, V b) { return a = a - b; }                                                      \
+    inline V& operator*=(V& a, V b) { return a = a * b; }                                                      \
+    inline V& operator/=(V& a, V b) { return a = a / b; }                                                      \
+    inline V& operator*=(V& a, float s) { return a = a * s; }                                                  \
+    inline V& operator/=(V& a, float s) { return a = a / s; }                                                  \
+    inline V min(V a, V b) { return detail::map(a, b, detail::minimum); }                                      \
+    inline V max(V a, V b) { return detail::map(a, b, detail::maximum); }                                      \
+    inline V min(V a, float s) { return min(a, detail::splat(a, s)); }                                         \
+    inline V max(V a, float s) { return max(a, detail::splat(a, s)); }                                         \
+    inline V clamp(V v, V lo, V hi) { return min(max(v, lo), hi); }                                           \
+    inline V clamp(V v, float lo, float hi) { return min(max(v, lo), hi); }                                    \
+    inline V abs(V a) { return detail::map(a, detail::absolute); }                                             \
+    inline V sqrt(V a) { return detail::map(a, detail::square_root); }                                         \
+    inline V floor(V a) { return detail::map(a, detail::round_down); }                                         \
+    inline V mix(V a, V b, float t) { return a + (b - a) * t; }                                                \
+    inline float length_squared(V a) { return dot(a, a); }                                                     \
+    inline float length(V a) { return std::sqrt(dot(a, a)); }                                                  \
+    inline float distance(V a, V b) { return length(a - b); }                                                 \
+    inline float distance_squared(V a, V b) { return length_squared(a - b); }                                  \
+    inline V normalize(V a) { return a / length(a); }
+
+inline float dot(float2 a, float2 b) { return a.x * b.x + a.y * b.y; }
+inline float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float dot(float4 a, float4 b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+inline float dot(float8 a, float8 b) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < 8; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+SIMD_PORTABLE_FLOAT_VECTOR(float2)
+SIMD_PORTABLE_FLOAT_VECTOR(float3)
+SIMD_PORTABLE_FLOAT_VECTOR(float4)
+SIMD_PORTABLE_FLOAT_VECTOR(float8)
+
+#undef SIMD_PORTABLE_FLOAT_VECTOR
+
+inline float3 cross(float3 a, float3 b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x, 0.0f };
+}
+
+inline float4 fma(float4 a, float4 b, float4 c) {
+    return { std::fma(a.x, b.x, c.x), std::fma(a.y, b.y, c.y), std::fma(a.z, b.z, c.z), std::fma(a.w, b.w, c.w) };
+}
+
+inline float8 fma(float8 a, float8 b, float8 c) {
+    float8 r;
+    for (size_t i = 0; i < 8; ++i) {
+        r[i] = std::fma(a[i], b[i], c[i]);
+    }
+    return r;
+}
+
+/// Lane masks, all bits set where the comparison holds, as Apple's comparisons return.
+inline int4 operator>(float4 a, float4 b) {
+    return { a.x > b.x ? -1 : 0, a.y > b.y ? -1 : 0, a.z > b.z ? -1 : 0, a.w > b.w ? -1 : 0 };
+}
+
+inline int8 operator>(float8 a, float8 b) {
+    int8 r;
+    for (size_t i = 0; i < 8; ++i) {
+        r[i] = a[i] > b[i] ? -1 : 0;
+    }
+    return r;
+}
+
+// ---- Integer vectors ----
+
+inline int2 operator+(int2 a, int2 b) { return { a.x + b.x, a.y + b.y }; }
+inline int2 operator-(int2 a, int2 b) { return { a.x - b.x, a.y - b.y }; }
+
+#define SIMD_PORTABLE_INTEGER_OP(op)                                                                           \
+    template <typename T, size_t N>                                                                            \
+    integer_vector<T, N> operator op(integer_vector<T, N> a, integer_vector<T, N> b) {                         \
+        integer_vector<T, N> r;                                                                                \
+        for (size_t i = 0; i < N; ++i) {                                                                       \
+            r[i] = T(a[i] op b[i]);                                                                            \
+        }                                                                                                      \
+        return r;                                                                                              \
+    }                                                                                                          \
+    template <typename T, size_t N>                                                                            \
+    integer_vector<T, N> operator op(integer_vector<T, N> a, T s) {                                            \
+        return a op integer_vector<T, N>(s);                                                                   \
+    }                                                                                                          \
+    template <typename T, size_t N>                                                                            \
+    integer_vector<T, N> operator op(T s, integer_vector<T, N> a) {                                            \
+        return integer_vector<T, N>(s) op a;                                                                   \
+    }                                                                                                          \
+    template <typename T, size_t N>                                                                            \
+    integer_vector<T, N>& operator op##=(integer_vector<T, N>& a, integer_vector<T, N> b) {                    \
+        return a = a op b;                                                                                     \
+    }                                                                                                          \
+    template <typename T, size_t N>                                                                            \
+    integer_vector<T, N>& operator op##=(integer_vector<T, N>& a, T s) {                                       \
+        return a = a op integer_vector<T, N>(s);                                                               \
+    }
+
+SIMD_PORTABLE_INTEGER_OP(+)
+SIMD_PORTABLE_INTEGER_OP(-)
+SIMD_PORTABLE_INTEGER_OP(*)
+SIMD_PORTABLE_INTEGER_OP(&)
+SIMD_PORTABLE_INTEGER_OP(|)
+SIMD_PORTABLE_INTEGER_OP(^)
+
+#undef SIMD_PORTABLE_INTEGER_OP
+
+// Literals are int, so the unsigned lanes also take them
+template <size_t N>
+using unsigned_vector = integer_vector<uint32_t, N>;
+template <size_t N>
+unsigned_vector<N> operator+(unsigned_vector<N> a, unsigned s) { return a + unsigned_vector<N>(s); }
+template <size_t N>
+unsigned_vector<N> operator*(unsigned_vector<N> a, unsigned s) { return a * unsigned_vector<N>(s); }
+template <size_t N>
+unsigned_vector<N> operator&(unsigned_vector<N> a, unsigned s) { return a & unsigned_vector<N>(s); }
+template <size_t N>
+unsigned_vector<N> operator^(unsigned_vector<N> a, unsigned s) { return a ^ unsigned_vector<N>(s); }
+template <size_t N>
+unsigned_vector<N>& operator*=(unsigned_vector<N>& a, unsigned s) { return a = a * unsigned_vector<N>(s); }
+
+template <typename T, size_t N>
+integer_vector<T, N> operator>>(integer_vector<T, N> a, int shift) {
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = T(a[i] >> shift);
+    }
+    return a;
+}
+
+template <typename T, size_t N>
+integer_vector<T, N> operator<<(integer_vector<T, N> a, int shift) {
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = T(a[i] << shift);
+    }
+    return a;
+}
+
+// ---- Matrices ----
+
+inline float3 operator*(const float3x3& m, float3 v) {
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z;
+}
+
+inline float4 operator*(const float4x4& m, float4 v) {
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+}
+
+inline float3x3 operator*(const float3x3& a, const float3x3& b) {
+    return { a * b.columns[0], a * b.columns[1], a * b.columns[2] };
+}
+
+inline float4x4 operator*(const float4x4& a, const float4x4& b) {
+    return { a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3] };
+}
+
+inline float3x3 transpose(const float3x3& m) {
+    float3x3 t;
+    for (size_t c = 0; c < 3; ++c) {
+        t.columns[c] = { m.columns[0][c], m.columns[1][c], m.columns[2][c], 0.0f };
+    }
+    return t;
+}
+
+inline float4x4 transpose(const float4x4& m) {
+    float4x4 t;
+    for (size_t c = 0; c < 4; ++c) {
+        t.columns[c] = { m.columns[0][c], m.columns[1][c], m.columns[2][c], m.columns[3][c] };
+    }
+    return t;
+}
+
+inline float3x3 inverse(const float3x3& m) {
+    const float3 a = m.columns[0], b = m.columns[1], c = m.columns[2];
+    const float3 r0 = cross(b, c), r1 = cross(c, a), r2 = cross(a, b);
+    const float inv = 1.0f / dot(a, r0);
+    return transpose(float3x3(r0 * inv, r1 * inv, r2 * inv));
+}
+
+/// The inverse by cofactors; the rows of the adjugate are built from 2x2 minors of column pairs.
+inline float4x4 inverse(const float4x4& m) {
+    const float4 a = m.columns[0], b = m.columns[1], c = m.columns[2], d = m.columns[3];
+    const float s0 = a.x * b.y - b.x * a.y, s1 = a.x * b.z - b.x * a.z, s2 = a.x * b.w - b.x * a.w;
+    const float s3 = a.y * b.z - b.y * a.z, s4 = a.y * b.w - b.y * a.w, s5 = a.z * b.w - b.z * a.w;
+    const float c5 = c.z * d.w - d.z * c.w, c4 = c.y * d.w - d.y * c.w, c3 = c.y * d.z - d.y * c.z;
+    const float c2 = c.x * d.w - d.x * c.w, c1 = c.x * d.z - d.x * c.z, c0 = c.x * d.y - d.x * c.y;
+    const float inv = 1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+    float4x4 r;
+    r.columns[0] = float4(b.y * c5 - b.z * c4 + b.w * c3, -a.y * c5 + a.z * c4 - a.w * c3,
+                          d.y * s5 - d.z * s4 + d.w * s3, -c.y * s5 + c.z * s4 - c.w * s3) * inv;
+    r.columns[1] = float4(-b.x * c5 + b.z * c2 - b.w * c1, a.x * c5 - a.z * c2 + a.w * c1,
+                          -d.x * s5 + d.z * s2 - d.w * s1, c.x * s5 - c.z * s2 + c.w * s1) * inv;
+    r.columns[2] = float4(b.x * c4 - b.y * c2 + b.w * c0, -a.x * c4 + a.y * c2 - a.w * c0,
+                          d.x * s4 - d.y * s2 + d.w * s0, -c.x * s4 + c.y * s2 - c.w * s0) * inv;
+    r.columns[3] = float4(-b.x * c3 + b.y * c1 - b.z * c0, a.x * c3 - a.y * c1 + a.z * c0,
+                          -d.x * s3 + d.y * s1 - d.z * s0, c.x * s3 - c.y * s1 + c.z * s0) * inv;
+    return r;
+}
+
+}
+
+// ---- C names ----
+
+typedef simd::float2 simd_float2;
+typedef simd::float3 simd_float3;
+typedef simd::float4 simd_float4;
+typedef simd::float8 simd_float8;
+typedef simd::float3x3 simd_float3x3;
+typedef simd::float4x4 simd_float4x4;
+typedef simd::quatf simd_quatf;
+
+inline simd_float3 simd_make_float3(float x, float y, float z) { return { x, y, z, 0.0f }; }
+inline simd_float4 simd_make_float4(float x, float y, float z, float w) { return { x, y, z, w }; }
+
+/// A rotation of angle radians about a unit axis.
+inline simd_quatf simd_quaternion(float angle, simd_float3 axis) {
+    const float s = std::sin(angle * 0.5f);
+    return { { axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) } };
+}
+
+// Conversions truncate toward zero, as Apple's do
+inline simd::int4 simd_int(simd::float4 v) { return { (int32_t)v.x, (int32_t)v.y, (int32_t)v.z, (int32_t)v.w }; }
+inline simd::uint4 simd_uint(simd::int4 v) {
+    return { (uint32_t)v[0], (uint32_t)v[1], (uint32_t)v[2], (uint32_t)v[3] };
+}
+inline simd::float4 simd_float(simd::int4 v) { return { (float)v[0], (float)v[1], (float)v[2], (float)v[3] }; }
+inline simd::float4 simd_float(simd::uint4 v) { return { (float)v[0], (float)v[1], (float)v[2], (float)v[3] }; }
+
+inline simd::int8 simd_int(simd::float8 v) {
+    simd::int8 r;
+    for (size_t i = 0; i < 8; ++i) {
+        r[i] = (int32_t)v[i];
+    }
+    return r;
+}
+inline simd::uint8 simd_uint(simd::int8 v) {
+    simd::uint8 r;
+    for (size_t i = 0; i < 8; ++i) {
+        r[i] = (uint32_t)v[i];
+    }
+    return r;
+}
+template <typename T>
+simd::float8 simd_float(simd::integer_vector<T, 8> v) {
+    simd::float8 r;
+    for (size_t i = 0; i < 8; ++i) {
+        r[i] = (float)v[i];
+    }
+    return r;
+}
@@ -0,0 +1,184 @@
+#include "primitives.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cube.hpp"
+#include "sphere.hpp"
+#include "vertex_cache.hpp"
+
+namespace {
+    // One circle of vertices of a surface of revolution, and the direction of their normals
+    struct LatheRow {
+        float radius;
+        float y;
+        float normalRadius;
+        float normalY;
+        float normalShift; // Azimuth offset of the normals in segments; -0.5 centres an apex's normal on its triangle
+    };
+
+    // Rows from top to bottom, wound counter-clockwise seen from outside like the sphere; a row of radius 0
+    // is a pole or an apex, whose degenerate triangles are left out
+    void add_lathe(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const LatheRow* rows,
+                   uint32_t rowCount) {
+        const uint32_t first = (uint32_t)vertices.size();
+        const uint32_t stride = PRIMITIVE_SEGMENTS + 1;
+        const float step = 2.0f * (float)M_PI / PRIMITIVE_SEGMENTS;
+        for (uint32_t row = 0; row < rowCount; ++row) {
+            const LatheRow& r = rows[row];
+            for (uint32_t segment = 0; segment <= PRIMITIVE_SEGMENTS; ++segment) {
+                const float azimuth = step * segment;
+                const float normalAzimuth = step * (segment + r.normalShift);
+                const simd::float3 position = { r.radius * cosf(azimuth), r.y, -r.radius * sinf(azimuth) };
+                const simd::float3 normal = { r.normalRadius * cosf(normalAzimuth), r.normalY,
+                                              -r.normalRadius * sinf(normalAzimuth) };
+                vertices.push_back({ position, simd::normalize(normal) });
+            }
+        }
+        for (uint32_t row = 0; row + 1 < rowCount; ++row) {
+            for (uint32_t segment = 0; segment < PRIMITIVE_SEGMENTS; ++segment) {
+                const uint32_t a = first + row * stride + segment;
+                const uint32_t b = a + stride;
+                if (rows[row].radius > 0.0f) {
+                    indices.insert(indices.end(), { a, b, a + 1 });
+                }
+                if (rows[row + 1].radius > 0.0f) {
+                    indices.insert(indices.end(), { a + 1, b, b + 1 });
+                }
+            }
+        }
+    }
+
+    // A flat disc facing up for normalY 1 or down for -1; its rim is not shared with the sides so it stays flat
+    void add_cap(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float radius, float y, float normalY) {
+        const uint32_t center = (uint32_t)vertices.size();
+        const simd::float3 normal = { 0.0f, normalY, 0.0f };
+        const float step = 2.0f * (float)M_PI / PRIMITIVE_SEGMENTS;
+        vertices.push_back({ { 0.0f, y, 0.0f }, normal });
+        for (uint32_t segment = 0; segment <= PRIMITIVE_SEGMENTS; ++segment) {
+            const float azimuth = step * segment;
+            vertices.push_back({ { radius * cosf(azimuth), y, -radius * sinf(azimuth) }, normal });
+        }
+        for (uint32_t segment = 0; segment < PRIMITIVE_SEGMENTS; ++segment) {
+            const uint32_t rim = center + 1 + segment;
+            if (normalY > 0.0f) {
+                indices.insert(indices.end(), { center, rim, rim + 1 });
+            } else {
+                indices.insert(indices.end(), { center, rim + 1, rim });
+            }
+        }
+    }
+
+    MeshData make_mesh(std::vector<Vertex>&& vertices, const std::vector<uint32_t>& indices) {
+        MeshData mesh;
+        mesh.vertices = std::move(vertices);
+        mesh.indices.resize(indices.size(), mesh.vertices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (mesh.indices.format == IndexFormat::UInt16) {
+                mesh.indices.indices16[i] = (uint16_t)indices[i];
+            } else {
+                mesh.indices.indices32[i] = indices[i];
+            }
+        }
+        mesh.bounds = compute_bounds(mesh.vertices.data(), mesh.vertices.size());
+        return mesh;
+    }
+}
+
+const char* primitive_name(Primitive primitive) {
+    switch (primitive) {
+    case Primitive::Cube:
+        return "cube";
+    case Primitive::Sphere:
+        return "sphere";
+    case Primitive::Cylinder:
+        return "cylinder";
+    case Primitive::Cone:
+        return "cone";
+    case Primitive::Capsule:
+        return "capsule";
+    }
+    return "";
+}
+
+MeshData create_cylinder() {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    const LatheRow side[] = { { 0.5f, 0.5f, 1.0f, 0.0f, 0.0f }, { 0.5f, -0.5f, 1.0f, 0.0f, 0.0f } };
+    add_lathe(vertices, indices, side, 2);
+    add_cap(vertices, indices, 0.5f, 0.5f, 1.0f);
+    add_cap(vertices, indices, 0.5f, -0.5f, -1.0f);
+    return make_mesh(std::move(vertices), indices);
+}
+
+MeshData create_cone() {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    // The slant rises 1 over a radius of 0.5, so its normal leans out 1 for every 0.5 up
+    const LatheRow side[] = { { 0.0f, 0.5f, 1.0f, 0.5f, -0.5f }, { 0.5f, -0.5f, 1.0f, 0.5f, 0.0f } };
+    add_lathe(vertices, indices, side, 2);
+    add_cap(vertices, indices, 0.5f, -0.5f, -1.0f);
+    return make_mesh(std::move(vertices), indices);
+}
+
+MeshData create_capsule() {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    // The equator is repeated, once per hemisphere, and the band between the copies is the cylinder
+    constexpr float radius = 0.25f;
+    LatheRow rows[CAPSULE_RINGS + 2];
+    for (uint32_t row = 0; row < CAPSULE_RINGS + 2; ++row) {
+        const bool upper = row <= CAPSULE_RINGS / 2;
+        const uint32_t ring = upper ? row : row - 1;
+        const float polar = (float)M_PI * ring / CAPSULE_RINGS;
+        const float s = ring % CAPSULE_RINGS == 0 ? 0.0f : sinf(polar);
+        const float c = cosf(polar);
+        rows[row] = { radius * s, (upper ? 0.5f - radius : radius - 0.5f) + radius * c, s, c, 0.0f };
+    }
+    add_lathe(vertices, indices, rows, CAPSULE_RINGS + 2);
+    return make_mesh(std::move(vertices), indices);
+}
+
+PrimitiveLibrary build_primitive_library() {
+    MeshData (*const builders[PRIMITIVE_COUNT])() = { create_cube, create_sphere, create_cylinder, create_cone,
+                                                      create_capsule };
+    MeshData parts[PRIMITIVE_COUNT];
+    size_t largest = 0;
+    for (uint32_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        parts[i] = builders[i]();
+        optimize_vertex_cache(parts[i].indices, parts[i].vertices.size());
+        largest = std::max(largest, parts[i].vertices.size());
+    }
+
+    PrimitiveLibrary library;
+    const uint32_t alignment = 4 / (uint32_t)index_stride(index_format_for(largest));
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    for (uint32_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        PrimitiveRange& range = library.ranges[i];
+        range.baseVertex = vertexCount;
+        range.firstIndex = indexCount;
+        range.indexCount = (uint32_t)parts[i].indices.size();
+        range.bounds = parts[i].bounds;
+        vertexCount += (uint32_t)parts[i].vertices.size();
+        indexCount = (indexCount + range.indexCount + alignment - 1) / alignment * alignment;
+    }
+
+    // Padding between the ranges is left as zeros and never drawn
+    MeshData& mesh = library.mesh;
+    mesh.vertices.reserve(vertexCount);
+    mesh.indices.resize(indexCount, largest);
+    for (uint32_t i = 0; i < PRIMITIVE_COUNT; ++i) {
+        const PrimitiveRange& range = library.ranges[i];
+        mesh.vertices.insert(mesh.vertices.end(), parts[i].vertices.begin(), parts[i].vertices.end());
+        for (uint32_t j = 0; j < range.indexCount; ++j) {
+            if (mesh.indices.format == IndexFormat::UInt16) {
+                mesh.indices.indices16[range.firstIndex + j] = (uint16_t)parts[i].indices[j];
+            } else {
+                mesh.indices.indices32[range.firstIndex + j] = parts[i].indices[j];
+            }
+        }
+    }
+    mesh.bounds = compute_bounds(mesh.vertices.data(), mesh.vertices.size());
+    return library;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file primitives.hpp
+ * @brief Cube, sphere, cylinder, cone and capsule meshes of unit extent, built together into one library.
+ *
+ * The library concatenates the primitives' vertices into one array and their indices into
+ * another, each primitive's indices counting from its own first vertex, so the GPU keeps one
+ * vertex and one index buffer for all of them and every draw of a primitive binds the same
+ * buffers, selecting its primitive with a base vertex and an index offset (see
+ * mesh_registry_add_primitives()).
+ */
+
+#pragma once
+
+#include "objects.hpp"
+
+/**
+ * @enum Primitive
+ * @brief The primitives of the library, in the order of their ranges.
+ */
+enum class Primitive : uint32_t {
+    Cube,       ///< The unit cube of cube.hpp.
+    Sphere,     ///< The sphere of sphere.hpp, radius 0.5.
+    Cylinder,   ///< Radius 0.5, height 1, capped.
+    Cone,       ///< Base radius 0.5 at y = -0.5, apex at y = 0.5, capped.
+    Capsule,    ///< Radius 0.25, height 1 from pole to pole.
+};
+
+/// Number of primitives in the library.
+constexpr uint32_t PRIMITIVE_COUNT = 5;
+
+/// Longitude segments of the cylinder, cone and capsule.
+constexpr uint32_t PRIMITIVE_SEGMENTS = 24;
+
+/// Latitude rings of the capsule's two hemispheres together.
+constexpr uint32_t CAPSULE_RINGS = 12;
+
+/// @return The name a primitive is registered under, e.g. "cube".
+const char* primitive_name(Primitive primitive);
+
+/// @return A capped cylinder around the y axis with flat caps and smooth sides.
+MeshData create_cylinder();
+
+/// @return A capped cone around the y axis with its apex at the top.
+MeshData create_cone();
+
+/// @return A capsule around the y axis: a cylinder between two hemispheres.
+MeshData create_capsule();
+
+/**
+ * @struct PrimitiveRange
+ * @brief Where one primitive lies in the library's arrays.
+ */
+struct PrimitiveRange {
+    uint32_t baseVertex = 0;    ///< First vertex of the primitive; added to each of its indices.
+    uint32_t firstIndex = 0;    ///< First index of the primitive.
+    uint32_t indexCount = 0;    ///< Indices of the primitive.
+    BoundingBox bounds;         ///< Model space bounds of the primitive.
+};
+
+/**
+ * @struct PrimitiveLibrary
+ * @brief Every primitive in one vertex array and one index array.
+ */
+struct PrimitiveLibrary {
+    MeshData mesh;                              ///< The arrays; bounds cover every primitive.
+    PrimitiveRange ranges[PRIMITIVE_COUNT];     ///< One range per Primitive, in enum order.
+};
+
+/**
+ * @brief Builds every primitive and concatenates them.
+ *
+ * Each primitive's indices are reordered with optimize_vertex_cache() first. The index format
+ * only needs to address the largest primitive, and every range starts on a four byte boundary
+ * so its index offset is valid for Metal.
+ *
+ * @return The library.
+ */
+PrimitiveLibrary build_primitive_library();
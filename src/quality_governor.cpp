@@ -0,0 +1,64 @@
+#include "quality_governor.hpp"
+
+#include <algorithm>
+
+namespace {
+    void change_tier(QualityGovernor& governor, uint32_t tier) {
+        governor.tier = tier;
+        governor.smoothedMs = -1.0f;
+        governor.slowFrames = 0;
+        governor.fastFrames = 0;
+        governor.changes++;
+    }
+}
+
+uint32_t quality_governor_floor(PowerState power) {
+    const uint32_t thermal = (uint32_t)power.thermal;
+    return std::min(std::max(thermal, power.lowPower ? 1u : 0u), QUALITY_TIER_COUNT - 1);
+}
+
+bool quality_governor_update(QualityGovernor& governor, const QualityGovernorSettings& settings, PowerState power,
+                             float gpuMs) {
+    governor.power = power;
+    governor.tierFrames[governor.tier]++;
+
+    // Heat is not waited out: the floor applies at once
+    const uint32_t floor = quality_governor_floor(power);
+    if (governor.tier < floor) {
+        change_tier(governor, floor);
+        return true;
+    }
+    if (gpuMs < 0.0f) {
+        return false;
+    }
+
+    if (governor.smoothedMs < 0.0f) {
+        governor.smoothedMs = gpuMs;
+    } else {
+        governor.smoothedMs += (gpuMs - governor.smoothedMs) * settings.smoothing;
+    }
+    const bool slow = governor.smoothedMs > settings.targetMs * settings.overBudget;
+    const bool fast = governor.smoothedMs < settings.targetMs * settings.underBudget;
+    governor.slowFrames = slow ? governor.slowFrames + 1 : 0;
+    governor.fastFrames = fast ? governor.fastFrames + 1 : 0;
+
+    if (governor.slowFrames >= settings.downFrames && governor.tier + 1 < QUALITY_TIER_COUNT) {
+        change_tier(governor, governor.tier + 1);
+        return true;
+    }
+    if (governor.fastFrames >= settings.upFrames && governor.tier > floor) {
+        change_tier(governor, governor.tier - 1);
+        return true;
+    }
+    return false;
+}
+
+const char* thermal_state_name(ThermalState state) {
+    switch (state) {
+        case ThermalState::Nominal: return "nominal";
+        case ThermalState::Fair: return "fair";
+        case ThermalState::Serious: return "serious";
+        case ThermalState::Critical: return "critical";
+    }
+    return "unknown";
+}
@@ -0,0 +1,108 @@
+/**
+ * @file quality_governor.hpp
+ * @brief Steps the rendering quality down and back up with the thermal state, low power mode and GPU time.
+ *
+ * Under sustained load a laptop throttles its GPU, and the frame rate drops well after the
+ * load started and by an amount the render scale controller alone cannot absorb. The
+ * governor picks one of QUALITY_TIER_COUNT tiers, each capping the render scale, the shadow
+ * cascades, the view distance and biasing the terrain LODs coarser, tier 0 being full quality.
+ *
+ * The thermal state and low power mode set a floor: a hotter state moves to its tier at
+ * once. GPU time moves the tier too, with hysteresis: it steps down one tier after
+ * downFrames frames in a row over budget and back up one after upFrames frames in a row well
+ * under it, never above the floor. Counting starts over after every change, since the frames
+ * in flight were still rendered at the old tier.
+ */
+
+#pragma once
+#include <cstdint>
+
+/// Quality tiers of the governor; tier 0 is full quality.
+constexpr uint32_t QUALITY_TIER_COUNT = 4;
+
+/**
+ * @enum ThermalState
+ * @brief The system's thermal pressure; matches NSProcessInfoThermalState.
+ */
+enum class ThermalState {
+    Nominal,    ///< No throttling.
+    Fair,       ///< Slightly elevated; fans may be running.
+    Serious,    ///< High; the system is throttling.
+    Critical,   ///< Very high; the system throttles hard and work should be cut.
+};
+
+/**
+ * @struct PowerState
+ * @brief What the system reports about heat and power.
+ */
+struct PowerState {
+    ThermalState thermal = ThermalState::Nominal;   ///< The thermal state.
+    bool lowPower = false;                          ///< Low power mode is on.
+};
+
+/**
+ * @struct QualityTier
+ * @brief The limits of one tier.
+ */
+struct QualityTier {
+    float maxRenderScale = 1.0f;    ///< Cap of the dynamic resolution's scale per axis.
+    uint32_t shadowCascades = 4;    ///< Cascades of the shadow map, at most as many as it was created with.
+    float viewDistance = 1.0f;      ///< Share of the streamed distance the far fade ends at.
+    float lodBias = 1.0f;           ///< Multiplies the screen-space error allowed when picking terrain LODs.
+};
+
+/**
+ * @struct QualityGovernorSettings
+ * @brief The tiers, the budget and the hysteresis.
+ */
+struct QualityGovernorSettings {
+    QualityTier tiers[QUALITY_TIER_COUNT] = {
+        { 1.0f, 4, 1.0f, 1.0f },
+        { 0.875f, 3, 0.85f, 1.5f },
+        { 0.75f, 2, 0.7f, 2.0f },
+        { 0.5f, 1, 0.5f, 3.0f },
+    };
+    float targetMs = 1000.0f / 120.0f;  ///< GPU budget per frame.
+    float overBudget = 1.1f;            ///< Fraction of the budget above which a frame counts as slow.
+    float underBudget = 0.75f;          ///< Fraction of the budget below which a frame counts as fast.
+    float smoothing = 0.1f;             ///< Weight of a new GPU time in the moving average.
+    uint32_t downFrames = 60;           ///< Slow frames in a row before stepping down a tier.
+    uint32_t upFrames = 300;            ///< Fast frames in a row before stepping up a tier.
+};
+
+/**
+ * @struct QualityGovernor
+ * @brief State of the governor.
+ */
+struct QualityGovernor {
+    uint32_t tier = 0;                  ///< Current tier.
+    float smoothedMs = -1.0f;           ///< Moving average of GPU time at this tier, negative when reset.
+    uint32_t slowFrames = 0;            ///< Slow frames in a row at this tier.
+    uint32_t fastFrames = 0;            ///< Fast frames in a row at this tier.
+    PowerState power;                   ///< The power state of the last update.
+    uint32_t changes = 0;               ///< Tier changes so far.
+    uint64_t tierFrames[QUALITY_TIER_COUNT] = {}; ///< Updates spent at each tier.
+};
+
+/// @return The lowest tier a power state allows: one per thermal step above nominal, and at least 1 in low power mode.
+uint32_t quality_governor_floor(PowerState power);
+
+/**
+ * @brief Feeds one frame to the governor.
+ * @param governor The governor to update.
+ * @param settings The tiers, the budget and the hysteresis.
+ * @param power The current power state.
+ * @param gpuMs The GPU time of a finished frame; negative if none finished, which only applies the floor.
+ * @return True if governor.tier changed.
+ */
+bool quality_governor_update(QualityGovernor& governor, const QualityGovernorSettings& settings, PowerState power,
+                             float gpuMs);
+
+/// @return The limits of the governor's current tier.
+inline const QualityTier& quality_governor_tier(const QualityGovernor& governor,
+                                                const QualityGovernorSettings& settings) {
+    return settings.tiers[governor.tier];
+}
+
+/// @return A short lowercase name of a thermal state.
+const char* thermal_state_name(ThermalState state);
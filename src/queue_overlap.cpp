@@ -0,0 +1,96 @@
+#include "queue_overlap.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Drops what lies outside [start, end] and trims what straddles it
+    void clip_intervals(std::vector<GpuInterval>& intervals, double start, double end) {
+        size_t kept = 0;
+        for (const GpuInterval& interval : intervals) {
+            const GpuInterval clipped = { std::max(interval.start, start), std::min(interval.end, end) };
+            if (clipped.end > clipped.start) {
+                intervals[kept++] = clipped;
+            }
+        }
+        intervals.resize(kept);
+    }
+}
+
+void queue_overlap_record(QueueOverlap& overlap, GpuQueue queue, double start, double end) {
+    std::lock_guard<std::mutex> lock(overlap.mutex);
+    std::vector<GpuInterval>& ring = overlap.intervals[queue];
+    if (ring.size() < QUEUE_OVERLAP_HISTORY) {
+        ring.push_back({ start, end });
+        return;
+    }
+    ring[overlap.heads[queue]] = { start, end };
+    overlap.heads[queue] = (overlap.heads[queue] + 1) % QUEUE_OVERLAP_HISTORY;
+}
+
+QueueOverlapSummary queue_overlap_summary(const QueueOverlap& overlap) {
+    std::vector<GpuInterval> render;
+    std::vector<GpuInterval> compute;
+    {
+        std::lock_guard<std::mutex> lock(overlap.mutex);
+        render = overlap.intervals[GPU_QUEUE_RENDER];
+        compute = overlap.intervals[GPU_QUEUE_COMPUTE];
+    }
+    QueueOverlapSummary summary;
+    if (render.empty() || compute.empty()) {
+        return summary;
+    }
+    merge_intervals(render);
+    merge_intervals(compute);
+    // One ring may reach further back than the other; only the span both cover is comparable
+    const double start = std::max(render.front().start, compute.front().start);
+    const double end = std::min(render.back().end, compute.back().end);
+    clip_intervals(render, start, end);
+    clip_intervals(compute, start, end);
+    for (const GpuInterval& interval : render) {
+        summary.renderMs += (interval.end - interval.start) * 1000.0;
+    }
+    for (const GpuInterval& interval : compute) {
+        summary.computeMs += (interval.end - interval.start) * 1000.0;
+    }
+    summary.overlappedMs = interval_overlap(compute, render) * 1000.0;
+    return summary;
+}
+
+double merge_intervals(std::vector<GpuInterval>& intervals) {
+    std::sort(intervals.begin(), intervals.end(),
+              [](const GpuInterval& a, const GpuInterval& b) { return a.start < b.start; });
+    size_t merged = 0;
+    double covered = 0.0;
+    for (const GpuInterval& interval : intervals) {
+        if (merged > 0 && interval.start <= intervals[merged - 1].end) {
+            intervals[merged - 1].end = std::max(intervals[merged - 1].end, interval.end);
+        } else {
+            intervals[merged++] = interval;
+        }
+    }
+    intervals.resize(merged);
+    for (const GpuInterval& interval : intervals) {
+        covered += interval.end - interval.start;
+    }
+    return covered;
+}
+
+double interval_overlap(const std::vector<GpuInterval>& a, const std::vector<GpuInterval>& b) {
+    double shared = 0.0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size()) {
+        const double start = std::max(a[i].start, b[j].start);
+        const double end = std::min(a[i].end, b[j].end);
+        if (end > start) {
+            shared += end - start;
+        }
+        // Whichever ends first cannot meet anything later in the other list
+        if (a[i].end < b[j].end) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return shared;
+}
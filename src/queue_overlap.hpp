@@ -0,0 +1,80 @@
+/**
+ * @file queue_overlap.hpp
+ * @brief How much of the compute queue's GPU time ran alongside the render queue's.
+ *
+ * Completion handlers record when each command buffer started and ended on the GPU; the
+ * summary merges the recent intervals of each queue and measures the compute time that
+ * falls inside render time. A high share means the async compute passes really did fill
+ * gaps next to rasterisation; a low one means the queues took turns, e.g. because the
+ * render queue waited on the compute queue's event. The same command buffers appear on
+ * their own queue tracks, labelled, in an Instruments Metal System Trace.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// Command buffers kept per queue.
+constexpr size_t QUEUE_OVERLAP_HISTORY = 256;
+
+/**
+ * @enum GpuQueue
+ * @brief The queues whose command buffers are recorded.
+ */
+enum GpuQueue {
+    GPU_QUEUE_RENDER,
+    GPU_QUEUE_COMPUTE,
+    GPU_QUEUE_COUNT
+};
+
+/**
+ * @struct GpuInterval
+ * @brief When a command buffer ran, in seconds on the GPU's clock.
+ */
+struct GpuInterval {
+    double start = 0.0; ///< MTLCommandBuffer GPUStartTime.
+    double end = 0.0;   ///< MTLCommandBuffer GPUEndTime.
+};
+
+/**
+ * @struct QueueOverlap
+ * @brief The latest command buffers of each queue, as rings.
+ */
+struct QueueOverlap {
+    std::vector<GpuInterval> intervals[GPU_QUEUE_COUNT];   ///< Up to QUEUE_OVERLAP_HISTORY per queue.
+    size_t heads[GPU_QUEUE_COUNT] = {};                     ///< Next slot of each ring to overwrite.
+    mutable std::mutex mutex;                               ///< Completion handlers record from other threads.
+};
+
+/**
+ * @struct QueueOverlapSummary
+ * @brief The compute queue's time over the recorded window.
+ */
+struct QueueOverlapSummary {
+    double computeMs = 0.0;     ///< Milliseconds the compute queue was busy.
+    double overlappedMs = 0.0;  ///< Of those, milliseconds the render queue was busy too.
+    double renderMs = 0.0;      ///< Milliseconds the render queue was busy.
+};
+
+/// Records a command buffer that completed on a queue; safe from any thread.
+void queue_overlap_record(QueueOverlap& overlap, GpuQueue queue, double start, double end);
+
+/// @return The overlap of the recorded command buffers, clipped to the span both queues were recorded over.
+QueueOverlapSummary queue_overlap_summary(const QueueOverlap& overlap);
+
+/**
+ * @brief Merges intervals into their sorted, disjoint union, in place.
+ * @param intervals The intervals, in any order and possibly overlapping each other.
+ * @return Seconds the union covers.
+ */
+double merge_intervals(std::vector<GpuInterval>& intervals);
+
+/**
+ * @brief Measures the time two merged sets of intervals share.
+ * @param a Sorted, disjoint intervals, e.g. from merge_intervals().
+ * @param b Sorted, disjoint intervals.
+ * @return Seconds covered by both.
+ */
+double interval_overlap(const std::vector<GpuInterval>& a, const std::vector<GpuInterval>& b);
@@ -0,0 +1,58 @@
+#include "range_allocator.hpp"
+
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) : m_capacity(capacity) {
+    if (capacity > 0) {
+        m_free.emplace(0, capacity);
+    }
+}
+
+uint32_t RangeAllocator::allocate(uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+        const uint32_t offset = it->first;
+        const uint32_t rest = it->second - count;
+        m_free.erase(it);
+        if (rest > 0) {
+            m_free.emplace(offset + count, rest);
+        }
+        m_used += count;
+        return offset;
+    }
+    return NO_RANGE;
+}
+
+void RangeAllocator::release(uint32_t offset, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    m_used -= count;
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            count += previous->second;
+            m_free.erase(previous);
+        }
+    }
+    if (next != m_free.end() && offset + count == next->first) {
+        count += next->second;
+        m_free.erase(next);
+    }
+    m_free.emplace(offset, count);
+}
+
+uint32_t RangeAllocator::largest_free() const {
+    uint32_t largest = 0;
+    for (const auto& range : m_free) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file range_allocator.hpp
+ * @brief First-fit allocation of variable-length ranges from a fixed span, for sub-allocating GPU buffers.
+ *
+ * Meshes differ in size, so unlike the equal slots of slot_allocator.hpp their ranges can
+ * leave holes. The free ranges are kept sorted by offset: allocation takes the lowest one
+ * that is long enough, which packs live ranges towards the start, and a release merges the
+ * range with free neighbours so holes grow back into usable space.
+ */
+
+#pragma once
+#include <cstdint>
+#include <map>
+
+/// An offset that names no range.
+constexpr uint32_t NO_RANGE = UINT32_MAX;
+
+/**
+ * @class RangeAllocator
+ * @brief Free-list of ranges in [0, capacity), in whatever unit the caller counts.
+ */
+class RangeAllocator {
+public:
+    /// @param capacity Length of the span; all of it starts free.
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    /**
+     * @brief Takes the lowest free range of at least count units.
+     * @param count Length of the range; 0 takes nothing and returns 0.
+     * @return The range's offset, or NO_RANGE if no free range is long enough.
+     */
+    uint32_t allocate(uint32_t count);
+
+    /// @brief Frees a range returned by allocate() with the same count.
+    void release(uint32_t offset, uint32_t count);
+
+    /// @return Length of the span.
+    uint32_t capacity() const { return m_capacity; }
+
+    /// @return Units allocated and not released.
+    uint32_t used() const { return m_used; }
+
+    /// @return Length of the longest free range; the largest allocation that can succeed.
+    uint32_t largest_free() const;
+
+    /// @return Number of separate free ranges; more than one means the span is fragmented.
+    uint32_t free_ranges() const { return (uint32_t)m_free.size(); }
+
+private:
+    uint32_t m_capacity;
+    uint32_t m_used = 0;
+    std::map<uint32_t, uint32_t> m_free;    ///< Offset to length of each free range; never adjacent.
+};
@@ -0,0 +1,42 @@
+#include "rasterization_rate.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Rate at a distance from the middle, 0 there and 1 at the edge
+    float falloff(float distance, float fovea, float edgeRate) {
+        const float start = std::clamp(fovea, 0.0f, 1.0f);
+        if (distance <= start || start >= 1.0f) {
+            return 1.0f;
+        }
+        const float t = (distance - start) / (1.0f - start);
+        return 1.0f + (edgeRate - 1.0f) * t;
+    }
+}
+
+void rasterization_rate_profile(const RasterizationRateSettings& settings, float* horizontal, float* vertical) {
+    const float edgeRate = std::clamp(settings.edgeRate, 0.01f, 1.0f);
+    const float skyRate = std::clamp(settings.skyRate, 0.01f, 1.0f);
+    for (uint32_t i = 0; i < RATE_MAP_ZONES; ++i) {
+        // Zone centres, so both edge zones are equally far from the middle
+        const float t = ((float)i + 0.5f) / (float)RATE_MAP_ZONES;
+        const float distance = std::abs(2.0f * t - 1.0f);
+        horizontal[i] = falloff(distance, settings.fovea, edgeRate);
+
+        float rate = falloff(distance, settings.fovea, edgeRate);
+        if (settings.skyBand > 0.0f && t < settings.skyBand) {
+            rate = std::min(rate, skyRate + (1.0f - skyRate) * t / settings.skyBand);
+        }
+        vertical[i] = rate;
+    }
+}
+
+float rasterization_rate_shaded_fraction(const float* horizontal, const float* vertical) {
+    float width = 0.0f;
+    float height = 0.0f;
+    for (uint32_t i = 0; i < RATE_MAP_ZONES; ++i) {
+        width += horizontal[i];
+        height += vertical[i];
+    }
+    return width * height / (float)(RATE_MAP_ZONES * RATE_MAP_ZONES);
+}
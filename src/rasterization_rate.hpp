@@ -0,0 +1,51 @@
+/**
+ * @file rasterization_rate.hpp
+ * @brief The shading-rate profile of the scene pass: full rate in the middle, less at the edges and the sky.
+ *
+ * A Metal rasterization rate map splits the screen into zones along each axis and shades each
+ * zone at a fraction of its pixels, its rate on that axis; the scene is rasterized into a
+ * smaller physical target and stretched back to the screen afterwards. The eye rests near the
+ * middle of the frame, and the top of a terrain view is mostly sky and far, fogged terrain, so
+ * RasterizationRateSettings keeps a central region at full rate and lowers the rate towards the
+ * left, right and bottom edges to edgeRate and across the top band to skyRate.
+ *
+ * rasterization_rate_profile() gives the per-zone rates GpuRasterizationRate builds its map
+ * from, and rasterization_rate_shaded_fraction() the share of the screen's pixels they shade.
+ */
+
+#pragma once
+#include <cstdint>
+
+/// Zones of the rate map along each axis.
+constexpr uint32_t RATE_MAP_ZONES = 16;
+
+/**
+ * @struct RasterizationRateSettings
+ * @brief Where and how much the scene pass lowers its shading rate.
+ */
+struct RasterizationRateSettings {
+    float edgeRate = 0.5f;      ///< Rate at the left, right and bottom edges, in (0, 1].
+    float skyRate = 0.25f;      ///< Rate at the top edge, in (0, 1].
+    float fovea = 0.5f;         ///< Share of the width and height around the middle kept at full rate.
+    float skyBand = 0.3f;       ///< Share of the height, from the top, over which the rate falls to skyRate.
+};
+
+/**
+ * @brief Returns the rate of every zone along each axis.
+ *
+ * Outside the fovea the rate falls linearly to edgeRate at the edge; within the sky band it
+ * also falls linearly to skyRate at the top, and the lower of the two applies.
+ *
+ * @param settings The profile.
+ * @param horizontal Receives RATE_MAP_ZONES rates, left to right.
+ * @param vertical Receives RATE_MAP_ZONES rates, top to bottom.
+ */
+void rasterization_rate_profile(const RasterizationRateSettings& settings, float* horizontal, float* vertical);
+
+/**
+ * @brief Returns the share of the screen's pixels a profile shades.
+ * @param horizontal RATE_MAP_ZONES rates, as from rasterization_rate_profile().
+ * @param vertical RATE_MAP_ZONES rates.
+ * @return The share, in (0, 1]; the physical target is this much of the screen's area.
+ */
+float rasterization_rate_shaded_fraction(const float* horizontal, const float* vertical);
@@ -0,0 +1,112 @@
+#include "reflection_probe.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Van der Corput's radical inverse in base 2: the second Hammersley coordinate
+    float radical_inverse(uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+}
+
+ReflectionProbeStep reflection_probe_step(ReflectionProbeSchedule& schedule, const ReflectionProbeSettings& settings,
+                                          simd::float3 camera) {
+    ReflectionProbeStep step;
+    if (schedule.published) {
+        ++schedule.age;
+    }
+    if (!schedule.capturing) {
+        const bool moved = simd::distance(camera, schedule.center) > settings.recaptureDistance;
+        const bool old = settings.refreshFrames > 0 && schedule.age >= settings.refreshFrames;
+        if (schedule.published && !moved && !old) {
+            return step;
+        }
+        schedule.capturing = true;
+        schedule.nextFace = 0;
+        schedule.captureCenter = camera;
+    }
+
+    // Every face of a capture is rendered from where it began, so the faces meet at their edges
+    step.firstFace = schedule.nextFace;
+    step.faceCount = std::min(std::max(settings.facesPerFrame, 1u), CUBE_FACE_COUNT - schedule.nextFace);
+    step.eye = schedule.captureCenter;
+    schedule.nextFace += step.faceCount;
+    if (schedule.nextFace == CUBE_FACE_COUNT) {
+        step.prefilter = true;
+        schedule.capturing = false;
+        schedule.published = true;
+        schedule.center = schedule.captureCenter;
+        schedule.age = 0;
+        ++schedule.captures;
+    }
+    return step;
+}
+
+uint32_t reflection_probe_mip_count(uint32_t faceSize) {
+    uint32_t count = 1;
+    while (faceSize > REFLECTION_PROBE_MIN_MIP_SIZE) {
+        faceSize /= 2;
+        ++count;
+    }
+    return count;
+}
+
+float reflection_probe_mip_roughness(uint32_t mip, uint32_t mipCount) {
+    return mipCount > 1 ? (float)mip / (float)(mipCount - 1) : 0.0f;
+}
+
+simd::float3 reflection_probe_texel_direction(uint32_t face, float u, float v) {
+    // The major axis and the face's s and t axes, as the cube map sampler picks them
+    const float s = 2.0f * u - 1.0f;
+    const float t = 2.0f * v - 1.0f;
+    simd::float3 direction;
+    switch (face) {
+    case 0: direction = { 1.0f, -t, -s }; break;
+    case 1: direction = { -1.0f, -t, s }; break;
+    case 2: direction = { s, 1.0f, t }; break;
+    case 3: direction = { s, -1.0f, -t }; break;
+    case 4: direction = { s, -t, 1.0f }; break;
+    default: direction = { -s, -t, -1.0f }; break;
+    }
+    return simd::normalize(direction);
+}
+
+simd::float3 reflection_probe_ggx_sample(uint32_t i, uint32_t count, float roughness, simd::float3 normal,
+                                         float& halfCosine) {
+    const float alpha = roughness * roughness;
+    const float phi = 2.0f * (float)M_PI * (float)i / (float)std::max(count, 1u);
+    const float xi = radical_inverse(i);
+    halfCosine = std::sqrt((1.0f - xi) / (1.0f + (alpha * alpha - 1.0f) * xi));
+    const float halfSine = std::sqrt(std::max(1.0f - halfCosine * halfCosine, 0.0f));
+
+    // A tangent frame around the normal; any will do, the lobe is symmetric about it
+    const simd::float3 up = std::abs(normal.z) < 0.999f ? simd::float3{ 0.0f, 0.0f, 1.0f }
+                                                        : simd::float3{ 1.0f, 0.0f, 0.0f };
+    const simd::float3 tangent = simd::normalize(simd::cross(up, normal));
+    const simd::float3 bitangent = simd::cross(normal, tangent);
+    const simd::float3 half = tangent * (halfSine * std::cos(phi)) + bitangent * (halfSine * std::sin(phi)) +
+                              normal * halfCosine;
+    // The view is the normal, so the light is the normal reflected about the half vector
+    return simd::normalize(2.0f * simd::dot(normal, half) * half - normal);
+}
+
+float reflection_probe_sample_lod(float roughness, float halfCosine, uint32_t count, uint32_t faceSize) {
+    if (roughness <= 0.0f || count == 0 || faceSize == 0) {
+        return 0.0f;
+    }
+    // GGX's distribution of half vectors; with the view on the normal the light's pdf is a quarter of it
+    const float alpha2 = roughness * roughness * roughness * roughness;
+    const float denominator = halfCosine * halfCosine * (alpha2 - 1.0f) + 1.0f;
+    const float distribution = alpha2 / ((float)M_PI * denominator * denominator);
+    const float pdf = distribution / 4.0f;
+    const float sampleSolidAngle = 1.0f / ((float)count * pdf);
+    const float texelSolidAngle = 4.0f * (float)M_PI / (6.0f * (float)faceSize * (float)faceSize);
+    // One level up halves the texel edge, which quarters its solid angle; the extra level hides the sample pattern
+    return std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file reflection_probe.hpp
+ * @brief A reflection probe refreshed a cube face at a time, and the prefiltering of its mips.
+ *
+ * Rendering all six faces of a probe in one frame would add six scene views to it. The probe
+ * is instead captured a few faces per frame around the position the camera had when the
+ * capture began, through the multi-view path (see multi_view.hpp), and only once the last
+ * face is in does the capture get prefiltered into the cube that reflections sample: the
+ * published probe is always whole, and the frame cost is bounded by facesPerFrame views and
+ * one prefilter. A new capture starts when the camera has moved away from the published
+ * probe's centre or it has grown old, so a still camera costs nothing most frames.
+ *
+ * Each mip of the published cube holds the capture convolved with a GGX lobe whose roughness
+ * grows linearly with the mip, so a surface picks the mip of its roughness. The lobe is
+ * importance sampled with a Hammersley sequence, and each sample reads the capture at the
+ * mip whose texels cover the sample's share of the lobe's solid angle, which keeps few
+ * samples free of fireflies. reflection_probe_ggx_sample() and reflection_probe_sample_lod()
+ * are the CPU reference of the prefilter kernel.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "multi_view.hpp"
+
+/// Edge of the smallest prefiltered mip; below it the roughest lobe gains nothing.
+constexpr uint32_t REFLECTION_PROBE_MIN_MIP_SIZE = 4;
+
+/**
+ * @struct ReflectionProbeSettings
+ * @brief Resolution, time slicing and refresh of a reflection probe.
+ */
+struct ReflectionProbeSettings {
+    uint32_t faceSize = 128;            ///< Pixels along each face edge; a power of two.
+    uint32_t facesPerFrame = 1;         ///< Faces captured per frame, in one multi-view pass.
+    float recaptureDistance = 4.0f;     ///< Camera distance from the published centre that starts a new capture.
+    uint32_t refreshFrames = 120;       ///< Frames after which a still camera's probe is captured again; 0 never.
+    uint32_t sampleCount = 32;          ///< Lobe samples per prefiltered texel.
+};
+
+/**
+ * @struct ReflectionProbeSchedule
+ * @brief Where the capture is, and what the published probe shows.
+ */
+struct ReflectionProbeSchedule {
+    bool capturing = false;             ///< True between the first and the last face of a capture.
+    uint32_t nextFace = 0;              ///< Next face of the capture to render.
+    simd::float3 captureCenter = {};    ///< Eye of the capture in progress.
+    bool published = false;             ///< True once a whole capture has been prefiltered.
+    simd::float3 center = {};           ///< Eye of the published probe.
+    uint32_t age = 0;                   ///< Frames since the probe was published.
+    uint32_t captures = 0;              ///< Captures published so far.
+};
+
+/**
+ * @struct ReflectionProbeStep
+ * @brief What one frame renders and filters.
+ */
+struct ReflectionProbeStep {
+    uint32_t firstFace = 0;             ///< First face to render.
+    uint32_t faceCount = 0;             ///< Faces to render, consecutive; 0 renders none.
+    simd::float3 eye = {};              ///< Where the faces are rendered from.
+    bool prefilter = false;             ///< The capture is whole after these faces: prefilter and publish it.
+};
+
+/**
+ * @brief Advances the schedule by a frame.
+ * @param schedule The schedule.
+ * @param settings The probe's settings.
+ * @param camera The camera position this frame.
+ * @return The faces to render this frame, if any, and whether to prefilter after them.
+ */
+ReflectionProbeStep reflection_probe_step(ReflectionProbeSchedule& schedule, const ReflectionProbeSettings& settings,
+                                          simd::float3 camera);
+
+/// @return Mips of the prefiltered cube of faceSize pixels, down to REFLECTION_PROBE_MIN_MIP_SIZE.
+uint32_t reflection_probe_mip_count(uint32_t faceSize);
+
+/// @return The GGX roughness prefiltered into a mip: 0 for mip 0, 1 for the last.
+float reflection_probe_mip_roughness(uint32_t mip, uint32_t mipCount);
+
+/**
+ * @brief Direction through a cube texel, in Metal's face order and orientation.
+ * @param face The face, 0 to 5: +X, -X, +Y, -Y, +Z, -Z.
+ * @param u Across the face, 0 to 1 from the left edge.
+ * @param v Down the face, 0 to 1 from the top edge.
+ * @return The unit direction.
+ */
+simd::float3 reflection_probe_texel_direction(uint32_t face, float u, float v);
+
+/**
+ * @brief The i-th of count light directions importance sampled from the GGX lobe around a normal.
+ *
+ * The view direction is taken to be the normal, as in the split-sum approximation, so the
+ * lobe is centred on the normal and its half vectors follow the GGX distribution.
+ *
+ * @param i The sample.
+ * @param count Samples in the sequence.
+ * @param roughness The GGX roughness; the distribution's alpha is its square.
+ * @param normal The unit normal, which is also the view and reflection direction.
+ * @param halfCosine Receives the cosine between the normal and the sample's half vector.
+ * @return The unit light direction; below the surface where the lobe reaches past it.
+ */
+simd::float3 reflection_probe_ggx_sample(uint32_t i, uint32_t count, float roughness, simd::float3 normal,
+                                         float& halfCosine);
+
+/**
+ * @brief The capture mip a lobe sample reads, so its texels cover the sample's solid angle.
+ * @param roughness The GGX roughness.
+ * @param halfCosine Cosine between the normal and the sample's half vector.
+ * @param count Samples taken per texel.
+ * @param faceSize Pixels along each face edge of the capture's mip 0.
+ * @return The mip level, 0 or more.
+ */
+float reflection_probe_sample_lod(float roughness, float halfCosine, uint32_t count, uint32_t faceSize);
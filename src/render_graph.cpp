@@ -0,0 +1,237 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+
+namespace {
+    uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Waits for a step unless it is the one waiting or already waited for
+    void add_wait(RenderGraphPlan& plan, RenderGraphStep& step, uint32_t stepIndex, uint32_t waitedFor, bool event) {
+        if (waitedFor == RENDER_GRAPH_NONE || waitedFor == stepIndex) {
+            return;
+        }
+        for (uint32_t i = step.firstWait; i < step.firstWait + step.waitCount; ++i) {
+            if (plan.waits[i].step == waitedFor) {
+                return;
+            }
+        }
+        RenderGraphWait wait;
+        wait.step = waitedFor;
+        wait.event = event;
+        plan.waits.push_back(wait);
+        ++step.waitCount;
+        if (event) {
+            plan.steps[waitedFor].signalEvent = true;
+        } else {
+            plan.steps[waitedFor].updateFence = true;
+        }
+    }
+
+    bool step_reads(const RenderGraph& graph, const RenderGraphStep& step, uint32_t resource) {
+        const RenderGraphPass& pass = graph.passes[step.pass];
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            if (graph.accesses[a].resource == resource && !graph.accesses[a].write) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Waits for what a resource's current contents depend on: its last write and, if asked, every read
+    // since. Each of those reads waited for the write, so when there are any the write needs no wait.
+    void wait_for_users(const RenderGraph& graph, RenderGraphPlan& plan, uint32_t stepIndex, uint32_t resource,
+                        bool readers) {
+        RenderGraphStep& step = plan.steps[stepIndex];
+        const uint32_t queue = graph.passes[step.pass].queue;
+        const bool tracked = graph.resources[resource].imported;
+        auto wait_for = [&](uint32_t user) {
+            const bool event = graph.passes[plan.steps[user].pass].queue != queue;
+            if (event || !tracked) {
+                add_wait(plan, step, stepIndex, user, event);
+            }
+        };
+        const uint32_t writer = plan.lastWriters[resource];
+        bool read = false;
+        if (readers) {
+            for (uint32_t user = writer == RENDER_GRAPH_NONE ? 0 : writer + 1; user < stepIndex; ++user) {
+                if (step_reads(graph, plan.steps[user], resource)) {
+                    wait_for(user);
+                    read = true;
+                }
+            }
+        }
+        if (writer != RENDER_GRAPH_NONE && !read) {
+            wait_for(writer);
+        }
+    }
+}
+
+void render_graph_reset(RenderGraph& graph) {
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.accesses.clear();
+}
+
+uint32_t render_graph_transient(RenderGraph& graph, const char* name, uint64_t size, uint64_t alignment) {
+    RenderGraphResource resource;
+    resource.name = name;
+    resource.size = size;
+    resource.alignment = std::max<uint64_t>(alignment, 1);
+    graph.resources.push_back(resource);
+    return (uint32_t)graph.resources.size() - 1;
+}
+
+uint32_t render_graph_import(RenderGraph& graph, const char* name) {
+    RenderGraphResource resource;
+    resource.name = name;
+    resource.imported = true;
+    graph.resources.push_back(resource);
+    return (uint32_t)graph.resources.size() - 1;
+}
+
+uint32_t render_graph_add_pass(RenderGraph& graph, const char* name, RenderGraphPassType type, uint32_t queue,
+                               bool sideEffects) {
+    RenderGraphPass pass;
+    pass.name = name;
+    pass.type = type;
+    pass.queue = queue;
+    pass.sideEffects = sideEffects;
+    pass.firstAccess = (uint32_t)graph.accesses.size();
+    graph.passes.push_back(pass);
+    return (uint32_t)graph.passes.size() - 1;
+}
+
+void render_graph_read(RenderGraph& graph, uint32_t resource) {
+    graph.accesses.push_back({ resource, false });
+    graph.passes.back().accessCount++;
+}
+
+void render_graph_write(RenderGraph& graph, uint32_t resource) {
+    graph.accesses.push_back({ resource, true });
+    graph.passes.back().accessCount++;
+}
+
+void compile_render_graph(const RenderGraph& graph, RenderGraphPlan& plan) {
+    const uint32_t resourceCount = (uint32_t)graph.resources.size();
+    const uint32_t passCount = (uint32_t)graph.passes.size();
+    plan.steps.clear();
+    plan.waits.clear();
+    plan.lifetimes.assign(resourceCount, RenderGraphLifetime());
+    plan.passSteps.assign(passCount, RENDER_GRAPH_NONE);
+    plan.heapSize = 0;
+    plan.transientBytes = 0;
+
+    // Culling: walking back, a pass is kept if it has side effects or writes what a kept pass reads later.
+    // Whatever an imported resource holds at the end is wanted, so its last write is always kept.
+    plan.wanted.resize(resourceCount);
+    for (uint32_t r = 0; r < resourceCount; ++r) {
+        plan.wanted[r] = graph.resources[r].imported;
+    }
+    for (uint32_t p = passCount; p-- > 0;) {
+        const RenderGraphPass& pass = graph.passes[p];
+        const RenderGraphAccess* accesses = graph.accesses.data() + pass.firstAccess;
+        bool keep = pass.sideEffects;
+        for (uint32_t a = 0; a < pass.accessCount && !keep; ++a) {
+            keep = accesses[a].write && plan.wanted[accesses[a].resource];
+        }
+        if (!keep) {
+            continue;
+        }
+        plan.passSteps[p] = 0;
+        for (uint32_t a = 0; a < pass.accessCount; ++a) {
+            if (accesses[a].write) {
+                plan.wanted[accesses[a].resource] = false;
+            }
+        }
+        for (uint32_t a = 0; a < pass.accessCount; ++a) {
+            if (!accesses[a].write) {
+                plan.wanted[accesses[a].resource] = true;
+            }
+        }
+    }
+
+    // The kept passes run in declaration order; each resource lives from its first to its last use
+    for (uint32_t p = 0; p < passCount; ++p) {
+        if (plan.passSteps[p] == RENDER_GRAPH_NONE) {
+            continue;
+        }
+        const uint32_t stepIndex = (uint32_t)plan.steps.size();
+        plan.passSteps[p] = stepIndex;
+        RenderGraphStep step;
+        step.pass = p;
+        plan.steps.push_back(step);
+        const RenderGraphPass& pass = graph.passes[p];
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            RenderGraphLifetime& lifetime = plan.lifetimes[graph.accesses[a].resource];
+            if (lifetime.first == RENDER_GRAPH_NONE) {
+                lifetime.first = stepIndex;
+            }
+            lifetime.last = stepIndex;
+        }
+    }
+
+    // Aliasing: in order of first use, each transient takes the lowest aligned gap between the
+    // transients already placed whose lifetimes overlap its own
+    plan.placed.clear();
+    for (uint32_t s = 0; s < (uint32_t)plan.steps.size(); ++s) {
+        const RenderGraphPass& pass = graph.passes[plan.steps[s].pass];
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            const uint32_t r = graph.accesses[a].resource;
+            const RenderGraphResource& resource = graph.resources[r];
+            RenderGraphLifetime& lifetime = plan.lifetimes[r];
+            if (resource.imported || lifetime.first != s ||
+                std::find(plan.placed.begin(), plan.placed.end(), r) != plan.placed.end()) {
+                continue;
+            }
+            plan.taken.clear();
+            for (uint32_t other : plan.placed) {
+                const RenderGraphLifetime& live = plan.lifetimes[other];
+                if (live.last >= lifetime.first && live.first <= lifetime.last) {
+                    plan.taken.push_back({ live.offset, live.offset + graph.resources[other].size });
+                }
+            }
+            std::sort(plan.taken.begin(), plan.taken.end());
+            uint64_t offset = 0;
+            for (const auto& range : plan.taken) {
+                if (align_up(offset, resource.alignment) + resource.size <= range.first) {
+                    break;
+                }
+                offset = std::max(offset, range.second);
+            }
+            lifetime.offset = align_up(offset, resource.alignment);
+            plan.heapSize = std::max(plan.heapSize, lifetime.offset + resource.size);
+            plan.transientBytes += resource.size;
+            plan.placed.push_back(r);
+        }
+    }
+
+    // Synchronisation, in step order so every resource's last writer is the one the step sees
+    plan.lastWriters.assign(resourceCount, RENDER_GRAPH_NONE);
+    for (uint32_t s = 0; s < (uint32_t)plan.steps.size(); ++s) {
+        plan.steps[s].firstWait = (uint32_t)plan.waits.size();
+        const RenderGraphPass& pass = graph.passes[plan.steps[s].pass];
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            const uint32_t r = graph.accesses[a].resource;
+            const RenderGraphLifetime& lifetime = plan.lifetimes[r];
+            // The first use of a transient waits for the last users of the memory it takes over
+            if (!graph.resources[r].imported && lifetime.first == s) {
+                const uint64_t end = lifetime.offset + graph.resources[r].size;
+                for (uint32_t other : plan.placed) {
+                    const RenderGraphLifetime& earlier = plan.lifetimes[other];
+                    if (earlier.last < s && earlier.offset < end &&
+                        lifetime.offset < earlier.offset + graph.resources[other].size) {
+                        wait_for_users(graph, plan, s, other, true);
+                    }
+                }
+            }
+            wait_for_users(graph, plan, s, r, graph.accesses[a].write);
+        }
+        for (uint32_t a = pass.firstAccess; a < pass.firstAccess + pass.accessCount; ++a) {
+            if (graph.accesses[a].write) {
+                plan.lastWriters[graph.accesses[a].resource] = s;
+            }
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/**
+ * @file render_graph.hpp
+ * @brief A frame's passes declared with the resources they read and write, compiled into an ordered
+ *        list of encoders with culling, aliased transient memory and the synchronisation between them.
+ *
+ * Each frame the passes are declared again, in the order they run, each followed by its reads and
+ * writes. A read sees the last write declared before it; a pass that loads and stores an attachment
+ * both reads and writes it. compile_render_graph() then:
+ *
+ * - culls every pass whose writes nothing kept reads, walking back from the imported resources (the
+ *   ones that outlive the frame, such as the scene colour) and the passes declared with side effects;
+ * - gives each transient resource the lifetime of the kept passes that use it, and places it in one
+ *   heap at the lowest offset not taken by a transient whose lifetime overlaps, so transients that
+ *   are never alive together share memory;
+ * - works out what each encoder waits for: the last write of everything it uses, every read since
+ *   the last write of what it writes, and the last users of the memory its transients alias.
+ *   Transients live in an untracked heap, so on the same queue that is a fence; imported resources
+ *   are hazard tracked by Metal on their queue, and a pass on another queue waits on an event.
+ *
+ * The compiler knows nothing of Metal; gpu_render_graph.hpp sizes the transients, creates the heap,
+ * fences and events, and encodes the plan. Declaring and compiling reuse the vectors' capacity, so
+ * after the first frames neither allocates.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// A resource or step index that refers to nothing, e.g. the step of a culled pass.
+constexpr uint32_t RENDER_GRAPH_NONE = UINT32_MAX;
+
+/**
+ * @enum RenderGraphPassType
+ * @brief The kind of encoder a pass is recorded into.
+ */
+enum class RenderGraphPassType : uint8_t {
+    Render,
+    Compute,
+    Blit
+};
+
+/**
+ * @struct RenderGraphResource
+ * @brief A texture or buffer passes read and write.
+ */
+struct RenderGraphResource {
+    const char* name = nullptr; ///< Debug name; must outlive the frame.
+    uint64_t size = 0;          ///< Bytes the transient takes in the heap; 0 for imported resources.
+    uint64_t alignment = 1;     ///< Alignment of its heap offset.
+    bool imported = false;      ///< Lives outside the graph: never placed in the heap, its last write is always kept.
+};
+
+/**
+ * @struct RenderGraphAccess
+ * @brief One resource a pass uses.
+ */
+struct RenderGraphAccess {
+    uint32_t resource = 0;  ///< Index into RenderGraph::resources.
+    bool write = false;     ///< True for a write, false for a read.
+};
+
+/**
+ * @struct RenderGraphPass
+ * @brief A pass as declared.
+ */
+struct RenderGraphPass {
+    const char* name = nullptr;                         ///< Debug name; must outlive the frame.
+    RenderGraphPassType type = RenderGraphPassType::Render; ///< Encoder the pass is recorded into.
+    uint32_t queue = 0;                                 ///< Queue the pass runs on.
+    bool sideEffects = false;                           ///< Kept even if nothing reads what it writes.
+    uint32_t firstAccess = 0;                           ///< First of its entries in RenderGraph::accesses.
+    uint32_t accessCount = 0;                           ///< Number of its entries in RenderGraph::accesses.
+};
+
+/**
+ * @struct RenderGraph
+ * @brief The passes and resources of one frame, in declaration order.
+ */
+struct RenderGraph {
+    std::vector<RenderGraphResource> resources; ///< Indexed by the handles the declarations return.
+    std::vector<RenderGraphPass> passes;        ///< In the order they run.
+    std::vector<RenderGraphAccess> accesses;    ///< Each pass's accesses, contiguous and in pass order.
+};
+
+/// Forgets the previous frame's declarations, keeping the capacity.
+void render_graph_reset(RenderGraph& graph);
+
+/**
+ * @brief Declares a resource that only lives within the frame.
+ * @param graph The graph.
+ * @param name The debug name.
+ * @param size The bytes it takes in the heap.
+ * @param alignment The alignment its heap offset needs; a power of two.
+ * @return Its handle.
+ */
+uint32_t render_graph_transient(RenderGraph& graph, const char* name, uint64_t size, uint64_t alignment);
+
+/// @return The handle of a resource that outlives the frame, such as a swapchain or history texture.
+uint32_t render_graph_import(RenderGraph& graph, const char* name);
+
+/**
+ * @brief Declares the next pass; the reads and writes that follow belong to it.
+ * @param graph The graph.
+ * @param name The debug name.
+ * @param type The encoder the pass is recorded into.
+ * @param queue The queue the pass runs on.
+ * @param sideEffects True if the pass must run even when nothing reads its writes, e.g. a readback.
+ * @return Its index.
+ */
+uint32_t render_graph_add_pass(RenderGraph& graph, const char* name, RenderGraphPassType type, uint32_t queue = 0,
+                               bool sideEffects = false);
+
+/// Declares that the last pass added reads a resource.
+void render_graph_read(RenderGraph& graph, uint32_t resource);
+
+/// Declares that the last pass added writes a resource.
+void render_graph_write(RenderGraph& graph, uint32_t resource);
+
+/**
+ * @struct RenderGraphWait
+ * @brief An earlier step an encoder must wait for.
+ */
+struct RenderGraphWait {
+    uint32_t step = 0;      ///< The step waited for.
+    bool event = false;     ///< True if it ran on another queue, so the wait is on an event rather than a fence.
+};
+
+/**
+ * @struct RenderGraphStep
+ * @brief One encoder of the compiled frame.
+ */
+struct RenderGraphStep {
+    uint32_t pass = 0;          ///< The pass it encodes.
+    uint32_t firstWait = 0;     ///< First of its entries in RenderGraphPlan::waits.
+    uint32_t waitCount = 0;     ///< Number of its entries in RenderGraphPlan::waits.
+    bool updateFence = false;   ///< A later step on the same queue waits for it.
+    bool signalEvent = false;   ///< A step on another queue waits for it.
+};
+
+/**
+ * @struct RenderGraphLifetime
+ * @brief Where and when a resource is alive.
+ */
+struct RenderGraphLifetime {
+    uint32_t first = RENDER_GRAPH_NONE; ///< First step using it; RENDER_GRAPH_NONE if no kept pass does.
+    uint32_t last = RENDER_GRAPH_NONE;  ///< Last step using it.
+    uint64_t offset = 0;                ///< Heap offset of a transient.
+};
+
+/**
+ * @struct RenderGraphPlan
+ * @brief A compiled frame, and the scratch space compiling it reuses.
+ */
+struct RenderGraphPlan {
+    std::vector<RenderGraphStep> steps;             ///< The kept passes, in the order they run.
+    std::vector<RenderGraphWait> waits;             ///< Each step's waits, contiguous and in step order.
+    std::vector<RenderGraphLifetime> lifetimes;     ///< Indexed like RenderGraph::resources.
+    std::vector<uint32_t> passSteps;                ///< Step of each pass; RENDER_GRAPH_NONE if it was culled.
+    uint64_t heapSize = 0;                          ///< Bytes the heap needs for the transients.
+    uint64_t transientBytes = 0;                    ///< Bytes the kept transients would take without aliasing.
+
+    std::vector<uint8_t> wanted;                    ///< Scratch: a kept pass reads the resource's latest write.
+    std::vector<uint32_t> lastWriters;              ///< Scratch: step of each resource's latest write.
+    std::vector<uint32_t> placed;                   ///< Scratch: transients placed so far.
+    std::vector<std::pair<uint64_t, uint64_t>> taken; ///< Scratch: heap ranges of live transients.
+};
+
+/**
+ * @brief Culls, orders, places and synchronises a frame's passes.
+ *
+ * A transient read before any kept pass writes it has undefined contents.
+ *
+ * @param graph The declared frame.
+ * @param plan Receives the compiled frame; keep it across frames to avoid allocating.
+ */
+void compile_render_graph(const RenderGraph& graph, RenderGraphPlan& plan);
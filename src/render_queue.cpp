@@ -0,0 +1,232 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+#include "mesh_asset.hpp"
+#include "objects.hpp"
+
+namespace {
+    // Index of an object in a small table of the states seen so far, added on first use
+    template <typename T>
+    uint32_t state_index(std::vector<T>& table, T object) {
+        auto it = std::find(table.begin(), table.end(), object);
+        if (it != table.end()) {
+            return (uint32_t)(it - table.begin());
+        }
+        table.push_back(object);
+        return (uint32_t)table.size() - 1;
+    }
+
+    // Buffers come and go with streamed chunks, so key them by address instead of a table;
+    // a collision only costs an extra binding because submission compares the objects
+    uint32_t buffer_key(const MTL::Buffer* buffer) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+        return (uint32_t)(address >> 4) ^ (uint32_t)((uint64_t)address >> 36);
+    }
+
+    // Object and mesh stage bindings are not tracked: meshlet draws are a handful per frame
+    // Object and mesh threadgroups: meshlets along x, instances along y
+    void encode_meshlet_draw(MTL::RenderCommandEncoder* enc, const DrawCommand& draw) {
+        enc->setObjectBuffer(draw.uniformBuffer, draw.uniformOffset, 1);
+        enc->setObjectBuffer(draw.instanceBuffer, draw.instanceOffset, 2);
+        enc->setObjectBuffer(draw.meshletBuffer, 0, 3);
+        if (draw.instanceIndexBuffer) {
+            enc->setObjectBuffer(draw.instanceIndexBuffer, draw.instanceIndexOffset, 6);
+        }
+        enc->setMeshBuffer(draw.vertexBuffer, 0, 0);
+        enc->setMeshBuffer(draw.uniformBuffer, draw.uniformOffset, 1);
+        enc->setMeshBuffer(draw.instanceBuffer, draw.instanceOffset, 2);
+        enc->setMeshBuffer(draw.meshletBuffer, 0, 3);
+        const uint32_t groups = (draw.meshletCount + MESHLET_OBJECT_THREADS - 1) / MESHLET_OBJECT_THREADS;
+        enc->drawMeshThreadgroups(MTL::Size(groups, draw.instanceCount, 1), MTL::Size(MESHLET_OBJECT_THREADS, 1, 1),
+                                  MTL::Size(MESHLET_MESH_THREADS, 1, 1));
+    }
+
+    // Brackets a draw with timestamps if there is room for them; returns the sample after it, or 0
+    NS::UInteger begin_timed_draw(DrawTimestamps* timestamps, MTL::RenderCommandEncoder* enc, const DrawCommand& draw) {
+        if (!timestamps || timestamps->count == timestamps->capacity) {
+            return 0;
+        }
+        const NS::UInteger sample = timestamps->first + timestamps->count * 2;
+        timestamps->tags[timestamps->count++] = { draw.object, draw.material };
+        enc->sampleCountersInBuffer(timestamps->samples, sample, true);
+        return sample + 1;
+    }
+
+    void end_timed_draw(DrawTimestamps* timestamps, MTL::RenderCommandEncoder* enc, NS::UInteger sample) {
+        if (sample != 0) {
+            enc->sampleCountersInBuffer(timestamps->samples, sample, true);
+        }
+    }
+
+    // Encodes packets [begin, end) starting from an encoder with nothing bound
+    RenderQueueStats encode_draws(const RenderQueue& queue, MTL::RenderCommandEncoder* enc, uint32_t begin,
+                                  uint32_t end) {
+        RenderQueueStats stats;
+        const MTL::RenderPipelineState* pipeline = nullptr;
+        const MTL::DepthStencilState* depthState = nullptr;
+        const MTL::Buffer* vertexBuffer = nullptr;
+        const MTL::Texture* vertexTexture = nullptr;
+        const MTL::Buffer* uniformBuffer = nullptr;
+        size_t uniformOffset = 0;
+        const MTL::Buffer* instanceBuffer = nullptr;
+        size_t instanceOffset = 0;
+        const MTL::Buffer* instanceIndexBuffer = nullptr;
+        size_t instanceIndexOffset = 0;
+
+        for (uint32_t i = begin; i < end; ++i) {
+            const DrawCommand& draw = queue.commands[queue.packets[i].command];
+
+            if (draw.pipeline != pipeline) {
+                enc->setRenderPipelineState(draw.pipeline);
+                pipeline = draw.pipeline;
+                stats.stateChanges++;
+            }
+            if (draw.depthState != depthState) {
+                enc->setDepthStencilState(draw.depthState);
+                depthState = draw.depthState;
+                stats.stateChanges++;
+            }
+            if (draw.meshletBuffer) {
+                if (__builtin_available(macOS 13.0, *)) {
+                    const NS::UInteger after = begin_timed_draw(queue.timestamps, enc, draw);
+                    encode_meshlet_draw(enc, draw);
+                    end_timed_draw(queue.timestamps, enc, after);
+                    stats.stateChanges += 2;
+                    stats.draws++;
+                }
+                continue;
+            }
+            if (draw.vertexBuffer && draw.vertexBuffer != vertexBuffer) {
+                enc->setVertexBuffer(draw.vertexBuffer, 0, 0);
+                vertexBuffer = draw.vertexBuffer;
+                stats.stateChanges++;
+            }
+            if (draw.vertexTextures[0] && draw.vertexTextures[0] != vertexTexture) {
+                enc->setVertexTexture(draw.vertexTextures[0], 0);
+                enc->setVertexTexture(draw.vertexTextures[1], 1);
+                vertexTexture = draw.vertexTextures[0];
+                stats.stateChanges++;
+            }
+            if (draw.uniformBuffer && draw.uniformBuffer != uniformBuffer) {
+                enc->setVertexBuffer(draw.uniformBuffer, draw.uniformOffset, 1);
+                enc->setFragmentBuffer(draw.uniformBuffer, draw.uniformOffset, 1);
+                uniformBuffer = draw.uniformBuffer;
+                uniformOffset = draw.uniformOffset;
+                stats.stateChanges++;
+            } else if (draw.uniformBuffer && draw.uniformOffset != uniformOffset) {
+                // Same buffer, new slice: only move the offset
+                enc->setVertexBufferOffset(draw.uniformOffset, 1);
+                enc->setFragmentBufferOffset(draw.uniformOffset, 1);
+                uniformOffset = draw.uniformOffset;
+                stats.stateChanges++;
+            }
+            if (draw.instanceBuffer && draw.instanceBuffer != instanceBuffer) {
+                enc->setVertexBuffer(draw.instanceBuffer, draw.instanceOffset, 2);
+                instanceBuffer = draw.instanceBuffer;
+                instanceOffset = draw.instanceOffset;
+                stats.stateChanges++;
+            } else if (draw.instanceBuffer && draw.instanceOffset != instanceOffset) {
+                enc->setVertexBufferOffset(draw.instanceOffset, 2);
+                instanceOffset = draw.instanceOffset;
+                stats.stateChanges++;
+            }
+            if (draw.instanceIndexBuffer && draw.instanceIndexBuffer != instanceIndexBuffer) {
+                enc->setVertexBuffer(draw.instanceIndexBuffer, draw.instanceIndexOffset, 6);
+                instanceIndexBuffer = draw.instanceIndexBuffer;
+                instanceIndexOffset = draw.instanceIndexOffset;
+                stats.stateChanges++;
+            } else if (draw.instanceIndexBuffer && draw.instanceIndexOffset != instanceIndexOffset) {
+                enc->setVertexBufferOffset(draw.instanceIndexOffset, 6);
+                instanceIndexOffset = draw.instanceIndexOffset;
+                stats.stateChanges++;
+            }
+
+            const NS::UInteger after = begin_timed_draw(queue.timestamps, enc, draw);
+            if (draw.indirectBuffer) {
+                // A batch binds nothing between its records, so each costs only the draw itself
+                for (uint32_t r = 0; r < draw.indirectCount; ++r) {
+                    enc->drawIndexedPrimitives(
+                        MTL::PrimitiveTypeTriangle, draw.indexType, draw.indexBuffer, draw.indexOffset,
+                        draw.indirectBuffer,
+                        draw.indirectOffset + r * sizeof(MTL::DrawIndexedPrimitivesIndirectArguments));
+                }
+                stats.draws += draw.indirectCount - 1;
+            } else {
+                enc->drawIndexedPrimitives(MTL::PrimitiveTypeTriangle, draw.indexCount, draw.indexType,
+                                           draw.indexBuffer, draw.indexOffset, draw.instanceCount, draw.baseVertex,
+                                           draw.baseInstance);
+            }
+            end_timed_draw(queue.timestamps, enc, after);
+            stats.draws++;
+        }
+        return stats;
+    }
+}
+
+void render_queue_clear(RenderQueue& queue) {
+    queue.commands.clear();
+    queue.packets.clear();
+}
+
+void render_queue_push(RenderQueue& queue, const DrawCommand& command) {
+    DrawPacket packet;
+    // Materials bind nothing of their own, so near to far costs no state changes
+    const uint32_t material = queue.frontToBack ? draw_depth_key(command.viewDepth) : command.material;
+    packet.key = make_draw_key(state_index(queue.pipelines, command.pipeline),
+                               state_index(queue.depthStates, command.depthState), material,
+                               buffer_key(command.vertexBuffer));
+    packet.command = (uint32_t)queue.commands.size();
+    queue.packets.push_back(packet);
+    queue.commands.push_back(command);
+}
+
+RenderQueueStats render_queue_submit(RenderQueue& queue, MTL::RenderCommandEncoder* enc) {
+    radix_sort_draws(queue.packets, queue.scratch);
+    return encode_draws(queue, enc, 0, (uint32_t)queue.packets.size());
+}
+
+RenderQueueStats render_queue_submit_parallel(RenderQueue& queue, MTL::ParallelRenderCommandEncoder* parallel,
+                                              JobSystem& jobs, FrameArena& arena, uint32_t maxThreads,
+                                              const RenderEncoderSetup& setup) {
+    radix_sort_draws(queue.packets, queue.scratch);
+    // Timed draws take their samples in order
+    if (queue.timestamps) {
+        maxThreads = 1;
+    }
+    DrawSlice* slices = arena.allocate_array<DrawSlice>(std::max(maxThreads, 1u));
+    const uint32_t sliceCount =
+        slice_draws((uint32_t)queue.packets.size(), maxThreads, RENDER_QUEUE_MIN_SLICE_DRAWS, slices);
+
+    if (sliceCount == 0) {
+        return {};
+    }
+
+    // Creation order is execution order, so every sub-encoder is made here before any thread starts.
+    // They are autoreleased into the caller's pool, which outlives this call.
+    MTL::RenderCommandEncoder** encoders = arena.allocate_array<MTL::RenderCommandEncoder*>(sliceCount);
+    for (uint32_t i = 0; i < sliceCount; ++i) {
+        encoders[i] = parallel->renderCommandEncoder();
+    }
+
+    RenderQueueStats* sliceStats = arena.allocate_array<RenderQueueStats>(sliceCount);
+    jobs.parallel_for(sliceCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            NS::AutoreleasePool* pool = NS::AutoreleasePool::alloc()->init();
+            MTL::RenderCommandEncoder* enc = encoders[i];
+            if (setup) {
+                setup(enc);
+            }
+            sliceStats[i] = encode_draws(queue, enc, slices[i].begin, slices[i].end);
+            enc->endEncoding();
+            pool->release();
+        }
+    });
+
+    RenderQueueStats stats;
+    for (uint32_t i = 0; i < sliceCount; ++i) {
+        stats.draws += sliceStats[i].draws;
+        stats.stateChanges += sliceStats[i].stateChanges;
+    }
+    return stats;
+}
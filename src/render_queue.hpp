@@ -0,0 +1,152 @@
+/**
+ * @file render_queue.hpp
+ * @brief Collects a frame's draws, sorts them by render state and submits them with minimal state changes.
+ *
+ * Written in plain C++ against metal-cpp: the per-draw loop sends its messages without
+ * Objective-C dispatch through ARC, and the queued commands hold plain pointers, so pushing,
+ * sorting and clearing them retains and releases nothing. Objective-C callers convert their
+ * objects with the casts of metal_cpp.hpp.
+ */
+
+#pragma once
+#include <functional>
+#include <vector>
+
+#include "draw_costs.hpp"
+#include "draw_sort.hpp"
+#include "frame_arena.hpp"
+#include "job_system.hpp"
+#include "metal_cpp.hpp"
+
+/**
+ * @struct DrawCommand
+ * @brief One indexed draw and the state it needs.
+ *
+ * Buffer slots follow the shaders: 0 = vertices, 1 = uniforms, 2 = instances, 6 = the index
+ * list of draws whose instances are resident (see gpu_scene_instances.hpp); the pass's
+ * FrameUniforms sit at slot 5 (see frame_uniforms_bind()). Bindless draws
+ * leave vertexBuffer nil and read their vertices through SceneArguments instead, and
+ * height-map chunks leave it nil and fetch theirs from vertexTextures. Instanced draws have
+ * nothing per draw and leave uniformBuffer nil, and terrain chunks share one uniform array
+ * that they index with their base instance, so the binding stays put between them. Meshlet draws
+ * (see meshlet_draw.hpp) bind the same slots to the object and mesh stages, plus the meshlets
+ * at slot 3, and ignore the index fields. An indirect draw may cover indirectCount consecutive
+ * argument records, drawn one after the other with the same state: terrain chunks that share
+ * the pipeline and the LOD index buffer go out as one such batch, each record's base instance
+ * picking the chunk's constants.
+ *
+ * The objects are not owned: whoever queues the draw keeps them alive until it is submitted.
+ */
+struct DrawCommand {
+    MTL::RenderPipelineState* pipeline = nullptr; ///< Pipeline to draw with.
+    MTL::DepthStencilState* depthState = nullptr; ///< Depth stencil state to draw with.
+    MTL::Buffer* vertexBuffer = nullptr;    ///< Bound at vertex slot 0.
+    MTL::Texture* vertexTextures[2] = {};   ///< Bound at vertex texture slots 0 and 1 if the first is set.
+    MTL::Buffer* uniformBuffer = nullptr;   ///< Bound at vertex and fragment slot 1 if set.
+    size_t uniformOffset = 0;               ///< Offset of the uniforms in uniformBuffer.
+    MTL::Buffer* instanceBuffer = nullptr;  ///< Bound at vertex slot 2 if set.
+    size_t instanceOffset = 0;              ///< Offset of the first instance in instanceBuffer.
+    MTL::Buffer* instanceIndexBuffer = nullptr; ///< Bound at vertex slot 6 if set: the instances to draw.
+    size_t instanceIndexOffset = 0;         ///< Offset of the draw's first index in instanceIndexBuffer.
+    MTL::Buffer* indexBuffer = nullptr;     ///< Triangle list indices.
+    size_t indexOffset = 0;                 ///< Byte offset of the first index.
+    uint32_t indexCount = 0;                ///< Number of indices per instance.
+    MTL::IndexType indexType = MTL::IndexTypeUInt32; ///< Width of the indices.
+    uint32_t instanceCount = 1;             ///< Number of instances.
+    uint32_t baseInstance = 0;              ///< First instance; terrain chunks pass their draw ID here.
+    uint32_t baseVertex = 0;                ///< Added to every index; skinned instances pick their posed copy with it.
+    MTL::Buffer* indirectBuffer = nullptr;  ///< If set, MTLDrawIndexedPrimitivesIndirectArguments replace the counts.
+    size_t indirectOffset = 0;              ///< Offset of the arguments in indirectBuffer.
+    uint32_t indirectCount = 1;             ///< Consecutive argument records drawn from indirectOffset.
+    uint32_t material = 0;                  ///< Material identifier, sorted after the pipeline and depth state.
+    uint32_t object = 0;                    ///< What the draw shows, for GPU cost attribution; see make_draw_object().
+    float viewDepth = 0.0f;                 ///< Distance from the eye; replaces material with RenderQueue::frontToBack.
+    MTL::Buffer* meshletBuffer = nullptr;   ///< If set, a meshlet draw of GpuMesh::meshletData with a mesh pipeline.
+    uint32_t meshletCount = 0;              ///< Meshlets per instance of a meshlet draw.
+};
+
+/**
+ * @struct DrawTimestamps
+ * @brief Where the draws of a sampled frame write their timestamps and tags; see gpu_draw_costs.hpp.
+ *
+ * Draw i samples first + 2i before it and first + 2i + 1 after it, with a barrier so draws do not
+ * overlap and the difference is its own. Several queues may share one, in submission order.
+ */
+struct DrawTimestamps {
+    MTL::CounterSampleBuffer* samples = nullptr; ///< Timestamps, sampled at draw boundaries.
+    NS::UInteger first = 0;     ///< First sample of the frame.
+    uint32_t capacity = 0;      ///< Draws that can be timed; later ones are not.
+    DrawTag* tags = nullptr;    ///< Receives each timed draw's tag; capacity entries.
+    uint32_t count = 0;         ///< Draws timed so far.
+};
+
+/**
+ * @struct RenderQueue
+ * @brief A frame's draw commands plus the sort scratch, reused across frames.
+ */
+struct RenderQueue {
+    std::vector<DrawCommand> commands;          ///< Draws pushed this frame, in push order.
+    std::vector<DrawPacket> packets;            ///< Sort keys of commands.
+    std::vector<DrawPacket> scratch;            ///< Radix sort working storage.
+    std::vector<MTL::RenderPipelineState*> pipelines; ///< Pipelines seen so far; their index is the key field.
+    std::vector<MTL::DepthStencilState*> depthStates; ///< Depth states seen so far; their index is the key field.
+    bool frontToBack = false;                   ///< Draws of one pipeline and depth state go near to far.
+    DrawTimestamps* timestamps = nullptr;       ///< Times each draw when set; the draws are then encoded on one thread.
+};
+
+/**
+ * @struct RenderQueueStats
+ * @brief What render_queue_submit() encoded.
+ */
+struct RenderQueueStats {
+    uint32_t draws = 0;         ///< Draw calls encoded.
+    uint32_t stateChanges = 0;  ///< Pipeline, depth state and buffer bindings encoded.
+};
+
+/// Fewest sorted draws worth encoding on a thread of their own.
+constexpr uint32_t RENDER_QUEUE_MIN_SLICE_DRAWS = 64;
+
+/// Binds state every encoder of a pass needs before its draws, such as argument buffers.
+using RenderEncoderSetup = std::function<void(MTL::RenderCommandEncoder* enc)>;
+
+/**
+ * @brief Removes all draws queued for the previous frame.
+ * @param queue The render queue.
+ */
+void render_queue_clear(RenderQueue& queue);
+
+/**
+ * @brief Queues a draw.
+ * @param queue The render queue.
+ * @param command The draw and its state.
+ */
+void render_queue_push(RenderQueue& queue, const DrawCommand& command);
+
+/**
+ * @brief Sorts the queued draws and encodes them, skipping state that is already bound.
+ * @param queue The render queue.
+ * @param enc The render encoder to draw with.
+ * @return What was encoded.
+ */
+RenderQueueStats render_queue_submit(RenderQueue& queue, MTL::RenderCommandEncoder* enc);
+
+/**
+ * @brief Sorts the queued draws and encodes them on the job system's frame threads.
+ *
+ * The sorted list is cut into contiguous slices and each slice gets its own sub-encoder
+ * of the parallel encoder. Sub-encoders are created in slice order on the calling thread,
+ * which fixes the GPU execution order, so the result matches render_queue_submit() apart
+ * from the state rebound at the start of each slice. Returns once every slice is encoded;
+ * the caller ends the parallel encoder. A queue with timestamps is encoded as one slice.
+ *
+ * @param queue The render queue.
+ * @param parallel The parallel encoder of the pass.
+ * @param jobs The job system encoding the slices; the caller encodes one of them.
+ * @param arena The calling thread's frame arena, for the slices and their stats.
+ * @param maxThreads The most slices to encode concurrently.
+ * @param setup Called on every sub-encoder before its draws; may be empty.
+ * @return What was encoded, summed over the slices.
+ */
+RenderQueueStats render_queue_submit_parallel(RenderQueue& queue, MTL::ParallelRenderCommandEncoder* parallel,
+                                              JobSystem& jobs, FrameArena& arena, uint32_t maxThreads,
+                                              const RenderEncoderSetup& setup);
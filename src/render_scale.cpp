@@ -0,0 +1,72 @@
+#include "render_scale.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "camera.hpp"
+
+namespace {
+    float clamp_scale(const RenderScaleSettings& settings, float scale) {
+        return std::clamp(scale, settings.minScale, settings.maxScale);
+    }
+}
+
+bool render_scale_update(RenderScaleController& controller, const RenderScaleSettings& settings, float gpuMs) {
+    controller.framesSinceChange++;
+    if (gpuMs < 0.0f) {
+        return false;
+    }
+
+    if (controller.smoothedMs < 0.0f) {
+        controller.smoothedMs = gpuMs;
+    } else {
+        controller.smoothedMs += (gpuMs - controller.smoothedMs) * settings.smoothing;
+    }
+    if (controller.framesSinceChange < settings.cooldownFrames) {
+        return false;
+    }
+
+    float scale = controller.scale;
+    if (controller.smoothedMs > settings.targetMs) {
+        // Pixels scale with scale^2, so the scale that fits the budget is a square root away
+        float fit = controller.scale * std::sqrt(settings.targetMs * settings.headroom / controller.smoothedMs);
+        scale = std::floor(fit / settings.step) * settings.step;
+        scale = std::min(scale, controller.scale - settings.step);
+    } else if (controller.smoothedMs < settings.targetMs * settings.growThreshold) {
+        scale = controller.scale + settings.step;
+    }
+
+    scale = clamp_scale(settings, scale);
+    if (scale == controller.scale) {
+        return false;
+    }
+
+    // Samples so far were taken at the old scale and frames in flight still are
+    controller.scale = scale;
+    controller.smoothedMs = -1.0f;
+    controller.framesSinceChange = 0;
+    return true;
+}
+
+uint32_t render_scale_dimension(uint32_t output, float scale) {
+    return std::max(1u, (uint32_t)std::lround(output * scale));
+}
+
+float halton(uint32_t index, uint32_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= base;
+        result += fraction * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+simd::float4x4 jitter_projection(const simd::float4x4& projection, simd::float2 jitterPixels,
+                                 uint32_t width, uint32_t height) {
+    // A clip-space translation by w * offset moves every vertex by offset in NDC; NDC y points up
+    float ndcX = 2.0f * jitterPixels.x / width;
+    float ndcY = -2.0f * jitterPixels.y / height;
+    return matrix_translation(ndcX, ndcY, 0.0f) * projection;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file render_scale.hpp
+ * @brief Dynamic resolution: picks the internal render scale from measured GPU time.
+ *
+ * GPU cost is treated as proportional to the number of shaded pixels, i.e. to the square
+ * of the scale. The controller steps down as far as the measured time says it needs to,
+ * but only ever steps back up one notch at a time, so a cheap frame does not bounce the
+ * resolution straight back into a miss.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+/**
+ * @struct RenderScaleSettings
+ * @brief Tuning of the render scale controller.
+ */
+struct RenderScaleSettings {
+    float targetMs = 1000.0f / 120.0f;  ///< GPU budget per frame; 120 Hz ProMotion by default.
+    float minScale = 0.5f;              ///< Lowest scale per axis.
+    float maxScale = 1.0f;              ///< Highest scale per axis.
+    float step = 0.125f;                ///< Scales are multiples of this, so targets are rarely reallocated.
+    float headroom = 0.9f;              ///< Fraction of the budget to aim for when stepping down.
+    float growThreshold = 0.7f;         ///< Fraction of the budget below which the scale steps up.
+    float smoothing = 0.1f;             ///< Weight of a new sample in the moving average.
+    uint32_t cooldownFrames = 30;       ///< Frames to measure after a change before the next one.
+};
+
+/**
+ * @struct RenderScaleController
+ * @brief State of the render scale controller.
+ */
+struct RenderScaleController {
+    float scale = 1.0f;                 ///< Current scale per axis.
+    float smoothedMs = -1.0f;           ///< Moving average of GPU time at this scale, negative when reset.
+    uint32_t framesSinceChange = 0;     ///< Frames measured since the scale last changed.
+};
+
+/**
+ * @brief Feeds one GPU time sample to the controller.
+ * @param controller The controller to update.
+ * @param settings The budget and limits.
+ * @param gpuMs The GPU time of a finished frame; negative samples only advance the cooldown.
+ * @return True if controller.scale changed.
+ */
+bool render_scale_update(RenderScaleController& controller, const RenderScaleSettings& settings, float gpuMs);
+
+/**
+ * @brief Scales one output dimension to the internal render size.
+ * @param output The output size in pixels.
+ * @param scale The scale per axis.
+ * @return The rounded size, at least 1.
+ */
+uint32_t render_scale_dimension(uint32_t output, float scale);
+
+/**
+ * @brief Returns element i of the Halton low-discrepancy sequence.
+ * @param index The element, starting at 1.
+ * @param base The prime base.
+ * @return A value in [0, 1).
+ */
+float halton(uint32_t index, uint32_t base);
+
+/**
+ * @brief Offsets a projection by a sub-pixel amount for temporal upscaling.
+ * @param projection The projection to jitter.
+ * @param jitterPixels The offset in pixels, +x right and +y down, typically in [-0.5, 0.5].
+ * @param width The render width in pixels.
+ * @param height The render height in pixels.
+ * @return The jittered projection.
+ */
+simd::float4x4 jitter_projection(const simd::float4x4& projection, simd::float2 jitterPixels,
+                                 uint32_t width, uint32_t height);
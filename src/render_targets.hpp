@@ -0,0 +1,85 @@
+/**
+ * @file render_targets.hpp
+ * @brief Render targets that stay in tile memory when no pass keeps them, and an audit of the
+ *        attachment traffic of each render pass.
+ *
+ * On Apple GPUs an attachment that a pass neither loads nor stores never leaves tile memory, so
+ * it can be created with MTLStorageModeMemoryless and takes no memory at all. Some targets only
+ * have their contents kept on some frames (scene depth, while GPU culling or temporal upscaling
+ * reads it); a TransientTarget hands out a memoryless texture on the other frames and allocates
+ * the private one the first time the contents are kept.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_stats.hpp"
+
+/**
+ * @struct TransientTarget
+ * @brief A render target that is memoryless on frames that discard it.
+ */
+struct TransientTarget {
+    id<MTLDevice> device;                               ///< Device the textures are created on.
+    MTLPixelFormat format = MTLPixelFormatInvalid;      ///< Pixel format of both textures.
+    MTLTextureUsage keptUsage = MTLTextureUsageRenderTarget; ///< Usage of kept; memoryless is a render target only.
+    uint32_t width = 0;                                 ///< Width in pixels.
+    uint32_t height = 0;                                ///< Height in pixels.
+    NSString* label;                                    ///< Debug label of both textures.
+    id<MTLTexture> memoryless;                          ///< Used on frames that discard the contents; nil if unsupported.
+    id<MTLTexture> kept;                                ///< Private texture, allocated the first frame it is needed.
+};
+
+/// @return True if the device can create MTLStorageModeMemoryless textures.
+bool memoryless_supported(id<MTLDevice> device);
+
+/**
+ * @brief Creates a target; only the memoryless texture is created up front, if supported.
+ * @param device The Metal device.
+ * @param format The pixel format.
+ * @param width The width in pixels.
+ * @param height The height in pixels.
+ * @param keptUsage Usage of the texture used on frames that keep the contents.
+ * @param label The debug label.
+ * @return The target.
+ */
+TransientTarget create_transient_target(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                                        MTLTextureUsage keptUsage, NSString* label);
+
+/**
+ * @brief Picks the texture for this frame's pass.
+ * @param target The target.
+ * @param keep True if the pass stores the contents or a later pass reads them.
+ * @return The private texture if keep or memoryless storage is unsupported, the memoryless one otherwise.
+ */
+id<MTLTexture> transient_target_texture(TransientTarget& target, bool keep);
+
+/// @return GPU bytes held by the target, which is only its private texture.
+size_t transient_target_bytes(const TransientTarget& target);
+
+/**
+ * @brief Measures the attachment traffic of a pass from its load and store actions.
+ *
+ * The first time a pass discards an attachment that is backed by memory, this logs it once
+ * under passName, since that attachment could be memoryless. Call it on the render thread only.
+ *
+ * @param passDesc The pass, with its attachments set.
+ * @param passName The name used in the log.
+ * @return The bytes the pass loads, stores and avoids moving.
+ */
+PassTraffic audit_render_pass(MTLRenderPassDescriptor* passDesc, const char* passName);
+
+/**
+ * @brief Detaches everything from a descriptor that is kept and filled again every frame.
+ *
+ * Clears the textures and resolve textures of every colour attachment and of depth and
+ * stencil, the timing samples and the rasterization rate map, so nothing the last frame
+ * attached (MSAA resolves, G-buffer planes, a profiler's sample buffer) carries over. The attachment descriptors
+ * themselves are kept, so after the first frame this allocates nothing.
+ *
+ * @param passDesc The descriptor; encoders made from it before have copied what they need.
+ */
+void render_pass_reset(MTLRenderPassDescriptor* passDesc);
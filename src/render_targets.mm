@@ -0,0 +1,138 @@
+#import "render_targets.hpp"
+
+#include <string>
+#include <unordered_set>
+
+namespace {
+    // Formats the render targets use; everything else is assumed to be 32 bits
+    size_t pixel_bytes(MTLPixelFormat format) {
+        switch (format) {
+        case MTLPixelFormatR8Unorm:
+            return 1;
+        case MTLPixelFormatRG16Float:
+        case MTLPixelFormatRG16Snorm:
+        case MTLPixelFormatRGBA8Unorm:
+        case MTLPixelFormatBGRA8Unorm:
+        case MTLPixelFormatR32Float:
+        case MTLPixelFormatDepth32Float:
+            return 4;
+        case MTLPixelFormatRGBA16Float:
+        case MTLPixelFormatDepth32Float_Stencil8:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
+    // Bytes of one slice, every sample included
+    uint64_t attachment_bytes(id<MTLTexture> texture) {
+        return (uint64_t)texture.width * texture.height * texture.sampleCount * pixel_bytes(texture.pixelFormat);
+    }
+
+    void audit_attachment(MTLRenderPassAttachmentDescriptor* attachment, const char* passName, const char* role,
+                          PassTraffic& traffic) {
+        id<MTLTexture> texture = attachment.texture;
+        if (!texture) {
+            return;
+        }
+        const uint64_t bytes = attachment_bytes(texture);
+        const MTLStoreAction store = attachment.storeAction;
+        const bool loads = attachment.loadAction == MTLLoadActionLoad;
+        const bool stores = store == MTLStoreActionStore || store == MTLStoreActionStoreAndMultisampleResolve;
+        const bool resolves =
+            store == MTLStoreActionMultisampleResolve || store == MTLStoreActionStoreAndMultisampleResolve;
+
+        traffic.loadedBytes += loads ? bytes : 0;
+        traffic.storedBytes += stores ? bytes : 0;
+        if (resolves && attachment.resolveTexture) {
+            traffic.storedBytes += attachment_bytes(attachment.resolveTexture);
+        }
+        traffic.savedBytes += (loads ? 0 : bytes) + (stores ? 0 : bytes);
+
+        if (texture.storageMode == MTLStorageModeMemoryless) {
+            traffic.memorylessBytes += bytes;
+        } else if (!loads && !stores) {
+            // Render thread only, like every caller
+            static std::unordered_set<std::string> reported;
+            if (reported.insert(std::string(passName) + role).second) {
+                NSLog(@"%s pass: the %s attachment is discarded but holds %.1f MB; it could be memoryless", passName,
+                      role, bytes / (1024.0 * 1024.0));
+            }
+        }
+    }
+}
+
+bool memoryless_supported(id<MTLDevice> device) {
+    return [device supportsFamily:MTLGPUFamilyApple1];
+}
+
+TransientTarget create_transient_target(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                                        MTLTextureUsage keptUsage, NSString* label) {
+    TransientTarget target;
+    target.device = device;
+    target.format = format;
+    target.keptUsage = keptUsage;
+    target.width = width;
+    target.height = height;
+    target.label = label;
+    if (memoryless_supported(device)) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModeMemoryless;
+        desc.usage = MTLTextureUsageRenderTarget;
+        target.memoryless = [device newTextureWithDescriptor:desc];
+        target.memoryless.label = [label stringByAppendingString:@" (memoryless)"];
+    }
+    return target;
+}
+
+id<MTLTexture> transient_target_texture(TransientTarget& target, bool keep) {
+    if (!keep && target.memoryless) {
+        return target.memoryless;
+    }
+    if (!target.kept) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:target.format
+                                                                                        width:target.width
+                                                                                       height:target.height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = target.keptUsage;
+        target.kept = [target.device newTextureWithDescriptor:desc];
+        target.kept.label = target.label;
+    }
+    return target.kept;
+}
+
+size_t transient_target_bytes(const TransientTarget& target) {
+    return target.kept ? target.kept.allocatedSize : 0;
+}
+
+void render_pass_reset(MTLRenderPassDescriptor* passDesc) {
+    // Metal's limit on colour attachments
+    constexpr NSUInteger maxColorAttachments = 8;
+    for (NSUInteger i = 0; i < maxColorAttachments; ++i) {
+        MTLRenderPassColorAttachmentDescriptor* color = passDesc.colorAttachments[i];
+        color.texture = nil;
+        color.resolveTexture = nil;
+    }
+    passDesc.depthAttachment.texture = nil;
+    passDesc.depthAttachment.resolveTexture = nil;
+    passDesc.stencilAttachment.texture = nil;
+    passDesc.stencilAttachment.resolveTexture = nil;
+    passDesc.sampleBufferAttachments[0].sampleBuffer = nil;
+    passDesc.rasterizationRateMap = nil;
+}
+
+PassTraffic audit_render_pass(MTLRenderPassDescriptor* passDesc, const char* passName) {
+    static const char* colorRoles[] = { "colour 0", "colour 1", "colour 2", "colour 3",
+                                        "colour 4", "colour 5", "colour 6", "colour 7" };
+    PassTraffic traffic;
+    for (NSUInteger i = 0; i < 8; ++i) {
+        audit_attachment(passDesc.colorAttachments[i], passName, colorRoles[i], traffic);
+    }
+    audit_attachment(passDesc.depthAttachment, passName, "depth", traffic);
+    audit_attachment(passDesc.stencilAttachment, passName, "stencil", traffic);
+    return traffic;
+}
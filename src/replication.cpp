@@ -0,0 +1,560 @@
+#include "replication.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // The three smallest components of a unit quaternion lie within +-1/sqrt(2)
+    constexpr float ROTATION_RANGE = 0.70710678f;
+    constexpr float ROTATION_STEPS = 1023.0f;
+    constexpr float SCALE_STEPS = 256.0f;
+
+    enum RecordKind : uint32_t {
+        RECORD_DELTA = 0,   ///< Fields that changed against the baseline entry.
+        RECORD_FULL = 1,    ///< A whole entry, new or replacing one of another generation, mesh or colour.
+        RECORD_REMOVED = 2, ///< The entry left the client's interest or was destroyed.
+    };
+
+    enum DeltaField : uint8_t {
+        FIELD_POSITION = 1,
+        FIELD_ROTATION = 2,
+        FIELD_SCALE = 4,
+    };
+
+    constexpr size_t HEADER_BYTES = 16;     // sequence, baseline, time
+    constexpr size_t MAX_RECORD_BYTES = 48; // A full record with the longest varints
+
+    struct Writer {
+        uint8_t* data;
+        size_t capacity;
+        size_t size = 0;
+
+        void byte(uint8_t value) {
+            data[size++] = value;
+        }
+        void u16(uint16_t value) {
+            byte((uint8_t)value);
+            byte((uint8_t)(value >> 8));
+        }
+        void u32(uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                byte((uint8_t)(value >> (8 * i)));
+            }
+        }
+        void f64(double value) {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            u32((uint32_t)bits);
+            u32((uint32_t)(bits >> 32));
+        }
+        void varint(uint64_t value) {
+            while (value >= 0x80) {
+                byte((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            byte((uint8_t)value);
+        }
+        // Small magnitudes of either sign become small varints
+        void zigzag(int64_t value) {
+            varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+        }
+    };
+
+    struct Reader {
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+        bool ok = true;
+
+        uint8_t byte() {
+            if (offset >= size) {
+                ok = false;
+                return 0;
+            }
+            return data[offset++];
+        }
+        uint16_t u16() {
+            const uint16_t low = byte();
+            return (uint16_t)(low | (byte() << 8));
+        }
+        uint32_t u32() {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= (uint32_t)byte() << (8 * i);
+            }
+            return value;
+        }
+        double f64() {
+            const uint64_t low = u32();
+            const uint64_t bits = low | ((uint64_t)u32() << 32);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64 && ok; shift += 7) {
+                const uint8_t next = byte();
+                value |= (uint64_t)(next & 0x7F) << shift;
+                if (!(next & 0x80)) {
+                    return value;
+                }
+            }
+            ok = false;
+            return 0;
+        }
+        int64_t zigzag() {
+            const uint64_t value = varint();
+            return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        }
+    };
+
+    void write_transform(Writer& out, const ReplicatedTransform& transform) {
+        for (int i = 0; i < 3; ++i) {
+            out.zigzag(transform.position[i]);
+        }
+        out.u32(transform.rotation);
+        for (int i = 0; i < 3; ++i) {
+            out.u16(transform.scale[i]);
+        }
+    }
+
+    ReplicatedTransform read_transform(Reader& in) {
+        ReplicatedTransform transform;
+        for (int i = 0; i < 3; ++i) {
+            transform.position[i] = (int32_t)in.zigzag();
+        }
+        transform.rotation = in.u32();
+        for (int i = 0; i < 3; ++i) {
+            transform.scale[i] = in.u16();
+        }
+        return transform;
+    }
+
+    bool same_position(const ReplicatedTransform& a, const ReplicatedTransform& b) {
+        return a.position[0] == b.position[0] && a.position[1] == b.position[1] && a.position[2] == b.position[2];
+    }
+
+    bool same_scale(const ReplicatedTransform& a, const ReplicatedTransform& b) {
+        return a.scale[0] == b.scale[0] && a.scale[1] == b.scale[1] && a.scale[2] == b.scale[2];
+    }
+
+    // A delta record only carries the transform; anything else needs a full one
+    bool same_identity(const ReplicatedEntity& a, const ReplicatedEntity& b) {
+        return a.entity.generation == b.entity.generation && a.mesh == b.mesh && a.color == b.color;
+    }
+
+    void write_full(Writer& out, const ReplicatedEntity& entity) {
+        out.varint(((uint64_t)entity.entity.index << 2) | RECORD_FULL);
+        out.varint(entity.entity.generation);
+        out.varint(entity.mesh);
+        out.byte((uint8_t)entity.color);
+        out.byte((uint8_t)(entity.color >> 8));
+        out.byte((uint8_t)(entity.color >> 16));
+        write_transform(out, entity.transform);
+    }
+
+    void write_delta(Writer& out, const ReplicatedEntity& base, const ReplicatedEntity& entity) {
+        const ReplicatedTransform& from = base.transform;
+        const ReplicatedTransform& to = entity.transform;
+        uint8_t fields = 0;
+        fields |= same_position(from, to) ? 0 : FIELD_POSITION;
+        fields |= from.rotation == to.rotation ? 0 : FIELD_ROTATION;
+        fields |= same_scale(from, to) ? 0 : FIELD_SCALE;
+        out.varint(((uint64_t)entity.entity.index << 2) | RECORD_DELTA);
+        out.byte(fields);
+        if (fields & FIELD_POSITION) {
+            for (int i = 0; i < 3; ++i) {
+                out.zigzag((int64_t)to.position[i] - from.position[i]);
+            }
+        }
+        if (fields & FIELD_ROTATION) {
+            out.u32(to.rotation);
+        }
+        if (fields & FIELD_SCALE) {
+            for (int i = 0; i < 3; ++i) {
+                out.u16(to.scale[i]);
+            }
+        }
+    }
+
+    // Applies a delta record to the entry it names
+    void read_delta(Reader& in, ReplicatedTransform& transform) {
+        const uint8_t fields = in.byte();
+        if (fields & FIELD_POSITION) {
+            for (int i = 0; i < 3; ++i) {
+                transform.position[i] = (int32_t)((int64_t)transform.position[i] + in.zigzag());
+            }
+        }
+        if (fields & FIELD_ROTATION) {
+            transform.rotation = in.u32();
+        }
+        if (fields & FIELD_SCALE) {
+            for (int i = 0; i < 3; ++i) {
+                transform.scale[i] = in.u16();
+            }
+        }
+    }
+
+    std::vector<ReplicatedEntity>::iterator entry_position(std::vector<ReplicatedEntity>& entities, uint32_t index) {
+        return std::lower_bound(entities.begin(), entities.end(), index,
+                                [](const ReplicatedEntity& e, uint32_t i) { return e.entity.index < i; });
+    }
+
+    const ReplicatedEntity* find_entry(const std::vector<ReplicatedEntity>& entities, uint32_t index) {
+        auto it = std::lower_bound(entities.begin(), entities.end(), index,
+                                   [](const ReplicatedEntity& e, uint32_t i) { return e.entity.index < i; });
+        return it != entities.end() && it->entity.index == index ? &*it : nullptr;
+    }
+
+    simd::float3 entity_position(const ReplicatedTransform& transform) {
+        return simd::float3{ (float)transform.position[0], (float)transform.position[1],
+                             (float)transform.position[2] } * REPLICATION_POSITION_STEP;
+    }
+
+    // Unit quaternion (x, y, z, w) of a rotation matrix given by its columns
+    simd::float4 quaternion_from_columns(simd::float3 x, simd::float3 y, simd::float3 z) {
+        const float trace = x.x + y.y + z.z;
+        simd::float4 q;
+        if (trace > 0.0f) {
+            const float s = sqrtf(trace + 1.0f) * 2.0f;
+            q = { (y.z - z.y) / s, (z.x - x.z) / s, (x.y - y.x) / s, 0.25f * s };
+        } else if (x.x > y.y && x.x > z.z) {
+            const float s = sqrtf(1.0f + x.x - y.y - z.z) * 2.0f;
+            q = { 0.25f * s, (y.x + x.y) / s, (z.x + x.z) / s, (y.z - z.y) / s };
+        } else if (y.y > z.z) {
+            const float s = sqrtf(1.0f + y.y - x.x - z.z) * 2.0f;
+            q = { (y.x + x.y) / s, 0.25f * s, (z.y + y.z) / s, (z.x - x.z) / s };
+        } else {
+            const float s = sqrtf(1.0f + z.z - x.x - y.y) * 2.0f;
+            q = { (z.x + x.z) / s, (z.y + y.z) / s, 0.25f * s, (x.y - y.x) / s };
+        }
+        return q / sqrtf(simd::dot(q, q));
+    }
+
+    uint32_t pack_rotation(simd::float4 q) {
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < 4; ++i) {
+            if (fabsf(q[i]) > fabsf(q[largest])) {
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, so the dropped component can always be taken as positive
+        if (q[largest] < 0.0f) {
+            q = -q;
+        }
+        uint32_t packed = largest << 30;
+        uint32_t shift = 20;
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (i == largest) {
+                continue;
+            }
+            const float unit = std::clamp((q[i] / ROTATION_RANGE + 1.0f) * 0.5f, 0.0f, 1.0f);
+            packed |= (uint32_t)lroundf(unit * ROTATION_STEPS) << shift;
+            shift -= 10;
+        }
+        return packed;
+    }
+
+    simd::float4 unpack_rotation(uint32_t packed) {
+        const uint32_t largest = packed >> 30;
+        simd::float4 q = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float sum = 0.0f;
+        uint32_t shift = 20;
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (i == largest) {
+                continue;
+            }
+            const float unit = (float)((packed >> shift) & 1023) / ROTATION_STEPS;
+            q[i] = (unit * 2.0f - 1.0f) * ROTATION_RANGE;
+            sum += q[i] * q[i];
+            shift -= 10;
+        }
+        q[largest] = sqrtf(std::max(1.0f - sum, 0.0f));
+        return q / sqrtf(simd::dot(q, q));
+    }
+
+    simd::float4x4 compose(simd::float3 position, simd::float4 q, simd::float3 scale) {
+        const float x = q.x, y = q.y, z = q.z, w = q.w;
+        const simd::float3 cx = { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) };
+        const simd::float3 cy = { 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) };
+        const simd::float3 cz = { 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) };
+        return simd::float4x4(simd::float4{ cx.x * scale.x, cx.y * scale.x, cx.z * scale.x, 0.0f },
+                              simd::float4{ cy.x * scale.y, cy.y * scale.y, cy.z * scale.y, 0.0f },
+                              simd::float4{ cz.x * scale.z, cz.y * scale.z, cz.z * scale.z, 0.0f },
+                              simd::float4{ position.x, position.y, position.z, 1.0f });
+    }
+
+    simd::float3 unpack_scale(const ReplicatedTransform& transform) {
+        return simd::float3{ (float)transform.scale[0], (float)transform.scale[1], (float)transform.scale[2] } /
+               SCALE_STEPS;
+    }
+
+    int32_t quantize_position(float value) {
+        const double steps = std::round((double)value / REPLICATION_POSITION_STEP);
+        return (int32_t)std::clamp(steps, (double)INT32_MIN, (double)INT32_MAX);
+    }
+}
+
+ReplicatedTransform replication_quantize(const simd::float4x4& transform) {
+    ReplicatedTransform quantized;
+    simd::float3 axes[3];
+    for (int i = 0; i < 3; ++i) {
+        axes[i] = simd::float3{ transform.columns[i].x, transform.columns[i].y, transform.columns[i].z };
+        const float length = simd::length(axes[i]);
+        quantized.scale[i] = (uint16_t)std::clamp(lroundf(length * SCALE_STEPS), 1L, 65535L);
+        axes[i] = length > 0.0f ? axes[i] / length : simd::float3{ i == 0 ? 1.0f : 0.0f, i == 1 ? 1.0f : 0.0f,
+                                                                    i == 2 ? 1.0f : 0.0f };
+        quantized.position[i] = quantize_position(transform.columns[3][i]);
+    }
+    quantized.rotation = pack_rotation(quaternion_from_columns(axes[0], axes[1], axes[2]));
+    return quantized;
+}
+
+simd::float4x4 replication_dequantize(const ReplicatedTransform& transform) {
+    return compose(entity_position(transform), unpack_rotation(transform.rotation), unpack_scale(transform));
+}
+
+uint32_t replication_pack_color(simd::float3 color) {
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; ++i) {
+        packed |= (uint32_t)lroundf(std::clamp(color[i], 0.0f, 1.0f) * 255.0f) << (8 * i);
+    }
+    return packed;
+}
+
+simd::float3 replication_unpack_color(uint32_t color) {
+    return simd::float3{ (float)(color & 255), (float)((color >> 8) & 255), (float)((color >> 16) & 255) } / 255.0f;
+}
+
+void replication_gather(const SceneStore& scene, simd::float3 eye, float chunkSize, int32_t radius, double time,
+                        std::vector<Entity>& query, ReplicationSnapshot& snapshot) {
+    const int64_t eyeX = (int64_t)floorf(eye.x / chunkSize);
+    const int64_t eyeZ = (int64_t)floorf(eye.z / chunkSize);
+    BoundingBox box;
+    box.min = { (float)(eyeX - radius) * chunkSize, -INFINITY, (float)(eyeZ - radius) * chunkSize };
+    box.max = { (float)(eyeX + radius + 1) * chunkSize, INFINITY, (float)(eyeZ + radius + 1) * chunkSize };
+    scene_query_box(scene, box, query);
+
+    snapshot.time = time;
+    snapshot.entities.clear();
+    for (Entity entity : query) {
+        const uint32_t i = scene_index(scene, entity);
+        if (i == UINT32_MAX) {
+            continue;
+        }
+        // The query box is a bound; an entity counts by the chunk its origin is in
+        const simd::float4 origin = scene.transforms[i].columns[3];
+        const int64_t chunkX = (int64_t)floorf(origin.x / chunkSize);
+        const int64_t chunkZ = (int64_t)floorf(origin.z / chunkSize);
+        if (std::abs(chunkX - eyeX) > radius || std::abs(chunkZ - eyeZ) > radius) {
+            continue;
+        }
+        ReplicatedEntity replicated;
+        replicated.entity = entity;
+        replicated.mesh = scene.meshes[i];
+        replicated.color = replication_pack_color(scene.colors[i]);
+        replicated.transform = replication_quantize(scene.transforms[i]);
+        snapshot.entities.push_back(replicated);
+    }
+    std::sort(snapshot.entities.begin(), snapshot.entities.end(),
+              [](const ReplicatedEntity& a, const ReplicatedEntity& b) { return a.entity.index < b.entity.index; });
+}
+
+size_t replication_encode(const ReplicationSnapshot* baseline, const ReplicationSnapshot& current, simd::float3 eye,
+                          uint8_t* packet, size_t capacity, ReplicationSnapshot& sent) {
+    static const std::vector<ReplicatedEntity> none;
+    const std::vector<ReplicatedEntity>& base = baseline ? baseline->entities : none;
+
+    Writer out{ packet, capacity };
+    out.u32(current.sequence);
+    out.u32(baseline ? baseline->sequence : REPLICATION_NO_BASELINE);
+    out.f64(current.time);
+
+    // One pass over both sorted lists: what left, and what is new or moved
+    std::vector<uint32_t> removed;
+    std::vector<uint32_t> changed; // Positions in current
+    size_t b = 0;
+    for (size_t c = 0; c < current.entities.size(); ++c) {
+        const ReplicatedEntity& entity = current.entities[c];
+        for (; b < base.size() && base[b].entity.index < entity.entity.index; ++b) {
+            removed.push_back(base[b].entity.index);
+        }
+        const bool known = b < base.size() && base[b].entity.index == entity.entity.index;
+        if (!known || !same_identity(base[b], entity) || !same_position(base[b].transform, entity.transform) ||
+            base[b].transform.rotation != entity.transform.rotation ||
+            !same_scale(base[b].transform, entity.transform)) {
+            changed.push_back((uint32_t)c);
+        }
+        b += known ? 1 : 0;
+    }
+    for (; b < base.size(); ++b) {
+        removed.push_back(base[b].entity.index);
+    }
+    std::sort(changed.begin(), changed.end(), [&](uint32_t x, uint32_t y) {
+        const float dx = simd::length(entity_position(current.entities[x].transform) - eye);
+        const float dy = simd::length(entity_position(current.entities[y].transform) - eye);
+        return dx < dy || (dx == dy && x < y);
+    });
+
+    // Records go through scratch, so one that does not fit is dropped whole
+    uint8_t scratch[MAX_RECORD_BYTES];
+    auto append = [&](const Writer& record) {
+        if (out.size + record.size > capacity) {
+            return false;
+        }
+        memcpy(out.data + out.size, record.data, record.size);
+        out.size += record.size;
+        return true;
+    };
+    std::vector<uint32_t> removedSent;
+    for (uint32_t index : removed) {
+        Writer record{ scratch, sizeof(scratch) };
+        record.varint(((uint64_t)index << 2) | RECORD_REMOVED);
+        if (append(record)) {
+            removedSent.push_back(index);
+        }
+    }
+    std::vector<uint32_t> changedSent;
+    for (uint32_t c : changed) {
+        const ReplicatedEntity& entity = current.entities[c];
+        const ReplicatedEntity* known = find_entry(base, entity.entity.index);
+        Writer record{ scratch, sizeof(scratch) };
+        if (known && same_identity(*known, entity)) {
+            write_delta(record, *known, entity);
+        } else {
+            write_full(record, entity);
+        }
+        if (append(record)) {
+            changedSent.push_back(c);
+        }
+    }
+
+    // What the client rebuilds: the baseline with the written records applied
+    std::sort(removedSent.begin(), removedSent.end());
+    std::sort(changedSent.begin(), changedSent.end());
+    sent.sequence = current.sequence;
+    sent.time = current.time;
+    sent.entities.clear();
+    size_t r = 0;
+    size_t w = 0;
+    b = 0;
+    while (b < base.size() || w < changedSent.size()) {
+        const uint32_t baseIndex = b < base.size() ? base[b].entity.index : UINT32_MAX;
+        const uint32_t writtenIndex =
+            w < changedSent.size() ? current.entities[changedSent[w]].entity.index : UINT32_MAX;
+        if (writtenIndex <= baseIndex) {
+            sent.entities.push_back(current.entities[changedSent[w++]]);
+            b += writtenIndex == baseIndex ? 1 : 0;
+            continue;
+        }
+        while (r < removedSent.size() && removedSent[r] < baseIndex) {
+            ++r;
+        }
+        if (r == removedSent.size() || removedSent[r] != baseIndex) {
+            sent.entities.push_back(base[b]);
+        }
+        ++b;
+    }
+    return out.size;
+}
+
+bool replication_peek(const uint8_t* packet, size_t size, uint32_t& sequence, uint32_t& baseline) {
+    if (size < HEADER_BYTES) {
+        return false;
+    }
+    Reader in{ packet, size };
+    sequence = in.u32();
+    baseline = in.u32();
+    return true;
+}
+
+bool replication_decode(const uint8_t* packet, size_t size, const ReplicationSnapshot* baseline,
+                        ReplicationSnapshot& snapshot) {
+    Reader in{ packet, size };
+    const uint32_t sequence = in.u32();
+    const uint32_t baselineSequence = in.u32();
+    const double time = in.f64();
+    if (!in.ok || (baselineSequence != REPLICATION_NO_BASELINE &&
+                   (!baseline || baseline->sequence != baselineSequence))) {
+        return false;
+    }
+    snapshot.sequence = sequence;
+    snapshot.time = time;
+    if (baselineSequence != REPLICATION_NO_BASELINE) {
+        snapshot.entities = baseline->entities;
+    } else {
+        snapshot.entities.clear();
+    }
+
+    while (in.ok && in.offset < in.size) {
+        const uint64_t header = in.varint();
+        const uint32_t index = (uint32_t)(header >> 2);
+        auto it = entry_position(snapshot.entities, index);
+        const bool present = it != snapshot.entities.end() && it->entity.index == index;
+        switch (header & 3) {
+        case RECORD_REMOVED:
+            if (present) {
+                snapshot.entities.erase(it);
+            }
+            break;
+        case RECORD_FULL: {
+            ReplicatedEntity entity;
+            entity.entity.index = index;
+            entity.entity.generation = (uint32_t)in.varint();
+            entity.mesh = (uint32_t)in.varint();
+            entity.color = in.byte();
+            entity.color |= (uint32_t)in.byte() << 8;
+            entity.color |= (uint32_t)in.byte() << 16;
+            entity.transform = read_transform(in);
+            if (present) {
+                *it = entity;
+            } else {
+                snapshot.entities.insert(it, entity);
+            }
+            break;
+        }
+        case RECORD_DELTA:
+            if (!present) {
+                return false;
+            }
+            read_delta(in, it->transform);
+            break;
+        default:
+            return false;
+        }
+    }
+    return in.ok;
+}
+
+void replication_interpolate(const ReplicationSnapshot& from, const ReplicationSnapshot& to, float t,
+                             std::vector<ReplicatedPose>& poses) {
+    poses.clear();
+    poses.reserve(to.entities.size());
+    for (const ReplicatedEntity& entity : to.entities) {
+        ReplicatedPose pose;
+        pose.entity = entity.entity;
+        pose.mesh = entity.mesh;
+        pose.color = entity.color;
+        const ReplicatedEntity* earlier = find_entry(from.entities, entity.entity.index);
+        if (!earlier || earlier->entity.generation != entity.entity.generation) {
+            pose.transform = replication_dequantize(entity.transform);
+            poses.push_back(pose);
+            continue;
+        }
+        const simd::float3 position = entity_position(earlier->transform) +
+                                      (entity_position(entity.transform) - entity_position(earlier->transform)) * t;
+        const simd::float3 scale =
+            unpack_scale(earlier->transform) + (unpack_scale(entity.transform) - unpack_scale(earlier->transform)) * t;
+        // Normalized lerp along the shorter arc; steps are a server tick apart, so the angles are small
+        const simd::float4 a = unpack_rotation(earlier->transform.rotation);
+        simd::float4 b = unpack_rotation(entity.transform.rotation);
+        if (simd::dot(a, b) < 0.0f) {
+            b = -b;
+        }
+        const simd::float4 q = a + (b - a) * t;
+        pose.transform = compose(position, q / sqrtf(simd::dot(q, q)), scale);
+        poses.push_back(pose);
+    }
+}
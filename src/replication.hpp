@@ -0,0 +1,160 @@
+/**
+ * @file replication.hpp
+ * @brief Scene transforms encoded for other observers as quantized deltas.
+ *
+ * The server gathers the entities in the terrain chunks around each client (interest
+ * management) into a snapshot of quantized transforms: positions in REPLICATION_POSITION_STEP
+ * units, rotations as the three smallest quaternion components in ten bits each, scales in
+ * 1/256ths. A snapshot is sent as a delta against the last one the client acknowledged: only
+ * entities that moved are written, positions as zigzag varints of their change, so a resting
+ * object costs nothing and a slow one a few bytes. Whatever does not fit a packet keeps its
+ * baseline value and goes out with a later one, nearest entities first, and the server records
+ * exactly what the client will have rebuilt, so both sides always agree on every baseline.
+ * Traffic therefore follows the objects near each client, not the size of the world.
+ * Clients keep the snapshots they received and draw between the two around a delayed time.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scene.hpp"
+
+/// World units per step of a quantized position coordinate: 2 mm.
+constexpr float REPLICATION_POSITION_STEP = 1.0f / 512.0f;
+/// Largest datagram written; below the usual 1280-byte IPv6 minimum MTU after headers.
+constexpr size_t REPLICATION_MAX_PACKET = 1200;
+/// Snapshots each side keeps, so an acknowledgement up to this many packets old is still a baseline.
+constexpr uint32_t REPLICATION_HISTORY = 32;
+/// Sequence number meaning "no baseline": the packet holds full entries only.
+constexpr uint32_t REPLICATION_NO_BASELINE = UINT32_MAX;
+
+/**
+ * @struct ReplicatedTransform
+ * @brief A model matrix reduced to quantized translation, rotation and scale.
+ */
+struct ReplicatedTransform {
+    int32_t position[3] = { 0, 0, 0 }; ///< Translation in REPLICATION_POSITION_STEP units.
+    uint32_t rotation = 0;              ///< Largest component's index in the top 2 bits, then three 10-bit components.
+    uint16_t scale[3] = { 0, 0, 0 };    ///< Axis scales in 1/256ths.
+};
+
+/**
+ * @struct ReplicatedEntity
+ * @brief One entity of a snapshot: the server's handle, what it looks like and where it is.
+ */
+struct ReplicatedEntity {
+    Entity entity;                  ///< The handle on the server; index orders the snapshot.
+    uint32_t mesh = 0;              ///< Mesh handle; the same on every observer, which build the same meshes.
+    uint32_t color = 0;             ///< Flat colour as 8-bit r, g, b in the low bytes.
+    ReplicatedTransform transform;  ///< The quantized transform.
+};
+
+/**
+ * @struct ReplicationSnapshot
+ * @brief The entities one client sees at one server step.
+ */
+struct ReplicationSnapshot {
+    uint32_t sequence = REPLICATION_NO_BASELINE; ///< Per-client packet number; REPLICATION_NO_BASELINE when empty.
+    double time = 0.0;                           ///< Server clock time of the step, in seconds.
+    std::vector<ReplicatedEntity> entities;      ///< Sorted by entity index.
+};
+
+/**
+ * @brief Quantizes a model matrix; its upper 3x3 must be a rotation times a positive scale.
+ * @param transform The matrix.
+ * @return The quantized transform.
+ */
+ReplicatedTransform replication_quantize(const simd::float4x4& transform);
+
+/// @return The matrix a quantized transform stands for.
+simd::float4x4 replication_dequantize(const ReplicatedTransform& transform);
+
+/// @return A colour packed as ReplicatedEntity::color.
+uint32_t replication_pack_color(simd::float3 color);
+
+/// @return The colour of a packed ReplicatedEntity::color.
+simd::float3 replication_unpack_color(uint32_t color);
+
+/**
+ * @brief Collects the entities in the terrain chunks around a viewpoint.
+ *
+ * The scene's BVH is queried with the box of chunks within radius of the viewpoint's chunk,
+ * so the cost follows the entities there rather than the whole scene.
+ *
+ * @param scene The scene, with bounds up to date.
+ * @param eye The client's viewpoint.
+ * @param chunkSize World side of a terrain chunk.
+ * @param radius Chunks around the viewpoint's chunk, along x and z, whose entities are included.
+ * @param time Server clock time of the snapshot.
+ * @param query Scratch for the BVH query.
+ * @param snapshot Receives the entities, sorted by index; its sequence is left alone.
+ */
+void replication_gather(const SceneStore& scene, simd::float3 eye, float chunkSize, int32_t radius, double time,
+                        std::vector<Entity>& query, ReplicationSnapshot& snapshot);
+
+/**
+ * @brief Writes a snapshot as a delta against a baseline the client holds.
+ *
+ * Removals are written first, then changed and new entities by distance from the viewpoint,
+ * until the packet is full.
+ *
+ * @param baseline The snapshot the client acknowledged, or nullptr to send full entries.
+ * @param current The snapshot to send; its sequence must be set.
+ * @param eye The client's viewpoint, which orders the entries.
+ * @param packet Receives the bytes.
+ * @param capacity Bytes available; REPLICATION_MAX_PACKET for a datagram.
+ * @param sent Receives the snapshot the client rebuilds from this packet, the baseline of later ones.
+ * @return The number of bytes written.
+ */
+size_t replication_encode(const ReplicationSnapshot* baseline, const ReplicationSnapshot& current, simd::float3 eye,
+                          uint8_t* packet, size_t capacity, ReplicationSnapshot& sent);
+
+/**
+ * @brief Reads the sequence numbers a packet starts with.
+ * @param packet The bytes.
+ * @param size The number of bytes.
+ * @param sequence Receives the snapshot's sequence.
+ * @param baseline Receives the baseline's sequence, or REPLICATION_NO_BASELINE.
+ * @return False if the packet is too short.
+ */
+bool replication_peek(const uint8_t* packet, size_t size, uint32_t& sequence, uint32_t& baseline);
+
+/**
+ * @brief Rebuilds a snapshot from a packet and the baseline it names.
+ * @param packet The bytes written by replication_encode().
+ * @param size The number of bytes.
+ * @param baseline The snapshot with the sequence replication_peek() reported, or nullptr for none.
+ * @param snapshot Receives the snapshot.
+ * @return False if the packet is malformed or names a baseline that was not given.
+ */
+bool replication_decode(const uint8_t* packet, size_t size, const ReplicationSnapshot* baseline,
+                        ReplicationSnapshot& snapshot);
+
+/**
+ * @struct ReplicatedPose
+ * @brief An entity as a client draws it.
+ */
+struct ReplicatedPose {
+    Entity entity;              ///< The handle on the server.
+    uint32_t mesh = 0;          ///< Mesh handle.
+    uint32_t color = 0;         ///< Packed colour.
+    simd::float4x4 transform;   ///< Interpolated model matrix.
+};
+
+/**
+ * @brief Blends two snapshots of one client.
+ *
+ * Entities in both are interpolated, positions and scales linearly and rotations along the
+ * shorter arc; entities only in the later one appear at its pose.
+ *
+ * @param from The earlier snapshot.
+ * @param to The later snapshot.
+ * @param t The blend, 0 at from and 1 at to.
+ * @param poses Receives the entities of to, in its order.
+ */
+void replication_interpolate(const ReplicationSnapshot& from, const ReplicationSnapshot& to, float t,
+                             std::vector<ReplicatedPose>& poses);
@@ -0,0 +1,235 @@
+#include "replication_session.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    enum MessageType : uint8_t {
+        MESSAGE_SNAPSHOT = 1,   ///< Server to client: a replication_encode() packet.
+        MESSAGE_ACK = 2,        ///< Client to server: newest sequence held and the camera.
+    };
+
+    constexpr size_t ACK_BYTES = 1 + 4 + 3 * 4;
+
+    void put_u32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+
+    uint32_t get_u32(const uint8_t* in) {
+        return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+    }
+
+    void put_f32(uint8_t* out, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        put_u32(out, bits);
+    }
+
+    float get_f32(const uint8_t* in) {
+        const uint32_t bits = get_u32(in);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // A baseline must still be in the history and not in the slot the new snapshot overwrites
+    const ReplicationSnapshot* history_entry(const std::vector<ReplicationSnapshot>& history, uint32_t sequence,
+                                             uint32_t newer) {
+        if (sequence == REPLICATION_NO_BASELINE || newer - sequence >= REPLICATION_HISTORY) {
+            return nullptr;
+        }
+        const ReplicationSnapshot& entry = history[sequence % REPLICATION_HISTORY];
+        return entry.sequence == sequence ? &entry : nullptr;
+    }
+
+    void receive_acks(ReplicationServer& server, double time) {
+        uint8_t message[ACK_BYTES + 1];
+        UdpAddress from;
+        while (size_t size = udp_socket_receive(server.socket, from, message, sizeof(message))) {
+            if (size != ACK_BYTES || message[0] != MESSAGE_ACK) {
+                continue;
+            }
+            auto peer = std::find_if(server.peers.begin(), server.peers.end(),
+                                     [&](const ReplicationPeer& p) { return p.address == from; });
+            if (peer == server.peers.end()) {
+                ReplicationPeer joined;
+                joined.address = from;
+                joined.sent.resize(REPLICATION_HISTORY);
+                server.peers.push_back(std::move(joined));
+                peer = server.peers.end() - 1;
+            }
+            const uint32_t acked = get_u32(message + 1);
+            peer->eye = { get_f32(message + 5), get_f32(message + 9), get_f32(message + 13) };
+            peer->lastHeard = time;
+            // Acks may arrive out of order; only a newer one that was actually sent moves the baseline
+            if (acked != REPLICATION_NO_BASELINE && acked < peer->sequence &&
+                (peer->acked == REPLICATION_NO_BASELINE || acked > peer->acked)) {
+                peer->acked = acked;
+            }
+        }
+    }
+
+    void receive_snapshots(ReplicationClient& client, double now) {
+        uint8_t packet[REPLICATION_MAX_PACKET];
+        ReplicationSnapshot incoming;
+        UdpAddress from;
+        client.bytesReceived = 0;
+        while (size_t size = udp_socket_receive(client.socket, from, packet, sizeof(packet))) {
+            uint32_t sequence = 0;
+            uint32_t baselineSequence = 0;
+            if (!(from == client.server) || packet[0] != MESSAGE_SNAPSHOT ||
+                !replication_peek(packet + 1, size - 1, sequence, baselineSequence)) {
+                continue;
+            }
+            client.bytesReceived += size;
+            const ReplicationSnapshot* baseline = history_entry(client.received, baselineSequence, sequence);
+            if (!replication_decode(packet + 1, size - 1, baseline, incoming)) {
+                continue; // Its baseline was lost or is too old; a later packet will name a newer one
+            }
+            // The least delayed packet gives the best estimate of the server's clock
+            const double offset = incoming.time - now;
+            client.clockOffset = client.synced ? std::max(client.clockOffset, offset) : offset;
+            client.synced = true;
+            if (client.latest == REPLICATION_NO_BASELINE || sequence > client.latest) {
+                client.latest = sequence;
+            }
+            std::swap(client.received[sequence % REPLICATION_HISTORY], incoming);
+        }
+    }
+
+    void apply_poses(ReplicationClient& client, SceneStore& scene, const std::vector<BoundingBox>& meshBounds) {
+        ++client.updates;
+        for (const ReplicatedPose& pose : client.poses) {
+            const uint32_t index = pose.entity.index;
+            if (index >= client.mirrors.size()) {
+                client.mirrors.resize(index + 1);
+                client.seen.resize(index + 1, 0);
+            }
+            client.seen[index] = client.updates;
+            Entity& mirror = client.mirrors[index];
+            if (scene_alive(scene, mirror)) {
+                scene_set_transform(scene, mirror, pose.transform);
+                continue;
+            }
+            // The starting scene is the same on both sides, so the server's handle names the same entity here
+            const uint32_t local = scene_index(scene, pose.entity);
+            const bool ours = pose.entity.index < client.created.size() && client.created[pose.entity.index];
+            if (local != UINT32_MAX && !ours && scene.meshes[local] == pose.mesh) {
+                mirror = pose.entity;
+                scene_set_transform(scene, mirror, pose.transform);
+            } else if (pose.mesh < meshBounds.size()) {
+                mirror = scene_create(scene, pose.mesh, meshBounds[pose.mesh], pose.transform,
+                                      replication_unpack_color(pose.color));
+                if (mirror.index >= client.created.size()) {
+                    client.created.resize(mirror.index + 1, 0);
+                }
+                client.created[mirror.index] = 1;
+            }
+        }
+        // Entities the server stopped sending: created ones go, adopted ones stay where they were last seen
+        for (uint32_t index = 0; index < client.mirrors.size(); ++index) {
+            Entity& mirror = client.mirrors[index];
+            if (client.seen[index] == client.updates || !scene_alive(scene, mirror)) {
+                continue;
+            }
+            if (mirror.index < client.created.size() && client.created[mirror.index]) {
+                client.created[mirror.index] = 0;
+                scene_destroy(scene, mirror);
+            }
+            mirror = Entity{};
+        }
+    }
+}
+
+bool replication_server_open(ReplicationServer& server, uint16_t port, const ReplicationSettings& settings,
+                             std::string& error) {
+    server.settings = settings;
+    server.peers.clear();
+    return udp_socket_open(server.socket, port, error);
+}
+
+void replication_server_update(ReplicationServer& server, const SceneStore& scene, double time) {
+    receive_acks(server, time);
+    const double timeout = server.settings.timeout;
+    server.peers.erase(std::remove_if(server.peers.begin(), server.peers.end(),
+                                      [&](const ReplicationPeer& peer) { return time - peer.lastHeard > timeout; }),
+                       server.peers.end());
+    if (server.lastSend >= 0.0 && time - server.lastSend < server.settings.sendInterval) {
+        return;
+    }
+    server.lastSend = time;
+    server.bytesSent = 0;
+
+    uint8_t packet[REPLICATION_MAX_PACKET];
+    packet[0] = MESSAGE_SNAPSHOT;
+    for (ReplicationPeer& peer : server.peers) {
+        replication_gather(scene, peer.eye, server.settings.chunkSize, server.settings.interestRadius, time,
+                           server.query, server.gathered);
+        server.gathered.sequence = peer.sequence++;
+        const ReplicationSnapshot* baseline = history_entry(peer.sent, peer.acked, server.gathered.sequence);
+        ReplicationSnapshot& sent = peer.sent[server.gathered.sequence % REPLICATION_HISTORY];
+        const size_t size = 1 + replication_encode(baseline, server.gathered, peer.eye, packet + 1,
+                                                   sizeof(packet) - 1, sent);
+        if (udp_socket_send(server.socket, peer.address, packet, size)) {
+            server.bytesSent += size;
+        }
+    }
+}
+
+bool replication_client_open(ReplicationClient& client, const UdpAddress& server, const ReplicationSettings& settings,
+                             std::string& error) {
+    client.server = server;
+    client.settings = settings;
+    client.received.assign(REPLICATION_HISTORY, ReplicationSnapshot{});
+    client.latest = REPLICATION_NO_BASELINE;
+    client.synced = false;
+    client.lastAck = -1.0;
+    return udp_socket_open(client.socket, 0, error);
+}
+
+void replication_client_update(ReplicationClient& client, SceneStore& scene, const std::vector<BoundingBox>& meshBounds,
+                               simd::float3 eye, double now) {
+    receive_snapshots(client, now);
+    if (client.lastAck < 0.0 || now - client.lastAck >= client.settings.sendInterval) {
+        uint8_t ack[ACK_BYTES];
+        ack[0] = MESSAGE_ACK;
+        put_u32(ack + 1, client.latest);
+        put_f32(ack + 5, eye.x);
+        put_f32(ack + 9, eye.y);
+        put_f32(ack + 13, eye.z);
+        udp_socket_send(client.socket, client.server, ack, sizeof(ack));
+        client.lastAck = now;
+    }
+    if (!client.synced) {
+        return;
+    }
+
+    // The two snapshots around the delayed server time, or the newest one when they ran out
+    const double renderTime = now + client.clockOffset - client.settings.interpolationDelay;
+    const ReplicationSnapshot* from = nullptr;
+    const ReplicationSnapshot* to = nullptr;
+    for (const ReplicationSnapshot& snapshot : client.received) {
+        if (snapshot.sequence == REPLICATION_NO_BASELINE || client.latest - snapshot.sequence >= REPLICATION_HISTORY) {
+            continue;
+        }
+        if (snapshot.time <= renderTime && (!from || snapshot.time > from->time)) {
+            from = &snapshot;
+        }
+        if (snapshot.time >= renderTime && (!to || snapshot.time < to->time)) {
+            to = &snapshot;
+        }
+    }
+    if (!to) {
+        to = &client.received[client.latest % REPLICATION_HISTORY];
+        from = to;
+    }
+    if (!from) {
+        from = to;
+    }
+    const double span = to->time - from->time;
+    const float t = span > 0.0 ? (float)std::clamp((renderTime - from->time) / span, 0.0, 1.0) : 1.0f;
+    replication_interpolate(*from, *to, t, client.poses);
+    apply_poses(client, scene, meshBounds);
+}
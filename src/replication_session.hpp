@@ -0,0 +1,130 @@
+/**
+ * @file replication_session.hpp
+ * @brief A server streaming its scene to observers over UDP, and the observers applying it.
+ *
+ * Clients say hello by acknowledging: every ack carries the newest snapshot they hold and
+ * their camera, which is all the server keeps of them besides the snapshots it sent. At the
+ * send rate the server gathers each client's interest area, encodes it against the acked
+ * snapshot (replication.hpp) and sends one datagram. A lost packet only means the next delta
+ * is taken against an older baseline; a client silent for a while is dropped.
+ *
+ * Clients hold the last REPLICATION_HISTORY snapshots and draw the scene a fixed delay behind
+ * the server's clock, interpolating between the two snapshots around that time, so jitter in
+ * arrival and a lost packet or two do not show. Both sides run the same program and build the
+ * same meshes and starting scene, so an entity the client already has under the server's
+ * handle is moved in place; anything else is created for as long as the server sends it.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "objects.hpp"
+#include "replication.hpp"
+#include "scene.hpp"
+#include "udp_socket.hpp"
+
+/**
+ * @struct ReplicationSettings
+ * @brief Rates and reach shared by the server and its clients.
+ */
+struct ReplicationSettings {
+    float chunkSize = 32.0f;            ///< Terrain chunk side; interest is counted in these.
+    int32_t interestRadius = 3;         ///< Chunks around a client's chunk whose entities it receives.
+    double sendInterval = 1.0 / 20.0;   ///< Seconds between snapshots, and between a client's acks.
+    double interpolationDelay = 0.1;    ///< Seconds clients draw behind the server; two send intervals.
+    double timeout = 5.0;               ///< Seconds of silence after which a client is dropped.
+};
+
+/**
+ * @struct ReplicationPeer
+ * @brief What the server knows of one client.
+ */
+struct ReplicationPeer {
+    UdpAddress address;                     ///< Where its acks come from.
+    simd::float3 eye = { 0.0f, 0.0f, 0.0f }; ///< Its camera, the centre of its interest area.
+    uint32_t acked = REPLICATION_NO_BASELINE; ///< Newest snapshot it holds.
+    uint32_t sequence = 0;                  ///< Number of the next snapshot sent to it.
+    double lastHeard = 0.0;                 ///< Server time of its last ack.
+    std::vector<ReplicationSnapshot> sent;  ///< What it rebuilt from each packet, by sequence modulo history.
+};
+
+/**
+ * @struct ReplicationServer
+ * @brief The listening socket and every client.
+ */
+struct ReplicationServer {
+    UdpSocket socket;                       ///< Bound to the listening port.
+    ReplicationSettings settings;           ///< Rates and reach.
+    std::vector<ReplicationPeer> peers;     ///< The clients heard from recently.
+    double lastSend = -1.0;                 ///< Server time of the last round of snapshots.
+    std::vector<Entity> query;              ///< Scratch for the interest queries.
+    ReplicationSnapshot gathered;           ///< Scratch for one client's snapshot.
+    size_t bytesSent = 0;                   ///< Bytes of the last round, over all clients.
+};
+
+/**
+ * @brief Starts listening for clients.
+ * @param server The server.
+ * @param port The UDP port.
+ * @param settings Rates and reach.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool replication_server_open(ReplicationServer& server, uint16_t port, const ReplicationSettings& settings,
+                             std::string& error);
+
+/**
+ * @brief Takes the clients' acks and, when a send is due, sends every client its snapshot.
+ * @param server The server.
+ * @param scene The scene, with bounds up to date.
+ * @param time Seconds on the server's clock.
+ */
+void replication_server_update(ReplicationServer& server, const SceneStore& scene, double time);
+
+/**
+ * @struct ReplicationClient
+ * @brief The connection to a server and the entities it mirrors.
+ */
+struct ReplicationClient {
+    UdpSocket socket;                       ///< Any local port.
+    UdpAddress server;                      ///< Where snapshots come from.
+    ReplicationSettings settings;           ///< Must match the server's.
+    std::vector<ReplicationSnapshot> received; ///< Snapshots by sequence modulo history.
+    uint32_t latest = REPLICATION_NO_BASELINE; ///< Newest sequence received.
+    double clockOffset = 0.0;               ///< Server clock minus local clock, from the fastest packet seen.
+    bool synced = false;                    ///< False until a snapshot arrived.
+    double lastAck = -1.0;                  ///< Local time of the last ack.
+    std::vector<ReplicatedPose> poses;      ///< Scratch for the interpolated entities.
+    std::vector<Entity> mirrors;            ///< Local entity of each server index, or a default Entity.
+    std::vector<uint8_t> created;           ///< By local handle slot: 1 if created for the server, removed with it.
+    std::vector<uint32_t> seen;             ///< Update in which each server index last appeared.
+    uint32_t updates = 0;                   ///< Updates run; stamps seen.
+    size_t bytesReceived = 0;               ///< Bytes of the last update's packets.
+};
+
+/**
+ * @brief Opens a socket towards a server; the first ack announces the client.
+ * @param client The client.
+ * @param server The server's address.
+ * @param settings Rates and reach; must match the server's.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool replication_client_open(ReplicationClient& client, const UdpAddress& server, const ReplicationSettings& settings,
+                             std::string& error);
+
+/**
+ * @brief Takes the snapshots that arrived, acks, and moves the mirrored entities to the delayed time.
+ * @param client The client.
+ * @param scene The local scene; mirrored entities are moved, created and destroyed in it.
+ * @param meshBounds Model space bounds of every mesh handle, for the entities created.
+ * @param eye The local camera, sent as the centre of the interest area.
+ * @param now Seconds on the local clock.
+ */
+void replication_client_update(ReplicationClient& client, SceneStore& scene, const std::vector<BoundingBox>& meshBounds,
+                               simd::float3 eye, double now);
@@ -0,0 +1,43 @@
+#include "reprojection.hpp"
+
+#include <cmath>
+
+simd::float4x4 view_history_previous(const ViewHistory& history, const simd::float4x4& current, uint32_t width,
+                                     uint32_t height) {
+    if (!history.valid || history.width != width || history.height != height) {
+        return current;
+    }
+    return history.viewProjection;
+}
+
+void view_history_push(ViewHistory& history, const simd::float4x4& viewProjection, uint32_t width, uint32_t height) {
+    history.viewProjection = viewProjection;
+    history.width = width;
+    history.height = height;
+    history.valid = true;
+}
+
+Reprojection reproject(const simd::float4x4& previousViewProjection, simd::float3 position) {
+    const simd::float4 clip = previousViewProjection * simd::float4{ position.x, position.y, position.z, 1.0f };
+    Reprojection reprojection;
+    // Perspective w is the view depth
+    reprojection.viewDepth = clip.w;
+    if (clip.w <= 0.0f) {
+        reprojection.uv = { -1.0f, -1.0f };
+        return reprojection;
+    }
+    reprojection.uv = { clip.x / clip.w * 0.5f + 0.5f, 0.5f - clip.y / clip.w * 0.5f };
+    return reprojection;
+}
+
+bool shading_cache_hit(const Reprojection& reprojection, float cachedDepth) {
+    if (reprojection.viewDepth <= 0.0f || reprojection.uv.x < 0.0f || reprojection.uv.x > 1.0f ||
+        reprojection.uv.y < 0.0f || reprojection.uv.y > 1.0f) {
+        return false;
+    }
+    return fabsf(cachedDepth - reprojection.viewDepth) <= SHADING_CACHE_DEPTH_TOLERANCE * reprojection.viewDepth;
+}
+
+bool shading_cache_refresh(uint32_t x, uint32_t y, uint32_t frame) {
+    return (x & 1) + 2 * (y & 1) == frame % SHADING_CACHE_REFRESH_FRAMES;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file reprojection.hpp
+ * @brief The previous frame's camera, and the reverse reprojection cache that reuses its shading.
+ *
+ * A ViewHistory keeps the last frame's unjittered view-projection. FrameUniforms carries it as
+ * previousViewProjection, and the temporal scaler's motion vectors are built from the same
+ * matrix, so every pass that looks back a frame agrees on where a surface was.
+ *
+ * The shading cache (Nehab et al., "Accelerating Real-Time Shading with Reverse Reprojection
+ * Caching", 2007) keeps, per pixel, the shadow visibility a fragment computed and the view
+ * depth it was at. The next frame, a fragment carries its world position through
+ * previousViewProjection to find where it was drawn; if the cached depth there matches its
+ * previous view depth it saw the same surface, and it reuses the visibility instead of filtering
+ * the shadow map again. The sun and the terrain are static, so the visibility of a world point
+ * holds from frame to frame; in case it does not, e.g. under a moving caster or after an edit,
+ * one pixel of every 2x2 block recomputes each frame whatever the cache holds, so a stale value
+ * lasts SHADING_CACHE_REFRESH_FRAMES frames at most.
+ *
+ * These functions mirror cached_shadow_visibility in shaders.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+/// Frames between recomputations of a pixel's cached terms, one pixel of each 2x2 block per frame.
+constexpr uint32_t SHADING_CACHE_REFRESH_FRAMES = 4;
+/// Largest difference between the cached and the expected view depth, relative to the expected one.
+constexpr float SHADING_CACHE_DEPTH_TOLERANCE = 0.02f;
+
+/**
+ * @struct ViewHistory
+ * @brief The camera of the last frame rendered at a given size.
+ */
+struct ViewHistory {
+    simd::float4x4 viewProjection;  ///< Unjittered world to clip transform of the last frame pushed.
+    uint32_t width = 0;             ///< Render target size of that frame.
+    uint32_t height = 0;
+    bool valid = false;             ///< False until a frame was pushed.
+};
+
+/**
+ * @brief Returns the view-projection to reproject this frame's surfaces with.
+ * @param history The history.
+ * @param current This frame's unjittered view-projection.
+ * @param width This frame's render target width.
+ * @param height This frame's render target height.
+ * @return The last frame's view-projection, or current if there is none at this size.
+ */
+simd::float4x4 view_history_previous(const ViewHistory& history, const simd::float4x4& current, uint32_t width,
+                                     uint32_t height);
+
+/// @brief Records this frame's unjittered view-projection and render target size for the next frame.
+void view_history_push(ViewHistory& history, const simd::float4x4& viewProjection, uint32_t width, uint32_t height);
+
+/**
+ * @struct Reprojection
+ * @brief Where a world position was in the previous frame.
+ */
+struct Reprojection {
+    simd::float2 uv;    ///< Texture coordinates in the previous frame, y down.
+    float viewDepth;    ///< View depth in the previous frame; not positive if it was behind the camera.
+};
+
+/// @return Where a world position was under previousViewProjection.
+Reprojection reproject(const simd::float4x4& previousViewProjection, simd::float3 position);
+
+/**
+ * @brief Returns true if a cache entry was written by the surface a reprojection expects.
+ * @param reprojection The fragment's reprojection.
+ * @param cachedDepth View depth stored at reprojection.uv.
+ * @return True if the position was in front of the previous camera and on screen, and the depths agree.
+ */
+bool shading_cache_hit(const Reprojection& reprojection, float cachedDepth);
+
+/// @return True if a pixel recomputes its cached terms on a frame regardless of the cache.
+bool shading_cache_refresh(uint32_t x, uint32_t y, uint32_t frame);
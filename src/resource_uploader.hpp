@@ -0,0 +1,195 @@
+/**
+ * @file resource_uploader.hpp
+ * @brief Uploads static GPU data into private buffers through a staging ring.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <deque>
+#include <mutex>
+
+#include "upload_budget.hpp"
+
+/// Default size of the shared staging ring.
+constexpr size_t DEFAULT_STAGING_CAPACITY = 8 * 1024 * 1024;
+
+/// Alignment of staging sub-allocations; satisfies the blit offset rules.
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+/**
+ * @struct UploadQueueStats
+ * @brief Throttled uploads waiting for their frame, and what the current frame sent.
+ */
+struct UploadQueueStats {
+    size_t queuedBatches = 0;   ///< Batches sealed by flush_throttled() and not committed yet.
+    size_t queuedBytes = 0;     ///< Upload bytes of those batches.
+    size_t frameBytes = 0;      ///< Bytes begin_frame() committed this frame.
+    double bytesPerMs = 0.0;    ///< Measured copy throughput; 0 until a batch has been timed.
+};
+
+/**
+ * @class ResourceUploader
+ * @brief Copies CPU data into MTLStorageModePrivate buffers on a dedicated blit queue.
+ *
+ * upload() writes the data into a reusable shared staging ring and encodes a blit
+ * into the returned private buffer; flush() commits the pending blits and returns
+ * the MTLSharedEvent value signalled once they have landed. Consumers either gate on
+ * is_complete() or make a command buffer wait on the GPU with encode_wait(), so the
+ * render thread never blocks on an upload. Safe to call from several threads.
+ *
+ * Streamed data goes through flush_throttled() instead, which queues the blits for
+ * begin_frame() to commit within the frame's UploadBudgetSettings. Blits are grouped into
+ * command buffers of at most sliceBytes, splitting large uploads, so one big upload is
+ * spread over several frames rather than copied in one.
+ */
+class ResourceUploader {
+public:
+    explicit ResourceUploader(id<MTLDevice> device, size_t stagingCapacity = DEFAULT_STAGING_CAPACITY,
+                              const UploadBudgetSettings& budget = {});
+
+    ResourceUploader(const ResourceUploader&) = delete;
+    ResourceUploader& operator=(const ResourceUploader&) = delete;
+
+    /**
+     * @brief Creates a private buffer and schedules a copy of data into it.
+     *
+     * The buffer must not be read until the value returned by the next flush() is complete.
+     * Blocks only when the staging ring is full of blits the GPU has not finished.
+     *
+     * @param data The bytes to upload.
+     * @param length The number of bytes.
+     * @param label Optional debug label of the new buffer.
+     * @return The private destination buffer.
+     */
+    id<MTLBuffer> upload(const void* data, size_t length, NSString* label = nil);
+
+    /**
+     * @brief Creates a private texture and schedules a copy of data into its first slice and level.
+     *
+     * Follows the same rules as upload().
+     *
+     * @param descriptor Describes the 2D texture; its storage mode is replaced by private.
+     * @param data The texels, row after row with no padding.
+     * @param bytesPerRow The bytes of one row of data.
+     * @param label Optional debug label of the new texture.
+     * @return The private destination texture.
+     */
+    id<MTLTexture> upload_texture(MTLTextureDescriptor* descriptor, const void* data, size_t bytesPerRow,
+                                  NSString* label = nil);
+
+    /**
+     * @brief Schedules a copy of data into part of an existing private buffer.
+     *
+     * Follows the same rules as upload(); the rest of the buffer is left as it is.
+     *
+     * @param destination The buffer to patch.
+     * @param offset The byte offset of the range in destination; a multiple of 4.
+     * @param data The bytes to copy.
+     * @param length The number of bytes.
+     */
+    void update(id<MTLBuffer> destination, size_t offset, const void* data, size_t length);
+
+    /**
+     * @brief Schedules a copy of data into a region of an existing private 2D texture.
+     *
+     * Follows the same rules as upload().
+     *
+     * @param destination The texture to patch; its first slice and level are written.
+     * @param region The texels to replace.
+     * @param data The texels of region, row after row with no padding.
+     * @param bytesPerRow The bytes of one row of data.
+     */
+    void update_texture(id<MTLTexture> destination, MTLRegion region, const void* data, size_t bytesPerRow);
+
+    /**
+     * @brief Commits all blits encoded since the last flush, and any still queued, right away.
+     * @return The event value signalled when every upload so far has completed.
+     */
+    uint64_t flush();
+
+    /**
+     * @brief Queues the blits encoded since the last flush for begin_frame() to commit.
+     *
+     * Their value completes a frame or more later than with flush(); an encode_wait() on it
+     * holds its command buffer until then. Blits also go early when the staging ring is full.
+     *
+     * @return The event value signalled when every upload so far has completed.
+     */
+    uint64_t flush_throttled();
+
+    /**
+     * @brief Commits queued batches, oldest first, until the frame's budget is spent.
+     *
+     * Call once per frame from the render thread; also measures the copy throughput of the
+     * batches that finished.
+     */
+    void begin_frame();
+
+    /// @return The queue depth and the current frame's upload bytes.
+    UploadQueueStats queue_stats() const;
+
+    /// @return True once the uploads covered by a flush() value are on the GPU.
+    bool is_complete(uint64_t value) const { return m_event.signaledValue >= value; }
+
+    /**
+     * @brief Makes a command buffer wait on the GPU for the uploads covered by a flush() value.
+     * @param cmd A command buffer that has not been encoded into yet.
+     * @param value A value returned by flush().
+     */
+    void encode_wait(id<MTLCommandBuffer> cmd, uint64_t value) const {
+        [cmd encodeWaitForEvent:m_event value:value];
+    }
+
+    /// @return The event flush() values are signalled on; for waits that are not a command buffer.
+    id<MTLSharedEvent> event() const { return m_event; }
+
+    /// @return Bytes uploaded since creation.
+    size_t uploaded_bytes() const;
+
+    /// @return GPU bytes of the staging ring.
+    size_t staging_bytes() const { return m_staging.allocatedSize; }
+
+    /// @return The device the uploader creates its buffers on.
+    id<MTLDevice> device() const { return m_device; }
+
+private:
+    struct Batch {
+        id<MTLCommandBuffer> cmd;   ///< The committed blit command buffer.
+        uint64_t value;             ///< Event value it signals.
+        size_t stagingBytes;        ///< Staging ring bytes, including wrap padding, it holds.
+        size_t uploadBytes;         ///< Bytes it copies; what the frame budget counts.
+    };
+
+    id<MTLBuffer> stage_locked(const void* data, size_t length, size_t& offset);
+    id<MTLBlitCommandEncoder> pending_encoder_locked();
+    size_t begin_copy_locked(size_t remaining);
+    size_t reserve_staging(size_t length);
+    void seal_pending_locked();
+    void commit_ready_locked(size_t count);
+    uint64_t flush_locked();
+    void retire_completed();
+    void copy_texture_rows_locked(id<MTLTexture> destination, MTLRegion region, const void* data,
+                                  size_t bytesPerRow);
+
+    id<MTLDevice> m_device;
+    id<MTLCommandQueue> m_queue;
+    id<MTLSharedEvent> m_event;
+    id<MTLBuffer> m_staging;
+    size_t m_capacity;
+    size_t m_head = 0;              ///< Next free byte of the staging ring.
+    size_t m_used = 0;              ///< Bytes between the oldest unretired batch and m_head.
+
+    id<MTLCommandBuffer> m_pending;             ///< Blits encoded but not committed yet.
+    id<MTLBlitCommandEncoder> m_pendingEncoder;
+    size_t m_pendingBytes = 0;
+    size_t m_pendingUploadBytes = 0;            ///< Bytes the pending blits copy.
+    std::deque<Batch> m_ready;                  ///< Sealed batches waiting for begin_frame(), oldest first.
+    std::deque<Batch> m_inFlight;               ///< Committed batches, oldest first.
+    uint64_t m_lastValue = 0;
+    size_t m_uploadedBytes = 0;
+    UploadBudgetSettings m_budgetSettings;
+    UploadBudget m_budget;
+
+    mutable std::mutex m_mutex;
+};
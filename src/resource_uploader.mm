@@ -0,0 +1,230 @@
+#import "resource_uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+ResourceUploader::ResourceUploader(id<MTLDevice> device, size_t stagingCapacity, const UploadBudgetSettings& budget)
+    : m_device(device), m_capacity(stagingCapacity), m_budgetSettings(budget) {
+    // Slices keep the blit offsets aligned
+    if (m_budgetSettings.sliceBytes > 0) {
+        const size_t aligned = m_budgetSettings.sliceBytes & ~(STAGING_ALIGNMENT - 1);
+        m_budgetSettings.sliceBytes = std::max(aligned, STAGING_ALIGNMENT);
+    }
+    m_queue = [m_device newCommandQueue];
+    m_queue.label = @"Resource uploads";
+    m_event = [m_device newSharedEvent];
+    m_staging = [m_device newBufferWithLength:m_capacity options:MTLResourceStorageModeShared];
+    m_staging.label = @"Staging ring";
+}
+
+id<MTLBuffer> ResourceUploader::upload(const void* data, size_t length, NSString* label) {
+    id<MTLBuffer> destination = [m_device newBufferWithLength:length options:MTLResourceStorageModePrivate];
+    destination.label = label;
+
+    update(destination, 0, data, length);
+    return destination;
+}
+
+id<MTLTexture> ResourceUploader::upload_texture(MTLTextureDescriptor* descriptor, const void* data,
+                                                size_t bytesPerRow, NSString* label) {
+    descriptor.storageMode = MTLStorageModePrivate;
+    id<MTLTexture> destination = [m_device newTextureWithDescriptor:descriptor];
+    destination.label = label;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    copy_texture_rows_locked(destination, MTLRegionMake2D(0, 0, descriptor.width, descriptor.height), data,
+                             bytesPerRow);
+    return destination;
+}
+
+void ResourceUploader::update(id<MTLBuffer> destination, size_t offset, const void* data, size_t length) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t done = 0; done < length;) {
+        const size_t slice = begin_copy_locked(length - done);
+        size_t sourceOffset = 0;
+        id<MTLBuffer> source = stage_locked((const uint8_t*)data + done, slice, sourceOffset);
+        [pending_encoder_locked() copyFromBuffer:source
+                                    sourceOffset:sourceOffset
+                                        toBuffer:destination
+                               destinationOffset:offset + done
+                                            size:slice];
+        m_pendingUploadBytes += slice;
+        done += slice;
+    }
+    m_uploadedBytes += length;
+}
+
+void ResourceUploader::update_texture(id<MTLTexture> destination, MTLRegion region, const void* data,
+                                      size_t bytesPerRow) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    copy_texture_rows_locked(destination, region, data, bytesPerRow);
+}
+
+void ResourceUploader::copy_texture_rows_locked(id<MTLTexture> destination, MTLRegion region, const void* data,
+                                                size_t bytesPerRow) {
+    const uint32_t rows = (uint32_t)region.size.height;
+    const uint32_t sliceRows = upload_slice_rows(bytesPerRow, rows, m_budgetSettings.sliceBytes);
+    for (uint32_t row = 0; row < rows; row += sliceRows) {
+        const uint32_t count = std::min(sliceRows, rows - row);
+        const size_t length = bytesPerRow * count;
+        begin_copy_locked(length);
+        size_t sourceOffset = 0;
+        id<MTLBuffer> source = stage_locked((const uint8_t*)data + bytesPerRow * row, length, sourceOffset);
+        [pending_encoder_locked() copyFromBuffer:source
+                                    sourceOffset:sourceOffset
+                               sourceBytesPerRow:bytesPerRow
+                             sourceBytesPerImage:length
+                                      sourceSize:MTLSizeMake(region.size.width, count, 1)
+                                       toTexture:destination
+                                destinationSlice:0
+                                destinationLevel:0
+                               destinationOrigin:MTLOriginMake(region.origin.x, region.origin.y + row, 0)];
+        m_pendingUploadBytes += length;
+    }
+    m_uploadedBytes += bytesPerRow * rows;
+}
+
+uint64_t ResourceUploader::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return flush_locked();
+}
+
+uint64_t ResourceUploader::flush_throttled() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    seal_pending_locked();
+    return m_lastValue;
+}
+
+void ResourceUploader::begin_frame() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    retire_completed();
+    upload_budget_begin_frame(m_budget);
+    size_t count = 0;
+    while (count < m_ready.size() && upload_budget_admit(m_budget, m_budgetSettings, m_ready[count].uploadBytes)) {
+        count++;
+    }
+    commit_ready_locked(count);
+}
+
+UploadQueueStats ResourceUploader::queue_stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    UploadQueueStats stats;
+    stats.queuedBatches = m_ready.size();
+    for (const Batch& batch : m_ready) {
+        stats.queuedBytes += batch.uploadBytes;
+    }
+    stats.frameBytes = m_budget.frameBytes;
+    stats.bytesPerMs = m_budget.bytesPerMs;
+    return stats;
+}
+
+size_t ResourceUploader::uploaded_bytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_uploadedBytes;
+}
+
+uint64_t ResourceUploader::flush_locked() {
+    // Queued batches go first: the event values have to be signalled in order
+    seal_pending_locked();
+    commit_ready_locked(m_ready.size());
+    return m_lastValue;
+}
+
+void ResourceUploader::seal_pending_locked() {
+    if (!m_pending) {
+        return;
+    }
+
+    [m_pendingEncoder endEncoding];
+    [m_pending encodeSignalEvent:m_event value:++m_lastValue];
+    m_ready.push_back({ m_pending, m_lastValue, m_pendingBytes, m_pendingUploadBytes });
+
+    m_pending = nil;
+    m_pendingEncoder = nil;
+    m_pendingBytes = 0;
+    m_pendingUploadBytes = 0;
+}
+
+void ResourceUploader::commit_ready_locked(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        [m_ready.front().cmd commit];
+        m_inFlight.push_back(m_ready.front());
+        m_ready.pop_front();
+    }
+}
+
+void ResourceUploader::retire_completed() {
+    uint64_t signaled = m_event.signaledValue;
+    while (!m_inFlight.empty() && (m_inFlight.front().value <= signaled ||
+                                   m_inFlight.front().cmd.status == MTLCommandBufferStatusCompleted)) {
+        const Batch& batch = m_inFlight.front();
+        if (batch.cmd.status == MTLCommandBufferStatusCompleted) {
+            upload_budget_measure(m_budget, m_budgetSettings, batch.uploadBytes,
+                                  (batch.cmd.GPUEndTime - batch.cmd.GPUStartTime) * 1000.0);
+        }
+        m_used -= batch.stagingBytes;
+        m_inFlight.pop_front();
+    }
+}
+
+id<MTLBuffer> ResourceUploader::stage_locked(const void* data, size_t length, size_t& offset) {
+    size_t aligned = (length + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    if (aligned > m_capacity) {
+        // Too large for the ring; a one-off staging buffer is kept alive by the command buffer
+        offset = 0;
+        return [m_device newBufferWithBytes:data length:length options:MTLResourceStorageModeShared];
+    }
+    offset = reserve_staging(aligned);
+    memcpy((uint8_t*)m_staging.contents + offset, data, length);
+    return m_staging;
+}
+
+size_t ResourceUploader::begin_copy_locked(size_t remaining) {
+    const size_t sliceBytes = m_budgetSettings.sliceBytes;
+    if (sliceBytes == 0) {
+        return remaining;
+    }
+    // A batch never holds more than a slice: copies that would overflow it start the next one
+    const size_t length = std::min(remaining, sliceBytes);
+    if (m_pendingUploadBytes > 0 && m_pendingUploadBytes + length > sliceBytes) {
+        seal_pending_locked();
+    }
+    return length;
+}
+
+id<MTLBlitCommandEncoder> ResourceUploader::pending_encoder_locked() {
+    if (!m_pending) {
+        m_pending = [m_queue commandBuffer];
+        m_pendingEncoder = [m_pending blitCommandEncoder];
+    }
+    return m_pendingEncoder;
+}
+
+size_t ResourceUploader::reserve_staging(size_t length) {
+    for (;;) {
+        retire_completed();
+        if (m_used == 0) {
+            m_head = 0;
+        }
+
+        // Allocations never straddle the end of the ring; the skipped tail counts as used
+        size_t padding = m_head + length > m_capacity ? m_capacity - m_head : 0;
+        if (m_used + padding + length <= m_capacity) {
+            size_t offset = padding ? 0 : m_head;
+            m_head = offset + length;
+            m_used += padding + length;
+            m_pendingBytes += padding + length;
+            return offset;
+        }
+
+        // Full: the space outranks the frame budget, so the oldest queued batch, or the pending blits, go now;
+        // then wait for the oldest batch
+        if (m_inFlight.empty()) {
+            if (m_ready.empty()) {
+                seal_pending_locked();
+            }
+            commit_ready_locked(1);
+        }
+        [m_inFlight.front().cmd waitUntilCompleted];
+    }
+}
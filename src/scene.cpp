@@ -0,0 +1,310 @@
+#include "scene.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "fog.hpp"
+#include "memory_report.hpp"
+
+namespace {
+    template <typename T>
+    void remove_swap(std::vector<T>& array, size_t index) {
+        array[index] = array.back();
+        array.pop_back();
+    }
+
+    BoundingBox world_bounds(const CullBounds& bounds, size_t index) {
+        simd::float3 center = { bounds.centerX[index], bounds.centerY[index], bounds.centerZ[index] };
+        simd::float3 extent = { bounds.extentX[index], bounds.extentY[index], bounds.extentZ[index] };
+        return { center - extent, center + extent };
+    }
+
+    float axis_length(simd::float4 column) {
+        return simd::length(simd::float3{ column.x, column.y, column.z });
+    }
+
+    Entity entity_of_slot(const SceneStore& scene, uint32_t slot) {
+        Entity entity;
+        entity.index = slot;
+        entity.generation = scene.generations[slot];
+        return entity;
+    }
+
+    void mark_instance(SceneStore& scene, uint32_t index) {
+        if (!scene.instanceFlags[index]) {
+            scene.instanceFlags[index] = 1;
+            scene.instanceDirty.push_back(index);
+        }
+    }
+
+    InstanceData instance_of(const SceneStore& scene, uint32_t index) {
+        InstanceData instance;
+        instance.modelMatrix = scene.transforms[index];
+        const simd::float3 color = scene.colors[index];
+        instance.color = { color.x, color.y, color.z, 0.0f };
+        return instance;
+    }
+
+    // Counting sort by mesh and level: count, turn the counts into first indices, then scatter. write(slot, v)
+    // receives the slot of visible[v] within its batch's run.
+    template <typename Write>
+    void group_instances(const SceneStore& scene, const uint32_t* visible, size_t visibleCount,
+                         std::vector<SceneBatch>& batches, const uint8_t* lods, Write write) {
+        batches.clear();
+        if (visibleCount == 0) {
+            return;
+        }
+
+        const auto key = [&](size_t v) {
+            return scene.meshes[visible[v]] * MESH_LOD_MAX_LEVELS + (lods ? lods[v] : 0u);
+        };
+        uint32_t keyCount = 0;
+        for (size_t v = 0; v < visibleCount; ++v) {
+            keyCount = std::max(keyCount, key(v) + 1);
+        }
+        batches.resize(keyCount);
+        for (uint32_t k = 0; k < keyCount; ++k) {
+            batches[k].mesh = k / MESH_LOD_MAX_LEVELS;
+            batches[k].lod = k % MESH_LOD_MAX_LEVELS;
+        }
+        for (size_t v = 0; v < visibleCount; ++v) {
+            batches[key(v)].count++;
+        }
+        uint32_t first = 0;
+        for (SceneBatch& batch : batches) {
+            batch.first = first;
+            first += batch.count;
+            batch.count = 0;
+        }
+        for (size_t v = 0; v < visibleCount; ++v) {
+            SceneBatch& batch = batches[key(v)];
+            write(batch.first + batch.count++, v);
+        }
+
+        batches.erase(std::remove_if(batches.begin(), batches.end(),
+                                     [](const SceneBatch& b) { return b.count == 0; }),
+                      batches.end());
+    }
+}
+
+void scene_reserve(SceneStore& scene, size_t capacity) {
+    scene.transforms.reserve(capacity);
+    scene.colors.reserve(capacity);
+    scene.meshes.reserve(capacity);
+    scene.localBounds.reserve(capacity);
+    cull_bounds_reserve(scene.worldBounds, capacity);
+    scene.proxies.reserve(capacity);
+    scene.owners.reserve(capacity);
+    scene.dense.reserve(capacity);
+    scene.generations.reserve(capacity);
+    scene.freeSlots.reserve(capacity);
+    scene.dirty.reserve(capacity);
+    scene.instanceDirty.reserve(capacity);
+    scene.instanceFlags.reserve(capacity);
+    bvh_reserve(scene.bvh, capacity);
+}
+
+Entity scene_create(SceneStore& scene, uint32_t mesh, const BoundingBox& meshBounds,
+                    const simd::float4x4& transform, simd::float3 color) {
+    Entity entity;
+    if (!scene.freeSlots.empty()) {
+        entity.index = scene.freeSlots.back();
+        scene.freeSlots.pop_back();
+    } else {
+        entity.index = (uint32_t)scene.dense.size();
+        scene.dense.push_back(UINT32_MAX);
+        scene.generations.push_back(0);
+    }
+    entity.generation = scene.generations[entity.index];
+
+    scene.dense[entity.index] = (uint32_t)scene.size();
+    scene.owners.push_back(entity.index);
+    scene.transforms.push_back(transform);
+    scene.colors.push_back(color);
+    scene.meshes.push_back(mesh);
+    scene.localBounds.push_back(meshBounds);
+    const BoundingBox worldBox = transform_bounds(meshBounds, transform);
+    cull_bounds_add(scene.worldBounds, worldBox);
+    scene.proxies.push_back(bvh_insert(scene.bvh, worldBox, entity.index));
+    scene.instanceFlags.push_back(0);
+    mark_instance(scene, scene.dense[entity.index]);
+    return entity;
+}
+
+void scene_destroy(SceneStore& scene, Entity entity) {
+    const uint32_t index = scene_index(scene, entity);
+    if (index == UINT32_MAX) {
+        return;
+    }
+
+    // The last entity takes over the hole; its handle slot follows it
+    const uint32_t last = (uint32_t)scene.size() - 1;
+    scene.dense[scene.owners[last]] = index;
+    bvh_remove(scene.bvh, scene.proxies[index]);
+    remove_swap(scene.proxies, index);
+    remove_swap(scene.owners, index);
+    remove_swap(scene.transforms, index);
+    remove_swap(scene.colors, index);
+    remove_swap(scene.meshes, index);
+    remove_swap(scene.localBounds, index);
+    cull_bounds_remove_swap(scene.worldBounds, index);
+
+    // Pending bounds updates follow the moved entity too
+    scene.dirty.erase(std::remove(scene.dirty.begin(), scene.dirty.end(), index), scene.dirty.end());
+    std::replace(scene.dirty.begin(), scene.dirty.end(), last, index);
+
+    // The last element is gone; the hole now holds the moved entity's instance, which the GPU copy lacks
+    if (scene.instanceFlags[last]) {
+        scene.instanceDirty.erase(std::find(scene.instanceDirty.begin(), scene.instanceDirty.end(), last));
+    }
+    if (index != last) {
+        mark_instance(scene, index);
+    }
+    scene.instanceFlags.pop_back();
+
+    scene.dense[entity.index] = UINT32_MAX;
+    scene.generations[entity.index]++;
+    scene.freeSlots.push_back(entity.index);
+}
+
+bool scene_alive(const SceneStore& scene, Entity entity) {
+    return scene_index(scene, entity) != UINT32_MAX;
+}
+
+uint32_t scene_index(const SceneStore& scene, Entity entity) {
+    if (entity.index >= scene.dense.size() || scene.generations[entity.index] != entity.generation) {
+        return UINT32_MAX;
+    }
+    return scene.dense[entity.index];
+}
+
+void scene_set_transform(SceneStore& scene, Entity entity, const simd::float4x4& transform) {
+    const uint32_t index = scene_index(scene, entity);
+    if (index == UINT32_MAX) {
+        return;
+    }
+    scene.transforms[index] = transform;
+    scene.dirty.push_back(index);
+    mark_instance(scene, index);
+}
+
+void scene_set_color(SceneStore& scene, Entity entity, simd::float3 color) {
+    const uint32_t index = scene_index(scene, entity);
+    if (index != UINT32_MAX) {
+        scene.colors[index] = color;
+        mark_instance(scene, index);
+    }
+}
+
+size_t scene_update_bounds(SceneStore& scene) {
+    // An entity moved twice in one frame is listed twice; sorting also makes the pass walk memory forwards
+    std::sort(scene.dirty.begin(), scene.dirty.end());
+    scene.dirty.erase(std::unique(scene.dirty.begin(), scene.dirty.end()), scene.dirty.end());
+
+    for (uint32_t index : scene.dirty) {
+        const BoundingBox box = transform_bounds(scene.localBounds[index], scene.transforms[index]);
+        cull_bounds_set(scene.worldBounds, index, box);
+        bvh_move(scene.bvh, scene.proxies[index], box);
+    }
+    bvh_refit(scene.bvh);
+    const size_t updated = scene.dirty.size();
+    scene.dirty.clear();
+    return updated;
+}
+
+size_t scene_cull(const SceneStore& scene, const Frustum& frustum, uint32_t* visible) {
+    return frustum_cull(frustum, scene.worldBounds, visible);
+}
+
+void scene_query_box(const SceneStore& scene, const BoundingBox& box, std::vector<Entity>& entities) {
+    std::vector<uint32_t> slots;
+    bvh_query_box(scene.bvh, box, slots);
+    entities.clear();
+    for (uint32_t slot : slots) {
+        entities.push_back(entity_of_slot(scene, slot));
+    }
+}
+
+Entity scene_raycast(const SceneStore& scene, simd::float3 origin, simd::float3 direction, float maxDistance,
+                     float& distance) {
+    // Leaves are enlarged, so the exact test is against the entity's own world bounds
+    const simd::float3 inverse = 1.0f / direction;
+    const uint32_t slot = bvh_raycast(scene.bvh, origin, direction, maxDistance, [&](uint32_t item, float limit) {
+        return ray_box_distance(world_bounds(scene.worldBounds, scene.dense[item]), origin, inverse, limit);
+    }, distance);
+    return slot == BVH_NULL ? Entity{} : entity_of_slot(scene, slot);
+}
+
+void scene_select_lods(const SceneStore& scene, const uint32_t* visible, size_t visibleCount,
+                       const MeshLodChain* chains, simd::float3 eye, float projectionScale, uint8_t* lods) {
+    for (size_t v = 0; v < visibleCount; ++v) {
+        const uint32_t index = visible[v];
+        const MeshLodChain& chain = chains[scene.meshes[index]];
+        if (chain.count <= 1) {
+            lods[v] = 0;
+            continue;
+        }
+        const simd::float4x4& m = scene.transforms[index];
+        const float scale =
+            std::max({ axis_length(m.columns[0]), axis_length(m.columns[1]), axis_length(m.columns[2]) });
+        // Inside the bounds every level would be seen up close
+        const float distance = box_distance(world_bounds(scene.worldBounds, index), eye);
+        lods[v] = distance > 0.0f ? (uint8_t)mesh_lod_select(chain, scale * projectionScale / distance) : 0;
+    }
+}
+
+void scene_order_instances(const SceneStore& scene, const uint32_t* visible, size_t visibleCount, uint32_t* order,
+                           std::vector<SceneBatch>& batches, const uint8_t* lods) {
+    group_instances(scene, visible, visibleCount, batches, lods,
+                    [&](uint32_t slot, size_t v) { order[slot] = visible[v]; });
+}
+
+void scene_fill_instances(const SceneStore& scene, const uint32_t* visible, size_t visibleCount,
+                          InstanceData* instances, std::vector<SceneBatch>& batches, const uint8_t* lods) {
+    group_instances(scene, visible, visibleCount, batches, lods,
+                    [&](uint32_t slot, size_t v) { instances[slot] = instance_of(scene, visible[v]); });
+}
+
+void scene_write_instances(const SceneStore& scene, const SceneRange& range, InstanceData* instances) {
+    for (uint32_t i = 0; i < range.count; ++i) {
+        instances[i] = instance_of(scene, range.first + i);
+    }
+}
+
+void scene_mark_all_instances(SceneStore& scene) {
+    const uint32_t count = (uint32_t)scene.size();
+    scene.instanceFlags.assign(count, 1);
+    scene.instanceDirty.resize(count);
+    std::iota(scene.instanceDirty.begin(), scene.instanceDirty.end(), 0u);
+}
+
+size_t scene_take_instance_ranges(SceneStore& scene, uint32_t maxGap, std::vector<SceneRange>& ranges) {
+    ranges.clear();
+    // Ascending, so neighbours merge and the copies walk the buffer forwards
+    std::sort(scene.instanceDirty.begin(), scene.instanceDirty.end());
+    size_t covered = 0;
+    for (uint32_t index : scene.instanceDirty) {
+        scene.instanceFlags[index] = 0;
+        if (!ranges.empty() && index - (ranges.back().first + ranges.back().count) <= maxGap) {
+            const uint32_t end = index + 1;
+            covered += end - (ranges.back().first + ranges.back().count);
+            ranges.back().count = end - ranges.back().first;
+            continue;
+        }
+        ranges.push_back({ index, 1 });
+        ++covered;
+    }
+    scene.instanceDirty.clear();
+    return covered;
+}
+
+size_t scene_memory_bytes(const SceneStore& scene) {
+    const CullBounds& bounds = scene.worldBounds;
+    return vector_bytes(scene.transforms) + vector_bytes(scene.colors) + vector_bytes(scene.meshes) +
+           vector_bytes(scene.localBounds) + vector_bytes(scene.proxies) + vector_bytes(scene.owners) +
+           vector_bytes(scene.dense) + vector_bytes(scene.generations) + vector_bytes(scene.freeSlots) +
+           vector_bytes(scene.dirty) + vector_bytes(scene.instanceDirty) + vector_bytes(scene.instanceFlags) +
+           vector_bytes(bounds.centerX) + vector_bytes(bounds.centerY) +
+           vector_bytes(bounds.centerZ) + vector_bytes(bounds.extentX) + vector_bytes(bounds.extentY) +
+           vector_bytes(bounds.extentZ) + vector_bytes(scene.bvh.nodes) + vector_bytes(scene.bvh.refitQueue);
+}
@@ -0,0 +1,258 @@
+/**
+ * @file scene.hpp
+ * @brief Entity storage with each component in its own contiguous array.
+ *
+ * Every live entity owns one element of each component array, and all arrays share
+ * one dense order, so a pass that needs only transforms or only bounds streams through
+ * exactly that data. Entities are addressed by generation-checked handles; destroying one
+ * moves the last entity into its slot, keeping the arrays free of holes. Mesh geometry is
+ * not stored here: an entity refers to a mesh by its MeshRegistry index. A dynamic BVH over
+ * the world bounds answers box and ray queries without scanning every entity.
+ *
+ * The store also remembers which dense elements' instance data changed, through creation, a
+ * move, a recolour or another entity moving into the slot, so a GPU copy of every instance
+ * (see gpu_scene_instances.hpp) can be brought up to date with only those elements, in a few
+ * coalesced ranges, rather than rewritten every frame.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "frustum.hpp"
+#include "mesh_lod.hpp"
+#include "objects.hpp"
+
+/**
+ * @struct Entity
+ * @brief Handle to a scene entity; stops matching once the entity is destroyed.
+ */
+struct Entity {
+    uint32_t index = UINT32_MAX;    ///< Slot in the handle table.
+    uint32_t generation = 0;        ///< Generation of the slot when the handle was issued.
+};
+
+/**
+ * @struct SceneBatch
+ * @brief A run of instances sharing one mesh and detail level, as written by scene_fill_instances().
+ */
+struct SceneBatch {
+    uint32_t mesh = 0;      ///< The mesh handle.
+    uint32_t lod = 0;       ///< The detail level of the mesh.
+    uint32_t first = 0;     ///< Index of the first InstanceData of the run.
+    uint32_t count = 0;     ///< Number of instances.
+};
+
+/**
+ * @struct SceneRange
+ * @brief A run of consecutive dense elements.
+ */
+struct SceneRange {
+    uint32_t first = 0;     ///< First dense element.
+    uint32_t count = 0;     ///< Number of elements.
+};
+
+/**
+ * @struct SceneStore
+ * @brief Component arrays of all entities plus the handle table mapping entities to them.
+ */
+struct SceneStore {
+    // --- Components, one element per live entity, in dense order ---
+    std::vector<simd::float4x4> transforms; ///< Model to world matrices.
+    std::vector<simd::float3> colors;       ///< Flat colours.
+    std::vector<uint32_t> meshes;           ///< Mesh handles: indices into the MeshRegistry.
+    std::vector<BoundingBox> localBounds;   ///< Model space bounds of each entity's mesh.
+    CullBounds worldBounds;                 ///< World space bounds, refreshed by scene_update_bounds().
+    std::vector<uint32_t> proxies;          ///< Leaf of each entity in bvh.
+
+    // --- Bookkeeping ---
+    std::vector<uint32_t> owners;           ///< Handle slot of each dense element.
+    std::vector<uint32_t> dense;            ///< Dense element of each handle slot, or UINT32_MAX when free.
+    std::vector<uint32_t> generations;      ///< Current generation of each handle slot.
+    std::vector<uint32_t> freeSlots;        ///< Handle slots ready for reuse.
+    std::vector<uint32_t> dirty;            ///< Dense elements whose transform changed since the last bounds update.
+    std::vector<uint32_t> instanceDirty;    ///< Dense elements whose instance data changed, each listed once.
+    std::vector<uint8_t> instanceFlags;     ///< 1 for each dense element in instanceDirty.
+    Bvh bvh;                                ///< Hierarchy over the world bounds; items are handle slots.
+
+    /// @return The number of live entities.
+    size_t size() const { return transforms.size(); }
+};
+
+/**
+ * @brief Reserves room for a number of live entities.
+ *
+ * Creating and destroying entities up to the reserved count then never reallocates, so
+ * steady churn costs no heap allocations and pointers into the arrays stay put.
+ *
+ * @param scene The scene.
+ * @param capacity The live entity count to make room for.
+ */
+void scene_reserve(SceneStore& scene, size_t capacity);
+
+/**
+ * @brief Adds an entity.
+ * @param scene The scene.
+ * @param mesh The mesh handle.
+ * @param meshBounds The model space bounds of the mesh.
+ * @param transform The model to world matrix.
+ * @param color The flat colour.
+ * @return The handle of the new entity.
+ */
+Entity scene_create(SceneStore& scene, uint32_t mesh, const BoundingBox& meshBounds,
+                    const simd::float4x4& transform, simd::float3 color);
+
+/**
+ * @brief Removes an entity; the last entity moves into its dense position.
+ * @param scene The scene.
+ * @param entity The entity; stale handles are ignored.
+ */
+void scene_destroy(SceneStore& scene, Entity entity);
+
+/// @return True if the handle refers to a live entity.
+bool scene_alive(const SceneStore& scene, Entity entity);
+
+/// @return The dense position of a live entity, or UINT32_MAX for a stale handle.
+uint32_t scene_index(const SceneStore& scene, Entity entity);
+
+/**
+ * @brief Moves an entity; its world bounds follow on the next scene_update_bounds().
+ * @param scene The scene.
+ * @param entity The entity; stale handles are ignored.
+ * @param transform The new model to world matrix.
+ */
+void scene_set_transform(SceneStore& scene, Entity entity, const simd::float4x4& transform);
+
+/**
+ * @brief Recolours an entity.
+ *
+ * The colour travels with each instance, so the entity stays in its mesh's instanced draw and
+ * the next scene_fill_instances() picks the colour up; nothing else is rewritten.
+ *
+ * @param scene The scene.
+ * @param entity The entity; stale handles are ignored.
+ * @param color The new flat colour.
+ */
+void scene_set_color(SceneStore& scene, Entity entity, simd::float3 color);
+
+/**
+ * @brief Recomputes the world bounds of every entity moved since the last call.
+ *
+ * The moved leaves of the BVH are widened and then refit together in one pass.
+ *
+ * @param scene The scene.
+ * @return The number of entities updated.
+ */
+size_t scene_update_bounds(SceneStore& scene);
+
+/**
+ * @brief Frustum-culls every entity against its world bounds, four at a time.
+ * @param scene The scene, with bounds up to date.
+ * @param frustum The frustum.
+ * @param visible Receives dense positions of the entities that may be visible, in order; needs size() slots.
+ * @return The number of positions written.
+ */
+size_t scene_cull(const SceneStore& scene, const Frustum& frustum, uint32_t* visible);
+
+/**
+ * @brief Collects the entities whose world bounds may overlap a box.
+ * @param scene The scene, with bounds up to date.
+ * @param box The query box.
+ * @param entities Receives the entities; cleared first. May include entities up to the BVH margin away.
+ */
+void scene_query_box(const SceneStore& scene, const BoundingBox& box, std::vector<Entity>& entities);
+
+/**
+ * @brief Finds the first entity whose world bounds a ray hits.
+ * @param scene The scene, with bounds up to date.
+ * @param origin The ray origin.
+ * @param direction The ray direction; distances are in its units.
+ * @param maxDistance The end of the ray.
+ * @param distance Receives the distance to the hit bounds.
+ * @return The entity hit, or a default Entity for none.
+ */
+Entity scene_raycast(const SceneStore& scene, simd::float3 origin, simd::float3 direction, float maxDistance,
+                     float& distance);
+
+/**
+ * @brief Picks the detail level of each visible entity from its projected size.
+ *
+ * The entity's error is projected at the nearest point of its world bounds and scaled by the
+ * largest axis scale of its transform, so a level is only used while it stays under
+ * MESH_LOD_SCREEN_ERROR (see mesh_lod_select()).
+ *
+ * @param scene The scene, with bounds up to date.
+ * @param visible Dense positions, e.g. from scene_cull().
+ * @param visibleCount The number of positions.
+ * @param chains The LOD chain of each mesh, indexed by mesh handle.
+ * @param eye The viewpoint.
+ * @param projectionScale mesh_lod_projection_scale() of the view.
+ * @param lods Receives the level of each visible entity, in visible order.
+ */
+void scene_select_lods(const SceneStore& scene, const uint32_t* visible, size_t visibleCount,
+                       const MeshLodChain* chains, simd::float3 eye, float projectionScale, uint8_t* lods);
+
+/**
+ * @brief Lists the dense positions of the visible entities, grouped by mesh and detail level.
+ *
+ * The grouping of scene_fill_instances(), for draws that read every entity's instance data from
+ * one buffer in dense order (see scene_write_instances()) through a list of positions.
+ *
+ * @param scene The scene.
+ * @param visible Dense positions, e.g. from scene_cull().
+ * @param visibleCount The number of positions.
+ * @param order Receives visibleCount dense positions; each batch reads order[first, first + count).
+ * @param batches Receives one batch per mesh and level with visible instances, in mesh then level order.
+ * @param lods Detail level of each visible entity; nullptr for level 0 throughout.
+ */
+void scene_order_instances(const SceneStore& scene, const uint32_t* visible, size_t visibleCount, uint32_t* order,
+                           std::vector<SceneBatch>& batches, const uint8_t* lods = nullptr);
+
+/**
+ * @brief Writes the instance data of the visible entities, grouped by mesh and detail level.
+ *
+ * Instances of one mesh and level end up contiguous, in visible order, so each batch is a
+ * single instanced draw reading instances [first, first + count).
+ *
+ * @param scene The scene.
+ * @param visible Dense positions, e.g. from scene_cull().
+ * @param visibleCount The number of positions.
+ * @param instances Receives visibleCount instances.
+ * @param batches Receives one batch per mesh and level with visible instances, in mesh then level order.
+ * @param lods Detail level of each visible entity, e.g. from scene_select_lods(); nullptr for level 0 throughout.
+ */
+void scene_fill_instances(const SceneStore& scene, const uint32_t* visible, size_t visibleCount,
+                          InstanceData* instances, std::vector<SceneBatch>& batches, const uint8_t* lods = nullptr);
+
+/**
+ * @brief Writes the instance data of a run of dense elements, as the GPU copy holds them.
+ * @param scene The scene.
+ * @param range The elements; must lie within size().
+ * @param instances Receives range.count instances.
+ */
+void scene_write_instances(const SceneStore& scene, const SceneRange& range, InstanceData* instances);
+
+/**
+ * @brief Marks every element's instance data as changed, e.g. after the arrays were replaced wholesale.
+ * @param scene The scene.
+ */
+void scene_mark_all_instances(SceneStore& scene);
+
+/**
+ * @brief Takes the elements whose instance data changed since the last call, as coalesced ranges.
+ *
+ * Ranges separated by at most maxGap unchanged elements are merged, since re-sending a few
+ * elements costs less than another copy. Every element is clean afterwards.
+ *
+ * @param scene The scene.
+ * @param maxGap Unchanged elements a range may span to join the next.
+ * @param ranges Receives the ranges in ascending order; cleared first.
+ * @return The elements the ranges cover, gaps included.
+ */
+size_t scene_take_instance_ranges(SceneStore& scene, uint32_t maxGap, std::vector<SceneRange>& ranges);
+
+/// @return The CPU heap bytes held by the scene's components, bookkeeping and BVH.
+size_t scene_memory_bytes(const SceneStore& scene);
@@ -0,0 +1,106 @@
+/**
+ * @file scene_arguments.hpp
+ * @brief Bindless draw records and materials, reached by shaders through one argument buffer.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <vector>
+
+#include "frame_ring.hpp"
+
+/// Buffer slot of SceneArguments in the bindless vertex shaders.
+constexpr NSUInteger SCENE_ARGUMENTS_BUFFER_INDEX = 4;
+
+/**
+ * @enum SceneMaterial
+ * @brief Entries of the material table created by create_metal_context().
+ */
+enum SceneMaterial : uint32_t {
+    MATERIAL_TERRAIN,   ///< Terrain chunks.
+    MATERIAL_COUNT
+};
+
+/**
+ * @struct MaterialParams
+ * @brief Per-material shading parameters; matches `MaterialParams` in shaders.metal.
+ */
+struct MaterialParams {
+    simd::float4 color; ///< Base colour; rgb is used when height banding is off.
+};
+
+/**
+ * @struct DrawRecord
+ * @brief Everything a bindless draw reads instead of its own bindings; matches `DrawRecord` in shaders.metal.
+ */
+struct DrawRecord {
+    simd::float4x4 modelMatrix; ///< Object to world transform.
+    uint64_t vertices;          ///< GPU address of the vertex buffer.
+    uint32_t material;          ///< Index into the material table.
+    uint32_t padding;
+};
+
+/**
+ * @struct SceneArguments
+ * @brief The argument buffer of a frame; matches `SceneArguments` in shaders.metal.
+ */
+struct SceneArguments {
+    uint64_t draws;     ///< GPU address of this frame's DrawRecord array.
+    uint64_t materials; ///< GPU address of the MaterialParams table.
+};
+
+/**
+ * @struct BindlessFrame
+ * @brief The draw records being written for one frame.
+ */
+struct BindlessFrame {
+    FrameAllocation arguments;              ///< The frame's SceneArguments.
+    DrawRecord* draws = nullptr;            ///< CPU view of the DrawRecord array.
+    uint32_t count = 0;                     ///< Records written so far.
+    uint32_t capacity = 0;                  ///< Records allocated.
+    std::vector<id<MTLResource>> resources; ///< Buffers the shaders reach through pointers.
+    bool resident = false;                  ///< A GpuResidency holds those buffers, so none are listed.
+};
+
+/// @return True if the device can dereference GPU addresses from argument buffers (Tier 2, Metal 3).
+bool bindless_supported(id<MTLDevice> device);
+
+/**
+ * @brief Allocates this frame's argument buffer and draw record array in the frame ring.
+ * @param frame The frame to reset; its resources vector is reused.
+ * @param ring The frame ring.
+ * @param materials The material table, created by create_material_buffer().
+ * @param maxDraws The most records that will be added.
+ */
+void bindless_begin_frame(BindlessFrame& frame, FrameRing& ring, id<MTLBuffer> materials, uint32_t maxDraws);
+
+/**
+ * @brief Appends a draw record.
+ * @param frame The frame.
+ * @param vertices The vertex buffer of the draw.
+ * @param material The material index.
+ * @param modelMatrix The object to world transform.
+ * @return The draw ID to pass as the draw's base instance.
+ */
+uint32_t bindless_add_draw(BindlessFrame& frame, id<MTLBuffer> vertices, uint32_t material,
+                           const simd::float4x4& modelMatrix);
+
+/**
+ * @brief Binds the argument buffer once and makes every referenced buffer resident, unless they already are.
+ * @param frame The frame.
+ * @param enc The render encoder.
+ */
+void bindless_bind(const BindlessFrame& frame, id<MTLRenderCommandEncoder> enc);
+
+/// @return The parameters of every SceneMaterial, in enum order.
+std::vector<MaterialParams> default_scene_materials();
+
+/**
+ * @brief Creates the shared material table.
+ * @param device The Metal device.
+ * @param materials The materials, indexed by DrawRecord::material.
+ * @return The buffer.
+ */
+id<MTLBuffer> create_material_buffer(id<MTLDevice> device, const std::vector<MaterialParams>& materials);
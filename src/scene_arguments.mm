@@ -0,0 +1,57 @@
+#import "scene_arguments.hpp"
+
+#include <algorithm>
+
+bool bindless_supported(id<MTLDevice> device) {
+    return device.argumentBuffersSupport == MTLArgumentBuffersTier2 && [device supportsFamily:MTLGPUFamilyMetal3];
+}
+
+void bindless_begin_frame(BindlessFrame& frame, FrameRing& ring, id<MTLBuffer> materials, uint32_t maxDraws) {
+    FrameAllocation records = frame_ring_allocate(ring, std::max(maxDraws, 1u) * sizeof(DrawRecord));
+    frame.arguments = frame_ring_allocate(ring, sizeof(SceneArguments));
+    frame.draws = (DrawRecord*)records.contents;
+    frame.count = 0;
+    frame.capacity = maxDraws;
+
+    SceneArguments* arguments = (SceneArguments*)frame.arguments.contents;
+    arguments->draws = records.buffer.gpuAddress + records.offset;
+    arguments->materials = materials.gpuAddress;
+
+    frame.resources.clear();
+    frame.resources.push_back(materials);
+}
+
+uint32_t bindless_add_draw(BindlessFrame& frame, id<MTLBuffer> vertices, uint32_t material,
+                           const simd::float4x4& modelMatrix) {
+    DrawRecord& record = frame.draws[frame.count];
+    record.modelMatrix = modelMatrix;
+    record.vertices = vertices.gpuAddress;
+    record.material = material;
+    if (!frame.resident) {
+        frame.resources.push_back(vertices);
+    }
+    return frame.count++;
+}
+
+void bindless_bind(const BindlessFrame& frame, id<MTLRenderCommandEncoder> enc) {
+    [enc setVertexBuffer:frame.arguments.buffer offset:frame.arguments.offset atIndex:SCENE_ARGUMENTS_BUFFER_INDEX];
+    if (frame.resident) {
+        return;
+    }
+    [enc useResources:frame.resources.data() count:frame.resources.size() usage:MTLResourceUsageRead
+               stages:MTLRenderStageVertex];
+}
+
+id<MTLBuffer> create_material_buffer(id<MTLDevice> device, const std::vector<MaterialParams>& materials) {
+    id<MTLBuffer> buffer = [device newBufferWithBytes:materials.data()
+                                               length:materials.size() * sizeof(MaterialParams)
+                                              options:MTLResourceStorageModeShared];
+    buffer.label = @"Materials";
+    return buffer;
+}
+
+std::vector<MaterialParams> default_scene_materials() {
+    std::vector<MaterialParams> materials(MATERIAL_COUNT);
+    materials[MATERIAL_TERRAIN].color = { 0.3f, 0.6f, 0.2f, 1.0f };
+    return materials;
+}
@@ -0,0 +1,103 @@
+#include "scene_cells.hpp"
+
+namespace {
+    // Reads the cell's file, or generates it if there is none or it does not fit this build
+    void load_cell(SceneCells& cells, ChunkKey key, const SceneCellGenerator& generate) {
+        SceneCellObjects& objects = cells.scratch;
+        if (!cells.directory.empty() && read_scene_cell(scene_cell_path(cells.directory, key), key, objects)) {
+            bool known = true;
+            for (uint32_t mesh : objects.meshes) {
+                known = known && mesh < cells.meshCount;
+            }
+            if (known) {
+                cells.loaded++;
+                return;
+            }
+        }
+        objects.clear();
+        if (generate) {
+            generate(key, objects);
+        }
+        cells.generated++;
+    }
+}
+
+void scene_cell_capture(const SceneStore& scene, const std::vector<Entity>& entities, SceneCellObjects& objects) {
+    objects.clear();
+    for (Entity entity : entities) {
+        const uint32_t i = scene_index(scene, entity);
+        if (i == UINT32_MAX) {
+            continue;
+        }
+        objects.transforms.push_back(scene.transforms[i]);
+        objects.colors.push_back(scene.colors[i]);
+        objects.meshes.push_back(scene.meshes[i]);
+        objects.localBounds.push_back(scene.localBounds[i]);
+    }
+}
+
+void scene_cell_spawn(SceneStore& scene, const SceneCellObjects& objects, std::vector<Entity>& entities) {
+    entities.clear();
+    entities.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        entities.push_back(
+            scene_create(scene, objects.meshes[i], objects.localBounds[i], objects.transforms[i], objects.colors[i]));
+    }
+}
+
+void scene_cells_update(SceneCells& cells, SceneStore& scene, const ChunkKey* chunks, size_t count,
+                        const SceneCellGenerator& generate) {
+    const uint64_t update = ++cells.updates;
+    for (size_t i = 0; i < count; ++i) {
+        auto [it, added] = cells.resident.try_emplace(chunks[i]);
+        it->second.update = update;
+        if (added) {
+            load_cell(cells, chunks[i], generate);
+            scene_cell_spawn(scene, cells.scratch, it->second.entities);
+        }
+    }
+
+    for (auto it = cells.resident.begin(); it != cells.resident.end();) {
+        if (it->second.update == update) {
+            ++it;
+            continue;
+        }
+        if (!cells.directory.empty()) {
+            scene_cell_capture(scene, it->second.entities, cells.scratch);
+            write_scene_cell(scene_cell_path(cells.directory, it->first), it->first, cells.scratch);
+        }
+        for (Entity entity : it->second.entities) {
+            scene_destroy(scene, entity);
+        }
+        cells.evicted++;
+        it = cells.resident.erase(it);
+    }
+}
+
+uint32_t scene_cells_flush(SceneCells& cells, const SceneStore& scene) {
+    if (cells.directory.empty()) {
+        return 0;
+    }
+    uint32_t failed = 0;
+    for (const auto& [key, cell] : cells.resident) {
+        scene_cell_capture(scene, cell.entities, cells.scratch);
+        failed += !write_scene_cell(scene_cell_path(cells.directory, key), key, cells.scratch);
+    }
+    return failed;
+}
+
+void scene_cells_entities(const SceneCells& cells, std::vector<Entity>& entities) {
+    for (const auto& [key, cell] : cells.resident) {
+        entities.insert(entities.end(), cell.entities.begin(), cell.entities.end());
+    }
+}
+
+size_t scene_cells_entity_count(const SceneCells& cells, const SceneStore& scene) {
+    size_t count = 0;
+    for (const auto& [key, cell] : cells.resident) {
+        for (Entity entity : cell.entities) {
+            count += scene_alive(scene, entity);
+        }
+    }
+    return count;
+}
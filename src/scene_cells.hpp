@@ -0,0 +1,97 @@
+/**
+ * @file scene_cells.hpp
+ * @brief Scene entities partitioned into cells that stream in and out with their terrain chunk.
+ *
+ * A world too large to keep every object in the SceneStore keeps only the cells of the resident
+ * chunks. Each cell is a list of the entities it created; every update loads the cells of chunks
+ * that became resident, reading the cell file written when the chunk was last evicted or, the
+ * first time, asking the generator, and evicts the cells of chunks that left, writing their
+ * entities' current transforms and colours back to the file before destroying them. Creating
+ * and destroying the entities inserts and removes their BVH leaves, and the instance data is
+ * written from the live entities every frame, so the spatial index and the instance buffers
+ * follow on their own. Resident entities are then bounded by the resident chunks, i.e. by the
+ * view distance, and so are the scene's arrays.
+ *
+ * An entity belongs to the cell that created it, wherever it moves; entities created any other
+ * way are not streamed. Without a directory nothing is written and evicted cells are generated
+ * again when they return.
+ */
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "landscape.hpp"
+#include "scene.hpp"
+#include "world_save.hpp"
+
+/**
+ * @struct SceneCell
+ * @brief The entities of one resident cell.
+ */
+struct SceneCell {
+    std::vector<Entity> entities;   ///< Created when the cell was loaded; some may since be destroyed.
+    uint64_t update = 0;            ///< Last update whose resident chunks included the cell.
+};
+
+/**
+ * @struct SceneCells
+ * @brief The resident cells and where evicted ones go.
+ */
+struct SceneCells {
+    std::string directory;      ///< Holds the cell files; empty writes none.
+    uint32_t meshCount = 0;     ///< Meshes of the registry; a cell file naming others is generated again.
+    std::unordered_map<ChunkKey, SceneCell, ChunkKeyHash> resident; ///< Loaded cells by chunk.
+    SceneCellObjects scratch;   ///< Holds the cell being loaded or evicted.
+    uint64_t updates = 0;       ///< scene_cells_update() calls so far.
+    uint64_t loaded = 0;        ///< Cells read from their file.
+    uint64_t generated = 0;     ///< Cells created by the generator.
+    uint64_t evicted = 0;       ///< Cells destroyed with their chunk.
+};
+
+/// Fills a cell's objects the first time its chunk becomes resident; objects arrives empty.
+using SceneCellGenerator = std::function<void(ChunkKey key, SceneCellObjects& objects)>;
+
+/**
+ * @brief Copies the live entities of a cell out of the scene.
+ * @param scene The scene.
+ * @param entities The cell's entities; destroyed ones are skipped.
+ * @param objects Receives the entities; cleared first.
+ */
+void scene_cell_capture(const SceneStore& scene, const std::vector<Entity>& entities, SceneCellObjects& objects);
+
+/**
+ * @brief Creates a cell's entities in the scene.
+ * @param scene The scene.
+ * @param objects The cell's objects.
+ * @param entities Receives the new entities, in objects order; cleared first.
+ */
+void scene_cell_spawn(SceneStore& scene, const SceneCellObjects& objects, std::vector<Entity>& entities);
+
+/**
+ * @brief Loads the cells of newly resident chunks and evicts those of chunks no longer resident.
+ * @param cells The cells.
+ * @param scene The scene the entities live in.
+ * @param chunks The resident chunks.
+ * @param count The number of chunks.
+ * @param generate Fills cells that have no valid file.
+ */
+void scene_cells_update(SceneCells& cells, SceneStore& scene, const ChunkKey* chunks, size_t count,
+                        const SceneCellGenerator& generate);
+
+/**
+ * @brief Writes every resident cell to its file, e.g. alongside a world save or at exit.
+ * @param cells The cells; nothing is written without a directory.
+ * @param scene The scene.
+ * @return The number of cells that could not be written.
+ */
+uint32_t scene_cells_flush(SceneCells& cells, const SceneStore& scene);
+
+/// Appends the entities of every resident cell, destroyed ones included, to entities.
+void scene_cells_entities(const SceneCells& cells, std::vector<Entity>& entities);
+
+/// @return The live entities of the resident cells.
+size_t scene_cells_entity_count(const SceneCells& cells, const SceneStore& scene);
@@ -0,0 +1,83 @@
+/**
+ * @file shader_reload.hpp
+ * @brief Recompiles edited shader sources in the background and swaps the pipelines in between frames.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metal_context.hpp"
+
+/**
+ * @class ShaderReloader
+ * @brief Watches shaders.metal and rebuilds every pipeline of a MetalContext when it changes.
+ *
+ * A dispatch source reports writes, and the renames editors save through, on a serial
+ * queue. After a short quiet period the source is compiled with
+ * newLibraryWithSource:options:completionHandler:, and metal_context_rebuild() compiles the
+ * pipelines from it, still off the render thread. The finished context waits until the
+ * render thread calls apply() at the start of a frame, so a frame never mixes pipelines of
+ * two libraries and never waits for a compile. A source that fails to compile is reported
+ * through status() and the running shaders are kept.
+ */
+class ShaderReloader {
+public:
+    /**
+     * @brief Starts watching a source file.
+     * @param sourcePath The shader source, e.g. metal_shader_source_path().
+     * @param ctx The context whose pipelines are rebuilt; apply() keeps the reloader in step with it.
+     */
+    ShaderReloader(NSString* sourcePath, const MetalContext& ctx);
+    ~ShaderReloader();
+
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    /**
+     * @brief Swaps in the pipelines of the latest successful reload; call between frames.
+     *
+     * Objects holding pipelines copied out of ctx must be given the new ones when this returns true.
+     * The replaced pipelines are held until the next reload, for frames still in flight whose command
+     * buffers do not retain them.
+     *
+     * @param ctx The render thread's context.
+     * @return True if ctx was replaced.
+     */
+    bool apply(MetalContext& ctx);
+
+    /// @return The outcome of the last reload, or the compiler's errors; empty before the first one.
+    std::string status() const;
+
+    /// @return The number of reloads applied so far.
+    uint32_t reload_count() const { return m_reloads; }
+
+private:
+    void watch();
+    void schedule_reload();
+    void reload(uint64_t change);
+    void set_status(std::string status);
+
+    NSString* m_path;
+    dispatch_queue_t m_queue;                   ///< Serializes file events and rebuilds.
+    dispatch_group_t m_pending;                 ///< Blocks that still reference this.
+    dispatch_source_t m_source = nil;
+    uint64_t m_change = 0;                      ///< File events seen; only touched on m_queue.
+    std::atomic<bool> m_stopping{ false };
+    uint32_t m_reloads = 0;                     ///< Only touched by apply().
+    MetalContext m_replaced;                    ///< The context apply() last replaced; only touched by apply().
+
+    mutable std::mutex m_mutex;                 ///< Guards the members below.
+    MetalContext m_base;                        ///< The pipelines the render thread uses, without variants.
+    std::vector<uint32_t> m_variantKeys;        ///< Variants the render thread has compiled.
+    size_t m_variantCount = 0;                  ///< Size of the render thread's variant map when they were listed.
+    std::unique_ptr<MetalContext> m_ready;      ///< A rebuilt context waiting for apply().
+    std::string m_status;
+};
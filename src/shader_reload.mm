@@ -0,0 +1,181 @@
+#import "shader_reload.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // Editors often write a file in several steps; a reload waits for the last of them
+    constexpr int64_t RELOAD_DELAY_NS = 150 * NSEC_PER_MSEC;
+
+    std::vector<uint32_t> variant_keys(const MetalContext& ctx) {
+        std::vector<uint32_t> keys;
+        keys.reserve(ctx.variants.size());
+        for (const auto& [key, pipeline] : ctx.variants) {
+            if (pipeline) {
+                keys.push_back(key);
+            }
+        }
+        return keys;
+    }
+
+    MetalContext without_variants(const MetalContext& ctx) {
+        MetalContext base = ctx;
+        base.variants.clear();
+        return base;
+    }
+}
+
+ShaderReloader::ShaderReloader(NSString* sourcePath, const MetalContext& ctx)
+    : m_path(sourcePath), m_queue(dispatch_queue_create("Shader reload", DISPATCH_QUEUE_SERIAL)),
+      m_pending(dispatch_group_create()), m_base(without_variants(ctx)), m_variantKeys(variant_keys(ctx)),
+      m_variantCount(ctx.variants.size()) {
+    dispatch_async(m_queue, ^{ watch(); });
+}
+
+ShaderReloader::~ShaderReloader() {
+    m_stopping = true;
+    dispatch_sync(m_queue, ^{
+        if (m_source) {
+            dispatch_source_cancel(m_source);
+            m_source = nil;
+        }
+    });
+    // Delayed reloads and library compiles still in flight return early once they see m_stopping
+    dispatch_group_wait(m_pending, DISPATCH_TIME_FOREVER);
+}
+
+void ShaderReloader::watch() {
+    if (m_source) {
+        dispatch_source_cancel(m_source);
+        m_source = nil;
+    }
+    if (m_stopping) {
+        return;
+    }
+    const int fd = open(m_path.fileSystemRepresentation, O_EVTONLY);
+    if (fd < 0) {
+        // Saved through a rename that has not landed yet; look again shortly
+        dispatch_group_enter(m_pending);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, RELOAD_DELAY_NS), m_queue, ^{
+            watch();
+            dispatch_group_leave(m_pending);
+        });
+        return;
+    }
+    dispatch_source_t source = dispatch_source_create(
+        DISPATCH_SOURCE_TYPE_VNODE, fd,
+        DISPATCH_VNODE_WRITE | DISPATCH_VNODE_EXTEND | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME, m_queue);
+    dispatch_source_set_event_handler(source, ^{
+        // A rename or delete means the path now names another file, or none; follow the path
+        if (dispatch_source_get_data(source) & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME)) {
+            watch();
+        }
+        schedule_reload();
+    });
+    dispatch_source_set_cancel_handler(source, ^{ close(fd); });
+    dispatch_resume(source);
+    m_source = source;
+}
+
+void ShaderReloader::schedule_reload() {
+    const uint64_t change = ++m_change;
+    dispatch_group_enter(m_pending);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, RELOAD_DELAY_NS), m_queue, ^{
+        reload(change);
+        dispatch_group_leave(m_pending);
+    });
+}
+
+void ShaderReloader::reload(uint64_t change) {
+    // Only the last of a burst of events reloads
+    if (m_stopping || change != m_change) {
+        return;
+    }
+    NSError* error = nil;
+    NSString* source = metal_read_shader_source(m_path, &error);
+    if (!source) {
+        set_status(std::string("Could not read ") + m_path.UTF8String);
+        return;
+    }
+    id<MTLDevice> device = nil;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        device = m_base.device;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    dispatch_group_enter(m_pending);
+    [device newLibraryWithSource:source options:metal_compile_options()
+               completionHandler:^(id<MTLLibrary> library, NSError* compileError) {
+        if (!library || m_stopping) {
+            if (!library) {
+                NSLog(@"Shader reload failed, keeping the running shaders: %@", compileError);
+                set_status(compileError ? compileError.localizedDescription.UTF8String : "Shader compile failed");
+            }
+            dispatch_group_leave(m_pending);
+            return;
+        }
+        // Pipelines are rebuilt on the serial queue, one library at a time
+        dispatch_async(m_queue, ^{
+            if (m_stopping) {
+                dispatch_group_leave(m_pending);
+                return;
+            }
+            MetalContext base;
+            std::vector<uint32_t> keys;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                base = m_base;
+                keys = m_variantKeys;
+            }
+            auto rebuilt = std::make_unique<MetalContext>();
+            if (!metal_context_rebuild(base, library, keys, *rebuilt)) {
+                set_status("Some pipelines failed to compile; keeping the running shaders");
+            } else {
+                const double ms =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                char status[64];
+                snprintf(status, sizeof(status), "Reloaded in %.0f ms", ms);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ready = std::move(rebuilt);
+                m_status = status;
+            }
+            dispatch_group_leave(m_pending);
+        });
+    }];
+}
+
+bool ShaderReloader::apply(MetalContext& ctx) {
+    std::unique_ptr<MetalContext> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Variants compiled on demand since the last call are rebuilt by later reloads too
+        if (ctx.variants.size() != m_variantCount) {
+            m_variantCount = ctx.variants.size();
+            m_variantKeys = variant_keys(ctx);
+        }
+        ready = std::move(m_ready);
+        if (ready) {
+            m_base = without_variants(*ready);
+        }
+    }
+    if (!ready) {
+        return false;
+    }
+    m_replaced = std::move(ctx);
+    ctx = std::move(*ready);
+    ++m_reloads;
+    return true;
+}
+
+std::string ShaderReloader::status() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_status;
+}
+
+void ShaderReloader::set_status(std::string status) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_status = std::move(status);
+}
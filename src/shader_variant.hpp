@@ -0,0 +1,148 @@
+/**
+ * @file shader_variant.hpp
+ * @brief Render pipeline variants selected through the function constants in shaders.metal.
+ */
+
+#pragma once
+#include <cstdint>
+
+#include "objects.hpp"
+
+/**
+ * @enum ShaderProgram
+ * @brief The vertex and fragment function pair of a pipeline.
+ */
+enum class ShaderProgram : uint32_t {
+    Default,    ///< vertex_main / fragment_main, coloured by Uniforms::color.
+    Instanced,  ///< vertex_instanced_main / fragment_instanced_main.
+    Landscape,  ///< landscape_vertex_main / landscape_fragment_main.
+    LandscapeBindless, ///< landscape_vertex_bindless / landscape_fragment_main, fed from SceneArguments.
+    DeferredLighting, ///< deferred_lighting_vertex / deferred_lighting_fragment; only with ShaderVariant::deferred.
+    InstancedMeshlets, ///< meshlet_object / meshlet_mesh / fragment_instanced_main; a mesh pipeline, see meshlet_draw.hpp.
+    LandscapeTessellated, ///< terrain_tessellated_vertex / landscape_fragment_main, drawn as patches; see gpu_tessellation.hpp.
+    LandscapeHeightMap, ///< landscape_vertex_heightmap / landscape_fragment_main, fed from a chunk's height and normal maps.
+    FoliageImpostor, ///< impostor_vertex / impostor_fragment, billboards of the impostor atlas; see gpu_impostors.hpp.
+    LandscapeClipmap, ///< landscape_vertex_clipmap / landscape_fragment_main, levels of a geometry clipmap.
+};
+
+/**
+ * @enum LightingModel
+ * @brief How fragments are lit; matches the LIGHTING_* constants in shaders.metal.
+ */
+enum class LightingModel : uint32_t {
+    Unlit,          ///< Surface colour only.
+    Lambert,        ///< Ambient plus clamped N.L diffuse.
+    HalfLambert,    ///< Ambient plus wrapped (N.L * 0.5 + 0.5)^2 diffuse, softer on back faces.
+};
+
+/**
+ * @struct ShaderVariant
+ * @brief Everything a specialized render pipeline is compiled for.
+ */
+struct ShaderVariant {
+    ShaderProgram program = ShaderProgram::Default;     ///< Functions to specialize.
+    VertexFormat vertexFormat = VertexFormat::Float;    ///< Vertex layout; only Landscape supports Packed.
+    LightingModel lighting = LightingModel::Lambert;    ///< Lighting model (function constant 1).
+    bool heightBands = true;                            ///< Landscape grass/rock/snow banding (function constant 2).
+    bool fog = false;                                   ///< Distance fog towards the sky colour (function constant 3).
+    bool shadows = false;                               ///< Cascaded shadow map lookup (function constant 4); see shadow_map.hpp.
+    bool farFade = false;                               ///< Fade into the sky at the end of the draw distance (function constant 5); see fog.hpp.
+    bool deferred = false;                              ///< Drawn in the deferred pass; surfaces write the G-buffer unlit. See deferred.hpp.
+    bool multiView = false;                             ///< Amplified to every view of a multi-view pass; Instanced and Landscape only. See multi_view.hpp.
+    bool virtualTexture = false;                        ///< Terrain albedo from the streamed virtual texture (function constant 6); see terrain_virtual_texture.hpp.
+    bool bakedMaterials = false;                        ///< Terrain albedo from the baked material atlas (function constant 7); see gpu_terrain_material.hpp.
+    bool skyFog = false;                                ///< Fog fades to the atmosphere's sky view instead of a flat colour (function constant 8); see sky.hpp.
+    bool pointLights = false;                           ///< Adds the clustered point lights (function constant 9); see gpu_light_clusters.hpp.
+    bool shadingCache = false;                          ///< Shadow visibility through the reprojection cache (function constant 10); see shading_cache.hpp.
+    bool ambientOcclusion = false;                      ///< Writes the ambient share of the colour to its alpha (function constant 11); see ambient_occlusion.hpp.
+    bool lodDissolve = false;                           ///< Instances dither out by their colour's alpha (function constant 12); see impostor.hpp.
+    bool foliageWind = false;                           ///< Instances sway by FrameUniforms::wind (function constant 13); Instanced only. See foliage.hpp.
+    bool rayTracedShadows = false;                      ///< Shadow rays through the scene's acceleration structure instead of the shadow map (function constant 14); see gpu_ray_tracing.hpp.
+    bool vertexLighting = false;                        ///< Landscape bands and sun lit per vertex (function constant 15); see select_vertex_lit_chunks().
+    bool depthOnly = false;                             ///< No fragment function, so only depth is written; the depth pre-pass of the landscape programs.
+    bool overdraw = false;                              ///< Every shaded fragment adds a fixed colour instead of its lit one, a heat map of overdraw.
+    bool horizonShadows = false;                        ///< Terrain self-shadowing from the baked horizon atlas past the cascades (function constant 16); see gpu_terrain_horizon.hpp.
+    bool indexedInstances = false;                      ///< Instances read from the resident buffer through the draw's index list (function constant 17); see gpu_scene_instances.hpp.
+    uint32_t sampleCount = 1;                           ///< Raster samples per pixel: 1, 2 or 4. See msaa.hpp.
+};
+
+/// @return A key that is unique for every distinct variant.
+inline uint32_t shader_variant_key(const ShaderVariant& variant) {
+    return (uint32_t)variant.program |
+           ((uint32_t)variant.vertexFormat << 4) |
+           ((uint32_t)variant.lighting << 5) |
+           ((uint32_t)variant.heightBands << 7) |
+           ((uint32_t)variant.fog << 8) |
+           ((uint32_t)variant.shadows << 9) |
+           ((uint32_t)variant.deferred << 10) |
+           ((variant.sampleCount >> 1) << 11) |
+           ((uint32_t)variant.farFade << 13) |
+           ((uint32_t)variant.multiView << 14) |
+           ((uint32_t)variant.virtualTexture << 15) |
+           ((uint32_t)variant.bakedMaterials << 16) |
+           ((uint32_t)variant.skyFog << 17) |
+           ((uint32_t)variant.pointLights << 18) |
+           ((uint32_t)variant.shadingCache << 19) |
+           ((uint32_t)variant.ambientOcclusion << 20) |
+           ((uint32_t)variant.lodDissolve << 21) |
+           ((uint32_t)variant.foliageWind << 22) |
+           ((uint32_t)variant.rayTracedShadows << 23) |
+           ((uint32_t)variant.vertexLighting << 24) |
+           ((uint32_t)variant.depthOnly << 25) |
+           ((uint32_t)variant.overdraw << 26) |
+           ((uint32_t)variant.horizonShadows << 27) |
+           ((uint32_t)variant.indexedInstances << 28);
+}
+
+/// @return The variant shader_variant_key() made key from.
+inline ShaderVariant shader_variant_from_key(uint32_t key) {
+    ShaderVariant variant;
+    variant.program = (ShaderProgram)(key & 15);
+    variant.vertexFormat = (VertexFormat)((key >> 4) & 1);
+    variant.lighting = (LightingModel)((key >> 5) & 3);
+    variant.heightBands = (key >> 7) & 1;
+    variant.fog = (key >> 8) & 1;
+    variant.shadows = (key >> 9) & 1;
+    variant.deferred = (key >> 10) & 1;
+    const uint32_t samples = (key >> 11) & 3;
+    variant.sampleCount = samples == 0 ? 1 : samples << 1;
+    variant.farFade = (key >> 13) & 1;
+    variant.multiView = (key >> 14) & 1;
+    variant.virtualTexture = (key >> 15) & 1;
+    variant.bakedMaterials = (key >> 16) & 1;
+    variant.skyFog = (key >> 17) & 1;
+    variant.pointLights = (key >> 18) & 1;
+    variant.shadingCache = (key >> 19) & 1;
+    variant.ambientOcclusion = (key >> 20) & 1;
+    variant.lodDissolve = (key >> 21) & 1;
+    variant.foliageWind = (key >> 22) & 1;
+    variant.rayTracedShadows = (key >> 23) & 1;
+    variant.vertexLighting = (key >> 24) & 1;
+    variant.depthOnly = (key >> 25) & 1;
+    variant.overdraw = (key >> 26) & 1;
+    variant.horizonShadows = (key >> 27) & 1;
+    variant.indexedInstances = (key >> 28) & 1;
+    return variant;
+}
+
+/**
+ * @brief Returns the variant drawn in place of another while it compiles or if it failed to.
+ *
+ * It keeps what the draw and its pass depend on: the program, the vertex layout, the pass's
+ * attachments and views (deferred, multiView, sampleCount), depthOnly, and where the instances
+ * are read from (indexedInstances). Lighting is Unlit
+ * and every other option is off, so there are few placeholders, they compile quickly, and once
+ * compiled they serve every variant of their pass.
+ */
+inline ShaderVariant shader_variant_placeholder(const ShaderVariant& variant) {
+    ShaderVariant placeholder;
+    placeholder.program = variant.program;
+    placeholder.vertexFormat = variant.vertexFormat;
+    placeholder.lighting = LightingModel::Unlit;
+    placeholder.deferred = variant.deferred;
+    placeholder.multiView = variant.multiView;
+    placeholder.depthOnly = variant.depthOnly;
+    placeholder.indexedInstances = variant.indexedInstances;
+    placeholder.sampleCount = variant.sampleCount;
+    return placeholder;
+}
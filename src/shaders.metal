@@ -1,4 +1,5 @@
 #include <metal_stdlib>
+#include <metal_raytracing>
 using namespace metal;
 
 // Structs used by both pipelines
@@ -7,79 +8,3210 @@ struct Vertex {
     float3 normal   [[attribute(1)]];
 };
 
+// Matches FrameUniforms in objects.hpp; bound once per encoder at buffer 5
+struct FrameUniforms {
+    float4x4 viewProjection;
+    float4x4 previousViewProjection; // Unjittered, of the previous frame
+    float3 cameraPosition;
+    float3 lightDirection;          // Towards the light, unit length
+    float fogDensity;
+    float fadeStart;                // Far fade, from fully visible to fully sky
+    float fadeEnd;
+    uint frameIndex;
+    float4 wind;                    // xy push downwind, z wind angle; see foliage_wind
+};
+
+// Matches Uniforms in objects.hpp; one per draw at buffer 1. Terrain chunks bind one array for
+// all their draws instead and pick their entry by the draw's base instance.
 struct Uniforms {
     float4x4 modelMatrix;
-    float4x4 viewMatrix;
-    float4x4 projectionMatrix;
+    float3x3 normalMatrix;          // Inverse transpose of the model 3x3
     float3 color;
 };
 
+// Selects the PackedVertex layout for the landscape shaders and the terrain generator
+constant bool packed_vertices [[function_constant(0)]];
+
+// Shading features, baked into each pipeline variant; see shader_variant.hpp
+constant uint lighting_model [[function_constant(1)]];
+constant bool height_bands [[function_constant(2)]];
+constant bool distance_fog [[function_constant(3)]];
+constant bool shadows [[function_constant(4)]];
+constant bool far_fade [[function_constant(5)]];
+constant bool virtual_texture [[function_constant(6)]];
+constant bool baked_materials [[function_constant(7)]];
+constant bool sky_fog [[function_constant(8)]];
+constant bool point_lights [[function_constant(9)]];
+constant bool shading_cache [[function_constant(10)]];
+constant bool ambient_occlusion [[function_constant(11)]];
+constant bool lod_dissolve [[function_constant(12)]];
+constant bool foliage_wind [[function_constant(13)]];
+constant bool ray_traced_shadows [[function_constant(14)]];
+constant bool vertex_lighting [[function_constant(15)]];
+constant bool horizon_shadows [[function_constant(16)]];
+constant bool indexed_instances [[function_constant(17)]];
+
+// LightingModel values
+constant uint LIGHTING_UNLIT = 0;
+constant uint LIGHTING_HALF_LAMBERT = 2;
+
+constant float3 AMBIENT = float3(0.2, 0.2, 0.2);
+constant float3 FOG_COLOR = float3(0.6, 0.8, 1.0); // The sky clear colour
+
+// Diffuse term of the variant's lighting model, from the cosine between the normal and the light
+static float diffuse_term(float n_dot_l) {
+    return lighting_model == LIGHTING_HALF_LAMBERT ? (n_dot_l * 0.5 + 0.5) * (n_dot_l * 0.5 + 0.5) : saturate(n_dot_l);
+}
+
+// Lights a surface colour with a diffuse term already taken; visibility scales the direct light
+static float3 lit_color(float3 albedo, float diffuse, float visibility) {
+    if (lighting_model == LIGHTING_UNLIT) {
+        return albedo;
+    }
+    return albedo * (AMBIENT + diffuse * visibility);
+}
+
+// Applies the variant's lighting model to a surface colour; visibility scales the direct light
+static float3 shade(float3 albedo, float3 normal_ws, float3 light, float visibility) {
+    if (lighting_model == LIGHTING_UNLIT) {
+        return albedo;
+    }
+    return lit_color(albedo, diffuse_term(dot(normalize(normal_ws), light)), visibility);
+}
+
+// 4x4 ordered dither. A level fading out keeps the pixels whose threshold is at or above its fade and the
+// level fading in keeps the rest, so while both are drawn they cover the surface once between them.
+constant float LOD_DITHER[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+
+static bool lod_dissolved(float2 pixel, float fade, bool incoming) {
+    uint2 p = uint2(pixel) & 3;
+    float threshold = (LOD_DITHER[p.y * 4 + p.x] + 0.5) / 16.0;
+    return incoming ? threshold >= fade : threshold < fade;
+}
+
+// --- Clustered Point Lights ---
+// The frustum is cut into LIGHT_CLUSTER_X x Y screen tiles and Z exponential depth slices;
+// cluster_lights lists the lights touching each, and fragments only loop over their own list.
+// Everything here matches light_clusters.cpp.
+
+constant uint LIGHT_CLUSTER_X = 16;
+constant uint LIGHT_CLUSTER_Y = 9;
+constant uint LIGHT_CLUSTER_Z = 24;
+constant uint LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+constant uint LIGHT_CLUSTER_MAX_LIGHTS = 64;
+
+// Matches PointLight in light_clusters.hpp
+struct PointLight {
+    float3 position;
+    float3 color;                   // Colour times intensity
+    float radius;                   // Where the contribution reaches zero
+};
+
+// Matches LightClusterUniforms in light_clusters.hpp; buffer 9 of the point_lights fragments
+struct LightClusterUniforms {
+    float4x4 view;
+    float4 projection;              // x and y scales and offsets of the projection
+    float2 viewport;                // Render target size in pixels
+    float nearZ;                    // View depth where the first slice starts
+    float farZ;                     // View depth where the last slice ends
+    uint lightCount;
+};
+
+// Inverse square falloff windowed to zero at the radius; matches light_attenuation
+static float point_light_attenuation(float distance, float radius) {
+    float ratio = distance / radius;
+    float window = saturate(1.0 - ratio * ratio * ratio * ratio);
+    return window * window / (distance * distance + 1.0);
+}
+
+// The cluster a fragment falls in, or LIGHT_CLUSTER_COUNT beyond farZ; matches light_cluster_of
+static uint light_cluster_of(constant LightClusterUniforms &clusters, float2 pixel, float view_depth) {
+    if (view_depth >= clusters.farZ) {
+        return LIGHT_CLUSTER_COUNT;
+    }
+    uint slice = view_depth <= clusters.nearZ
+        ? 0
+        : uint(log(view_depth / clusters.nearZ) / log(clusters.farZ / clusters.nearZ) * float(LIGHT_CLUSTER_Z));
+    uint2 tile = uint2(pixel / clusters.viewport * float2(LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y));
+    tile = min(tile, uint2(LIGHT_CLUSTER_X - 1, LIGHT_CLUSTER_Y - 1));
+    return tile.x + LIGHT_CLUSTER_X * (tile.y + LIGHT_CLUSTER_Y * min(slice, LIGHT_CLUSTER_Z - 1));
+}
+
+// Diffuse light from the point lights of the fragment's cluster, with the variant's lighting model
+static float3 point_lighting(float3 albedo, float3 position_ws, float3 normal_ws, float2 pixel, float view_depth,
+                             constant LightClusterUniforms &clusters, const device PointLight *lights,
+                             const device uint *counts, const device ushort *indices) {
+    if (lighting_model == LIGHTING_UNLIT) {
+        return 0.0;
+    }
+    uint cluster = light_cluster_of(clusters, pixel, view_depth);
+    if (cluster == LIGHT_CLUSTER_COUNT) {
+        return 0.0;
+    }
+    float3 n = normalize(normal_ws);
+    float3 light = 0.0;
+    uint count = min(counts[cluster], LIGHT_CLUSTER_MAX_LIGHTS);
+    for (uint i = 0; i < count; ++i) {
+        PointLight p = lights[indices[cluster * LIGHT_CLUSTER_MAX_LIGHTS + i]];
+        float3 to_light = p.position - position_ws;
+        float distance = length(to_light);
+        float n_dot_l = dot(n, to_light / max(distance, 1e-4));
+        light += p.color * (diffuse_term(n_dot_l) * point_light_attenuation(distance, p.radius));
+    }
+    return albedo * light;
+}
+
+// Matches ShadowUniforms in shadow_map.mm
+struct ShadowUniforms {
+    float4x4 viewProjection[4];     // World to each cascade's clip space
+    float4 splits;                  // View depth where each cascade ends
+    float4 normalOffset;            // World distance receivers are pushed along their normal, per cascade
+    uint cascadeCount;
+    float texelUV;                  // One shadow map texel in texture coordinates
+};
+
+// Fraction of the light reaching a point: 3x3 bilinear comparisons around it in the
+// cascade that covers its view depth. Points past the last cascade are lit.
+static float shadow_visibility(constant ShadowUniforms &shadow, depth2d_array<float> shadowMap,
+                               float3 position_ws, float3 normal_ws, float view_depth) {
+    uint cascade = 0;
+    while (cascade + 1 < shadow.cascadeCount && view_depth > shadow.splits[cascade]) {
+        cascade++;
+    }
+    if (view_depth > shadow.splits[cascade]) {
+        return 1.0;
+    }
+
+    // Offsetting along the normal removes acne on slopes that a constant bias would need to be large for
+    float3 p = position_ws + normalize(normal_ws) * shadow.normalOffset[cascade];
+    // Orthographic: w is 1. The casters were drawn with a slope-scaled depth bias.
+    float4 clip = shadow.viewProjection[cascade] * float4(p, 1.0);
+    float2 uv = clip.xy * float2(0.5, -0.5) + 0.5;
+    float depth = clip.z;
+
+    constexpr sampler compare(coord::normalized, filter::linear, address::clamp_to_edge, compare_func::less_equal);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            lit += shadowMap.sample_compare(compare, uv + float2(x, y) * shadow.texelUV, cascade, depth);
+        }
+    }
+    return lit / 9.0;
+}
+
+// --- Ray-Traced Shadows ---
+// The ray-traced tier of shadow_visibility, see gpu_ray_tracing.hpp: one ray towards the sun
+// through the instance structure of the terrain and the entities. The structures hold the
+// full-detail chunks while farther chunks draw coarser levels, so the ray starts further along
+// the normal with the view depth to clear the difference.
+
+constant float RAY_SHADOW_DISTANCE = 4096.0;
+constant float RAY_NORMAL_OFFSET = 0.05;
+constant float RAY_DEPTH_OFFSET = 0.002;     // Extra normal offset per unit of view depth
+
+// 1 if nothing lies between a point and the sun, else 0. Any hit shadows, so the search stops at the first.
+static float traced_shadow_visibility(raytracing::instance_acceleration_structure scene, float3 position_ws,
+                                      float3 normal_ws, float3 light, float view_depth) {
+    float offset = RAY_NORMAL_OFFSET + RAY_DEPTH_OFFSET * view_depth;
+    raytracing::ray ray(position_ws + normalize(normal_ws) * offset, light, 0.0, RAY_SHADOW_DISTANCE);
+    raytracing::intersector<raytracing::instancing> shadow_rays;
+    shadow_rays.accept_any_intersection(true);
+    shadow_rays.force_opacity(raytracing::forced_opacity::opaque);
+    return shadow_rays.intersect(ray, scene).type == raytracing::intersection_type::none ? 1.0 : 0.0;
+}
+
+// --- Shading Cache ---
+// Reverse reprojection (Nehab et al. 2007), see reprojection.hpp: a fragment finds where its world
+// position was drawn last frame and reuses the shadow visibility cached there if the depth stored
+// with it says it is the same surface. One pixel of each 2x2 block recomputes every frame anyway.
+// Matches reprojection.cpp.
+
+constant uint SHADING_CACHE_REFRESH_FRAMES = 4;
+constant float SHADING_CACHE_DEPTH_TOLERANCE = 0.02;
+
+static bool shading_cache_refresh(uint2 pixel, uint frame) {
+    return (pixel.x & 1) + 2 * (pixel.y & 1) == frame % SHADING_CACHE_REFRESH_FRAMES;
+}
+
+// shadow_visibility() through the cache: read from last frame's cache, recomputed on a miss, and
+// written with the view depth into this frame's. The write is ordered with the raster, so the
+// last fragment to pass the depth test leaves its value.
+static float cached_shadow_visibility(constant ShadowUniforms &shadow, depth2d_array<float> shadowMap,
+                                      float3 position_ws, float3 normal_ws, float view_depth, float2 pixel,
+                                      constant FrameUniforms &frame, texture2d<half> previous,
+                                      texture2d<half, access::write> current) {
+    float visibility = -1.0;
+    if (!shading_cache_refresh(uint2(pixel), frame.frameIndex)) {
+        // Perspective w is the previous view depth
+        float4 clip = frame.previousViewProjection * float4(position_ws, 1.0);
+        float2 uv = clip.xy / clip.w * float2(0.5, -0.5) + 0.5;
+        if (clip.w > 0.0 && all(uv >= 0.0) && all(uv <= 1.0)) {
+            // Filtered, so an edge blends the depths of both sides and misses
+            constexpr sampler linear(coord::normalized, filter::linear, address::clamp_to_edge);
+            float2 cached = float2(previous.sample(linear, uv).rg);
+            if (abs(cached.y - clip.w) <= SHADING_CACHE_DEPTH_TOLERANCE * clip.w) {
+                visibility = cached.x;
+            }
+        }
+    }
+    if (visibility < 0.0) {
+        visibility = shadow_visibility(shadow, shadowMap, position_ws, normal_ws, view_depth);
+    }
+    current.write(half4(half(visibility), half(view_depth), 0.0h, 0.0h), uint2(pixel));
+    return visibility;
+}
+
+// Blends towards the sky colour with squared exponential fog and the far fade, whichever the variant
+// has. Both use the distance from the eye rather than the view depth, so they do not shift as the
+// camera turns and the CPU can cull what they hide by box distance; matches fog_visibility in fog.cpp.
+static float3 apply_fog(float3 color, float3 position_ws, constant FrameUniforms &frame,
+                        float3 fogColor = FOG_COLOR) {
+    if (!distance_fog && !far_fade) {
+        return color;
+    }
+    float distance = length(position_ws - frame.cameraPosition);
+    float visibility = 1.0;
+    if (distance_fog) {
+        float d = frame.fogDensity * distance;
+        visibility = exp(-d * d);
+    }
+    if (far_fade) {
+        visibility *= saturate((frame.fadeEnd - distance) / max(frame.fadeEnd - frame.fadeStart, 1e-6));
+    }
+    return mix(fogColor, color, visibility);
+}
+
+// The scene colour's alpha. In ambient_occlusion variants it is the share of the fogged colour that
+// is ambient light, which the ambient occlusion pass darkens; everything else writes 1.
+static float ambient_share(float3 albedo, float3 color, float3 fogged, float3 position_ws,
+                           constant FrameUniforms &frame, float3 fogColor) {
+    if (!ambient_occlusion) {
+        return 1.0;
+    }
+    if (lighting_model == LIGHTING_UNLIT) {
+        return 0.0;
+    }
+    // Fog is linear in the colour, so what fogging the rest of the light leaves out is the ambient part
+    float3 rest = apply_fog(color - albedo * AMBIENT, position_ws, frame, fogColor);
+    constexpr float3 luma = float3(0.2126, 0.7152, 0.0722);
+    return saturate(dot(fogged - rest, luma) / max(dot(fogged, luma), 1e-4));
+}
+
+// Sky view lookup coordinates of a direction: u from the sun's azimuth to the opposite one, v from
+// the zenith through the horizon (0.5) to the nadir, both square-root spaced; matches
+// atmosphere_sky_view_uv in atmosphere.cpp
+static float2 sky_view_uv(float3 direction, float3 sun) {
+    constexpr float HALF_PI = M_PI_F / 2.0;
+    float elevation = asin(clamp(direction.y, -1.0, 1.0));
+    float v = elevation >= 0.0 ? 0.5 * (1.0 - sqrt(elevation / HALF_PI)) : 0.5 + 0.5 * sqrt(-elevation / HALF_PI);
+    float2 forward = length(sun.xz) > 1e-5 ? normalize(sun.xz) : float2(1.0, 0.0);
+    float horizontal = length(direction.xz);
+    float cosAzimuth = horizontal > 1e-5 ? clamp(dot(direction.xz, forward) / horizontal, -1.0, 1.0) : 1.0;
+    return float2(sqrt(saturate(0.5 - 0.5 * cosAzimuth)), v);
+}
+
+// Exposed sky radiance reaching the viewer from a direction, from the sky view lookup
+static float3 sky_radiance(texture2d<float> skyView, float3 direction, float3 sun) {
+    constexpr sampler linear(coord::normalized, filter::linear, address::clamp_to_edge);
+    return skyView.sample(linear, sky_view_uv(normalize(direction), sun)).rgb;
+}
+
+// The sky's display colour in a direction: what the sky pass draws there, and what sky_fog fades to
+static float3 sky_color(texture2d<float> skyView, float3 direction, float3 sun) {
+    return 1.0 - exp(-sky_radiance(skyView, direction, sun));
+}
+
+// Carries a normal through an instance transform that does not mirror. The cofactor matrix is
+// the inverse transpose scaled by the determinant, and the scale goes when the normal is
+// normalized, so non-uniform scale keeps normals perpendicular without a division.
+static float3 transform_normal(float4x4 model, float3 n) {
+    float3 c0 = model[0].xyz;
+    float3 c1 = model[1].xyz;
+    float3 c2 = model[2].xyz;
+    return float3x3(cross(c1, c2), cross(c2, c0), cross(c0, c1)) * n;
+}
+
+// Octahedral normal decoding; matches decode_octahedral_normal in vertex_packing.cpp
+static float3 decode_octahedral(float2 e) {
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+static float2 encode_octahedral(float3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    float2 e = n.xy;
+    if (n.z < 0.0) {
+        e = (1.0 - abs(e.yx)) * select(float2(-1.0), float2(1.0), e >= 0.0);
+    }
+    return e;
+}
+
+// Surface attributes a deferred pass keeps in tile memory; matches the formats in deferred.hpp.
+// Colour attachment 0 is left to deferred_lighting_fragment.
+struct GBufferOut {
+    half4 albedo [[color(1)]];
+    half2 normal [[color(2)]];      // Octahedral world-space normal
+    float depth  [[color(3)]];      // Clip-space depth, rebuilt into a position when lit
+};
+
+static GBufferOut write_gbuffer(float3 albedo, float3 normal_ws, float4 position) {
+    GBufferOut out;
+    out.albedo = half4(half3(albedo), 1.0h);
+    out.normal = half2(encode_octahedral(normalize(normal_ws)));
+    out.depth = position.z;
+    return out;
+}
+
 // --- Default Object Shaders ---
 
 struct VertexOut {
     float4 position [[position]];
+    float3 position_ws;
     float3 normal_ws; // World space normal
+    float  view_depth;
 };
 
 vertex VertexOut vertex_main(const Vertex in [[stage_in]],
-                             constant Uniforms &uniforms [[buffer(1)]]) {
+                             constant Uniforms &uniforms [[buffer(1)]],
+                             constant FrameUniforms &frame [[buffer(5)]]) {
     VertexOut out;
-    float4 pos = float4(in.position, 1.0);
-    out.position = uniforms.projectionMatrix * uniforms.viewMatrix * uniforms.modelMatrix * pos;
-    out.normal_ws = (uniforms.modelMatrix * float4(in.normal, 0.0)).xyz;
+    float4 world_pos = uniforms.modelMatrix * float4(in.position, 1.0);
+    out.position = frame.viewProjection * world_pos;
+    out.position_ws = world_pos.xyz;
+    out.normal_ws = uniforms.normalMatrix * in.normal;
+    out.view_depth = out.position.w;
     return out;
 }
 
 fragment float4 fragment_main(VertexOut in [[stage_in]],
-                              constant Uniforms &uniforms [[buffer(1)]]) {
-    float3 light_dir = normalize(float3(0.8, 1.0, 0.5));
-    float diffuse_k = saturate(dot(normalize(in.normal_ws), light_dir));
-    float3 ambient = float3(0.2, 0.2, 0.2);
-    float3 final_color = uniforms.color * ambient + uniforms.color * diffuse_k;
-    return float4(final_color, 1.0);
+                              constant Uniforms &uniforms [[buffer(1)]],
+                              constant FrameUniforms &frame [[buffer(5)]],
+                              constant ShadowUniforms &shadow [[buffer(3), function_constant(shadows)]],
+                              depth2d_array<float> shadowMap [[texture(0), function_constant(shadows)]],
+                              texture2d<float> skyView [[texture(4), function_constant(sky_fog)]],
+                              constant LightClusterUniforms &clusters [[buffer(9), function_constant(point_lights)]],
+                              const device PointLight *lights [[buffer(10), function_constant(point_lights)]],
+                              const device uint *clusterCounts [[buffer(11), function_constant(point_lights)]],
+                              const device ushort *clusterLights [[buffer(12), function_constant(point_lights)]],
+                              raytracing::instance_acceleration_structure scene [[buffer(13), function_constant(ray_traced_shadows)]]) {
+    float visibility = 1.0;
+    if (ray_traced_shadows) {
+        visibility = traced_shadow_visibility(scene, in.position_ws, in.normal_ws, frame.lightDirection, in.view_depth);
+    } else if (shadows) {
+        visibility = shadow_visibility(shadow, shadowMap, in.position_ws, in.normal_ws, in.view_depth);
+    }
+    float3 fogColor = FOG_COLOR;
+    if (sky_fog) {
+        fogColor = sky_color(skyView, in.position_ws - frame.cameraPosition, frame.lightDirection);
+    }
+    float3 color = shade(uniforms.color, in.normal_ws, frame.lightDirection, visibility);
+    if (point_lights) {
+        color += point_lighting(uniforms.color, in.position_ws, in.normal_ws, in.position.xy, in.view_depth,
+                                clusters, lights, clusterCounts, clusterLights);
+    }
+    float3 fogged = apply_fog(color, in.position_ws, frame, fogColor);
+    return float4(fogged, ambient_share(uniforms.color, color, fogged, in.position_ws, frame, fogColor));
 }
 
-// --- Landscape Shaders ---
+fragment GBufferOut gbuffer_fragment_main(VertexOut in [[stage_in]],
+                                          constant Uniforms &uniforms [[buffer(1)]]) {
+    return write_gbuffer(uniforms.color, in.normal_ws, in.position);
+}
 
-struct LandscapeVertexOut {
+// --- Instanced Object Shaders ---
+
+struct InstanceData {
+    float4x4 modelMatrix;
+    float4 color;   // rgb flat colour, a how far a foliage part has dissolved into its impostor
+};
+
+// With indexed_instances, buffer 2 holds every scene entity's InstanceData in dense order and the draw's
+// index list at buffer 6 says which of them its instances are; see gpu_scene_instances.hpp
+static uint instance_index(const device uint *indices, uint instance) {
+    return indexed_instances ? indices[instance] : instance;
+}
+
+// Same as foliage_sway in foliage.cpp: sway grows with the square of the height above the base
+static float3 foliage_sway(float4 wind, float4 sway, float3 position) {
+    float height = max(position.y - sway.x, 0.0);
+    float wave = 0.5 + 0.5 * sin(wind.z + sway.y);
+    float gust = 0.7 + 0.3 * sin(0.25 * wind.z + sway.y);
+    float amount = sway.z * height * height * wave * gust;
+    return float3(wind.x, 0.0, wind.y) * amount;
+}
+
+struct InstancedVertexOut {
     float4 position [[position]];
+    float3 position_ws;
     float3 normal_ws; // World space normal
-    float  height;
+    float4 color;
+    float  view_depth;
 };
 
-vertex LandscapeVertexOut landscape_vertex_main(const Vertex in [[stage_in]],
-                                                 constant Uniforms &uniforms [[buffer(1)]]) {
-    LandscapeVertexOut out;
-    float4 world_pos = uniforms.modelMatrix * float4(in.position, 1.0);
-    out.position = uniforms.projectionMatrix * uniforms.viewMatrix * world_pos;
-    out.normal_ws = (uniforms.modelMatrix * float4(in.normal, 0.0)).xyz;
-    out.height = world_pos.y;
+vertex InstancedVertexOut vertex_instanced_main(const Vertex in [[stage_in]],
+                                                const device InstanceData *instances [[buffer(2)]],
+                                                constant FrameUniforms &frame [[buffer(5)]],
+                                                const device float4 *sway [[buffer(3), function_constant(foliage_wind)]],
+                                                const device uint *indices [[buffer(6), function_constant(indexed_instances)]],
+                                                uint instance_id [[instance_id]]) {
+    InstancedVertexOut out;
+    InstanceData instance = instances[instance_index(indices, instance_id)];
+    float4 world_pos = instance.modelMatrix * float4(in.position, 1.0);
+    if (foliage_wind) {
+        world_pos.xyz += foliage_sway(frame.wind, sway[instance_id], world_pos.xyz);
+    }
+    out.position = frame.viewProjection * world_pos;
+    out.position_ws = world_pos.xyz;
+    out.normal_ws = transform_normal(instance.modelMatrix, in.normal);
+    out.color = instance.color;
+    out.view_depth = out.position.w;
     return out;
 }
 
-fragment float4 landscape_fragment_main(LandscapeVertexOut in [[stage_in]]) {
-    float3 final_color;
-    float3 grass_color = float3(0.3, 0.6, 0.2);
+fragment float4 fragment_instanced_main(InstancedVertexOut in [[stage_in]],
+                                        constant FrameUniforms &frame [[buffer(5)]],
+                                        constant ShadowUniforms &shadow [[buffer(3), function_constant(shadows)]],
+                                        depth2d_array<float> shadowMap [[texture(0), function_constant(shadows)]],
+                                        texture2d<float> skyView [[texture(4), function_constant(sky_fog)]],
+                                        constant LightClusterUniforms &clusters [[buffer(9), function_constant(point_lights)]],
+                                        const device PointLight *lights [[buffer(10), function_constant(point_lights)]],
+                                        const device uint *clusterCounts [[buffer(11), function_constant(point_lights)]],
+                                        const device ushort *clusterLights [[buffer(12), function_constant(point_lights)]],
+                                        raytracing::instance_acceleration_structure scene [[buffer(13), function_constant(ray_traced_shadows)]]) {
+    if (lod_dissolve && lod_dissolved(in.position.xy, in.color.a, false)) {
+        discard_fragment();
+    }
+    float visibility = 1.0;
+    if (ray_traced_shadows) {
+        visibility = traced_shadow_visibility(scene, in.position_ws, in.normal_ws, frame.lightDirection, in.view_depth);
+    } else if (shadows) {
+        visibility = shadow_visibility(shadow, shadowMap, in.position_ws, in.normal_ws, in.view_depth);
+    }
+    float3 fogColor = FOG_COLOR;
+    if (sky_fog) {
+        fogColor = sky_color(skyView, in.position_ws - frame.cameraPosition, frame.lightDirection);
+    }
+    float3 color = shade(in.color.rgb, in.normal_ws, frame.lightDirection, visibility);
+    if (point_lights) {
+        color += point_lighting(in.color.rgb, in.position_ws, in.normal_ws, in.position.xy, in.view_depth,
+                                clusters, lights, clusterCounts, clusterLights);
+    }
+    float3 fogged = apply_fog(color, in.position_ws, frame, fogColor);
+    return float4(fogged, ambient_share(in.color.rgb, color, fogged, in.position_ws, frame, fogColor));
+}
+
+fragment GBufferOut gbuffer_instanced_fragment(InstancedVertexOut in [[stage_in]]) {
+    if (lod_dissolve && lod_dissolved(in.position.xy, in.color.a, false)) {
+        discard_fragment();
+    }
+    return write_gbuffer(in.color.rgb, in.normal_ws, in.position);
+}
+
+// --- Meshlet Shaders ---
+// Instanced cooked meshes drawn per meshlet; the fragment stage is the instanced one.
+
+// Matches MESHLET_OBJECT_THREADS, MESHLET_MESH_THREADS and the meshlet limits on the CPU side
+constant uint MESHLET_OBJECT_THREADS = 32;
+constant uint MESHLET_MESH_THREADS = 128;
+constant uint MESHLET_MAX_VERTICES = 64;
+constant uint MESHLET_MAX_TRIANGLES = 124;
+
+// Matches MeshletUniforms in meshlet_draw.hpp
+struct MeshletUniforms {
+    float4x4 viewProjection;
+    float4 frustumPlanes[6];        // Inward facing, world space
+    float3 cameraPosition;
+    uint meshletCount;
+    uint instanceCount;
+    uint vertexListOffset;          // Byte offsets into the meshlet buffer
+    uint triangleListOffset;
+    uint baseVertex;                // The mesh's first vertex in the vertex buffer
+};
+
+// Matches Meshlet in mesh_asset.hpp
+struct MeshletBounds {
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+    packed_float3 center;
+    float radius;
+    packed_float3 coneAxis;
+    float coneCutoff;
+};
+
+// The Vertex layout read as a plain buffer
+struct MeshletVertex {
+    float3 position;
+    float3 normal;
+};
+
+struct MeshletPayload {
+    uint instance;
+    uint meshlets[MESHLET_OBJECT_THREADS]; // Visible meshlets, one mesh threadgroup each
+};
+
+// Moves a world space point into the model space of an affine transform
+static float3 to_model_space(float4x4 model, float3 p) {
+    float3 c0 = model[0].xyz;
+    float3 c1 = model[1].xyz;
+    float3 c2 = model[2].xyz;
+    float3 d = p - model[3].xyz;
+    // Rows of the inverse are the cross products of the columns over the determinant
+    float det = dot(c0, cross(c1, c2));
+    return float3(dot(cross(c1, c2), d), dot(cross(c2, c0), d), dot(cross(c0, c1), d)) / det;
+}
+
+// Same test as meshlet_backfacing in mesh_asset.cpp
+static bool meshlet_backfacing(MeshletBounds meshlet, float3 viewpoint) {
+    float3 d = float3(meshlet.center) - viewpoint;
+    return dot(d, float3(meshlet.coneAxis)) >= meshlet.coneCutoff * length(d) + meshlet.radius;
+}
+
+// One thread per meshlet of one instance: frustum and normal cone culling, then one mesh
+// threadgroup per survivor
+[[object]] void meshlet_object(object_data MeshletPayload &payload [[payload]],
+                               mesh_grid_properties grid,
+                               constant MeshletUniforms &uniforms [[buffer(1)]],
+                               const device InstanceData *instances [[buffer(2)]],
+                               const device MeshletBounds *meshlets [[buffer(3)]],
+                               const device uint *indices [[buffer(6), function_constant(indexed_instances)]],
+                               uint2 group [[threadgroup_position_in_grid]],
+                               uint lane [[thread_index_in_threadgroup]]) {
+    uint index = group.x * MESHLET_OBJECT_THREADS + lane;
+    uint instance = instance_index(indices, group.y);
+    float4x4 model = instances[instance].modelMatrix;
+
+    bool visible = false;
+    if (index < uniforms.meshletCount) {
+        MeshletBounds meshlet = meshlets[index];
+        float3 center = (model * float4(float3(meshlet.center), 1.0)).xyz;
+        float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+        float radius = meshlet.radius * scale;
+        visible = true;
+        for (uint i = 0; i < 6; ++i) {
+            float4 plane = uniforms.frustumPlanes[i];
+            visible = visible && dot(plane.xyz, center) + plane.w >= -radius;
+        }
+        // The cone test holds under any affine transform, so it runs in model space
+        if (visible && meshlet.coneCutoff < 1.0) {
+            visible = !meshlet_backfacing(meshlet, to_model_space(model, uniforms.cameraPosition));
+        }
+    }
+
+    uint slot = simd_prefix_exclusive_sum(uint(visible));
+    if (visible) {
+        payload.meshlets[slot] = index;
+    }
+    uint count = simd_sum(uint(visible));
+    if (lane == 0) {
+        payload.instance = instance;
+        grid.set_threadgroups_per_grid(uint3(count, 1, 1));
+    }
+}
+
+using MeshletMesh = mesh<InstancedVertexOut, void, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, topology::triangle>;
+
+// One threadgroup per visible meshlet: transforms its vertices and copies its local triangle list
+[[mesh]] void meshlet_mesh(MeshletMesh output,
+                           const object_data MeshletPayload &payload [[payload]],
+                           const device MeshletVertex *vertices [[buffer(0)]],
+                           constant MeshletUniforms &uniforms [[buffer(1)]],
+                           const device InstanceData *instances [[buffer(2)]],
+                           const device uchar *meshletData [[buffer(3)]],
+                           uint group [[threadgroup_position_in_grid]],
+                           uint lane [[thread_index_in_threadgroup]]) {
+    MeshletBounds meshlet = ((const device MeshletBounds *)meshletData)[payload.meshlets[group]];
+    InstanceData instance = instances[payload.instance];
+
+    if (lane == 0) {
+        output.set_primitive_count(meshlet.triangleCount);
+    }
+    if (lane < meshlet.vertexCount) {
+        const device uint *vertexList = (const device uint *)(meshletData + uniforms.vertexListOffset);
+        MeshletVertex in = vertices[uniforms.baseVertex + vertexList[meshlet.vertexOffset + lane]];
+
+        InstancedVertexOut out;
+        float4 world_pos = instance.modelMatrix * float4(in.position, 1.0);
+        out.position = uniforms.viewProjection * world_pos;
+        out.position_ws = world_pos.xyz;
+        out.normal_ws = transform_normal(instance.modelMatrix, in.normal);
+        out.color = instance.color;
+        out.view_depth = out.position.w;
+        output.set_vertex(lane, out);
+    }
+
+    const device uchar *triangles = meshletData + uniforms.triangleListOffset + meshlet.triangleOffset;
+    for (uint i = lane; i < meshlet.triangleCount * 3; i += MESHLET_MESH_THREADS) {
+        output.set_index(i, triangles[i]);
+    }
+}
+
+// --- Landscape Shaders ---
+
+// The position is invariant so the depth pre-pass and the colour pass compute bit-identical depth
+struct LandscapeVertexOut {
+    float4 position [[position, invariant]];
+    float3 position_ws;
+    float3 normal_ws; // World space normal
+    float  view_depth;
+    float3 albedo;    // Surface colour used when height_bands is off; the band colour with vertex_lighting
+    float  diffuse;   // Diffuse term of the sun at the vertex; only written with vertex_lighting
+};
+
+constant float3 TERRAIN_GRASS_COLOR = float3(0.3, 0.6, 0.2);
+
+// Grass below 0, rock at 4, snow above 8, blended linearly in between without branches
+static float3 terrain_band_albedo(float height) {
     float3 rock_color = float3(0.5, 0.5, 0.5);
     float3 snow_color = float3(1.0, 1.0, 1.0);
+    float3 albedo = mix(TERRAIN_GRASS_COLOR, rock_color, saturate(height / 4.0));
+    return mix(albedo, snow_color, saturate((height - 4.0) / 4.0));
+}
+
+// Takes any vertex output with position_ws and albedo, so the multi-view variants share it. With
+// vertex_lighting the vertex stage has blended the bands already.
+template <typename SurfaceIn>
+static float3 landscape_albedo(SurfaceIn in) {
+    return height_bands && !vertex_lighting ? terrain_band_albedo(in.position_ws.y) : in.albedo;
+}
+
+// With vertex_lighting, chunks whose cells cover a few pixels (see select_vertex_lit_chunks) take
+// their band colour and diffuse term per vertex, and the fragment stage only interpolates them
+static void light_landscape_vertex(thread LandscapeVertexOut &out, constant FrameUniforms &frame) {
+    if (!vertex_lighting) {
+        return;
+    }
+    if (height_bands) {
+        out.albedo = terrain_band_albedo(out.position_ws.y);
+    }
+    out.diffuse = diffuse_term(dot(normalize(out.normal_ws), frame.lightDirection));
+}
 
-    if (in.height > 8.0) {
-        final_color = snow_color;
-    } else if (in.height > 4.0) {
-        float blend = (in.height - 4.0) / 4.0;
-        final_color = mix(rock_color, snow_color, blend);
-    } else if (in.height > 0.0) {
-        float blend = (in.height - 0.0) / 4.0;
-        final_color = mix(grass_color, rock_color, blend);
+// Fed either Float3 attributes or, with packed_vertices, UShort4Normalized positions in the
+// chunk's quantization box (unpacked by modelMatrix) and Short2Normalized octahedral normals
+struct LandscapeVertexIn {
+    float4 position [[attribute(0)]];
+    float3 normal   [[attribute(1)]];
+};
+
+vertex LandscapeVertexOut landscape_vertex_main(const LandscapeVertexIn in [[stage_in]],
+                                                 uint draw_id [[instance_id]],
+                                                 const device Uniforms *draws [[buffer(1)]],
+                                                 constant FrameUniforms &frame [[buffer(5)]]) {
+    const device Uniforms &uniforms = draws[draw_id];
+    LandscapeVertexOut out;
+    float4 world_pos = uniforms.modelMatrix * float4(in.position.xyz, 1.0);
+    out.position = frame.viewProjection * world_pos;
+    if (packed_vertices) {
+        // The quantization matrix only translates and scales, so the normal is already in world space
+        out.normal_ws = decode_octahedral(in.normal.xy);
     } else {
-        final_color = grass_color;
+        out.normal_ws = uniforms.normalMatrix * in.normal;
+    }
+    out.position_ws = world_pos.xyz;
+    out.view_depth = out.position.w;
+    out.albedo = TERRAIN_GRASS_COLOR;
+    light_landscape_vertex(out, frame);
+    return out;
+}
+
+// Height-map chunks have no vertex buffer. The shared LOD index lists address the chunk's grid
+// row-major, so the vertex ID names a texel, and the model matrix from terrain_height_map_matrix
+// maps (column, height, row) to world space.
+static uint2 height_map_texel(uint vertex_id, texture2d<float, access::read> heights) {
+    uint width = heights.get_width();
+    return uint2(vertex_id % width, vertex_id / width);
+}
+
+vertex LandscapeVertexOut landscape_vertex_heightmap(uint vertex_id [[vertex_id]],
+                                                     uint draw_id [[instance_id]],
+                                                     const device Uniforms *draws [[buffer(1)]],
+                                                     constant FrameUniforms &frame [[buffer(5)]],
+                                                     texture2d<float, access::read> heights [[texture(0)]],
+                                                     texture2d<float, access::read> normals [[texture(1)]]) {
+    const device Uniforms &uniforms = draws[draw_id];
+    uint2 texel = height_map_texel(vertex_id, heights);
+    float4 world_pos = uniforms.modelMatrix * float4(float(texel.x), heights.read(texel).r, float(texel.y), 1.0);
+    // World space X and Z of the normal; terrain normals always point up. Matches decode_terrain_normal.
+    float2 xz = normals.read(texel).rg;
+
+    LandscapeVertexOut out;
+    out.position = frame.viewProjection * world_pos;
+    out.normal_ws = normalize(float3(xz.x, sqrt(saturate(1.0 - dot(xz, xz))), xz.y));
+    out.position_ws = world_pos.xyz;
+    out.view_depth = out.position.w;
+    out.albedo = TERRAIN_GRASS_COLOR;
+    light_landscape_vertex(out, frame);
+    return out;
+}
+
+// Matches TerrainMaterialUniforms in terrain_material.hpp
+struct TerrainMaterialUniforms {
+    float chunkSize;
+    uint tiles;
+    uint tileTexels;
+    float atlasTexels;
+};
+
+// Reads the albedo baked for the fragment's chunk. Chunk k owns tile k modulo the tile count,
+// and its texels sit on the chunk's vertices, so the filter stays inside the tile.
+static float3 baked_albedo(float3 position_ws, constant TerrainMaterialUniforms &materials,
+                           texture2d<float> atlas) {
+    float2 cell = position_ws.xz / materials.chunkSize;
+    float2 chunk = floor(cell);
+    float tiles = float(materials.tiles);
+    float2 tile = chunk - tiles * floor(chunk / tiles);
+    float2 texel = tile * float(materials.tileTexels) + 0.5 + (cell - chunk) * float(materials.tileTexels - 1);
+    constexpr sampler bilinear(filter::linear, address::clamp_to_edge);
+    return atlas.sample(bilinear, texel / materials.atlasTexels).rgb;
+}
+
+// Matches TerrainHorizonUniforms in terrain_horizon.hpp
+struct TerrainHorizonUniforms {
+    float chunkSize;
+    uint tiles;
+    uint tileTexels;
+    float atlasTexels;
+    float cascadeEnd;
+    float fadeDepth;
+    float softness;
+    float padding;
+};
+
+// The sun's visibility over the horizon baked for the fragment's chunk, addressed like baked_albedo;
+// matches terrain_horizon_visibility in terrain_horizon.cpp. Slice 0 holds directions 0-3, slice 1 4-7.
+static float horizon_visibility(float3 position_ws, float3 light, constant TerrainHorizonUniforms &horizons,
+                                texture2d_array<float> atlas) {
+    float2 cell = position_ws.xz / horizons.chunkSize;
+    float2 chunk = floor(cell);
+    float tiles = float(horizons.tiles);
+    float2 tile = chunk - tiles * floor(chunk / tiles);
+    float2 texel = tile * float(horizons.tileTexels) + 0.5 + (cell - chunk) * float(horizons.tileTexels - 1);
+    constexpr sampler bilinear(filter::linear, address::clamp_to_edge);
+    float2 uv = texel / horizons.atlasTexels;
+    float4 first = atlas.sample(bilinear, uv, 0);
+    float4 second = atlas.sample(bilinear, uv, 1);
+    float sines[8] = { first.x, first.y, first.z, first.w, second.x, second.y, second.z, second.w };
+
+    float azimuth = atan2(light.z, light.x) * (8.0 / (2.0 * M_PI_F));
+    azimuth -= 8.0 * floor(azimuth / 8.0);
+    uint below = min(uint(azimuth), 7u);
+    float horizon = mix(sines[below], sines[(below + 1) & 7], azimuth - float(below));
+    float elevation = light.y / length(light);
+    float s = saturate((elevation - (horizon - horizons.softness)) / max(2.0 * horizons.softness, 1e-6));
+    return s * s * (3.0 - 2.0 * s);
+}
+
+// Matches VirtualTextureUniforms in virtual_texture.hpp
+struct VirtualTextureUniforms {
+    float originX;
+    float originZ;
+    float worldSize;
+    uint size;
+    uint pageWidth;
+    uint pageHeight;
+    uint sparseMips;
+    uint minMipWidth;
+    uint minMipHeight;
+    uint pageOffset[16];
+    uint pagesX[16];
+};
+
+// Samples the terrain's virtual texture where it covers the fragment, else keeps the band colour.
+// Every fourth pixel in each direction records the page it needs in the feedback bitmap, which is
+// enough to find every page on screen; sampling is clamped to the finest level the min-mip map
+// says is resident around the fragment, so pages that are still streaming fall back to coarser ones.
+static float3 virtual_texture_albedo(float3 fallback, float3 position_ws, float4 frag_position,
+                                     constant VirtualTextureUniforms &vt, texture2d<float> pages,
+                                     texture2d<uint> minMip, device atomic_uint *feedback) {
+    float2 uv = (position_ws.xz - float2(vt.originX, vt.originZ)) / vt.worldSize;
+    if (any(uv < 0.0) || any(uv >= 1.0)) {
+        return fallback;
+    }
+    constexpr sampler trilinear(filter::linear, mip_filter::linear, address::clamp_to_edge, max_anisotropy(8));
+    if ((uint(frag_position.x) & 3) == 0 && (uint(frag_position.y) & 3) == 0) {
+        uint mip = uint(max(pages.calculate_unclamped_lod(trilinear, uv), 0.0));
+        if (mip < vt.sparseMips) {
+            uint2 page = uint2(uv * float(max(vt.size >> mip, 1u))) / uint2(vt.pageWidth, vt.pageHeight);
+            uint index = vt.pageOffset[mip] + page.y * vt.pagesX[mip] + page.x;
+            atomic_fetch_or_explicit(&feedback[index >> 5], 1u << (index & 31), memory_order_relaxed);
+        }
+    }
+    // The filter footprint can reach into the neighbouring pages, so take the coarsest level of the four nearest
+    constexpr sampler nearest(filter::nearest, address::clamp_to_edge);
+    uint4 levels = minMip.gather(nearest, uv);
+    float minLod = float(max(max(levels.x, levels.y), max(levels.z, levels.w)));
+    return pages.sample(trilinear, uv, min_lod_clamp(minLod)).rgb;
+}
+
+// Early depth testing stays on although the virtual texture feedback writes to memory: the
+// feedback is only wanted from fragments that end up visible
+[[early_fragment_tests]]
+fragment float4 landscape_fragment_main(LandscapeVertexOut in [[stage_in]],
+                                        constant FrameUniforms &frame [[buffer(5)]],
+                                        constant ShadowUniforms &shadow [[buffer(3), function_constant(shadows)]],
+                                        depth2d_array<float> shadowMap [[texture(0), function_constant(shadows)]],
+                                        constant VirtualTextureUniforms &vt [[buffer(6), function_constant(virtual_texture)]],
+                                        texture2d<float> vtPages [[texture(1), function_constant(virtual_texture)]],
+                                        texture2d<uint> vtMinMip [[texture(2), function_constant(virtual_texture)]],
+                                        device atomic_uint *vtFeedback [[buffer(7), function_constant(virtual_texture)]],
+                                        constant TerrainMaterialUniforms &materials [[buffer(8), function_constant(baked_materials)]],
+                                        texture2d<float> materialAtlas [[texture(3), function_constant(baked_materials)]],
+                                        texture2d<float> skyView [[texture(4), function_constant(sky_fog)]],
+                                        constant LightClusterUniforms &clusters [[buffer(9), function_constant(point_lights)]],
+                                        const device PointLight *lights [[buffer(10), function_constant(point_lights)]],
+                                        const device uint *clusterCounts [[buffer(11), function_constant(point_lights)]],
+                                        const device ushort *clusterLights [[buffer(12), function_constant(point_lights)]],
+                                        texture2d<half> cachePrevious [[texture(6), function_constant(shading_cache)]],
+                                        texture2d<half, access::write> cacheCurrent [[texture(7), raster_order_group(0), function_constant(shading_cache)]],
+                                        raytracing::instance_acceleration_structure scene [[buffer(13), function_constant(ray_traced_shadows)]],
+                                        constant TerrainHorizonUniforms &horizons [[buffer(14), function_constant(horizon_shadows)]],
+                                        texture2d_array<float> horizonAtlas [[texture(5), function_constant(horizon_shadows)]]) {
+    float3 albedo = baked_materials ? baked_albedo(in.position_ws, materials, materialAtlas) : landscape_albedo(in);
+    if (virtual_texture) {
+        albedo = virtual_texture_albedo(albedo, in.position_ws, in.position, vt, vtPages, vtMinMip, vtFeedback);
+    }
+    float visibility = 1.0;
+    if (ray_traced_shadows) {
+        visibility = traced_shadow_visibility(scene, in.position_ws, in.normal_ws, frame.lightDirection, in.view_depth);
+    } else if (shadows && shading_cache) {
+        visibility = cached_shadow_visibility(shadow, shadowMap, in.position_ws, in.normal_ws, in.view_depth, in.position.xy, frame,
+                                              cachePrevious, cacheCurrent);
+    } else if (shadows) {
+        visibility = shadow_visibility(shadow, shadowMap, in.position_ws, in.normal_ws, in.view_depth);
+    }
+    if (horizon_shadows) {
+        // The horizon fades in over the last fadeDepth of the cascades, which are lit past their end
+        float fadeStart = horizons.cascadeEnd - horizons.fadeDepth;
+        float takeOver = saturate((in.view_depth - fadeStart) / max(horizons.fadeDepth, 1e-6));
+        if (takeOver > 0.0) {
+            float horizon = horizon_visibility(in.position_ws, frame.lightDirection, horizons, horizonAtlas);
+            visibility = min(visibility, mix(1.0, horizon, takeOver));
+        }
+    }
+    float3 fogColor = FOG_COLOR;
+    if (sky_fog) {
+        fogColor = sky_color(skyView, in.position_ws - frame.cameraPosition, frame.lightDirection);
+    }
+    float3 color = vertex_lighting ? lit_color(albedo, in.diffuse, visibility)
+                                   : shade(albedo, in.normal_ws, frame.lightDirection, visibility);
+    if (point_lights) {
+        color += point_lighting(albedo, in.position_ws, in.normal_ws, in.position.xy, in.view_depth,
+                                clusters, lights, clusterCounts, clusterLights);
+    }
+    float3 fogged = apply_fog(color, in.position_ws, frame, fogColor);
+    return float4(fogged, ambient_share(albedo, color, fogged, in.position_ws, frame, fogColor));
+}
+
+[[early_fragment_tests]]
+fragment GBufferOut landscape_gbuffer_fragment(LandscapeVertexOut in [[stage_in]],
+                                               constant VirtualTextureUniforms &vt [[buffer(6), function_constant(virtual_texture)]],
+                                               texture2d<float> vtPages [[texture(1), function_constant(virtual_texture)]],
+                                               texture2d<uint> vtMinMip [[texture(2), function_constant(virtual_texture)]],
+                                               device atomic_uint *vtFeedback [[buffer(7), function_constant(virtual_texture)]],
+                                               constant TerrainMaterialUniforms &materials [[buffer(8), function_constant(baked_materials)]],
+                                               texture2d<float> materialAtlas [[texture(3), function_constant(baked_materials)]]) {
+    float3 albedo = baked_materials ? baked_albedo(in.position_ws, materials, materialAtlas) : landscape_albedo(in);
+    if (virtual_texture) {
+        albedo = virtual_texture_albedo(albedo, in.position_ws, in.position, vt, vtPages, vtMinMip, vtFeedback);
+    }
+    return write_gbuffer(albedo, in.normal_ws, in.position);
+}
+
+// --- Overdraw ---
+
+// Stands in for the fragment function of every scene surface in the overdraw view. Blended additively, a pixel
+// shaded once turns dark red, eight times bright red and from sixteen on yellow to white. Blending keeps the GPU
+// from removing hidden surfaces itself, so only the depth test, and with it the draw order, spares fragments.
+constant half4 OVERDRAW_STEP = half4(0.125h, 0.05h, 0.02h, 0.0h);
+
+[[early_fragment_tests]]
+fragment half4 overdraw_fragment() {
+    return OVERDRAW_STEP;
+}
+
+// --- Multi-View ---
+// Vertex amplification runs the vertex stage once per view of the group a draw is amplified to.
+// FrameUniforms at buffer 5 become an array with one entry per view of the group, and the
+// encoder's view mappings add each view's render target slice and viewport to the zeros written
+// here. Shadows are not offered: the cascades are fitted to the main camera.
+
+struct InstancedMultiViewOut {
+    float4 position [[position]];
+    float3 position_ws;
+    float3 normal_ws;
+    float3 color;
+    uint view [[flat]];
+    uint layer [[render_target_array_index]];
+    uint viewport [[viewport_array_index]];
+};
+
+vertex InstancedMultiViewOut vertex_instanced_multiview(const Vertex in [[stage_in]],
+                                                        const device InstanceData *instances [[buffer(2)]],
+                                                        constant FrameUniforms *views [[buffer(5)]],
+                                                        const device uint *indices [[buffer(6), function_constant(indexed_instances)]],
+                                                        uint instance_id [[instance_id]],
+                                                        ushort amp [[amplification_id]]) {
+    InstancedMultiViewOut out;
+    InstanceData instance = instances[instance_index(indices, instance_id)];
+    float4 world_pos = instance.modelMatrix * float4(in.position, 1.0);
+    out.position = views[amp].viewProjection * world_pos;
+    out.position_ws = world_pos.xyz;
+    out.normal_ws = transform_normal(instance.modelMatrix, in.normal);
+    out.color = instance.color.rgb;
+    out.view = amp;
+    out.layer = 0;
+    out.viewport = 0;
+    return out;
+}
+
+fragment float4 fragment_instanced_multiview(InstancedMultiViewOut in [[stage_in]],
+                                             constant FrameUniforms *views [[buffer(5)]]) {
+    constant FrameUniforms &frame = views[in.view];
+    return float4(apply_fog(shade(in.color, in.normal_ws, frame.lightDirection, 1.0), in.position_ws, frame), 1.0);
+}
+
+struct LandscapeMultiViewOut {
+    float4 position [[position]];
+    float3 position_ws;
+    float3 normal_ws;
+    float3 albedo;
+    uint view [[flat]];
+    uint layer [[render_target_array_index]];
+    uint viewport [[viewport_array_index]];
+};
+
+vertex LandscapeMultiViewOut landscape_vertex_multiview(const LandscapeVertexIn in [[stage_in]],
+                                                        uint draw_id [[instance_id]],
+                                                        const device Uniforms *draws [[buffer(1)]],
+                                                        constant FrameUniforms *views [[buffer(5)]],
+                                                        ushort amp [[amplification_id]]) {
+    const device Uniforms &uniforms = draws[draw_id];
+    LandscapeMultiViewOut out;
+    float4 world_pos = uniforms.modelMatrix * float4(in.position.xyz, 1.0);
+    out.position = views[amp].viewProjection * world_pos;
+    out.normal_ws = packed_vertices ? decode_octahedral(in.normal.xy) : uniforms.normalMatrix * in.normal;
+    out.position_ws = world_pos.xyz;
+    out.albedo = TERRAIN_GRASS_COLOR;
+    out.view = amp;
+    out.layer = 0;
+    out.viewport = 0;
+    return out;
+}
+
+fragment float4 landscape_fragment_multiview(LandscapeMultiViewOut in [[stage_in]],
+                                             constant FrameUniforms *views [[buffer(5)]]) {
+    constant FrameUniforms &frame = views[in.view];
+    float3 albedo = landscape_albedo(in);
+    return float4(apply_fog(shade(albedo, in.normal_ws, frame.lightDirection, 1.0), in.position_ws, frame), 1.0);
+}
+
+// --- Shadow Casters ---
+// Depth only: no fragment function. The chunk's Uniforms entry, picked by base instance, carries its
+// transform and FrameUniforms the cascade's view-projection; attribute 0 is read as float3 or, for
+// packed chunks, unorm16.
+
+struct ShadowVertexIn {
+    float4 position [[attribute(0)]];
+};
+
+vertex float4 shadow_landscape_vertex(const ShadowVertexIn in [[stage_in]],
+                                      uint draw_id [[instance_id]],
+                                      const device Uniforms *draws [[buffer(1)]],
+                                      constant FrameUniforms &frame [[buffer(5)]]) {
+    return frame.viewProjection * (draws[draw_id].modelMatrix * float4(in.position.xyz, 1.0));
+}
+
+vertex float4 shadow_landscape_heightmap_vertex(uint vertex_id [[vertex_id]],
+                                                uint draw_id [[instance_id]],
+                                                const device Uniforms *draws [[buffer(1)]],
+                                                constant FrameUniforms &frame [[buffer(5)]],
+                                                texture2d<float, access::read> heights [[texture(0)]]) {
+    uint2 texel = height_map_texel(vertex_id, heights);
+    return frame.viewProjection *
+           (draws[draw_id].modelMatrix * float4(float(texel.x), heights.read(texel).r, float(texel.y), 1.0));
+}
+
+vertex float4 shadow_instanced_vertex(const ShadowVertexIn in [[stage_in]],
+                                      const device InstanceData *instances [[buffer(2)]],
+                                      constant FrameUniforms &frame [[buffer(5)]],
+                                      uint instance_id [[instance_id]]) {
+    return frame.viewProjection * (instances[instance_id].modelMatrix * float4(in.position.xyz, 1.0));
+}
+
+// --- Deferred Lighting ---
+// The last draw of a deferred pass: one triangle over the screen at the far plane. The pass
+// depth test (Greater, or Less with reverse-Z) drops the sky, and every covered pixel reads its
+// surface from the tile's G-buffer and is lit exactly as the forward fragments would light it.
+
+// Matches DeferredUniforms in deferred.mm
+struct DeferredUniforms {
+    float4x4 inverseViewProjection;
+    float farDepth;                 // Depth of the far plane: 1, or 0 with reverse-Z
+};
+
+struct DeferredVertexOut {
+    float4 position [[position]];
+    float2 ndc;
+};
+
+vertex DeferredVertexOut deferred_lighting_vertex(uint vertex_id [[vertex_id]],
+                                                 constant DeferredUniforms &deferred [[buffer(0)]]) {
+    float2 uv = float2((vertex_id << 1) & 2, vertex_id & 2);
+    DeferredVertexOut out;
+    out.ndc = uv * 2.0 - 1.0;
+    out.position = float4(out.ndc, deferred.farDepth, 1.0);
+    return out;
+}
+
+fragment float4 deferred_lighting_fragment(DeferredVertexOut in [[stage_in]],
+                                           half4 albedo [[color(1)]],
+                                           half2 normal [[color(2)]],
+                                           float depth [[color(3)]],
+                                           constant DeferredUniforms &deferred [[buffer(0)]],
+                                           constant FrameUniforms &frame [[buffer(5)]],
+                                           constant ShadowUniforms &shadow [[buffer(3), function_constant(shadows)]],
+                                           depth2d_array<float> shadowMap [[texture(0), function_constant(shadows)]],
+                                           texture2d<float> skyView [[texture(4), function_constant(sky_fog)]],
+                                           constant LightClusterUniforms &clusters [[buffer(9), function_constant(point_lights)]],
+                                           const device PointLight *lights [[buffer(10), function_constant(point_lights)]],
+                                           const device uint *clusterCounts [[buffer(11), function_constant(point_lights)]],
+                                           const device ushort *clusterLights [[buffer(12), function_constant(point_lights)]],
+                                           texture2d<half> cachePrevious [[texture(6), function_constant(shading_cache)]],
+                                           texture2d<half, access::write> cacheCurrent [[texture(7), raster_order_group(0), function_constant(shading_cache)]],
+                                           raytracing::instance_acceleration_structure scene [[buffer(13), function_constant(ray_traced_shadows)]]) {
+    // The unprojected w is 1 / clip w, and clip w is the view depth
+    float4 world = deferred.inverseViewProjection * float4(in.ndc, depth, 1.0);
+    float view_depth = 1.0 / world.w;
+    float3 position_ws = world.xyz * view_depth;
+    float3 normal_ws = decode_octahedral(float2(normal));
+
+    float visibility = 1.0;
+    if (ray_traced_shadows) {
+        visibility = traced_shadow_visibility(scene, position_ws, normal_ws, frame.lightDirection, view_depth);
+    } else if (shadows && shading_cache) {
+        visibility = cached_shadow_visibility(shadow, shadowMap, position_ws, normal_ws, view_depth, in.position.xy, frame,
+                                              cachePrevious, cacheCurrent);
+    } else if (shadows) {
+        visibility = shadow_visibility(shadow, shadowMap, position_ws, normal_ws, view_depth);
+    }
+    float3 fogColor = FOG_COLOR;
+    if (sky_fog) {
+        fogColor = sky_color(skyView, position_ws - frame.cameraPosition, frame.lightDirection);
+    }
+    float3 color = shade(float3(albedo.rgb), normal_ws, frame.lightDirection, visibility);
+    if (point_lights) {
+        color += point_lighting(float3(albedo.rgb), position_ws, normal_ws, in.position.xy, view_depth,
+                                clusters, lights, clusterCounts, clusterLights);
+    }
+    float3 fogged = apply_fog(color, position_ws, frame, fogColor);
+    return float4(fogged, ambient_share(float3(albedo.rgb), color, fogged, position_ws, frame, fogColor));
+}
+
+// --- Noise ---
+// noise_shared.hpp is the same source noise.cpp compiles. Lattice hashes wrap in uint, every
+// product that feeds a sum is an explicit fma, and the library is built without fast math, so
+// with a polynomial interpolant every value matches the CPU bit for bit.
+
+#include "noise_shared.hpp"
+
+static float gpu_fractal_noise(float x, float z, NoiseSettings settings) {
+    return noise_shared::fractal<noise_shared::Scalar, 0>(x, z, settings);
+}
+
+static noise_shared::Sample<float> gpu_fractal_noise_sample(float x, float z, NoiseSettings settings) {
+    return noise_shared::fractal_derivative<noise_shared::Scalar, 0>(x, z, settings);
+}
+
+static float gpu_noise_height(float2 p, float noiseOffset, float noiseScale, float heightScale, NoiseSettings noise) {
+    float2 n = (p + noiseOffset) * noiseScale;
+    return gpu_fractal_noise(n.x, n.y, noise) * heightScale;
+}
+
+// Height and world-space gradient in one evaluation; the height equals gpu_noise_height's, as
+// get_terrain_sample's equals get_terrain_height's
+static float3 gpu_noise_height_gradient(float2 p, float noiseOffset, float noiseScale, float heightScale,
+                                        NoiseSettings noise) {
+    float2 n = (p + noiseOffset) * noiseScale;
+    noise_shared::Sample<float> s = gpu_fractal_noise_sample(n.x, n.y, noise);
+    float slope = noiseScale * heightScale;
+    return float3(s.value * heightScale, s.dx * slope, s.dz * slope);
+}
+
+// Evaluates fractal noise and its derivatives at arbitrary points, so the CPU implementation can be
+// checked against this one
+kernel void evaluate_noise(constant NoiseSettings &settings [[buffer(0)]],
+                           device const float2 *points [[buffer(1)]],
+                           device float *values [[buffer(2)]],
+                           constant uint &count [[buffer(3)]],
+                           device float2 *derivatives [[buffer(4)]],
+                           uint gid [[thread_position_in_grid]]) {
+    if (gid >= count) {
+        return;
     }
+    values[gid] = gpu_fractal_noise(points[gid].x, points[gid].y, settings);
+    noise_shared::Sample<float> s = gpu_fractal_noise_sample(points[gid].x, points[gid].y, settings);
+    derivatives[gid] = float2(s.dx, s.dz);
+}
+
+// --- Terrain Generation (compute) ---
+
+struct TerrainGenParams {
+    float2 origin;       // World-space position of vertex (0, 0)
+    float step;          // World-space distance between vertices
+    uint resolution;     // Vertices along each edge
+    float noiseOffset;   // World to noise space: (p + noiseOffset) * noiseScale
+    float noiseScale;
+    float heightScale;   // Noise to world height
+    float quantMinY;     // Packed output: height mapped to unorm 0
+    float quantExtentY;  // Packed output: height range mapped to [0, 1]
+    NoiseSettings noise; // The terrain's noise field
+};
+
+static float gpu_terrain_height(float2 p, constant TerrainGenParams &params) {
+    return gpu_noise_height(p, params.noiseOffset, params.noiseScale, params.heightScale, params.noise);
+}
+
+// Matches the CPU Vertex struct: two float3 padded to 16 bytes each
+struct TerrainVertex {
+    float3 position;
+    float3 normal;
+};
+
+// Matches the CPU PackedVertex struct; packed types keep the stride at 12 bytes
+struct PackedTerrainVertex {
+    packed_ushort4 position;
+    packed_short2 normal;
+};
+
+kernel void generate_terrain_chunk(constant TerrainGenParams &params [[buffer(0)]],
+                                   device TerrainVertex *vertices [[buffer(1), function_constant(!packed_vertices)]],
+                                   device float *heights [[buffer(2)]],
+                                   device PackedTerrainVertex *packed [[buffer(3), function_constant(packed_vertices)]],
+                                   uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.resolution || gid.y >= params.resolution) {
+        return;
+    }
+
+    float2 p = params.origin + float2(gid) * params.step;
+    float h = gpu_terrain_height(p, params);
+
+    // Central differences over neighbouring samples, so chunk borders match without an apron pass
+    float heightL = gpu_terrain_height(p - float2(params.step, 0.0), params);
+    float heightR = gpu_terrain_height(p + float2(params.step, 0.0), params);
+    float heightD = gpu_terrain_height(p - float2(0.0, params.step), params);
+    float heightU = gpu_terrain_height(p + float2(0.0, params.step), params);
+
+    uint index = gid.y * params.resolution + gid.x;
+    float3 normal = normalize(float3((heightL - heightR) / params.step, 2.0, (heightD - heightU) / params.step));
+    if (packed_vertices) {
+        float3 unit = float3(float2(gid) / float(params.resolution - 1), (h - params.quantMinY) / params.quantExtentY);
+        packed[index].position = ushort4(ushort3(round(saturate(unit.xzy) * 65535.0)), 65535);
+        packed[index].normal = short2(round(clamp(encode_octahedral(normal), -1.0, 1.0) * 32767.0));
+    } else {
+        vertices[index].position = float3(p.x, h, p.y);
+        vertices[index].normal = normal;
+    }
+    heights[index] = h;
+}
+
+// --- Biomes ---
+// A chunk's biome IDs sit on the corners of its biome cells (see biome.hpp), so blending the
+// four corners around a point matches the neighbouring chunk along their shared edge.
+
+// Matches BiomeProfile in biome.hpp
+struct BiomeProfile {
+    float4 ground;
+    float4 rock;
+    float4 snow;
+    float snowline;
+    float treeDensity;
+    float rockDensity;
+    float padding;
+};
+
+static BiomeProfile blend_biome_profiles(BiomeProfile a, BiomeProfile b, float t) {
+    BiomeProfile out;
+    out.ground = mix(a.ground, b.ground, t);
+    out.rock = mix(a.rock, b.rock, t);
+    out.snow = mix(a.snow, b.snow, t);
+    out.snowline = mix(a.snowline, b.snowline, t);
+    out.treeDensity = mix(a.treeDensity, b.treeDensity, t);
+    out.rockDensity = mix(a.rockDensity, b.rockDensity, t);
+    out.padding = 0.0;
+    return out;
+}
+
+// Same blend as biome_profile_at in biome.cpp; uv is the point's position inside the chunk in [0, 1]
+static BiomeProfile biome_profile_at(constant uchar *biomes, constant BiomeProfile *profiles, uint cells, float2 uv) {
+    float2 g = saturate(uv) * float(cells);
+    uint2 cell = min(uint2(g), uint2(cells - 1));
+    float2 f = g - float2(cell);
+    uint row = cells + 1;
+    uint i = cell.y * row + cell.x;
+    BiomeProfile row0 = blend_biome_profiles(profiles[biomes[i]], profiles[biomes[i + 1]], f.x);
+    BiomeProfile row1 = blend_biome_profiles(profiles[biomes[i + row]], profiles[biomes[i + row + 1]], f.x);
+    return blend_biome_profiles(row0, row1, f.y);
+}
+
+// terrain_band_albedo with the biome's colours and snowline; matches biome_band_albedo in biome.cpp
+static float3 biome_band_albedo(BiomeProfile profile, float height) {
+    float3 albedo = mix(profile.ground.rgb, profile.rock.rgb, saturate(height / 4.0));
+    return mix(albedo, profile.snow.rgb, saturate((height - profile.snowline) / 4.0));
+}
+
+// Matches TerrainMaterialBakeParams in gpu_terrain_material.mm
+struct TerrainMaterialBakeParams {
+    uint2 tileOrigin;    // Atlas texel of the chunk's vertex (0, 0)
+    uint resolution;     // Vertices along each chunk edge, and texels along each tile edge
+    float heightScale;   // Vertex y to world height, from the chunk's model matrix
+    float heightOffset;
+    uint biomeCells;     // Biome cells along each chunk edge; 0 bakes the plain height bands
+};
+
+// One thread per chunk vertex: bakes the height band colour at the vertex into the chunk's atlas tile,
+// in the colours of the chunk's biomes when it has them
+kernel void bake_terrain_materials(constant TerrainMaterialBakeParams &params [[buffer(0)]],
+                                   const device TerrainVertex *vertices [[buffer(1), function_constant(!packed_vertices)]],
+                                   const device PackedTerrainVertex *packed [[buffer(2), function_constant(packed_vertices)]],
+                                   constant uchar *biomes [[buffer(3)]],
+                                   constant BiomeProfile *profiles [[buffer(4)]],
+                                   texture2d<float, access::write> atlas [[texture(0)]],
+                                   uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.resolution || gid.y >= params.resolution) {
+        return;
+    }
+    uint index = gid.y * params.resolution + gid.x;
+    float y = packed_vertices ? float(packed[index].position.y) / 65535.0 : vertices[index].position.y;
+    float height = y * params.heightScale + params.heightOffset;
+    float3 albedo = terrain_band_albedo(height);
+    if (params.biomeCells > 0) {
+        float2 uv = float2(gid) / float(params.resolution - 1);
+        albedo = biome_band_albedo(biome_profile_at(biomes, profiles, params.biomeCells, uv), height);
+    }
+    atlas.write(float4(albedo, 1.0), params.tileOrigin + gid);
+}
+
+// Matches TerrainHorizonBakeParams in gpu_terrain_horizon.mm
+struct TerrainHorizonBakeParams {
+    float2 origin;       // World position of the tile's texel (0, 0), the chunk's corner
+    uint2 tileOrigin;    // Atlas texel of the chunk's texel (0, 0)
+    uint tileTexels;     // Texels along each tile edge, the first and last on the chunk's borders
+    float texelSpacing;  // World distance between texels
+    uint steps;          // Samples along each direction
+    float firstStep;     // Distance of the first sample; each step after is stepGrowth times longer
+    float stepGrowth;
+    float noiseOffset;
+    float noiseScale;
+    float heightScale;
+    NoiseSettings noise;
+};
+
+// One thread per horizon texel: marches the terrain's noise outwards in eight directions and keeps the sine of
+// the steepest elevation reached in each; matches terrain_horizon_sines in terrain_horizon.cpp
+kernel void bake_terrain_horizons(constant TerrainHorizonBakeParams &params [[buffer(0)]],
+                                  texture2d_array<float, access::write> atlas [[texture(0)]],
+                                  uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.tileTexels || gid.y >= params.tileTexels) {
+        return;
+    }
+    float2 p = params.origin + float2(gid) * params.texelSpacing;
+    float origin = gpu_noise_height(p, params.noiseOffset, params.noiseScale, params.heightScale, params.noise);
+    float sines[8];
+    for (uint d = 0; d < 8; ++d) {
+        float angle = float(d) * (2.0 * M_PI_F / 8.0);
+        float2 direction = float2(cos(angle), sin(angle));
+        float slope = 0.0;
+        float distance = 0.0;
+        float step = params.firstStep;
+        for (uint i = 0; i < params.steps; ++i) {
+            distance += step;
+            step *= params.stepGrowth;
+            float h = gpu_noise_height(p + direction * distance, params.noiseOffset, params.noiseScale,
+                                       params.heightScale, params.noise);
+            slope = max(slope, (h - origin) / distance);
+        }
+        sines[d] = slope * rsqrt(1.0 + slope * slope);
+    }
+    uint2 texel = params.tileOrigin + gid;
+    atlas.write(float4(sines[0], sines[1], sines[2], sines[3]), texel, 0);
+    atlas.write(float4(sines[4], sines[5], sines[6], sines[7]), texel, 1);
+}
+
+// --- Reflection Probes ---
+// A cube captured a few faces per frame through the multi-view path, then convolved into one GGX
+// roughness per mip of the cube the water reflects; see gpu_reflection_probe.hpp.
+
+// Matches ReflectionProbeFilterParams in gpu_reflection_probe.mm
+struct ReflectionProbeFilterParams {
+    uint size;           // Texels along each face edge of the mip written
+    float roughness;     // GGX roughness of the mip; 0 copies the capture
+    uint sourceSize;     // Texels along each face edge of the capture's mip 0
+    uint sampleCount;    // Lobe samples per texel
+};
+
+// Direction through a cube texel in Metal's face order; matches reflection_probe_texel_direction
+float3 reflection_probe_texel_direction(uint face, float2 uv) {
+    float s = 2.0 * uv.x - 1.0;
+    float t = 2.0 * uv.y - 1.0;
+    switch (face) {
+    case 0: return normalize(float3(1.0, -t, -s));
+    case 1: return normalize(float3(-1.0, -t, s));
+    case 2: return normalize(float3(s, 1.0, t));
+    case 3: return normalize(float3(s, -1.0, -t));
+    case 4: return normalize(float3(s, -t, 1.0));
+    default: return normalize(float3(-s, -t, -1.0));
+    }
+}
+
+// One thread per texel of one face of a mip: importance samples the GGX lobe around the texel's direction,
+// each sample from the capture mip matching its solid angle; matches reflection_probe_ggx_sample and
+// reflection_probe_sample_lod in reflection_probe.cpp
+kernel void prefilter_reflection_probe(constant ReflectionProbeFilterParams &params [[buffer(0)]],
+                                       texturecube<float> capture [[texture(0)]],
+                                       texturecube<float, access::write> filtered [[texture(1)]],
+                                       uint3 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.size || gid.y >= params.size || gid.z >= 6) {
+        return;
+    }
+    constexpr sampler trilinear(filter::linear, mip_filter::linear);
+    float3 normal = reflection_probe_texel_direction(gid.z, (float2(gid.xy) + 0.5) / float(params.size));
+    if (params.roughness <= 0.0) {
+        filtered.write(capture.sample(trilinear, normal, level(0.0)), gid.xy, gid.z);
+        return;
+    }
+
+    float alpha = params.roughness * params.roughness;
+    float alpha2 = alpha * alpha;
+    float3 up = abs(normal.z) < 0.999 ? float3(0.0, 0.0, 1.0) : float3(1.0, 0.0, 0.0);
+    float3 tangent = normalize(cross(up, normal));
+    float3 bitangent = cross(normal, tangent);
+    float texelSolidAngle = 4.0 * M_PI_F / (6.0 * float(params.sourceSize * params.sourceSize));
+
+    float3 sum = 0.0;
+    float weight = 0.0;
+    for (uint i = 0; i < params.sampleCount; ++i) {
+        float phi = 2.0 * M_PI_F * float(i) / float(params.sampleCount);
+        float xi = float(reverse_bits(i)) * 2.3283064365386963e-10;
+        float halfCosine = sqrt((1.0 - xi) / (1.0 + (alpha2 - 1.0) * xi));
+        float halfSine = sqrt(max(1.0 - halfCosine * halfCosine, 0.0));
+        float3 half_ = tangent * (halfSine * cos(phi)) + bitangent * (halfSine * sin(phi)) + normal * halfCosine;
+        float3 light = normalize(2.0 * dot(normal, half_) * half_ - normal);
+        float lit = dot(normal, light);
+        if (lit <= 0.0) {
+            continue;
+        }
+        float denominator = halfCosine * halfCosine * (alpha2 - 1.0) + 1.0;
+        float pdf = alpha2 / (M_PI_F * denominator * denominator) / 4.0;
+        float sampleSolidAngle = 1.0 / (float(params.sampleCount) * pdf);
+        float lod = max(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0);
+        sum += capture.sample(trilinear, light, level(lod)).rgb * lit;
+        weight += lit;
+    }
+    filtered.write(float4(sum / max(weight, 1e-5), 1.0), gid.xy, gid.z);
+}
+
+// --- Terrain Tessellation ---
+// Chunks near the camera drawn as one quad patch per grid cell; see gpu_tessellation.hpp.
+// Every vertex, corner or generated, is placed on the same noise generate_terrain_chunk samples.
+
+// Matches TerrainPatchParams in gpu_tessellation.mm
+struct TerrainPatchParams {
+    float2 origin;          // World-space position of grid vertex (0, 0)
+    float step;             // World-space distance between grid vertices
+    uint cellsPerEdge;      // Patches along each chunk edge
+    float3 camera;          // Factor kernel only
+    float projectionScale;
+    float targetEdgePixels;
+    float maxFactor;
+    float noiseOffset;
+    float noiseScale;
+    float heightScale;
+    NoiseSettings noise;
+};
+
+static float3 patch_point(constant TerrainPatchParams &params, float2 cell) {
+    float2 p = params.origin + cell * params.step;
+    return float3(p.x, gpu_noise_height(p, params.noiseOffset, params.noiseScale, params.heightScale, params.noise),
+                  p.y);
+}
+
+// Same as terrain_edge_tessellation in terrain_tessellation.cpp
+static float edge_tessellation(constant TerrainPatchParams &params, float3 a, float3 b) {
+    float distance = max(length((a + b) * 0.5 - params.camera), 1e-3);
+    float pixels = length(b - a) * params.projectionScale / distance;
+    return clamp(pixels / params.targetEdgePixels, 1.0, params.maxFactor);
+}
+
+// One thread per grid cell: the factors of its patch
+kernel void terrain_tessellation_factors(constant TerrainPatchParams &params [[buffer(0)]],
+                                         device MTLQuadTessellationFactorsHalf *factors [[buffer(1)]],
+                                         uint2 gid [[thread_position_in_grid]]) {
+    uint n = params.cellsPerEdge;
+    if (gid.x >= n || gid.y >= n) {
+        return;
+    }
+
+    float2 cell = float2(gid);
+    float3 p00 = patch_point(params, cell);
+    float3 p10 = patch_point(params, cell + float2(1.0, 0.0));
+    float3 p01 = patch_point(params, cell + float2(0.0, 1.0));
+    float3 p11 = patch_point(params, cell + float2(1.0, 1.0));
+
+    // Metal's quad edge order: u = 0, v = 0, u = 1, v = 1
+    float edges[4] = { edge_tessellation(params, p00, p01), edge_tessellation(params, p00, p10),
+                       edge_tessellation(params, p10, p11), edge_tessellation(params, p01, p11) };
+    uint index = gid.y * n + gid.x;
+    factors[index].insideTessellationFactor[0] = half(max(edges[1], edges[3]));
+    factors[index].insideTessellationFactor[1] = half(max(edges[0], edges[2]));
+
+    // Chunk borders stay whole so they match the grid the neighbouring chunks are drawn with
+    if (gid.x == 0) edges[0] = 1.0;
+    if (gid.y == 0) edges[1] = 1.0;
+    if (gid.x == n - 1) edges[2] = 1.0;
+    if (gid.y == n - 1) edges[3] = 1.0;
+    for (uint i = 0; i < 4; ++i) {
+        factors[index].edgeTessellationFactor[i] = half(edges[i]);
+    }
+}
+
+[[patch(quad, 4)]]
+vertex LandscapeVertexOut terrain_tessellated_vertex(constant TerrainPatchParams &params [[buffer(0)]],
+                                                     constant FrameUniforms &frame [[buffer(5)]],
+                                                     uint patch_id [[patch_id]],
+                                                     float2 uv [[position_in_patch]]) {
+    float2 cell = float2(patch_id % params.cellsPerEdge, patch_id / params.cellsPerEdge) + uv;
+
+    // The height and its analytic slope from one evaluation; the height is patch_point's
+    float2 xz = params.origin + cell * params.step;
+    float3 terrain = gpu_noise_height_gradient(xz, params.noiseOffset, params.noiseScale, params.heightScale,
+                                               params.noise);
+    float3 p = float3(xz.x, terrain.x, xz.y);
+
+    LandscapeVertexOut out;
+    out.position = frame.viewProjection * float4(p, 1.0);
+    out.position_ws = p;
+    out.normal_ws = normalize(float3(-terrain.y, 1.0, -terrain.z));
+    out.view_depth = out.position.w;
+    out.albedo = TERRAIN_GRASS_COLOR;
+    light_landscape_vertex(out, frame);
+    return out;
+}
+
+// --- GPU-driven terrain culling ---
+
+// Matches ChunkDrawArgs in gpu_culling.mm
+struct ChunkDrawArgs {
+    float4 boundsMin;               // World space box corners; w unused
+    float4 boundsMax;
+    device const void *vertices;    // The chunk's vertex buffer
+    uint indexStart;                // Range of the shared LOD index buffer
+    uint indexCount;                // 0 for chunks drawn by another path
+};
+
+// Matches CullParams in gpu_culling.mm
+struct CullParams {
+    float4 planes[6];               // Current frustum, inward facing
+    float4x4 previousViewProjection; // Matrix the Hi-Z pyramid was rendered with
+    float2 hizSize;                 // Size of Hi-Z mip 0 in texels
+    uint chunkCount;
+    uint hizLevels;                 // 0 disables the occlusion test
+    uint index16;                   // Index buffer holds ushort instead of uint
+    uint reverseZ;                  // Depth falls with distance: the nearest depth is the largest
+    device const Uniforms *draws;   // One entry per chunk, bound to vertex buffer 1 and picked by base instance
+    constant FrameUniforms *frame;  // Bound to the chunks' vertex and fragment buffer 5
+    constant ShadowUniforms *shadow; // Bound to the chunks' fragment buffer 3; null without shadows
+    constant TerrainMaterialUniforms *materials; // Bound to the chunks' fragment buffer 8; null without baked materials
+};
+
+struct CullCommands {
+    command_buffer commands [[id(0)]];
+};
+
+static bool box_in_frustum(constant CullParams &params, float3 center, float3 extent) {
+    for (uint i = 0; i < 6; ++i) {
+        float4 plane = params.planes[i];
+        if (dot(plane.xyz, center) + plane.w + dot(abs(plane.xyz), extent) < 0.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if the box is behind the depth the previous frame left in the Hi-Z pyramid
+static bool box_occluded(constant CullParams &params, texture2d<float, access::read> hiz, float3 lo, float3 hi) {
+    bool reversed = params.reverseZ != 0;
+    float2 minUV = float2(1.0);
+    float2 maxUV = float2(0.0);
+    float nearestDepth = reversed ? 0.0 : 1.0;
+    for (uint i = 0; i < 8; ++i) {
+        float3 corner = float3((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+        float4 clip = params.previousViewProjection * float4(corner, 1.0);
+        if (clip.w <= 0.0) {
+            return false; // Crosses the camera plane; cannot be judged from the pyramid
+        }
+        float3 ndc = clip.xyz / clip.w;
+        float2 uv = ndc.xy * float2(0.5, -0.5) + 0.5;
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        nearestDepth = reversed ? max(nearestDepth, ndc.z) : min(nearestDepth, ndc.z);
+    }
+    minUV = saturate(minUV);
+    maxUV = saturate(maxUV);
+
+    // Pick the level where the footprint covers at most 2x2 texels
+    float2 extent = (maxUV - minUV) * params.hizSize;
+    uint level = min(uint(ceil(log2(max(max(extent.x, extent.y), 1.0)))), params.hizLevels - 1);
+    float2 levelSize = float2(max(uint(params.hizSize.x) >> level, 1u), max(uint(params.hizSize.y) >> level, 1u));
+    uint2 a = uint2(min(minUV * levelSize, levelSize - 1.0));
+    uint2 b = uint2(min(maxUV * levelSize, levelSize - 1.0));
+
+    float4 depths = float4(hiz.read(uint2(a.x, a.y), level).r, hiz.read(uint2(b.x, a.y), level).r,
+                           hiz.read(uint2(a.x, b.y), level).r, hiz.read(uint2(b.x, b.y), level).r);
+    if (reversed) {
+        return nearestDepth < min(min(depths.x, depths.y), min(depths.z, depths.w));
+    }
+    return nearestDepth > max(max(depths.x, depths.y), max(depths.z, depths.w));
+}
+
+// One thread per resident chunk: encodes its draw into the indirect command buffer or resets the slot
+kernel void cull_terrain_chunks(constant CullParams &params [[buffer(0)]],
+                                const device ChunkDrawArgs *chunks [[buffer(1)]],
+                                device CullCommands &icb [[buffer(2)]],
+                                const device uchar *indices [[buffer(3)]],
+                                texture2d<float, access::read> hiz [[texture(0)]],
+                                uint id [[thread_position_in_grid]]) {
+    if (id >= params.chunkCount) {
+        return;
+    }
+
+    ChunkDrawArgs chunk = chunks[id];
+    float3 center = (chunk.boundsMin.xyz + chunk.boundsMax.xyz) * 0.5;
+    float3 extent = (chunk.boundsMax.xyz - chunk.boundsMin.xyz) * 0.5;
+
+    render_command cmd(icb.commands, id);
+    if (chunk.indexCount == 0 || !box_in_frustum(params, center, extent) ||
+        (params.hizLevels > 0 && box_occluded(params, hiz, chunk.boundsMin.xyz, chunk.boundsMax.xyz))) {
+        cmd.reset();
+        return;
+    }
+
+    cmd.set_vertex_buffer(chunk.vertices, 0);
+    cmd.set_vertex_buffer(params.draws, 1);
+    cmd.set_vertex_buffer(params.frame, 5);
+    cmd.set_fragment_buffer(params.frame, 5);
+    if (params.shadow) {
+        cmd.set_fragment_buffer(params.shadow, 3);
+    }
+    if (params.materials) {
+        cmd.set_fragment_buffer(params.materials, 8);
+    }
+    if (params.index16) {
+        cmd.draw_indexed_primitives(primitive_type::triangle, chunk.indexCount,
+                                    (const device ushort *)indices + chunk.indexStart, 1, 0, id);
+    } else {
+        cmd.draw_indexed_primitives(primitive_type::triangle, chunk.indexCount,
+                                    (const device uint *)indices + chunk.indexStart, 1, 0, id);
+    }
+}
+
+// Hi-Z mip 0: a copy of the depth buffer
+kernel void hiz_copy_depth(depth2d<float, access::read> depth [[texture(0)]],
+                           texture2d<float, access::write> dst [[texture(1)]],
+                           uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= dst.get_width() || gid.y >= dst.get_height()) {
+        return;
+    }
+    dst.write(float4(depth.read(gid)), gid);
+}
+
+// Each Hi-Z texel keeps the farthest depth of the texels it covers one level up: the largest,
+// or the smallest with reverse-Z
+kernel void hiz_reduce(texture2d<float, access::read> src [[texture(0)]],
+                       texture2d<float, access::write> dst [[texture(1)]],
+                       constant uint &reverseZ [[buffer(0)]],
+                       uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= dst.get_width() || gid.y >= dst.get_height()) {
+        return;
+    }
+
+    uint2 srcMax = uint2(src.get_width() - 1, src.get_height() - 1);
+    uint2 base = gid * 2;
+    float farthest = reverseZ ? 1.0 : 0.0;
+    // Odd source sizes fold their last row or column into the final texel
+    uint spanX = (gid.x == dst.get_width() - 1 && (src.get_width() & 1)) ? 3 : 2;
+    uint spanY = (gid.y == dst.get_height() - 1 && (src.get_height() & 1)) ? 3 : 2;
+    for (uint y = 0; y < spanY; ++y) {
+        for (uint x = 0; x < spanX; ++x) {
+            float depth = src.read(min(base + uint2(x, y), srcMax)).r;
+            farthest = reverseZ ? min(farthest, depth) : max(farthest, depth);
+        }
+    }
+    dst.write(float4(farthest), gid);
+}
+
+// --- Foliage (compute) ---
+// GPU port of foliage.cpp: each resident chunk owns a slot of the instance pool that
+// scatter_foliage fills once when the chunk arrives; every frame select_foliage turns the
+// pool into instanced cube draws and impostor quads, picking a level per instance by distance.
+
+// Matches FoliageInstance in foliage.hpp
+struct FoliageInstance {
+    float4 position;    // xyz base on the terrain, w uniform scale
+    float yaw;
+    uint kind;          // 0 tree, 1 rock
+    float shade;        // [0, 1) colour variation
+    uint padding;
+};
+
+// Matches FoliageScatterParams in gpu_foliage.mm
+struct FoliageScatterParams {
+    float2 origin;          // World position of the chunk's vertex (0, 0)
+    int2 chunk;             // Chunk key, hashed into every cell
+    float cellSize;         // World size of a placement cell
+    uint cellsPerEdge;
+    float gridStep;         // World distance between chunk vertices
+    uint gridResolution;    // Chunk vertices along each edge
+    uint seed;
+    float treeDensity;
+    float rockDensity;
+    float forestScale;
+    float treeline;
+    float noiseOffset;      // Terrain noise mapping, as in TerrainGenParams
+    float noiseScale;
+    float heightScale;
+    uint firstInstance;     // First pool entry of the chunk's slot
+    uint slot;              // Counter of the chunk's slot
+    NoiseSettings noise;    // Terrain noise field
+    uint biomeCells;        // Biome cells along each chunk edge; 0 without biomes
+};
+
+// Matches FoliageSelectParams in gpu_foliage.mm
+struct FoliageSelectParams {
+    float4 planes[6];           // Current frustum, inward facing
+    float3 camera;
+    float treeDetailDistance;   // Trees beyond draw as impostors
+    float treeDrawDistance;
+    float rockDrawDistance;
+    uint capacity;              // Pool entries per slot
+    uint slotCount;
+    uint maxInstances;          // Capacity of the output instance buffer
+    float rockDetailDistance;   // Rocks beyond draw as impostors; only with impostors
+    float fadeDistance;         // Both levels are drawn this far before the detail distances
+    uint impostors;             // Far instances as impostor quads rather than boxes
+    uint maxImpostors;          // Capacity of the impostor buffer
+    uint sway;                  // Write each part's sway beside it; only the scene's selection
+    float4 impostorBounds[2];   // Per kind: xyz centre above the base, w radius; see impostor_bounds
+};
+
+// Matches ImpostorInstance in gpu_foliage.mm
+struct ImpostorInstance {
+    float4 center;      // xyz world centre of the bounds, w world radius
+    float4 color;       // rgb tint over the baked colours, a how far the instance has faded in
+    float yaw;
+    uint kind;
+    float2 padding;
+};
+
+// Draw arguments followed by the unclamped count of instances select_foliage appended
+constant uint FOLIAGE_INSTANCE_COUNT = 1;
+constant uint FOLIAGE_APPENDED = 5;
+
+static uint foliage_hash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static uint foliage_cell_hash(uint seed, int2 chunk, uint cellX, uint cellZ) {
+    uint h = foliage_hash(seed);
+    h = foliage_hash(h ^ uint(chunk.x));
+    h = foliage_hash(h ^ uint(chunk.y));
+    return foliage_hash(h ^ ((cellZ << 16) | cellX));
+}
+
+static float foliage_unit(uint bits) {
+    return float(bits >> 8) * (1.0 / 16777216.0);
+}
+
+// One thread per placement cell of a chunk; kept candidates are appended to the chunk's slot
+kernel void scatter_foliage(constant FoliageScatterParams &params [[buffer(0)]],
+                            device FoliageInstance *pool [[buffer(1)]],
+                            device atomic_uint *counts [[buffer(2)]],
+                            constant uchar *biomes [[buffer(3)]],
+                            constant BiomeProfile *profiles [[buffer(4)]],
+                            uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.cellsPerEdge || gid.y >= params.cellsPerEdge) {
+        return;
+    }
+
+    uint h = foliage_cell_hash(params.seed, params.chunk, gid.x, gid.y);
+    float2 p = params.origin + (float2(gid) + float2(foliage_unit(foliage_hash(h + 1)),
+                                                     foliage_unit(foliage_hash(h + 2)))) * params.cellSize;
+
+    float roll = foliage_unit(h);
+    // Same field as foliage_forest_density in foliage.cpp
+    NoiseSettings forestNoise = { params.seed, NoiseBasis::Value, NoiseInterpolation::Smoothstep, 0.0, 5, 0.45 };
+    float forest = saturate(gpu_fractal_noise((p.x + 311.0) * params.forestScale,
+                                              (p.y - 173.0) * params.forestScale, forestNoise) + 0.5);
+    float treeChance = params.treeDensity * forest;
+    float rockChance = params.rockDensity;
+    if (params.biomeCells > 0) {
+        float chunkSize = params.cellSize * float(params.cellsPerEdge);
+        BiomeProfile profile = biome_profile_at(biomes, profiles, params.biomeCells, (p - params.origin) / chunkSize);
+        treeChance *= profile.treeDensity;
+        rockChance *= profile.rockDensity;
+    }
+    uint kind;
+    if (roll < treeChance) {
+        kind = 0;
+    } else if (roll < treeChance + rockChance) {
+        kind = 1;
+    } else {
+        return;
+    }
+
+    // Bilinear over the chunk's vertex grid, so instances sit on the drawn surface
+    float2 g = (p - params.origin) / params.gridStep;
+    float2 cell = min(floor(g), float2(params.gridResolution - 2));
+    float2 f = g - cell;
+    float2 corner = params.origin + cell * params.gridStep;
+    float h00 = gpu_noise_height(corner, params.noiseOffset, params.noiseScale, params.heightScale, params.noise);
+    float h10 = gpu_noise_height(corner + float2(params.gridStep, 0.0), params.noiseOffset, params.noiseScale,
+                                 params.heightScale, params.noise);
+    float h01 = gpu_noise_height(corner + float2(0.0, params.gridStep), params.noiseOffset, params.noiseScale,
+                                 params.heightScale, params.noise);
+    float h11 = gpu_noise_height(corner + params.gridStep, params.noiseOffset, params.noiseScale, params.heightScale,
+                                 params.noise);
+    float y = mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+    if (kind == 0 && y > params.treeline) {
+        return;
+    }
+
+    float variation = foliage_unit(foliage_hash(h + 3));
+    FoliageInstance instance;
+    instance.position = float4(p.x, y, p.y, kind == 0 ? 0.8 + 0.5 * variation : 0.6 + 1.0 * variation);
+    instance.yaw = foliage_unit(foliage_hash(h + 4)) * 6.2831853;
+    instance.kind = kind;
+    instance.shade = foliage_unit(foliage_hash(h + 5));
+    instance.padding = 0;
+
+    uint index = atomic_fetch_add_explicit(&counts[params.slot], 1, memory_order_relaxed);
+    pool[params.firstInstance + index] = instance;
+}
+
+// Base transform of an instance times a box of the given size centred at offset
+static float4x4 foliage_part(FoliageInstance instance, float3 offset, float3 size) {
+    float c = cos(instance.yaw);
+    float s = sin(instance.yaw);
+    float k = instance.position.w;
+    float3 o = offset * k;
+    float3 d = size * k;
+    return float4x4(float4(c * d.x, 0.0, -s * d.x, 0.0),
+                    float4(0.0, d.y, 0.0, 0.0),
+                    float4(s * d.z, 0.0, c * d.z, 0.0),
+                    float4(instance.position.xyz + float3(c * o.x + s * o.z, o.y, c * o.z - s * o.x), 1.0));
+}
+
+static bool sphere_in_frustum(constant FoliageSelectParams &params, float3 center, float radius) {
+    for (uint i = 0; i < 6; ++i) {
+        if (dot(params.planes[i].xyz, center) + params.planes[i].w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static float3 foliage_crown(float shade) {
+    return float3(0.05 * shade, 0.65 + 0.25 * shade, 0.15 + 0.1 * shade);
+}
+
+// One thread per pool entry: appends the visible instances' parts for the instanced cube draw.
+// Near trees are a trunk and a crown, far trees a single box standing in for both. With impostors,
+// instances beyond their detail distance are appended as quads instead, and over the fade stretch
+// before it as both, each part carrying how far it has dissolved into the quad. With params.sway,
+// each part's sway goes to the same index of the sway buffer, for the foliage_wind variant.
+kernel void select_foliage(constant FoliageSelectParams &params [[buffer(0)]],
+                           const device FoliageInstance *pool [[buffer(1)]],
+                           const device uint *counts [[buffer(2)]],
+                           device InstanceData *instances [[buffer(3)]],
+                           device atomic_uint *draw [[buffer(4)]],
+                           device ImpostorInstance *impostors [[buffer(5)]],
+                           device atomic_uint *impostorDraw [[buffer(6)]],
+                           device float4 *sway [[buffer(7)]],
+                           uint id [[thread_position_in_grid]]) {
+    uint slot = id / params.capacity;
+    if (slot >= params.slotCount || id - slot * params.capacity >= counts[slot]) {
+        return;
+    }
+
+    FoliageInstance instance = pool[id];
+    float k = instance.position.w;
+    float distance = length(instance.position.xyz - params.camera);
+    bool tree = instance.kind == 0;
+    if (distance >= (tree ? params.treeDrawDistance : params.rockDrawDistance) ||
+        !sphere_in_frustum(params, instance.position.xyz + float3(0.0, (tree ? 1.7 : 0.3) * k, 0.0),
+                           (tree ? 2.0 : 1.1) * k)) {
+        return;
+    }
+
+    // Same as foliage_impostor_fade in foliage.cpp
+    float fade = 0.0;
+    if (params.impostors) {
+        float detail = tree ? params.treeDetailDistance : params.rockDetailDistance;
+        fade = saturate((distance - detail) / params.fadeDistance + 1.0);
+        if (fade > 0.0) {
+            uint slot = atomic_fetch_add_explicit(&impostorDraw[FOLIAGE_APPENDED], 1, memory_order_relaxed);
+            if (slot < params.maxImpostors) {
+                float4 bounds = params.impostorBounds[instance.kind];
+                float c = cos(instance.yaw);
+                float s = sin(instance.yaw);
+                float3 o = bounds.xyz * k;
+                ImpostorInstance impostor;
+                impostor.center = float4(instance.position.xyz + float3(c * o.x + s * o.z, o.y, c * o.z - s * o.x),
+                                         bounds.w * k);
+                // The atlas holds the middle shade; the crown dominates a tree's colour
+                float3 tint = tree ? foliage_crown(instance.shade) / foliage_crown(0.5)
+                                   : float3((0.4 + 0.2 * instance.shade) / 0.5);
+                impostor.color = float4(tint, fade);
+                impostor.yaw = instance.yaw;
+                impostor.kind = instance.kind;
+                impostor.padding = 0.0;
+                impostors[slot] = impostor;
+            }
+        }
+        if (fade >= 1.0) {
+            return;
+        }
+    }
+
+    // With impostors only instances short of their detail distance get this far
+    bool detailed = tree && (params.impostors || distance < params.treeDetailDistance);
+    uint parts = detailed ? 2 : 1;
+    uint first = atomic_fetch_add_explicit(&draw[FOLIAGE_APPENDED], parts, memory_order_relaxed);
+    if (first + parts > params.maxInstances) {
+        return;
+    }
+
+    float3 crown = foliage_crown(instance.shade);
+    if (!tree) {
+        instances[first].modelMatrix = foliage_part(instance, float3(0.0, 0.3, 0.0), float3(1.2, 0.8, 1.6));
+        instances[first].color = float4(float3(0.4 + 0.2 * instance.shade), fade);
+    } else if (detailed) {
+        instances[first].modelMatrix = foliage_part(instance, float3(0.0, 1.0, 0.0), float3(0.2, 2.0, 0.2));
+        instances[first].color = float4(float3(0.5, 0.35, 0.26) * (0.85 + 0.3 * instance.shade), fade);
+        instances[first + 1].modelMatrix = foliage_part(instance, float3(0.0, 2.5, 0.0), float3(1.5));
+        instances[first + 1].color = float4(crown, fade);
+    } else {
+        // Far box: spans the crown and the visible part of the trunk
+        instances[first].modelMatrix = foliage_part(instance, float3(0.0, 2.1, 0.0), float3(1.4, 2.3, 1.4));
+        instances[first].color = float4(crown, 0.0);
+    }
+
+    // Same as foliage_sway_params in foliage.cpp; a tree's parts share it, so they move as one
+    if (params.sway) {
+        float4 partSway = float4(instance.position.y, instance.yaw, tree ? 1.0 / (k * k) : 0.0, 0.0);
+        for (uint i = 0; i < parts; ++i) {
+            sway[first + i] = partSway;
+        }
+    }
+}
+
+// Single thread: clamps the appended counts into the draws' instance counts. The shadow casters
+// share this frame's impostor arguments, which they append nothing to, so clamping again is harmless.
+kernel void finish_foliage_draw(constant FoliageSelectParams &params [[buffer(0)]],
+                                device uint *draw [[buffer(4)]],
+                                device uint *impostorDraw [[buffer(6)]]) {
+    draw[FOLIAGE_INSTANCE_COUNT] = min(draw[FOLIAGE_APPENDED], params.maxInstances);
+    impostorDraw[FOLIAGE_INSTANCE_COUNT] = min(impostorDraw[FOLIAGE_APPENDED], params.maxImpostors);
+}
+
+// --- Foliage Impostors ---
+// Far foliage as one camera-facing quad per instance, textured from the octahedral atlas that the
+// bake shaders render at load time. Everything here matches impostor.cpp; see impostor.hpp.
+
+// Matches IMPOSTOR_FRAMES and IMPOSTOR_FRAME_SIZE in impostor.hpp
+constant uint IMPOSTOR_FRAMES = 8;
+constant float IMPOSTOR_FRAME_SIZE = 64.0;
+
+struct ImpostorBakeOut {
+    float4 position [[position]];
+    float3 normal;      // Instance space
+    float3 color;
+};
+
+struct ImpostorBakeTargets {
+    float4 albedo [[color(0)]];     // rgb colour, a coverage
+    float4 normal [[color(1)]];     // Instance space normal * 0.5 + 0.5, a coverage
+};
+
+// One frame of the atlas: the viewport picks the frame, buffer 1 holds its impostor_frame_view_projection
+// and buffer 2 the impostor_parts of the kind
+vertex ImpostorBakeOut impostor_bake_vertex(const Vertex in [[stage_in]],
+                                            constant float4x4 &viewProjection [[buffer(1)]],
+                                            constant InstanceData *parts [[buffer(2)]],
+                                            uint instance_id [[instance_id]]) {
+    InstanceData part = parts[instance_id];
+    ImpostorBakeOut out;
+    out.position = viewProjection * (part.modelMatrix * float4(in.position, 1.0));
+    out.normal = transform_normal(part.modelMatrix, in.normal);
+    out.color = part.color.rgb;
+    return out;
+}
+
+fragment ImpostorBakeTargets impostor_bake_fragment(ImpostorBakeOut in [[stage_in]]) {
+    ImpostorBakeTargets out;
+    out.albedo = float4(in.color, 1.0);
+    out.normal = float4(normalize(in.normal) * 0.5 + 0.5, 1.0);
+    return out;
+}
+
+static float2 impostor_octahedral_encode(float3 d) {
+    d.y = max(d.y, 0.0);
+    d /= max(abs(d.x) + d.y + abs(d.z), 1e-6);
+    return float2(d.x + d.z, d.x - d.z) * 0.5 + 0.5;
+}
+
+struct ImpostorVertexOut {
+    float4 position [[position]];
+    float3 position_ws;
+    float2 uv;                      // Across the quad, v down as in the frames
+    float view_depth;
+    float4 color [[flat]];          // rgb tint, a fade
+    uint4 frames [[flat]];          // The frames of impostor_frame_blend
+    float4 weights [[flat]];
+    float2 yaw [[flat]];            // Cosine and sine of the instance's yaw
+    uint kind [[flat]];
+};
+
+// Corners from the vertex ID: 0 bottom left, 1 bottom right, 2 top left, 3 top right
+vertex ImpostorVertexOut impostor_vertex(uint vertex_id [[vertex_id]],
+                                         const device ImpostorInstance *impostors [[buffer(2)]],
+                                         constant FrameUniforms &frame [[buffer(5)]],
+                                         uint instance_id [[instance_id]]) {
+    ImpostorInstance impostor = impostors[instance_id];
+    float c = cos(impostor.yaw);
+    float s = sin(impostor.yaw);
+    float3 center = impostor.center.xyz;
+    float3 toEye = normalize(frame.cameraPosition - center);
+
+    // The basis of impostor_frame_view_projection, in world space
+    float3 right = cross(float3(0.0, 1.0, 0.0), toEye);
+    right = length(right) > 1e-4 ? normalize(right) : float3(c, 0.0, -s);
+    float3 up = cross(toEye, right);
+    float2 corner = float2(float(vertex_id & 1), float(vertex_id >> 1)) * 2.0 - 1.0;
+    float3 world = center + (right * corner.x + up * corner.y) * impostor.center.w;
+
+    // The direction the instance is seen from, in its own space, picks the frames
+    float3 local = float3(c * toEye.x - s * toEye.z, toEye.y, s * toEye.x + c * toEye.z);
+    float last = float(IMPOSTOR_FRAMES - 1);
+    float2 grid = clamp(impostor_octahedral_encode(local) * last, 0.0, last);
+    uint2 cell = min(uint2(grid), uint2(IMPOSTOR_FRAMES - 2));
+    float2 f = grid - float2(cell);
+    uint first = cell.y * IMPOSTOR_FRAMES + cell.x;
+
+    ImpostorVertexOut out;
+    out.position = frame.viewProjection * float4(world, 1.0);
+    out.position_ws = world;
+    out.uv = float2(corner.x, -corner.y) * 0.5 + 0.5;
+    out.view_depth = out.position.w;
+    out.color = impostor.color;
+    out.frames = uint4(first, first + 1, first + IMPOSTOR_FRAMES, first + IMPOSTOR_FRAMES + 1);
+    out.weights = float4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    out.yaw = float2(c, s);
+    out.kind = impostor.kind;
+    return out;
+}
+
+// Blends the four frames at the quad's uv. False where the blended coverage is under a half, or the
+// pixel belongs to the full level while it fades out.
+static bool impostor_surface(ImpostorVertexOut in, texture2d_array<float> albedoAtlas,
+                             texture2d_array<float> normalAtlas, thread float3 &albedo, thread float3 &normal_ws) {
+    if (lod_dissolved(in.position.xy, in.color.a, true)) {
+        return false;
+    }
+    constexpr sampler atlasSampler(filter::linear, mip_filter::linear, address::clamp_to_edge);
+    // Half a texel in from the frame's edges, so the neighbouring frames do not bleed in
+    float2 uv = clamp(in.uv, 0.5 / IMPOSTOR_FRAME_SIZE, 1.0 - 0.5 / IMPOSTOR_FRAME_SIZE);
+    float4 albedoSum = 0.0;
+    float4 normalSum = 0.0;
+    for (uint i = 0; i < 4; ++i) {
+        uint frame = in.frames[i];
+        float2 atlasUv = (float2(frame % IMPOSTOR_FRAMES, frame / IMPOSTOR_FRAMES) + uv) / float(IMPOSTOR_FRAMES);
+        albedoSum += albedoAtlas.sample(atlasSampler, atlasUv, in.kind) * in.weights[i];
+        normalSum += normalAtlas.sample(atlasSampler, atlasUv, in.kind) * in.weights[i];
+    }
+    if (albedoSum.a < 0.5) {
+        return false;
+    }
+    // The atlas is cleared to zero around the parts, so dividing by coverage undoes filtering towards it
+    albedo = albedoSum.rgb / albedoSum.a * in.color.rgb;
+    float3 n = normalSum.rgb / normalSum.a * 2.0 - 1.0;
+    normal_ws = float3(in.yaw.x * n.x + in.yaw.y * n.z, n.y, in.yaw.x * n.z - in.yaw.y * n.x);
+    return true;
+}
+
+fragment float4 impostor_fragment(ImpostorVertexOut in [[stage_in]],
+                                  constant FrameUniforms &frame [[buffer(5)]],
+                                  texture2d_array<float> albedoAtlas [[texture(8)]],
+                                  texture2d_array<float> normalAtlas [[texture(9)]],
+                                  constant ShadowUniforms &shadow [[buffer(3), function_constant(shadows)]],
+                                  depth2d_array<float> shadowMap [[texture(0), function_constant(shadows)]],
+                                  texture2d<float> skyView [[texture(4), function_constant(sky_fog)]],
+                                  constant LightClusterUniforms &clusters [[buffer(9), function_constant(point_lights)]],
+                                  const device PointLight *lights [[buffer(10), function_constant(point_lights)]],
+                                  const device uint *clusterCounts [[buffer(11), function_constant(point_lights)]],
+                                  const device ushort *clusterLights [[buffer(12), function_constant(point_lights)]],
+                                  raytracing::instance_acceleration_structure scene [[buffer(13), function_constant(ray_traced_shadows)]]) {
+    float3 albedo;
+    float3 normal_ws;
+    if (!impostor_surface(in, albedoAtlas, normalAtlas, albedo, normal_ws)) {
+        discard_fragment();
+    }
+    float visibility = 1.0;
+    if (ray_traced_shadows) {
+        visibility = traced_shadow_visibility(scene, in.position_ws, normal_ws, frame.lightDirection, in.view_depth);
+    } else if (shadows) {
+        visibility = shadow_visibility(shadow, shadowMap, in.position_ws, normal_ws, in.view_depth);
+    }
+    float3 fogColor = FOG_COLOR;
+    if (sky_fog) {
+        fogColor = sky_color(skyView, in.position_ws - frame.cameraPosition, frame.lightDirection);
+    }
+    float3 color = shade(albedo, normal_ws, frame.lightDirection, visibility);
+    if (point_lights) {
+        color += point_lighting(albedo, in.position_ws, normal_ws, in.position.xy, in.view_depth,
+                                clusters, lights, clusterCounts, clusterLights);
+    }
+    float3 fogged = apply_fog(color, in.position_ws, frame, fogColor);
+    return float4(fogged, ambient_share(albedo, color, fogged, in.position_ws, frame, fogColor));
+}
+
+fragment GBufferOut impostor_gbuffer_fragment(ImpostorVertexOut in [[stage_in]],
+                                              texture2d_array<float> albedoAtlas [[texture(8)]],
+                                              texture2d_array<float> normalAtlas [[texture(9)]]) {
+    float3 albedo;
+    float3 normal_ws;
+    if (!impostor_surface(in, albedoAtlas, normalAtlas, albedo, normal_ws)) {
+        discard_fragment();
+    }
+    return write_gbuffer(albedo, normal_ws, in.position);
+}
+
+// --- Skinning (compute) ---
+// Poses every vertex of every skinned instance once a frame; the scene and shadow passes draw the
+// result with the instanced pipelines. Matches skin_vertex() in animation.cpp; see gpu_skinning.hpp.
+
+// Matches SkinParams in gpu_skinning.mm
+struct SkinParams {
+    uint vertexCount;
+    uint jointCount;
+    uint instanceCount;
+    uint padding;
+};
+
+// Matches VertexSkin in animation.hpp: four joints and unorm8 weights summing to 255
+struct VertexSkin {
+    uchar4 joints;
+    uchar4 weights;
+};
+
+// Matches Affine in affine.hpp: the top three rows of a 4x4 transform
+struct SkinJoint {
+    float4 rows[3];
+};
+
+kernel void skin_vertices(constant SkinParams &params [[buffer(0)]],
+                          const device MeshletVertex *rest [[buffer(1)]],
+                          const device VertexSkin *skins [[buffer(2)]],
+                          const device SkinJoint *palettes [[buffer(3)]],
+                          device MeshletVertex *skinned [[buffer(4)]],
+                          uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= params.vertexCount || gid.y >= params.instanceCount) {
+        return;
+    }
+    const VertexSkin skin = skins[gid.x];
+    const float4 weights = float4(skin.weights) * (1.0 / 255.0);
+    const device SkinJoint *palette = palettes + gid.y * params.jointCount;
+    float4 rows[3] = { float4(0.0), float4(0.0), float4(0.0) };
+    for (uint i = 0; i < 4; ++i) {
+        const device SkinJoint &joint = palette[min(uint(skin.joints[i]), params.jointCount - 1)];
+        for (uint r = 0; r < 3; ++r) {
+            rows[r] += weights[i] * joint.rows[r];
+        }
+    }
+
+    const MeshletVertex in = rest[gid.x];
+    const float4 position = float4(in.position, 1.0);
+    const float3 normal = in.normal;
+    MeshletVertex out;
+    out.position = float3(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position));
+    out.normal = normalize(float3(dot(rows[0].xyz, normal), dot(rows[1].xyz, normal), dot(rows[2].xyz, normal)));
+    skinned[gid.y * params.vertexCount + gid.x] = out;
+}
+
+// --- Bindless Landscape ---
+// Chunks are drawn without per-draw bindings: the draw ID arrives as the base instance and
+// indexes a table of records in the scene argument buffer, which point at the vertices.
+
+// Matches DrawRecord in scene_arguments.hpp
+struct DrawRecord {
+    float4x4 modelMatrix;
+    const device uchar *vertices;   // TerrainVertex or, with packed_vertices, PackedTerrainVertex
+    uint material;
+    uint padding;
+};
+
+// Matches MaterialParams in scene_arguments.hpp
+struct MaterialParams {
+    float4 color;
+};
+
+// Matches SceneArguments in scene_arguments.hpp
+struct SceneArguments {
+    const device DrawRecord *draws;
+    const device MaterialParams *materials;
+};
+
+vertex LandscapeVertexOut landscape_vertex_bindless(uint vertex_id [[vertex_id]],
+                                                    uint draw_id [[instance_id]],
+                                                    constant SceneArguments &scene [[buffer(4)]],
+                                                    constant FrameUniforms &frame [[buffer(5)]]) {
+    const device DrawRecord &draw = scene.draws[draw_id];
+
+    float3 position;
+    float3 normal_ws;
+    if (packed_vertices) {
+        PackedTerrainVertex v = ((const device PackedTerrainVertex *)draw.vertices)[vertex_id];
+        position = float3(ushort3(v.position.xyz)) / 65535.0;
+        normal_ws = decode_octahedral(max(float2(short2(v.normal)) / 32767.0, -1.0));
+    } else {
+        TerrainVertex v = ((const device TerrainVertex *)draw.vertices)[vertex_id];
+        position = v.position;
+        normal_ws = (draw.modelMatrix * float4(v.normal, 0.0)).xyz;
+    }
+
+    LandscapeVertexOut out;
+    float4 world_pos = draw.modelMatrix * float4(position, 1.0);
+    out.position = frame.viewProjection * world_pos;
+    out.normal_ws = normal_ws;
+    out.position_ws = world_pos.xyz;
+    out.view_depth = out.position.w;
+    out.albedo = scene.materials[draw.material].color.rgb;
+    light_landscape_vertex(out, frame);
+    return out;
+}
+
+// --- Temporal Upscaling ---
+// The scene has no moving objects, so motion comes from the camera alone: each pixel is
+// unprojected with this frame's jittered matrix and reprojected with the unjittered ones.
+
+// Matches MotionParams in upscaler.mm
+struct MotionParams {
+    float4x4 inverseViewProjection;
+    float4x4 viewProjection;
+    float4x4 previousViewProjection;
+};
+
+// Texture UV of a clip-space position; UV y points down
+static float2 clip_to_uv(float4 clip) {
+    float2 ndc = clip.xy / clip.w;
+    return float2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+}
+
+// Writes the UV offset from each pixel to where its surface was last frame
+kernel void camera_motion_vectors(depth2d<float, access::read> depth [[texture(0)]],
+                                  texture2d<half, access::write> motion [[texture(1)]],
+                                  constant MotionParams &params [[buffer(0)]],
+                                  uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= motion.get_width() || gid.y >= motion.get_height()) {
+        return;
+    }
+
+    float2 uv = (float2(gid) + 0.5) / float2(motion.get_width(), motion.get_height());
+    // Left homogeneous: clip_to_uv divides by w anyway, and the sky of an infinite projection has w = 0
+    float4 world = params.inverseViewProjection * float4(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, depth.read(gid), 1.0);
+
+    float2 offset = clip_to_uv(params.previousViewProjection * world) - clip_to_uv(params.viewProjection * world);
+    motion.write(half4(half2(offset), 0.0h, 0.0h), gid);
+}
+
+// --- Temporal Anti-Aliasing ---
+// The jittered frame at the output size, blended into the last frame's result reprojected through the
+// motion vectors above, with the history clipped into the current 3x3 neighbourhood's range in YCoCg so
+// it cannot ghost; see temporal_aa.hpp. The result goes to the output, which the debug lines are drawn
+// over, and to the next frame's history, which stays clean of them.
+
+// Matches TemporalAAParams in upscaler.mm
+struct TemporalAAParams {
+    float currentWeight;    // Share of a still pixel taken from the current frame
+    float motionWeight;     // Share added per pixel of motion
+    float maxCurrentWeight; // Largest share of the current frame
+    uint hasHistory;        // 0 on the first frame after the targets were made
+};
+
+// Same as rgb_to_ycocg and ycocg_to_rgb in temporal_aa.cpp
+static float3 rgb_to_ycocg(float3 rgb) {
+    return float3(dot(rgb, float3(0.25, 0.5, 0.25)), dot(rgb, float3(0.5, 0.0, -0.5)),
+                  dot(rgb, float3(-0.25, 0.5, -0.25)));
+}
+
+static float3 ycocg_to_rgb(float3 ycocg) {
+    return float3(ycocg.x + ycocg.y - ycocg.z, ycocg.x + ycocg.z, ycocg.x - ycocg.y - ycocg.z);
+}
+
+// Same as taa_clip_history in temporal_aa.cpp
+static float3 taa_clip_history(float3 color, float3 box_min, float3 box_max) {
+    float3 center = 0.5 * (box_max + box_min);
+    float3 extents = 0.5 * (box_max - box_min) + 1e-4;
+    float3 offset = color - center;
+    float3 units = abs(offset / extents);
+    float furthest = max(units.x, max(units.y, units.z));
+    return furthest > 1.0 ? center + offset / furthest : color;
+}
+
+kernel void temporal_aa_resolve(texture2d<float, access::read> color [[texture(0)]],
+                                texture2d<half, access::read> motion [[texture(1)]],
+                                texture2d<float, access::sample> history [[texture(2)]],
+                                texture2d<float, access::write> output [[texture(3)]],
+                                texture2d<float, access::write> accumulated [[texture(4)]],
+                                constant TemporalAAParams &params [[buffer(0)]],
+                                uint2 gid [[thread_position_in_grid]]) {
+    uint2 size = uint2(output.get_width(), output.get_height());
+    if (gid.x >= size.x || gid.y >= size.y) {
+        return;
+    }
+
+    float3 current = rgb_to_ycocg(color.read(gid).rgb);
+    float3 box_min = current;
+    float3 box_max = current;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            uint2 texel = uint2(clamp(int2(gid) + int2(x, y), int2(0), int2(size) - 1));
+            float3 neighbour = rgb_to_ycocg(color.read(texel).rgb);
+            box_min = min(box_min, neighbour);
+            box_max = max(box_max, neighbour);
+        }
+    }
+
+    // Uncovered from off screen, or nothing accumulated yet: the frame alone
+    float2 offset = float2(motion.read(gid).xy);
+    float2 uv = (float2(gid) + 0.5) / float2(size) + offset;
+    float3 resolved = current;
+    if (params.hasHistory != 0 && all(uv >= 0.0) && all(uv <= 1.0)) {
+        constexpr sampler bilinear(filter::linear, address::clamp_to_edge);
+        float3 clipped = taa_clip_history(rgb_to_ycocg(history.sample(bilinear, uv).rgb), box_min, box_max);
+        float weight = clamp(params.currentWeight + params.motionWeight * length(offset * float2(size)),
+                             params.currentWeight, params.maxCurrentWeight);
+        resolved = mix(clipped, current, weight);
+    }
+    float4 rgb = float4(ycocg_to_rgb(resolved), 1.0);
+    output.write(rgb, gid);
+    accumulated.write(rgb, gid);
+}
+
+// --- Composite ---
+// The scene is rendered offscreen at the drawable's size; one triangle covering the screen
+// copies it into the drawable and lays the UI overlay over it. The overlay holds ImGui's
+// colour premultiplied by its coverage, and the coverage in alpha; see ui_overlay.hpp.
+
+struct CompositeVertexOut {
+    float4 position [[position]];
+};
+
+vertex CompositeVertexOut composite_vertex(uint vertex_id [[vertex_id]]) {
+    float2 uv = float2((vertex_id << 1) & 2, vertex_id & 2);
+    CompositeVertexOut out;
+    out.position = float4(uv * 2.0 - 1.0, 0.0, 1.0);
+    return out;
+}
+
+fragment half4 composite_fragment(CompositeVertexOut in [[stage_in]],
+                                  texture2d<half, access::read> scene [[texture(0)]],
+                                  texture2d<half, access::read> overlay [[texture(1)]]) {
+    uint2 pixel = uint2(in.position.xy);
+    half4 ui = overlay.read(pixel);
+    return half4(scene.read(pixel).rgb * (1.0h - ui.a) + ui.rgb, 1.0h);
+}
+
+// A scene pass drawn through a rasterization rate map leaves its colour at the smaller physical
+// size; each screen pixel reads it back at the physical position the map placed it at, filtered
+// where a zone was shaded below full rate. See gpu_rasterization_rate.hpp.
+fragment half4 rate_map_resolve_fragment(CompositeVertexOut in [[stage_in]],
+                                         constant rasterization_rate_map_data& map [[buffer(0)]],
+                                         texture2d<half> scene [[texture(0)]]) {
+    constexpr sampler physicalSampler(coord::pixel, filter::linear, address::clamp_to_edge);
+    rasterization_rate_map_decoder decoder(map);
+    float2 physical = decoder.map_screen_to_physical_coordinates(in.position.xy);
+    return half4(scene.sample(physicalSampler, physical).rgb, 1.0h);
+}
+
+// --- Geometry Clipmaps ---
+// Nested grids around the camera that place their vertices from the vertex ID; see clipmap.hpp.
+// The ocean and the clipmap terrain share the placement, which matches clipmap_point in clipmap.cpp.
+
+// Matches ClipmapLevel in clipmap.hpp
+struct ClipmapLevel {
+    float2 center;                  // World x/z of the grid centre
+    float2 innerShift;              // Offset of the inner level's centre, in cells
+    float cellSize;
+    float lod;                      // Mip of a texture matching the cell size
+    float nextLod;                  // lod of the next coarser level
+    float padding;
+};
+
+struct ClipmapPoint {
+    float2 xz;                      // World position
+    float morph;                    // 0 inside the level, 1 where it meets the next
+};
+
+static ClipmapPoint clipmap_point(ClipmapLevel level, uint grid_size, uint vertex_id) {
+    int half_size = int(grid_size / 2);
+    int quarter = int(grid_size / 4);
+    int i = int(vertex_id % (grid_size + 1)) - half_size;
+    int j = int(vertex_id / (grid_size + 1)) - half_size;
+
+    // The ring's inner edge follows the inner level; the outer quarter slides onto the next lattice
+    float2 p = float2(i, j) + select(float2(0.0), level.innerShift, abs(int2(i, j)) <= quarter);
+    ClipmapPoint out;
+    out.morph = saturate((float(max(abs(i), abs(j))) - 0.375 * grid_size) / (0.125 * grid_size));
+    p -= out.morph * (p - 2.0 * floor(0.5 * p));
+    out.xz = level.center + p * level.cellSize;
+    return out;
+}
+
+// Clipmap terrain: each level's heights live in one slice of a texture array, a window of the
+// level's lattice stored toroidally (see terrain_clipmap.hpp), so a move only refreshes the
+// strips that enter the window.
+
+// Matches TerrainClipmapUpdate in gpu_terrain_clipmap.mm
+struct TerrainClipmapUpdate {
+    int2 origin;                    // Lattice point of the region's first thread, in the level's cells
+    uint2 size;                     // Region points along x and z
+    float cellSize;                 // World distance between the level's lattice points
+    uint level;                     // Slice of the texture array
+    uint textureSize;               // Texels per side of a slice
+    float noiseOffset;              // Terrain noise mapping, as in TerrainGenParams
+    float noiseScale;
+    float heightScale;
+    NoiseSettings noise;
+};
+
+kernel void update_terrain_clipmap(constant TerrainClipmapUpdate &update [[buffer(0)]],
+                                   texture2d_array<float, access::write> heights [[texture(0)]],
+                                   uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= update.size.x || gid.y >= update.size.y) {
+        return;
+    }
+    int2 lattice = update.origin + int2(gid);
+    float h = gpu_noise_height(float2(lattice) * update.cellSize, update.noiseOffset, update.noiseScale,
+                               update.heightScale, update.noise);
+    // Matches terrain_clipmap_texel
+    int size = int(update.textureSize);
+    uint2 texel = uint2(((lattice % size) + size) % size);
+    heights.write(float4(h, 0.0, 0.0, 0.0), texel, update.level);
+}
+
+// Matches TerrainClipmapUniforms in gpu_terrain_clipmap.mm
+struct TerrainClipmapUniforms {
+    uint gridSize;                  // Cells per side of a level
+    uint textureSize;               // Texels per side of a height slice
+    uint levelCount;
+    uint padding;
+    ClipmapLevel levels[8];         // CLIPMAP_MAX_LEVELS
+};
+
+// Bilinear, wrapping: lattice point p sits at the centre of texel p mod size
+static float clipmap_height(texture2d_array<float> heights, float2 cell, uint slice, uint texture_size) {
+    constexpr sampler wrap(filter::linear, address::repeat);
+    return heights.sample(wrap, (cell + 0.5) / float(texture_size), slice, level(0.0)).r;
+}
+
+// The full grid for instance 0 and the ring for the coarser levels. Heights and normals come from
+// the level's slice; across the outer quarter both slide onto the next level's lattice with the vertex.
+vertex LandscapeVertexOut landscape_vertex_clipmap(uint vertex_id [[vertex_id]],
+                                                   uint instance_id [[instance_id]],
+                                                   constant TerrainClipmapUniforms &clipmap [[buffer(0)]],
+                                                   constant FrameUniforms &frame [[buffer(5)]],
+                                                   texture2d_array<float> heights [[texture(0)]]) {
+    ClipmapLevel clip = clipmap.levels[instance_id];
+    ClipmapPoint placed = clipmap_point(clip, clipmap.gridSize, vertex_id);
+    float2 cell = placed.xz / clip.cellSize;
+    float h = clipmap_height(heights, cell, instance_id, clipmap.textureSize);
+
+    // Central differences, as generate_terrain_chunk takes them
+    float heightL = clipmap_height(heights, cell - float2(1.0, 0.0), instance_id, clipmap.textureSize);
+    float heightR = clipmap_height(heights, cell + float2(1.0, 0.0), instance_id, clipmap.textureSize);
+    float heightD = clipmap_height(heights, cell - float2(0.0, 1.0), instance_id, clipmap.textureSize);
+    float heightU = clipmap_height(heights, cell + float2(0.0, 1.0), instance_id, clipmap.textureSize);
+
+    LandscapeVertexOut out;
+    out.position_ws = float3(placed.xz.x, h, placed.xz.y);
+    out.position = frame.viewProjection * float4(out.position_ws, 1.0);
+    out.normal_ws = normalize(float3((heightL - heightR) / clip.cellSize, 2.0, (heightD - heightU) / clip.cellSize));
+    out.view_depth = out.position.w;
+    out.albedo = TERRAIN_GRASS_COLOR;
+    light_landscape_vertex(out, frame);
+    return out;
+}
+
+// --- Order-Independent Transparency ---
+// Transparent surfaces draw in a pass of their own after the opaque scene, against its depth
+// without writing it. They add into two memoryless attachments that stay in tile memory:
+// colour 1 sums colour * weight (RGBA16Float, one + one) and colour 2 keeps the revealage
+// (R16Float, multiplied by 1 - alpha). The pass ends with one triangle that reads both through
+// programmable blending and lays the average over the scene colour; matches oit.cpp.
+
+struct OitOut {
+    float4 accum [[color(1)]];
+    float revealage [[color(2)]];   // Blended as dst * (1 - src), so this is the fragment's alpha
+};
+
+// Matches oit_weight in oit.cpp
+static float oit_weight(float view_depth, float alpha) {
+    float near = view_depth / 5.0;
+    float far = view_depth / 200.0;
+    float weight = 10.0 / (1e-5 + near * near + far * far * far * far * far * far);
+    return alpha * clamp(weight, 1e-2, 3e3);
+}
+
+static OitOut oit_output(float3 color, float alpha, float view_depth) {
+    float weight = oit_weight(view_depth, alpha);
+    OitOut out;
+    out.accum = float4(color * weight, weight);
+    out.revealage = alpha;
+    return out;
+}
+
+// apply_fog for pipelines compiled once rather than per variant: fog that is switched off has
+// zero density and an infinite fade end in the frame uniforms. Matches fog_visibility in fog.cpp.
+static float3 apply_frame_fog(float3 color, float3 position_ws, constant FrameUniforms &frame) {
+    float distance = length(position_ws - frame.cameraPosition);
+    float d = frame.fogDensity * distance;
+    float visibility = exp(-d * d);
+    if (isfinite(frame.fadeEnd)) {
+        visibility *= saturate((frame.fadeEnd - distance) / max(frame.fadeEnd - frame.fadeStart, 1e-6));
+    }
+    return mix(FOG_COLOR, color, visibility);
+}
+
+// Matches WaterUniforms in transparency.mm
+struct WaterUniforms {
+    float4 color;                   // rgb: deep colour, a: opacity looking straight down
+    float level;                    // World height of the still surface
+    float patchSize;                // World side of the tiling ocean patch
+    uint gridSize;                  // Cells per side of a clipmap level
+    uint levelCount;
+    ClipmapLevel levels[8];         // CLIPMAP_MAX_LEVELS
+    uint reflectionMips;            // Mips of the reflection probe; 0 reflects the fog colour
+};
+
+struct WaterVertexOut {
+    float4 position [[position]];
+    float3 position_ws;
+    float2 uv;                      // Position on the ocean patch, repeating
+    float view_depth;
+};
+
+// The full grid for instance 0 and the ring for the coarser levels, displaced by the ocean at the level's mip
+vertex WaterVertexOut water_vertex(uint vertex_id [[vertex_id]],
+                                   uint instance_id [[instance_id]],
+                                   constant WaterUniforms &water [[buffer(0)]],
+                                   constant FrameUniforms &frame [[buffer(5)]],
+                                   texture2d<float> displacement [[texture(0)]]) {
+    constexpr sampler wrap(filter::linear, mip_filter::linear, address::repeat);
+    ClipmapLevel clip = water.levels[instance_id];
+    ClipmapPoint placed = clipmap_point(clip, water.gridSize, vertex_id);
+
+    WaterVertexOut out;
+    out.uv = placed.xz / water.patchSize;
+    float3 d = displacement.sample(wrap, out.uv, level(mix(clip.lod, clip.nextLod, placed.morph))).xyz;
+    out.position_ws = float3(placed.xz.x + d.x, water.level + d.y, placed.xz.y + d.z);
+    out.position = frame.viewProjection * float4(out.position_ws, 1.0);
+    out.view_depth = out.position.w;
+    return out;
+}
+
+fragment OitOut water_fragment(WaterVertexOut in [[stage_in]],
+                               constant WaterUniforms &water [[buffer(0)]],
+                               constant FrameUniforms &frame [[buffer(5)]],
+                               texture2d<float> normals [[texture(0)]],
+                               texturecube<float> reflections [[texture(1)]]) {
+    constexpr sampler trilinear(filter::linear, mip_filter::linear, address::repeat, max_anisotropy(8));
+    float4 surface = normals.sample(trilinear, in.uv);
+    float3 normal = normalize(surface.xyz);
+
+    // Schlick's Fresnel term turns grazing views opaque and reflective; foam covers the crests
+    float3 view = normalize(frame.cameraPosition - in.position_ws);
+    float fresnel = 0.02 + 0.98 * pow(1.0 - saturate(dot(normal, view)), 5.0);
+    float specular = pow(saturate(dot(normal, normalize(view + frame.lightDirection))), 256.0);
+    float light = 0.4 + 0.6 * saturate(frame.lightDirection.y);
+    float3 body = water.color.rgb * light;
+    float3 reflected = FOG_COLOR;
+    if (water.reflectionMips > 0) {
+        // Waves turn some reflections downwards; the probe's ground below the water would show through
+        float3 direction = reflect(-view, normal);
+        direction.y = max(direction.y, 0.0);
+        // The second mip's slight roughness hides the probe's resolution on the calm surface
+        constexpr sampler cube(filter::linear, mip_filter::linear);
+        reflected = reflections.sample(cube, direction, level(min(1.0, float(water.reflectionMips - 1)))).rgb;
+    }
+    float3 color = mix(mix(body, reflected, fresnel) + specular, float3(0.9) * light, surface.w);
+    float alpha = mix(water.color.a, 1.0, max(fresnel, surface.w));
+    return oit_output(apply_frame_fog(color, in.position_ws, frame), alpha, in.view_depth);
+}
+
+// Drawn with composite_vertex after the last transparent surface. Pixels nothing transparent
+// covered have a revealage of 1 and keep the scene colour.
+fragment half4 oit_composite_fragment(CompositeVertexOut in [[stage_in]],
+                                      half4 scene [[color(0)]],
+                                      float4 accum [[color(1)]],
+                                      float revealage [[color(2)]]) {
+    float3 average = accum.rgb / max(accum.a, 1e-5);
+    return half4(mix(half3(average), scene.rgb, half(revealage)), 1.0h);
+}
+
+// --- Particles ---
+// The pool particles.metal simulates, drawn in the transparent pass after the composite as one
+// camera-facing quad per survivor. The sort there leaves the keys back to front, so the quads
+// blend premultiplied over the scene colour in order; see gpu_particles.hpp.
+
+// Matches Particle in particles.hpp
+struct PoolParticle {
+    float4 position;                // xyz: world position, w: seconds since emission
+    float4 velocity;                // xyz: world units per second, w: seconds the particle lives
+};
+
+// Matches ParticleDrawUniforms in gpu_particles.mm
+struct ParticleDrawUniforms {
+    float4 color;                   // Straight alpha; fades to 0 with age
+    float3 right;                   // Camera axes, unit length
+    float3 up;
+    float startSize;
+    float endSize;
+};
+
+struct ParticleVertexOut {
+    float4 position [[position]];
+    float2 uv;                      // -1 to 1 across the quad
+    float4 color;                   // Premultiplied
+};
+
+// A triangle strip of four vertices per instance; instance i draws the particle of the i-th sorted key
+vertex ParticleVertexOut particle_vertex(uint vertex_id [[vertex_id]],
+                                         uint instance_id [[instance_id]],
+                                         constant ParticleDrawUniforms &draw [[buffer(0)]],
+                                         const device PoolParticle *particles [[buffer(1)]],
+                                         const device uint2 *keys [[buffer(2)]],
+                                         constant FrameUniforms &frame [[buffer(5)]]) {
+    PoolParticle particle = particles[keys[instance_id].y];
+    float age = saturate(particle.position.w / particle.velocity.w);
+    float2 corner = float2(float(vertex_id & 1) * 2.0 - 1.0, float(vertex_id >> 1) * 2.0 - 1.0);
+    float3 center = particle.position.xyz;
+    float half_size = 0.5 * mix(draw.startSize, draw.endSize, age);
+
+    ParticleVertexOut out;
+    out.position = frame.viewProjection * float4(center + (corner.x * draw.right + corner.y * draw.up) * half_size,
+                                                 1.0);
+    out.uv = corner;
+    float alpha = draw.color.a * (1.0 - age);
+    out.color = float4(apply_frame_fog(draw.color.rgb, center, frame) * alpha, alpha);
+    return out;
+}
+
+// A soft disc; blended as src + dst * (1 - src alpha)
+fragment half4 particle_fragment(ParticleVertexOut in [[stage_in]]) {
+    float falloff = saturate(1.0 - length_squared(in.uv));
+    return half4(in.color * falloff);
+}
+
+// --- Ambient Occlusion ---
+// Alchemy screen-space occlusion at half resolution, upsampled bilaterally over the scene colour;
+// see ambient_occlusion.hpp. Everything here matches ambient_occlusion.cpp.
+
+constant uint AO_SAMPLES = 12;
+constant uint AO_SPIRAL_TURNS = 5;
+constant float AO_MAX_PIXEL_RADIUS = 64.0;
+constant float AO_BIAS = 0.1;
+
+// Matches AmbientOcclusionUniforms in ambient_occlusion.hpp
+struct AmbientOcclusionUniforms {
+    float4x4 inverseProjection;
+    float2 viewport;                // Full-resolution size in pixels
+    float pixelsPerUnit;            // At view depth 1
+    float radius;
+    float intensity;
+    float clearDepth;
+};
+
+static float3 ao_view_position(constant AmbientOcclusionUniforms &ao, float2 pixel, float depth) {
+    float2 ndc = float2(pixel.x / ao.viewport.x * 2.0 - 1.0, 1.0 - pixel.y / ao.viewport.y * 2.0);
+    float4 view = ao.inverseProjection * float4(ndc, depth, 1.0);
+    return view.xyz / view.w;
+}
+
+// The view position of a full-resolution pixel, clamped to the screen
+static float3 ao_pixel_position(constant AmbientOcclusionUniforms &ao, depth2d<float, access::read> depth, int2 pixel) {
+    uint2 p = uint2(clamp(pixel, int2(0), int2(ao.viewport) - 1));
+    return ao_view_position(ao, float2(p) + 0.5, depth.read(p));
+}
+
+static float ao_sample_occlusion(float3 offset, float3 normal, float radius) {
+    float distance_squared = dot(offset, offset);
+    float radius_squared = radius * radius;
+    if (distance_squared >= radius_squared || distance_squared <= 0.0) {
+        return 0.0;
+    }
+    float cosine = dot(offset, normal) * rsqrt(distance_squared);
+    return max(cosine - AO_BIAS, 0.0) * (1.0 - distance_squared / radius_squared);
+}
+
+// The view normal of a full-resolution pixel at center; matches ao_normal: on each axis the
+// neighbour closer in depth
+static float3 ao_pixel_normal(constant AmbientOcclusionUniforms &ao, depth2d<float, access::read> depth, int2 pixel,
+                              float3 center) {
+    float3 left = ao_pixel_position(ao, depth, pixel - int2(1, 0));
+    float3 right = ao_pixel_position(ao, depth, pixel + int2(1, 0));
+    float3 up = ao_pixel_position(ao, depth, pixel - int2(0, 1));
+    float3 down = ao_pixel_position(ao, depth, pixel + int2(0, 1));
+    float3 dx = abs(right.z - center.z) < abs(center.z - left.z) ? right - center : center - left;
+    float3 dy = abs(up.z - center.z) < abs(center.z - down.z) ? up - center : center - down;
+    float3 normal = normalize(cross(dx, dy));
+    return dot(normal, center) > 0.0 ? -normal : normal;
+}
+
+// One thread per half-resolution pixel, sampling the full-resolution depth. Writes the ambient
+// visibility and the view depth the upsample weighs it by; a depth of 0 marks the background.
+kernel void ambient_occlusion(depth2d<float, access::read> depth [[texture(0)]],
+                              texture2d<half, access::write> occlusion [[texture(1)]],
+                              constant AmbientOcclusionUniforms &ao [[buffer(0)]],
+                              uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= occlusion.get_width() || gid.y >= occlusion.get_height()) {
+        return;
+    }
+    int2 pixel = min(int2(gid * 2), int2(ao.viewport) - 1);
+    if (depth.read(uint2(pixel)) == ao.clearDepth) {
+        occlusion.write(half4(1.0h, 0.0h, 0.0h, 0.0h), gid);
+        return;
+    }
+    float3 center = ao_pixel_position(ao, depth, pixel);
+    float3 normal = ao_pixel_normal(ao, depth, pixel, center);
+
+    float view_depth = -center.z;
+    float radius = min(ao.radius * ao.pixelsPerUnit / view_depth, AO_MAX_PIXEL_RADIUS);
+    // Interleaved gradient noise, matches ao_noise
+    float rotation = fract(52.9829189 * fract(0.06711056 * float(gid.x) + 0.00583715 * float(gid.y)));
+    float sum = 0.0;
+    for (uint i = 0; i < AO_SAMPLES; ++i) {
+        float alpha = (float(i) + 0.5) / float(AO_SAMPLES);
+        float angle = (alpha * float(AO_SPIRAL_TURNS) + rotation) * 2.0 * M_PI_F;
+        int2 offset = int2(round(float2(cos(angle), sin(angle)) * alpha * radius));
+        uint2 sample_pixel = uint2(clamp(pixel + offset, int2(0), int2(ao.viewport) - 1));
+        float sample_depth = depth.read(sample_pixel);
+        if (sample_depth == ao.clearDepth) {
+            continue;
+        }
+        float3 occluder = ao_view_position(ao, float2(sample_pixel) + 0.5, sample_depth);
+        sum += ao_sample_occlusion(occluder - center, normal, ao.radius);
+    }
+    float visibility = saturate(1.0 - ao.intensity * sum / float(AO_SAMPLES));
+    occlusion.write(half4(half(visibility), half(view_depth), 0.0h, 0.0h), gid);
+}
+
+// The ray-traced tier of ambient_occlusion, see gpu_ray_tracing.hpp: the same position and normal
+// from the depth, but the occlusion is the share of RT_AO_RAYS cosine-distributed rays that hit
+// the terrain or an entity within the radius. Writes what ambient_occlusion does, so the same
+// upsample applies it.
+constant uint RT_AO_RAYS = 8;
+constant float RT_AO_GOLDEN_ANGLE = 2.39996323;
+
+kernel void ray_traced_ambient_occlusion(depth2d<float, access::read> depth [[texture(0)]],
+                                         texture2d<half, access::write> occlusion [[texture(1)]],
+                                         constant AmbientOcclusionUniforms &ao [[buffer(0)]],
+                                         constant float4x4 &viewToWorld [[buffer(1)]],
+                                         raytracing::instance_acceleration_structure scene [[buffer(2)]],
+                                         uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= occlusion.get_width() || gid.y >= occlusion.get_height()) {
+        return;
+    }
+    int2 pixel = min(int2(gid * 2), int2(ao.viewport) - 1);
+    if (depth.read(uint2(pixel)) == ao.clearDepth) {
+        occlusion.write(half4(1.0h, 0.0h, 0.0h, 0.0h), gid);
+        return;
+    }
+    float3 center = ao_pixel_position(ao, depth, pixel);
+    float3 normal = normalize((viewToWorld * float4(ao_pixel_normal(ao, depth, pixel, center), 0.0)).xyz);
+    float view_depth = -center.z;
+    float offset = RAY_NORMAL_OFFSET + RAY_DEPTH_OFFSET * view_depth;
+    float3 origin = (viewToWorld * float4(center, 1.0)).xyz + normal * offset;
+    float3 tangent = normalize(cross(abs(normal.y) < 0.99 ? float3(0.0, 1.0, 0.0) : float3(1.0, 0.0, 0.0), normal));
+    float3 bitangent = cross(normal, tangent);
+
+    raytracing::intersector<raytracing::instancing> occluders;
+    occluders.accept_any_intersection(true);
+    occluders.force_opacity(raytracing::forced_opacity::opaque);
+    // Rotated per pixel by the same noise as the spiral, for the upsample to average
+    float rotation = fract(52.9829189 * fract(0.06711056 * float(gid.x) + 0.00583715 * float(gid.y)));
+    uint hits = 0;
+    for (uint i = 0; i < RT_AO_RAYS; ++i) {
+        float u = (float(i) + 0.5) / float(RT_AO_RAYS);
+        float angle = float(i) * RT_AO_GOLDEN_ANGLE + rotation * 2.0 * M_PI_F;
+        float r = sqrt(u);
+        float3 direction = tangent * (r * cos(angle)) + bitangent * (r * sin(angle)) + normal * sqrt(1.0 - u);
+        raytracing::ray ray(origin, direction, 0.0, ao.radius);
+        hits += occluders.intersect(ray, scene).type == raytracing::intersection_type::none ? 0 : 1;
+    }
+    float visibility = saturate(1.0 - ao.intensity * float(hits) / float(RT_AO_RAYS));
+    occlusion.write(half4(half(visibility), half(view_depth), 0.0h, 0.0h), gid);
+}
+
+// Drawn with composite_vertex over the scene colour. Weighs the 3x3 half-resolution neighbours
+// by depth (ao_upsample_weight), occludes the ambient share the scene alpha holds (ao_apply),
+// and leaves the alpha at 1 for the passes after it.
+fragment half4 ambient_occlusion_apply_fragment(CompositeVertexOut in [[stage_in]],
+                                                half4 scene [[color(0)]],
+                                                depth2d<float, access::read> depth [[texture(0)]],
+                                                texture2d<half, access::read> occlusion [[texture(1)]],
+                                                constant AmbientOcclusionUniforms &ao [[buffer(0)]]) {
+    uint2 pixel = uint2(in.position.xy);
+    float d = depth.read(pixel);
+    if (d == ao.clearDepth) {
+        return half4(scene.rgb, 1.0h);
+    }
+    float view_depth = -ao_view_position(ao, in.position.xy, d).z;
+    int2 center = int2(pixel / 2);
+    int2 last = int2(occlusion.get_width(), occlusion.get_height()) - 1;
+    float sum = 0.0;
+    float weights = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            float2 s = float2(occlusion.read(uint2(clamp(center + int2(x, y), int2(0), last))).rg);
+            if (s.y <= 0.0) {
+                continue;
+            }
+            float weight = 1.0 / (1e-3 + abs(s.y - view_depth) / view_depth);
+            sum += weight * s.x;
+            weights += weight;
+        }
+    }
+    float visibility = weights > 0.0 ? sum / weights : 1.0;
+    return half4(scene.rgb * half(1.0 - float(scene.a) * (1.0 - visibility)), 1.0h);
+}
+
+// --- Atmosphere ---
+// Hillaire's sky (2020), see atmosphere.hpp. Distances are in kilometres from the planet centre,
+// and the viewer stands on the +Y axis at bottomRadius + viewerAltitude. The transmittance and
+// multiple scattering kernels only depend on the atmosphere and run once; the sky view kernel
+// runs again whenever the sun moves. Lookup coordinates match atmosphere.cpp.
+
+// Matches AtmosphereParams in atmosphere.hpp
+struct AtmosphereParams {
+    float3 rayleighScattering;      // Per kilometre at sea level
+    float3 mieScattering;
+    float3 mieExtinction;
+    float3 ozoneAbsorption;         // At the peak of the ozone tent
+    float3 groundAlbedo;
+    float3 sunDirection;            // Towards the sun, unit length
+    float bottomRadius;
+    float topRadius;
+    float rayleighScaleHeight;
+    float mieScaleHeight;
+    float miePhaseG;
+    float ozoneCenter;
+    float ozoneWidth;
+    float viewerAltitude;
+    float sunIlluminance;
+    float exposure;
+};
+
+struct AtmosphereMedium {
+    float3 rayleigh;                // Rayleigh scattering
+    float3 mie;                     // Mie scattering
+    float3 scattering;              // Both
+    float3 extinction;              // Scattering plus Mie and ozone absorption
+};
+
+static AtmosphereMedium sample_medium(constant AtmosphereParams &atmosphere, float altitude) {
+    float rayleighDensity = exp(-altitude / atmosphere.rayleighScaleHeight);
+    float mieDensity = exp(-altitude / atmosphere.mieScaleHeight);
+    float ozoneDensity = max(0.0, 1.0 - abs(altitude - atmosphere.ozoneCenter) / (0.5 * atmosphere.ozoneWidth));
+    AtmosphereMedium medium;
+    medium.rayleigh = atmosphere.rayleighScattering * rayleighDensity;
+    medium.mie = atmosphere.mieScattering * mieDensity;
+    medium.scattering = medium.rayleigh + medium.mie;
+    medium.extinction = medium.rayleigh + atmosphere.mieExtinction * mieDensity + atmosphere.ozoneAbsorption * ozoneDensity;
+    return medium;
+}
+
+// Distance along a unit direction to the first crossing of a sphere around the planet centre that
+// is not behind the origin, or -1 if there is none
+static float ray_sphere(float3 origin, float3 direction, float radius) {
+    float b = dot(origin, direction);
+    float discriminant = b * b - dot(origin, origin) + radius * radius;
+    if (discriminant < 0.0) {
+        return -1.0;
+    }
+    float root = sqrt(discriminant);
+    float near = -b - root;
+    float far = -b + root;
+    return near >= 0.0 ? near : (far >= 0.0 ? far : -1.0);
+}
+
+// Distance to the top of the atmosphere from inside it, as the lookup table parameterizes it
+static float distance_to_top(constant AtmosphereParams &atmosphere, float radius, float mu) {
+    float discriminant = radius * radius * (mu * mu - 1.0) + atmosphere.topRadius * atmosphere.topRadius;
+    return max(0.0, -radius * mu + sqrt(max(discriminant, 0.0)));
+}
+
+// Matches atmosphere_transmittance_uv in atmosphere.cpp
+static float2 transmittance_uv(constant AtmosphereParams &atmosphere, float radius, float mu) {
+    float horizon = sqrt(atmosphere.topRadius * atmosphere.topRadius - atmosphere.bottomRadius * atmosphere.bottomRadius);
+    float rho = sqrt(max(radius * radius - atmosphere.bottomRadius * atmosphere.bottomRadius, 0.0));
+    float dMin = atmosphere.topRadius - radius;
+    float dMax = rho + horizon;
+    return float2((distance_to_top(atmosphere, radius, mu) - dMin) / (dMax - dMin), rho / horizon);
+}
+
+static float3 lookup_transmittance(constant AtmosphereParams &atmosphere, texture2d<float> transmittance,
+                                   float radius, float mu) {
+    constexpr sampler linear(coord::normalized, filter::linear, address::clamp_to_edge);
+    return transmittance.sample(linear, transmittance_uv(atmosphere, radius, mu), level(0)).rgb;
+}
+
+// Multiple scattering is looked up by the cosine of the sun zenith across and altitude down
+static float3 lookup_multiscattering(constant AtmosphereParams &atmosphere, texture2d<float> multiscattering,
+                                     float radius, float sunMu) {
+    constexpr sampler linear(coord::normalized, filter::linear, address::clamp_to_edge);
+    float2 uv = float2(sunMu * 0.5 + 0.5, (radius - atmosphere.bottomRadius) / (atmosphere.topRadius - atmosphere.bottomRadius));
+    return multiscattering.sample(linear, uv, level(0)).rgb;
+}
+
+// Light from the sun reaching a point: through the atmosphere above it, and none in the planet's shadow
+static float3 sun_transmittance(constant AtmosphereParams &atmosphere, texture2d<float> transmittance, float3 position,
+                                float3 sun) {
+    if (ray_sphere(position, sun, atmosphere.bottomRadius) >= 0.0) {
+        return float3(0.0);
+    }
+    float radius = length(position);
+    return lookup_transmittance(atmosphere, transmittance, radius, dot(position / radius, sun));
+}
+
+// Where a ray from inside the atmosphere stops: the ground if it hits it, else the top
+static float ray_length(constant AtmosphereParams &atmosphere, float3 origin, float3 direction, thread bool &ground) {
+    float toGround = ray_sphere(origin, direction, atmosphere.bottomRadius);
+    ground = toGround >= 0.0;
+    return ground ? toGround : max(ray_sphere(origin, direction, atmosphere.topRadius), 0.0);
+}
+
+static float rayleigh_phase(float cosTheta) {
+    return 3.0 / (16.0 * M_PI_F) * (1.0 + cosTheta * cosTheta);
+}
+
+// Cornette-Shanks, the Henyey-Greenstein lobe with Rayleigh's symmetric term
+static float mie_phase(float cosTheta, float g) {
+    float k = 3.0 / (8.0 * M_PI_F) * (1.0 - g * g) / (2.0 + g * g);
+    return k * (1.0 + cosTheta * cosTheta) / pow(1.0 + g * g - 2.0 * g * cosTheta, 1.5);
+}
+
+// One texel per thread: the optical depth to the top of the atmosphere along a ray that misses the
+// ground, by midpoint integration; matches atmosphere_transmittance in atmosphere.cpp
+kernel void atmosphere_transmittance_lut(constant AtmosphereParams &atmosphere [[buffer(0)]],
+                                         texture2d<float, access::write> out [[texture(0)]],
+                                         uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= out.get_width() || gid.y >= out.get_height()) {
+        return;
+    }
+    // Inverse of transmittance_uv
+    float2 uv = (float2(gid) + 0.5) / float2(out.get_width(), out.get_height());
+    float horizon = sqrt(atmosphere.topRadius * atmosphere.topRadius - atmosphere.bottomRadius * atmosphere.bottomRadius);
+    float rho = horizon * uv.y;
+    float radius = sqrt(rho * rho + atmosphere.bottomRadius * atmosphere.bottomRadius);
+    float dMin = atmosphere.topRadius - radius;
+    float d = dMin + uv.x * (rho + horizon - dMin);
+    float mu = d == 0.0 ? 1.0 : clamp((horizon * horizon - rho * rho - d * d) / (2.0 * radius * d), -1.0, 1.0);
+
+    constexpr uint STEPS = 40;
+    float dt = distance_to_top(atmosphere, radius, mu) / float(STEPS);
+    float3 opticalDepth = float3(0.0);
+    for (uint i = 0; i < STEPS; ++i) {
+        float t = (float(i) + 0.5) * dt;
+        float r = sqrt(radius * radius + t * t + 2.0 * radius * mu * t);
+        opticalDepth += sample_medium(atmosphere, r - atmosphere.bottomRadius).extinction * dt;
+    }
+    out.write(float4(exp(-opticalDepth), 1.0), gid);
+}
+
+// One texel per thread: single scattering towards the point from 64 directions around it, lit by a
+// unit sun, plus the ground's bounce. Treating every further order as scattering the same fraction
+// again sums the series: psi = L2 / (1 - f_ms).
+kernel void atmosphere_multiscattering_lut(constant AtmosphereParams &atmosphere [[buffer(0)]],
+                                           texture2d<float> transmittance [[texture(0)]],
+                                           texture2d<float, access::write> out [[texture(1)]],
+                                           uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= out.get_width() || gid.y >= out.get_height()) {
+        return;
+    }
+    float2 uv = (float2(gid) + 0.5) / float2(out.get_width(), out.get_height());
+    float sunMu = uv.x * 2.0 - 1.0;
+    float3 sun = float3(sqrt(saturate(1.0 - sunMu * sunMu)), sunMu, 0.0);
+    float3 origin = float3(0.0, mix(atmosphere.bottomRadius + 1e-3, atmosphere.topRadius - 1e-3, uv.y), 0.0);
+
+    constexpr uint RINGS = 8;
+    constexpr uint STEPS = 20;
+    constexpr float ISOTROPIC = 1.0 / (4.0 * M_PI_F);
+    float3 secondOrder = float3(0.0);
+    float3 transfer = float3(0.0);
+    for (uint i = 0; i < RINGS * RINGS; ++i) {
+        // Uniform over the sphere: cos theta and phi on an 8x8 grid
+        float cosTheta = 1.0 - 2.0 * (float(i / RINGS) + 0.5) / float(RINGS);
+        float phi = 2.0 * M_PI_F * (float(i % RINGS) + 0.5) / float(RINGS);
+        float sinTheta = sqrt(saturate(1.0 - cosTheta * cosTheta));
+        float3 direction = float3(sinTheta * cos(phi), cosTheta, sinTheta * sin(phi));
+
+        bool ground = false;
+        float dt = ray_length(atmosphere, origin, direction, ground) / float(STEPS);
+        float3 throughput = float3(1.0);
+        float3 radiance = float3(0.0);
+        float3 fraction = float3(0.0);
+        for (uint s = 0; s < STEPS; ++s) {
+            float3 position = origin + direction * ((float(s) + 0.5) * dt);
+            AtmosphereMedium medium = sample_medium(atmosphere, length(position) - atmosphere.bottomRadius);
+            float3 stepTransmittance = exp(-medium.extinction * dt);
+            // Energy-conserving integration of constant in-scattering over the step
+            float3 integral = (1.0 - stepTransmittance) / medium.extinction;
+            float3 inScattering = medium.scattering * ISOTROPIC * sun_transmittance(atmosphere, transmittance, position, sun);
+            radiance += throughput * inScattering * integral;
+            fraction += throughput * medium.scattering * integral;
+            throughput *= stepTransmittance;
+        }
+        if (ground) {
+            float3 position = origin + direction * (dt * float(STEPS));
+            float3 normal = normalize(position);
+            float3 lit = sun_transmittance(atmosphere, transmittance, position, sun) * saturate(dot(normal, sun));
+            radiance += throughput * lit * atmosphere.groundAlbedo / M_PI_F;
+        }
+        secondOrder += radiance;
+        transfer += fraction;
+    }
+    // The average over the sphere, with the isotropic phase towards the point
+    float3 l2 = secondOrder / float(RINGS * RINGS);
+    float3 fms = transfer / float(RINGS * RINGS);
+    out.write(float4(l2 / (1.0 - fms), 1.0), gid);
+}
+
+// One texel per thread: single scattering from the sun and the multiple scattering lookup along
+// the view ray, exposed; the sky pass and sky_fog read the result
+kernel void atmosphere_sky_view_lut(constant AtmosphereParams &atmosphere [[buffer(0)]],
+                                    texture2d<float> transmittance [[texture(0)]],
+                                    texture2d<float> multiscattering [[texture(1)]],
+                                    texture2d<float, access::write> out [[texture(2)]],
+                                    uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= out.get_width() || gid.y >= out.get_height()) {
+        return;
+    }
+    // Inverse of sky_view_uv; matches atmosphere_sky_view_direction in atmosphere.cpp
+    float2 uv = (float2(gid) + 0.5) / float2(out.get_width(), out.get_height());
+    float3 sun = atmosphere.sunDirection;
+    float c = uv.y < 0.5 ? 1.0 - 2.0 * uv.y : 2.0 * uv.y - 1.0;
+    float elevation = (uv.y < 0.5 ? 1.0 : -1.0) * c * c * (M_PI_F / 2.0);
+    float cosAzimuth = 1.0 - 2.0 * uv.x * uv.x;
+    float sinAzimuth = sqrt(saturate(1.0 - cosAzimuth * cosAzimuth));
+    float2 forward = length(sun.xz) > 1e-5 ? normalize(sun.xz) : float2(1.0, 0.0);
+    float2 horizontal = forward * cosAzimuth + float2(-forward.y, forward.x) * sinAzimuth;
+    float3 direction = float3(horizontal.x * cos(elevation), sin(elevation), horizontal.y * cos(elevation));
+
+    float3 origin = float3(0.0, atmosphere.bottomRadius + atmosphere.viewerAltitude, 0.0);
+    bool ground = false;
+    constexpr uint STEPS = 30;
+    float dt = ray_length(atmosphere, origin, direction, ground) / float(STEPS);
+    float cosTheta = dot(direction, sun);
+    float rayleigh = rayleigh_phase(cosTheta);
+    float mie = mie_phase(cosTheta, atmosphere.miePhaseG);
+
+    float3 throughput = float3(1.0);
+    float3 radiance = float3(0.0);
+    for (uint s = 0; s < STEPS; ++s) {
+        float3 position = origin + direction * ((float(s) + 0.5) * dt);
+        float radius = length(position);
+        AtmosphereMedium medium = sample_medium(atmosphere, radius - atmosphere.bottomRadius);
+        float3 stepTransmittance = exp(-medium.extinction * dt);
+        float3 sunLight = sun_transmittance(atmosphere, transmittance, position, sun);
+        float3 multiple = lookup_multiscattering(atmosphere, multiscattering, radius, dot(position / radius, sun));
+        float3 inScattering = (medium.rayleigh * rayleigh + medium.mie * mie) * sunLight + medium.scattering * multiple;
+        radiance += throughput * inScattering * (1.0 - stepTransmittance) / medium.extinction;
+        throughput *= stepTransmittance;
+    }
+    out.write(float4(radiance * atmosphere.sunIlluminance * atmosphere.exposure, 1.0), gid);
+}
+
+// The sky pass: deferred_lighting_vertex's triangle at the far plane, drawn with an Equal depth test
+// so it only covers pixels no surface did. Tone mapped like sky_color, plus the sun's disk.
+constant float SUN_COS_RADIUS = 0.99999; // About half a degree across, like the real sun
+
+fragment float4 sky_fragment(DeferredVertexOut in [[stage_in]],
+                             constant DeferredUniforms &deferred [[buffer(0)]],
+                             constant AtmosphereParams &atmosphere [[buffer(1)]],
+                             constant FrameUniforms &frame [[buffer(5)]],
+                             texture2d<float> skyView [[texture(4)]],
+                             texture2d<float> transmittance [[texture(5)]]) {
+    // Unprojected at the near plane, which stays finite with an infinite reverse-Z far plane
+    float4 world = deferred.inverseViewProjection * float4(in.ndc, 1.0 - deferred.farDepth, 1.0);
+    float3 direction = normalize(world.xyz / world.w - frame.cameraPosition);
+    float3 radiance = sky_radiance(skyView, direction, frame.lightDirection);
+
+    float3 origin = float3(0.0, atmosphere.bottomRadius + atmosphere.viewerAltitude, 0.0);
+    if (dot(direction, frame.lightDirection) > SUN_COS_RADIUS && ray_sphere(origin, direction, atmosphere.bottomRadius) < 0.0) {
+        float3 light = lookup_transmittance(atmosphere, transmittance, origin.y, direction.y);
+        radiance += light * atmosphere.sunIlluminance * atmosphere.exposure;
+    }
+    return float4(1.0 - exp(-radiance), 1.0);
+}
+
+// --- Light Clustering ---
+// One thread per cluster. Each threadgroup brings LIGHT_CLUSTER_BATCH lights at a time into
+// threadgroup memory in view space, and every thread tests them against its cluster's box, so
+// each light is read and transformed once per group rather than once per cluster. Lists keep
+// light order and stop at LIGHT_CLUSTER_MAX_LIGHTS; the count keeps going. Matches
+// light_clusters_build in light_clusters.cpp.
+
+constant uint LIGHT_CLUSTER_BATCH = 64; // Threads per threadgroup, see gpu_light_clusters.mm
+
+// View-space bounds of a cluster's piece of the frustum; matches light_cluster_box
+static void light_cluster_box(constant LightClusterUniforms &clusters, uint cluster, thread float3 &lo,
+                              thread float3 &hi) {
+    uint x = cluster % LIGHT_CLUSTER_X;
+    uint y = cluster / LIGHT_CLUSTER_X % LIGHT_CLUSTER_Y;
+    uint slice = cluster / (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y);
+    // Tile rows count down from the top of the screen, where NDC y is 1
+    float2 ndcMin = float2(-1.0 + 2.0 * float(x) / LIGHT_CLUSTER_X, 1.0 - 2.0 * float(y + 1) / LIGHT_CLUSTER_Y);
+    float2 ndcMax = float2(-1.0 + 2.0 * float(x + 1) / LIGHT_CLUSTER_X, 1.0 - 2.0 * float(y) / LIGHT_CLUSTER_Y);
+    float range = clusters.farZ / clusters.nearZ;
+    float nearDepth = clusters.nearZ * pow(range, float(slice) / LIGHT_CLUSTER_Z);
+    float farDepth = clusters.nearZ * pow(range, float(slice + 1) / LIGHT_CLUSTER_Z);
+
+    // View x and y are depth * (ndc + offset) / scale, so the extremes lie at the near or far depth
+    float2 scale = clusters.projection.xy;
+    float2 offset = clusters.projection.zw;
+    float2 a = nearDepth * (ndcMin + offset) / scale;
+    float2 b = nearDepth * (ndcMax + offset) / scale;
+    float2 c = farDepth * (ndcMin + offset) / scale;
+    float2 d = farDepth * (ndcMax + offset) / scale;
+    lo = float3(min(min(a, b), min(c, d)), -farDepth);
+    hi = float3(max(max(a, b), max(c, d)), -nearDepth);
+}
+
+kernel void cluster_lights(constant LightClusterUniforms &clusters [[buffer(0)]],
+                           const device PointLight *lights [[buffer(1)]],
+                           device uint *counts [[buffer(2)]],
+                           device ushort *indices [[buffer(3)]],
+                           uint cluster [[thread_position_in_grid]],
+                           uint local [[thread_position_in_threadgroup]]) {
+    threadgroup float4 batch[LIGHT_CLUSTER_BATCH]; // View-space centre and radius
+
+    // Threads past the grid still load lights and meet the barriers, they just list nothing
+    bool active = cluster < LIGHT_CLUSTER_COUNT;
+    float3 lo = 0.0;
+    float3 hi = 0.0;
+    if (active) {
+        light_cluster_box(clusters, cluster, lo, hi);
+    }
+
+    uint count = 0;
+    for (uint base = 0; base < clusters.lightCount; base += LIGHT_CLUSTER_BATCH) {
+        if (base + local < clusters.lightCount) {
+            PointLight light = lights[base + local];
+            batch[local] = float4((clusters.view * float4(light.position, 1.0)).xyz, light.radius);
+        }
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+
+        uint size = min(LIGHT_CLUSTER_BATCH, clusters.lightCount - base);
+        for (uint i = 0; active && i < size; ++i) {
+            float4 sphere = batch[i];
+            float3 d = sphere.xyz - clamp(sphere.xyz, lo, hi);
+            if (dot(d, d) <= sphere.w * sphere.w) {
+                if (count < LIGHT_CLUSTER_MAX_LIGHTS) {
+                    indices[cluster * LIGHT_CLUSTER_MAX_LIGHTS + count] = ushort(base + i);
+                }
+                ++count;
+            }
+        }
+        threadgroup_barrier(mem_flags::mem_threadgroup);
+    }
+    if (active) {
+        counts[cluster] = count;
+    }
+}
+
+// --- Debug Draw ---
+// Wireframe hexahedra over the finished frame, one instance per shape and one line-list vertex
+// per edge end; corner i takes bit 0 along x, bit 1 along y and bit 2 along z. The edge table
+// matches debug_draw.cpp.
+
+struct DebugShape {
+    float3 corners[8];
+    float4 color;
+};
+
+constant uchar DEBUG_SHAPE_EDGES[24] = {
+    0, 1, 2, 3, 4, 5, 6, 7,
+    0, 2, 1, 3, 4, 6, 5, 7,
+    0, 4, 1, 5, 2, 6, 3, 7,
+};
+
+struct DebugVertexOut {
+    float4 position [[position]];
+    half4 color;
+};
+
+vertex DebugVertexOut debug_draw_vertex(uint vertex_id [[vertex_id]],
+                                        uint instance_id [[instance_id]],
+                                        const device DebugShape* shapes [[buffer(0)]],
+                                        constant float4x4 &viewProjection [[buffer(1)]]) {
+    const device DebugShape& shape = shapes[instance_id];
+    DebugVertexOut out;
+    out.position = viewProjection * float4(shape.corners[DEBUG_SHAPE_EDGES[vertex_id]], 1.0);
+    out.color = half4(shape.color);
+    return out;
+}
+
+fragment half4 debug_draw_fragment(DebugVertexOut in [[stage_in]]) {
+    return in.color;
+}
+
+// --- Picking ---
+// The entities around a point of the view, drawn into a small target of IDs through a projection
+// magnified about the point; see picking.hpp and gpu_picking.hpp.
+
+// Matches PickInstance in gpu_picking.hpp
+struct PickInstance {
+    float4x4 modelMatrix;
+    uint2 id;               // PickId: handle slot plus one, and its generation
+    uint2 padding;
+};
+
+struct PickVertexOut {
+    float4 position [[position]];
+    uint2 id [[flat]];
+};
+
+vertex PickVertexOut picking_vertex(const ShadowVertexIn in [[stage_in]],
+                                    constant float4x4 &viewProjection [[buffer(1)]],
+                                    const device PickInstance *instances [[buffer(2)]],
+                                    uint instance_id [[instance_id]]) {
+    const device PickInstance& instance = instances[instance_id];
+    PickVertexOut out;
+    out.position = viewProjection * (instance.modelMatrix * float4(in.position.xyz, 1.0));
+    out.id = instance.id;
+    return out;
+}
 
-    float3 light_dir = normalize(float3(0.8, 1.0, 0.5));
-    float diffuse_k = saturate(dot(normalize(in.normal_ws), light_dir));
-    float3 ambient = float3(0.2, 0.2, 0.2);
-    
-    final_color = final_color * ambient + final_color * diffuse_k;
-    
-    return float4(final_color, 1.0);
+fragment uint2 picking_fragment(PickVertexOut in [[stage_in]]) {
+    return in.id;
 }
@@ -0,0 +1,57 @@
+/**
+ * @file shading_cache.hpp
+ * @brief The per-pixel textures of the reverse reprojection cache that terrain shadowing reuses.
+ *
+ * Two RG16Float textures at the render size hold shadow visibility and view depth. Each frame
+ * shading_cache_begin_frame() swaps them: the ShaderVariant::shadingCache fragments read last
+ * frame's through FrameUniforms::previousViewProjection and write this frame's, with the
+ * lookup and its validity test described in reprojection.hpp. Both are plain textures, so
+ * the GPU-culled chunks inherit them from the encoder like the shadow map.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct ShadingCache
+ * @brief The cache textures and which of them this frame writes.
+ *
+ * Starts empty; shading_cache_begin_frame() allocates the textures.
+ */
+struct ShadingCache {
+    id<MTLTexture> textures[2];     ///< RG16Float visibility and view depth, read and written in turn.
+    uint32_t current = 0;           ///< Index of the texture written this frame.
+    uint32_t width = 0;             ///< Size of both textures in pixels.
+    uint32_t height = 0;
+    uint64_t lastFrame = 0;         ///< Frame the textures were last begun for.
+    bool hasHistory = false;        ///< False until a frame was begun at this size.
+};
+
+/// @return True if the device orders the fragments' texture writes, which the cache relies on.
+bool shading_cache_supported(id<MTLDevice> device);
+
+/// @return GPU bytes held by the textures.
+size_t shading_cache_bytes(const ShadingCache& cache);
+
+/**
+ * @brief Swaps the textures for a frame that shades through the cache.
+ *
+ * Recreates the textures at a new size. If the previous frame did not use the cache, e.g.
+ * because it was toggled off, what it left is stale, and the texture read this frame is
+ * cleared to a depth no fragment matches, so every pixel misses once.
+ *
+ * @param cache The cache.
+ * @param device Device to create the textures on.
+ * @param cmd The frame's command buffer, before the scene pass.
+ * @param width Render target width in pixels.
+ * @param height Render target height in pixels.
+ * @param frame Index of this frame; consecutive frames must count up by one.
+ */
+void shading_cache_begin_frame(ShadingCache& cache, id<MTLDevice> device, id<MTLCommandBuffer> cmd,
+                               uint32_t width, uint32_t height, uint64_t frame);
+
+/// @brief Binds last frame's texture and this frame's for the ShaderVariant::shadingCache fragments.
+void shading_cache_bind(const ShadingCache& cache, id<MTLRenderCommandEncoder> enc);
@@ -0,0 +1,63 @@
+#import "shading_cache.hpp"
+
+namespace {
+    id<MTLTexture> make_cache_texture(id<MTLDevice> device, uint32_t width, uint32_t height, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRG16Float
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModePrivate;
+        // Render target only to be cleared by a pass
+        desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite | MTLTextureUsageRenderTarget;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+
+    void clear(id<MTLCommandBuffer> cmd, id<MTLTexture> texture) {
+        // Full visibility at depth zero, which is never within the tolerance of a visible surface
+        MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+        passDesc.colorAttachments[0].texture = texture;
+        passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+        passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+        passDesc.colorAttachments[0].clearColor = MTLClearColorMake(1.0, 0.0, 0.0, 0.0);
+        id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+        enc.label = @"Clear shading cache";
+        [enc endEncoding];
+    }
+}
+
+bool shading_cache_supported(id<MTLDevice> device) {
+    return device.rasterOrderGroupsSupported;
+}
+
+size_t shading_cache_bytes(const ShadingCache& cache) {
+    size_t bytes = 0;
+    for (id<MTLTexture> texture : cache.textures) {
+        bytes += texture ? texture.allocatedSize : 0;
+    }
+    return bytes;
+}
+
+void shading_cache_begin_frame(ShadingCache& cache, id<MTLDevice> device, id<MTLCommandBuffer> cmd,
+                               uint32_t width, uint32_t height, uint64_t frame) {
+    if (!cache.textures[0] || cache.width != width || cache.height != height) {
+        cache.textures[0] = make_cache_texture(device, width, height, @"Shading cache A");
+        cache.textures[1] = make_cache_texture(device, width, height, @"Shading cache B");
+        cache.width = width;
+        cache.height = height;
+        cache.hasHistory = false;
+    }
+    const bool consecutive = cache.hasHistory && frame == cache.lastFrame + 1;
+    cache.current ^= 1;
+    if (!consecutive) {
+        clear(cmd, cache.textures[cache.current ^ 1]);
+    }
+    cache.lastFrame = frame;
+    cache.hasHistory = true;
+}
+
+void shading_cache_bind(const ShadingCache& cache, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:cache.textures[cache.current ^ 1] atIndex:6];
+    [enc setFragmentTexture:cache.textures[cache.current] atIndex:7];
+}
@@ -0,0 +1,136 @@
+#include "shadow_cascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    simd::float3 light_up(simd::float3 lightDirection) {
+        return std::fabs(lightDirection.y) > 0.99f ? simd::float3{ 0.0f, 0.0f, 1.0f } : simd::float3{ 0.0f, 1.0f, 0.0f };
+    }
+
+    // View depths of the near and far planes of a matrix_perspective_right_hand projection, or
+    // of a matrix_perspective_reverse_z_infinite one, whose depth row is (0, 0, 0, nearZ)
+    void camera_depth_range(const simd::float4x4& projection, float& nearZ, float& farZ) {
+        const float zs = projection.columns[2][2];
+        const float zn = projection.columns[3][2];
+        if (zs == 0.0f) {
+            nearZ = zn;
+            farZ = INFINITY;
+            return;
+        }
+        nearZ = zn / zs;
+        farZ = zn / (zs + 1.0f);
+    }
+}
+
+void shadow_cascade_splits(float nearZ, float farZ, uint32_t count, float lambda, float* splits) {
+    for (uint32_t i = 1; i <= count; ++i) {
+        const float t = (float)i / (float)count;
+        const float logarithmic = nearZ * std::pow(farZ / nearZ, t);
+        const float uniform = nearZ + (farZ - nearZ) * t;
+        splits[i - 1] = lambda * logarithmic + (1.0f - lambda) * uniform;
+    }
+    splits[count - 1] = farZ;
+}
+
+ShadowCascade fit_shadow_cascade(const ShadowSettings& settings, const Camera& cam, float splitNear, float splitFar) {
+    // Smallest sphere around the slice: on the view axis, equidistant from the near and far
+    // corners, or around the far rectangle alone once that is the wider one. It only depends
+    // on the slice, so turning the camera keeps the cascade's size and texel size.
+    const float tanX = 1.0f / cam.projectionMatrix.columns[0][0];
+    const float tanY = 1.0f / cam.projectionMatrix.columns[1][1];
+    const float k2 = tanX * tanX + tanY * tanY;
+    const float depth = std::min((splitNear + splitFar) * 0.5f * (1.0f + k2), splitFar);
+    const float sliceRadius = std::sqrt((splitFar - depth) * (splitFar - depth) + k2 * splitFar * splitFar);
+
+    const simd::float4 viewCenter = simd::inverse(cam.viewMatrix) * simd::float4{ 0.0f, 0.0f, -depth, 1.0f };
+    const simd::float3 sliceCenter = { viewCenter.x, viewCenter.y, viewCenter.z };
+
+    ShadowCascade cascade;
+    cascade.radius = sliceRadius * (1.0f + settings.guardBand);
+    cascade.sliceRadius = sliceRadius;
+    cascade.splitFar = splitFar;
+    cascade.texelSize = 2.0f * cascade.radius / (float)settings.resolution;
+
+    // Snap the centre to whole texels in a light space whose origin is fixed in the world
+    const simd::float3 light = simd::normalize(settings.lightDirection);
+    const simd::float3 up = light_up(light);
+    const simd::float4x4 lightRotation = matrix_look_at_right_hand(simd::float3{ 0.0f, 0.0f, 0.0f }, -light, up);
+    simd::float4 lightCenter = lightRotation * simd::float4{ sliceCenter.x, sliceCenter.y, sliceCenter.z, 1.0f };
+    lightCenter.x = std::round(lightCenter.x / cascade.texelSize) * cascade.texelSize;
+    lightCenter.y = std::round(lightCenter.y / cascade.texelSize) * cascade.texelSize;
+    const simd::float4 snapped = simd::inverse(lightRotation) * lightCenter;
+    cascade.center = { snapped.x, snapped.y, snapped.z };
+
+    const float back = cascade.radius + settings.casterDistance;
+    const simd::float4x4 view = matrix_look_at_right_hand(cascade.center + light * back, cascade.center, up);
+    const simd::float4x4 projection = matrix_orthographic_right_hand(-cascade.radius, cascade.radius, -cascade.radius,
+                                                                     cascade.radius, 0.0f, back + cascade.radius);
+    cascade.viewProjection = projection * view;
+    return cascade;
+}
+
+uint32_t shadow_cascades_update(ShadowCascades& cascades, const Camera& cam) {
+    const ShadowSettings& settings = cascades.settings;
+    const uint32_t count = std::min(settings.cascadeCount, MAX_SHADOW_CASCADES);
+    float nearZ = 0.0f, farZ = 0.0f;
+    camera_depth_range(cam.projectionMatrix, nearZ, farZ);
+    float splits[MAX_SHADOW_CASCADES];
+    shadow_cascade_splits(nearZ, std::min(farZ, settings.maxDistance), count, settings.splitLambda, splits);
+    cascades.frame++;
+
+    ShadowCascade fits[MAX_SHADOW_CASCADES];
+    uint32_t due[MAX_SHADOW_CASCADES];
+    uint32_t dueCount = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        fits[i] = fit_shadow_cascade(settings, cam, i == 0 ? nearZ : splits[i - 1], splits[i]);
+        const ShadowCascade& current = cascades.cascades[i];
+        const bool covered = current.valid && current.splitFar == fits[i].splitFar &&
+                             simd::length(fits[i].center - current.center) + fits[i].sliceRadius <= current.radius;
+        if (!covered) {
+            due[dueCount++] = i;
+        }
+    }
+
+    // The first cascade is under the camera and goes first; the rest by how long they have waited
+    std::stable_sort(due + (dueCount > 0 && due[0] == 0 ? 1 : 0), due + dueCount, [&](uint32_t a, uint32_t b) {
+        return cascades.cascades[a].drawnFrame < cascades.cascades[b].drawnFrame;
+    });
+
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < std::min(dueCount, settings.maxUpdatesPerFrame); ++i) {
+        ShadowCascade& cascade = cascades.cascades[due[i]];
+        cascade = fits[due[i]];
+        cascade.valid = true;
+        cascade.drawnFrame = cascades.frame;
+        mask |= 1u << due[i];
+    }
+    return mask;
+}
+
+void shadow_cascades_invalidate(ShadowCascades& cascades, const BoundingBox& box) {
+    for (ShadowCascade& cascade : cascades.cascades) {
+        if (!cascade.valid) {
+            continue;
+        }
+        simd::float3 lo = { INFINITY, INFINITY, INFINITY };
+        simd::float3 hi = { -INFINITY, -INFINITY, -INFINITY };
+        for (int i = 0; i < 8; ++i) {
+            simd::float4 corner = { (i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y,
+                                    (i & 4) ? box.max.z : box.min.z, 1.0f };
+            simd::float4 clip = cascade.viewProjection * corner;
+            simd::float3 p = { clip.x, clip.y, clip.z };
+            lo = simd::min(lo, p);
+            hi = simd::max(hi, p);
+        }
+        if (lo.x <= 1.0f && hi.x >= -1.0f && lo.y <= 1.0f && hi.y >= -1.0f && lo.z <= 1.0f && hi.z >= 0.0f) {
+            cascade.valid = false;
+        }
+    }
+}
+
+void shadow_cascades_invalidate_all(ShadowCascades& cascades) {
+    for (ShadowCascade& cascade : cascades.cascades) {
+        cascade.valid = false;
+    }
+}
@@ -0,0 +1,111 @@
+/**
+ * @file shadow_cascades.hpp
+ * @brief Fitting, texel snapping and update scheduling of cascaded shadow maps.
+ *
+ * The camera frustum up to the shadow distance is split into slices, and every slice is
+ * covered by one cascade: an orthographic view along the light around the slice's bounding
+ * sphere. The sphere only depends on the slice, not on where the camera looks, so the
+ * cascade keeps its size as the camera turns, and its centre is snapped to whole shadow map
+ * texels so the map does not shimmer as the camera moves.
+ *
+ * A cascade covers its sphere plus a guard band and is kept until the slice leaves that
+ * coverage or a caster inside it changes. At most a fixed number of cascades are redrawn per
+ * frame; the others keep being sampled with the matrix they were drawn with.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "camera.hpp"
+#include "objects.hpp"
+
+/// Most cascades a shadow map holds.
+constexpr uint32_t MAX_SHADOW_CASCADES = 4;
+
+/**
+ * @struct ShadowSettings
+ * @brief Shadow map layout, coverage and per-frame budget.
+ */
+struct ShadowSettings {
+    uint32_t cascadeCount = 4;          ///< Slices of the view frustum, at most MAX_SHADOW_CASCADES.
+    uint32_t resolution = 2048;         ///< Texels along each edge of a cascade.
+    float maxDistance = 100.0f;         ///< Shadowed view depth; capped by the camera's far plane.
+    float splitLambda = 0.7f;           ///< Blend of logarithmic (1) and uniform (0) split distances.
+    float casterDistance = 60.0f;       ///< Distance towards the light that casters outside a slice are still caught.
+    float guardBand = 0.2f;             ///< Coverage added around each slice, relative to its radius.
+    uint32_t maxUpdatesPerFrame = 2;    ///< Cascades redrawn per frame at most.
+    simd::float3 lightDirection = LIGHT_DIRECTION; ///< Towards the light; the scene is shaded with LIGHT_DIRECTION.
+};
+
+/**
+ * @struct ShadowCascade
+ * @brief The light view of one slice.
+ */
+struct ShadowCascade {
+    simd::float4x4 viewProjection;      ///< World to the cascade's clip space.
+    simd::float3 center;                ///< Centre of the covered sphere.
+    float radius = 0.0f;                ///< Radius of the covered sphere, guard band included.
+    float sliceRadius = 0.0f;           ///< Radius of the slice's own bounding sphere.
+    float splitFar = 0.0f;              ///< View depth where the slice ends.
+    float texelSize = 0.0f;             ///< World size of one shadow map texel.
+    bool valid = false;                 ///< False until drawn, and again once a caster inside changed.
+    uint64_t drawnFrame = 0;            ///< Frame the cascade was last drawn.
+};
+
+/**
+ * @struct ShadowCascades
+ * @brief The cascades as they are in the shadow map.
+ */
+struct ShadowCascades {
+    ShadowSettings settings;                            ///< Layout and budget.
+    ShadowCascade cascades[MAX_SHADOW_CASCADES];        ///< Current contents of each cascade.
+    uint64_t frame = 0;                                 ///< Frames scheduled so far.
+};
+
+/**
+ * @brief Splits a depth range with the practical split scheme.
+ * @param nearZ The view depth where the first slice starts.
+ * @param farZ The view depth where the last slice ends.
+ * @param count The number of slices.
+ * @param lambda 1 for logarithmic splits, 0 for uniform ones.
+ * @param splits Receives the far depth of each slice; splits[count - 1] is farZ.
+ */
+void shadow_cascade_splits(float nearZ, float farZ, uint32_t count, float lambda, float* splits);
+
+/**
+ * @brief Fits a cascade to a slice of the camera frustum.
+ * @param settings The shadow settings.
+ * @param cam The camera.
+ * @param splitNear The view depth where the slice starts.
+ * @param splitFar The view depth where the slice ends.
+ * @return The cascade, not yet drawn.
+ */
+ShadowCascade fit_shadow_cascade(const ShadowSettings& settings, const Camera& cam, float splitNear, float splitFar);
+
+/**
+ * @brief Refits the cascades to the camera and picks the ones to redraw this frame.
+ *
+ * A cascade is due if it is invalid or its slice has left the covered sphere. Due cascades
+ * are taken nearest first for the first cascade, and longest-waiting first after it, up to
+ * maxUpdatesPerFrame; the picked ones take their new fit.
+ *
+ * @param cascades The cascades.
+ * @param cam The camera of this frame.
+ * @return A bit per cascade to redraw.
+ */
+uint32_t shadow_cascades_update(ShadowCascades& cascades, const Camera& cam);
+
+/**
+ * @brief Marks the cascades that cover a box as needing a redraw.
+ * @param cascades The cascades.
+ * @param box World bounds of a caster that appeared, moved or disappeared.
+ */
+void shadow_cascades_invalidate(ShadowCascades& cascades, const BoundingBox& box);
+
+/**
+ * @brief Marks every cascade as needing a redraw.
+ * @param cascades The cascades.
+ */
+void shadow_cascades_invalidate_all(ShadowCascades& cascades);
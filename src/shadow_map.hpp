@@ -0,0 +1,105 @@
+/**
+ * @file shadow_map.hpp
+ * @brief The cascaded shadow map: caster passes and the binding the lit pipelines sample.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "camera.hpp"
+#include "chunk_manager.hpp"
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "frustum.hpp"
+#include "gpu_foliage.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_skinning.hpp"
+#include "mesh_registry.hpp"
+#include "metal_context.hpp"
+#include "shadow_cascades.hpp"
+
+/**
+ * @struct ShadowCaster
+ * @brief What a resident chunk looked like when the cascades last accounted for it.
+ */
+struct ShadowCaster {
+    BoundingBox bounds;         ///< Chunk bounds raised by the height of its foliage.
+    int lodLevel = 0;           ///< LOD level the chunk was drawn with.
+    uint32_t stitchMask = 0;    ///< Stitch mask the chunk was drawn with.
+    uint32_t lastSeen = 0;      ///< Frame the chunk was last resident.
+};
+
+/**
+ * @struct ShadowMap
+ * @brief One Depth32Float slice per cascade and the state deciding when each is redrawn.
+ *
+ * Terrain chunks and foliage are the casters. A cascade is redrawn when its slice leaves the
+ * cascade's coverage or a chunk inside it is published, evicted or changes LOD, at most
+ * ShadowSettings::maxUpdatesPerFrame per frame; the lit pipelines pick a cascade by view depth
+ * and filter it with 3x3 comparison samples.
+ */
+struct ShadowMap {
+    id<MTLRenderPipelineState> landscapePipeline;   ///< shadow_landscape_vertex in the chunks' vertex format.
+    id<MTLRenderPipelineState> heightMapPipeline;   ///< shadow_landscape_heightmap_vertex, for height-map chunks.
+    id<MTLRenderPipelineState> instancedPipeline;   ///< shadow_instanced_vertex.
+    id<MTLDepthStencilState> depthState;            ///< Less, with depth writes.
+    id<MTLTexture> texture;                         ///< 2D array, one slice per cascade.
+    ShadowCascades cascades;                        ///< Settings and the matrix each slice was drawn with.
+    std::unordered_map<ChunkKey, ShadowCaster, ChunkKeyHash> casters; ///< Chunks the cascades account for.
+    CullBounds bounds;                              ///< Resident chunk bounds, rebuilt every frame.
+    std::vector<uint32_t> visible;                  ///< Chunks inside the cascade being drawn.
+    uint32_t frame = 0;                             ///< Frames encoded so far.
+    uint32_t drawnMask = 0;                         ///< Cascades redrawn by the last shadow_map_encode.
+    FrameAllocation uniforms = {};                  ///< ShadowUniforms of this frame, bound by shadow_map_bind.
+};
+
+/// @return True if the depth-only pipelines compiled.
+bool shadow_map_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the shadow map with every slice cleared to the far plane, so undrawn cascades are lit.
+ * @param metal The Metal context; its shadow pipelines must exist.
+ * @param terrainFormat The vertex format of the terrain chunks.
+ * @param settings Cascade layout, coverage and per-frame budget.
+ * @return The shadow map.
+ */
+ShadowMap create_shadow_map(const MetalContext& metal, VertexFormat terrainFormat, const ShadowSettings& settings = {});
+
+/// @return Frame ring bytes shadow_map_encode needs per frame with maxChunks resident chunks.
+size_t shadow_map_frame_bytes(const ShadowSettings& settings, uint32_t maxChunks);
+
+/// @return GPU bytes held by the shadow map texture.
+size_t shadow_map_bytes(const ShadowMap& shadowMap);
+
+/**
+ * @brief Redraws the cascades that are due and writes this frame's ShadowUniforms.
+ *
+ * Must be encoded after gpu_foliage_encode and gpu_skinning_encode, and before the passes that
+ * sample the map. Skinned instances move every frame, so the cascades under them are redrawn
+ * as often as the update budget allows.
+ *
+ * @param shadowMap The shadow map.
+ * @param cmd The frame's command buffer.
+ * @param chunkManager Provides the resident chunks.
+ * @param uniformRing The frame ring that receives the casters' uniforms.
+ * @param cam The camera of this frame.
+ * @param foliage The foliage casting shadows, or null.
+ * @param foliageMesh The mesh foliage parts are drawn with.
+ * @param skinning This frame's posed skinned instances, or null.
+ * @param frameStats Receives the caster draws.
+ * @param profiler Times the cascade passes as GPU_PASS_SHADOWS, or null.
+ */
+void shadow_map_encode(ShadowMap& shadowMap, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                       FrameRing& uniformRing, const Camera& cam, GpuFoliage* foliage, const GpuMesh& foliageMesh,
+                       GpuSkinning* skinning, FrameStats& frameStats, GpuProfiler* profiler);
+
+/**
+ * @brief Binds this frame's shadow map for pipelines compiled with ShaderVariant::shadows.
+ * @param shadowMap The shadow map, after shadow_map_encode.
+ * @param enc The render encoder.
+ */
+void shadow_map_bind(const ShadowMap& shadowMap, id<MTLRenderCommandEncoder> enc);
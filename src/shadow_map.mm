@@ -0,0 +1,260 @@
+#import "shadow_map.hpp"
+
+#include <algorithm>
+
+#include "render_targets.hpp"
+#include "trace.hpp"
+
+namespace {
+    // Matches ShadowUniforms in shaders.metal
+    struct ShadowUniforms {
+        simd::float4x4 viewProjection[MAX_SHADOW_CASCADES];
+        simd::float4 splits;
+        simd::float4 normalOffset;
+        uint32_t cascadeCount;
+        float texelUV;
+    };
+
+    // Trees reach about 4 m above the ground they stand on
+    const float FOLIAGE_CASTER_HEIGHT = 5.0f;
+
+    // Receivers are pushed this many texels along their normal before the lookup
+    const float NORMAL_OFFSET_TEXELS = 1.5f;
+
+    size_t aligned(size_t bytes) {
+        return (bytes + FRAME_RING_ALIGNMENT - 1) & ~(FRAME_RING_ALIGNMENT - 1);
+    }
+
+    // Invalidates the cascades under chunks that appeared, changed LOD or went away since the last frame
+    void track_casters(ShadowMap& shadowMap, const ChunkManager& chunkManager) {
+        const uint32_t frame = shadowMap.frame;
+        cull_bounds_clear(shadowMap.bounds);
+        for (const ResidentChunk& chunk : chunkManager.resident()) {
+            BoundingBox bounds = chunk.bounds;
+            bounds.max.y += FOLIAGE_CASTER_HEIGHT;
+            cull_bounds_add(shadowMap.bounds, bounds);
+
+            auto [it, inserted] = shadowMap.casters.try_emplace(chunk.key);
+            ShadowCaster& caster = it->second;
+            if (inserted || caster.lodLevel != chunk.lodLevel || caster.stitchMask != chunk.stitchMask) {
+                shadow_cascades_invalidate(shadowMap.cascades, bounds);
+                caster.bounds = bounds;
+                caster.lodLevel = chunk.lodLevel;
+                caster.stitchMask = chunk.stitchMask;
+            }
+            caster.lastSeen = frame;
+        }
+
+        for (auto it = shadowMap.casters.begin(); it != shadowMap.casters.end();) {
+            if (it->second.lastSeen == frame) {
+                ++it;
+                continue;
+            }
+            shadow_cascades_invalidate(shadowMap.cascades, it->second.bounds);
+            it = shadowMap.casters.erase(it);
+        }
+    }
+
+    // Skinned instances pose and move every frame, so the cascades under them are never current
+    void invalidate_skinned(ShadowMap& shadowMap, const GpuSkinning& skinning) {
+        const CullBounds& bounds = skinning.bounds;
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            const simd::float3 center = { bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i] };
+            const simd::float3 extent = { bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] };
+            shadow_cascades_invalidate(shadowMap.cascades, { center - extent, center + extent });
+        }
+    }
+
+    void write_uniforms(ShadowMap& shadowMap, FrameRing& uniformRing) {
+        const ShadowCascades& cascades = shadowMap.cascades;
+        shadowMap.uniforms = frame_ring_allocate(uniformRing, sizeof(ShadowUniforms));
+        ShadowUniforms* uniforms = (ShadowUniforms*)shadowMap.uniforms.contents;
+        *uniforms = {};
+        uniforms->cascadeCount = std::min(cascades.settings.cascadeCount, MAX_SHADOW_CASCADES);
+        uniforms->texelUV = 1.0f / (float)cascades.settings.resolution;
+        for (uint32_t i = 0; i < uniforms->cascadeCount; ++i) {
+            // Cascades that missed the budget are sampled with the matrix they were drawn with
+            const ShadowCascade& cascade = cascades.cascades[i];
+            uniforms->viewProjection[i] = cascade.viewProjection;
+            uniforms->splits[i] = cascade.splitFar;
+            uniforms->normalOffset[i] = cascade.texelSize * NORMAL_OFFSET_TEXELS;
+        }
+    }
+
+    void draw_terrain(ShadowMap& shadowMap, id<MTLRenderCommandEncoder> enc, const ChunkManager& chunkManager,
+                      FrameRing& uniformRing, const ShadowCascade& cascade, FrameStats& frameStats) {
+        const std::vector<ResidentChunk>& chunks = chunkManager.resident();
+        shadowMap.visible.resize(shadowMap.bounds.size());
+        const size_t visibleCount =
+            frustum_cull(extract_frustum(cascade.viewProjection), shadowMap.bounds, shadowMap.visible.data());
+
+        if (visibleCount == 0) {
+            return;
+        }
+
+        // One uniform array for the cascade, bound once; each draw picks its entry with its base instance
+        FrameAllocation draws = frame_ring_allocate(uniformRing, visibleCount * sizeof(Uniforms));
+        Uniforms* uniforms = (Uniforms*)draws.contents;
+        const bool heightMaps = chunkManager.config().heightMaps;
+        [enc setRenderPipelineState:heightMaps ? shadowMap.heightMapPipeline : shadowMap.landscapePipeline];
+        [enc setVertexBuffer:draws.buffer offset:draws.offset atIndex:1];
+        for (size_t v = 0; v < visibleCount; ++v) {
+            const ResidentChunk& chunk = chunks[shadowMap.visible[v]];
+            const ChunkDraw geometry = chunkManager.chunk_draw(chunk);
+            const IndexRange& range = geometry.range;
+
+            // Depth only: the normal matrix and colour are not read
+            uniforms[v].modelMatrix = geometry.modelMatrix;
+
+            if (heightMaps) {
+                [enc setVertexTexture:chunk.heightMap atIndex:0];
+            } else {
+                [enc setVertexBuffer:geometry.vertexBuffer offset:0 atIndex:0];
+            }
+            [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                            indexCount:range.count
+                             indexType:geometry.indexType
+                           indexBuffer:geometry.indexBuffer
+                     indexBufferOffset:range.offset * metal_index_size(geometry.indexType)
+                         instanceCount:1
+                            baseVertex:0
+                          baseInstance:v];
+            frame_stats_count_draw(frameStats, range.count);
+        }
+    }
+
+    void draw_foliage(const ShadowMap& shadowMap, id<MTLRenderCommandEncoder> enc, const GpuFoliage& foliage,
+                      const GpuMesh& mesh, FrameStats& frameStats) {
+        [enc setRenderPipelineState:shadowMap.instancedPipeline];
+        [enc setVertexBuffer:mesh.vertexBuffer offset:0 atIndex:0];
+        [enc setVertexBuffer:foliage.shadowInstances offset:0 atIndex:2];
+        [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                         indexType:mesh.indexType
+                       indexBuffer:mesh.indexBuffer
+                 indexBufferOffset:gpu_mesh_index_offset(mesh)
+                    indirectBuffer:foliage.shadowDraw.buffer
+              indirectBufferOffset:foliage.shadowDraw.offset];
+        // The instance count stays on the GPU
+        frame_stats_count_draw(frameStats, mesh.indexCount, 0);
+    }
+}
+
+bool shadow_map_supported(const MetalContext& metal) {
+    return metal.shadow_landscape_pipeline && metal.shadow_landscape_packed_pipeline &&
+           metal.shadow_landscape_heightmap_pipeline && metal.shadow_instanced_pipeline;
+}
+
+ShadowMap create_shadow_map(const MetalContext& metal, VertexFormat terrainFormat, const ShadowSettings& settings) {
+    ShadowMap shadowMap;
+    shadowMap.landscapePipeline = terrainFormat == VertexFormat::Packed ? metal.shadow_landscape_packed_pipeline
+                                                                        : metal.shadow_landscape_pipeline;
+    shadowMap.heightMapPipeline = metal.shadow_landscape_heightmap_pipeline;
+    shadowMap.instancedPipeline = metal.shadow_instanced_pipeline;
+    shadowMap.cascades.settings = settings;
+    shadowMap.cascades.settings.cascadeCount = std::clamp(settings.cascadeCount, 1u, MAX_SHADOW_CASCADES);
+
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = MTLCompareFunctionLess;
+    depthDesc.depthWriteEnabled = YES;
+    shadowMap.depthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatDepth32Float
+                                                                                    width:settings.resolution
+                                                                                   height:settings.resolution
+                                                                                mipmapped:NO];
+    desc.textureType = MTLTextureType2DArray;
+    desc.arrayLength = shadowMap.cascades.settings.cascadeCount;
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+    shadowMap.texture = [metal.device newTextureWithDescriptor:desc];
+    shadowMap.texture.label = @"Shadow cascades";
+
+    // The queue orders these clears before any frame samples the map
+    id<MTLCommandBuffer> cmd = [metal.queue commandBuffer];
+    for (NSUInteger slice = 0; slice < desc.arrayLength; ++slice) {
+        MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+        passDesc.depthAttachment.texture = shadowMap.texture;
+        passDesc.depthAttachment.slice = slice;
+        passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+        passDesc.depthAttachment.storeAction = MTLStoreActionStore;
+        passDesc.depthAttachment.clearDepth = 1.0;
+        [[cmd renderCommandEncoderWithDescriptor:passDesc] endEncoding];
+    }
+    [cmd commit];
+    return shadowMap;
+}
+
+size_t shadow_map_frame_bytes(const ShadowSettings& settings, uint32_t maxChunks) {
+    // Every redrawn cascade takes its frame uniforms and a uniform array entry per chunk
+    const size_t perCascade = aligned(sizeof(FrameUniforms)) + aligned(sizeof(Uniforms) * maxChunks) +
+                              gpu_foliage_frame_bytes();
+    return aligned(sizeof(ShadowUniforms)) + perCascade * std::min(settings.maxUpdatesPerFrame, MAX_SHADOW_CASCADES);
+}
+
+size_t shadow_map_bytes(const ShadowMap& shadowMap) {
+    return shadowMap.texture.allocatedSize;
+}
+
+void shadow_map_encode(ShadowMap& shadowMap, id<MTLCommandBuffer> cmd, const ChunkManager& chunkManager,
+                       FrameRing& uniformRing, const Camera& cam, GpuFoliage* foliage, const GpuMesh& foliageMesh,
+                       GpuSkinning* skinning, FrameStats& frameStats, GpuProfiler* profiler) {
+    TRACE_SCOPE("Encode shadow cascades");
+    ++shadowMap.frame;
+    track_casters(shadowMap, chunkManager);
+    if (skinning) {
+        invalidate_skinned(shadowMap, *skinning);
+    }
+    shadowMap.drawnMask = shadow_cascades_update(shadowMap.cascades, cam);
+    write_uniforms(shadowMap, uniformRing);
+
+    const ShadowSettings& settings = shadowMap.cascades.settings;
+    for (uint32_t i = 0; i < settings.cascadeCount; ++i) {
+        if (!(shadowMap.drawnMask & (1u << i))) {
+            continue;
+        }
+        const ShadowCascade& cascade = shadowMap.cascades.cascades[i];
+        if (foliage) {
+            gpu_foliage_encode_shadow(*foliage, cmd, uniformRing, extract_frustum(cascade.viewProjection),
+                                      cascade.center, cascade.radius + settings.casterDistance, foliageMesh);
+        }
+
+        MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+        passDesc.depthAttachment.texture = shadowMap.texture;
+        passDesc.depthAttachment.slice = i;
+        passDesc.depthAttachment.loadAction = MTLLoadActionClear;
+        passDesc.depthAttachment.storeAction = MTLStoreActionStore;
+        passDesc.depthAttachment.clearDepth = 1.0;
+        frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "Shadow cascade"));
+        gpu_profiler_sample_pass(profiler, passDesc, GPU_PASS_SHADOWS);
+
+        id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+        enc.label = [NSString stringWithFormat:@"Shadow cascade %u", i];
+        [enc setDepthStencilState:shadowMap.depthState];
+        // Casters between the light and the near plane still block it
+        [enc setDepthClipMode:MTLDepthClipModeClamp];
+        [enc setDepthBias:1.0f slopeScale:2.0f clamp:0.01f];
+
+        // The cascade stands in for the camera: its view-projection is the pass's
+        FrameAllocation frame = frame_ring_allocate(uniformRing, sizeof(FrameUniforms));
+        FrameUniforms* frameUniforms = (FrameUniforms*)frame.contents;
+        frameUniforms->viewProjection = cascade.viewProjection;
+        frameUniforms->cameraPosition = cascade.center;
+        frameUniforms->lightDirection = settings.lightDirection;
+        [enc setVertexBuffer:frame.buffer offset:frame.offset atIndex:FRAME_UNIFORMS_BUFFER_INDEX];
+
+        draw_terrain(shadowMap, enc, chunkManager, uniformRing, cascade, frameStats);
+        if (foliage) {
+            draw_foliage(shadowMap, enc, *foliage, foliageMesh, frameStats);
+        }
+        if (skinning) {
+            [enc setRenderPipelineState:shadowMap.instancedPipeline];
+            gpu_skinning_draw(*skinning, enc, extract_frustum(cascade.viewProjection), frameStats);
+        }
+        [enc endEncoding];
+    }
+}
+
+void shadow_map_bind(const ShadowMap& shadowMap, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentBuffer:shadowMap.uniforms.buffer offset:shadowMap.uniforms.offset atIndex:3];
+    [enc setFragmentTexture:shadowMap.texture atIndex:0];
+}
@@ -0,0 +1,161 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef __APPLE__
+#include <pthread.h>
+#include <sys/qos.h>
+#endif
+
+namespace {
+    SimulationSnapshot make_first_snapshot(const Camera& camera) {
+        SimulationSnapshot snapshot;
+        snapshot.time = simulation_clock();
+        snapshot.previous = camera_pose(camera);
+        snapshot.current = snapshot.previous;
+        return snapshot;
+    }
+}
+
+double simulation_clock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t fixed_step_advance(FixedStepClock& clock, const SimulationSettings& settings, double now) {
+    if (clock.lastTime < 0.0) {
+        clock.lastTime = now;
+        return 0;
+    }
+    clock.accumulator += std::max(now - clock.lastTime, 0.0);
+    clock.lastTime = now;
+
+    auto steps = (uint32_t)std::min(std::floor(clock.accumulator / settings.step), (double)settings.maxCatchUpSteps);
+    clock.accumulator -= steps * settings.step;
+    if (steps == settings.maxCatchUpSteps) {
+        clock.accumulator = std::fmod(clock.accumulator, settings.step);
+    }
+    return steps;
+}
+
+CameraPose camera_pose(const Camera& cam) {
+    CameraPose pose;
+    pose.position = cam.position;
+    pose.yaw = cam.yaw;
+    pose.pitch = cam.pitch;
+    return pose;
+}
+
+void set_camera_pose(Camera& cam, const CameraPose& pose) {
+    cam.position = pose.position;
+    cam.yaw = pose.yaw;
+    cam.pitch = pose.pitch;
+    update_camera_view(cam);
+}
+
+CameraPose interpolate_pose(const CameraPose& from, const CameraPose& to, float t) {
+    // Yaw is never wrapped by update_camera, so a plain lerp takes the short way round
+    CameraPose pose;
+    pose.position = from.position + (to.position - from.position) * t;
+    pose.yaw = from.yaw + (to.yaw - from.yaw) * t;
+    pose.pitch = from.pitch + (to.pitch - from.pitch) * t;
+    return pose;
+}
+
+float snapshot_alpha(const SimulationSnapshot& snapshot, const SimulationSettings& settings, double now) {
+    // previous is the state at time - step and current the state at time; render at now - step
+    return (float)std::clamp((now - snapshot.time) / settings.step, 0.0, 1.0);
+}
+
+CameraPose sample_snapshot(const SimulationSnapshot& snapshot, const SimulationSettings& settings, double now) {
+    return interpolate_pose(snapshot.previous, snapshot.current, snapshot_alpha(snapshot, settings, now));
+}
+
+Simulation::Simulation(const Camera& camera, InputQueue& input, StepFunction step, const SimulationSettings& settings,
+                       std::vector<RecordedInput>* recording)
+    : m_settings(settings),
+      m_step(std::move(step)),
+      m_camera(camera),
+      m_queue(input),
+      m_recording(recording),
+      m_snapshots(make_first_snapshot(camera)),
+      m_thread(&Simulation::thread_main, this) {
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::stop() {
+    m_stopping = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+const SimulationSnapshot& Simulation::latest() {
+    m_snapshots.update();
+    return m_snapshots.read();
+}
+
+void Simulation::thread_main() {
+#ifdef __APPLE__
+    pthread_setname_np("Simulation");
+    // Input-to-photon latency runs through this thread, so it gets the render thread's QoS
+    pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+    FixedStepClock clock;
+    fixed_step_advance(clock, m_settings, simulation_clock());
+    SimulationSnapshot snapshot;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        const double now = simulation_clock();
+        uint32_t steps = fixed_step_advance(clock, m_settings, now);
+        if (steps > 0) {
+            // The end of the last whole step, which is what the render thread interpolates from
+            snapshot.time = now - clock.accumulator;
+            for (uint32_t i = 0; i < steps; ++i) {
+                m_drained.clear();
+                drain_input(m_queue, m_input, snapshot.time - (steps - 1 - i) * m_settings.step,
+                            m_recording ? &m_drained : nullptr);
+                for (const InputEvent& event : m_drained) {
+                    m_recording->push_back({ snapshot.tick, event });
+                }
+                snapshot.previous = camera_pose(m_camera);
+                m_step(m_camera, m_input, (float)m_settings.step);
+                snapshot.current = camera_pose(m_camera);
+                clear_input_deltas(m_input);
+                ++snapshot.tick;
+            }
+            m_snapshots.write(snapshot);
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(m_settings.step - clock.accumulator));
+    }
+}
+
+SimulationReplay create_simulation_replay(const Camera& camera) {
+    SimulationReplay replay;
+    replay.camera = camera;
+    replay.previous = camera_pose(camera);
+    return replay;
+}
+
+CameraPose simulation_replay_frame(SimulationReplay& replay, const InputRecording& recording,
+                                   const RecordedFrame& frame, const Simulation::StepFunction& step) {
+    while (replay.tick < frame.tick) {
+        for (; replay.nextInput < recording.inputs.size() && recording.inputs[replay.nextInput].tick <= replay.tick;
+             ++replay.nextInput) {
+            apply_input_event(replay.input, recording.inputs[replay.nextInput].event);
+        }
+        replay.previous = camera_pose(replay.camera);
+        step(replay.camera, replay.input, (float)recording.step);
+        clear_input_deltas(replay.input);
+        ++replay.tick;
+    }
+    // Before the first step both poses are the starting one, as in the first snapshot
+    const CameraPose current = camera_pose(replay.camera);
+    const CameraPose previous = replay.tick == 0 ? current : replay.previous;
+    return interpolate_pose(previous, current, frame.alpha);
+}
@@ -0,0 +1,205 @@
+/**
+ * @file simulation.hpp
+ * @brief Fixed-timestep simulation thread publishing camera snapshots to the renderer.
+ *
+ * The simulation advances in steps of exactly SimulationSettings::step seconds, however
+ * long frames take, so a slow frame changes when the results are seen but never the
+ * results themselves. Each step publishes a snapshot holding the pose before and after
+ * it; the render thread draws one step in the past and interpolates between the two,
+ * which keeps motion smooth when the display and simulation rates differ.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "camera.hpp"
+#include "input.hpp"
+#include "input_recording.hpp"
+#include "triple_buffer.hpp"
+
+/**
+ * @struct SimulationSettings
+ * @brief Timing of the simulation thread.
+ */
+struct SimulationSettings {
+    double step = 1.0 / 120.0;      ///< Seconds simulated per step.
+    uint32_t maxCatchUpSteps = 8;   ///< Most steps run back to back after a stall; older time is dropped.
+};
+
+/**
+ * @struct CameraPose
+ * @brief The part of a camera the simulation owns.
+ */
+struct CameraPose {
+    simd::float3 position;      ///< The camera position in world space.
+    float yaw = 0.0f;           ///< The yaw in radians.
+    float pitch = 0.0f;         ///< The pitch in radians.
+};
+
+/**
+ * @struct SimulationSnapshot
+ * @brief Immutable simulation state after a step.
+ */
+struct SimulationSnapshot {
+    uint64_t tick = 0;          ///< Steps run so far.
+    double time = 0.0;          ///< Clock time at which the step ended, in seconds.
+    CameraPose previous;        ///< The camera before the step.
+    CameraPose current;         ///< The camera after the step.
+};
+
+/**
+ * @struct FixedStepClock
+ * @brief Wall-clock time not yet simulated.
+ */
+struct FixedStepClock {
+    double lastTime = -1.0;     ///< The time passed to the previous advance, or negative before the first.
+    double accumulator = 0.0;   ///< Seconds waiting for a full step.
+};
+
+/// @return Seconds on the steady clock, the time base of simulation snapshots.
+double simulation_clock();
+
+/**
+ * @brief Moves the clock to a new time and returns the number of steps that became due.
+ *
+ * The first call only starts the clock. When more than maxCatchUpSteps are due, the
+ * rest of the backlog is dropped so a long stall does not freeze the thread catching up.
+ *
+ * @param clock The clock state.
+ * @param settings The step length and catch-up limit.
+ * @param now The current time in seconds.
+ * @return The number of steps to run now.
+ */
+uint32_t fixed_step_advance(FixedStepClock& clock, const SimulationSettings& settings, double now);
+
+/// @return The pose of a camera.
+CameraPose camera_pose(const Camera& cam);
+
+/**
+ * @brief Moves a camera to a pose and rebuilds its view matrix.
+ * @param cam The camera to update; its projection is kept.
+ * @param pose The pose to apply.
+ */
+void set_camera_pose(Camera& cam, const CameraPose& pose);
+
+/**
+ * @brief Blends two poses.
+ * @param from The pose at t = 0.
+ * @param to The pose at t = 1.
+ * @param t The blend factor.
+ * @return The interpolated pose.
+ */
+CameraPose interpolate_pose(const CameraPose& from, const CameraPose& to, float t);
+
+/**
+ * @brief Returns how far between a snapshot's two poses the render time lies.
+ * @param snapshot The latest snapshot.
+ * @param settings The step length.
+ * @param now The render time in seconds.
+ * @return 0 at snapshot.previous, 1 at snapshot.current.
+ */
+float snapshot_alpha(const SimulationSnapshot& snapshot, const SimulationSettings& settings, double now);
+
+/**
+ * @brief Returns the pose to render at a time, one step behind the simulation.
+ * @param snapshot The latest snapshot.
+ * @param settings The step length.
+ * @param now The render time in seconds.
+ * @return The pose between snapshot.previous and snapshot.current matching now - step.
+ */
+CameraPose sample_snapshot(const SimulationSnapshot& snapshot, const SimulationSettings& settings, double now);
+
+/**
+ * @class Simulation
+ * @brief Runs fixed steps on its own thread.
+ *
+ * Input events come in through an InputQueue and snapshots go out through a triple
+ * buffer, so the thread never waits for the main or render thread. Before each step it
+ * applies the events timestamped up to the end of that step, so a batch of catch-up
+ * steps sees input in the order and at the rate it arrived. The simulation's camera
+ * belongs to the thread; the step function runs there and must only read state that
+ * the render thread does not modify.
+ */
+class Simulation {
+public:
+    /// Advances the camera by one step of dt seconds; input holds the mouse motion of that step.
+    typedef std::function<void(Camera& cam, const InputState& input, float dt)> StepFunction;
+
+    /**
+     * @param camera The starting camera.
+     * @param input The queue to drain; the simulation thread is its only consumer.
+     * @param step The function run for every step.
+     * @param settings The step length and catch-up limit.
+     * @param recording If not null, receives every input event with the step it was applied before. It
+     *        belongs to the simulation thread until stop().
+     */
+    Simulation(const Camera& camera, InputQueue& input, StepFunction step, const SimulationSettings& settings = {},
+               std::vector<RecordedInput>* recording = nullptr);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    /// @return The most recent snapshot. Call from the render thread only.
+    const SimulationSnapshot& latest();
+
+    /// @return The settings the thread runs with.
+    const SimulationSettings& settings() const { return m_settings; }
+
+    /// @brief Stops the thread after its current step; latest() keeps the last snapshot.
+    void stop();
+
+private:
+    void thread_main();
+
+    const SimulationSettings m_settings;
+    StepFunction m_step;
+    Camera m_camera;                                ///< Owned by the simulation thread.
+    InputQueue& m_queue;
+    InputState m_input;                             ///< Owned by the simulation thread.
+    std::vector<RecordedInput>* m_recording;        ///< Owned by the simulation thread until stop().
+    std::vector<InputEvent> m_drained;              ///< Scratch for the events of one step, when recording.
+
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;                           ///< Last, so it starts after every other member.
+};
+
+/**
+ * @struct SimulationReplay
+ * @brief Recorded steps run again on the calling thread, in lockstep with the recorded frames.
+ */
+struct SimulationReplay {
+    Camera camera;          ///< The camera after tick steps.
+    InputState input;       ///< Input as the next step sees it.
+    CameraPose previous;    ///< The camera before the last step.
+    uint64_t tick = 0;      ///< Steps run.
+    size_t nextInput = 0;   ///< First recorded input not applied yet.
+};
+
+/// @return A replay starting from a camera, which must be the one the recorded session started with.
+SimulationReplay create_simulation_replay(const Camera& camera);
+
+/**
+ * @brief Runs the steps a recorded frame had seen and returns the pose that frame drew.
+ *
+ * Before each step the inputs recorded for it are applied, exactly as the simulation thread
+ * applied them, so the camera follows the recorded path however long the replayed frames
+ * take. Steps run until the replay has run frame.tick of them; the pose is then blended
+ * by frame.alpha as sample_snapshot() blended it.
+ *
+ * @param replay The replay.
+ * @param recording The recorded session.
+ * @param frame The frame, one of recording.frames, taken in order.
+ * @param step The function the recorded session stepped with.
+ * @return The camera pose of the frame.
+ */
+CameraPose simulation_replay_frame(SimulationReplay& replay, const InputRecording& recording,
+                                   const RecordedFrame& frame, const Simulation::StepFunction& step);
@@ -0,0 +1,87 @@
+/**
+ * @file sky.hpp
+ * @brief The physically based sky: atmosphere lookup tables filled by compute kernels, and the sky pass.
+ *
+ * create_sky() allocates the three lookup tables of atmosphere.hpp. sky_update() fills the
+ * transmittance and multiple scattering tables the first time it runs and the sky view table
+ * whenever the sun has moved since, so a frame with a still sun dispatches nothing. The scene
+ * pass then draws the sky as one full-screen triangle behind its surfaces, one lookup per pixel,
+ * and ShaderVariant::skyFog pipelines fade distant surfaces into the same lookup instead of a
+ * flat colour, so the terrain dissolves into the sky behind it.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "atmosphere.hpp"
+#include "camera.hpp"
+#include "frame_stats.hpp"
+#include "metal_context.hpp"
+
+/**
+ * @struct Sky
+ * @brief The atmosphere lookup tables and the state of the sky pass.
+ */
+struct Sky {
+    id<MTLComputePipelineState> transmittancePipeline;      ///< atmosphere_transmittance_lut.
+    id<MTLComputePipelineState> multiScatteringPipeline;    ///< atmosphere_multiscattering_lut.
+    id<MTLComputePipelineState> skyViewPipeline;            ///< atmosphere_sky_view_lut.
+    id<MTLTexture> transmittance;       ///< RGBA16Float, ATMOSPHERE_TRANSMITTANCE_WIDTH x HEIGHT.
+    id<MTLTexture> multiScattering;     ///< RGBA16Float, ATMOSPHERE_MULTISCATTERING_SIZE squared.
+    id<MTLTexture> skyView;             ///< RGBA16Float exposed radiance, ATMOSPHERE_SKY_VIEW_WIDTH x HEIGHT.
+    id<MTLDepthStencilState> depthState; ///< Passes only where the depth is still the clear value, without writes.
+    AtmosphereParams params;            ///< The atmosphere; sunDirection is the sun the sky view holds.
+    bool tablesValid = false;           ///< True once transmittance and multiple scattering are filled.
+    bool skyViewValid = false;          ///< True once the sky view is filled for params.sunDirection.
+    uint32_t skyViewUpdates = 0;        ///< Times the sky view was filled, for the overlay.
+};
+
+/// @return True if the atmosphere kernels and the sky pipeline compiled.
+bool sky_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the lookup tables, all of them unfilled.
+ * @param metal The Metal context; its atmosphere pipelines must exist.
+ * @return The sky.
+ */
+Sky create_sky(const MetalContext& metal);
+
+/// @return GPU bytes held by the lookup tables.
+size_t sky_bytes(const Sky& sky);
+
+/// @brief Marks every table for refilling, e.g. after the kernels were reloaded.
+void sky_invalidate(Sky& sky);
+
+/**
+ * @brief Fills the tables that are missing or that the sun has made stale.
+ *
+ * Must be encoded before the render pass that samples the sky view.
+ *
+ * @param sky The sky.
+ * @param cmd The frame's command buffer.
+ * @param sun Towards the sun, unit length.
+ * @return True if anything was dispatched.
+ */
+bool sky_update(Sky& sky, id<MTLCommandBuffer> cmd, simd::float3 sun);
+
+/// @brief Binds the sky view for the ShaderVariant::skyFog fragments.
+void sky_bind(const Sky& sky, id<MTLRenderCommandEncoder> enc);
+
+/**
+ * @brief Draws the sky into every pixel of the scene pass that no surface covered.
+ *
+ * The pass's depth must have been cleared to camera_clear_depth(); the draw may come before or
+ * after the surfaces, and in the deferred pass before or after the lighting.
+ *
+ * @param sky The sky; sky_update() must have run this frame.
+ * @param enc The scene pass encoder, with the frame uniforms bound.
+ * @param pipeline metal_sky_pipeline() for the pass's sample count and kind.
+ * @param cam The camera of the pass.
+ * @param frameStats Receives the draw.
+ */
+void sky_encode(const Sky& sky, id<MTLRenderCommandEncoder> enc, id<MTLRenderPipelineState> pipeline,
+                const Camera& cam, FrameStats& frameStats);
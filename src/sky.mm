@@ -0,0 +1,118 @@
+#import "sky.hpp"
+
+#include "trace.hpp"
+
+namespace {
+    // Matches DeferredUniforms in shaders.metal, which the sky shares the full-screen triangle of
+    struct SkyUniforms {
+        simd::float4x4 inverseViewProjection;
+        float farDepth;
+    };
+
+    id<MTLTexture> create_table(id<MTLDevice> device, uint32_t width, uint32_t height, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatRGBA16Float
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = MTLTextureUsageShaderRead | MTLTextureUsageShaderWrite;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+
+    void dispatch(id<MTLComputeCommandEncoder> enc, id<MTLTexture> target) {
+        [enc dispatchThreads:MTLSizeMake(target.width, target.height, 1) threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+    }
+}
+
+bool sky_supported(const MetalContext& metal) {
+    return metal.atmosphere_transmittance_pipeline && metal.atmosphere_multiscattering_pipeline &&
+           metal.atmosphere_sky_view_pipeline && metal.sky_pipeline;
+}
+
+Sky create_sky(const MetalContext& metal) {
+    Sky sky;
+    sky.transmittancePipeline = metal.atmosphere_transmittance_pipeline;
+    sky.multiScatteringPipeline = metal.atmosphere_multiscattering_pipeline;
+    sky.skyViewPipeline = metal.atmosphere_sky_view_pipeline;
+    sky.transmittance = create_table(metal.device, ATMOSPHERE_TRANSMITTANCE_WIDTH, ATMOSPHERE_TRANSMITTANCE_HEIGHT,
+                                     @"Atmosphere transmittance");
+    sky.multiScattering = create_table(metal.device, ATMOSPHERE_MULTISCATTERING_SIZE, ATMOSPHERE_MULTISCATTERING_SIZE,
+                                       @"Atmosphere multiple scattering");
+    sky.skyView = create_table(metal.device, ATMOSPHERE_SKY_VIEW_WIDTH, ATMOSPHERE_SKY_VIEW_HEIGHT, @"Sky view");
+
+    // The triangle lies exactly at the clear depth, so Equal keeps it out of every covered pixel
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = MTLCompareFunctionEqual;
+    depthDesc.depthWriteEnabled = NO;
+    sky.depthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+    return sky;
+}
+
+size_t sky_bytes(const Sky& sky) {
+    return sky.transmittance.allocatedSize + sky.multiScattering.allocatedSize + sky.skyView.allocatedSize;
+}
+
+void sky_invalidate(Sky& sky) {
+    sky.tablesValid = false;
+    sky.skyViewValid = false;
+}
+
+bool sky_update(Sky& sky, id<MTLCommandBuffer> cmd, simd::float3 sun) {
+    const bool sunMoved = !sky.skyViewValid || atmosphere_sun_moved(sky.params.sunDirection, sun);
+    if (sky.tablesValid && !sunMoved) {
+        return false;
+    }
+    sky.params.sunDirection = sun;
+
+    // Dispatches of one encoder run in order, so each table is complete before the next reads it
+    id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+    enc.label = @"Atmosphere";
+    [enc setBytes:&sky.params length:sizeof(sky.params) atIndex:0];
+    if (!sky.tablesValid) {
+        TRACE_PUSH_GROUP(enc, "Transmittance and multiple scattering");
+        [enc setComputePipelineState:sky.transmittancePipeline];
+        [enc setTexture:sky.transmittance atIndex:0];
+        dispatch(enc, sky.transmittance);
+        [enc setComputePipelineState:sky.multiScatteringPipeline];
+        [enc setTexture:sky.multiScattering atIndex:1];
+        dispatch(enc, sky.multiScattering);
+        TRACE_POP_GROUP(enc);
+        sky.tablesValid = true;
+    }
+    TRACE_PUSH_GROUP(enc, "Sky view");
+    [enc setComputePipelineState:sky.skyViewPipeline];
+    [enc setTexture:sky.transmittance atIndex:0];
+    [enc setTexture:sky.multiScattering atIndex:1];
+    [enc setTexture:sky.skyView atIndex:2];
+    dispatch(enc, sky.skyView);
+    TRACE_POP_GROUP(enc);
+    [enc endEncoding];
+    sky.skyViewValid = true;
+    ++sky.skyViewUpdates;
+    return true;
+}
+
+void sky_bind(const Sky& sky, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:sky.skyView atIndex:4];
+}
+
+void sky_encode(const Sky& sky, id<MTLRenderCommandEncoder> enc, id<MTLRenderPipelineState> pipeline,
+                const Camera& cam, FrameStats& frameStats) {
+    SkyUniforms uniforms;
+    uniforms.inverseViewProjection = simd::inverse(cam.projectionMatrix * cam.viewMatrix);
+    uniforms.farDepth = camera_clear_depth(cam);
+
+    TRACE_PUSH_GROUP(enc, "Sky");
+    [enc setRenderPipelineState:pipeline];
+    [enc setDepthStencilState:sky.depthState];
+    [enc setVertexBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+    [enc setFragmentBytes:&uniforms length:sizeof(uniforms) atIndex:0];
+    [enc setFragmentBytes:&sky.params length:sizeof(sky.params) atIndex:1];
+    [enc setFragmentTexture:sky.skyView atIndex:4];
+    [enc setFragmentTexture:sky.transmittance atIndex:5];
+    [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+    TRACE_POP_GROUP(enc);
+    frame_stats_count_draw(frameStats, 3);
+}
@@ -0,0 +1,54 @@
+#include "slot_allocator.hpp"
+
+#include <algorithm>
+
+SlotAllocator::SlotAllocator(uint32_t slotsPerPage) : m_slotsPerPage(std::max(slotsPerPage, 1u)) {}
+
+uint32_t SlotAllocator::allocate() {
+    if (m_free.empty()) {
+        const uint32_t first = page_count() * m_slotsPerPage;
+        for (uint32_t i = 0; i < m_slotsPerPage; ++i) {
+            m_free.insert(m_free.end(), first + i);
+        }
+        m_pageUse.push_back(0);
+    }
+    const uint32_t slot = *m_free.begin();
+    m_free.erase(m_free.begin());
+    m_pageUse[slot / m_slotsPerPage]++;
+    m_used++;
+    return slot;
+}
+
+void SlotAllocator::release(uint32_t slot) {
+    m_free.insert(slot);
+    m_pageUse[slot / m_slotsPerPage]--;
+    m_used--;
+}
+
+void SlotAllocator::retire(uint32_t slot, uint64_t frame) {
+    m_retired.push_back({ slot, frame });
+}
+
+uint32_t SlotAllocator::reclaim(uint64_t completedFrame) {
+    uint32_t freed = 0;
+    while (!m_retired.empty() && m_retired.front().frame <= completedFrame) {
+        release(m_retired.front().slot);
+        m_retired.pop_front();
+        freed++;
+    }
+    return freed;
+}
+
+uint32_t SlotAllocator::trim(uint32_t spare) {
+    uint32_t empty = 0;
+    while (empty < page_count() && m_pageUse[page_count() - 1 - empty] == 0) {
+        empty++;
+    }
+    const uint32_t dropped = empty > spare ? empty - spare : 0;
+    if (dropped > 0) {
+        const uint32_t kept = page_count() - dropped;
+        m_free.erase(m_free.lower_bound(kept * m_slotsPerPage), m_free.end());
+        m_pageUse.resize(kept);
+    }
+    return dropped;
+}
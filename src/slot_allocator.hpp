@@ -0,0 +1,87 @@
+/**
+ * @file slot_allocator.hpp
+ * @brief Hands out equal-sized slots grouped into pages, for sub-allocating GPU heaps.
+ *
+ * Every streamed terrain chunk needs a vertex buffer of the same size, so a heap divided
+ * into equal slots never fragments into holes too small to use. What it can do is spread
+ * a few live slots over many mostly empty pages. Handing out the lowest free slot first
+ * packs live slots into the first pages, so churn empties the last ones, and trim() gives
+ * those back. A released slot may still be read by frames the GPU has not finished, so
+ * retire() holds it back until reclaim() is told those frames have completed.
+ */
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <vector>
+
+/// A slot index that names no slot.
+constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+/**
+ * @class SlotAllocator
+ * @brief Lowest-first allocation of slot indices; slot / slots_per_page() is the page.
+ */
+class SlotAllocator {
+public:
+    /// @param slotsPerPage Slots added by each new page; at least 1.
+    explicit SlotAllocator(uint32_t slotsPerPage);
+
+    /**
+     * @brief Takes the lowest free slot, adding a page if every page is full.
+     * @return The slot.
+     */
+    uint32_t allocate();
+
+    /// @brief Frees a slot at once; only for slots the GPU never used.
+    void release(uint32_t slot);
+
+    /**
+     * @brief Frees a slot once the frame it was last used in has completed.
+     * @param slot The slot.
+     * @param frame The serial of the last frame that may use it.
+     */
+    void retire(uint32_t slot, uint64_t frame);
+
+    /**
+     * @brief Frees the retired slots whose frames have completed.
+     * @param completedFrame Every frame up to this serial has completed on the GPU.
+     * @return The number of slots freed.
+     */
+    uint32_t reclaim(uint64_t completedFrame);
+
+    /**
+     * @brief Drops empty pages from the end.
+     * @param spare Empty pages to keep, so the next allocations do not add them back.
+     * @return The number of pages dropped.
+     */
+    uint32_t trim(uint32_t spare = 0);
+
+    /// @return Slots per page.
+    uint32_t slots_per_page() const { return m_slotsPerPage; }
+
+    /// @return Pages currently allocated.
+    uint32_t page_count() const { return (uint32_t)m_pageUse.size(); }
+
+    /// @return Live slots in a page.
+    uint32_t page_use(uint32_t page) const { return m_pageUse[page]; }
+
+    /// @return Slots allocated and not yet freed, retired ones included.
+    uint32_t used() const { return m_used; }
+
+    /// @return Retired slots waiting for their frames.
+    uint32_t retired() const { return (uint32_t)m_retired.size(); }
+
+private:
+    struct Retired {
+        uint32_t slot;
+        uint64_t frame;
+    };
+
+    uint32_t m_slotsPerPage;
+    std::vector<uint32_t> m_pageUse;    ///< Live and retired slots per page.
+    std::set<uint32_t> m_free;          ///< Free slots of the allocated pages, lowest first.
+    std::deque<Retired> m_retired;      ///< In retire() order, so frames never decrease.
+    uint32_t m_used = 0;
+};
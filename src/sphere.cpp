@@ -0,0 +1,42 @@
+#include "sphere.hpp"
+
+#include <cmath>
+
+MeshData create_sphere() {
+    MeshData sphere;
+    for (uint32_t ring = 0; ring <= SPHERE_RINGS; ++ring) {
+        const float polar = (float)M_PI * ring / SPHERE_RINGS;
+        for (uint32_t segment = 0; segment <= SPHERE_SEGMENTS; ++segment) {
+            const float azimuth = 2.0f * (float)M_PI * segment / SPHERE_SEGMENTS;
+            const simd::float3 normal = { sinf(polar) * cosf(azimuth), cosf(polar), -sinf(polar) * sinf(azimuth) };
+            sphere.vertices.push_back({ normal * 0.5f, normal });
+        }
+    }
+
+    // Counter-clockwise seen from outside, like the cube's faces
+    std::vector<uint32_t> indices;
+    const uint32_t stride = SPHERE_SEGMENTS + 1;
+    for (uint32_t ring = 0; ring < SPHERE_RINGS; ++ring) {
+        for (uint32_t segment = 0; segment < SPHERE_SEGMENTS; ++segment) {
+            const uint32_t a = ring * stride + segment;
+            const uint32_t b = a + stride;
+            if (ring > 0) {
+                indices.insert(indices.end(), { a, b, a + 1 });
+            }
+            if (ring + 1 < SPHERE_RINGS) {
+                indices.insert(indices.end(), { a + 1, b, b + 1 });
+            }
+        }
+    }
+
+    sphere.indices.resize(indices.size(), sphere.vertices.size());
+    for (size_t i = 0; i < indices.size(); ++i) {
+        if (sphere.indices.format == IndexFormat::UInt16) {
+            sphere.indices.indices16[i] = (uint16_t)indices[i];
+        } else {
+            sphere.indices.indices32[i] = indices[i];
+        }
+    }
+    sphere.bounds = compute_bounds(sphere.vertices.data(), sphere.vertices.size());
+    return sphere;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file sphere.hpp
+ * @brief A UV sphere mesh of unit diameter, matching the unit cube's extent.
+ */
+
+#pragma once
+
+#include "objects.hpp"
+
+/// Longitude segments of the sphere mesh.
+constexpr uint32_t SPHERE_SEGMENTS = 24;
+
+/// Latitude rings of the sphere mesh.
+constexpr uint32_t SPHERE_RINGS = 12;
+
+/**
+ * @brief Builds a sphere of radius 0.5 around the origin with smooth normals.
+ * @return The mesh; its seam and pole vertices are duplicated per segment.
+ */
+MeshData create_sphere();
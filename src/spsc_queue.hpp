@@ -0,0 +1,77 @@
+/**
+ * @file spsc_queue.hpp
+ * @brief Bounded lock-free queue between one producer and one consumer thread.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class SpscQueue
+ * @brief A fixed-size ring buffer with one pushing and one popping thread.
+ *
+ * Each side owns one index and only reads the other's, so push and pop are a copy and
+ * an atomic store. Unlike TripleBuffer, every value is delivered in order; a full queue
+ * rejects new values instead of overwriting old ones.
+ *
+ * @tparam T The value type.
+ * @tparam Capacity The number of slots; a power of two.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /**
+     * @brief Appends a value. Producer thread only.
+     * @param value The value to copy in.
+     * @return False if the queue is full and the value was dropped.
+     */
+    bool push(const T& value) {
+        const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_slots[tail & (Capacity - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Returns the oldest value without removing it. Consumer thread only.
+     * @return The value, or null if the queue is empty; valid until the next pop().
+     */
+    const T* peek() const {
+        const uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_slots[head & (Capacity - 1)];
+    }
+
+    /**
+     * @brief Removes the oldest value. Consumer thread only.
+     * @param value Receives the value.
+     * @return False if the queue was empty.
+     */
+    bool pop(T& value) {
+        const T* front = peek();
+        if (!front) {
+            return false;
+        }
+        value = *front;
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T m_slots[Capacity];
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };  // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<uint64_t> m_tail{ 0 };  // Next slot to push, written by the producer
+};
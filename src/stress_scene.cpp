@@ -0,0 +1,57 @@
+#include "stress_scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Most placement cells along a chunk edge; beyond this the square is too small for the count
+    constexpr uint32_t MAX_STRESS_CELLS_PER_EDGE = 1024;
+}
+
+std::vector<FoliageInstance> scatter_stress_objects(const StressSceneSettings& settings, float chunkSize,
+                                                    int resolution, const TerrainParams& terrain) {
+    std::vector<FoliageInstance> candidates;
+    if (settings.objects == 0 || settings.worldSize <= 0.0f) {
+        return candidates;
+    }
+    const float half = 0.5f * settings.worldSize;
+    const int first = (int)floorf(-half / chunkSize);
+    const int last = (int)ceilf(half / chunkSize) - 1;
+    const float chunks = (float)((last - first + 1) * (last - first + 1));
+
+    // Dense enough that about half the cells survive the density rolls and the treeline
+    FoliageSettings placement;
+    placement.seed = settings.seed;
+    placement.treeDensity = 0.8f;
+    placement.rockDensity = 0.2f;
+    placement.cellsPerEdge = std::max((uint32_t)ceilf(sqrtf(2.0f * settings.objects / chunks)), 1u);
+    for (;;) {
+        candidates.clear();
+        for (int cz = first; cz <= last; ++cz) {
+            for (int cx = first; cx <= last; ++cx) {
+                for (uint32_t cell = 0; cell < placement.cellsPerEdge * placement.cellsPerEdge; ++cell) {
+                    FoliageInstance instance;
+                    if (foliage_candidate(placement, { cx, cz }, cell % placement.cellsPerEdge,
+                                          cell / placement.cellsPerEdge, chunkSize, resolution, instance, terrain) &&
+                        fabsf(instance.position.x) <= half && fabsf(instance.position.z) <= half) {
+                        candidates.push_back(instance);
+                    }
+                }
+            }
+        }
+        if (candidates.size() >= settings.objects || placement.cellsPerEdge >= MAX_STRESS_CELLS_PER_EDGE) {
+            break;
+        }
+        placement.cellsPerEdge = std::min(placement.cellsPerEdge * 2, MAX_STRESS_CELLS_PER_EDGE);
+    }
+
+    // Candidates come chunk by chunk, so an even stride keeps the whole square covered
+    if (candidates.size() > settings.objects) {
+        const size_t total = candidates.size();
+        for (size_t i = 0; i < settings.objects; ++i) {
+            candidates[i] = candidates[i * total / settings.objects];
+        }
+        candidates.resize(settings.objects);
+    }
+    return candidates;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file stress_scene.hpp
+ * @brief Procedural scenes of a chosen size for load testing.
+ *
+ * The objects are trees and rocks of the foliage placement (foliage.hpp), scattered over a
+ * square centred on the origin with as many cells per chunk as the count needs, then thinned
+ * to exactly the count by an even stride through the candidates, so every size covers the
+ * whole square and a larger run holds denser, not wider, forests. The placement depends only
+ * on the settings and the terrain, so runs of the same size draw the same scene, and
+ * benchmark runs over a range of sizes give each frame, phase and pass time as a function of
+ * the object count (see perf_scaling()).
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "foliage.hpp"
+#include "landscape.hpp"
+
+/**
+ * @struct StressSceneSettings
+ * @brief What a stress scene holds.
+ */
+struct StressSceneSettings {
+    uint32_t objects = 0;       ///< Trees and rocks to place; 0 leaves the scene as it is.
+    uint32_t lights = 0;        ///< Point lights to scatter, up to MAX_POINT_LIGHTS.
+    float worldSize = 512.0f;   ///< Side of the square centred on the origin that everything is spread over.
+    uint32_t seed = 7;          ///< Varies the placement.
+};
+
+/**
+ * @brief Places the objects of a stress scene.
+ * @param settings The scene.
+ * @param chunkSize The chunk edge length in world units.
+ * @param resolution The vertices along each chunk edge.
+ * @param terrain The terrain generator's tunables.
+ * @return settings.objects instances, fewer only if the square is too small to hold them at 1024 cells
+ *         per chunk edge.
+ */
+std::vector<FoliageInstance> scatter_stress_objects(const StressSceneSettings& settings, float chunkSize,
+                                                    int resolution, const TerrainParams& terrain = {});
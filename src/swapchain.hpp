@@ -0,0 +1,72 @@
+/**
+ * @file swapchain.hpp
+ * @brief Keeps the CAMetalLayer drawable size and the scene targets in step with the window.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#import <QuartzCore/CAMetalLayer.h>
+
+#include <cstdint>
+
+#include "render_targets.hpp"
+
+/**
+ * @struct Swapchain
+ * @brief The layer and the render targets sized to its drawables.
+ *
+ * The scene renders into color rather than the drawable, so the drawable is only needed
+ * by the final composite pass and is acquired as late in the frame as possible.
+ *
+ * Resizes are only recorded by swapchain_resize() and applied at the start of the next
+ * frame, so a burst of framebuffer-size callbacks during a live resize reallocates once.
+ * The old textures are simply released: command buffers from commandBuffer retain
+ * their attachments, so frames still in flight keep it alive until they complete and the
+ * render loop never waits for the GPU.
+ */
+struct Swapchain {
+    CAMetalLayer* layer;                ///< The window's Metal layer.
+    id<MTLDevice> device;               ///< Device the targets are created on.
+    id<MTLTexture> color;               ///< Scene colour target matching the drawable size and format.
+    TransientTarget depth;              ///< Depth target matching the drawable size; memoryless while not kept.
+    MTLTextureUsage depthUsage = MTLTextureUsageRenderTarget; ///< Usage of depth on frames that keep it.
+    uint32_t width = 0;                 ///< Drawable width in pixels.
+    uint32_t height = 0;                ///< Drawable height in pixels.
+    uint32_t pendingWidth = 0;          ///< Size requested by the last swapchain_resize().
+    uint32_t pendingHeight = 0;         ///< Size requested by the last swapchain_resize().
+    uint64_t generation = 0;            ///< Incremented every time the targets are recreated.
+};
+
+/**
+ * @brief Sets up the layer and allocates targets for an initial size.
+ * @param device The Metal device.
+ * @param layer The window's layer.
+ * @param width The framebuffer width in pixels.
+ * @param height The framebuffer height in pixels.
+ * @param contentsScale The window's backing scale factor.
+ * @param depthUsage Usage flags of the depth target on frames that keep it.
+ * @return The swapchain.
+ */
+Swapchain create_swapchain(id<MTLDevice> device, CAMetalLayer* layer, uint32_t width, uint32_t height,
+                           float contentsScale, MTLTextureUsage depthUsage = MTLTextureUsageRenderTarget);
+
+/**
+ * @brief Records a new framebuffer size; safe to call from the GLFW framebuffer-size callback.
+ * @param swapchain The swapchain.
+ * @param width The framebuffer width in pixels.
+ * @param height The framebuffer height in pixels.
+ * @param contentsScale The window's backing scale factor, which changes between displays.
+ */
+void swapchain_resize(Swapchain& swapchain, uint32_t width, uint32_t height, float contentsScale);
+
+/**
+ * @brief Applies a pending resize by reallocating the targets.
+ * @param swapchain The swapchain.
+ * @return True if the targets were recreated; sized resources derived from them must follow.
+ */
+bool swapchain_begin_frame(Swapchain& swapchain);
+
+/// @return False while the window is minimized or has no area, when nothing should be rendered.
+inline bool swapchain_has_area(const Swapchain& swapchain) {
+    return swapchain.width > 0 && swapchain.height > 0;
+}
@@ -0,0 +1,55 @@
+#import "swapchain.hpp"
+
+namespace {
+    void allocate_targets(Swapchain& swapchain) {
+        swapchain.layer.drawableSize = CGSizeMake(swapchain.width, swapchain.height);
+        swapchain.generation++;
+        if (!swapchain_has_area(swapchain)) {
+            swapchain.color = nil;
+            swapchain.depth = {};
+            return;
+        }
+
+        MTLTextureDescriptor* colorDesc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:swapchain.layer.pixelFormat
+                                                                                             width:swapchain.width
+                                                                                            height:swapchain.height
+                                                                                         mipmapped:NO];
+        colorDesc.storageMode = MTLStorageModePrivate;
+        colorDesc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+        swapchain.color = [swapchain.device newTextureWithDescriptor:colorDesc];
+        swapchain.color.label = @"Scene colour";
+        swapchain.depth = create_transient_target(swapchain.device, MTLPixelFormatDepth32Float, swapchain.width,
+                                                  swapchain.height, swapchain.depthUsage, @"Depth");
+    }
+}
+
+Swapchain create_swapchain(id<MTLDevice> device, CAMetalLayer* layer, uint32_t width, uint32_t height,
+                           float contentsScale, MTLTextureUsage depthUsage) {
+    Swapchain swapchain;
+    swapchain.layer = layer;
+    swapchain.device = device;
+    swapchain.depthUsage = depthUsage;
+    swapchain.width = swapchain.pendingWidth = width;
+    swapchain.height = swapchain.pendingHeight = height;
+    layer.contentsScale = contentsScale;
+    allocate_targets(swapchain);
+    return swapchain;
+}
+
+void swapchain_resize(Swapchain& swapchain, uint32_t width, uint32_t height, float contentsScale) {
+    swapchain.pendingWidth = width;
+    swapchain.pendingHeight = height;
+    if (swapchain.layer.contentsScale != contentsScale) {
+        swapchain.layer.contentsScale = contentsScale;
+    }
+}
+
+bool swapchain_begin_frame(Swapchain& swapchain) {
+    if (swapchain.pendingWidth == swapchain.width && swapchain.pendingHeight == swapchain.height) {
+        return false;
+    }
+    swapchain.width = swapchain.pendingWidth;
+    swapchain.height = swapchain.pendingHeight;
+    allocate_targets(swapchain);
+    return true;
+}
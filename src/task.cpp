@@ -0,0 +1,23 @@
+#include "task.hpp"
+
+size_t TaskScheduler::poll() {
+    // Conditions are checked outside the lock, so tasks parking meanwhile do not wait on them
+    std::vector<Waiter> parked;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        parked.swap(m_parked);
+    }
+    std::vector<Waiter> waiting;
+    for (Waiter& waiter : parked) {
+        const bool cancelled = waiter.cancel.cancelled();
+        if (cancelled || waiter.ready()) {
+            *waiter.held = !cancelled;
+            resume(waiter.handle, waiter.priority);
+        } else {
+            waiting.push_back(std::move(waiter));
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_parked.insert(m_parked.end(), std::make_move_iterator(waiting.begin()), std::make_move_iterator(waiting.end()));
+    return m_parked.size();
+}
@@ -0,0 +1,285 @@
+/**
+ * @file task.hpp
+ * @brief C++20 coroutine tasks that run multi-stage loading flows on the job system.
+ *
+ * A flow like "check the tile cache, generate on a miss, erode, scatter foliage, upload,
+ * publish" is written as one coroutine returning Task<>, with a co_await wherever it changes
+ * thread or waits: `co_await scheduler.on(JobPriority::Background)` moves it onto a job
+ * system pool, `co_await scheduler.until(ready)` parks it until a condition holds (a job
+ * counter drained, an upload's event value reached, an IO load finished, see gpu_tasks.hpp),
+ * and `co_await subtask` runs another Task<T> and yields its value. No thread blocks: a parked
+ * flow is only a coroutine frame in the scheduler's list until poll(), called once per frame,
+ * finds it ready and queues its resumption as a job.
+ *
+ * Cancellation is cooperative. Waits take a CancelToken and end early, returning false, once
+ * it is cancelled, so a flow for a chunk the camera has left returns at its next wait rather
+ * than finishing work nobody wants. Tasks are lazy and owned: start() runs a task on the
+ * calling thread up to its first suspension, and the owner keeps it alive until done().
+ */
+
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "job_system.hpp"
+
+/**
+ * @class CancelToken
+ * @brief A cancellation flag shared by its copies; the requester keeps one, the flow another.
+ */
+class CancelToken {
+public:
+    CancelToken() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    /// Asks every flow holding a copy to stop at its next wait.
+    void cancel() const { m_flag->store(true, std::memory_order_release); }
+
+    /// @return True once cancel() was called on any copy.
+    bool cancelled() const { return m_flag->load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+template <typename T>
+class Task;
+
+namespace task_detail {
+    struct PromiseBase {
+        std::coroutine_handle<> continuation;   ///< The coroutine awaiting this one, if any.
+        std::atomic<bool> finished{ false };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+                PromiseBase& promise = handle.promise();
+                const std::coroutine_handle<> next = promise.continuation ? promise.continuation
+                                                                          : std::noop_coroutine();
+                // The owner may destroy the frame as soon as this is set
+                promise.finished.store(true, std::memory_order_release);
+                return next;
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        // The engine does not use exceptions; one escaping a flow is a bug
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    template <typename T>
+    struct Promise : PromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+
+        template <typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+
+        T take() { return std::move(*value); }
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase {
+        Task<void> get_return_object();
+        void return_void() {}
+        void take() {}
+    };
+}
+
+/**
+ * @class Task
+ * @brief A lazily started coroutine that produces a T; awaiting it runs it and yields the T.
+ */
+template <typename T = void>
+class [[nodiscard]] Task {
+public:
+    using promise_type = task_detail::Promise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            m_handle = std::exchange(other.m_handle, {});
+        }
+        return *this;
+    }
+    ~Task() { reset(); }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    /// Runs the task on the calling thread until it first suspends; call once, on a task nobody awaits.
+    void start() { m_handle.resume(); }
+
+    /// @return True once the task has returned, or if it holds no coroutine.
+    bool done() const { return !m_handle || m_handle.promise().finished.load(std::memory_order_acquire); }
+
+    /// @return The returned value, moved out; only once done().
+    T result() { return m_handle.promise().take(); }
+
+    /// Awaiting a task starts it and resumes the awaiter, on the thread that finished it, with its value.
+    auto operator co_await() noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+                handle.promise().continuation = awaiter;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().take(); }
+        };
+        return Awaiter{ m_handle };
+    }
+
+private:
+    // Destroying a task that is suspended part way leaves whoever would resume it dangling
+    void reset() {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = {};
+        }
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename T>
+Task<T> task_detail::Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> task_detail::Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+/**
+ * @class TaskScheduler
+ * @brief Resumes coroutine tasks on a job system, directly or once a condition holds.
+ *
+ * Conditions are polled rather than signalled because what flows wait for, GPU event values,
+ * IO loads and job counters, is already cheap to query and the render thread checks it once a
+ * frame anyway. Safe to call from several threads. Before it is destroyed every task it
+ * serves must have finished; cancel them and keep polling until they are done.
+ */
+class TaskScheduler {
+public:
+    explicit TaskScheduler(JobSystem& jobs) : m_jobs(jobs) {}
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    /**
+     * @brief Returns an awaitable that continues the awaiting task as a job.
+     * @param priority The pool to continue on; Background for streaming work.
+     */
+    auto on(JobPriority priority) {
+        struct Awaiter {
+            TaskScheduler& scheduler;
+            JobPriority priority;
+
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { scheduler.resume(handle, priority); }
+            void await_resume() noexcept {}
+        };
+        return Awaiter{ *this, priority };
+    }
+
+    /**
+     * @brief Returns an awaitable that continues the awaiting task once a condition holds.
+     *
+     * The condition is checked at once and then by every poll() until it holds or the token
+     * is cancelled; the task continues as a job on the given pool, or inline if it already held.
+     * @param ready The condition; cheap, thread-safe and must not call into the scheduler.
+     * @param priority The pool to continue on.
+     * @param cancel Ends the wait early.
+     * @return From co_await, true if the condition held, false if the wait was cancelled.
+     */
+    auto until(std::function<bool()> ready, JobPriority priority = JobPriority::Background,
+               CancelToken cancel = {}) {
+        struct Awaiter {
+            TaskScheduler& scheduler;
+            Waiter waiter;
+            bool held = false;
+
+            bool await_ready() {
+                if (waiter.cancel.cancelled()) {
+                    return true;
+                }
+                held = waiter.ready();
+                return held;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                waiter.held = &held;
+                scheduler.park(std::move(waiter));
+            }
+
+            bool await_resume() noexcept { return held; }
+        };
+        return Awaiter{ *this, Waiter{ std::move(ready), std::move(cancel), priority, {}, nullptr } };
+    }
+
+    /**
+     * @brief Queues a suspended task to continue as a job; for awaitables woken by a callback.
+     * @param handle The suspended coroutine.
+     * @param priority The pool to continue on.
+     */
+    void resume(std::coroutine_handle<> handle, JobPriority priority) {
+        m_jobs.run([handle] { handle.resume(); }, nullptr, priority);
+    }
+
+    /**
+     * @brief Continues the parked tasks whose condition holds or whose wait was cancelled.
+     *
+     * Call once per frame, or in a loop while waiting for flows to finish.
+     * @return The tasks still parked.
+     */
+    size_t poll();
+
+    /// @return The tasks parked on a condition.
+    size_t parked() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_parked.size();
+    }
+
+    /// @return The job system tasks continue on.
+    JobSystem& jobs() const { return m_jobs; }
+
+private:
+    struct Waiter {
+        std::function<bool()> ready;
+        CancelToken cancel;
+        JobPriority priority;
+        std::coroutine_handle<> handle;
+        bool* held;                     ///< Receives whether the condition held; lives in the coroutine frame.
+    };
+
+    void park(Waiter waiter) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_parked.push_back(std::move(waiter));
+    }
+
+    JobSystem& m_jobs;
+    mutable std::mutex m_mutex;
+    std::vector<Waiter> m_parked;       ///< Guarded by m_mutex.
+};
@@ -0,0 +1,46 @@
+#include "temporal_aa.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Keeps a flat neighbourhood's box from having no extent to divide by
+    constexpr float CLIP_EPSILON = 1e-4f;
+}
+
+simd::float3 rgb_to_ycocg(simd::float3 rgb) {
+    return simd::float3{ 0.25f * rgb.x + 0.5f * rgb.y + 0.25f * rgb.z, 0.5f * rgb.x - 0.5f * rgb.z,
+                         -0.25f * rgb.x + 0.5f * rgb.y - 0.25f * rgb.z };
+}
+
+simd::float3 ycocg_to_rgb(simd::float3 ycocg) {
+    return simd::float3{ ycocg.x + ycocg.y - ycocg.z, ycocg.x + ycocg.z, ycocg.x - ycocg.y - ycocg.z };
+}
+
+simd::float3 taa_clip_history(simd::float3 color, simd::float3 boxMin, simd::float3 boxMax) {
+    const simd::float3 center = 0.5f * (boxMax + boxMin);
+    const simd::float3 extents = 0.5f * (boxMax - boxMin) + CLIP_EPSILON;
+    const simd::float3 offset = color - center;
+    const simd::float3 units = simd::abs(offset / extents);
+    const float furthest = std::max({ units.x, units.y, units.z });
+    return furthest > 1.0f ? center + offset / furthest : color;
+}
+
+float taa_current_weight(const TemporalAASettings& settings, float motionPixels) {
+    return std::clamp(settings.currentWeight + settings.motionWeight * motionPixels, settings.currentWeight,
+                      settings.maxCurrentWeight);
+}
+
+simd::float3 taa_resolve(const simd::float3 neighbourhood[9], simd::float3 history, float motionPixels,
+                         const TemporalAASettings& settings) {
+    const simd::float3 current = rgb_to_ycocg(neighbourhood[4]);
+    simd::float3 boxMin = current;
+    simd::float3 boxMax = current;
+    for (int i = 0; i < 9; ++i) {
+        const simd::float3 sample = rgb_to_ycocg(neighbourhood[i]);
+        boxMin = simd::min(boxMin, sample);
+        boxMax = simd::max(boxMax, sample);
+    }
+    const simd::float3 clipped = taa_clip_history(rgb_to_ycocg(history), boxMin, boxMax);
+    const float weight = taa_current_weight(settings, motionPixels);
+    return ycocg_to_rgb(clipped + (current - clipped) * weight);
+}
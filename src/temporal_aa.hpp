@@ -0,0 +1,69 @@
+/**
+ * @file temporal_aa.hpp
+ * @brief Temporal anti-aliasing: jittered frames accumulated into a history clamped to the current one.
+ *
+ * MSAA only supersamples coverage, so shading that changes faster than the pixel grid, like the
+ * terrain's height bands, still aliases. Temporal anti-aliasing spreads the supersampling over
+ * frames instead: each frame's projection is offset by the next point of a Halton sequence
+ * (see halton() and jitter_projection()), and a resolve pass blends the frame into a history
+ * reprojected with the camera motion vectors, so a still image converges to many samples a pixel
+ * for the cost of one.
+ *
+ * History that no longer matches the scene, uncovered by motion or changed by lighting, would
+ * ghost. The resolve clips it towards the range of the current frame's 3x3 neighbourhood in
+ * YCoCg, where the box fits the colours more tightly than in RGB (Karis, "High Quality Temporal
+ * Supersampling", 2014; Pedersen, "Temporal Reprojection Anti-Aliasing in INSIDE", 2016), and
+ * leans on the current frame more the faster the pixel moves, since reprojection blurs.
+ *
+ * It runs as a mode of the Upscaler, on the same jitter sequence, depth and motion vectors the
+ * MetalFX temporal scaler reads, and never alongside it: when the scene renders below the output
+ * size the temporal scaler anti-aliases as it upscales, so either way it is one pass.
+ * These functions mirror temporal_aa_resolve in shaders.metal.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+/**
+ * @struct TemporalAASettings
+ * @brief How much of each new frame goes into the history.
+ */
+struct TemporalAASettings {
+    float currentWeight = 0.1f;     ///< Share of a still pixel taken from the current frame.
+    float motionWeight = 0.02f;     ///< Share added per pixel the surface moved since the last frame.
+    float maxCurrentWeight = 0.5f;  ///< Largest share of the current frame, however fast the motion.
+};
+
+/// @return rgb in YCoCg: luma, orange and green chroma.
+simd::float3 rgb_to_ycocg(simd::float3 rgb);
+
+/// @return The inverse of rgb_to_ycocg().
+simd::float3 ycocg_to_rgb(simd::float3 ycocg);
+
+/**
+ * @brief Clips a colour towards the centre of a box until it lies within it.
+ * @param color The history colour.
+ * @param boxMin The box's lower corner.
+ * @param boxMax The box's upper corner.
+ * @return color if inside, otherwise where the segment from the box's centre to color leaves the box.
+ */
+simd::float3 taa_clip_history(simd::float3 color, simd::float3 boxMin, simd::float3 boxMax);
+
+/**
+ * @brief Returns the share of the current frame in the resolved colour.
+ * @param settings The settings.
+ * @param motionPixels Distance the pixel's surface moved since the last frame, in pixels.
+ * @return A weight in [currentWeight, maxCurrentWeight].
+ */
+float taa_current_weight(const TemporalAASettings& settings, float motionPixels);
+
+/**
+ * @brief Resolves one pixel.
+ * @param neighbourhood The current frame's 3x3 neighbourhood in RGB, row by row; element 4 is the pixel.
+ * @param history The history reprojected to the pixel, in RGB.
+ * @param motionPixels Distance the pixel's surface moved since the last frame, in pixels.
+ * @param settings The settings.
+ * @return The blend of the current colour and the history clipped to the neighbourhood, in RGB.
+ */
+simd::float3 taa_resolve(const simd::float3 neighbourhood[9], simd::float3 history, float motionPixels,
+                         const TemporalAASettings& settings);
@@ -0,0 +1,81 @@
+#include "terrain_bake.hpp"
+
+#include <cstring>
+
+#include "terrain_height_map.hpp"
+#include "vertex_packing.hpp"
+
+TerrainTileParams terrain_bake_tile_params(const TerrainBakeSettings& settings) {
+    TerrainTileParams params;
+    params.chunkSize = settings.chunkSize;
+    params.resolution = settings.resolution;
+    params.vertexFormat = settings.vertexFormat;
+    params.heightMaps = settings.heightMaps;
+    params.noise = terrain_noise_mapping(settings.terrain);
+    params.compressed = settings.compressed;
+    return params;
+}
+
+size_t terrain_bake_payload_bytes(const TerrainBakeSettings& settings) {
+    const size_t res = (size_t)settings.resolution;
+    return res * res * (settings.heightMaps ? TERRAIN_HEIGHT_MAP_TEXEL_BYTES : vertex_stride(settings.vertexFormat));
+}
+
+ChunkLodInfo encode_terrain_bake_payload(ChunkKey key, const Vertex* vertices, const TerrainBakeSettings& settings,
+                                         std::vector<uint8_t>& payload) {
+    payload.resize(terrain_bake_payload_bytes(settings));
+    return encode_terrain_bake_payload(key, vertices, settings, (void*)payload.data());
+}
+
+ChunkLodInfo encode_terrain_bake_payload(ChunkKey key, const Vertex* vertices, const TerrainBakeSettings& settings,
+                                         void* payload) {
+    const int res = settings.resolution;
+    const size_t count = (size_t)res * res;
+    uint8_t* bytes = (uint8_t*)payload;
+
+    std::vector<float> heights(count);
+    for (size_t i = 0; i < count; ++i) {
+        heights[i] = vertices[i].position.y;
+    }
+
+    if (settings.heightMaps) {
+        TerrainHeightMap map;
+        encode_terrain_height_map(vertices, res, map);
+        const size_t heightBytes = map.heights.size() * sizeof(uint16_t);
+        memcpy(bytes, map.heights.data(), heightBytes);
+        memcpy(bytes + heightBytes, map.normals.data(), map.normals.size());
+    } else if (settings.vertexFormat == VertexFormat::Packed) {
+        const QuantizationBox box = terrain_chunk_quantization_box(key.x, key.z, settings.chunkSize, settings.terrain);
+        pack_vertices(vertices, count, box, (PackedVertex*)bytes);
+    } else if (bytes != (const uint8_t*)vertices) {
+        memcpy(bytes, vertices, count * sizeof(Vertex));
+    }
+    return compute_chunk_lod_info(heights.data(), res);
+}
+
+TerrainTileFooter terrain_bake_footer(const TerrainBakeSettings& settings, uint64_t generatorKey, ChunkKey key,
+                                      const ChunkLodInfo& lod) {
+    TerrainTileFooter footer;
+    footer.generatorKey = generatorKey;
+    footer.chunkX = key.x;
+    footer.chunkZ = key.z;
+    footer.vertexBytes = terrain_bake_payload_bytes(settings);
+    footer.lod = lod;
+    if (settings.compressed) {
+        footer.codec = (uint32_t)(settings.heightMaps ? TerrainTileCodec::HeightMap : TerrainTileCodec::Vertices);
+        footer.codecStride = settings.heightMaps ? (uint32_t)settings.resolution
+                                                 : (uint32_t)vertex_stride(settings.vertexFormat);
+    }
+    return footer;
+}
+
+bool bake_terrain_tile(const std::string& directory, ChunkKey key, const TerrainBakeSettings& settings,
+                       std::vector<Vertex>& vertices, std::vector<uint8_t>& payload) {
+    vertices.resize(terrain_chunk_mesh_size(settings.resolution).vertexCount);
+    build_terrain_chunk_vertices(key.x, key.z, settings.resolution, settings.chunkSize, vertices.data(),
+                                 settings.terrain);
+    const ChunkLodInfo lod = encode_terrain_bake_payload(key, vertices.data(), settings, payload);
+    const uint64_t generatorKey = terrain_tile_generator_key(terrain_bake_tile_params(settings));
+    return write_terrain_tile(terrain_tile_path(directory, key), terrain_bake_footer(settings, generatorKey, key, lod),
+                              payload.data());
+}
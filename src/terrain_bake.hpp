@@ -0,0 +1,90 @@
+/**
+ * @file terrain_bake.hpp
+ * @brief Builds the tiles of generated terrain chunks without a GPU, for streaming and offline baking.
+ *
+ * A chunk's tile payload depends only on TerrainBakeSettings and its coordinates, so the
+ * tiles ChunkManager writes as it generates chunks on the CPU and the ones the terrain_baker
+ * tool writes ahead of time, on any machine and any number of them, are the same bytes under
+ * the same generator key. A farm of build machines can bake a world's tile directory and ship
+ * it to the clients' tile caches.
+ *
+ * Eroded terrain is not baked: erosion runs over windows spanning several chunks and the
+ * windows a client erodes depend on what it visits, so eroded tiles stay local to a client.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "objects.hpp"
+#include "terrain_lod.hpp"
+#include "terrain_tile_cache.hpp"
+
+/**
+ * @struct TerrainBakeSettings
+ * @brief The generator and layout of the baked chunks; the defaults match ChunkManagerConfig's.
+ */
+struct TerrainBakeSettings {
+    float chunkSize = 32.0f;                          ///< Edge length of a chunk in world units.
+    int resolution = 33;                              ///< Vertices along each chunk edge.
+    VertexFormat vertexFormat = VertexFormat::Packed; ///< Layout of the stored vertices.
+    bool heightMaps = false;                          ///< Store height-map texels instead of vertices.
+    bool compressed = false;                          ///< Encode the payload with mesh_codec.hpp.
+    TerrainParams terrain;                            ///< Terrain generator tunables.
+};
+
+/// @return The tile parameters, erosion off, whose terrain_tile_generator_key() names the tile directory.
+TerrainTileParams terrain_bake_tile_params(const TerrainBakeSettings& settings);
+
+/// @return Bytes of a chunk's payload: its vertices, or its height-map heights followed by its normals.
+size_t terrain_bake_payload_bytes(const TerrainBakeSettings& settings);
+
+/**
+ * @brief Converts a chunk's vertices into its tile payload.
+ * @param key The chunk.
+ * @param vertices resolution^2 vertices, as build_terrain_chunk_vertices() writes them, possibly edited.
+ * @param settings The layout.
+ * @param payload Receives terrain_bake_payload_bytes() bytes.
+ * @return The chunk's LOD metrics.
+ */
+ChunkLodInfo encode_terrain_bake_payload(ChunkKey key, const Vertex* vertices, const TerrainBakeSettings& settings,
+                                         std::vector<uint8_t>& payload);
+
+/**
+ * @brief Converts a chunk's vertices into its tile payload in caller-provided memory, e.g. a shared GPU buffer.
+ * @param key The chunk.
+ * @param vertices resolution^2 vertices, as build_terrain_chunk_vertices() writes them, possibly edited.
+ * @param settings The layout.
+ * @param payload Receives terrain_bake_payload_bytes() bytes. With float vertices it may be vertices itself,
+ *                for vertices built in place, which are then only measured.
+ * @return The chunk's LOD metrics.
+ */
+ChunkLodInfo encode_terrain_bake_payload(ChunkKey key, const Vertex* vertices, const TerrainBakeSettings& settings,
+                                         void* payload);
+
+/**
+ * @brief Returns the footer of a chunk's tile, with the codec the settings select.
+ * @param settings The layout.
+ * @param generatorKey terrain_tile_generator_key() of the tile directory.
+ * @param key The chunk.
+ * @param lod The chunk's LOD metrics.
+ * @return The footer for write_terrain_tile().
+ */
+TerrainTileFooter terrain_bake_footer(const TerrainBakeSettings& settings, uint64_t generatorKey, ChunkKey key,
+                                      const ChunkLodInfo& lod);
+
+/**
+ * @brief Generates a chunk and writes its tile.
+ * @param directory The terrain_tile_directory() of terrain_bake_tile_params().
+ * @param key The chunk.
+ * @param settings The generator and layout.
+ * @param vertices Scratch for the chunk's vertices, reused across calls.
+ * @param payload Scratch for the payload, reused across calls.
+ * @return True if the tile was written.
+ */
+bool bake_terrain_tile(const std::string& directory, ChunkKey key, const TerrainBakeSettings& settings,
+                       std::vector<Vertex>& vertices, std::vector<uint8_t>& payload);
@@ -0,0 +1,97 @@
+#include <metal_stdlib>
+using namespace metal;
+
+// --- Terrain brushes (compute) ---
+// Built into a terrain_brush.metallib of its own, which metal_terrain_brush_pipelines() loads
+// when the terrain editor is first opened; shaders.metal does not use any of it.
+// One thread per grid point of the brush rectangle, matching TerrainEdits::apply() in
+// terrain_edit.cpp: every point reads the heights as they were before the brush, neighbours
+// outside the rectangle read the nearest point inside it, and the new offsets go to a scratch
+// texture that gpu_terrain_brush.mm copies back over the window's offsets.
+
+// Matches TerrainBrushMode in terrain_edit.hpp
+constant uint TERRAIN_BRUSH_RAISE = 0;
+constant uint TERRAIN_BRUSH_LOWER = 1;
+constant uint TERRAIN_BRUSH_FLATTEN = 2;
+constant uint TERRAIN_BRUSH_SMOOTH = 3;
+constant uint TERRAIN_BRUSH_ERODE = 4;
+
+// Matches TerrainBrushParams in gpu_terrain_brush.hpp
+struct TerrainBrushParams {
+    int originX;
+    int originZ;
+    int pointX;
+    int pointZ;
+    uint width;
+    uint depth;
+    uint mode;
+    float spacing;
+    float centerX;
+    float centerZ;
+    float radius;
+    float strength;
+    float targetHeight;
+    float talus;
+    float heightLimit;
+};
+
+// terrain_brush_weight() in terrain_edit.cpp
+static float terrain_brush_weight(float distance, float radius) {
+    const float t = clamp(1.0 - distance / radius, 0.0, 1.0);
+    return t * t * (3.0 - 2.0 * t);
+}
+
+static float terrain_brush_height(constant TerrainBrushParams& p, texture2d<float, access::read> base,
+                                  texture2d<float, access::read> offsets, int2 point) {
+    const int2 inside = clamp(point, int2(0), int2(int(p.width) - 1, int(p.depth) - 1));
+    const uint2 texel = uint2(inside + int2(p.originX, p.originZ));
+    return base.read(texel).r + offsets.read(texel).r;
+}
+
+kernel void terrain_brush_apply(constant TerrainBrushParams& p [[buffer(0)]],
+                                texture2d<float, access::read> base [[texture(0)]],
+                                texture2d<float, access::read> offsets [[texture(1)]],
+                                texture2d<float, access::write> out [[texture(2)]],
+                                uint2 gid [[thread_position_in_grid]]) {
+    if (gid.x >= p.width || gid.y >= p.depth) return;
+    const int2 point = int2(gid);
+    const uint2 texel = uint2(point + int2(p.originX, p.originZ));
+    const float offset = offsets.read(texel).r;
+    const float dx = float(p.pointX + point.x) * p.spacing - p.centerX;
+    const float dz = float(p.pointZ + point.y) * p.spacing - p.centerZ;
+    const float weight = terrain_brush_weight(sqrt(dx * dx + dz * dz), p.radius);
+    if (weight <= 0.0) {
+        out.write(float4(offset), gid);
+        return;
+    }
+
+    const float baseHeight = base.read(texel).r;
+    const float here = baseHeight + offset;
+    const float neighbours[4] = { terrain_brush_height(p, base, offsets, point + int2(-1, 0)),
+                                  terrain_brush_height(p, base, offsets, point + int2(1, 0)),
+                                  terrain_brush_height(p, base, offsets, point + int2(0, -1)),
+                                  terrain_brush_height(p, base, offsets, point + int2(0, 1)) };
+    const float fraction = clamp(p.strength, 0.0, 1.0);
+    float height = here;
+    if (p.mode == TERRAIN_BRUSH_RAISE) {
+        height += p.strength * weight;
+    } else if (p.mode == TERRAIN_BRUSH_LOWER) {
+        height -= p.strength * weight;
+    } else if (p.mode == TERRAIN_BRUSH_FLATTEN) {
+        height += (p.targetHeight - here) * fraction * weight;
+    } else if (p.mode == TERRAIN_BRUSH_SMOOTH) {
+        const float mean = 0.25 * (neighbours[0] + neighbours[1] + neighbours[2] + neighbours[3]);
+        height += (mean - here) * fraction * weight;
+    } else if (p.mode == TERRAIN_BRUSH_ERODE) {
+        const float slide = p.talus * p.spacing;
+        float flow = 0.0;
+        for (int n = 0; n < 4; ++n) {
+            const float difference = neighbours[n] - here;
+            flow += 0.125 * copysign(max(abs(difference) - slide, 0.0), difference);
+        }
+        height += flow * fraction * weight;
+    }
+    height = clamp(height, -p.heightLimit, p.heightLimit);
+    // An unchanged point keeps its offset bit for bit, as the CPU leaves it alone
+    out.write(float4(abs(height - here) > 0.0 ? height - baseHeight : offset), gid);
+}
@@ -0,0 +1,41 @@
+#include "terrain_clipmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+simd::int2 terrain_clipmap_origin(const ClipmapLevel& level, uint32_t textureSize) {
+    const int32_t half = (int32_t)textureSize / 2;
+    return simd::int2{ (int32_t)lroundf(level.center.x / level.cellSize) - half,
+                       (int32_t)lroundf(level.center.y / level.cellSize) - half };
+}
+
+uint32_t terrain_clipmap_texel(int32_t coordinate, uint32_t textureSize) {
+    const int32_t size = (int32_t)textureSize;
+    return (uint32_t)(((coordinate % size) + size) % size);
+}
+
+uint32_t terrain_clipmap_dirty_regions(simd::int2 previous, simd::int2 current, bool valid, uint32_t textureSize,
+                                       TerrainClipmapRegion regions[2]) {
+    const int32_t size = (int32_t)textureSize;
+    const int32_t dx = current.x - previous.x;
+    const int32_t dz = current.y - previous.y;
+    if (!valid || std::abs(dx) >= size || std::abs(dz) >= size) {
+        regions[0] = { current, { textureSize, textureSize } };
+        return 1;
+    }
+
+    uint32_t count = 0;
+    // Columns that entered on the side the window moved towards, over its full depth
+    if (dx != 0) {
+        const int32_t x = dx > 0 ? previous.x + size : current.x;
+        regions[count++] = { { x, current.y }, { (uint32_t)std::abs(dx), textureSize } };
+    }
+    // Rows that entered, over the columns the first strip left out
+    if (dz != 0) {
+        const int32_t x = dx > 0 ? current.x : current.x - std::min(dx, 0);
+        const int32_t z = dz > 0 ? previous.y + size : current.y;
+        regions[count++] = { { x, z }, { (uint32_t)(size - std::abs(dx)), (uint32_t)std::abs(dz) } };
+    }
+    return count;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file terrain_clipmap.hpp
+ * @brief Which texels of a clipmap terrain's height textures a camera move invalidates.
+ *
+ * In clipmap mode the terrain is drawn as a geometry clipmap (see clipmap.hpp) instead of
+ * chunks. Each level reads its heights from its own slice of a texture array, one texel per
+ * grid vertex plus a border for the normals. A slice is a window of the level's lattice around
+ * its centre, stored toroidally: lattice point (x, z) lives at texel (x mod size, z mod size).
+ * When the level moves, the texels that stay in the window keep their place and only the strips
+ * that enter it are refreshed, so a frame costs a few rows of height evaluations however large
+ * the world is and however far the camera sees.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "clipmap.hpp"
+
+/// Lattice points kept beyond a level's grid on each side, for the normals' central differences.
+constexpr uint32_t TERRAIN_CLIPMAP_BORDER = 2;
+
+/**
+ * @struct TerrainClipmapRegion
+ * @brief A rectangle of lattice points of one level, in the level's cells.
+ */
+struct TerrainClipmapRegion {
+    simd::int2 origin;  ///< Lattice x/z of the first point.
+    simd::uint2 size;   ///< Points along x and z.
+};
+
+/// @return Texels per side of a level's height slice for a grid of gridSize cells.
+inline uint32_t terrain_clipmap_texture_size(uint32_t gridSize) {
+    return gridSize + 2 * TERRAIN_CLIPMAP_BORDER;
+}
+
+/**
+ * @brief Returns the first lattice point of a level's window.
+ * @param level The level, placed by clipmap_place().
+ * @param textureSize terrain_clipmap_texture_size() of the grid.
+ * @return Lattice x/z, in the level's cells, of the window's low corner.
+ */
+simd::int2 terrain_clipmap_origin(const ClipmapLevel& level, uint32_t textureSize);
+
+/**
+ * @brief Returns the texel a lattice coordinate is stored at.
+ * @param coordinate Lattice x or z; any integer.
+ * @param textureSize Texels per side.
+ * @return coordinate modulo textureSize, in [0, textureSize).
+ */
+uint32_t terrain_clipmap_texel(int32_t coordinate, uint32_t textureSize);
+
+/**
+ * @brief Finds the lattice points a window move brings in.
+ *
+ * At most two rectangles: a strip of columns over the whole new window and a strip of rows
+ * beside it. A first update, or a move of a whole window or more, refreshes everything.
+ *
+ * @param previous The window's origin before the move.
+ * @param current The window's origin after it.
+ * @param valid False if the slice holds nothing yet.
+ * @param textureSize Texels per side.
+ * @param regions Receives up to two rectangles.
+ * @return The number of rectangles written.
+ */
+uint32_t terrain_clipmap_dirty_regions(simd::int2 previous, simd::int2 current, bool valid, uint32_t textureSize,
+                                       TerrainClipmapRegion regions[2]);
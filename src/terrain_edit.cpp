@@ -0,0 +1,277 @@
+#include "terrain_edit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "landscape.hpp"
+#include "terrain_erosion.hpp"
+
+TerrainGridRect terrain_grid_rect_expand(const TerrainGridRect& rect, int border) {
+    if (rect.empty()) {
+        return rect;
+    }
+    return { rect.x0 - border, rect.z0 - border, rect.x1 + border, rect.z1 + border };
+}
+
+TerrainGridRect terrain_grid_rect_intersect(const TerrainGridRect& a, const TerrainGridRect& b) {
+    return { std::max(a.x0, b.x0), std::max(a.z0, b.z0), std::min(a.x1, b.x1), std::min(a.z1, b.z1) };
+}
+
+TerrainGridRect terrain_grid_rect_union(const TerrainGridRect& a, const TerrainGridRect& b) {
+    if (a.empty()) {
+        return b;
+    }
+    if (b.empty()) {
+        return a;
+    }
+    return { std::min(a.x0, b.x0), std::min(a.z0, b.z0), std::max(a.x1, b.x1), std::max(a.z1, b.z1) };
+}
+
+float terrain_brush_weight(float distance, float radius) {
+    const float t = std::clamp(1.0f - distance / radius, 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+TerrainEdits::TerrainEdits(float spacing, float heightLimit) : m_spacing(spacing), m_heightLimit(heightLimit) {}
+
+TerrainGridRect TerrainEdits::brush_rect(const TerrainBrush& brush) const {
+    return { (int)ceilf((brush.centerX - brush.radius) / m_spacing), (int)ceilf((brush.centerZ - brush.radius) / m_spacing),
+             (int)floorf((brush.centerX + brush.radius) / m_spacing), (int)floorf((brush.centerZ + brush.radius) / m_spacing) };
+}
+
+TerrainEditResult TerrainEdits::apply(const TerrainBrush& brush, const float* baseHeights) {
+    const TerrainGridRect rect = brush_rect(brush);
+    TerrainEditResult result;
+    result.changed = { rect.x1 + 1, rect.z1 + 1, rect.x0 - 1, rect.z0 - 1 };
+    if (rect.empty()) {
+        return result;
+    }
+
+    // Smooth and Erode read the neighbours as they were before the brush
+    const int width = rect.width();
+    std::vector<float> current((size_t)width * rect.depth());
+    for (int z = rect.z0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x) {
+            const int i = (z - rect.z0) * width + (x - rect.x0);
+            current[i] = baseHeights[i] + offset(x, z);
+        }
+    }
+    auto height_of = [&](int x, int z) {
+        return current[(size_t)(std::clamp(z, rect.z0, rect.z1) - rect.z0) * width +
+                       (std::clamp(x, rect.x0, rect.x1) - rect.x0)];
+    };
+    const float fraction = std::clamp(brush.strength, 0.0f, 1.0f);
+    const float slide = brush.talus * m_spacing;
+
+    for (int z = rect.z0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x) {
+            const float dx = x * m_spacing - brush.centerX;
+            const float dz = z * m_spacing - brush.centerZ;
+            const float weight = terrain_brush_weight(sqrtf(dx * dx + dz * dz), brush.radius);
+            if (weight <= 0.0f) {
+                continue;
+            }
+
+            const int i = (z - rect.z0) * width + (x - rect.x0);
+            const float base = baseHeights[i];
+            const float here = current[i];
+            const float neighbours[4] = { height_of(x - 1, z), height_of(x + 1, z), height_of(x, z - 1),
+                                          height_of(x, z + 1) };
+            float height = here;
+            switch (brush.mode) {
+            case TerrainBrushMode::Raise:
+                height += brush.strength * weight;
+                break;
+            case TerrainBrushMode::Lower:
+                height -= brush.strength * weight;
+                break;
+            case TerrainBrushMode::Flatten:
+                height += (brush.targetHeight - here) * fraction * weight;
+                break;
+            case TerrainBrushMode::Smooth: {
+                const float mean = 0.25f * (neighbours[0] + neighbours[1] + neighbours[2] + neighbours[3]);
+                height += (mean - here) * fraction * weight;
+                break;
+            }
+            case TerrainBrushMode::Erode: {
+                // An eighth of each excess moves, so no slope overshoots even with all four neighbours flowing
+                float flow = 0.0f;
+                for (float neighbour : neighbours) {
+                    const float difference = neighbour - here;
+                    flow += 0.125f * std::copysign(std::max(fabsf(difference) - slide, 0.0f), difference);
+                }
+                height += flow * fraction * weight;
+                break;
+            }
+            }
+            height = std::clamp(height, -m_heightLimit, m_heightLimit);
+            const float change = fabsf(height - here);
+            if (change <= 0.0f) {
+                continue;
+            }
+
+            m_offsets[point_key(x, z)] = height - base;
+            result.maxChange = std::max(result.maxChange, change);
+            result.changed = { std::min(result.changed.x0, x), std::min(result.changed.z0, z),
+                               std::max(result.changed.x1, x), std::max(result.changed.z1, z) };
+        }
+    }
+
+    if (!result.changed.empty()) {
+        m_bounds = terrain_grid_rect_union(m_bounds, result.changed);
+    }
+    return result;
+}
+
+float TerrainEdits::offset(int x, int z) const {
+    auto it = m_offsets.find(point_key(x, z));
+    return it != m_offsets.end() ? it->second : 0.0f;
+}
+
+float TerrainEdits::offset_at(float x, float z) const {
+    if (m_offsets.empty()) {
+        return 0.0f;
+    }
+    const float gx = x / m_spacing;
+    const float gz = z / m_spacing;
+    const int x0 = (int)floorf(gx);
+    const int z0 = (int)floorf(gz);
+    const float fx = gx - x0;
+    const float fz = gz - z0;
+    const float h0 = offset(x0, z0) * (1.0f - fx) + offset(x0 + 1, z0) * fx;
+    const float h1 = offset(x0, z0 + 1) * (1.0f - fx) + offset(x0 + 1, z0 + 1) * fx;
+    return h0 * (1.0f - fz) + h1 * fz;
+}
+
+void TerrainEdits::apply_offsets(const TerrainGridRect& rect, float* heights) const {
+    const TerrainGridRect edited = terrain_grid_rect_intersect(rect, m_bounds);
+    for (int z = edited.z0; z <= edited.z1; ++z) {
+        for (int x = edited.x0; x <= edited.x1; ++x) {
+            heights[(z - rect.z0) * rect.width() + (x - rect.x0)] += offset(x, z);
+        }
+    }
+}
+
+void TerrainEdits::read_offsets(const TerrainGridRect& rect, float* out) const {
+    std::fill(out, out + (size_t)rect.width() * rect.depth(), 0.0f);
+    const TerrainGridRect edited = terrain_grid_rect_intersect(rect, m_bounds);
+    for (int z = edited.z0; z <= edited.z1; ++z) {
+        for (int x = edited.x0; x <= edited.x1; ++x) {
+            out[(z - rect.z0) * rect.width() + (x - rect.x0)] = offset(x, z);
+        }
+    }
+}
+
+TerrainGridRect TerrainEdits::write_offsets(const TerrainGridRect& rect, const float* offsets) {
+    TerrainGridRect changed = { rect.x1 + 1, rect.z1 + 1, rect.x0 - 1, rect.z0 - 1 };
+    for (int z = rect.z0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x) {
+            const float value = offsets[(z - rect.z0) * rect.width() + (x - rect.x0)];
+            if (value == offset(x, z)) {
+                continue;
+            }
+            if (value == 0.0f) {
+                m_offsets.erase(point_key(x, z));
+            } else {
+                m_offsets[point_key(x, z)] = value;
+            }
+            changed = { std::min(changed.x0, x), std::min(changed.z0, z), std::max(changed.x1, x),
+                        std::max(changed.z1, z) };
+        }
+    }
+    // Dropped points stay inside the bounds, which only need to cover every edited point
+    if (!changed.empty()) {
+        m_bounds = terrain_grid_rect_union(m_bounds, changed);
+    }
+    return changed;
+}
+
+bool TerrainEdits::touches(const TerrainGridRect& rect) const {
+    const TerrainGridRect edited = terrain_grid_rect_intersect(rect, m_bounds);
+    for (int z = edited.z0; z <= edited.z1; ++z) {
+        for (int x = edited.x0; x <= edited.x1; ++x) {
+            if (m_offsets.count(point_key(x, z))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TerrainEdits::points(std::vector<TerrainEditPoint>& points) const {
+    points.clear();
+    points.reserve(m_offsets.size());
+    for (const auto& [key, offset] : m_offsets) {
+        points.push_back({ (int32_t)(uint32_t)(key >> 32), (int32_t)(uint32_t)key, offset });
+    }
+    std::sort(points.begin(), points.end(), [](const TerrainEditPoint& a, const TerrainEditPoint& b) {
+        return a.z != b.z ? a.z < b.z : a.x < b.x;
+    });
+}
+
+TerrainGridRect TerrainEdits::assign(const TerrainEditPoint* points, size_t count) {
+    TerrainGridRect changed = m_bounds;
+    m_offsets.clear();
+    m_bounds = TerrainGridRect();
+    for (size_t i = 0; i < count; ++i) {
+        const TerrainEditPoint& point = points[i];
+        m_offsets[point_key(point.x, point.z)] = point.offset;
+        m_bounds = m_bounds.empty() ? TerrainGridRect{ point.x, point.z, point.x, point.z }
+                                    : TerrainGridRect{ std::min(m_bounds.x0, point.x), std::min(m_bounds.z0, point.z),
+                                                       std::max(m_bounds.x1, point.x), std::max(m_bounds.z1, point.z) };
+    }
+    if (changed.empty()) {
+        return m_bounds;
+    }
+    if (!m_bounds.empty()) {
+        changed = { std::min(changed.x0, m_bounds.x0), std::min(changed.z0, m_bounds.z0),
+                    std::max(changed.x1, m_bounds.x1), std::max(changed.z1, m_bounds.z1) };
+    }
+    return changed;
+}
+
+void terrain_grid_normals(const float* heights, int width, int depth, float spacing, simd::float3* out) {
+    for (int z = 1; z < depth - 1; ++z) {
+        for (int x = 1; x < width - 1; ++x) {
+            const int a = z * width + x;
+            const float heightL = heights[a - 1];
+            const float heightR = heights[a + 1];
+            const float heightD = heights[a - width];
+            const float heightU = heights[a + width];
+            out[(z - 1) * (width - 2) + (x - 1)] =
+                simd::normalize(simd::float3{ (heightL - heightR) / spacing, 2.0f, (heightD - heightU) / spacing });
+        }
+    }
+}
+
+void height_field_apply_edits(HeightField& field, float minX, float minZ, float maxX, float maxZ,
+                              const TerrainEdits& edits, const TerrainParams& terrain,
+                              const TerrainErosion* erosion) {
+    const int x0 = std::max((int)ceilf((minX - field.originX) / field.spacing), 0);
+    const int z0 = std::max((int)ceilf((minZ - field.originZ) / field.spacing), 0);
+    const int x1 = std::min((int)floorf((maxX - field.originX) / field.spacing), field.width - 1);
+    const int z1 = std::min((int)floorf((maxZ - field.originZ) / field.spacing), field.depth - 1);
+    if (x1 < x0 || z1 < z0) {
+        return;
+    }
+
+    const size_t count = (size_t)(x1 - x0 + 1) * (z1 - z0 + 1);
+    std::vector<float> xs(count), zs(count), heights(count);
+    size_t i = 0;
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x, ++i) {
+            xs[i] = field.originX + x * field.spacing;
+            zs[i] = field.originZ + z * field.spacing;
+        }
+    }
+    get_terrain_heights(xs.data(), zs.data(), heights.data(), count, terrain);
+
+    i = 0;
+    for (int z = z0; z <= z1; ++z) {
+        for (int x = x0; x <= x1; ++x, ++i) {
+            const float eroded = erosion ? heights[i] + erosion->offset_at(xs[i], zs[i]) : heights[i];
+            field.heights[z * field.width + x] = eroded + edits.offset_at(xs[i], zs[i]);
+        }
+    }
+}
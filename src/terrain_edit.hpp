@@ -0,0 +1,218 @@
+/**
+ * @file terrain_edit.hpp
+ * @brief Brush edits layered over the procedural terrain, and the normals they invalidate.
+ *
+ * Edits are height offsets on the grid points of the chunk grid, which chunks share along
+ * their borders, so an edit moves the same point in every chunk that holds it. Only edited
+ * points are stored. A brush touches the points within its radius, and the normals that
+ * depend on them lie at most one point further out, so every update an edit causes is
+ * bounded by the brush area.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "height_field.hpp"
+
+class TerrainErosion;
+
+/**
+ * @enum TerrainBrushMode
+ * @brief What a brush does to the heights under it.
+ */
+enum class TerrainBrushMode {
+    Raise,      ///< Adds strength, scaled by the falloff.
+    Lower,      ///< Subtracts strength, scaled by the falloff.
+    Flatten,    ///< Moves towards targetHeight by the fraction strength, scaled by the falloff.
+    Smooth,     ///< Moves towards the mean of the four neighbours by the fraction strength, scaled by the falloff.
+    Erode,      ///< Slides the fraction strength of the excess over the talus slope downhill, scaled by the falloff.
+};
+
+/**
+ * @struct TerrainBrush
+ * @brief One application of a brush.
+ */
+struct TerrainBrush {
+    TerrainBrushMode mode = TerrainBrushMode::Raise; ///< Operation.
+    float centerX = 0.0f;                            ///< World x of the brush centre.
+    float centerZ = 0.0f;                            ///< World z of the brush centre.
+    float radius = 4.0f;                             ///< Points this far from the centre or further are untouched.
+    float strength = 0.25f;                          ///< World units for Raise and Lower; a fraction in [0, 1] for Flatten.
+    float targetHeight = 0.0f;                       ///< Height Flatten moves towards.
+    float talus = 1.0f;                              ///< Height difference per unit distance past which Erode slides.
+};
+
+/**
+ * @struct TerrainGridRect
+ * @brief An inclusive rectangle of grid points; empty when x1 < x0.
+ */
+struct TerrainGridRect {
+    int x0 = 0; ///< First column.
+    int z0 = 0; ///< First row.
+    int x1 = -1; ///< Last column.
+    int z1 = -1; ///< Last row.
+
+    bool empty() const { return x1 < x0 || z1 < z0; }
+    int width() const { return empty() ? 0 : x1 - x0 + 1; }
+    int depth() const { return empty() ? 0 : z1 - z0 + 1; }
+};
+
+/// @return The rectangle grown by border points on every side.
+TerrainGridRect terrain_grid_rect_expand(const TerrainGridRect& rect, int border);
+
+/// @return The points in both rectangles.
+TerrainGridRect terrain_grid_rect_intersect(const TerrainGridRect& a, const TerrainGridRect& b);
+
+/// @return The smallest rectangle covering both; either may be empty.
+TerrainGridRect terrain_grid_rect_union(const TerrainGridRect& a, const TerrainGridRect& b);
+
+/**
+ * @struct TerrainEditResult
+ * @brief What one brush application changed.
+ */
+struct TerrainEditResult {
+    TerrainGridRect changed;    ///< Points whose height moved; empty if none did.
+    float maxChange = 0.0f;     ///< Largest height change of any point.
+};
+
+/**
+ * @struct TerrainEditPoint
+ * @brief The offset of one edited grid point, as saved and restored.
+ */
+struct TerrainEditPoint {
+    int32_t x = 0;          ///< Column.
+    int32_t z = 0;          ///< Row.
+    float offset = 0.0f;    ///< Height added to the procedural terrain.
+};
+
+/**
+ * @brief Returns the brush falloff: 1 at the centre, easing to 0 at the radius.
+ * @param distance The distance from the brush centre.
+ * @param radius The brush radius.
+ * @return The weight in [0, 1].
+ */
+float terrain_brush_weight(float distance, float radius);
+
+/**
+ * @class TerrainEdits
+ * @brief The height offsets brushes have added to the terrain.
+ */
+class TerrainEdits {
+public:
+    /**
+     * @param spacing The world distance between grid points; the chunk size / (resolution - 1).
+     * @param heightLimit Edited heights are kept in [-heightLimit, heightLimit].
+     */
+    TerrainEdits(float spacing, float heightLimit);
+
+    /// @return The world distance between grid points.
+    float spacing() const { return m_spacing; }
+
+    /// @return The largest edited height either side of 0.
+    float height_limit() const { return m_heightLimit; }
+
+    /// @return The grid points a brush can touch.
+    TerrainGridRect brush_rect(const TerrainBrush& brush) const;
+
+    /**
+     * @brief Applies a brush.
+     *
+     * Every point reads the heights as they were before the brush, so Smooth and Erode do not
+     * depend on the order points are visited in; neighbours outside brush_rect() read the
+     * nearest point inside it. The brush kernel of terrain_brush.metal matches this.
+     *
+     * @param brush The brush.
+     * @param baseHeights The unedited heights of brush_rect(brush), row-major.
+     * @return The points that changed.
+     */
+    TerrainEditResult apply(const TerrainBrush& brush, const float* baseHeights);
+
+    /// @return The offset of grid point (x, z); 0 if it was never edited.
+    float offset(int x, int z) const;
+
+    /// @return The offset at world position (x, z), bilinear between grid points.
+    float offset_at(float x, float z) const;
+
+    /**
+     * @brief Adds the offsets of a rectangle to its unedited heights.
+     * @param rect The grid points.
+     * @param heights The unedited heights of rect, row-major; receives the edited ones.
+     */
+    void apply_offsets(const TerrainGridRect& rect, float* heights) const;
+
+    /**
+     * @brief Copies the offsets of a rectangle.
+     * @param rect The grid points.
+     * @param out Receives the offsets of rect, row-major; 0 where a point was never edited.
+     */
+    void read_offsets(const TerrainGridRect& rect, float* out) const;
+
+    /**
+     * @brief Replaces the offsets of a rectangle, e.g. with those a GPU brush computed or an undo restores.
+     * @param rect The grid points.
+     * @param offsets The new offsets of rect, row-major; 0 drops a point's edit.
+     * @return Covers the points whose offset changed; empty if none did.
+     */
+    TerrainGridRect write_offsets(const TerrainGridRect& rect, const float* offsets);
+
+    /// @return True if any point of rect has been edited.
+    bool touches(const TerrainGridRect& rect) const;
+
+    /// @return The number of edited grid points.
+    size_t size() const { return m_offsets.size(); }
+
+    /**
+     * @brief Lists the edited points in row then column order, so equal edits list the same way.
+     * @param points Receives the points; cleared first.
+     */
+    void points(std::vector<TerrainEditPoint>& points) const;
+
+    /**
+     * @brief Replaces every offset, e.g. with the points of a saved world.
+     * @param points The edited points, e.g. as listed by points().
+     * @param count The number of points.
+     * @return Covers every point edited before or after, i.e. whose height may have changed.
+     */
+    TerrainGridRect assign(const TerrainEditPoint* points, size_t count);
+
+private:
+    static uint64_t point_key(int x, int z) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z; }
+
+    float m_spacing;
+    float m_heightLimit;
+    std::unordered_map<uint64_t, float> m_offsets;
+    TerrainGridRect m_bounds;   ///< Covers every edited point.
+};
+
+/**
+ * @brief Computes the normals of the interior points of a height grid.
+ *
+ * Uses the central differences build_terrain_chunk_vertices() uses, so recomputed normals
+ * match freshly generated chunks.
+ *
+ * @param heights width * depth heights, row-major.
+ * @param width Points along X; at least 3.
+ * @param depth Points along Z; at least 3.
+ * @param spacing The world distance between points.
+ * @param out Receives (width - 2) * (depth - 2) normals, row-major.
+ */
+void terrain_grid_normals(const float* heights, int width, int depth, float spacing, simd::float3* out);
+
+/**
+ * @brief Resamples the part of a height field a world-space box covers.
+ * @param field The height field.
+ * @param minX The smallest world x to update.
+ * @param minZ The smallest world z to update.
+ * @param maxX The largest world x to update.
+ * @param maxZ The largest world z to update.
+ * @param edits The edits to add to the unedited terrain height.
+ * @param terrain The terrain generator's tunables.
+ * @param erosion The erosion to add under the edits; nullptr for none.
+ */
+void height_field_apply_edits(HeightField& field, float minX, float minZ, float maxX, float maxZ,
+                              const TerrainEdits& edits, const TerrainParams& terrain = {},
+                              const TerrainErosion* erosion = nullptr);
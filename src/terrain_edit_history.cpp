@@ -0,0 +1,150 @@
+#include "terrain_edit_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mesh_codec.hpp"
+
+namespace {
+    constexpr size_t TILE_POINTS = (size_t)TERRAIN_EDIT_TILE * TERRAIN_EDIT_TILE;
+
+    // -0 reads as +0, as an unedited point does, so a point's bits never depend on how it got to zero
+    uint32_t offset_bits(float offset) {
+        offset = offset == 0.0f ? 0.0f : offset;
+        uint32_t bits;
+        memcpy(&bits, &offset, sizeof(bits));
+        return bits;
+    }
+
+    int tile_of(int point) {
+        return (int)std::floor((float)point / TERRAIN_EDIT_TILE);
+    }
+}
+
+TerrainGridRect terrain_edit_tiles(const TerrainGridRect& rect) {
+    if (rect.empty()) {
+        return rect;
+    }
+    return { tile_of(rect.x0), tile_of(rect.z0), tile_of(rect.x1), tile_of(rect.z1) };
+}
+
+TerrainGridRect terrain_edit_tile_rect(int x, int z) {
+    return { x * TERRAIN_EDIT_TILE, z * TERRAIN_EDIT_TILE, (x + 1) * TERRAIN_EDIT_TILE - 1,
+             (z + 1) * TERRAIN_EDIT_TILE - 1 };
+}
+
+TerrainEditHistory::TerrainEditHistory(size_t byteLimit) : m_byteLimit(byteLimit) {}
+
+void TerrainEditHistory::begin_stroke() {
+    m_stroking = true;
+}
+
+void TerrainEditHistory::touch(const TerrainEdits& edits, const TerrainGridRect& rect) {
+    if (!m_stroking) {
+        return;
+    }
+    const TerrainGridRect tiles = terrain_edit_tiles(rect);
+    for (int z = tiles.z0; z <= tiles.z1; ++z) {
+        for (int x = tiles.x0; x <= tiles.x1; ++x) {
+            std::vector<float>& before = m_before[tile_key(x, z)];
+            if (before.empty()) {
+                before.resize(TILE_POINTS);
+                edits.read_offsets(terrain_edit_tile_rect(x, z), before.data());
+            }
+        }
+    }
+}
+
+bool TerrainEditHistory::end_stroke(const TerrainEdits& edits) {
+    m_stroking = false;
+    TerrainEditStroke stroke;
+    std::vector<float> after(TILE_POINTS);
+    std::vector<uint32_t> delta(TILE_POINTS);
+    for (const auto& [key, before] : m_before) {
+        const int x = (int32_t)(uint32_t)(key >> 32);
+        const int z = (int32_t)(uint32_t)key;
+        edits.read_offsets(terrain_edit_tile_rect(x, z), after.data());
+        bool changed = false;
+        for (size_t i = 0; i < TILE_POINTS; ++i) {
+            delta[i] = offset_bits(before[i]) ^ offset_bits(after[i]);
+            changed = changed || delta[i] != 0;
+        }
+        if (changed) {
+            TerrainEditTileDelta tile = { x, z, encode_vertex_buffer(delta.data(), TILE_POINTS, sizeof(uint32_t)) };
+            stroke.bytes += tile.bits.size();
+            stroke.tiles.push_back(std::move(tile));
+        }
+    }
+    m_before.clear();
+    if (stroke.tiles.empty()) {
+        return false;
+    }
+
+    // The map's order is arbitrary; sorted tiles undo the same way every time
+    std::sort(stroke.tiles.begin(), stroke.tiles.end(),
+              [](const TerrainEditTileDelta& a, const TerrainEditTileDelta& b) {
+                  return a.z != b.z ? a.z < b.z : a.x < b.x;
+              });
+    for (const TerrainEditStroke& undone : m_redo) {
+        m_bytes -= undone.bytes;
+    }
+    m_redo.clear();
+    m_bytes += stroke.bytes;
+    m_undo.push_back(std::move(stroke));
+    while (m_bytes > m_byteLimit && m_undo.size() > 1) {
+        m_bytes -= m_undo.front().bytes;
+        m_undo.pop_front();
+    }
+    return true;
+}
+
+TerrainGridRect TerrainEditHistory::toggle(TerrainEdits& edits, const TerrainEditStroke& stroke) const {
+    TerrainGridRect changed;
+    std::vector<uint32_t> delta(TILE_POINTS);
+    std::vector<float> offsets(TILE_POINTS);
+    for (const TerrainEditTileDelta& tile : stroke.tiles) {
+        // Decoding only fails on corrupt memory; such a tile is left as it is
+        if (!decode_vertex_buffer(tile.bits.data(), tile.bits.size(), delta.data(), TILE_POINTS, sizeof(uint32_t))) {
+            continue;
+        }
+        const TerrainGridRect rect = terrain_edit_tile_rect(tile.x, tile.z);
+        edits.read_offsets(rect, offsets.data());
+        for (size_t i = 0; i < TILE_POINTS; ++i) {
+            const uint32_t bits = offset_bits(offsets[i]) ^ delta[i];
+            memcpy(&offsets[i], &bits, sizeof(bits));
+        }
+        changed = terrain_grid_rect_union(changed, edits.write_offsets(rect, offsets.data()));
+    }
+    return changed;
+}
+
+TerrainGridRect TerrainEditHistory::undo(TerrainEdits& edits) {
+    if (m_undo.empty()) {
+        return {};
+    }
+    TerrainEditStroke stroke = std::move(m_undo.back());
+    m_undo.pop_back();
+    const TerrainGridRect changed = toggle(edits, stroke);
+    m_redo.push_back(std::move(stroke));
+    return changed;
+}
+
+TerrainGridRect TerrainEditHistory::redo(TerrainEdits& edits) {
+    if (m_redo.empty()) {
+        return {};
+    }
+    TerrainEditStroke stroke = std::move(m_redo.back());
+    m_redo.pop_back();
+    const TerrainGridRect changed = toggle(edits, stroke);
+    m_undo.push_back(std::move(stroke));
+    return changed;
+}
+
+void TerrainEditHistory::clear() {
+    m_stroking = false;
+    m_before.clear();
+    m_undo.clear();
+    m_redo.clear();
+    m_bytes = 0;
+}
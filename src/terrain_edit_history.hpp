@@ -0,0 +1,121 @@
+/**
+ * @file terrain_edit_history.hpp
+ * @brief Undo and redo of terrain brush strokes, kept as compressed deltas of the tiles they touched.
+ *
+ * The edit grid is cut into square tiles of TERRAIN_EDIT_TILE points. While a stroke is open,
+ * touch() copies the offsets of every tile a brush is about to change, once per tile; closing
+ * the stroke compares each copy with the offsets the stroke left and keeps their difference as
+ * the exclusive-or of the two floats' bits. Undoing and redoing apply the same exclusive-or, so
+ * both restore the offsets bit for bit, and a tile the brush crossed only in part is zero
+ * outside its path. The deltas are packed with the vertex codec of mesh_codec.hpp, a float per
+ * vertex, whose byte planes and LZ4 pass shrink those runs of zeros to almost nothing.
+ *
+ * History is bounded in bytes: past the limit, the oldest strokes are forgotten.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "terrain_edit.hpp"
+
+/// Grid points along each side of a history tile.
+constexpr int TERRAIN_EDIT_TILE = 32;
+
+/// @return The tiles of TERRAIN_EDIT_TILE points covering a rectangle, as an inclusive rectangle of tile indices.
+TerrainGridRect terrain_edit_tiles(const TerrainGridRect& rect);
+
+/// @return The grid points of tile (x, z).
+TerrainGridRect terrain_edit_tile_rect(int x, int z);
+
+/**
+ * @struct TerrainEditTileDelta
+ * @brief What a stroke changed in one tile.
+ */
+struct TerrainEditTileDelta {
+    int32_t x = 0;              ///< Tile column.
+    int32_t z = 0;              ///< Tile row.
+    std::vector<uint8_t> bits;  ///< Encoded exclusive-or of the offsets before and after, row-major.
+};
+
+/**
+ * @struct TerrainEditStroke
+ * @brief The tiles one stroke changed.
+ */
+struct TerrainEditStroke {
+    std::vector<TerrainEditTileDelta> tiles;    ///< Changed tiles; untouched or unchanged ones are left out.
+    size_t bytes = 0;                           ///< Encoded bytes of every tile.
+};
+
+/**
+ * @class TerrainEditHistory
+ * @brief The strokes that can be undone and redone.
+ */
+class TerrainEditHistory {
+public:
+    /// @param byteLimit Encoded bytes kept across every stroke; the oldest go first past it.
+    explicit TerrainEditHistory(size_t byteLimit = 64u << 20);
+
+    /// Opens a stroke; one already open is closed first by the next end_stroke().
+    void begin_stroke();
+
+    /// @return True between begin_stroke() and end_stroke().
+    bool stroking() const { return m_stroking; }
+
+    /**
+     * @brief Copies the tiles a change is about to reach, unless the open stroke has already.
+     * @param edits The offsets before the change.
+     * @param rect The grid points about to change; ignored without an open stroke.
+     */
+    void touch(const TerrainEdits& edits, const TerrainGridRect& rect);
+
+    /**
+     * @brief Closes the stroke and keeps what it changed; redoing is no longer possible if it changed anything.
+     * @param edits The offsets the stroke left.
+     * @return True if the stroke changed any offset.
+     */
+    bool end_stroke(const TerrainEdits& edits);
+
+    /// @return True if a closed stroke can be undone.
+    bool can_undo() const { return !m_undo.empty(); }
+
+    /// @return True if an undone stroke can be redone.
+    bool can_redo() const { return !m_redo.empty(); }
+
+    /**
+     * @brief Reverts the last stroke; it moves to the redo list.
+     * @param edits The offsets, as the stroke and any redone after it left them.
+     * @return Covers the points whose offset changed; empty if there was nothing to undo.
+     */
+    TerrainGridRect undo(TerrainEdits& edits);
+
+    /**
+     * @brief Applies the last undone stroke again.
+     * @param edits The offsets, as the undo left them.
+     * @return Covers the points whose offset changed; empty if there was nothing to redo.
+     */
+    TerrainGridRect redo(TerrainEdits& edits);
+
+    /// Forgets every stroke, e.g. when a saved world replaces the edits.
+    void clear();
+
+    /// @return Strokes that can be undone.
+    size_t undo_count() const { return m_undo.size(); }
+
+    /// @return Encoded bytes of every stroke kept.
+    size_t bytes() const { return m_bytes; }
+
+private:
+    static uint64_t tile_key(int x, int z) { return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z; }
+    TerrainGridRect toggle(TerrainEdits& edits, const TerrainEditStroke& stroke) const;
+
+    size_t m_byteLimit;
+    size_t m_bytes = 0;
+    bool m_stroking = false;
+    std::unordered_map<uint64_t, std::vector<float>> m_before; ///< Offsets of each tile the open stroke touched.
+    std::deque<TerrainEditStroke> m_undo;                     ///< Oldest first.
+    std::vector<TerrainEditStroke> m_redo;                    ///< Most recently undone last.
+};
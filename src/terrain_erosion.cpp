@@ -0,0 +1,320 @@
+#include "terrain_erosion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+    // Below this depth the water is too thin to give the flow a speed
+    constexpr float MIN_FLOW_DEPTH = 1e-4f;
+
+    int floor_div(int a, int b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    int ceil_div(int a, int b) {
+        return -floor_div(-a, b);
+    }
+
+    // Each stage matches the kernel of the same name in erosion.metal; points are (x, z), row-major
+    struct Stage {
+        const ErosionParams& p;
+        int width() const { return (int)p.width; }
+        int depth() const { return (int)p.depth; }
+        int index(int x, int z) const { return z * width() + x; }
+        bool inside(int x, int z) const { return x >= 0 && z >= 0 && x < width() && z < depth(); }
+    };
+
+    // Pipes fill with the difference of the water surfaces and are scaled so a point never
+    // sends away more water than it holds. Outside the grid the ground continues at the same
+    // height without water, so water drains over the edges rather than pooling there.
+    void erosion_flux(const Stage& s, const float* terrain, const float* water, const simd::float4* flux,
+                      simd::float4* fluxOut) {
+        const ErosionParams& p = s.p;
+        const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (int z = 0; z < s.depth(); ++z) {
+            for (int x = 0; x < s.width(); ++x) {
+                const int i = s.index(x, z);
+                const float depth = water[i] + p.rain * p.timeStep;
+                const float surface = terrain[i] + depth;
+                simd::float4 out = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (int n = 0; n < 4; ++n) {
+                    const int nx = x + offsets[n][0];
+                    const int nz = z + offsets[n][1];
+                    const float neighbour = s.inside(nx, nz)
+                        ? terrain[s.index(nx, nz)] + water[s.index(nx, nz)] + p.rain * p.timeStep
+                        : terrain[i];
+                    out[n] = std::max(0.0f, flux[i][n] + p.timeStep * p.gravity * p.spacing * (surface - neighbour));
+                }
+                const float total = out.x + out.y + out.z + out.w;
+                if (total > 0.0f) {
+                    out = out * std::min(1.0f, depth * p.spacing * p.spacing / (total * p.timeStep));
+                }
+                fluxOut[i] = out;
+            }
+        }
+    }
+
+    void erosion_water(const Stage& s, const float* water, const simd::float4* flux, float* waterOut,
+                       simd::float2* velocity) {
+        const ErosionParams& p = s.p;
+        for (int z = 0; z < s.depth(); ++z) {
+            for (int x = 0; x < s.width(); ++x) {
+                const int i = s.index(x, z);
+                const simd::float4 f = flux[i];
+                const float fromLeft = x > 0 ? flux[i - 1].y : 0.0f;
+                const float fromRight = x + 1 < s.width() ? flux[i + 1].x : 0.0f;
+                const float fromDown = z > 0 ? flux[i - s.width()].w : 0.0f;
+                const float fromUp = z + 1 < s.depth() ? flux[i + s.width()].z : 0.0f;
+                const float before = water[i] + p.rain * p.timeStep;
+                const float net = fromLeft + fromRight + fromDown + fromUp - (f.x + f.y + f.z + f.w);
+                const float after = std::max(0.0f, before + p.timeStep * net / (p.spacing * p.spacing));
+                waterOut[i] = after;
+
+                const float mean = 0.5f * (before + after);
+                const simd::float2 throughput = { 0.5f * (fromLeft - f.x + f.y - fromRight),
+                                                  0.5f * (fromDown - f.z + f.w - fromUp) };
+                velocity[i] = mean > MIN_FLOW_DEPTH ? throughput / (p.spacing * mean) : simd::float2{ 0.0f, 0.0f };
+            }
+        }
+    }
+
+    // The flow carries sediment in proportion to its speed and the slope under it
+    void erosion_sediment(const Stage& s, const float* terrain, const float* sediment, const simd::float2* velocity,
+                          float* terrainOut, float* sedimentOut) {
+        const ErosionParams& p = s.p;
+        for (int z = 0; z < s.depth(); ++z) {
+            for (int x = 0; x < s.width(); ++x) {
+                const int i = s.index(x, z);
+                const int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, s.width() - 1);
+                const int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, s.depth() - 1);
+                const float slopeX = (terrain[s.index(x1, z)] - terrain[s.index(x0, z)]) / ((x1 - x0) * p.spacing);
+                const float slopeZ = (terrain[s.index(x, z1)] - terrain[s.index(x, z0)]) / ((z1 - z0) * p.spacing);
+                const float slopeSq = slopeX * slopeX + slopeZ * slopeZ;
+                const float tilt = std::max(sqrtf(slopeSq / (1.0f + slopeSq)), p.minTilt);
+                const float capacity = p.capacity * tilt * simd::length(velocity[i]);
+
+                const float carried = sediment[i];
+                const float moved = capacity > carried ? p.dissolving * p.timeStep * (capacity - carried)
+                                                       : -p.deposition * p.timeStep * (carried - capacity);
+                terrainOut[i] = terrain[i] - moved;
+                sedimentOut[i] = carried + moved;
+            }
+        }
+    }
+
+    // Sediment is advected back along the flow, and the water evaporates
+    void erosion_transport(const Stage& s, const float* sediment, const simd::float2* velocity, const float* water,
+                           float* sedimentOut, float* waterOut) {
+        const ErosionParams& p = s.p;
+        const float keep = std::max(0.0f, 1.0f - p.evaporation * p.timeStep);
+        for (int z = 0; z < s.depth(); ++z) {
+            for (int x = 0; x < s.width(); ++x) {
+                const int i = s.index(x, z);
+                const simd::float2 from = simd::float2{ (float)x, (float)z } - velocity[i] * (p.timeStep / p.spacing);
+                const float fx = std::clamp(from.x, 0.0f, (float)(s.width() - 1));
+                const float fz = std::clamp(from.y, 0.0f, (float)(s.depth() - 1));
+                const int x0 = std::min((int)fx, s.width() - 2);
+                const int z0 = std::min((int)fz, s.depth() - 2);
+                const float tx = fx - x0;
+                const float tz = fz - z0;
+                const float s0 = sediment[s.index(x0, z0)] * (1.0f - tx) + sediment[s.index(x0 + 1, z0)] * tx;
+                const float s1 = sediment[s.index(x0, z0 + 1)] * (1.0f - tx) + sediment[s.index(x0 + 1, z0 + 1)] * tx;
+                sedimentOut[i] = s0 * (1.0f - tz) + s1 * tz;
+                waterOut[i] = water[i] * keep;
+            }
+        }
+    }
+
+    // Material above the talus slope slides to the lower neighbours. Each point gathers what it
+    // receives and sends along the same pipes its neighbours compute, so the terrain is conserved.
+    void erosion_thermal(const Stage& s, const float* terrain, float* terrainOut) {
+        const ErosionParams& p = s.p;
+        const float rate = 0.25f * std::min(p.thermalRate * p.timeStep, 1.0f);
+        const float limit = p.talus * p.spacing;
+        const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (int z = 0; z < s.depth(); ++z) {
+            for (int x = 0; x < s.width(); ++x) {
+                const int i = s.index(x, z);
+                float change = 0.0f;
+                for (const auto& offset : offsets) {
+                    const int nx = x + offset[0];
+                    const int nz = z + offset[1];
+                    if (!s.inside(nx, nz)) {
+                        continue;
+                    }
+                    const float difference = terrain[s.index(nx, nz)] - terrain[i];
+                    change += rate * (std::max(0.0f, difference - limit) - std::max(0.0f, -difference - limit));
+                }
+                terrainOut[i] = terrain[i] + change;
+            }
+        }
+    }
+}
+
+ErosionParams erosion_params(const ErosionSettings& settings, int width, int depth, float spacing) {
+    ErosionParams params;
+    params.width = (uint32_t)width;
+    params.depth = (uint32_t)depth;
+    params.spacing = spacing;
+    params.timeStep = settings.timeStep;
+    params.rain = settings.rain;
+    params.evaporation = settings.evaporation;
+    params.capacity = settings.capacity;
+    params.dissolving = settings.dissolving;
+    params.deposition = settings.deposition;
+    params.minTilt = settings.minTilt;
+    params.talus = settings.talus;
+    params.thermalRate = settings.thermalRate;
+    params.gravity = settings.gravity;
+    return params;
+}
+
+ErosionGrid create_erosion_grid(const float* heights, const ErosionParams& params) {
+    const size_t count = (size_t)params.width * params.depth;
+    ErosionGrid grid;
+    grid.params = params;
+    grid.terrain.assign(heights, heights + count);
+    grid.water.assign(count, 0.0f);
+    grid.sediment.assign(count, 0.0f);
+    grid.flux.assign(count, simd::float4{ 0.0f, 0.0f, 0.0f, 0.0f });
+    grid.velocity.assign(count, simd::float2{ 0.0f, 0.0f });
+    return grid;
+}
+
+void erosion_step(ErosionGrid& grid) {
+    const Stage stage{ grid.params };
+    const size_t count = grid.terrain.size();
+    std::vector<simd::float4> flux(count);
+    std::vector<float> water(count), terrain(count), sediment(count);
+
+    erosion_flux(stage, grid.terrain.data(), grid.water.data(), grid.flux.data(), flux.data());
+    erosion_water(stage, grid.water.data(), flux.data(), water.data(), grid.velocity.data());
+    erosion_sediment(stage, grid.terrain.data(), grid.sediment.data(), grid.velocity.data(), terrain.data(),
+                     sediment.data());
+    erosion_transport(stage, sediment.data(), grid.velocity.data(), water.data(), grid.sediment.data(),
+                      grid.water.data());
+    erosion_thermal(stage, terrain.data(), grid.terrain.data());
+    grid.flux = std::move(flux);
+}
+
+void erode_heights(float* heights, int width, int depth, float spacing, const ErosionSettings& settings) {
+    ErosionGrid grid = create_erosion_grid(heights, erosion_params(settings, width, depth, spacing));
+    for (uint32_t i = 0; i < settings.iterations; ++i) {
+        erosion_step(grid);
+    }
+    std::copy(grid.terrain.begin(), grid.terrain.end(), heights);
+}
+
+TerrainGridRect erosion_window_rect(ChunkKey corner, int cells) {
+    return { (corner.x - 1) * cells, (corner.z - 1) * cells, (corner.x + 1) * cells, (corner.z + 1) * cells };
+}
+
+std::vector<float> erosion_window_offsets(const float* uneroded, const float* eroded, int cells, int margin) {
+    const int size = 2 * cells + 1;
+    const int simulated = size + 2 * margin;
+    std::vector<float> offsets((size_t)size * size);
+    for (int z = 0; z < size; ++z) {
+        for (int x = 0; x < size; ++x) {
+            const int i = (z + margin) * simulated + x + margin;
+            offsets[z * size + x] = eroded[i] - uneroded[i];
+        }
+    }
+    return offsets;
+}
+
+TerrainErosion::TerrainErosion(const ErosionSettings& settings, int cells, float spacing)
+    : m_settings(settings), m_cells(cells), m_spacing(spacing) {}
+
+TerrainGridRect TerrainErosion::simulated_rect(ChunkKey corner) const {
+    return terrain_grid_rect_expand(erosion_window_rect(corner, m_cells), m_settings.margin);
+}
+
+void TerrainErosion::missing_windows(const TerrainGridRect& rect, std::vector<ChunkKey>& out) const {
+    out.clear();
+    if (!enabled() || rect.empty()) {
+        return;
+    }
+    // A window's tent is non-zero strictly inside its rectangle
+    for (int z = floor_div(rect.z0, m_cells); z <= ceil_div(rect.z1, m_cells); ++z) {
+        for (int x = floor_div(rect.x0, m_cells); x <= ceil_div(rect.x1, m_cells); ++x) {
+            if (!m_windows.count({ x, z })) {
+                out.push_back({ x, z });
+            }
+        }
+    }
+}
+
+void TerrainErosion::store(ChunkKey corner, std::vector<float> offsets) {
+    m_windows[corner] = std::move(offsets);
+}
+
+const std::vector<float>* TerrainErosion::window(ChunkKey corner) const {
+    auto it = m_windows.find(corner);
+    return it != m_windows.end() ? &it->second : nullptr;
+}
+
+float TerrainErosion::window_offset(ChunkKey corner, int x, int z) const {
+    auto it = m_windows.find(corner);
+    if (it == m_windows.end()) {
+        return 0.0f;
+    }
+    const int size = 2 * m_cells + 1;
+    return it->second[(size_t)(z - (corner.z - 1) * m_cells) * size + (x - (corner.x - 1) * m_cells)];
+}
+
+float TerrainErosion::offset(int x, int z) const {
+    if (m_windows.empty()) {
+        return 0.0f;
+    }
+    // The corners around the point, in a fixed order so every chunk sums them alike
+    const int cx = floor_div(x, m_cells);
+    const int cz = floor_div(z, m_cells);
+    const float tx = (float)(x - cx * m_cells) / m_cells;
+    const float tz = (float)(z - cz * m_cells) / m_cells;
+    const float h0 = window_offset({ cx, cz }, x, z) * (1.0f - tx) + window_offset({ cx + 1, cz }, x, z) * tx;
+    const float h1 = window_offset({ cx, cz + 1 }, x, z) * (1.0f - tx) + window_offset({ cx + 1, cz + 1 }, x, z) * tx;
+    return h0 * (1.0f - tz) + h1 * tz;
+}
+
+float TerrainErosion::offset_at(float x, float z) const {
+    if (m_windows.empty()) {
+        return 0.0f;
+    }
+    const float gx = x / m_spacing;
+    const float gz = z / m_spacing;
+    const int x0 = (int)floorf(gx);
+    const int z0 = (int)floorf(gz);
+    const float fx = gx - x0;
+    const float fz = gz - z0;
+    const float h0 = offset(x0, z0) * (1.0f - fx) + offset(x0 + 1, z0) * fx;
+    const float h1 = offset(x0, z0 + 1) * (1.0f - fx) + offset(x0 + 1, z0 + 1) * fx;
+    return h0 * (1.0f - fz) + h1 * fz;
+}
+
+void TerrainErosion::apply_offsets(const TerrainGridRect& rect, float* heights) const {
+    if (m_windows.empty()) {
+        return;
+    }
+    for (int z = rect.z0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x) {
+            heights[(z - rect.z0) * rect.width() + (x - rect.x0)] += offset(x, z);
+        }
+    }
+}
+
+void TerrainErosion::trim(ChunkKey center, int radius) {
+    for (auto it = m_windows.begin(); it != m_windows.end();) {
+        const int dx = it->first.x - center.x;
+        const int dz = it->first.z - center.z;
+        it = dx * dx + dz * dz > radius * radius ? m_windows.erase(it) : std::next(it);
+    }
+}
+
+size_t TerrainErosion::bytes() const {
+    size_t bytes = 0;
+    for (const auto& [corner, offsets] : m_windows) {
+        bytes += offsets.capacity() * sizeof(float);
+    }
+    return bytes;
+}
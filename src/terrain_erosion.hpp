@@ -0,0 +1,205 @@
+/**
+ * @file terrain_erosion.hpp
+ * @brief Hydraulic and thermal erosion of the terrain, simulated once per window of the chunk grid.
+ *
+ * The simulation is the virtual-pipe shallow-water model with sediment transport. Each step
+ * rains onto the grid, lets water flow through pipes to the four neighbours in proportion to
+ * the difference of their water surfaces, dissolves terrain where the flow can carry more
+ * sediment than it holds and deposits it where it can carry less, carries the sediment along
+ * with the flow, evaporates some water, and finally slides material down slopes steeper than
+ * the talus slope. The GPU runs one kernel of erosion.metal per stage; erosion_step() is the
+ * CPU reference they match. More iterations carve deeper channels, so the count is the
+ * quality knob, and 0 turns erosion off.
+ *
+ * Erosion is not local, so unlike the noise it cannot be evaluated per chunk. The terrain is
+ * eroded in windows centred on the corners of the chunk grid instead, each spanning the four
+ * chunks around its corner plus a margin that is simulated and thrown away, so water and
+ * sediment cross the window's edges. A window keeps the offsets erosion added to the noise,
+ * and a grid point takes the offsets of the windows around it weighted by bilinear tents that
+ * sum to one, so chunks agree on their shared borders and windows blend without seams.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "landscape.hpp"
+#include "terrain_edit.hpp"
+
+/**
+ * @struct ErosionSettings
+ * @brief Tunables of the erosion simulation; rates are per second of simulated time.
+ */
+struct ErosionSettings {
+    uint32_t iterations = 0;    ///< Steps simulated per window; 0 leaves the terrain uneroded.
+    int margin = 16;            ///< Grid points simulated past each window edge and discarded.
+    float timeStep = 0.05f;     ///< Simulated seconds per step.
+    float rain = 0.2f;          ///< Water depth added to every point per second.
+    float evaporation = 0.5f;   ///< Fraction of the water evaporated per second.
+    float capacity = 0.01f;     ///< Sediment carried per unit of flow speed on a unit slope.
+    float dissolving = 0.5f;    ///< Fraction of the missing sediment dissolved per second.
+    float deposition = 0.5f;    ///< Fraction of the excess sediment deposited per second.
+    float minTilt = 0.05f;      ///< Sine of the slope flatter ground carries sediment as if it had.
+    float talus = 1.2f;         ///< Height difference per unit distance past which material slides.
+    float thermalRate = 0.5f;   ///< Fraction of the excess over the talus slope moved per second.
+    float gravity = 9.81f;      ///< Acceleration of the water.
+};
+
+/**
+ * @struct ErosionParams
+ * @brief The settings of one simulated grid; matches ErosionParams in erosion.metal.
+ */
+struct ErosionParams {
+    uint32_t width;     ///< Points along X.
+    uint32_t depth;     ///< Points along Z.
+    float spacing;      ///< World distance between points.
+    float timeStep;     ///< The rest as in ErosionSettings.
+    float rain;
+    float evaporation;
+    float capacity;
+    float dissolving;
+    float deposition;
+    float minTilt;
+    float talus;
+    float thermalRate;
+    float gravity;
+};
+
+/// @return The parameters of a width by depth grid with the given spacing.
+ErosionParams erosion_params(const ErosionSettings& settings, int width, int depth, float spacing);
+
+/**
+ * @struct ErosionGrid
+ * @brief The simulation state of every point of a grid, row-major by z.
+ */
+struct ErosionGrid {
+    ErosionParams params;
+    std::vector<float> terrain;             ///< Height of the ground.
+    std::vector<float> water;               ///< Depth of the water on it.
+    std::vector<float> sediment;            ///< Suspended sediment.
+    std::vector<simd::float4> flux;         ///< Outflow per second towards -x, +x, -z and +z.
+    std::vector<simd::float2> velocity;     ///< Flow velocity in world units per second.
+};
+
+/**
+ * @brief Starts a simulation on dry terrain.
+ * @param heights width * depth heights, row-major.
+ * @param params The grid's parameters, from erosion_params().
+ * @return The grid, without water or sediment.
+ */
+ErosionGrid create_erosion_grid(const float* heights, const ErosionParams& params);
+
+/// Advances a grid by one step; the CPU reference of the erosion kernels.
+void erosion_step(ErosionGrid& grid);
+
+/**
+ * @brief Erodes a height grid on the CPU.
+ * @param heights width * depth heights, row-major; receives the eroded ones.
+ * @param width Points along X; at least 2.
+ * @param depth Points along Z; at least 2.
+ * @param spacing The world distance between points.
+ * @param settings The simulation; runs settings.iterations steps.
+ */
+void erode_heights(float* heights, int width, int depth, float spacing, const ErosionSettings& settings);
+
+/**
+ * @brief Returns the grid points of an erosion window.
+ * @param corner The chunk grid corner at its centre; corner (x, z) is the first point of chunk (x, z).
+ * @param cells Grid cells along a chunk edge; the chunk resolution - 1.
+ * @return The points of the four chunks around the corner, without the margin.
+ */
+TerrainGridRect erosion_window_rect(ChunkKey corner, int cells);
+
+/**
+ * @brief Crops the offsets a window keeps out of its simulated grid.
+ * @param uneroded The heights the simulation started from, over the window grown by margin points.
+ * @param eroded The heights it ended with.
+ * @param cells Grid cells along a chunk edge.
+ * @param margin The margin the window was simulated with.
+ * @return Eroded minus uneroded heights of erosion_window_rect(), row-major.
+ */
+std::vector<float> erosion_window_offsets(const float* uneroded, const float* eroded, int cells, int margin);
+
+/**
+ * @class TerrainErosion
+ * @brief The height offsets of the eroded windows, blended into the terrain.
+ *
+ * Windows that have not been stored count as uneroded, so callers store every window of
+ * missing_windows() before reading offsets they must agree on.
+ */
+class TerrainErosion {
+public:
+    /**
+     * @param settings The simulation the windows are eroded with.
+     * @param cells Grid cells along a chunk edge; the chunk resolution - 1.
+     * @param spacing The world distance between grid points.
+     */
+    TerrainErosion(const ErosionSettings& settings, int cells, float spacing);
+
+    /// @return True if the terrain is eroded at all.
+    bool enabled() const { return m_settings.iterations > 0; }
+
+    /// @return The simulation the windows are eroded with.
+    const ErosionSettings& settings() const { return m_settings; }
+
+    /// @return The world distance between grid points.
+    float spacing() const { return m_spacing; }
+
+    /// @return The points a window's simulation covers: erosion_window_rect() grown by the margin.
+    TerrainGridRect simulated_rect(ChunkKey corner) const;
+
+    /**
+     * @brief Lists the windows the offsets of a rectangle depend on that are not stored yet.
+     * @param rect The grid points.
+     * @param out Receives the windows' corners; cleared first.
+     */
+    void missing_windows(const TerrainGridRect& rect, std::vector<ChunkKey>& out) const;
+
+    /**
+     * @brief Keeps the offsets of a window, replacing any it had.
+     * @param corner The window's corner.
+     * @param offsets Its erosion_window_offsets().
+     */
+    void store(ChunkKey corner, std::vector<float> offsets);
+
+    /// @return The offsets of a stored window, or nullptr.
+    const std::vector<float>* window(ChunkKey corner) const;
+
+    /// @return The blended offset of grid point (x, z).
+    float offset(int x, int z) const;
+
+    /// @return The offset at world position (x, z), bilinear between grid points.
+    float offset_at(float x, float z) const;
+
+    /**
+     * @brief Adds the offsets of a rectangle to its uneroded heights.
+     * @param rect The grid points.
+     * @param heights The uneroded heights of rect, row-major; receives the eroded ones.
+     */
+    void apply_offsets(const TerrainGridRect& rect, float* heights) const;
+
+    /**
+     * @brief Drops windows far from a chunk; they are eroded or loaded again when needed.
+     * @param center The chunk the kept windows are around.
+     * @param radius Windows whose corner is more than this many chunks away are dropped.
+     */
+    void trim(ChunkKey center, int radius);
+
+    /// @return The number of stored windows.
+    size_t size() const { return m_windows.size(); }
+
+    /// @return CPU bytes of the stored offsets.
+    size_t bytes() const;
+
+private:
+    float window_offset(ChunkKey corner, int x, int z) const;
+
+    ErosionSettings m_settings;
+    int m_cells;
+    float m_spacing;
+    std::unordered_map<ChunkKey, std::vector<float>, ChunkKeyHash> m_windows;
+};
@@ -0,0 +1,84 @@
+#include "terrain_height_map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "affine.hpp"
+
+namespace {
+    int8_t to_snorm8(float value) {
+        return (int8_t)lrintf(std::clamp(value, -1.0f, 1.0f) * 127.0f);
+    }
+}
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const uint32_t magnitude = bits & 0x7fffffff;
+
+    if (magnitude >= 0x7f800000) {
+        // Infinity stays infinity; NaN keeps a mantissa bit
+        return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 : 0);
+    }
+    if (magnitude >= 0x477ff000) {
+        // Rounds past 65504
+        return sign | 0x7c00;
+    }
+    if (magnitude < 0x38800000) {
+        // Subnormal half: let the FPU round the value onto the 2^-24 grid
+        float absolute;
+        memcpy(&absolute, &magnitude, sizeof(absolute));
+        return sign | (uint16_t)lrintf(absolute * 16777216.0f);
+    }
+
+    // Rebias the exponent and round the 13 dropped mantissa bits to nearest even
+    const uint32_t rebiased = magnitude - ((127 - 15) << 23);
+    const uint32_t rounded = rebiased + 0xfff + ((rebiased >> 13) & 1);
+    return sign | (uint16_t)(rounded >> 13);
+}
+
+float half_to_float(uint16_t bits) {
+    const uint32_t sign = (uint32_t)(bits & 0x8000) << 16;
+    const uint32_t exponent = (bits >> 10) & 0x1f;
+    const uint32_t mantissa = bits & 0x3ff;
+
+    float value;
+    if (exponent == 0) {
+        value = mantissa / 16777216.0f;
+        return sign ? -value : value;
+    }
+    const uint32_t result = exponent == 0x1f ? sign | 0x7f800000 | (mantissa << 13)
+                                             : sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    memcpy(&value, &result, sizeof(value));
+    return value;
+}
+
+void encode_terrain_height_map(const Vertex* vertices, int resolution, TerrainHeightMap& out) {
+    const size_t count = (size_t)resolution * resolution;
+    out.resolution = resolution;
+    out.heights.resize(count);
+    out.normals.resize(count * 2);
+    for (size_t i = 0; i < count; ++i) {
+        out.heights[i] = float_to_half(vertices[i].position.y);
+        encode_terrain_normal(vertices[i].normal, &out.normals[i * 2]);
+    }
+}
+
+void encode_terrain_normal(simd::float3 normal, int8_t encoded[2]) {
+    encoded[0] = to_snorm8(normal.x);
+    encoded[1] = to_snorm8(normal.z);
+}
+
+simd::float3 decode_terrain_normal(const int8_t encoded[2]) {
+    const float x = std::max(encoded[0] / 127.0f, -1.0f);
+    const float z = std::max(encoded[1] / 127.0f, -1.0f);
+    const float y = sqrtf(std::max(1.0f - x * x - z * z, 0.0f));
+    return simd::normalize(simd::float3{ x, y, z });
+}
+
+simd::float4x4 terrain_height_map_matrix(int chunkX, int chunkZ, int resolution, float chunkSize) {
+    const float step = chunkSize / (float)(resolution - 1);
+    return affine_matrix(affine_translation_scale(chunkX * chunkSize, 0.0f, chunkZ * chunkSize, step, 1.0f, step));
+}
@@ -0,0 +1,75 @@
+/**
+ * @file terrain_height_map.hpp
+ * @brief Terrain chunks stored as height and normal texels instead of vertices.
+ *
+ * The XZ positions of a chunk's vertices are a regular grid, so in height-map mode a chunk
+ * keeps only an r16Float height and an rg8Snorm normal per grid point, 4 bytes instead of
+ * the 32 of a Vertex. landscape_vertex_heightmap rebuilds the grid position from the
+ * vertex ID and fetches the rest from the two textures.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <vector>
+
+#include "objects.hpp"
+
+/// Bytes per grid point of a height map: a half-float height and two snorm8 normal components.
+constexpr size_t TERRAIN_HEIGHT_MAP_TEXEL_BYTES = sizeof(uint16_t) + 2 * sizeof(int8_t);
+
+/**
+ * @struct TerrainHeightMap
+ * @brief The texels of one chunk, row-major with rows along Z.
+ */
+struct TerrainHeightMap {
+    int resolution = 0;             ///< Texels along each edge; the chunk's vertex resolution.
+    std::vector<uint16_t> heights;  ///< r16Float world space heights.
+    std::vector<int8_t> normals;    ///< rg8Snorm X and Z of the unit normal; Y is rebuilt as positive.
+};
+
+/**
+ * @brief Converts a float to IEEE half precision, rounding to nearest even.
+ * @param value The value; magnitudes past the half range become infinity.
+ * @return The half-float bits.
+ */
+uint16_t float_to_half(float value);
+
+/**
+ * @brief Converts IEEE half precision bits to a float.
+ * @param bits The half-float bits.
+ * @return The value.
+ */
+float half_to_float(uint16_t bits);
+
+/**
+ * @brief Encodes a chunk's vertices, e.g. from build_terrain_chunk_vertices(), into texels.
+ * @param vertices resolution * resolution vertices, row-major with rows along Z.
+ * @param resolution The number of vertices along each edge.
+ * @param out Receives the texels.
+ */
+void encode_terrain_height_map(const Vertex* vertices, int resolution, TerrainHeightMap& out);
+
+/**
+ * @brief Encodes a unit normal into a normal texel.
+ * @param normal The unit normal.
+ * @param encoded Receives the snorm8 X and Z components.
+ */
+void encode_terrain_normal(simd::float3 normal, int8_t encoded[2]);
+
+/**
+ * @brief Decodes a normal texel, as the vertex shader does.
+ * @param encoded The snorm8 X and Z components.
+ * @return The unit normal, pointing up.
+ */
+simd::float3 decode_terrain_normal(const int8_t encoded[2]);
+
+/**
+ * @brief Returns the model matrix of a height-map chunk.
+ * @param chunkX The chunk coordinate along X.
+ * @param chunkZ The chunk coordinate along Z.
+ * @param resolution The number of texels along each edge.
+ * @param chunkSize The edge length of a chunk in world units.
+ * @return Maps (column, height, row) to world space.
+ */
+simd::float4x4 terrain_height_map_matrix(int chunkX, int chunkZ, int resolution, float chunkSize);
@@ -0,0 +1,66 @@
+#include "terrain_horizon.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TerrainHorizonUniforms terrain_horizon_uniforms(float chunkSize, uint32_t tiles, float cascadeEnd,
+                                                const HorizonSettings& settings) {
+    TerrainHorizonUniforms uniforms = {};
+    uniforms.chunkSize = chunkSize;
+    uniforms.tiles = tiles;
+    uniforms.tileTexels = HORIZON_TILE_TEXELS;
+    uniforms.atlasTexels = (float)(tiles * HORIZON_TILE_TEXELS);
+    uniforms.cascadeEnd = cascadeEnd;
+    // Without cascades there is nothing to fade from
+    uniforms.fadeDepth = cascadeEnd > 0.0f ? std::min(settings.fadeDepth, cascadeEnd) : 0.0f;
+    uniforms.softness = settings.softness;
+    return uniforms;
+}
+
+float terrain_horizon_step_distance(const HorizonSettings& settings, uint32_t step) {
+    // Step lengths grow geometrically from firstStep; the distance is their sum
+    if (std::abs(settings.stepGrowth - 1.0f) < 1e-6f) {
+        return settings.firstStep * (float)(step + 1);
+    }
+    return settings.firstStep * (std::pow(settings.stepGrowth, (float)(step + 1)) - 1.0f) /
+           (settings.stepGrowth - 1.0f);
+}
+
+void terrain_horizon_sines(const TerrainParams& params, float x, float z, const HorizonSettings& settings,
+                           float sines[HORIZON_DIRECTIONS]) {
+    const float origin = get_terrain_height(x, z, params);
+    for (uint32_t d = 0; d < HORIZON_DIRECTIONS; ++d) {
+        const float angle = 2.0f * (float)M_PI * (float)d / (float)HORIZON_DIRECTIONS;
+        const float dx = std::cos(angle);
+        const float dz = std::sin(angle);
+        // Below the flat horizon the surface's own normal already turns the light away
+        float slope = 0.0f;
+        for (uint32_t step = 0; step < settings.steps; ++step) {
+            const float distance = terrain_horizon_step_distance(settings, step);
+            const float height = get_terrain_height(x + dx * distance, z + dz * distance, params);
+            slope = std::max(slope, (height - origin) / distance);
+        }
+        sines[d] = slope / std::sqrt(1.0f + slope * slope);
+    }
+}
+
+float terrain_horizon_visibility(const float sines[HORIZON_DIRECTIONS], simd::float3 lightDirection,
+                                 float softness) {
+    const float length = simd::length(lightDirection);
+    if (length <= 0.0f) {
+        return 1.0f;
+    }
+    // The sun's azimuth in directions, between the two stored either side of it
+    float azimuth = std::atan2(lightDirection.z, lightDirection.x) * (float)HORIZON_DIRECTIONS / (2.0f * (float)M_PI);
+    azimuth -= (float)HORIZON_DIRECTIONS * std::floor(azimuth / (float)HORIZON_DIRECTIONS);
+    const uint32_t below = std::min((uint32_t)azimuth, HORIZON_DIRECTIONS - 1);
+    const uint32_t above = (below + 1) % HORIZON_DIRECTIONS;
+    const float t = azimuth - (float)below;
+    const float horizon = sines[below] + (sines[above] - sines[below]) * t;
+
+    // smoothstep(horizon - softness, horizon + softness, elevation), as the shader computes it
+    const float elevation = lightDirection.y / length;
+    const float width = std::max(2.0f * softness, 1e-6f);
+    const float s = std::clamp((elevation - (horizon - softness)) / width, 0.0f, 1.0f);
+    return s * s * (3.0f - 2.0f * s);
+}
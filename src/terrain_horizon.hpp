@@ -0,0 +1,99 @@
+/**
+ * @file terrain_horizon.hpp
+ * @brief Horizon maps: how high the terrain rises around each point, baked once per chunk, for soft self-shadowing.
+ *
+ * For a point on the terrain, the horizon in a direction is the steepest elevation any terrain
+ * further along that direction reaches; the sun is hidden while it stands below it. A chunk's
+ * horizon tile holds, per texel, the sine of that elevation in HORIZON_DIRECTIONS directions
+ * around the compass, found by marching outwards with steps that grow geometrically, so near
+ * bumps are resolved finely and distant ridges are still caught. Shading then costs two taps
+ * and an interpolation between the two directions either side of the sun's azimuth, with no
+ * shadow map: the landscape fragments use it where the cascades end, so the cascades only have
+ * to cover the ground near the camera (see gpu_terrain_horizon.hpp).
+ *
+ * The sines are stored in two RGBA8 slices, directions 0-3 and 4-7. Tiles are addressed like the
+ * material atlas's (see terrain_material.hpp): chunk (x, z) owns tile (x mod tiles, z mod tiles),
+ * with texels on the chunk's borders, but at HORIZON_TILE_TEXELS per edge whatever the chunk
+ * resolution, since the horizon varies slowly and is only read in the distance.
+ *
+ * terrain_horizon_sines() and terrain_horizon_visibility() are the CPU reference of the bake
+ * kernel and of the shader's lookup.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "landscape.hpp"
+
+/// Compass directions of a horizon texel; direction i points along (cos, sin)(2 pi i / HORIZON_DIRECTIONS) in x, z.
+constexpr uint32_t HORIZON_DIRECTIONS = 8;
+
+/// Texels along each horizon tile edge.
+constexpr uint32_t HORIZON_TILE_TEXELS = 17;
+
+/// Fragment buffer index of TerrainHorizonUniforms in the landscape pipelines.
+constexpr uint32_t TERRAIN_HORIZON_BUFFER_INDEX = 14;
+
+/**
+ * @struct HorizonSettings
+ * @brief How far and how finely the bake marches, and how soft the shadow edge is.
+ */
+struct HorizonSettings {
+    uint32_t steps = 16;        ///< Samples along each direction.
+    float firstStep = 0.5f;     ///< World distance of the first sample.
+    float stepGrowth = 1.35f;   ///< Ratio between consecutive sample distances; 16 steps reach about 170 units.
+    float softness = 0.08f;     ///< Half-width, in sine of elevation, of the penumbra around the horizon.
+    float fadeDepth = 20.0f;    ///< View depth over which the horizon takes over from the last cascade.
+};
+
+/**
+ * @struct TerrainHorizonUniforms
+ * @brief What the shader needs to find and apply a chunk's horizons; matches TerrainHorizonUniforms in shaders.metal.
+ */
+struct TerrainHorizonUniforms {
+    float chunkSize;        ///< World units along each chunk edge.
+    uint32_t tiles;         ///< Tiles along each side of the atlas.
+    uint32_t tileTexels;    ///< Texels along each tile edge, HORIZON_TILE_TEXELS.
+    float atlasTexels;      ///< Texels along each side of the atlas.
+    float cascadeEnd;       ///< View depth where the shadow cascades end; 0 without them.
+    float fadeDepth;        ///< View depth before cascadeEnd where the horizon starts to take over.
+    float softness;         ///< HorizonSettings::softness.
+    float padding;
+};
+
+/**
+ * @brief Fills the shader's constants.
+ * @param chunkSize World units along each chunk edge.
+ * @param tiles Tiles along each side of the atlas.
+ * @param cascadeEnd View depth the shadow cascades cover; 0 if there are none.
+ * @param settings The horizon settings.
+ * @return The uniforms.
+ */
+TerrainHorizonUniforms terrain_horizon_uniforms(float chunkSize, uint32_t tiles, float cascadeEnd,
+                                                const HorizonSettings& settings = {});
+
+/// @return World distance of sample step (from 0) along a direction.
+float terrain_horizon_step_distance(const HorizonSettings& settings, uint32_t step);
+
+/**
+ * @brief Finds the horizon around a terrain point, as the bake kernel does.
+ * @param params The terrain generator's tunables.
+ * @param x The point's world x.
+ * @param z The point's world z.
+ * @param settings The horizon settings.
+ * @param sines Receives the sine of the horizon's elevation in each direction, in [0, 1].
+ */
+void terrain_horizon_sines(const TerrainParams& params, float x, float z, const HorizonSettings& settings,
+                           float sines[HORIZON_DIRECTIONS]);
+
+/**
+ * @brief How much of the sun a point sees over its horizon, as the shader computes it.
+ * @param sines The point's horizon, as from terrain_horizon_sines().
+ * @param lightDirection Towards the light; need not be normalized.
+ * @param softness Half-width of the penumbra, in sine of elevation.
+ * @return Visibility in [0, 1]: 0 with the sun well below the horizon, 1 well above it.
+ */
+float terrain_horizon_visibility(const float sines[HORIZON_DIRECTIONS], simd::float3 lightDirection,
+                                 float softness);
@@ -0,0 +1,187 @@
+#include "terrain_lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "vertex_cache.hpp"
+
+int terrain_lod_level_count(int resolution) {
+    int levels = 1;
+    while ((1 << levels) <= resolution - 1 && levels < MAX_TERRAIN_LOD_LEVELS) {
+        ++levels;
+    }
+    return levels;
+}
+
+TerrainLodIndices build_terrain_lod_indices(int resolution) {
+    TerrainLodIndices lod;
+    lod.resolution = resolution;
+    lod.levelCount = terrain_lod_level_count(resolution);
+    lod.ranges.resize(lod.levelCount * TERRAIN_STITCH_MASKS);
+
+    const int last = resolution - 1;
+
+    for (int level = 0; level < lod.levelCount; ++level) {
+        const int step = 1 << level;
+
+        for (uint32_t mask = 0; mask < TERRAIN_STITCH_MASKS; ++mask) {
+            // Odd vertices of this level on a stitched edge snap to their even predecessor
+            auto vertex = [&](int x, int z) -> uint32_t {
+                bool oddX = (x / step) % 2 == 1;
+                bool oddZ = (z / step) % 2 == 1;
+                if ((mask & STITCH_NEG_Z) && z == 0 && oddX) x -= step;
+                if ((mask & STITCH_POS_Z) && z == last && oddX) x -= step;
+                if ((mask & STITCH_NEG_X) && x == 0 && oddZ) z -= step;
+                if ((mask & STITCH_POS_X) && x == last && oddZ) z -= step;
+                return (uint32_t)(z * resolution + x);
+            };
+
+            auto emit = [&](uint32_t a, uint32_t b, uint32_t c) {
+                if (a != b && b != c && a != c) {
+                    lod.indices.insert(lod.indices.end(), { a, b, c });
+                }
+            };
+
+            IndexRange& range = lod.ranges[level * TERRAIN_STITCH_MASKS + mask];
+            range.offset = (uint32_t)lod.indices.size();
+
+            // Cells are walked in vertical stripes for vertex cache reuse, as in build_landscape
+            const int stripeWidth = GRID_STRIPE_WIDTH * step;
+            for (int stripe = 0; stripe < last; stripe += stripeWidth) {
+                const int stripeEnd = std::min(stripe + stripeWidth, last);
+                for (int z = 0; z < last; z += step) {
+                    for (int x = stripe; x < stripeEnd; x += step) {
+                        uint32_t i0 = vertex(x, z);
+                        uint32_t i1 = vertex(x + step, z);
+                        uint32_t i2 = vertex(x, z + step);
+                        uint32_t i3 = vertex(x + step, z + step);
+
+                        emit(i0, i2, i1);
+                        emit(i1, i2, i3);
+                    }
+                }
+            }
+
+            range.count = (uint32_t)lod.indices.size() - range.offset;
+        }
+    }
+
+    return lod;
+}
+
+ChunkLodInfo compute_chunk_lod_info(const std::vector<Vertex>& vertices, int resolution) {
+    std::vector<float> heights(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        heights[i] = vertices[i].position.y;
+    }
+    return compute_chunk_lod_info(heights.data(), resolution);
+}
+
+ChunkLodInfo compute_chunk_lod_info(const float* heights, int resolution) {
+    ChunkLodInfo info;
+    info.levelCount = terrain_lod_level_count(resolution);
+    info.minHeight = heights[0];
+    info.maxHeight = heights[0];
+    for (int i = 0; i < resolution * resolution; ++i) {
+        info.minHeight = std::min(info.minHeight, heights[i]);
+        info.maxHeight = std::max(info.maxHeight, heights[i]);
+    }
+
+    auto height = [&](int x, int z) { return heights[z * resolution + x]; };
+
+    for (int level = 1; level < info.levelCount; ++level) {
+        const int step = 1 << level;
+        float maxError = info.geometricError[level - 1];
+
+        for (int z = 0; z < resolution; ++z) {
+            for (int x = 0; x < resolution; ++x) {
+                int cx = std::min(x / step * step, resolution - 1 - step);
+                int cz = std::min(z / step * step, resolution - 1 - step);
+                float fx = (float)(x - cx) / step;
+                float fz = (float)(z - cz) / step;
+
+                float h0 = height(cx, cz) * (1.0f - fx) + height(cx + step, cz) * fx;
+                float h1 = height(cx, cz + step) * (1.0f - fx) + height(cx + step, cz + step) * fx;
+                float approx = h0 * (1.0f - fz) + h1 * fz;
+
+                maxError = std::max(maxError, fabsf(height(x, z) - approx));
+            }
+        }
+
+        info.geometricError[level] = maxError;
+    }
+
+    return info;
+}
+
+namespace {
+    // Distance from the camera to the chunk's bounding box
+    float chunk_distance(const ChunkLodInput& chunk, float chunkSize, simd::float3 cameraPosition) {
+        simd::float3 boxMin = { chunk.key.x * chunkSize, chunk.info->minHeight, chunk.key.z * chunkSize };
+        simd::float3 boxMax = { boxMin.x + chunkSize, chunk.info->maxHeight, boxMin.z + chunkSize };
+        simd::float3 closest = simd::clamp(cameraPosition, boxMin, boxMax);
+        return std::max(simd::length(cameraPosition - closest), 1e-3f);
+    }
+}
+
+void select_terrain_lods(const ChunkLodInput* chunks, size_t count, float chunkSize,
+                         simd::float3 cameraPosition, float projectionScale, float maxPixelError,
+                         int* outLevels, uint32_t* outStitchMasks) {
+    std::unordered_map<ChunkKey, size_t, ChunkKeyHash> lookup;
+    lookup.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        const ChunkLodInfo& info = *chunks[i].info;
+        lookup.emplace(chunks[i].key, i);
+
+        float distance = chunk_distance(chunks[i], chunkSize, cameraPosition);
+
+        int level = 0;
+        for (int l = info.levelCount - 1; l > 0; --l) {
+            if (info.geometricError[l] * projectionScale / distance <= maxPixelError) {
+                level = l;
+                break;
+            }
+        }
+        outLevels[i] = level;
+    }
+
+    const ChunkKey offsets[4] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+    const uint32_t edges[4] = { STITCH_NEG_X, STITCH_POS_X, STITCH_NEG_Z, STITCH_POS_Z };
+
+    // Neighbours may differ by at most one level; refine until stable
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 0; i < count; ++i) {
+            for (const auto& offset : offsets) {
+                auto it = lookup.find({chunks[i].key.x + offset.x, chunks[i].key.z + offset.z});
+                if (it != lookup.end() && outLevels[i] > outLevels[it->second] + 1) {
+                    outLevels[i] = outLevels[it->second] + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t mask = 0;
+        for (int e = 0; e < 4; ++e) {
+            auto it = lookup.find({chunks[i].key.x + offsets[e].x, chunks[i].key.z + offsets[e].z});
+            if (it != lookup.end() && outLevels[it->second] > outLevels[i]) {
+                mask |= edges[e];
+            }
+        }
+        outStitchMasks[i] = mask;
+    }
+}
+
+void select_vertex_lit_chunks(const ChunkLodInput* chunks, size_t count, const int* levels, int resolution,
+                              float chunkSize, simd::float3 cameraPosition, float projectionScale,
+                              float maxCellPixels, bool* outVertexLit) {
+    const float step = chunkSize / (float)std::max(resolution - 1, 1);
+    for (size_t i = 0; i < count; ++i) {
+        const float cell = step * (float)(1 << levels[i]);
+        outVertexLit[i] = cell * projectionScale / chunk_distance(chunks[i], chunkSize, cameraPosition) < maxCellPixels;
+    }
+}
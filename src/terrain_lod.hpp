@@ -0,0 +1,153 @@
+/**
+ * @file terrain_lod.hpp
+ * @brief Geomipmapped level-of-detail for terrain chunks with crack-free stitching.
+ *
+ * Every chunk keeps its full-resolution vertex buffer; a level only changes which
+ * vertices the index buffer references. Level l uses every 2^l-th vertex. Because all
+ * chunks share one grid layout, the index lists for every (level, stitch mask) pair are
+ * built once and shared by all chunks.
+ */
+
+#pragma once
+
+#include <simd/simd.h>
+#include <vector>
+
+#include "landscape.hpp"
+
+/// Maximum number of LOD levels supported per chunk.
+constexpr int MAX_TERRAIN_LOD_LEVELS = 8;
+
+/// Number of stitch masks per level (one bit per chunk edge).
+constexpr int TERRAIN_STITCH_MASKS = 16;
+
+/**
+ * @brief Chunk edges that border a coarser neighbour and must be stitched.
+ */
+enum TerrainStitchEdge : uint32_t {
+    STITCH_NEG_X = 1u << 0, ///< Edge at x = 0.
+    STITCH_POS_X = 1u << 1, ///< Edge at x = resolution - 1.
+    STITCH_NEG_Z = 1u << 2, ///< Edge at z = 0.
+    STITCH_POS_Z = 1u << 3, ///< Edge at z = resolution - 1.
+};
+
+/**
+ * @struct IndexRange
+ * @brief A contiguous range of indices inside a shared index buffer.
+ */
+struct IndexRange {
+    uint32_t offset = 0; ///< First index of the range.
+    uint32_t count = 0;  ///< Number of indices in the range.
+};
+
+/**
+ * @struct TerrainLodIndices
+ * @brief Index lists for every LOD level and stitch mask, packed in one array.
+ */
+struct TerrainLodIndices {
+    int resolution = 0;              ///< Vertices along each chunk edge.
+    int levelCount = 0;              ///< Number of LOD levels.
+    std::vector<uint32_t> indices;   ///< All index lists back to back.
+    std::vector<IndexRange> ranges;  ///< levelCount * TERRAIN_STITCH_MASKS ranges.
+
+    /// @return The index range for a level and stitch mask.
+    const IndexRange& range(int level, uint32_t stitchMask) const {
+        return ranges[level * TERRAIN_STITCH_MASKS + stitchMask];
+    }
+};
+
+/**
+ * @struct ChunkLodInfo
+ * @brief Per-chunk data used to pick a LOD level at runtime.
+ */
+struct ChunkLodInfo {
+    float minHeight = 0.0f;                              ///< Lowest vertex height.
+    float maxHeight = 0.0f;                              ///< Highest vertex height.
+    int levelCount = 1;                                  ///< Number of valid levels.
+    float geometricError[MAX_TERRAIN_LOD_LEVELS] = {};   ///< World-space error of each level, non-decreasing.
+};
+
+/**
+ * @struct ChunkLodInput
+ * @brief A resident chunk as seen by the LOD selector.
+ */
+struct ChunkLodInput {
+    ChunkKey key;               ///< Position on the chunk grid.
+    const ChunkLodInfo* info;   ///< Error metrics of the chunk.
+};
+
+/**
+ * @brief Returns the number of LOD levels for a chunk resolution.
+ * @param resolution Vertices along each chunk edge; must be 2^n + 1.
+ * @return n + 1, capped at MAX_TERRAIN_LOD_LEVELS.
+ */
+int terrain_lod_level_count(int resolution);
+
+/**
+ * @brief Builds the shared index lists for all levels and stitch masks.
+ *
+ * On a stitched edge, every odd vertex of the level is snapped onto its even
+ * predecessor so that the edge matches a neighbour one level coarser. Triangles
+ * that collapse are dropped. Cells are emitted in vertex cache friendly stripes.
+ *
+ * @param resolution Vertices along each chunk edge; must be 2^n + 1.
+ * @return The packed index lists.
+ */
+TerrainLodIndices build_terrain_lod_indices(int resolution);
+
+/**
+ * @brief Measures the height bounds and per-level geometric error of a chunk.
+ * @param vertices The full-resolution vertices of the chunk, row-major.
+ * @param resolution Vertices along each chunk edge.
+ * @return The LOD info of the chunk.
+ */
+ChunkLodInfo compute_chunk_lod_info(const std::vector<Vertex>& vertices, int resolution);
+
+/**
+ * @brief Measures the height bounds and per-level geometric error of a chunk.
+ * @param heights The full-resolution heights of the chunk, row-major.
+ * @param resolution Vertices along each chunk edge.
+ * @return The LOD info of the chunk.
+ */
+ChunkLodInfo compute_chunk_lod_info(const float* heights, int resolution);
+
+/**
+ * @brief Picks a LOD level and stitch mask for every chunk from screen-space error.
+ *
+ * The coarsest level whose projected error stays below maxPixelError is chosen, then
+ * levels are clamped so neighbouring chunks differ by at most one level.
+ *
+ * @param chunks The chunks to classify.
+ * @param count The number of chunks.
+ * @param chunkSize The edge length of a chunk in world units.
+ * @param cameraPosition The camera position in world space.
+ * @param projectionScale Viewport height / (2 * tan(fovy / 2)), in pixels.
+ * @param maxPixelError The allowed screen-space error in pixels.
+ * @param outLevels Receives the selected level of each chunk.
+ * @param outStitchMasks Receives the TerrainStitchEdge mask of each chunk.
+ */
+void select_terrain_lods(const ChunkLodInput* chunks, size_t count, float chunkSize,
+                         simd::float3 cameraPosition, float projectionScale, float maxPixelError,
+                         int* outLevels, uint32_t* outStitchMasks);
+
+/**
+ * @brief Picks the chunks whose cells are small enough on screen to be lit per vertex.
+ *
+ * A cell of level l spans 2^l grid steps of chunkSize / (resolution - 1). Where it projects to
+ * fewer than maxCellPixels pixels at the chunk's nearest point, interpolating the lighting of
+ * its corners differs from lighting every pixel by little more than the colour quantization,
+ * so the chunk can be drawn with ShaderVariant::vertexLighting.
+ *
+ * @param chunks The chunks to classify.
+ * @param count The number of chunks.
+ * @param levels The level each chunk is drawn at, from select_terrain_lods().
+ * @param resolution Vertices along each chunk edge.
+ * @param chunkSize The edge length of a chunk in world units.
+ * @param cameraPosition The camera position in world space.
+ * @param projectionScale Viewport height / (2 * tan(fovy / 2)), in pixels.
+ * @param maxCellPixels The largest projected cell edge lit per vertex, in pixels.
+ * @param outVertexLit Receives whether each chunk may be lit per vertex.
+ */
+void select_vertex_lit_chunks(const ChunkLodInput* chunks, size_t count, const int* levels, int resolution,
+                              float chunkSize, simd::float3 cameraPosition, float projectionScale,
+                              float maxCellPixels, bool* outVertexLit);
@@ -0,0 +1,46 @@
+#include "terrain_material.hpp"
+
+namespace {
+    // Non-negative remainder, so chunks west and north of the origin wrap like the shader's floor-based modulo
+    uint32_t wrap(int value, uint32_t tiles) {
+        const int remainder = value % (int)tiles;
+        return (uint32_t)(remainder < 0 ? remainder + (int)tiles : remainder);
+    }
+}
+
+uint32_t terrain_material_atlas_tiles(int unloadRadius) {
+    return 2 * (uint32_t)unloadRadius + 1;
+}
+
+TerrainMaterialTile terrain_material_tile(ChunkKey key, uint32_t tiles) {
+    return { wrap(key.x, tiles), wrap(key.z, tiles) };
+}
+
+TerrainMaterialUniforms terrain_material_uniforms(float chunkSize, int resolution, uint32_t tiles) {
+    TerrainMaterialUniforms uniforms = {};
+    uniforms.chunkSize = chunkSize;
+    uniforms.tiles = tiles;
+    uniforms.tileTexels = (uint32_t)resolution;
+    uniforms.atlasTexels = (float)(tiles * (uint32_t)resolution);
+    return uniforms;
+}
+
+TerrainMaterialSlots::TerrainMaterialSlots(uint32_t tiles) : m_tiles(tiles), m_slots((size_t)tiles * tiles) {}
+
+bool TerrainMaterialSlots::claim(ChunkKey key, uint64_t editVersion) {
+    const TerrainMaterialTile tile = terrain_material_tile(key, m_tiles);
+    Slot& slot = m_slots[(size_t)tile.z * m_tiles + tile.x];
+    if (slot.baked && slot.key == key && slot.editVersion == editVersion) {
+        return false;
+    }
+    slot.key = key;
+    slot.editVersion = editVersion;
+    slot.baked = true;
+    return true;
+}
+
+void TerrainMaterialSlots::invalidate() {
+    for (Slot& slot : m_slots) {
+        slot.baked = false;
+    }
+}
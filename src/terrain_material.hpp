@@ -0,0 +1,92 @@
+/**
+ * @file terrain_material.hpp
+ * @brief Where each terrain chunk's baked material tile lives in the atlas, and when it needs baking.
+ *
+ * The landscape fragments can read the chunk's albedo from a tile baked once per chunk
+ * (see gpu_terrain_material.hpp) instead of blending the height bands every pixel. All
+ * tiles share one atlas texture that is bound once per encoder: chunk (x, z) owns tile
+ * (x mod tiles, z mod tiles), so the shader finds it from the world position alone, and
+ * the tile count spans the unload diameter, so no two resident chunks share a tile.
+ *
+ * A tile holds one texel per chunk vertex, its borders on the chunk's borders, so bilinear
+ * filtering inside a chunk never reads a neighbouring tile and the texels on either side
+ * of a chunk border are baked from the same heights.
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "landscape.hpp"
+
+/// Fragment buffer index of TerrainMaterialUniforms in the landscape pipelines.
+constexpr uint32_t TERRAIN_MATERIAL_BUFFER_INDEX = 8;
+
+/**
+ * @struct TerrainMaterialUniforms
+ * @brief What the shader needs to find a chunk's tile; matches TerrainMaterialUniforms in shaders.metal.
+ */
+struct TerrainMaterialUniforms {
+    float chunkSize;        ///< World units along each chunk edge.
+    uint32_t tiles;         ///< Tiles along each side of the atlas.
+    uint32_t tileTexels;    ///< Texels along each tile edge; the chunk resolution.
+    float atlasTexels;      ///< Texels along each side of the atlas.
+};
+
+/**
+ * @struct TerrainMaterialTile
+ * @brief A tile of the atlas.
+ */
+struct TerrainMaterialTile {
+    uint32_t x = 0; ///< Column.
+    uint32_t z = 0; ///< Row.
+};
+
+/// @return Tiles along each side of the atlas for chunks resident within unloadRadius of the camera's chunk.
+uint32_t terrain_material_atlas_tiles(int unloadRadius);
+
+/// @return The tile chunk key owns in an atlas of tiles x tiles.
+TerrainMaterialTile terrain_material_tile(ChunkKey key, uint32_t tiles);
+
+/**
+ * @brief Fills the shader's addressing constants.
+ * @param chunkSize World units along each chunk edge.
+ * @param resolution Vertices along each chunk edge.
+ * @param tiles Tiles along each side of the atlas.
+ * @return The uniforms.
+ */
+TerrainMaterialUniforms terrain_material_uniforms(float chunkSize, int resolution, uint32_t tiles);
+
+/**
+ * @class TerrainMaterialSlots
+ * @brief Remembers which chunk, at which edit, each tile was last baked for.
+ */
+class TerrainMaterialSlots {
+public:
+    /// @param tiles Tiles along each side of the atlas.
+    explicit TerrainMaterialSlots(uint32_t tiles = 0);
+
+    /**
+     * @brief Records that a chunk is drawn from its tile.
+     * @param key The chunk.
+     * @param editVersion The chunk's ResidentChunk::editVersion; a newer one means its heights changed.
+     * @return True if the tile holds another chunk or an older version of this one, and must be baked.
+     */
+    bool claim(ChunkKey key, uint64_t editVersion);
+
+    /// @brief Forgets every tile, so every chunk is baked again.
+    void invalidate();
+
+    /// @return Tiles along each side of the atlas.
+    uint32_t tiles() const { return m_tiles; }
+
+private:
+    struct Slot {
+        ChunkKey key;
+        uint64_t editVersion = 0;
+        bool baked = false;
+    };
+
+    uint32_t m_tiles;
+    std::vector<Slot> m_slots;
+};
@@ -0,0 +1,21 @@
+#include "terrain_tessellation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float terrain_edge_tessellation(simd::float3 a, simd::float3 b, simd::float3 cameraPosition, float projectionScale,
+                                const TerrainTessellationSettings& settings) {
+    const simd::float3 center = (a + b) * 0.5f;
+    const float distance = std::max(simd::length(center - cameraPosition), 1e-3f);
+    const float pixels = simd::length(b - a) * projectionScale / distance;
+    return std::clamp(pixels / settings.targetEdgePixels, 1.0f, settings.maxFactor);
+}
+
+bool terrain_chunk_tessellated(const BoundingBox& bounds, int lodLevel, uint32_t stitchMask,
+                               simd::float3 cameraPosition, const TerrainTessellationSettings& settings) {
+    if (lodLevel != 0 || stitchMask != 0) {
+        return false;
+    }
+    const simd::float3 nearest = simd::clamp(cameraPosition, bounds.min, bounds.max);
+    return simd::length(nearest - cameraPosition) <= settings.maxDistance;
+}
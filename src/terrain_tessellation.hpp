@@ -0,0 +1,58 @@
+/**
+ * @file terrain_tessellation.hpp
+ * @brief Which terrain chunks are tessellated and how finely; the reference for the GPU kernels.
+ *
+ * Near the camera a chunk can be drawn as one quad patch per grid cell instead of from its
+ * vertex buffer (see gpu_tessellation.hpp). Every patch edge is split according to the
+ * length it covers on screen, and the new vertices are displaced onto the terrain noise.
+ * An edge's factor only depends on its two end points, so neighbouring patches always split
+ * a shared edge the same way. Edges on the chunk border are never split, which keeps them
+ * identical to the untessellated grid the neighbouring chunks are drawn with.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include "objects.hpp"
+
+/**
+ * @struct TerrainTessellationSettings
+ * @brief Tunables for tessellated terrain.
+ */
+struct TerrainTessellationSettings {
+    float targetEdgePixels = 8.0f;  ///< Screen-space length a split edge segment aims for.
+    float maxFactor = 15.0f;        ///< Most segments an edge is split into; odd partitioning allows up to 15.
+    float maxDistance = 48.0f;      ///< Chunks farther than this from the camera keep their vertex buffer.
+};
+
+/**
+ * @brief Returns the tessellation factor of a patch edge.
+ *
+ * The edge is measured as the screen-space diameter of its bounding sphere, which does not
+ * shrink when the edge points at the camera. The result is symmetric in a and b.
+ *
+ * @param a One end of the edge in world space.
+ * @param b The other end.
+ * @param cameraPosition The camera position in world space.
+ * @param projectionScale Viewport height / (2 * tan(fovy / 2)), in pixels.
+ * @param settings The tessellation settings.
+ * @return The number of segments, in [1, settings.maxFactor].
+ */
+float terrain_edge_tessellation(simd::float3 a, simd::float3 b, simd::float3 cameraPosition, float projectionScale,
+                                const TerrainTessellationSettings& settings);
+
+/**
+ * @brief Decides whether a chunk is drawn tessellated.
+ *
+ * Only chunks at full resolution without stitched edges qualify, since their borders are
+ * the full grid the tessellated patches keep.
+ *
+ * @param bounds The chunk's world space bounds.
+ * @param lodLevel The chunk's selected LOD level.
+ * @param stitchMask The chunk's TerrainStitchEdge mask.
+ * @param cameraPosition The camera position in world space.
+ * @param settings The tessellation settings.
+ * @return True if the chunk should be tessellated.
+ */
+bool terrain_chunk_tessellated(const BoundingBox& bounds, int lodLevel, uint32_t stitchMask,
+                               simd::float3 cameraPosition, const TerrainTessellationSettings& settings);
@@ -0,0 +1,294 @@
+#include "terrain_tile_cache.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "mesh_codec.hpp"
+
+namespace {
+    // FNV-1a over raw bytes
+    uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    uint64_t hash_value(uint64_t hash, const T& value) {
+        return hash_bytes(hash, &value, sizeof(value));
+    }
+}
+
+uint64_t terrain_tile_generator_key(const TerrainTileParams& params) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hash_value(hash, TERRAIN_TILE_VERSION);
+    hash = hash_value(hash, params.chunkSize);
+    hash = hash_value(hash, (int32_t)params.resolution);
+    hash = hash_value(hash, (uint32_t)params.vertexFormat);
+    hash = hash_value(hash, (uint32_t)params.heightMaps);
+    hash = hash_value(hash, params.noise.offset);
+    hash = hash_value(hash, params.noise.scale);
+    hash = hash_value(hash, params.noise.heightScale);
+    hash = hash_value(hash, params.noise.noise.seed);
+    hash = hash_value(hash, (uint32_t)params.noise.noise.basis);
+    hash = hash_value(hash, (uint32_t)params.noise.noise.interpolation);
+    hash = hash_value(hash, params.noise.noise.warp);
+    hash = hash_value(hash, params.noise.noise.octaves);
+    hash = hash_value(hash, params.noise.noise.persistence);
+    // Uneroded terrain keeps the directories it had before erosion existed
+    if (params.erosion.iterations > 0) {
+        const ErosionSettings& erosion = params.erosion;
+        hash = hash_value(hash, erosion.iterations);
+        hash = hash_value(hash, (int32_t)erosion.margin);
+        hash = hash_value(hash, erosion.timeStep);
+        hash = hash_value(hash, erosion.rain);
+        hash = hash_value(hash, erosion.evaporation);
+        hash = hash_value(hash, erosion.capacity);
+        hash = hash_value(hash, erosion.dissolving);
+        hash = hash_value(hash, erosion.deposition);
+        hash = hash_value(hash, erosion.minTilt);
+        hash = hash_value(hash, erosion.talus);
+        hash = hash_value(hash, erosion.thermalRate);
+        hash = hash_value(hash, erosion.gravity);
+    }
+    hash = hash_value(hash, (uint32_t)params.compressed);
+    return hash;
+}
+
+std::string terrain_tile_directory(const std::string& cacheRoot, uint64_t generatorKey) {
+    char name[17];
+    snprintf(name, sizeof(name), "%016" PRIx64, generatorKey);
+    return (std::filesystem::path(cacheRoot) / name).string();
+}
+
+std::string terrain_tile_path(const std::string& directory, ChunkKey key) {
+    return (std::filesystem::path(directory) / (std::to_string(key.x) + "_" + std::to_string(key.z) + ".tile")).string();
+}
+
+std::string terrain_erosion_tile_path(const std::string& directory, ChunkKey corner) {
+    return (std::filesystem::path(directory) /
+            ("erosion_" + std::to_string(corner.x) + "_" + std::to_string(corner.z) + ".tile")).string();
+}
+
+size_t terrain_tile_file_size(size_t vertexBytes) {
+    const size_t unpadded = vertexBytes + sizeof(TerrainTileFooter);
+    return (unpadded + TERRAIN_TILE_ALIGNMENT - 1) / TERRAIN_TILE_ALIGNMENT * TERRAIN_TILE_ALIGNMENT;
+}
+
+namespace {
+    bool encode_payload(const TerrainTileFooter& footer, const void* vertices, std::vector<uint8_t>& payload) {
+        const size_t stride = footer.codecStride;
+        switch ((TerrainTileCodec)footer.codec) {
+        case TerrainTileCodec::Vertices:
+            if (stride == 0 || footer.vertexBytes % stride != 0) {
+                return false;
+            }
+            payload = encode_vertex_buffer(vertices, footer.vertexBytes / stride, stride);
+            return true;
+        case TerrainTileCodec::HeightMap: {
+            // 16-bit heights, then two 8-bit normal components per texel
+            const size_t count = stride * stride;
+            if (footer.vertexBytes != count * 4) {
+                return false;
+            }
+            const std::vector<uint8_t> heights =
+                encode_height_grid((const uint16_t*)vertices, (uint32_t)stride, (uint32_t)stride);
+            const std::vector<uint8_t> normals =
+                encode_vertex_buffer((const uint8_t*)vertices + count * sizeof(uint16_t), count, 2);
+            const uint32_t heightBytes = (uint32_t)heights.size();
+            payload.resize(sizeof(heightBytes));
+            memcpy(payload.data(), &heightBytes, sizeof(heightBytes));
+            payload.insert(payload.end(), heights.begin(), heights.end());
+            payload.insert(payload.end(), normals.begin(), normals.end());
+            return true;
+        }
+        case TerrainTileCodec::Raw:
+            break;
+        }
+        return false;
+    }
+
+    bool decode_payload(const TerrainTileFooter& footer, const uint8_t* payload, void* vertices) {
+        const size_t stride = footer.codecStride;
+        const size_t size = footer.storedBytes;
+        switch ((TerrainTileCodec)footer.codec) {
+        case TerrainTileCodec::Vertices:
+            return stride > 0 && footer.vertexBytes % stride == 0 &&
+                   decode_vertex_buffer(payload, size, vertices, footer.vertexBytes / stride, stride);
+        case TerrainTileCodec::HeightMap: {
+            const size_t count = stride * stride;
+            uint32_t heightBytes;
+            if (footer.vertexBytes != count * 4 || size < sizeof(heightBytes)) {
+                return false;
+            }
+            memcpy(&heightBytes, payload, sizeof(heightBytes));
+            if (heightBytes > size - sizeof(heightBytes)) {
+                return false;
+            }
+            const uint8_t* normals = payload + sizeof(heightBytes) + heightBytes;
+            return decode_height_grid(payload + sizeof(heightBytes), heightBytes, (uint16_t*)vertices,
+                                      (uint32_t)stride, (uint32_t)stride) &&
+                   decode_vertex_buffer(normals, size - sizeof(heightBytes) - heightBytes,
+                                        (uint8_t*)vertices + count * sizeof(uint16_t), count, 2);
+        }
+        case TerrainTileCodec::Raw:
+            break;
+        }
+        return false;
+    }
+}
+
+bool write_terrain_tile(const std::string& path, const TerrainTileFooter& footer, const void* vertices) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    TerrainTileFooter stored = footer;
+    std::vector<char> contents;
+    if (footer.codec == (uint32_t)TerrainTileCodec::Raw) {
+        contents.assign(terrain_tile_file_size(footer.vertexBytes), 0);
+        memcpy(contents.data(), vertices, footer.vertexBytes);
+        stored.storedBytes = footer.vertexBytes;
+    } else {
+        // Encoded tiles are read, not mapped, so they are not padded
+        std::vector<uint8_t> payload;
+        if (!encode_payload(footer, vertices, payload)) {
+            return false;
+        }
+        contents.assign(payload.size() + sizeof(stored), 0);
+        memcpy(contents.data(), payload.data(), payload.size());
+        stored.storedBytes = payload.size();
+    }
+    memcpy(contents.data() + contents.size() - sizeof(stored), &stored, sizeof(stored));
+
+    // Another process may write the same tile; each writes its own temporary file
+    const std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(contents.data(), contents.size())) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+namespace {
+    bool footer_identifies(const TerrainTileFooter& footer, uint64_t generatorKey, ChunkKey key, size_t vertexBytes) {
+        return footer.magic == TERRAIN_TILE_MAGIC && footer.version == TERRAIN_TILE_VERSION &&
+               footer.generatorKey == generatorKey && footer.chunkX == key.x && footer.chunkZ == key.z &&
+               footer.vertexBytes == vertexBytes;
+    }
+
+    // Only Raw tiles hold the vertices as the GPU reads them
+    bool footer_matches(const TerrainTileFooter& footer, uint64_t generatorKey, ChunkKey key, size_t vertexBytes) {
+        return footer_identifies(footer, generatorKey, key, vertexBytes) &&
+               footer.codec == (uint32_t)TerrainTileCodec::Raw;
+    }
+
+    // Opens a tile and checks its size; returns -1 if it is missing or has the wrong size
+    int open_tile(const std::string& path, size_t fileSize) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return -1;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size != fileSize) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+bool read_terrain_tile(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                       void* vertices, TerrainTileFooter& footer) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    TerrainTileFooter read;
+    bool valid = fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(read) &&
+                 pread(fd, &read, sizeof(read), info.st_size - sizeof(read)) == (ssize_t)sizeof(read) &&
+                 footer_identifies(read, generatorKey, key, vertexBytes);
+    if (valid && read.codec == (uint32_t)TerrainTileCodec::Raw) {
+        valid = (size_t)info.st_size == terrain_tile_file_size(vertexBytes) &&
+                pread(fd, vertices, vertexBytes, 0) == (ssize_t)vertexBytes;
+    } else if (valid) {
+        std::vector<uint8_t> payload;
+        valid = (uint64_t)info.st_size == read.storedBytes + sizeof(read);
+        if (valid) {
+            payload.resize(read.storedBytes);
+            valid = pread(fd, payload.data(), payload.size(), 0) == (ssize_t)payload.size() &&
+                    decode_payload(read, payload.data(), vertices);
+        }
+    }
+    close(fd);
+    if (valid) {
+        footer = read;
+    }
+    return valid;
+}
+
+bool read_terrain_tile_footer(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                              TerrainTileFooter& footer) {
+    const size_t fileSize = terrain_tile_file_size(vertexBytes);
+    const int fd = open_tile(path, fileSize);
+    if (fd < 0) {
+        return false;
+    }
+    TerrainTileFooter read;
+    const bool complete = pread(fd, &read, sizeof(read), fileSize - sizeof(read)) == (ssize_t)sizeof(read);
+    close(fd);
+    if (!complete || !footer_matches(read, generatorKey, key, vertexBytes)) {
+        return false;
+    }
+    footer = read;
+    return true;
+}
+
+bool map_terrain_tile(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                      TerrainTile& tile) {
+    const size_t fileSize = terrain_tile_file_size(vertexBytes);
+    const int fd = open_tile(path, fileSize);
+    if (fd < 0) {
+        return false;
+    }
+    void* data = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    TerrainTileFooter footer;
+    memcpy(&footer, (const char*)data + fileSize - sizeof(footer), sizeof(footer));
+    if (!footer_matches(footer, generatorKey, key, vertexBytes)) {
+        munmap(data, fileSize);
+        return false;
+    }
+
+    tile.data = data;
+    tile.length = fileSize;
+    tile.footer = footer;
+    return true;
+}
+
+void unmap_terrain_tile(const TerrainTile& tile) {
+    if (tile.data) {
+        munmap(tile.data, tile.length);
+    }
+}
@@ -0,0 +1,169 @@
+/**
+ * @file terrain_tile_cache.hpp
+ * @brief Generated terrain chunks persisted as tile files that map straight into GPU buffers.
+ *
+ * A tile holds one chunk's vertex buffer exactly as the GPU reads it, in the chunk's
+ * VertexFormat, followed by a footer with the chunk's LOD metrics at the end of the file.
+ * Vertices start at offset 0 and the file is padded to TERRAIN_TILE_ALIGNMENT, so a mapping
+ * of the whole file can back an MTLBuffer without a copy. Height-map chunks store their
+ * heights followed by their normals (see terrain_height_map.hpp) in place of the vertices.
+ * The LOD index lists are shared by every chunk of a resolution and are rebuilt at startup,
+ * so tiles only store what differs per chunk.
+ *
+ * Tiles are grouped in a directory named after terrain_tile_generator_key(). Changing the
+ * noise mapping, the chunk layout, the vertex format or the erosion selects a new directory
+ * instead of reading stale tiles; changes to the generator code itself must bump
+ * TERRAIN_TILE_VERSION. Eroded terrain also keeps the offsets of its erosion windows (see
+ * terrain_erosion.hpp) in tiles of the same layout, so a seed is eroded only once.
+ *
+ * Compressed tiles trade the mapping for smaller reads: the payload is encoded with
+ * mesh_codec.hpp, the footer follows it without padding, and read_terrain_tile() decodes it
+ * into memory the caller uploads from. They live in their own directory, as the generator
+ * key includes the choice.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "landscape.hpp"
+#include "terrain_erosion.hpp"
+#include "terrain_lod.hpp"
+
+/// "TILE" in little-endian byte order.
+constexpr uint32_t TERRAIN_TILE_MAGIC = 0x454c4954;
+/// Bump whenever tiles written by older code must not be read.
+constexpr uint32_t TERRAIN_TILE_VERSION = 4;
+/// Tile files are a multiple of this; the largest page size of Apple platforms.
+constexpr size_t TERRAIN_TILE_ALIGNMENT = 16384;
+
+/**
+ * @struct TerrainTileParams
+ * @brief Everything that decides the contents of a tile besides its chunk coordinates.
+ */
+struct TerrainTileParams {
+    float chunkSize = 0.0f;                         ///< Edge length of a chunk in world units.
+    int resolution = 0;                             ///< Vertices along each chunk edge.
+    VertexFormat vertexFormat = VertexFormat::Float; ///< Layout of the stored vertices.
+    bool heightMaps = false;                        ///< Tiles hold height-map texels instead of vertices.
+    TerrainNoiseMapping noise = {};                 ///< World to noise space mapping of the generator.
+    ErosionSettings erosion = {};                   ///< Erosion of the terrain; only hashed while it is on.
+    bool compressed = false;                        ///< Tiles are written with a codec other than Raw.
+};
+
+/**
+ * @enum TerrainTileCodec
+ * @brief How a tile stores its payload.
+ */
+enum class TerrainTileCodec : uint32_t {
+    Raw,        ///< As the GPU reads it, padded to TERRAIN_TILE_ALIGNMENT; can be mapped.
+    Vertices,   ///< encode_vertex_buffer() with codecStride-byte vertices.
+    HeightMap,  ///< encode_height_grid() of codecStride^2 heights, then encode_vertex_buffer() of their normals.
+};
+
+/**
+ * @struct TerrainTileFooter
+ * @brief The last bytes of a tile file.
+ */
+struct TerrainTileFooter {
+    uint32_t magic = TERRAIN_TILE_MAGIC;        ///< Identifies a tile file.
+    uint32_t version = TERRAIN_TILE_VERSION;    ///< Format version the tile was written with.
+    uint64_t generatorKey = 0;                  ///< terrain_tile_generator_key() of the generator.
+    int32_t chunkX = 0;                         ///< ChunkKey::x of the tile.
+    int32_t chunkZ = 0;                         ///< ChunkKey::z of the tile.
+    uint64_t vertexBytes = 0;                   ///< Size of the vertex data at the start of the file, decoded.
+    uint32_t codec = (uint32_t)TerrainTileCodec::Raw; ///< TerrainTileCodec of the payload.
+    uint32_t codecStride = 0;                   ///< Vertex stride, or height-map resolution, of the codec.
+    uint64_t storedBytes = 0;                   ///< Size of the encoded payload; vertexBytes for Raw tiles.
+    ChunkLodInfo lod;                           ///< Height bounds and per-level error of the chunk.
+};
+
+/**
+ * @struct TerrainTile
+ * @brief A tile file mapped into memory.
+ */
+struct TerrainTile {
+    void* data = nullptr;       ///< Start of the mapping: the vertex data, page-aligned.
+    size_t length = 0;          ///< Length of the mapping, a multiple of TERRAIN_TILE_ALIGNMENT.
+    TerrainTileFooter footer;   ///< Copy of the validated footer.
+};
+
+/// @return A 64-bit hash of the parameters and TERRAIN_TILE_VERSION, naming the tile directory.
+uint64_t terrain_tile_generator_key(const TerrainTileParams& params);
+
+/**
+ * @brief Returns the directory that holds the tiles of one generator.
+ * @param cacheRoot The root of the tile cache.
+ * @param generatorKey The generator's terrain_tile_generator_key().
+ * @return cacheRoot/<generatorKey in hex>.
+ */
+std::string terrain_tile_directory(const std::string& cacheRoot, uint64_t generatorKey);
+
+/// @return The path of a chunk's tile inside a terrain_tile_directory().
+std::string terrain_tile_path(const std::string& directory, ChunkKey key);
+
+/// @return The path of the tile holding the offsets of the erosion window around a chunk grid corner.
+std::string terrain_erosion_tile_path(const std::string& directory, ChunkKey corner);
+
+/// @return The size of a Raw tile file whose vertex data takes vertexBytes.
+size_t terrain_tile_file_size(size_t vertexBytes);
+
+/**
+ * @brief Writes a tile, creating its directory if needed.
+ *
+ * The file is written under a temporary name and renamed into place, so readers never map
+ * a partial tile.
+ *
+ * @param path The tile path.
+ * @param footer The footer; vertexBytes gives the size of vertices, codec and codecStride how to store them.
+ *               Its storedBytes is ignored; the file gets the encoded size.
+ * @param vertices The chunk's vertex data.
+ * @return True if the tile was written; false also for a codec that does not fit vertexBytes.
+ */
+bool write_terrain_tile(const std::string& path, const TerrainTileFooter& footer, const void* vertices);
+
+/**
+ * @brief Reads a tile of any codec and decodes its vertex data.
+ * @param path The tile path.
+ * @param generatorKey The expected generator.
+ * @param key The expected chunk.
+ * @param vertexBytes The expected size of the vertex data.
+ * @param vertices Receives vertexBytes bytes; undefined on failure.
+ * @param footer Receives the footer.
+ * @return True if the tile exists, matches and decodes.
+ */
+bool read_terrain_tile(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                       void* vertices, TerrainTileFooter& footer);
+
+/**
+ * @brief Reads only the footer of a Raw tile, for loaders that stream the vertices themselves.
+ * @param path The tile path.
+ * @param generatorKey The expected generator.
+ * @param key The expected chunk.
+ * @param vertexBytes The expected size of the vertex data.
+ * @param footer Receives the footer.
+ * @return True if the tile exists and matches; its vertices are the first vertexBytes of the file.
+ */
+bool read_terrain_tile_footer(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                              TerrainTileFooter& footer);
+
+/**
+ * @brief Maps a Raw tile if it exists and matches the expected generator, chunk and size.
+ *
+ * The mapping is private and writable so it can back a GPU buffer; pages are only read
+ * from the file, never copied, until something writes to them.
+ *
+ * @param path The tile path.
+ * @param generatorKey The expected generator.
+ * @param key The expected chunk.
+ * @param vertexBytes The expected size of the vertex data.
+ * @param tile Receives the mapping.
+ * @return True if the tile was mapped; it must be released with unmap_terrain_tile().
+ */
+bool map_terrain_tile(const std::string& path, uint64_t generatorKey, ChunkKey key, size_t vertexBytes,
+                      TerrainTile& tile);
+
+/// Releases a mapping made by map_terrain_tile().
+void unmap_terrain_tile(const TerrainTile& tile);
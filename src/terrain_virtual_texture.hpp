@@ -0,0 +1,117 @@
+/**
+ * @file terrain_virtual_texture.hpp
+ * @brief The terrain's virtual albedo texture: a sparse texture whose pages are mapped and
+ *        filled as the landscape fragments ask for them.
+ *
+ * The texture lives in a placement sparse heap sized for VirtualTextureCache's page budget, so
+ * its memory stays fixed however much of the world it covers. Each frame the landscape
+ * fragments record the pages they sample in a feedback bitmap; once the frame completes, the
+ * next update reads it, and a resource state pass maps the pages the cache loads and unmaps the
+ * ones it evicts. The job system generates the loaded pages into a staging buffer, a blit copies
+ * them in, and the min-mip map the shader clamps its sampling with is uploaded after them, all
+ * ahead of the scene pass in the same command buffer.
+ *
+ * Pages are stored block-compressed where the device samples it: the jobs compress each row of
+ * blocks as they generate it, so neither the staging buffer nor the heap holds uncompressed
+ * texels. A sparse tile has the same bytes in every format, so a compressed page covers 4 to 16
+ * times the texels, and the heap shrinks by the same factor for the same coverage.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "frame_ring.hpp"
+#include "job_system.hpp"
+#include "texture_compression.hpp"
+#include "virtual_texture.hpp"
+
+/**
+ * @struct TerrainVirtualTextureSettings
+ * @brief Size, placement and budgets of the virtual texture.
+ */
+struct TerrainVirtualTextureSettings {
+    uint32_t size = 16384;              ///< Texels along each side of level 0; 16 per world unit over worldSize.
+    VirtualTextureWorld world;          ///< Where the texture lies; terrain outside keeps its height bands.
+    size_t heapBytes = 64 * 1024 * 1024; ///< Sparse heap size with uncompressed pages; the mip tail comes out of
+                                         ///< it and the rest is pages. Compressed pages keep its coverage.
+    uint32_t maxUploadsPerFrame = 16;   ///< Uncompressed pages generated and copied in per frame; as many texels
+                                        ///< of compressed ones.
+    TextureCompression compression = TextureCompression::Astc4x4; ///< Preferred block format of the pages.
+};
+
+/**
+ * @struct VirtualTextureFeedbackSlot
+ * @brief A feedback bitmap and whether the frame that wrote it has completed.
+ */
+struct VirtualTextureFeedbackSlot {
+    id<MTLBuffer> buffer;                   ///< Shared; one bit per page.
+    std::atomic<bool> inFlight{ false };    ///< True from binding until the frame's command buffer completes.
+    bool written = false;                   ///< True once a frame has been bound to it and not yet read back.
+};
+
+/**
+ * @struct TerrainVirtualTexture
+ * @brief The sparse texture, its residency and the buffers that feed it.
+ */
+struct TerrainVirtualTexture {
+    TerrainVirtualTextureSettings settings;
+    VirtualTextureLayout layout;
+    std::unique_ptr<VirtualTextureCache> cache;
+    id<MTLHeap> heap;                       ///< Placement sparse heap backing the texture's pages.
+    id<MTLTexture> texture;                 ///< Albedo with every mip level, in the compression's format; sparse.
+    TextureCompression compression = TextureCompression::None; ///< The block format the device samples.
+    id<MTLTexture> minMip;                  ///< R8Uint, one texel per page of level 0.
+    id<MTLBuffer> staging;                  ///< Shared; generated pages and the min-mip map, per frame in flight.
+    size_t stagingFrameBytes = 0;           ///< Bytes of staging one frame uses.
+    size_t pageBytes = 0;                   ///< Staging bytes of one page.
+    size_t pageRowBytes = 0;                ///< Staging bytes of one row of a page's blocks.
+    std::vector<uint8_t> texels;            ///< One row of blocks of BGRA8 texels per page loaded in a frame.
+    uint32_t stagingSlot = 0;               ///< Frame's region of staging.
+    std::shared_ptr<VirtualTextureFeedbackSlot[]> feedback; ///< Frames in flight plus two, shared with completion handlers.
+    uint32_t feedbackCount = 0;             ///< Slots in feedback.
+    id<MTLBuffer> discardFeedback;          ///< Written when every slot is busy, and never read.
+    id<MTLBuffer> boundFeedback;            ///< Bitmap the current frame writes.
+    std::vector<uint32_t> requests;         ///< Pages the completed frames asked for, combined.
+    VirtualTextureUpdate update;            ///< The last update's residency changes.
+    VirtualTextureUniforms uniforms;        ///< Bound at fragment buffer 6.
+    uint64_t frame = 0;                     ///< Updates so far.
+    uint32_t pagesLoaded = 0;               ///< Pages the last update loaded.
+};
+
+/// @return True if the device has placement sparse textures.
+bool terrain_virtual_texture_supported(id<MTLDevice> device);
+
+/**
+ * @brief Creates the texture with only its mip tail resident and filled.
+ * @param device The Metal device; must be supported.
+ * @param queue Used once to map and fill the mip tail.
+ * @param settings Size, placement and budgets; the compression falls back to one the device samples.
+ * @return The virtual texture.
+ */
+TerrainVirtualTexture create_terrain_virtual_texture(id<MTLDevice> device, id<MTLCommandQueue> queue,
+                                                     const TerrainVirtualTextureSettings& settings);
+
+/**
+ * @brief Applies the feedback of completed frames and binds a feedback bitmap for this one.
+ *
+ * Encodes the page mapping, the copies of the generated pages and the min-mip upload into
+ * cmd, so it must come before the passes that sample the texture. Call once per frame after
+ * frame_ring_begin_frame(), which keeps the staging region it writes out of use by the GPU.
+ *
+ * @param vt The virtual texture.
+ * @param cmd The command buffer of the frame's scene pass.
+ * @param jobs Generates the loaded pages.
+ */
+void terrain_virtual_texture_update(TerrainVirtualTexture& vt, id<MTLCommandBuffer> cmd, JobSystem& jobs);
+
+/// @brief Binds the texture, min-mip map, uniforms and this frame's feedback for the landscape fragments.
+void terrain_virtual_texture_bind(const TerrainVirtualTexture& vt, id<MTLRenderCommandEncoder> enc);
+
+/// @return GPU bytes held by the heap, min-mip map, staging and feedback buffers.
+size_t terrain_virtual_texture_bytes(const TerrainVirtualTexture& vt);
@@ -0,0 +1,326 @@
+#import "terrain_virtual_texture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "gpu_texture_compression.hpp"
+#include "trace.hpp"
+
+namespace {
+    // A slot per frame in flight, one completing while the next frame binds, and one spare
+    constexpr uint32_t FEEDBACK_SLOTS = DEFAULT_FRAMES_IN_FLIGHT + 2;
+
+    size_t round_up(size_t bytes, size_t alignment) {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    id<MTLBuffer> make_feedback_buffer(id<MTLDevice> device, const VirtualTextureLayout& layout) {
+        const size_t bytes = std::max<size_t>(virtual_texture_feedback_words(layout) * sizeof(uint32_t), 4);
+        id<MTLBuffer> buffer = [device newBufferWithLength:bytes options:MTLResourceStorageModeShared];
+        memset(buffer.contents, 0, bytes);
+        return buffer;
+    }
+
+    // Generates a region of a level a row of blocks at a time into texels, which hold one row of
+    // blocks, and compresses each row into out, rowBytes apart
+    void generate_blocks(const TerrainVirtualTexture& vt, uint32_t mip, uint32_t x0, uint32_t y0, uint32_t width,
+                         uint32_t height, uint8_t* out, size_t rowBytes, uint8_t* texels) {
+        if (vt.compression == TextureCompression::None) {
+            generate_virtual_texels(vt.layout, vt.settings.world, mip, x0, y0, width, height, out, rowBytes);
+            return;
+        }
+        const uint32_t blockHeight = texture_block_format(vt.compression).height;
+        for (uint32_t y = 0; y < height; y += blockHeight) {
+            const uint32_t rows = std::min(blockHeight, height - y);
+            generate_virtual_texels(vt.layout, vt.settings.world, mip, x0, y0 + y, width, rows, texels,
+                                    (size_t)width * 4);
+            compress_bgra_texels(vt.compression, texels, (size_t)width * 4, width, rows,
+                                 out + y / blockHeight * rowBytes, rowBytes);
+        }
+    }
+
+    // Maps the mip tail and fills every level of it, then uploads the all-tail min-mip map
+    void fill_mip_tail(TerrainVirtualTexture& vt, id<MTLDevice> device, id<MTLCommandQueue> queue) {
+        const VirtualTextureLayout& layout = vt.layout;
+        std::vector<size_t> offsets;
+        size_t bytes = 0;
+        for (uint32_t mip = layout.sparseMips; mip < layout.mipCount; ++mip) {
+            offsets.push_back(bytes);
+            const uint32_t size = virtual_texture_mip_size(layout, mip);
+            bytes += compressed_image_bytes(vt.compression, size, size);
+        }
+        const size_t minMipOffset = bytes;
+        bytes += vt.cache->min_mip().size();
+
+        id<MTLBuffer> upload = [device newBufferWithLength:std::max<size_t>(bytes, 4)
+                                                   options:MTLResourceStorageModeShared];
+        uint8_t* contents = (uint8_t*)upload.contents;
+        std::vector<uint8_t> texels;
+        for (uint32_t mip = layout.sparseMips; mip < layout.mipCount; ++mip) {
+            const uint32_t size = virtual_texture_mip_size(layout, mip);
+            texels.resize((size_t)size * texture_block_format(vt.compression).height * 4);
+            generate_blocks(vt, mip, 0, 0, size, size, contents + offsets[mip - layout.sparseMips],
+                            compressed_row_bytes(vt.compression, size), texels.data());
+        }
+        memcpy(contents + minMipOffset, vt.cache->min_mip().data(), vt.cache->min_mip().size());
+
+        id<MTLCommandBuffer> cmd = [queue commandBuffer];
+        cmd.label = @"Virtual texture tail";
+        if (layout.sparseMips < layout.mipCount) {
+            // The tail is mapped as a whole through its first level
+            id<MTLResourceStateCommandEncoder> mapping = [cmd resourceStateCommandEncoder];
+            [mapping updateTextureMapping:vt.texture
+                                     mode:MTLSparseTextureMappingModeMap
+                                   region:MTLRegionMake2D(0, 0, 1, 1)
+                                 mipLevel:layout.sparseMips
+                                    slice:0];
+            [mapping endEncoding];
+        }
+        id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+        for (uint32_t mip = layout.sparseMips; mip < layout.mipCount; ++mip) {
+            const uint32_t size = virtual_texture_mip_size(layout, mip);
+            [blit copyFromBuffer:upload
+                    sourceOffset:offsets[mip - layout.sparseMips]
+               sourceBytesPerRow:compressed_row_bytes(vt.compression, size)
+             sourceBytesPerImage:compressed_image_bytes(vt.compression, size, size)
+                      sourceSize:MTLSizeMake(size, size, 1)
+                       toTexture:vt.texture
+                destinationSlice:0
+                destinationLevel:mip
+               destinationOrigin:MTLOriginMake(0, 0, 0)];
+        }
+        [blit copyFromBuffer:upload
+                sourceOffset:minMipOffset
+           sourceBytesPerRow:vt.minMip.width
+         sourceBytesPerImage:vt.minMip.width * vt.minMip.height
+                  sourceSize:MTLSizeMake(vt.minMip.width, vt.minMip.height, 1)
+                   toTexture:vt.minMip
+            destinationSlice:0
+            destinationLevel:0
+           destinationOrigin:MTLOriginMake(0, 0, 0)];
+        [blit endEncoding];
+        [cmd commit];
+        [cmd waitUntilCompleted];
+    }
+
+    // ORs the bitmaps of completed frames into vt.requests and frees their slots
+    void gather_feedback(TerrainVirtualTexture& vt) {
+        std::fill(vt.requests.begin(), vt.requests.end(), 0);
+        for (uint32_t i = 0; i < vt.feedbackCount; ++i) {
+            VirtualTextureFeedbackSlot& slot = vt.feedback[i];
+            if (!slot.written || slot.inFlight.load(std::memory_order_acquire)) {
+                continue;
+            }
+            uint32_t* bits = (uint32_t*)slot.buffer.contents;
+            for (size_t word = 0; word < vt.requests.size(); ++word) {
+                vt.requests[word] |= bits[word];
+            }
+            memset(bits, 0, vt.requests.size() * sizeof(uint32_t));
+            slot.written = false;
+        }
+    }
+
+    // Binds a free bitmap for this frame and frees it again once cmd completes
+    void bind_feedback(TerrainVirtualTexture& vt, id<MTLCommandBuffer> cmd) {
+        vt.boundFeedback = vt.discardFeedback;
+        for (uint32_t i = 0; i < vt.feedbackCount; ++i) {
+            VirtualTextureFeedbackSlot& slot = vt.feedback[i];
+            if (slot.written) {
+                continue;
+            }
+            slot.written = true;
+            slot.inFlight.store(true, std::memory_order_release);
+            vt.boundFeedback = slot.buffer;
+            std::shared_ptr<VirtualTextureFeedbackSlot[]> slots = vt.feedback;
+            [cmd addCompletedHandler:^(id<MTLCommandBuffer>) {
+                slots[i].inFlight.store(false, std::memory_order_release);
+            }];
+            return;
+        }
+    }
+}
+
+bool terrain_virtual_texture_supported(id<MTLDevice> device) {
+    // Placement sparse heaps need an A13 or later
+    return [device supportsFamily:MTLGPUFamilyApple6];
+}
+
+TerrainVirtualTexture create_terrain_virtual_texture(id<MTLDevice> device, id<MTLCommandQueue> queue,
+                                                     const TerrainVirtualTextureSettings& settings) {
+    TerrainVirtualTexture vt;
+    vt.settings = settings;
+    vt.compression = pick_texture_compression(device, settings.compression);
+    const MTLPixelFormat pixelFormat = texture_compression_pixel_format(vt.compression);
+
+    const MTLSize tile = [device sparseTileSizeWithTextureType:MTLTextureType2D
+                                                   pixelFormat:pixelFormat
+                                                   sampleCount:1];
+    const MTLSize uncompressedTile = [device sparseTileSizeWithTextureType:MTLTextureType2D
+                                                               pixelFormat:MTLPixelFormatBGRA8Unorm
+                                                               sampleCount:1];
+    // Tiles are the same bytes in every format, so a compressed page covers this many uncompressed ones
+    const size_t pageRatio =
+        std::max<size_t>(tile.width * tile.height / (uncompressedTile.width * uncompressedTile.height), 1);
+    vt.settings.maxUploadsPerFrame = std::max<uint32_t>(settings.maxUploadsPerFrame / (uint32_t)pageRatio, 1);
+    const size_t tileBytes = device.sparseTileSizeInBytes;
+    MTLHeapDescriptor* heapDesc = [MTLHeapDescriptor new];
+    heapDesc.type = MTLHeapTypeSparse;
+    heapDesc.storageMode = MTLStorageModePrivate;
+    // Tracked, so unmapping a page waits for the frames in flight that still sample it
+    heapDesc.hazardTrackingMode = MTLHazardTrackingModeTracked;
+    heapDesc.size = round_up(std::max(settings.heapBytes / pageRatio, tileBytes), tileBytes);
+    vt.heap = [device newHeapWithDescriptor:heapDesc];
+    vt.heap.label = @"Virtual texture pages";
+
+    MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:pixelFormat
+                                                                                    width:settings.size
+                                                                                   height:settings.size
+                                                                                mipmapped:YES];
+    desc.storageMode = MTLStorageModePrivate;
+    desc.usage = MTLTextureUsageShaderRead;
+    vt.texture = [vt.heap newTextureWithDescriptor:desc];
+    vt.texture.label = @"Terrain virtual texture";
+
+    vt.layout = make_virtual_texture_layout(settings.size, (uint32_t)tile.width, (uint32_t)tile.height,
+                                            (uint32_t)vt.texture.firstMipmapInTail);
+    const size_t pageHeapBytes = vt.heap.size > vt.texture.tailSizeInBytes ? vt.heap.size - vt.texture.tailSizeInBytes : 0;
+    vt.cache = std::make_unique<VirtualTextureCache>(vt.layout, (uint32_t)(pageHeapBytes / tileBytes));
+    vt.uniforms = virtual_texture_uniforms(vt.layout, settings.world.originX, settings.world.originZ,
+                                           settings.world.worldSize);
+
+    MTLTextureDescriptor* minMipDesc =
+        [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR8Uint
+                                                           width:vt.uniforms.minMipWidth
+                                                          height:vt.uniforms.minMipHeight
+                                                       mipmapped:NO];
+    minMipDesc.storageMode = MTLStorageModePrivate;
+    minMipDesc.usage = MTLTextureUsageShaderRead;
+    vt.minMip = [device newTextureWithDescriptor:minMipDesc];
+    vt.minMip.label = @"Virtual texture min-mip";
+
+    vt.pageBytes = compressed_image_bytes(vt.compression, vt.layout.pageWidth, vt.layout.pageHeight);
+    vt.pageRowBytes = compressed_row_bytes(vt.compression, vt.layout.pageWidth);
+    if (vt.compression != TextureCompression::None) {
+        vt.texels.resize((size_t)vt.settings.maxUploadsPerFrame * vt.layout.pageWidth *
+                         texture_block_format(vt.compression).height * 4);
+    }
+    vt.stagingFrameBytes = round_up(vt.settings.maxUploadsPerFrame * vt.pageBytes + vt.cache->min_mip().size(), 256);
+    vt.staging = [device newBufferWithLength:vt.stagingFrameBytes * DEFAULT_FRAMES_IN_FLIGHT
+                                     options:MTLResourceStorageModeShared | MTLResourceCPUCacheModeWriteCombined];
+    vt.staging.label = @"Virtual texture staging";
+
+    vt.feedbackCount = FEEDBACK_SLOTS;
+    vt.feedback = std::shared_ptr<VirtualTextureFeedbackSlot[]>(new VirtualTextureFeedbackSlot[FEEDBACK_SLOTS]);
+    for (uint32_t i = 0; i < FEEDBACK_SLOTS; ++i) {
+        vt.feedback[i].buffer = make_feedback_buffer(device, vt.layout);
+    }
+    vt.discardFeedback = make_feedback_buffer(device, vt.layout);
+    vt.boundFeedback = vt.discardFeedback;
+    vt.requests.assign(virtual_texture_feedback_words(vt.layout), 0);
+    // Reserved so updates never allocate
+    vt.update.loads.reserve(vt.layout.pageCount);
+    vt.update.evictions.reserve(vt.layout.pageCount);
+
+    fill_mip_tail(vt, device, queue);
+    return vt;
+}
+
+void terrain_virtual_texture_update(TerrainVirtualTexture& vt, id<MTLCommandBuffer> cmd, JobSystem& jobs) {
+    TRACE_SCOPE("Virtual texture");
+    ++vt.frame;
+    gather_feedback(vt);
+    vt.cache->update(vt.requests.data(), vt.frame, vt.settings.maxUploadsPerFrame, vt.update);
+    vt.pagesLoaded = (uint32_t)vt.update.loads.size();
+    bind_feedback(vt, cmd);
+    if (vt.update.loads.empty() && vt.update.evictions.empty()) {
+        return;
+    }
+
+    // The frame ring keeps at most DEFAULT_FRAMES_IN_FLIGHT frames in flight, so this region is free
+    const size_t stagingOffset = vt.stagingSlot * vt.stagingFrameBytes;
+    vt.stagingSlot = (vt.stagingSlot + 1) % DEFAULT_FRAMES_IN_FLIGHT;
+    uint8_t* staging = (uint8_t*)vt.staging.contents + stagingOffset;
+    const VirtualTextureLayout& layout = vt.layout;
+    const std::vector<uint32_t>& loads = vt.update.loads;
+
+    // Pages at the edge of a level smaller than a page are clipped to it
+    auto page_extent = [&layout](const VirtualPage& page) {
+        const uint32_t mipSize = virtual_texture_mip_size(layout, page.mip);
+        return MTLSizeMake(std::min(layout.pageWidth, mipSize - page.x * layout.pageWidth),
+                           std::min(layout.pageHeight, mipSize - page.y * layout.pageHeight), 1);
+    };
+    const size_t texelsPerPage = vt.texels.size() / vt.settings.maxUploadsPerFrame;
+    jobs.parallel_for((uint32_t)loads.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const VirtualPage page = virtual_page_at(layout, loads[i]);
+            const MTLSize extent = page_extent(page);
+            generate_blocks(vt, page.mip, page.x * layout.pageWidth, page.y * layout.pageHeight,
+                            (uint32_t)extent.width, (uint32_t)extent.height, staging + i * vt.pageBytes,
+                            vt.pageRowBytes, vt.texels.data() + i * texelsPerPage);
+        }
+    });
+
+    // Sparse mappings are addressed in pages
+    id<MTLResourceStateCommandEncoder> mapping = [cmd resourceStateCommandEncoder];
+    for (uint32_t index : vt.update.evictions) {
+        const VirtualPage page = virtual_page_at(layout, index);
+        [mapping updateTextureMapping:vt.texture
+                                 mode:MTLSparseTextureMappingModeUnmap
+                               region:MTLRegionMake2D(page.x, page.y, 1, 1)
+                             mipLevel:page.mip
+                                slice:0];
+    }
+    for (uint32_t index : loads) {
+        const VirtualPage page = virtual_page_at(layout, index);
+        [mapping updateTextureMapping:vt.texture
+                                 mode:MTLSparseTextureMappingModeMap
+                               region:MTLRegionMake2D(page.x, page.y, 1, 1)
+                             mipLevel:page.mip
+                                slice:0];
+    }
+    [mapping endEncoding];
+
+    id<MTLBlitCommandEncoder> blit = [cmd blitCommandEncoder];
+    for (size_t i = 0; i < loads.size(); ++i) {
+        const VirtualPage page = virtual_page_at(layout, loads[i]);
+        [blit copyFromBuffer:vt.staging
+                sourceOffset:stagingOffset + i * vt.pageBytes
+           sourceBytesPerRow:vt.pageRowBytes
+         sourceBytesPerImage:vt.pageBytes
+                  sourceSize:page_extent(page)
+                   toTexture:vt.texture
+            destinationSlice:0
+            destinationLevel:page.mip
+           destinationOrigin:MTLOriginMake(page.x * layout.pageWidth, page.y * layout.pageHeight, 0)];
+    }
+    if (vt.update.minMipChanged) {
+        const std::vector<uint8_t>& minMip = vt.cache->min_mip();
+        const size_t minMipOffset = vt.settings.maxUploadsPerFrame * vt.pageBytes;
+        memcpy(staging + minMipOffset, minMip.data(), minMip.size());
+        [blit copyFromBuffer:vt.staging
+                sourceOffset:stagingOffset + minMipOffset
+           sourceBytesPerRow:vt.minMip.width
+         sourceBytesPerImage:minMip.size()
+                  sourceSize:MTLSizeMake(vt.minMip.width, vt.minMip.height, 1)
+                   toTexture:vt.minMip
+            destinationSlice:0
+            destinationLevel:0
+           destinationOrigin:MTLOriginMake(0, 0, 0)];
+    }
+    [blit endEncoding];
+}
+
+void terrain_virtual_texture_bind(const TerrainVirtualTexture& vt, id<MTLRenderCommandEncoder> enc) {
+    [enc setFragmentTexture:vt.texture atIndex:1];
+    [enc setFragmentTexture:vt.minMip atIndex:2];
+    [enc setFragmentBytes:&vt.uniforms length:sizeof(VirtualTextureUniforms) atIndex:6];
+    [enc setFragmentBuffer:vt.boundFeedback offset:0 atIndex:7];
+}
+
+size_t terrain_virtual_texture_bytes(const TerrainVirtualTexture& vt) {
+    size_t bytes = vt.heap.size + vt.minMip.allocatedSize + vt.staging.allocatedSize + vt.discardFeedback.allocatedSize;
+    for (uint32_t i = 0; i < vt.feedbackCount; ++i) {
+        bytes += vt.feedback[i].buffer.allocatedSize;
+    }
+    return bytes;
+}
@@ -0,0 +1,305 @@
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // Weights of every ASTC block: a 4x4 grid of 3-bit weights in one plane
+    constexpr uint32_t ASTC_GRID = 4;
+    constexpr uint32_t ASTC_WEIGHT_BITS = 3;
+    constexpr uint32_t ASTC_BLOCK_MODE = 0x53;
+    // LDR RGB, direct: six 8-bit endpoint values, as the 63 bits left after the weights hold
+    constexpr uint32_t ASTC_CEM_LDR_RGB_DIRECT = 8;
+    constexpr uint32_t ASTC_ENDPOINTS_BIT = 17;
+    // The 3-bit weights once the GPU unquantizes them, out of 64
+    const uint8_t ASTC_WEIGHT_VALUES[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+    constexpr uint32_t MAX_BLOCK_TEXELS = 64;
+
+    struct Color {
+        float r, g, b;
+    };
+
+    Color operator-(Color a, Color b) { return { a.r - b.r, a.g - b.g, a.b - b.b }; }
+    Color operator+(Color a, Color b) { return { a.r + b.r, a.g + b.g, a.b + b.b }; }
+    Color operator*(Color a, float s) { return { a.r * s, a.g * s, a.b * s }; }
+    float dot(Color a, Color b) { return a.r * b.r + a.g * b.g + a.b * b.b; }
+
+    Color texel(const uint8_t* rgb, uint32_t i) {
+        return { (float)rgb[i * 3], (float)rgb[i * 3 + 1], (float)rgb[i * 3 + 2] };
+    }
+
+    uint8_t to_byte(float value) {
+        return (uint8_t)std::clamp((int)std::lround(value), 0, 255);
+    }
+
+    // The ends of the texels' spread along their principal axis, found by power iteration on the covariance
+    void principal_endpoints(const uint8_t* rgb, uint32_t count, Color& low, Color& high) {
+        Color mean = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t i = 0; i < count; ++i) {
+            mean = mean + texel(rgb, i);
+        }
+        mean = mean * (1.0f / count);
+
+        float cov[6] = {};
+        for (uint32_t i = 0; i < count; ++i) {
+            const Color d = texel(rgb, i) - mean;
+            cov[0] += d.r * d.r;
+            cov[1] += d.r * d.g;
+            cov[2] += d.r * d.b;
+            cov[3] += d.g * d.g;
+            cov[4] += d.g * d.b;
+            cov[5] += d.b * d.b;
+        }
+        // Starting from the row of the largest variance, which is never orthogonal to the principal axis
+        Color axis = { cov[0], cov[1], cov[2] };
+        if (cov[3] > cov[0] && cov[3] >= cov[5]) {
+            axis = { cov[1], cov[3], cov[4] };
+        } else if (cov[5] > cov[0]) {
+            axis = { cov[2], cov[4], cov[5] };
+        }
+        const float axisLength = std::sqrt(dot(axis, axis));
+        if (axisLength < 1e-6f) {
+            low = high = mean; // One colour
+            return;
+        }
+        axis = axis * (1.0f / axisLength);
+        for (int step = 0; step < 8; ++step) {
+            const Color next = { cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                                 cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                                 cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b };
+            const float length = std::sqrt(dot(next, next));
+            if (length < 1e-6f) {
+                break;
+            }
+            axis = next * (1.0f / length);
+        }
+
+        float lo = 0.0f, hi = 0.0f;
+        for (uint32_t i = 0; i < count; ++i) {
+            const float t = dot(texel(rgb, i) - mean, axis);
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+        low = mean + axis * lo;
+        high = mean + axis * hi;
+    }
+
+    // Where each texel lies between two endpoints, from 0 at a to 1 at b
+    void project(const uint8_t* rgb, uint32_t count, Color a, Color b, float* t) {
+        const Color d = b - a;
+        const float lengthSq = dot(d, d);
+        for (uint32_t i = 0; i < count; ++i) {
+            t[i] = lengthSq > 0.0f ? std::clamp(dot(texel(rgb, i) - a, d) / lengthSq, 0.0f, 1.0f) : 0.0f;
+        }
+    }
+
+    void put_bits(uint8_t* block, uint32_t bit, uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if ((value >> i) & 1) {
+                block[(bit + i) / 8] |= (uint8_t)(1 << ((bit + i) % 8));
+            }
+        }
+    }
+
+    uint16_t pack_565(Color c) {
+        const uint32_t r = (uint32_t)std::clamp((int)std::lround(c.r * 31.0f / 255.0f), 0, 31);
+        const uint32_t g = (uint32_t)std::clamp((int)std::lround(c.g * 63.0f / 255.0f), 0, 63);
+        const uint32_t b = (uint32_t)std::clamp((int)std::lround(c.b * 31.0f / 255.0f), 0, 31);
+        return (uint16_t)(r << 11 | g << 5 | b);
+    }
+
+    Color unpack_565(uint16_t c) {
+        const uint32_t r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+        return { (float)(r << 3 | r >> 2), (float)(g << 2 | g >> 4), (float)(b << 3 | b >> 2) };
+    }
+}
+
+TextureBlockFormat texture_block_format(TextureCompression compression) {
+    switch (compression) {
+    case TextureCompression::Astc4x4:
+        return { 4, 4, 16 };
+    case TextureCompression::Astc6x6:
+        return { 6, 6, 16 };
+    case TextureCompression::Astc8x8:
+        return { 8, 8, 16 };
+    case TextureCompression::Bc1:
+        return { 4, 4, 8 };
+    case TextureCompression::None:
+        break;
+    }
+    return { 1, 1, 4 };
+}
+
+size_t compressed_row_bytes(TextureCompression compression, uint32_t width) {
+    const TextureBlockFormat format = texture_block_format(compression);
+    return (size_t)(width + format.width - 1) / format.width * format.bytes;
+}
+
+size_t compressed_image_bytes(TextureCompression compression, uint32_t width, uint32_t height) {
+    const TextureBlockFormat format = texture_block_format(compression);
+    return compressed_row_bytes(compression, width) * ((height + format.height - 1) / format.height);
+}
+
+void compress_bgra_texels(TextureCompression compression, const uint8_t* bgra, size_t rowBytes, uint32_t width,
+                          uint32_t height, uint8_t* blocks, size_t outRowBytes) {
+    if (outRowBytes == 0) {
+        outRowBytes = compressed_row_bytes(compression, width);
+    }
+    if (compression == TextureCompression::None) {
+        for (uint32_t y = 0; y < height; ++y) {
+            memcpy(blocks + y * outRowBytes, bgra + y * rowBytes, (size_t)width * 4);
+        }
+        return;
+    }
+
+    const TextureBlockFormat format = texture_block_format(compression);
+    uint8_t rgb[MAX_BLOCK_TEXELS * 3];
+    for (uint32_t by = 0; by * format.height < height; ++by) {
+        uint8_t* out = blocks + by * outRowBytes;
+        for (uint32_t bx = 0; bx * format.width < width; ++bx, out += format.bytes) {
+            for (uint32_t y = 0; y < format.height; ++y) {
+                const uint32_t sy = std::min(by * format.height + y, height - 1);
+                for (uint32_t x = 0; x < format.width; ++x) {
+                    const uint32_t sx = std::min(bx * format.width + x, width - 1);
+                    const uint8_t* source = bgra + sy * rowBytes + (size_t)sx * 4;
+                    uint8_t* texel = rgb + (y * format.width + x) * 3;
+                    texel[0] = source[2];
+                    texel[1] = source[1];
+                    texel[2] = source[0];
+                }
+            }
+            if (compression == TextureCompression::Bc1) {
+                encode_bc1_block(rgb, out);
+            } else {
+                encode_astc_block(rgb, format.width, format.height, out);
+            }
+        }
+    }
+}
+
+void encode_astc_block(const uint8_t* rgb, uint32_t blockWidth, uint32_t blockHeight, uint8_t* block) {
+    const uint32_t count = blockWidth * blockHeight;
+    Color low, high;
+    principal_endpoints(rgb, count, low, high);
+    uint8_t e0[3] = { to_byte(low.r), to_byte(low.g), to_byte(low.b) };
+    uint8_t e1[3] = { to_byte(high.r), to_byte(high.g), to_byte(high.b) };
+    // The GPU swaps the endpoints and blue-contracts them when the second sums to less than the first
+    if (e1[0] + e1[1] + e1[2] < e0[0] + e0[1] + e0[2]) {
+        std::swap(e0, e1);
+    }
+
+    float ideal[MAX_BLOCK_TEXELS];
+    project(rgb, count, { (float)e0[0], (float)e0[1], (float)e0[2] }, { (float)e1[0], (float)e1[1], (float)e1[2] },
+            ideal);
+
+    // Each grid weight is the average of the texels it reaches, by the share the GPU's infill gives it
+    float sum[ASTC_GRID * ASTC_GRID] = {};
+    float share[ASTC_GRID * ASTC_GRID] = {};
+    const uint32_t ds = (1024 + blockWidth / 2) / (blockWidth - 1);
+    const uint32_t dt = (1024 + blockHeight / 2) / (blockHeight - 1);
+    for (uint32_t t = 0; t < blockHeight; ++t) {
+        const uint32_t gt = (dt * t * (ASTC_GRID - 1) + 32) >> 6;
+        for (uint32_t s = 0; s < blockWidth; ++s) {
+            const uint32_t gs = (ds * s * (ASTC_GRID - 1) + 32) >> 6;
+            const uint32_t js = gs >> 4, fs = gs & 15, jt = gt >> 4, ft = gt & 15;
+            const uint32_t w11 = (fs * ft + 8) >> 4;
+            const uint32_t corners[4][3] = { { js, jt, 16 - fs - ft + w11 }, { js + 1, jt, fs - w11 },
+                                             { js, jt + 1, ft - w11 }, { js + 1, jt + 1, w11 } };
+            for (const auto& corner : corners) {
+                if (corner[2] > 0 && corner[0] < ASTC_GRID && corner[1] < ASTC_GRID) {
+                    sum[corner[1] * ASTC_GRID + corner[0]] += corner[2] * ideal[t * blockWidth + s];
+                    share[corner[1] * ASTC_GRID + corner[0]] += (float)corner[2];
+                }
+            }
+        }
+    }
+
+    memset(block, 0, 16);
+    put_bits(block, 0, ASTC_BLOCK_MODE, 11);
+    put_bits(block, 11, 0, 2); // One partition
+    put_bits(block, 13, ASTC_CEM_LDR_RGB_DIRECT, 4);
+    const uint8_t endpoints[6] = { e0[0], e1[0], e0[1], e1[1], e0[2], e1[2] };
+    for (uint32_t i = 0; i < 6; ++i) {
+        put_bits(block, ASTC_ENDPOINTS_BIT + i * 8, endpoints[i], 8);
+    }
+    // Weights fill the block from its top bit down
+    for (uint32_t i = 0; i < ASTC_GRID * ASTC_GRID; ++i) {
+        const float target = share[i] > 0.0f ? sum[i] / share[i] * 64.0f : 0.0f;
+        uint32_t best = 0;
+        for (uint32_t q = 1; q < 8; ++q) {
+            if (std::fabs(ASTC_WEIGHT_VALUES[q] - target) < std::fabs(ASTC_WEIGHT_VALUES[best] - target)) {
+                best = q;
+            }
+        }
+        for (uint32_t b = 0; b < ASTC_WEIGHT_BITS; ++b) {
+            put_bits(block, 127 - (i * ASTC_WEIGHT_BITS + b), (best >> b) & 1, 1);
+        }
+    }
+}
+
+void encode_bc1_block(const uint8_t* rgb, uint8_t* block) {
+    Color low, high;
+    principal_endpoints(rgb, 16, low, high);
+    uint16_t c0 = pack_565(high);
+    uint16_t c1 = pack_565(low);
+    // Four-colour mode needs c0 > c1; equal endpoints decode the same in either mode
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    const Color p0 = unpack_565(c0), p1 = unpack_565(c1);
+    const Color palette[4] = { p0, p1, p0 * (2.0f / 3.0f) + p1 * (1.0f / 3.0f),
+                               p0 * (1.0f / 3.0f) + p1 * (2.0f / 3.0f) };
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            const Color c = texel(rgb, i);
+            uint32_t best = 0;
+            float bestError = dot(c - palette[0], c - palette[0]);
+            for (uint32_t p = 1; p < 4; ++p) {
+                const float error = dot(c - palette[p], c - palette[p]);
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+    block[0] = (uint8_t)c0;
+    block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)c1;
+    block[3] = (uint8_t)(c1 >> 8);
+    memcpy(block + 4, &indices, 4);
+}
+
+const char* texture_compression_name(TextureCompression compression) {
+    switch (compression) {
+    case TextureCompression::None:
+        return "none";
+    case TextureCompression::Astc4x4:
+        return "astc4x4";
+    case TextureCompression::Astc6x6:
+        return "astc6x6";
+    case TextureCompression::Astc8x8:
+        return "astc8x8";
+    case TextureCompression::Bc1:
+        return "bc1";
+    }
+    return "none";
+}
+
+bool parse_texture_compression(const char* name, TextureCompression& compression) {
+    const TextureCompression all[] = { TextureCompression::None, TextureCompression::Astc4x4,
+                                       TextureCompression::Astc6x6, TextureCompression::Astc8x8,
+                                       TextureCompression::Bc1 };
+    for (TextureCompression candidate : all) {
+        if (strcmp(name, texture_compression_name(candidate)) == 0) {
+            compression = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file texture_compression.hpp
+ * @brief Block compression of generated colour texels into ASTC or BC1, for textures streamed to the GPU.
+ *
+ * Every block format stores a block of texels as two endpoint colours and a weight per texel
+ * or per point of a coarser grid, which the GPU interpolates between the endpoints on every
+ * sample. The encoders here pick the endpoints along the block's principal colour axis and
+ * fit the weights to it, fast enough to run on the jobs that generate the texels.
+ *
+ * ASTC blocks are single-partition LDR RGB blocks with 8-bit endpoints and a 4x4 grid of
+ * 3-bit weights, whatever the block footprint; the GPU infills the grid over larger blocks,
+ * so 6x6 and 8x8 trade detail for 3.56 and 2 bits per texel against 8 for 4x4. BC1 is the
+ * fallback for GPUs without ASTC, at 4 bits per texel. Alpha is always opaque.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @enum TextureCompression
+ * @brief The block format a texture is stored in.
+ */
+enum class TextureCompression : uint8_t {
+    None,       ///< 32-bit BGRA texels.
+    Astc4x4,    ///< ASTC, 16 bytes per 4x4 block.
+    Astc6x6,    ///< ASTC, 16 bytes per 6x6 block.
+    Astc8x8,    ///< ASTC, 16 bytes per 8x8 block.
+    Bc1,        ///< BC1 (DXT1), 8 bytes per 4x4 block.
+};
+
+/**
+ * @struct TextureBlockFormat
+ * @brief The footprint and size of one block; 1x1 texels of 4 bytes when uncompressed.
+ */
+struct TextureBlockFormat {
+    uint32_t width;     ///< Texels along X of a block.
+    uint32_t height;    ///< Texels along Y of a block.
+    uint32_t bytes;     ///< Bytes of a block.
+};
+
+/// @return The block footprint and size of a format.
+TextureBlockFormat texture_block_format(TextureCompression compression);
+
+/// @return The bytes of one row of blocks covering width texels.
+size_t compressed_row_bytes(TextureCompression compression, uint32_t width);
+
+/// @return The bytes of the blocks covering a width x height image.
+size_t compressed_image_bytes(TextureCompression compression, uint32_t width, uint32_t height);
+
+/**
+ * @brief Compresses BGRA8 texels into rows of blocks.
+ *
+ * Blocks over the right or bottom edge repeat the last column or row of texels.
+ *
+ * @param compression The format; None copies the texels.
+ * @param bgra The texels, 4 bytes each in B, G, R, A order.
+ * @param rowBytes Bytes between rows of bgra.
+ * @param width Texels along X.
+ * @param height Texels along Y.
+ * @param blocks Receives compressed_image_bytes() bytes, or rows of outRowBytes apart.
+ * @param outRowBytes Bytes between rows of blocks in blocks; 0 for compressed_row_bytes().
+ */
+void compress_bgra_texels(TextureCompression compression, const uint8_t* bgra, size_t rowBytes, uint32_t width,
+                          uint32_t height, uint8_t* blocks, size_t outRowBytes = 0);
+
+/**
+ * @brief Encodes one ASTC block.
+ * @param rgb The block's texels, 3 bytes each in R, G, B order, row after row.
+ * @param blockWidth Texels along X; at most 8.
+ * @param blockHeight Texels along Y; at most 8.
+ * @param block Receives the 16-byte block.
+ */
+void encode_astc_block(const uint8_t* rgb, uint32_t blockWidth, uint32_t blockHeight, uint8_t* block);
+
+/**
+ * @brief Encodes one BC1 block in four-colour mode.
+ * @param rgb The 4x4 texels, 3 bytes each in R, G, B order, row after row.
+ * @param block Receives the 8-byte block.
+ */
+void encode_bc1_block(const uint8_t* rgb, uint8_t* block);
+
+/// @return The name of a format as --texture-compression takes it, e.g. "astc4x4".
+const char* texture_compression_name(TextureCompression compression);
+
+/**
+ * @brief Parses a format name.
+ * @param name One of the names texture_compression_name() returns.
+ * @param compression Receives the format.
+ * @return False if the name is unknown; compression is then left as it was.
+ */
+bool parse_texture_compression(const char* name, TextureCompression& compression);
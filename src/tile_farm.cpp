@@ -0,0 +1,321 @@
+#include "tile_farm.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+#include "json.hpp"
+#include "terrain_tile_cache.hpp"
+
+namespace {
+    uint64_t mix(uint64_t value) {
+        // splitmix64's finalizer
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+        return value ^ (value >> 31);
+    }
+
+    std::string hex(uint64_t value) {
+        char text[17];
+        snprintf(text, sizeof(text), "%016" PRIx64, value);
+        return text;
+    }
+
+    bool parse_hex(const JsonValue* value, uint64_t& out) {
+        if (!value || value->type != JsonValue::STRING || value->string.empty() || value->string.size() > 16) {
+            return false;
+        }
+        char* end = nullptr;
+        out = strtoull(value->string.c_str(), &end, 16);
+        return *end == '\0';
+    }
+
+    bool parse_int(const JsonValue* value, int64_t& out) {
+        if (!value || value->type != JsonValue::NUMBER) {
+            return false;
+        }
+        out = (int64_t)value->number;
+        return (double)out == value->number;
+    }
+
+    bool same_job(const TileFarmJob& a, const TileFarmJob& b) {
+        return a.generatorKey == b.generatorKey && a.range.minX == b.range.minX && a.range.minZ == b.range.minZ &&
+               a.range.maxX == b.range.maxX && a.range.maxZ == b.range.maxZ && a.workerCount == b.workerCount &&
+               a.regionChunks == b.regionChunks;
+    }
+
+    // Writes through a temporary name, so readers never see a partial file
+    bool write_file(const std::string& path, const std::string& contents) {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        const std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.write(contents.data(), contents.size())) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+uint64_t chunk_range_count(const ChunkRange& range) {
+    if (range.maxX < range.minX || range.maxZ < range.minZ) {
+        return 0;
+    }
+    return ((uint64_t)((int64_t)range.maxX - range.minX) + 1) * ((uint64_t)((int64_t)range.maxZ - range.minZ) + 1);
+}
+
+std::vector<ChunkRange> tile_farm_regions(const TileFarmJob& job) {
+    std::vector<ChunkRange> regions;
+    if (chunk_range_count(job.range) == 0 || job.regionChunks <= 0) {
+        return regions;
+    }
+    const int64_t step = job.regionChunks;
+    for (int64_t z = job.range.minZ; z <= job.range.maxZ; z += step) {
+        for (int64_t x = job.range.minX; x <= job.range.maxX; x += step) {
+            ChunkRange region;
+            region.minX = (int32_t)x;
+            region.minZ = (int32_t)z;
+            region.maxX = (int32_t)std::min(x + step - 1, (int64_t)job.range.maxX);
+            region.maxZ = (int32_t)std::min(z + step - 1, (int64_t)job.range.maxZ);
+            regions.push_back(region);
+        }
+    }
+    return regions;
+}
+
+std::vector<uint32_t> tile_farm_region_workers(const TileFarmJob& job) {
+    const std::vector<ChunkRange> regions = tile_farm_regions(job);
+    // Shuffle by a hash of the generator and the position, then deal the regions out in turn
+    std::vector<std::pair<uint64_t, uint32_t>> order(regions.size());
+    for (uint32_t i = 0; i < regions.size(); ++i) {
+        const uint64_t position = (uint64_t)(uint32_t)regions[i].minX << 32 | (uint32_t)regions[i].minZ;
+        order[i] = { mix(job.generatorKey ^ mix(position)), i };
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<uint32_t> workers(regions.size());
+    const uint32_t workerCount = std::max(job.workerCount, 1u);
+    for (uint32_t rank = 0; rank < order.size(); ++rank) {
+        workers[order[rank].second] = rank % workerCount;
+    }
+    return workers;
+}
+
+std::vector<ChunkKey> tile_farm_worker_chunks(const TileFarmJob& job, uint32_t worker) {
+    const std::vector<ChunkRange> regions = tile_farm_regions(job);
+    const std::vector<uint32_t> workers = tile_farm_region_workers(job);
+    std::vector<ChunkKey> keys;
+    for (size_t i = 0; i < regions.size(); ++i) {
+        if (workers[i] != worker) {
+            continue;
+        }
+        for (int32_t z = regions[i].minZ; z <= regions[i].maxZ; ++z) {
+            for (int32_t x = regions[i].minX; x <= regions[i].maxX; ++x) {
+                keys.push_back({ x, z });
+            }
+        }
+    }
+    return keys;
+}
+
+uint64_t tile_farm_content_hash(const void* data, size_t size) {
+    // FNV-1a, finished with the size so files that only differ in trailing zeros differ
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return mix(hash ^ size);
+}
+
+std::string tile_farm_object_path(const std::string& store, uint64_t contentHash) {
+    const std::string name = hex(contentHash);
+    return (std::filesystem::path(store) / "objects" / name.substr(0, 2) / (name + ".tile")).string();
+}
+
+std::string tile_farm_partial_manifest_path(const std::string& store, uint32_t worker, uint32_t workerCount) {
+    const std::string name = "worker-" + std::to_string(worker) + "-of-" + std::to_string(workerCount) + ".json";
+    return (std::filesystem::path(store) / "manifests" / name).string();
+}
+
+std::string tile_farm_manifest_path(const std::string& store) {
+    return (std::filesystem::path(store) / "manifest.json").string();
+}
+
+bool store_tile_farm_object(const std::string& store, const std::string& file, ChunkKey key, TileFarmEntry& entry) {
+    std::error_code error;
+    std::vector<char> contents(std::filesystem::file_size(file, error));
+    std::ifstream in(file, std::ios::binary);
+    if (error || contents.empty() || !in.read(contents.data(), contents.size())) {
+        return false;
+    }
+    entry.key = key;
+    entry.contentHash = tile_farm_content_hash(contents.data(), contents.size());
+    entry.size = contents.size();
+
+    const std::string object = tile_farm_object_path(store, entry.contentHash);
+    if (std::filesystem::file_size(object, error) == entry.size) {
+        std::remove(file.c_str());
+        return true;
+    }
+    std::filesystem::create_directories(std::filesystem::path(object).parent_path(), error);
+    if (std::rename(file.c_str(), object.c_str()) != 0) {
+        std::remove(file.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool write_tile_farm_manifest(const std::string& path, const TileFarmManifest& manifest) {
+    const TileFarmJob& job = manifest.job;
+    char line[256];
+    snprintf(line, sizeof(line),
+             "{\n  \"generator\": \"%s\",\n  \"range\": [%d, %d, %d, %d],\n  \"workers\": %u,\n"
+             "  \"regionChunks\": %d,\n  \"worker\": %d,\n  \"tiles\": [",
+             hex(job.generatorKey).c_str(), job.range.minX, job.range.minZ, job.range.maxX, job.range.maxZ,
+             job.workerCount, job.regionChunks, manifest.worker);
+    std::string text = line;
+    text.reserve(text.size() + manifest.entries.size() * 48);
+    for (size_t i = 0; i < manifest.entries.size(); ++i) {
+        const TileFarmEntry& entry = manifest.entries[i];
+        snprintf(line, sizeof(line), "%s\n    [%d, %d, \"%s\", %" PRIu64 "]", i > 0 ? "," : "", entry.key.x,
+                 entry.key.z, hex(entry.contentHash).c_str(), entry.size);
+        text += line;
+    }
+    text += "\n  ]\n}\n";
+    return write_file(path, text);
+}
+
+bool read_tile_farm_manifest(const std::string& path, TileFarmManifest& manifest, std::string& error) {
+    JsonValue root;
+    if (!load_json(path.c_str(), root, error)) {
+        return false;
+    }
+    TileFarmManifest result;
+    const JsonValue* range = root.find("range");
+    const JsonValue* tiles = root.find("tiles");
+    int64_t bounds[4], workers, regionChunks, worker;
+    bool valid = parse_hex(root.find("generator"), result.job.generatorKey) && range &&
+                 range->type == JsonValue::ARRAY && range->array.size() == 4 &&
+                 parse_int(root.find("workers"), workers) && workers > 0 &&
+                 parse_int(root.find("regionChunks"), regionChunks) && regionChunks > 0 &&
+                 parse_int(root.find("worker"), worker) && worker >= -1 && worker < workers && tiles &&
+                 tiles->type == JsonValue::ARRAY;
+    for (size_t i = 0; valid && i < 4; ++i) {
+        valid = parse_int(&range->array[i], bounds[i]);
+    }
+    if (!valid) {
+        error = path + ": not a tile farm manifest";
+        return false;
+    }
+    result.job.range = { (int32_t)bounds[0], (int32_t)bounds[1], (int32_t)bounds[2], (int32_t)bounds[3] };
+    result.job.workerCount = (uint32_t)workers;
+    result.job.regionChunks = (int32_t)regionChunks;
+    result.worker = (int32_t)worker;
+    result.entries.reserve(tiles->array.size());
+    for (const JsonValue& tile : tiles->array) {
+        TileFarmEntry entry;
+        int64_t x, z, size;
+        if (tile.type != JsonValue::ARRAY || tile.array.size() != 4 || !parse_int(&tile.array[0], x) ||
+            !parse_int(&tile.array[1], z) || !parse_hex(&tile.array[2], entry.contentHash) ||
+            !parse_int(&tile.array[3], size) || size <= 0) {
+            error = path + ": malformed tile entry";
+            return false;
+        }
+        entry.key = { (int32_t)x, (int32_t)z };
+        entry.size = (uint64_t)size;
+        result.entries.push_back(entry);
+    }
+    manifest = std::move(result);
+    return true;
+}
+
+bool merge_tile_farm(const std::string& store, uint32_t workerCount, TileFarmManifest& merged, std::string& error) {
+    TileFarmManifest result;
+    for (uint32_t worker = 0; worker < workerCount; ++worker) {
+        TileFarmManifest partial;
+        const std::string path = tile_farm_partial_manifest_path(store, worker, workerCount);
+        if (!read_tile_farm_manifest(path, partial, error)) {
+            return false;
+        }
+        if (partial.worker != (int32_t)worker || (worker > 0 && !same_job(partial.job, result.job))) {
+            error = path + ": belongs to another job";
+            return false;
+        }
+        result.job = partial.job;
+        result.entries.insert(result.entries.end(), partial.entries.begin(), partial.entries.end());
+    }
+
+    // Every chunk exactly once, and every object present
+    const ChunkRange& range = result.job.range;
+    const uint64_t count = chunk_range_count(range);
+    const uint64_t width = count > 0 ? (uint64_t)((int64_t)range.maxX - range.minX) + 1 : 1;
+    std::vector<bool> seen(count, false);
+    for (const TileFarmEntry& entry : result.entries) {
+        const ChunkKey key = entry.key;
+        if (key.x < range.minX || key.x > range.maxX || key.z < range.minZ || key.z > range.maxZ) {
+            error = "chunk " + std::to_string(key.x) + ", " + std::to_string(key.z) + " is outside the job";
+            return false;
+        }
+        const uint64_t row = (uint64_t)((int64_t)key.z - range.minZ);
+        const uint64_t index = row * width + (uint64_t)((int64_t)key.x - range.minX);
+        if (seen[index]) {
+            error = "chunk " + std::to_string(key.x) + ", " + std::to_string(key.z) + " is listed twice";
+            return false;
+        }
+        seen[index] = true;
+        std::error_code sizeError;
+        if (std::filesystem::file_size(tile_farm_object_path(store, entry.contentHash), sizeError) != entry.size) {
+            error = "the tile of chunk " + std::to_string(key.x) + ", " + std::to_string(key.z) + " is missing";
+            return false;
+        }
+    }
+    if (result.entries.size() != count) {
+        error = std::to_string(count - result.entries.size()) + " chunks of the job were not baked";
+        return false;
+    }
+
+    std::sort(result.entries.begin(), result.entries.end(), [](const TileFarmEntry& a, const TileFarmEntry& b) {
+        return a.key.z != b.key.z ? a.key.z < b.key.z : a.key.x < b.key.x;
+    });
+    result.worker = -1;
+    if (!write_tile_farm_manifest(tile_farm_manifest_path(store), result)) {
+        error = "cannot write " + tile_farm_manifest_path(store);
+        return false;
+    }
+    merged = std::move(result);
+    return true;
+}
+
+bool install_tile_farm(const std::string& store, const TileFarmManifest& manifest, const std::string& cacheRoot,
+                       std::string& error) {
+    const std::string directory = terrain_tile_directory(cacheRoot, manifest.job.generatorKey);
+    std::error_code fsError;
+    std::filesystem::create_directories(directory, fsError);
+    for (const TileFarmEntry& entry : manifest.entries) {
+        const std::string object = tile_farm_object_path(store, entry.contentHash);
+        const std::string path = terrain_tile_path(directory, entry.key);
+        const std::string temporary = path + "." + std::to_string(getpid()) + ".tmp";
+        // A link shares the object's pages; a copy works across file systems
+        std::filesystem::remove(temporary, fsError);
+        std::filesystem::create_hard_link(object, temporary, fsError);
+        if (fsError) {
+            std::filesystem::copy_file(object, temporary, std::filesystem::copy_options::overwrite_existing, fsError);
+        }
+        if (fsError || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::filesystem::remove(temporary, fsError);
+            error = "cannot install " + object + " as " + path;
+            return false;
+        }
+    }
+    return true;
+}
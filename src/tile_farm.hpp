@@ -0,0 +1,167 @@
+/**
+ * @file tile_farm.hpp
+ * @brief Splits the baking of a world's terrain tiles across worker processes or hosts.
+ *
+ * A farm job is a rectangle of chunks, cut into square regions of regionChunks chunks. The
+ * regions are dealt out to the workers in turn, in an order shuffled by hashing the generator
+ * key, which includes the terrain seed, with each region's position. Every worker computes
+ * its own share from the job alone without a coordinator, the shares differ by at most one
+ * region, and each spans the whole world rather than one band of it, so mountains and plains
+ * cost every worker alike.
+ *
+ * Workers write into a shared store: each tile file is placed under the hash of its contents
+ * (objects/<first two digits>/<hash>.tile) and listed in the worker's partial manifest.
+ * Identical bytes always land on the same name, so workers that overlap or rerun never
+ * conflict, and the manifest can be checked against the objects. merge_tile_farm() combines
+ * the partial manifests into manifest.json once every worker has finished and checks every
+ * chunk of the job is present exactly once; install_tile_farm() then links the tiles into a
+ * tile cache directory, named as the application looks them up.
+ *
+ * Manifests are JSON (see json.hpp); hashes and keys are hex strings, as JSON numbers are doubles.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+
+/// Default edge length of a farm region in chunks.
+constexpr int TILE_FARM_REGION_CHUNKS = 16;
+
+/**
+ * @struct ChunkRange
+ * @brief An inclusive rectangle of chunk coordinates.
+ */
+struct ChunkRange {
+    int32_t minX = 0; ///< Lowest chunk X.
+    int32_t minZ = 0; ///< Lowest chunk Z.
+    int32_t maxX = 0; ///< Highest chunk X.
+    int32_t maxZ = 0; ///< Highest chunk Z.
+};
+
+/// @return Number of chunks in the range; 0 if it is empty.
+uint64_t chunk_range_count(const ChunkRange& range);
+
+/**
+ * @struct TileFarmJob
+ * @brief What a farm bakes and how it is shared out; every worker and the merge must agree on it.
+ */
+struct TileFarmJob {
+    uint64_t generatorKey = 0;                   ///< terrain_tile_generator_key() of the tiles.
+    ChunkRange range;                            ///< Chunks to bake.
+    uint32_t workerCount = 1;                    ///< Workers sharing the job.
+    int32_t regionChunks = TILE_FARM_REGION_CHUNKS; ///< Edge length of a region in chunks.
+};
+
+/**
+ * @struct TileFarmEntry
+ * @brief One baked tile in a manifest.
+ */
+struct TileFarmEntry {
+    ChunkKey key;               ///< The chunk.
+    uint64_t contentHash = 0;   ///< tile_farm_content_hash() of the tile file, naming its object.
+    uint64_t size = 0;          ///< Bytes of the tile file.
+};
+
+/**
+ * @struct TileFarmManifest
+ * @brief The tiles of a job baked by one worker, or by all of them once merged.
+ */
+struct TileFarmManifest {
+    TileFarmJob job;                    ///< The job the tiles belong to.
+    int32_t worker = -1;                ///< The worker that wrote a partial manifest; -1 once merged.
+    std::vector<TileFarmEntry> entries; ///< The tiles, in the order written; merged ones by Z, then X.
+};
+
+/**
+ * @brief Cuts a job's range into regions, row after row; edge regions are clipped to the range.
+ * @param job The job.
+ * @return The regions.
+ */
+std::vector<ChunkRange> tile_farm_regions(const TileFarmJob& job);
+
+/**
+ * @brief Returns the worker of every region.
+ * @param job The job.
+ * @return One worker index below job.workerCount per region of tile_farm_regions(job).
+ */
+std::vector<uint32_t> tile_farm_region_workers(const TileFarmJob& job);
+
+/**
+ * @brief Returns the chunks of a worker's regions, region after region.
+ * @param job The job.
+ * @param worker The worker's index.
+ * @return The chunks.
+ */
+std::vector<ChunkKey> tile_farm_worker_chunks(const TileFarmJob& job, uint32_t worker);
+
+/// @return A 64-bit hash of bytes, naming their object in a store.
+uint64_t tile_farm_content_hash(const void* data, size_t size);
+
+/// @return The path of the object holding the file with a content hash.
+std::string tile_farm_object_path(const std::string& store, uint64_t contentHash);
+
+/// @return The path of a worker's partial manifest in a store.
+std::string tile_farm_partial_manifest_path(const std::string& store, uint32_t worker, uint32_t workerCount);
+
+/// @return The path of the merged manifest in a store.
+std::string tile_farm_manifest_path(const std::string& store);
+
+/**
+ * @brief Moves a finished tile file into a store under the hash of its contents.
+ *
+ * If the object already exists, it holds the same bytes and the file is only removed.
+ *
+ * @param store The store.
+ * @param file The tile file, written elsewhere in the store's file system.
+ * @param key The tile's chunk.
+ * @param entry Receives the manifest entry.
+ * @return True if the object is in place.
+ */
+bool store_tile_farm_object(const std::string& store, const std::string& file, ChunkKey key, TileFarmEntry& entry);
+
+/**
+ * @brief Writes a manifest under a temporary name and renames it into place.
+ * @param path The manifest path.
+ * @param manifest The manifest.
+ * @return True on success.
+ */
+bool write_tile_farm_manifest(const std::string& path, const TileFarmManifest& manifest);
+
+/**
+ * @brief Reads a manifest.
+ * @param path The manifest path.
+ * @param manifest Receives the manifest.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool read_tile_farm_manifest(const std::string& path, TileFarmManifest& manifest, std::string& error);
+
+/**
+ * @brief Combines the partial manifests of every worker of a job into the store's manifest.json.
+ *
+ * Fails, writing nothing, if a worker's manifest is missing or belongs to another job, or if
+ * a chunk of the job is missing, listed twice or outside it.
+ *
+ * @param store The store.
+ * @param workerCount Workers of the job.
+ * @param merged Receives the merged manifest.
+ * @param error Receives a description of the problem on failure.
+ * @return True if manifest.json was written.
+ */
+bool merge_tile_farm(const std::string& store, uint32_t workerCount, TileFarmManifest& merged, std::string& error);
+
+/**
+ * @brief Links, or copies where links are not possible, every tile of a merged manifest into a tile cache.
+ * @param store The store.
+ * @param manifest The merged manifest.
+ * @param cacheRoot The root of the tile cache; the tiles go to its terrain_tile_directory().
+ * @param error Receives a description of the problem on failure.
+ * @return True if every tile was installed.
+ */
+bool install_tile_farm(const std::string& store, const TileFarmManifest& manifest, const std::string& cacheRoot,
+                       std::string& error);
@@ -0,0 +1,55 @@
+/**
+ * @file trace.hpp
+ * @brief Scoped trace markers for Instruments: os_signpost intervals and Metal debug groups.
+ *
+ * TRACE_SCOPE("Name") marks the rest of the enclosing scope as a signpost interval in the
+ * Points of Interest track. TRACE_PUSH_GROUP(object, "Name") and TRACE_POP_GROUP(object) wrap
+ * the GPU work of a command buffer or encoder in a debug group, so the CPU interval that
+ * encoded some work and the GPU time it took line up in one trace. Names must be string literals.
+ *
+ * Without TRACING_ENABLED every macro expands to nothing. CMake defines it for Debug,
+ * RelWithDebInfo and Profile builds, and for Release and Dist builds configured with
+ * -DENABLE_TRACING=ON.
+ */
+
+#pragma once
+
+#if defined(TRACING_ENABLED) && defined(__APPLE__)
+#include <os/signpost.h>
+
+/// @return The log signposts are emitted to, shown in Instruments' Points of Interest track.
+inline os_log_t trace_log() {
+    static os_log_t log = os_log_create("glfw_metal", OS_LOG_CATEGORY_POINTS_OF_INTEREST);
+    return log;
+}
+
+/// Runs end when the scope holding it exits.
+template <typename F>
+struct TraceScopeEnd {
+    F end;
+    ~TraceScopeEnd() { end(); }
+};
+template <typename F>
+TraceScopeEnd(F) -> TraceScopeEnd<F>;
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Every interval gets its own id, so scopes on job threads may overlap
+#define TRACE_SCOPE(name)                                                                              \
+    const os_signpost_id_t TRACE_CONCAT(traceId_, __LINE__) = os_signpost_id_generate(trace_log());   \
+    os_signpost_interval_begin(trace_log(), TRACE_CONCAT(traceId_, __LINE__), name);                  \
+    TraceScopeEnd TRACE_CONCAT(traceEnd_, __LINE__){ [id = TRACE_CONCAT(traceId_, __LINE__)] {       \
+        os_signpost_interval_end(trace_log(), id, name);                                            \
+    } }
+
+#ifdef __OBJC__
+#define TRACE_PUSH_GROUP(object, name) [(object) pushDebugGroup:@"" name]
+#define TRACE_POP_GROUP(object) [(object) popDebugGroup]
+#endif
+
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_PUSH_GROUP(object, name) ((void)0)
+#define TRACE_POP_GROUP(object) ((void)0)
+#endif
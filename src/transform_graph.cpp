@@ -0,0 +1,174 @@
+#include "transform_graph.hpp"
+
+#include <algorithm>
+
+namespace {
+    // Depth of the node at a position
+    uint32_t level_of(const TransformGraph& graph, uint32_t position) {
+        return (uint32_t)(std::upper_bound(graph.levelEnds.begin(), graph.levelEnds.end(), position) -
+                          graph.levelEnds.begin());
+    }
+
+    template <typename T>
+    void compact(std::vector<T>& array, const std::vector<uint32_t>& remap) {
+        size_t kept = 0;
+        for (size_t i = 0; i < array.size(); ++i) {
+            if (remap[i] != UINT32_MAX) {
+                array[kept++] = array[i];
+            }
+        }
+        array.resize(kept);
+    }
+}
+
+TransformNode transform_graph_create(TransformGraph& graph, TransformNode parent, const Affine& local,
+                                     Entity entity) {
+    uint32_t parentPosition = TRANSFORM_ROOT;
+    uint32_t level = 0;
+    if (parent.index != UINT32_MAX) {
+        parentPosition = transform_graph_position(graph, parent);
+        if (parentPosition == UINT32_MAX) {
+            return {};
+        }
+        level = level_of(graph, parentPosition) + 1;
+    }
+    if (level == graph.levelEnds.size()) {
+        graph.levelEnds.push_back((uint32_t)graph.size());
+    }
+
+    // Make room at the end of the level; everything behind it moves back by one
+    const uint32_t position = graph.levelEnds[level];
+    for (uint32_t& p : graph.parents) {
+        if (p != TRANSFORM_ROOT && p >= position) {
+            ++p;
+        }
+    }
+    for (uint32_t i = position; i < graph.owners.size(); ++i) {
+        graph.positions[graph.owners[i]]++;
+    }
+    for (uint32_t i = level; i < graph.levelEnds.size(); ++i) {
+        graph.levelEnds[i]++;
+    }
+
+    TransformNode node;
+    if (!graph.freeSlots.empty()) {
+        node.index = graph.freeSlots.back();
+        graph.freeSlots.pop_back();
+    } else {
+        node.index = (uint32_t)graph.positions.size();
+        graph.positions.push_back(UINT32_MAX);
+        graph.generations.push_back(0);
+    }
+    node.generation = graph.generations[node.index];
+    graph.positions[node.index] = position;
+
+    graph.local.insert(graph.local.begin() + position, local);
+    graph.world.insert(graph.world.begin() + position, local);
+    graph.parents.insert(graph.parents.begin() + position, parentPosition);
+    graph.dirty.insert(graph.dirty.begin() + position, 1);
+    graph.entities.insert(graph.entities.begin() + position, entity);
+    graph.owners.insert(graph.owners.begin() + position, node.index);
+    graph.dirtyCount++;
+    return node;
+}
+
+void transform_graph_destroy(TransformGraph& graph, TransformNode node) {
+    const uint32_t root = transform_graph_position(graph, node);
+    if (root == UINT32_MAX) {
+        return;
+    }
+
+    // Parents come first, so one forward pass finds the whole subtree
+    std::vector<uint8_t> removed(graph.size(), 0);
+    removed[root] = 1;
+    for (uint32_t i = root + 1; i < graph.size(); ++i) {
+        removed[i] = graph.parents[i] != TRANSFORM_ROOT && removed[graph.parents[i]];
+    }
+
+    std::vector<uint32_t> remap(graph.size(), UINT32_MAX);
+    std::vector<uint32_t> levelSizes(graph.levelEnds.size(), 0);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < graph.size(); ++i) {
+        if (removed[i]) {
+            const uint32_t slot = graph.owners[i];
+            graph.positions[slot] = UINT32_MAX;
+            graph.generations[slot]++;
+            graph.freeSlots.push_back(slot);
+            graph.dirtyCount -= graph.dirty[i] ? 1 : 0;
+        } else {
+            remap[i] = kept++;
+            levelSizes[level_of(graph, i)]++;
+        }
+    }
+
+    compact(graph.local, remap);
+    compact(graph.world, remap);
+    compact(graph.parents, remap);
+    compact(graph.dirty, remap);
+    compact(graph.entities, remap);
+    compact(graph.owners, remap);
+    for (uint32_t i = 0; i < graph.size(); ++i) {
+        if (graph.parents[i] != TRANSFORM_ROOT) {
+            graph.parents[i] = remap[graph.parents[i]];
+        }
+        graph.positions[graph.owners[i]] = i;
+    }
+
+    graph.levelEnds.clear();
+    uint32_t end = 0;
+    for (uint32_t size : levelSizes) {
+        if (size == 0) {
+            break; // Levels below an emptied level are empty too
+        }
+        end += size;
+        graph.levelEnds.push_back(end);
+    }
+}
+
+uint32_t transform_graph_position(const TransformGraph& graph, TransformNode node) {
+    if (node.index >= graph.positions.size() || graph.generations[node.index] != node.generation) {
+        return UINT32_MAX;
+    }
+    return graph.positions[node.index];
+}
+
+void transform_graph_set_local(TransformGraph& graph, TransformNode node, const Affine& local) {
+    const uint32_t position = transform_graph_position(graph, node);
+    if (position == UINT32_MAX) {
+        return;
+    }
+    graph.local[position] = local;
+    if (!graph.dirty[position]) {
+        graph.dirty[position] = 1;
+        graph.dirtyCount++;
+    }
+}
+
+size_t transform_graph_update(TransformGraph& graph, SceneStore& scene) {
+    if (graph.dirtyCount == 0) {
+        return 0;
+    }
+
+    size_t updated = 0;
+    uint32_t begin = 0;
+    for (uint32_t end : graph.levelEnds) {
+        // Every parent of this level is final, so its nodes can be computed in any order
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t parent = graph.parents[i];
+            if (parent != TRANSFORM_ROOT && graph.dirty[parent]) {
+                graph.dirty[i] = 1;
+            }
+            if (!graph.dirty[i]) {
+                continue;
+            }
+            graph.world[i] = parent == TRANSFORM_ROOT ? graph.local[i] : affine_multiply(graph.world[parent], graph.local[i]);
+            scene_set_transform(scene, graph.entities[i], affine_matrix(graph.world[i]));
+            ++updated;
+        }
+        begin = end;
+    }
+
+    std::fill(graph.dirty.begin(), graph.dirty.end(), 0);
+    graph.dirtyCount = 0;
+    return updated;
+}
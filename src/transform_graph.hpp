@@ -0,0 +1,96 @@
+/**
+ * @file transform_graph.hpp
+ * @brief Parent/child transform hierarchy driving the transforms of scene entities.
+ *
+ * Nodes are stored breadth-first: all roots, then all their children, and so on, with
+ * each level contiguous. A parent therefore always sits before its children, and one
+ * forward pass computes every world matrix from parents that are already final. Within
+ * a level the nodes are independent of each other, so a level is one flat batch over the
+ * local and world arrays. Changing a local transform flags its node; the flag is pushed
+ * down to the subtree during the pass, and only flagged nodes multiply matrices and
+ * touch their entity, so moving a compound object costs the nodes that actually moved.
+ * Transforms are kept as 3x4 Affine matrices and only widened to float4x4 for the scene.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "affine.hpp"
+#include "scene.hpp"
+
+/**
+ * @struct TransformNode
+ * @brief Handle to a node of a TransformGraph; stops matching once the node is destroyed.
+ */
+struct TransformNode {
+    uint32_t index = UINT32_MAX;    ///< Slot in the handle table; UINT32_MAX means no node, e.g. no parent.
+    uint32_t generation = 0;        ///< Generation of the slot when the handle was issued.
+};
+
+/// Parent position of a root node.
+constexpr uint32_t TRANSFORM_ROOT = UINT32_MAX;
+
+/**
+ * @struct TransformGraph
+ * @brief Node arrays in breadth-first order plus the handle table mapping nodes to them.
+ */
+struct TransformGraph {
+    // --- Per node, in breadth-first order ---
+    std::vector<Affine> local;          ///< Transform relative to the parent.
+    std::vector<Affine> world;          ///< Model to world transform, valid after transform_graph_update().
+    std::vector<uint32_t> parents;      ///< Position of the parent, or TRANSFORM_ROOT.
+    std::vector<uint8_t> dirty;         ///< Non-zero if local changed since the last update.
+    std::vector<Entity> entities;       ///< The scene entity following the node; a default Entity for none.
+    std::vector<uint32_t> owners;       ///< Handle slot of each position.
+    std::vector<uint32_t> levelEnds;    ///< One past the last position of each depth.
+
+    // --- Handle table ---
+    std::vector<uint32_t> positions;    ///< Position of each handle slot, or UINT32_MAX when free.
+    std::vector<uint32_t> generations;  ///< Current generation of each handle slot.
+    std::vector<uint32_t> freeSlots;    ///< Handle slots ready for reuse.
+
+    uint32_t dirtyCount = 0;            ///< Nodes flagged since the last update; zero skips the pass.
+
+    /// @return The number of nodes.
+    size_t size() const { return local.size(); }
+};
+
+/**
+ * @brief Adds a node at the end of its level.
+ * @param graph The graph.
+ * @param parent The parent node, or a default TransformNode for a root.
+ * @param local The transform relative to the parent.
+ * @param entity The scene entity whose transform follows the node's world transform, if any.
+ * @return The new node, or a default TransformNode if the parent is stale.
+ */
+TransformNode transform_graph_create(TransformGraph& graph, TransformNode parent, const Affine& local,
+                                     Entity entity = {});
+
+/**
+ * @brief Removes a node and all of its descendants; their entities are kept.
+ * @param graph The graph.
+ * @param node The node; stale handles are ignored.
+ */
+void transform_graph_destroy(TransformGraph& graph, TransformNode node);
+
+/// @return The breadth-first position of a live node, or UINT32_MAX for a stale handle.
+uint32_t transform_graph_position(const TransformGraph& graph, TransformNode node);
+
+/**
+ * @brief Changes a node's transform relative to its parent.
+ * @param graph The graph.
+ * @param node The node; stale handles are ignored.
+ * @param local The new local transform; the subtree's world transforms follow on the next update.
+ */
+void transform_graph_set_local(TransformGraph& graph, TransformNode node, const Affine& local);
+
+/**
+ * @brief Recomputes the world transform of every flagged node and its descendants, level by level.
+ * @param graph The graph.
+ * @param scene Receives the new transforms of the entities attached to recomputed nodes.
+ * @return The number of nodes recomputed.
+ */
+size_t transform_graph_update(TransformGraph& graph, SceneStore& scene);
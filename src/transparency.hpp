@@ -0,0 +1,111 @@
+/**
+ * @file transparency.hpp
+ * @brief The transparent pass: weighted blended order-independent transparency in tile memory.
+ *
+ * Every pipeline of the scene pass is opaque. Transparent surfaces draw afterwards in a render
+ * pass of their own, which loads the scene colour and tests against the scene depth without
+ * writing it. They are not sorted: each fragment blends into two memoryless attachments, the
+ * weighted colour sum and the revealage (see oit.hpp), which only ever exist in the GPU's tile
+ * memory. The pass ends with one full-screen triangle that reads both through programmable
+ * blending and composites them over the scene colour, so the transparency costs no memory
+ * traffic beyond loading and storing the scene colour once. Being its own pass, it is timed
+ * as GPU_PASS_TRANSPARENT.
+ *
+ * The blend is commutative, so the fixed-function blender resolves overlapping fragments in any
+ * order and no raster order groups are needed. Water is the first transparent surface: an FFT
+ * ocean (see gpu_ocean.hpp) drawn as a clipmap around the camera, whose simulation is declared
+ * in the render graph just before the pass, on the compute queue when it may overlap the scene.
+ * Particles (see gpu_particles.hpp) are the exception to the order independence: their compute
+ * pass sorts them back to front, and they blend over the scene colour after the composite.
+ *
+ * The water reflects a prefiltered cube (see gpu_reflection_probe.hpp) where one is set, and the
+ * fog colour otherwise.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "camera.hpp"
+#include "frame_ring.hpp"
+#include "frame_stats.hpp"
+#include "gpu_ocean.hpp"
+#include "gpu_particles.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_render_graph.hpp"
+#include "metal_context.hpp"
+#include "resource_uploader.hpp"
+
+/// Weighted colour sum; colour attachment 1 of the transparent pass.
+constexpr MTLPixelFormat OIT_ACCUM_FORMAT = MTLPixelFormatRGBA16Float;
+/// Revealage, the product of (1 - alpha); colour attachment 2.
+constexpr MTLPixelFormat OIT_REVEALAGE_FORMAT = MTLPixelFormatR16Float;
+
+/**
+ * @struct WaterSettings
+ * @brief The water surface that fills the valleys below a fixed level; the waves move about it.
+ */
+struct WaterSettings {
+    float level = -1.5f;                                    ///< World height of the surface.
+    simd::float4 color = { 0.05f, 0.22f, 0.30f, 0.55f };    ///< rgb: deep colour, a: opacity looking straight down.
+};
+
+/**
+ * @struct Transparency
+ * @brief The memoryless OIT attachments and the transparent pass state.
+ */
+struct Transparency {
+    id<MTLRenderPipelineState> waterPipeline;       ///< water_vertex / water_fragment.
+    id<MTLRenderPipelineState> compositePipeline;   ///< composite_vertex / oit_composite_fragment.
+    id<MTLDepthStencilState> surfaceDepthState;     ///< Tests against the scene depth without writing it.
+    id<MTLDepthStencilState> compositeDepthState;   ///< Always passes, without writes.
+    id<MTLTexture> accum;                           ///< Colour attachment 1.
+    id<MTLTexture> revealage;                       ///< Colour attachment 2.
+    uint32_t width = 0;                             ///< Width of the attachments in pixels.
+    uint32_t height = 0;                            ///< Height of the attachments in pixels.
+    WaterSettings water;                            ///< The water surface.
+    GpuOcean ocean;                                 ///< The waves on it and the grid they are drawn on.
+    const GpuParticles* particles = nullptr;        ///< Drawn after the composite if set; owned by the caller.
+    id<MTLTexture> reflections;                     ///< Prefiltered cube the water reflects; nil reflects the fog.
+    id<MTLTexture> noReflections;                   ///< 1x1 cube bound in place of a nil reflections.
+};
+
+/// @return True if the device has memoryless attachments and programmable blending, and the pipelines and the
+/// ocean kernels compiled.
+bool transparency_supported(const MetalContext& metal);
+
+/**
+ * @brief Creates the transparent pass state without attachments; transparency_add_passes() allocates them.
+ * @param metal The Metal context; its water, OIT composite and ocean pipelines must exist.
+ * @param uploader Uploads the ocean's tables; must be flushed before the first transparency_add_passes().
+ * @param waterExtent How far from the camera the water reaches, e.g. the streamed radius.
+ * @param reverseZ True if the scene is drawn with a reverse-Z projection.
+ * @return The transparent pass state.
+ */
+Transparency create_transparency(const MetalContext& metal, ResourceUploader& uploader, float waterExtent,
+                                 bool reverseZ = false);
+
+/**
+ * @brief Declares the drawing of the transparent surfaces over a finished scene.
+ *
+ * Must be declared after the scene pass, which must have stored both color and depth. Declares
+ * the simulation of the waves for the given time first. The particles' passes, if any, must be
+ * declared before this.
+ *
+ * @param transparency The transparent pass state; must outlive the graph's execution.
+ * @param rg The frame's render graph.
+ * @param color The imported single-sample scene colour, composited in place.
+ * @param depth The imported scene depth the surfaces are tested against.
+ * @param keepDepth True if a later pass reads depth, so this pass stores it again.
+ * @param cam The camera of the scene pass.
+ * @param frameUniforms The FrameUniforms the scene pass used.
+ * @param time Seconds the waves are simulated at.
+ * @param oceanQueue The queue the wave simulation runs on; see gpu_ocean_add_passes().
+ * @param profiler Times the pass, and the ocean simulation on the render queue, as GPU_PASS_TRANSPARENT; may be null.
+ * @param frameStats Receives the draws and the pass traffic; must outlive the graph's execution.
+ */
+void transparency_add_passes(Transparency& transparency, GpuRenderGraph& rg, uint32_t color, uint32_t depth,
+                             bool keepDepth, const Camera& cam, const FrameAllocation& frameUniforms, double time,
+                             uint32_t oceanQueue, GpuProfiler* profiler, FrameStats& frameStats);
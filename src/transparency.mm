@@ -0,0 +1,172 @@
+#import "transparency.hpp"
+
+#include "deferred.hpp"
+#include "trace.hpp"
+
+namespace {
+    // Matches WaterUniforms in shaders.metal
+    struct WaterUniforms {
+        simd::float4 color;
+        float level;
+        float patchSize;
+        uint32_t gridSize;
+        uint32_t levelCount;
+        ClipmapLevel levels[CLIPMAP_MAX_LEVELS];
+        uint32_t reflectionMips;
+    };
+
+    id<MTLTexture> create_attachment(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                                     NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModeMemoryless;
+        desc.usage = MTLTextureUsageRenderTarget;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+
+    // Memoryless textures hold no memory, so reallocating only costs the texture objects
+    void resize(Transparency& transparency, id<MTLDevice> device, uint32_t width, uint32_t height) {
+        if (transparency.accum && transparency.width == width && transparency.height == height) {
+            return;
+        }
+        transparency.accum = create_attachment(device, OIT_ACCUM_FORMAT, width, height, @"OIT accumulation");
+        transparency.revealage = create_attachment(device, OIT_REVEALAGE_FORMAT, width, height, @"OIT revealage");
+        transparency.width = width;
+        transparency.height = height;
+    }
+
+    void attach(MTLRenderPassDescriptor* passDesc, NSUInteger index, id<MTLTexture> texture, double clear) {
+        passDesc.colorAttachments[index].texture = texture;
+        passDesc.colorAttachments[index].loadAction = MTLLoadActionClear;
+        passDesc.colorAttachments[index].storeAction = MTLStoreActionDontCare;
+        passDesc.colorAttachments[index].clearColor = MTLClearColorMake(clear, clear, clear, clear);
+    }
+}
+
+bool transparency_supported(const MetalContext& metal) {
+    return deferred_supported(metal.device) && metal.water_pipeline && metal.oit_composite_pipeline &&
+           gpu_ocean_supported(metal);
+}
+
+Transparency create_transparency(const MetalContext& metal, ResourceUploader& uploader, float waterExtent,
+                                 bool reverseZ) {
+    Transparency transparency;
+    transparency.waterPipeline = metal.water_pipeline;
+    transparency.compositePipeline = metal.oit_composite_pipeline;
+    transparency.ocean = create_gpu_ocean(metal, uploader, OceanSettings{}, waterExtent);
+
+    MTLDepthStencilDescriptor* depthDesc = [MTLDepthStencilDescriptor new];
+    depthDesc.depthCompareFunction = reverseZ ? MTLCompareFunctionGreater : MTLCompareFunctionLess;
+    depthDesc.depthWriteEnabled = NO;
+    transparency.surfaceDepthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+    depthDesc.depthCompareFunction = MTLCompareFunctionAlways;
+    transparency.compositeDepthState = [metal.device newDepthStencilStateWithDescriptor:depthDesc];
+
+    // The shader never reads it, but a bound texture keeps the validation layer quiet
+    MTLTextureDescriptor* cubeDesc = [MTLTextureDescriptor textureCubeDescriptorWithPixelFormat:MTLPixelFormatRGBA8Unorm
+                                                                                           size:1
+                                                                                      mipmapped:NO];
+    cubeDesc.storageMode = MTLStorageModePrivate;
+    cubeDesc.usage = MTLTextureUsageShaderRead;
+    transparency.noReflections = [metal.device newTextureWithDescriptor:cubeDesc];
+    transparency.noReflections.label = @"No reflections";
+    return transparency;
+}
+
+void transparency_add_passes(Transparency& transparency, GpuRenderGraph& rg, uint32_t color, uint32_t depth,
+                             bool keepDepth, const Camera& cam, const FrameAllocation& frameUniforms, double time,
+                             uint32_t oceanQueue, GpuProfiler* profiler, FrameStats& frameStats) {
+    id<MTLTexture> colorTexture = gpu_render_graph_resolve(rg, color);
+    resize(transparency, rg.device, (uint32_t)colorTexture.width, (uint32_t)colorTexture.height);
+    const GpuOcean& ocean = transparency.ocean;
+    const GpuOceanResources waves = gpu_ocean_add_passes(ocean, rg, time, oceanQueue, profiler);
+
+    WaterUniforms water;
+    water.color = transparency.water.color;
+    water.level = transparency.water.level;
+    water.patchSize = ocean.settings.patchSize;
+    water.gridSize = ocean.gridSize;
+    water.levelCount = ocean.levelCount;
+    clipmap_place(ocean.cellSize, ocean.levelCount, { cam.position.x, cam.position.z },
+                  ocean.settings.patchSize / ocean.settings.resolution, water.levels);
+    water.reflectionMips = transparency.reflections ? (uint32_t)transparency.reflections.mipmapLevelCount : 0;
+    id<MTLTexture> reflections = transparency.reflections ? transparency.reflections : transparency.noReflections;
+
+    const Transparency* state = &transparency;
+    const GpuRenderGraph* graph = &rg;
+    FrameStats* stats = &frameStats;
+    const FrameAllocation uniforms = frameUniforms;
+    const GpuParticles* particles = transparency.particles;
+    const Camera camera = cam;
+    gpu_render_graph_render_pass(
+        rg, "Transparent",
+        ^(MTLRenderPassDescriptor* passDesc) {
+            passDesc.colorAttachments[0].texture = gpu_render_graph_resolve(*graph, color);
+            passDesc.colorAttachments[0].loadAction = MTLLoadActionLoad;
+            passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+            attach(passDesc, 1, state->accum, 0.0);
+            attach(passDesc, 2, state->revealage, 1.0);
+            passDesc.depthAttachment.texture = gpu_render_graph_resolve(*graph, depth);
+            passDesc.depthAttachment.loadAction = MTLLoadActionLoad;
+            passDesc.depthAttachment.storeAction = keepDepth ? MTLStoreActionStore : MTLStoreActionDontCare;
+            gpu_profiler_sample_pass(profiler, passDesc, GPU_PASS_TRANSPARENT);
+        },
+        ^(id<MTLRenderCommandEncoder> enc) {
+            const GpuOcean& sea = state->ocean;
+            [enc setVertexBuffer:uniforms.buffer offset:uniforms.offset atIndex:5];
+            [enc setFragmentBuffer:uniforms.buffer offset:uniforms.offset atIndex:5];
+
+            TRACE_PUSH_GROUP(enc, "Water");
+            [enc setRenderPipelineState:state->waterPipeline];
+            [enc setDepthStencilState:state->surfaceDepthState];
+            [enc setVertexBytes:&water length:sizeof(water) atIndex:0];
+            [enc setFragmentBytes:&water length:sizeof(water) atIndex:0];
+            [enc setVertexTexture:sea.displacement atIndex:0];
+            [enc setFragmentTexture:sea.normals atIndex:0];
+            [enc setFragmentTexture:reflections atIndex:1];
+            // The innermost level is the full grid; every other level is one instance of the ring around it
+            [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                            indexCount:sea.fullCount
+                             indexType:MTLIndexTypeUInt16
+                           indexBuffer:sea.grid
+                     indexBufferOffset:0];
+            frame_stats_count_draw(*stats, sea.fullCount);
+            if (sea.levelCount > 1) {
+                [enc drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                                indexCount:sea.ringCount
+                                 indexType:MTLIndexTypeUInt16
+                               indexBuffer:sea.grid
+                         indexBufferOffset:sea.fullCount * sizeof(uint16_t)
+                             instanceCount:sea.levelCount - 1
+                                baseVertex:0
+                              baseInstance:1];
+                frame_stats_count_draw(*stats, sea.ringCount, sea.levelCount - 1);
+            }
+            TRACE_POP_GROUP(enc);
+
+            TRACE_PUSH_GROUP(enc, "OIT composite");
+            [enc setRenderPipelineState:state->compositePipeline];
+            [enc setDepthStencilState:state->compositeDepthState];
+            [enc drawPrimitives:MTLPrimitiveTypeTriangle vertexStart:0 vertexCount:3];
+            TRACE_POP_GROUP(enc);
+            frame_stats_count_draw(*stats, 3);
+
+            // Sorted, so they blend over the composited colour rather than into the weighted sums
+            if (particles) {
+                [enc setDepthStencilState:state->surfaceDepthState];
+                gpu_particles_draw(*particles, enc, camera, *stats);
+            }
+        });
+    render_graph_read(rg.graph, waves.displacement);
+    render_graph_read(rg.graph, waves.normals);
+    render_graph_read(rg.graph, color);
+    render_graph_read(rg.graph, depth);
+    render_graph_write(rg.graph, color);
+    if (keepDepth) {
+        render_graph_write(rg.graph, depth);
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file triple_buffer.hpp
+ * @brief Lock-free single-writer, single-reader exchange of the latest value.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @class TripleBuffer
+ * @brief Hands the most recent value from one thread to another without locks or waits.
+ *
+ * The writer fills its back slot and publishes it by swapping it with the middle slot;
+ * the reader swaps the middle slot with its front slot when a newer value is waiting.
+ * Neither side ever touches the other's slot, so a value is read while the next one
+ * is written. Values the reader has not picked up in time are overwritten, which suits
+ * state snapshots; use a queue for anything that must not be dropped.
+ *
+ * @tparam T The value type; copied in full on write().
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /// @param initial The value read() returns until the first publish().
+    explicit TripleBuffer(const T& initial = T{}) {
+        for (T& slot : m_slots) {
+            slot = initial;
+        }
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /// @return The writer's slot, to fill in place before publish(). Writer thread only.
+    T& back() { return m_slots[m_back]; }
+
+    /// @brief Makes the back slot the latest value and takes over an unused slot. Writer thread only.
+    void publish() {
+        const uint32_t previous = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        m_back = previous & INDEX_MASK;
+    }
+
+    /// @brief Copies a value into the back slot and publishes it. Writer thread only.
+    void write(const T& value) {
+        back() = value;
+        publish();
+    }
+
+    /**
+     * @brief Takes the latest published value if there is one the reader has not seen. Reader thread only.
+     * @return True if read() now returns a newer value.
+     */
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        const uint32_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX_MASK;
+        return true;
+    }
+
+    /// @return The value taken by the last update(). Reader thread only.
+    const T& read() const { return m_slots[m_front]; }
+
+private:
+    static constexpr uint32_t INDEX_MASK = 0x3;
+    static constexpr uint32_t FRESH = 0x4;    ///< Set in m_middle while it holds an unread value.
+
+    T m_slots[3];
+    uint32_t m_back = 0;                                // Owned by the writer
+    alignas(64) std::atomic<uint32_t> m_middle{ 1 };    // Slot index plus FRESH, swapped by both sides
+    alignas(64) uint32_t m_front = 2;                   // Owned by the reader
+};
@@ -0,0 +1,187 @@
+#include "tuning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "json.hpp"
+
+namespace {
+    double read_target(const Tunable& tunable) {
+        switch (tunable.type) {
+        case TunableType::Float:
+            return *(const float*)tunable.target;
+        case TunableType::Int:
+            return *(const int32_t*)tunable.target;
+        case TunableType::Bool:
+            return *(const bool*)tunable.target ? 1.0 : 0.0;
+        }
+        return 0.0;
+    }
+
+    void write_target(const Tunable& tunable, double value) {
+        switch (tunable.type) {
+        case TunableType::Float:
+            *(float*)tunable.target = (float)value;
+            break;
+        case TunableType::Int:
+            *(int32_t*)tunable.target = (int32_t)value;
+            break;
+        case TunableType::Bool:
+            *(bool*)tunable.target = value != 0.0;
+            break;
+        }
+    }
+
+    // The name is written as is, so it must not need escaping
+    bool plain_name(const char* name) {
+        for (const char* c = name; *c; ++c) {
+            if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) {
+                return false;
+            }
+        }
+        return *name != '\0';
+    }
+}
+
+uint32_t TuningRegistry::add(const char* group, const char* name, TunableType type, void* target, double value,
+                             double min, double max, bool startup) {
+    // A duplicate or unwritable name is a programming error; the knob is still returned so callers need no check
+    if (find(name) != NONE || !plain_name(name)) {
+        fprintf(stderr, "Tunable \"%s\" is a duplicate or cannot be saved\n", name);
+    }
+    Tunable tunable;
+    tunable.group = group;
+    tunable.name = name;
+    tunable.type = type;
+    tunable.target = target;
+    tunable.value = value;
+    tunable.applied = value;
+    tunable.defaultValue = value;
+    tunable.min = min;
+    tunable.max = max;
+    tunable.startup = startup;
+    m_tunables.push_back(std::move(tunable));
+    return (uint32_t)m_tunables.size() - 1;
+}
+
+uint32_t TuningRegistry::add(const char* group, const char* name, float* target, float min, float max, bool startup) {
+    return add(group, name, TunableType::Float, target, *target, min, max, startup);
+}
+
+uint32_t TuningRegistry::add(const char* group, const char* name, int32_t* target, int32_t min, int32_t max,
+                             bool startup) {
+    return add(group, name, TunableType::Int, target, *target, min, max, startup);
+}
+
+uint32_t TuningRegistry::add(const char* group, const char* name, bool* target, bool startup) {
+    return add(group, name, TunableType::Bool, target, *target ? 1.0 : 0.0, 0.0, 1.0, startup);
+}
+
+uint32_t TuningRegistry::find(const std::string& name) const {
+    for (uint32_t i = 0; i < m_tunables.size(); ++i) {
+        if (m_tunables[i].name == name) {
+            return i;
+        }
+    }
+    return NONE;
+}
+
+void TuningRegistry::set(uint32_t i, double value) {
+    Tunable& tunable = m_tunables[i];
+    if (!std::isfinite(value)) {
+        return;
+    }
+    if (tunable.type != TunableType::Float) {
+        value = std::round(value);
+    }
+    tunable.value = std::clamp(value, tunable.min, tunable.max);
+}
+
+void TuningRegistry::reset() {
+    for (Tunable& tunable : m_tunables) {
+        tunable.value = tunable.defaultValue;
+    }
+}
+
+uint32_t TuningRegistry::apply() {
+    uint32_t written = 0;
+    for (Tunable& tunable : m_tunables) {
+        // The code may have moved the target itself; the staged value wins only when it was edited
+        tunable.changed = tunable.value != tunable.applied;
+        if (tunable.changed) {
+            write_target(tunable, tunable.value);
+            tunable.applied = read_target(tunable);
+            tunable.value = tunable.applied;
+            ++written;
+        }
+    }
+    return written;
+}
+
+bool TuningRegistry::pending() const {
+    return std::any_of(m_tunables.begin(), m_tunables.end(),
+                       [](const Tunable& tunable) { return tunable.value != tunable.applied; });
+}
+
+std::string TuningRegistry::to_json() const {
+    std::string text = "{";
+    char number[64];
+    for (size_t i = 0; i < m_tunables.size(); ++i) {
+        const Tunable& tunable = m_tunables[i];
+        text += i > 0 ? ",\n  \"" : "\n  \"";
+        text += tunable.name;
+        text += "\": ";
+        if (tunable.type == TunableType::Bool) {
+            text += tunable.value != 0.0 ? "true" : "false";
+        } else {
+            // Nine significant digits bring every float back bit for bit
+            snprintf(number, sizeof(number), tunable.type == TunableType::Float ? "%.9g" : "%.0f", tunable.value);
+            text += number;
+        }
+    }
+    text += m_tunables.empty() ? "}\n" : "\n}\n";
+    return text;
+}
+
+bool TuningRegistry::from_json(const std::string& text, std::string& error) {
+    JsonValue root;
+    if (!parse_json(text, root, error)) {
+        return false;
+    }
+    if (root.type != JsonValue::OBJECT) {
+        error = "tuning must be a JSON object";
+        return false;
+    }
+    for (const auto& [name, value] : root.object) {
+        const uint32_t i = find(name);
+        if (i == NONE) {
+            continue;
+        }
+        if (value.type == JsonValue::NUMBER) {
+            set(i, value.number);
+        } else if (value.type == JsonValue::LITERAL && (value.string == "true" || value.string == "false")) {
+            set(i, value.string == "true" ? 1.0 : 0.0);
+        }
+    }
+    return true;
+}
+
+bool TuningRegistry::save(const char* filename) const {
+    std::ofstream file(filename, std::ios::trunc);
+    const std::string text = to_json();
+    return file && file.write(text.data(), text.size());
+}
+
+bool TuningRegistry::load(const char* filename, std::string& error) {
+    std::ifstream file(filename);
+    if (!file) {
+        error = std::string("cannot open ") + filename;
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return from_json(text.str(), error);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file tuning.hpp
+ * @brief A registry of typed performance knobs, edited live from a generated panel and kept in a JSON file.
+ *
+ * Each knob is bound to the variable the code already reads, such as a field of a settings
+ * struct. Edits from the panel or a loaded file are only staged: apply(), called once at the
+ * top of a frame, writes every staged value to its variable and flags the knobs it changed,
+ * so nothing moves under a frame halfway through, and the code that owns a knob can react to
+ * the flag, e.g. by reallocating a texture. Knobs that can only be read at startup are marked
+ * as such; they are saved like the others and take effect on the next run.
+ *
+ * The file is a flat JSON object of knob names and values. Loading it ignores unknown names
+ * and clamps values into each knob's range, so files outlive the knobs they were written with.
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @enum TunableType
+ * @brief The type of variable a knob writes.
+ */
+enum class TunableType {
+    Float,  ///< float; shown as a slider.
+    Int,    ///< int32_t; shown as an integer slider.
+    Bool,   ///< bool; shown as a checkbox.
+};
+
+/**
+ * @struct Tunable
+ * @brief One knob; values are held as doubles whatever the type.
+ */
+struct Tunable {
+    std::string group;                  ///< Section of the panel.
+    std::string name;                   ///< Label in the panel and key in the file; unique.
+    TunableType type = TunableType::Float;
+    void* target = nullptr;             ///< The variable apply() writes.
+    double value = 0.0;                 ///< Staged value, written at the next apply().
+    double applied = 0.0;               ///< Value last written to the target.
+    double defaultValue = 0.0;          ///< The target's value when it was added.
+    double min = 0.0;                   ///< Smallest value.
+    double max = 1.0;                   ///< Largest value.
+    bool startup = false;               ///< Only read at startup; a change takes effect on the next run.
+    bool changed = false;               ///< Set by the last apply() if it wrote this knob.
+};
+
+/**
+ * @class TuningRegistry
+ * @brief The knobs, in the order they were added.
+ */
+class TuningRegistry {
+public:
+    /// Index returned for a name no knob has.
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /**
+     * @brief Adds a knob; the target's current value becomes its default.
+     * @param group Section of the panel.
+     * @param name Label and key; must not be taken.
+     * @param target Written by apply(); must outlive the registry's use of it.
+     * @param min Smallest value.
+     * @param max Largest value.
+     * @param startup True if the target is only read at startup.
+     * @return The knob's index.
+     */
+    uint32_t add(const char* group, const char* name, float* target, float min, float max, bool startup = false);
+    uint32_t add(const char* group, const char* name, int32_t* target, int32_t min, int32_t max,
+                 bool startup = false);
+    uint32_t add(const char* group, const char* name, bool* target, bool startup = false);
+
+    /// @return The index of the knob with this name, or NONE.
+    uint32_t find(const std::string& name) const;
+
+    /// @return The number of knobs.
+    uint32_t size() const { return (uint32_t)m_tunables.size(); }
+
+    /// @return Knob i.
+    const Tunable& operator[](uint32_t i) const { return m_tunables[i]; }
+
+    /// Stages a value for knob i, clamped to its range and rounded for integer and boolean knobs.
+    void set(uint32_t i, double value);
+
+    /// Stages every knob's default.
+    void reset();
+
+    /**
+     * @brief Writes the staged values that differ from the applied ones; call at a frame boundary.
+     * @return The number of knobs written; each has changed set until the next apply().
+     */
+    uint32_t apply();
+
+    /// @return True if the last apply() wrote knob i; false for NONE.
+    bool changed(uint32_t i) const { return i < m_tunables.size() && m_tunables[i].changed; }
+
+    /// @return True if a staged value waits for apply().
+    bool pending() const;
+
+    /// @return The staged values as a JSON object, one member per line.
+    std::string to_json() const;
+
+    /**
+     * @brief Stages the values of a JSON object; unknown names and non-number values are skipped.
+     * @param text The object.
+     * @param error Receives the parse error on failure.
+     * @return True if the text was an object.
+     */
+    bool from_json(const std::string& text, std::string& error);
+
+    /// @return True if the staged values were written to the file.
+    bool save(const char* filename) const;
+
+    /**
+     * @brief Stages the values of a file written by save().
+     * @param filename The file.
+     * @param error Receives a description of the problem on failure.
+     * @return True on success.
+     */
+    bool load(const char* filename, std::string& error);
+
+private:
+    uint32_t add(const char* group, const char* name, TunableType type, void* target, double value, double min,
+                 double max, bool startup);
+
+    std::vector<Tunable> m_tunables;
+};
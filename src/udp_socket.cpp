@@ -0,0 +1,91 @@
+#include "udp_socket.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    sockaddr_in to_sockaddr(const UdpAddress& address) {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(address.host);
+        addr.sin_port = htons(address.port);
+        return addr;
+    }
+}
+
+bool udp_address_parse(const char* text, UdpAddress& address) {
+    const char* colon = strrchr(text, ':');
+    if (!colon || colon == text || colon[1] == '\0') {
+        return false;
+    }
+    const std::string host(text, colon - text);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* found = nullptr;
+    if (getaddrinfo(host.c_str(), colon + 1, &hints, &found) != 0 || !found) {
+        return false;
+    }
+    const sockaddr_in* addr = (const sockaddr_in*)found->ai_addr;
+    address.host = ntohl(addr->sin_addr.s_addr);
+    address.port = ntohs(addr->sin_port);
+    freeaddrinfo(found);
+    return true;
+}
+
+bool udp_socket_open(UdpSocket& socket, uint16_t port, std::string& error) {
+    udp_socket_close(socket);
+    const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        error = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    sockaddr_in addr = to_sockaddr({ INADDR_ANY, port });
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = std::string("bind: ") + strerror(errno);
+        close(fd);
+        return false;
+    }
+    socklen_t length = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &length);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    socket.fd = fd;
+    socket.port = ntohs(addr.sin_port);
+    return true;
+}
+
+void udp_socket_close(UdpSocket& socket) {
+    if (socket.fd >= 0) {
+        close(socket.fd);
+    }
+    socket.fd = -1;
+    socket.port = 0;
+}
+
+bool udp_socket_send(const UdpSocket& socket, const UdpAddress& to, const uint8_t* data, size_t size) {
+    const sockaddr_in addr = to_sockaddr(to);
+    return sendto(socket.fd, data, size, 0, (const sockaddr*)&addr, sizeof(addr)) == (ssize_t)size;
+}
+
+size_t udp_socket_receive(const UdpSocket& socket, UdpAddress& from, uint8_t* buffer, size_t capacity) {
+    sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    // An empty datagram reads as nothing waiting, which is all it could mean here
+    const ssize_t received = recvfrom(socket.fd, buffer, capacity, 0, (sockaddr*)&addr, &length);
+    if (received <= 0) {
+        return 0;
+    }
+    from.host = ntohl(addr.sin_addr.s_addr);
+    from.port = ntohs(addr.sin_port);
+    return (size_t)received;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file udp_socket.hpp
+ * @brief A non-blocking IPv4 UDP socket over the POSIX socket API.
+ *
+ * Only what replication needs: bind, send a datagram, and drain whatever has arrived
+ * without waiting, so the frame loop can poll it once per frame.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @struct UdpAddress
+ * @brief An IPv4 endpoint.
+ */
+struct UdpAddress {
+    uint32_t host = 0;  ///< IPv4 address in host byte order.
+    uint16_t port = 0;  ///< Port in host byte order.
+
+    bool operator==(const UdpAddress& other) const { return host == other.host && port == other.port; }
+};
+
+/**
+ * @struct UdpSocket
+ * @brief An open socket, or fd -1.
+ */
+struct UdpSocket {
+    int fd = -1;        ///< The descriptor.
+    uint16_t port = 0;  ///< The local port it is bound to.
+};
+
+/**
+ * @brief Resolves "host:port" to an IPv4 address.
+ * @param text The host name or dotted address, a colon and the port.
+ * @param address Receives the address.
+ * @return False if the text has no port or the host does not resolve.
+ */
+bool udp_address_parse(const char* text, UdpAddress& address);
+
+/**
+ * @brief Opens a non-blocking socket bound to a port on every interface.
+ * @param socket Receives the socket.
+ * @param port The port; 0 picks a free one, which socket.port reports.
+ * @param error Receives a description of the problem on failure.
+ * @return True on success.
+ */
+bool udp_socket_open(UdpSocket& socket, uint16_t port, std::string& error);
+
+/// Closes the socket if it is open.
+void udp_socket_close(UdpSocket& socket);
+
+/**
+ * @brief Sends one datagram.
+ * @param socket The socket.
+ * @param to The destination.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return False if the datagram was not handed to the network, e.g. because its buffer is full.
+ */
+bool udp_socket_send(const UdpSocket& socket, const UdpAddress& to, const uint8_t* data, size_t size);
+
+/**
+ * @brief Takes the next datagram that arrived, if any.
+ * @param socket The socket.
+ * @param from Receives the sender.
+ * @param buffer Receives the bytes; a longer datagram is truncated.
+ * @param capacity Bytes available.
+ * @return The number of bytes received, or 0 when nothing is waiting.
+ */
+size_t udp_socket_receive(const UdpSocket& socket, UdpAddress& from, uint8_t* buffer, size_t capacity);
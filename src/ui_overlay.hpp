@@ -0,0 +1,62 @@
+/**
+ * @file ui_overlay.hpp
+ * @brief The retained UI overlay: ImGui rendered into a texture of its own, composited every frame.
+ *
+ * ImGui draws with source-alpha blending for colour and one / one-minus-source-alpha for alpha,
+ * so over a target cleared to transparent black it leaves colour premultiplied by coverage and
+ * the coverage in alpha. composite_fragment lays that over the scene with
+ * scene * (1 - alpha) + colour, which is what drawing the same lists over the scene would give.
+ *
+ * ui_refresh.hpp decides when the texture is rendered again; in between, the frame neither lays
+ * out the UI nor encodes its draws, and the composite reads the texture it already holds.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+
+#include <cstddef>
+
+#include "frame_stats.hpp"
+#include "gpu_profiler.hpp"
+#include "ui_refresh.hpp"
+
+struct ImDrawData;
+
+/**
+ * @struct UiOverlay
+ * @brief The overlay texture and when it was rendered.
+ */
+struct UiOverlay {
+    id<MTLTexture> texture;     ///< Premultiplied UI at the drawable's size and format.
+    UiRefresh refresh;          ///< What texture holds.
+};
+
+/**
+ * @brief Returns the render pass the overlay is drawn in, reallocating the texture if the size changed.
+ *
+ * Also hands ImGui_ImplMetal_NewFrame() the format its pipelines are built for.
+ *
+ * @param overlay The overlay.
+ * @param device The device.
+ * @param format The drawable's pixel format.
+ * @param width The drawable's width in pixels.
+ * @param height The drawable's height in pixels.
+ * @return A pass that clears the texture to transparent black and stores it.
+ */
+MTLRenderPassDescriptor* ui_overlay_pass(UiOverlay& overlay, id<MTLDevice> device, MTLPixelFormat format,
+                                         uint32_t width, uint32_t height);
+
+/**
+ * @brief Renders ImGui's draw lists into the overlay in a pass of its own, timed as GPU_PASS_OVERLAY.
+ * @param overlay The overlay.
+ * @param cmd The command buffer; committed before the composite that reads the texture.
+ * @param passDesc The pass returned by ui_overlay_pass() this frame.
+ * @param drawData The lists ImGui::Render() produced.
+ * @param profiler Nullable GPU pass profiler.
+ * @param frameStats Counts the pass.
+ */
+void ui_overlay_render(UiOverlay& overlay, id<MTLCommandBuffer> cmd, MTLRenderPassDescriptor* passDesc,
+                       ImDrawData* drawData, GpuProfiler* profiler, FrameStats& frameStats);
+
+/// @return GPU bytes held by the overlay texture.
+size_t ui_overlay_bytes(const UiOverlay& overlay);
@@ -0,0 +1,44 @@
+#import "ui_overlay.hpp"
+
+#import "imgui_impl_metal.h"
+
+#include "render_targets.hpp"
+#include "trace.hpp"
+
+MTLRenderPassDescriptor* ui_overlay_pass(UiOverlay& overlay, id<MTLDevice> device, MTLPixelFormat format,
+                                         uint32_t width, uint32_t height) {
+    if (!overlay.texture || overlay.texture.width != width || overlay.texture.height != height ||
+        overlay.texture.pixelFormat != format) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead;
+        overlay.texture = [device newTextureWithDescriptor:desc];
+        overlay.texture.label = @"UI overlay";
+        overlay.refresh.valid = false;
+    }
+    MTLRenderPassDescriptor* passDesc = [MTLRenderPassDescriptor renderPassDescriptor];
+    passDesc.colorAttachments[0].texture = overlay.texture;
+    passDesc.colorAttachments[0].loadAction = MTLLoadActionClear;
+    passDesc.colorAttachments[0].storeAction = MTLStoreActionStore;
+    passDesc.colorAttachments[0].clearColor = MTLClearColorMake(0.0, 0.0, 0.0, 0.0);
+    return passDesc;
+}
+
+void ui_overlay_render(UiOverlay& overlay, id<MTLCommandBuffer> cmd, MTLRenderPassDescriptor* passDesc,
+                       ImDrawData* drawData, GpuProfiler* profiler, FrameStats& frameStats) {
+    frame_stats_count_pass(frameStats, audit_render_pass(passDesc, "UI overlay"));
+    gpu_profiler_sample_pass(profiler, passDesc, GPU_PASS_OVERLAY);
+    id<MTLRenderCommandEncoder> enc = [cmd renderCommandEncoderWithDescriptor:passDesc];
+    enc.label = @"UI overlay";
+    TRACE_PUSH_GROUP(enc, "ImGui");
+    ImGui_ImplMetal_RenderDrawData(drawData, cmd, enc);
+    TRACE_POP_GROUP(enc);
+    [enc endEncoding];
+}
+
+size_t ui_overlay_bytes(const UiOverlay& overlay) {
+    return overlay.texture ? overlay.texture.allocatedSize : 0;
+}
@@ -0,0 +1,20 @@
+#include "ui_refresh.hpp"
+
+bool ui_refresh_due(const UiRefresh& refresh, double now, bool inputPending, uint32_t width, uint32_t height) {
+    if (!refresh.valid || refresh.width != width || refresh.height != height) {
+        return true;
+    }
+    return inputPending || refresh.settleFrames > 0 || now - refresh.lastLayout >= UI_REFRESH_SECONDS;
+}
+
+void ui_refresh_laid_out(UiRefresh& refresh, double now, bool inputPending, uint32_t width, uint32_t height) {
+    refresh.lastLayout = now;
+    if (inputPending) {
+        refresh.settleFrames = UI_SETTLE_FRAMES;
+    } else if (refresh.settleFrames > 0) {
+        --refresh.settleFrames;
+    }
+    refresh.width = width;
+    refresh.height = height;
+    refresh.valid = true;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file ui_refresh.hpp
+ * @brief When the UI overlay has to be laid out and rendered again, and when the last one can stay.
+ *
+ * The controls and the frame stats windows are rendered into an overlay texture that the
+ * composite lays over the scene every frame. Laying out and rendering them is only needed
+ * when something they show may have changed: input reached ImGui, the drawable was resized,
+ * or the frame stats have new numbers to show, which they get UI_REFRESH_SECONDS apart. After
+ * input the UI keeps being laid out for UI_SETTLE_FRAMES frames, so hover highlights, widgets
+ * released on the next frame and ImGui's input trickling settle before it is frozen again.
+ */
+
+#pragma once
+#include <cstdint>
+
+/// Seconds between layouts of a UI that received no input; the frame stats refresh this often.
+constexpr double UI_REFRESH_SECONDS = 0.25;
+/// Frames the UI keeps being laid out after its last input.
+constexpr uint32_t UI_SETTLE_FRAMES = 3;
+
+/**
+ * @struct UiRefresh
+ * @brief What the overlay texture holds.
+ */
+struct UiRefresh {
+    double lastLayout = 0.0;    ///< Time the overlay was last laid out.
+    uint32_t settleFrames = 0;  ///< Frames left to lay out after the last input.
+    uint32_t width = 0;         ///< Overlay size in pixels.
+    uint32_t height = 0;
+    bool valid = false;         ///< False until the overlay was first rendered.
+};
+
+/**
+ * @brief Returns true if the overlay has to be laid out and rendered this frame.
+ * @param refresh The overlay's state.
+ * @param now The current time in seconds.
+ * @param inputPending True if ImGui has input it has not processed yet.
+ * @param width The drawable's width in pixels.
+ * @param height The drawable's height in pixels.
+ * @return False if the last overlay can be composited again.
+ */
+bool ui_refresh_due(const UiRefresh& refresh, double now, bool inputPending, uint32_t width, uint32_t height);
+
+/// @brief Records that the overlay was laid out and rendered at a size.
+void ui_refresh_laid_out(UiRefresh& refresh, double now, bool inputPending, uint32_t width, uint32_t height);
@@ -0,0 +1,43 @@
+#include "upload_budget.hpp"
+
+#include <algorithm>
+
+void upload_budget_begin_frame(UploadBudget& budget) {
+    budget.frameBytes = 0;
+    budget.frameBatches = 0;
+}
+
+size_t upload_budget_frame_limit(const UploadBudget& budget, const UploadBudgetSettings& settings) {
+    size_t limit = settings.bytesPerFrame > 0 ? settings.bytesPerFrame : SIZE_MAX;
+    // Until a copy has been timed there is nothing to turn the time into bytes with
+    if (settings.millisecondsPerFrame > 0.0f && budget.bytesPerMs > 0.0) {
+        limit = std::min(limit, (size_t)(budget.bytesPerMs * settings.millisecondsPerFrame));
+    }
+    return limit;
+}
+
+bool upload_budget_admit(UploadBudget& budget, const UploadBudgetSettings& settings, size_t bytes) {
+    const size_t limit = upload_budget_frame_limit(budget, settings);
+    if (budget.frameBatches > 0 && (budget.frameBytes >= limit || bytes > limit - budget.frameBytes)) {
+        return false;
+    }
+    budget.frameBytes += bytes;
+    budget.frameBatches++;
+    return true;
+}
+
+void upload_budget_measure(UploadBudget& budget, const UploadBudgetSettings& settings, size_t bytes, double gpuMs) {
+    if (gpuMs <= 0.0 || bytes == 0) {
+        return;
+    }
+    const double rate = bytes / gpuMs;
+    budget.bytesPerMs = budget.bytesPerMs > 0.0 ? budget.bytesPerMs + (rate - budget.bytesPerMs) * settings.smoothing
+                                                : rate;
+}
+
+uint32_t upload_slice_rows(size_t bytesPerRow, uint32_t rows, size_t sliceBytes) {
+    if (sliceBytes == 0 || bytesPerRow == 0) {
+        return std::max(rows, 1u);
+    }
+    return (uint32_t)std::clamp<size_t>(sliceBytes / bytesPerRow, 1, std::max(rows, 1u));
+}
@@ -0,0 +1,70 @@
+/**
+ * @file upload_budget.hpp
+ * @brief How many streamed upload bytes the ResourceUploader sends to the GPU each frame.
+ *
+ * A burst of uploads committed at once, e.g. the chunks a fast camera pulls in together,
+ * competes with the frame's own passes for memory bandwidth and shows up as a frame time
+ * spike. The uploader instead splits uploads into batches of at most sliceBytes and, once
+ * per frame, commits queued batches until the frame's budget is spent: bytesPerFrame, or
+ * the bytes the measured copy throughput moves in millisecondsPerFrame, whichever is less.
+ * The first batch of a frame always goes, so a budget smaller than a batch slows streaming
+ * down rather than stopping it.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @struct UploadBudgetSettings
+ * @brief Limits of the throttled uploads.
+ */
+struct UploadBudgetSettings {
+    size_t bytesPerFrame = 2 << 20;     ///< Bytes committed per frame; 0 for no byte limit.
+    float millisecondsPerFrame = 0.5f;  ///< GPU copy time per frame; 0 for no time limit.
+    size_t sliceBytes = 256 << 10;      ///< Largest batch; bigger uploads are split. 0 never splits.
+    float smoothing = 0.1f;             ///< Weight of a new measurement in the throughput average.
+};
+
+/**
+ * @struct UploadBudget
+ * @brief What has been committed this frame and how fast copies ran so far.
+ */
+struct UploadBudget {
+    size_t frameBytes = 0;          ///< Bytes committed since upload_budget_begin_frame().
+    uint32_t frameBatches = 0;      ///< Batches committed since upload_budget_begin_frame().
+    double bytesPerMs = 0.0;        ///< Moving average of the copy throughput; 0 until measured.
+};
+
+/// @brief Starts a frame: nothing is committed in it yet.
+void upload_budget_begin_frame(UploadBudget& budget);
+
+/// @return The bytes the frame may commit, or SIZE_MAX without a limit.
+size_t upload_budget_frame_limit(const UploadBudget& budget, const UploadBudgetSettings& settings);
+
+/**
+ * @brief Decides whether a batch may be committed this frame, and counts it if so.
+ * @param budget The frame's budget.
+ * @param settings The limits.
+ * @param bytes The batch's bytes.
+ * @return True if it fits what is left of the frame's limit or is the frame's first batch.
+ */
+bool upload_budget_admit(UploadBudget& budget, const UploadBudgetSettings& settings, size_t bytes);
+
+/**
+ * @brief Feeds the GPU time of a finished batch into the throughput average.
+ * @param budget The budget to update.
+ * @param settings The limits.
+ * @param bytes The batch's bytes.
+ * @param gpuMs Milliseconds the GPU spent on it; ignored unless positive.
+ */
+void upload_budget_measure(UploadBudget& budget, const UploadBudgetSettings& settings, size_t bytes, double gpuMs);
+
+/**
+ * @brief Picks how many rows of a texture region go into one batch.
+ * @param bytesPerRow The bytes of one row.
+ * @param rows The rows of the region.
+ * @param sliceBytes The largest batch; 0 never splits.
+ * @return Rows per batch; at least 1, so a row wider than a slice still gets its own batch.
+ */
+uint32_t upload_slice_rows(size_t bytesPerRow, uint32_t rows, size_t sliceBytes);
@@ -0,0 +1,103 @@
+/**
+ * @file upscaler.hpp
+ * @brief Renders the scene below the drawable size and upscales it with MetalFX, or anti-aliases it temporally.
+ */
+
+#pragma once
+#import <Metal/Metal.h>
+#import <MetalFX/MetalFX.h>
+#include <simd/simd.h>
+
+#include <cstdint>
+
+#include "camera.hpp"
+#include "metal_context.hpp"
+#include "render_targets.hpp"
+#include "temporal_aa.hpp"
+
+/**
+ * @enum UpscalerMode
+ * @brief The MetalFX scaler used to reach the output size.
+ */
+enum class UpscalerMode {
+    Spatial,    ///< MTLFXSpatialScaler: one frame of colour, no history.
+    Temporal,   ///< MTLFXTemporalScaler: jittered frames accumulated with depth and motion vectors.
+    TemporalAA, ///< temporal_aa_resolve at the output size: the same jitter and motion vectors, no scaling.
+};
+
+/**
+ * @struct Upscaler
+ * @brief The internal-resolution targets and the scaler reading them.
+ *
+ * The scene renders into color and depth at the input size; upscaler_encode() upscales
+ * into output, which the composite pass then draws into the drawable. In TemporalAA mode the
+ * input is the output size and the resolve kernel stands in for the MetalFX scaler, keeping its
+ * own history: it writes the frame's result to output and to accumulated, which then trades
+ * places with history, so what is drawn over output never feeds back (see temporal_aa.hpp).
+ * Targets and scaler are recreated together whenever a size or the mode changes; frames
+ * in flight keep the old ones alive through their command buffers.
+ */
+struct Upscaler {
+    id<MTLDevice> device;                           ///< Device the targets are created on.
+    id<MTLComputePipelineState> motionPipeline;     ///< camera_motion_vectors.
+    id<MTLComputePipelineState> resolvePipeline;    ///< temporal_aa_resolve.
+    UpscalerMode mode = UpscalerMode::Spatial;      ///< Scaler in use.
+    id<MTLFXSpatialScaler> spatial;                 ///< Set in Spatial mode.
+    id<MTLFXTemporalScaler> temporal;               ///< Set in Temporal mode.
+    id<MTLTexture> color;                           ///< Scene colour at the input size.
+    TransientTarget depth;                          ///< Scene depth at the input size; always kept in Temporal mode.
+    id<MTLTexture> motion;                          ///< Motion vectors at the input size; Temporal and TemporalAA.
+    id<MTLTexture> output;                          ///< Upscaled colour at the output size.
+    id<MTLTexture> history;                         ///< Last frame's result at the output size, TemporalAA only.
+    id<MTLTexture> accumulated;                     ///< This frame's result, the next history; TemporalAA only.
+    TemporalAASettings antiAliasing;                ///< How fast the TemporalAA history follows the frame.
+    uint32_t inputWidth = 0;                        ///< Internal render width in pixels.
+    uint32_t inputHeight = 0;                       ///< Internal render height in pixels.
+    uint32_t outputWidth = 0;                       ///< Drawable width in pixels.
+    uint32_t outputHeight = 0;                      ///< Drawable height in pixels.
+    uint32_t jitterIndex = 0;                       ///< Position in the Halton jitter sequence.
+    simd::float2 jitter = { 0.0f, 0.0f };           ///< Jitter of the current frame in input pixels.
+    bool hasHistory = false;                        ///< False until the temporal scaler or resolve has seen a frame.
+};
+
+/// @return True if the device can run the scaler for mode; TemporalAA needs only compute.
+bool upscaler_supported(id<MTLDevice> device, UpscalerMode mode);
+
+/**
+ * @brief Creates an upscaler without targets; upscaler_configure() allocates them.
+ * @param metal The Metal context; its motion vector pipeline must exist, and its TAA one for TemporalAA.
+ * @return The upscaler.
+ */
+Upscaler create_upscaler(const MetalContext& metal);
+
+/**
+ * @brief Makes the targets and scaler match the requested sizes and mode.
+ * @param upscaler The upscaler.
+ * @param inputWidth The internal render width.
+ * @param inputHeight The internal render height.
+ * @param outputWidth The drawable width.
+ * @param outputHeight The drawable height.
+ * @param mode The scaler to use; must be supported. TemporalAA needs the input size to be the output size.
+ * @return True if anything was recreated, which also drops the temporal history.
+ */
+bool upscaler_configure(Upscaler& upscaler, uint32_t inputWidth, uint32_t inputHeight,
+                        uint32_t outputWidth, uint32_t outputHeight, UpscalerMode mode);
+
+/**
+ * @brief Advances the jitter sequence and returns the camera to render this frame with.
+ * @param upscaler The upscaler.
+ * @param cam The unjittered camera.
+ * @return cam with a sub-pixel offset projection in Temporal and TemporalAA modes, cam itself otherwise.
+ */
+Camera upscaler_begin_frame(Upscaler& upscaler, const Camera& cam);
+
+/**
+ * @brief Upscales or resolves the rendered scene into output.
+ * @param upscaler The upscaler.
+ * @param cmd The command buffer, after the scene pass.
+ * @param renderCam The camera returned by upscaler_begin_frame().
+ * @param cam The unjittered camera.
+ * @param previousViewProjection Unjittered matrix of the previous frame, from the frame's ViewHistory.
+ */
+void upscaler_encode(Upscaler& upscaler, id<MTLCommandBuffer> cmd, const Camera& renderCam, const Camera& cam,
+                     const simd::float4x4& previousViewProjection);
@@ -0,0 +1,261 @@
+#import "upscaler.hpp"
+
+#include <utility>
+
+#include "render_scale.hpp"
+
+namespace {
+    // Matches MotionParams in shaders.metal
+    struct MotionParams {
+        simd::float4x4 inverseViewProjection;
+        simd::float4x4 viewProjection;
+        simd::float4x4 previousViewProjection;
+    };
+
+    // Matches TemporalAAParams in shaders.metal
+    struct TemporalAAParams {
+        float currentWeight;
+        float motionWeight;
+        float maxCurrentWeight;
+        uint32_t hasHistory;
+    };
+
+    // Cycle length of the jitter sequence; 8 samples cover a pixel well at these scales
+    constexpr uint32_t JITTER_PHASES = 8;
+
+    id<MTLTexture> make_target(id<MTLDevice> device, MTLPixelFormat format, uint32_t width, uint32_t height,
+                               MTLTextureUsage usage, NSString* label) {
+        MTLTextureDescriptor* desc = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:format
+                                                                                        width:width
+                                                                                       height:height
+                                                                                    mipmapped:NO];
+        desc.storageMode = MTLStorageModePrivate;
+        desc.usage = usage;
+        id<MTLTexture> texture = [device newTextureWithDescriptor:desc];
+        texture.label = label;
+        return texture;
+    }
+
+    void create_spatial(Upscaler& upscaler) {
+        MTLFXSpatialScalerDescriptor* desc = [MTLFXSpatialScalerDescriptor new];
+        desc.inputWidth = upscaler.inputWidth;
+        desc.inputHeight = upscaler.inputHeight;
+        desc.outputWidth = upscaler.outputWidth;
+        desc.outputHeight = upscaler.outputHeight;
+        desc.colorTextureFormat = MTLPixelFormatBGRA8Unorm;
+        desc.outputTextureFormat = MTLPixelFormatBGRA8Unorm;
+        desc.colorProcessingMode = MTLFXSpatialScalerColorProcessingModePerceptual;
+        upscaler.spatial = [desc newSpatialScalerWithDevice:upscaler.device];
+        if (!upscaler.spatial) {
+            NSLog(@"Failed to create the spatial scaler for %ux%u -> %ux%u", upscaler.inputWidth,
+                  upscaler.inputHeight, upscaler.outputWidth, upscaler.outputHeight);
+            return;
+        }
+
+        upscaler.color = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.inputWidth,
+                                     upscaler.inputHeight, MTLTextureUsageRenderTarget | upscaler.spatial.colorTextureUsage,
+                                     @"Scene colour");
+        upscaler.depth = create_transient_target(upscaler.device, MTLPixelFormatDepth32Float, upscaler.inputWidth,
+                                                 upscaler.inputHeight,
+                                                 MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead, @"Scene depth");
+        // The composite reads the output and the debug layer draws over it
+        upscaler.output = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.outputWidth,
+                                      upscaler.outputHeight,
+                                      upscaler.spatial.outputTextureUsage | MTLTextureUsageShaderRead |
+                                          MTLTextureUsageRenderTarget,
+                                      @"Upscaled colour");
+        upscaler.spatial.colorTexture = upscaler.color;
+        upscaler.spatial.outputTexture = upscaler.output;
+        upscaler.spatial.inputContentWidth = upscaler.inputWidth;
+        upscaler.spatial.inputContentHeight = upscaler.inputHeight;
+    }
+
+    void create_temporal(Upscaler& upscaler) {
+        MTLFXTemporalScalerDescriptor* desc = [MTLFXTemporalScalerDescriptor new];
+        desc.inputWidth = upscaler.inputWidth;
+        desc.inputHeight = upscaler.inputHeight;
+        desc.outputWidth = upscaler.outputWidth;
+        desc.outputHeight = upscaler.outputHeight;
+        desc.colorTextureFormat = MTLPixelFormatBGRA8Unorm;
+        desc.depthTextureFormat = MTLPixelFormatDepth32Float;
+        desc.motionTextureFormat = MTLPixelFormatRG16Float;
+        desc.outputTextureFormat = MTLPixelFormatBGRA8Unorm;
+        upscaler.temporal = [desc newTemporalScalerWithDevice:upscaler.device];
+        if (!upscaler.temporal) {
+            NSLog(@"Failed to create the temporal scaler for %ux%u -> %ux%u", upscaler.inputWidth,
+                  upscaler.inputHeight, upscaler.outputWidth, upscaler.outputHeight);
+            return;
+        }
+
+        id<MTLFXTemporalScaler> scaler = upscaler.temporal;
+        upscaler.color = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.inputWidth,
+                                     upscaler.inputHeight, MTLTextureUsageRenderTarget | scaler.colorTextureUsage,
+                                     @"Scene colour");
+        upscaler.depth = create_transient_target(
+            upscaler.device, MTLPixelFormatDepth32Float, upscaler.inputWidth, upscaler.inputHeight,
+            MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead | scaler.depthTextureUsage, @"Scene depth");
+        upscaler.motion = make_target(upscaler.device, MTLPixelFormatRG16Float, upscaler.inputWidth,
+                                      upscaler.inputHeight, MTLTextureUsageShaderWrite | scaler.motionTextureUsage,
+                                      @"Motion vectors");
+        upscaler.output = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.outputWidth,
+                                      upscaler.outputHeight,
+                                      scaler.outputTextureUsage | MTLTextureUsageShaderRead |
+                                          MTLTextureUsageRenderTarget,
+                                      @"Upscaled colour");
+        scaler.colorTexture = upscaler.color;
+        scaler.depthTexture = transient_target_texture(upscaler.depth, true);
+        scaler.motionTexture = upscaler.motion;
+        scaler.outputTexture = upscaler.output;
+        scaler.inputContentWidth = upscaler.inputWidth;
+        scaler.inputContentHeight = upscaler.inputHeight;
+        // Motion vectors are written in UV units
+        scaler.motionVectorScaleX = upscaler.inputWidth;
+        scaler.motionVectorScaleY = upscaler.inputHeight;
+    }
+
+    void create_temporal_aa(Upscaler& upscaler) {
+        upscaler.color = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.inputWidth,
+                                     upscaler.inputHeight, MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead,
+                                     @"Scene colour");
+        upscaler.depth = create_transient_target(
+            upscaler.device, MTLPixelFormatDepth32Float, upscaler.inputWidth, upscaler.inputHeight,
+            MTLTextureUsageRenderTarget | MTLTextureUsageShaderRead, @"Scene depth");
+        upscaler.motion = make_target(upscaler.device, MTLPixelFormatRG16Float, upscaler.inputWidth,
+                                      upscaler.inputHeight, MTLTextureUsageShaderWrite | MTLTextureUsageShaderRead,
+                                      @"Motion vectors");
+        // The composite reads the output and the debug layer draws over it
+        upscaler.output = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.outputWidth,
+                                      upscaler.outputHeight,
+                                      MTLTextureUsageShaderWrite | MTLTextureUsageShaderRead |
+                                          MTLTextureUsageRenderTarget,
+                                      @"Anti-aliased colour");
+        upscaler.history = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.outputWidth,
+                                       upscaler.outputHeight, MTLTextureUsageShaderWrite | MTLTextureUsageShaderRead,
+                                       @"TAA history");
+        upscaler.accumulated = make_target(upscaler.device, MTLPixelFormatBGRA8Unorm, upscaler.outputWidth,
+                                           upscaler.outputHeight,
+                                           MTLTextureUsageShaderWrite | MTLTextureUsageShaderRead, @"TAA history");
+    }
+
+    void encode_motion_vectors(const Upscaler& upscaler, id<MTLCommandBuffer> cmd, const Camera& renderCam,
+                               const Camera& cam, const simd::float4x4& previousViewProjection) {
+        simd::float4x4 viewProjection = cam.projectionMatrix * cam.viewMatrix;
+        MotionParams params;
+        params.inverseViewProjection = simd_inverse(renderCam.projectionMatrix * renderCam.viewMatrix);
+        params.viewProjection = viewProjection;
+        params.previousViewProjection = upscaler.hasHistory ? previousViewProjection : viewProjection;
+
+        id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+        enc.label = @"Camera motion vectors";
+        [enc setComputePipelineState:upscaler.motionPipeline];
+        [enc setTexture:upscaler.depth.kept atIndex:0];
+        [enc setTexture:upscaler.motion atIndex:1];
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        [enc dispatchThreadgroups:MTLSizeMake((upscaler.inputWidth + 7) / 8, (upscaler.inputHeight + 7) / 8, 1)
+            threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+        [enc endEncoding];
+    }
+
+    void encode_temporal_aa(const Upscaler& upscaler, id<MTLCommandBuffer> cmd) {
+        const TemporalAASettings& settings = upscaler.antiAliasing;
+        TemporalAAParams params = { settings.currentWeight, settings.motionWeight, settings.maxCurrentWeight,
+                                    upscaler.hasHistory ? 1u : 0u };
+
+        id<MTLComputeCommandEncoder> enc = [cmd computeCommandEncoder];
+        enc.label = @"Temporal anti-aliasing";
+        [enc setComputePipelineState:upscaler.resolvePipeline];
+        [enc setTexture:upscaler.color atIndex:0];
+        [enc setTexture:upscaler.motion atIndex:1];
+        [enc setTexture:upscaler.history atIndex:2];
+        [enc setTexture:upscaler.output atIndex:3];
+        [enc setTexture:upscaler.accumulated atIndex:4];
+        [enc setBytes:&params length:sizeof(params) atIndex:0];
+        [enc dispatchThreadgroups:MTLSizeMake((upscaler.outputWidth + 7) / 8, (upscaler.outputHeight + 7) / 8, 1)
+            threadsPerThreadgroup:MTLSizeMake(8, 8, 1)];
+        [enc endEncoding];
+    }
+}
+
+bool upscaler_supported(id<MTLDevice> device, UpscalerMode mode) {
+    if (mode == UpscalerMode::Temporal) {
+        return [MTLFXTemporalScalerDescriptor supportsDevice:device];
+    }
+    if (mode == UpscalerMode::TemporalAA) {
+        return device != nil;
+    }
+    return [MTLFXSpatialScalerDescriptor supportsDevice:device];
+}
+
+Upscaler create_upscaler(const MetalContext& metal) {
+    Upscaler upscaler;
+    upscaler.device = metal.device;
+    upscaler.motionPipeline = metal.motion_vectors_pipeline;
+    upscaler.resolvePipeline = metal.temporal_aa_pipeline;
+    return upscaler;
+}
+
+bool upscaler_configure(Upscaler& upscaler, uint32_t inputWidth, uint32_t inputHeight,
+                        uint32_t outputWidth, uint32_t outputHeight, UpscalerMode mode) {
+    if (upscaler.output && upscaler.mode == mode && upscaler.inputWidth == inputWidth &&
+        upscaler.inputHeight == inputHeight && upscaler.outputWidth == outputWidth &&
+        upscaler.outputHeight == outputHeight) {
+        return false;
+    }
+
+    upscaler.mode = mode;
+    upscaler.inputWidth = inputWidth;
+    upscaler.inputHeight = inputHeight;
+    upscaler.outputWidth = outputWidth;
+    upscaler.outputHeight = outputHeight;
+    upscaler.spatial = nil;
+    upscaler.temporal = nil;
+    upscaler.color = upscaler.motion = upscaler.output = upscaler.history = upscaler.accumulated = nil;
+    upscaler.depth = {};
+    upscaler.hasHistory = false;
+
+    if (mode == UpscalerMode::Temporal) {
+        create_temporal(upscaler);
+    } else if (mode == UpscalerMode::TemporalAA) {
+        create_temporal_aa(upscaler);
+    } else {
+        create_spatial(upscaler);
+    }
+    return true;
+}
+
+Camera upscaler_begin_frame(Upscaler& upscaler, const Camera& cam) {
+    if (upscaler.mode == UpscalerMode::Spatial) {
+        upscaler.jitter = { 0.0f, 0.0f };
+        return cam;
+    }
+
+    uint32_t phase = upscaler.jitterIndex++ % JITTER_PHASES + 1;
+    upscaler.jitter = { halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f };
+
+    Camera renderCam = cam;
+    renderCam.projectionMatrix = jitter_projection(cam.projectionMatrix, upscaler.jitter,
+                                                   upscaler.inputWidth, upscaler.inputHeight);
+    return renderCam;
+}
+
+void upscaler_encode(Upscaler& upscaler, id<MTLCommandBuffer> cmd, const Camera& renderCam, const Camera& cam,
+                     const simd::float4x4& previousViewProjection) {
+    if (upscaler.mode == UpscalerMode::Temporal && upscaler.temporal) {
+        encode_motion_vectors(upscaler, cmd, renderCam, cam, previousViewProjection);
+
+        upscaler.temporal.jitterOffsetX = upscaler.jitter.x;
+        upscaler.temporal.jitterOffsetY = upscaler.jitter.y;
+        upscaler.temporal.depthReversed = cam.reverseZ;
+        upscaler.temporal.reset = !upscaler.hasHistory;
+        [upscaler.temporal encodeToCommandBuffer:cmd];
+
+        upscaler.hasHistory = true;
+    } else if (upscaler.mode == UpscalerMode::TemporalAA && upscaler.output) {
+        encode_motion_vectors(upscaler, cmd, renderCam, cam, previousViewProjection);
+        encode_temporal_aa(upscaler, cmd);
+        std::swap(upscaler.history, upscaler.accumulated);
+        upscaler.hasHistory = true;
+    } else if (upscaler.spatial) {
+        [upscaler.spatial encodeToCommandBuffer:cmd];
+    }
+}
@@ -0,0 +1,197 @@
+#include "vertex_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Forsyth's tuning constants; the cache is modelled larger than the one ACMR is measured on
+    const int OPTIMIZER_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    const uint32_t VALENCE_TABLE_SIZE = 32;
+
+    struct ScoreTables {
+        float cache[OPTIMIZER_CACHE_SIZE];
+        float valence[VALENCE_TABLE_SIZE];
+    };
+
+    const ScoreTables& score_tables() {
+        static const ScoreTables tables = [] {
+            ScoreTables t;
+            for (int i = 0; i < OPTIMIZER_CACHE_SIZE; ++i) {
+                // The triangle just emitted gets a flat score so the next one does not
+                // simply fan around the same edge
+                t.cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                                   : powf(1.0f - (i - 3) / (float)(OPTIMIZER_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            t.valence[0] = 0.0f;
+            for (uint32_t i = 1; i < VALENCE_TABLE_SIZE; ++i) {
+                t.valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    float vertex_score(int cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+        const ScoreTables& tables = score_tables();
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+
+        // Vertices with few triangles left are finished off first
+        return score + (remainingTriangles < VALENCE_TABLE_SIZE
+                            ? tables.valence[remainingTriangles]
+                            : VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER));
+    }
+
+    template <typename Index>
+    void optimize(Index* indices, size_t indexCount, size_t vertexCount) {
+        const size_t triangleCount = indexCount / 3;
+        if (triangleCount < 2) {
+            return;
+        }
+
+        // Vertex to triangle adjacency, packed as offsets into one array
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; ++i) {
+            remaining[indices[i]]++;
+        }
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+        }
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> score(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            score[v] = vertex_score(-1, remaining[v]);
+        }
+
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        }
+
+        std::vector<Index> output(triangleCount * 3);
+        std::vector<uint32_t> cache, nextCache;
+        cache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+        nextCache.reserve(OPTIMIZER_CACHE_SIZE + 3);
+
+        size_t best = 0;
+        for (size_t t = 1; t < triangleCount; ++t) {
+            if (triangleScore[t] > triangleScore[best]) best = t;
+        }
+        size_t scanStart = 0;
+
+        for (size_t out = 0; out < triangleCount; ++out) {
+            const Index* tri = indices + best * 3;
+            std::copy(tri, tri + 3, output.begin() + out * 3);
+            emitted[best] = 1;
+
+            // Remove the triangle from its vertices' adjacency lists
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = tri[k];
+                uint32_t* begin = adjacency.data() + adjacencyOffset[v];
+                uint32_t* end = begin + remaining[v];
+                *std::find(begin, end, (uint32_t)best) = end[-1];
+                remaining[v]--;
+            }
+
+            // The emitted vertices move to the front of the LRU cache
+            nextCache.assign(tri, tri + 3);
+            for (uint32_t v : cache) {
+                if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                    nextCache.push_back(v);
+                }
+            }
+            std::swap(cache, nextCache);
+
+            // Rescore every vertex that was or still is cached, and the triangles around it
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cache.size(); ++i) {
+                uint32_t v = cache[i];
+                int position = i < (size_t)OPTIMIZER_CACHE_SIZE ? (int)i : -1;
+                cachePosition[v] = position;
+                float delta = vertex_score(position, remaining[v]) - score[v];
+                score[v] += delta;
+
+                const uint32_t* adjacent = adjacency.data() + adjacencyOffset[v];
+                for (uint32_t a = 0; a < remaining[v]; ++a) {
+                    uint32_t t = adjacent[a];
+                    triangleScore[t] += delta;
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            if (cache.size() > (size_t)OPTIMIZER_CACHE_SIZE) {
+                cache.resize(OPTIMIZER_CACHE_SIZE);
+            }
+
+            // Nothing adjacent to the cache; restart from the next unemitted triangle
+            if (bestScore < 0.0f) {
+                while (scanStart < triangleCount && emitted[scanStart]) ++scanStart;
+                best = scanStart;
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+    }
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    optimize(indices, indexCount, vertexCount);
+}
+
+void optimize_vertex_cache(uint16_t* indices, size_t indexCount, size_t vertexCount) {
+    optimize(indices, indexCount, vertexCount);
+}
+
+void optimize_vertex_cache(MeshIndices& indices, size_t vertexCount) {
+    if (indices.format == IndexFormat::UInt16) {
+        optimize_vertex_cache(indices.indices16.data(), indices.indices16.size(), vertexCount);
+    } else {
+        optimize_vertex_cache(indices.indices32.data(), indices.indices32.size(), vertexCount);
+    }
+}
+
+float vertex_cache_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+    if (indexCount < 3) {
+        return 0.0f;
+    }
+
+    // FIFO cache: a hit does not refresh the entry
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t v = indices[i];
+        if (insertedAt[v] == 0 || misses - insertedAt[v] + 1 > cacheSize) {
+            ++misses;
+            insertedAt[v] = misses;
+        }
+    }
+    return (float)misses / (float)(indexCount / 3);
+}
+
+float vertex_cache_acmr(const MeshIndices& indices, size_t vertexCount, size_t cacheSize) {
+    std::vector<uint32_t> wide(indices.size());
+    for (size_t i = 0; i < wide.size(); ++i) {
+        wide[i] = indices[i];
+    }
+    return vertex_cache_acmr(wide.data(), wide.size(), vertexCount, cacheSize);
+}
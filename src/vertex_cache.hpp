@@ -0,0 +1,57 @@
+/**
+ * @file vertex_cache.hpp
+ * @brief Reorders triangle lists for the GPU's post-transform vertex cache.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "objects.hpp"
+
+/// Cache size assumed when measuring ACMR; FIFO, like most recent GPUs.
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+/// Cells per stripe when indexing regular grids; two rows of a stripe's vertices fill the cache.
+constexpr int GRID_STRIPE_WIDTH = (int)VERTEX_CACHE_SIZE / 2 - 1;
+
+/**
+ * @brief Reorders the triangles of an index list to improve vertex reuse.
+ *
+ * Uses Tom Forsyth's linear-speed greedy algorithm: each vertex is scored by its
+ * position in a simulated LRU cache and its number of unemitted triangles, and the
+ * triangle with the best total score is emitted next. Only the triangle order
+ * changes; every triangle keeps its vertices and winding.
+ *
+ * @param indices The triangle list, reordered in place.
+ * @param indexCount The number of indices (a multiple of three).
+ * @param vertexCount One more than the largest index.
+ */
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/// @copydoc optimize_vertex_cache(uint32_t*, size_t, size_t)
+void optimize_vertex_cache(uint16_t* indices, size_t indexCount, size_t vertexCount);
+
+/**
+ * @brief Reorders the triangles of a mesh's index list in whichever width it is stored.
+ * @param indices The mesh indices, reordered in place.
+ * @param vertexCount The number of vertices in the mesh.
+ */
+void optimize_vertex_cache(MeshIndices& indices, size_t vertexCount);
+
+/**
+ * @brief Measures the average cache miss ratio: vertex shader invocations per triangle.
+ *
+ * 3.0 means no reuse at all; a regular grid cannot go below about 0.5.
+ *
+ * @param indices The triangle list.
+ * @param indexCount The number of indices.
+ * @param vertexCount One more than the largest index.
+ * @param cacheSize The number of entries in the simulated FIFO cache.
+ * @return Cache misses divided by the number of triangles.
+ */
+float vertex_cache_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                        size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// @copydoc vertex_cache_acmr(const uint32_t*, size_t, size_t, size_t)
+float vertex_cache_acmr(const MeshIndices& indices, size_t vertexCount, size_t cacheSize = VERTEX_CACHE_SIZE);
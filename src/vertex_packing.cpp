@@ -0,0 +1,80 @@
+#include "vertex_packing.hpp"
+#include "affine.hpp"
+#include "landscape.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    uint16_t to_unorm16(float v) {
+        return (uint16_t)lroundf(std::clamp(v, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    int16_t to_snorm16(float v) {
+        return (int16_t)lroundf(std::clamp(v, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    float sign_not_zero(float v) {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+void encode_octahedral_normal(simd::float3 normal, int16_t out[2]) {
+    float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    float x = normal.x / l1;
+    float y = normal.y / l1;
+
+    // The lower hemisphere folds over the diagonals of the square
+    if (normal.z < 0.0f) {
+        float fx = (1.0f - fabsf(y)) * sign_not_zero(x);
+        float fy = (1.0f - fabsf(x)) * sign_not_zero(y);
+        x = fx;
+        y = fy;
+    }
+    out[0] = to_snorm16(x);
+    out[1] = to_snorm16(y);
+}
+
+simd::float3 decode_octahedral_normal(const int16_t encoded[2]) {
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    simd::float3 n = { x, y, 1.0f - fabsf(x) - fabsf(y) };
+
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return simd::normalize(n);
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const QuantizationBox& box) {
+    simd::float3 unit = (vertex.position - box.origin) / box.extent;
+
+    PackedVertex packed;
+    packed.position[0] = to_unorm16(unit.x);
+    packed.position[1] = to_unorm16(unit.y);
+    packed.position[2] = to_unorm16(unit.z);
+    packed.position[3] = 65535;
+    encode_octahedral_normal(vertex.normal, packed.normal);
+    return packed;
+}
+
+Vertex unpack_vertex(const PackedVertex& packed, const QuantizationBox& box) {
+    simd::float3 unit = { packed.position[0] / 65535.0f, packed.position[1] / 65535.0f, packed.position[2] / 65535.0f };
+    return { box.origin + unit * box.extent, decode_octahedral_normal(packed.normal) };
+}
+
+void pack_vertices(const Vertex* vertices, size_t count, const QuantizationBox& box, PackedVertex* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = pack_vertex(vertices[i], box);
+    }
+}
+
+simd::float4x4 quantization_matrix(const QuantizationBox& box) {
+    return affine_matrix(affine_translation_scale(box.origin.x, box.origin.y, box.origin.z,
+                                                  box.extent.x, box.extent.y, box.extent.z));
+}
+
+QuantizationBox terrain_chunk_quantization_box(int chunkX, int chunkZ, float chunkSize, const TerrainParams& terrain) {
+    float bound = terrain_height_bound(terrain);
+    return { { chunkX * chunkSize, -bound, chunkZ * chunkSize }, { chunkSize, 2.0f * bound, chunkSize } };
+}
@@ -0,0 +1,76 @@
+/**
+ * @file vertex_packing.hpp
+ * @brief Conversion between Vertex and the quantized PackedVertex layout.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include "landscape.hpp"
+#include "objects.hpp"
+
+/**
+ * @struct QuantizationBox
+ * @brief The axis-aligned box packed positions are quantized into.
+ */
+struct QuantizationBox {
+    simd::float3 origin;    ///< Corner mapped to unorm 0.
+    simd::float3 extent;    ///< Size of the box; origin + extent maps to unorm 1.
+};
+
+/**
+ * @brief Encodes a unit normal with the octahedral mapping.
+ * @param normal The unit normal.
+ * @param out Receives the two snorm16 components.
+ */
+void encode_octahedral_normal(simd::float3 normal, int16_t out[2]);
+
+/**
+ * @brief Decodes an octahedral-encoded normal.
+ * @param encoded The two snorm16 components.
+ * @return The unit normal.
+ */
+simd::float3 decode_octahedral_normal(const int16_t encoded[2]);
+
+/**
+ * @brief Packs one vertex.
+ * @param vertex The full-precision vertex.
+ * @param box The box the position is quantized into; positions outside are clamped.
+ * @return The packed vertex.
+ */
+PackedVertex pack_vertex(const Vertex& vertex, const QuantizationBox& box);
+
+/**
+ * @brief Unpacks one vertex, as the vertex shader does.
+ * @param packed The packed vertex.
+ * @param box The box the vertex was packed with.
+ * @return The reconstructed vertex.
+ */
+Vertex unpack_vertex(const PackedVertex& packed, const QuantizationBox& box);
+
+/**
+ * @brief Packs many vertices, e.g. straight into a shared MTLBuffer.
+ * @param vertices The full-precision vertices.
+ * @param count The number of vertices.
+ * @param box The box positions are quantized into.
+ * @param out Receives count packed vertices.
+ */
+void pack_vertices(const Vertex* vertices, size_t count, const QuantizationBox& box, PackedVertex* out);
+
+/**
+ * @brief Returns the model matrix that maps unorm positions back into the box.
+ * @param box The quantization box.
+ * @return translation(origin) * scale(extent).
+ */
+simd::float4x4 quantization_matrix(const QuantizationBox& box);
+
+/**
+ * @brief Returns the box covering terrain chunk (chunkX, chunkZ) and every possible height.
+ * @param chunkX The chunk coordinate along X.
+ * @param chunkZ The chunk coordinate along Z.
+ * @param chunkSize The edge length of a chunk in world units.
+ * @param terrain The terrain generator's tunables, which bound the heights.
+ * @return The quantization box.
+ */
+QuantizationBox terrain_chunk_quantization_box(int chunkX, int chunkZ, float chunkSize,
+                                               const TerrainParams& terrain = {});
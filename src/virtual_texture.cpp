@@ -0,0 +1,252 @@
+#include "virtual_texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "noise.hpp"
+
+namespace {
+    // Texels generated per pass along a row; bounds the scratch rows kept on the stack
+    constexpr uint32_t GENERATE_SPAN = 256;
+
+    // Seed of the noise that varies the material colours; any value apart from the terrain's own
+    constexpr uint32_t MATERIAL_NOISE_SEED = 0x5EED7E47;
+
+    struct Color {
+        float r, g, b;
+    };
+
+    Color mix(const Color& a, const Color& b, float t) {
+        return { a.r + (b.r - a.r) * t, a.g + (b.g - a.g) * t, a.b + (b.b - a.b) * t };
+    }
+
+    float saturate(float value) {
+        return std::clamp(value, 0.0f, 1.0f);
+    }
+
+    uint8_t to_unorm8(float value) {
+        return (uint8_t)(saturate(value) * 255.0f + 0.5f);
+    }
+
+    // Heights at the centres of texels x0 .. x0 + count (one past the span, for the slope) of a row
+    void row_heights(float worldX0, float worldZ, float texelWorld, uint32_t count, const TerrainParams& terrain,
+                     float* heights) {
+        float xs[GENERATE_SPAN + 1];
+        float zs[GENERATE_SPAN + 1];
+        for (uint32_t i = 0; i <= count; ++i) {
+            xs[i] = worldX0 + (float)i * texelWorld;
+            zs[i] = worldZ;
+        }
+        get_terrain_heights(xs, zs, heights, count + 1, terrain);
+    }
+}
+
+VirtualTextureLayout make_virtual_texture_layout(uint32_t size, uint32_t pageWidth, uint32_t pageHeight,
+                                                 uint32_t firstTailMip) {
+    VirtualTextureLayout layout;
+    layout.size = size;
+    layout.pageWidth = pageWidth;
+    layout.pageHeight = pageHeight;
+    while (layout.mipCount < VIRTUAL_TEXTURE_MAX_MIPS && (size >> layout.mipCount) > 0) {
+        ++layout.mipCount;
+    }
+    layout.sparseMips = std::min(firstTailMip, layout.mipCount);
+    for (uint32_t mip = 0; mip < layout.sparseMips; ++mip) {
+        const uint32_t mipSize = virtual_texture_mip_size(layout, mip);
+        layout.pageOffset[mip] = layout.pageCount;
+        layout.pagesX[mip] = (mipSize + pageWidth - 1) / pageWidth;
+        layout.pagesY[mip] = (mipSize + pageHeight - 1) / pageHeight;
+        layout.pageCount += layout.pagesX[mip] * layout.pagesY[mip];
+    }
+    return layout;
+}
+
+uint32_t virtual_page_index(const VirtualTextureLayout& layout, const VirtualPage& page) {
+    return layout.pageOffset[page.mip] + page.y * layout.pagesX[page.mip] + page.x;
+}
+
+VirtualPage virtual_page_at(const VirtualTextureLayout& layout, uint32_t index) {
+    uint32_t mip = 0;
+    while (mip + 1 < layout.sparseMips && index >= layout.pageOffset[mip + 1]) {
+        ++mip;
+    }
+    const uint32_t local = index - layout.pageOffset[mip];
+    return { mip, local % layout.pagesX[mip], local / layout.pagesX[mip] };
+}
+
+VirtualTextureUniforms virtual_texture_uniforms(const VirtualTextureLayout& layout, float originX, float originZ,
+                                                float worldSize) {
+    VirtualTextureUniforms uniforms = {};
+    uniforms.originX = originX;
+    uniforms.originZ = originZ;
+    uniforms.worldSize = worldSize;
+    uniforms.size = layout.size;
+    uniforms.pageWidth = layout.pageWidth;
+    uniforms.pageHeight = layout.pageHeight;
+    uniforms.sparseMips = layout.sparseMips;
+    uniforms.minMipWidth = layout.sparseMips > 0 ? layout.pagesX[0] : 1;
+    uniforms.minMipHeight = layout.sparseMips > 0 ? layout.pagesY[0] : 1;
+    for (uint32_t mip = 0; mip < layout.sparseMips; ++mip) {
+        uniforms.pageOffset[mip] = layout.pageOffset[mip];
+        uniforms.pagesX[mip] = layout.pagesX[mip];
+    }
+    return uniforms;
+}
+
+VirtualTextureCache::VirtualTextureCache(const VirtualTextureLayout& layout, uint32_t maxResidentPages)
+    : m_layout(layout), m_maxResident(maxResidentPages), m_lastUsed(layout.pageCount, NOT_RESIDENT),
+      m_requested(layout.pageCount, 0) {
+    m_missing.reserve(layout.pageCount);
+    m_evictable.reserve(layout.pageCount);
+    rebuild_min_mip();
+}
+
+void VirtualTextureCache::update(const uint32_t* feedback, uint64_t frame, uint32_t maxLoads,
+                                 VirtualTextureUpdate& update) {
+    update.loads.clear();
+    update.evictions.clear();
+    update.minMipChanged = false;
+
+    // Every requested page and the ancestors it falls back to
+    std::fill(m_requested.begin(), m_requested.end(), 0);
+    const uint32_t words = virtual_texture_feedback_words(m_layout);
+    for (uint32_t word = 0; word < words; ++word) {
+        for (uint32_t bits = feedback[word]; bits != 0; bits &= bits - 1) {
+            const uint32_t index = word * 32 + (uint32_t)__builtin_ctz(bits);
+            if (index >= m_layout.pageCount) {
+                break;
+            }
+            VirtualPage page = virtual_page_at(m_layout, index);
+            for (;;) {
+                const uint32_t ancestor = virtual_page_index(m_layout, page);
+                if (m_requested[ancestor]) {
+                    break;
+                }
+                m_requested[ancestor] = 1;
+                if (++page.mip == m_layout.sparseMips) {
+                    break;
+                }
+                page.x /= 2;
+                page.y /= 2;
+            }
+        }
+    }
+
+    // Coarser levels have higher indices, so walking down loads them first
+    m_missing.clear();
+    for (uint32_t index = m_layout.pageCount; index-- > 0;) {
+        if (!m_requested[index]) {
+            continue;
+        }
+        if (resident(index)) {
+            m_lastUsed[index] = frame;
+        } else {
+            m_missing.push_back(index);
+        }
+    }
+    uint32_t loadCount = std::min(maxLoads, (uint32_t)m_missing.size());
+
+    if (m_residentCount + loadCount > m_maxResident) {
+        m_evictable.clear();
+        for (uint32_t index = 0; index < m_layout.pageCount; ++index) {
+            if (resident(index) && m_lastUsed[index] < frame) {
+                m_evictable.push_back(index);
+            }
+        }
+        const uint32_t needed = m_residentCount + loadCount - m_maxResident;
+        const uint32_t evictCount = std::min(needed, (uint32_t)m_evictable.size());
+        loadCount -= needed - evictCount;
+        // Least recently used first; of equally old pages, the finer ones go first
+        auto older = [&](uint32_t a, uint32_t b) {
+            return m_lastUsed[a] != m_lastUsed[b] ? m_lastUsed[a] < m_lastUsed[b] : a < b;
+        };
+        std::nth_element(m_evictable.begin(), m_evictable.begin() + evictCount, m_evictable.end(), older);
+        for (uint32_t i = 0; i < evictCount; ++i) {
+            m_lastUsed[m_evictable[i]] = NOT_RESIDENT;
+            update.evictions.push_back(m_evictable[i]);
+        }
+        m_residentCount -= evictCount;
+    }
+
+    for (uint32_t i = 0; i < loadCount; ++i) {
+        m_lastUsed[m_missing[i]] = frame;
+        update.loads.push_back(m_missing[i]);
+    }
+    m_residentCount += loadCount;
+
+    if (!update.loads.empty() || !update.evictions.empty()) {
+        rebuild_min_mip();
+        update.minMipChanged = true;
+    }
+}
+
+void VirtualTextureCache::rebuild_min_mip() {
+    if (m_layout.sparseMips == 0) {
+        m_minMip.assign(1, 0);
+        return;
+    }
+    const uint32_t width = m_layout.pagesX[0];
+    const uint32_t height = m_layout.pagesY[0];
+    m_minMip.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            // Walk down from the tail while the chain of pages stays resident
+            uint32_t level = m_layout.sparseMips;
+            while (level > 0) {
+                const uint32_t mip = level - 1;
+                const VirtualPage page{ mip, std::min(x >> mip, m_layout.pagesX[mip] - 1),
+                                        std::min(y >> mip, m_layout.pagesY[mip] - 1) };
+                if (!resident(virtual_page_index(m_layout, page))) {
+                    break;
+                }
+                level = mip;
+            }
+            m_minMip[(size_t)y * width + x] = (uint8_t)level;
+        }
+    }
+}
+
+void generate_virtual_texels(const VirtualTextureLayout& layout, const VirtualTextureWorld& world, uint32_t mip,
+                             uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, uint8_t* bgra,
+                             size_t rowBytes) {
+    const Color grass = { 0.3f, 0.6f, 0.2f };
+    const Color rock = { 0.5f, 0.5f, 0.5f };
+    const Color snow = { 1.0f, 1.0f, 1.0f };
+
+    const float texelWorld = world.worldSize / (float)virtual_texture_mip_size(layout, mip);
+    for (uint32_t spanX = 0; spanX < width; spanX += GENERATE_SPAN) {
+        const uint32_t span = std::min(GENERATE_SPAN, width - spanX);
+        const float worldX0 = world.originX + ((float)(x0 + spanX) + 0.5f) * texelWorld;
+
+        // Two rows of heights roll down the span; slopes are forward differences
+        float rows[2][GENERATE_SPAN + 1];
+        float* current = rows[0];
+        float* next = rows[1];
+        row_heights(worldX0, world.originZ + ((float)y0 + 0.5f) * texelWorld, texelWorld, span, world.terrain,
+                    current);
+        for (uint32_t y = 0; y < height; ++y) {
+            const float worldZ = world.originZ + ((float)(y0 + y) + 0.5f) * texelWorld;
+            row_heights(worldX0, worldZ + texelWorld, texelWorld, span, world.terrain, next);
+            uint8_t* out = bgra + y * rowBytes + (size_t)spanX * 4;
+            for (uint32_t x = 0; x < span; ++x) {
+                const float h = current[x];
+                const float slope = std::hypot(current[x + 1] - h, next[x] - h) / texelWorld;
+
+                // The untextured shader's bands, with rock on slopes steeper than about 35 degrees
+                Color albedo = mix(grass, rock, std::max(saturate(h / 4.0f), saturate((slope - 0.5f) * 4.0f)));
+                albedo = mix(albedo, snow, saturate((h - 4.0f) / 4.0f) * (1.0f - saturate((slope - 0.8f) * 4.0f)));
+
+                // Patches a few units across, faded out where a texel covers several of them
+                const float worldX = worldX0 + (float)x * texelWorld;
+                const float detail = smoothed_noise(worldX * 0.25f, worldZ * 0.25f, MATERIAL_NOISE_SEED,
+                                                    NoiseInterpolation::Smoothstep);
+                const float shade = 1.0f + 0.12f * detail * saturate(2.0f - texelWorld);
+                out[4 * x + 0] = to_unorm8(albedo.b * shade);
+                out[4 * x + 1] = to_unorm8(albedo.g * shade);
+                out[4 * x + 2] = to_unorm8(albedo.r * shade);
+                out[4 * x + 3] = 255;
+            }
+            std::swap(current, next);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+/**
+ * @file virtual_texture.hpp
+ * @brief Page addressing, feedback-driven residency and page contents of the terrain's virtual texture.
+ *
+ * The virtual texture is one large mipmapped albedo texture draped over a square of the world
+ * from above. Only its pages, the sparse tiles of its mip levels, that the last frames sampled
+ * are backed by memory. The landscape fragments set a bit in a feedback bitmap for every page
+ * they would sample; the CPU reads the bitmaps back, loads the missing pages coarse first, and
+ * evicts the pages unused for longest when the page budget is full. A page is only useful with
+ * every coarser page above it, since the shader falls back to those while it streams in, so a
+ * request also asks for its ancestors.
+ *
+ * The levels too small to split into pages, the mip tail, stay resident throughout and are the
+ * last fallback. The min-mip map, one texel per page of level 0, tells the shader the finest
+ * level whose page and all ancestors are resident at that spot.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "landscape.hpp"
+
+/// Mip levels the virtual texture can have; a 32768 texel texture has 16.
+constexpr uint32_t VIRTUAL_TEXTURE_MAX_MIPS = 16;
+
+/**
+ * @struct VirtualTextureUniforms
+ * @brief What the shader needs to address pages; matches VirtualTextureUniforms in shaders.metal.
+ */
+struct VirtualTextureUniforms {
+    float originX;      ///< World X of the texture's u = 0 edge.
+    float originZ;      ///< World Z of the texture's v = 0 edge.
+    float worldSize;    ///< World units the texture spans along X and Z.
+    uint32_t size;      ///< Texels along each side of level 0.
+    uint32_t pageWidth; ///< Texels along X of a page.
+    uint32_t pageHeight; ///< Texels along Z of a page.
+    uint32_t sparseMips; ///< Levels made of pages; the rest are the resident mip tail.
+    uint32_t minMipWidth; ///< Texels along X of the min-mip map, one per page of level 0.
+    uint32_t minMipHeight; ///< Texels along Z of the min-mip map.
+    uint32_t pageOffset[VIRTUAL_TEXTURE_MAX_MIPS]; ///< Index of each sparse level's first page.
+    uint32_t pagesX[VIRTUAL_TEXTURE_MAX_MIPS];     ///< Pages along X of each sparse level.
+};
+
+/**
+ * @struct VirtualTextureLayout
+ * @brief How the texture's levels divide into pages.
+ */
+struct VirtualTextureLayout {
+    uint32_t size = 0;          ///< Texels along each side of level 0; a power of two.
+    uint32_t pageWidth = 0;     ///< Texels along X of a page.
+    uint32_t pageHeight = 0;    ///< Texels along Z of a page.
+    uint32_t mipCount = 0;      ///< Levels down to 1x1.
+    uint32_t sparseMips = 0;    ///< Levels made of pages, 0 to sparseMips - 1.
+    uint32_t pageCount = 0;     ///< Pages of every sparse level.
+    uint32_t pageOffset[VIRTUAL_TEXTURE_MAX_MIPS] = {}; ///< Index of each sparse level's first page.
+    uint32_t pagesX[VIRTUAL_TEXTURE_MAX_MIPS] = {};     ///< Pages along X of each sparse level.
+    uint32_t pagesY[VIRTUAL_TEXTURE_MAX_MIPS] = {};     ///< Pages along Z of each sparse level.
+};
+
+/**
+ * @struct VirtualPage
+ * @brief A page of a sparse level.
+ */
+struct VirtualPage {
+    uint32_t mip = 0;   ///< Level.
+    uint32_t x = 0;     ///< Column.
+    uint32_t y = 0;     ///< Row.
+};
+
+/**
+ * @brief Divides a texture into pages.
+ * @param size Texels along each side of level 0; a power of two.
+ * @param pageWidth Texels along X of a page, as the device's sparse tiles have.
+ * @param pageHeight Texels along Z of a page.
+ * @param firstTailMip The first level of the mip tail, as the device reports it; clamped to the level count.
+ * @return The layout.
+ */
+VirtualTextureLayout make_virtual_texture_layout(uint32_t size, uint32_t pageWidth, uint32_t pageHeight,
+                                                 uint32_t firstTailMip);
+
+/// @return The index of a page among all pages, for feedback bits and residency.
+uint32_t virtual_page_index(const VirtualTextureLayout& layout, const VirtualPage& page);
+
+/// @return The page with an index.
+VirtualPage virtual_page_at(const VirtualTextureLayout& layout, uint32_t index);
+
+/// @return Texels along each side of a level.
+inline uint32_t virtual_texture_mip_size(const VirtualTextureLayout& layout, uint32_t mip) {
+    return layout.size >> mip ? layout.size >> mip : 1;
+}
+
+/// @return 32-bit words in a feedback bitmap, one bit per page.
+inline uint32_t virtual_texture_feedback_words(const VirtualTextureLayout& layout) {
+    return (layout.pageCount + 31) / 32;
+}
+
+/**
+ * @brief Fills the shader's addressing constants.
+ * @param layout The layout.
+ * @param originX World X of the texture's west edge.
+ * @param originZ World Z of the texture's north edge.
+ * @param worldSize World units the texture spans.
+ * @return The uniforms.
+ */
+VirtualTextureUniforms virtual_texture_uniforms(const VirtualTextureLayout& layout, float originX, float originZ,
+                                                float worldSize);
+
+/**
+ * @struct VirtualTextureUpdate
+ * @brief The residency changes of one update, to apply before anything samples the texture.
+ */
+struct VirtualTextureUpdate {
+    std::vector<uint32_t> loads;        ///< Pages to map and fill, coarsest first.
+    std::vector<uint32_t> evictions;    ///< Pages to unmap.
+    bool minMipChanged = false;         ///< True if the min-mip map has to be uploaded again.
+};
+
+/**
+ * @class VirtualTextureCache
+ * @brief Decides which pages are resident from the pages the frames asked for.
+ */
+class VirtualTextureCache {
+public:
+    /**
+     * @param layout The texture's layout.
+     * @param maxResidentPages The most pages backed by memory at once.
+     */
+    VirtualTextureCache(const VirtualTextureLayout& layout, uint32_t maxResidentPages);
+
+    /**
+     * @brief Loads and evicts pages for the pages requested by the feedback of completed frames.
+     *
+     * Requested pages and their ancestors count as used this frame. Missing ones load coarsest
+     * first, at most maxLoads of them; when the budget is full each load evicts the resident
+     * page unused for longest, never one used this frame.
+     *
+     * @param feedback virtual_texture_feedback_words() words of requested page bits.
+     * @param frame The current frame number; increases every call.
+     * @param maxLoads The most pages to load.
+     * @param update Receives the changes; its vectors are reused.
+     */
+    void update(const uint32_t* feedback, uint64_t frame, uint32_t maxLoads, VirtualTextureUpdate& update);
+
+    /// @return True if a page is resident.
+    bool resident(uint32_t page) const { return m_lastUsed[page] != NOT_RESIDENT; }
+
+    /// @return Pages resident now.
+    uint32_t resident_count() const { return m_residentCount; }
+
+    /// @return The most pages resident at once.
+    uint32_t max_resident_pages() const { return m_maxResident; }
+
+    /// @return The min-mip map, pagesX[0] * pagesY[0] levels, row-major.
+    const std::vector<uint8_t>& min_mip() const { return m_minMip; }
+
+private:
+    static constexpr uint64_t NOT_RESIDENT = ~0ull;
+
+    void rebuild_min_mip();
+
+    VirtualTextureLayout m_layout;
+    uint32_t m_maxResident;
+    uint32_t m_residentCount = 0;
+    std::vector<uint64_t> m_lastUsed;   ///< Frame each page was last requested in, or NOT_RESIDENT.
+    std::vector<uint8_t> m_requested;   ///< Scratch: pages asked for this update.
+    std::vector<uint32_t> m_missing;    ///< Scratch: requested pages that are not resident.
+    std::vector<uint32_t> m_evictable;  ///< Scratch: resident pages not used this update.
+    std::vector<uint8_t> m_minMip;
+};
+
+/**
+ * @struct VirtualTextureWorld
+ * @brief Where the texture lies in the world and what it shows.
+ */
+struct VirtualTextureWorld {
+    float originX = -512.0f;    ///< World X of the west edge.
+    float originZ = -512.0f;    ///< World Z of the north edge.
+    float worldSize = 1024.0f;  ///< World units across.
+    TerrainParams terrain;      ///< The terrain the materials are laid over.
+};
+
+/**
+ * @brief Generates the texels of a region of a level from the terrain's height and slope.
+ *
+ * Grass covers low, gentle ground, rock the slopes and the heights from 0 to 4, and snow
+ * lies above 8, matching the height bands the untextured shader draws, with a little noise
+ * to break up the bands. Each texel samples the terrain at its centre.
+ *
+ * @param layout The texture's layout.
+ * @param world Where the texture lies.
+ * @param mip The level.
+ * @param x0 First texel column.
+ * @param y0 First texel row.
+ * @param width Texels along X.
+ * @param height Texels along Z.
+ * @param bgra Receives BGRA8 texels.
+ * @param rowBytes Bytes from one row of bgra to the next.
+ */
+void generate_virtual_texels(const VirtualTextureLayout& layout, const VirtualTextureWorld& world, uint32_t mip,
+                             uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, uint8_t* bgra,
+                             size_t rowBytes);
@@ -0,0 +1,351 @@
+#include "volume_terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Bound on the gradient of gradient_noise3 per noise unit, with a margin over the largest
+    // seen; the brick bounds rely on it to rule tunnels out
+    constexpr float NOISE3_SLOPE = 4.0f;
+
+    // Stands in for the samples of skipped bricks; only its sign is read
+    constexpr float FAR_DISTANCE = 1.0e6f;
+
+    int floor_div(int a, int b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    float saturate(float v) {
+        return std::clamp(v, 0.0f, 1.0f);
+    }
+
+    // The radius of the tunnels at a point; they fade in over the top quarter of caveDepth down
+    float cave_radius(const VolumeTerrainSettings& settings, float y, float surfaceHeight, float mask) {
+        const float fade = saturate((y - (surfaceHeight - settings.caveDepth)) / (0.25f * settings.caveDepth));
+        return settings.caveRadius * mask * fade;
+    }
+
+    float cave_field(const VolumeTerrainSettings& settings, simd::float3 p) {
+        const simd::float3 n = p * settings.caveFrequency;
+        const float a = fractal_noise3(n.x, n.y, n.z, volume_cave_noise(settings, 0));
+        const float b = fractal_noise3(n.x, n.y, n.z, volume_cave_noise(settings, 1));
+        return sqrtf(a * a + b * b);
+    }
+
+    // The chunk's columns, one point past its low edges and one past its high ones
+    struct Columns {
+        int points;                 // Along x and z
+        const float* heights;
+        std::vector<float> masks;
+        float maxMask = 0.0f;
+    };
+
+    void sample_masks(const VolumeTerrainSettings& settings, simd::float2 origin, float spacing, int cells,
+                      Columns& columns) {
+        columns.points = cells + 3;
+        columns.masks.resize((size_t)columns.points * columns.points);
+        columns.maxMask = 0.0f;
+        for (int z = 0, i = 0; z < columns.points; ++z) {
+            for (int x = 0; x < columns.points; ++x, ++i) {
+                const float mask = volume_feature_mask(settings, origin.x + (x - 1) * spacing,
+                                                       origin.y + (z - 1) * spacing);
+                columns.masks[i] = mask;
+                columns.maxMask = std::max(columns.maxMask, mask);
+            }
+        }
+    }
+
+    bool chunk_has_features(const VolumeTerrainSettings& settings, simd::float2 origin, float spacing, int cells) {
+        Columns columns;
+        sample_masks(settings, origin, spacing, cells, columns);
+        return columns.maxMask > 0.0f;
+    }
+
+    // Samples of the chunk's grid, x fastest, then y, then z
+    struct Grid {
+        int nx, ny, nz;
+        int y0;                     // World grid index of the first layer
+        std::vector<float> values;
+
+        size_t index(int x, int y, int z) const { return ((size_t)z * ny + y) * nx + x; }
+        float at(int x, int y, int z) const { return values[index(x, y, z)]; }
+    };
+}
+
+NoiseSettings volume_overhang_noise(const VolumeTerrainSettings& settings) {
+    NoiseSettings noise;
+    noise.seed = settings.seed ^ 0x1b873593u;
+    noise.octaves = 2;
+    noise.persistence = 0.5f;
+    return noise;
+}
+
+NoiseSettings volume_cave_noise(const VolumeTerrainSettings& settings, uint32_t field) {
+    NoiseSettings noise;
+    noise.seed = settings.seed ^ (field == 0 ? 0xcc9e2d51u : 0xe6546b64u);
+    noise.octaves = 1;
+    return noise;
+}
+
+float volume_feature_mask(const VolumeTerrainSettings& settings, float x, float z) {
+    NoiseSettings noise;
+    noise.seed = settings.seed;
+    noise.basis = NoiseBasis::Gradient;
+    noise.octaves = 2;
+    noise.persistence = 0.5f;
+    const float n = fractal_noise(x * settings.featureFrequency, z * settings.featureFrequency, noise);
+    return saturate((n - settings.featureThreshold) / settings.featureSoftness);
+}
+
+float volume_density(const VolumeTerrainSettings& settings, simd::float3 p, float surfaceHeight, float mask) {
+    float d = p.y - surfaceHeight;
+    if (mask <= 0.0f) {
+        return d;
+    }
+    const simd::float3 n = p * settings.overhangFrequency;
+    d -= mask * settings.overhangAmplitude * fractal_noise3(n.x, n.y, n.z, volume_overhang_noise(settings));
+    const float radius = cave_radius(settings, p.y, surfaceHeight, mask);
+    if (radius > 0.0f) {
+        // In noise units of the tunnel fields, scaled back to roughly world units
+        d = std::max(d, (radius - cave_field(settings, p)) / settings.caveFrequency);
+    }
+    return d;
+}
+
+bool build_volume_mesh(const VolumeTerrainSettings& settings, const VolumeChunkInput& input, VolumeMesh& out,
+                       bool sparse) {
+    out.vertices.clear();
+    out.indices.clear();
+    out.bricks = 0;
+    out.skippedBricks = 0;
+    out.minY = out.maxY = 0.0f;
+
+    const int cells = input.cells;
+    const float spacing = input.spacing;
+    Columns columns;
+    columns.heights = input.heights;
+    sample_masks(settings, input.origin, spacing, cells, columns);
+    if (columns.maxMask <= 0.0f) {
+        return false;
+    }
+
+    // The vertical range the surface can reach over these columns, on the world grid
+    const float overhang = settings.overhangAmplitude * fractal_noise_bound(volume_overhang_noise(settings));
+    const int count = columns.points * columns.points;
+    const float minHeight = *std::min_element(input.heights, input.heights + count);
+    const float maxHeight = *std::max_element(input.heights, input.heights + count);
+    const int brick = std::max(settings.brickCells, 1);
+    const int by0 = floor_div((int)floorf((minHeight - std::max(settings.caveDepth, overhang)) / spacing) - 1, brick);
+    const int by1 = floor_div((int)ceilf((maxHeight + overhang) / spacing) + 1, brick);
+
+    Grid grid;
+    grid.nx = grid.nz = columns.points;
+    grid.y0 = by0 * brick;
+    grid.ny = (by1 - by0 + 1) * brick + 1;
+    grid.values.assign((size_t)grid.nx * grid.ny * grid.nz, 0.0f);
+
+    auto column = [&](int x, int z) { return z * columns.points + x; };
+    auto world = [&](int x, int y, int z) {
+        return simd::float3{ input.origin.x + (x - 1) * spacing, (grid.y0 + y) * spacing,
+                             input.origin.y + (z - 1) * spacing };
+    };
+
+    // Bricks on the world grid, clipped to the chunk's samples; skipped ones are filled first so
+    // the points they share with sampled ones end up exact
+    const int bx0 = floor_div(input.gridX - 1, brick), bx1 = floor_div(input.gridX + cells, brick);
+    const int bz0 = floor_div(input.gridZ - 1, brick), bz1 = floor_div(input.gridZ + cells, brick);
+    const float caveSlope =
+        NOISE3_SLOPE * settings.caveFrequency * fractal_noise_bound(volume_cave_noise(settings, 0)) * sqrtf(2.0f);
+    struct Region {
+        int x0, x1, y0, y1, z0, z1;
+    };
+    std::vector<Region> sampled;
+    for (int bz = bz0; bz <= bz1; ++bz) {
+        for (int by = by0; by <= by1; ++by) {
+            for (int bx = bx0; bx <= bx1; ++bx) {
+                Region r;
+                r.x0 = std::max(bx * brick - input.gridX + 1, 0);
+                r.x1 = std::min((bx + 1) * brick - input.gridX + 1, grid.nx - 1);
+                r.z0 = std::max(bz * brick - input.gridZ + 1, 0);
+                r.z1 = std::min((bz + 1) * brick - input.gridZ + 1, grid.nz - 1);
+                r.y0 = (by - by0) * brick;
+                r.y1 = r.y0 + brick;
+                if (r.x0 >= r.x1 || r.z0 >= r.z1) {
+                    continue;
+                }
+
+                float lowest = INFINITY, highest = -INFINITY, mask = 0.0f;
+                for (int z = r.z0; z <= r.z1; ++z) {
+                    for (int x = r.x0; x <= r.x1; ++x) {
+                        lowest = std::min(lowest, input.heights[column(x, z)]);
+                        highest = std::max(highest, input.heights[column(x, z)]);
+                        mask = std::max(mask, columns.masks[column(x, z)]);
+                    }
+                }
+                const float bottom = (grid.y0 + r.y0) * spacing;
+                const float top = (grid.y0 + r.y1) * spacing;
+                float side = 0.0f;
+                if (bottom - highest - mask * overhang > 0.0f) {
+                    side = FAR_DISTANCE;
+                } else if (top - lowest + mask * overhang < 0.0f) {
+                    // Solid unless a tunnel may reach into the brick
+                    bool tunnel = settings.caveRadius * mask > 0.0f && top > lowest - settings.caveDepth;
+                    if (tunnel) {
+                        const simd::float3 lo = world(r.x0, r.y0, r.z0);
+                        const simd::float3 hi = world(r.x1, r.y1, r.z1);
+                        const float reach = caveSlope * 0.5f * simd::length(hi - lo);
+                        tunnel = cave_field(settings, (lo + hi) * 0.5f) - reach < settings.caveRadius * mask;
+                    }
+                    side = tunnel ? 0.0f : -FAR_DISTANCE;
+                }
+                if (side == 0.0f || !sparse) {
+                    sampled.push_back(r);
+                    out.bricks++;
+                    continue;
+                }
+                out.skippedBricks++;
+                for (int z = r.z0; z <= r.z1; ++z) {
+                    for (int y = r.y0; y <= r.y1; ++y) {
+                        for (int x = r.x0; x <= r.x1; ++x) {
+                            grid.values[grid.index(x, y, z)] = side;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (const Region& r : sampled) {
+        for (int z = r.z0; z <= r.z1; ++z) {
+            for (int x = r.x0; x <= r.x1; ++x) {
+                const float height = input.heights[column(x, z)];
+                const float mask = columns.masks[column(x, z)];
+                for (int y = r.y0; y <= r.y1; ++y) {
+                    grid.values[grid.index(x, y, z)] = volume_density(settings, world(x, y, z), height, mask);
+                }
+            }
+        }
+    }
+
+    // A vertex in every cell the surface crosses, at the mean of its edges' crossings
+    const int cx = grid.nx - 1, cy = grid.ny - 1, cz = grid.nz - 1;
+    std::vector<int32_t> cellVertex((size_t)cx * cy * cz, -1);
+    auto cell_index = [&](int x, int y, int z) { return ((size_t)z * cy + y) * cx + x; };
+    out.minY = INFINITY;
+    out.maxY = -INFINITY;
+    for (int z = 0; z < cz; ++z) {
+        for (int y = 0; y < cy; ++y) {
+            for (int x = 0; x < cx; ++x) {
+                float corner[8];
+                int air = 0;
+                for (int c = 0; c < 8; ++c) {
+                    corner[c] = grid.at(x + (c & 1), y + ((c >> 1) & 1), z + (c >> 2));
+                    air += corner[c] > 0.0f;
+                }
+                if (air == 0 || air == 8) {
+                    continue;
+                }
+                simd::float3 sum = { 0.0f, 0.0f, 0.0f };
+                int crossings = 0;
+                for (int c = 0; c < 8; ++c) {
+                    for (int axis = 0; axis < 3; ++axis) {
+                        const int other = c | (1 << axis);
+                        if (other == c || (corner[c] > 0.0f) == (corner[other] > 0.0f)) {
+                            continue;
+                        }
+                        const float t = corner[c] / (corner[c] - corner[other]);
+                        simd::float3 p = { (float)(c & 1), (float)((c >> 1) & 1), (float)(c >> 2) };
+                        p[axis] += t;
+                        sum += p;
+                        crossings++;
+                    }
+                }
+                const simd::float3 gradient = {
+                    (corner[1] - corner[0]) + (corner[3] - corner[2]) + (corner[5] - corner[4]) + (corner[7] - corner[6]),
+                    (corner[2] - corner[0]) + (corner[3] - corner[1]) + (corner[6] - corner[4]) + (corner[7] - corner[5]),
+                    (corner[4] - corner[0]) + (corner[5] - corner[1]) + (corner[6] - corner[2]) + (corner[7] - corner[3]),
+                };
+                Vertex vertex;
+                vertex.position = world(x, y, z) + sum / (float)crossings * spacing;
+                const float length = simd::length(gradient);
+                vertex.normal = length > 0.0f ? gradient / length : simd::float3{ 0.0f, 1.0f, 0.0f };
+                cellVertex[cell_index(x, y, z)] = (int32_t)out.vertices.size();
+                out.vertices.push_back(vertex);
+                out.minY = std::min(out.minY, vertex.position.y);
+                out.maxY = std::max(out.maxY, vertex.position.y);
+            }
+        }
+    }
+    if (out.vertices.empty()) {
+        out.minY = out.maxY = 0.0f;
+        return true;
+    }
+
+    // Edges starting on the chunk's own points belong to it, and so do those starting on the first
+    // points of a neighbour past its high edges that draws its height field, so the volumetric mesh
+    // overlaps the height field rather than stopping half a cell short of it
+    const bool heightFieldX = !chunk_has_features(settings, input.origin + simd::float2{ cells * spacing, 0.0f },
+                                                  spacing, cells);
+    const bool heightFieldZ = !chunk_has_features(settings, input.origin + simd::float2{ 0.0f, cells * spacing },
+                                                  spacing, cells);
+    const bool heightFieldXZ =
+        !chunk_has_features(settings, input.origin + simd::float2{ cells * spacing, cells * spacing }, spacing, cells);
+    auto owned = [&](int x, int z) {
+        const bool pastX = x == cells + 1, pastZ = z == cells + 1;
+        if (x < 1 || z < 1 || x > cells + 1 || z > cells + 1) {
+            return false;
+        }
+        return pastX && pastZ ? heightFieldXZ : pastX ? heightFieldX : pastZ ? heightFieldZ : true;
+    };
+
+    for (int z = 1; z < grid.nz - 1; ++z) {
+        for (int y = 1; y < grid.ny - 1; ++y) {
+            for (int x = 1; x < grid.nx - 1; ++x) {
+                if (!owned(x, z)) {
+                    continue;
+                }
+                const float base = grid.at(x, y, z);
+                for (int axis = 0; axis < 3; ++axis) {
+                    const int ex = x + (axis == 0), ey = y + (axis == 1), ez = z + (axis == 2);
+                    if ((base > 0.0f) == (grid.at(ex, ey, ez) > 0.0f)) {
+                        continue;
+                    }
+                    // The four cells around the edge, in order around it
+                    int quad[4];
+                    bool complete = true;
+                    for (int k = 0; k < 4; ++k) {
+                        const int s = k == 1 || k == 2, t = k >= 2;
+                        int ux = x, uy = y, uz = z;
+                        if (axis == 0) {
+                            uy -= s;
+                            uz -= t;
+                        } else if (axis == 1) {
+                            uz -= s;
+                            ux -= t;
+                        } else {
+                            ux -= s;
+                            uy -= t;
+                        }
+                        quad[k] = cellVertex[cell_index(ux, uy, uz)];
+                        complete &= quad[k] >= 0;
+                    }
+                    if (!complete) {
+                        continue;
+                    }
+                    // Wind the quad counter-clockwise seen from the air
+                    const simd::float3 p0 = out.vertices[quad[0]].position;
+                    const simd::float3 facing = simd::cross(out.vertices[quad[1]].position - p0,
+                                                            out.vertices[quad[2]].position - p0);
+                    simd::float3 up = { 0.0f, 0.0f, 0.0f };
+                    up[axis] = base > 0.0f ? -1.0f : 1.0f;
+                    if (simd::dot(facing, up) < 0.0f) {
+                        std::swap(quad[1], quad[3]);
+                    }
+                    const uint32_t triangles[6] = { (uint32_t)quad[0], (uint32_t)quad[1], (uint32_t)quad[2],
+                                                    (uint32_t)quad[0], (uint32_t)quad[2], (uint32_t)quad[3] };
+                    out.indices.insert(out.indices.end(), triangles, triangles + 6);
+                }
+            }
+        }
+    }
+    return true;
+}
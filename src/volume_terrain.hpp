@@ -0,0 +1,116 @@
+/**
+ * @file volume_terrain.hpp
+ * @brief An optional volumetric layer over the height field, for caves and overhangs.
+ *
+ * A height field has one surface per column, so it cannot hang over itself or hollow out.
+ * Where a low-frequency feature mask rises above its threshold, the terrain is instead the zero
+ * set of a signed distance estimate, positive in the air: the height above the surface, pushed
+ * in and out by 3D noise for overhangs and arches, and carved by tunnels where two more 3D
+ * fields are both near zero, fading out caveDepth below the surface. Columns the mask leaves at
+ * 0 are exactly the height field, so chunks none of whose columns have features keep their
+ * height-field mesh, LODs and all.
+ *
+ * A volumetric chunk samples the distance on a grid with the chunk's grid spacing along all
+ * three axes, split into bricks of brickCells cells on a grid shared by every chunk. A brick
+ * is only sampled if bounds on the distance, from its columns' heights and mask and one cave
+ * sample at its centre, cannot rule the surface out of it; the rest take the sign of their
+ * side. The mesh is built with surface nets: a vertex in each cell the surface crosses, at the
+ * mean of the crossings on its edges, and a quad around each crossed edge. Every chunk samples
+ * one point past each edge but only emits the quads of edges starting on its own points, and
+ * the samples are the same world points in both neighbours, so the meshes meet without seams.
+ * Next to a height-field chunk it also takes that chunk's first row of edges, overlapping the
+ * height field instead of leaving a half-cell gap. What a chunk keeps is the mesh of its surface
+ * bricks, so the memory follows the area of the surface rather than the volume.
+ *
+ * Nothing here touches Metal, so the meshing is tested on its own.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "noise.hpp"
+#include "objects.hpp"
+
+/**
+ * @struct VolumeTerrainSettings
+ * @brief Where the volumetric layer applies and the shape of its caves and overhangs.
+ */
+struct VolumeTerrainSettings {
+    bool enabled = false;               ///< Build volumetric chunks where the feature mask is above 0.
+    uint32_t seed = 0x2c1b3c6du;        ///< Seed of the mask and the 3D fields.
+    int brickCells = 8;                 ///< Cells along each edge of a brick.
+    float featureFrequency = 0.006f;    ///< Of the 2D feature mask, in cycles per world unit.
+    float featureThreshold = 0.1f;      ///< Mask noise where features start.
+    float featureSoftness = 0.3f;       ///< Mask noise range over which they fade in to full strength.
+    float overhangFrequency = 0.05f;    ///< Of the overhang field, in cycles per world unit.
+    float overhangAmplitude = 5.0f;     ///< Largest distance in world units the surface is pushed in or out.
+    float caveFrequency = 0.03f;        ///< Of the two tunnel fields, in cycles per world unit.
+    float caveRadius = 0.1f;            ///< Tunnel radius, in units of the tunnel fields.
+    float caveDepth = 24.0f;            ///< Depth below the surface where the tunnels fade out.
+};
+
+/// @return The field that pushes the surface in and out.
+NoiseSettings volume_overhang_noise(const VolumeTerrainSettings& settings);
+
+/// @return One of the two fields whose common zero set is the tunnels' centre line.
+NoiseSettings volume_cave_noise(const VolumeTerrainSettings& settings, uint32_t field);
+
+/**
+ * @brief Returns how strongly caves and overhangs apply to a column.
+ * @param settings The volumetric layer.
+ * @param x The world x.
+ * @param z The world z.
+ * @return 0 where the terrain is the height field, up to 1 at full strength.
+ */
+float volume_feature_mask(const VolumeTerrainSettings& settings, float x, float z);
+
+/**
+ * @brief Returns the distance estimate of the volumetric terrain at a point.
+ * @param settings The volumetric layer.
+ * @param p The world position.
+ * @param surfaceHeight The height field at p's column.
+ * @param mask volume_feature_mask() at p's column.
+ * @return Roughly the distance to the surface: positive in the air, negative in the ground.
+ */
+float volume_density(const VolumeTerrainSettings& settings, simd::float3 p, float surfaceHeight, float mask);
+
+/**
+ * @struct VolumeChunkInput
+ * @brief The columns of a chunk the volumetric mesh is built from.
+ */
+struct VolumeChunkInput {
+    simd::float2 origin = { 0.0f, 0.0f }; ///< World x and z of the chunk's first grid point.
+    float spacing = 1.0f;       ///< World distance between grid points, also used vertically.
+    int cells = 32;             ///< Cells along the chunk's x and z edges.
+    int gridX = 0;              ///< World grid index of the first grid point along x, which places the bricks.
+    int gridZ = 0;              ///< The same along z.
+    const float* heights = nullptr; ///< Surface heights of (cells + 3)^2 points, row-major by z, from one point
+                                    ///< before the origin to one past the far edge.
+};
+
+/**
+ * @struct VolumeMesh
+ * @brief The surface-nets mesh of a volumetric chunk.
+ */
+struct VolumeMesh {
+    std::vector<Vertex> vertices;   ///< World space, with the distance estimate's gradient as normal.
+    std::vector<uint32_t> indices;  ///< Triangle list.
+    uint32_t bricks = 0;            ///< Bricks sampled because the surface may cross them.
+    uint32_t skippedBricks = 0;     ///< Bricks the bounds put wholly on one side.
+    float minY = 0.0f;              ///< Lowest vertex height.
+    float maxY = 0.0f;              ///< Highest vertex height.
+};
+
+/**
+ * @brief Builds the volumetric mesh of a chunk.
+ * @param settings The volumetric layer.
+ * @param input The chunk's columns.
+ * @param sparse Skip the bricks the bounds rule out; false samples every brick, for testing.
+ * @param out Receives the mesh; emptied if no column of the chunk has features.
+ * @return True if the chunk has features, i.e. should draw out instead of its height field.
+ */
+bool build_volume_mesh(const VolumeTerrainSettings& settings, const VolumeChunkInput& input, VolumeMesh& out,
+                       bool sparse = true);
@@ -0,0 +1,74 @@
+#include "world_origin.hpp"
+
+#include <cmath>
+
+#include "camera.hpp"
+
+WorldPosition world_position_from_double(double x, double y, double z, float chunkSize) {
+    WorldPosition position;
+    const double size = chunkSize;
+    const double chunkX = std::floor(x / size);
+    const double chunkZ = std::floor(z / size);
+    position.chunkX = (int64_t)chunkX;
+    position.chunkZ = (int64_t)chunkZ;
+    position.local = { (float)(x - chunkX * size), (float)y, (float)(z - chunkZ * size) };
+    // Rounding the offset to float may land it on the chunk size itself
+    world_position_normalize(position, chunkSize);
+    return position;
+}
+
+simd::double3 world_position_to_double(const WorldPosition& position, float chunkSize) {
+    return simd::double3{ (double)position.chunkX * chunkSize + position.local.x, (double)position.local.y,
+                          (double)position.chunkZ * chunkSize + position.local.z };
+}
+
+void world_position_normalize(WorldPosition& position, float chunkSize) {
+    const float carryX = std::floor(position.local.x / chunkSize);
+    const float carryZ = std::floor(position.local.z / chunkSize);
+    position.chunkX += (int64_t)carryX;
+    position.chunkZ += (int64_t)carryZ;
+    position.local.x -= carryX * chunkSize;
+    position.local.z -= carryZ * chunkSize;
+}
+
+simd::float3 world_position_delta(const WorldPosition& a, const WorldPosition& b, float chunkSize) {
+    const int64_t chunksX = a.chunkX - b.chunkX;
+    const int64_t chunksZ = a.chunkZ - b.chunkZ;
+    // In double until the end, so only the final offset is rounded
+    return simd::float3{ (float)((double)chunksX * chunkSize + ((double)a.local.x - b.local.x)),
+                         a.local.y - b.local.y,
+                         (float)((double)chunksZ * chunkSize + ((double)a.local.z - b.local.z)) };
+}
+
+simd::float3 world_origin_relative(const WorldOrigin& origin, const WorldPosition& position) {
+    WorldPosition corner;
+    corner.chunkX = origin.chunkX;
+    corner.chunkZ = origin.chunkZ;
+    return world_position_delta(position, corner, origin.chunkSize);
+}
+
+WorldPosition world_origin_absolute(const WorldOrigin& origin, simd::float3 relative) {
+    WorldPosition position;
+    position.chunkX = origin.chunkX;
+    position.chunkZ = origin.chunkZ;
+    position.local = relative;
+    world_position_normalize(position, origin.chunkSize);
+    return position;
+}
+
+bool world_origin_rebase(WorldOrigin& origin, simd::float3 eye, float threshold, simd::float3& shift) {
+    if (std::fabs(eye.x) <= threshold && std::fabs(eye.z) <= threshold) {
+        return false;
+    }
+    const int64_t chunksX = (int64_t)std::floor(eye.x / origin.chunkSize);
+    const int64_t chunksZ = (int64_t)std::floor(eye.z / origin.chunkSize);
+    origin.chunkX += chunksX;
+    origin.chunkZ += chunksZ;
+    shift = { (float)chunksX * origin.chunkSize, 0.0f, (float)chunksZ * origin.chunkSize };
+    return true;
+}
+
+simd::float4x4 matrix_camera_relative_view(float yaw, float pitch) {
+    const simd::float3 eye = { 0.0f, 0.0f, 0.0f };
+    return matrix_look_at_right_hand(eye, camera_forward(yaw, pitch), simd::float3{ 0.0f, 1.0f, 0.0f });
+}
@@ -0,0 +1,117 @@
+/**
+ * @file world_origin.hpp
+ * @brief World positions kept as whole chunks plus a float offset, and a floating render origin.
+ *
+ * A float holds about seven significant digits, so a few kilometres from the origin vertex
+ * positions and view matrices start to snap in millimetre steps and the image jitters. A
+ * WorldPosition stores the chunk in int64 and only the offset within it in float, so any point
+ * of any world keeps the same precision. Rendering and simulation stay in float, relative to a
+ * WorldOrigin: world_origin_rebase() moves the origin in whole chunks once the camera strays past
+ * a threshold, so the floats the GPU sees never grow large. The matrices drawn with are built
+ * camera-relative on the CPU from world_position_delta(), never from two large floats.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstdint>
+
+/**
+ * @struct WorldPosition
+ * @brief A point of the world: the chunk it lies in and its offset from the chunk's corner.
+ */
+struct WorldPosition {
+    int64_t chunkX = 0;                        ///< Chunk column along x.
+    int64_t chunkZ = 0;                        ///< Chunk row along z.
+    simd::float3 local = { 0.0f, 0.0f, 0.0f }; ///< Offset from the chunk's low corner; x and z in [0, chunkSize).
+};
+
+/**
+ * @struct WorldOrigin
+ * @brief The chunk whose low corner is float position zero for rendering and simulation.
+ */
+struct WorldOrigin {
+    int64_t chunkX = 0;      ///< Chunk column at the origin.
+    int64_t chunkZ = 0;      ///< Chunk row at the origin.
+    float chunkSize = 32.0f; ///< World side of a chunk; matches ChunkManagerConfig::chunkSize.
+};
+
+/**
+ * @brief Splits a double-precision point into a chunk and an offset.
+ * @param x World x.
+ * @param y World y; kept as it is, the world does not stream vertically.
+ * @param z World z.
+ * @param chunkSize World side of a chunk.
+ * @return The position.
+ */
+WorldPosition world_position_from_double(double x, double y, double z, float chunkSize);
+
+/**
+ * @brief Joins a position back into double precision.
+ * @param position The position.
+ * @param chunkSize World side of a chunk.
+ * @return x, y and z; exact to a double's precision, which is micrometres at a billion metres.
+ */
+simd::double3 world_position_to_double(const WorldPosition& position, float chunkSize);
+
+/**
+ * @brief Carries whole chunks out of the offset, after it was moved.
+ * @param position The position; its offset may lie anywhere.
+ * @param chunkSize World side of a chunk.
+ */
+void world_position_normalize(WorldPosition& position, float chunkSize);
+
+/**
+ * @brief Returns a - b without ever forming either point as a float.
+ *
+ * The chunk difference is taken in integers and only the result is rounded, so two points a
+ * metre apart give a metre however far both are from zero.
+ *
+ * @param a The first position.
+ * @param b The second position.
+ * @param chunkSize World side of a chunk.
+ * @return The offset from b to a.
+ */
+simd::float3 world_position_delta(const WorldPosition& a, const WorldPosition& b, float chunkSize);
+
+/**
+ * @brief Returns where a position lies relative to the origin, the coordinates drawn and simulated with.
+ * @param origin The origin.
+ * @param position The position.
+ * @return The float position.
+ */
+simd::float3 world_origin_relative(const WorldOrigin& origin, const WorldPosition& position);
+
+/**
+ * @brief Returns the world position of a float position relative to the origin.
+ * @param origin The origin.
+ * @param relative A float position.
+ * @return The position, normalized.
+ */
+WorldPosition world_origin_absolute(const WorldOrigin& origin, simd::float3 relative);
+
+/**
+ * @brief Moves the origin to the camera's chunk once the camera is far enough from it.
+ *
+ * The move is a whole number of chunks, so chunk grids, noise lattices and tile keys stay
+ * aligned and only the float coordinates change.
+ *
+ * @param origin The origin; moved if the camera is past the threshold.
+ * @param eye The camera, relative to the origin.
+ * @param threshold Horizontal distance from the origin beyond which it moves.
+ * @param shift Receives the offset to subtract from every float position when it moved.
+ * @return True if the origin moved.
+ */
+bool world_origin_rebase(WorldOrigin& origin, simd::float3 eye, float threshold, simd::float3& shift);
+
+/**
+ * @brief Returns a view matrix whose eye is at zero: the camera's rotation alone.
+ *
+ * Paired with model matrices translated by world_position_delta() from the eye, nothing the
+ * GPU multiplies holds the camera's distance from the world's origin.
+ *
+ * @param yaw The camera's yaw in radians.
+ * @param pitch The camera's pitch in radians.
+ * @return The view matrix.
+ */
+simd::float4x4 matrix_camera_relative_view(float yaw, float pitch);
@@ -0,0 +1,360 @@
+#include "world_save.hpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    size_t align_section(size_t offset) {
+        return (offset + WORLD_SAVE_ALIGNMENT - 1) & ~(WORLD_SAVE_ALIGNMENT - 1);
+    }
+
+    bool section_fits(uint64_t offset, uint64_t bytes, uint64_t fileSize) {
+        return offset % WORLD_SAVE_ALIGNMENT == 0 && offset <= fileSize && bytes <= fileSize - offset;
+    }
+
+    // Element sizes of this build; a file written with others is not read
+    constexpr uint32_t SECTION_STRIDES[WORLD_SAVE_SECTION_COUNT] = {
+        sizeof(simd::float4x4), sizeof(simd::float3), sizeof(uint32_t), sizeof(BoundingBox), 6 * sizeof(float),
+        sizeof(uint32_t),       sizeof(uint32_t),     sizeof(uint32_t), sizeof(uint32_t),    sizeof(uint32_t),
+        sizeof(BvhNode),        sizeof(TerrainEditPoint),
+    };
+
+    WorldSaveHeader layout_header(const WorldSaveState& state) {
+        const SceneStore& scene = state.scene;
+        const size_t counts[WORLD_SAVE_SECTION_COUNT] = {
+            scene.size(), scene.size(), scene.size(), scene.size(), scene.size(), scene.size(), scene.size(),
+            scene.dense.size(), scene.generations.size(), scene.freeSlots.size(), scene.bvh.nodes.size(),
+            state.terrainEdits.size(),
+        };
+        WorldSaveHeader header;
+        size_t offset = align_section(sizeof(WorldSaveHeader));
+        for (uint32_t i = 0; i < WORLD_SAVE_SECTION_COUNT; ++i) {
+            header.sections[i].stride = SECTION_STRIDES[i];
+            header.sections[i].count = (uint32_t)counts[i];
+            header.sections[i].offset = offset;
+            offset = align_section(offset + counts[i] * SECTION_STRIDES[i]);
+        }
+        header.fileSize = offset;
+        header.camera[0] = state.camera.position.x;
+        header.camera[1] = state.camera.position.y;
+        header.camera[2] = state.camera.position.z;
+        header.camera[3] = state.camera.yaw;
+        header.camera[4] = state.camera.pitch;
+        header.terrainSpacing = state.terrainSpacing;
+        header.bvhRoot = scene.bvh.root;
+        header.bvhFreeList = scene.bvh.freeList;
+        header.bvhLeafCount = scene.bvh.leafCount;
+        header.bvhMargin = scene.bvh.margin;
+        return header;
+    }
+
+    // Vector types carry a padding lane; only the three used ones are copied, so the file never holds stale bytes
+    void put_float3(char* out, simd::float3 value) {
+        const float lanes[3] = { value.x, value.y, value.z };
+        memcpy(out, lanes, sizeof(lanes));
+    }
+
+    void put_box(char* out, const BoundingBox& box) {
+        put_float3(out + offsetof(BoundingBox, min), box.min);
+        put_float3(out + offsetof(BoundingBox, max), box.max);
+    }
+
+    void put_node(char* out, const BvhNode& node) {
+        put_box(out + offsetof(BvhNode, box), node.box);
+        memcpy(out + offsetof(BvhNode, parent), &node.parent, sizeof(node.parent));
+        memcpy(out + offsetof(BvhNode, left), &node.left, sizeof(node.left));
+        memcpy(out + offsetof(BvhNode, right), &node.right, sizeof(node.right));
+        memcpy(out + offsetof(BvhNode, item), &node.item, sizeof(node.item));
+        memcpy(out + offsetof(BvhNode, height), &node.height, sizeof(node.height));
+    }
+
+    template <typename T>
+    void put_array(char* contents, const WorldSaveSection& section, const std::vector<T>& values) {
+        memcpy(contents + section.offset, values.data(), values.size() * sizeof(T));
+    }
+
+    template <typename T>
+    const T* section_data(const WorldSaveFile& file, WorldSaveSectionId id) {
+        return (const T*)file.sections[id];
+    }
+
+    template <typename T>
+    void get_array(const WorldSaveFile& file, WorldSaveSectionId id, std::vector<T>& values) {
+        const T* data = section_data<T>(file, id);
+        values.assign(data, data + file.header.sections[id].count);
+    }
+
+    // Copies a section out of a file read into memory, which need not be aligned for T
+    template <typename T>
+    void get_section(const std::vector<char>& contents, const WorldSaveSection& section, std::vector<T>& values) {
+        values.resize(section.count);
+        memcpy(values.data(), contents.data() + section.offset, (size_t)section.count * sizeof(T));
+    }
+
+    bool index_valid(uint32_t index, uint32_t count) {
+        return index == UINT32_MAX || index < count;
+    }
+
+    // Indices the restored scene would follow must stay inside their arrays, whatever the file holds
+    bool indices_valid(const WorldSaveFile& file) {
+        const WorldSaveSection* sections = file.header.sections;
+        const uint32_t entities = sections[WORLD_SAVE_TRANSFORMS].count;
+        const uint32_t slots = sections[WORLD_SAVE_DENSE].count;
+        const uint32_t nodes = sections[WORLD_SAVE_BVH_NODES].count;
+        for (uint32_t id = WORLD_SAVE_COLORS; id <= WORLD_SAVE_OWNERS; ++id) {
+            if (sections[id].count != entities) {
+                return false;
+            }
+        }
+        if (sections[WORLD_SAVE_GENERATIONS].count != slots || !index_valid(file.header.bvhRoot, nodes) ||
+            !index_valid(file.header.bvhFreeList, nodes)) {
+            return false;
+        }
+        const uint32_t* proxies = section_data<uint32_t>(file, WORLD_SAVE_PROXIES);
+        const uint32_t* owners = section_data<uint32_t>(file, WORLD_SAVE_OWNERS);
+        for (uint32_t i = 0; i < entities; ++i) {
+            if (proxies[i] >= nodes || owners[i] >= slots) {
+                return false;
+            }
+        }
+        const uint32_t* dense = section_data<uint32_t>(file, WORLD_SAVE_DENSE);
+        for (uint32_t i = 0; i < slots; ++i) {
+            if (!index_valid(dense[i], entities)) {
+                return false;
+            }
+        }
+        const uint32_t* freeSlots = section_data<uint32_t>(file, WORLD_SAVE_FREE_SLOTS);
+        for (uint32_t i = 0; i < sections[WORLD_SAVE_FREE_SLOTS].count; ++i) {
+            if (freeSlots[i] >= slots) {
+                return false;
+            }
+        }
+        const BvhNode* bvhNodes = section_data<BvhNode>(file, WORLD_SAVE_BVH_NODES);
+        for (uint32_t i = 0; i < nodes; ++i) {
+            const BvhNode& node = bvhNodes[i];
+            if (!index_valid(node.parent, nodes) || !index_valid(node.left, nodes) || !index_valid(node.right, nodes)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void world_save_capture(const SceneStore& scene, const CameraPose& camera, const TerrainEdits& edits,
+                        WorldSaveState& state) {
+    state.scene = scene;
+    state.camera = camera;
+    edits.points(state.terrainEdits);
+    state.terrainSpacing = edits.spacing();
+}
+
+size_t world_save_file_size(const WorldSaveState& state) {
+    return layout_header(state).fileSize;
+}
+
+bool write_world_save(const std::string& path, const WorldSaveState& state) {
+    const WorldSaveHeader header = layout_header(state);
+    const WorldSaveSection* sections = header.sections;
+    const SceneStore& scene = state.scene;
+    std::vector<char> contents(header.fileSize, 0);
+    memcpy(contents.data(), &header, sizeof(header));
+
+    put_array(contents.data(), sections[WORLD_SAVE_TRANSFORMS], scene.transforms);
+    for (size_t i = 0; i < scene.size(); ++i) {
+        put_float3(contents.data() + sections[WORLD_SAVE_COLORS].offset + i * sizeof(simd::float3), scene.colors[i]);
+        put_box(contents.data() + sections[WORLD_SAVE_LOCAL_BOUNDS].offset + i * sizeof(BoundingBox),
+                scene.localBounds[i]);
+    }
+    put_array(contents.data(), sections[WORLD_SAVE_MESHES], scene.meshes);
+    const std::vector<float>* bounds[6] = { &scene.worldBounds.centerX, &scene.worldBounds.centerY,
+                                            &scene.worldBounds.centerZ, &scene.worldBounds.extentX,
+                                            &scene.worldBounds.extentY, &scene.worldBounds.extentZ };
+    for (int axis = 0; axis < 6; ++axis) {
+        memcpy(contents.data() + sections[WORLD_SAVE_WORLD_BOUNDS].offset + axis * scene.size() * sizeof(float),
+               bounds[axis]->data(), scene.size() * sizeof(float));
+    }
+    put_array(contents.data(), sections[WORLD_SAVE_PROXIES], scene.proxies);
+    put_array(contents.data(), sections[WORLD_SAVE_OWNERS], scene.owners);
+    put_array(contents.data(), sections[WORLD_SAVE_DENSE], scene.dense);
+    put_array(contents.data(), sections[WORLD_SAVE_GENERATIONS], scene.generations);
+    put_array(contents.data(), sections[WORLD_SAVE_FREE_SLOTS], scene.freeSlots);
+    for (size_t i = 0; i < scene.bvh.nodes.size(); ++i) {
+        put_node(contents.data() + sections[WORLD_SAVE_BVH_NODES].offset + i * sizeof(BvhNode), scene.bvh.nodes[i]);
+    }
+    put_array(contents.data(), sections[WORLD_SAVE_TERRAIN_EDITS], state.terrainEdits);
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(contents.data(), contents.size()) || !file.flush()) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool map_world_save(const std::string& path, WorldSaveFile& file) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(WorldSaveHeader)) {
+        close(fd);
+        return false;
+    }
+    const size_t fileSize = (size_t)info.st_size;
+    void* data = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    WorldSaveHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool valid = header.magic == WORLD_SAVE_MAGIC && header.version == WORLD_SAVE_VERSION &&
+                 header.fileSize == fileSize;
+    for (uint32_t i = 0; i < WORLD_SAVE_SECTION_COUNT && valid; ++i) {
+        const WorldSaveSection& section = header.sections[i];
+        valid = section.stride == SECTION_STRIDES[i] &&
+                section_fits(section.offset, (uint64_t)section.count * section.stride, fileSize);
+    }
+    // The pointer fixups: every section is used where it lies in the mapping
+    file.data = data;
+    file.length = fileSize;
+    file.header = header;
+    for (uint32_t i = 0; i < WORLD_SAVE_SECTION_COUNT && valid; ++i) {
+        file.sections[i] = (const char*)data + header.sections[i].offset;
+    }
+    if (!valid || !indices_valid(file)) {
+        munmap(data, fileSize);
+        file = WorldSaveFile();
+        return false;
+    }
+    return true;
+}
+
+void unmap_world_save(const WorldSaveFile& file) {
+    if (file.data) {
+        munmap(file.data, file.length);
+    }
+}
+
+void world_save_restore_scene(const WorldSaveFile& file, SceneStore& scene) {
+    get_array(file, WORLD_SAVE_TRANSFORMS, scene.transforms);
+    get_array(file, WORLD_SAVE_COLORS, scene.colors);
+    get_array(file, WORLD_SAVE_MESHES, scene.meshes);
+    get_array(file, WORLD_SAVE_LOCAL_BOUNDS, scene.localBounds);
+    const uint32_t count = file.header.sections[WORLD_SAVE_TRANSFORMS].count;
+    const float* bounds = section_data<float>(file, WORLD_SAVE_WORLD_BOUNDS);
+    std::vector<float>* axes[6] = { &scene.worldBounds.centerX, &scene.worldBounds.centerY,
+                                    &scene.worldBounds.centerZ, &scene.worldBounds.extentX,
+                                    &scene.worldBounds.extentY, &scene.worldBounds.extentZ };
+    for (int axis = 0; axis < 6; ++axis) {
+        axes[axis]->assign(bounds + axis * count, bounds + (axis + 1) * count);
+    }
+    get_array(file, WORLD_SAVE_PROXIES, scene.proxies);
+    get_array(file, WORLD_SAVE_OWNERS, scene.owners);
+    get_array(file, WORLD_SAVE_DENSE, scene.dense);
+    get_array(file, WORLD_SAVE_GENERATIONS, scene.generations);
+    get_array(file, WORLD_SAVE_FREE_SLOTS, scene.freeSlots);
+    scene.dirty.clear();
+    // None of the restored instances are on the GPU yet
+    scene_mark_all_instances(scene);
+
+    get_array(file, WORLD_SAVE_BVH_NODES, scene.bvh.nodes);
+    scene.bvh.root = file.header.bvhRoot;
+    scene.bvh.freeList = file.header.bvhFreeList;
+    scene.bvh.leafCount = file.header.bvhLeafCount;
+    scene.bvh.margin = file.header.bvhMargin;
+    scene.bvh.refitQueue.clear();
+}
+
+CameraPose world_save_camera(const WorldSaveFile& file) {
+    CameraPose pose;
+    pose.position = { file.header.camera[0], file.header.camera[1], file.header.camera[2] };
+    pose.yaw = file.header.camera[3];
+    pose.pitch = file.header.camera[4];
+    return pose;
+}
+
+const TerrainEditPoint* world_save_terrain_edits(const WorldSaveFile& file) {
+    return section_data<TerrainEditPoint>(file, WORLD_SAVE_TERRAIN_EDITS);
+}
+
+std::string scene_cell_path(const std::string& directory, ChunkKey key) {
+    return (std::filesystem::path(directory) /
+            (std::to_string(key.x) + "_" + std::to_string(key.z) + ".cell")).string();
+}
+
+bool write_scene_cell(const std::string& path, ChunkKey key, const SceneCellObjects& objects) {
+    SceneCellHeader header;
+    header.chunkX = key.x;
+    header.chunkZ = key.z;
+    size_t offset = align_section(sizeof(SceneCellHeader));
+    for (uint32_t i = 0; i < SCENE_CELL_SECTION_COUNT; ++i) {
+        header.sections[i].stride = SECTION_STRIDES[i];
+        header.sections[i].count = (uint32_t)objects.size();
+        header.sections[i].offset = offset;
+        offset = align_section(offset + objects.size() * SECTION_STRIDES[i]);
+    }
+    header.fileSize = offset;
+
+    const WorldSaveSection* sections = header.sections;
+    std::vector<char> contents(header.fileSize, 0);
+    memcpy(contents.data(), &header, sizeof(header));
+    put_array(contents.data(), sections[WORLD_SAVE_TRANSFORMS], objects.transforms);
+    for (size_t i = 0; i < objects.size(); ++i) {
+        put_float3(contents.data() + sections[WORLD_SAVE_COLORS].offset + i * sizeof(simd::float3), objects.colors[i]);
+        put_box(contents.data() + sections[WORLD_SAVE_LOCAL_BOUNDS].offset + i * sizeof(BoundingBox),
+                objects.localBounds[i]);
+    }
+    put_array(contents.data(), sections[WORLD_SAVE_MESHES], objects.meshes);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(contents.data(), contents.size()) || !file.flush()) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool read_scene_cell(const std::string& path, ChunkKey key, SceneCellObjects& objects) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    SceneCellHeader header;
+    if (contents.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, contents.data(), sizeof(header));
+    bool valid = header.magic == SCENE_CELL_MAGIC && header.version == WORLD_SAVE_VERSION &&
+                 header.fileSize == contents.size() && header.chunkX == key.x && header.chunkZ == key.z;
+    for (uint32_t i = 0; i < SCENE_CELL_SECTION_COUNT && valid; ++i) {
+        const WorldSaveSection& section = header.sections[i];
+        valid = section.stride == SECTION_STRIDES[i] && section.count == header.sections[0].count &&
+                section_fits(section.offset, (uint64_t)section.count * section.stride, contents.size());
+    }
+    if (!valid) {
+        return false;
+    }
+    get_section(contents, header.sections[WORLD_SAVE_TRANSFORMS], objects.transforms);
+    get_section(contents, header.sections[WORLD_SAVE_COLORS], objects.colors);
+    get_section(contents, header.sections[WORLD_SAVE_MESHES], objects.meshes);
+    get_section(contents, header.sections[WORLD_SAVE_LOCAL_BOUNDS], objects.localBounds);
+    return true;
+}
@@ -0,0 +1,236 @@
+/**
+ * @file world_save.hpp
+ * @brief Saved worlds: the scene, the terrain edits and the camera in one flat binary file.
+ *
+ * Every array of the SceneStore, its BVH included, is written in the layout the program
+ * keeps it in, so loading maps the file, checks the header and the section table, and points
+ * at the sections where they lie; restoring the scene is then one copy per array, with no
+ * parsing and no rebuilding of the hierarchy. Entity handles survive, since the handle table
+ * is saved with the components.
+ *
+ * Saving is split so the frame only pays for copies: world_save_capture() copies the state
+ * into a WorldSaveState, reusing its allocations from the last save, and write_world_save()
+ * lays out and writes that copy on any thread while the frame carries on. The file is
+ * written next to its destination and renamed over it, so a crash mid-save keeps the old
+ * world. Padding lanes are zeroed and the terrain edits sorted, so equal worlds give equal
+ * files.
+ *
+ * Sections follow a WorldSaveHeader at offset 0, each starting at a multiple of
+ * WORLD_SAVE_ALIGNMENT, in WorldSaveSectionId order.
+ *
+ * A streamed scene (see scene_cells.hpp) keeps the objects of each terrain chunk in a cell file
+ * of the same format: a SceneCellHeader and the first four sections of a saved world, holding
+ * only the cell's entities. Cells have no handles or hierarchy of their own; loading one creates
+ * its entities afresh.
+ */
+
+#pragma once
+#include <simd/simd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "landscape.hpp"
+#include "scene.hpp"
+#include "simulation.hpp"
+#include "terrain_edit.hpp"
+
+/// "WSAV" in little-endian byte order.
+constexpr uint32_t WORLD_SAVE_MAGIC = 0x56415357;
+/// Bump whenever files written by older builds must not be read.
+constexpr uint32_t WORLD_SAVE_VERSION = 2;
+/// Every section starts at a multiple of this.
+constexpr size_t WORLD_SAVE_ALIGNMENT = 16;
+/// "SCEL" in little-endian byte order; cell files share WORLD_SAVE_VERSION.
+constexpr uint32_t SCENE_CELL_MAGIC = 0x4c454353;
+
+/**
+ * @enum WorldSaveSectionId
+ * @brief The sections of a saved world, in file order.
+ */
+enum WorldSaveSectionId : uint32_t {
+    WORLD_SAVE_TRANSFORMS,      ///< simd::float4x4 per entity.
+    WORLD_SAVE_COLORS,          ///< simd::float3 per entity.
+    WORLD_SAVE_MESHES,          ///< uint32_t mesh handle per entity.
+    WORLD_SAVE_LOCAL_BOUNDS,    ///< BoundingBox per entity.
+    WORLD_SAVE_WORLD_BOUNDS,    ///< Six float arrays per entity: the CullBounds centres, then the extents.
+    WORLD_SAVE_PROXIES,         ///< uint32_t BVH leaf per entity.
+    WORLD_SAVE_OWNERS,          ///< uint32_t handle slot per entity.
+    WORLD_SAVE_DENSE,           ///< uint32_t dense position per handle slot.
+    WORLD_SAVE_GENERATIONS,     ///< uint32_t generation per handle slot.
+    WORLD_SAVE_FREE_SLOTS,      ///< uint32_t per free handle slot.
+    WORLD_SAVE_BVH_NODES,       ///< BvhNode per node of the pool.
+    WORLD_SAVE_TERRAIN_EDITS,   ///< TerrainEditPoint per edited grid point.
+    WORLD_SAVE_SECTION_COUNT
+};
+
+/**
+ * @struct WorldSaveSection
+ * @brief Where one section lies and what it holds.
+ */
+struct WorldSaveSection {
+    uint32_t stride = 0;    ///< Bytes per element when written; must match the reader's.
+    uint32_t count = 0;     ///< Elements in the section.
+    uint64_t offset = 0;    ///< Byte offset of the section.
+};
+
+/**
+ * @struct WorldSaveHeader
+ * @brief The first bytes of a saved world.
+ */
+struct WorldSaveHeader {
+    uint32_t magic = WORLD_SAVE_MAGIC;      ///< Identifies a saved world.
+    uint32_t version = WORLD_SAVE_VERSION;  ///< Format version the file was written with.
+    uint64_t fileSize = 0;                  ///< Size of the whole file.
+    float camera[5] = {};                   ///< Camera position, yaw and pitch.
+    float terrainSpacing = 0.0f;            ///< TerrainEdits::spacing() the edits were made at.
+    uint32_t bvhRoot = BVH_NULL;            ///< Bvh::root of the scene.
+    uint32_t bvhFreeList = BVH_NULL;        ///< Bvh::freeList of the scene.
+    uint32_t bvhLeafCount = 0;              ///< Bvh::leafCount of the scene.
+    float bvhMargin = 0.0f;                 ///< Bvh::margin of the scene.
+    WorldSaveSection sections[WORLD_SAVE_SECTION_COUNT]; ///< Indexed by WorldSaveSectionId.
+};
+
+/// Sections of a cell file: the first ones of a saved world, indexed by the same WorldSaveSectionId.
+constexpr uint32_t SCENE_CELL_SECTION_COUNT = WORLD_SAVE_LOCAL_BOUNDS + 1;
+
+/**
+ * @struct SceneCellHeader
+ * @brief The first bytes of a cell file.
+ */
+struct SceneCellHeader {
+    uint32_t magic = SCENE_CELL_MAGIC;      ///< Identifies a cell file.
+    uint32_t version = WORLD_SAVE_VERSION;  ///< Format version the file was written with.
+    uint64_t fileSize = 0;                  ///< Size of the whole file.
+    int32_t chunkX = 0;                     ///< ChunkKey::x of the cell.
+    int32_t chunkZ = 0;                     ///< ChunkKey::z of the cell.
+    WorldSaveSection sections[SCENE_CELL_SECTION_COUNT]; ///< Transforms, colours, meshes and local bounds.
+};
+
+/**
+ * @struct SceneCellObjects
+ * @brief The entities of one cell out of the scene, one element each in every array.
+ */
+struct SceneCellObjects {
+    std::vector<simd::float4x4> transforms; ///< Model to world matrices.
+    std::vector<simd::float3> colors;       ///< Flat colours.
+    std::vector<uint32_t> meshes;           ///< Mesh handles.
+    std::vector<BoundingBox> localBounds;   ///< Model space bounds of each entity's mesh.
+
+    /// @return The number of entities.
+    size_t size() const { return transforms.size(); }
+
+    /// Removes every entity, keeping the capacity.
+    void clear() {
+        transforms.clear();
+        colors.clear();
+        meshes.clear();
+        localBounds.clear();
+    }
+};
+
+/**
+ * @struct WorldSaveState
+ * @brief A copy of everything a save holds, owned by whoever writes it.
+ */
+struct WorldSaveState {
+    SceneStore scene;                           ///< The scene, bounds up to date.
+    CameraPose camera;                          ///< The camera.
+    std::vector<TerrainEditPoint> terrainEdits; ///< The edited points, in TerrainEdits::points() order.
+    float terrainSpacing = 0.0f;                ///< Grid spacing of the edits.
+};
+
+/**
+ * @struct WorldSaveFile
+ * @brief A saved world mapped into memory; the pointers point into the mapping.
+ */
+struct WorldSaveFile {
+    void* data = nullptr;                       ///< Start of the mapping.
+    size_t length = 0;                          ///< Length of the mapping.
+    WorldSaveHeader header;                     ///< Copy of the validated header.
+    const void* sections[WORLD_SAVE_SECTION_COUNT] = {}; ///< Start of each section, by WorldSaveSectionId.
+};
+
+/**
+ * @brief Copies the state of the world for a save.
+ *
+ * Only copies: the arrays are assigned into the state's, whose capacity is kept between
+ * saves, so a capture costs a few memcpy calls of the scene's size.
+ *
+ * @param scene The scene, with bounds up to date.
+ * @param camera The camera.
+ * @param edits The terrain edits.
+ * @param state Receives the copy.
+ */
+void world_save_capture(const SceneStore& scene, const CameraPose& camera, const TerrainEdits& edits,
+                        WorldSaveState& state);
+
+/// @return The size of the file write_world_save() writes for a state.
+size_t world_save_file_size(const WorldSaveState& state);
+
+/**
+ * @brief Writes a saved world; safe from any thread that owns the state.
+ *
+ * The file is written as path + ".tmp" and renamed over path once complete.
+ *
+ * @param path The output path.
+ * @param state The captured world.
+ * @return True if the file was written.
+ */
+bool write_world_save(const std::string& path, const WorldSaveState& state);
+
+/**
+ * @brief Maps a saved world, checks its header and points at its sections.
+ * @param path The file to map.
+ * @param file Receives the mapping.
+ * @return True if the file exists, was written with this format version and layout and every
+ *         section lies within it; the mapping must be released with unmap_world_save().
+ */
+bool map_world_save(const std::string& path, WorldSaveFile& file);
+
+/// Releases a mapping made by map_world_save().
+void unmap_world_save(const WorldSaveFile& file);
+
+/**
+ * @brief Replaces a scene with the saved one, handles and hierarchy included.
+ *
+ * The saved mesh handles must name the same meshes as the scene's MeshRegistry, which holds
+ * when the file was saved by the same program.
+ *
+ * @param file The mapped world.
+ * @param scene Receives the scene; its capacity is kept.
+ */
+void world_save_restore_scene(const WorldSaveFile& file, SceneStore& scene);
+
+/// @return The saved camera.
+CameraPose world_save_camera(const WorldSaveFile& file);
+
+/// @return The saved terrain edits; WorldSaveFile::header.sections[WORLD_SAVE_TERRAIN_EDITS].count of them.
+const TerrainEditPoint* world_save_terrain_edits(const WorldSaveFile& file);
+
+/// @return The path of a chunk's cell file inside a directory of cells.
+std::string scene_cell_path(const std::string& directory, ChunkKey key);
+
+/**
+ * @brief Writes a cell file, creating its directory if needed.
+ *
+ * The file is written as path + ".tmp" and renamed over path once complete.
+ *
+ * @param path The output path.
+ * @param key The chunk the cell belongs to.
+ * @param objects The cell's entities.
+ * @return True if the file was written.
+ */
+bool write_scene_cell(const std::string& path, ChunkKey key, const SceneCellObjects& objects);
+
+/**
+ * @brief Reads a cell file.
+ * @param path The file to read.
+ * @param key The chunk the cell must belong to.
+ * @param objects Receives the cell's entities; undefined on failure.
+ * @return True if the file exists, was written for key with this format version and layout and
+ *         every section lies within it.
+ */
+bool read_scene_cell(const std::string& path, ChunkKey key, SceneCellObjects& objects);
@@ -0,0 +1,26 @@
+/**
+ * @file heap_allocations.hpp
+ * @brief Test helper: counts the heap allocations a stretch of code makes.
+ *
+ * run_tests is built with TRACK_HEAP_ALLOCATIONS, so the global operator new and delete are
+ * the counting replacements in frame_arena.cpp and heap_allocation_count() is live. The count
+ * is per thread, so work other threads do at the same time, such as job system workers,
+ * is not included.
+ */
+
+#pragma once
+#include <cstdint>
+
+#include "frame_arena.hpp"
+
+/**
+ * @brief Runs a function and counts the operator new calls it makes on the calling thread.
+ * @param work The code to measure.
+ * @return The number of allocations.
+ */
+template <typename Work>
+uint64_t count_heap_allocations(Work&& work) {
+    const uint64_t before = heap_allocation_count();
+    work();
+    return heap_allocation_count() - before;
+}
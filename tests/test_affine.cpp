@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "affine.hpp"
+#include "camera.hpp"
+
+#include <vector>
+
+namespace {
+    void expect_affine_near(const Affine& a, const Affine& b, float tolerance = 1e-5f) {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                EXPECT_NEAR(a.rows[i][j], b.rows[i][j], tolerance) << "row " << i << " column " << j;
+            }
+        }
+    }
+
+    Trs sample_trs(float angle) {
+        Trs trs;
+        trs.translation = { 3.0f, -1.0f, 2.5f };
+        trs.rotation = simd_quaternion(angle, simd::normalize(simd::float3{ 1.0f, 2.0f, -0.5f }));
+        trs.scale = { 1.5f, 0.5f, 2.0f };
+        return trs;
+    }
+
+    // Built at compile time; the constructors need no runtime work
+    constexpr Affine SHIFT = affine_translation(1.0f, 2.0f, 3.0f);
+}
+
+TEST(AffineTests, MatchesTheMatrixHelpers) {
+    expect_affine_near(SHIFT, affine_from_matrix(matrix_translation(1.0f, 2.0f, 3.0f)));
+    expect_affine_near(affine_translation_scale(1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f),
+                       affine_from_matrix(matrix_translation(1.0f, 2.0f, 3.0f) * matrix_scale(4.0f, 5.0f, 6.0f)));
+    expect_affine_near(affine_trs_y({ 1.0f, 2.0f, 3.0f }, 0.7f, { 1.5f, 1.0f, 2.5f }),
+                       affine_from_matrix(matrix_translation(1.0f, 2.0f, 3.0f) * matrix_rotation_y(0.7f) *
+                                          matrix_scale(1.5f, 1.0f, 2.5f)));
+
+    // Widening and narrowing round-trip, and the products agree with float4x4 products
+    const Affine a = affine_trs_y({ -4.0f, 0.5f, 2.0f }, 1.1f, { 2.0f, 3.0f, 0.5f });
+    const Affine b = affine_from_trs(sample_trs(0.4f));
+    expect_affine_near(affine_from_matrix(affine_matrix(a)), a);
+    expect_affine_near(affine_multiply(a, b), affine_from_matrix(affine_matrix(a) * affine_matrix(b)));
+
+    const simd::float3 p = affine_transform_point(b, { 1.0f, -2.0f, 0.5f });
+    const simd::float4 q = affine_matrix(b) * simd::float4{ 1.0f, -2.0f, 0.5f, 1.0f };
+    EXPECT_NEAR(p.x, q.x, 1e-5f);
+    EXPECT_NEAR(p.y, q.y, 1e-5f);
+    EXPECT_NEAR(p.z, q.z, 1e-5f);
+}
+
+TEST(AffineTests, QuaternionAboutYMatchesYaw) {
+    Trs trs;
+    trs.translation = { 1.0f, 2.0f, 3.0f };
+    trs.rotation = simd_quaternion(0.9f, simd::float3{ 0.0f, 1.0f, 0.0f });
+    trs.scale = { 2.0f, 1.0f, 0.5f };
+    expect_affine_near(affine_from_trs(trs), affine_trs_y(trs.translation, 0.9f, trs.scale));
+}
+
+TEST(AffineTests, InversesUndoTheTransform) {
+    const Trs trs = sample_trs(1.3f);
+    const Affine m = affine_from_trs(trs);
+    expect_affine_near(affine_multiply(affine_inverse(m), m), affine_identity());
+    expect_affine_near(affine_multiply(m, affine_inverse(m)), affine_identity());
+    expect_affine_near(affine_inverse_trs(trs), affine_inverse(m));
+}
+
+TEST(AffineTests, ComposeTrsKeepsTheInverseInStep) {
+    const Affine root = affine_trs_y({ 5.0f, 0.0f, -2.0f }, 0.3f, { 2.0f, 2.0f, 2.0f });
+    AffinePair pair = { root, affine_inverse(root) };
+    for (int i = 0; i < 4; ++i) {
+        pair = affine_compose_trs(pair, sample_trs(0.5f * (float)i));
+    }
+    expect_affine_near(pair.inverse, affine_inverse(pair.forward), 1e-4f);
+    expect_affine_near(affine_multiply(pair.forward, pair.inverse), affine_identity(), 1e-4f);
+}
+
+TEST(AffineTests, BatchesMatchOneAtATime) {
+    const size_t n = 37;
+    std::vector<Trs> trs(n);
+    for (size_t i = 0; i < n; ++i) {
+        trs[i] = sample_trs(0.1f * (float)i);
+        trs[i].translation.x = (float)i;
+    }
+    std::vector<Affine> local(n), world(n), pairwise(n);
+    affine_from_trs_batch(trs.data(), local.data(), n);
+
+    const Affine parent = affine_trs_y({ 1.0f, 2.0f, 3.0f }, 0.8f, { 1.0f, 2.0f, 1.0f });
+    affine_multiply_batch(parent, local.data(), world.data(), n);
+    std::vector<Affine> parents(n, parent);
+    affine_multiply_batch(parents.data(), local.data(), pairwise.data(), n);
+
+    std::vector<simd::float4x4> matrices(n);
+    affine_matrix_batch(world.data(), matrices.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        expect_affine_near(local[i], affine_from_trs(trs[i]));
+        expect_affine_near(world[i], affine_multiply(parent, local[i]));
+        expect_affine_near(pairwise[i], world[i]);
+        expect_affine_near(affine_from_matrix(matrices[i]), world[i]);
+    }
+
+    // In place
+    affine_multiply_batch(parent, local.data(), local.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        expect_affine_near(local[i], world[i]);
+    }
+}
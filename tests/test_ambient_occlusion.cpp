@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "ambient_occlusion.hpp"
+#include "camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Projects a view-space point to the pixel and depth ao_view_position reads back
+    void project(const Camera& cam, simd::float3 view, uint32_t width, uint32_t height, simd::float2& pixel,
+                 float& depth) {
+        const simd::float4 clip = cam.projectionMatrix * simd::float4{ view.x, view.y, view.z, 1.0f };
+        pixel = { (clip.x / clip.w * 0.5f + 0.5f) * width, (0.5f - clip.y / clip.w * 0.5f) * height };
+        depth = clip.z / clip.w;
+    }
+}
+
+TEST(AmbientOcclusionTests, ViewPositionsRoundTripThroughTheDepthBuffer) {
+    for (bool reverseZ : { false, true }) {
+        const Camera cam = make_camera(1280, 720, reverseZ);
+        const AmbientOcclusionUniforms uniforms =
+            ambient_occlusion_uniforms(cam.projectionMatrix, 1280, 720, camera_clear_depth(cam), {});
+        for (simd::float3 view : { simd::float3{ 0.0f, 0.0f, -5.0f }, simd::float3{ 3.0f, -2.0f, -40.0f },
+                                   simd::float3{ -20.0f, 8.0f, -300.0f } }) {
+            simd::float2 pixel;
+            float depth;
+            project(cam, view, 1280, 720, pixel, depth);
+            const simd::float3 rebuilt = ao_view_position(uniforms, pixel, depth);
+            EXPECT_NEAR(rebuilt.x, view.x, 1e-3f * -view.z);
+            EXPECT_NEAR(rebuilt.y, view.y, 1e-3f * -view.z);
+            EXPECT_NEAR(rebuilt.z, view.z, 1e-3f * -view.z);
+        }
+        // A world unit at depth 1 spans as many pixels as the projection says
+        EXPECT_NEAR(ao_pixel_radius(uniforms, 1e6f) * 1e6f / uniforms.radius, uniforms.pixelsPerUnit, 1e-2f);
+    }
+}
+
+TEST(AmbientOcclusionTests, NormalsFaceTheCameraAndIgnoreSilhouettes) {
+    // Ground 2 units below the eye, seen looking down -z
+    auto ground = [](float x, float z) { return simd::float3{ x, -2.0f, z }; };
+    simd::float3 n = ao_normal(ground(0, -10), ground(-0.1f, -10), ground(0.1f, -10), ground(0, -10.2f), ground(0, -9.8f));
+    EXPECT_NEAR(n.y, 1.0f, 1e-4f);
+
+    // The right neighbour is on a far wall; the left one continues the ground
+    n = ao_normal(ground(0, -10), ground(-0.1f, -10), simd::float3{ 0.1f, 5.0f, -80.0f }, ground(0, -10.2f),
+                  ground(0, -9.8f));
+    EXPECT_NEAR(n.y, 1.0f, 1e-4f);
+
+    // A wall facing the camera
+    auto wall = [](float x, float y) { return simd::float3{ x, y, -10.0f }; };
+    n = ao_normal(wall(0, 0), wall(-0.1f, 0), wall(0.1f, 0), wall(0, 0.1f), wall(0, -0.1f));
+    EXPECT_NEAR(n.z, 1.0f, 1e-4f);
+}
+
+TEST(AmbientOcclusionTests, OnlyNearGeometryAboveTheTangentPlaneOccludes) {
+    const simd::float3 up = { 0.0f, 1.0f, 0.0f };
+    // Flat ground, and anything below it, does not occlude
+    EXPECT_EQ(ao_sample_occlusion({ 1.0f, 0.0f, 0.0f }, up, 4.0f), 0.0f);
+    EXPECT_EQ(ao_sample_occlusion({ 1.0f, -1.0f, 0.0f }, up, 4.0f), 0.0f);
+    EXPECT_EQ(ao_sample_occlusion({ 0.0f, 0.0f, 0.0f }, up, 4.0f), 0.0f);
+
+    // A wall beside the surface does, less with distance and not at all beyond the radius
+    const float near = ao_sample_occlusion({ 0.5f, 0.5f, 0.0f }, up, 4.0f);
+    const float far = ao_sample_occlusion({ 2.0f, 2.0f, 0.0f }, up, 4.0f);
+    EXPECT_GT(near, far);
+    EXPECT_GT(far, 0.0f);
+    EXPECT_EQ(ao_sample_occlusion({ 4.0f, 4.0f, 0.0f }, up, 4.0f), 0.0f);
+    EXPECT_LE(ao_sample_occlusion({ 0.0f, 0.1f, 0.0f }, up, 4.0f), 1.0f);
+
+    EXPECT_EQ(ao_visibility(0.0f, 1.5f), 1.0f);
+    EXPECT_EQ(ao_visibility((float)AO_SAMPLES, 1.5f), 0.0f);
+    EXPECT_NEAR(ao_visibility(0.5f * AO_SAMPLES, 1.0f), 0.5f, 1e-6f);
+}
+
+TEST(AmbientOcclusionTests, SpiralStaysInTheDiskAndCoversIt) {
+    float minRadius = 1.0f;
+    float maxRadius = 0.0f;
+    simd::float2 sum = { 0.0f, 0.0f };
+    for (uint32_t i = 0; i < AO_SAMPLES; ++i) {
+        const simd::float2 offset = ao_sample_offset(i, 0.3f);
+        const float radius = sqrtf(offset.x * offset.x + offset.y * offset.y);
+        EXPECT_LE(radius, 1.0f);
+        minRadius = std::min(minRadius, radius);
+        maxRadius = std::max(maxRadius, radius);
+        sum = sum + offset;
+    }
+    EXPECT_LT(minRadius, 0.1f);
+    EXPECT_GT(maxRadius, 0.9f);
+    // Spread around the centre rather than bunched to one side
+    EXPECT_LT(sqrtf(sum.x * sum.x + sum.y * sum.y) / AO_SAMPLES, 0.25f);
+
+    for (uint32_t y = 0; y < 8; ++y) {
+        for (uint32_t x = 0; x < 8; ++x) {
+            const float noise = ao_noise(x, y);
+            EXPECT_GE(noise, 0.0f);
+            EXPECT_LT(noise, 1.0f);
+        }
+    }
+    EXPECT_NE(ao_noise(0, 0), ao_noise(1, 0));
+}
+
+TEST(AmbientOcclusionTests, UpsampleFavoursTheSameSurfaceAndApplyOccludesOnlyAmbient) {
+    EXPECT_GT(ao_upsample_weight(20.0f, 20.1f), 50.0f * ao_upsample_weight(20.0f, 60.0f));
+    EXPECT_GT(ao_upsample_weight(20.0f, 20.0f), ao_upsample_weight(20.0f, 20.1f));
+
+    const simd::float3 color = { 0.4f, 0.6f, 0.2f };
+    const simd::float3 unlit = ao_apply(color, 0.0f, 0.2f);
+    EXPECT_FLOAT_EQ(unlit.y, color.y);
+    const simd::float3 ambient = ao_apply(color, 1.0f, 0.25f);
+    EXPECT_FLOAT_EQ(ambient.x, 0.25f * color.x);
+    const simd::float3 mixed = ao_apply(color, 0.5f, 0.0f);
+    EXPECT_FLOAT_EQ(mixed.z, 0.5f * color.z);
+    const simd::float3 open = ao_apply(color, 0.7f, 1.0f);
+    EXPECT_FLOAT_EQ(open.x, color.x);
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include "animation.hpp"
+#include "creature.hpp"
+
+#include <cmath>
+
+namespace {
+    const simd::float3 Y_AXIS = { 0.0f, 1.0f, 0.0f };
+    const simd::float3 Z_AXIS = { 0.0f, 0.0f, 1.0f };
+
+    simd::quatf negated(simd::quatf q) {
+        return simd::quatf{ simd::float4{ -q.vector.x, -q.vector.y, -q.vector.z, -q.vector.w } };
+    }
+
+    void expect_near(simd::float3 a, simd::float3 b, float tolerance = 1e-4f) {
+        EXPECT_NEAR(a.x, b.x, tolerance);
+        EXPECT_NEAR(a.y, b.y, tolerance);
+        EXPECT_NEAR(a.z, b.z, tolerance);
+    }
+
+    // A root at (0, 1, 0) and a child one unit above it
+    Skeleton two_joints() {
+        Skeleton skeleton;
+        skeleton.parents = { JOINT_ROOT, 0 };
+        skeleton.inverseBind = { affine_translation(0.0f, -1.0f, 0.0f), affine_translation(0.0f, -2.0f, 0.0f) };
+        return skeleton;
+    }
+}
+
+TEST(AnimationTests, SamplingInterpolatesKeysAlongTheShorterArc) {
+    AnimationClip clip;
+    animation_clip_resize(clip, 1, 3);
+    EXPECT_FLOAT_EQ(clip.duration(), 2.0f / 30.0f);
+    // The second key is stored as -q, the same rotation as q by the long way round
+    animation_set_key(clip, 0, 0, simd_quaternion(0.0f, Y_AXIS), { 0.0f, 0.0f, 0.0f });
+    animation_set_key(clip, 1, 0, negated(simd_quaternion((float)M_PI / 2.0f, Y_AXIS)), { 2.0f, 0.0f, 0.0f });
+    animation_set_key(clip, 2, 0, simd_quaternion(0.0f, Y_AXIS), { 0.0f, 0.0f, 0.0f });
+
+    Pose pose;
+    animation_sample(clip, 0.25f, pose);
+    EXPECT_NEAR(pose.translation[0][0], 1.0f, 1e-5f);
+    // Halfway is a quarter turn's half, 45 degrees, not 135
+    const float angle = 2.0f * acosf(fabsf(pose.rotation[3][0]));
+    EXPECT_NEAR(angle, (float)M_PI / 4.0f, 1e-4f);
+
+    // The phase wraps, and the end of the cycle is its start
+    animation_sample(clip, 1.25f, pose);
+    EXPECT_NEAR(pose.translation[0][0], 1.0f, 1e-5f);
+    animation_sample(clip, 0.0f, pose);
+    EXPECT_NEAR(pose.translation[0][0], 0.0f, 1e-5f);
+    EXPECT_NEAR(pose.rotation[3][0], 1.0f, 1e-5f);
+}
+
+TEST(AnimationTests, BlendingMixesPosesInPlace) {
+    Pose a = {};
+    Pose b = {};
+    for (uint32_t j = 0; j < 3; ++j) {
+        a.rotation[3][j] = 1.0f;
+        b.rotation[2][j] = sinf(0.5f);
+        b.rotation[3][j] = cosf(0.5f);
+        a.translation[1][j] = 1.0f;
+        b.translation[1][j] = 3.0f;
+    }
+    animation_blend(a, b, 0.25f, 3, a);
+    for (uint32_t j = 0; j < 3; ++j) {
+        EXPECT_NEAR(a.translation[1][j], 1.5f, 1e-5f);
+        const float length = sqrtf(a.rotation[2][j] * a.rotation[2][j] + a.rotation[3][j] * a.rotation[3][j]);
+        EXPECT_NEAR(length, 1.0f, 1e-5f);
+        EXPECT_GT(a.rotation[2][j], 0.0f);
+        EXPECT_LT(a.rotation[2][j], 0.5f * sinf(0.5f));
+    }
+}
+
+TEST(AnimationTests, PaletteCarriesChildrenWithTheirParents) {
+    const Skeleton skeleton = two_joints();
+    Pose pose = {};
+    pose.rotation[3][1] = 1.0f;
+    pose.translation[1][0] = 1.0f;
+    pose.translation[1][1] = 1.0f;
+    // The root turns a quarter about +Z, swinging the child from above it to its left
+    const simd::quatf turn = simd_quaternion((float)M_PI / 2.0f, Z_AXIS);
+    for (int c = 0; c < 4; ++c) {
+        pose.rotation[c][0] = turn.vector[c];
+    }
+
+    Affine palette[2];
+    animation_palette(skeleton, pose, palette);
+    const Vertex tip = { { 0.0f, 2.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+    const VertexSkin onChild = { { 1, 0, 0, 0 }, { 255, 0, 0, 0 } };
+    const Vertex moved = skin_vertex(tip, onChild, palette);
+    expect_near(moved.position, { -1.5f, 1.0f, 0.0f });
+    expect_near(moved.normal, { -1.0f, 0.0f, 0.0f });
+
+    // Half on each joint lands halfway between where each would carry it
+    const VertexSkin shared = { { 0, 1, 0, 0 }, { 128, 127, 0, 0 } };
+    const Vertex base = { { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } };
+    const simd::float3 onRoot = skin_vertex(base, { { 0, 0, 0, 0 }, { 255, 0, 0, 0 } }, palette).position;
+    const simd::float3 onTip = skin_vertex(base, onChild, palette).position;
+    expect_near(skin_vertex(base, shared, palette).position, (onRoot + onTip) * 0.5f, 1e-2f);
+}
+
+TEST(AnimationTests, JobsMatchSerialSampling) {
+    const AnimationSet set = create_creature_animations();
+    const uint32_t joints = set.skeleton.size();
+    const uint32_t count = 37;
+    std::vector<Animator> animators(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        animators[i].clips[1] = CREATURE_CLIP_WALK;
+        animators[i].blend = (float)i / count;
+        animators[i].phase = 0.37f * i - floorf(0.37f * i);
+    }
+    std::vector<Animator> serial = animators;
+
+    JobSystem jobs({ 3, 1 });
+    std::vector<Affine> palettes((size_t)count * joints);
+    animate(jobs, set, animators.data(), count, 0.1f, palettes.data());
+
+    Pose pose;
+    Pose walk;
+    Affine expected[ANIMATION_MAX_JOINTS];
+    for (uint32_t i = 0; i < count; ++i) {
+        animator_advance(serial[i], set, 0.1f);
+        EXPECT_FLOAT_EQ(animators[i].phase, serial[i].phase);
+        animation_sample(set.clips[CREATURE_CLIP_IDLE], serial[i].phase, pose);
+        animation_sample(set.clips[CREATURE_CLIP_WALK], serial[i].phase, walk);
+        animation_blend(pose, walk, serial[i].blend, joints, pose);
+        animation_palette(set.skeleton, pose, expected);
+        for (uint32_t j = 0; j < joints; ++j) {
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 4; ++c) {
+                    EXPECT_NEAR(palettes[(size_t)i * joints + j].rows[r][c], expected[j].rows[r][c], 1e-5f);
+                }
+            }
+        }
+    }
+}
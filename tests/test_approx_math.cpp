@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "approx_math.hpp"
+#include "noise.hpp"
+
+#include <cmath>
+
+TEST(ApproxMathTests, TrigStaysWithinItsBound) {
+    double worstSin = 0.0, worstCos = 0.0;
+    for (int i = -200000; i <= 200000; ++i) {
+        const float x = APPROX_TRIG_RANGE * (float)i / 200000.0f;
+        float s, c;
+        approx_sincos(x, s, c);
+        worstSin = std::max(worstSin, std::fabs(s - std::sin((double)x)));
+        worstCos = std::max(worstCos, std::fabs(c - std::cos((double)x)));
+        ASSERT_EQ(approx_sin(x), s);
+        ASSERT_EQ(approx_cos(x), c);
+    }
+    EXPECT_LE(worstSin, APPROX_TRIG_MAX_ERROR);
+    EXPECT_LE(worstCos, APPROX_TRIG_MAX_ERROR);
+}
+
+TEST(ApproxMathTests, QuadrantsKeepTheirSigns) {
+    const float quarter = 1.5707964f;
+    EXPECT_NEAR(approx_sin(quarter), 1.0f, APPROX_TRIG_MAX_ERROR);
+    EXPECT_NEAR(approx_cos(2.0f * quarter), -1.0f, APPROX_TRIG_MAX_ERROR);
+    EXPECT_NEAR(approx_sin(-quarter), -1.0f, APPROX_TRIG_MAX_ERROR);
+    EXPECT_NEAR(approx_cos(-3.0f * quarter), 0.0f, APPROX_TRIG_MAX_ERROR);
+    EXPECT_EQ(approx_sin(0.0f), 0.0f);
+    EXPECT_EQ(approx_cos(0.0f), 1.0f);
+}
+
+TEST(ApproxMathTests, PreciseSincosIsLibm) {
+    for (float x : { -3.0f, 0.1f, 2.5f, 1000.0f }) {
+        float s, c;
+        precise_sincos(x, s, c);
+        EXPECT_EQ(s, sinf(x));
+        EXPECT_EQ(c, cosf(x));
+    }
+}
+
+// The noise's cosine interpolant has its own polynomial, shared with the GPU
+TEST(ApproxMathTests, CosineInterpolantFollowsTheCosine) {
+    double worst = 0.0;
+    for (int i = 0; i <= 100000; ++i) {
+        const float t = (float)i / 100000.0f;
+        const double exact = (1.0 - std::cos(M_PI * (double)t)) * 0.5;
+        worst = std::max(worst, std::fabs(cosine_interpolate(0.0f, 1.0f, t) - exact));
+    }
+    EXPECT_LE(worst, 2e-7);
+    EXPECT_NEAR(cosine_interpolate(2.0f, 4.0f, 0.0f), 2.0f, 1e-6f);
+    EXPECT_NEAR(cosine_interpolate(2.0f, 4.0f, 1.0f), 4.0f, 1e-6f);
+}
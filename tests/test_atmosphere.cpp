@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "atmosphere.hpp"
+
+#include <cmath>
+
+namespace {
+    const simd::float3 SUN = { 0.5819f, 0.7274f, 0.3637f };
+}
+
+TEST(AtmosphereTests, TransmittanceCoordinatesRoundTrip) {
+    const AtmosphereParams params;
+    for (float altitude : { 0.0f, 0.2f, 5.0f, 40.0f, 99.0f }) {
+        const float radius = params.bottomRadius + altitude;
+        // Cosine of the zenith angle of the ray grazing the ground
+        const float horizonMu = -sqrtf(1.0f - (params.bottomRadius / radius) * (params.bottomRadius / radius));
+        for (float mu : { horizonMu + 1e-3f, 0.5f * horizonMu, 0.0f, 0.05f, 0.5f, 1.0f }) {
+            const simd::float2 uv = atmosphere_transmittance_uv(params, radius, mu);
+            EXPECT_GE(uv.x, -1e-4f);
+            EXPECT_LE(uv.x, 1.0f + 1e-4f);
+            EXPECT_GE(uv.y, 0.0f);
+            EXPECT_LE(uv.y, 1.0f);
+
+            float backRadius = 0.0f;
+            float backMu = 0.0f;
+            atmosphere_transmittance_radius_mu(params, uv, backRadius, backMu);
+            EXPECT_NEAR(backRadius, radius, 0.05f) << altitude << " " << mu;
+            EXPECT_NEAR(backMu, mu, 2e-3f) << altitude << " " << mu;
+        }
+    }
+}
+
+TEST(AtmosphereTests, TransmittanceReddensTowardsTheHorizon) {
+    const AtmosphereParams params;
+    const float ground = params.bottomRadius + params.viewerAltitude;
+    const simd::float3 zenith = atmosphere_transmittance(params, ground, 1.0f);
+    const simd::float3 horizon = atmosphere_transmittance(params, ground, 0.02f);
+
+    // Blue scatters most, and the long path near the horizon removes more of everything
+    EXPECT_GT(zenith.x, zenith.z);
+    EXPECT_GT(horizon.x, horizon.z);
+    EXPECT_LT(horizon.x, zenith.x);
+    EXPECT_LT(horizon.z, zenith.z);
+    EXPECT_GT(zenith.z, 0.5f);
+    EXPECT_LT(zenith.x, 1.0f);
+
+    // Nothing is in the way at the top of the atmosphere
+    const simd::float3 space = atmosphere_transmittance(params, params.topRadius, 1.0f);
+    EXPECT_FLOAT_EQ(space.x, 1.0f);
+}
+
+TEST(AtmosphereTests, TransmittanceConverges) {
+    const AtmosphereParams params;
+    const float ground = params.bottomRadius;
+    const simd::float3 coarse = atmosphere_transmittance(params, ground, 0.3f, 40);
+    const simd::float3 fine = atmosphere_transmittance(params, ground, 0.3f, 400);
+    // Steps far longer than the Mie scale height still land within a percent
+    EXPECT_NEAR(coarse.x, fine.x, 0.01f * fine.x);
+    EXPECT_NEAR(coarse.z, fine.z, 0.01f * fine.z);
+}
+
+TEST(AtmosphereTests, SkyViewCoordinatesRoundTrip) {
+    for (float v : { 0.02f, 0.25f, 0.49f, 0.51f, 0.75f, 0.98f }) {
+        for (float u : { 0.0f, 0.1f, 0.5f, 0.9f, 1.0f }) {
+            const simd::float3 direction = atmosphere_sky_view_direction({ u, v }, SUN);
+            EXPECT_NEAR(simd::length(direction), 1.0f, 1e-5f);
+            const simd::float2 uv = atmosphere_sky_view_uv(direction, SUN);
+            EXPECT_NEAR(uv.x, u, 1e-3f) << u << " " << v;
+            EXPECT_NEAR(uv.y, v, 1e-3f) << u << " " << v;
+        }
+    }
+}
+
+TEST(AtmosphereTests, SkyViewPutsTheSunAndHorizonWhereExpected) {
+    // Towards the sun's azimuth is the left edge, the opposite azimuth the right edge
+    const simd::float3 towards = simd::normalize(simd::float3{ SUN.x, 0.0f, SUN.z });
+    EXPECT_NEAR(atmosphere_sky_view_uv(towards, SUN).x, 0.0f, 1e-3f);
+    EXPECT_NEAR(atmosphere_sky_view_uv(-towards, SUN).x, 1.0f, 1e-3f);
+
+    // The horizon is the middle row, the zenith and nadir the edges
+    EXPECT_NEAR(atmosphere_sky_view_uv(towards, SUN).y, 0.5f, 1e-6f);
+    EXPECT_NEAR(atmosphere_sky_view_uv({ 0.0f, 1.0f, 0.0f }, SUN).y, 0.0f, 1e-6f);
+    EXPECT_NEAR(atmosphere_sky_view_uv({ 0.0f, -1.0f, 0.0f }, SUN).y, 1.0f, 1e-6f);
+}
+
+TEST(AtmosphereTests, OnlyAMovedSunNeedsANewSkyView) {
+    EXPECT_FALSE(atmosphere_sun_moved(SUN, SUN));
+    const float angle = 0.01f;
+    const simd::float3 moved = { SUN.x * cosf(angle) - SUN.z * sinf(angle), SUN.y,
+                                 SUN.x * sinf(angle) + SUN.z * cosf(angle) };
+    EXPECT_TRUE(atmosphere_sun_moved(SUN, moved));
+}
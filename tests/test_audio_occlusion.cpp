@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "audio_occlusion.hpp"
+
+namespace {
+    // A flat 64 x 64 unit field with a ridge four units high along x = 30..34
+    HeightField make_field() {
+        HeightField field;
+        field.width = 65;
+        field.depth = 65;
+        field.heights.assign((size_t)field.width * field.depth, 0.0f);
+        for (int z = 0; z < field.depth; ++z) {
+            for (int x = 30; x <= 34; ++x) {
+                field.heights[(size_t)z * field.width + x] = x == 32 ? 4.0f : 2.0f;
+            }
+        }
+        return field;
+    }
+}
+
+TEST(AudioOcclusionTests, RidgesOccludeAndOpenGroundDoesNot) {
+    JobSystem jobs({ 1, 1 });
+    const HeightField field = make_field();
+    AudioOcclusion occlusion;
+    occlusion.positions = { { 10.0f, 0.0f, 20.0f }, { 50.0f, 0.0f, 20.0f }, { 50.0f, 20.0f, 20.0f } };
+    const AudioOcclusionSettings settings;
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, { 20.0f, 1.7f, 20.0f }, settings), 3u);
+
+    // The first is on the listener's side, the second behind the ridge, the third high above it
+    EXPECT_EQ(occlusion.occlusion[0], 0.0f);
+    EXPECT_EQ(occlusion.occlusion[1], 1.0f);
+    EXPECT_EQ(occlusion.occlusion[2], 0.0f);
+
+    // Partly over the ridge is partly occluded
+    occlusion.positions[1].y = 4.0f;
+    audio_occlusion_update(occlusion, field, jobs, { 20.0f, 1.7f, 20.0f }, settings);
+    EXPECT_GT(occlusion.occlusion[1], 0.0f);
+    EXPECT_LT(occlusion.occlusion[1], 1.0f);
+}
+
+TEST(AudioOcclusionTests, StationaryEmittersKeepTheirResults) {
+    JobSystem jobs({ 1, 1 });
+    HeightField field = make_field();
+    AudioOcclusion occlusion;
+    for (int i = 0; i < 10; ++i) {
+        occlusion.positions.push_back({ 40.0f + (float)i, 0.0f, 5.0f + 5.0f * (float)i });
+    }
+    AudioOcclusionSettings settings;
+    const simd::float3 listener = { 10.0f, 1.7f, 30.0f };
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, listener, settings), 10u);
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, listener, settings), 0u);
+
+    // One emitter moves, the listener shifts within its tolerance, then a new emitter appears
+    occlusion.positions[3].x += 1.0f;
+    const simd::float3 nudged = listener + simd::float3{ 0.2f, 0.0f, 0.0f };
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, nudged, settings), 1u);
+    occlusion.positions.push_back({ 60.0f, 0.0f, 60.0f });
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, listener, settings), 1u);
+    EXPECT_EQ(occlusion.lastTested, 1u);
+
+    // Moving the listener or editing the terrain tests everything again, and the edit shows
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, listener + simd::float3{ 2.0f, 0.0f, 0.0f }, settings),
+              11u);
+    for (float& h : field.heights) {
+        h = 0.0f;
+    }
+    audio_occlusion_invalidate(occlusion);
+    EXPECT_EQ(audio_occlusion_update(occlusion, field, jobs, listener, settings), 11u);
+    for (float o : occlusion.occlusion) {
+        EXPECT_EQ(o, 0.0f);
+    }
+}
+
+TEST(AudioOcclusionTests, ResultsDoNotDependOnTheThreadCount) {
+    const HeightField field = create_height_field(-64.0f, -64.0f, 129, 129, 1.0f);
+    JobSystem serial({ 0, 1 });
+    JobSystem parallel({ 3, 1 });
+    AudioOcclusion a, b;
+    for (int i = 0; i < 500; ++i) {
+        const simd::float3 p = { -60.0f + (float)(i % 25) * 5.0f, 0.0f, -60.0f + (float)(i / 25) * 6.0f };
+        a.positions.push_back({ p.x, height_field_height(field, p.x, p.z), p.z });
+    }
+    b.positions = a.positions;
+    const simd::float3 listener = { 3.0f, height_field_height(field, 3.0f, -7.0f) + 1.7f, -7.0f };
+    audio_occlusion_update(a, field, serial, listener, AudioOcclusionSettings{});
+    audio_occlusion_update(b, field, parallel, listener, AudioOcclusionSettings{});
+    EXPECT_EQ(a.occlusion, b.occlusion);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "biome.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+    const float CHUNK_SIZE = 32.0f;
+
+    BiomeMap uniform_map(uint32_t cells, Biome biome) {
+        BiomeMap map;
+        map.cellsPerEdge = cells;
+        map.ids.assign((size_t)(cells + 1) * (cells + 1), (uint8_t)biome);
+        return map;
+    }
+}
+
+TEST(BiomeTests, ClassifyFollowsTheClimateTable) {
+    EXPECT_EQ(biome_classify({ 0.1f, 0.2f }), Biome::Tundra);
+    EXPECT_EQ(biome_classify({ 0.1f, 0.8f }), Biome::Taiga);
+    EXPECT_EQ(biome_classify({ 0.5f, 0.2f }), Biome::Grassland);
+    EXPECT_EQ(biome_classify({ 0.5f, 0.8f }), Biome::Forest);
+    EXPECT_EQ(biome_classify({ 0.9f, 0.1f }), Biome::Desert);
+    EXPECT_EQ(biome_classify({ 0.9f, 0.5f }), Biome::Savanna);
+    EXPECT_EQ(biome_classify({ 0.9f, 0.9f }), Biome::Jungle);
+}
+
+TEST(BiomeTests, TemperatureFallsWithHeight) {
+    BiomeSettings settings;
+    const BiomeClimate low = biome_climate(settings, 10.0f, -20.0f, 0.0f);
+    const BiomeClimate high = biome_climate(settings, 10.0f, -20.0f, 10.0f);
+    EXPECT_NEAR(low.temperature - high.temperature, std::min(low.temperature, 10.0f * settings.lapseRate), 1e-6f);
+    EXPECT_EQ(low.moisture, high.moisture);
+}
+
+TEST(BiomeTests, ZeroCellsTurnBiomesOff) {
+    BiomeSettings settings;
+    EXPECT_TRUE(generate_biome_map(settings, { 0, 0 }, CHUNK_SIZE).empty());
+
+    settings.cellsPerEdge = 1000;
+    const BiomeMap map = generate_biome_map(settings, { 0, 0 }, CHUNK_SIZE);
+    EXPECT_EQ(map.cellsPerEdge, BIOME_MAX_CELLS);
+    EXPECT_EQ(map.ids.size(), (size_t)(BIOME_MAX_CELLS + 1) * (BIOME_MAX_CELLS + 1));
+    EXPECT_LE(map.ids.size(), 4096u);
+}
+
+TEST(BiomeTests, NeighbouringChunksAgreeOnTheirSharedEdge) {
+    BiomeSettings settings;
+    settings.cellsPerEdge = 8;
+    const BiomeMap left = generate_biome_map(settings, { 3, -2 }, CHUNK_SIZE);
+    const BiomeMap right = generate_biome_map(settings, { 4, -2 }, CHUNK_SIZE);
+    const BiomeMap again = generate_biome_map(settings, { 3, -2 }, CHUNK_SIZE);
+    EXPECT_EQ(left.ids, again.ids);
+    EXPECT_EQ(left.bytes(), 81u);
+    for (uint32_t z = 0; z <= 8; ++z) {
+        EXPECT_EQ(left.at(8, z), right.at(0, z));
+    }
+}
+
+TEST(BiomeTests, TheWorldHoldsSeveralBiomes) {
+    BiomeSettings settings;
+    settings.cellsPerEdge = 2;
+    std::set<int> seen;
+    for (int z = -40; z < 40; z += 4) {
+        for (int x = -40; x < 40; x += 4) {
+            const BiomeMap map = generate_biome_map(settings, { x, z }, CHUNK_SIZE);
+            for (uint8_t id : map.ids) {
+                ASSERT_LT(id, BIOME_COUNT);
+                seen.insert(id);
+            }
+        }
+    }
+    EXPECT_GE(seen.size(), 4u);
+}
+
+TEST(BiomeTests, ProfilesBlendBetweenCorners) {
+    BiomeMap map = uniform_map(2, Biome::Forest);
+    map.ids[1] = (uint8_t)Biome::Desert; // Corner (1, 0)
+    const BiomeProfile& forest = biome_profiles()[(int)Biome::Forest];
+    const BiomeProfile& desert = biome_profiles()[(int)Biome::Desert];
+
+    EXPECT_FLOAT_EQ(biome_profile_at(map, 0.0f, 0.0f).treeDensity, forest.treeDensity);
+    EXPECT_FLOAT_EQ(biome_profile_at(map, 0.5f, 0.0f).treeDensity, desert.treeDensity);
+    EXPECT_FLOAT_EQ(biome_profile_at(map, 0.25f, 0.0f).treeDensity, 0.5f * (forest.treeDensity + desert.treeDensity));
+    EXPECT_FLOAT_EQ(biome_profile_at(map, 0.5f, 0.25f).rockDensity, 0.5f * (forest.rockDensity + desert.rockDensity));
+    EXPECT_FLOAT_EQ(biome_profile_at(map, 1.0f, 1.0f).ground.x, forest.ground.x);
+}
+
+TEST(BiomeTests, GrasslandShadesLikeTheHeightBands) {
+    const BiomeProfile& grass = biome_profiles()[(int)Biome::Grassland];
+    simd::float3 low = biome_band_albedo(grass, -2.0f);
+    simd::float3 slope = biome_band_albedo(grass, 4.0f);
+    simd::float3 peak = biome_band_albedo(grass, 9.0f);
+    EXPECT_FLOAT_EQ(low.y, 0.6f);
+    EXPECT_FLOAT_EQ(slope.x, 0.5f);
+    EXPECT_FLOAT_EQ(peak.z, 1.0f);
+
+    // Deserts stay sand and rock however high they reach
+    simd::float3 dune = biome_band_albedo(biome_profiles()[(int)Biome::Desert], 30.0f);
+    EXPECT_FLOAT_EQ(dune.x, 0.7f);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "build_trace.hpp"
+
+namespace {
+    // Two units in the shape clang writes: complete events in microseconds, then "Total" summaries
+    const char* TRACE_A = R"({"traceEvents":[
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":900000,"name":"ExecuteCompiler"},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":600000,"name":"Frontend"},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":400000,"name":"Source","args":{"detail":"Metal/Metal.hpp"}},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":100000,"name":"Source","args":{"detail":"simd/simd.h"}},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":50000,"name":"InstantiateClass","args":{"detail":"std::vector<int>"}},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":300000,"name":"Backend"},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":400000,"name":"Total Source","args":{"count":2}},
+        {"pid":1,"tid":1,"ph":"M","ts":0,"name":"process_name","args":{"name":"clang"}}
+    ]})";
+    const char* TRACE_B = R"({"traceEvents":[
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":2000000,"name":"ExecuteCompiler"},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":500000,"name":"Source","args":{"detail":"Metal/Metal.hpp"}},
+        {"pid":1,"tid":1,"ph":"X","ts":0,"dur":20000,"name":"InstantiateClass","args":{"detail":"std::vector<int>"}}
+    ]})";
+
+    void add(const char* text, const char* name, BuildTraceReport& report) {
+        JsonValue root;
+        std::string error;
+        ASSERT_TRUE(parse_json(text, root, error)) << error;
+        ASSERT_TRUE(add_build_trace(root, name, report, error)) << error;
+    }
+}
+
+TEST(BuildTraceTests, SumsHeadersAndTemplatesOverUnits) {
+    BuildTraceReport report;
+    add(TRACE_A, "a.cpp", report);
+    add(TRACE_B, "b.mm", report);
+    finish_build_trace(report);
+
+    ASSERT_EQ(report.units.size(), 2u);
+    EXPECT_EQ(report.units[0].name, "b.mm");
+    EXPECT_DOUBLE_EQ(report.units[1].totalMs, 900.0);
+    EXPECT_DOUBLE_EQ(report.units[1].frontendMs, 600.0);
+    EXPECT_DOUBLE_EQ(report.units[1].backendMs, 300.0);
+    EXPECT_DOUBLE_EQ(report.totalMs, 2900.0);
+
+    // The "Total Source" summary is not counted as a header
+    ASSERT_EQ(report.headers.size(), 2u);
+    EXPECT_EQ(report.headers[0].name, "Metal/Metal.hpp");
+    EXPECT_DOUBLE_EQ(report.headers[0].ms, 900.0);
+    EXPECT_EQ(report.headers[0].count, 2u);
+    ASSERT_EQ(report.templates.size(), 1u);
+    EXPECT_DOUBLE_EQ(report.templates[0].ms, 70.0);
+    EXPECT_EQ(report.templates[0].count, 2u);
+}
+
+TEST(BuildTraceTests, RejectsDocumentsThatAreNotTraces) {
+    JsonValue root;
+    std::string error;
+    ASSERT_TRUE(parse_json(R"({"frames": 600})", root, error));
+    BuildTraceReport report;
+    EXPECT_FALSE(add_build_trace(root, "report.json", report, error));
+    EXPECT_TRUE(report.units.empty());
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "bvh.hpp"
+#include "camera.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+    BoundingBox box_at(float x, float y, float z) {
+        return { { x - 0.5f, y - 0.5f, z - 0.5f }, { x + 0.5f, y + 0.5f, z + 0.5f } };
+    }
+
+    // Checks parent links, heights, containment and balance of every internal node
+    void expect_valid(const Bvh& bvh, uint32_t node) {
+        const BvhNode& n = bvh.nodes[node];
+        if (n.left == BVH_NULL) {
+            EXPECT_EQ(n.height, 0);
+            return;
+        }
+        const BvhNode& l = bvh.nodes[n.left];
+        const BvhNode& r = bvh.nodes[n.right];
+        EXPECT_EQ(l.parent, node);
+        EXPECT_EQ(r.parent, node);
+        EXPECT_EQ(n.height, 1 + std::max(l.height, r.height));
+        EXPECT_LE(std::abs(l.height - r.height), 1);
+        for (const BvhNode* child : { &l, &r }) {
+            EXPECT_LE(n.box.min.x, child->box.min.x);
+            EXPECT_LE(n.box.min.z, child->box.min.z);
+            EXPECT_GE(n.box.max.x, child->box.max.x);
+            EXPECT_GE(n.box.max.z, child->box.max.z);
+        }
+        expect_valid(bvh, n.left);
+        expect_valid(bvh, n.right);
+    }
+
+    std::set<uint32_t> to_set(const std::vector<uint32_t>& items) {
+        return std::set<uint32_t>(items.begin(), items.end());
+    }
+}
+
+TEST(BvhTests, QueriesMatchBruteForceThroughInsertsAndRemovals) {
+    Bvh bvh;
+    std::vector<BoundingBox> boxes;
+    std::vector<uint32_t> leaves;
+    for (uint32_t i = 0; i < 500; ++i) {
+        boxes.push_back(box_at((float)(i % 25) * 3.0f, 0.0f, (float)(i / 25) * 3.0f));
+        leaves.push_back(bvh_insert(bvh, boxes.back(), i));
+    }
+    // Drop every third item
+    std::vector<bool> alive(boxes.size(), true);
+    for (uint32_t i = 0; i < boxes.size(); i += 3) {
+        bvh_remove(bvh, leaves[i]);
+        alive[i] = false;
+    }
+    EXPECT_EQ(bvh.leafCount, 500u - 167u);
+    expect_valid(bvh, bvh.root);
+
+    // Touching leaves are enlarged by the margin, so the query box is kept clear of neighbours
+    BoundingBox query = { { 10.0f, -1.0f, 10.0f }, { 25.0f, 1.0f, 31.0f } };
+    std::set<uint32_t> expected;
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        const BoundingBox& b = boxes[i];
+        if (alive[i] && b.min.x <= query.max.x && query.min.x <= b.max.x && b.min.z <= query.max.z &&
+            query.min.z <= b.max.z) {
+            expected.insert(i);
+        }
+    }
+    std::vector<uint32_t> items;
+    bvh_query_box(bvh, query, items);
+    EXPECT_EQ(to_set(items), expected);
+    EXPECT_EQ(items.size(), expected.size());
+
+    // The frustum query agrees with testing every live box
+    Camera cam = make_camera(1280, 720);
+    cam.position = { 30.0f, 5.0f, 90.0f }; // Beyond the grid, looking back down -Z over part of it
+    update_camera_view(cam);
+    Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+    bvh_query_frustum(bvh, frustum, items);
+    std::set<uint32_t> visible = to_set(items);
+    EXPECT_FALSE(visible.empty());
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        if (alive[i] && frustum_intersects(frustum, boxes[i])) {
+            EXPECT_TRUE(visible.count(i)) << i;
+        }
+        if (!alive[i]) {
+            EXPECT_FALSE(visible.count(i)) << i;
+        }
+    }
+}
+
+TEST(BvhTests, SmallMovesStayInsideTheEnlargedLeaf) {
+    Bvh bvh;
+    uint32_t leaf = bvh_insert(bvh, box_at(0.0f, 0.0f, 0.0f), 7);
+    bvh_insert(bvh, box_at(10.0f, 0.0f, 0.0f), 8);
+
+    EXPECT_FALSE(bvh_update(bvh, leaf, box_at(0.1f, 0.0f, 0.0f)));
+    EXPECT_TRUE(bvh_update(bvh, leaf, box_at(5.0f, 0.0f, 0.0f)));
+
+    std::vector<uint32_t> items;
+    bvh_query_box(bvh, box_at(5.0f, 0.0f, 0.0f), items);
+    EXPECT_EQ(items, std::vector<uint32_t>{ 7 });
+}
+
+TEST(BvhTests, RefitAfterBatchedMovesUpdatesAncestors) {
+    Bvh bvh;
+    std::vector<uint32_t> leaves;
+    for (uint32_t i = 0; i < 64; ++i) {
+        leaves.push_back(bvh_insert(bvh, box_at((float)i * 2.0f, 0.0f, 0.0f), i));
+    }
+    // Lift every even item far above the row
+    for (uint32_t i = 0; i < 64; i += 2) {
+        bvh_move(bvh, leaves[i], box_at((float)i * 2.0f, 50.0f, 0.0f));
+    }
+    EXPECT_GT(bvh_refit(bvh), 0u);
+    expect_valid(bvh, bvh.root);
+    EXPECT_GE(bvh.nodes[bvh.root].box.max.y, 50.5f);
+
+    std::vector<uint32_t> items;
+    bvh_query_box(bvh, { { -1.0f, 49.0f, -1.0f }, { 200.0f, 51.0f, 1.0f } }, items);
+    EXPECT_EQ(items.size(), 32u);
+    for (uint32_t item : items) {
+        EXPECT_EQ(item % 2, 0u);
+    }
+    // Nothing queued, nothing to do
+    EXPECT_EQ(bvh_refit(bvh), 0u);
+}
+
+TEST(BvhTests, RaycastReturnsTheNearestHit) {
+    Bvh bvh;
+    std::vector<BoundingBox> boxes;
+    for (uint32_t i = 0; i < 100; ++i) {
+        boxes.push_back(box_at((float)(i % 10) * 4.0f, 0.0f, (float)(i / 10) * 4.0f));
+        bvh_insert(bvh, boxes.back(), i);
+    }
+    const simd::float3 origin = { 12.0f, 0.0f, -10.0f };
+    const simd::float3 direction = { 0.0f, 0.0f, 1.0f };
+    const simd::float3 inverse = 1.0f / direction;
+    auto hit = [&](uint32_t item, float limit) { return ray_box_distance(boxes[item], origin, inverse, limit); };
+
+    float distance = 0.0f;
+    EXPECT_EQ(bvh_raycast(bvh, origin, direction, 100.0f, hit, distance), 3u);
+    EXPECT_NEAR(distance, 9.5f, 1e-4f);
+
+    // Too short to reach the first box
+    EXPECT_EQ(bvh_raycast(bvh, origin, direction, 9.0f, hit, distance), BVH_NULL);
+    // Between two columns
+    const simd::float3 gap = { 14.0f, 0.0f, -10.0f };
+    auto gapHit = [&](uint32_t item, float limit) { return ray_box_distance(boxes[item], gap, inverse, limit); };
+    EXPECT_EQ(bvh_raycast(bvh, gap, direction, 100.0f, gapHit, distance), BVH_NULL);
+}
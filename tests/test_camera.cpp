@@ -1,6 +1,11 @@
 #include "landscape.hpp"
 #include <gtest/gtest.h>
 #include "camera.hpp"
+#include "job_system.hpp"
+#include "heap_allocations.hpp"
+
+#include <cmath>
+#include <cstring>
 
 // Helper to compare simd::float4x4 matrices
 void expect_matrix_eq(const simd::float4x4& a, const simd::float4x4& b) {
@@ -20,6 +25,27 @@ TEST(MatrixUtils, Perspective) {
     EXPECT_EQ(proj.columns[2][3], -1.0f);
 }
 
+TEST(MatrixUtils, ReverseZInfinitePerspective) {
+    simd::float4x4 proj = matrix_perspective_reverse_z_infinite(M_PI / 2.0f, 2.0f, 0.1f);
+    EXPECT_NEAR(proj.columns[0][0], 0.5f, 1e-5);
+    EXPECT_NEAR(proj.columns[1][1], 1.0f, 1e-5);
+
+    // The near plane lands on 1 and depth falls towards 0 without ever reaching the far side
+    float previous = 2.0f;
+    for (float z : { 0.1f, 1.0f, 100.0f, 1e4f, 1e7f }) {
+        simd::float4 clip = proj * simd::float4{ 0.0f, 0.0f, -z, 1.0f };
+        float depth = clip.z / clip.w;
+        EXPECT_GT(depth, 0.0f);
+        EXPECT_LT(depth, previous);
+        previous = depth;
+    }
+    simd::float4 nearClip = proj * simd::float4{ 0.0f, 0.0f, -0.1f, 1.0f };
+    EXPECT_NEAR(nearClip.z / nearClip.w, 1.0f, 1e-6);
+    // Points at infinity (w = 0) map to depth 0
+    simd::float4 infinity = proj * simd::float4{ 0.0f, 0.0f, -1.0f, 0.0f };
+    EXPECT_EQ(infinity.z, 0.0f);
+}
+
 TEST(MatrixUtils, LookAt) {
     simd::float3 eye = {0, 0, 5};
     simd::float3 center = {0, 0, 0};
@@ -52,6 +78,31 @@ TEST(CameraTest, MakeCamera) {
     EXPECT_EQ(cam.pitch, 0.0f);
 }
 
+TEST(CameraTest, SetViewportKeepsVerticalFov) {
+    Camera cam = make_camera(800, 600);
+    float yScale = cam.projectionMatrix.columns[1][1];
+
+    set_camera_viewport(cam, 1600, 600);
+    EXPECT_NEAR(cam.projectionMatrix.columns[1][1], yScale, 1e-6);
+    EXPECT_NEAR(cam.projectionMatrix.columns[0][0], yScale * 600.0f / 1600.0f, 1e-6);
+
+    // A minimized window reports a zero size; the projection must stay usable
+    set_camera_viewport(cam, 0, 0);
+    EXPECT_NEAR(cam.projectionMatrix.columns[0][0], yScale * 600.0f / 1600.0f, 1e-6);
+}
+
+TEST(CameraTest, ReverseZSurvivesViewportChanges) {
+    Camera cam = make_camera(800, 600, true);
+    EXPECT_EQ(camera_clear_depth(cam), 0.0f);
+    EXPECT_EQ(camera_clear_depth(make_camera(800, 600)), 1.0f);
+    EXPECT_EQ(cam.projectionMatrix.columns[2][2], 0.0f);
+    EXPECT_NEAR(cam.projectionMatrix.columns[3][2], cam.nearZ, 1e-7);
+
+    set_camera_viewport(cam, 1600, 600);
+    EXPECT_EQ(cam.projectionMatrix.columns[2][2], 0.0f);
+    EXPECT_NEAR(cam.projectionMatrix.columns[0][0], cam.projectionMatrix.columns[1][1] * 600.0f / 1600.0f, 1e-6);
+}
+
 TEST(CameraTest, UpdateCameraPosition) {
     Camera cam = make_camera(800, 600);
     bool keys[1024] = {};
@@ -63,10 +114,10 @@ TEST(CameraTest, UpdateCameraPosition) {
     EXPECT_NEAR(cam.position.z, 3.0f - cam.moveSpeed, 1e-5);
 }
 
-// TODO: Add tests for camera bounding
-
 TEST(CameraTest, UpdateCameraBounds) {
     Camera cam = make_camera(800, 600);
+    cam.minBounds = { -20.0f, 0.0f, -20.0f };
+    cam.maxBounds = { 20.0f, 20.0f, 20.0f };
     cam.position = {19.9f, 0.0f, 0.0f};
     bool keys[1024] = {};
     keys['D'] = true; // Move right
@@ -78,6 +129,30 @@ TEST(CameraTest, UpdateCameraBounds) {
     EXPECT_EQ(cam.position.x, 20.0f);
 }
 
+TEST(CameraTest, WorldSettingsReplaceTheDefaultLimits) {
+    Camera cam = make_camera(800, 600);
+    bool keys[1024] = {};
+    keys['D'] = true;
+    update_camera(cam, 10.0f, keys, 0.0, 0.0);
+    EXPECT_NEAR(cam.position.x, 80.0f, 1e-4f); // No clamp until the world sets one
+
+    const simd::float4x4 before = cam.projectionMatrix;
+    set_camera_world(cam, 500.0f, -30.0f, 250.0f, 16.0f);
+    EXPECT_EQ(cam.farZ, 500.0f);
+    EXPECT_EQ(cam.projectionMatrix.columns[0][0], before.columns[0][0]); // Same aspect and field of view
+    EXPECT_NE(cam.projectionMatrix.columns[2][2], before.columns[2][2]);
+
+    keys['D'] = false;
+    keys[' '] = true;
+    update_camera(cam, 100.0f, keys, 0.0, 0.0);
+    EXPECT_EQ(cam.position.y, 250.0f);
+    EXPECT_NEAR(cam.position.x, 80.0f, 1e-4f);
+    keys[' '] = false;
+    keys['A'] = true;
+    update_camera(cam, 100.0f, keys, 0.0, 0.0);
+    EXPECT_NEAR(cam.position.x, 80.0f - 1600.0f, 1e-2f); // Moved at the world's speed, past any edge
+}
+
 TEST(CameraTest, PitchClamp) {
     Camera cam = make_camera(800, 600);
     bool keys[1024] = {};
@@ -91,6 +166,51 @@ TEST(CameraTest, PitchClamp) {
     EXPECT_EQ(cam.pitch, -1.5708f);
 }
 
+TEST(CameraTest, BasisFollowsAnglesHoweverTheyChange) {
+    Camera cam = make_camera(800, 600);
+    bool keys[1024] = {};
+    update_camera(cam, 0.0f, keys, 40.0f, 10.0f);
+    EXPECT_EQ(cam.basisYaw, cam.yaw);
+    EXPECT_EQ(cam.forward.x, camera_forward(cam.yaw, cam.pitch).x);
+
+    // Angles set directly, as camera paths and snapshots do, are picked up by the next update
+    cam.yaw = 1.0f;
+    cam.pitch = -0.25f;
+    update_camera_view(cam);
+    const simd::float3 forward = camera_forward(1.0f, -0.25f);
+    EXPECT_EQ(cam.forward.x, forward.x);
+    EXPECT_EQ(cam.forward.z, forward.z);
+    EXPECT_NEAR(simd::dot(cam.right, cam.forward), 0.0f, 1e-6f);
+    EXPECT_EQ(cam.right.y, 0.0f);
+}
+
+// Cameras keep all their state, so updating many on worker threads matches updating them in turn
+TEST(CameraTest, CamerasUpdateIndependentlyInParallel) {
+    constexpr uint32_t CAMERAS = 64;
+    auto drive = [](Camera& cam, uint32_t index) {
+        bool keys[1024] = {};
+        keys[index % 2 ? (int)'W' : (int)'A'] = true;
+        for (int step = 0; step < 100; ++step) {
+            update_camera(cam, 1.0f / 60.0f, keys, (float)index - 30.0f, step % 7 == 0 ? 3.0f : 0.0f);
+        }
+    };
+    std::vector<Camera> serial(CAMERAS, make_camera(800, 600));
+    std::vector<Camera> parallel = serial;
+    for (uint32_t i = 0; i < CAMERAS; ++i) {
+        drive(serial[i], i);
+    }
+    JobSystem jobs({ 3, 1 });
+    jobs.parallel_for(CAMERAS, 4, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            drive(parallel[i], i);
+        }
+    });
+    for (uint32_t i = 0; i < CAMERAS; ++i) {
+        EXPECT_EQ(memcmp(&parallel[i].viewMatrix, &serial[i].viewMatrix, sizeof(simd::float4x4)), 0) << i;
+        EXPECT_EQ(parallel[i].position.x, serial[i].position.x) << i;
+    }
+}
+
 TEST(MatrixUtils, Scale) {
     simd::float4x4 scale_matrix = matrix_scale(2.0f, 3.0f, 4.0f);
     simd::float4x4 expected = simd::float4x4(
@@ -102,6 +222,48 @@ TEST(MatrixUtils, Scale) {
     expect_matrix_eq(scale_matrix, expected);
 }
 
+TEST(MatrixUtils, Orthographic) {
+    simd::float4x4 proj = matrix_orthographic_right_hand(-2.0f, 2.0f, -1.0f, 3.0f, 1.0f, 11.0f);
+    simd::float4 nearCorner = proj * simd::float4{ -2.0f, -1.0f, -1.0f, 1.0f };
+    simd::float4 farCorner = proj * simd::float4{ 2.0f, 3.0f, -11.0f, 1.0f };
+    EXPECT_NEAR(nearCorner.x, -1.0f, 1e-5);
+    EXPECT_NEAR(nearCorner.y, -1.0f, 1e-5);
+    EXPECT_NEAR(nearCorner.z, 0.0f, 1e-5);
+    EXPECT_NEAR(farCorner.x, 1.0f, 1e-5);
+    EXPECT_NEAR(farCorner.y, 1.0f, 1e-5);
+    EXPECT_NEAR(farCorner.z, 1.0f, 1e-5);
+    EXPECT_EQ(farCorner.w, 1.0f);
+}
+
+TEST(MatrixUtils, NormalMatrixKeepsNormalsPerpendicular) {
+    // A trunk-like non-uniform scale, rotated and moved: the translation must not reach the normals
+    simd::float4x4 model =
+        matrix_translation(3.0f, -2.0f, 5.0f) * matrix_rotation_y(0.6f) * matrix_scale(0.2f, 2.0f, 0.5f);
+    simd::float3x3 normalMatrix = matrix_normal(model);
+
+    // A surface spanned by two tangents, and its normal
+    simd::float3 t0 = simd::normalize(simd::float3{ 1.0f, 1.0f, 0.0f });
+    simd::float3 t1 = simd::normalize(simd::float3{ 0.0f, 1.0f, -1.0f });
+    simd::float3 n = simd::cross(t0, t1);
+
+    simd::float4 w0 = model * simd::float4{ t0.x, t0.y, t0.z, 0.0f };
+    simd::float4 w1 = model * simd::float4{ t1.x, t1.y, t1.z, 0.0f };
+    simd::float3 nw = normalMatrix * n;
+    EXPECT_NEAR(nw.x * w0.x + nw.y * w0.y + nw.z * w0.z, 0.0f, 1e-5f);
+    EXPECT_NEAR(nw.x * w1.x + nw.y * w1.y + nw.z * w1.z, 0.0f, 1e-5f);
+    // Transforming the normal like a direction tilts it off the surface
+    simd::float4 tilted = model * simd::float4{ n.x, n.y, n.z, 0.0f };
+    EXPECT_GT(fabsf(tilted.x * w0.x + tilted.y * w0.y + tilted.z * w0.z), 0.1f);
+
+    // Rotations pass normals through unchanged
+    simd::float3x3 rotation = matrix_normal(matrix_rotation_y(1.1f));
+    simd::float4 rotated = matrix_rotation_y(1.1f) * simd::float4{ n.x, n.y, n.z, 0.0f };
+    simd::float3 r = rotation * n;
+    EXPECT_NEAR(r.x, rotated.x, 1e-5f);
+    EXPECT_NEAR(r.y, rotated.y, 1e-5f);
+    EXPECT_NEAR(r.z, rotated.z, 1e-5f);
+}
+
 // Test case for get_terrain_height
 TEST(LandscapeTests, GetTerrainHeightReturnsPlausibleValue) {
     // The landscape is centered around 0,0.
@@ -122,9 +284,35 @@ TEST(LandscapeTests, GetTerrainHeightReturnsPlausibleValue) {
     EXPECT_LE(height2, 25.0f);
 }
 
+TEST(LandscapeTests, HeightQueriesAndCameraUpdatesDoNotAllocate) {
+    TerrainParams params;
+    params.noise.warp = 0.8f;
+    // More points than get_terrain_heights maps per block
+    std::vector<float> xs(600), zs(600), heights(600);
+    for (size_t i = 0; i < xs.size(); ++i) {
+        xs[i] = i * 0.37f - 100.0f;
+        zs[i] = i * -1.3f + 40.0f;
+    }
+    Camera cam = make_camera(800, 600);
+    bool keys[1024] = {};
+    keys['W'] = true;
+    float sum = 0.0f;
+    EXPECT_EQ(count_heap_allocations([&] {
+        for (int i = 0; i < 100; ++i) {
+            sum += get_terrain_height(xs[i], zs[i], params);
+        }
+        get_terrain_heights(xs.data(), zs.data(), heights.data(), xs.size(), params);
+        update_camera(cam, 0.016f, keys, 3.0, -2.0);
+    }), 0u);
+    EXPECT_TRUE(std::isfinite(sum));
+    for (size_t i = 250; i < 260; ++i) {
+        EXPECT_EQ(heights[i], get_terrain_height(xs[i], zs[i], params));
+    }
+}
+
 // Test case for create_landscape (basic checks)
 TEST(LandscapeTests, CreateLandscapeGeneratesVerticesAndIndices) {
-    GameObject landscape = create_landscape(50, 50);
+    MeshData landscape = create_landscape(50, 50);
 
     // Expect a certain number of vertices (width * depth)
     EXPECT_EQ(landscape.vertices.size(), 50 * 50);
@@ -139,4 +327,147 @@ TEST(LandscapeTests, CreateLandscapeGeneratesVerticesAndIndices) {
         // Check normals are normalized
         EXPECT_NEAR(simd::length(vertex.normal), 1.0f, 1e-5);
     }
-}
\ No newline at end of file
+}
+// Neighbouring chunks must share border vertices and normals to avoid cracks and lighting seams
+TEST(LandscapeTests, TerrainChunkBordersMatchNeighbours) {
+    const int resolution = 17;
+    const float chunkSize = 16.0f;
+    MeshData left = create_terrain_chunk(0, 0, resolution, chunkSize);
+    MeshData right = create_terrain_chunk(1, 0, resolution, chunkSize);
+
+    EXPECT_EQ(left.vertices.size(), resolution * resolution);
+    EXPECT_EQ(left.indices.size(), 2 * (resolution - 1) * (resolution - 1) * 3);
+
+    for (int z = 0; z < resolution; ++z) {
+        const Vertex& a = left.vertices[z * resolution + (resolution - 1)];
+        const Vertex& b = right.vertices[z * resolution];
+        EXPECT_NEAR(a.position.x, b.position.x, 1e-4);
+        EXPECT_NEAR(a.position.y, b.position.y, 1e-4);
+        EXPECT_NEAR(a.position.z, b.position.z, 1e-4);
+        EXPECT_NEAR(simd::dot(a.normal, b.normal), 1.0f, 1e-5);
+    }
+}
+
+// The fused single-pass builder must match central differences of the terrain, the grid's edges included
+TEST(LandscapeTests, BuildLandscapeMatchesCentralDifferenceNormals) {
+    const int width = 23;
+    const int depth = 17;
+    MeshSize size = landscape_mesh_size(width, depth);
+    std::vector<Vertex> vertices(size.vertexCount);
+    std::vector<uint32_t> indices(size.indexCount);
+    build_landscape(width, depth, vertices.data(), indices.data());
+
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < width; ++x) {
+            const float worldX = (float)x - width/2.0f;
+            const float worldZ = (float)z - depth/2.0f;
+            float heightL = get_terrain_height((float)(x - 1) - width/2.0f, worldZ);
+            float heightR = get_terrain_height((float)(x + 1) - width/2.0f, worldZ);
+            float heightD = get_terrain_height(worldX, (float)(z - 1) - depth/2.0f);
+            float heightU = get_terrain_height(worldX, (float)(z + 1) - depth/2.0f);
+            simd::float3 expected = simd::normalize(simd::float3{heightL - heightR, 2.0f, heightD - heightU});
+
+            const Vertex& v = vertices[z * width + x];
+            EXPECT_EQ(v.normal.x, expected.x);
+            EXPECT_EQ(v.normal.y, expected.y);
+            EXPECT_EQ(v.normal.z, expected.z);
+        }
+    }
+    EXPECT_EQ(indices.back(), (uint32_t)(width * depth - 1));
+}
+
+// A grid's edge vertices are interior ones of a grid one vertex larger all round; both see the same slope
+TEST(LandscapeTests, EdgeNormalsDoNotDependOnTheGridExtent) {
+    const int width = 20;
+    const int depth = 14;
+    MeshData inner = create_landscape(width, depth);
+    MeshData outer = create_landscape(width + 2, depth + 2);
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < width; ++x) {
+            const Vertex& a = inner.vertices[z * width + x];
+            const Vertex& b = outer.vertices[(z + 1) * (width + 2) + (x + 1)];
+            ASSERT_EQ(a.position.x, b.position.x);
+            ASSERT_EQ(a.position.z, b.position.z);
+            EXPECT_EQ(a.normal.x, b.normal.x);
+            EXPECT_EQ(a.normal.y, b.normal.y);
+            EXPECT_EQ(a.normal.z, b.normal.z);
+        }
+    }
+}
+
+// Any grid size samples the same terrain get_terrain_height reports, not one stretched over the grid,
+// and normals across the seams between tiles are central differences of it like any other
+TEST(LandscapeTests, LandscapeSamplesTerrainAtAnySize) {
+    for (int size : { 12, 50, 81, LANDSCAPE_TILE_SIZE * 2 + 1 }) {
+        MeshData landscape = create_landscape(size, size - 3);
+        for (const Vertex& v : landscape.vertices) {
+            const float x = v.position.x;
+            const float z = v.position.z;
+            ASSERT_EQ(v.position.y, get_terrain_height(x, z)) << "size " << size;
+            const simd::float3 normal = simd::normalize(simd::float3{
+                get_terrain_height(x - 1.0f, z) - get_terrain_height(x + 1.0f, z), 2.0f,
+                get_terrain_height(x, z - 1.0f) - get_terrain_height(x, z + 1.0f) });
+            ASSERT_EQ(v.normal.x, normal.x) << "size " << size << " at " << x << ", " << z;
+            ASSERT_EQ(v.normal.z, normal.z) << "size " << size << " at " << x << ", " << z;
+        }
+    }
+}
+
+// Bands and stripes split across threads must reproduce the serial mesh bit for bit
+TEST(LandscapeTests, ParallelLandscapeMatchesSerial) {
+    JobSystem jobs({ 3, 1 });
+    TerrainParams params;
+    params.noise.seed = 9;
+    // 16-bit and 32-bit indices; depths that do not divide into whole bands
+    for (int size : { 90, 300 }) {
+        MeshData serial = create_landscape(size, size - 37, params);
+        MeshData parallel = create_landscape(size, size - 37, jobs, params);
+        ASSERT_EQ(parallel.vertices.size(), serial.vertices.size());
+        EXPECT_EQ(memcmp(parallel.vertices.data(), serial.vertices.data(), serial.vertices.size() * sizeof(Vertex)), 0)
+            << "size " << size;
+        ASSERT_EQ(parallel.indices.format, serial.indices.format);
+        EXPECT_EQ(parallel.indices.indices16, serial.indices.indices16);
+        EXPECT_EQ(parallel.indices.indices32, serial.indices.indices32);
+        EXPECT_EQ(memcmp(&parallel.bounds, &serial.bounds, sizeof(BoundingBox)), 0);
+    }
+}
+
+TEST(LandscapeTests, TerrainParamsReachEveryQuery) {
+    TerrainParams tall;
+    tall.height = 24.0f;
+    EXPECT_EQ(get_terrain_height(3.5f, -7.25f, tall), 2.0f * get_terrain_height(3.5f, -7.25f));
+    EXPECT_EQ(terrain_height_bound(tall), 2.0f * terrain_height_bound());
+
+    TerrainParams reseeded;
+    reseeded.noise.seed = 77;
+    reseeded.noise.octaves = 7;
+    MeshData chunk = create_terrain_chunk(1, -1, 9, 8.0f, reseeded);
+    float difference = 0.0f;
+    for (const Vertex& v : chunk.vertices) {
+        EXPECT_EQ(v.position.y, get_terrain_height(v.position.x, v.position.z, reseeded));
+        difference += fabsf(v.position.y - get_terrain_height(v.position.x, v.position.z));
+    }
+    EXPECT_GT(difference, 0.0f);
+
+    TerrainParams single;
+    single.noise.octaves = 1;
+    EXPECT_FLOAT_EQ(terrain_height_bound(single), single.height);
+}
+
+TEST(LandscapeTests, IndicesUseNarrowestFormat) {
+    MeshData chunk = create_terrain_chunk(0, 0, 33, 32.0f);
+    EXPECT_EQ(chunk.indices.format, IndexFormat::UInt16);
+    EXPECT_EQ(chunk.indices.byte_size(), chunk.indices.size() * sizeof(uint16_t));
+
+    MeshSize size = terrain_chunk_mesh_size(33);
+    std::vector<Vertex> vertices(size.vertexCount);
+    std::vector<uint32_t> wide(size.indexCount);
+    build_terrain_chunk(0, 0, 33, 32.0f, vertices.data(), wide.data());
+    ASSERT_EQ(chunk.indices.size(), wide.size());
+    for (size_t i = 0; i < wide.size(); ++i) {
+        ASSERT_EQ(chunk.indices[i], wide[i]);
+    }
+
+    EXPECT_EQ(index_format_for(65535), IndexFormat::UInt16);
+    EXPECT_EQ(index_format_for(65536), IndexFormat::UInt32);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include "camera_path.hpp"
+
+#include <string>
+
+namespace {
+    const char* PATH_JSON = R"({
+        "width": 640, "height": 360, "frames": 100, "warmupFrames": 5,
+        "keyframes": [
+            { "time": 2.0, "position": [4, 5, 6], "yaw": 1.0, "pitch": 0.5 },
+            { "time": 0.0, "position": [0, 5, 0], "yaw": 0.0, "pitch": -0.5 },
+            { "time": 4.0, "position": [8, 5, 0] }
+        ]
+    })";
+}
+
+TEST(CameraPathTests, ParsesAndSortsKeyframes) {
+    CameraPath path;
+    std::string error;
+    ASSERT_TRUE(parse_camera_path(PATH_JSON, path, error)) << error;
+
+    EXPECT_EQ(path.width, 640);
+    EXPECT_EQ(path.height, 360);
+    EXPECT_EQ(path.frames, 100);
+    EXPECT_EQ(path.warmupFrames, 5);
+    ASSERT_EQ(path.keyframes.size(), 3u);
+    EXPECT_FLOAT_EQ(path.keyframes[0].time, 0.0f);
+    EXPECT_FLOAT_EQ(path.keyframes[1].position.x, 4.0f);
+    EXPECT_FLOAT_EQ(camera_path_duration(path), 4.0f);
+}
+
+TEST(CameraPathTests, RejectsMalformedPaths) {
+    CameraPath path;
+    std::string error;
+    EXPECT_FALSE(parse_camera_path("{ \"keyframes\": [] }", path, error));
+    EXPECT_FALSE(error.empty());
+
+    error.clear();
+    EXPECT_FALSE(parse_camera_path("{ \"keyframes\": [ { \"time\": 0, \"position\": [1, 2] } ] }", path, error));
+    EXPECT_FALSE(error.empty());
+
+    error.clear();
+    EXPECT_FALSE(parse_camera_path("{ \"frames\": ", path, error));
+    EXPECT_FALSE(error.empty());
+}
+
+TEST(CameraPathTests, SplinePassesThroughKeyframes) {
+    CameraPath path;
+    std::string error;
+    ASSERT_TRUE(parse_camera_path(PATH_JSON, path, error)) << error;
+
+    for (const auto& key : path.keyframes) {
+        CameraKeyframe pose = sample_camera_path(path, key.time);
+        EXPECT_NEAR(pose.position.x, key.position.x, 1e-5f);
+        EXPECT_NEAR(pose.position.y, key.position.y, 1e-5f);
+        EXPECT_NEAR(pose.position.z, key.position.z, 1e-5f);
+    }
+
+    CameraKeyframe mid = sample_camera_path(path, 1.0f);
+    EXPECT_FLOAT_EQ(mid.yaw, 0.5f);
+    EXPECT_FLOAT_EQ(mid.pitch, 0.0f);
+
+    // Clamped outside the path
+    EXPECT_FLOAT_EQ(sample_camera_path(path, -1.0f).position.x, 0.0f);
+    EXPECT_FLOAT_EQ(sample_camera_path(path, 10.0f).position.x, 8.0f);
+}
+
+TEST(CameraPathTests, AppliedPoseDrivesViewMatrix) {
+    Camera cam = make_camera(640, 360);
+    CameraKeyframe pose;
+    pose.position = {1.0f, 2.0f, 3.0f};
+    pose.yaw = 0.3f;
+    pose.pitch = -0.2f;
+    apply_camera_pose(cam, pose, 0.016f);
+
+    EXPECT_FLOAT_EQ(cam.position.x, 1.0f);
+    EXPECT_FLOAT_EQ(cam.yaw, 0.3f);
+    EXPECT_FLOAT_EQ(cam.pitch, -0.2f);
+
+    // The camera position maps to the view-space origin
+    simd::float4 origin = cam.viewMatrix * simd::float4{1.0f, 2.0f, 3.0f, 1.0f};
+    EXPECT_NEAR(origin.x, 0.0f, 1e-5f);
+    EXPECT_NEAR(origin.y, 0.0f, 1e-5f);
+    EXPECT_NEAR(origin.z, 0.0f, 1e-5f);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "camera.hpp"
+#include "chunk_schedule.hpp"
+
+namespace {
+    const float CHUNK_SIZE = 32.0f;
+    const float HEIGHT_BOUND = 20.0f;
+
+    // Camera at the origin looking down -Z, moving towards -Z at 64 units per second
+    ChunkStreamingView moving_view() {
+        simd::float4x4 projection = matrix_perspective_right_hand(M_PI / 3.0f, 1.0f, 0.1f, 1000.0f);
+        simd::float4x4 view =
+            matrix_look_at_right_hand(simd::float3{0, 0, 0}, simd::float3{0, 0, -1}, simd::float3{0, 1, 0});
+        return chunk_streaming_view({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 32.0f }, 0.5f, projection * view);
+    }
+}
+
+TEST(ChunkScheduleTests, StreamingViewMeasuresTheVelocity) {
+    const ChunkStreamingView view = moving_view();
+    EXPECT_FLOAT_EQ(view.velocity.z, -64.0f);
+    EXPECT_FLOAT_EQ(view.velocity.x, 0.0f);
+    EXPECT_TRUE(view.hasFrustum);
+
+    const ChunkStreamingView paused = chunk_streaming_view({ 1.0f, 0.0f, 0.0f }, {}, 0.0f, matrix_translation(0, 0, 0));
+    EXPECT_FLOAT_EQ(paused.velocity.x, 0.0f);
+}
+
+TEST(ChunkScheduleTests, PredictsAlongTheGround) {
+    ChunkStreamingView view = moving_view();
+    view.velocity.y = 10.0f;
+    const simd::float3 predicted = predict_camera_position(view, 1.0f);
+    EXPECT_FLOAT_EQ(predicted.z, -64.0f);
+    EXPECT_FLOAT_EQ(predicted.y, 0.0f);
+    EXPECT_FLOAT_EQ(predict_camera_position(view, 0.0f).z, 0.0f);
+}
+
+TEST(ChunkScheduleTests, ChunkDistanceIsZeroInside) {
+    EXPECT_FLOAT_EQ(chunk_distance({ 0, 0 }, CHUNK_SIZE, { 5.0f, 0.0f, 5.0f }), 0.0f);
+    EXPECT_FLOAT_EQ(chunk_distance({ 2, 0 }, CHUNK_SIZE, { 5.0f, 0.0f, 5.0f }), 59.0f);
+    EXPECT_FLOAT_EQ(chunk_distance({ 1, 1 }, CHUNK_SIZE, { 29.0f, 0.0f, 28.0f }), 5.0f);
+}
+
+TEST(ChunkScheduleTests, ChunksAheadComeBeforeChunksBehind) {
+    const ChunkStreamingView view = moving_view();
+    ChunkScheduleSettings settings;
+    // Two chunks ahead on the predicted path against two chunks behind
+    const float ahead = chunk_request_priority({ -1, -3 }, CHUNK_SIZE, HEIGHT_BOUND, view, settings);
+    const float behind = chunk_request_priority({ -1, 2 }, CHUNK_SIZE, HEIGHT_BOUND, view, settings);
+    EXPECT_LT(ahead, behind);
+
+    // Without the lookahead and the frustum the nearer chunk behind wins
+    settings.lookahead = 0.0f;
+    ChunkStreamingView still = view;
+    still.hasFrustum = false;
+    EXPECT_GT(chunk_request_priority({ -1, -3 }, CHUNK_SIZE, HEIGHT_BOUND, still, settings),
+              chunk_request_priority({ -1, 1 }, CHUNK_SIZE, HEIGHT_BOUND, still, settings));
+}
+
+TEST(ChunkScheduleTests, ChunksOutsideTheFrustumCountAsFarther) {
+    ChunkStreamingView view = moving_view();
+    view.velocity = { 0.0f, 0.0f, 0.0f };
+    ChunkScheduleSettings settings;
+    // As far to the side in front of the camera as behind it
+    const float inside = chunk_request_priority({ -1, -4 }, CHUNK_SIZE, HEIGHT_BOUND, view, settings);
+    const float outside = chunk_request_priority({ -1, 3 }, CHUNK_SIZE, HEIGHT_BOUND, view, settings);
+    EXPECT_FLOAT_EQ(outside, settings.offscreenFactor * inside);
+
+    view.hasFrustum = false;
+    EXPECT_FLOAT_EQ(chunk_request_priority({ -1, 3 }, CHUNK_SIZE, HEIGHT_BOUND, view, settings), inside);
+}
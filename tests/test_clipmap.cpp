@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "clipmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+
+namespace {
+    // Vertices of one level's outer edge, or of the ring's inner edge, as world positions rounded to centimetres
+    std::set<std::pair<long, long>> edge_points(const ClipmapLevel& level, uint32_t gridSize, int edge) {
+        std::set<std::pair<long, long>> points;
+        const int half = (int)gridSize / 2;
+        for (uint32_t v = 0; v < (gridSize + 1) * (gridSize + 1); ++v) {
+            const int i = (int)(v % (gridSize + 1)) - half;
+            const int j = (int)(v / (gridSize + 1)) - half;
+            if (std::max(std::abs(i), std::abs(j)) == edge) {
+                const simd::float3 p = clipmap_point(level, gridSize, v);
+                points.insert({ lroundf(p.x * 100.0f), lroundf(p.y * 100.0f) });
+            }
+        }
+        return points;
+    }
+}
+
+TEST(ClipmapTests, GridLeavesTheInnerLevelOut) {
+    const ClipmapGrid grid = clipmap_grid(16);
+    EXPECT_EQ(grid.fullCount, 16u * 16u * 6u);
+    EXPECT_EQ(grid.ringCount, (16u * 16u - 8u * 8u) * 6u);
+    EXPECT_EQ(grid.indices.size(), (size_t)(grid.fullCount + grid.ringCount));
+    EXPECT_EQ(clipmap_level_count(16, 1.0f, 8.0f), 1u);
+    EXPECT_EQ(clipmap_level_count(16, 1.0f, 9.0f), 2u);
+    EXPECT_EQ(clipmap_level_count(16, 1.0f, 1e6f), CLIPMAP_MAX_LEVELS);
+}
+
+TEST(ClipmapTests, LevelsMeetWithoutCracks) {
+    const uint32_t gridSize = 32;
+    const uint32_t count = 5;
+    const simd::float2 eyes[] = { { 0.0f, 0.0f }, { 13.3f, -7.9f }, { -101.6f, 250.2f }, { 3.9f, 4.1f } };
+    for (const simd::float2 eye : eyes) {
+        ClipmapLevel levels[count];
+        clipmap_place(0.5f, count, eye, 1.0f, levels);
+        for (uint32_t l = 0; l < count; ++l) {
+            // The finest level always has the camera well inside
+            EXPECT_LE(fabsf(levels[l].center.x - eye.x), levels[l].cellSize);
+            EXPECT_LE(fabsf(levels[l].center.y - eye.y), levels[l].cellSize);
+            EXPECT_LE(fabsf(levels[l].innerShift.x), 1.0f);
+            EXPECT_LE(fabsf(levels[l].innerShift.y), 1.0f);
+            if (l == 0) {
+                continue;
+            }
+            // The ring's inner edge lies on exactly the points the inner level's outer edge slid onto
+            EXPECT_EQ(edge_points(levels[l], gridSize, gridSize / 4),
+                      edge_points(levels[l - 1], gridSize, gridSize / 2));
+            EXPECT_FLOAT_EQ(levels[l - 1].nextLod, levels[l].lod);
+        }
+    }
+}
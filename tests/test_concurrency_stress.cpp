@@ -0,0 +1,374 @@
+// Stress tests of the engine's concurrency primitives, built into run_stress_tests and run by
+// `ctest -L stress`. Each test repeats a race-prone pattern many times with random yields and spins
+// between the steps, so the threads interleave differently on every round. STRESS_SCALE multiplies
+// the round counts and STRESS_SEED fixes the interleaving; a failure prints the seed to rerun it
+// with. Build with -DENABLE_THREAD_SANITIZER=ON to have data races reported even where the results
+// happen to come out right.
+#include <gtest/gtest.h>
+#include "draw_costs.hpp"
+#include "frame_stats.hpp"
+#include "concurrent_map.hpp"
+#include "job_system.hpp"
+#include "mpmc_queue.hpp"
+#include "spsc_queue.hpp"
+#include "triple_buffer.hpp"
+
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    uint32_t stress_scale() {
+        const char* scale = std::getenv("STRESS_SCALE");
+        return scale ? std::max(atoi(scale), 1) : 1;
+    }
+
+    uint32_t stress_seed() {
+        static const uint32_t seed = [] {
+            const char* fixed = std::getenv("STRESS_SEED");
+            return fixed ? (uint32_t)strtoul(fixed, nullptr, 10) : std::random_device{}();
+        }();
+        return seed;
+    }
+
+    // Perturbs the schedule: usually nothing, sometimes a yield, sometimes a short spin
+    void jitter(std::mt19937& rng) {
+        const uint32_t roll = rng() % 16;
+        if (roll == 0) {
+            std::this_thread::yield();
+        } else if (roll == 1) {
+            const uint32_t spins = rng() % 256;
+            volatile uint32_t sink = 0;
+            for (uint32_t i = 0; i < spins; ++i) {
+                sink = i;
+            }
+            EXPECT_LE(sink, spins);
+        }
+    }
+
+    class StressTest : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            RecordProperty("seed", (int)stress_seed());
+        }
+
+        void TearDown() override {
+            if (HasFailure()) {
+                printf("Rerun with STRESS_SEED=%u\n", stress_seed());
+            }
+        }
+
+        // A generator of its own per thread, derived from the test's seed
+        std::mt19937 thread_rng(uint32_t thread) const {
+            return std::mt19937(stress_seed() * 2654435761u + thread);
+        }
+    };
+
+    using JobSystemStress = StressTest;
+    using SpscQueueStress = StressTest;
+    using MpmcQueueStress = StressTest;
+    using ConcurrentMapStress = StressTest;
+    using TripleBufferStress = StressTest;
+    using SharedStatsStress = StressTest;
+}
+
+TEST_F(JobSystemStress, CountersDrainUnderConcurrentSubmitters) {
+    JobSystem jobs({ 3, 2 });
+    for (uint32_t round = 0; round < 1000 * stress_scale(); ++round) {
+        // Outside threads submit to the injection deque while the frame threads steal from it
+        std::atomic<uint32_t> sum{ 0 };
+        JobCounter counter;
+        std::vector<std::thread> submitters;
+        for (uint32_t t = 0; t < 3; ++t) {
+            submitters.emplace_back([&, t] {
+                std::mt19937 rng = thread_rng(round * 8 + t);
+                for (uint32_t i = 0; i < 64; ++i) {
+                    jobs.run([&sum, i] { sum += i; }, &counter,
+                             rng() % 4 == 0 ? JobPriority::Background : JobPriority::Frame);
+                    jitter(rng);
+                }
+            });
+        }
+        for (std::thread& submitter : submitters) {
+            submitter.join();
+        }
+        jobs.wait(counter);
+        ASSERT_TRUE(counter.done());
+        ASSERT_EQ(sum.load(), 3u * (63 * 64 / 2));
+    }
+}
+
+TEST_F(JobSystemStress, NestedWaitsNeverDeadlock) {
+    JobSystem jobs({ 2, 1 });
+    for (uint32_t round = 0; round < 500 * stress_scale(); ++round) {
+        std::atomic<uint32_t> leaves{ 0 };
+        JobCounter outer;
+        for (uint32_t i = 0; i < 16; ++i) {
+            jobs.run([&, i] {
+                std::mt19937 rng = thread_rng(round * 16 + i);
+                JobCounter inner;
+                const uint32_t children = 1 + rng() % 16;
+                for (uint32_t j = 0; j < children; ++j) {
+                    jobs.run([&leaves] { leaves++; }, &inner);
+                    jitter(rng);
+                }
+                jobs.wait(inner);
+                leaves += 1000;
+            }, &outer);
+        }
+        jobs.wait(outer);
+        ASSERT_GE(leaves.load(), 16u * 1000);
+    }
+}
+
+TEST_F(JobSystemStress, ParallelForWritesEveryItemOnce) {
+    JobSystem jobs({ 3, 1 });
+    std::vector<uint32_t> hits(4096);
+    for (uint32_t round = 0; round < 1000 * stress_scale(); ++round) {
+        std::mt19937 rng = thread_rng(round);
+        const uint32_t count = 1 + rng() % (uint32_t)hits.size();
+        const uint32_t grain = 1 + rng() % 128;
+        std::fill(hits.begin(), hits.end(), 0u);
+        jobs.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                hits[i]++;
+            }
+        });
+        for (uint32_t i = 0; i < count; ++i) {
+            ASSERT_EQ(hits[i], 1u) << "item " << i << " of " << count << ", grain " << grain;
+        }
+    }
+}
+
+TEST_F(SpscQueueStress, DeliversEveryValueInOrderThroughATinyRing) {
+    // Four slots keep both indices wrapping and the full and empty checks racing
+    SpscQueue<uint64_t, 4> queue;
+    const uint64_t count = 1000000ull * stress_scale();
+    std::thread producer([&] {
+        std::mt19937 rng = thread_rng(1);
+        for (uint64_t i = 0; i < count; ++i) {
+            while (!queue.push(i * 0x9E3779B97F4A7C15ull)) {
+                std::this_thread::yield();
+            }
+            jitter(rng);
+        }
+    });
+
+    std::mt19937 rng = thread_rng(2);
+    uint64_t expected = 0;
+    while (expected < count) {
+        uint64_t value;
+        if (queue.pop(value)) {
+            ASSERT_EQ(value, expected * 0x9E3779B97F4A7C15ull);
+            ++expected;
+        }
+        jitter(rng);
+    }
+    producer.join();
+}
+
+TEST_F(MpmcQueueStress, DeliversEveryValueOnceThroughATinyRing) {
+    // Four slots and four threads a side keep every slot's sequence contended
+    MpmcQueue<uint64_t, 4> queue;
+    constexpr uint32_t THREADS = 4;
+    const uint64_t perProducer = 100000ull * stress_scale();
+    std::vector<std::atomic<uint8_t>> seen(THREADS * perProducer);
+    std::atomic<uint64_t> received{ 0 };
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng = thread_rng(t);
+            for (uint64_t i = 0; i < perProducer; ++i) {
+                while (!queue.push(t * perProducer + i)) {
+                    std::this_thread::yield();
+                }
+                jitter(rng);
+            }
+        });
+        threads.emplace_back([&, t] {
+            std::mt19937 rng = thread_rng(THREADS + t);
+            uint64_t value;
+            while (received.load() < THREADS * perProducer) {
+                if (queue.pop(value)) {
+                    seen[value]++;
+                    received++;
+                }
+                jitter(rng);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::atomic<uint8_t>& count : seen) {
+        ASSERT_EQ(count.load(), 1);
+    }
+}
+
+TEST_F(ConcurrentMapStress, ReadersNeverSeeFreedOrTornEntries) {
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t check = 0;     // The key's hash, so a value read from a reused node would show
+    };
+    // Few keys over two shards of two buckets, so writers replace and erase under the readers
+    ConcurrentMap<uint64_t, Entry, std::hash<uint64_t>, 2> map(2);
+    constexpr uint64_t KEYS = 32;
+    const uint32_t rounds = 100000 * stress_scale();
+    std::atomic<bool> done{ false };
+    std::vector<std::thread> readers;
+    for (uint32_t t = 0; t < 3; ++t) {
+        readers.emplace_back([&, t] {
+            std::mt19937 rng = thread_rng(10 + t);
+            while (!done.load()) {
+                Entry entry;
+                const uint64_t key = rng() % KEYS;
+                if (map.find(key, entry)) {
+                    ASSERT_EQ(entry.key, key);
+                    ASSERT_EQ(entry.check, key * 0x9E3779B97F4A7C15ull);
+                }
+                map.for_each([&](uint64_t visited, const Entry& value) {
+                    ASSERT_EQ(value.key, visited);
+                });
+                jitter(rng);
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (uint32_t t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] {
+            std::mt19937 rng = thread_rng(t);
+            for (uint32_t i = 0; i < rounds; ++i) {
+                const uint64_t key = rng() % KEYS;
+                if (rng() % 3 == 0) {
+                    map.erase(key);
+                } else {
+                    map.insert_or_assign(key, { key, key * 0x9E3779B97F4A7C15ull });
+                }
+                jitter(rng);
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    size_t entries = 0;
+    map.for_each([&](uint64_t, const Entry&) { entries++; });
+    EXPECT_EQ(entries, map.size());
+}
+
+TEST_F(TripleBufferStress, ReaderSeesWholeIncreasingValues) {
+    struct Value {
+        uint64_t sequence = 0;
+        uint64_t copies[15] = {};   // A value spanning cache lines, so a torn read would show
+    };
+    TripleBuffer<Value> buffer;
+    const uint64_t count = 1000000ull * stress_scale();
+    std::atomic<bool> done{ false };
+    std::thread writer([&] {
+        std::mt19937 rng = thread_rng(1);
+        for (uint64_t i = 1; i <= count; ++i) {
+            Value& value = buffer.back();
+            value.sequence = i;
+            for (uint64_t& copy : value.copies) {
+                copy = i;
+            }
+            buffer.publish();
+            jitter(rng);
+        }
+        done = true;
+    });
+
+    std::mt19937 rng = thread_rng(2);
+    uint64_t last = 0;
+    for (bool finished = false; !finished;) {
+        // Read after the writer is done, the value is its last
+        finished = done.load();
+        buffer.update();
+        const Value& value = buffer.read();
+        ASSERT_GE(value.sequence, last);
+        for (uint64_t copy : value.copies) {
+            ASSERT_EQ(copy, value.sequence);
+        }
+        last = value.sequence;
+        jitter(rng);
+    }
+    writer.join();
+    EXPECT_EQ(last, count);
+}
+
+TEST_F(SharedStatsStress, GpuTimesArriveFromManyThreads) {
+    // Completion handlers record GPU times while the render thread ends frames, some before their frame
+    // has ended and some after, and the render thread reads the latest back
+    FrameStats stats;
+    const uint64_t frames = 20000ull * stress_scale();
+    std::atomic<uint64_t> ended{ 0 };
+    std::vector<std::thread> handlers;
+    for (uint32_t t = 0; t < 3; ++t) {
+        handlers.emplace_back([&, t] {
+            std::mt19937 rng = thread_rng(t);
+            for (uint64_t frame = 1 + t; frame <= frames; frame += 3) {
+                while (ended.load() + 1 < frame) {
+                    std::this_thread::yield();
+                }
+                jitter(rng);
+                frame_stats_record_gpu(stats, frame, 1.0f + (float)(frame % 7));
+                frame_stats_record_latency(stats, frame, LATENCY_QUEUE, 2.0f);
+            }
+        });
+    }
+    std::mt19937 rng = thread_rng(3);
+    for (uint64_t frame = 1; frame <= frames; ++frame) {
+        frame_stats_begin_frame(stats);
+        jitter(rng);
+        frame_stats_end_frame(stats);
+        ended = frame;
+        uint64_t latest = 0;
+        const float gpuMs = frame_stats_latest_gpu(stats, latest);
+        if (latest > 0) {
+            ASSERT_FLOAT_EQ(gpuMs, 1.0f + (float)(latest % 7));
+        }
+    }
+    for (std::thread& handler : handlers) {
+        handler.join();
+    }
+
+    // Every time reached its frame, whichever side of the frame's end it arrived on
+    for (const FrameSample& sample : frame_stats_history(stats)) {
+        ASSERT_FLOAT_EQ(sample.gpuMs, 1.0f + (float)(sample.frame % 7)) << "frame " << sample.frame;
+    }
+}
+
+TEST_F(SharedStatsStress, DrawCostsRecordWhileTheOverlayReads) {
+    DrawCosts costs;
+    costs.settings.sampledFrames = 3;
+    const uint32_t frames = 50000 * stress_scale();
+    const DrawTag tags[] = { { make_chunk_draw_object(1, 2), 0 }, { make_mesh_draw_object(3, 0), 1 } };
+    const float ms[] = { 2.0f, 1.0f };
+    std::atomic<bool> done{ false };
+    std::thread reader([&] {
+        std::mt19937 rng = thread_rng(1);
+        std::vector<DrawCost> objects, materials;
+        while (!done.load()) {
+            draw_costs_top(costs, objects, materials);
+            for (const DrawCost& cost : objects) {
+                ASSERT_TRUE(cost.ms == 2.0f || cost.ms == 1.0f);
+            }
+            jitter(rng);
+        }
+    });
+    std::mt19937 rng = thread_rng(2);
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        draw_costs_record_frame(costs, tags, ms, 2);
+        jitter(rng);
+    }
+    done = true;
+    reader.join();
+
+    std::vector<DrawCost> objects, materials;
+    EXPECT_EQ(draw_costs_top(costs, objects, materials), frames / 3);
+}
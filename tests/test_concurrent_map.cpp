@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "concurrent_map.hpp"
+#include "landscape.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST(ConcurrentMapTests, InsertAssignFindAndErase) {
+    ConcurrentMap<ChunkKey, int, ChunkKeyHash> map(4);
+    EXPECT_TRUE(map.insert({ 1, 2 }, 10));
+    EXPECT_FALSE(map.insert({ 1, 2 }, 11));
+    EXPECT_TRUE(map.insert_or_assign({ -3, 5 }, 20));
+    EXPECT_FALSE(map.insert_or_assign({ -3, 5 }, 21));
+    EXPECT_EQ(map.size(), 2u);
+
+    int value = 0;
+    ASSERT_TRUE(map.find({ 1, 2 }, value));
+    EXPECT_EQ(value, 10);
+    ASSERT_TRUE(map.find({ -3, 5 }, value));
+    EXPECT_EQ(value, 21);
+    EXPECT_FALSE(map.contains({ 2, 1 }));
+
+    EXPECT_TRUE(map.erase({ 1, 2 }));
+    EXPECT_FALSE(map.erase({ 1, 2 }));
+    EXPECT_FALSE(map.contains({ 1, 2 }));
+    EXPECT_EQ(map.size(), 1u);
+}
+
+TEST(ConcurrentMapTests, ChainsHoldManyKeysPerBucket) {
+    // One bucket per shard, so every shard is a single long chain
+    ConcurrentMap<ChunkKey, int, ChunkKeyHash, 4> map(1);
+    for (int z = -20; z < 20; ++z) {
+        for (int x = -20; x < 20; ++x) {
+            map.insert({ x, z }, x * 100 + z);
+        }
+    }
+    for (int z = -20; z < 20; z += 2) {
+        for (int x = -20; x < 20; ++x) {
+            map.erase({ x, z });
+        }
+    }
+    EXPECT_EQ(map.size(), 800u);
+    size_t visited = 0;
+    map.for_each([&](const ChunkKey& key, int value) {
+        EXPECT_NE(key.z % 2, 0);
+        EXPECT_EQ(value, key.x * 100 + key.z);
+        visited++;
+    });
+    EXPECT_EQ(visited, 800u);
+}
+
+TEST(ConcurrentMapTests, ReadersSeeWholeValuesWhileWritersReplaceThem) {
+    struct Pair {
+        uint64_t a = 0;
+        uint64_t b = 0;
+    };
+    ConcurrentMap<int, Pair> map(8);
+    for (int key = 0; key < 16; ++key) {
+        map.insert(key, {});
+    }
+    std::atomic<bool> done{ false };
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 2; ++w) {
+        writers.emplace_back([&map, w] {
+            for (uint64_t i = 1; i <= 20000; ++i) {
+                map.insert_or_assign((int)(i % 16), { i + w, i + w });
+            }
+        });
+    }
+    std::thread reader([&] {
+        while (!done.load()) {
+            for (int key = 0; key < 16; ++key) {
+                Pair pair;
+                ASSERT_TRUE(map.find(key, pair));
+                ASSERT_EQ(pair.a, pair.b);
+            }
+        }
+    });
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    // Replaced nodes are freed in batches as the epoch moves on, not kept for the map's lifetime
+    EXPECT_LT(map.retired(), 40000u);
+}
+
+TEST(EpochTests, RetiredNodesWaitForPinnedReaders) {
+    EpochDomain domain;
+    static int freed = 0;
+    freed = 0;
+    {
+        EpochGuard guard(domain);
+        domain.retire(nullptr, [](void*) { freed++; });
+        for (int i = 0; i < 4; ++i) {
+            domain.collect();
+        }
+        EXPECT_EQ(freed, 0);
+    }
+    domain.collect();
+    domain.collect();
+    EXPECT_EQ(freed, 1);
+    EXPECT_EQ(domain.retired(), 0u);
+}
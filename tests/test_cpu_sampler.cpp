@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "cpu_sampler.hpp"
+
+#include <sstream>
+#include <string>
+
+namespace {
+    CpuStackSample stack_sample(double time, uint64_t thread, std::initializer_list<uintptr_t> pcs) {
+        CpuStackSample sample;
+        sample.time = time;
+        sample.thread = thread;
+        for (uintptr_t pc : pcs) {
+            sample.pcs[sample.depth++] = pc;
+        }
+        return sample;
+    }
+
+    std::string fake_symbol(uintptr_t address) {
+        return "f" + std::to_string(address);
+    }
+}
+
+TEST(CpuSamplerTests, RingKeepsTheNewestSamplesInOrder) {
+    CpuSampleRing ring(3);
+    for (int i = 0; i < 5; ++i) {
+        ring.push(stack_sample(i, 1, { 100 }));
+    }
+    EXPECT_EQ(ring.size(), 3u);
+
+    std::vector<CpuStackSample> all = ring.collect(0.0);
+    ASSERT_EQ(all.size(), 3u);
+    EXPECT_DOUBLE_EQ(all.front().time, 2.0);
+    EXPECT_DOUBLE_EQ(all.back().time, 4.0);
+    EXPECT_EQ(ring.collect(3.5).size(), 1u);
+}
+
+TEST(CpuSamplerTests, FoldsStacksOutermostFirstUnderTheirThread) {
+    CpuProfile profile;
+    profile.threadNames[1] = "Render";
+    // Innermost first; return addresses are symbolized one byte into their call
+    profile.samples.push_back(stack_sample(0.0, 1, { 10, 21, 31 }));
+    profile.samples.push_back(stack_sample(0.1, 1, { 10, 21, 31 }));
+    profile.samples.push_back(stack_sample(0.2, 1, { 11, 31 }));
+    profile.samples.push_back(stack_sample(0.3, 7, { 10 }));
+
+    std::map<std::string, uint32_t> stacks = fold_cpu_samples(profile, fake_symbol);
+    ASSERT_EQ(stacks.size(), 3u);
+    EXPECT_EQ(stacks["Render;f30;f20;f10"], 2u);
+    EXPECT_EQ(stacks["Render;f30;f11"], 1u);
+    EXPECT_EQ(stacks["thread 7;f10"], 1u);
+
+    std::ostringstream out;
+    write_folded_stacks(stacks, out);
+    EXPECT_NE(out.str().find("Render;f30;f20;f10 2\n"), std::string::npos);
+}
+
+TEST(CpuSamplerTests, SeparatorsInSymbolsAreReplaced) {
+    CpuProfile profile;
+    profile.samples.push_back(stack_sample(0.0, 2, { 5 }));
+    std::map<std::string, uint32_t> stacks = fold_cpu_samples(profile, [](uintptr_t) { return "a;b"; });
+    EXPECT_EQ(stacks.count("thread 2;a:b"), 1u);
+}
+
+TEST(CpuSamplerTests, SymbolizesAddressesByImage) {
+    // Executables that do not export their symbols still name the image and offset
+    const std::string name = symbolize_address((uintptr_t)&symbolize_address);
+    EXPECT_TRUE(name.find("symbolize_address") != std::string::npos || name.find("+0x") != std::string::npos)
+        << name;
+    EXPECT_EQ(symbolize_address(0x10), "0x10");
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "creature.hpp"
+
+#include <cmath>
+
+TEST(CreatureTests, EveryVertexIsFullyWeightedOnAJoint) {
+    const SkinnedMesh creature = create_creature_mesh();
+    const AnimationSet set = create_creature_animations();
+    ASSERT_EQ(creature.skin.size(), creature.mesh.vertices.size());
+    for (const VertexSkin& skin : creature.skin) {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < SKIN_INFLUENCES; ++i) {
+            sum += skin.weights[i];
+            EXPECT_LT(skin.joints[i], set.skeleton.size());
+        }
+        EXPECT_EQ(sum, 255u);
+    }
+
+    // The feet stand on the ground, and the walk reaches farther than the bind pose
+    EXPECT_NEAR(creature.mesh.bounds.min.y, 0.0f, 1e-6f);
+    const BoundingBox posed = animation_bounds(creature, set);
+    EXPECT_LE(posed.min.z, creature.mesh.bounds.min.z);
+    EXPECT_GT(posed.max.z - posed.min.z, creature.mesh.bounds.max.z - creature.mesh.bounds.min.z);
+}
+
+TEST(CreatureTests, HerdWalksOnTheTerrain) {
+    const HeightField field = create_height_field(-32.0f, -32.0f, 65, 65, 1.0f);
+    const SkinnedMesh creature = create_creature_mesh();
+    Herd herd = create_herd(field, creature, 6);
+    ASSERT_EQ(herd.size(), 6u);
+    ASSERT_EQ(herd.palettes.size(), 6u * herd.animation.skeleton.size());
+
+    JobSystem jobs({ 2, 1 });
+    const std::vector<float> start = herd.angles;
+    double time = 0.0;
+    for (int step = 0; step < 600; ++step) {
+        time += 0.05;
+        herd_update(herd, jobs, field, time, 0.05f);
+    }
+    bool moved = false;
+    for (uint32_t i = 0; i < herd.size(); ++i) {
+        const simd::float3 position = affine_translation_of(herd.world[i]);
+        EXPECT_NEAR(position.y, height_field_height(field, position.x, position.z), 1e-4f);
+        EXPECT_TRUE(height_field_contains(field, position.x, position.z));
+        EXPECT_LE(fabsf(position.x - herd.bounds.centerX[i]), herd.bounds.extentX[i]);
+        EXPECT_GE(herd.animators[i].blend, 0.0f);
+        EXPECT_LE(herd.animators[i].blend, 1.0f);
+        moved = moved || herd.angles[i] > start[i];
+    }
+    // Half a minute covers a walking stretch of every cycle
+    EXPECT_TRUE(moved);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "crowd.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    // A 64 x 64 unit field rising gently along x
+    HeightField make_field() {
+        HeightField field;
+        field.width = 65;
+        field.depth = 65;
+        field.heights.resize((size_t)field.width * field.depth);
+        for (int z = 0; z < field.depth; ++z) {
+            for (int x = 0; x < field.width; ++x) {
+                field.heights[(size_t)z * field.width + x] = 0.1f * (float)x;
+            }
+        }
+        return field;
+    }
+
+    simd::float3 entity_position(const SceneStore& scene, Entity entity) {
+        const simd::float4 t = scene.transforms[scene_index(scene, entity)].columns[3];
+        return { t.x, t.y, t.z };
+    }
+}
+
+TEST(CrowdTests, AgentsAreEntitiesStandingOnTheTerrain) {
+    SceneStore scene;
+    const HeightField field = make_field();
+    CrowdSettings settings;
+    settings.size = 2.0f;
+    const Crowd crowd = create_crowd(scene, field, 500, 3, UNIT_BOX, settings);
+    ASSERT_EQ(crowd.size(), 500u);
+    EXPECT_EQ(scene.size(), 500u);
+    for (uint32_t i = 0; i < crowd.size(); i += 37) {
+        const simd::float3 p = entity_position(scene, crowd.entities[i]);
+        EXPECT_FLOAT_EQ(p.x, crowd.xs[i]);
+        EXPECT_NEAR(p.y, height_field_height(field, p.x, p.z) + 1.0f, 1e-4f);
+        EXPECT_EQ(scene.meshes[scene_index(scene, crowd.entities[i])], 3u);
+    }
+}
+
+TEST(CrowdTests, NeighbourQueriesMatchAScan) {
+    SceneStore scene;
+    const HeightField field = make_field();
+    CrowdSettings settings;
+    settings.radius = 2.0f;
+    const Crowd crowd = create_crowd(scene, field, 4000, 0, UNIT_BOX, settings);
+
+    std::vector<uint32_t> found;
+    for (uint32_t probe = 0; probe < 50; ++probe) {
+        const float x = crowd.xs[probe * 13];
+        const float z = crowd.zs[probe * 13] + 0.7f;
+        crowd_neighbours(crowd, x, z, 1.8f, found);
+        std::sort(found.begin(), found.end());
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < crowd.size(); ++i) {
+            const float dx = crowd.xs[i] - x;
+            const float dz = crowd.zs[i] - z;
+            if (dx * dx + dz * dz < 1.8f * 1.8f) {
+                expected.push_back(i);
+            }
+        }
+        EXPECT_EQ(found, expected);
+    }
+}
+
+TEST(CrowdTests, CloseAgentsArePushedApart) {
+    SceneStore scene;
+    const HeightField field = make_field();
+    CrowdSettings settings;
+    settings.wander = 0.0f;
+    settings.slope = 0.0f;
+    Crowd crowd = create_crowd(scene, field, 2, 0, UNIT_BOX, settings);
+    // Both heading along +x, side by side
+    crowd.xs = { 20.0f, 20.0f };
+    crowd.zs = { 30.0f, 30.4f };
+    crowd.headings = { 0.0f, 0.0f };
+
+    JobSystem jobs({ 1, 1 });
+    for (int step = 0; step < 60; ++step) {
+        crowd_update(crowd, scene, jobs, field, settings, 1.0f / 30.0f);
+    }
+    EXPECT_GT(std::fabs(crowd.zs[1] - crowd.zs[0]), settings.radius * 0.9f);
+    EXPECT_GT(crowd.xs[0], 20.5f);
+}
+
+TEST(CrowdTests, AgentsWalkDownhillAndStayInside) {
+    SceneStore scene;
+    HeightField field = make_field();
+    for (float& h : field.heights) {
+        h *= 20.0f; // Two units per unit along x: steep enough to override the wandering
+    }
+    CrowdSettings settings;
+    Crowd crowd = create_crowd(scene, field, 300, 0, UNIT_BOX, settings);
+    float meanX = 0.0f;
+    for (float x : crowd.xs) {
+        meanX += x / (float)crowd.size();
+    }
+
+    JobSystem jobs({ 1, 1 });
+    for (int step = 0; step < 120; ++step) {
+        crowd_update(crowd, scene, jobs, field, settings, 1.0f / 30.0f);
+    }
+    float movedX = 0.0f;
+    for (uint32_t i = 0; i < crowd.size(); ++i) {
+        movedX += crowd.xs[i] / (float)crowd.size();
+        ASSERT_GE(crowd.xs[i], 0.0f);
+        ASSERT_LE(crowd.xs[i], 64.0f);
+        ASSERT_GE(crowd.zs[i], 0.0f);
+        ASSERT_LE(crowd.zs[i], 64.0f);
+    }
+    EXPECT_LT(movedX, meanX - 2.0f);
+}
+
+TEST(CrowdTests, ResultsDoNotDependOnTheThreadCount) {
+    const HeightField field = make_field();
+    CrowdSettings settings;
+    SceneStore sceneA, sceneB;
+    Crowd a = create_crowd(sceneA, field, 5000, 0, UNIT_BOX, settings);
+    Crowd b = create_crowd(sceneB, field, 5000, 0, UNIT_BOX, settings);
+
+    JobSystem serial({ 0, 1 });
+    JobSystem parallel({ 3, 1 });
+    for (int step = 0; step < 5; ++step) {
+        crowd_update(a, sceneA, serial, field, settings, 1.0f / 60.0f);
+        crowd_update(b, sceneB, parallel, field, settings, 1.0f / 60.0f);
+    }
+    EXPECT_EQ(a.xs, b.xs);
+    EXPECT_EQ(a.zs, b.zs);
+    EXPECT_EQ(scene_update_bounds(sceneB), 5000u);
+}
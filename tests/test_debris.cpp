@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "debris.hpp"
+#include "affine.hpp"
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+    const simd::float3 ORIGIN = { 0.0f, 10.0f, 0.0f };
+    const simd::float3 UP = { 0.0f, 1.0f, 0.0f };
+}
+
+TEST(DebrisTests, SpawnsAtTheRateAndCarriesFractions) {
+    SceneStore scene;
+    DebrisPool pool = create_debris_pool(scene, 1000);
+    DebrisSettings settings;
+    settings.rate = 150.0f;
+
+    uint32_t spawned = 0;
+    for (int i = 0; i < 60; ++i) {
+        spawned += debris_update(pool, scene, settings, 1.0f / 60.0f, ORIGIN, UP, 0, UNIT_BOX);
+    }
+    // 2.5 pieces a frame; the halves add up instead of being lost
+    EXPECT_NEAR((float)spawned, 150.0f, 1.0f);
+    EXPECT_EQ(pool.size(), spawned);
+    EXPECT_EQ(scene.size(), spawned);
+}
+
+TEST(DebrisTests, PiecesExpireAndFall) {
+    SceneStore scene;
+    DebrisPool pool = create_debris_pool(scene, 100);
+    DebrisSettings settings;
+    settings.rate = 10.0f;
+    settings.lifetime = 0.5f;
+    settings.speed = 0.0f;
+    debris_update(pool, scene, settings, 1.0f, ORIGIN, UP, 0, UNIT_BOX);
+    ASSERT_EQ(pool.size(), 10u);
+    const Entity first = pool.entities[0];
+
+    settings.rate = 0.0f;
+    debris_update(pool, scene, settings, 0.25f, ORIGIN, UP, 0, UNIT_BOX);
+    ASSERT_TRUE(scene_alive(scene, first));
+    EXPECT_LT(scene.transforms[scene_index(scene, first)].columns[3].y, ORIGIN.y);
+
+    debris_update(pool, scene, settings, 0.25f, ORIGIN, UP, 0, UNIT_BOX);
+    EXPECT_EQ(pool.size(), 0u);
+    EXPECT_EQ(scene.size(), 0u);
+    EXPECT_FALSE(scene_alive(scene, first));
+}
+
+TEST(DebrisTests, CapacityCapsLivePiecesAndKeepsOtherHandles) {
+    SceneStore scene;
+    const Entity rock = scene_create(scene, 1, UNIT_BOX, affine_matrix(affine_scale(1.0f, 1.0f, 1.0f)), { 1.0f, 0.0f, 0.0f });
+    DebrisPool pool = create_debris_pool(scene, 64);
+    DebrisSettings settings;
+    settings.rate = 1000.0f;
+    settings.lifetime = 0.05f;
+
+    for (int i = 0; i < 200; ++i) {
+        debris_update(pool, scene, settings, 1.0f / 60.0f, ORIGIN, UP, 0, UNIT_BOX);
+        ASSERT_LE(pool.size(), 64u);
+        scene_update_bounds(scene);
+    }
+    ASSERT_TRUE(scene_alive(scene, rock));
+    EXPECT_EQ(scene.meshes[scene_index(scene, rock)], 1u);
+    EXPECT_FLOAT_EQ(scene.colors[scene_index(scene, rock)].x, 1.0f);
+}
+
+TEST(DebrisTests, ChurnDoesNotReallocateTheScene) {
+    SceneStore scene;
+    DebrisPool pool = create_debris_pool(scene, 256);
+    DebrisSettings settings;
+    settings.rate = 4000.0f;
+    settings.lifetime = 0.05f;
+    // Fill to capacity once so every array has reached its steady size
+    for (int i = 0; i < 10; ++i) {
+        debris_update(pool, scene, settings, 1.0f / 60.0f, ORIGIN, UP, 0, UNIT_BOX);
+        scene_update_bounds(scene);
+    }
+
+    const simd::float4x4* transforms = scene.transforms.data();
+    const BvhNode* nodes = scene.bvh.nodes.data();
+    const Entity* entities = pool.entities.data();
+    const size_t bytes = scene_memory_bytes(scene);
+    for (int i = 0; i < 600; ++i) {
+        debris_update(pool, scene, settings, 1.0f / 60.0f, ORIGIN, UP, 0, UNIT_BOX);
+        scene_update_bounds(scene);
+    }
+    EXPECT_EQ(scene.transforms.data(), transforms);
+    EXPECT_EQ(scene.bvh.nodes.data(), nodes);
+    EXPECT_EQ(pool.entities.data(), entities);
+    EXPECT_EQ(scene_memory_bytes(scene), bytes);
+}
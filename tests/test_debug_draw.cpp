@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "debug_draw.hpp"
+#include "camera.hpp"
+
+#include <cmath>
+
+TEST(DebugDrawTests, EdgesJoinCornersOneAxisApart) {
+    uint32_t uses[DEBUG_SHAPE_CORNERS] = {};
+    for (uint32_t v = 0; v < DEBUG_SHAPE_VERTICES; v += 2) {
+        const uint32_t a = debug_shape_corner(v);
+        const uint32_t b = debug_shape_corner(v + 1);
+        const uint32_t diff = a ^ b;
+        EXPECT_TRUE(diff == 1 || diff == 2 || diff == 4) << a << " " << b;
+        ++uses[a];
+        ++uses[b];
+    }
+    // Three edges meet at every corner of a box
+    for (uint32_t c = 0; c < DEBUG_SHAPE_CORNERS; ++c) {
+        EXPECT_EQ(uses[c], 3u);
+    }
+}
+
+TEST(DebugDrawTests, BoxCornersFollowTheirBits) {
+    DebugDraw draw;
+    debug_draw_box(draw, { { -1.0f, 2.0f, -3.0f }, { 4.0f, 5.0f, 6.0f } }, debug_lod_color(0));
+    ASSERT_EQ(draw.shapes.size(), 1u);
+    const DebugShape& shape = draw.shapes[0];
+    EXPECT_EQ(shape.corners[0].x, -1.0f);
+    EXPECT_EQ(shape.corners[0].y, 2.0f);
+    EXPECT_EQ(shape.corners[0].z, -3.0f);
+    EXPECT_EQ(shape.corners[5].x, 4.0f);
+    EXPECT_EQ(shape.corners[5].y, 2.0f);
+    EXPECT_EQ(shape.corners[5].z, 6.0f);
+
+    debug_draw_clear(draw);
+    EXPECT_TRUE(draw.shapes.empty());
+    for (uint32_t i = 0; i < DEBUG_DRAW_MAX_SHAPES + 10; ++i) {
+        debug_draw_box(draw, { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } }, DEBUG_PENDING_COLOR);
+    }
+    EXPECT_EQ(draw.shapes.size(), DEBUG_DRAW_MAX_SHAPES);
+}
+
+TEST(DebugDrawTests, FrustumReachesTheDistanceInBothDepthConventions) {
+    for (bool reverseZ : { false, true }) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = { 0.0f, 10.0f, 0.0f };
+        update_camera_view(cam);
+        DebugDraw draw;
+        debug_draw_frustum(draw, cam.projectionMatrix * cam.viewMatrix, cam.position, 50.0f, DEBUG_FRUSTUM_COLOR);
+        ASSERT_EQ(draw.shapes.size(), 1u);
+        const DebugShape& shape = draw.shapes[0];
+        const simd::float3 forward = camera_forward(cam.yaw, cam.pitch);
+        for (uint32_t i = 0; i < 4; ++i) {
+            EXPECT_EQ(shape.corners[i].y, cam.position.y);
+            EXPECT_NEAR(simd::dot(shape.corners[i + 4] - cam.position, forward), 50.0f, 1e-2f) << reverseZ;
+        }
+        // Corner 7 is top right, corner 4 bottom left
+        EXPECT_GT(shape.corners[7].y, shape.corners[4].y);
+        const simd::float3 right = simd::cross(forward, simd::float3{ 0.0f, 1.0f, 0.0f });
+        EXPECT_GT(simd::dot(shape.corners[7] - shape.corners[4], right), 0.0f);
+    }
+}
+
+TEST(DebugDrawTests, CullResultsMatchTheSceneCulling) {
+    Camera cam = make_camera(1280, 720);
+    cam.position = { 0.0f, 0.0f, 0.0f };
+    update_camera_view(cam);
+    const Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+    const simd::float3 forward = camera_forward(cam.yaw, cam.pitch);
+    const simd::float3 ahead = forward * 20.0f;
+    const simd::float3 far = forward * 80.0f;
+    const simd::float3 behind = forward * -20.0f;
+    const simd::float3 one = { 1.0f, 1.0f, 1.0f };
+
+    EXPECT_EQ(debug_cull(frustum, cam.position, 50.0f, { ahead - one, ahead + one }), DebugCull::Visible);
+    EXPECT_EQ(debug_cull(frustum, cam.position, 50.0f, { far - one, far + one }), DebugCull::FogCulled);
+    EXPECT_EQ(debug_cull(frustum, cam.position, INFINITY, { far - one, far + one }), DebugCull::Visible);
+    EXPECT_EQ(debug_cull(frustum, cam.position, 50.0f, { behind - one, behind + one }), DebugCull::FrustumCulled);
+}
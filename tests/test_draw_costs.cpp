@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "draw_costs.hpp"
+
+TEST(DrawCostsTests, SamplesTheFirstFramesOfEachPeriod) {
+    DrawCostSettings settings;
+    settings.sampledFrames = 2;
+    settings.periodFrames = 10;
+    EXPECT_TRUE(draw_costs_sample_frame(settings, 20));
+    EXPECT_TRUE(draw_costs_sample_frame(settings, 21));
+    EXPECT_FALSE(draw_costs_sample_frame(settings, 22));
+    EXPECT_FALSE(draw_costs_sample_frame(settings, 29));
+}
+
+TEST(DrawCostsTests, ObjectNamesRoundTripTheirIndices) {
+    EXPECT_EQ(draw_object_name(make_chunk_draw_object(3, -2)), "chunk (3, -2)");
+    EXPECT_EQ(draw_object_name(make_mesh_draw_object(5, 1)), "mesh 5 lod 1");
+    EXPECT_EQ(draw_object_name(make_draw_object(DrawObjectKind::Skinned, 7)), "creature 7");
+    EXPECT_EQ(draw_object_name(0), "untagged");
+}
+
+TEST(DrawCostsTests, WindowKeepsTheMostExpensivePerFrame) {
+    DrawCosts costs;
+    costs.settings.sampledFrames = 2;
+    costs.settings.topCount = 2;
+    const uint32_t terrain = make_chunk_draw_object(0, 0);
+    const uint32_t rock = make_mesh_draw_object(1, 0);
+    const uint32_t tree = make_mesh_draw_object(2, 0);
+    const DrawTag tags[] = { { terrain, 0 }, { rock, 1 }, { tree, 1 }, { terrain, 0 } };
+    const float ms[] = { 1.0f, 0.5f, 0.25f, 3.0f };
+
+    std::vector<DrawCost> objects, materials;
+    draw_costs_record_frame(costs, tags, ms, 4);
+    EXPECT_EQ(draw_costs_top(costs, objects, materials), 0u);
+    EXPECT_TRUE(objects.empty());
+
+    draw_costs_record_frame(costs, tags, ms, 4);
+    EXPECT_EQ(draw_costs_top(costs, objects, materials), 1u);
+    ASSERT_EQ(objects.size(), 2u);
+    EXPECT_EQ(objects[0].id, terrain);
+    EXPECT_FLOAT_EQ(objects[0].ms, 4.0f);
+    EXPECT_EQ(objects[0].draws, 2u);
+    EXPECT_EQ(objects[1].id, rock);
+    ASSERT_EQ(materials.size(), 2u);
+    EXPECT_EQ(materials[0].id, 0u);
+    EXPECT_FLOAT_EQ(materials[1].ms, 0.75f);
+}
+
+TEST(DrawCostsTests, UntimedDrawsAreLeftOut) {
+    DrawCosts costs;
+    costs.settings.sampledFrames = 1;
+    const DrawTag tags[] = { { 1, 0 }, { 2, 0 } };
+    const float ms[] = { -1.0f, 2.0f };
+    draw_costs_record_frame(costs, tags, ms, 2);
+
+    std::vector<DrawCost> objects, materials;
+    draw_costs_top(costs, objects, materials);
+    ASSERT_EQ(objects.size(), 1u);
+    EXPECT_EQ(objects[0].id, 2u);
+    EXPECT_EQ(materials[0].draws, 1u);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "draw_sort.hpp"
+
+#include <algorithm>
+#include <random>
+
+TEST(DrawSortTests, KeyOrdersPipelineBeforeOtherState) {
+    EXPECT_LT(make_draw_key(0, 15, 0xFFFFF, 0xFFFFFFFF), make_draw_key(1, 0, 0, 0));
+    EXPECT_LT(make_draw_key(2, 0, 0xFFFFF, 0xFFFFFFFF), make_draw_key(2, 1, 0, 0));
+    EXPECT_LT(make_draw_key(2, 1, 3, 0xFFFFFFFF), make_draw_key(2, 1, 4, 0));
+    EXPECT_EQ(make_draw_key(2, 1, 3, 7), make_draw_key(2 + (1u << DRAW_KEY_PIPELINE_BITS), 1, 3, 7));
+}
+
+TEST(DrawSortTests, DepthKeysOrderLikeTheDistances) {
+    EXPECT_EQ(draw_depth_key(0.0f), 0u);
+    EXPECT_EQ(draw_depth_key(-5.0f), 0u);
+    EXPECT_LT(draw_depth_key(0.5f), draw_depth_key(1.0f));
+    EXPECT_LT(draw_depth_key(1.0f), draw_depth_key(1.001f));
+    EXPECT_LT(draw_depth_key(999.0f), draw_depth_key(1000.0f));
+    EXPECT_LT(draw_depth_key(1000.0f), 1u << DRAW_KEY_MATERIAL_BITS);
+
+    // Nearer draws of one pipeline sort first whatever their vertex buffers
+    EXPECT_LT(make_draw_key(1, 0, draw_depth_key(10.0f), 0xFFFFFFFF), make_draw_key(1, 0, draw_depth_key(20.0f), 0));
+    EXPECT_LT(make_draw_key(0, 0, draw_depth_key(500.0f), 0), make_draw_key(1, 0, draw_depth_key(1.0f), 0));
+}
+
+TEST(DrawSortTests, VisibleListsSortNearestFirst) {
+    CullBounds bounds;
+    const float xs[] = { 30.0f, -10.0f, 5.0f, 10.0f, 20.0f };
+    for (float x : xs) {
+        bounds.centerX.push_back(x);
+        bounds.centerY.push_back(0.0f);
+        bounds.centerZ.push_back(0.0f);
+        bounds.extentX.push_back(1.0f);
+        bounds.extentY.push_back(1.0f);
+        bounds.extentZ.push_back(1.0f);
+    }
+    uint32_t visible[] = { 0, 1, 3, 4, 2 };
+    uint64_t scratch[5];
+    sort_front_to_back(bounds, simd::float3{ 0.0f, 0.0f, 0.0f }, visible, 5, scratch);
+    // Boxes 1 and 3 are equally far, so the lower index goes first
+    const uint32_t expected[] = { 2, 1, 3, 4, 0 };
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(visible[i], expected[i]);
+    }
+}
+
+TEST(DrawSortTests, RadixSortMatchesStableSort) {
+    std::mt19937 rng(7);
+    std::vector<DrawPacket> packets(5000);
+    for (uint32_t i = 0; i < packets.size(); ++i) {
+        packets[i].key = make_draw_key(rng() % 3, rng() % 2, rng() % 40, rng() % 200);
+        packets[i].command = i;
+    }
+    std::vector<DrawPacket> expected = packets;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+    std::vector<DrawPacket> scratch;
+    radix_sort_draws(packets, scratch);
+    ASSERT_EQ(packets.size(), expected.size());
+    for (size_t i = 0; i < packets.size(); ++i) {
+        EXPECT_EQ(packets[i].key, expected[i].key);
+        EXPECT_EQ(packets[i].command, expected[i].command);
+    }
+}
+
+TEST(DrawSortTests, SkipsPassesWithoutChangingTheResult) {
+    // Only the top byte differs, so a single pass does all the work
+    std::vector<DrawPacket> packets = { { 3ull << 56, 0 }, { 1ull << 56, 1 }, { 3ull << 56, 2 }, { 0, 3 } };
+    std::vector<DrawPacket> scratch;
+    radix_sort_draws(packets, scratch);
+    EXPECT_EQ(packets[0].command, 3u);
+    EXPECT_EQ(packets[1].command, 1u);
+    EXPECT_EQ(packets[2].command, 0u);
+    EXPECT_EQ(packets[3].command, 2u);
+}
+
+TEST(DrawSortTests, SlicesCoverTheListInOrder) {
+    DrawSlice slices[4];
+    ASSERT_EQ(slice_draws(1000, 4, 64, slices), 4u);
+    uint32_t next = 0;
+    for (const auto& slice : slices) {
+        EXPECT_EQ(slice.begin, next);
+        EXPECT_EQ(slice.end - slice.begin, 250u);
+        next = slice.end;
+    }
+    EXPECT_EQ(next, 1000u);
+
+    ASSERT_EQ(slice_draws(10, 3, 1, slices), 3u);
+    EXPECT_EQ(slices[0].end - slices[0].begin, 4u);
+    EXPECT_EQ(slices[2].end, 10u);
+}
+
+TEST(DrawSortTests, SmallListsAreNotSplit) {
+    DrawSlice slices[8];
+    EXPECT_EQ(slice_draws(0, 4, 64, slices), 0u);
+    EXPECT_EQ(slice_draws(100, 8, 64, slices), 1u);
+    EXPECT_EQ(slice_draws(200, 8, 64, slices), 3u);
+    EXPECT_EQ(slice_draws(200, 0, 64, slices), 1u);
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "fog.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    BoundingBox box_at(float x, float y, float z, float halfSize = 1.0f) {
+        return { { x - halfSize, y - halfSize, z - halfSize }, { x + halfSize, y + halfSize, z + halfSize } };
+    }
+}
+
+TEST(FogTests, VisibilityFallsWithDistance) {
+    FogSettings fog;
+    EXPECT_FLOAT_EQ(fog_visibility(fog, 0.0f), 1.0f);
+    float previous = 1.0f;
+    for (float d = 8.0f; d <= 160.0f; d += 8.0f) {
+        const float visibility = fog_visibility(fog, d);
+        EXPECT_LE(visibility, previous) << "at " << d;
+        previous = visibility;
+    }
+    EXPECT_FLOAT_EQ(fog_visibility(fog, fog.fadeEnd), 0.0f);
+
+    // Without the fade only the exponential term is left
+    fog.fadeEnd = INFINITY;
+    const float d = fog.density * 100.0f;
+    EXPECT_NEAR(fog_visibility(fog, 100.0f), expf(-d * d), 1e-6f);
+}
+
+TEST(FogTests, CullDistanceHidesEverythingBeyondIt) {
+    FogSettings fog;
+    fog.density = 0.03f;
+    fog.fadeEnd = INFINITY;
+    const float distance = fog_cull_distance(fog);
+    EXPECT_NEAR(fog_visibility(fog, distance), FOG_CULL_VISIBILITY, 1e-5f);
+    EXPECT_LT(fog_visibility(fog, distance + 1.0f), FOG_CULL_VISIBILITY);
+
+    // The fade ends first
+    fog.fadeStart = 40.0f;
+    fog.fadeEnd = 50.0f;
+    EXPECT_FLOAT_EQ(fog_cull_distance(fog), 50.0f);
+
+    // Neither term: nothing is ever hidden
+    fog.density = 0.0f;
+    fog.fadeEnd = INFINITY;
+    EXPECT_TRUE(std::isinf(fog_cull_distance(fog)));
+}
+
+TEST(FogTests, CullKeepsBoxesReachingIntoTheFog) {
+    const simd::float3 eye = { 0.0f, 0.0f, 0.0f };
+    const std::vector<BoundingBox> boxes = {
+        box_at(0.0f, 0.0f, -10.0f),     // Near
+        box_at(0.0f, 0.0f, -60.0f),     // Past the limit
+        box_at(50.5f, 0.0f, 0.0f),      // Nearest face exactly at the limit
+        box_at(0.0f, 0.0f, 0.0f),       // Around the eye
+        box_at(40.0f, 40.0f, 0.0f),     // Diagonal, ~55 away
+    };
+    CullBounds bounds;
+    for (const BoundingBox& box : boxes) {
+        cull_bounds_add(bounds, box);
+    }
+
+    std::vector<uint32_t> visible = { 0, 1, 2, 3, 4 };
+    const size_t count = fog_cull(bounds, eye, 49.5f, visible.data(), visible.size());
+    ASSERT_EQ(count, 3u);
+    EXPECT_EQ(visible[0], 0u);
+    EXPECT_EQ(visible[1], 2u);
+    EXPECT_EQ(visible[2], 3u);
+    // The dropped ones follow
+    EXPECT_EQ(std::min(visible[3], visible[4]), 1u);
+    EXPECT_EQ(std::max(visible[3], visible[4]), 4u);
+
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        const bool kept = std::find(visible.begin(), visible.begin() + count, (uint32_t)i) != visible.begin() + count;
+        EXPECT_EQ(kept, box_distance(boxes[i], eye) <= 49.5f) << "box " << i;
+    }
+
+    // An infinite limit keeps every box
+    visible = { 0, 1, 2, 3, 4 };
+    EXPECT_EQ(fog_cull(bounds, eye, INFINITY, visible.data(), visible.size()), 5u);
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include "foliage.hpp"
+#include "height_field.hpp"
+
+#include <vector>
+
+namespace {
+    const float CHUNK_SIZE = 32.0f;
+    const int CHUNK_RESOLUTION = 33;
+
+    std::vector<FoliageInstance> scatter(const FoliageSettings& settings, ChunkKey key) {
+        std::vector<FoliageInstance> instances;
+        for (uint32_t z = 0; z < settings.cellsPerEdge; ++z) {
+            for (uint32_t x = 0; x < settings.cellsPerEdge; ++x) {
+                FoliageInstance instance;
+                if (foliage_candidate(settings, key, x, z, CHUNK_SIZE, CHUNK_RESOLUTION, instance)) {
+                    instances.push_back(instance);
+                }
+            }
+        }
+        return instances;
+    }
+}
+
+TEST(FoliageTests, ScatterIsDeterministicPerSeed) {
+    FoliageSettings settings;
+    std::vector<FoliageInstance> a = scatter(settings, { 1, -2 });
+    std::vector<FoliageInstance> b = scatter(settings, { 1, -2 });
+    ASSERT_FALSE(a.empty());
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(a[i].position.x, b[i].position.x);
+        EXPECT_EQ(a[i].position.z, b[i].position.z);
+        EXPECT_EQ(a[i].kind, b[i].kind);
+    }
+
+    settings.seed++;
+    std::vector<FoliageInstance> c = scatter(settings, { 1, -2 });
+    size_t same = 0;
+    for (size_t i = 0; i < std::min(a.size(), c.size()); ++i) {
+        same += a[i].position.x == c[i].position.x;
+    }
+    EXPECT_LT(same, a.size() / 10);
+}
+
+TEST(FoliageTests, CandidatesStayInTheirCell) {
+    FoliageSettings settings;
+    settings.treeDensity = 1.0f;
+    settings.treeline = 1e9f;
+    const ChunkKey key = { -1, 3 };
+    const float cellSize = CHUNK_SIZE / settings.cellsPerEdge;
+    for (uint32_t z = 0; z < settings.cellsPerEdge; z += 7) {
+        for (uint32_t x = 0; x < settings.cellsPerEdge; x += 5) {
+            FoliageInstance instance;
+            if (!foliage_candidate(settings, key, x, z, CHUNK_SIZE, CHUNK_RESOLUTION, instance)) {
+                continue;
+            }
+            const float cellX = key.x * CHUNK_SIZE + x * cellSize;
+            const float cellZ = key.z * CHUNK_SIZE + z * cellSize;
+            EXPECT_GE(instance.position.x, cellX);
+            EXPECT_LE(instance.position.x, cellX + cellSize);
+            EXPECT_GE(instance.position.z, cellZ);
+            EXPECT_LE(instance.position.z, cellZ + cellSize);
+            EXPECT_GT(instance.position.w, 0.0f);
+        }
+    }
+}
+
+TEST(FoliageTests, InstancesSitOnTheHeightField) {
+    // The field's samples coincide with the chunk vertices, so both interpolate the same surface
+    HeightField field = create_height_field(-32.0f, -32.0f, 65, 65, CHUNK_SIZE / (CHUNK_RESOLUTION - 1));
+    FoliageSettings settings;
+    for (ChunkKey key : { ChunkKey{ -1, -1 }, ChunkKey{ 0, -1 }, ChunkKey{ 0, 0 } }) {
+        std::vector<FoliageInstance> instances = scatter(settings, key);
+        ASSERT_FALSE(instances.empty());
+        for (const FoliageInstance& instance : instances) {
+            EXPECT_NEAR(instance.position.y, height_field_height(field, instance.position.x, instance.position.z), 1e-4f);
+            if (instance.kind == FoliageKind::Tree) {
+                EXPECT_LE(instance.position.y, settings.treeline);
+            }
+        }
+    }
+}
+
+TEST(FoliageTests, DensityControlsWhatIsPlaced) {
+    FoliageSettings settings;
+    settings.treeDensity = 0.0f;
+    settings.rockDensity = 0.0f;
+    EXPECT_TRUE(scatter(settings, { 0, 0 }).empty());
+
+    settings.rockDensity = 0.2f;
+    std::vector<FoliageInstance> rocks = scatter(settings, { 0, 0 });
+    ASSERT_FALSE(rocks.empty());
+    for (const FoliageInstance& instance : rocks) {
+        EXPECT_EQ(instance.kind, FoliageKind::Rock);
+    }
+    // Roughly one cell in five
+    const float fraction = (float)rocks.size() / (settings.cellsPerEdge * settings.cellsPerEdge);
+    EXPECT_NEAR(fraction, 0.2f, 0.03f);
+}
+
+TEST(FoliageTests, BiomesScaleTheDensities) {
+    FoliageSettings settings;
+    settings.treeline = 1e9f;
+    BiomeMap biomes;
+    biomes.cellsPerEdge = 4;
+    biomes.ids.assign(25, (uint8_t)Biome::Desert);
+
+    size_t trees = 0, rocks = 0, desertRocks = 0;
+    for (uint32_t z = 0; z < settings.cellsPerEdge; ++z) {
+        for (uint32_t x = 0; x < settings.cellsPerEdge; ++x) {
+            FoliageInstance instance;
+            if (foliage_candidate(settings, { 1, -2 }, x, z, CHUNK_SIZE, CHUNK_RESOLUTION, instance)) {
+                (instance.kind == FoliageKind::Tree ? trees : rocks)++;
+            }
+            if (foliage_candidate(settings, { 1, -2 }, x, z, CHUNK_SIZE, CHUNK_RESOLUTION, instance, {}, &biomes)) {
+                EXPECT_EQ(instance.kind, FoliageKind::Rock);
+                ++desertRocks;
+            }
+        }
+    }
+    ASSERT_GT(trees, 0u);
+    EXPECT_GT(desertRocks, rocks);
+}
+
+TEST(FoliageTests, LodFollowsDistance) {
+    FoliageSettings settings;
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Tree, 10.0f), FoliageLod::Full);
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Tree, settings.treeDetailDistance + 1.0f), FoliageLod::Impostor);
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Tree, settings.treeDrawDistance + 1.0f), FoliageLod::Hidden);
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Rock, 10.0f), FoliageLod::Full);
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Rock, settings.rockDetailDistance + 1.0f), FoliageLod::Impostor);
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Rock, settings.rockDrawDistance + 1.0f), FoliageLod::Hidden);
+}
+
+TEST(FoliageTests, ImpostorFadesInBeforeTheDetailDistance) {
+    FoliageSettings settings;
+    const float start = settings.treeDetailDistance - settings.impostorFadeDistance;
+    EXPECT_EQ(foliage_impostor_fade(settings, FoliageKind::Tree, start - 1.0f), 0.0f);
+    EXPECT_FLOAT_EQ(foliage_impostor_fade(settings, FoliageKind::Tree, start + 0.5f * settings.impostorFadeDistance),
+                    0.5f);
+    EXPECT_EQ(foliage_impostor_fade(settings, FoliageKind::Tree, settings.treeDetailDistance), 1.0f);
+    EXPECT_EQ(foliage_impostor_fade(settings, FoliageKind::Rock, settings.rockDetailDistance + 1.0f), 1.0f);
+    // Fully faded out where the impostor level begins
+    EXPECT_EQ(foliage_lod(settings, FoliageKind::Tree, settings.treeDetailDistance), FoliageLod::Impostor);
+}
+
+TEST(FoliageTests, WindBendsCrownsAlongTheWind) {
+    FoliageInstance tree;
+    tree.position = { 3.0f, 10.0f, -2.0f, 1.5f };
+    tree.yaw = 0.7f;
+    tree.kind = FoliageKind::Tree;
+    FoliageInstance rock = tree;
+    rock.kind = FoliageKind::Rock;
+
+    const WindSettings settings;
+    const simd::float4 wind = foliage_wind(settings, 0.4);
+    const simd::float4 sway = foliage_sway_params(tree);
+    // The base stays rooted and rocks never move
+    const simd::float3 base = foliage_sway(wind, sway, { 3.0f, 10.0f, -2.0f });
+    EXPECT_FLOAT_EQ(base.x, 0.0f);
+    EXPECT_FLOAT_EQ(base.z, 0.0f);
+    const simd::float3 rockTop = foliage_sway(wind, foliage_sway_params(rock), { 3.0f, 11.0f, -2.0f });
+    EXPECT_FLOAT_EQ(rockTop.x, 0.0f);
+
+    // The crown leans downwind, further than the trunk
+    const simd::float3 trunk = foliage_sway(wind, sway, { 3.0f, 11.0f, -2.0f });
+    const simd::float3 crown = foliage_sway(wind, sway, { 3.0f, 14.0f, -2.0f });
+    EXPECT_FLOAT_EQ(crown.y, 0.0f);
+    EXPECT_GT(crown.x, trunk.x);
+    EXPECT_GT(trunk.x, 0.0f);
+    EXPECT_NEAR(crown.z / crown.x, settings.direction.y / settings.direction.x, 1e-4f);
+}
+
+TEST(FoliageTests, WindIsContinuousAcrossTheAngleWrap) {
+    WindSettings settings;
+    settings.frequency = 1.0f;
+    FoliageInstance tree;
+    tree.position = { 0.0f, 0.0f, 0.0f, 1.0f };
+    tree.yaw = 2.0f;
+    tree.kind = FoliageKind::Tree;
+    const simd::float4 sway = foliage_sway_params(tree);
+    const simd::float3 top = { 0.0f, 4.0f, 0.0f };
+
+    // A long way into the run, just before and just after the angle wraps
+    const double wrap = 1000.0 * FOLIAGE_WIND_PERIOD;
+    const simd::float4 before = foliage_wind(settings, wrap - 1e-4);
+    const simd::float4 after = foliage_wind(settings, wrap + 1e-4);
+    EXPECT_GT(before.z, after.z);
+    EXPECT_LT(after.z, 1e-2f);
+    EXPECT_NEAR(foliage_sway(before, sway, top).x, foliage_sway(after, sway, top).x, 1e-4f);
+}
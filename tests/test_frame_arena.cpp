@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "frame_arena.hpp"
+#include "heap_allocations.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+TEST(FrameArenaTests, AllocationsAreAlignedAndDisjoint) {
+    FrameArena arena(1024);
+    uint8_t* bytes = static_cast<uint8_t*>(arena.allocate(3, 1));
+    double* values = arena.allocate_array<double>(4);
+    uint32_t* indices = arena.allocate_array<uint32_t>(8);
+    EXPECT_EQ((uintptr_t)values % alignof(double), 0u);
+    EXPECT_GE((uint8_t*)values, bytes + 3);
+    EXPECT_GE((uint8_t*)indices, (uint8_t*)(values + 4));
+    EXPECT_GE(arena.used(), 3u + 4 * sizeof(double) + 8 * sizeof(uint32_t));
+
+    arena.reset();
+    EXPECT_EQ(arena.used(), 0u);
+    EXPECT_EQ(arena.allocate(3, 1), bytes); // Reset hands the same memory out again
+}
+
+TEST(FrameArenaTests, OverflowGrowsTheArenaAtReset) {
+    FrameArena arena(256);
+    for (int i = 0; i < 10; ++i) {
+        uint32_t* values = arena.allocate_array<uint32_t>(64);
+        values[63] = (uint32_t)i; // Overflow blocks are usable memory
+    }
+    EXPECT_GT(arena.capacity(), 256u);
+    const size_t peak = arena.peak();
+    EXPECT_GE(peak, 10 * 64 * sizeof(uint32_t));
+
+    // After the reset one block holds a frame as large as the last one
+    arena.reset();
+    const size_t capacity = arena.capacity();
+    EXPECT_GE(capacity, peak);
+    for (int i = 0; i < 10; ++i) {
+        arena.allocate_array<uint32_t>(64);
+    }
+    EXPECT_EQ(arena.capacity(), capacity);
+}
+
+TEST(FrameArenaTests, ContainersAllocateFromTheArena) {
+    FrameArena arena(64 * 1024);
+    {
+        ArenaVector<int> values{ ArenaAllocator<int>(arena) };
+        for (int i = 0; i < 1000; ++i) {
+            values.push_back(i);
+        }
+        EXPECT_EQ(values[999], 999);
+
+        std::unordered_set<int, std::hash<int>, std::equal_to<int>, ArenaAllocator<int>> keys(
+            64, std::hash<int>(), std::equal_to<int>(), ArenaAllocator<int>(arena));
+        keys.insert(7);
+        keys.insert(7);
+        EXPECT_EQ(keys.size(), 1u);
+    }
+    EXPECT_GE(arena.used(), 1000 * sizeof(int));
+    EXPECT_LE(arena.capacity(), 64u * 1024u);
+}
+
+TEST(FrameArenaTests, FramesAndThreadsHaveTheirOwnArenas) {
+    FrameArenas arenas = create_frame_arenas(3, 2, 1024);
+    ASSERT_EQ(arenas.arenas.size(), 6u);
+
+    frame_arenas_begin_frame(arenas, 0);
+    FrameArena& render = frame_arena(arenas, 0);
+    FrameArena& worker = frame_arena(arenas, 1);
+    EXPECT_NE(&render, &worker);
+    render.allocate(100);
+
+    // The next frames use other arenas, and leave frame 0's data alone
+    frame_arenas_begin_frame(arenas, 1);
+    EXPECT_NE(&frame_arena(arenas, 0), &render);
+    EXPECT_GT(render.used(), 0u);
+
+    // Frame 3 takes frame 0's turn and resets its arenas
+    frame_arenas_begin_frame(arenas, 3);
+    EXPECT_EQ(&frame_arena(arenas, 0), &render);
+    EXPECT_EQ(render.used(), 0u);
+    EXPECT_GE(frame_arenas_peak(arenas), 100u);
+}
+
+TEST(FrameArenaTests, HeapAllocationsAreCountedPerCall) {
+    static std::vector<std::unique_ptr<int>> kept; // Keeps the allocations observable
+    kept.reserve(2);
+    EXPECT_EQ(count_heap_allocations([] {
+        kept.push_back(std::make_unique<int>(1));
+        kept.push_back(std::make_unique<int>(2));
+    }), 2u);
+    kept.clear();
+
+    FrameArena arena(64 * 1024);
+    EXPECT_EQ(count_heap_allocations([&] {
+        ArenaVector<int> values{ ArenaAllocator<int>(arena) };
+        for (int i = 0; i < 1000; ++i) {
+            values.push_back(i);
+        }
+    }), 0u);
+}
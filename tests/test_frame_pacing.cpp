@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "frame_pacing.hpp"
+
+namespace {
+    constexpr double REFRESH_120HZ = 1.0 / 120.0;
+}
+
+TEST(FramePacingTests, IntervalIsAWholeNumberOfRefreshes) {
+    FramePacingSettings settings;
+    EXPECT_DOUBLE_EQ(frame_pacing_interval(settings, REFRESH_120HZ), REFRESH_120HZ);
+
+    settings.mode = PresentMode::FixedRate;
+    settings.targetFps = 60.0f;
+    EXPECT_NEAR(frame_pacing_interval(settings, REFRESH_120HZ), 2.0 * REFRESH_120HZ, 1e-9);
+    settings.targetFps = 50.0f;
+    EXPECT_NEAR(frame_pacing_interval(settings, REFRESH_120HZ), 3.0 * REFRESH_120HZ, 1e-9);
+    settings.targetFps = 240.0f;
+    EXPECT_NEAR(frame_pacing_interval(settings, REFRESH_120HZ), REFRESH_120HZ, 1e-9);
+
+    settings.mode = PresentMode::Uncapped;
+    EXPECT_EQ(frame_pacing_interval(settings, REFRESH_120HZ), 0.0);
+}
+
+TEST(FramePacingTests, SnapsJitteryDeltasToTheInterval) {
+    FramePacingSettings settings;
+    FramePacer pacer;
+    EXPECT_EQ(frame_pacer_tick(pacer, settings, REFRESH_120HZ, 10.0), 0.0f);
+
+    const double jitter[] = { 0.0011, -0.0009, 0.0004, -0.0012, 0.0007 };
+    double now = 10.0;
+    for (double j : jitter) {
+        now += REFRESH_120HZ + j;
+        EXPECT_NEAR(frame_pacer_tick(pacer, settings, REFRESH_120HZ, now), REFRESH_120HZ, 1e-6);
+    }
+}
+
+TEST(FramePacingTests, MissedRefreshesAdvanceByWholeIntervalsWithoutDrift) {
+    FramePacingSettings settings;
+    FramePacer pacer;
+    frame_pacer_tick(pacer, settings, REFRESH_120HZ, 0.0);
+
+    double now = 0.0;
+    double simulated = 0.0;
+    for (int i = 0; i < 100; ++i) {
+        now += (i % 10 == 0 ? 2.3 : 1.1) * REFRESH_120HZ;
+        simulated += frame_pacer_tick(pacer, settings, REFRESH_120HZ, now);
+    }
+    EXPECT_NEAR(simulated, now, REFRESH_120HZ);
+}
+
+TEST(FramePacingTests, UncappedSmoothsAndClampsStalls) {
+    FramePacingSettings settings;
+    settings.mode = PresentMode::Uncapped;
+    FramePacer pacer;
+    frame_pacer_tick(pacer, settings, REFRESH_120HZ, 0.0);
+    EXPECT_FLOAT_EQ(frame_pacer_tick(pacer, settings, REFRESH_120HZ, 0.004), 0.004f);
+
+    // A one-second stall is clamped before it is averaged in
+    float dt = frame_pacer_tick(pacer, settings, REFRESH_120HZ, 1.004);
+    EXPECT_NEAR(dt, 0.004f + (settings.maxDt - 0.004f) * settings.smoothing, 1e-6f);
+    EXPECT_LE(dt, settings.maxDt);
+}
+
+TEST(FramePacingTests, VsyncTimeIsTheLastRefreshBeforeNow) {
+    EXPECT_EQ(frame_vsync_time(-1.0, REFRESH_120HZ, 5.0), 5.0);
+    EXPECT_DOUBLE_EQ(frame_vsync_time(5.0, REFRESH_120HZ, 5.0), 5.0);
+    EXPECT_NEAR(frame_vsync_time(5.0, REFRESH_120HZ, 5.0 + 2.5 * REFRESH_120HZ), 5.0 + 2.0 * REFRESH_120HZ, 1e-9);
+    // A refresh reported after now, e.g. the link's next output time, is walked back
+    EXPECT_NEAR(frame_vsync_time(5.0 + REFRESH_120HZ, REFRESH_120HZ, 5.0 + 0.5 * REFRESH_120HZ), 5.0, 1e-9);
+}
+
+TEST(FramePacingTests, GameClockScalesAndPauses) {
+    GameClock clock;
+    GameClockSettings settings;
+    EXPECT_FLOAT_EQ(game_clock_advance(clock, settings, 0.5f), 0.5f);
+    settings.timeScale = 0.25f;
+    EXPECT_FLOAT_EQ(game_clock_advance(clock, settings, 0.5f), 0.125f);
+    settings.paused = true;
+    EXPECT_EQ(game_clock_advance(clock, settings, 0.5f), 0.0f);
+    EXPECT_DOUBLE_EQ(clock.time, 0.625);
+
+    // Whole days of 120 Hz frames add up without drifting
+    GameClock day;
+    settings = GameClockSettings{};
+    for (int i = 0; i < 120 * 86400; ++i) {
+        game_clock_advance(day, settings, 0.0078125f);
+    }
+    EXPECT_DOUBLE_EQ(day.time, 0.0078125 * 120 * 86400);
+}
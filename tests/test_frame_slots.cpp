@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "frame_slots.hpp"
+
+#include <deque>
+#include <random>
+
+namespace {
+    // A FrameRing's slot bookkeeping, with the GPU's frames in flight kept as a queue
+    struct FakeRing {
+        uint32_t count;
+        uint32_t index;
+        std::deque<uint32_t> inFlight;
+
+        explicit FakeRing(uint32_t slots) : count(slots), index(frame_slot_initial(slots)) {}
+
+        bool slot_free() const { return inFlight.size() < count; }
+        bool in_flight(uint32_t slot) const {
+            for (uint32_t busy : inFlight) {
+                if (busy == slot) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+}
+
+TEST(FrameSlotTests, FramesTakeTheSlotsInTurn) {
+    uint32_t index = frame_slot_initial(3);
+    EXPECT_EQ(frame_slot_begin(index, 3), 0u);
+    EXPECT_EQ(frame_slot_begin(index, 3), 1u);
+    EXPECT_EQ(frame_slot_begin(index, 3), 2u);
+    EXPECT_EQ(frame_slot_begin(index, 3), 0u);
+}
+
+TEST(FrameSlotTests, AbortedFrameHandsItsSlotToTheNextFrame) {
+    FakeRing ring(3);
+    // Slots 0 and 1 are still being read when the frame on slot 2 is abandoned
+    ring.inFlight.push_back(frame_slot_begin(ring.index, ring.count));
+    ring.inFlight.push_back(frame_slot_begin(ring.index, ring.count));
+    EXPECT_EQ(frame_slot_begin(ring.index, ring.count), 2u);
+    frame_slot_abort(ring.index, ring.count);
+
+    const uint32_t next = frame_slot_begin(ring.index, ring.count);
+    EXPECT_EQ(next, 2u);
+    EXPECT_FALSE(ring.in_flight(next));
+
+    // Aborting again with the ring wrapped round lands back on the slot just given up
+    ring.inFlight.push_back(next);
+    ring.inFlight.pop_front();
+    EXPECT_EQ(frame_slot_begin(ring.index, ring.count), 0u);
+    frame_slot_abort(ring.index, ring.count);
+    EXPECT_EQ(frame_slot_begin(ring.index, ring.count), 0u);
+}
+
+TEST(FrameSlotTests, NoFrameWritesASlotTheGpuIsReading) {
+    std::mt19937 rng(7);
+    for (uint32_t count = 1; count <= 4; ++count) {
+        FakeRing ring(count);
+        for (int step = 0; step < 2000; ++step) {
+            // The GPU finishes its oldest frame now and then, or when the CPU would block on it
+            if (!ring.inFlight.empty() && (!ring.slot_free() || rng() % 3 == 0)) {
+                ring.inFlight.pop_front();
+            }
+            const uint32_t slot = frame_slot_begin(ring.index, ring.count);
+            ASSERT_FALSE(ring.in_flight(slot)) << "slots " << count << ", step " << step;
+            if (rng() % 4 == 0) {
+                frame_slot_abort(ring.index, ring.count);
+            } else {
+                ring.inFlight.push_back(slot);
+            }
+        }
+    }
+}
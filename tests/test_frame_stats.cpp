@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+#include "frame_stats.hpp"
+
+#include <sstream>
+#include <string>
+
+TEST(FrameStatsTests, CountsDrawsAndTriangles) {
+    FrameStats stats;
+    frame_stats_begin_frame(stats);
+    frame_stats_count_draw(stats, 36);
+    frame_stats_count_draw(stats, 36, 7);
+    frame_stats_count_fog_culled(stats, 36, 2);
+    frame_stats_count_occlusion(stats, 10, 4);
+    frame_stats_count_occlusion(stats, 5, 1);
+    frame_stats_end_phase(stats, PHASE_ENCODE);
+    frame_stats_end_frame(stats);
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), 1u);
+    EXPECT_EQ(history[0].frame, 1u);
+    EXPECT_EQ(history[0].drawCalls, 2u);
+    EXPECT_EQ(history[0].triangles, 12u + 84u);
+    EXPECT_EQ(history[0].fogCulledTriangles, 24u);
+    EXPECT_EQ(history[0].occlusionTested, 15u);
+    EXPECT_EQ(history[0].occlusionCulled, 5u);
+    EXPECT_GE(history[0].cpuMs, history[0].phaseMs[PHASE_ENCODE]);
+}
+
+TEST(FrameStatsTests, HistoryKeepsNewestFramesInOrder) {
+    FrameStats stats;
+    for (size_t i = 0; i < FRAME_STATS_HISTORY + 10; ++i) {
+        frame_stats_begin_frame(stats);
+        frame_stats_end_frame(stats);
+    }
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), FRAME_STATS_HISTORY);
+    EXPECT_EQ(history.front().frame, 11u);
+    EXPECT_EQ(history.back().frame, FRAME_STATS_HISTORY + 10);
+}
+
+TEST(FrameStatsTests, GpuTimeArrivesBeforeOrAfterFrameEnds) {
+    FrameStats stats;
+    frame_stats_begin_frame(stats);
+    frame_stats_end_frame(stats);
+    frame_stats_record_gpu(stats, 1, 4.0f);
+
+    frame_stats_begin_frame(stats);
+    frame_stats_record_gpu(stats, 2, 5.0f);
+    frame_stats_end_frame(stats);
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    EXPECT_FLOAT_EQ(history[0].gpuMs, 4.0f);
+    EXPECT_FLOAT_EQ(history[1].gpuMs, 5.0f);
+}
+
+TEST(FrameStatsTests, GpuPassTimesArriveBeforeOrAfterFrameEnds) {
+    FrameStats stats;
+    frame_stats_begin_frame(stats);
+    frame_stats_end_frame(stats);
+    frame_stats_record_gpu_passes(stats, 1, GpuPassTimes{ 1.0f, 2.0f, 0.0f, 0.0f, 0.5f });
+
+    frame_stats_begin_frame(stats);
+    frame_stats_record_gpu_passes(stats, 2, GpuPassTimes{ 0.0f, 3.0f, 0.5f, 0.125f, 0.25f });
+    frame_stats_end_frame(stats);
+
+    frame_stats_begin_frame(stats);
+    frame_stats_end_frame(stats);
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), 3u);
+    EXPECT_TRUE(history[0].hasGpuPasses);
+    EXPECT_FLOAT_EQ(history[0].gpuPassMs[GPU_PASS_SCENE], 2.0f);
+    EXPECT_TRUE(history[1].hasGpuPasses);
+    EXPECT_FLOAT_EQ(history[1].gpuPassMs[GPU_PASS_AMBIENT_OCCLUSION], 0.5f);
+    EXPECT_FLOAT_EQ(history[1].gpuPassMs[GPU_PASS_TRANSPARENT], 0.125f);
+    EXPECT_FLOAT_EQ(history[1].gpuPassMs[GPU_PASS_OVERLAY], 0.25f);
+    EXPECT_FALSE(history[2].hasGpuPasses);
+}
+
+TEST(FrameStatsTests, LatenciesArriveBeforeOrAfterFrameEnds) {
+    FrameStats stats;
+    frame_stats_begin_frame(stats);
+    frame_stats_record_latency(stats, 1, LATENCY_SCHEDULE, 0.5f);
+    frame_stats_record_latency(stats, 1, LATENCY_QUEUE, 2.0f);
+    frame_stats_end_frame(stats);
+    frame_stats_record_latency(stats, 1, LATENCY_PRESENT, 30.0f);
+
+    for (int i = 0; i < 2; ++i) {
+        frame_stats_begin_frame(stats);
+        frame_stats_end_frame(stats);
+    }
+    frame_stats_record_latency(stats, 3, LATENCY_QUEUE, 6.0f);
+    EXPECT_TRUE(stats.earlyLatency.empty());
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), 3u);
+    EXPECT_FLOAT_EQ(history[0].latencyMs[LATENCY_SCHEDULE], 0.5f);
+    EXPECT_FLOAT_EQ(history[0].latencyMs[LATENCY_QUEUE], 2.0f);
+    EXPECT_FLOAT_EQ(history[0].latencyMs[LATENCY_PRESENT], 30.0f);
+    EXPECT_LT(history[1].latencyMs[LATENCY_QUEUE], 0.0f);
+
+    // Frames that never reported a latency are left out, as are those before firstFrame
+    FrameTimeSummary queue = frame_stats_summarize_latency(stats, LATENCY_QUEUE);
+    EXPECT_EQ(queue.count, 2u);
+    EXPECT_FLOAT_EQ(queue.max, 6.0f);
+    EXPECT_EQ(frame_stats_summarize_latency(stats, LATENCY_QUEUE, 2).count, 1u);
+    EXPECT_STREQ(frame_latency_name(LATENCY_PRESENT), "present");
+}
+
+TEST(FrameStatsTests, LatencyOfAnOverwrittenFrameIsDropped) {
+    FrameStats stats;
+    for (size_t i = 0; i < FRAME_STATS_HISTORY + 1; ++i) {
+        frame_stats_begin_frame(stats);
+        frame_stats_end_frame(stats);
+    }
+    frame_stats_record_latency(stats, 1, LATENCY_PRESENT, 30.0f);
+    EXPECT_TRUE(stats.earlyLatency.empty());
+}
+
+TEST(FrameStatsTests, LatestGpuSkipsFramesStillInFlight) {
+    FrameStats stats;
+    uint64_t frame = 42;
+    EXPECT_LT(frame_stats_latest_gpu(stats, frame), 0.0f);
+    EXPECT_EQ(frame, 0u);
+
+    for (int i = 0; i < 3; ++i) {
+        frame_stats_begin_frame(stats);
+        frame_stats_end_frame(stats);
+    }
+    frame_stats_record_gpu(stats, 2, 6.0f);
+    frame_stats_record_gpu(stats, 1, 3.0f);
+
+    EXPECT_FLOAT_EQ(frame_stats_latest_gpu(stats, frame), 6.0f);
+    EXPECT_EQ(frame, 2u);
+}
+
+TEST(FrameStatsTests, WritesOneCsvRowPerFrame) {
+    FrameStats stats;
+    for (int i = 0; i < 3; ++i) {
+        frame_stats_begin_frame(stats);
+        frame_stats_count_draw(stats, 3);
+        frame_stats_end_frame(stats);
+    }
+
+    std::ostringstream csv;
+    frame_stats_write_csv(stats, csv);
+
+    std::istringstream lines(csv.str());
+    std::string header, row;
+    std::getline(lines, header);
+    EXPECT_EQ(header.rfind("frame,cpu_ms,gpu_ms,input_ms", 0), 0u);
+
+    int rows = 0;
+    while (std::getline(lines, row)) {
+        EXPECT_EQ(row.rfind(std::to_string(rows + 1) + ",", 0), 0u);
+        ++rows;
+    }
+    EXPECT_EQ(rows, 3);
+}
+
+TEST(FrameStatsTests, SumsPassTrafficPerFrame) {
+    FrameStats stats;
+    PassTraffic scene;
+    scene.loadedBytes = 100;
+    scene.storedBytes = 400;
+    scene.savedBytes = 300;
+    scene.memorylessBytes = 200;
+    PassTraffic composite;
+    composite.storedBytes = 50;
+    composite.savedBytes = 50;
+
+    frame_stats_begin_frame(stats);
+    frame_stats_count_pass(stats, scene);
+    frame_stats_count_pass(stats, composite);
+    frame_stats_end_frame(stats);
+    frame_stats_begin_frame(stats);
+    frame_stats_end_frame(stats);
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), 2u);
+    EXPECT_EQ(history[0].attachmentBytes, 550u);
+    EXPECT_EQ(history[0].savedAttachmentBytes, 350u);
+    EXPECT_EQ(history[0].memorylessBytes, 200u);
+    EXPECT_EQ(history[1].attachmentBytes, 0u);
+}
+
+TEST(FrameStatsTests, CountsRateMappedPixelsPerFrame) {
+    FrameStats stats;
+    frame_stats_begin_frame(stats);
+    frame_stats_count_rasterization(stats, 1920 * 1080, 1200 * 700);
+    frame_stats_end_frame(stats);
+    frame_stats_begin_frame(stats);
+    frame_stats_end_frame(stats);
+
+    std::vector<FrameSample> history = frame_stats_history(stats);
+    ASSERT_EQ(history.size(), 2u);
+    EXPECT_EQ(history[0].screenPixels, 1920u * 1080u);
+    EXPECT_EQ(history[0].shadedPixels, 1200u * 700u);
+    EXPECT_EQ(history[1].screenPixels, 0u);
+    EXPECT_EQ(history[1].shadedPixels, 0u);
+}
+
+TEST(FrameStatsTests, SummarizesPercentiles) {
+    std::vector<float> ms;
+    for (int i = 1; i <= 100; ++i) {
+        ms.push_back((float)i);
+    }
+    ms.push_back(-1.0f); // A frame whose GPU time never arrived
+
+    FrameTimeSummary summary = summarize_frame_times(ms);
+    EXPECT_EQ(summary.count, 100u);
+    EXPECT_FLOAT_EQ(summary.mean, 50.5f);
+    EXPECT_FLOAT_EQ(summary.p50, 50.0f);
+    EXPECT_FLOAT_EQ(summary.p95, 95.0f);
+    EXPECT_FLOAT_EQ(summary.p99, 99.0f);
+    EXPECT_FLOAT_EQ(summary.max, 100.0f);
+
+    EXPECT_EQ(summarize_frame_times({}).count, 0u);
+}
+
+TEST(FrameStatsTests, CountsSpikesOverTwiceTheMedian) {
+    std::vector<float> ms(20, 16.0f);
+    ms[3] = 32.0f;  // Exactly twice the median is no spike
+    ms[7] = 33.0f;
+    ms[11] = 80.0f;
+    EXPECT_EQ(summarize_frame_times(ms).spikes, 2u);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "camera.hpp"
+#include "frustum.hpp"
+
+namespace {
+    // Camera at the origin looking down -Z, as make_camera sets up the projection
+    Frustum test_frustum() {
+        simd::float4x4 projection = matrix_perspective_right_hand(M_PI / 3.0f, 1.0f, 0.1f, 100.0f);
+        simd::float4x4 view = matrix_look_at_right_hand(simd::float3{0, 0, 0}, simd::float3{0, 0, -1}, simd::float3{0, 1, 0});
+        return extract_frustum(projection * view);
+    }
+
+    BoundingBox box_at(float x, float y, float z, float halfSize = 0.5f) {
+        return { { x - halfSize, y - halfSize, z - halfSize }, { x + halfSize, y + halfSize, z + halfSize } };
+    }
+}
+
+TEST(FrustumTests, ClassifiesBoxesAroundTheCamera) {
+    Frustum frustum = test_frustum();
+    EXPECT_TRUE(frustum_intersects(frustum, box_at(0, 0, -10)));
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(0, 0, 10)));       // Behind
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(0, 0, -150)));     // Past the far plane
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(50, 0, -10)));     // Off to the right
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(0, -50, -10)));    // Below
+    EXPECT_TRUE(frustum_intersects(frustum, box_at(6.2f, 0, -10)));    // Straddles the right plane
+}
+
+TEST(FrustumTests, InfiniteProjectionHasNoFarPlane) {
+    simd::float4x4 projection = matrix_perspective_reverse_z_infinite(M_PI / 3.0f, 1.0f, 0.1f);
+    simd::float4x4 view = matrix_look_at_right_hand(simd::float3{0, 0, 0}, simd::float3{0, 0, -1}, simd::float3{0, 1, 0});
+    Frustum frustum = extract_frustum(projection * view);
+    for (const simd::float4& plane : frustum.planes) {
+        EXPECT_TRUE(std::isfinite(plane.x) && std::isfinite(plane.y) && std::isfinite(plane.z) && std::isfinite(plane.w));
+    }
+    EXPECT_TRUE(frustum_intersects(frustum, box_at(0, 0, -10)));
+    EXPECT_TRUE(frustum_intersects(frustum, box_at(0, 0, -1e6f)));     // Far beyond any finite far plane
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(0, 0, 10)));       // Behind
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(0, 0, -0.05f, 0.01f))); // Before the near plane
+    EXPECT_FALSE(frustum_intersects(frustum, box_at(50, 0, -10)));     // Off to the right
+}
+
+TEST(FrustumTests, BatchedCullMatchesSingleTests) {
+    Frustum frustum = test_frustum();
+    CullBounds bounds;
+    std::vector<BoundingBox> boxes;
+    for (int i = 0; i < 103; ++i) {
+        boxes.push_back(box_at((float)(i % 11) * 4.0f - 20.0f, (float)(i % 5) - 2.0f, (float)(i % 13) * -9.0f + 20.0f, 1.0f));
+        cull_bounds_add(bounds, boxes.back());
+    }
+
+    std::vector<uint32_t> visible(bounds.size());
+    size_t count = frustum_cull(frustum, bounds, visible.data());
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        if (frustum_intersects(frustum, boxes[i])) expected.push_back(i);
+    }
+    visible.resize(count);
+    EXPECT_EQ(visible, expected);
+    EXPECT_GT(count, 0u);
+    EXPECT_LT(count, boxes.size());
+}
+
+TEST(FrustumTests, CullAnyKeepsBoxesInsideEitherFrustum) {
+    // The test camera looking down -Z, and one at the same spot looking down +Z
+    simd::float4x4 projection = matrix_perspective_right_hand(M_PI / 3.0f, 1.0f, 0.1f, 100.0f);
+    simd::float4x4 back = matrix_look_at_right_hand(simd::float3{0, 0, 0}, simd::float3{0, 0, 1}, simd::float3{0, 1, 0});
+    const Frustum frustums[2] = { test_frustum(), extract_frustum(projection * back) };
+
+    CullBounds bounds;
+    std::vector<BoundingBox> boxes;
+    for (int i = 0; i < 103; ++i) {
+        boxes.push_back(box_at((float)(i % 11) * 4.0f - 20.0f, (float)(i % 5) - 2.0f, (float)(i % 13) * -9.0f + 50.0f, 1.0f));
+        cull_bounds_add(bounds, boxes.back());
+    }
+
+    std::vector<uint32_t> visible(bounds.size());
+    size_t count = frustum_cull_any(frustums, 2, bounds, visible.data());
+
+    std::vector<uint32_t> expected;
+    size_t front = 0;
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        front += frustum_intersects(frustums[0], boxes[i]);
+        if (frustum_intersects(frustums[0], boxes[i]) || frustum_intersects(frustums[1], boxes[i])) expected.push_back(i);
+    }
+    visible.resize(count);
+    EXPECT_EQ(visible, expected);
+    EXPECT_GT(count, front);
+    EXPECT_EQ(frustum_cull_any(frustums, 0, bounds, visible.data()), 0u);
+}
+
+TEST(FrustumTests, TransformedBoundsContainTheRotatedBox) {
+    BoundingBox unit = box_at(0, 0, 0);
+    BoundingBox rotated = transform_bounds(unit, matrix_translation(3, 0, 0) * matrix_rotation_y(M_PI / 4.0f));
+    EXPECT_NEAR(rotated.min.x, 3.0f - 0.70710677f, 1e-5f);
+    EXPECT_NEAR(rotated.max.x, 3.0f + 0.70710677f, 1e-5f);
+    EXPECT_NEAR(rotated.max.y, 0.5f, 1e-5f);
+}
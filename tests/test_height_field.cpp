@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include "height_field.hpp"
+#include "landscape.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+TEST(HeightFieldTests, MatchesTerrainAtSamples) {
+    HeightField field = create_height_field(-8.0f, -6.0f, 17, 13, 1.0f);
+
+    for (int z = 0; z < field.depth; ++z) {
+        for (int x = 0; x < field.width; ++x) {
+            float wx = field.originX + x * field.spacing;
+            float wz = field.originZ + z * field.spacing;
+            EXPECT_FLOAT_EQ(height_field_height(field, wx, wz), get_terrain_height(wx, wz));
+        }
+    }
+}
+
+TEST(HeightFieldTests, InterpolatesBilinearly) {
+    HeightField field;
+    field.width = 2;
+    field.depth = 2;
+    field.heights = { 0.0f, 2.0f, 4.0f, 6.0f };
+
+    EXPECT_FLOAT_EQ(height_field_height(field, 0.5f, 0.5f), 3.0f);
+    EXPECT_FLOAT_EQ(height_field_height(field, 1.0f, 0.25f), 3.0f);
+
+    // Clamped to the border outside the grid
+    EXPECT_FALSE(height_field_contains(field, 3.0f, 0.0f));
+    EXPECT_FLOAT_EQ(height_field_height(field, 3.0f, 0.0f), 2.0f);
+
+    // Slope of 2 along X and 4 along Z
+    simd::float3 n = height_field_normal(field, 0.5f, 0.5f);
+    simd::float3 expected = simd::normalize(simd::float3{ -2.0f, 1.0f, -4.0f });
+    EXPECT_NEAR(n.x, expected.x, 1e-6f);
+    EXPECT_NEAR(n.y, expected.y, 1e-6f);
+    EXPECT_NEAR(n.z, expected.z, 1e-6f);
+}
+
+TEST(HeightFieldTests, WrapsLandscapeGrid) {
+    MeshData landscape = create_landscape(12, 10);
+    HeightField field = create_height_field(landscape, 12, 10);
+
+    for (const auto& v : landscape.vertices) {
+        EXPECT_NEAR(height_field_height(field, v.position.x, v.position.z), v.position.y, 1e-5f);
+    }
+}
+
+TEST(HeightFieldTests, BatchMatchesScalar) {
+    HeightField field = create_height_field(-16.0f, -16.0f, 33, 33, 1.0f);
+
+    std::vector<float> xs, zs;
+    for (int i = 0; i < 257; ++i) {
+        xs.push_back(-20.0f + 0.157f * i);
+        zs.push_back(15.0f - 0.121f * i);
+    }
+    std::vector<float> heights(xs.size());
+    std::vector<simd::float3> normals(xs.size());
+    height_field_heights(field, xs.data(), zs.data(), heights.data(), xs.size());
+    height_field_normals(field, xs.data(), zs.data(), normals.data(), xs.size());
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_EQ(heights[i], height_field_height(field, xs[i], zs[i])) << "at index " << i;
+        simd::float3 n = height_field_normal(field, xs[i], zs[i]);
+        EXPECT_EQ(normals[i].x, n.x);
+        EXPECT_EQ(normals[i].y, n.y);
+        EXPECT_EQ(normals[i].z, n.z);
+    }
+}
+
+// A sample is the height and the slope height_field_normal is built from, in get_terrain_sample's form
+TEST(HeightFieldTests, SamplesMatchHeightAndNormal) {
+    HeightField field = create_height_field(-16.0f, -16.0f, 33, 33, 1.0f);
+
+    std::vector<float> xs, zs;
+    for (int i = 0; i < 61; ++i) {
+        xs.push_back(-20.0f + 0.657f * i);
+        zs.push_back(15.0f - 0.521f * i);
+    }
+    std::vector<TerrainSample> samples(xs.size());
+    height_field_samples(field, xs.data(), zs.data(), samples.data(), xs.size());
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const TerrainSample sample = height_field_sample(field, xs[i], zs[i]);
+        EXPECT_EQ(sample.height, height_field_height(field, xs[i], zs[i])) << "at index " << i;
+        const simd::float3 n = height_field_normal(field, xs[i], zs[i]);
+        const simd::float3 fromSample = terrain_sample_normal(sample);
+        EXPECT_EQ(fromSample.x, n.x);
+        EXPECT_EQ(fromSample.y, n.y);
+        EXPECT_EQ(fromSample.z, n.z);
+        EXPECT_EQ(samples[i].height, sample.height);
+        EXPECT_EQ(samples[i].gradient.x, sample.gradient.x);
+        EXPECT_EQ(samples[i].gradient.y, sample.gradient.y);
+    }
+}
+
+TEST(HeightFieldTests, RaycastMeetsTheInterpolatedSurface) {
+    HeightField field = create_height_field(-16.0f, -16.0f, 33, 33, 1.0f);
+
+    // Straight down lands exactly on the bilinear height
+    TerrainHit hit;
+    ASSERT_TRUE(height_field_raycast(field, simd::float3{ 2.3f, 50.0f, -4.7f }, simd::float3{ 0.0f, -1.0f, 0.0f },
+                                     100.0f, hit));
+    EXPECT_NEAR(hit.position.y, height_field_height(field, 2.3f, -4.7f), 1e-4f);
+    EXPECT_NEAR(hit.distance, 50.0f - hit.position.y, 1e-4f);
+
+    // A slanted ray ends on the surface too, and nothing before it is below
+    simd::float3 origin = { -15.0f, 8.0f, -12.0f };
+    simd::float3 direction = { 1.0f, -0.3f, 0.7f };
+    ASSERT_TRUE(height_field_raycast(field, origin, direction, 100.0f, hit));
+    EXPECT_NEAR(hit.position.y, height_field_height(field, hit.position.x, hit.position.z), 1e-3f);
+    for (float t = 0.0f; t < hit.distance - 1e-3f; t += 0.01f) {
+        simd::float3 p = origin + direction * t;
+        EXPECT_GT(p.y, height_field_height(field, p.x, p.z) - 1e-4f) << "at t = " << t;
+    }
+
+    // Too short, outside the grid, or starting underground
+    EXPECT_FALSE(height_field_raycast(field, simd::float3{ 2.3f, 50.0f, -4.7f }, simd::float3{ 0.0f, -1.0f, 0.0f },
+                                      10.0f, hit));
+    EXPECT_LT(hit.distance, 0.0f);
+    EXPECT_FALSE(height_field_raycast(field, simd::float3{ 40.0f, -50.0f, 0.0f }, simd::float3{ 0.0f, 0.0f, 1.0f },
+                                      100.0f, hit));
+    simd::float3 below = { 1.0f, height_field_height(field, 1.0f, 1.0f) - 1.0f, 1.0f };
+    ASSERT_TRUE(height_field_raycast(field, below, simd::float3{ 1.0f, 0.0f, 0.0f }, 5.0f, hit));
+    EXPECT_EQ(hit.distance, 0.0f);
+}
+
+TEST(HeightFieldTests, FastMovesDoNotPassThroughRidges) {
+    // Flat ground with a one-sample ridge at x = 8
+    HeightField field;
+    field.width = 17;
+    field.depth = 5;
+    field.heights.assign(field.width * field.depth, 0.0f);
+    for (int z = 0; z < field.depth; ++z) {
+        field.heights[z * field.width + 8] = 10.0f;
+    }
+
+    // Both ends are clear of the ground, so only a sweep sees the ridge
+    simd::float3 start = { 2.0f, 1.5f, 2.0f };
+    simd::float3 end = height_field_move(field, start, simd::float3{ 12.0f, 0.0f, 0.0f }, 1.5f);
+    EXPECT_LT(end.x, 8.0f);
+    EXPECT_GE(end.y, height_field_height(field, end.x, end.z) + 1.5f - 1e-4f);
+
+    // Along the ridge nothing is in the way; resting contact only lifts the body by the skin
+    end = height_field_move(field, start, simd::float3{ 0.0f, 0.0f, 1.5f }, 1.5f);
+    EXPECT_NEAR(end.z, 3.5f, 1e-5f);
+    EXPECT_NEAR(end.y, 1.5f, 2e-3f);
+
+    // Flying into the ground slides along it instead of stopping
+    end = height_field_move(field, start, simd::float3{ 3.0f, -2.0f, 0.0f }, 1.5f);
+    EXPECT_GT(end.x, 4.0f);
+    EXPECT_NEAR(end.y, 1.5f, 1e-2f);
+}
+
+TEST(HeightFieldTests, BatchRaycastsMatchScalar) {
+    HeightField field = create_height_field(-16.0f, -16.0f, 33, 33, 1.0f);
+
+    std::vector<simd::float3> origins, directions;
+    std::vector<float> maxDistances;
+    for (int i = 0; i < 103; ++i) {
+        float angle = 0.37f * i;
+        origins.push_back({ -20.0f + 0.4f * i, 6.0f + (float)(i % 5), 14.0f - 0.3f * i });
+        directions.push_back({ std::cos(angle), -0.1f - 0.05f * (i % 7), std::sin(angle) });
+        maxDistances.push_back(i % 11 == 0 ? 2.0f : 60.0f);
+    }
+    std::vector<TerrainHit> hits(origins.size());
+    size_t count = height_field_raycasts(field, origins.data(), directions.data(), maxDistances.data(), hits.data(),
+                                         origins.size());
+
+    size_t expected = 0;
+    for (size_t i = 0; i < origins.size(); ++i) {
+        TerrainHit hit;
+        bool scalar = height_field_raycast(field, origins[i], directions[i], maxDistances[i], hit);
+        expected += scalar;
+        EXPECT_EQ(hits[i].distance >= 0.0f, scalar) << "at index " << i;
+        EXPECT_NEAR(hits[i].distance, hit.distance, 1e-4f) << "at index " << i;
+    }
+    EXPECT_EQ(count, expected);
+    EXPECT_GT(count, 0u);
+}
+
+TEST(HeightFieldTests, SegmentDepthsMatchDenseSampling) {
+    HeightField field = create_height_field(-16.0f, -16.0f, 33, 33, 1.0f);
+
+    std::vector<simd::float3> starts, ends;
+    for (int i = 0; i < 61; ++i) {
+        const float angle = 0.53f * i;
+        const simd::float3 start = { -12.0f + 0.35f * i, 1.0f + (float)(i % 4), 10.0f - 0.3f * i };
+        starts.push_back(start);
+        const float rise = -2.0f + (float)(i % 5);
+        ends.push_back(start + simd::float3{ 18.0f * std::cos(angle), rise, 18.0f * std::sin(angle) });
+    }
+    std::vector<float> depths(starts.size());
+    height_field_segment_depths(field, starts.data(), ends.data(), 1000.0f, depths.data(), starts.size());
+
+    size_t under = 0;
+    for (size_t i = 0; i < starts.size(); ++i) {
+        float expected = 0.0f;
+        for (int s = 0; s <= 4000; ++s) {
+            const simd::float3 p = starts[i] + (ends[i] - starts[i]) * (s / 4000.0f);
+            if (height_field_contains(field, p.x, p.z)) {
+                expected = std::max(expected, height_field_height(field, p.x, p.z) - p.y);
+            }
+        }
+        // Dense sampling can only miss the deepest point by a little
+        EXPECT_GE(depths[i], expected - 1e-4f) << "at index " << i;
+        EXPECT_LT(depths[i], expected + 1e-2f) << "at index " << i;
+        under += depths[i] > 0.0f;
+    }
+    EXPECT_GT(under, 0u);
+    EXPECT_LT(under, starts.size());
+
+    // A capped depth stops at the cap
+    float capped = 0.0f;
+    const simd::float3 start = { -10.0f, -50.0f, 0.0f };
+    const simd::float3 end = { 10.0f, -50.0f, 0.0f };
+    height_field_segment_depths(field, &start, &end, 2.0f, &capped, 1);
+    EXPECT_EQ(capped, 2.0f);
+}
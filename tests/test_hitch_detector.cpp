@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "hitch_detector.hpp"
+
+namespace {
+    HitchDetector detector_with_budget(float budgetMs) {
+        HitchDetector detector;
+        detector.settings.budgetMs = budgetMs;
+        detector.settings.cooldownSeconds = 5.0f;
+        detector.settings.maxReports = 2;
+        detector.settings.directory = "captures";
+        return detector;
+    }
+}
+
+TEST(HitchDetectorTests, SlowCpuFrameArmsACaptureOfTheNextFrame) {
+    HitchDetector detector = detector_with_budget(20.0f);
+    HitchReport report;
+    EXPECT_FALSE(hitch_detector_update(detector, 1, 10.0f, 0, -1.0f, 0.0, report));
+    EXPECT_TRUE(hitch_detector_take_capture(detector).empty());
+
+    ASSERT_TRUE(hitch_detector_update(detector, 2, 35.0f, 0, -1.0f, 0.1, report));
+    EXPECT_EQ(report.frame, 2u);
+    EXPECT_FLOAT_EQ(report.ms, 35.0f);
+    EXPECT_FALSE(report.gpu);
+    EXPECT_EQ(report.prefix, "captures/hitch_2");
+    EXPECT_EQ(hitch_detector_take_capture(detector), "captures/hitch_2.gputrace");
+    EXPECT_TRUE(hitch_detector_take_capture(detector).empty());
+}
+
+TEST(HitchDetectorTests, GpuTimesAreCheckedOnceAsTheyArrive) {
+    HitchDetector detector = detector_with_budget(20.0f);
+    detector.settings.cooldownSeconds = 0.0f;
+    HitchReport report;
+    ASSERT_TRUE(hitch_detector_update(detector, 5, 8.0f, 3, 30.0f, 0.0, report));
+    EXPECT_TRUE(report.gpu);
+    EXPECT_EQ(report.frame, 3u);
+    // The same GPU frame is still the newest next frame
+    EXPECT_FALSE(hitch_detector_update(detector, 6, 8.0f, 3, 30.0f, 1.0, report));
+}
+
+TEST(HitchDetectorTests, ReportsAreRateLimited) {
+    HitchDetector detector = detector_with_budget(20.0f);
+    HitchReport report;
+    EXPECT_TRUE(hitch_detector_update(detector, 1, 50.0f, 0, -1.0f, 0.0, report));
+    // A run of slow frames writes one report
+    EXPECT_FALSE(hitch_detector_update(detector, 2, 50.0f, 0, -1.0f, 1.0, report));
+    EXPECT_TRUE(hitch_detector_update(detector, 3, 50.0f, 0, -1.0f, 6.0, report));
+    // maxReports reached
+    EXPECT_FALSE(hitch_detector_update(detector, 4, 50.0f, 0, -1.0f, 20.0, report));
+}
+
+TEST(HitchDetectorTests, ZeroBudgetDisablesDetection) {
+    HitchDetector detector = detector_with_budget(0.0f);
+    HitchReport report;
+    EXPECT_FALSE(hitch_detector_update(detector, 1, 500.0f, 1, 500.0f, 0.0, report));
+}
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include "image_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    std::string temp_path(const char* name) {
+        return (::testing::TempDir() + name);
+    }
+}
+
+TEST(ImageFileTests, TgaRoundTripsPaddedRows) {
+    // Rows padded past 4 * width, as GPU readback buffers often are
+    const uint32_t width = 5, height = 3;
+    const size_t rowBytes = 32;
+    std::vector<uint8_t> pixels(rowBytes * height, 0xEE);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < 4 * width; ++x) {
+            pixels[y * rowBytes + x] = (uint8_t)(y * 40 + x);
+        }
+    }
+    const std::string path = temp_path("round_trip.tga");
+    std::string error;
+    ASSERT_TRUE(write_tga(path.c_str(), pixels.data(), width, height, rowBytes, error)) << error;
+
+    std::vector<uint8_t> read;
+    uint32_t readWidth = 0, readHeight = 0;
+    ASSERT_TRUE(read_tga(path.c_str(), read, readWidth, readHeight, error)) << error;
+    EXPECT_EQ(readWidth, width);
+    EXPECT_EQ(readHeight, height);
+    ASSERT_EQ(read.size(), 4u * width * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < 4 * width; ++x) {
+            ASSERT_EQ(read[y * 4 * width + x], pixels[y * rowBytes + x]) << "row " << y;
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST(ImageFileTests, RejectsBadSizesAndPaths) {
+    const uint8_t pixel[4] = {};
+    std::string error;
+    EXPECT_FALSE(write_tga(temp_path("empty.tga").c_str(), pixel, 0, 1, 4, error));
+    EXPECT_FALSE(write_tga(temp_path("short_rows.tga").c_str(), pixel, 2, 1, 4, error));
+    EXPECT_FALSE(write_tga("/nonexistent/dir/image.tga", pixel, 1, 1, 4, error));
+    EXPECT_FALSE(error.empty());
+
+    std::vector<uint8_t> read;
+    uint32_t width, height;
+    EXPECT_FALSE(read_tga("/nonexistent/dir/image.tga", read, width, height, error));
+}
+
+namespace {
+    uint32_t read_u32_be(const uint8_t* p) {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    // Decodes the single fixed-Huffman deflate block the encoder emits
+    std::vector<uint8_t> inflate_fixed(const uint8_t* data, size_t size) {
+        size_t bit = 0;
+        auto bits = [&](uint32_t count) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; ++i, ++bit) {
+                value |= (uint32_t)((data[bit / 8] >> (bit % 8)) & 1) << i;
+            }
+            return value;
+        };
+        auto code = [&](uint32_t count) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                value = (value << 1) | bits(1);
+            }
+            return value;
+        };
+        static const uint16_t lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                               35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                               3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        std::vector<uint8_t> out;
+        EXPECT_EQ(bits(1), 1u);
+        EXPECT_EQ(bits(2), 1u);
+        for (;;) {
+            EXPECT_LT(bit / 8, size);
+            uint32_t symbol = code(7);
+            if (symbol <= 0x17) {
+                symbol += 256;
+            } else {
+                symbol = (symbol << 1) | bits(1);
+                if (symbol >= 0x30 && symbol <= 0xBF) {
+                    symbol -= 0x30;
+                } else if (symbol >= 0xC0 && symbol <= 0xC7) {
+                    symbol = symbol - 0xC0 + 280;
+                } else {
+                    symbol = ((symbol << 1) | bits(1)) - 0x190 + 144;
+                }
+            }
+            if (symbol < 256) {
+                out.push_back((uint8_t)symbol);
+            } else if (symbol == 256) {
+                return out;
+            } else {
+                const uint32_t length = lengthBase[symbol - 257] + bits(lengthExtra[symbol - 257]);
+                // Distance codes 2n and 2n + 1 from 4 up carry n - 1 extra bits
+                const uint32_t distanceCode = code(5);
+                const uint32_t extra = distanceCode < 4 ? 0 : distanceCode / 2 - 1;
+                const uint32_t distanceBase = distanceCode < 4 ? distanceCode + 1
+                                                               : ((2u + (distanceCode & 1)) << extra) + 1;
+                const uint32_t distance = distanceBase + bits(extra);
+                for (uint32_t i = 0; i < length; ++i) {
+                    out.push_back(out[out.size() - distance]);
+                }
+            }
+        }
+    }
+}
+
+TEST(ImageFileTests, PngHoldsTheRgbRows) {
+    const uint32_t width = 37, height = 11;
+    const size_t rowBytes = 4 * width + 12;
+    std::vector<uint8_t> pixels(rowBytes * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t* p = &pixels[y * rowBytes + 4 * x];
+            p[0] = (uint8_t)(x * 7);           // B
+            p[1] = (uint8_t)(y * 20);          // G
+            p[2] = (uint8_t)((x / 4) % 2 * 200); // R, in runs that LZ77 can match
+            p[3] = 255;
+        }
+    }
+    std::vector<uint8_t> png;
+    encode_png(pixels.data(), width, height, rowBytes, png);
+
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    ASSERT_GT(png.size(), 8u);
+    ASSERT_EQ(memcmp(png.data(), signature, 8), 0);
+    ASSERT_EQ(memcmp(png.data() + 12, "IHDR", 4), 0);
+    EXPECT_EQ(read_u32_be(png.data() + 16), width);
+    EXPECT_EQ(read_u32_be(png.data() + 20), height);
+    EXPECT_EQ(png[24], 8);  // Bits per channel
+    EXPECT_EQ(png[25], 2);  // RGB
+
+    const size_t idat = 8 + 12 + 13;
+    ASSERT_EQ(memcmp(png.data() + idat + 4, "IDAT", 4), 0);
+    const uint32_t idatSize = read_u32_be(png.data() + idat);
+    EXPECT_EQ(memcmp(png.data() + idat + 12 + idatSize + 4, "IEND", 4), 0);
+
+    // Skip the two byte zlib header; the Adler-32 trailer is not checked
+    const std::vector<uint8_t> filtered = inflate_fixed(png.data() + idat + 10, idatSize - 2);
+    ASSERT_EQ(filtered.size(), (size_t)(3 * width + 1) * height);
+    std::vector<uint8_t> previous(3 * width, 0), row(3 * width);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* in = &filtered[y * (3 * width + 1)];
+        const uint8_t filter = in[0];
+        ASSERT_LE(filter, 2) << "row " << y;
+        for (uint32_t i = 0; i < 3 * width; ++i) {
+            const uint8_t left = i >= 3 ? row[i - 3] : 0;
+            row[i] = (uint8_t)(in[1 + i] + (filter == 1 ? left : filter == 2 ? previous[i] : 0));
+        }
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint8_t* p = &pixels[y * rowBytes + 4 * x];
+            ASSERT_EQ(row[3 * x + 0], p[2]) << x << "," << y;
+            ASSERT_EQ(row[3 * x + 1], p[1]) << x << "," << y;
+            ASSERT_EQ(row[3 * x + 2], p[0]) << x << "," << y;
+        }
+        previous = row;
+    }
+}
+
+TEST(ImageFileTests, PngCompressesFlatImages) {
+    const uint32_t size = 64;
+    const std::vector<uint8_t> pixels(size * size * 4, 0x80);
+    std::vector<uint8_t> png;
+    encode_png(pixels.data(), size, size, size * 4, png);
+    EXPECT_LT(png.size(), pixels.size() / 20);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "image_gate.hpp"
+
+#include <vector>
+
+namespace {
+    // A grey image with a dark vertical bar starting at column barX
+    std::vector<uint8_t> bar_image(uint32_t width, uint32_t height, uint32_t barX) {
+        std::vector<uint8_t> pixels((size_t)width * height * 4);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                uint8_t* p = &pixels[((size_t)y * width + x) * 4];
+                const uint8_t value = x >= barX && x < barX + 4 ? 20 : 180;
+                p[0] = p[1] = p[2] = value;
+                p[3] = 255;
+            }
+        }
+        return pixels;
+    }
+}
+
+TEST(ImageGateTests, DeltaEMatchesKnownDifferences) {
+    const uint8_t black[4] = { 0, 0, 0, 255 };
+    const uint8_t white[4] = { 255, 255, 255, 255 };
+    const uint8_t nearWhite[4] = { 254, 254, 254, 255 };
+    EXPECT_NEAR(bgra_delta_e(black, white), 100.0f, 0.1f);
+    EXPECT_LT(bgra_delta_e(white, nearWhite), 1.0f);
+    EXPECT_EQ(bgra_delta_e(white, white), 0.0f);
+}
+
+TEST(ImageGateTests, IdenticalAndRoundedImagesPass) {
+    std::vector<uint8_t> golden = bar_image(32, 16, 10);
+    ImageComparison same = compare_images(golden.data(), golden.data(), 32, 16, ImageGateSettings{});
+    EXPECT_TRUE(same.passed);
+    EXPECT_EQ(same.changedPixels, 0u);
+
+    // One step of rounding everywhere is well under the just noticeable difference
+    std::vector<uint8_t> rounded = golden;
+    for (size_t i = 0; i < rounded.size(); i += 4) {
+        rounded[i + 1]++;
+    }
+    const ImageComparison comparison = compare_images(golden.data(), rounded.data(), 32, 16, ImageGateSettings{});
+    EXPECT_TRUE(comparison.passed);
+    EXPECT_GT(comparison.meanDeltaE, 0.0f);
+}
+
+TEST(ImageGateTests, EdgesMovedByATexelPass) {
+    const std::vector<uint8_t> golden = bar_image(32, 16, 10);
+    const std::vector<uint8_t> shifted = bar_image(32, 16, 11);
+    ImageGateSettings settings;
+    settings.maxMeanDeltaE = 100.0f;
+    const ImageComparison comparison = compare_images(golden.data(), shifted.data(), 32, 16, settings);
+    EXPECT_EQ(comparison.changedPixels, 0u);
+    EXPECT_TRUE(comparison.passed);
+}
+
+TEST(ImageGateTests, MissingFeaturesFail) {
+    const std::vector<uint8_t> golden = bar_image(32, 16, 10);
+    const std::vector<uint8_t> moved = bar_image(32, 16, 20);
+    std::vector<uint8_t> diff;
+    const ImageComparison comparison = compare_images(golden.data(), moved.data(), 32, 16, ImageGateSettings{}, &diff);
+    EXPECT_FALSE(comparison.passed);
+    EXPECT_EQ(comparison.changedPixels, 2u * 4 * 16);
+    ASSERT_EQ(diff.size(), golden.size());
+    EXPECT_EQ(diff[(3 * 32 + 12) * 4 + 2], 255);
+    EXPECT_EQ(diff[(3 * 32 + 12) * 4 + 1], 0);
+}
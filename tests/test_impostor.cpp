@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "impostor.hpp"
+
+#include <cmath>
+
+namespace {
+    simd::float3 clip_of(const simd::float4x4& m, simd::float3 p) {
+        const simd::float4 c = m * simd::float4{ p.x, p.y, p.z, 1.0f };
+        return { c.x / c.w, c.y / c.w, c.z / c.w };
+    }
+}
+
+TEST(ImpostorTests, OctahedralMappingRoundTrips) {
+    for (simd::float3 d : { simd::float3{ 0.0f, 1.0f, 0.0f }, simd::float3{ 1.0f, 0.0f, 0.0f },
+                            simd::float3{ 0.3f, 0.5f, -0.8f }, simd::float3{ -0.6f, 0.1f, -0.2f } }) {
+        d = simd::normalize(d);
+        const simd::float2 uv = impostor_octahedral_encode(d);
+        EXPECT_GE(uv.x, 0.0f);
+        EXPECT_LE(uv.x, 1.0f);
+        EXPECT_GE(uv.y, 0.0f);
+        EXPECT_LE(uv.y, 1.0f);
+        const simd::float3 back = impostor_octahedral_decode(uv);
+        EXPECT_NEAR(simd::dot(back, d), 1.0f, 1e-5f);
+    }
+    // Straight up is the centre, and below the horizon is taken as on it
+    const simd::float2 up = impostor_octahedral_encode({ 0.0f, 1.0f, 0.0f });
+    EXPECT_FLOAT_EQ(up.x, 0.5f);
+    EXPECT_FLOAT_EQ(up.y, 0.5f);
+    const simd::float3 below = simd::normalize(simd::float3{ 1.0f, -1.0f, 0.0f });
+    EXPECT_GE(impostor_octahedral_decode(impostor_octahedral_encode(below)).y, 0.0f);
+}
+
+TEST(ImpostorTests, FramesCoverTheUpperHemisphere) {
+    for (uint32_t y = 0; y < IMPOSTOR_FRAMES; ++y) {
+        for (uint32_t x = 0; x < IMPOSTOR_FRAMES; ++x) {
+            const simd::float3 d = impostor_frame_direction(x, y);
+            EXPECT_NEAR(simd::length(d), 1.0f, 1e-5f);
+            EXPECT_GE(d.y, 0.0f);
+        }
+    }
+    // The corners lie on the horizon
+    EXPECT_NEAR(impostor_frame_direction(0, 0).y, 0.0f, 1e-5f);
+    EXPECT_NEAR(impostor_frame_direction(IMPOSTOR_FRAMES - 1, 0).y, 0.0f, 1e-5f);
+}
+
+TEST(ImpostorTests, BlendPicksTheFramesAroundTheDirection) {
+    // Exactly a frame's direction gives that frame alone
+    const ImpostorBlend exact = impostor_frame_blend(impostor_frame_direction(3, 2));
+    float total = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        total += exact.weights[i];
+        if (exact.frames[i] == 2 * IMPOSTOR_FRAMES + 3) {
+            EXPECT_NEAR(exact.weights[i], 1.0f, 1e-4f);
+        }
+    }
+    EXPECT_NEAR(total, 1.0f, 1e-5f);
+
+    // Between frames, the weights spread over a 2x2 block and still sum to one
+    const ImpostorBlend between =
+        impostor_frame_blend(simd::normalize(impostor_frame_direction(3, 2) + impostor_frame_direction(4, 3)));
+    EXPECT_EQ(between.frames[1], between.frames[0] + 1);
+    EXPECT_EQ(between.frames[2], between.frames[0] + IMPOSTOR_FRAMES);
+    total = 0.0f;
+    for (float w : between.weights) {
+        EXPECT_GE(w, 0.0f);
+        total += w;
+    }
+    EXPECT_NEAR(total, 1.0f, 1e-5f);
+    EXPECT_LT(between.weights[0], 1.0f);
+
+    // The last row and column stay inside the atlas
+    const uint32_t last = IMPOSTOR_FRAMES - 1;
+    const ImpostorBlend corner = impostor_frame_blend(impostor_frame_direction(last, last));
+    EXPECT_EQ(corner.frames[3], IMPOSTOR_FRAMES * IMPOSTOR_FRAMES - 1);
+    EXPECT_NEAR(corner.weights[3], 1.0f, 1e-4f);
+}
+
+TEST(ImpostorTests, BoundsEncloseEveryPart) {
+    for (FoliageKind kind : { FoliageKind::Tree, FoliageKind::Rock }) {
+        InstanceData parts[IMPOSTOR_MAX_PARTS];
+        const uint32_t count = impostor_parts(kind, parts);
+        EXPECT_EQ(count, kind == FoliageKind::Tree ? 2u : 1u);
+        const ImpostorBounds bounds = impostor_bounds(kind);
+        for (uint32_t i = 0; i < count; ++i) {
+            for (uint32_t c = 0; c < 8; ++c) {
+                const simd::float4 corner = parts[i].modelMatrix * simd::float4{ (c & 1) ? 0.5f : -0.5f,
+                                                                                 (c & 2) ? 0.5f : -0.5f,
+                                                                                 (c & 4) ? 0.5f : -0.5f, 1.0f };
+                const simd::float3 p = { corner.x, corner.y, corner.z };
+                EXPECT_LE(simd::length(p - bounds.center), bounds.radius + 1e-5f);
+            }
+        }
+    }
+    // A tree stands on its base, its crown reaching up to 3.25
+    const ImpostorBounds tree = impostor_bounds(FoliageKind::Tree);
+    EXPECT_NEAR(tree.center.y, 1.625f, 1e-5f);
+}
+
+TEST(ImpostorTests, FramesFitTheBoundsAndFaceTheirDirection) {
+    const ImpostorBounds bounds = impostor_bounds(FoliageKind::Tree);
+    for (uint32_t frame : { 0u, 9u, 27u, 63u }) {
+        const uint32_t x = frame % IMPOSTOR_FRAMES;
+        const uint32_t y = frame / IMPOSTOR_FRAMES;
+        const simd::float4x4 m = impostor_frame_view_projection(FoliageKind::Tree, x, y);
+        const simd::float3 d = impostor_frame_direction(x, y);
+
+        const simd::float3 center = clip_of(m, bounds.center);
+        EXPECT_NEAR(center.x, 0.0f, 1e-4f);
+        EXPECT_NEAR(center.y, 0.0f, 1e-4f);
+        EXPECT_NEAR(center.z, 0.5f, 1e-4f);
+        // Towards the viewer is nearer, and the sphere spans the depth range
+        EXPECT_NEAR(clip_of(m, bounds.center + d * bounds.radius).z, 0.0f, 1e-4f);
+        EXPECT_NEAR(clip_of(m, bounds.center - d * bounds.radius).z, 1.0f, 1e-4f);
+        // Up on screen is up in the world, unless looking straight down
+        const simd::float3 above = clip_of(m, bounds.center + simd::float3{ 0.0f, bounds.radius, 0.0f });
+        EXPECT_GT(above.y, 0.0f);
+        EXPECT_LE(above.y, 1.0f + 1e-4f);
+    }
+}
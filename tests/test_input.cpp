@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "input.hpp"
+#include "spsc_queue.hpp"
+
+#include <thread>
+
+namespace {
+    InputEvent make_event(double time, InputEventType type, int key = 0, double x = 0.0, double y = 0.0) {
+        InputEvent event;
+        event.time = time;
+        event.type = type;
+        event.key = key;
+        event.x = x;
+        event.y = y;
+        return event;
+    }
+}
+
+TEST(SpscQueueTests, DeliversInOrderAndRejectsWhenFull) {
+    SpscQueue<int, 4> queue;
+    int value = 0;
+    EXPECT_FALSE(queue.pop(value));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_FALSE(queue.push(4));
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_EQ(queue.peek(), nullptr);
+}
+
+TEST(SpscQueueTests, NothingIsLostAcrossThreads) {
+    SpscQueue<uint32_t, 64> queue;
+    constexpr uint32_t COUNT = 100000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < COUNT; ++i) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    while (expected < COUNT) {
+        uint32_t value;
+        if (queue.pop(value)) {
+            ASSERT_EQ(value, expected);
+            ++expected;
+        }
+    }
+    producer.join();
+}
+
+TEST(InputTests, AccumulatesMouseDeltasFromTheFirstKnownPosition) {
+    InputState state;
+    apply_input_event(state, make_event(0.0, InputEventType::MouseMove, 0, 100.0, 50.0));
+    EXPECT_EQ(state.mouseDeltaX, 0.0f);
+
+    apply_input_event(state, make_event(0.1, InputEventType::MouseMove, 0, 104.0, 49.0));
+    apply_input_event(state, make_event(0.2, InputEventType::MouseMove, 0, 110.0, 47.0));
+    EXPECT_FLOAT_EQ(state.mouseDeltaX, 10.0f);
+    EXPECT_FLOAT_EQ(state.mouseDeltaY, -3.0f);
+
+    clear_input_deltas(state);
+    EXPECT_EQ(state.mouseDeltaX, 0.0f);
+
+    // Capturing the cursor moves it; that jump must not turn the camera
+    apply_input_event(state, make_event(0.3, InputEventType::CursorRelease));
+    EXPECT_FALSE(state.cursorLocked);
+    apply_input_event(state, make_event(0.4, InputEventType::CursorLock));
+    apply_input_event(state, make_event(0.5, InputEventType::MouseMove, 0, 400.0, 300.0));
+    EXPECT_TRUE(state.cursorLocked);
+    EXPECT_EQ(state.mouseDeltaX, 0.0f);
+}
+
+TEST(InputTests, DrainStopsAtEventsAfterTheStep) {
+    InputQueue queue;
+    InputState state;
+    queue.push(make_event(1.0, InputEventType::KeyDown, 'W'));
+    queue.push(make_event(2.0, InputEventType::KeyUp, 'W'));
+    queue.push(make_event(2.0, InputEventType::KeyDown, 2000)); // Out of range keys are ignored
+
+    EXPECT_EQ(drain_input(queue, state, 1.5), 1u);
+    EXPECT_TRUE(state.keys['W']);
+    EXPECT_EQ(drain_input(queue, state, 2.0), 2u);
+    EXPECT_FALSE(state.keys['W']);
+    EXPECT_EQ(drain_input(queue, state, 3.0), 0u);
+}
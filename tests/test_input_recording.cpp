@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "input_recording.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+    std::string test_path(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "input_recording_tests";
+        std::filesystem::create_directories(dir);
+        return (dir / name).string();
+    }
+
+    InputRecording sample_recording() {
+        InputRecording recording;
+        recording.terrainSeed = 1234;
+        recording.debrisSeed = 5;
+        recording.herdSeed = 7;
+        recording.step = 1.0 / 120.0;
+        recording.camera[3] = 1.5f;
+        InputEvent event;
+        event.type = InputEventType::CursorLock;
+        recording.inputs.push_back({ 0, event });
+        event.type = InputEventType::KeyDown;
+        event.key = 87;
+        recording.inputs.push_back({ 2, event });
+        event.key = -1;
+        recording.inputs.push_back({ 2, event });
+        for (uint64_t tick = 3; tick < 200; ++tick) {
+            InputEvent move;
+            move.type = InputEventType::MouseMove;
+            move.x = 400.25 + tick;
+            move.y = 300.0 - 0.5 * tick;
+            recording.inputs.push_back({ tick, move });
+        }
+        event.type = InputEventType::KeyUp;
+        event.key = 87;
+        recording.inputs.push_back({ 100000, event });
+        for (uint64_t frame = 0; frame < 100; ++frame) {
+            recording.frames.push_back({ 1.0f / 60.0f, frame * 2, 0.25f });
+        }
+        return recording;
+    }
+}
+
+TEST(InputRecordingTests, RoundTripsEventsFramesAndSeeds) {
+    const InputRecording recording = sample_recording();
+    const std::string path = test_path("round_trip.rec");
+    std::string error;
+    ASSERT_TRUE(write_input_recording(path, recording, error)) << error;
+
+    InputRecording read;
+    ASSERT_TRUE(read_input_recording(path, read, error)) << error;
+    EXPECT_EQ(read.terrainSeed, 1234u);
+    EXPECT_EQ(read.debrisSeed, 5u);
+    EXPECT_EQ(read.herdSeed, 7u);
+    EXPECT_EQ(read.step, recording.step);
+    EXPECT_EQ(read.camera[3], 1.5f);
+    ASSERT_EQ(read.inputs.size(), recording.inputs.size());
+    for (size_t i = 0; i < read.inputs.size(); ++i) {
+        EXPECT_EQ(read.inputs[i].tick, recording.inputs[i].tick);
+        EXPECT_EQ(read.inputs[i].event.type, recording.inputs[i].event.type);
+        EXPECT_EQ(read.inputs[i].event.key, recording.inputs[i].event.key);
+        EXPECT_EQ(read.inputs[i].event.x, recording.inputs[i].event.x);
+        EXPECT_EQ(read.inputs[i].event.y, recording.inputs[i].event.y);
+    }
+    ASSERT_EQ(read.frames.size(), recording.frames.size());
+    EXPECT_EQ(read.frames[99].tick, 198u);
+    EXPECT_EQ(read.frames[99].dt, 1.0f / 60.0f);
+    EXPECT_EQ(read.frames[99].alpha, 0.25f);
+
+    // Small deltas and only the fields an event uses: mouse moves dominate at 18 bytes each
+    EXPECT_LT(std::filesystem::file_size(path), 64u + 200u * 18u + 100u * 9u);
+}
+
+TEST(InputRecordingTests, RejectsForeignAndTruncatedFiles) {
+    const std::string path = test_path("truncated.rec");
+    std::string error;
+    InputRecording read;
+    EXPECT_FALSE(read_input_recording(test_path("missing.rec"), read, error));
+    ASSERT_TRUE(write_input_recording(path, sample_recording(), error));
+
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size() - 3);
+    EXPECT_FALSE(read_input_recording(path, read, error));
+    bytes[0] = 'X';
+    std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size());
+    EXPECT_FALSE(read_input_recording(path, read, error));
+}
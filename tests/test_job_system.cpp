@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "job_system.hpp"
+
+#include <numeric>
+#include <set>
+
+TEST(JobSystemTests, CounterWaitsForEveryJob) {
+    JobSystem jobs({ 3, 1 });
+    std::atomic<int> sum{ 0 };
+    JobCounter counter;
+    for (int i = 1; i <= 100; ++i) {
+        jobs.run([&sum, i] { sum += i; }, &counter);
+    }
+    jobs.wait(counter);
+    EXPECT_TRUE(counter.done());
+    EXPECT_EQ(sum.load(), 5050);
+}
+
+TEST(JobSystemTests, NestedJobsFinishBeforeTheirParentsCounter) {
+    JobSystem jobs({ 2, 1 });
+    std::atomic<int> leaves{ 0 };
+    JobCounter outer;
+    for (int i = 0; i < 8; ++i) {
+        jobs.run([&] {
+            // Waiting inside a job runs other jobs instead of blocking a worker
+            JobCounter inner;
+            for (int j = 0; j < 16; ++j) {
+                jobs.run([&leaves] { leaves++; }, &inner);
+            }
+            jobs.wait(inner);
+        }, &outer);
+    }
+    jobs.wait(outer);
+    EXPECT_EQ(leaves.load(), 8 * 16);
+}
+
+TEST(JobSystemTests, ParallelForCoversEveryItemOnce) {
+    JobSystem jobs({ 3, 1 });
+    std::vector<int> hits(1000, 0);
+    jobs.parallel_for((uint32_t)hits.size(), 64, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            hits[i]++;
+        }
+    });
+    EXPECT_EQ(std::accumulate(hits.begin(), hits.end(), 0), 1000);
+    EXPECT_EQ(*std::min_element(hits.begin(), hits.end()), 1);
+
+    bool called = false;
+    jobs.parallel_for(0, 64, [&](uint32_t, uint32_t) { called = true; });
+    EXPECT_FALSE(called);
+}
+
+TEST(JobSystemTests, ThreadIndicesNameTheFrameThreads) {
+    JobSystem jobs({ 3, 1 });
+    EXPECT_EQ(jobs.thread_index(), 0u);
+
+    std::vector<uint32_t> indices(64, 0);
+    jobs.parallel_for((uint32_t)indices.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            indices[i] = jobs.thread_index();
+        }
+    });
+    EXPECT_EQ(indices[0], 0u); // The caller runs the first slice
+    for (uint32_t index : indices) {
+        EXPECT_LE(index, jobs.worker_count(JobPriority::Frame));
+    }
+
+    JobSystem other({ 1, 1 });
+    JobCounter counter;
+    uint32_t foreign = UINT32_MAX;
+    other.run([&] { foreign = jobs.thread_index(); }, &counter);
+    other.wait(counter);
+    EXPECT_EQ(foreign, 0u);
+}
+
+TEST(JobSystemTests, BackgroundJobsRunOffTheFramePool) {
+    JobSystem jobs({ 1, 2 });
+    EXPECT_EQ(jobs.worker_count(JobPriority::Frame), 1u);
+    EXPECT_EQ(jobs.worker_count(JobPriority::Background), 2u);
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    JobCounter counter;
+    for (int i = 0; i < 32; ++i) {
+        jobs.run([&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        }, &counter, JobPriority::Background);
+    }
+    jobs.wait(counter);
+    EXPECT_FALSE(threads.count(std::this_thread::get_id()));
+    EXPECT_LE(threads.size(), 2u);
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include "light_clusters.hpp"
+#include "camera.hpp"
+
+#include <cmath>
+
+namespace {
+    LightClusterUniforms make_uniforms(uint32_t lightCount, bool reverseZ = false) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = { 10.0f, 20.0f, -5.0f };
+        cam.yaw = 0.7f;
+        cam.pitch = -0.2f;
+        update_camera_view(cam);
+        return light_cluster_uniforms(cam.viewMatrix, cam.projectionMatrix, 1280, 720, cam.nearZ, 400.0f, lightCount);
+    }
+
+    simd::float3 to_view(const LightClusterUniforms& uniforms, simd::float3 p) {
+        const simd::float4 v = uniforms.view * simd::float4{ p.x, p.y, p.z, 1.0f };
+        return { v.x, v.y, v.z };
+    }
+
+    bool box_contains(const LightClusterBox& box, simd::float3 p, float slack) {
+        return p.x >= box.min.x - slack && p.x <= box.max.x + slack && p.y >= box.min.y - slack &&
+               p.y <= box.max.y + slack && p.z >= box.min.z - slack && p.z <= box.max.z + slack;
+    }
+}
+
+TEST(LightClusterTests, SlicesCoverTheRangeExponentially) {
+    const LightClusterUniforms uniforms = make_uniforms(0);
+    EXPECT_NEAR(light_cluster_slice_depth(uniforms, 0), uniforms.nearZ, 1e-5f);
+    EXPECT_NEAR(light_cluster_slice_depth(uniforms, LIGHT_CLUSTER_Z), uniforms.farZ, uniforms.farZ * 1e-5f);
+    EXPECT_EQ(light_cluster_slice(uniforms, 0.5f * uniforms.nearZ), 0u);
+    EXPECT_EQ(light_cluster_slice(uniforms, uniforms.farZ * 1.01f), LIGHT_CLUSTER_Z);
+
+    // Every slice is the same ratio deeper than the one before
+    const float ratio = light_cluster_slice_depth(uniforms, 1) / light_cluster_slice_depth(uniforms, 0);
+    for (uint32_t slice = 0; slice < LIGHT_CLUSTER_Z; ++slice) {
+        const float start = light_cluster_slice_depth(uniforms, slice);
+        const float end = light_cluster_slice_depth(uniforms, slice + 1);
+        EXPECT_NEAR(end / start, ratio, 1e-3f);
+        EXPECT_EQ(light_cluster_slice(uniforms, sqrtf(start * end)), slice);
+    }
+}
+
+TEST(LightClusterTests, FragmentsFallInsideTheirClusterBox) {
+    for (bool reverseZ : { false, true }) {
+        const LightClusterUniforms uniforms = make_uniforms(0, reverseZ);
+        for (float px : { 3.0f, 300.5f, 640.0f, 1279.0f }) {
+            for (float py : { 1.0f, 200.0f, 500.5f, 719.0f }) {
+                for (float depth : { 0.2f, 3.0f, 47.0f, 390.0f }) {
+                    const uint32_t cluster = light_cluster_of(uniforms, { px, py }, depth);
+                    ASSERT_LT(cluster, LIGHT_CLUSTER_COUNT);
+                    const uint32_t x = cluster % LIGHT_CLUSTER_X;
+                    const uint32_t y = cluster / LIGHT_CLUSTER_X % LIGHT_CLUSTER_Y;
+                    const uint32_t slice = cluster / (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y);
+
+                    // The view-space point behind the pixel, y up in NDC and down in pixels
+                    const float ndcX = 2.0f * px / uniforms.viewport.x - 1.0f;
+                    const float ndcY = 1.0f - 2.0f * py / uniforms.viewport.y;
+                    const simd::float3 p = { depth * (ndcX + uniforms.projection.z) / uniforms.projection.x,
+                                             depth * (ndcY + uniforms.projection.w) / uniforms.projection.y, -depth };
+                    EXPECT_TRUE(box_contains(light_cluster_box(uniforms, x, y, slice), p, depth * 1e-4f))
+                        << px << " " << py << " " << depth;
+                }
+            }
+        }
+        EXPECT_EQ(light_cluster_of(uniforms, { 10.0f, 10.0f }, 500.0f), LIGHT_CLUSTER_COUNT);
+    }
+}
+
+TEST(LightClusterTests, AttenuationFadesToZeroAtTheRadius) {
+    EXPECT_NEAR(light_attenuation(0.0f, 8.0f), 1.0f, 1e-6f);
+    EXPECT_EQ(light_attenuation(8.0f, 8.0f), 0.0f);
+    EXPECT_EQ(light_attenuation(20.0f, 8.0f), 0.0f);
+    float previous = 1.0f;
+    for (float d = 0.5f; d < 8.0f; d += 0.5f) {
+        const float a = light_attenuation(d, 8.0f);
+        EXPECT_LT(a, previous);
+        EXPECT_GT(a, 0.0f);
+        previous = a;
+    }
+}
+
+TEST(LightClusterTests, LightsAreListedInExactlyTheClustersTheyTouch) {
+    const LightClusterUniforms uniforms = make_uniforms(3);
+    const simd::float4x4 toWorld = simd::inverse(uniforms.view);
+    auto world = [&](simd::float3 v) {
+        const simd::float4 p = toWorld * simd::float4{ v.x, v.y, v.z, 1.0f };
+        return simd::float3{ p.x, p.y, p.z };
+    };
+    const PointLight lights[3] = {
+        { world({ 0.0f, 0.0f, -10.0f }), { 1.0f, 1.0f, 1.0f }, 2.0f },
+        { world({ -30.0f, 5.0f, -60.0f }), { 1.0f, 1.0f, 1.0f }, 8.0f },
+        { world({ 0.0f, 0.0f, 30.0f }), { 1.0f, 1.0f, 1.0f }, 5.0f },     // behind the camera
+    };
+    const LightClusterGrid grid = light_clusters_build(uniforms, lights);
+
+    uint32_t listed[3] = {};
+    for (uint32_t slice = 0; slice < LIGHT_CLUSTER_Z; ++slice) {
+        for (uint32_t y = 0; y < LIGHT_CLUSTER_Y; ++y) {
+            for (uint32_t x = 0; x < LIGHT_CLUSTER_X; ++x) {
+                const uint32_t cluster = light_cluster_index(x, y, slice);
+                const LightClusterBox box = light_cluster_box(uniforms, x, y, slice);
+                uint32_t expected = 0;
+                for (uint32_t i = 0; i < 3; ++i) {
+                    if (light_sphere_touches_box(to_view(uniforms, lights[i].position), lights[i].radius, box)) {
+                        EXPECT_EQ(grid.lights[cluster * LIGHT_CLUSTER_MAX_LIGHTS + expected], i);
+                        ++expected;
+                        ++listed[i];
+                    }
+                }
+                EXPECT_EQ(grid.counts[cluster], expected);
+            }
+        }
+    }
+    EXPECT_GT(listed[0], 0u);
+    EXPECT_GT(listed[1], 0u);
+    EXPECT_EQ(listed[2], 0u);
+
+    // The cluster of a lit point lists the light
+    const uint32_t centre = light_cluster_of(uniforms, { 640.0f, 360.0f }, 10.0f);
+    ASSERT_GT(grid.counts[centre], 0u);
+    EXPECT_EQ(grid.lights[centre * LIGHT_CLUSTER_MAX_LIGHTS], 0u);
+}
+
+TEST(LightClusterTests, CrowdedClustersKeepTheirTrueCount) {
+    const uint32_t count = LIGHT_CLUSTER_MAX_LIGHTS + 10;
+    const LightClusterUniforms uniforms = make_uniforms(count);
+    const simd::float4x4 toWorld = simd::inverse(uniforms.view);
+    std::vector<PointLight> lights(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const simd::float4 p = toWorld * simd::float4{ 0.01f * i, 0.0f, -20.0f, 1.0f };
+        lights[i] = { { p.x, p.y, p.z }, { 1.0f, 1.0f, 1.0f }, 1.0f };
+    }
+    const LightClusterGrid grid = light_clusters_build(uniforms, lights.data());
+    const uint32_t cluster = light_cluster_of(uniforms, { 640.0f, 360.0f }, 20.0f);
+    EXPECT_EQ(grid.counts[cluster], count);
+    for (uint32_t i = 0; i < LIGHT_CLUSTER_MAX_LIGHTS; ++i) {
+        EXPECT_EQ(grid.lights[cluster * LIGHT_CLUSTER_MAX_LIGHTS + i], i);
+    }
+}
+
+TEST(LightClusterTests, EmittersStandOnTheTerrainAndMove) {
+    auto height = [](float x, float z) { return 0.1f * x - 0.05f * z; };
+    const std::vector<LightEmitter> emitters = scatter_light_emitters(64, { 100.0f, -50.0f }, 30.0f, 7, height);
+    ASSERT_EQ(emitters.size(), 64u);
+    uint32_t vehicles = 0;
+    for (const LightEmitter& emitter : emitters) {
+        EXPECT_LE(fabsf(emitter.anchor.x - 100.0f), 30.0f);
+        EXPECT_LE(fabsf(emitter.anchor.z + 50.0f), 30.0f);
+        const float ground = height(emitter.anchor.x, emitter.anchor.z);
+        EXPECT_GT(emitter.anchor.y, ground);
+        EXPECT_LT(emitter.anchor.y, ground + 2.0f);
+        vehicles += emitter.orbit > 0.0f;
+    }
+    EXPECT_EQ(vehicles, 16u);
+
+    std::vector<PointLight> before(64);
+    std::vector<PointLight> after(64);
+    light_emitters_evaluate(emitters.data(), 64, 1.0, before.data());
+    light_emitters_evaluate(emitters.data(), 64, 2.0, after.data());
+    for (uint32_t i = 0; i < 64; ++i) {
+        const LightEmitter& emitter = emitters[i];
+        const simd::float3 offset = after[i].position - emitter.anchor;
+        if (emitter.orbit > 0.0f) {
+            EXPECT_NEAR(simd::length(offset), emitter.orbit, 1e-3f);
+            EXPECT_NEAR(offset.y, 0.0f, 1e-5f);
+            EXPECT_GT(simd::length(after[i].position - before[i].position), 0.1f);
+        } else {
+            EXPECT_NEAR(simd::length(offset), 0.0f, 1e-6f);
+            EXPECT_LE(after[i].color.x, emitter.color.x + 1e-5f);
+            EXPECT_GE(after[i].color.x, emitter.color.x * 0.7f - 1e-5f);
+        }
+        EXPECT_EQ(after[i].radius, emitter.radius);
+    }
+}
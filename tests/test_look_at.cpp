@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "look_at.hpp"
+
+#include <cmath>
+
+namespace {
+    // A camera looking down -Z and a little down, from above the field's centre plus an offset
+    Camera make_view(bool reverseZ, simd::float3 position) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = position;
+        cam.pitch = -0.3f;
+        update_camera_view(cam);
+        return cam;
+    }
+
+    // A field rising 0.5 per unit along x, over [-16, 16] in x and z around a centre
+    HeightField ramp_field(float centerX = 0.0f, float centerZ = 0.0f) {
+        HeightField field;
+        field.originX = centerX - 16.0f;
+        field.originZ = centerZ - 16.0f;
+        field.spacing = 1.0f;
+        field.width = 33;
+        field.depth = 33;
+        field.heights.resize(33 * 33);
+        for (int z = 0; z < 33; ++z) {
+            for (int x = 0; x < 33; ++x) {
+                field.heights[z * 33 + x] = 0.5f * (float)(x - 16);
+            }
+        }
+        return field;
+    }
+
+    // Where a world point lands in the view, and its depth, as the depth buffer would hold it
+    simd::float2 project(const Camera& cam, simd::float3 world, float& depth) {
+        const simd::float4 clip = cam.projectionMatrix * cam.viewMatrix * simd::float4{ world.x, world.y, world.z, 1 };
+        depth = clip.z / clip.w;
+        return { 0.5f + 0.5f * clip.x / clip.w, 0.5f - 0.5f * clip.y / clip.w };
+    }
+}
+
+TEST(LookAtTests, DepthUnderThePointReconstructsTheSurface) {
+    for (bool reverseZ : { false, true }) {
+        const Camera cam = make_view(reverseZ, { 0.0f, 8.0f, 12.0f });
+        const simd::float3 surface = { 2.0f, 1.0f, -3.0f };
+        float depth = 0.0f;
+        const LookAtQuery query = look_at_query(cam, project(cam, surface, depth), 7);
+        simd::float3 position;
+        ASSERT_TRUE(look_at_unproject(query, depth, position));
+        EXPECT_NEAR(position.x, surface.x, 1e-3f);
+        EXPECT_NEAR(position.y, surface.y, 1e-3f);
+        EXPECT_NEAR(position.z, surface.z, 1e-3f);
+        EXPECT_EQ(query.frame, 7u);
+        // The clear depth is sky
+        EXPECT_FALSE(look_at_unproject(query, camera_clear_depth(cam), position));
+    }
+}
+
+TEST(LookAtTests, FarFromTheOriginThePointKeepsItsPrecision) {
+    const simd::float3 eye = { 20000.0f, 8.0f, -30000.0f };
+    const Camera cam = make_view(true, eye);
+    const simd::float3 surface = eye + simd::float3{ 1.5f, -7.0f, -15.0f };
+    float depth = 0.0f;
+    const LookAtQuery query = look_at_query(cam, project(cam, surface, depth), 1);
+    simd::float3 position;
+    ASSERT_TRUE(look_at_unproject(query, depth, position));
+    // A float ulp is 2 mm out here; cancelling world coordinates in the inverse would lose far more
+    EXPECT_NEAR(position.x, surface.x, 0.02f);
+    EXPECT_NEAR(position.y, surface.y, 0.02f);
+    EXPECT_NEAR(position.z, surface.z, 0.02f);
+}
+
+TEST(LookAtTests, ResolveDescribesTheTerrainUnderThePoint) {
+    const HeightField field = ramp_field();
+    const Camera cam = make_view(false, { 0.0f, 12.0f, 14.0f });
+    BiomeSettings biomes;
+
+    // On the ramp: height 0.5 * x, slope atan(0.5)
+    const simd::float3 ground = { 4.0f, 2.0f, -2.0f };
+    float depth = 0.0f;
+    LookAtQuery query = look_at_query(cam, project(cam, ground, depth), 3);
+    LookAtResult result = look_at_resolve(query, depth, field, biomes);
+    ASSERT_TRUE(result.hit);
+    EXPECT_TRUE(result.onTerrain);
+    EXPECT_NEAR(result.terrainHeight, 2.0f, 1e-3f);
+    EXPECT_NEAR(result.slopeDegrees, 26.565f, 0.01f);
+    EXPECT_NEAR(result.distance, simd::length(ground - cam.position), 1e-2f);
+    EXPECT_FALSE(result.hasBiome);
+    EXPECT_EQ(result.frame, 3u);
+
+    // An object standing on the ramp is hit, but is not the terrain
+    const simd::float3 object = { 4.0f, 4.0f, -2.0f };
+    query = look_at_query(cam, project(cam, object, depth), 4);
+    biomes.cellsPerEdge = 4;
+    result = look_at_resolve(query, depth, field, biomes);
+    ASSERT_TRUE(result.hit);
+    EXPECT_FALSE(result.onTerrain);
+    EXPECT_NEAR(result.terrainHeight, 2.0f, 1e-2f);
+    EXPECT_TRUE(result.hasBiome);
+    EXPECT_EQ(result.biome, biome_classify(biome_climate(biomes, result.position.x, result.position.z, 2.0f)));
+
+    // Sky
+    result = look_at_resolve(query, camera_clear_depth(cam), field, biomes);
+    EXPECT_FALSE(result.hit);
+}
+
+TEST(LookAtTests, BiomesHaveNames) {
+    EXPECT_STREQ(biome_name(Biome::Tundra), "tundra");
+    EXPECT_STREQ(biome_name(Biome::Jungle), "jungle");
+}
@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include "map_tiles.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <set>
+#include <tuple>
+
+namespace {
+    MapTileSettings small_settings() {
+        MapTileSettings settings;
+        settings.originX = -64.0f;
+        settings.originZ = -64.0f;
+        settings.finestTileWorld = 32.0f;
+        settings.levels = 3;
+        settings.tileSize = 4;
+        return settings;
+    }
+
+    MapTileImage flat_tile(const MapTile& tile, uint32_t tileSize, uint8_t value) {
+        return { tile, std::vector<uint8_t>((size_t)tileSize * tileSize * 4, value) };
+    }
+}
+
+TEST(MapTileTests, LevelsHalveTheTileSize) {
+    const MapTileSettings settings = small_settings();
+    EXPECT_FLOAT_EQ(map_tile_world_size(settings, 2), 32.0f);
+    EXPECT_FLOAT_EQ(map_tile_world_size(settings, 0), 128.0f);
+
+    const BoundingBox bounds = map_tile_bounds(settings, { 2, 3, 1 });
+    EXPECT_FLOAT_EQ(bounds.min.x, 32.0f);
+    EXPECT_FLOAT_EQ(bounds.max.x, 64.0f);
+    EXPECT_FLOAT_EQ(bounds.min.z, -32.0f);
+    EXPECT_FLOAT_EQ(bounds.max.z, 0.0f);
+    EXPECT_FLOAT_EQ(bounds.min.y, settings.minHeight);
+    EXPECT_FLOAT_EQ(bounds.max.y, settings.maxHeight);
+
+    EXPECT_EQ(map_tile_parent({ 2, 3, 1 }), (MapTile{ 1, 1, 0 }));
+}
+
+TEST(MapTileTests, CameraFillsTheViewportNorthUp) {
+    const MapTileSettings settings = small_settings();
+    const MapTile tile{ 2, 1, 2 };
+    const BoundingBox bounds = map_tile_bounds(settings, tile);
+    const Camera cam = map_tile_camera(settings, tile);
+    const simd::float4x4 viewProjection = cam.projectionMatrix * cam.viewMatrix;
+
+    auto project = [&](float x, float y, float z) {
+        const simd::float4 clip = viewProjection * simd::float4{ x, y, z, 1.0f };
+        return simd::float3{ clip.x, clip.y, clip.z } / clip.w;
+    };
+    // North-west at the top left, south-east at the bottom right
+    const simd::float3 northWest = project(bounds.min.x, 0.0f, bounds.min.z);
+    EXPECT_NEAR(northWest.x, -1.0f, 1e-5f);
+    EXPECT_NEAR(northWest.y, 1.0f, 1e-5f);
+    const simd::float3 southEast = project(bounds.max.x, 0.0f, bounds.max.z);
+    EXPECT_NEAR(southEast.x, 1.0f, 1e-5f);
+    EXPECT_NEAR(southEast.y, -1.0f, 1e-5f);
+
+    // The whole height range is inside the depth range, higher ground nearer
+    const float top = project(bounds.min.x, settings.maxHeight, bounds.min.z).z;
+    const float bottom = project(bounds.min.x, settings.minHeight, bounds.min.z).z;
+    EXPECT_GE(top, 0.0f);
+    EXPECT_LE(bottom, 1.0f);
+    EXPECT_LT(top, bottom);
+}
+
+TEST(MapTileTests, PathNamesLevelAndPosition) {
+    EXPECT_EQ(map_tile_path("out", { 3, 5, 7 }), (std::filesystem::path("out") / "3" / "5_7.png").string());
+}
+
+TEST(MapTileTests, ScheduleVisitsEveryFinestTileInMortonOrder) {
+    const MapTileSettings settings = small_settings();
+    const std::vector<MapTile> tiles = map_tile_schedule(settings, [](const MapTile&) { return false; });
+    ASSERT_EQ(tiles.size(), 16u);
+    EXPECT_EQ(tiles[0], (MapTile{ 2, 0, 0 }));
+    EXPECT_EQ(tiles[1], (MapTile{ 2, 1, 0 }));
+    EXPECT_EQ(tiles[2], (MapTile{ 2, 0, 1 }));
+    EXPECT_EQ(tiles[3], (MapTile{ 2, 1, 1 }));
+    EXPECT_EQ(tiles[4], (MapTile{ 2, 2, 0 }));
+
+    // Every group of four shares a parent
+    for (size_t i = 0; i < tiles.size(); i += 4) {
+        for (size_t j = 1; j < 4; ++j) {
+            EXPECT_EQ(map_tile_parent(tiles[i + j]), map_tile_parent(tiles[i]));
+        }
+    }
+}
+
+TEST(MapTileTests, ScheduleSkipsFinishedSubtrees) {
+    const MapTileSettings settings = small_settings();
+    // Everything done except the finest tile (2, 3, 3) and the root
+    const std::vector<MapTile> tiles = map_tile_schedule(settings, [](const MapTile& tile) {
+        return tile.level == 1 || (tile.level == 2 && tile != MapTile{ 2, 3, 3 });
+    });
+    // A missing root would need every quadrant to rebuild it
+    EXPECT_EQ(tiles.size(), 16u);
+
+    const std::vector<MapTile> resumed = map_tile_schedule(settings, [](const MapTile& tile) {
+        return tile != MapTile{ 2, 3, 3 } && tile != MapTile{ 1, 1, 1 } && tile != MapTile{ 0, 0, 0 };
+    });
+    EXPECT_EQ(resumed.size(), 16u);
+
+    const std::vector<MapTile> partial = map_tile_schedule(settings, [](const MapTile& tile) {
+        return tile != MapTile{ 2, 3, 3 } && tile != MapTile{ 1, 1, 1 };
+    });
+    ASSERT_EQ(partial.size(), 4u);
+    for (const MapTile& tile : partial) {
+        EXPECT_EQ(map_tile_parent(tile), (MapTile{ 1, 1, 1 }));
+    }
+
+    EXPECT_TRUE(map_tile_schedule(settings, [](const MapTile&) { return true; }).empty());
+}
+
+TEST(MapTileTests, PyramidFinishesEveryTile) {
+    const MapTileSettings settings = small_settings();
+    MapPyramid pyramid(settings);
+    std::vector<MapTileImage> finished;
+    const std::vector<MapTile> tiles = map_tile_schedule(settings, [](const MapTile&) { return false; });
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const size_t before = finished.size();
+        pyramid.add(flat_tile(tiles[i], settings.tileSize, (uint8_t)(i * 10)), finished);
+        // The fourth sibling also finishes its parent
+        EXPECT_EQ(finished.size() - before, i % 16 == 15 ? 3u : i % 4 == 3 ? 2u : 1u);
+    }
+
+    std::set<std::tuple<uint32_t, uint32_t, uint32_t>> seen;
+    for (const MapTileImage& image : finished) {
+        EXPECT_EQ(image.bgra.size(), (size_t)settings.tileSize * settings.tileSize * 4);
+        seen.insert({ image.tile.level, image.tile.x, image.tile.z });
+    }
+    EXPECT_EQ(seen.size(), 21u);
+    EXPECT_EQ(finished.back().tile, (MapTile{ 0, 0, 0 }));
+}
+
+TEST(MapTileTests, PyramidDownsamplesIntoQuadrants) {
+    MapTileSettings settings = small_settings();
+    settings.levels = 2;
+    MapPyramid pyramid(settings);
+    std::vector<MapTileImage> finished;
+    const uint8_t values[4] = { 10, 20, 30, 40 };
+    for (uint32_t child = 0; child < 4; ++child) {
+        pyramid.add(flat_tile({ 1, child & 1, child >> 1 }, settings.tileSize, values[child]), finished);
+    }
+    ASSERT_EQ(finished.size(), 5u);
+    const MapTileImage& parent = finished.back();
+    ASSERT_EQ(parent.tile, (MapTile{ 0, 0, 0 }));
+
+    const uint32_t size = settings.tileSize;
+    auto pixel = [&](uint32_t x, uint32_t y) { return parent.bgra[(y * size + x) * 4]; };
+    EXPECT_EQ(pixel(0, 0), 10);
+    EXPECT_EQ(pixel(size - 1, 0), 20);
+    EXPECT_EQ(pixel(0, size - 1), 30);
+    EXPECT_EQ(pixel(size - 1, size - 1), 40);
+}
+
+TEST(MapTileTests, PyramidDropsAnAbandonedParent) {
+    const MapTileSettings settings = small_settings();
+    MapPyramid pyramid(settings);
+    std::vector<MapTileImage> finished;
+    // A rerun renders one child of (1, 0, 0) and then all of (1, 1, 0)
+    pyramid.add(flat_tile({ 2, 0, 0 }, settings.tileSize, 200), finished);
+    for (uint32_t child = 0; child < 4; ++child) {
+        pyramid.add(flat_tile({ 2, 2 + (child & 1), child >> 1 }, settings.tileSize, 8), finished);
+    }
+    ASSERT_EQ(finished.size(), 6u);
+    EXPECT_EQ(finished.back().tile, (MapTile{ 1, 1, 0 }));
+    for (uint8_t value : finished.back().bgra) {
+        ASSERT_EQ(value, 8);
+    }
+}
+
+TEST(MapTileTests, SavedTilesAreSkippedOnRestart) {
+    const MapTileSettings settings = small_settings();
+    const std::string directory = ::testing::TempDir() + "map_tiles_restart";
+    std::filesystem::remove_all(directory);
+
+    auto done = [&](const MapTile& tile) { return std::filesystem::exists(map_tile_path(directory, tile)); };
+    const std::vector<MapTile> first = map_tile_schedule(settings, done);
+    ASSERT_EQ(first.size(), 16u);
+
+    // Interrupted after the first parent and its subtree
+    MapPyramid pyramid(settings);
+    std::vector<MapTileImage> finished;
+    for (size_t i = 0; i < 4; ++i) {
+        pyramid.add(flat_tile(first[i], settings.tileSize, 50), finished);
+    }
+    std::string error;
+    for (const MapTileImage& image : finished) {
+        ASSERT_TRUE(save_map_tile(directory, image, settings.tileSize, error)) << error;
+    }
+    EXPECT_TRUE(std::filesystem::exists(map_tile_path(directory, { 1, 0, 0 })));
+
+    // The root is still missing, so every finest tile has to be rendered again to rebuild it
+    EXPECT_EQ(map_tile_schedule(settings, done).size(), 16u);
+
+    // With the root saved, only the three unfinished quadrants remain
+    ASSERT_TRUE(save_map_tile(directory, flat_tile({ 0, 0, 0 }, settings.tileSize, 0), settings.tileSize, error));
+    const std::vector<MapTile> resumed = map_tile_schedule(settings, done);
+    ASSERT_EQ(resumed.size(), 12u);
+    for (const MapTile& tile : resumed) {
+        EXPECT_NE(map_tile_parent(tile), (MapTile{ 1, 0, 0 }));
+    }
+    std::filesystem::remove_all(directory);
+}
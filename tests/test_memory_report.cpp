@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include "memory_report.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+TEST(MemoryReportTests, TaggedAllocationsAreCountedUntilFreed) {
+    const uint64_t before = memory_tag_cpu_bytes(MEMORY_UI);
+    void* a = memory_tag_alloc(100, MEMORY_UI);
+    void* b = memory_tag_alloc(28, MEMORY_UI);
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+    EXPECT_EQ(memory_tag_cpu_bytes(MEMORY_UI), before + 128);
+    EXPECT_EQ((uintptr_t)a % alignof(std::max_align_t), 0u);
+    memset(a, 0xab, 100); // The whole block is writable
+
+    memory_tag_free(a);
+    EXPECT_EQ(memory_tag_cpu_bytes(MEMORY_UI), before + 28);
+    memory_tag_free(b);
+    memory_tag_free(nullptr);
+    EXPECT_EQ(memory_tag_cpu_bytes(MEMORY_UI), before);
+}
+
+TEST(MemoryReportTests, TagsAreCountedSeparately) {
+    const uint64_t terrain = memory_tag_cpu_bytes(MEMORY_TERRAIN);
+    void* ui = memory_tag_alloc(64, MEMORY_UI);
+    EXPECT_EQ(memory_tag_cpu_bytes(MEMORY_TERRAIN), terrain);
+    memory_tag_free(ui);
+}
+
+TEST(MemoryReportTests, TotalsSumEveryTag) {
+    MemoryReport report;
+    report.gpuBytes[MEMORY_TERRAIN] = 1000;
+    report.gpuBytes[MEMORY_TARGETS] = 24;
+    report.cpuBytes[MEMORY_UI] = 7;
+    EXPECT_EQ(memory_report_gpu_total(report), 1024u);
+    EXPECT_EQ(memory_report_cpu_total(report), 7u);
+    EXPECT_STREQ(memory_tag_name(MEMORY_MESHES), "meshes");
+}
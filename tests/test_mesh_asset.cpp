@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "landscape.hpp"
+#include "mesh_asset.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+    MeshData landscape_mesh(int width, int depth) {
+        MeshSize size = landscape_mesh_size(width, depth);
+        MeshData mesh;
+        mesh.vertices.resize(size.vertexCount);
+        mesh.indices.format = IndexFormat::UInt32;
+        mesh.indices.indices32.resize(size.indexCount);
+        build_landscape(width, depth, mesh.vertices.data(), mesh.indices.indices32.data());
+        return mesh;
+    }
+
+    // A flat grid in the y = 0 plane, every triangle facing +y
+    MeshData flat_grid(int cells) {
+        MeshData mesh;
+        const int side = cells + 1;
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                Vertex vertex;
+                vertex.position = simd::float3{ (float)x, 0.0f, (float)z };
+                vertex.normal = simd::float3{ 0.0f, 1.0f, 0.0f };
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        mesh.indices.format = IndexFormat::UInt32;
+        for (int z = 0; z < cells; ++z) {
+            for (int x = 0; x < cells; ++x) {
+                const uint32_t a = z * side + x;
+                const uint32_t c = a + side;
+                for (uint32_t i : { a, c, a + 1, a + 1, c, c + 1 }) {
+                    mesh.indices.indices32.push_back(i);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    std::string test_path(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "mesh_asset_tests";
+        std::filesystem::create_directories(dir);
+        return (dir / name).string();
+    }
+}
+
+TEST(MeshAssetTests, MeshletsRespectLimitsAndCoverEveryTriangleInOrder) {
+    CookedMesh mesh = cook_mesh(landscape_mesh(40, 40));
+    EXPECT_EQ(mesh.indices.format, IndexFormat::UInt16);
+    ASSERT_FALSE(mesh.meshlets.empty());
+
+    size_t index = 0;
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        EXPECT_LE(meshlet.vertexCount, MESHLET_MAX_VERTICES);
+        EXPECT_LE(meshlet.triangleCount, MESHLET_MAX_TRIANGLES);
+        for (uint32_t t = 0; t < meshlet.triangleCount * 3; ++t) {
+            const uint8_t local = mesh.meshletTriangles[meshlet.triangleOffset + t];
+            ASSERT_LT(local, meshlet.vertexCount);
+            const uint32_t vertex = mesh.meshletVertices[meshlet.vertexOffset + local];
+            EXPECT_EQ(vertex, mesh.indices[index++]);
+
+            const simd::float3& p = mesh.vertices[vertex].position;
+            const float dx = p.x - meshlet.center[0];
+            const float dy = p.y - meshlet.center[1];
+            const float dz = p.z - meshlet.center[2];
+            EXPECT_LE(dx * dx + dy * dy + dz * dz, meshlet.radius * meshlet.radius * 1.0001f + 1e-6f);
+        }
+    }
+    // Meshlets cover the full detail level; the coarser levels follow it
+    EXPECT_EQ(index, mesh.lods.levels[0].indexCount);
+    ASSERT_GT(mesh.lods.count, 1u);
+    const MeshLod& last = mesh.lods.levels[mesh.lods.count - 1];
+    EXPECT_EQ(mesh.indices.size(), last.indexOffset + last.indexCount);
+}
+
+TEST(MeshAssetTests, NormalConesCullOnlyFromBehind) {
+    CookedMesh mesh = cook_mesh(flat_grid(16));
+    ASSERT_GT(mesh.meshlets.size(), 1u);
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        EXPECT_NEAR(meshlet.coneAxis[1], 1.0f, 1e-5f);
+        EXPECT_NEAR(meshlet.coneCutoff, 0.0f, 1e-3f);
+
+        const float below[3] = { meshlet.center[0], -50.0f, meshlet.center[2] };
+        const float above[3] = { meshlet.center[0], 50.0f, meshlet.center[2] };
+        const float grazing[3] = { meshlet.center[0] + 100.0f, 0.01f, meshlet.center[2] };
+        EXPECT_TRUE(meshlet_backfacing(meshlet, below));
+        EXPECT_FALSE(meshlet_backfacing(meshlet, above));
+        EXPECT_FALSE(meshlet_backfacing(meshlet, grazing));
+    }
+
+    // Triangles facing opposite ways give an empty cone that never culls
+    MeshData folded = flat_grid(1);
+    folded.indices.indices32 = { 0, 2, 1, 0, 1, 2 };
+    CookedMesh both = cook_mesh(folded);
+    ASSERT_EQ(both.meshlets.size(), 1u);
+    const float anywhere[3] = { 0.5f, -3.0f, 0.5f };
+    EXPECT_FALSE(meshlet_backfacing(both.meshlets[0], anywhere));
+}
+
+TEST(MeshAssetTests, MapsWrittenFileWithoutConversion) {
+    CookedMesh mesh = cook_mesh(landscape_mesh(12, 9));
+    const std::string path = test_path("round_trip.mesh");
+    ASSERT_TRUE(write_mesh_asset(path, mesh));
+    EXPECT_EQ(std::filesystem::file_size(path), mesh_asset_file_size(mesh));
+
+    MeshAsset asset;
+    ASSERT_TRUE(map_mesh_asset(path, asset));
+    EXPECT_EQ(asset.header.vertexCount, mesh.vertices.size());
+    EXPECT_EQ(asset.header.indexCount, mesh.indices.size());
+    EXPECT_EQ(asset.header.meshletCount, mesh.meshlets.size());
+    EXPECT_EQ((IndexFormat)asset.header.indexFormat, mesh.indices.format);
+    EXPECT_FLOAT_EQ(asset.header.boundsMax[0], mesh.bounds.max.x);
+    EXPECT_EQ(memcmp(asset.vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)), 0);
+    EXPECT_EQ(memcmp(asset.indices, mesh.indices.data(), mesh.indices.byte_size()), 0);
+    EXPECT_EQ(memcmp(asset.meshletTriangles, mesh.meshletTriangles.data(), mesh.meshletTriangles.size()), 0);
+    EXPECT_EQ(asset.meshlets[0].triangleCount, mesh.meshlets[0].triangleCount);
+    ASSERT_EQ(asset.header.lodCount, mesh.lods.count);
+    for (uint32_t i = 0; i < mesh.lods.count; ++i) {
+        EXPECT_EQ(asset.header.lods[i].indexOffset, mesh.lods.levels[i].indexOffset);
+        EXPECT_EQ(asset.header.lods[i].indexCount, mesh.lods.levels[i].indexCount);
+        EXPECT_FLOAT_EQ(asset.header.lods[i].error, mesh.lods.levels[i].error);
+    }
+    unmap_mesh_asset(asset);
+}
+
+TEST(MeshAssetTests, DecodesCompressedFilesToTheSameLayout) {
+    CookedMesh mesh = cook_mesh(landscape_mesh(24, 24));
+    const std::string path = test_path("compressed.mesh");
+    ASSERT_TRUE(write_mesh_asset(path, mesh, true));
+    EXPECT_LT(std::filesystem::file_size(path), mesh_asset_file_size(mesh) / 2);
+
+    MeshAsset asset;
+    ASSERT_TRUE(map_mesh_asset(path, asset));
+    EXPECT_TRUE(asset.decoded);
+    EXPECT_EQ(asset.length, mesh_asset_file_size(mesh));
+    EXPECT_EQ(memcmp(asset.vertices, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)), 0);
+    EXPECT_EQ(memcmp(asset.indices, mesh.indices.data(), mesh.indices.byte_size()), 0);
+    EXPECT_EQ(memcmp(asset.meshlets, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet)), 0);
+    EXPECT_EQ(memcmp(asset.meshletVertices, mesh.meshletVertices.data(),
+                     mesh.meshletVertices.size() * sizeof(uint32_t)), 0);
+    EXPECT_EQ(memcmp(asset.meshletTriangles, mesh.meshletTriangles.data(), mesh.meshletTriangles.size()), 0);
+    unmap_mesh_asset(asset);
+
+    // A damaged section fails the load rather than decoding garbage
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    EXPECT_FALSE(map_mesh_asset(path, asset));
+}
+
+TEST(MeshAssetTests, RejectsTruncatedOrForeignFiles) {
+    CookedMesh mesh = cook_mesh(landscape_mesh(4, 4));
+    const std::string path = test_path("truncated.mesh");
+    ASSERT_TRUE(write_mesh_asset(path, mesh));
+    std::filesystem::resize_file(path, mesh_asset_file_size(mesh) - MESH_ASSET_ALIGNMENT);
+
+    MeshAsset asset;
+    EXPECT_FALSE(map_mesh_asset(path, asset));
+
+    const std::string foreign = test_path("foreign.mesh");
+    {
+        std::ofstream file(foreign, std::ios::binary | std::ios::trunc);
+        std::vector<char> zeros(4096, 0);
+        file.write(zeros.data(), zeros.size());
+    }
+    EXPECT_FALSE(map_mesh_asset(foreign, asset));
+    EXPECT_FALSE(map_mesh_asset(test_path("missing.mesh"), asset));
+    EXPECT_EQ(asset.data, nullptr);
+}
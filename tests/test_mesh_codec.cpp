@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "mesh_codec.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    // A terrain-like grid: x and z step evenly, heights roll smoothly
+    struct GridVertex {
+        float position[3];
+        int8_t normal[4];
+    };
+
+    std::vector<GridVertex> grid_vertices(uint32_t resolution) {
+        std::vector<GridVertex> vertices;
+        for (uint32_t z = 0; z < resolution; ++z) {
+            for (uint32_t x = 0; x < resolution; ++x) {
+                GridVertex v = {};
+                v.position[0] = (float)x;
+                v.position[1] = 4.0f * sinf(x * 0.2f) * cosf(z * 0.15f);
+                v.position[2] = (float)z;
+                v.normal[1] = 127;
+                vertices.push_back(v);
+            }
+        }
+        return vertices;
+    }
+}
+
+TEST(MeshCodecTests, LzRoundTripsAndShrinksRepeats) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 4000; ++i) {
+        data.push_back((uint8_t)(i % 7));
+    }
+    std::vector<uint8_t> block;
+    lz_compress(data.data(), data.size(), block);
+    EXPECT_LT(block.size(), data.size() / 20);
+    std::vector<uint8_t> decoded(data.size());
+    ASSERT_TRUE(lz_decompress(block.data(), block.size(), decoded.data(), decoded.size()));
+    EXPECT_EQ(decoded, data);
+}
+
+TEST(MeshCodecTests, LzRoundTripsRandomAndTinyInputs) {
+    std::mt19937 rng(7);
+    for (size_t size : { 0u, 1u, 5u, 12u, 13u, 100u, 70000u }) {
+        std::vector<uint8_t> data(size);
+        for (uint8_t& byte : data) {
+            byte = (uint8_t)(rng() % 4); // Few symbols, so there are short matches everywhere
+        }
+        std::vector<uint8_t> block;
+        lz_compress(data.data(), data.size(), block);
+        std::vector<uint8_t> decoded(size);
+        ASSERT_TRUE(lz_decompress(block.data(), block.size(), decoded.data(), decoded.size())) << size;
+        EXPECT_EQ(decoded, data) << size;
+    }
+}
+
+TEST(MeshCodecTests, LzRejectsMalformedBlocks) {
+    const std::vector<uint8_t> data(64, 9);
+    std::vector<uint8_t> block;
+    lz_compress(data.data(), data.size(), block);
+    std::vector<uint8_t> decoded(data.size());
+    // Too short an output, a truncated block and an offset before the start
+    EXPECT_FALSE(lz_decompress(block.data(), block.size(), decoded.data(), decoded.size() - 1));
+    EXPECT_FALSE(lz_decompress(block.data(), block.size() - 3, decoded.data(), decoded.size()));
+    const uint8_t farMatch[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+    EXPECT_FALSE(lz_decompress(farMatch, sizeof(farMatch), decoded.data(), 5));
+}
+
+TEST(MeshCodecTests, VerticesRoundTripSmallerThanRaw) {
+    const std::vector<GridVertex> vertices = grid_vertices(33);
+    const size_t rawBytes = vertices.size() * sizeof(GridVertex);
+    const std::vector<uint8_t> encoded = encode_vertex_buffer(vertices.data(), vertices.size(), sizeof(GridVertex));
+    EXPECT_LT(encoded.size(), rawBytes / 2);
+
+    std::vector<GridVertex> decoded(vertices.size());
+    ASSERT_TRUE(decode_vertex_buffer(encoded.data(), encoded.size(), decoded.data(), decoded.size(),
+                                     sizeof(GridVertex)));
+    EXPECT_EQ(memcmp(decoded.data(), vertices.data(), rawBytes), 0);
+    // The stride and count are part of the format
+    EXPECT_FALSE(decode_vertex_buffer(encoded.data(), encoded.size(), decoded.data(), decoded.size() - 1,
+                                      sizeof(GridVertex)));
+}
+
+TEST(MeshCodecTests, IndicesRoundTripInBothWidths) {
+    // Strips over a grid, as the LOD index lists and cache-ordered meshes look
+    std::vector<uint32_t> indices32;
+    for (uint32_t z = 0; z < 20; ++z) {
+        for (uint32_t x = 0; x < 20; ++x) {
+            const uint32_t i = z * 21 + x;
+            indices32.insert(indices32.end(), { i, i + 21, i + 1, i + 1, i + 21, i + 22 });
+        }
+    }
+    indices32.push_back(0xfffffff0u); // A large jump still round trips
+    std::vector<uint8_t> encoded = encode_index_buffer(indices32.data(), indices32.size(), 4);
+    EXPECT_LT(encoded.size(), indices32.size());
+    std::vector<uint32_t> decoded32(indices32.size());
+    ASSERT_TRUE(decode_index_buffer(encoded.data(), encoded.size(), decoded32.data(), decoded32.size(), 4));
+    EXPECT_EQ(decoded32, indices32);
+
+    std::vector<uint16_t> indices16(indices32.begin(), indices32.end() - 1);
+    encoded = encode_index_buffer(indices16.data(), indices16.size(), 2);
+    std::vector<uint16_t> decoded16(indices16.size());
+    ASSERT_TRUE(decode_index_buffer(encoded.data(), encoded.size(), decoded16.data(), decoded16.size(), 2));
+    EXPECT_EQ(decoded16, indices16);
+}
+
+TEST(MeshCodecTests, HeightGridsPredictSlopes) {
+    const uint32_t width = 33, height = 33;
+    std::vector<uint16_t> slope(width * height), hills(width * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            slope[y * width + x] = (uint16_t)(1000 + 7 * x + 3 * y);
+            hills[y * width + x] = (uint16_t)(30000 + 2000 * sinf(x * 0.3f) * cosf(y * 0.2f));
+        }
+    }
+    // A plane is predicted exactly past the first row and column
+    const std::vector<uint8_t> plane = encode_height_grid(slope.data(), width, height);
+    EXPECT_LT(plane.size(), slope.size() * 2 / 16);
+    std::vector<uint16_t> decoded(slope.size());
+    ASSERT_TRUE(decode_height_grid(plane.data(), plane.size(), decoded.data(), width, height));
+    EXPECT_EQ(decoded, slope);
+
+    const std::vector<uint8_t> rolling = encode_height_grid(hills.data(), width, height);
+    // Curvature leaves residuals of about a byte a sample
+    EXPECT_LT(rolling.size(), hills.size() * 2 * 3 / 4);
+    ASSERT_TRUE(decode_height_grid(rolling.data(), rolling.size(), decoded.data(), width, height));
+    EXPECT_EQ(decoded, hills);
+}
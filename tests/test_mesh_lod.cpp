@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "mesh_lod.hpp"
+#include "camera.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    // A flat grid in the y = 0 plane, every triangle facing +y
+    MeshData flat_grid(int cells) {
+        MeshData mesh;
+        const int side = cells + 1;
+        for (int z = 0; z < side; ++z) {
+            for (int x = 0; x < side; ++x) {
+                mesh.vertices.push_back({ { (float)x, 0.0f, (float)z }, { 0.0f, 1.0f, 0.0f } });
+            }
+        }
+        for (int z = 0; z < cells; ++z) {
+            for (int x = 0; x < cells; ++x) {
+                const uint32_t a = z * side + x;
+                const uint32_t c = a + side;
+                for (uint32_t i : { a, c, a + 1, a + 1, c, c + 1 }) {
+                    mesh.indices.indices32.push_back(i);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // A closed unit sphere of rings x segments quads, the poles split like every other row
+    MeshData sphere(int rings, int segments) {
+        MeshData mesh;
+        for (int r = 0; r <= rings; ++r) {
+            const float theta = (float)M_PI * r / rings;
+            const float radius = r == 0 || r == rings ? 0.0f : sinf(theta);
+            for (int s = 0; s <= segments; ++s) {
+                const float phi = 2.0f * (float)M_PI * (s % segments) / segments;
+                const simd::float3 p = { radius * cosf(phi), cosf(theta), radius * sinf(phi) };
+                mesh.vertices.push_back({ p, p });
+            }
+        }
+        const int side = segments + 1;
+        for (int r = 0; r < rings; ++r) {
+            for (int s = 0; s < segments; ++s) {
+                const uint32_t a = r * side + s;
+                const uint32_t c = a + side;
+                for (uint32_t i : { a, a + 1, c, a + 1, c + 1, c }) {
+                    mesh.indices.indices32.push_back(i);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    simd::float3 triangle_normal(const MeshData& mesh, const std::vector<uint32_t>& indices, size_t t) {
+        const simd::float3 a = mesh.vertices[indices[t]].position;
+        const simd::float3 b = mesh.vertices[indices[t + 1]].position;
+        const simd::float3 c = mesh.vertices[indices[t + 2]].position;
+        return simd::cross(b - a, c - a);
+    }
+}
+
+TEST(MeshLodTests, FlatGridSimplifiesWithoutErrorOrFlips) {
+    const MeshData grid = flat_grid(16);
+    float error = 1.0f;
+    const std::vector<uint32_t> simplified = simplify_mesh(grid.vertices, grid.indices.indices32.data(),
+                                                           grid.indices.indices32.size(), 96, error);
+    EXPECT_LE(simplified.size(), 96u);
+    EXPECT_EQ(simplified.size() % 3, 0u);
+    EXPECT_NEAR(error, 0.0f, 1e-3f);
+
+    // Every triangle still faces up, and together they still cover the grid
+    float area = 0.0f;
+    for (size_t t = 0; t < simplified.size(); t += 3) {
+        const simd::float3 n = triangle_normal(grid, simplified, t);
+        EXPECT_GT(n.y, 0.0f);
+        area += 0.5f * n.y;
+    }
+    EXPECT_NEAR(area, 256.0f, 1e-2f);
+}
+
+TEST(MeshLodTests, ChainHalvesTrianglesWithGrowingError) {
+    MeshData ball = sphere(16, 32);
+    const size_t fullCount = ball.indices.size();
+    const MeshLodChain chain = build_mesh_lods(ball.vertices, ball.indices);
+    ASSERT_GE(chain.count, 3u);
+    EXPECT_EQ(chain.levels[0].indexOffset, 0u);
+    EXPECT_EQ(chain.levels[0].indexCount, fullCount);
+    EXPECT_EQ(chain.levels[0].error, 0.0f);
+
+    for (uint32_t i = 1; i < chain.count; ++i) {
+        const MeshLod& lod = chain.levels[i];
+        EXPECT_EQ(lod.indexOffset, chain.levels[i - 1].indexOffset + chain.levels[i - 1].indexCount);
+        EXPECT_LE((float)lod.indexCount, MESH_LOD_MIN_REDUCTION * chain.levels[i - 1].indexCount);
+        EXPECT_GE(lod.error, chain.levels[i - 1].error);
+        EXPECT_LT(lod.error, 0.5f);
+        // Still a closed ball: every triangle faces outwards
+        std::vector<uint32_t> level(ball.indices.indices32.begin() + lod.indexOffset,
+                                    ball.indices.indices32.begin() + lod.indexOffset + lod.indexCount);
+        for (size_t t = 0; t < level.size(); t += 3) {
+            const simd::float3 centroid = (ball.vertices[level[t]].position + ball.vertices[level[t + 1]].position +
+                                           ball.vertices[level[t + 2]].position) / 3.0f;
+            EXPECT_GT(simd::dot(triangle_normal(ball, level, t), centroid), 0.0f);
+        }
+    }
+    const MeshLod& last = chain.levels[chain.count - 1];
+    EXPECT_EQ(ball.indices.size(), last.indexOffset + last.indexCount);
+
+    // Too small to simplify
+    MeshData tiny = flat_grid(2);
+    EXPECT_EQ(build_mesh_lods(tiny.vertices, tiny.indices).count, 1u);
+    EXPECT_EQ(tiny.indices.size(), 24u);
+}
+
+TEST(MeshLodTests, SelectionFollowsProjectedSize) {
+    Camera cam = make_camera(1280, 720);
+    update_camera_view(cam);
+    const float projection = mesh_lod_projection_scale(cam.projectionMatrix * cam.viewMatrix);
+    EXPECT_NEAR(projection, 0.5f / tanf((float)M_PI / 6.0f), 1e-4f);
+
+    MeshLodChain chain = mesh_lod_single(300);
+    chain.levels[1] = { 300, 150, 0.01f };
+    chain.levels[2] = { 450, 75, 0.1f };
+    chain.count = 3;
+    // The error of a level reaches the threshold at error * projection / threshold
+    const float nearLevel1 = 0.01f * projection / MESH_LOD_SCREEN_ERROR;
+    const float nearLevel2 = 0.1f * projection / MESH_LOD_SCREEN_ERROR;
+    EXPECT_EQ(mesh_lod_select(chain, projection / (0.5f * nearLevel1)), 0u);
+    EXPECT_EQ(mesh_lod_select(chain, projection / (2.0f * nearLevel1)), 1u);
+    EXPECT_EQ(mesh_lod_select(chain, projection / (2.0f * nearLevel2)), 2u);
+    // A model scaled up needs to be farther away
+    EXPECT_EQ(mesh_lod_select(chain, 4.0f * projection / (2.0f * nearLevel1)), 0u);
+    EXPECT_EQ(mesh_lod_select(mesh_lod_single(300), 0.0f), 0u);
+}
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "metrics.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+    // Sends a request to the loopback port and returns everything the server answered
+    std::string http_request(uint16_t port, const char* request) {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        std::string response;
+        if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) == 0) {
+            send(fd, request, strlen(request), 0);
+            char buffer[4096];
+            ssize_t received;
+            while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+                response.append(buffer, (size_t)received);
+            }
+        }
+        close(fd);
+        return response;
+    }
+}
+
+TEST(MetricsTests, ObservationsLandInTheirBucket) {
+    EXPECT_EQ(metric_bucket(-1.0f), 0u);
+    EXPECT_EQ(metric_bucket(2.0f), 0u);
+    EXPECT_EQ(metric_bucket(2.5f), 1u);
+    EXPECT_EQ(metric_bucket(16.6f), 4u);
+    EXPECT_EQ(metric_bucket(1000.0f), METRIC_BUCKETS - 1);
+
+    MetricsRegistry metrics;
+    metrics_observe(metrics, METRIC_FRAME_MS, 16.0f);
+    metrics_observe(metrics, METRIC_FRAME_MS, 16.5f);
+    metrics_observe(metrics, METRIC_FRAME_MS, 40.0f);
+    metrics_add(metrics, METRIC_FRAMES, 3);
+    metrics_set(metrics, METRIC_CHUNKS_RESIDENT, 120);
+    metrics_set(metrics, METRIC_CHUNKS_RESIDENT, 96);
+
+    const MetricsSnapshot snapshot = metrics_snapshot(metrics);
+    EXPECT_EQ(snapshot.histograms[METRIC_FRAME_MS].buckets[4], 2u);
+    EXPECT_EQ(snapshot.histograms[METRIC_FRAME_MS].count(), 3u);
+    EXPECT_NEAR(snapshot.histograms[METRIC_FRAME_MS].sumMs, 72.5, 0.01);
+    EXPECT_EQ(snapshot.histograms[METRIC_GPU_MS].count(), 0u);
+    EXPECT_EQ(snapshot.counters[METRIC_FRAMES], 3u);
+    EXPECT_EQ(snapshot.gauges[METRIC_CHUNKS_RESIDENT], 96u);
+}
+
+TEST(MetricsTests, QuantilesCoverOnlyTheNewObservations) {
+    MetricsRegistry metrics;
+    for (int i = 0; i < 100; ++i) {
+        metrics_observe(metrics, METRIC_GPU_MS, 60.0f);
+    }
+    const MetricsSnapshot before = metrics_snapshot(metrics);
+    for (int i = 0; i < 95; ++i) {
+        metrics_observe(metrics, METRIC_GPU_MS, 7.0f);
+    }
+    for (int i = 0; i < 5; ++i) {
+        metrics_observe(metrics, METRIC_GPU_MS, 30.0f);
+    }
+    const MetricsSnapshot now = metrics_snapshot(metrics);
+    const MetricsSnapshot::Histogram& gpu = now.histograms[METRIC_GPU_MS];
+    EXPECT_FLOAT_EQ(metrics_histogram_quantile(gpu, before.histograms[METRIC_GPU_MS], 0.5f), 8.0f);
+    EXPECT_FLOAT_EQ(metrics_histogram_quantile(gpu, before.histograms[METRIC_GPU_MS], 0.95f), 8.0f);
+    EXPECT_FLOAT_EQ(metrics_histogram_quantile(gpu, before.histograms[METRIC_GPU_MS], 0.99f), 33.4f);
+    // Over everything, the slow first half dominates the upper quantiles
+    EXPECT_FLOAT_EQ(metrics_histogram_quantile(gpu, {}, 0.99f), 100.0f);
+    EXPECT_FLOAT_EQ(metrics_histogram_quantile(gpu, gpu, 0.5f), 0.0f);
+}
+
+TEST(MetricsTests, PrometheusTextHasCumulativeBucketsAndMemoryLabels) {
+    MetricsRegistry metrics;
+    metrics_observe(metrics, METRIC_FRAME_MS, 3.0f);
+    metrics_observe(metrics, METRIC_FRAME_MS, 300.0f);
+    metrics_add(metrics, METRIC_UPLOAD_BYTES, 4096);
+    MemoryReport memory;
+    memory.gpuBytes[MEMORY_TERRAIN] = 1 << 20;
+    memory.cpuBytes[MEMORY_SCENE] = 512;
+    metrics_set_memory(metrics, memory);
+
+    const std::string text = metrics_format_prometheus(metrics_snapshot(metrics), "kiosk");
+    EXPECT_NE(text.find("# TYPE kiosk_upload_bytes_total counter\nkiosk_upload_bytes_total 4096\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("kiosk_frame_ms_bucket{le=\"2\"} 0\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_frame_ms_bucket{le=\"4\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_frame_ms_bucket{le=\"250\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_frame_ms_bucket{le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_frame_ms_sum 303.000\nkiosk_frame_ms_count 2\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_memory_bytes{kind=\"gpu\",tag=\"terrain\"} 1048576\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_memory_bytes{kind=\"cpu\",tag=\"scene\"} 512\n"), std::string::npos);
+    EXPECT_NE(text.find("kiosk_gpu_ms_count 0\n"), std::string::npos);
+}
+
+TEST(MetricsTests, StatsdSendsTheChangeSinceTheLastReport) {
+    MetricsRegistry metrics;
+    metrics_add(metrics, METRIC_FRAMES, 50);
+    const MetricsSnapshot before = metrics_snapshot(metrics);
+    metrics_add(metrics, METRIC_FRAMES, 10);
+    metrics_set(metrics, METRIC_UPLOAD_QUEUED_BATCHES, 3);
+    metrics_observe(metrics, METRIC_FRAME_MS, 10.0f);
+    metrics_observe(metrics, METRIC_FRAME_MS, 20.0f);
+
+    const std::string lines = metrics_format_statsd(metrics_snapshot(metrics), before, "kiosk");
+    EXPECT_NE(lines.find("kiosk.frames:10|c\n"), std::string::npos);
+    EXPECT_NE(lines.find("kiosk.upload_queued_batches:3|g\n"), std::string::npos);
+    EXPECT_NE(lines.find("kiosk.memory.gpu.terrain:0|g\n"), std::string::npos);
+    EXPECT_NE(lines.find("kiosk.frame_ms.count:2|c\nkiosk.frame_ms.mean:15.000|g\n"), std::string::npos);
+    EXPECT_NE(lines.find("kiosk.frame_ms.p50:12|g\n"), std::string::npos);
+    // A histogram without new observations sends only its count
+    EXPECT_NE(lines.find("kiosk.gpu_ms.count:0|c\n"), std::string::npos);
+    EXPECT_EQ(lines.find("kiosk.gpu_ms.mean"), std::string::npos);
+}
+
+TEST(MetricsTests, ExporterServesMetricsOverHttp) {
+    MetricsRegistry metrics;
+    metrics_add(metrics, METRIC_HITCHES, 2);
+    MetricsExporterConfig config;
+    config.httpPort = 0;
+    config.prefix = "kiosk";
+    MetricsExporter exporter(metrics, config);
+    ASSERT_TRUE(exporter.running()) << exporter.error();
+    ASSERT_NE(exporter.http_port(), 0);
+
+    const std::string ok = http_request(exporter.http_port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_EQ(ok.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    EXPECT_NE(ok.find("kiosk_hitches_total 2\n"), std::string::npos);
+    // Later values show up in the next scrape
+    metrics_add(metrics, METRIC_HITCHES);
+    EXPECT_NE(http_request(exporter.http_port(), "GET /metrics HTTP/1.0\r\n\r\n").find("kiosk_hitches_total 3\n"),
+              std::string::npos);
+
+    const std::string missing = http_request(exporter.http_port(), "GET /other HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(missing.compare(0, 22, "HTTP/1.1 404 Not Found"), 0);
+}
+
+TEST(MetricsTests, ExporterPushesStatsdEveryInterval) {
+    UdpSocket daemon;
+    std::string error;
+    ASSERT_TRUE(udp_socket_open(daemon, 0, error)) << error;
+
+    MetricsRegistry metrics;
+    MetricsExporterConfig config;
+    config.statsd = true;
+    config.statsdAddress = { INADDR_LOOPBACK, daemon.port };
+    config.intervalMs = 10.0f;
+    config.prefix = "kiosk";
+    MetricsExporter exporter(metrics, config);
+    ASSERT_TRUE(exporter.running()) << exporter.error();
+    EXPECT_EQ(exporter.http_port(), 0);
+    metrics_add(metrics, METRIC_FRAMES, 7);
+
+    // Counters are deltas, so the 7 frames arrive in one report, whichever that is
+    std::string received;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (received.find("kiosk.frames:7|c\n") == std::string::npos && std::chrono::steady_clock::now() < deadline) {
+        uint8_t buffer[2048];
+        UdpAddress from;
+        const size_t size = udp_socket_receive(daemon, from, buffer, sizeof(buffer));
+        if (size == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        EXPECT_LE(size, 1400u);
+        received.append((const char*)buffer, size);
+    }
+    EXPECT_NE(received.find("kiosk.frames:7|c\n"), std::string::npos);
+    udp_socket_close(daemon);
+}
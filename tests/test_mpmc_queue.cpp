@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include "mpmc_queue.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST(MpmcQueueTests, KeepsOrderAndRejectsWhenFull) {
+    MpmcQueue<int, 4> queue;
+    int value = 0;
+    EXPECT_FALSE(queue.pop(value));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(i));
+    }
+    EXPECT_FALSE(queue.push(4));
+    EXPECT_EQ(queue.size_hint(), 4u);
+
+    // Wrapping around the ring a few times keeps the order
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(queue.pop(value));
+        EXPECT_EQ(value, i);
+        EXPECT_TRUE(queue.push(i + 4));
+    }
+    EXPECT_EQ(queue.size_hint(), 4u);
+}
+
+TEST(MpmcQueueTests, EveryValueArrivesOnceAcrossThreads) {
+    MpmcQueue<uint32_t, 64> queue;
+    constexpr uint32_t PRODUCERS = 3;
+    constexpr uint32_t PER_PRODUCER = 20000;
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (uint32_t i = 0; i < PER_PRODUCER; ++i) {
+                while (!queue.push(p * PER_PRODUCER + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    std::vector<std::atomic<uint32_t>> seen(PRODUCERS * PER_PRODUCER);
+    std::atomic<uint32_t> received{ 0 };
+    for (int c = 0; c < 3; ++c) {
+        threads.emplace_back([&] {
+            uint32_t value;
+            while (received.load() < PRODUCERS * PER_PRODUCER) {
+                if (queue.pop(value)) {
+                    seen[value]++;
+                    received++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::atomic<uint32_t>& count : seen) {
+        ASSERT_EQ(count.load(), 1u);
+    }
+}
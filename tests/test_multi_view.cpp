@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "multi_view.hpp"
+
+#include <vector>
+
+namespace {
+    // Normalized device coordinates of a world point, or w <= 0 if it is behind the view
+    simd::float4 project(const RenderView& view, simd::float3 p) {
+        simd::float4 clip = view.viewProjection * simd::float4{ p.x, p.y, p.z, 1.0f };
+        return { clip.x / clip.w, clip.y / clip.w, clip.z / clip.w, clip.w };
+    }
+
+    BoundingBox box_at(float x, float y, float z) {
+        return { { x - 0.5f, y - 0.5f, z - 0.5f }, { x + 0.5f, y + 0.5f, z + 0.5f } };
+    }
+}
+
+TEST(MultiViewTests, CubeFacesLookAlongTheirAxes) {
+    const simd::float3 eye = { 1.0f, 2.0f, 3.0f };
+    for (bool reverseZ : { false, true }) {
+        RenderView faces[CUBE_FACE_COUNT];
+        cube_map_views(eye, 0.1f, 100.0f, reverseZ, faces);
+        const simd::float3 axes[CUBE_FACE_COUNT] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 },
+                                                     { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+        for (uint32_t face = 0; face < CUBE_FACE_COUNT; ++face) {
+            EXPECT_EQ(faces[face].slice, face);
+            const simd::float4 centre = project(faces[face], eye + axes[face] * 10.0f);
+            EXPECT_GT(centre.w, 0.0f);
+            EXPECT_NEAR(centre.x, 0.0f, 1e-5f);
+            EXPECT_NEAR(centre.y, 0.0f, 1e-5f);
+            for (uint32_t other = 0; other < CUBE_FACE_COUNT; ++other) {
+                if (other != face) {
+                    const simd::float4 p = project(faces[other], eye + axes[face] * 10.0f);
+                    EXPECT_TRUE(p.w <= 0.0f || fabsf(p.x) >= 1.0f - 1e-5f || fabsf(p.y) >= 1.0f - 1e-5f);
+                }
+            }
+        }
+    }
+}
+
+TEST(MultiViewTests, CubeFacesFollowTheSamplingConvention) {
+    RenderView faces[CUBE_FACE_COUNT];
+    cube_map_views(simd::float3{ 0, 0, 0 }, 0.1f, 100.0f, false, faces);
+    // +X: texture u grows towards -Z and v (downwards) towards -Y
+    EXPECT_GT(project(faces[0], simd::float3{ 10, 0, -2 }).x, 0.0f);
+    EXPECT_GT(project(faces[0], simd::float3{ 10, 2, 0 }).y, 0.0f);
+    // +Y: u grows towards +X, v towards +Z
+    EXPECT_GT(project(faces[2], simd::float3{ 2, 10, 0 }).x, 0.0f);
+    EXPECT_LT(project(faces[2], simd::float3{ 0, 10, 2 }).y, 0.0f);
+    // -Z: u grows towards -X
+    EXPECT_GT(project(faces[5], simd::float3{ -2, 0, -10 }).x, 0.0f);
+}
+
+TEST(MultiViewTests, GroupsCoverEveryViewOnce) {
+    MultiViewGroup groups[MULTI_VIEW_MAX_VIEWS];
+    ASSERT_EQ(multi_view_groups(6, 2, groups), 3u);
+    EXPECT_EQ(groups[2].first, 4u);
+    EXPECT_EQ(groups[2].count, 2u);
+
+    ASSERT_EQ(multi_view_groups(5, 4, groups), 2u);
+    EXPECT_EQ(groups[0].count, 4u);
+    EXPECT_EQ(groups[1].first, 4u);
+    EXPECT_EQ(groups[1].count, 1u);
+
+    EXPECT_EQ(multi_view_groups(3, 0, groups), 3u);
+    EXPECT_EQ(multi_view_groups(0, 2, groups), 0u);
+}
+
+TEST(MultiViewTests, CullKeepsWhatAnyViewOfTheGroupSees) {
+    RenderView faces[CUBE_FACE_COUNT];
+    cube_map_views(simd::float3{ 0, 0, 0 }, 0.1f, 100.0f, false, faces);
+
+    CullBounds bounds;
+    cull_bounds_add(bounds, box_at(10, 0, 0));   // +X
+    cull_bounds_add(bounds, box_at(-10, 0, 0));  // -X
+    cull_bounds_add(bounds, box_at(0, 10, 0));   // +Y
+    cull_bounds_add(bounds, box_at(0, 0, -10));  // -Z
+    cull_bounds_add(bounds, box_at(0, 0, 200));  // Past every far plane
+
+    std::vector<uint32_t> visible(bounds.size());
+    ASSERT_EQ(multi_view_cull(faces, 2, bounds, visible.data()), 2u);
+    EXPECT_EQ(visible[0], 0u);
+    EXPECT_EQ(visible[1], 1u);
+
+    ASSERT_EQ(multi_view_cull(faces, CUBE_FACE_COUNT, bounds, visible.data()), 4u);
+    EXPECT_EQ(visible[3], 3u);
+}
+
+TEST(MultiViewTests, FogDistanceCoversTheFurthestEye) {
+    Camera left = make_camera(640, 480);
+    Camera right = left;
+    right.position = left.position + simd::float3{ 3, 0, 4 };
+    update_camera_view(left);
+    update_camera_view(right);
+    const RenderView views[2] = { camera_render_view(left, 0, 0), camera_render_view(right, 0, 1) };
+    EXPECT_EQ(views[1].viewport, 1u);
+    EXPECT_FLOAT_EQ(multi_view_fog_distance(views, 1, 50.0f), 50.0f);
+    EXPECT_FLOAT_EQ(multi_view_fog_distance(views, 2, 50.0f), 55.0f);
+}
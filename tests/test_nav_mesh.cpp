@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "nav_mesh.hpp"
+
+#include <cmath>
+
+namespace {
+    // A flat 64 x 64 unit field
+    HeightField make_field() {
+        HeightField field;
+        field.width = 65;
+        field.depth = 65;
+        field.heights.assign((size_t)field.width * field.depth, 0.0f);
+        return field;
+    }
+
+    // Raises a wall three units high along x = 30..33, open where z lies in [gapZ0, gapZ1]
+    void add_wall(HeightField& field, int gapZ0, int gapZ1) {
+        for (int z = 0; z < field.depth; ++z) {
+            for (int x = 30; x <= 33; ++x) {
+                if (z < gapZ0 || z > gapZ1) {
+                    field.heights[(size_t)z * field.width + x] = 3.0f;
+                }
+            }
+        }
+    }
+
+    NavPath find_path(const NavMesh& mesh, JobSystem& jobs, simd::float2 start, simd::float2 end) {
+        const NavPathQuery query = { start, end };
+        NavPath path;
+        nav_mesh_find_paths(mesh, jobs, &query, &path, 1);
+        return path;
+    }
+
+    void expect_same_tiles(const NavMesh& a, const NavMesh& b) {
+        ASSERT_EQ(a.tiles.size(), b.tiles.size());
+        EXPECT_EQ(a.polyCount, b.polyCount);
+        for (size_t t = 0; t < a.tiles.size(); ++t) {
+            EXPECT_EQ(a.tiles[t].cellPolys, b.tiles[t].cellPolys) << t;
+            EXPECT_EQ(a.tiles[t].links, b.tiles[t].links) << t;
+        }
+    }
+}
+
+TEST(NavMeshTests, FlatTilesAreOnePolygonLinkedToTheirNeighbours) {
+    JobSystem jobs({ 1, 1 });
+    NavMeshSettings settings;
+    settings.cellSize = 1.0f;
+    settings.tileCells = 16;
+    const NavMesh mesh = create_nav_mesh(make_field(), settings, jobs);
+    ASSERT_EQ(mesh.tilesX, 4u);
+    ASSERT_EQ(mesh.tilesZ, 4u);
+    EXPECT_EQ(mesh.polyCount, 16u);
+    // A corner tile has two neighbours, an edge tile three, an inner tile four
+    EXPECT_EQ(mesh.tiles[0].polys[0].linkCount, 2u);
+    EXPECT_EQ(mesh.tiles[1].polys[0].linkCount, 3u);
+    EXPECT_EQ(mesh.tiles[5].polys[0].linkCount, 4u);
+    EXPECT_EQ(nav_mesh_find_poly(mesh, 20.0f, 3.0f), 1u << NAV_POLY_BITS);
+    EXPECT_EQ(nav_mesh_find_poly(mesh, -1.0f, 3.0f), NAV_NO_POLY);
+}
+
+TEST(NavMeshTests, PathsGoAroundWallsThroughTheGap) {
+    JobSystem jobs({ 1, 1 });
+    HeightField field = make_field();
+    add_wall(field, 50, 58);
+    const NavMesh mesh = create_nav_mesh(field, NavMeshSettings{}, jobs);
+
+    // The wall's slopes are too steep, so its top is an island and its cells are unwalkable
+    EXPECT_EQ(nav_mesh_find_poly(mesh, 29.75f, 10.0f), NAV_NO_POLY);
+    const NavPath path = find_path(mesh, jobs, { 10.0f, 10.0f }, { 55.0f, 10.0f });
+    ASSERT_TRUE(path.found);
+    // At least the two straight legs to a corner of the gap and on to the end
+    EXPECT_GT(path.length, 2.0f * 44.0f);
+    bool throughGap = false;
+    for (const simd::float3& p : path.points) {
+        EXPECT_NEAR(p.y, 0.0f, 1e-4f);
+        throughGap = throughGap || (p.x > 29.0f && p.x < 35.0f && p.z >= 49.5f && p.z <= 58.5f);
+    }
+    EXPECT_TRUE(throughGap);
+    EXPECT_EQ(path.polys.front(), nav_mesh_find_poly(mesh, 10.0f, 10.0f));
+    EXPECT_EQ(path.polys.back(), nav_mesh_find_poly(mesh, 55.0f, 10.0f));
+
+    HeightField closed = make_field();
+    add_wall(closed, 1, 0);
+    const NavMesh sealed = create_nav_mesh(closed, NavMeshSettings{}, jobs);
+    EXPECT_FALSE(find_path(sealed, jobs, { 10.0f, 10.0f }, { 55.0f, 10.0f }).found);
+}
+
+TEST(NavMeshTests, FlatPathsAreNearlyStraight) {
+    JobSystem jobs({ 1, 1 });
+    const NavMesh mesh = create_nav_mesh(make_field(), NavMeshSettings{}, jobs);
+    const NavPath path = find_path(mesh, jobs, { 2.0f, 3.0f }, { 60.0f, 50.0f });
+    ASSERT_TRUE(path.found);
+    const float straight = std::sqrt(58.0f * 58.0f + 47.0f * 47.0f);
+    EXPECT_GE(path.length, straight - 1e-3f);
+    EXPECT_LT(path.length, straight * 1.25f);
+}
+
+TEST(NavMeshTests, RebuildingEditedTilesMatchesAFullBuild) {
+    JobSystem jobs({ 1, 1 });
+    HeightField field = make_field();
+    NavMeshSettings settings;
+    settings.tileCells = 16;
+    NavMesh mesh = create_nav_mesh(field, settings, jobs);
+
+    // A mound between x, z = 42 and 45, inside the tile over 40..48
+    for (int z = 42; z <= 45; ++z) {
+        for (int x = 42; x <= 45; ++x) {
+            field.heights[(size_t)z * field.width + x] = 2.5f;
+        }
+    }
+    EXPECT_EQ(nav_mesh_rebuild(mesh, field, jobs, 42.0f, 42.0f, 45.0f, 45.0f), 1u);
+    const NavMesh full = create_nav_mesh(field, settings, jobs);
+    expect_same_tiles(mesh, full);
+
+    uint32_t rebuilt = 0;
+    for (const NavTile& tile : mesh.tiles) {
+        rebuilt += tile.builds > 1 ? 1 : 0;
+    }
+    EXPECT_EQ(rebuilt, 1u);
+    EXPECT_EQ(nav_mesh_find_poly(mesh, 41.75f, 41.75f), NAV_NO_POLY);
+}
+
+TEST(NavMeshTests, BatchedQueriesDoNotDependOnTheThreadCount) {
+    HeightField field = make_field();
+    add_wall(field, 20, 26);
+    JobSystem serial({ 0, 1 });
+    JobSystem parallel({ 3, 1 });
+    const NavMesh mesh = create_nav_mesh(field, NavMeshSettings{}, parallel);
+    expect_same_tiles(mesh, create_nav_mesh(field, NavMeshSettings{}, serial));
+
+    std::vector<NavPathQuery> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back({ { 1.0f + (float)(i % 10) * 2.5f, 1.0f + (float)(i / 10) * 6.0f },
+                            { 63.0f - (float)(i % 7) * 3.0f, 2.0f + (float)(i % 13) * 4.5f } });
+    }
+    std::vector<NavPath> a(queries.size());
+    std::vector<NavPath> b(queries.size());
+    nav_mesh_find_paths(mesh, serial, queries.data(), a.data(), (uint32_t)queries.size());
+    nav_mesh_find_paths(mesh, parallel, queries.data(), b.data(), (uint32_t)queries.size());
+    uint32_t found = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        EXPECT_EQ(a[i].found, b[i].found);
+        EXPECT_EQ(a[i].polys, b[i].polys);
+        found += a[i].found ? 1 : 0;
+    }
+    EXPECT_GT(found, 90u);
+}
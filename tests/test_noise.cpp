@@ -0,0 +1,340 @@
+#include <gtest/gtest.h>
+#include "noise.hpp"
+#include "landscape.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Points on both sides of the origin, with a count that leaves a partial SIMD tail
+    void make_points(std::vector<float>& xs, std::vector<float>& zs, size_t n) {
+        xs.resize(n);
+        zs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            xs[i] = -7.3f + 0.173f * i;
+            zs[i] = 4.1f - 0.091f * i;
+        }
+    }
+}
+
+TEST(NoiseTests, BatchMatchesScalarExactly) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 103);
+    std::vector<float> out(xs.size());
+
+    fractal_noise_batch(xs.data(), zs.data(), out.data(), xs.size());
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_EQ(out[i], fractal_noise(xs[i], zs[i])) << "at index " << i;
+    }
+}
+
+TEST(NoiseTests, SmoothstepBatchStaysCloseToCosine) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 64);
+    std::vector<float> out(xs.size());
+
+    NoiseSettings smooth;
+    smooth.interpolation = NoiseInterpolation::Smoothstep;
+    fractal_noise_batch(xs.data(), zs.data(), out.data(), xs.size(), smooth);
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_NEAR(out[i], fractal_noise(xs[i], zs[i]), 0.1f);
+    }
+}
+
+TEST(NoiseTests, BatchMatchesScalarForEveryField) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 41);
+    std::vector<float> out(xs.size());
+
+    for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+        for (NoiseInterpolation interpolation : { NoiseInterpolation::Cosine, NoiseInterpolation::Smoothstep }) {
+            for (float warp : { 0.0f, 0.75f }) {
+                const NoiseSettings settings = { 17, basis, interpolation, warp };
+                fractal_noise_batch(xs.data(), zs.data(), out.data(), xs.size(), settings);
+                for (size_t i = 0; i < xs.size(); ++i) {
+                    EXPECT_EQ(out[i], fractal_noise(xs[i], zs[i], settings))
+                        << "basis " << (int)basis << ", interpolation " << (int)interpolation
+                        << ", warp " << warp << ", index " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(NoiseTests, GridMatchesScalarForEveryField) {
+    // About three columns per lattice cell share corners; points 19.7 apart are sparser than the lattice
+    for (float spacing : { 0.31f, 19.7f }) {
+        std::vector<float> xs(23), zs(17), out(xs.size() * zs.size());
+        for (size_t i = 0; i < xs.size(); ++i) {
+            xs[i] = -3.2f + spacing * i;
+        }
+        for (size_t j = 0; j < zs.size(); ++j) {
+            zs[j] = 1.9f - spacing * j;
+        }
+        for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+            for (NoiseInterpolation interpolation : { NoiseInterpolation::Cosine, NoiseInterpolation::Smoothstep }) {
+                for (float warp : { 0.0f, 0.75f }) {
+                    const NoiseSettings settings = { 29, basis, interpolation, warp, 6 };
+                    fractal_noise_grid(xs.data(), xs.size(), zs.data(), zs.size(), out.data(), settings);
+                    for (size_t j = 0; j < zs.size(); ++j) {
+                        for (size_t i = 0; i < xs.size(); ++i) {
+                            ASSERT_EQ(out[j * xs.size() + i], fractal_noise(xs[i], zs[j], settings))
+                                << "basis " << (int)basis << ", interpolation " << (int)interpolation
+                                << ", warp " << warp << ", spacing " << spacing << " at " << i << ", " << j;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(NoiseTests, HashIsStableAndSeeded) {
+    EXPECT_EQ(noise_hash(3, -5, 12), noise_hash(3, -5, 12));
+    EXPECT_NE(noise_hash(3, -5, 12), noise_hash(4, -5, 12));
+    EXPECT_NE(noise_hash(3, -5, 12), noise_hash(3, 12, -5));
+    // Extreme coordinates wrap instead of overflowing
+    EXPECT_EQ(noise_hash(0, INT32_MAX, INT32_MIN), noise_hash(0, INT32_MAX, INT32_MIN));
+}
+
+TEST(NoiseTests, SeedsGiveUnrelatedFields) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 32);
+
+    int differing = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const NoiseSettings a = { 1 };
+        const NoiseSettings b = { 2 };
+        differing += fractal_noise(xs[i], zs[i], a) != fractal_noise(xs[i], zs[i], b);
+    }
+    EXPECT_EQ(differing, (int)xs.size());
+}
+
+TEST(NoiseTests, BasesStayInRange) {
+    for (int i = 0; i < 4000; ++i) {
+        const float x = -40.0f + 0.0271f * i;
+        const float z = 13.0f - 0.0193f * i + 0.37f * (i % 7);
+        const float value = smoothed_noise(x, z, 5, NoiseInterpolation::Smoothstep);
+        const float gradient = gradient_noise(x, z, 5);
+        const float simplex = simplex_noise(x, z, 5);
+        EXPECT_LE(fabsf(value), 1.0f);
+        EXPECT_LE(fabsf(gradient), 1.0f);
+        EXPECT_LE(fabsf(simplex), 1.0f);
+    }
+
+    const NoiseSettings warped = { 9, NoiseBasis::Simplex, NoiseInterpolation::Smoothstep, 2.0f };
+    EXPECT_LE(fabsf(fractal_noise(3.3f, -8.1f, warped)), fractal_noise_bound());
+}
+
+TEST(NoiseTests, GradientNoiseVanishesOnLattice) {
+    for (int x = -3; x <= 3; ++x) {
+        for (int z = -3; z <= 3; ++z) {
+            EXPECT_EQ(gradient_noise((float)x, (float)z, 11), 0.0f);
+        }
+    }
+}
+
+TEST(NoiseTests, GradientNoise3StaysInRangeAndVanishesOnLattice) {
+    float largest = 0.0f;
+    for (int i = 0; i < 4000; ++i) {
+        const float value = gradient_noise3(-20.0f + 0.0271f * i, 0.013f * i, 7.0f - 0.0193f * i, 3);
+        largest = std::max(largest, fabsf(value));
+    }
+    EXPECT_LE(largest, 1.0f);
+    EXPECT_GT(largest, 0.3f);
+    EXPECT_EQ(gradient_noise3(2.0f, -1.0f, 5.0f, 3), 0.0f);
+
+    NoiseSettings settings;
+    settings.octaves = 3;
+    settings.persistence = 0.5f;
+    EXPECT_LE(fabsf(fractal_noise3(1.3f, 2.7f, -0.4f, settings)), fractal_noise_bound(settings));
+}
+
+TEST(NoiseTests, WarpMovesTheField) {
+    NoiseSettings warped;
+    warped.warp = 1.5f;
+    EXPECT_NE(fractal_noise(2.4f, 7.9f), fractal_noise(2.4f, 7.9f, warped));
+}
+
+TEST(NoiseTests, UnrolledOctavesMatchRuntimeCount) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 29);
+    std::vector<float> fixed(xs.size()), runtime(xs.size());
+
+    NoiseSettings settings;
+    settings.octaves = 3;
+    settings.persistence = 0.6f;
+    fractal_noise_batch<3>(xs.data(), zs.data(), fixed.data(), xs.size(), settings);
+    fractal_noise_batch(xs.data(), zs.data(), runtime.data(), xs.size(), settings);
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_EQ(fixed[i], runtime[i]) << "at index " << i;
+    }
+
+    // Counts above the unrolled ones take the generic loop
+    settings.octaves = NOISE_UNROLLED_OCTAVES + 2;
+    fractal_noise_batch(xs.data(), zs.data(), runtime.data(), xs.size(), settings);
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_EQ(runtime[i], fractal_noise(xs[i], zs[i], settings)) << "at index " << i;
+        EXPECT_LE(fabsf(runtime[i]), fractal_noise_bound(settings));
+    }
+}
+
+// A registered field, with its basis fixed at compile time, against the path that reads it from the settings
+template <uint32_t Octaves, NoiseBasis Basis, NoiseInterpolation Interpolation>
+void expect_registered_field_matches() {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 23);
+    std::vector<float> fixed(xs.size()), runtime(xs.size());
+    for (float warp : { 0.0f, 0.6f }) {
+        const NoiseSettings settings = { 11, Basis, Interpolation, warp, Octaves, 0.5f };
+        EXPECT_TRUE(fractal_noise_registered(settings));
+        fractal_noise_batch<Octaves>(xs.data(), zs.data(), runtime.data(), xs.size(), settings);
+        FractalNoise<Octaves, Basis, Interpolation>::batch(xs.data(), zs.data(), fixed.data(), xs.size(), settings);
+        for (size_t i = 0; i < xs.size(); ++i) {
+            EXPECT_EQ(fixed[i], runtime[i]) << "basis " << (int)Basis << ", " << Octaves << " octaves, index " << i;
+            EXPECT_EQ(fractal_noise(xs[i], zs[i], settings), runtime[i]);
+            const NoiseSample sample = FractalNoise<Octaves, Basis, Interpolation>::sample(xs[i], zs[i], settings);
+            EXPECT_EQ(sample.value, runtime[i]);
+            EXPECT_EQ(sample.dx, fractal_noise_sample(xs[i], zs[i], settings).dx);
+        }
+    }
+}
+
+TEST(NoiseTests, RegisteredFieldsMatchTheSettingsPath) {
+#define EXPECT_REGISTERED_FIELD(octaves, basis, interpolation) \
+    expect_registered_field_matches<octaves, basis, interpolation>();
+    NOISE_REGISTERED_FIELDS(EXPECT_REGISTERED_FIELD)
+#undef EXPECT_REGISTERED_FIELD
+
+    NoiseSettings other;
+    other.octaves = 7;
+    EXPECT_FALSE(fractal_noise_registered(other));
+    other.octaves = NOISE_UNROLLED_OCTAVES + 1;
+    EXPECT_FALSE(fractal_noise_registered(other));
+}
+
+TEST(NoiseTests, BatchedTerrainHeightsMatchScalar) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 37);
+    std::vector<float> out(xs.size());
+
+    get_terrain_heights(xs.data(), zs.data(), out.data(), xs.size());
+
+    for (size_t i = 0; i < xs.size(); ++i) {
+        EXPECT_EQ(out[i], get_terrain_height(xs[i], zs[i]));
+    }
+}
+
+TEST(NoiseTests, LaneTerrainHeightsMatchScalar) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 8);
+    simd::float4 x4, z4;
+    simd::float8 x8, z8;
+    for (int i = 0; i < 8; ++i) {
+        x8[i] = xs[i];
+        z8[i] = zs[i];
+        if (i < 4) {
+            x4[i] = xs[i];
+            z4[i] = zs[i];
+        }
+    }
+
+    for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+        TerrainParams params;
+        params.noise = { 17, basis, NoiseInterpolation::Cosine, 0.75f };
+        const simd::float4 heights4 = get_terrain_height4(x4, z4, params);
+        const simd::float8 heights8 = get_terrain_height8(x8, z8, params);
+        for (int i = 0; i < 8; ++i) {
+            const float expected = get_terrain_height(xs[i], zs[i], params);
+            EXPECT_EQ(heights8[i], expected) << "basis " << (int)basis << ", lane " << i;
+            if (i < 4) {
+                EXPECT_EQ(heights4[i], expected) << "basis " << (int)basis << ", lane " << i;
+            }
+        }
+    }
+
+    // More octaves than are unrolled take the generic loop
+    NoiseSettings deep;
+    deep.octaves = NOISE_UNROLLED_OCTAVES + 2;
+    const simd::float8 noise8 = fractal_noise8(x8, z8, deep);
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(noise8[i], fractal_noise(xs[i], zs[i], deep));
+    }
+}
+
+// The analytic derivatives must follow the field they differentiate, through every octave and the warp
+TEST(NoiseTests, SampleDerivativesMatchFiniteDifferences) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 53);
+    const float h = 1e-3f;
+
+    for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+        for (NoiseInterpolation interpolation : { NoiseInterpolation::Cosine, NoiseInterpolation::Smoothstep }) {
+            for (float warp : { 0.0f, 0.75f }) {
+                const NoiseSettings settings = { 17, basis, interpolation, warp, 3, 0.5f };
+                for (size_t i = 0; i < xs.size(); ++i) {
+                    const NoiseSample sample = fractal_noise_sample(xs[i], zs[i], settings);
+                    const float dx = (fractal_noise(xs[i] + h, zs[i], settings) -
+                                      fractal_noise(xs[i] - h, zs[i], settings)) / (2.0f * h);
+                    const float dz = (fractal_noise(xs[i], zs[i] + h, settings) -
+                                      fractal_noise(xs[i], zs[i] - h, settings)) / (2.0f * h);
+                    EXPECT_EQ(sample.value, fractal_noise(xs[i], zs[i], settings));
+                    EXPECT_NEAR(sample.dx, dx, 0.01f + 0.01f * fabsf(dx))
+                        << "basis " << (int)basis << ", interpolation " << (int)interpolation
+                        << ", warp " << warp << ", index " << i;
+                    EXPECT_NEAR(sample.dz, dz, 0.01f + 0.01f * fabsf(dz))
+                        << "basis " << (int)basis << ", interpolation " << (int)interpolation
+                        << ", warp " << warp << ", index " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(NoiseTests, SampleBatchMatchesScalarExactly) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 41);
+    std::vector<NoiseSample> out(xs.size());
+
+    for (NoiseBasis basis : { NoiseBasis::Value, NoiseBasis::Gradient, NoiseBasis::Simplex }) {
+        for (uint32_t octaves : { 5u, NOISE_UNROLLED_OCTAVES + 2 }) {
+            const NoiseSettings settings = { 3, basis, NoiseInterpolation::Cosine, 0.5f, octaves, 0.45f };
+            fractal_noise_sample_batch(xs.data(), zs.data(), out.data(), xs.size(), settings);
+            for (size_t i = 0; i < xs.size(); ++i) {
+                const NoiseSample scalar = fractal_noise_sample(xs[i], zs[i], settings);
+                EXPECT_EQ(out[i].value, scalar.value) << "basis " << (int)basis << ", index " << i;
+                EXPECT_EQ(out[i].dx, scalar.dx) << "basis " << (int)basis << ", index " << i;
+                EXPECT_EQ(out[i].dz, scalar.dz) << "basis " << (int)basis << ", index " << i;
+            }
+        }
+    }
+}
+
+TEST(NoiseTests, TerrainSamplesCarryTheWorldSlope) {
+    std::vector<float> xs, zs;
+    make_points(xs, zs, 37);
+    std::vector<TerrainSample> out(xs.size());
+    TerrainParams params;
+    params.height = 20.0f;
+
+    get_terrain_samples(xs.data(), zs.data(), out.data(), xs.size(), params);
+
+    const float h = 1e-2f;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const TerrainSample sample = get_terrain_sample(xs[i], zs[i], params);
+        EXPECT_EQ(sample.height, get_terrain_height(xs[i], zs[i], params));
+        EXPECT_EQ(out[i].height, sample.height);
+        EXPECT_EQ(out[i].gradient.x, sample.gradient.x);
+        EXPECT_EQ(out[i].gradient.y, sample.gradient.y);
+
+        const float dx = (get_terrain_height(xs[i] + h, zs[i], params) -
+                          get_terrain_height(xs[i] - h, zs[i], params)) / (2.0f * h);
+        const float dz = (get_terrain_height(xs[i], zs[i] + h, params) -
+                          get_terrain_height(xs[i], zs[i] - h, params)) / (2.0f * h);
+        EXPECT_NEAR(sample.gradient.x, dx, 0.02f + 0.01f * fabsf(dx)) << "at index " << i;
+        EXPECT_NEAR(sample.gradient.y, dz, 0.02f + 0.01f * fabsf(dz)) << "at index " << i;
+        EXPECT_GT(terrain_sample_normal(sample).y, 0.0f);
+    }
+}
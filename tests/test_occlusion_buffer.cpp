@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "occlusion_buffer.hpp"
+#include "camera.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    OcclusionBuffer buffer_for(bool reverseZ) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = { 0.0f, 0.0f, 0.0f };
+        update_camera_view(cam);
+        OcclusionBuffer buffer;
+        occlusion_buffer_begin(buffer, cam.projectionMatrix * cam.viewMatrix, OCCLUSION_BUFFER_WIDTH, 144);
+        return buffer;
+    }
+
+    // A square facing the camera, 10 units ahead
+    void draw_wall(OcclusionBuffer& buffer) {
+        occlusion_buffer_triangle(buffer, { -5.0f, -5.0f, -10.0f }, { 5.0f, -5.0f, -10.0f }, { 5.0f, 5.0f, -10.0f });
+        occlusion_buffer_triangle(buffer, { -5.0f, -5.0f, -10.0f }, { -5.0f, 5.0f, -10.0f }, { 5.0f, 5.0f, -10.0f });
+    }
+
+    BoundingBox box_at(simd::float3 center, float extent) {
+        return { center - simd::float3{ extent, extent, extent }, center + simd::float3{ extent, extent, extent } };
+    }
+}
+
+TEST(OcclusionBufferTests, WallHidesOnlyWhatIsBehindIt) {
+    for (bool reverseZ : { false, true }) {
+        OcclusionBuffer buffer = buffer_for(reverseZ);
+        EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -30.0f }, 1.0f)));
+
+        draw_wall(buffer);
+        EXPECT_NEAR(buffer.inverseDepth[72 * buffer.width + 128], 0.1f, 1e-4f);
+        EXPECT_TRUE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -30.0f }, 1.0f)));
+        // In front of the wall, reaching in front of it, and beside it
+        EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -5.0f }, 1.0f)));
+        EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -12.0f }, 3.0f)));
+        EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 20.0f, 0.0f, -30.0f }, 1.0f)));
+        // Just behind, within the bias
+        EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -10.05f - 1.0f / 32.0f }, 1.0f / 32.0f)));
+    }
+}
+
+TEST(OcclusionBufferTests, TrianglesCrossingTheNearPlaneAreClipped) {
+    OcclusionBuffer buffer = buffer_for(false);
+    // A floor reaching behind the camera covers the bottom of the screen only
+    occlusion_buffer_triangle(buffer, { -50.0f, -2.0f, 20.0f }, { 50.0f, -2.0f, 20.0f }, { 50.0f, -2.0f, -100.0f });
+    occlusion_buffer_triangle(buffer, { -50.0f, -2.0f, 20.0f }, { -50.0f, -2.0f, -100.0f }, { 50.0f, -2.0f, -100.0f });
+    EXPECT_GT(buffer.inverseDepth[(buffer.height - 1) * buffer.width + 128], 0.0f);
+    EXPECT_EQ(buffer.inverseDepth[128], 0.0f);
+
+    EXPECT_TRUE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, -4.0f, -20.0f }, 1.0f)));
+    EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, 0.0f, -20.0f }, 1.0f)));
+    // Reaching behind the camera
+    EXPECT_FALSE(occlusion_buffer_occludes(buffer, box_at({ 0.0f, -4.0f, 0.0f }, 1.0f)));
+}
+
+TEST(OcclusionBufferTests, CullKeepsTheVisibleFirst) {
+    OcclusionBuffer buffer = buffer_for(false);
+    draw_wall(buffer);
+    CullBounds bounds;
+    cull_bounds_add(bounds, box_at({ 0.0f, 0.0f, -30.0f }, 1.0f));
+    cull_bounds_add(bounds, box_at({ 20.0f, 0.0f, -30.0f }, 1.0f));
+    cull_bounds_add(bounds, box_at({ 1.0f, 1.0f, -40.0f }, 1.0f));
+    cull_bounds_add(bounds, box_at({ 0.0f, 0.0f, -5.0f }, 1.0f));
+    uint32_t visible[] = { 0, 1, 2, 3 };
+    ASSERT_EQ(occlusion_cull(buffer, bounds, visible, 4), 2u);
+    EXPECT_EQ(std::min(visible[0], visible[1]), 1u);
+    EXPECT_EQ(std::max(visible[0], visible[1]), 3u);
+    EXPECT_EQ(std::min(visible[2], visible[3]), 0u);
+    EXPECT_EQ(std::max(visible[2], visible[3]), 2u);
+}
+
+TEST(OcclusionBufferTests, OccluderGridStaysUnderTheTerrain) {
+    const auto height = [](float x, float z) { return 10.0f * sinf(x * 0.13f) * cosf(z * 0.07f) + 0.05f * x; };
+    TerrainOccluder occluder;
+    const simd::float2 origin = { 64.0f, -32.0f };
+    const float size = 32.0f;
+    terrain_occluder_build(occluder, origin, size, height);
+
+    // Densely sampled, each cell lies above all four of its corners
+    const float cell = size / (OCCLUDER_GRID - 1);
+    for (uint32_t j = 0; j + 1 < OCCLUDER_GRID; ++j) {
+        for (uint32_t i = 0; i + 1 < OCCLUDER_GRID; ++i) {
+            float lowest = INFINITY;
+            for (int s = 0; s <= 32; ++s) {
+                for (int t = 0; t <= 32; ++t) {
+                    const float x = origin.x + (i + s / 32.0f) * cell;
+                    lowest = std::min(lowest, height(x, origin.y + (j + t / 32.0f) * cell));
+                }
+            }
+            for (uint32_t corner = 0; corner < 4; ++corner) {
+                const uint32_t index = (j + corner / 2) * OCCLUDER_GRID + i + corner % 2;
+                EXPECT_LE(occluder.heights[index], lowest);
+            }
+        }
+    }
+
+    // Flat terrain is matched up to the margin
+    terrain_occluder_build(occluder, origin, size, [](float, float) { return 3.0f; });
+    for (float h : occluder.heights) {
+        EXPECT_FLOAT_EQ(h, 3.0f - OCCLUDER_HEIGHT_MARGIN);
+    }
+}
+
+TEST(OcclusionBufferTests, CacheReusesGridsNotUsedThisFrame) {
+    TerrainOccluderCache cache;
+    EXPECT_EQ(terrain_occluder_find(cache, { 1, 2 }, 0, 1), nullptr);
+    terrain_occluder_slot(cache, { 1, 2 }, 0, 1).heights[0] = 5.0f;
+    terrain_occluder_slot(cache, { 3, 4 }, 0, 1);
+    ASSERT_NE(terrain_occluder_find(cache, { 1, 2 }, 0, 1), nullptr);
+    EXPECT_EQ(terrain_occluder_find(cache, { 1, 2 }, 0, 1)->heights[0], 5.0f);
+    // An edit makes the grid stale, and rebuilding it keeps its place
+    EXPECT_EQ(terrain_occluder_find(cache, { 1, 2 }, 1, 2), nullptr);
+    EXPECT_EQ(&terrain_occluder_slot(cache, { 1, 2 }, 1, 2), &cache.occluders[0]);
+    EXPECT_EQ(cache.occluders.size(), 2u);
+
+    // { 3, 4 } was not looked up on frame 2, so a new chunk takes its place
+    terrain_occluder_slot(cache, { 5, 6 }, 0, 2);
+    EXPECT_EQ(cache.occluders.size(), 2u);
+    EXPECT_EQ(terrain_occluder_find(cache, { 3, 4 }, 0, 2), nullptr);
+    terrain_occluder_slot(cache, { 7, 8 }, 0, 2);
+    EXPECT_EQ(cache.occluders.size(), 3u);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "ocean.hpp"
+
+#include <cmath>
+#include <complex>
+
+namespace {
+    OceanSettings small_ocean() {
+        OceanSettings settings;
+        settings.resolution = 16;
+        settings.patchSize = 40.0f;
+        settings.windSpeed = 6.0f;
+        settings.shortestWave = 0.1f;
+        return settings;
+    }
+}
+
+TEST(OceanTests, ButterfliesComputeTheInverseDft) {
+    const uint32_t n = 16;
+    std::vector<simd::float4> data(n * n);
+    for (uint32_t i = 0; i < n * n; ++i) {
+        data[i] = { sinf(0.7f * i), cosf(1.3f * i), 0.01f * (float)(i % 7), -0.02f * (float)(i % 5) };
+    }
+    std::vector<simd::float4> transformed = data;
+    ocean_inverse_fft_2d(ocean_butterflies(n), n, transformed);
+
+    for (uint32_t y = 0; y < n; y += 5) {
+        for (uint32_t x = 0; x < n; x += 3) {
+            std::complex<double> first = 0.0;
+            std::complex<double> second = 0.0;
+            for (uint32_t v = 0; v < n; ++v) {
+                for (uint32_t u = 0; u < n; ++u) {
+                    const std::complex<double> w = std::polar(1.0, 2.0 * M_PI * (double)(u * x + v * y) / n);
+                    const simd::float4 d = data[v * n + u];
+                    first += std::complex<double>(d.x, d.y) * w;
+                    second += std::complex<double>(d.z, d.w) * w;
+                }
+            }
+            const simd::float4 got = transformed[y * n + x];
+            EXPECT_NEAR(got.x, first.real(), 1e-3);
+            EXPECT_NEAR(got.y, first.imag(), 1e-3);
+            EXPECT_NEAR(got.z, second.real(), 1e-3);
+            EXPECT_NEAR(got.w, second.imag(), 1e-3);
+        }
+    }
+}
+
+TEST(OceanTests, SurfaceIsTheSumOfItsWaves) {
+    const OceanSettings settings = small_ocean();
+    const uint32_t n = settings.resolution;
+    const std::vector<simd::float4> initial = ocean_initial_spectrum(settings);
+    const float time = 3.7f;
+    std::vector<simd::float4> fields = ocean_spectrum_at(settings, initial, time);
+    ocean_inverse_fft_2d(ocean_butterflies(n), n, fields);
+
+    const uint32_t x = 5;
+    const uint32_t y = 11;
+    const simd::float2 position = simd::float2{ (float)x, (float)y } * (settings.patchSize / n);
+    // Every frequency is a travelling wave; its conjugate partner keeps the sum real
+    std::complex<double> height = 0.0;
+    for (uint32_t v = 0; v < n; ++v) {
+        for (uint32_t u = 0; u < n; ++u) {
+            const simd::float2 k = ocean_wave_vector(settings, u, v);
+            const double omega = ocean_angular_frequency(settings, simd::length(k));
+            const simd::float4 h0 = initial[v * n + u];
+            const std::complex<double> h = std::complex<double>(h0.x, h0.y) * std::polar(1.0, omega * time) +
+                                           std::complex<double>(h0.z, h0.w) * std::polar(1.0, -omega * time);
+            height += h * std::polar(1.0, (double)simd::dot(k, position));
+        }
+    }
+    EXPECT_NEAR(height.imag(), 0.0, 1e-4);
+    const simd::float3 d = ocean_displacement(settings, fields, x, y);
+    EXPECT_NEAR(d.y, height.real(), 1e-4);
+    EXPECT_GT(fabs(height.real()), 1e-3);
+
+    // Height and both displacements come out real: nothing is left in the unused imaginary part
+    for (uint32_t i = 0; i < n * n; ++i) {
+        ASSERT_NEAR(fields[i].w, 0.0f, 1e-4f);
+    }
+}
+
+TEST(OceanTests, WavesRunDownwindAndRepeatEveryLoop) {
+    OceanSettings settings;
+    settings.resolution = 64;
+    const std::vector<simd::float4> initial = ocean_initial_spectrum(settings);
+    EXPECT_EQ(ocean_phillips(settings, -settings.windDirection), 0.0f);
+    EXPECT_GT(ocean_phillips(settings, settings.windDirection * 0.1f), 0.0f);
+    EXPECT_EQ(ocean_phillips(settings, { 0.0f, 0.0f }), 0.0f);
+
+    const std::vector<OceanButterfly> butterflies = ocean_butterflies(settings.resolution);
+    std::vector<simd::float4> early = ocean_spectrum_at(settings, initial, 12.0f);
+    std::vector<simd::float4> late = ocean_spectrum_at(settings, initial, 12.0f + settings.loopPeriod);
+    ocean_inverse_fft_2d(butterflies, settings.resolution, early);
+    ocean_inverse_fft_2d(butterflies, settings.resolution, late);
+    double sum = 0.0;
+    for (uint32_t y = 0; y < settings.resolution; ++y) {
+        for (uint32_t x = 0; x < settings.resolution; ++x) {
+            const simd::float3 a = ocean_displacement(settings, early, x, y);
+            const simd::float3 b = ocean_displacement(settings, late, x, y);
+            ASSERT_NEAR(a.y, b.y, 1e-3f);
+            sum += a.y * a.y;
+        }
+    }
+    // A fresh breeze: waves of a few decimetres, not ripples and not storm seas
+    const double rms = sqrt(sum / (settings.resolution * settings.resolution));
+    EXPECT_GT(rms, 0.1);
+    EXPECT_LT(rms, 1.0);
+}
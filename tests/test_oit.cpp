@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "oit.hpp"
+
+namespace {
+    void expect_near(simd::float3 a, simd::float3 b, float tolerance) {
+        EXPECT_NEAR(a.x, b.x, tolerance);
+        EXPECT_NEAR(a.y, b.y, tolerance);
+        EXPECT_NEAR(a.z, b.z, tolerance);
+    }
+}
+
+TEST(OitTests, UncoveredPixelsKeepTheBackground) {
+    const OitPixel pixel;
+    expect_near(oit_resolve(pixel, { 0.2f, 0.4f, 0.6f }), { 0.2f, 0.4f, 0.6f }, 1e-6f);
+}
+
+TEST(OitTests, OneLayerMatchesOverBlending) {
+    const simd::float3 background = { 0.6f, 0.8f, 1.0f };
+    const simd::float3 water = { 0.1f, 0.3f, 0.4f };
+    OitPixel pixel;
+    oit_accumulate(pixel, water, 0.6f, 25.0f);
+    expect_near(oit_resolve(pixel, background), water * 0.6f + background * 0.4f, 1e-5f);
+}
+
+TEST(OitTests, LayerOrderDoesNotMatter) {
+    const simd::float3 background = { 0.5f, 0.5f, 0.5f };
+    const simd::float3 colors[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+    const float alphas[3] = { 0.3f, 0.5f, 0.7f };
+    const float depths[3] = { 4.0f, 40.0f, 400.0f };
+
+    OitPixel forward;
+    OitPixel backward;
+    for (int i = 0; i < 3; ++i) {
+        oit_accumulate(forward, colors[i], alphas[i], depths[i]);
+        oit_accumulate(backward, colors[2 - i], alphas[2 - i], depths[2 - i]);
+    }
+    expect_near(oit_resolve(forward, background), oit_resolve(backward, background), 1e-5f);
+    EXPECT_NEAR(forward.revealage, 0.7f * 0.5f * 0.3f, 1e-6f);
+}
+
+TEST(OitTests, NearLayersDominate) {
+    EXPECT_GT(oit_weight(2.0f, 0.5f), oit_weight(50.0f, 0.5f));
+    EXPECT_GT(oit_weight(50.0f, 0.5f), oit_weight(500.0f, 0.5f));
+
+    // Two equal layers far apart: the near one's colour wins the average
+    OitPixel pixel;
+    oit_accumulate(pixel, { 1.0f, 0.0f, 0.0f }, 0.5f, 3.0f);
+    oit_accumulate(pixel, { 0.0f, 0.0f, 1.0f }, 0.5f, 300.0f);
+    const simd::float3 color = oit_resolve(pixel, { 0.0f, 0.0f, 0.0f });
+    EXPECT_GT(color.x, 10.0f * color.z);
+}
+
+TEST(OitTests, WeightsStayInsideHalfPrecision) {
+    // The accumulation target is RGBA16Float; a few full-weight layers must not overflow it
+    EXPECT_LE(oit_weight(0.0f, 1.0f), 3e3f);
+    EXPECT_GT(oit_weight(1e6f, 1.0f), 0.0f);
+    EXPECT_FLOAT_EQ(oit_weight(10.0f, 0.0f), 0.0f);
+}
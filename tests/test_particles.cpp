@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "particles.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+    // Runs the passes as the sort kernel does, on the keys below n only
+    void bitonic_sort(std::vector<uint32_t>& keys, uint32_t n, const std::vector<simd::uint2>& passes) {
+        for (simd::uint2 pass : passes) {
+            for (uint32_t i = 0; i < n; ++i) {
+                const uint32_t partner = i ^ pass.y;
+                if (partner <= i || partner >= n) {
+                    continue;
+                }
+                const bool ascending = (i & pass.x) == 0;
+                if ((keys[i] > keys[partner]) == ascending) {
+                    std::swap(keys[i], keys[partner]);
+                }
+            }
+        }
+    }
+
+    HeightField flat_field(float height) {
+        HeightField field;
+        field.originX = -8.0f;
+        field.originZ = -8.0f;
+        field.width = 17;
+        field.depth = 17;
+        field.heights.assign((size_t)field.width * field.depth, height);
+        return field;
+    }
+}
+
+TEST(ParticleTests, EmissionCarriesFractionsAndStopsAtTheCapacity) {
+    float pending = 0.0f;
+    uint32_t emitted = 0;
+    for (int i = 0; i < 60; ++i) {
+        emitted += particle_emit_count(pending, 150.0f, 1.0f / 60.0f, 1000);
+    }
+    EXPECT_NEAR((float)emitted, 150.0f, 1.0f);
+    EXPECT_EQ(particle_emit_count(pending, 1e6f, 1.0f, 1000), 1000u);
+    EXPECT_EQ(particle_emit_count(pending, -5.0f, 1.0f, 1000), 0u);
+}
+
+TEST(ParticleTests, PoolPassesSortAnyPowerOfTwoPrefix) {
+    const uint32_t capacity = 64;
+    const std::vector<simd::uint2> passes = particle_sort_passes(capacity);
+    EXPECT_EQ(passes.size(), 21u); // log2(64) * (log2(64) + 1) / 2
+
+    for (uint32_t alive : { 0u, 1u, 5u, 16u, 17u, 64u }) {
+        const uint32_t n = particle_sort_size(alive);
+        ASSERT_LE(n, capacity);
+        std::vector<uint32_t> keys(capacity, 7u); // Past n stays as the last frame left it
+        for (uint32_t i = 0; i < alive; ++i) {
+            keys[i] = (i * 2654435761u) >> 8;
+        }
+        std::fill(keys.begin() + alive, keys.begin() + n, PARTICLE_PAD_KEY);
+        std::vector<uint32_t> expected(keys.begin(), keys.begin() + n);
+        std::sort(expected.begin(), expected.end());
+
+        bitonic_sort(keys, n, passes);
+        EXPECT_EQ(std::vector<uint32_t>(keys.begin(), keys.begin() + n), expected) << alive;
+    }
+    EXPECT_EQ(particle_sort_size(17), 32u);
+    EXPECT_EQ(particle_sort_size(32), 32u);
+}
+
+TEST(ParticleTests, FartherParticlesSortFirst) {
+    EXPECT_LT(particle_sort_key(100.0f), particle_sort_key(10.0f));
+    EXPECT_LT(particle_sort_key(10.0f), particle_sort_key(0.5f));
+    EXPECT_LT(particle_sort_key(0.0f), PARTICLE_PAD_KEY);
+}
+
+TEST(ParticleTests, ParticlesFallBounceAndExpire) {
+    const HeightField field = flat_field(1.0f);
+    ParticleSettings settings;
+    settings.drag = 0.0f;
+    settings.bounce = 0.5f;
+    settings.friction = 0.0f;
+    Particle particle = { { 0.0f, 3.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 2.0f } };
+
+    float lowest = 3.0f;
+    float fastestUp = 0.0f;
+    int steps = 0;
+    while (particle_step(particle, settings, field, 1.0f / 60.0f)) {
+        lowest = std::min(lowest, particle.position.y);
+        fastestUp = std::max(fastestUp, particle.velocity.y);
+        ++steps;
+    }
+    EXPECT_NEAR(steps, 120, 1); // Two seconds of life, give or take the rounding of the ages
+    EXPECT_FLOAT_EQ(lowest, 1.0f);
+    // Falling two units reaches about 6.3 units per second; half of it comes back up
+    EXPECT_NEAR(fastestUp, 0.5f * std::sqrt(2.0f * 9.8f * 2.0f), 0.2f);
+    EXPECT_NEAR(particle.velocity.x, 1.0f, 1e-5f);
+}
+
+TEST(ParticleTests, FrictionSlowsParticlesAlongTheGround) {
+    const HeightField field = flat_field(0.0f);
+    ParticleSettings settings;
+    settings.drag = 0.0f;
+    settings.friction = 0.5f;
+    Particle particle = { { 0.0f, 0.0f, 0.0f, 0.0f }, { 4.0f, -1.0f, 0.0f, 10.0f } };
+    ASSERT_TRUE(particle_step(particle, settings, field, 0.1f));
+    EXPECT_FLOAT_EQ(particle.position.y, 0.0f);
+    EXPECT_NEAR(particle.velocity.x, 2.0f, 1e-5f);
+    EXPECT_GT(particle.velocity.y, 0.0f);
+}
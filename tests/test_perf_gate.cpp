@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include "perf_gate.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+    // Frame times around a median with a deterministic spread and an occasional stall
+    std::vector<float> frame_times(float median, size_t count, uint32_t seed) {
+        std::vector<float> ms;
+        for (size_t i = 0; i < count; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            const float jitter = ((float)(seed >> 8) / (float)(1u << 24) - 0.5f) * 0.1f * median;
+            ms.push_back(median + jitter + (i % 37 == 0 ? 4.0f * median : 0.0f));
+        }
+        return ms;
+    }
+
+    JsonValue parse(const char* text) {
+        JsonValue root;
+        std::string error;
+        EXPECT_TRUE(parse_json(text, root, error)) << error;
+        return root;
+    }
+}
+
+TEST(PerfGateTests, MannWhitneyMatchesTheNormalApproximation) {
+    const MannWhitney separated = mann_whitney_u({ 1, 2, 3, 4, 5 }, { 6, 7, 8, 9, 10 });
+    EXPECT_DOUBLE_EQ(separated.u, 25.0);
+    // z = (25 - 12.5 - 0.5) / sqrt(25 * 11 / 12)
+    EXPECT_NEAR(separated.pGreater, 0.00609, 1e-4);
+    EXPECT_GT(separated.pLess, 0.99);
+
+    const MannWhitney same = mann_whitney_u({ 1, 2, 3, 4, 5 }, { 1, 2, 3, 4, 5 });
+    EXPECT_DOUBLE_EQ(same.u, 12.5);
+    EXPECT_GT(same.pGreater, 0.4);
+    EXPECT_GT(same.pLess, 0.4);
+
+    const MannWhitney tied = mann_whitney_u({ 2, 2, 2 }, { 2, 2, 2 });
+    EXPECT_DOUBLE_EQ(tied.pGreater, 1.0);
+    EXPECT_DOUBLE_EQ(mann_whitney_u({}, { 1 }).pGreater, 1.0);
+}
+
+TEST(PerfGateTests, ReadsFrameAndMicrobenchmarkReports) {
+    std::vector<PerfMetric> metrics;
+    std::string error;
+    const JsonValue frames = parse(R"({
+        "path": "flyover.json", "device": "Apple M2 Max",
+        "cpu_ms": { "count": 3, "mean": 2.0 },
+        "samples": { "cpu_ms": [1.5, 2.0, 2.5], "gpu_ms": [3.0, -1.0, 3.5] }
+    })");
+    ASSERT_TRUE(parse_perf_report(frames, metrics, error)) << error;
+    ASSERT_EQ(metrics.size(), 2u);
+    EXPECT_EQ(metrics[0].name, "cpu_ms");
+    EXPECT_EQ(metrics[0].samples.size(), 3u);
+    // Frames whose GPU time never arrived are left out
+    EXPECT_EQ(metrics[1].samples, (std::vector<float>{ 3.0f, 3.5f }));
+    EXPECT_EQ(perf_report_device(frames), "Apple M2 Max");
+
+    const JsonValue micro = parse(R"({
+        "context": { "num_cpus": 8 },
+        "benchmarks": [
+            { "name": "BM_Noise", "run_name": "BM_Noise", "run_type": "iteration", "real_time": 2000,
+              "time_unit": "ns" },
+            { "name": "BM_Bvh/1000", "run_name": "BM_Bvh/1000", "run_type": "iteration", "real_time": 3,
+              "time_unit": "ms" },
+            { "name": "BM_Noise", "run_name": "BM_Noise", "run_type": "iteration", "real_time": 4, "time_unit": "us" },
+            { "name": "BM_Noise_mean", "run_name": "BM_Noise", "run_type": "aggregate", "real_time": 3,
+              "time_unit": "us" },
+            { "name": "BM_Broken", "run_type": "iteration", "error_occurred": true, "real_time": 0 }
+        ]
+    })");
+    ASSERT_TRUE(parse_perf_report(micro, metrics, error)) << error;
+    ASSERT_EQ(metrics.size(), 2u);
+    EXPECT_EQ(metrics[0].name, "BM_Noise");
+    ASSERT_EQ(metrics[0].samples.size(), 2u);
+    EXPECT_FLOAT_EQ(metrics[0].samples[0], 0.002f);
+    EXPECT_FLOAT_EQ(metrics[0].samples[1], 0.004f);
+    EXPECT_FLOAT_EQ(metrics[1].samples[0], 3.0f);
+    EXPECT_EQ(perf_report_device(micro), "");
+
+    EXPECT_FALSE(parse_perf_report(parse(R"({ "keyframes": [] })"), metrics, error));
+}
+
+TEST(PerfGateTests, FlagsOnlySignificantShiftsBeyondTheThreshold) {
+    const std::vector<PerfMetric> baseline = {
+        { "cpu_ms", frame_times(10.0f, 300, 1) },
+        { "scene_gpu_ms", frame_times(4.0f, 300, 2) },
+        { "shadows_gpu_ms", frame_times(2.0f, 300, 3) },
+        { "encode_cpu_ms", frame_times(1.0f, 300, 4) },
+        { "BM_Noise", { 1, 1, 1, 1 } },
+    };
+    const std::vector<PerfMetric> current = {
+        { "cpu_ms", frame_times(11.0f, 300, 5) },          // 10% slower
+        { "scene_gpu_ms", frame_times(4.04f, 300, 6) },    // 1% slower: significant, but within the threshold
+        { "shadows_gpu_ms", frame_times(2.0f, 300, 7) },   // Unchanged
+        { "encode_cpu_ms", frame_times(0.8f, 300, 8) },    // 20% faster
+        { "BM_Noise", { 2, 2, 2, 2 } },
+        { "ao_gpu_ms", frame_times(1.0f, 300, 9) },
+    };
+    const std::vector<PerfComparison> comparisons = compare_perf_metrics(baseline, current, PerfGateSettings{});
+    ASSERT_EQ(comparisons.size(), current.size());
+    EXPECT_EQ(comparisons[0].verdict, PerfVerdict::Regressed);
+    EXPECT_NEAR(comparisons[0].change, 0.1f, 0.02f);
+    EXPECT_LT(comparisons[0].p, 1e-6);
+    EXPECT_EQ(comparisons[1].verdict, PerfVerdict::Unchanged);
+    EXPECT_LT(comparisons[1].p, 0.01);
+    EXPECT_EQ(comparisons[2].verdict, PerfVerdict::Unchanged);
+    EXPECT_EQ(comparisons[3].verdict, PerfVerdict::Improved);
+    EXPECT_EQ(comparisons[4].verdict, PerfVerdict::TooFewSamples);
+    EXPECT_EQ(comparisons[5].verdict, PerfVerdict::NoBaseline);
+}
+
+TEST(PerfGateTests, DeviceClassesAreDirectoryNames) {
+    EXPECT_EQ(perf_device_class("Apple M1 Pro"), "apple-m1-pro");
+    EXPECT_EQ(perf_device_class("  AMD Radeon Pro 5500M (8 GB) "), "amd-radeon-pro-5500m-8-gb");
+    EXPECT_EQ(perf_device_class(""), "default");
+}
+
+TEST(PerfGateTests, KneeIsWhereGrowthOutpacesTheWorkload) {
+    const std::vector<uint32_t> objects = { 1000, 10000, 100000, 1000000 };
+    // Flat, then linear, then quadratic from 100k to 1M
+    const std::vector<float> ms = { 1.0f, 10.0f, 100.0f, 10000.0f };
+    const PerfScaling scaling = perf_scaling(objects, ms);
+    ASSERT_EQ(scaling.exponents.size(), 4u);
+    EXPECT_EQ(scaling.exponents[0], 0.0f);
+    EXPECT_NEAR(scaling.exponents[1], 1.0f, 1e-4f);
+    EXPECT_NEAR(scaling.exponents[3], 2.0f, 1e-4f);
+    EXPECT_EQ(scaling.knee, 3u);
+
+    // Constant costs never reach the knee, nor does noise under the floor
+    const PerfScaling flat = perf_scaling(objects, { 2.0f, 2.0f, 2.1f, 2.0f });
+    EXPECT_EQ(flat.knee, 4u);
+    const PerfScaling noise = perf_scaling(objects, { 0.001f, 0.04f, 0.002f, 0.03f });
+    EXPECT_EQ(noise.knee, 4u);
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "physics.hpp"
+
+#include <cmath>
+
+namespace {
+    // A 64 x 64 plane rising by slope per unit of x
+    HeightField plane(float slope = 0.0f) {
+        HeightField field;
+        field.originX = -32.0f;
+        field.originZ = -32.0f;
+        field.width = 65;
+        field.depth = 65;
+        for (int z = 0; z < field.depth; ++z) {
+            for (int x = 0; x < field.width; ++x) {
+                field.heights.push_back(slope * (field.originX + x));
+            }
+        }
+        return field;
+    }
+
+    void run(PhysicsWorld& world, JobSystem& jobs, const HeightField& field, float seconds) {
+        for (float t = 0.0f; t < seconds; t += world.settings.step) {
+            physics_step(world, jobs, field);
+        }
+    }
+}
+
+TEST(PhysicsTests, DroppedSpheresSettleOnTheGroundAndEachOther) {
+    const HeightField field = plane();
+    JobSystem jobs({ 2, 1 });
+    PhysicsWorld world = create_physics_world(2);
+    const uint32_t bottom = physics_add_sphere(world, { 0.0f, 2.0f, 0.0f }, 0.5f);
+    const uint32_t top = physics_add_sphere(world, { 0.0f, 4.0f, 0.0f }, 0.5f);
+
+    run(world, jobs, field, 4.0f);
+    // Resting on the plane and on each other, within the slop the solver leaves
+    EXPECT_NEAR(world.positions[bottom].y, 0.5f, 0.03f);
+    EXPECT_NEAR(world.positions[top].y, 1.5f, 0.06f);
+    EXPECT_NEAR(world.positions[top].x, 0.0f, 1e-4f);
+    // The pile went to sleep as one island
+    EXPECT_FALSE(world.awake[bottom]);
+    EXPECT_FALSE(world.awake[top]);
+    EXPECT_EQ(world.stats.awake, 0u);
+    physics_step(world, jobs, field);
+    EXPECT_EQ(world.stats.islands, 0u);
+
+    // Something falling onto the pile wakes it
+    const uint32_t falling = physics_add_sphere(world, { 0.3f, 3.0f, 0.0f }, 0.5f);
+    run(world, jobs, field, 0.5f);
+    EXPECT_TRUE(world.awake[top] || world.awake[bottom]);
+    EXPECT_LT(world.positions[falling].y, 3.0f);
+}
+
+TEST(PhysicsTests, CollisionsKeepMomentum) {
+    const HeightField field = plane();
+    JobSystem jobs({ 1, 1 });
+    PhysicsSettings settings;
+    settings.gravity = { 0.0f, 0.0f, 0.0f };
+    settings.linearDamping = 0.0f;
+    settings.restitution = 1.0f;
+    PhysicsWorld world = create_physics_world(2, settings);
+    const uint32_t a = physics_add_sphere(world, { -2.0f, 10.0f, 0.0f }, 0.5f, { 4.0f, 0.0f, 0.0f });
+    const uint32_t b = physics_add_sphere(world, { 2.0f, 10.0f, 0.0f }, 1.0f, { -1.0f, 0.0f, 0.0f });
+    const float ma = 1.0f / world.inverseMasses[a];
+    const float mb = 1.0f / world.inverseMasses[b];
+    const float before = ma * world.velocities[a].x + mb * world.velocities[b].x;
+
+    run(world, jobs, field, 2.0f);
+    const float after = ma * world.velocities[a].x + mb * world.velocities[b].x;
+    EXPECT_NEAR(after, before, 1e-3f * fabsf(before) + 1e-4f);
+    // They bounced apart: the light one backwards, the heavy one forwards
+    EXPECT_LT(world.velocities[a].x, 0.0f);
+    EXPECT_GT(world.velocities[b].x, 0.0f);
+    EXPECT_GT(simd::length(world.positions[b] - world.positions[a]), 1.5f);
+}
+
+TEST(PhysicsTests, FrictionRollsSpheresDownSlopes) {
+    const HeightField field = plane(0.3f);
+    JobSystem jobs({ 1, 1 });
+    PhysicsSettings settings;
+    settings.angularDamping = 0.0f;
+    settings.linearDamping = 0.0f;
+    PhysicsWorld world = create_physics_world(1, settings);
+    const uint32_t ball = physics_add_sphere(world, { 10.0f, 3.5f, 0.0f }, 0.5f);
+
+    run(world, jobs, field, 1.5f);
+    const simd::float3 v = world.velocities[ball];
+    const simd::float3 w = world.angularVelocities[ball];
+    EXPECT_LT(v.x, -1.0f);
+    // Rolling without slipping: the rim turns as fast as the centre moves, about -Z for motion towards -X
+    EXPECT_NEAR(simd::length(w) * 0.5f, simd::length(v), 0.1f * simd::length(v));
+    EXPECT_GT(w.z, 0.0f);
+}
+
+TEST(PhysicsTests, StepsAreTheSameOnAnyNumberOfThreads) {
+    const HeightField field = plane(0.1f);
+    JobSystem serial({ 1, 1 });
+    JobSystem parallel({ 4, 1 });
+    PhysicsWorld a = create_physics_world(1200);
+    for (uint32_t i = 0; i < 1200; ++i) {
+        // A loose column of layers, offset so the piles tumble
+        const simd::float3 p = { (float)(i % 10) * 1.1f - 5.0f + 0.05f * (i / 100), 2.0f + (float)(i / 100) * 1.2f,
+                                 (float)((i / 10) % 10) * 1.1f - 5.0f };
+        physics_add_sphere(a, p, 0.4f + 0.1f * (i % 3));
+    }
+    PhysicsWorld b = a;
+
+    for (int step = 0; step < 90; ++step) {
+        physics_step(a, serial, field);
+        physics_step(b, parallel, field);
+    }
+    EXPECT_GT(a.stats.contacts, 1000u);
+    EXPECT_LT(a.stats.islands, a.stats.awake);
+    EXPECT_EQ(a.stats.islands, b.stats.islands);
+    for (uint32_t i = 0; i < a.size(); ++i) {
+        ASSERT_EQ(a.positions[i].x, b.positions[i].x);
+        ASSERT_EQ(a.positions[i].y, b.positions[i].y);
+        ASSERT_EQ(a.positions[i].z, b.positions[i].z);
+        // Nothing tunnels through the terrain
+        EXPECT_GT(a.positions[i].y - 0.1f * a.positions[i].x, 0.2f);
+    }
+}
+
+TEST(PhysicsTests, UpdateRunsWholeStepsAndCarriesTheRest) {
+    const HeightField field = plane();
+    JobSystem jobs({ 1, 1 });
+    PhysicsWorld world = create_physics_world(1);
+    physics_add_sphere(world, { 0.0f, 5.0f, 0.0f }, 0.5f);
+
+    EXPECT_EQ(physics_update(world, jobs, field, 0.01f), 0u);
+    EXPECT_EQ(physics_update(world, jobs, field, 0.01f), 1u);
+    EXPECT_NEAR(physics_alpha(world), (0.02f - 1.0f / 60.0f) * 60.0f, 1e-4f);
+    // A stall runs at most maxCatchUpSteps and drops the rest
+    EXPECT_EQ(physics_update(world, jobs, field, 1.0f), world.settings.maxCatchUpSteps);
+    EXPECT_LT(physics_alpha(world), 1.0f);
+    EXPECT_EQ(world.steps, 1u + world.settings.maxCatchUpSteps);
+
+    // Halfway between the last two steps
+    const simd::float4x4 m = physics_body_matrix(world, 0, 0.5f);
+    EXPECT_NEAR(m.columns[3].y, 0.5f * (world.positions[0].y + world.previousPositions[0].y), 1e-5f);
+    EXPECT_NEAR(m.columns[1].y, 1.0f, 1e-5f);
+}
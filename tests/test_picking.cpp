@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "picking.hpp"
+#include "camera.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    // A camera at the origin's side, looking down -Z at a row of unit boxes
+    Camera make_view(bool reverseZ) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = { 0.0f, 1.0f, 10.0f };
+        update_camera_view(cam);
+        return cam;
+    }
+
+    // A flat field at height 0 over [-16, 16] in x and z
+    HeightField flat_field() {
+        HeightField field;
+        field.originX = -16.0f;
+        field.originZ = -16.0f;
+        field.spacing = 1.0f;
+        field.width = 33;
+        field.depth = 33;
+        field.heights.assign(33 * 33, 0.0f);
+        return field;
+    }
+}
+
+TEST(PickingTests, ProjectionCentresThePointInTheTarget) {
+    for (bool reverseZ : { false, true }) {
+        const Camera cam = make_view(reverseZ);
+        const simd::float2 point = { 0.7f, 0.25f };
+        const simd::float4x4 pick = pick_projection(cam.projectionMatrix, point, 1280.0f, 720.0f);
+        // A world point under the cursor lands at the centre of the pick target, at the same depth
+        const PickRay ray = pick_ray(cam.projectionMatrix * cam.viewMatrix, point, reverseZ);
+        const simd::float3 world = ray.origin + 25.0f * ray.direction;
+        const simd::float4 full = cam.projectionMatrix * cam.viewMatrix * simd::float4{ world.x, world.y, world.z, 1 };
+        const simd::float4 magnified = pick * cam.viewMatrix * simd::float4{ world.x, world.y, world.z, 1 };
+        EXPECT_NEAR(magnified.x / magnified.w, 0.0f, 1e-3f);
+        EXPECT_NEAR(magnified.y / magnified.w, 0.0f, 1e-3f);
+        EXPECT_NEAR(magnified.z / magnified.w, full.z / full.w, 1e-6f);
+
+        // One scene pixel to the right moves one target texel, 2 / PICK_TARGET_SIZE in clip space
+        const PickRay next = pick_ray(cam.projectionMatrix * cam.viewMatrix, point + simd::float2{ 1.0f / 1280.0f, 0 },
+                                      reverseZ);
+        const simd::float3 beside = next.origin + 25.0f * next.direction;
+        const simd::float4 moved = pick * cam.viewMatrix * simd::float4{ beside.x, beside.y, beside.z, 1 };
+        EXPECT_NEAR(moved.x / moved.w, 2.0f / PICK_TARGET_SIZE, 1e-2f);
+    }
+}
+
+TEST(PickingTests, RayStartsAtTheEyeAndLooksThroughThePoint) {
+    for (bool reverseZ : { false, true }) {
+        const Camera cam = make_view(reverseZ);
+        const PickRay ray = pick_ray(cam.projectionMatrix * cam.viewMatrix, { 0.5f, 0.5f }, reverseZ);
+        EXPECT_NEAR(simd::length(ray.origin - cam.position), cam.nearZ, 1e-3f);
+        EXPECT_NEAR(simd::dot(ray.direction, cam.forward), 1.0f, 1e-5f);
+    }
+}
+
+TEST(PickingTests, ResolvePrefersTheCentreThenTheNearestTexel) {
+    std::vector<PickId> ids(PICK_TARGET_SIZE * PICK_TARGET_SIZE);
+    const uint32_t center = PICK_TARGET_SIZE / 2 * (PICK_TARGET_SIZE + 1);
+    EXPECT_EQ(pick_resolve(ids.data()), UINT32_MAX);
+
+    // Beyond the radius is too far
+    ids[center + PICK_RADIUS + 1] = { 1, 0 };
+    EXPECT_EQ(pick_resolve(ids.data()), UINT32_MAX);
+
+    ids[center + 3] = { 2, 0 };
+    ids[center - 2 * PICK_TARGET_SIZE] = { 3, 0 };
+    EXPECT_EQ(pick_resolve(ids.data()), center - 2 * PICK_TARGET_SIZE);
+
+    ids[center] = { 4, 0 };
+    EXPECT_EQ(pick_resolve(ids.data()), center);
+}
+
+TEST(PickingTests, StaleIdsPickNothing) {
+    SceneStore scene;
+    const Entity a = scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 1.0f, 0.0f), { 1, 1, 1 });
+    const PickId id = { a.index + 1, a.generation };
+    EXPECT_EQ(pick_entity(scene, id).index, a.index);
+    EXPECT_FALSE(scene_alive(scene, pick_entity(scene, PickId{})));
+
+    // The readback arrives after the entity is gone and its slot reused
+    scene_destroy(scene, a);
+    const Entity b = scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 1.0f, 0.0f), { 1, 1, 1 });
+    ASSERT_EQ(b.index, a.index);
+    EXPECT_FALSE(scene_alive(scene, pick_entity(scene, id)));
+}
+
+TEST(PickingTests, RaycastSkipsEntitiesBehindTheTerrain) {
+    SceneStore scene;
+    const Entity near = scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 1.0f, 0.0f), { 1, 1, 1 });
+    scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 1.0f, -5.0f), { 1, 1, 1 });
+    const Camera cam = make_view(false);
+    const PickRay ray = pick_ray(cam.projectionMatrix * cam.viewMatrix, { 0.5f, 0.5f }, false);
+
+    HeightField field = flat_field();
+    EXPECT_EQ(pick_raycast(scene, &field, ray, 100.0f).index, near.index);
+    EXPECT_FALSE(pick_hidden_by_terrain(scene, field, ray, near, 100.0f));
+
+    // A ridge between the camera and the boxes hides both
+    for (int x = 0; x < field.width; ++x) {
+        field.heights[(16 + 5) * field.width + x] = 4.0f;
+    }
+    EXPECT_TRUE(pick_hidden_by_terrain(scene, field, ray, near, 100.0f));
+    EXPECT_FALSE(scene_alive(scene, pick_raycast(scene, &field, ray, 100.0f)));
+    EXPECT_EQ(pick_raycast(scene, nullptr, ray, 100.0f).index, near.index);
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "pipeline_requests.hpp"
+
+#include <thread>
+
+namespace {
+    // Stands in for a pipeline handle; null is a failed compile
+    using FakePipeline = const int*;
+}
+
+TEST(PipelineRequestsTests, StaysPendingUntilTheCompileFinishes) {
+    PipelineRequests<FakePipeline> requests;
+    std::unordered_set<uint32_t> pending = { 7 };
+    std::unordered_map<uint32_t, FakePipeline> pipelines;
+
+    EXPECT_EQ(pipeline_request_collect(requests, pending, pipelines, 7), PipelineRequestState::Pending);
+    EXPECT_EQ(pending.count(7), 1u);
+    EXPECT_TRUE(pipelines.empty());
+
+    // Another request finishing leaves this one pending
+    const int other = 0;
+    pipeline_request_finish(requests, 8, &other);
+    EXPECT_EQ(pipeline_request_collect(requests, pending, pipelines, 7), PipelineRequestState::Pending);
+    EXPECT_TRUE(pipelines.empty());
+}
+
+TEST(PipelineRequestsTests, FinishedPipelineMovesIntoTheTable) {
+    PipelineRequests<FakePipeline> requests;
+    std::unordered_set<uint32_t> pending = { 3, 4 };
+    std::unordered_map<uint32_t, FakePipeline> pipelines;
+
+    const int pipeline = 0;
+    std::thread compiler([&] { pipeline_request_finish(requests, 3, &pipeline); });
+    compiler.join();
+
+    EXPECT_EQ(pipeline_request_collect(requests, pending, pipelines, 3), PipelineRequestState::Finished);
+    EXPECT_EQ(pipelines.at(3), &pipeline);
+    EXPECT_EQ(pending.count(3), 0u);
+    EXPECT_EQ(pending.count(4), 1u);
+    // Collected once; the hand-off holds nothing more for it
+    EXPECT_TRUE(requests.finished.empty());
+}
+
+TEST(PipelineRequestsTests, FailedCompileIsRecordedAsNull) {
+    PipelineRequests<FakePipeline> requests;
+    std::unordered_set<uint32_t> pending = { 5 };
+    std::unordered_map<uint32_t, FakePipeline> pipelines;
+
+    pipeline_request_finish<FakePipeline>(requests, 5, nullptr);
+    EXPECT_EQ(pipeline_request_collect(requests, pending, pipelines, 5), PipelineRequestState::Failed);
+    // In the table as null, so it is not requested again
+    ASSERT_EQ(pipelines.count(5), 1u);
+    EXPECT_EQ(pipelines.at(5), nullptr);
+    EXPECT_TRUE(pending.empty());
+}
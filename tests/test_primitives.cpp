@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "cube.hpp"
+#include "primitives.hpp"
+#include "sphere.hpp"
+
+namespace {
+    MeshData build(Primitive primitive) {
+        switch (primitive) {
+        case Primitive::Cube:
+            return create_cube();
+        case Primitive::Sphere:
+            return create_sphere();
+        case Primitive::Cylinder:
+            return create_cylinder();
+        case Primitive::Cone:
+            return create_cone();
+        case Primitive::Capsule:
+            return create_capsule();
+        }
+        return {};
+    }
+}
+
+TEST(PrimitiveTests, PrimitivesAreClosedOutwardAndUnitSized) {
+    const simd::float3 halfExtents[PRIMITIVE_COUNT] = {
+        { 0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { 0.25f, 0.5f, 0.25f }
+    };
+    for (uint32_t p = 0; p < PRIMITIVE_COUNT; ++p) {
+        SCOPED_TRACE(primitive_name((Primitive)p));
+        const MeshData mesh = build((Primitive)p);
+        ASSERT_EQ(mesh.indices.size() % 3, 0u);
+        for (int axis = 0; axis < 3; ++axis) {
+            EXPECT_NEAR(mesh.bounds.max[axis], halfExtents[p][axis], 1e-5f);
+            EXPECT_NEAR(mesh.bounds.min[axis], -halfExtents[p][axis], 1e-5f);
+        }
+        for (const Vertex& vertex : mesh.vertices) {
+            EXPECT_NEAR(simd::length(vertex.normal), 1.0f, 1e-5f);
+        }
+
+        // Every shape is convex around the origin, so every front face points away from it
+        double area = 0.0;
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const Vertex& a = mesh.vertices[mesh.indices[i]];
+            const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+            const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+            const simd::float3 face = simd::cross(b.position - a.position, c.position - a.position);
+            ASSERT_GT(simd::length(face), 1e-6f) << "degenerate triangle " << i / 3;
+            EXPECT_GT(simd::dot(face, a.position + b.position + c.position), 0.0f) << "triangle " << i / 3;
+            EXPECT_GT(simd::dot(face, a.normal), 0.0f) << "triangle " << i / 3;
+            area += simd::length(face) * 0.5;
+        }
+        EXPECT_GT(area, 0.0);
+    }
+}
+
+TEST(PrimitiveTests, LibraryHoldsEachPrimitiveAtItsOffsets) {
+    const PrimitiveLibrary library = build_primitive_library();
+    const MeshData& mesh = library.mesh;
+    size_t vertexCount = 0;
+    uint32_t nextIndex = 0;
+    for (uint32_t p = 0; p < PRIMITIVE_COUNT; ++p) {
+        SCOPED_TRACE(primitive_name((Primitive)p));
+        const MeshData part = build((Primitive)p);
+        const PrimitiveRange& range = library.ranges[p];
+        EXPECT_EQ(range.baseVertex, vertexCount);
+        EXPECT_GE(range.firstIndex, nextIndex);
+        EXPECT_EQ(range.firstIndex * index_stride(mesh.indices.format) % 4, 0u);
+        EXPECT_EQ(range.indexCount, part.indices.size());
+        EXPECT_EQ(simd::length(range.bounds.max - part.bounds.max), 0.0f);
+
+        // The indices count from the primitive's own first vertex
+        for (size_t k = 0; k < part.vertices.size(); ++k) {
+            EXPECT_EQ(simd::length(mesh.vertices[range.baseVertex + k].position - part.vertices[k].position), 0.0f);
+        }
+        for (uint32_t i = 0; i < range.indexCount; ++i) {
+            ASSERT_LT(mesh.indices[range.firstIndex + i], part.vertices.size());
+        }
+        vertexCount += part.vertices.size();
+        nextIndex = range.firstIndex + range.indexCount;
+    }
+    EXPECT_EQ(mesh.vertices.size(), vertexCount);
+    EXPECT_EQ(mesh.indices.format, IndexFormat::UInt16);
+}
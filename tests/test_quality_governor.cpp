@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "quality_governor.hpp"
+
+namespace {
+    QualityGovernorSettings quick_settings() {
+        QualityGovernorSettings settings;
+        settings.targetMs = 10.0f;
+        settings.smoothing = 1.0f;
+        settings.downFrames = 3;
+        settings.upFrames = 5;
+        return settings;
+    }
+}
+
+TEST(QualityGovernorTests, FloorFollowsThermalStateAndLowPower) {
+    EXPECT_EQ(quality_governor_floor({ ThermalState::Nominal, false }), 0u);
+    EXPECT_EQ(quality_governor_floor({ ThermalState::Nominal, true }), 1u);
+    EXPECT_EQ(quality_governor_floor({ ThermalState::Fair, true }), 1u);
+    EXPECT_EQ(quality_governor_floor({ ThermalState::Serious, false }), 2u);
+    EXPECT_EQ(quality_governor_floor({ ThermalState::Critical, true }), QUALITY_TIER_COUNT - 1);
+}
+
+TEST(QualityGovernorTests, HeatStepsDownAtOnceAndRecoversOnlyAfterFastFrames) {
+    const QualityGovernorSettings settings = quick_settings();
+    QualityGovernor governor;
+    EXPECT_TRUE(quality_governor_update(governor, settings, { ThermalState::Serious, false }, -1.0f));
+    EXPECT_EQ(governor.tier, 2u);
+
+    // Cooled down, but the tier only rises one step per run of fast frames
+    const PowerState cool;
+    for (uint32_t i = 0; i + 1 < settings.upFrames; ++i) {
+        EXPECT_FALSE(quality_governor_update(governor, settings, cool, 5.0f));
+    }
+    EXPECT_TRUE(quality_governor_update(governor, settings, cool, 5.0f));
+    EXPECT_EQ(governor.tier, 1u);
+    for (uint32_t i = 0; i < settings.upFrames; ++i) {
+        quality_governor_update(governor, settings, cool, 5.0f);
+    }
+    EXPECT_EQ(governor.tier, 0u);
+    EXPECT_EQ(governor.changes, 3u);
+
+    // Low power mode keeps it from rising above tier 1 however fast the frames are
+    const PowerState saving = { ThermalState::Nominal, true };
+    quality_governor_update(governor, settings, saving, 5.0f);
+    EXPECT_EQ(governor.tier, 1u);
+    for (uint32_t i = 0; i < 2 * settings.upFrames; ++i) {
+        quality_governor_update(governor, settings, saving, 5.0f);
+    }
+    EXPECT_EQ(governor.tier, 1u);
+}
+
+TEST(QualityGovernorTests, GpuTimeMovesTiersWithHysteresis) {
+    const QualityGovernorSettings settings = quick_settings();
+    QualityGovernor governor;
+    const PowerState cool;
+
+    // An isolated slow frame, or time between the two thresholds, changes nothing
+    quality_governor_update(governor, settings, cool, 20.0f);
+    quality_governor_update(governor, settings, cool, 9.0f);
+    quality_governor_update(governor, settings, cool, 20.0f);
+    quality_governor_update(governor, settings, cool, 20.0f);
+    EXPECT_EQ(governor.tier, 0u);
+    for (uint32_t i = 0; i < 2 * settings.upFrames; ++i) {
+        quality_governor_update(governor, settings, cool, 9.0f);
+    }
+    EXPECT_EQ(governor.tier, 0u);
+
+    // Sustained slow frames step down one tier per run, and the run starts over after each step
+    for (uint32_t i = 0; i < settings.downFrames; ++i) {
+        quality_governor_update(governor, settings, cool, 20.0f);
+    }
+    EXPECT_EQ(governor.tier, 1u);
+    EXPECT_EQ(governor.slowFrames, 0u);
+    for (uint32_t i = 0; i < 10 * settings.downFrames; ++i) {
+        quality_governor_update(governor, settings, cool, 20.0f);
+    }
+    EXPECT_EQ(governor.tier, QUALITY_TIER_COUNT - 1);
+
+    // Missing GPU times neither break a run nor count towards one
+    for (uint32_t i = 0; i + 1 < settings.upFrames; ++i) {
+        quality_governor_update(governor, settings, cool, 5.0f);
+        quality_governor_update(governor, settings, cool, -1.0f);
+    }
+    EXPECT_EQ(governor.tier, QUALITY_TIER_COUNT - 1);
+    quality_governor_update(governor, settings, cool, 5.0f);
+    EXPECT_EQ(governor.tier, QUALITY_TIER_COUNT - 2);
+}
+
+TEST(QualityGovernorTests, CountsFramesPerTier) {
+    const QualityGovernorSettings settings = quick_settings();
+    QualityGovernor governor;
+    quality_governor_update(governor, settings, {}, 5.0f);
+    quality_governor_update(governor, settings, { ThermalState::Fair, false }, 5.0f);
+    quality_governor_update(governor, settings, { ThermalState::Fair, false }, 5.0f);
+    EXPECT_EQ(governor.tierFrames[0], 2u);
+    EXPECT_EQ(governor.tierFrames[1], 1u);
+    EXPECT_STREQ(thermal_state_name(governor.power.thermal), "fair");
+}
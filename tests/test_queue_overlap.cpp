@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "queue_overlap.hpp"
+
+TEST(QueueOverlapTests, MergesOverlappingAndTouchingIntervals) {
+    std::vector<GpuInterval> intervals = { { 5.0, 6.0 }, { 0.0, 2.0 }, { 1.0, 3.0 }, { 3.0, 4.0 } };
+    EXPECT_DOUBLE_EQ(merge_intervals(intervals), 5.0);
+    ASSERT_EQ(intervals.size(), 2u);
+    EXPECT_DOUBLE_EQ(intervals[0].start, 0.0);
+    EXPECT_DOUBLE_EQ(intervals[0].end, 4.0);
+    EXPECT_DOUBLE_EQ(intervals[1].start, 5.0);
+}
+
+TEST(QueueOverlapTests, OverlapCountsSharedTimeOnce) {
+    const std::vector<GpuInterval> a = { { 0.0, 4.0 }, { 6.0, 10.0 } };
+    const std::vector<GpuInterval> b = { { 1.0, 2.0 }, { 3.0, 7.0 }, { 9.5, 12.0 } };
+    EXPECT_DOUBLE_EQ(interval_overlap(a, b), 1.0 + 1.0 + 1.0 + 0.5);
+    EXPECT_DOUBLE_EQ(interval_overlap(b, a), 3.5);
+    EXPECT_DOUBLE_EQ(interval_overlap(a, {}), 0.0);
+}
+
+TEST(QueueOverlapTests, SummaryComparesOnlyTheSpanBothQueuesCover) {
+    QueueOverlap overlap;
+    // Render frames of 10 ms every 16 ms; compute of 4 ms, half of it before each frame starts
+    for (int frame = 0; frame < 10; ++frame) {
+        const double start = frame * 0.016;
+        queue_overlap_record(overlap, GPU_QUEUE_RENDER, start, start + 0.010);
+        if (frame >= 5) {
+            queue_overlap_record(overlap, GPU_QUEUE_COMPUTE, start - 0.002, start + 0.002);
+        }
+    }
+    const QueueOverlapSummary summary = queue_overlap_summary(overlap);
+    // The first compute buffer starts at 78 ms and the last render frame ends at 154 ms
+    EXPECT_NEAR(summary.computeMs, 20.0, 1e-9);
+    EXPECT_NEAR(summary.overlappedMs, 10.0, 1e-9);
+    EXPECT_NEAR(summary.renderMs, 2.0 + 4 * 10.0, 1e-9);
+}
+
+TEST(QueueOverlapTests, RingsKeepTheLatestCommandBuffers) {
+    QueueOverlap overlap;
+    for (size_t i = 0; i < QUEUE_OVERLAP_HISTORY + 10; ++i) {
+        queue_overlap_record(overlap, GPU_QUEUE_COMPUTE, (double)i, i + 0.5);
+    }
+    ASSERT_EQ(overlap.intervals[GPU_QUEUE_COMPUTE].size(), QUEUE_OVERLAP_HISTORY);
+    EXPECT_DOUBLE_EQ(overlap.intervals[GPU_QUEUE_COMPUTE][0].start, (double)QUEUE_OVERLAP_HISTORY);
+    EXPECT_EQ(queue_overlap_summary(overlap).computeMs, 0.0); // Nothing to compare against
+}
@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+#include "range_allocator.hpp"
+
+TEST(RangeAllocatorTests, TakesTheLowestRangeThatFits) {
+    RangeAllocator ranges(100);
+    EXPECT_EQ(ranges.allocate(10), 0u);
+    EXPECT_EQ(ranges.allocate(20), 10u);
+    EXPECT_EQ(ranges.allocate(30), 30u);
+    EXPECT_EQ(ranges.used(), 60u);
+    EXPECT_EQ(ranges.allocate(41), NO_RANGE);
+
+    // A hole too short is skipped, and one long enough is reused from its start
+    ranges.release(0, 10);
+    EXPECT_EQ(ranges.free_ranges(), 2u);
+    EXPECT_EQ(ranges.allocate(15), 60u);
+    EXPECT_EQ(ranges.allocate(5), 0u);
+    EXPECT_EQ(ranges.allocate(5), 5u);
+    EXPECT_EQ(ranges.largest_free(), 25u);
+    EXPECT_EQ(ranges.allocate(0), 0u);
+    EXPECT_EQ(ranges.used(), 75u);
+}
+
+TEST(RangeAllocatorTests, ReleasesMergeWithTheirNeighbours) {
+    RangeAllocator ranges(30);
+    const uint32_t a = ranges.allocate(10);
+    const uint32_t b = ranges.allocate(10);
+    const uint32_t c = ranges.allocate(10);
+    EXPECT_EQ(ranges.free_ranges(), 0u);
+
+    ranges.release(a, 10);
+    ranges.release(c, 10);
+    EXPECT_EQ(ranges.free_ranges(), 2u);
+    EXPECT_EQ(ranges.allocate(20), NO_RANGE);
+
+    // The middle joins both sides into the whole span again
+    ranges.release(b, 10);
+    EXPECT_EQ(ranges.free_ranges(), 1u);
+    EXPECT_EQ(ranges.largest_free(), 30u);
+    EXPECT_EQ(ranges.used(), 0u);
+    EXPECT_EQ(ranges.allocate(30), 0u);
+}
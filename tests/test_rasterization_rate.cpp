@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "rasterization_rate.hpp"
+
+TEST(RasterizationRateTests, FullRateInTheMiddleAndLessTowardsTheEdges) {
+    float horizontal[RATE_MAP_ZONES];
+    float vertical[RATE_MAP_ZONES];
+    RasterizationRateSettings settings;
+    rasterization_rate_profile(settings, horizontal, vertical);
+
+    EXPECT_FLOAT_EQ(horizontal[RATE_MAP_ZONES / 2], 1.0f);
+    EXPECT_FLOAT_EQ(horizontal[RATE_MAP_ZONES / 2 - 1], 1.0f);
+    for (uint32_t i = 0; i < RATE_MAP_ZONES; ++i) {
+        // Symmetric, never below the edge rate and falling towards both sides
+        EXPECT_FLOAT_EQ(horizontal[i], horizontal[RATE_MAP_ZONES - 1 - i]);
+        EXPECT_GE(horizontal[i], settings.edgeRate);
+        if (i + 1 < RATE_MAP_ZONES / 2) {
+            EXPECT_LE(horizontal[i], horizontal[i + 1]);
+        }
+    }
+    EXPECT_LT(horizontal[0], 0.6f);
+
+    // The sky band lowers the top further than the edge falloff lowers the bottom
+    EXPECT_LT(vertical[0], vertical[RATE_MAP_ZONES - 1]);
+    EXPECT_GE(vertical[0], settings.skyRate);
+    EXPECT_LT(vertical[0], 0.35f);
+    EXPECT_FLOAT_EQ(vertical[RATE_MAP_ZONES - 1], horizontal[RATE_MAP_ZONES - 1]);
+    EXPECT_FLOAT_EQ(vertical[RATE_MAP_ZONES / 2], 1.0f);
+}
+
+TEST(RasterizationRateTests, ShadedFractionIsTheProductOfTheAxisMeans) {
+    float horizontal[RATE_MAP_ZONES];
+    float vertical[RATE_MAP_ZONES];
+    RasterizationRateSettings full;
+    full.edgeRate = 1.0f;
+    full.skyRate = 1.0f;
+    rasterization_rate_profile(full, horizontal, vertical);
+    EXPECT_FLOAT_EQ(rasterization_rate_shaded_fraction(horizontal, vertical), 1.0f);
+
+    RasterizationRateSettings flat;
+    flat.edgeRate = 0.5f;
+    flat.fovea = 0.0f;
+    flat.skyBand = 0.0f;
+    rasterization_rate_profile(flat, horizontal, vertical);
+    // Both axes fall from 1 to 0.5 over the zone centres, so each averages 0.75
+    EXPECT_NEAR(rasterization_rate_shaded_fraction(horizontal, vertical), 0.75f * 0.75f, 1e-5f);
+
+    rasterization_rate_profile(RasterizationRateSettings{}, horizontal, vertical);
+    const float fraction = rasterization_rate_shaded_fraction(horizontal, vertical);
+    EXPECT_GT(fraction, 0.4f);
+    EXPECT_LT(fraction, 0.9f);
+}
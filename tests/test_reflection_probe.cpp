@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "reflection_probe.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    simd::float4 project(const RenderView& view, simd::float3 p) {
+        simd::float4 clip = view.viewProjection * simd::float4{ p.x, p.y, p.z, 1.0f };
+        return { clip.x / clip.w, clip.y / clip.w, clip.z / clip.w, clip.w };
+    }
+}
+
+TEST(ReflectionProbeTests, CapturesAFaceAFrameAndPublishesWholeProbes) {
+    ReflectionProbeSettings settings;
+    ReflectionProbeSchedule schedule;
+    const simd::float3 start = { 1.0f, 2.0f, 3.0f };
+    for (uint32_t face = 0; face < CUBE_FACE_COUNT; ++face) {
+        // The camera drifts, but the capture stays where it began
+        const simd::float3 camera = start + simd::float3{ 0.1f * face, 0, 0 };
+        const ReflectionProbeStep step = reflection_probe_step(schedule, settings, camera);
+        EXPECT_EQ(step.firstFace, face);
+        EXPECT_EQ(step.faceCount, 1u);
+        EXPECT_EQ(step.eye.x, start.x);
+        EXPECT_EQ(step.prefilter, face + 1 == CUBE_FACE_COUNT);
+        EXPECT_EQ(schedule.published, face + 1 == CUBE_FACE_COUNT);
+    }
+    EXPECT_EQ(schedule.captures, 1u);
+    EXPECT_EQ(schedule.center.x, start.x);
+
+    // A still camera renders nothing until the probe is old
+    for (uint32_t frame = 1; frame < settings.refreshFrames; ++frame) {
+        EXPECT_EQ(reflection_probe_step(schedule, settings, start).faceCount, 0u);
+    }
+    EXPECT_EQ(reflection_probe_step(schedule, settings, start).faceCount, 1u);
+}
+
+TEST(ReflectionProbeTests, MovingAwayStartsANewCapture) {
+    ReflectionProbeSettings settings;
+    settings.facesPerFrame = 4;
+    settings.refreshFrames = 0;
+    ReflectionProbeSchedule schedule;
+    ReflectionProbeStep step = reflection_probe_step(schedule, settings, {});
+    EXPECT_EQ(step.faceCount, 4u);
+    // The last pass renders what is left
+    step = reflection_probe_step(schedule, settings, {});
+    EXPECT_EQ(step.firstFace, 4u);
+    EXPECT_EQ(step.faceCount, 2u);
+    EXPECT_TRUE(step.prefilter);
+
+    EXPECT_EQ(reflection_probe_step(schedule, settings, { 3.0f, 0.0f, 0.0f }).faceCount, 0u);
+    step = reflection_probe_step(schedule, settings, { 5.0f, 0.0f, 0.0f });
+    EXPECT_EQ(step.firstFace, 0u);
+    EXPECT_EQ(step.eye.x, 5.0f);
+    // The published probe keeps its centre until the new one is whole
+    EXPECT_EQ(schedule.center.x, 0.0f);
+}
+
+TEST(ReflectionProbeTests, MipsGoDownToTheSmallestAndRoughenLinearly) {
+    EXPECT_EQ(reflection_probe_mip_count(128), 6u);
+    EXPECT_EQ(reflection_probe_mip_count(REFLECTION_PROBE_MIN_MIP_SIZE), 1u);
+    EXPECT_FLOAT_EQ(reflection_probe_mip_roughness(0, 6), 0.0f);
+    EXPECT_FLOAT_EQ(reflection_probe_mip_roughness(5, 6), 1.0f);
+    EXPECT_FLOAT_EQ(reflection_probe_mip_roughness(0, 1), 0.0f);
+}
+
+TEST(ReflectionProbeTests, TexelDirectionsMatchTheCapturedFaces) {
+    // The prefilter reads texels where the multi-view pass drew them
+    RenderView faces[CUBE_FACE_COUNT];
+    cube_map_views(simd::float3{ 0, 0, 0 }, 0.1f, 100.0f, false, faces);
+    for (uint32_t face = 0; face < CUBE_FACE_COUNT; ++face) {
+        for (float u : { 0.2f, 0.5f, 0.9f }) {
+            for (float v : { 0.1f, 0.5f, 0.7f }) {
+                const simd::float3 direction = reflection_probe_texel_direction(face, u, v);
+                EXPECT_NEAR(simd::length(direction), 1.0f, 1e-5f);
+                const simd::float4 ndc = project(faces[face], direction * 10.0f);
+                EXPECT_GT(ndc.w, 0.0f);
+                EXPECT_NEAR(ndc.x, 2.0f * u - 1.0f, 1e-4f);
+                EXPECT_NEAR(ndc.y, 1.0f - 2.0f * v, 1e-4f);
+            }
+        }
+    }
+}
+
+TEST(ReflectionProbeTests, LobeSamplesGatherAroundTheNormal) {
+    const simd::float3 normal = simd::normalize(simd::float3{ 0.3f, 1.0f, -0.2f });
+    const uint32_t count = 32;
+    float halfCosine = 0.0f;
+    // A mirror reflects the normal itself
+    for (uint32_t i = 0; i < count; ++i) {
+        const simd::float3 light = reflection_probe_ggx_sample(i, count, 0.0f, normal, halfCosine);
+        EXPECT_NEAR(simd::dot(light, normal), 1.0f, 1e-4f);
+        EXPECT_NEAR(halfCosine, 1.0f, 1e-5f);
+    }
+    // Rougher lobes spread wider, but what the prefilter keeps of them, weighted by N.L, stays centred
+    float previous = 1.0f;
+    for (float roughness : { 0.25f, 0.5f, 1.0f }) {
+        simd::float3 sum = {};
+        float spread = 0.0f;
+        for (uint32_t i = 0; i < count; ++i) {
+            const simd::float3 light = reflection_probe_ggx_sample(i, count, roughness, normal, halfCosine);
+            EXPECT_NEAR(simd::length(light), 1.0f, 1e-4f);
+            sum += light * std::max(simd::dot(light, normal), 0.0f);
+            spread += simd::dot(light, normal);
+        }
+        EXPECT_GT(simd::dot(simd::normalize(sum), normal), 0.99f);
+        EXPECT_LT(spread / count, previous);
+        previous = spread / count;
+    }
+}
+
+TEST(ReflectionProbeTests, SparserSamplesReadCoarserMips) {
+    EXPECT_FLOAT_EQ(reflection_probe_sample_lod(0.0f, 1.0f, 32, 128), 0.0f);
+    // Rougher lobes and fewer samples cover more solid angle per sample
+    const float smooth = reflection_probe_sample_lod(0.3f, 1.0f, 32, 128);
+    const float rough = reflection_probe_sample_lod(0.8f, 1.0f, 32, 128);
+    EXPECT_GT(rough, smooth);
+    EXPECT_GT(reflection_probe_sample_lod(0.8f, 1.0f, 8, 128), rough);
+    // Off the lobe's peak the density falls, so the footprint grows
+    EXPECT_GT(reflection_probe_sample_lod(0.3f, 0.95f, 32, 128), smooth);
+    // Finer captures need coarser mips for the same footprint: one level per doubling
+    EXPECT_NEAR(reflection_probe_sample_lod(0.8f, 1.0f, 32, 256) - rough, 1.0f, 1e-4f);
+}
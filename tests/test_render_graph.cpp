@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include "heap_allocations.hpp"
+#include "render_graph.hpp"
+
+namespace {
+    // SSAO-like frame: a kernel into a transient, an upsample into the imported colour, and a debug pass
+    // writing a transient nothing reads
+    struct SampleFrame {
+        uint32_t color, depth, occlusion, debug;
+        uint32_t kernel, upsample, unused;
+    };
+
+    SampleFrame declare_sample(RenderGraph& graph, uint32_t upsampleQueue = 0) {
+        SampleFrame frame;
+        render_graph_reset(graph);
+        frame.color = render_graph_import(graph, "Color");
+        frame.depth = render_graph_import(graph, "Depth");
+        frame.occlusion = render_graph_transient(graph, "Occlusion", 1000, 256);
+        frame.debug = render_graph_transient(graph, "Debug", 500, 256);
+        frame.kernel = render_graph_add_pass(graph, "Kernel", RenderGraphPassType::Compute);
+        render_graph_read(graph, frame.depth);
+        render_graph_write(graph, frame.occlusion);
+        frame.unused = render_graph_add_pass(graph, "Debug", RenderGraphPassType::Compute);
+        render_graph_read(graph, frame.occlusion);
+        render_graph_write(graph, frame.debug);
+        frame.upsample = render_graph_add_pass(graph, "Upsample", RenderGraphPassType::Render, upsampleQueue);
+        render_graph_read(graph, frame.depth);
+        render_graph_read(graph, frame.occlusion);
+        render_graph_read(graph, frame.color);
+        render_graph_write(graph, frame.color);
+        return frame;
+    }
+
+    const RenderGraphWait* step_waits(const RenderGraphPlan& plan, uint32_t step) {
+        return plan.waits.data() + plan.steps[step].firstWait;
+    }
+}
+
+TEST(RenderGraphTests, CullsPassesWhoseOutputsNothingReads) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    const SampleFrame frame = declare_sample(graph);
+    compile_render_graph(graph, plan);
+
+    ASSERT_EQ(plan.steps.size(), 2u);
+    EXPECT_EQ(plan.steps[0].pass, frame.kernel);
+    EXPECT_EQ(plan.steps[1].pass, frame.upsample);
+    EXPECT_EQ(plan.passSteps[frame.unused], RENDER_GRAPH_NONE);
+    EXPECT_EQ(plan.lifetimes[frame.debug].first, RENDER_GRAPH_NONE);
+    EXPECT_EQ(plan.heapSize, 1000u);
+    EXPECT_EQ(plan.transientBytes, 1000u);
+
+    // With side effects the same pass stays, and so does the memory it writes
+    graph.passes[frame.unused].sideEffects = true;
+    compile_render_graph(graph, plan);
+    ASSERT_EQ(plan.steps.size(), 3u);
+    EXPECT_EQ(plan.steps[1].pass, frame.unused);
+    EXPECT_EQ(plan.lifetimes[frame.debug].first, 1u);
+    EXPECT_EQ(plan.heapSize, 1524u);
+}
+
+TEST(RenderGraphTests, OverwrittenResultsAreCulled) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    const uint32_t color = render_graph_import(graph, "Color");
+    render_graph_add_pass(graph, "Clear", RenderGraphPassType::Render);
+    render_graph_write(graph, color);
+    const uint32_t draw = render_graph_add_pass(graph, "Draw", RenderGraphPassType::Render);
+    render_graph_write(graph, color);
+    const uint32_t blend = render_graph_add_pass(graph, "Blend", RenderGraphPassType::Render);
+    render_graph_read(graph, color);
+    render_graph_write(graph, color);
+    compile_render_graph(graph, plan);
+
+    ASSERT_EQ(plan.steps.size(), 2u);
+    EXPECT_EQ(plan.steps[0].pass, draw);
+    EXPECT_EQ(plan.steps[1].pass, blend);
+    // Metal tracks imported resources on their own queue, so nothing waits
+    EXPECT_TRUE(plan.waits.empty());
+}
+
+TEST(RenderGraphTests, TransientsShareMemoryOnlyWhenNeverAliveTogether) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    const uint32_t color = render_graph_import(graph, "Color");
+    const uint32_t a = render_graph_transient(graph, "A", 1000, 256);
+    const uint32_t b = render_graph_transient(graph, "B", 300, 256);
+    const uint32_t c = render_graph_transient(graph, "C", 600, 512);
+    render_graph_add_pass(graph, "Write A", RenderGraphPassType::Compute);
+    render_graph_write(graph, a);
+    render_graph_add_pass(graph, "A to B", RenderGraphPassType::Compute);
+    render_graph_read(graph, a);
+    render_graph_write(graph, b);
+    render_graph_add_pass(graph, "B to C", RenderGraphPassType::Compute);
+    render_graph_read(graph, b);
+    render_graph_write(graph, c);
+    render_graph_add_pass(graph, "Resolve", RenderGraphPassType::Render);
+    render_graph_read(graph, c);
+    render_graph_write(graph, color);
+    compile_render_graph(graph, plan);
+
+    ASSERT_EQ(plan.steps.size(), 4u);
+    EXPECT_EQ(plan.lifetimes[a].first, 0u);
+    EXPECT_EQ(plan.lifetimes[a].last, 1u);
+    EXPECT_EQ(plan.lifetimes[b].first, 1u);
+    EXPECT_EQ(plan.lifetimes[c].last, 3u);
+    // B is alive with A, so it goes after it; C is only alive with B, so it takes A's memory
+    EXPECT_EQ(plan.lifetimes[a].offset, 0u);
+    EXPECT_EQ(plan.lifetimes[b].offset, 1024u);
+    EXPECT_EQ(plan.lifetimes[c].offset, 0u);
+    EXPECT_EQ(plan.heapSize, 1324u);
+    EXPECT_EQ(plan.transientBytes, 1900u);
+
+    // C's writer waits for B's writer, which is also A's last reader and so frees A's memory
+    ASSERT_EQ(plan.steps[2].waitCount, 1u);
+    EXPECT_EQ(step_waits(plan, 2)[0].step, 1u);
+    EXPECT_FALSE(step_waits(plan, 2)[0].event);
+    EXPECT_TRUE(plan.steps[1].updateFence);
+    EXPECT_EQ(plan.steps[3].waitCount, 1u);
+    EXPECT_EQ(step_waits(plan, 3)[0].step, 2u);
+    EXPECT_FALSE(plan.steps[3].updateFence);
+}
+
+TEST(RenderGraphTests, WritersWaitForEveryReaderSinceTheLastWrite) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    const uint32_t color = render_graph_import(graph, "Color");
+    const uint32_t t = render_graph_transient(graph, "T", 64, 64);
+    render_graph_add_pass(graph, "Write", RenderGraphPassType::Compute);
+    render_graph_write(graph, t);
+    for (int i = 0; i < 2; ++i) {
+        render_graph_add_pass(graph, "Read", RenderGraphPassType::Render);
+        render_graph_read(graph, t);
+        render_graph_read(graph, color);
+        render_graph_write(graph, color);
+    }
+    render_graph_add_pass(graph, "Rewrite", RenderGraphPassType::Compute);
+    render_graph_write(graph, t);
+    render_graph_add_pass(graph, "Read again", RenderGraphPassType::Render);
+    render_graph_read(graph, t);
+    render_graph_read(graph, color);
+    render_graph_write(graph, color);
+    compile_render_graph(graph, plan);
+
+    ASSERT_EQ(plan.steps.size(), 5u);
+    // Both readers waited for the first write, so the rewrite only waits for them
+    ASSERT_EQ(plan.steps[3].waitCount, 2u);
+    EXPECT_EQ(step_waits(plan, 3)[0].step, 1u);
+    EXPECT_EQ(step_waits(plan, 3)[1].step, 2u);
+    ASSERT_EQ(plan.steps[4].waitCount, 1u);
+    EXPECT_EQ(step_waits(plan, 4)[0].step, 3u);
+}
+
+TEST(RenderGraphTests, OtherQueuesWaitOnEvents) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    const SampleFrame frame = declare_sample(graph, 1);
+    compile_render_graph(graph, plan);
+
+    ASSERT_EQ(plan.steps.size(), 2u);
+    ASSERT_EQ(plan.steps[1].waitCount, 1u);
+    EXPECT_EQ(step_waits(plan, 1)[0].step, 0u);
+    EXPECT_TRUE(step_waits(plan, 1)[0].event);
+    EXPECT_TRUE(plan.steps[0].signalEvent);
+    EXPECT_FALSE(plan.steps[0].updateFence);
+    EXPECT_EQ(plan.steps[1].pass, frame.upsample);
+}
+
+TEST(RenderGraphTests, SteadyStateFramesDoNotAllocate) {
+    RenderGraph graph;
+    RenderGraphPlan plan;
+    declare_sample(graph);
+    compile_render_graph(graph, plan);
+    EXPECT_EQ(count_heap_allocations([&] {
+        declare_sample(graph);
+        compile_render_graph(graph, plan);
+    }), 0u);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "heap_allocations.hpp"
+#include "render_queue.hpp"
+
+#include <cstdint>
+
+namespace {
+    const char* QUAD_SHADERS = R"(
+        #include <metal_stdlib>
+        using namespace metal;
+        vertex float4 quad_vertex(uint vid [[vertex_id]]) {
+            return float4(float(vid & 1), float(vid >> 1), 0.0, 1.0);
+        }
+        fragment half4 quad_fragment() {
+            return half4(1.0h);
+        }
+    )";
+
+    // Stand-ins for pushes that never reach an encoder, which only compare the pointers
+    template <typename T>
+    T* fake_object(uintptr_t address) {
+        return reinterpret_cast<T*>(address);
+    }
+
+    // A device, two identical pipelines and an encoder on a small target
+    class RenderQueueEncodeTests : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            pool = NS::AutoreleasePool::alloc()->init();
+            device = MTL::CreateSystemDefaultDevice();
+            if (!device) {
+                GTEST_SKIP() << "No Metal device";
+            }
+            NS::Error* error = nullptr;
+            MTL::Library* library =
+                device->newLibrary(NS::String::string(QUAD_SHADERS, NS::UTF8StringEncoding), nullptr, &error);
+            ASSERT_NE(library, nullptr);
+            MTL::Function* vertex = library->newFunction(NS::String::string("quad_vertex", NS::UTF8StringEncoding));
+            MTL::Function* fragment =
+                library->newFunction(NS::String::string("quad_fragment", NS::UTF8StringEncoding));
+            MTL::RenderPipelineDescriptor* desc = MTL::RenderPipelineDescriptor::alloc()->init();
+            desc->setVertexFunction(vertex);
+            desc->setFragmentFunction(fragment);
+            desc->colorAttachments()->object(0)->setPixelFormat(MTL::PixelFormatRGBA8Unorm);
+            for (MTL::RenderPipelineState*& pipeline : pipelines) {
+                pipeline = device->newRenderPipelineState(desc, &error);
+                ASSERT_NE(pipeline, nullptr);
+            }
+            desc->release();
+            fragment->release();
+            vertex->release();
+            library->release();
+
+            MTL::TextureDescriptor* targetDesc =
+                MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatRGBA8Unorm, 4, 4, false);
+            targetDesc->setUsage(MTL::TextureUsageRenderTarget);
+            targetDesc->setStorageMode(MTL::StorageModePrivate);
+            target = device->newTexture(targetDesc);
+            indices = device->newBuffer(6 * sizeof(uint16_t), MTL::ResourceStorageModeShared);
+            uniforms = device->newBuffer(1024, MTL::ResourceStorageModeShared);
+            commandQueue = device->newCommandQueue();
+
+            MTL::RenderPassDescriptor* passDesc = MTL::RenderPassDescriptor::renderPassDescriptor();
+            passDesc->colorAttachments()->object(0)->setTexture(target);
+            passDesc->colorAttachments()->object(0)->setLoadAction(MTL::LoadActionClear);
+            passDesc->colorAttachments()->object(0)->setStoreAction(MTL::StoreActionStore);
+            enc = commandQueue->commandBuffer()->renderCommandEncoder(passDesc);
+        }
+
+        // Whatever SetUp got to before it skipped or failed
+        void TearDown() override {
+            if (enc) {
+                enc->endEncoding();
+            }
+            NS::Object* owned[] = { commandQueue, uniforms, indices, target, pipelines[0], pipelines[1], device };
+            for (NS::Object* object : owned) {
+                if (object) {
+                    object->release();
+                }
+            }
+            pool->release();
+        }
+
+        DrawCommand quad(uint32_t pipeline) const {
+            DrawCommand draw;
+            draw.pipeline = pipelines[pipeline];
+            draw.indexBuffer = indices;
+            draw.indexCount = 6;
+            draw.indexType = MTL::IndexTypeUInt16;
+            return draw;
+        }
+
+        NS::AutoreleasePool* pool = nullptr;
+        MTL::Device* device = nullptr;
+        MTL::RenderPipelineState* pipelines[2] = {};
+        MTL::Texture* target = nullptr;
+        MTL::Buffer* indices = nullptr;
+        MTL::Buffer* uniforms = nullptr;
+        MTL::CommandQueue* commandQueue = nullptr;
+        MTL::RenderCommandEncoder* enc = nullptr;
+        RenderQueue queue;
+    };
+}
+
+TEST(RenderQueueTests, PushingAndClearingDoNotAllocateOnceWarm) {
+    RenderQueue queue;
+    auto fill = [&] {
+        render_queue_clear(queue);
+        for (uint32_t i = 0; i < 64; ++i) {
+            DrawCommand draw;
+            draw.pipeline = fake_object<MTL::RenderPipelineState>(0x1000 + 0x100 * (i % 3));
+            draw.depthState = fake_object<MTL::DepthStencilState>(0x8000);
+            draw.vertexBuffer = fake_object<MTL::Buffer>(0x10000 + 0x100 * i);
+            draw.material = i % 5;
+            render_queue_push(queue, draw);
+        }
+    };
+    fill();
+    EXPECT_EQ(count_heap_allocations(fill), 0u);
+    EXPECT_EQ(queue.commands.size(), 64u);
+    EXPECT_EQ(queue.pipelines.size(), 3u);
+    EXPECT_EQ(queue.depthStates.size(), 1u);
+}
+
+TEST_F(RenderQueueEncodeTests, SortsDrawsByPipelineBeforeEncoding) {
+    for (uint32_t i = 0; i < 4; ++i) {
+        render_queue_push(queue, quad(i % 2));
+    }
+    const RenderQueueStats stats = render_queue_submit(queue, enc);
+    EXPECT_EQ(stats.draws, 4u);
+    // Interleaved as pushed this would be four pipeline changes
+    EXPECT_EQ(stats.stateChanges, 2u);
+}
+
+TEST_F(RenderQueueEncodeTests, SameUniformBufferOnlyMovesTheOffset) {
+    for (size_t offset : { 0, 256, 256, 512 }) {
+        DrawCommand draw = quad(0);
+        draw.uniformBuffer = uniforms;
+        draw.uniformOffset = offset;
+        render_queue_push(queue, draw);
+    }
+    const RenderQueueStats stats = render_queue_submit(queue, enc);
+    EXPECT_EQ(stats.draws, 4u);
+    // The pipeline, the buffer, then two offset moves; the repeated offset binds nothing
+    EXPECT_EQ(stats.stateChanges, 4u);
+}
+
+TEST_F(RenderQueueEncodeTests, IndirectBatchDrawsEveryRecordWithOneBinding) {
+    auto* records = (MTL::DrawIndexedPrimitivesIndirectArguments*)uniforms->contents();
+    for (uint32_t i = 0; i < 3; ++i) {
+        records[i] = { 6, 1, 0, 0, i };
+    }
+    DrawCommand batch = quad(0);
+    batch.indirectBuffer = uniforms;
+    batch.indirectCount = 3;
+    render_queue_push(queue, batch);
+    const RenderQueueStats stats = render_queue_submit(queue, enc);
+    EXPECT_EQ(stats.draws, 3u);
+    EXPECT_EQ(stats.stateChanges, 1u);
+}
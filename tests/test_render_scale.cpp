@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "render_scale.hpp"
+
+#include "camera.hpp"
+
+namespace {
+    // Feeds the same GPU time until the controller changes scale, or gives up
+    bool run_until_change(RenderScaleController& controller, const RenderScaleSettings& settings, float gpuMs) {
+        for (int i = 0; i < 200; ++i) {
+            if (render_scale_update(controller, settings, gpuMs)) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+TEST(RenderScaleTests, StepsDownToFitTheBudget) {
+    RenderScaleSettings settings;
+    RenderScaleController controller;
+    // Twice the budget at full scale: 1/sqrt(2 / 0.9) is about 0.67, rounded down to 0.625
+    ASSERT_TRUE(run_until_change(controller, settings, settings.targetMs * 2.0f));
+    EXPECT_FLOAT_EQ(controller.scale, 0.625f);
+    EXPECT_EQ(controller.framesSinceChange, 0u);
+}
+
+TEST(RenderScaleTests, WaitsForTheCooldownBeforeChanging) {
+    RenderScaleSettings settings;
+    RenderScaleController controller;
+    for (uint32_t i = 1; i < settings.cooldownFrames; ++i) {
+        EXPECT_FALSE(render_scale_update(controller, settings, settings.targetMs * 3.0f));
+    }
+    EXPECT_TRUE(render_scale_update(controller, settings, settings.targetMs * 3.0f));
+}
+
+TEST(RenderScaleTests, StepsUpOneNotchAndHoldsInsideTheBand) {
+    RenderScaleSettings settings;
+    RenderScaleController controller;
+    controller.scale = settings.minScale;
+
+    ASSERT_TRUE(run_until_change(controller, settings, settings.targetMs * 0.3f));
+    EXPECT_FLOAT_EQ(controller.scale, settings.minScale + settings.step);
+
+    // Between the grow threshold and the budget nothing changes
+    EXPECT_FALSE(run_until_change(controller, settings, settings.targetMs * 0.85f));
+}
+
+TEST(RenderScaleTests, StaysWithinLimits) {
+    RenderScaleSettings settings;
+    RenderScaleController controller;
+    EXPECT_FALSE(run_until_change(controller, settings, settings.targetMs * 0.1f));
+    EXPECT_FLOAT_EQ(controller.scale, settings.maxScale);
+
+    while (run_until_change(controller, settings, settings.targetMs * 100.0f)) {}
+    EXPECT_FLOAT_EQ(controller.scale, settings.minScale);
+}
+
+TEST(RenderScaleTests, IgnoresMissingGpuTimes) {
+    RenderScaleSettings settings;
+    RenderScaleController controller;
+    EXPECT_FALSE(run_until_change(controller, settings, -1.0f));
+    EXPECT_FLOAT_EQ(controller.scale, 1.0f);
+    EXPECT_LT(controller.smoothedMs, 0.0f);
+}
+
+TEST(RenderScaleTests, DimensionRoundsAndNeverReachesZero) {
+    EXPECT_EQ(render_scale_dimension(1920, 0.75f), 1440u);
+    EXPECT_EQ(render_scale_dimension(1001, 0.5f), 501u);
+    EXPECT_EQ(render_scale_dimension(1, 0.5f), 1u);
+}
+
+TEST(RenderScaleTests, HaltonSequence) {
+    EXPECT_FLOAT_EQ(halton(1, 2), 0.5f);
+    EXPECT_FLOAT_EQ(halton(2, 2), 0.25f);
+    EXPECT_FLOAT_EQ(halton(3, 2), 0.75f);
+    EXPECT_FLOAT_EQ(halton(1, 3), 1.0f / 3.0f);
+    EXPECT_FLOAT_EQ(halton(2, 3), 2.0f / 3.0f);
+    EXPECT_FLOAT_EQ(halton(3, 3), 1.0f / 9.0f);
+}
+
+TEST(RenderScaleTests, JitterMovesProjectedPointsBySubPixels) {
+    const uint32_t width = 800, height = 600;
+    simd::float4x4 projection = matrix_perspective_right_hand(1.0f, (float)width / height, 0.1f, 100.0f);
+    simd::float4x4 jittered = jitter_projection(projection, simd::float2{ 0.5f, -0.25f }, width, height);
+
+    simd::float4 point = { 1.0f, 2.0f, -10.0f, 1.0f };
+    simd::float4 a = projection * point;
+    simd::float4 b = jittered * point;
+    // Pixel offsets: x right, y down, so NDC y moves the other way
+    EXPECT_NEAR((b.x / b.w - a.x / a.w) * width * 0.5f, 0.5f, 1e-4f);
+    EXPECT_NEAR((b.y / b.w - a.y / a.w) * height * 0.5f, 0.25f, 1e-4f);
+    EXPECT_NEAR(b.z / b.w, a.z / a.w, 1e-6f);
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include "replication.hpp"
+#include "replication_session.hpp"
+#include "camera.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    ReplicatedEntity entity_at(uint32_t index, float x, float z) {
+        ReplicatedEntity entity;
+        entity.entity = { index, 1 };
+        entity.mesh = index % 3;
+        entity.color = replication_pack_color({ 0.2f, 0.4f, 0.6f });
+        entity.transform = replication_quantize(matrix_translation(x, 1.0f, z));
+        return entity;
+    }
+
+    void expect_same(const ReplicationSnapshot& a, const ReplicationSnapshot& b) {
+        ASSERT_EQ(a.entities.size(), b.entities.size());
+        for (size_t i = 0; i < a.entities.size(); ++i) {
+            const ReplicatedEntity& x = a.entities[i];
+            const ReplicatedEntity& y = b.entities[i];
+            EXPECT_EQ(x.entity.index, y.entity.index);
+            EXPECT_EQ(x.entity.generation, y.entity.generation);
+            EXPECT_EQ(x.mesh, y.mesh);
+            EXPECT_EQ(x.color, y.color);
+            for (int j = 0; j < 3; ++j) {
+                EXPECT_EQ(x.transform.position[j], y.transform.position[j]);
+                EXPECT_EQ(x.transform.scale[j], y.transform.scale[j]);
+            }
+            EXPECT_EQ(x.transform.rotation, y.transform.rotation);
+        }
+    }
+}
+
+TEST(ReplicationTests, QuantizedTransformsRoundTrip) {
+    const simd::float4x4 transform = matrix_translation(12.3456f, -4.0f, 1000.5f) * matrix_rotation_y(2.1f) *
+                                     matrix_scale(1.5f, 0.75f, 2.0f);
+    const simd::float4x4 back = replication_dequantize(replication_quantize(transform));
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 3; ++r) {
+            // Ten bits per rotation component and 1/256 of scale: a few thousandths on a unit axis
+            EXPECT_NEAR(back.columns[c][r], transform.columns[c][r], c == 3 ? REPLICATION_POSITION_STEP : 0.01f);
+        }
+    }
+    const simd::float3 color = replication_unpack_color(replication_pack_color({ 1.0f, 0.5f, 0.0f }));
+    EXPECT_NEAR(color.y, 0.5f, 1.0f / 255.0f);
+}
+
+TEST(ReplicationTests, DeltasRebuildTheSnapshot) {
+    ReplicationSnapshot baseline;
+    baseline.sequence = 4;
+    for (uint32_t i = 0; i < 6; ++i) {
+        baseline.entities.push_back(entity_at(i, (float)i, 0.0f));
+    }
+    // 1 moves, 3 is gone, 4 was destroyed and its slot reused, 9 is new; the rest rest
+    ReplicationSnapshot current;
+    current.sequence = 7;
+    current.time = 2.5;
+    current.entities = baseline.entities;
+    current.entities[1].transform = replication_quantize(matrix_translation(1.01f, 1.0f, -0.02f));
+    current.entities[4].entity.generation = 2;
+    current.entities.erase(current.entities.begin() + 3);
+    current.entities.push_back(entity_at(9, 4.0f, 4.0f));
+
+    uint8_t packet[REPLICATION_MAX_PACKET];
+    ReplicationSnapshot sent;
+    const size_t size = replication_encode(&baseline, current, { 0.0f, 0.0f, 0.0f }, packet, sizeof(packet), sent);
+    expect_same(sent, current);
+
+    uint32_t sequence = 0;
+    uint32_t baselineSequence = 0;
+    ASSERT_TRUE(replication_peek(packet, size, sequence, baselineSequence));
+    EXPECT_EQ(sequence, 7u);
+    EXPECT_EQ(baselineSequence, 4u);
+    ReplicationSnapshot received;
+    ASSERT_TRUE(replication_decode(packet, size, &baseline, received));
+    expect_same(received, current);
+    EXPECT_EQ(received.time, 2.5);
+    // Without the baseline it names, the packet cannot be read
+    EXPECT_FALSE(replication_decode(packet, size, nullptr, received));
+}
+
+TEST(ReplicationTests, RestingEntitiesCostNothing) {
+    ReplicationSnapshot baseline;
+    baseline.sequence = 1;
+    for (uint32_t i = 0; i < 200; ++i) {
+        baseline.entities.push_back(entity_at(i, (float)i, 0.0f));
+    }
+    ReplicationSnapshot current = baseline;
+    current.sequence = 2;
+
+    uint8_t packet[REPLICATION_MAX_PACKET];
+    ReplicationSnapshot sent;
+    const size_t resting = replication_encode(&baseline, current, {}, packet, sizeof(packet), sent);
+    current.entities[7].transform = replication_quantize(matrix_translation(7.05f, 1.0f, 0.0f));
+    const size_t moved = replication_encode(&baseline, current, {}, packet, sizeof(packet), sent);
+    // Only the header, and then one small delta record
+    EXPECT_EQ(resting, 16u);
+    EXPECT_LE(moved, resting + 8u);
+}
+
+TEST(ReplicationTests, FullPacketsSendTheNearestFirstAndCatchUp) {
+    ReplicationSnapshot current;
+    for (uint32_t i = 0; i < 400; ++i) {
+        current.entities.push_back(entity_at(i, (float)i, 0.0f));
+    }
+    const simd::float3 eye = { 399.0f, 0.0f, 0.0f };
+
+    // The client acknowledges every packet, so each one builds on the previous one
+    ReplicationSnapshot client;
+    const ReplicationSnapshot* baseline = nullptr;
+    uint8_t packet[REPLICATION_MAX_PACKET];
+    for (uint32_t round = 0; round < 32; ++round) {
+        current.sequence = round;
+        ReplicationSnapshot sent;
+        const size_t size = replication_encode(baseline, current, eye, packet, sizeof(packet), sent);
+        EXPECT_LE(size, REPLICATION_MAX_PACKET);
+        ReplicationSnapshot received;
+        ASSERT_TRUE(replication_decode(packet, size, baseline, received));
+        expect_same(received, sent);
+        if (round == 0) {
+            // Not everything fit, and what did is what lies nearest the eye
+            ASSERT_LT(sent.entities.size(), current.entities.size());
+            EXPECT_EQ(sent.entities.back().entity.index, 399u);
+            EXPECT_GT(sent.entities.front().entity.index, 300u);
+        }
+        client = received;
+        baseline = &client;
+        if (client.entities.size() == current.entities.size()) {
+            break;
+        }
+    }
+    expect_same(client, current);
+}
+
+TEST(ReplicationTests, GatherKeepsTheChunksAroundTheEye) {
+    SceneStore scene;
+    for (int i = 0; i < 20; ++i) {
+        scene_create(scene, 0, UNIT_BOX, matrix_translation(i * 32.0f + 16.0f, 0.0f, 16.0f), { 1.0f, 1.0f, 1.0f });
+    }
+    scene_update_bounds(scene);
+
+    std::vector<Entity> query;
+    ReplicationSnapshot snapshot;
+    replication_gather(scene, { 5 * 32.0f + 1.0f, 10.0f, 3.0f }, 32.0f, 2, 1.0, query, snapshot);
+    ASSERT_EQ(snapshot.entities.size(), 5u);
+    for (size_t i = 0; i < snapshot.entities.size(); ++i) {
+        EXPECT_EQ(snapshot.entities[i].entity.index, 3 + i);
+    }
+    EXPECT_EQ(snapshot.time, 1.0);
+}
+
+TEST(ReplicationTests, InterpolationBlendsKnownEntities) {
+    ReplicationSnapshot from;
+    from.entities = { entity_at(0, 0.0f, 0.0f) };
+    from.entities[0].transform = replication_quantize(matrix_translation(0.0f, 1.0f, 0.0f) * matrix_rotation_y(0.2f));
+    ReplicationSnapshot to;
+    to.entities = { entity_at(0, 2.0f, 0.0f), entity_at(1, 5.0f, 5.0f) };
+    to.entities[0].transform = replication_quantize(matrix_translation(2.0f, 1.0f, 0.0f) * matrix_rotation_y(0.6f));
+
+    std::vector<ReplicatedPose> poses;
+    replication_interpolate(from, to, 0.5f, poses);
+    ASSERT_EQ(poses.size(), 2u);
+    const simd::float4x4 halfway = matrix_translation(1.0f, 1.0f, 0.0f) * matrix_rotation_y(0.4f);
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 3; ++r) {
+            EXPECT_NEAR(poses[0].transform.columns[c][r], halfway.columns[c][r], 0.01f);
+        }
+    }
+    // The new entity appears where it is
+    EXPECT_NEAR(poses[1].transform.columns[3].x, 5.0f, REPLICATION_POSITION_STEP);
+}
+
+TEST(ReplicationTests, ClientsMirrorTheServerOverLoopback) {
+    ReplicationSettings settings;
+    ReplicationServer server;
+    std::string error;
+    if (!replication_server_open(server, 0, settings, error)) {
+        GTEST_SKIP() << "No UDP socket here: " << error;
+    }
+    ReplicationClient client;
+    UdpAddress address;
+    ASSERT_TRUE(udp_address_parse(("127.0.0.1:" + std::to_string(server.socket.port)).c_str(), address));
+    ASSERT_TRUE(replication_client_open(client, address, settings, error)) << error;
+
+    // Both start from the same scene; the server then moves one entity, adds one nearby and one far away
+    SceneStore serverScene;
+    SceneStore clientScene;
+    Entity moved;
+    for (SceneStore* scene : { &serverScene, &clientScene }) {
+        moved = scene_create(*scene, 0, UNIT_BOX, matrix_translation(1.0f, 0.0f, 1.0f), { 1.0f, 0.0f, 0.0f });
+        scene_update_bounds(*scene);
+    }
+    scene_set_transform(serverScene, moved, matrix_translation(3.0f, 0.0f, 2.0f));
+    scene_create(serverScene, 1, UNIT_BOX, matrix_translation(-5.0f, 2.0f, 4.0f), { 0.0f, 1.0f, 0.0f });
+    scene_create(serverScene, 1, UNIT_BOX, matrix_translation(5000.0f, 0.0f, 0.0f), { 0.0f, 0.0f, 1.0f });
+    scene_update_bounds(serverScene);
+
+    const std::vector<BoundingBox> meshBounds = { UNIT_BOX, UNIT_BOX };
+    double time = 0.0;
+    for (int step = 0; step < 40 && clientScene.size() < 2; ++step, time += settings.sendInterval) {
+        replication_client_update(client, clientScene, meshBounds, { 0.0f, 1.0f, 0.0f }, time);
+        replication_server_update(server, serverScene, time);
+    }
+    // Settle past the interpolation delay
+    for (int step = 0; step < 10; ++step, time += settings.sendInterval) {
+        replication_client_update(client, clientScene, meshBounds, { 0.0f, 1.0f, 0.0f }, time);
+        replication_server_update(server, serverScene, time);
+    }
+    EXPECT_EQ(server.peers.size(), 1u);
+    // The far entity is outside the interest area and never arrives
+    ASSERT_EQ(clientScene.size(), 2u);
+    EXPECT_NEAR(clientScene.transforms[scene_index(clientScene, moved)].columns[3].x, 3.0f, 0.01f);
+    EXPECT_NEAR(clientScene.transforms[1].columns[3].x, -5.0f, 0.01f);
+    EXPECT_EQ(clientScene.meshes[1], 1u);
+
+    udp_socket_close(client.socket);
+    udp_socket_close(server.socket);
+}
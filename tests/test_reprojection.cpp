@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "reprojection.hpp"
+#include "camera.hpp"
+
+#include <cmath>
+
+namespace {
+    simd::float4x4 view_projection(const Camera& cam) {
+        return cam.projectionMatrix * cam.viewMatrix;
+    }
+
+    Camera camera_at(simd::float3 position, float yaw, bool reverseZ = false) {
+        Camera cam = make_camera(1280, 720, reverseZ);
+        cam.position = position;
+        cam.yaw = yaw;
+        update_camera_view(cam);
+        return cam;
+    }
+}
+
+TEST(ReprojectionTests, HistoryFallsBackToTheCurrentFrame) {
+    const simd::float4x4 a = view_projection(camera_at({ 0.0f, 5.0f, 0.0f }, 0.0f));
+    const simd::float4x4 b = view_projection(camera_at({ 1.0f, 5.0f, 0.0f }, 0.1f));
+    ViewHistory history;
+    EXPECT_EQ(view_history_previous(history, b, 1280, 720).columns[3].x, b.columns[3].x);
+
+    view_history_push(history, a, 1280, 720);
+    const simd::float4x4 previous = view_history_previous(history, b, 1280, 720);
+    for (int c = 0; c < 4; ++c) {
+        EXPECT_EQ(previous.columns[c].x, a.columns[c].x);
+        EXPECT_EQ(previous.columns[c].w, a.columns[c].w);
+    }
+    // A resized target has no history of its own
+    EXPECT_EQ(view_history_previous(history, b, 640, 360).columns[3].x, b.columns[3].x);
+}
+
+TEST(ReprojectionTests, StillCameraReprojectsToTheSamePixel) {
+    for (bool reverseZ : { false, true }) {
+        const Camera cam = camera_at({ 3.0f, 8.0f, -2.0f }, 0.4f, reverseZ);
+        const simd::float4x4 vp = view_projection(cam);
+        const simd::float3 forward = camera_forward(cam.yaw, cam.pitch);
+        const simd::float3 point = cam.position + forward * 20.0f + simd::float3{ 2.0f, -1.0f, 0.0f };
+        const Reprojection r = reproject(vp, point);
+        EXPECT_NEAR(r.viewDepth, simd::dot(point - cam.position, forward), 1e-3f);
+        EXPECT_TRUE(shading_cache_hit(r, r.viewDepth));
+
+        // The point is right of and below the centre of the screen, whose y points down
+        EXPECT_GT(r.uv.x, 0.5f);
+        EXPECT_GT(r.uv.y, 0.5f);
+    }
+}
+
+TEST(ReprojectionTests, MovingCameraFindsWhereThePointWas) {
+    const Camera before = camera_at({ 0.0f, 5.0f, 0.0f }, 0.0f);
+    const Camera after = camera_at({ 0.5f, 5.0f, -1.0f }, 0.05f);
+    const simd::float3 point = { -2.0f, 3.0f, -25.0f };
+
+    const Reprojection then = reproject(view_projection(before), point);
+    const Reprojection now = reproject(view_projection(after), point);
+    // Straight ahead at the start, so near the centre; the camera turned left and moved, so it drifts
+    EXPECT_NEAR(then.viewDepth, 25.0f, 1e-3f);
+    EXPECT_NE(then.uv.x, now.uv.x);
+    EXPECT_LT(now.viewDepth, then.viewDepth);
+    EXPECT_TRUE(shading_cache_hit(then, then.viewDepth * 1.01f));
+    EXPECT_FALSE(shading_cache_hit(then, then.viewDepth * 1.05f));
+    EXPECT_FALSE(shading_cache_hit(then, 0.0f));
+}
+
+TEST(ReprojectionTests, PointsOffScreenOrBehindMiss) {
+    const Camera cam = camera_at({ 0.0f, 0.0f, 0.0f }, 0.0f);
+    const simd::float4x4 vp = view_projection(cam);
+    const Reprojection behind = reproject(vp, { 0.0f, 0.0f, 10.0f });
+    EXPECT_LE(behind.viewDepth, 0.0f);
+    EXPECT_FALSE(shading_cache_hit(behind, behind.viewDepth));
+
+    const Reprojection aside = reproject(vp, { 100.0f, 0.0f, -10.0f });
+    EXPECT_GT(aside.uv.x, 1.0f);
+    EXPECT_FALSE(shading_cache_hit(aside, aside.viewDepth));
+}
+
+TEST(ReprojectionTests, EveryPixelRefreshesOncePerCycle) {
+    for (uint32_t y = 0; y < 6; ++y) {
+        for (uint32_t x = 0; x < 6; ++x) {
+            uint32_t refreshes = 0;
+            for (uint32_t frame = 100; frame < 100 + SHADING_CACHE_REFRESH_FRAMES; ++frame) {
+                refreshes += shading_cache_refresh(x, y, frame);
+            }
+            EXPECT_EQ(refreshes, 1u) << x << " " << y;
+        }
+    }
+    // One pixel of every 2x2 block per frame
+    for (uint32_t frame = 0; frame < 8; ++frame) {
+        uint32_t refreshes = 0;
+        for (uint32_t y = 0; y < 2; ++y) {
+            for (uint32_t x = 0; x < 2; ++x) {
+                refreshes += shading_cache_refresh(x + 10, y + 4, frame);
+            }
+        }
+        EXPECT_EQ(refreshes, 1u);
+    }
+}
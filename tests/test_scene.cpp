@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+#include "scene.hpp"
+#include "camera.hpp"
+#include "draw_sort.hpp"
+#include "frame_stats.hpp"
+#include "heap_allocations.hpp"
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    Entity add_at(SceneStore& scene, uint32_t mesh, float x) {
+        return scene_create(scene, mesh, UNIT_BOX, matrix_translation(x, 0.0f, 0.0f), { x, 0.0f, 0.0f });
+    }
+}
+
+TEST(SceneTests, DestroyKeepsComponentsDenseAndHandlesValid) {
+    SceneStore scene;
+    Entity a = add_at(scene, 0, 1.0f);
+    Entity b = add_at(scene, 0, 2.0f);
+    Entity c = add_at(scene, 0, 3.0f);
+
+    scene_destroy(scene, a);
+    EXPECT_EQ(scene.size(), 2u);
+    EXPECT_FALSE(scene_alive(scene, a));
+    ASSERT_TRUE(scene_alive(scene, c));
+    // c moved into a's place and still finds its own components
+    EXPECT_EQ(scene_index(scene, c), 0u);
+    EXPECT_FLOAT_EQ(scene.colors[scene_index(scene, c)].x, 3.0f);
+    EXPECT_FLOAT_EQ(scene.colors[scene_index(scene, b)].x, 2.0f);
+    EXPECT_FLOAT_EQ(scene.worldBounds.centerX[scene_index(scene, c)], 3.0f);
+
+    // The freed slot is reused, but the old handle does not come back to life
+    Entity d = add_at(scene, 0, 4.0f);
+    EXPECT_EQ(d.index, a.index);
+    EXPECT_FALSE(scene_alive(scene, a));
+    EXPECT_TRUE(scene_alive(scene, d));
+    scene_destroy(scene, a);
+    EXPECT_EQ(scene.size(), 3u);
+}
+
+TEST(SceneTests, MovedEntitiesRefreshTheirBounds) {
+    SceneStore scene;
+    Entity a = add_at(scene, 0, 1.0f);
+    Entity b = add_at(scene, 0, 2.0f);
+
+    scene_set_transform(scene, b, matrix_translation(10.0f, 0.0f, 0.0f));
+    scene_set_transform(scene, b, matrix_translation(20.0f, 0.0f, 0.0f));
+    // Still the old bounds until the update pass runs
+    EXPECT_FLOAT_EQ(scene.worldBounds.centerX[scene_index(scene, b)], 2.0f);
+
+    scene_destroy(scene, a);
+    EXPECT_EQ(scene_update_bounds(scene), 1u);
+    EXPECT_FLOAT_EQ(scene.worldBounds.centerX[scene_index(scene, b)], 20.0f);
+    EXPECT_EQ(scene_update_bounds(scene), 0u);
+}
+
+TEST(SceneTests, CullsAndGroupsInstancesByMesh) {
+    SceneStore scene;
+    add_at(scene, 1, 0.0f);
+    add_at(scene, 0, 1.0f);
+    add_at(scene, 1, 2.0f);
+    add_at(scene, 0, 500.0f); // Behind the far plane
+    add_at(scene, 1, 3.0f);
+
+    Camera cam = make_camera(800, 600);
+    cam.position = { 0.0f, 0.0f, 10.0f };
+    update_camera_view(cam);
+    const Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+
+    std::vector<uint32_t> visible(scene.size());
+    size_t visibleCount = scene_cull(scene, frustum, visible.data());
+    ASSERT_EQ(visibleCount, 4u);
+
+    std::vector<InstanceData> instances(visibleCount);
+    std::vector<SceneBatch> batches;
+    scene_fill_instances(scene, visible.data(), visibleCount, instances.data(), batches);
+    ASSERT_EQ(batches.size(), 2u);
+    EXPECT_EQ(batches[0].mesh, 0u);
+    EXPECT_EQ(batches[0].first, 0u);
+    EXPECT_EQ(batches[0].count, 1u);
+    EXPECT_EQ(batches[1].mesh, 1u);
+    EXPECT_EQ(batches[1].first, 1u);
+    EXPECT_EQ(batches[1].count, 3u);
+
+    EXPECT_FLOAT_EQ(instances[0].color.x, 1.0f);
+    EXPECT_FLOAT_EQ(instances[1].color.x, 0.0f);
+    EXPECT_FLOAT_EQ(instances[2].color.x, 2.0f);
+    EXPECT_FLOAT_EQ(instances[3].modelMatrix.columns[3].x, 3.0f);
+}
+
+TEST(SceneTests, RecolouredEntitiesStayInTheirBatch) {
+    SceneStore scene;
+    const Entity a = add_at(scene, 0, 0.0f);
+    add_at(scene, 0, 1.0f);
+    scene_set_color(scene, a, { 0.25f, 0.5f, 0.75f });
+    scene_set_color(scene, Entity{}, { 9.0f, 9.0f, 9.0f });
+
+    const uint32_t visible[] = { 0, 1 };
+    InstanceData instances[2];
+    std::vector<SceneBatch> batches;
+    scene_fill_instances(scene, visible, 2, instances, batches);
+    ASSERT_EQ(batches.size(), 1u);
+    EXPECT_EQ(batches[0].count, 2u);
+    EXPECT_FLOAT_EQ(instances[0].color.y, 0.5f);
+    EXPECT_FLOAT_EQ(instances[1].color.x, 1.0f);
+}
+
+TEST(SceneTests, FarEntitiesBatchAtCoarserLevels) {
+    SceneStore scene;
+    add_at(scene, 1, 0.0f);
+    add_at(scene, 0, 1.0f);
+    add_at(scene, 1, 200.0f);
+    scene_create(scene, 1, UNIT_BOX, matrix_translation(200.0f, 0.0f, 0.0f) * matrix_scale(100.0f, 100.0f, 100.0f),
+                 { 3.0f, 0.0f, 0.0f });
+
+    MeshLodChain chains[2] = { mesh_lod_single(36), mesh_lod_single(300) };
+    chains[1].levels[1] = { 300, 150, 0.01f };
+    chains[1].count = 2;
+    const uint32_t visible[] = { 0, 1, 2, 3 };
+    uint8_t lods[4];
+    scene_select_lods(scene, visible, 4, chains, { -5.0f, 0.0f, 0.0f }, 1.0f, lods);
+    // Mesh 0 has no coarser level, and the scaled-up far entity still needs its full detail
+    EXPECT_EQ(lods[0], 0u);
+    EXPECT_EQ(lods[1], 0u);
+    EXPECT_EQ(lods[2], 1u);
+    EXPECT_EQ(lods[3], 0u);
+
+    std::vector<InstanceData> instances(4);
+    std::vector<SceneBatch> batches;
+    scene_fill_instances(scene, visible, 4, instances.data(), batches, lods);
+    ASSERT_EQ(batches.size(), 3u);
+    EXPECT_EQ(batches[0].mesh, 0u);
+    EXPECT_EQ(batches[1].mesh, 1u);
+    EXPECT_EQ(batches[1].lod, 0u);
+    EXPECT_EQ(batches[1].count, 2u);
+    EXPECT_EQ(batches[2].mesh, 1u);
+    EXPECT_EQ(batches[2].lod, 1u);
+    EXPECT_EQ(batches[2].count, 1u);
+    EXPECT_FLOAT_EQ(instances[batches[2].first].color.x, 200.0f);
+}
+
+TEST(SceneTests, MemoryBytesCoverEveryEntity) {
+    SceneStore scene;
+    EXPECT_EQ(scene_memory_bytes(scene), 0u);
+    for (int i = 0; i < 10; ++i) {
+        add_at(scene, 0, (float)i);
+    }
+    const size_t perEntity = sizeof(simd::float4x4) + sizeof(simd::float3) + sizeof(BoundingBox) + 6 * sizeof(float);
+    EXPECT_GE(scene_memory_bytes(scene), scene.size() * perEntity + scene.bvh.nodes.size() * sizeof(BvhNode));
+}
+
+TEST(SceneTests, ReserveCoversCreationAndTheHierarchy) {
+    SceneStore scene;
+    scene_reserve(scene, 100);
+    const simd::float4x4* transforms = scene.transforms.data();
+    const BvhNode* nodes = scene.bvh.nodes.data();
+    for (int i = 0; i < 100; ++i) {
+        add_at(scene, 0, (float)i);
+    }
+    EXPECT_EQ(scene.transforms.data(), transforms);
+    EXPECT_EQ(scene.bvh.nodes.data(), nodes);
+    EXPECT_EQ(scene.bvh.nodes.size(), 199u);
+}
+
+TEST(SceneTests, SteadyStateFrameDoesNotAllocate) {
+    SceneStore scene;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 300; ++i) {
+        entities.push_back(add_at(scene, (uint32_t)i % 3, (float)(i % 30) - 15.0f));
+    }
+    Camera cam = make_camera(800, 600);
+    cam.position = { 0.0f, 0.0f, 30.0f };
+    update_camera_view(cam);
+    const Frustum frustum = extract_frustum(cam.projectionMatrix * cam.viewMatrix);
+
+    // What a frame keeps between frames: culling and instance buffers, batches, sort scratch, stats
+    std::vector<uint32_t> visible(scene.size());
+    std::vector<InstanceData> instances(scene.size());
+    std::vector<SceneBatch> batches;
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> sortScratch;
+    FrameStats stats;
+    auto run_frame = [&](int frame) {
+        frame_stats_begin_frame(stats);
+        scene_set_transform(scene, entities[(size_t)frame * 7 % entities.size()],
+                            matrix_translation((float)(frame % 11) - 5.0f, 1.0f, 0.0f));
+        scene_update_bounds(scene);
+        const size_t visibleCount = scene_cull(scene, frustum, visible.data());
+        scene_fill_instances(scene, visible.data(), visibleCount, instances.data(), batches);
+        packets.clear();
+        for (uint32_t b = 0; b < batches.size(); ++b) {
+            packets.push_back({ make_draw_key(0, 0, batches[b].mesh, 0), b });
+            frame_stats_count_draw(stats, 36, batches[b].count);
+        }
+        radix_sort_draws(packets, sortScratch);
+        frame_stats_end_frame(stats);
+    };
+
+    run_frame(0); // Sizes the batches, packets, sort scratch and the stats history
+    EXPECT_EQ(count_heap_allocations([&] {
+        for (int frame = 1; frame <= 300; ++frame) {
+            run_frame(frame);
+        }
+    }), 0u);
+    EXPECT_EQ(frame_stats_history(stats).size(), FRAME_STATS_HISTORY);
+}
+
+TEST(SceneTests, ChangedInstancesAreTakenOnceAsCoalescedRanges) {
+    SceneStore scene;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 10; ++i) {
+        entities.push_back(add_at(scene, 0, (float)i));
+    }
+    std::vector<SceneRange> ranges;
+    // New entities are changes too
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 10u);
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].first, 0u);
+    EXPECT_EQ(ranges[0].count, 10u);
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 0u);
+    EXPECT_TRUE(ranges.empty());
+
+    scene_set_transform(scene, entities[3], matrix_translation(0.0f, 1.0f, 0.0f));
+    scene_set_transform(scene, entities[2], matrix_translation(0.0f, 2.0f, 0.0f));
+    scene_set_transform(scene, entities[2], matrix_translation(0.0f, 3.0f, 0.0f)); // Listed once
+    scene_set_color(scene, entities[9], { 1.0f, 0.0f, 0.0f });
+    scene_set_color(scene, entities[7], { 0.0f, 1.0f, 0.0f });
+    EXPECT_EQ(scene.instanceDirty.size(), 4u);
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 4u);
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].first, 2u);
+    EXPECT_EQ(ranges[0].count, 2u);
+    EXPECT_EQ(ranges[1].first, 7u);
+    EXPECT_EQ(ranges[2].first, 9u);
+
+    // A one-element gap is re-sent rather than split into another copy
+    scene_set_color(scene, entities[7], { 0.0f, 0.0f, 1.0f });
+    scene_set_color(scene, entities[9], { 0.0f, 0.0f, 1.0f });
+    EXPECT_EQ(scene_take_instance_ranges(scene, 1, ranges), 3u);
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].first, 7u);
+    EXPECT_EQ(ranges[0].count, 3u);
+}
+
+TEST(SceneTests, DestroyMarksTheHoleTheLastEntityFills) {
+    SceneStore scene;
+    std::vector<Entity> entities;
+    for (int i = 0; i < 5; ++i) {
+        entities.push_back(add_at(scene, 0, (float)i));
+    }
+    std::vector<SceneRange> ranges;
+    scene_take_instance_ranges(scene, 0, ranges);
+
+    // The last entity was pending; it moves into the hole and is listed there instead
+    scene_set_color(scene, entities[4], { 1.0f, 1.0f, 1.0f });
+    scene_destroy(scene, entities[1]);
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 1u);
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].first, 1u);
+
+    // Destroying the last entity leaves nothing to send
+    scene_set_color(scene, entities[3], { 1.0f, 1.0f, 1.0f });
+    scene_destroy(scene, entities[3]);
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 0u);
+    EXPECT_EQ(scene.instanceFlags.size(), scene.size());
+}
+
+TEST(SceneTests, OrderedInstancesMatchFilledOnes) {
+    SceneStore scene;
+    for (int i = 0; i < 12; ++i) {
+        add_at(scene, (uint32_t)(i * 5) % 3, (float)i);
+    }
+    std::vector<uint32_t> visible = { 11, 2, 5, 7, 0, 9 };
+    std::vector<InstanceData> filled(visible.size());
+    std::vector<SceneBatch> filledBatches;
+    scene_fill_instances(scene, visible.data(), visible.size(), filled.data(), filledBatches);
+
+    // The resident copy in dense order, read through the order list
+    std::vector<InstanceData> resident(scene.size());
+    scene_write_instances(scene, { 0, (uint32_t)scene.size() }, resident.data());
+    std::vector<uint32_t> order(visible.size());
+    std::vector<SceneBatch> batches;
+    scene_order_instances(scene, visible.data(), visible.size(), order.data(), batches);
+    ASSERT_EQ(batches.size(), filledBatches.size());
+    for (size_t b = 0; b < batches.size(); ++b) {
+        EXPECT_EQ(batches[b].first, filledBatches[b].first);
+        EXPECT_EQ(batches[b].count, filledBatches[b].count);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        EXPECT_FLOAT_EQ(resident[order[i]].modelMatrix.columns[3].x, filled[i].modelMatrix.columns[3].x);
+        EXPECT_FLOAT_EQ(resident[order[i]].color.x, filled[i].color.x);
+    }
+}
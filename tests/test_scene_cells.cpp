@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "camera.hpp"
+#include "scene_cells.hpp"
+
+#include <filesystem>
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    std::string test_directory(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "scene_cells_tests" / name;
+        std::filesystem::remove_all(dir);
+        return dir.string();
+    }
+
+    // Two objects per cell at the chunk's corner, counting how often it is asked
+    SceneCellGenerator counting_generator(int& calls) {
+        return [&calls](ChunkKey key, SceneCellObjects& objects) {
+            calls++;
+            for (int i = 0; i < 2; ++i) {
+                objects.transforms.push_back(matrix_translation(key.x * 32.0f + i, 0.0f, key.z * 32.0f));
+                objects.colors.push_back({ 1.0f, 1.0f, 1.0f });
+                objects.meshes.push_back(0);
+                objects.localBounds.push_back(UNIT_BOX);
+            }
+        };
+    }
+}
+
+TEST(SceneCellsTests, EntitiesFollowTheResidentChunks) {
+    SceneCells cells;
+    cells.meshCount = 1;
+    SceneStore scene;
+    int calls = 0;
+    const SceneCellGenerator generate = counting_generator(calls);
+
+    const ChunkKey near[] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+    scene_cells_update(cells, scene, near, 3, generate);
+    EXPECT_EQ(scene.size(), 6u);
+    EXPECT_EQ(calls, 3);
+    // Already resident cells are left alone
+    scene_cells_update(cells, scene, near, 3, generate);
+    EXPECT_EQ(calls, 3);
+
+    const ChunkKey moved[] = { { 1, 0 }, { 2, 0 } };
+    scene_cells_update(cells, scene, moved, 2, generate);
+    EXPECT_EQ(scene.size(), 4u);
+    EXPECT_EQ(scene_cells_entity_count(cells, scene), 4u);
+    EXPECT_EQ(cells.evicted, 2u);
+    std::vector<Entity> found;
+    scene_query_box(scene, { { -5.0f, -5.0f, -5.0f }, { 5.0f, 5.0f, 5.0f } }, found);
+    EXPECT_TRUE(found.empty());
+}
+
+TEST(SceneCellsTests, EvictedCellsKeepTheirChanges) {
+    SceneCells cells;
+    cells.directory = test_directory("evicted");
+    cells.meshCount = 1;
+    SceneStore scene;
+    int calls = 0;
+    const SceneCellGenerator generate = counting_generator(calls);
+
+    const ChunkKey cell[] = { { 3, -2 } };
+    scene_cells_update(cells, scene, cell, 1, generate);
+    const Entity moved = cells.resident.at(cell[0]).entities[0];
+    scene_set_transform(scene, moved, matrix_translation(7.0f, 8.0f, 9.0f));
+    scene_destroy(scene, cells.resident.at(cell[0]).entities[1]);
+
+    scene_cells_update(cells, scene, nullptr, 0, generate);
+    EXPECT_EQ(scene.size(), 0u);
+    scene_cells_update(cells, scene, cell, 1, generate);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(cells.loaded, 1u);
+    ASSERT_EQ(scene.size(), 1u);
+    EXPECT_FLOAT_EQ(scene.transforms[0].columns[3].y, 8.0f);
+}
+
+TEST(SceneCellsTests, CellsNamingUnknownMeshesAreGeneratedAgain) {
+    SceneCells cells;
+    cells.directory = test_directory("unknown");
+    cells.meshCount = 1;
+    SceneStore scene;
+    int calls = 0;
+    const SceneCellGenerator generate = counting_generator(calls);
+
+    const ChunkKey cell[] = { { 0, 0 } };
+    scene_cells_update(cells, scene, cell, 1, generate);
+    EXPECT_EQ(scene_cells_flush(cells, scene), 0u);
+    scene_cells_update(cells, scene, nullptr, 0, generate);
+
+    cells.meshCount = 0;
+    scene_cells_update(cells, scene, cell, 1, generate);
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(cells.loaded, 0u);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "shader_variant.hpp"
+
+#include <set>
+
+TEST(ShaderVariantTests, KeysAreUniquePerVariant) {
+    std::set<uint32_t> keys;
+    int count = 0;
+    for (ShaderProgram program : { ShaderProgram::Default, ShaderProgram::Instanced, ShaderProgram::Landscape,
+                                   ShaderProgram::LandscapeBindless, ShaderProgram::DeferredLighting,
+                                   ShaderProgram::FoliageImpostor }) {
+        for (VertexFormat format : { VertexFormat::Float, VertexFormat::Packed }) {
+            for (LightingModel lighting : { LightingModel::Unlit, LightingModel::Lambert, LightingModel::HalfLambert }) {
+                for (bool heightBands : { false, true }) {
+                    for (bool fog : { false, true }) {
+                        for (bool shadows : { false, true }) {
+                            for (bool deferred : { false, true }) {
+                                for (uint32_t sampleCount : { 1u, 2u, 4u }) {
+                                    for (bool farFade : { false, true }) {
+                                        for (bool multiView : { false, true }) {
+                                            for (bool virtualTexture : { false, true }) {
+                                                for (bool bakedMaterials : { false, true }) {
+                                                    for (bool skyFog : { false, true }) {
+                                                        for (bool pointLights : { false, true }) {
+                                                            for (bool shadingCache : { false, true }) {
+                                                                for (bool ambientOcclusion : { false, true }) {
+                                                                    for (bool lodDissolve : { false, true }) {
+                                                                        for (bool foliageWind : { false, true }) {
+                                                                            for (bool rayTraced : { false, true }) {
+                                                                                ShaderVariant variant;
+                                                                                variant.program = program;
+                                                                                variant.vertexFormat = format;
+                                                                                variant.lighting = lighting;
+                                                                                variant.heightBands = heightBands;
+                                                                                variant.fog = fog;
+                                                                                variant.shadows = shadows;
+                                                                                variant.deferred = deferred;
+                                                                                variant.sampleCount = sampleCount;
+                                                                                variant.farFade = farFade;
+                                                                                variant.multiView = multiView;
+                                                                                variant.virtualTexture = virtualTexture;
+                                                                                variant.bakedMaterials = bakedMaterials;
+                                                                                variant.skyFog = skyFog;
+                                                                                variant.pointLights = pointLights;
+                                                                                variant.shadingCache = shadingCache;
+                                                                                variant.ambientOcclusion = ambientOcclusion;
+                                                                                variant.lodDissolve = lodDissolve;
+                                                                                variant.foliageWind = foliageWind;
+                                                                                variant.rayTracedShadows = rayTraced;
+                                                                                keys.insert(shader_variant_key(variant));
+                                                                                ++count;
+                                                                            }
+                                                                        }
+                                                                    }
+                                                                }
+                                                            }
+                                                        }
+                                                    }
+                                                }
+                                            }
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_EQ(keys.size(), (size_t)count);
+}
+
+TEST(ShaderVariantTests, KeysDecodeToTheirVariant) {
+    for (ShaderProgram program : { ShaderProgram::Default, ShaderProgram::InstancedMeshlets,
+                                   ShaderProgram::LandscapeTessellated, ShaderProgram::LandscapeHeightMap,
+                                   ShaderProgram::FoliageImpostor, ShaderProgram::LandscapeClipmap }) {
+        for (uint32_t sampleCount : { 1u, 2u, 4u }) {
+            ShaderVariant variant;
+            variant.program = program;
+            variant.vertexFormat = VertexFormat::Packed;
+            variant.lighting = LightingModel::HalfLambert;
+            variant.heightBands = false;
+            variant.fog = true;
+            variant.deferred = true;
+            variant.sampleCount = sampleCount;
+            variant.farFade = true;
+            variant.multiView = true;
+            variant.virtualTexture = true;
+            variant.bakedMaterials = true;
+            variant.skyFog = true;
+            variant.pointLights = true;
+            variant.shadingCache = true;
+            variant.ambientOcclusion = true;
+            variant.lodDissolve = true;
+            variant.foliageWind = true;
+            variant.rayTracedShadows = true;
+            variant.vertexLighting = true;
+            variant.depthOnly = true;
+            variant.overdraw = true;
+            variant.horizonShadows = true;
+            variant.indexedInstances = true;
+
+            const ShaderVariant decoded = shader_variant_from_key(shader_variant_key(variant));
+            EXPECT_EQ(decoded.program, variant.program);
+            EXPECT_EQ(decoded.vertexFormat, variant.vertexFormat);
+            EXPECT_EQ(decoded.lighting, variant.lighting);
+            EXPECT_EQ(decoded.heightBands, variant.heightBands);
+            EXPECT_EQ(decoded.fog, variant.fog);
+            EXPECT_EQ(decoded.shadows, variant.shadows);
+            EXPECT_EQ(decoded.deferred, variant.deferred);
+            EXPECT_EQ(decoded.sampleCount, variant.sampleCount);
+            EXPECT_EQ(decoded.farFade, variant.farFade);
+            EXPECT_EQ(decoded.multiView, variant.multiView);
+            EXPECT_EQ(decoded.virtualTexture, variant.virtualTexture);
+            EXPECT_EQ(decoded.bakedMaterials, variant.bakedMaterials);
+            EXPECT_EQ(decoded.skyFog, variant.skyFog);
+            EXPECT_EQ(decoded.pointLights, variant.pointLights);
+            EXPECT_EQ(decoded.shadingCache, variant.shadingCache);
+            EXPECT_EQ(decoded.ambientOcclusion, variant.ambientOcclusion);
+            EXPECT_EQ(decoded.lodDissolve, variant.lodDissolve);
+            EXPECT_EQ(decoded.foliageWind, variant.foliageWind);
+            EXPECT_EQ(decoded.rayTracedShadows, variant.rayTracedShadows);
+            EXPECT_EQ(decoded.vertexLighting, variant.vertexLighting);
+            EXPECT_EQ(decoded.depthOnly, variant.depthOnly);
+            EXPECT_EQ(decoded.overdraw, variant.overdraw);
+            EXPECT_EQ(decoded.horizonShadows, variant.horizonShadows);
+            EXPECT_EQ(decoded.indexedInstances, variant.indexedInstances);
+        }
+    }
+    EXPECT_EQ(shader_variant_key(shader_variant_from_key(shader_variant_key(ShaderVariant{}))),
+              shader_variant_key(ShaderVariant{}));
+}
+
+TEST(ShaderVariantTests, VertexLightingHasItsOwnKey) {
+    ShaderVariant variant;
+    variant.program = ShaderProgram::Landscape;
+    variant.shadows = true;
+    variant.rayTracedShadows = true;
+    ShaderVariant vertexLit = variant;
+    vertexLit.vertexLighting = true;
+    EXPECT_NE(shader_variant_key(vertexLit), shader_variant_key(variant));
+    EXPECT_FALSE(shader_variant_from_key(shader_variant_key(variant)).vertexLighting);
+}
+
+TEST(ShaderVariantTests, DepthOnlyAndOverdrawHaveTheirOwnKeys) {
+    ShaderVariant variant;
+    variant.program = ShaderProgram::Landscape;
+    variant.vertexLighting = true;
+    ShaderVariant depthOnly = variant;
+    depthOnly.depthOnly = true;
+    ShaderVariant overdraw = variant;
+    overdraw.overdraw = true;
+    EXPECT_NE(shader_variant_key(depthOnly), shader_variant_key(variant));
+    EXPECT_NE(shader_variant_key(overdraw), shader_variant_key(variant));
+    EXPECT_NE(shader_variant_key(overdraw), shader_variant_key(depthOnly));
+    EXPECT_FALSE(shader_variant_from_key(shader_variant_key(overdraw)).depthOnly);
+}
+
+TEST(ShaderVariantTests, PlaceholderKeepsThePassAndDropsTheShading) {
+    ShaderVariant variant;
+    variant.program = ShaderProgram::LandscapeBindless;
+    variant.vertexFormat = VertexFormat::Packed;
+    variant.lighting = LightingModel::HalfLambert;
+    variant.fog = true;
+    variant.shadows = true;
+    variant.pointLights = true;
+    variant.virtualTexture = true;
+    variant.deferred = true;
+    variant.sampleCount = 4;
+
+    const ShaderVariant placeholder = shader_variant_placeholder(variant);
+    EXPECT_EQ(placeholder.program, ShaderProgram::LandscapeBindless);
+    EXPECT_EQ(placeholder.vertexFormat, VertexFormat::Packed);
+    EXPECT_EQ(placeholder.lighting, LightingModel::Unlit);
+    EXPECT_TRUE(placeholder.deferred);
+    EXPECT_EQ(placeholder.sampleCount, 4u);
+    EXPECT_FALSE(placeholder.fog);
+    EXPECT_FALSE(placeholder.shadows);
+    EXPECT_FALSE(placeholder.pointLights);
+    EXPECT_FALSE(placeholder.virtualTexture);
+
+    // Variants differing only in their shading share one placeholder, which is its own
+    variant.shadows = false;
+    variant.lighting = LightingModel::Lambert;
+    EXPECT_EQ(shader_variant_key(shader_variant_placeholder(variant)), shader_variant_key(placeholder));
+    EXPECT_EQ(shader_variant_key(shader_variant_placeholder(placeholder)), shader_variant_key(placeholder));
+
+    // Instances are bound differently for indexed draws, so their placeholder reads them the same way
+    ShaderVariant indexed;
+    indexed.program = ShaderProgram::Instanced;
+    indexed.indexedInstances = true;
+    EXPECT_TRUE(shader_variant_placeholder(indexed).indexedInstances);
+}
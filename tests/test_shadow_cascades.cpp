@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include "shadow_cascades.hpp"
+
+#include <cmath>
+
+namespace {
+    Camera camera_at(simd::float3 position, float yaw, float pitch) {
+        Camera cam = make_camera(800, 600);
+        cam.position = position;
+        cam.yaw = yaw;
+        cam.pitch = pitch;
+        update_camera_view(cam);
+        return cam;
+    }
+
+    simd::float3 clip_of(const ShadowCascade& cascade, simd::float3 p) {
+        simd::float4 clip = cascade.viewProjection * simd::float4{ p.x, p.y, p.z, 1.0f };
+        return { clip.x, clip.y, clip.z };
+    }
+
+    bool inside(simd::float3 clip) {
+        return std::fabs(clip.x) <= 1.0f && std::fabs(clip.y) <= 1.0f && clip.z >= 0.0f && clip.z <= 1.0f;
+    }
+}
+
+TEST(ShadowCascadeTests, SplitsBlendLogarithmicAndUniform) {
+    float splits[4];
+    shadow_cascade_splits(1.0f, 81.0f, 4, 1.0f, splits);
+    EXPECT_NEAR(splits[0], 3.0f, 1e-4f);
+    EXPECT_NEAR(splits[1], 9.0f, 1e-4f);
+    EXPECT_NEAR(splits[2], 27.0f, 1e-3f);
+    EXPECT_EQ(splits[3], 81.0f);
+
+    shadow_cascade_splits(1.0f, 81.0f, 4, 0.0f, splits);
+    EXPECT_NEAR(splits[0], 21.0f, 1e-4f);
+    EXPECT_NEAR(splits[2], 61.0f, 1e-4f);
+    EXPECT_EQ(splits[3], 81.0f);
+}
+
+TEST(ShadowCascadeTests, CascadeCoversItsSlice) {
+    ShadowSettings settings;
+    Camera cam = camera_at({ 3.0f, 5.0f, -2.0f }, 0.7f, -0.3f);
+    ShadowCascade cascade = fit_shadow_cascade(settings, cam, 4.0f, 20.0f);
+
+    simd::float4x4 toWorld = simd::inverse(cam.viewMatrix);
+    const float tanX = 1.0f / cam.projectionMatrix.columns[0][0];
+    const float tanY = 1.0f / cam.projectionMatrix.columns[1][1];
+    for (float depth : { 4.0f, 20.0f }) {
+        for (int i = 0; i < 4; ++i) {
+            simd::float4 corner = toWorld * simd::float4{ (i & 1 ? 1 : -1) * tanX * depth, (i & 2 ? 1 : -1) * tanY * depth,
+                                                          -depth, 1.0f };
+            EXPECT_TRUE(inside(clip_of(cascade, { corner.x, corner.y, corner.z })));
+        }
+    }
+    // Casters up to casterDistance towards the light of the slice still land in the map
+    simd::float3 above = cam.position + simd::normalize(settings.lightDirection) * (settings.casterDistance * 0.9f);
+    EXPECT_TRUE(inside(clip_of(cascade, above)));
+}
+
+TEST(ShadowCascadeTests, TurningKeepsSizeAndMovingSnapsToTexels) {
+    ShadowSettings settings;
+    ShadowCascade a = fit_shadow_cascade(settings, camera_at({ 0.0f, 5.0f, 0.0f }, 0.0f, 0.0f), 4.0f, 20.0f);
+    ShadowCascade b = fit_shadow_cascade(settings, camera_at({ 0.0f, 5.0f, 0.0f }, 2.0f, -0.6f), 4.0f, 20.0f);
+    EXPECT_FLOAT_EQ(a.radius, b.radius);
+    EXPECT_FLOAT_EQ(a.texelSize, b.texelSize);
+
+    // A world point keeps its sub-texel position when the camera slides a fraction of a texel
+    ShadowCascade c = fit_shadow_cascade(settings, camera_at({ 0.3f * a.texelSize, 5.0f, 0.0f }, 0.0f, 0.0f), 4.0f, 20.0f);
+    const simd::float3 p = { 1.0f, 2.0f, -8.0f };
+    const float texelsPerClip = settings.resolution * 0.5f;
+    simd::float3 pa = clip_of(a, p) * texelsPerClip;
+    simd::float3 pc = clip_of(c, p) * texelsPerClip;
+    EXPECT_NEAR(pa.x - std::round(pa.x - pc.x), pc.x, 2e-2f);
+    EXPECT_NEAR(pa.y - std::round(pa.y - pc.y), pc.y, 2e-2f);
+}
+
+TEST(ShadowCascadeTests, UpdateRespectsBudgetAndCoverage) {
+    ShadowCascades cascades;
+    cascades.settings.maxUpdatesPerFrame = 2;
+    Camera cam = camera_at({ 0.0f, 5.0f, 0.0f }, 0.0f, 0.0f);
+
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0b0011u);
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0b1100u);
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0u);
+
+    // Small moves stay inside the guard band; far ones redraw the near cascade first
+    cam.position.x += 0.01f;
+    update_camera_view(cam);
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0u);
+    cam.position.x += 20.0f;
+    update_camera_view(cam);
+    uint32_t mask = shadow_cascades_update(cascades, cam);
+    EXPECT_TRUE(mask & 1u);
+    EXPECT_EQ(__builtin_popcount(mask), 2);
+}
+
+TEST(ShadowCascadeTests, InfiniteFarPlaneStopsAtMaxDistance) {
+    ShadowCascades cascades;
+    cascades.settings.maxUpdatesPerFrame = MAX_SHADOW_CASCADES;
+    Camera cam = make_camera(800, 600, true);
+    cam.position = { 0.0f, 5.0f, 0.0f };
+    update_camera_view(cam);
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0b1111u);
+
+    const uint32_t last = cascades.settings.cascadeCount - 1;
+    EXPECT_EQ(cascades.cascades[last].splitFar, cascades.settings.maxDistance);
+    EXPECT_TRUE(std::isfinite(cascades.cascades[0].radius));
+    EXPECT_LT(cascades.cascades[0].splitFar, cascades.settings.maxDistance);
+}
+
+TEST(ShadowCascadeTests, InvalidateHitsOverlappingCascades) {
+    ShadowCascades cascades;
+    cascades.settings.maxUpdatesPerFrame = MAX_SHADOW_CASCADES;
+    Camera cam = camera_at({ 0.0f, 5.0f, 0.0f }, 0.0f, 0.0f);
+    shadow_cascades_update(cascades, cam);
+
+    // Far behind the camera and away from the light: no cascade sees it
+    shadow_cascades_invalidate(cascades, { { 500.0f, -50.0f, 500.0f }, { 501.0f, -49.0f, 501.0f } });
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0u);
+
+    // Just ahead of the camera: every cascade reaches back to the camera
+    shadow_cascades_invalidate(cascades, { { -0.5f, 4.0f, -2.5f }, { 0.5f, 5.0f, -1.5f } });
+    EXPECT_TRUE(shadow_cascades_update(cascades, cam) & 1u);
+
+    shadow_cascades_invalidate_all(cascades);
+    EXPECT_EQ(shadow_cascades_update(cascades, cam), 0b1111u);
+}
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include <simd/simd.h>
+
+// The core builds against Apple's simd library on macOS and src/portable/simd/simd.h elsewhere;
+// these hold for both, so structs written to tiles and saves read back on either
+
+TEST(SimdTests, LayoutsMatchAppleSimd) {
+    EXPECT_EQ(sizeof(simd::float2), 8u);
+    EXPECT_EQ(sizeof(simd::float3), 16u);
+    EXPECT_EQ(alignof(simd::float3), 16u);
+    EXPECT_EQ(sizeof(simd::float4), 16u);
+    EXPECT_EQ(sizeof(simd::float4x4), 64u);
+    EXPECT_EQ(sizeof(simd::int4), 16u);
+    EXPECT_EQ(sizeof(simd::float8), 32u);
+    EXPECT_EQ(sizeof(simd::uint8), 32u);
+}
+
+TEST(SimdTests, VectorArithmeticIsElementWise) {
+    const simd::float3 a = { 1.0f, 2.0f, 3.0f };
+    const simd::float3 b = { 4.0f, -5.0f, 6.0f };
+    const simd::float3 sum = a + b * 2.0f;
+    EXPECT_FLOAT_EQ(sum.x, 9.0f);
+    EXPECT_FLOAT_EQ(sum.y, -8.0f);
+    EXPECT_FLOAT_EQ(sum.z, 15.0f);
+    const simd::float3 ratio = b / a;
+    EXPECT_FLOAT_EQ(ratio.y, -2.5f);
+    EXPECT_FLOAT_EQ(simd::dot(a, b), 12.0f);
+    const simd::float3 c = simd::cross(a, b);
+    EXPECT_FLOAT_EQ(simd::dot(c, a), 0.0f);
+    EXPECT_FLOAT_EQ(simd::dot(c, b), 0.0f);
+    EXPECT_FLOAT_EQ(simd::length(simd::normalize(b)), 1.0f);
+    const simd::float3 clamped = simd::clamp(b, simd::float3{ 0, 0, 0 }, simd::float3{ 5, 5, 5 });
+    EXPECT_FLOAT_EQ(clamped.x, 4.0f);
+    EXPECT_FLOAT_EQ(clamped.y, 0.0f);
+    EXPECT_FLOAT_EQ(clamped.z, 5.0f);
+}
+
+TEST(SimdTests, InverseUndoesATransform) {
+    // Rotation about Y, a scale and a translation
+    const float c = 0.6f, s = 0.8f;
+    const simd::float4x4 m(simd::float4{ 2 * c, 0, -2 * s, 0 }, simd::float4{ 0, 3, 0, 0 },
+                           simd::float4{ 2 * s, 0, 2 * c, 0 }, simd::float4{ 5, -1, 7, 1 });
+    const simd::float4x4 identity = simd::inverse(m) * m;
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            EXPECT_NEAR(identity.columns[col][row], col == row ? 1.0f : 0.0f, 1e-5f) << col << ", " << row;
+        }
+    }
+    const simd::float4x4 t = simd::transpose(m);
+    EXPECT_FLOAT_EQ(t.columns[3][0], m.columns[0][3]);
+    EXPECT_FLOAT_EQ(t.columns[0][3], 5.0f);
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include "simulation.hpp"
+#include "triple_buffer.hpp"
+
+#include <chrono>
+#include <thread>
+
+TEST(TripleBufferTests, ReaderSeesOnlyTheLatestValue) {
+    TripleBuffer<int> buffer(-1);
+    EXPECT_FALSE(buffer.update());
+    EXPECT_EQ(buffer.read(), -1);
+
+    buffer.write(1);
+    buffer.write(2);
+    EXPECT_TRUE(buffer.update());
+    EXPECT_EQ(buffer.read(), 2);
+    EXPECT_FALSE(buffer.update());
+    EXPECT_EQ(buffer.read(), 2);
+
+    buffer.back() = 3;
+    buffer.publish();
+    EXPECT_TRUE(buffer.update());
+    EXPECT_EQ(buffer.read(), 3);
+}
+
+TEST(TripleBufferTests, ValuesNeverTearAcrossThreads) {
+    struct Pair { uint64_t a = 0; uint64_t b = 0; };
+    TripleBuffer<Pair> buffer;
+    constexpr uint64_t WRITES = 200000;
+
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= WRITES; ++i) {
+            buffer.write({ i, ~i });
+        }
+    });
+
+    uint64_t last = 0;
+    while (last < WRITES) {
+        if (buffer.update()) {
+            const Pair& value = buffer.read();
+            ASSERT_EQ(value.b, ~value.a);
+            ASSERT_GT(value.a, last);
+            last = value.a;
+        }
+    }
+    writer.join();
+}
+
+TEST(SimulationTests, FixedStepCarriesPartialSteps) {
+    SimulationSettings settings;
+    settings.step = 0.01;
+    FixedStepClock clock;
+    EXPECT_EQ(fixed_step_advance(clock, settings, 5.0), 0u);
+    EXPECT_EQ(fixed_step_advance(clock, settings, 5.025), 2u);
+    EXPECT_NEAR(clock.accumulator, 0.005, 1e-9);
+    EXPECT_EQ(fixed_step_advance(clock, settings, 5.03), 1u);
+    EXPECT_NEAR(clock.accumulator, 0.0, 1e-9);
+}
+
+TEST(SimulationTests, FixedStepDropsTimeAfterAStall) {
+    SimulationSettings settings;
+    settings.step = 0.01;
+    settings.maxCatchUpSteps = 4;
+    FixedStepClock clock;
+    fixed_step_advance(clock, settings, 0.0);
+    EXPECT_EQ(fixed_step_advance(clock, settings, 1.005), 4u);
+    EXPECT_LT(clock.accumulator, settings.step);
+    EXPECT_EQ(fixed_step_advance(clock, settings, 1.006), 0u);
+}
+
+TEST(SimulationTests, SamplesOneStepBehind) {
+    SimulationSettings settings;
+    settings.step = 0.01;
+    SimulationSnapshot snapshot;
+    snapshot.time = 2.0;
+    snapshot.previous.position = { 0.0f, 0.0f, 0.0f };
+    snapshot.current.position = { 1.0f, 0.0f, 0.0f };
+    snapshot.current.yaw = 1.0f;
+
+    EXPECT_FLOAT_EQ(sample_snapshot(snapshot, settings, 2.0).position.x, 0.0f);
+    CameraPose half = sample_snapshot(snapshot, settings, 2.005);
+    EXPECT_NEAR(half.position.x, 0.5f, 1e-4);
+    EXPECT_NEAR(half.yaw, 0.5f, 1e-4);
+    // A late snapshot holds at the newest pose rather than extrapolating
+    EXPECT_FLOAT_EQ(sample_snapshot(snapshot, settings, 3.0).position.x, 1.0f);
+}
+
+TEST(SimulationTests, ThreadPublishesEveryStep) {
+    SimulationSettings settings;
+    settings.step = 0.001;
+    Camera cam = make_camera(640, 480);
+    cam.position = { 0.0f, 0.0f, 0.0f };
+
+    InputQueue input;
+    Simulation simulation(cam, input, [](Camera& c, const InputState&, float dt) { c.position.x += dt; }, settings);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (simulation.latest().tick < 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const SimulationSnapshot& snapshot = simulation.latest();
+    ASSERT_GE(snapshot.tick, 10u);
+    // The pose only depends on the number of steps, not on how they were scheduled
+    EXPECT_NEAR(snapshot.current.position.x, snapshot.tick * 0.001f, 1e-4);
+    EXPECT_NEAR(snapshot.current.position.x - snapshot.previous.position.x, 0.001f, 1e-6);
+}
+
+TEST(SimulationTests, RecordsEachEventWithItsStep) {
+    SimulationSettings settings;
+    settings.step = 0.001;
+    Camera cam = make_camera(640, 480);
+    InputQueue input;
+    std::vector<RecordedInput> recording;
+    Simulation simulation(cam, input, [](Camera&, const InputState&, float) {}, settings, &recording);
+
+    InputEvent event;
+    event.type = InputEventType::KeyDown;
+    for (int key = 1; key <= 3; ++key) {
+        event.key = key;
+        event.time = simulation_clock();
+        input.push(event);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // A snapshot ending after the last event comes from steps that applied it
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (simulation.latest().time < event.time && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    simulation.stop();
+
+    ASSERT_EQ(recording.size(), 3u);
+    for (size_t i = 0; i < recording.size(); ++i) {
+        EXPECT_EQ(recording[i].event.key, (int)i + 1);
+        EXPECT_LE(recording[i].tick, simulation.latest().tick);
+    }
+    // Five milliseconds apart at one step per millisecond
+    EXPECT_GT(recording[1].tick, recording[0].tick);
+    EXPECT_GT(recording[2].tick, recording[1].tick);
+}
+
+TEST(SimulationTests, ReplayFollowsTheRecordedStepsWhateverTheFrames) {
+    InputRecording recording;
+    recording.step = 0.01;
+    InputEvent event;
+    event.type = InputEventType::KeyDown;
+    event.key = 1;
+    recording.inputs.push_back({ 3, event });
+    event.type = InputEventType::KeyUp;
+    recording.inputs.push_back({ 7, event });
+    // Moves while key 1 is held, so the path depends on which steps saw the events
+    const Simulation::StepFunction step = [](Camera& c, const InputState& input, float dt) {
+        c.position.x += input.keys[1] ? dt : 0.0f;
+        c.yaw += dt;
+    };
+    Camera cam = make_camera(640, 480);
+    cam.position = { 0.0f, 0.0f, 0.0f };
+
+    // One frame per step, and then the same session drawn at a third of the rate
+    SimulationReplay fine = create_simulation_replay(cam);
+    CameraPose pose;
+    for (uint64_t tick = 0; tick <= 12; ++tick) {
+        recording.frames.push_back({ 0.01f, tick, 1.0f });
+        pose = simulation_replay_frame(fine, recording, recording.frames.back(), step);
+    }
+    EXPECT_NEAR(pose.position.x, 0.04f, 1e-6);
+    EXPECT_NEAR(pose.yaw, 0.12f, 1e-6);
+
+    SimulationReplay coarse = create_simulation_replay(cam);
+    for (uint64_t tick : { 0u, 5u, 9u }) {
+        simulation_replay_frame(coarse, recording, { 0.03f, tick, 1.0f }, step);
+    }
+    const CameraPose halfway = simulation_replay_frame(coarse, recording, { 0.03f, 12, 0.5f }, step);
+    EXPECT_EQ(coarse.tick, 12u);
+    EXPECT_NEAR(halfway.position.x, 0.04f, 1e-6);
+    EXPECT_NEAR(halfway.yaw, 0.115f, 1e-6);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "slot_allocator.hpp"
+
+#include <vector>
+
+TEST(SlotAllocatorTests, HandsOutTheLowestFreeSlot) {
+    SlotAllocator slots(4);
+    for (uint32_t i = 0; i < 10; ++i) {
+        EXPECT_EQ(slots.allocate(), i);
+    }
+    EXPECT_EQ(slots.page_count(), 3u);
+    EXPECT_EQ(slots.used(), 10u);
+    EXPECT_EQ(slots.page_use(2), 2u);
+
+    // Holes are refilled before anything past them
+    slots.release(6);
+    slots.release(1);
+    EXPECT_EQ(slots.allocate(), 1u);
+    EXPECT_EQ(slots.allocate(), 6u);
+    EXPECT_EQ(slots.allocate(), 10u);
+}
+
+TEST(SlotAllocatorTests, RetiredSlotsWaitForTheirFrame) {
+    SlotAllocator slots(2);
+    const uint32_t a = slots.allocate();
+    const uint32_t b = slots.allocate();
+    slots.retire(a, 5);
+    slots.retire(b, 7);
+    EXPECT_EQ(slots.retired(), 2u);
+
+    // Still used by frames in flight: a new slot comes from a new page
+    EXPECT_EQ(slots.reclaim(4), 0u);
+    EXPECT_EQ(slots.allocate(), 2u);
+
+    EXPECT_EQ(slots.reclaim(6), 1u);
+    EXPECT_EQ(slots.allocate(), a);
+    EXPECT_EQ(slots.reclaim(7), 1u);
+    EXPECT_EQ(slots.retired(), 0u);
+    EXPECT_EQ(slots.used(), 2u);
+}
+
+TEST(SlotAllocatorTests, TrimDropsEmptyPagesFromTheEnd) {
+    SlotAllocator slots(2);
+    std::vector<uint32_t> live;
+    for (int i = 0; i < 8; ++i) {
+        live.push_back(slots.allocate());
+    }
+    // Pages 1 and 3 empty; only the last one can go
+    for (uint32_t slot : { 2u, 3u, 6u, 7u }) {
+        slots.release(slot);
+    }
+    EXPECT_EQ(slots.trim(), 1u);
+    EXPECT_EQ(slots.page_count(), 3u);
+
+    // Lowest-first allocation fills page 1 again rather than the end
+    EXPECT_EQ(slots.allocate(), 2u);
+    slots.release(2);
+    slots.release(4);
+    slots.release(5);
+    EXPECT_EQ(slots.trim(1), 1u);
+    EXPECT_EQ(slots.page_count(), 2u);
+    EXPECT_EQ(slots.allocate(), 2u);
+    EXPECT_EQ(slots.allocate(), 3u);
+    EXPECT_EQ(slots.allocate(), 4u);
+    EXPECT_EQ(slots.page_count(), 3u);
+}
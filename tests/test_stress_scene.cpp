@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include "stress_scene.hpp"
+
+#include <cmath>
+
+TEST(StressSceneTests, PlacesExactlyTheCountOverTheWholeSquare) {
+    StressSceneSettings settings;
+    settings.objects = 5000;
+    settings.worldSize = 256.0f;
+    const std::vector<FoliageInstance> objects = scatter_stress_objects(settings, 32.0f, 33);
+    ASSERT_EQ(objects.size(), 5000u);
+
+    // Every quadrant of the square gets its share
+    uint32_t quadrants[4] = {};
+    for (const FoliageInstance& object : objects) {
+        EXPECT_LE(fabsf(object.position.x), 128.0f);
+        EXPECT_LE(fabsf(object.position.z), 128.0f);
+        quadrants[(object.position.x >= 0.0f ? 1 : 0) + (object.position.z >= 0.0f ? 2 : 0)]++;
+    }
+    for (uint32_t quadrant : quadrants) {
+        EXPECT_GT(quadrant, 5000u / 8);
+    }
+}
+
+TEST(StressSceneTests, PlacementIsRepeatable) {
+    StressSceneSettings settings;
+    settings.objects = 700;
+    settings.worldSize = 128.0f;
+    const std::vector<FoliageInstance> a = scatter_stress_objects(settings, 32.0f, 33);
+    const std::vector<FoliageInstance> b = scatter_stress_objects(settings, 32.0f, 33);
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(a[i].position.x, b[i].position.x);
+        EXPECT_EQ(a[i].position.z, b[i].position.z);
+    }
+    settings.objects = 0;
+    EXPECT_TRUE(scatter_stress_objects(settings, 32.0f, 33).empty());
+}
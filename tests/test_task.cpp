@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "task.hpp"
+
+#include <thread>
+
+namespace {
+    template <typename T>
+    void drive(TaskScheduler& scheduler, Task<T>& task) {
+        while (!task.done()) {
+            scheduler.poll();
+            std::this_thread::yield();
+        }
+    }
+
+    Task<int> sum_in_jobs(TaskScheduler& scheduler, int count) {
+        co_await scheduler.on(JobPriority::Frame);
+        std::atomic<int> sum{ 0 };
+        JobCounter counter;
+        for (int i = 1; i <= count; ++i) {
+            scheduler.jobs().run([&sum, i] { sum += i; }, &counter);
+        }
+        co_await scheduler.until([&counter] { return counter.done(); }, JobPriority::Frame);
+        co_return sum.load();
+    }
+
+    Task<> load_flow(TaskScheduler& scheduler, std::thread::id caller, std::vector<int>& stages) {
+        stages.push_back(std::this_thread::get_id() == caller ? 1 : -1);
+        co_await scheduler.on(JobPriority::Background);
+        stages.push_back(std::this_thread::get_id() != caller ? 2 : -2);
+        const int sum = co_await sum_in_jobs(scheduler, 100);
+        stages.push_back(sum);
+    }
+
+    Task<> cancellable_flow(TaskScheduler& scheduler, CancelToken cancel, int& stages) {
+        co_await scheduler.on(JobPriority::Background);
+        stages++;
+        if (!co_await scheduler.until([] { return false; }, JobPriority::Background, cancel)) {
+            co_return;
+        }
+        stages++;
+    }
+
+    Task<int> ready_at_once(TaskScheduler& scheduler) {
+        const bool held = co_await scheduler.until([] { return true; });
+        co_return held ? 7 : 0;
+    }
+}
+
+TEST(TaskTests, FlowRunsItsStagesInOrderAcrossThreads) {
+    JobSystem jobs({ 2, 1 });
+    TaskScheduler scheduler(jobs);
+    std::vector<int> stages;
+    Task<> flow = load_flow(scheduler, std::this_thread::get_id(), stages);
+    EXPECT_TRUE(stages.empty());
+
+    flow.start();
+    drive(scheduler, flow);
+    EXPECT_EQ(stages, (std::vector<int>{ 1, 2, 5050 }));
+    EXPECT_EQ(scheduler.parked(), 0u);
+}
+
+TEST(TaskTests, CancellingEndsTheWaitEarly) {
+    JobSystem jobs({ 2, 1 });
+    TaskScheduler scheduler(jobs);
+    CancelToken cancel;
+    int stages = 0;
+    Task<> flow = cancellable_flow(scheduler, cancel, stages);
+    flow.start();
+    while (scheduler.parked() == 0) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(scheduler.poll(), 1u);
+    EXPECT_FALSE(flow.done());
+
+    cancel.cancel();
+    drive(scheduler, flow);
+    EXPECT_EQ(stages, 1);
+}
+
+TEST(TaskTests, ConditionThatAlreadyHoldsContinuesInline) {
+    JobSystem jobs({ 1, 1 });
+    TaskScheduler scheduler(jobs);
+    Task<int> task = ready_at_once(scheduler);
+    task.start();
+    ASSERT_TRUE(task.done());
+    EXPECT_EQ(task.result(), 7);
+}
+
+TEST(TaskTests, ManyFlowsShareTheScheduler) {
+    JobSystem jobs({ 3, 2 });
+    TaskScheduler scheduler(jobs);
+    std::vector<Task<int>> tasks;
+    for (int i = 1; i <= 64; ++i) {
+        tasks.push_back(sum_in_jobs(scheduler, i));
+    }
+    for (Task<int>& task : tasks) {
+        task.start();
+    }
+    for (Task<int>& task : tasks) {
+        drive(scheduler, task);
+    }
+    for (int i = 1; i <= 64; ++i) {
+        EXPECT_EQ(tasks[i - 1].result(), i * (i + 1) / 2);
+    }
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "temporal_aa.hpp"
+
+#include "render_scale.hpp"
+
+#include <cmath>
+
+namespace {
+    void expect_near(simd::float3 a, simd::float3 b, float tolerance = 1e-5f) {
+        EXPECT_NEAR(a.x, b.x, tolerance);
+        EXPECT_NEAR(a.y, b.y, tolerance);
+        EXPECT_NEAR(a.z, b.z, tolerance);
+    }
+}
+
+TEST(TemporalAATests, YCoCgRoundTrips) {
+    for (simd::float3 rgb : { simd::float3{ 0, 0, 0 }, simd::float3{ 1, 1, 1 }, simd::float3{ 0.8f, 0.3f, 0.1f },
+                              simd::float3{ 0.05f, 0.9f, 0.6f } }) {
+        expect_near(ycocg_to_rgb(rgb_to_ycocg(rgb)), rgb);
+    }
+    // Greys have no chroma
+    const simd::float3 grey = rgb_to_ycocg(simd::float3{ 0.4f, 0.4f, 0.4f });
+    EXPECT_NEAR(grey.x, 0.4f, 1e-6f);
+    EXPECT_NEAR(grey.y, 0.0f, 1e-6f);
+    EXPECT_NEAR(grey.z, 0.0f, 1e-6f);
+}
+
+TEST(TemporalAATests, HistoryIsClippedOntoTheBoxTowardsItsCentre) {
+    const simd::float3 boxMin = { 0.0f, -0.1f, -0.1f };
+    const simd::float3 boxMax = { 0.5f, 0.1f, 0.1f };
+
+    const simd::float3 inside = { 0.3f, 0.05f, -0.02f };
+    expect_near(taa_clip_history(inside, boxMin, boxMax), inside);
+
+    // Twice as far from the centre as the box reaches along x, so halfway back
+    const simd::float3 outside = { 0.75f, 0.02f, 0.0f };
+    const simd::float3 clipped = taa_clip_history(outside, boxMin, boxMax);
+    EXPECT_NEAR(clipped.x, 0.5f, 1e-3f);
+    EXPECT_NEAR(clipped.y, 0.01f, 1e-3f);
+    EXPECT_NEAR(clipped.z, 0.0f, 1e-3f);
+}
+
+TEST(TemporalAATests, MotionLeansOnTheCurrentFrameUpToALimit) {
+    const TemporalAASettings settings;
+    EXPECT_FLOAT_EQ(taa_current_weight(settings, 0.0f), settings.currentWeight);
+    EXPECT_GT(taa_current_weight(settings, 4.0f), taa_current_weight(settings, 1.0f));
+    EXPECT_FLOAT_EQ(taa_current_weight(settings, 1000.0f), settings.maxCurrentWeight);
+}
+
+TEST(TemporalAATests, StillJitteredFramesConvergeToTheCoverage) {
+    // A vertical edge crossing the pixel at 0.3 of its width: white left of it, black right of it
+    const TemporalAASettings settings;
+    const float edge = 0.3f;
+    simd::float3 history = {};
+    float error = 0.0f;
+    for (uint32_t frame = 0; frame < 256; ++frame) {
+        const float jitter = halton(frame % 8 + 1, 2) - 0.5f;
+        simd::float3 neighbourhood[9];
+        for (int row = 0; row < 3; ++row) {
+            neighbourhood[row * 3 + 0] = simd::float3(1.0f);
+            neighbourhood[row * 3 + 1] = simd::float3(0.5f + jitter < edge ? 1.0f : 0.0f);
+            neighbourhood[row * 3 + 2] = simd::float3(0.0f);
+        }
+        history = frame == 0 ? neighbourhood[4] : taa_resolve(neighbourhood, history, 0.0f, settings);
+        if (frame >= 192) {
+            error = std::max(error, std::abs(history.x - 0.375f));
+        }
+    }
+    // Three of the eight jitter phases land left of the edge; the exponential average wobbles around that
+    EXPECT_LT(error, 0.1f);
+}
+
+TEST(TemporalAATests, StaleHistoryDoesNotGhost) {
+    // The neighbourhood turned dark; a bright history is pulled down to its brightest sample
+    const TemporalAASettings settings;
+    simd::float3 neighbourhood[9];
+    for (int i = 0; i < 9; ++i) {
+        neighbourhood[i] = simd::float3(0.1f + 0.01f * i);
+    }
+    const simd::float3 resolved = taa_resolve(neighbourhood, simd::float3(1.0f), 0.0f, settings);
+    EXPECT_LE(resolved.x, 0.18f + 1e-3f);
+    EXPECT_GE(resolved.x, neighbourhood[4].x - 1e-3f);
+
+    // History matching the frame is kept as it is
+    expect_near(taa_resolve(neighbourhood, neighbourhood[4], 0.0f, settings), neighbourhood[4]);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "terrain_bake.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "terrain_height_map.hpp"
+
+namespace {
+    std::string test_directory(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "terrain_bake_tests" / name;
+        std::filesystem::remove_all(dir);
+        return dir.string();
+    }
+
+    // Bakes a chunk, reads its tile back and compares it with the payload built in memory
+    void expect_tile_round_trips(const TerrainBakeSettings& settings, const char* name) {
+        const std::string directory = test_directory(name);
+        const ChunkKey key = { -3, 5 };
+        std::vector<Vertex> vertices;
+        std::vector<uint8_t> payload;
+        ASSERT_TRUE(bake_terrain_tile(directory, key, settings, vertices, payload));
+        ASSERT_EQ(payload.size(), terrain_bake_payload_bytes(settings));
+
+        std::vector<uint8_t> expected;
+        const ChunkLodInfo lod = encode_terrain_bake_payload(key, vertices.data(), settings, expected);
+        EXPECT_EQ(payload, expected);
+
+        const uint64_t generatorKey = terrain_tile_generator_key(terrain_bake_tile_params(settings));
+        std::vector<uint8_t> read(payload.size());
+        TerrainTileFooter footer;
+        ASSERT_TRUE(read_terrain_tile(terrain_tile_path(directory, key), generatorKey, key, read.size(), read.data(),
+                                      footer));
+        EXPECT_EQ(read, payload);
+        EXPECT_EQ(footer.lod.minHeight, lod.minHeight);
+        EXPECT_EQ(footer.lod.maxHeight, lod.maxHeight);
+        EXPECT_EQ(footer.codec, (uint32_t)terrain_bake_footer(settings, generatorKey, key, lod).codec);
+    }
+}
+
+TEST(TerrainBakeTests, TileParamsFollowTheSettings) {
+    TerrainBakeSettings settings;
+    const TerrainTileParams params = terrain_bake_tile_params(settings);
+    EXPECT_EQ(params.chunkSize, settings.chunkSize);
+    EXPECT_EQ(params.resolution, settings.resolution);
+    EXPECT_EQ(params.vertexFormat, settings.vertexFormat);
+    EXPECT_EQ(params.erosion.iterations, 0u);
+    const uint64_t base = terrain_tile_generator_key(params);
+
+    settings.compressed = true;
+    EXPECT_NE(terrain_tile_generator_key(terrain_bake_tile_params(settings)), base);
+    settings = {};
+    settings.terrain.noise.seed = 9;
+    EXPECT_NE(terrain_tile_generator_key(terrain_bake_tile_params(settings)), base);
+}
+
+TEST(TerrainBakeTests, PayloadSizesMatchTheLayouts) {
+    TerrainBakeSettings settings;
+    EXPECT_EQ(terrain_bake_payload_bytes(settings), 33u * 33 * sizeof(PackedVertex));
+    settings.vertexFormat = VertexFormat::Float;
+    EXPECT_EQ(terrain_bake_payload_bytes(settings), 33u * 33 * sizeof(Vertex));
+    settings.heightMaps = true;
+    EXPECT_EQ(terrain_bake_payload_bytes(settings), 33u * 33 * TERRAIN_HEIGHT_MAP_TEXEL_BYTES);
+}
+
+TEST(TerrainBakeTests, FloatPayloadsAreTheGeneratedVertices) {
+    TerrainBakeSettings settings;
+    settings.vertexFormat = VertexFormat::Float;
+    std::vector<Vertex> vertices(terrain_chunk_mesh_size(settings.resolution).vertexCount);
+    build_terrain_chunk_vertices(2, 1, settings.resolution, settings.chunkSize, vertices.data(), settings.terrain);
+    std::vector<uint8_t> payload;
+    const ChunkLodInfo lod = encode_terrain_bake_payload({ 2, 1 }, vertices.data(), settings, payload);
+    ASSERT_EQ(payload.size(), vertices.size() * sizeof(Vertex));
+    EXPECT_EQ(memcmp(payload.data(), vertices.data(), payload.size()), 0);
+    EXPECT_LE(lod.minHeight, lod.maxHeight);
+}
+
+TEST(TerrainBakeTests, PayloadsEncodeIntoCallerMemory) {
+    TerrainBakeSettings settings;
+    std::vector<Vertex> vertices(terrain_chunk_mesh_size(settings.resolution).vertexCount);
+    build_terrain_chunk_vertices(-1, 3, settings.resolution, settings.chunkSize, vertices.data(), settings.terrain);
+    std::vector<uint8_t> expected;
+    const ChunkLodInfo expectedLod = encode_terrain_bake_payload({ -1, 3 }, vertices.data(), settings, expected);
+    std::vector<uint8_t> packed(terrain_bake_payload_bytes(settings));
+    encode_terrain_bake_payload({ -1, 3 }, vertices.data(), settings, (void*)packed.data());
+    EXPECT_EQ(packed, expected);
+
+    // Float vertices built where the payload goes are only measured
+    settings.vertexFormat = VertexFormat::Float;
+    const std::vector<Vertex> original = vertices;
+    const ChunkLodInfo lod = encode_terrain_bake_payload({ -1, 3 }, vertices.data(), settings, (void*)vertices.data());
+    EXPECT_EQ(memcmp(vertices.data(), original.data(), vertices.size() * sizeof(Vertex)), 0);
+    EXPECT_EQ(lod.minHeight, expectedLod.minHeight);
+    EXPECT_EQ(lod.maxHeight, expectedLod.maxHeight);
+}
+
+TEST(TerrainBakeTests, BakedTilesReadBackInEveryLayout) {
+    TerrainBakeSettings settings;
+    expect_tile_round_trips(settings, "packed");
+    settings.compressed = true;
+    expect_tile_round_trips(settings, "packed_compressed");
+    settings.heightMaps = true;
+    expect_tile_round_trips(settings, "height_maps_compressed");
+    settings.compressed = false;
+    expect_tile_round_trips(settings, "height_maps");
+}
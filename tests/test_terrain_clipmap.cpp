@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "terrain_clipmap.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Stands in for the height of a lattice point; distinct for every point of a window
+    int32_t point_value(int32_t x, int32_t z) {
+        return x * 4096 + z;
+    }
+
+    // One level's toroidal slice, refreshed the way gpu_terrain_clipmap_encode refreshes it
+    struct Slice {
+        uint32_t size;
+        std::vector<int32_t> texels;
+        simd::int2 origin = { 0, 0 };
+        bool valid = false;
+        uint32_t refreshed = 0;
+
+        explicit Slice(uint32_t size) : size(size), texels(size * size, -1) {}
+
+        void move_to(simd::int2 current) {
+            TerrainClipmapRegion regions[2];
+            const uint32_t count = terrain_clipmap_dirty_regions(origin, current, valid, size, regions);
+            for (uint32_t r = 0; r < count; ++r) {
+                for (uint32_t j = 0; j < regions[r].size.y; ++j) {
+                    for (uint32_t i = 0; i < regions[r].size.x; ++i) {
+                        const int32_t x = regions[r].origin.x + (int32_t)i;
+                        const int32_t z = regions[r].origin.y + (int32_t)j;
+                        texels[terrain_clipmap_texel(z, size) * size + terrain_clipmap_texel(x, size)] =
+                            point_value(x, z);
+                        refreshed++;
+                    }
+                }
+            }
+            origin = current;
+            valid = true;
+        }
+
+        bool holds_window() const {
+            for (int32_t z = origin.y; z < origin.y + (int32_t)size; ++z) {
+                for (int32_t x = origin.x; x < origin.x + (int32_t)size; ++x) {
+                    if (texels[terrain_clipmap_texel(z, size) * size + terrain_clipmap_texel(x, size)] !=
+                        point_value(x, z)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    };
+}
+
+TEST(TerrainClipmapTests, TexelsWrapAroundTheSlice) {
+    EXPECT_EQ(terrain_clipmap_texel(0, 36), 0u);
+    EXPECT_EQ(terrain_clipmap_texel(37, 36), 1u);
+    EXPECT_EQ(terrain_clipmap_texel(-1, 36), 35u);
+    EXPECT_EQ(terrain_clipmap_texel(-72, 36), 0u);
+    EXPECT_EQ(terrain_clipmap_texture_size(32), 36u);
+
+    ClipmapLevel level;
+    clipmap_place(2.0f, 1, { 41.0f, -7.0f }, 2.0f, &level);
+    // The window is centred on the level, in its cells
+    const simd::int2 origin = terrain_clipmap_origin(level, 36);
+    EXPECT_EQ(origin.x, 20 - 18);
+    EXPECT_EQ(origin.y, -4 - 18);
+}
+
+TEST(TerrainClipmapTests, MovesRefreshOnlyTheStripsThatEnter) {
+    const uint32_t size = 36;
+    Slice slice(size);
+    slice.move_to({ 10, -3 });
+    EXPECT_EQ(slice.refreshed, size * size);
+    EXPECT_TRUE(slice.holds_window());
+
+    // Every direction, diagonals, no move at all and a jump past the whole window
+    const simd::int2 moves[] = { { 2, 0 }, { 0, -4 }, { -2, 2 }, { 6, 4 }, { 0, 0 }, { -4, -6 }, { 100, 0 } };
+    for (const simd::int2 move : moves) {
+        slice.refreshed = 0;
+        slice.move_to(slice.origin + move);
+        EXPECT_TRUE(slice.holds_window());
+        const uint32_t dx = (uint32_t)std::abs(move.x);
+        const uint32_t dz = (uint32_t)std::abs(move.y);
+        const uint32_t expected = dx >= size ? size * size : size * size - (size - dx) * (size - dz);
+        EXPECT_EQ(slice.refreshed, expected);
+    }
+}
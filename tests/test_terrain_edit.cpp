@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+#include "terrain_edit.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    std::vector<float> flat_heights(const TerrainGridRect& rect, float height) {
+        return std::vector<float>((size_t)rect.width() * rect.depth(), height);
+    }
+}
+
+TEST(TerrainEditTests, BrushTouchesOnlyPointsInsideItsRadius) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainBrush brush;
+    brush.centerX = 10.0f;
+    brush.centerZ = -4.0f;
+    brush.radius = 3.0f;
+    brush.strength = 2.0f;
+
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    const TerrainEditResult result = edits.apply(brush, flat_heights(rect, 5.0f).data());
+    EXPECT_FLOAT_EQ(result.maxChange, 2.0f);
+    EXPECT_EQ(result.changed.x0, 8);
+    EXPECT_EQ(result.changed.x1, 12);
+    EXPECT_EQ(result.changed.z0, -6);
+    EXPECT_EQ(result.changed.z1, -2);
+
+    EXPECT_FLOAT_EQ(edits.offset(10, -4), 2.0f);
+    EXPECT_EQ(edits.offset(13, -4), 0.0f);
+    EXPECT_GT(edits.offset(11, -3), edits.offset(12, -2));
+    EXPECT_GT(edits.offset(12, -2), 0.0f);
+    EXPECT_TRUE(edits.touches({ 10, -4, 10, -4 }));
+    EXPECT_FALSE(edits.touches({ 20, 20, 40, 40 }));
+}
+
+TEST(TerrainEditTests, RepeatedStrokesAccumulateAndClamp) {
+    TerrainEdits edits(0.5f, 3.0f);
+    TerrainBrush brush;
+    brush.radius = 2.0f;
+    brush.strength = 1.0f;
+
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    const std::vector<float> base = flat_heights(rect, 1.0f);
+    edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(edits.offset(0, 0), 1.0f);
+    edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(edits.offset(0, 0), 2.0f);
+
+    // 1 + 2 + 1 exceeds the limit of 3, so the centre stays and only the flanks rise
+    const TerrainEditResult clamped = edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(edits.offset(0, 0), 2.0f);
+    EXPECT_LT(clamped.maxChange, 1.0f);
+
+    brush.mode = TerrainBrushMode::Lower;
+    brush.strength = 0.5f;
+    edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(edits.offset(0, 0), 1.5f);
+}
+
+TEST(TerrainEditTests, FlattenMovesTowardsTheTarget) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainBrush brush;
+    brush.mode = TerrainBrushMode::Flatten;
+    brush.radius = 4.0f;
+    brush.strength = 0.5f;
+    brush.targetHeight = 2.0f;
+
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    const std::vector<float> base = flat_heights(rect, 10.0f);
+    edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(10.0f + edits.offset(0, 0), 6.0f);
+    edits.apply(brush, base.data());
+    EXPECT_FLOAT_EQ(10.0f + edits.offset(0, 0), 4.0f);
+
+    std::vector<float> heights = base;
+    edits.apply_offsets(rect, heights.data());
+    for (int z = rect.z0; z <= rect.z1; ++z) {
+        for (int x = rect.x0; x <= rect.x1; ++x) {
+            const float h = heights[(z - rect.z0) * rect.width() + (x - rect.x0)];
+            EXPECT_LE(h, 10.0f);
+            EXPECT_GE(h, 4.0f);
+        }
+    }
+}
+
+TEST(TerrainEditTests, SmoothAndErodeWearDownASpike) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainBrush brush;
+    brush.radius = 6.0f;
+    brush.strength = 1.0f;
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    std::vector<float> base = flat_heights(rect, 0.0f);
+    base[(0 - rect.z0) * rect.width() + (0 - rect.x0)] = 8.0f;
+
+    // Smoothing pulls the spike most of the way to its flat neighbours and leaves flat ground alone
+    brush.mode = TerrainBrushMode::Smooth;
+    edits.apply(brush, base.data());
+    EXPECT_LT(8.0f + edits.offset(0, 0), 1.0f);
+    EXPECT_GT(edits.offset(1, 0), 1.0f);
+    EXPECT_EQ(edits.offset(3, 3), 0.0f);
+
+    // Erosion only moves the excess over the talus slope, and what the spike loses its neighbours gain;
+    // a wide brush weighs the points around the spike almost equally
+    TerrainEdits eroded(1.0f, 100.0f);
+    brush.mode = TerrainBrushMode::Erode;
+    brush.radius = 200.0f;
+    const TerrainGridRect wide = eroded.brush_rect(brush);
+    std::vector<float> spike = flat_heights(wide, 0.0f);
+    spike[(0 - wide.z0) * wide.width() + (0 - wide.x0)] = 8.0f;
+    eroded.apply(brush, spike.data());
+    const TerrainGridRect around = { -1, -1, 1, 1 };
+    std::vector<float> offsets(9);
+    eroded.read_offsets(around, offsets.data());
+    float total = 0.0f;
+    for (float o : offsets) {
+        total += o;
+    }
+    EXPECT_LT(offsets[4], 0.0f);
+    EXPECT_GT(offsets[1], 0.0f);
+    EXPECT_EQ(offsets[0], 0.0f);
+    EXPECT_NEAR(total, 0.0f, 1e-3f);
+    EXPECT_GE(8.0f + offsets[4], offsets[1] + 1.0f);
+}
+
+TEST(TerrainEditTests, WrittenOffsetsReadBackAndReportWhatChanged) {
+    TerrainEdits edits(1.0f, 100.0f);
+    const TerrainGridRect rect = { 4, 4, 6, 5 };
+    const std::vector<float> offsets = { 0.0f, 1.0f, 2.0f, 0.0f, 0.0f, -3.0f };
+    TerrainGridRect changed = edits.write_offsets(rect, offsets.data());
+    EXPECT_EQ(changed.x0, 5);
+    EXPECT_EQ(changed.x1, 6);
+    EXPECT_EQ(changed.z0, 4);
+    EXPECT_EQ(changed.z1, 5);
+    EXPECT_EQ(edits.size(), 3u);
+
+    std::vector<float> read(offsets.size());
+    edits.read_offsets(rect, read.data());
+    EXPECT_EQ(read, offsets);
+    EXPECT_TRUE(edits.write_offsets(rect, offsets.data()).empty());
+
+    // Zero drops the edit
+    const std::vector<float> cleared(offsets.size(), 0.0f);
+    changed = edits.write_offsets(rect, cleared.data());
+    EXPECT_EQ(changed.x0, 5);
+    EXPECT_EQ(edits.size(), 0u);
+    EXPECT_FALSE(edits.touches(rect));
+}
+
+TEST(TerrainEditTests, OffsetsInterpolateBetweenGridPoints) {
+    TerrainEdits edits(2.0f, 100.0f);
+    TerrainBrush brush;
+    brush.centerX = 4.0f;
+    brush.radius = 2.5f;
+    brush.strength = 1.0f;
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    edits.apply(brush, flat_heights(rect, 0.0f).data());
+
+    EXPECT_FLOAT_EQ(edits.offset_at(4.0f, 0.0f), 1.0f);
+    EXPECT_FLOAT_EQ(edits.offset_at(5.0f, 0.0f), 0.5f * (1.0f + edits.offset(3, 0)));
+    EXPECT_FLOAT_EQ(edits.offset_at(100.0f, 0.0f), 0.0f);
+}
+
+TEST(TerrainEditTests, AssignReplacesEveryPointAndReportsBothAreas) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainBrush brush;
+    brush.centerX = -10.0f;
+    brush.radius = 2.0f;
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    edits.apply(brush, flat_heights(rect, 0.0f).data());
+
+    std::vector<TerrainEditPoint> points;
+    edits.points(points);
+    ASSERT_EQ(points.size(), edits.size());
+    for (size_t i = 1; i < points.size(); ++i) {
+        EXPECT_TRUE(points[i - 1].z < points[i].z || (points[i - 1].z == points[i].z && points[i - 1].x < points[i].x));
+    }
+
+    const TerrainEditPoint loaded[] = { { 5, 2, 1.5f }, { 6, -3, -0.5f } };
+    const TerrainGridRect changed = edits.assign(loaded, 2);
+    EXPECT_EQ(edits.size(), 2u);
+    EXPECT_EQ(edits.offset(-10, 0), 0.0f);
+    EXPECT_EQ(edits.offset(6, -3), -0.5f);
+    EXPECT_TRUE(edits.touches({ 5, 2, 5, 2 }));
+    // The old brush and the new points both changed
+    EXPECT_EQ(changed.x0, -11);
+    EXPECT_EQ(changed.x1, 6);
+    EXPECT_EQ(changed.z0, -3);
+    EXPECT_EQ(changed.z1, 2);
+}
+
+TEST(TerrainEditTests, GridNormalsFollowTheSlope) {
+    // A plane rising 0.5 per unit along X
+    const int width = 4, depth = 3;
+    std::vector<float> heights(width * depth);
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < width; ++x) {
+            heights[z * width + x] = 0.5f * x;
+        }
+    }
+    std::vector<simd::float3> normals((width - 2) * (depth - 2));
+    terrain_grid_normals(heights.data(), width, depth, 1.0f, normals.data());
+    for (const simd::float3& n : normals) {
+        EXPECT_NEAR(n.x, -1.0f / sqrtf(5.0f), 1e-5f);
+        EXPECT_NEAR(n.y, 2.0f / sqrtf(5.0f), 1e-5f);
+        EXPECT_NEAR(n.z, 0.0f, 1e-6f);
+    }
+}
+
+TEST(TerrainEditTests, HeightFieldPicksUpEditsInsideTheBox) {
+    HeightField field = create_height_field(-8.0f, -8.0f, 17, 17, 1.0f);
+    const HeightField original = field;
+
+    TerrainEdits edits(1.0f, 1000.0f);
+    TerrainBrush brush;
+    brush.radius = 3.0f;
+    brush.strength = 1.5f;
+    const TerrainGridRect rect = edits.brush_rect(brush);
+    edits.apply(brush, flat_heights(rect, 0.0f).data());
+    height_field_apply_edits(field, -3.0f, -3.0f, 3.0f, 3.0f, edits);
+
+    for (int z = 0; z < field.depth; ++z) {
+        for (int x = 0; x < field.width; ++x) {
+            const int i = z * field.width + x;
+            EXPECT_NEAR(field.heights[i], original.heights[i] + edits.offset(x - 8, z - 8), 1e-4f) << x << ", " << z;
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "terrain_edit_history.hpp"
+
+#include <vector>
+
+namespace {
+    // Applies a brush over flat ground at height 0 inside an open stroke
+    void stroke(TerrainEdits& edits, TerrainEditHistory& history, const TerrainBrush& brush) {
+        const TerrainGridRect rect = edits.brush_rect(brush);
+        const std::vector<float> base((size_t)rect.width() * rect.depth(), 0.0f);
+        history.touch(edits, rect);
+        edits.apply(brush, base.data());
+    }
+
+    std::vector<TerrainEditPoint> points_of(const TerrainEdits& edits) {
+        std::vector<TerrainEditPoint> points;
+        edits.points(points);
+        return points;
+    }
+
+    bool same_points(const std::vector<TerrainEditPoint>& a, const std::vector<TerrainEditPoint>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].x != b[i].x || a[i].z != b[i].z || a[i].offset != b[i].offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(TerrainEditHistoryTests, TilesCoverRectanglesOnBothSidesOfTheOrigin) {
+    const TerrainGridRect tiles = terrain_edit_tiles({ -1, 0, 32, 31 });
+    EXPECT_EQ(tiles.x0, -1);
+    EXPECT_EQ(tiles.x1, 1);
+    EXPECT_EQ(tiles.z0, 0);
+    EXPECT_EQ(tiles.z1, 0);
+    const TerrainGridRect rect = terrain_edit_tile_rect(-1, 2);
+    EXPECT_EQ(rect.x0, -TERRAIN_EDIT_TILE);
+    EXPECT_EQ(rect.x1, -1);
+    EXPECT_EQ(rect.z0, 2 * TERRAIN_EDIT_TILE);
+    EXPECT_EQ(rect.width(), TERRAIN_EDIT_TILE);
+}
+
+TEST(TerrainEditHistoryTests, UndoAndRedoRestoreOffsetsExactly) {
+    TerrainEdits edits(0.5f, 100.0f);
+    TerrainEditHistory history;
+    TerrainBrush brush;
+    brush.radius = 6.0f;
+    brush.strength = 0.37f;
+
+    const std::vector<TerrainEditPoint> empty = points_of(edits);
+    history.begin_stroke();
+    for (int i = 0; i < 20; ++i) {
+        brush.centerX = 0.7f * (float)i - 4.0f;
+        stroke(edits, history, brush);
+    }
+    EXPECT_TRUE(history.end_stroke(edits));
+    const std::vector<TerrainEditPoint> first = points_of(edits);
+
+    // A second stroke smooths across what the first raised
+    history.begin_stroke();
+    brush.mode = TerrainBrushMode::Smooth;
+    brush.strength = 0.8f;
+    brush.centerZ = 2.0f;
+    stroke(edits, history, brush);
+    EXPECT_TRUE(history.end_stroke(edits));
+    const std::vector<TerrainEditPoint> second = points_of(edits);
+    EXPECT_EQ(history.undo_count(), 2u);
+
+    EXPECT_FALSE(history.undo(edits).empty());
+    EXPECT_TRUE(same_points(points_of(edits), first));
+    EXPECT_FALSE(history.undo(edits).empty());
+    EXPECT_TRUE(same_points(points_of(edits), empty));
+    EXPECT_FALSE(history.can_undo());
+    EXPECT_TRUE(history.undo(edits).empty());
+
+    EXPECT_FALSE(history.redo(edits).empty());
+    EXPECT_TRUE(same_points(points_of(edits), first));
+    EXPECT_FALSE(history.redo(edits).empty());
+    EXPECT_TRUE(same_points(points_of(edits), second));
+    EXPECT_FALSE(history.can_redo());
+}
+
+TEST(TerrainEditHistoryTests, NewStrokesDropRedoAndEmptyStrokesAreNotKept) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainEditHistory history;
+    TerrainBrush brush;
+
+    history.begin_stroke();
+    stroke(edits, history, brush);
+    history.end_stroke(edits);
+    history.undo(edits);
+    EXPECT_TRUE(history.can_redo());
+
+    // Touching without changing anything is not a stroke, and keeps what can be redone
+    history.begin_stroke();
+    history.touch(edits, { 0, 0, 100, 100 });
+    EXPECT_FALSE(history.end_stroke(edits));
+    EXPECT_TRUE(history.can_redo());
+
+    history.begin_stroke();
+    brush.centerX = 50.0f;
+    stroke(edits, history, brush);
+    EXPECT_TRUE(history.end_stroke(edits));
+    EXPECT_FALSE(history.can_redo());
+    EXPECT_EQ(history.undo_count(), 1u);
+}
+
+TEST(TerrainEditHistoryTests, DeltasCompressAndTheOldestStrokesAreForgotten) {
+    TerrainEdits edits(1.0f, 100.0f);
+    TerrainEditHistory unbounded;
+    TerrainBrush brush;
+    brush.radius = 3.0f;
+
+    // A small brush in the middle of a tile leaves most of it zero
+    unbounded.begin_stroke();
+    brush.centerX = 16.0f;
+    brush.centerZ = 16.0f;
+    stroke(edits, unbounded, brush);
+    unbounded.end_stroke(edits);
+    EXPECT_GT(unbounded.bytes(), 0u);
+    EXPECT_LT(unbounded.bytes(), (size_t)TERRAIN_EDIT_TILE * TERRAIN_EDIT_TILE * sizeof(float) / 8);
+
+    const size_t strokeBytes = unbounded.bytes();
+    TerrainEditHistory bounded(strokeBytes * 3);
+    for (int i = 0; i < 10; ++i) {
+        bounded.begin_stroke();
+        stroke(edits, bounded, brush);
+        bounded.end_stroke(edits);
+    }
+    EXPECT_LE(bounded.bytes(), strokeBytes * 3);
+    EXPECT_GE(bounded.undo_count(), 2u);
+    EXPECT_LT(bounded.undo_count(), 10u);
+    bounded.clear();
+    EXPECT_EQ(bounded.bytes(), 0u);
+    EXPECT_FALSE(bounded.can_undo());
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "terrain_erosion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace {
+    double total(const std::vector<float>& heights) {
+        return std::accumulate(heights.begin(), heights.end(), 0.0);
+    }
+
+    std::vector<float> window_of(int cells, float offset) {
+        return std::vector<float>((size_t)(2 * cells + 1) * (2 * cells + 1), offset);
+    }
+}
+
+TEST(TerrainErosionTests, DryFlatTerrainIsUnchanged) {
+    ErosionSettings settings;
+    settings.iterations = 40;
+    settings.rain = 0.0f;
+    std::vector<float> heights(16 * 12, 3.0f);
+    erode_heights(heights.data(), 16, 12, 1.0f, settings);
+    for (float height : heights) {
+        EXPECT_EQ(height, 3.0f);
+    }
+}
+
+TEST(TerrainErosionTests, ThermalErosionConservesTerrainAndSettlesAtTheTalusSlope) {
+    ErosionSettings settings;
+    settings.iterations = 2000;
+    settings.rain = 0.0f;
+    settings.talus = 1.0f;
+    settings.thermalRate = 10.0f;
+    const int size = 21;
+    std::vector<float> heights(size * size, 0.0f);
+    heights[10 * size + 10] = 20.0f;
+    const double before = total(heights);
+    erode_heights(heights.data(), size, size, 1.0f, settings);
+
+    EXPECT_NEAR(total(heights), before, 1e-3);
+    EXPECT_LT(heights[10 * size + 10], 6.0f);
+    float steepest = 0.0f;
+    for (int z = 0; z < size; ++z) {
+        for (int x = 0; x + 1 < size; ++x) {
+            steepest = std::max(steepest, fabsf(heights[z * size + x + 1] - heights[z * size + x]));
+            steepest = std::max(steepest, fabsf(heights[x * size + z + size] - heights[x * size + z]));
+        }
+    }
+    EXPECT_LT(steepest, settings.talus + 0.05f);
+}
+
+TEST(TerrainErosionTests, RunningWaterCarvesSlopesAndRepeatsExactly) {
+    ErosionSettings settings;
+    settings.iterations = 100;
+    settings.thermalRate = 0.0f;
+    const int width = 24, depth = 16;
+    std::vector<float> heights(width * depth);
+    for (int z = 0; z < depth; ++z) {
+        for (int x = 0; x < width; ++x) {
+            heights[z * width + x] = 0.5f * x + 0.25f * sinf(0.7f * z);
+        }
+    }
+    std::vector<float> eroded = heights;
+    erode_heights(eroded.data(), width, depth, 1.0f, settings);
+
+    // Dissolved terrain is still suspended or has left the grid
+    EXPECT_LT(total(eroded), total(heights));
+    float deepest = 0.0f;
+    for (size_t i = 0; i < heights.size(); ++i) {
+        deepest = std::max(deepest, heights[i] - eroded[i]);
+    }
+    EXPECT_GT(deepest, 0.01f);
+
+    std::vector<float> again = heights;
+    erode_heights(again.data(), width, depth, 1.0f, settings);
+    EXPECT_EQ(again, eroded);
+}
+
+TEST(TerrainErosionTests, ZeroIterationsLeaveHeightsAlone) {
+    ErosionSettings settings;
+    std::vector<float> heights = { 0.0f, 4.0f, 9.0f, 1.0f };
+    erode_heights(heights.data(), 2, 2, 1.0f, settings);
+    EXPECT_EQ(heights, (std::vector<float>{ 0.0f, 4.0f, 9.0f, 1.0f }));
+    EXPECT_FALSE(TerrainErosion(settings, 4, 1.0f).enabled());
+}
+
+TEST(TerrainErosionTests, WindowOffsetsCropTheMargin) {
+    const int cells = 2, margin = 1, simulated = 2 * cells + 1 + 2 * margin;
+    std::vector<float> uneroded(simulated * simulated), eroded(simulated * simulated);
+    for (int i = 0; i < simulated * simulated; ++i) {
+        uneroded[i] = (float)i;
+        eroded[i] = (float)i + (float)(i % simulated) * 0.5f;
+    }
+    const std::vector<float> offsets = erosion_window_offsets(uneroded.data(), eroded.data(), cells, margin);
+    ASSERT_EQ(offsets.size(), 25u);
+    EXPECT_FLOAT_EQ(offsets[0], 0.5f);
+    EXPECT_FLOAT_EQ(offsets[4], 2.5f);
+    EXPECT_FLOAT_EQ(offsets[24], 2.5f);
+
+    const TerrainGridRect rect = erosion_window_rect({ 1, -1 }, cells);
+    EXPECT_EQ(rect.x0, 0);
+    EXPECT_EQ(rect.z0, -4);
+    EXPECT_EQ(rect.width(), 5);
+    EXPECT_EQ(rect.depth(), 5);
+}
+
+TEST(TerrainErosionTests, ChunksNeedTheFourWindowsAroundThem) {
+    ErosionSettings settings;
+    settings.iterations = 1;
+    settings.margin = 3;
+    const int cells = 4;
+    TerrainErosion erosion(settings, cells, 0.5f);
+    const TerrainGridRect sim = erosion.simulated_rect({ 0, 0 });
+    EXPECT_EQ(sim.x0, -7);
+    EXPECT_EQ(sim.x1, 7);
+
+    std::vector<ChunkKey> missing;
+    erosion.missing_windows({ 0, 0, cells, cells }, missing);
+    ASSERT_EQ(missing.size(), 4u);
+    EXPECT_TRUE((missing[0] == ChunkKey{ 0, 0 }));
+    EXPECT_TRUE((missing[3] == ChunkKey{ 1, 1 }));
+
+    // One point past the chunk reaches the windows beyond it
+    erosion.missing_windows({ -1, 0, cells, cells }, missing);
+    EXPECT_EQ(missing.size(), 6u);
+
+    for (const ChunkKey& corner : { ChunkKey{ 0, 0 }, ChunkKey{ 1, 0 }, ChunkKey{ 0, 1 }, ChunkKey{ 1, 1 } }) {
+        erosion.store(corner, window_of(cells, 1.0f));
+    }
+    erosion.missing_windows({ 0, 0, cells, cells }, missing);
+    EXPECT_TRUE(missing.empty());
+    EXPECT_EQ(erosion.size(), 4u);
+    EXPECT_EQ(erosion.bytes(), 4 * 81 * sizeof(float));
+}
+
+TEST(TerrainErosionTests, WindowsBlendIntoOneSurfaceThatChunksShare) {
+    ErosionSettings settings;
+    settings.iterations = 1;
+    const int cells = 4;
+    TerrainErosion erosion(settings, cells, 0.5f);
+    for (int z = -1; z <= 2; ++z) {
+        for (int x = -1; x <= 2; ++x) {
+            erosion.store({ x, z }, window_of(cells, (float)(x * 10 + z)));
+        }
+    }
+
+    // A corner takes its own window's offset, and the tents interpolate between corners
+    EXPECT_FLOAT_EQ(erosion.offset(cells, 0), 10.0f);
+    EXPECT_FLOAT_EQ(erosion.offset(cells, cells), 11.0f);
+    EXPECT_FLOAT_EQ(erosion.offset(cells / 2, 0), 5.0f);
+    EXPECT_FLOAT_EQ(erosion.offset(cells / 2, cells / 2), 5.5f);
+    EXPECT_FLOAT_EQ(erosion.offset_at(0.25f * cells, 0.0f), 5.0f);
+
+    // The border column of chunks (0, 0) and (1, 0) is the same points either way
+    std::vector<float> left((cells + 1) * (cells + 1), 0.0f), right((cells + 1) * (cells + 1), 0.0f);
+    erosion.apply_offsets({ 0, 0, cells, cells }, left.data());
+    erosion.apply_offsets({ cells, 0, 2 * cells, cells }, right.data());
+    for (int z = 0; z <= cells; ++z) {
+        EXPECT_EQ(left[z * (cells + 1) + cells], right[z * (cells + 1)]);
+    }
+
+    erosion.trim({ 0, 0 }, 1);
+    EXPECT_EQ(erosion.size(), 5u);
+    EXPECT_NE(erosion.window({ 1, 0 }), nullptr);
+    EXPECT_EQ(erosion.window({ 1, 1 }), nullptr);
+    EXPECT_FLOAT_EQ(erosion.offset(cells, cells), 0.0f);
+}
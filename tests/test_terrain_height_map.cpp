@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "terrain_height_map.hpp"
+
+#include <cmath>
+
+TEST(TerrainHeightMapTests, HalfFloatsRoundTripWithinHalfAnUlp) {
+    EXPECT_EQ(float_to_half(0.0f), 0x0000);
+    EXPECT_EQ(float_to_half(1.0f), 0x3c00);
+    EXPECT_EQ(float_to_half(-2.0f), 0xc000);
+    EXPECT_EQ(float_to_half(65504.0f), 0x7bff);
+    EXPECT_EQ(float_to_half(1e6f), 0x7c00);
+    EXPECT_EQ(half_to_float(0x0001), std::ldexp(1.0f, -24));
+    for (float value = -40.0f; value <= 40.0f; value += 0.173f) {
+        const float decoded = half_to_float(float_to_half(value));
+        const float ulp = std::ldexp(1.0f, std::ilogb(std::max(std::fabs(value), 1e-4f)) - 10);
+        EXPECT_LE(std::fabs(decoded - value), 0.5f * ulp) << value;
+    }
+}
+
+TEST(TerrainHeightMapTests, NormalsRebuildTheirUpComponent) {
+    for (int i = 0; i < 64; ++i) {
+        const float tilt = 1.4f * (i % 8) / 7.0f;
+        const float heading = 6.2831853f * (i / 8) / 8.0f;
+        const simd::float3 n = { sinf(tilt) * cosf(heading), cosf(tilt), sinf(tilt) * sinf(heading) };
+
+        Vertex vertex = { { 0.0f, 0.0f, 0.0f }, n };
+        TerrainHeightMap map;
+        encode_terrain_height_map(&vertex, 1, map);
+        const simd::float3 decoded = decode_terrain_normal(map.normals.data());
+        EXPECT_GT(decoded.y, 0.0f);
+        EXPECT_GT(simd::dot(n, decoded), 0.995f) << "tilt " << tilt << " heading " << heading;
+    }
+}
+
+TEST(TerrainHeightMapTests, MatrixPlacesTexelsOnTheChunkGrid) {
+    const int res = 33;
+    const float chunkSize = 32.0f;
+    const simd::float4x4 m = terrain_height_map_matrix(-2, 3, res, chunkSize);
+
+    const simd::float4 corner = m * simd::float4{ 0.0f, 5.0f, 0.0f, 1.0f };
+    const simd::float4 far = m * simd::float4{ res - 1.0f, -5.0f, res - 1.0f, 1.0f };
+    EXPECT_FLOAT_EQ(corner.x, -64.0f);
+    EXPECT_FLOAT_EQ(corner.y, 5.0f);
+    EXPECT_FLOAT_EQ(corner.z, 96.0f);
+    EXPECT_FLOAT_EQ(far.x, -32.0f);
+    EXPECT_FLOAT_EQ(far.y, -5.0f);
+    EXPECT_FLOAT_EQ(far.z, 128.0f);
+}
+
+TEST(TerrainHeightMapTests, TexelsAreAnEighthOfFloatVertices) {
+    EXPECT_EQ(TERRAIN_HEIGHT_MAP_TEXEL_BYTES * 8, vertex_stride(VertexFormat::Float));
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "terrain_horizon.hpp"
+
+#include <cmath>
+
+namespace {
+    // A sun at an azimuth in degrees, counter-clockwise from +x towards +z, whose elevation has the given sine
+    simd::float3 sun(float azimuthDegrees, float elevationSine) {
+        const float azimuth = azimuthDegrees * (float)M_PI / 180.0f;
+        const float horizontal = std::sqrt(1.0f - elevationSine * elevationSine);
+        return { horizontal * std::cos(azimuth), elevationSine, horizontal * std::sin(azimuth) };
+    }
+
+    float mean_sine(const TerrainParams& params, float x, float z) {
+        float sines[HORIZON_DIRECTIONS];
+        terrain_horizon_sines(params, x, z, HorizonSettings{}, sines);
+        float sum = 0.0f;
+        for (float sine : sines) {
+            EXPECT_GE(sine, 0.0f);
+            EXPECT_LE(sine, 1.0f);
+            sum += sine;
+        }
+        return sum / (float)HORIZON_DIRECTIONS;
+    }
+}
+
+TEST(TerrainHorizonTests, UniformsDescribeTheAtlasAndTheHandOver) {
+    const TerrainHorizonUniforms uniforms = terrain_horizon_uniforms(32.0f, 13, 100.0f);
+    EXPECT_FLOAT_EQ(uniforms.chunkSize, 32.0f);
+    EXPECT_EQ(uniforms.tiles, 13u);
+    EXPECT_EQ(uniforms.tileTexels, HORIZON_TILE_TEXELS);
+    EXPECT_FLOAT_EQ(uniforms.atlasTexels, 13.0f * HORIZON_TILE_TEXELS);
+    EXPECT_FLOAT_EQ(uniforms.cascadeEnd, 100.0f);
+    EXPECT_FLOAT_EQ(uniforms.fadeDepth, HorizonSettings{}.fadeDepth);
+
+    // Short cascades fade over their whole range; without them the horizon covers everything at once
+    EXPECT_FLOAT_EQ(terrain_horizon_uniforms(32.0f, 13, 8.0f).fadeDepth, 8.0f);
+    EXPECT_FLOAT_EQ(terrain_horizon_uniforms(32.0f, 13, 0.0f).fadeDepth, 0.0f);
+}
+
+TEST(TerrainHorizonTests, StepsGrowGeometrically) {
+    const HorizonSettings settings;
+    EXPECT_FLOAT_EQ(terrain_horizon_step_distance(settings, 0), settings.firstStep);
+    for (uint32_t step = 1; step + 1 < settings.steps; ++step) {
+        const float previous = terrain_horizon_step_distance(settings, step - 1);
+        const float current = terrain_horizon_step_distance(settings, step);
+        const float next = terrain_horizon_step_distance(settings, step + 1);
+        EXPECT_NEAR((next - current) / (current - previous), settings.stepGrowth, 1e-3f);
+    }
+    // Far enough to catch the ridges beyond the default shadow distance
+    EXPECT_GT(terrain_horizon_step_distance(settings, settings.steps - 1), 150.0f);
+
+    HorizonSettings uniform;
+    uniform.stepGrowth = 1.0f;
+    EXPECT_FLOAT_EQ(terrain_horizon_step_distance(uniform, 3), 4.0f * uniform.firstStep);
+}
+
+TEST(TerrainHorizonTests, FlatTerrainHasAFlatHorizon) {
+    TerrainParams flat;
+    flat.height = 0.0f;
+    float sines[HORIZON_DIRECTIONS];
+    terrain_horizon_sines(flat, 3.0f, -7.0f, HorizonSettings{}, sines);
+    for (float sine : sines) {
+        EXPECT_FLOAT_EQ(sine, 0.0f);
+    }
+    EXPECT_FLOAT_EQ(terrain_horizon_visibility(sines, sun(40.0f, 0.5f), 0.08f), 1.0f);
+    // A sun on the horizon is half hidden
+    EXPECT_FLOAT_EQ(terrain_horizon_visibility(sines, sun(40.0f, 0.0f), 0.08f), 0.5f);
+}
+
+TEST(TerrainHorizonTests, VisibilityFollowsTheHorizonTowardsTheSun) {
+    // A wall along +x only
+    float sines[HORIZON_DIRECTIONS] = {};
+    sines[0] = 0.5f;
+    const float softness = 0.08f;
+    EXPECT_FLOAT_EQ(terrain_horizon_visibility(sines, sun(0.0f, 0.3f), softness), 0.0f);
+    EXPECT_FLOAT_EQ(terrain_horizon_visibility(sines, sun(180.0f, 0.3f), softness), 1.0f);
+    EXPECT_FLOAT_EQ(terrain_horizon_visibility(sines, sun(0.0f, 0.7f), softness), 1.0f);
+
+    // Half-way to the next direction the horizon is half as high, so the same sun is partly lit
+    const float between = terrain_horizon_visibility(sines, sun(22.5f, 0.3f), softness);
+    EXPECT_GT(between, 0.0f);
+    EXPECT_LT(between, 1.0f);
+    // Either side of +x alike, across the wrap from the last direction to the first
+    EXPECT_NEAR(terrain_horizon_visibility(sines, sun(-22.5f, 0.3f), softness), between, 1e-5f);
+
+    // The light need not be normalized
+    EXPECT_NEAR(terrain_horizon_visibility(sines, 4.0f * sun(22.5f, 0.3f), softness), between, 1e-5f);
+}
+
+TEST(TerrainHorizonTests, ValleysSeeAHigherHorizonThanPeaks) {
+    const TerrainParams params;
+    // The lowest and highest points of a patch of the standard terrain
+    float lowX = 0.0f, lowZ = 0.0f, highX = 0.0f, highZ = 0.0f;
+    float low = INFINITY, high = -INFINITY;
+    for (int z = -20; z <= 20; ++z) {
+        for (int x = -20; x <= 20; ++x) {
+            const float height = get_terrain_height((float)x, (float)z, params);
+            if (height < low) {
+                low = height;
+                lowX = (float)x;
+                lowZ = (float)z;
+            }
+            if (height > high) {
+                high = height;
+                highX = (float)x;
+                highZ = (float)z;
+            }
+        }
+    }
+    ASSERT_LT(low, high);
+    EXPECT_GT(mean_sine(params, lowX, lowZ), mean_sine(params, highX, highZ));
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "terrain_lod.hpp"
+
+#include <set>
+
+TEST(TerrainLodTests, LevelCount) {
+    EXPECT_EQ(terrain_lod_level_count(2), 1);
+    EXPECT_EQ(terrain_lod_level_count(17), 5);
+    EXPECT_EQ(terrain_lod_level_count(33), 6);
+}
+
+TEST(TerrainLodTests, UnstitchedLevelsCoverTheChunk) {
+    const int resolution = 33;
+    TerrainLodIndices lod = build_terrain_lod_indices(resolution);
+    for (int level = 0; level < lod.levelCount; ++level) {
+        int cells = (resolution - 1) >> level;
+        EXPECT_EQ(lod.range(level, 0).count, (uint32_t)(cells * cells * 6));
+    }
+}
+
+// A stitched edge must only reference vertices that exist on the neighbour one level coarser
+TEST(TerrainLodTests, StitchedEdgesSkipOddVertices) {
+    const int resolution = 17;
+    TerrainLodIndices lod = build_terrain_lod_indices(resolution);
+    const int level = 1;
+    const int coarseStep = 2 << level;
+
+    const IndexRange& range = lod.range(level, STITCH_NEG_Z | STITCH_POS_X);
+    std::set<uint32_t> used(lod.indices.begin() + range.offset, lod.indices.begin() + range.offset + range.count);
+    for (uint32_t index : used) {
+        int x = index % resolution;
+        int z = index / resolution;
+        if (z == 0) {
+            EXPECT_EQ(x % coarseStep, 0);
+        }
+        if (x == resolution - 1) {
+            EXPECT_EQ(z % coarseStep, 0);
+        }
+    }
+    for (uint32_t i = range.offset; i < range.offset + range.count; i += 3) {
+        EXPECT_NE(lod.indices[i], lod.indices[i + 1]);
+        EXPECT_NE(lod.indices[i + 1], lod.indices[i + 2]);
+        EXPECT_NE(lod.indices[i], lod.indices[i + 2]);
+    }
+}
+
+TEST(TerrainLodTests, NeighbourLevelsDifferByAtMostOne) {
+    ChunkLodInfo rough;
+    rough.levelCount = 6;
+    for (int l = 1; l < rough.levelCount; ++l) rough.geometricError[l] = l * 10.0f;
+    ChunkLodInfo flat;
+    flat.levelCount = 6;
+
+    // A flat chunk next to a rough one near the camera cannot drop straight to the coarsest level
+    ChunkLodInput chunks[2] = { { {0, 0}, &rough }, { {1, 0}, &flat } };
+    int levels[2];
+    uint32_t masks[2];
+    select_terrain_lods(chunks, 2, 32.0f, simd::float3{16.0f, 0.0f, 16.0f}, 500.0f, 2.0f, levels, masks);
+
+    EXPECT_EQ(levels[0], 0);
+    EXPECT_EQ(levels[1], 1);
+    EXPECT_EQ(masks[0], (uint32_t)STITCH_POS_X);
+    EXPECT_EQ(masks[1], 0u);
+}
+
+TEST(TerrainLodTests, OnlyChunksWithSmallCellsOnScreenAreVertexLit) {
+    ChunkLodInfo info;
+    info.levelCount = 6;
+    // One-unit cells 80 units away project to 6.25 pixels; 624 units away to 0.8
+    ChunkLodInput chunks[4] = { { {0, 0}, &info }, { {3, 0}, &info }, { {20, 0}, &info }, { {20, 1}, &info } };
+    const int levels[4] = { 0, 0, 0, 3 };
+    bool vertexLit[4];
+    select_vertex_lit_chunks(chunks, 4, levels, 33, 32.0f, simd::float3{16.0f, 0.0f, 16.0f}, 500.0f, 4.0f,
+                             vertexLit);
+
+    EXPECT_FALSE(vertexLit[0]);
+    EXPECT_FALSE(vertexLit[1]);
+    EXPECT_TRUE(vertexLit[2]);
+    // The same distance at a coarser level has cells eight times as wide
+    EXPECT_FALSE(vertexLit[3]);
+}
+
+TEST(TerrainLodTests, GeometricErrorIsNonDecreasing) {
+    const int resolution = 17;
+    MeshData chunk = create_terrain_chunk(2, -1, resolution, 16.0f);
+    ChunkLodInfo info = compute_chunk_lod_info(chunk.vertices, resolution);
+    EXPECT_EQ(info.geometricError[0], 0.0f);
+    for (int l = 1; l < info.levelCount; ++l) {
+        EXPECT_GE(info.geometricError[l], info.geometricError[l - 1]);
+    }
+    EXPECT_LE(info.minHeight, info.maxHeight);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "terrain_material.hpp"
+
+#include <set>
+
+TEST(TerrainMaterialTests, ResidentChunksNeverShareATile) {
+    const int radius = 6;
+    const uint32_t tiles = terrain_material_atlas_tiles(radius);
+    EXPECT_EQ(tiles, 13u);
+
+    // Every chunk the unload radius keeps around a camera chunk, including west and north of the origin
+    for (ChunkKey center : { ChunkKey{ 0, 0 }, ChunkKey{ -3, 7 }, ChunkKey{ -100, -41 } }) {
+        std::set<std::pair<uint32_t, uint32_t>> used;
+        int count = 0;
+        for (int dz = -radius; dz <= radius; ++dz) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                const TerrainMaterialTile tile = terrain_material_tile({ center.x + dx, center.z + dz }, tiles);
+                EXPECT_LT(tile.x, tiles);
+                EXPECT_LT(tile.z, tiles);
+                used.insert({ tile.x, tile.z });
+                ++count;
+            }
+        }
+        EXPECT_EQ(used.size(), (size_t)count);
+    }
+}
+
+TEST(TerrainMaterialTests, TilesWrapLikeAFloorModulo) {
+    EXPECT_EQ(terrain_material_tile({ -1, -13 }, 13).x, 12u);
+    EXPECT_EQ(terrain_material_tile({ -1, -13 }, 13).z, 0u);
+    EXPECT_EQ(terrain_material_tile({ 14, 25 }, 13).x, 1u);
+    EXPECT_EQ(terrain_material_tile({ 14, 25 }, 13).z, 12u);
+}
+
+TEST(TerrainMaterialTests, UniformsDescribeTheAtlas) {
+    const TerrainMaterialUniforms uniforms = terrain_material_uniforms(32.0f, 33, 13);
+    EXPECT_FLOAT_EQ(uniforms.chunkSize, 32.0f);
+    EXPECT_EQ(uniforms.tiles, 13u);
+    EXPECT_EQ(uniforms.tileTexels, 33u);
+    EXPECT_FLOAT_EQ(uniforms.atlasTexels, 429.0f);
+}
+
+TEST(TerrainMaterialTests, ChunksAreBakedOnceUntilEdited) {
+    TerrainMaterialSlots slots(5);
+    EXPECT_TRUE(slots.claim({ 1, 2 }, 0));
+    EXPECT_FALSE(slots.claim({ 1, 2 }, 0));
+    EXPECT_FALSE(slots.claim({ 1, 2 }, 0));
+
+    // An edit that reached the chunk bumps its version
+    EXPECT_TRUE(slots.claim({ 1, 2 }, 3));
+    EXPECT_FALSE(slots.claim({ 1, 2 }, 3));
+
+    // Other tiles are independent
+    EXPECT_TRUE(slots.claim({ 2, 2 }, 0));
+    EXPECT_FALSE(slots.claim({ 1, 2 }, 3));
+}
+
+TEST(TerrainMaterialTests, AChunkTakingOverATileIsBaked) {
+    TerrainMaterialSlots slots(5);
+    EXPECT_TRUE(slots.claim({ 0, 0 }, 0));
+    // Five chunks east, the camera has moved on and a new chunk owns the same tile
+    EXPECT_TRUE(slots.claim({ 5, 0 }, 0));
+    EXPECT_FALSE(slots.claim({ 5, 0 }, 0));
+    EXPECT_TRUE(slots.claim({ 0, 0 }, 0));
+}
+
+TEST(TerrainMaterialTests, InvalidateBakesEveryTileAgain) {
+    TerrainMaterialSlots slots(3);
+    EXPECT_TRUE(slots.claim({ 0, 0 }, 0));
+    EXPECT_TRUE(slots.claim({ 1, 0 }, 0));
+    slots.invalidate();
+    EXPECT_TRUE(slots.claim({ 0, 0 }, 0));
+    EXPECT_TRUE(slots.claim({ 1, 0 }, 0));
+    EXPECT_FALSE(slots.claim({ 0, 0 }, 0));
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+#include "terrain_tessellation.hpp"
+
+TEST(TerrainTessellationTests, EdgeFactorIsSymmetricAndClamped) {
+    TerrainTessellationSettings settings;
+    const simd::float3 camera = { 0.0f, 2.0f, 0.0f };
+    const simd::float3 a = { 3.0f, 0.5f, 4.0f };
+    const simd::float3 b = { 4.0f, 1.0f, 4.0f };
+    EXPECT_FLOAT_EQ(terrain_edge_tessellation(a, b, camera, 800.0f, settings),
+                    terrain_edge_tessellation(b, a, camera, 800.0f, settings));
+
+    // Right at the camera the edge is huge on screen; far away it is below a pixel
+    EXPECT_FLOAT_EQ(terrain_edge_tessellation(a, b, (a + b) * 0.5f, 800.0f, settings), settings.maxFactor);
+    const simd::float3 far = { 5000.0f, 0.0f, 0.0f };
+    EXPECT_FLOAT_EQ(terrain_edge_tessellation(a, b, far, 800.0f, settings), 1.0f);
+}
+
+TEST(TerrainTessellationTests, EdgeFactorFallsWithDistance) {
+    TerrainTessellationSettings settings;
+    settings.maxFactor = 64.0f;
+    const simd::float3 a = { 0.0f, 0.0f, 0.0f };
+    const simd::float3 b = { 1.0f, 0.0f, 0.0f };
+    const float near = terrain_edge_tessellation(a, b, simd::float3{ 0.5f, 10.0f, 0.0f }, 800.0f, settings);
+    const float mid = terrain_edge_tessellation(a, b, simd::float3{ 0.5f, 20.0f, 0.0f }, 800.0f, settings);
+    EXPECT_GT(near, mid);
+    EXPECT_NEAR(near, 2.0f * mid, 1e-3f);
+
+    // Pointing at the camera does not make the edge vanish
+    const float endOn = terrain_edge_tessellation(a, b, simd::float3{ 10.5f, 0.0f, 0.0f }, 800.0f, settings);
+    EXPECT_NEAR(endOn, near, 1e-3f);
+}
+
+TEST(TerrainTessellationTests, OnlyNearUnstitchedFullResolutionChunks) {
+    TerrainTessellationSettings settings;
+    settings.maxDistance = 40.0f;
+    const BoundingBox chunk = { { 0.0f, -5.0f, 0.0f }, { 32.0f, 5.0f, 32.0f } };
+    const simd::float3 above = { 16.0f, 20.0f, 16.0f };
+    EXPECT_TRUE(terrain_chunk_tessellated(chunk, 0, 0, above, settings));
+    EXPECT_FALSE(terrain_chunk_tessellated(chunk, 1, 0, above, settings));
+    EXPECT_FALSE(terrain_chunk_tessellated(chunk, 0, 1, above, settings));
+
+    // Distance is to the nearest point of the bounds, not the centre
+    EXPECT_TRUE(terrain_chunk_tessellated(chunk, 0, 0, simd::float3{ 70.0f, 0.0f, 16.0f }, settings));
+    EXPECT_FALSE(terrain_chunk_tessellated(chunk, 0, 0, simd::float3{ 75.0f, 0.0f, 16.0f }, settings));
+}
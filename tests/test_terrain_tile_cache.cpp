@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include "terrain_tile_cache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace {
+    TerrainTileParams test_params() {
+        TerrainTileParams params;
+        params.chunkSize = 32.0f;
+        params.resolution = 33;
+        params.vertexFormat = VertexFormat::Packed;
+        params.noise = { 25.0f, 0.1f, 10.0f };
+        return params;
+    }
+
+    std::string test_directory(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "terrain_tile_cache_tests" / name;
+        std::filesystem::remove_all(dir);
+        return dir.string();
+    }
+}
+
+TEST(TerrainTileCacheTests, GeneratorKeyChangesWithEveryParameter) {
+    const uint64_t base = terrain_tile_generator_key(test_params());
+    EXPECT_EQ(terrain_tile_generator_key(test_params()), base);
+
+    TerrainTileParams params = test_params();
+    params.chunkSize = 64.0f;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.resolution = 65;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.vertexFormat = VertexFormat::Float;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.heightMaps = true;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.heightScale = 12.0f;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.noise.seed = 2;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.noise.basis = NoiseBasis::Simplex;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.noise.warp = 0.5f;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.noise.octaves = 6;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.noise.noise.persistence = 0.5f;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+    params = test_params();
+    params.compressed = true;
+    EXPECT_NE(terrain_tile_generator_key(params), base);
+}
+
+TEST(TerrainTileCacheTests, GeneratorKeyOnlyHashesErosionWhileItIsOn) {
+    const uint64_t base = terrain_tile_generator_key(test_params());
+    TerrainTileParams params = test_params();
+    params.erosion.rain = 1.0f;
+    EXPECT_EQ(terrain_tile_generator_key(params), base);
+    params.erosion.iterations = 100;
+    const uint64_t eroded = terrain_tile_generator_key(params);
+    EXPECT_NE(eroded, base);
+    params.erosion.talus = 2.0f;
+    EXPECT_NE(terrain_tile_generator_key(params), eroded);
+
+    EXPECT_NE(terrain_erosion_tile_path("tiles", { 1, -2 }), terrain_tile_path("tiles", { 1, -2 }));
+}
+
+TEST(TerrainTileCacheTests, FilesArePaddedToWholePages) {
+    EXPECT_EQ(terrain_tile_file_size(1), TERRAIN_TILE_ALIGNMENT);
+    EXPECT_EQ(terrain_tile_file_size(TERRAIN_TILE_ALIGNMENT - sizeof(TerrainTileFooter)), TERRAIN_TILE_ALIGNMENT);
+    EXPECT_EQ(terrain_tile_file_size(TERRAIN_TILE_ALIGNMENT), 2 * TERRAIN_TILE_ALIGNMENT);
+}
+
+TEST(TerrainTileCacheTests, MapsWrittenTileWithVerticesAtTheStart) {
+    const uint64_t generatorKey = terrain_tile_generator_key(test_params());
+    const std::string dir = terrain_tile_directory(test_directory("round_trip"), generatorKey);
+    const ChunkKey key{ -3, 7 };
+
+    std::vector<uint8_t> vertices(33 * 33 * 12);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i] = (uint8_t)(i * 31);
+    }
+    TerrainTileFooter footer;
+    footer.generatorKey = generatorKey;
+    footer.chunkX = key.x;
+    footer.chunkZ = key.z;
+    footer.vertexBytes = vertices.size();
+    footer.lod.minHeight = -2.0f;
+    footer.lod.maxHeight = 5.0f;
+    footer.lod.levelCount = 6;
+    footer.lod.geometricError[3] = 0.75f;
+    ASSERT_TRUE(write_terrain_tile(terrain_tile_path(dir, key), footer, vertices.data()));
+
+    TerrainTile tile;
+    ASSERT_TRUE(map_terrain_tile(terrain_tile_path(dir, key), generatorKey, key, vertices.size(), tile));
+    EXPECT_EQ(tile.length % TERRAIN_TILE_ALIGNMENT, 0u);
+    EXPECT_EQ(memcmp(tile.data, vertices.data(), vertices.size()), 0);
+    EXPECT_FLOAT_EQ(tile.footer.lod.minHeight, -2.0f);
+    EXPECT_FLOAT_EQ(tile.footer.lod.maxHeight, 5.0f);
+    EXPECT_EQ(tile.footer.lod.levelCount, 6);
+    EXPECT_FLOAT_EQ(tile.footer.lod.geometricError[3], 0.75f);
+    unmap_terrain_tile(tile);
+}
+
+TEST(TerrainTileCacheTests, RejectsTilesOfAnotherGeneratorChunkOrSize) {
+    const uint64_t generatorKey = terrain_tile_generator_key(test_params());
+    const std::string dir = test_directory("mismatch");
+    const ChunkKey key{ 1, 2 };
+    const std::string path = terrain_tile_path(dir, key);
+
+    std::vector<uint8_t> vertices(1024, 7);
+    TerrainTileFooter footer;
+    footer.generatorKey = generatorKey;
+    footer.chunkX = key.x;
+    footer.chunkZ = key.z;
+    footer.vertexBytes = vertices.size();
+    ASSERT_TRUE(write_terrain_tile(path, footer, vertices.data()));
+
+    TerrainTile tile;
+    EXPECT_FALSE(map_terrain_tile(path, generatorKey + 1, key, vertices.size(), tile));
+    EXPECT_FALSE(map_terrain_tile(path, generatorKey, ChunkKey{ 2, 1 }, vertices.size(), tile));
+    EXPECT_FALSE(map_terrain_tile(path, generatorKey, key, vertices.size() * 2 + TERRAIN_TILE_ALIGNMENT, tile));
+    EXPECT_FALSE(map_terrain_tile(terrain_tile_path(dir, ChunkKey{ 9, 9 }), generatorKey, ChunkKey{ 9, 9 },
+                                  vertices.size(), tile));
+    EXPECT_EQ(tile.data, nullptr);
+
+    ASSERT_TRUE(map_terrain_tile(path, generatorKey, key, vertices.size(), tile));
+    unmap_terrain_tile(tile);
+}
+
+TEST(TerrainTileCacheTests, ReadsFooterWithoutMapping) {
+    const uint64_t generatorKey = terrain_tile_generator_key(test_params());
+    const std::string dir = test_directory("footer");
+    const ChunkKey key{ 4, -5 };
+    const std::string path = terrain_tile_path(dir, key);
+
+    std::vector<uint8_t> vertices(2048, 3);
+    TerrainTileFooter footer;
+    footer.generatorKey = generatorKey;
+    footer.chunkX = key.x;
+    footer.chunkZ = key.z;
+    footer.vertexBytes = vertices.size();
+    footer.lod.maxHeight = 9.0f;
+    ASSERT_TRUE(write_terrain_tile(path, footer, vertices.data()));
+
+    TerrainTileFooter read;
+    ASSERT_TRUE(read_terrain_tile_footer(path, generatorKey, key, vertices.size(), read));
+    EXPECT_FLOAT_EQ(read.lod.maxHeight, 9.0f);
+    EXPECT_FALSE(read_terrain_tile_footer(path, generatorKey + 1, key, vertices.size(), read));
+    EXPECT_FALSE(read_terrain_tile_footer(path, generatorKey, key, vertices.size() + TERRAIN_TILE_ALIGNMENT, read));
+}
+
+TEST(TerrainTileCacheTests, CompressedTilesDecodeSmallerThanTheyMap) {
+    const uint64_t generatorKey = terrain_tile_generator_key(test_params());
+    const std::string dir = test_directory("compressed");
+    const ChunkKey key{ 2, 3 };
+    const std::string path = terrain_tile_path(dir, key);
+
+    // Packed vertices of a gentle slope: 16-bit x, y, z and w, then a packed normal
+    const uint32_t res = 33;
+    std::vector<uint16_t> vertices;
+    for (uint32_t z = 0; z < res; ++z) {
+        for (uint32_t x = 0; x < res; ++x) {
+            vertices.insert(vertices.end(), { (uint16_t)(x * 2047), (uint16_t)(30000 + x * 40 + z * 25),
+                                              (uint16_t)(z * 2047), 0, 0x7f00, 0 });
+        }
+    }
+    const size_t vertexBytes = vertices.size() * sizeof(uint16_t);
+    TerrainTileFooter footer;
+    footer.generatorKey = generatorKey;
+    footer.chunkX = key.x;
+    footer.chunkZ = key.z;
+    footer.vertexBytes = vertexBytes;
+    footer.codec = (uint32_t)TerrainTileCodec::Vertices;
+    footer.codecStride = 12;
+    footer.lod.maxHeight = 4.0f;
+    ASSERT_TRUE(write_terrain_tile(path, footer, vertices.data()));
+    EXPECT_LT(std::filesystem::file_size(path), vertexBytes / 4);
+
+    std::vector<uint16_t> decoded(vertices.size());
+    TerrainTileFooter read;
+    ASSERT_TRUE(read_terrain_tile(path, generatorKey, key, vertexBytes, decoded.data(), read));
+    EXPECT_EQ(decoded, vertices);
+    EXPECT_FLOAT_EQ(read.lod.maxHeight, 4.0f);
+    EXPECT_FALSE(read_terrain_tile(path, generatorKey + 1, key, vertexBytes, decoded.data(), read));
+    // Encoded tiles cannot back a buffer
+    TerrainTile tile;
+    EXPECT_FALSE(map_terrain_tile(path, generatorKey, key, vertexBytes, tile));
+    EXPECT_FALSE(read_terrain_tile_footer(path, generatorKey, key, vertexBytes, read));
+
+    // Height maps: half-float heights of a slope, then RG8 normals
+    std::vector<uint16_t> heightMap(res * res * 2);
+    for (uint32_t i = 0; i < res * res; ++i) {
+        heightMap[i] = (uint16_t)(0x4000 + (i % res) * 3 + (i / res) * 5);
+        heightMap[res * res + i] = 0x7f10;
+    }
+    footer.vertexBytes = heightMap.size() * sizeof(uint16_t);
+    footer.codec = (uint32_t)TerrainTileCodec::HeightMap;
+    footer.codecStride = res;
+    ASSERT_TRUE(write_terrain_tile(path, footer, heightMap.data()));
+    std::vector<uint16_t> decodedMap(heightMap.size());
+    ASSERT_TRUE(read_terrain_tile(path, generatorKey, key, footer.vertexBytes, decodedMap.data(), read));
+    EXPECT_EQ(decodedMap, heightMap);
+
+    // Raw tiles read back the same way
+    footer.codec = (uint32_t)TerrainTileCodec::Raw;
+    ASSERT_TRUE(write_terrain_tile(path, footer, heightMap.data()));
+    std::fill(decodedMap.begin(), decodedMap.end(), 0);
+    ASSERT_TRUE(read_terrain_tile(path, generatorKey, key, footer.vertexBytes, decodedMap.data(), read));
+    EXPECT_EQ(decodedMap, heightMap);
+}
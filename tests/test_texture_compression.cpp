@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+    uint32_t get_bits(const uint8_t* block, uint32_t bit, uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            value |= ((block[(bit + i) / 8] >> ((bit + i) % 8)) & 1u) << i;
+        }
+        return value;
+    }
+
+    // Decodes the blocks encode_astc_block writes, the way the ASTC specification decodes LDR RGB
+    // direct blocks with a 4x4 grid of 3-bit weights into UNORM8
+    void decode_astc_block(const uint8_t* block, uint32_t blockWidth, uint32_t blockHeight, uint8_t* rgb) {
+        ASSERT_EQ(get_bits(block, 0, 11), 0x53u);
+        ASSERT_EQ(get_bits(block, 11, 2), 0u);
+        ASSERT_EQ(get_bits(block, 13, 4), 8u);
+        uint32_t v[6];
+        for (uint32_t i = 0; i < 6; ++i) {
+            v[i] = get_bits(block, 17 + i * 8, 8);
+        }
+        ASSERT_GE(v[1] + v[3] + v[5], v[0] + v[2] + v[4]);
+        const uint32_t e0[3] = { v[0], v[2], v[4] };
+        const uint32_t e1[3] = { v[1], v[3], v[5] };
+
+        uint32_t grid[16];
+        for (uint32_t i = 0; i < 16; ++i) {
+            uint32_t q = 0;
+            for (uint32_t b = 0; b < 3; ++b) {
+                q |= get_bits(block, 127 - (i * 3 + b), 1) << b;
+            }
+            const uint32_t w = q << 3 | q;
+            grid[i] = w > 32 ? w + 1 : w;
+        }
+
+        const uint32_t ds = (1024 + blockWidth / 2) / (blockWidth - 1);
+        const uint32_t dt = (1024 + blockHeight / 2) / (blockHeight - 1);
+        for (uint32_t t = 0; t < blockHeight; ++t) {
+            for (uint32_t s = 0; s < blockWidth; ++s) {
+                const uint32_t gs = (ds * s * 3 + 32) >> 6, gt = (dt * t * 3 + 32) >> 6;
+                const uint32_t js = gs >> 4, fs = gs & 15, jt = gt >> 4, ft = gt & 15;
+                const uint32_t w11 = (fs * ft + 8) >> 4, w10 = ft - w11, w01 = fs - w11, w00 = 16 - fs - ft + w11;
+                auto at = [&](uint32_t x, uint32_t y) { return x < 4 && y < 4 ? grid[y * 4 + x] : 0u; };
+                const uint32_t weight = (at(js, jt) * w00 + at(js + 1, jt) * w01 + at(js, jt + 1) * w10 +
+                                         at(js + 1, jt + 1) * w11 + 8) >> 4;
+                for (uint32_t c = 0; c < 3; ++c) {
+                    const uint32_t c0 = e0[c] << 8 | e0[c], c1 = e1[c] << 8 | e1[c];
+                    const uint32_t value = (c0 * (64 - weight) + c1 * weight + 32) >> 6;
+                    rgb[(t * blockWidth + s) * 3 + c] = (uint8_t)(value >> 8);
+                }
+            }
+        }
+    }
+
+    void decode_bc1_block(const uint8_t* block, uint8_t* rgb) {
+        const uint32_t c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+        auto expand = [](uint32_t c, float* out) {
+            const uint32_t r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+            out[0] = (float)(r << 3 | r >> 2);
+            out[1] = (float)(g << 2 | g >> 4);
+            out[2] = (float)(b << 3 | b >> 2);
+        };
+        float palette[4][3];
+        expand(c0, palette[0]);
+        expand(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = c0 > c1 ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = c0 > c1 ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0.0f;
+        }
+        uint32_t indices;
+        memcpy(&indices, block + 4, 4);
+        for (uint32_t i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                rgb[i * 3 + c] = (uint8_t)std::lround(palette[(indices >> (i * 2)) & 3][c]);
+            }
+        }
+    }
+
+    // A smooth diagonal blend from grass to rock, as generated terrain colours mostly are
+    std::vector<uint8_t> gradient_rgb(uint32_t width, uint32_t height) {
+        std::vector<uint8_t> rgb((size_t)width * height * 3);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                const float t = (float)(x + y) / (float)(width + height - 2);
+                uint8_t* texel = &rgb[(y * width + x) * 3];
+                texel[0] = (uint8_t)std::lround(77 + 51 * t);
+                texel[1] = (uint8_t)std::lround(153 - 25 * t);
+                texel[2] = (uint8_t)std::lround(51 + 77 * t);
+            }
+        }
+        return rgb;
+    }
+
+    int max_error(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+        int error = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            error = std::max(error, std::abs((int)a[i] - (int)b[i]));
+        }
+        return error;
+    }
+}
+
+TEST(TextureCompressionTests, SizesFollowTheBlocks) {
+    EXPECT_EQ(compressed_image_bytes(TextureCompression::None, 256, 256), 256u * 256 * 4);
+    EXPECT_EQ(compressed_image_bytes(TextureCompression::Astc4x4, 256, 256), 64u * 64 * 16);
+    EXPECT_EQ(compressed_image_bytes(TextureCompression::Bc1, 256, 256), 64u * 64 * 8);
+    EXPECT_EQ(compressed_image_bytes(TextureCompression::Astc8x8, 256, 256), 32u * 32 * 16);
+    // Partial blocks at the edges still take a whole block
+    EXPECT_EQ(compressed_row_bytes(TextureCompression::Astc6x6, 256), 43u * 16);
+    EXPECT_EQ(compressed_image_bytes(TextureCompression::Astc4x4, 1, 1), 16u);
+}
+
+TEST(TextureCompressionTests, AstcRoundTripsGradients) {
+    for (uint32_t size : { 4u, 6u, 8u }) {
+        const std::vector<uint8_t> rgb = gradient_rgb(size, size);
+        uint8_t block[16];
+        encode_astc_block(rgb.data(), size, size, block);
+        std::vector<uint8_t> decoded(rgb.size());
+        decode_astc_block(block, size, size, decoded.data());
+        EXPECT_LE(max_error(rgb, decoded), 8) << size << "x" << size;
+    }
+}
+
+TEST(TextureCompressionTests, AstcKeepsSolidColoursExact) {
+    std::vector<uint8_t> rgb(16 * 3);
+    for (size_t i = 0; i < rgb.size(); i += 3) {
+        rgb[i] = 77;
+        rgb[i + 1] = 153;
+        rgb[i + 2] = 51;
+    }
+    uint8_t block[16];
+    encode_astc_block(rgb.data(), 4, 4, block);
+    std::vector<uint8_t> decoded(rgb.size());
+    decode_astc_block(block, 4, 4, decoded.data());
+    EXPECT_EQ(max_error(rgb, decoded), 0);
+}
+
+TEST(TextureCompressionTests, AstcHandlesColoursAcrossTheAxes) {
+    // Red rising as green falls: the spread is orthogonal to grey
+    std::vector<uint8_t> rgb(16 * 3);
+    for (uint32_t i = 0; i < 16; ++i) {
+        rgb[i * 3] = (uint8_t)(100 + 8 * i);
+        rgb[i * 3 + 1] = (uint8_t)(200 - 8 * i);
+        rgb[i * 3 + 2] = 90;
+    }
+    uint8_t block[16];
+    encode_astc_block(rgb.data(), 4, 4, block);
+    std::vector<uint8_t> decoded(rgb.size());
+    decode_astc_block(block, 4, 4, decoded.data());
+    EXPECT_LE(max_error(rgb, decoded), 8);
+}
+
+TEST(TextureCompressionTests, Bc1RoundTripsGradients) {
+    const std::vector<uint8_t> rgb = gradient_rgb(4, 4);
+    uint8_t block[8];
+    encode_bc1_block(rgb.data(), block);
+    EXPECT_GT(block[0] | block[1] << 8, block[2] | block[3] << 8);
+    std::vector<uint8_t> decoded(rgb.size());
+    decode_bc1_block(block, decoded.data());
+    // Four colours across a spread of 77 are 26 apart, plus the rounding to 5:6:5
+    EXPECT_LE(max_error(rgb, decoded), 16);
+}
+
+TEST(TextureCompressionTests, CompressesBgraImagesWithPartialBlocks) {
+    // A 5x3 image: the second block column and the bottom rows repeat the edge texels
+    const uint32_t width = 5, height = 3;
+    std::vector<uint8_t> bgra(width * height * 4);
+    for (uint32_t i = 0; i < width * height; ++i) {
+        bgra[i * 4] = 30;       // B
+        bgra[i * 4 + 1] = 90;   // G
+        bgra[i * 4 + 2] = (uint8_t)(i % width == width - 1 ? 250 : 10); // R
+        bgra[i * 4 + 3] = 255;
+    }
+    std::vector<uint8_t> blocks(compressed_image_bytes(TextureCompression::Astc4x4, width, height));
+    ASSERT_EQ(blocks.size(), 32u);
+    compress_bgra_texels(TextureCompression::Astc4x4, bgra.data(), width * 4, width, height, blocks.data());
+
+    uint8_t left[16 * 3], right[16 * 3];
+    decode_astc_block(blocks.data(), 4, 4, left);
+    decode_astc_block(blocks.data() + 16, 4, 4, right);
+    EXPECT_NEAR(left[0], 10, 2);
+    EXPECT_NEAR(left[1], 90, 2);
+    EXPECT_NEAR(left[2], 30, 2);
+    // The right block holds only the last column, repeated
+    EXPECT_NEAR(right[15 * 3], 250, 2);
+
+    std::vector<uint8_t> copy(width * height * 4);
+    compress_bgra_texels(TextureCompression::None, bgra.data(), width * 4, width, height, copy.data());
+    EXPECT_EQ(copy, bgra);
+}
+
+TEST(TextureCompressionTests, NamesRoundTrip) {
+    for (TextureCompression compression : { TextureCompression::None, TextureCompression::Astc4x4,
+                                            TextureCompression::Astc6x6, TextureCompression::Astc8x8,
+                                            TextureCompression::Bc1 }) {
+        TextureCompression parsed = TextureCompression::None;
+        EXPECT_TRUE(parse_texture_compression(texture_compression_name(compression), parsed));
+        EXPECT_EQ(parsed, compression);
+    }
+    TextureCompression unchanged = TextureCompression::Bc1;
+    EXPECT_FALSE(parse_texture_compression("etc2", unchanged));
+    EXPECT_EQ(unchanged, TextureCompression::Bc1);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "tile_farm.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <utility>
+
+#include "terrain_tile_cache.hpp"
+
+namespace {
+    std::string test_directory(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "tile_farm_tests" / name;
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        return dir.string();
+    }
+
+    TileFarmJob test_job(uint32_t workerCount) {
+        TileFarmJob job;
+        job.generatorKey = 0x1234abcd5678ef00ull;
+        job.range = { -5, -3, 6, 4 };
+        job.workerCount = workerCount;
+        job.regionChunks = 4;
+        return job;
+    }
+
+    // Stands in for a worker: every chunk gets a small file of its own bytes
+    void bake_worker(const std::string& store, const TileFarmJob& job, uint32_t worker) {
+        TileFarmManifest manifest;
+        manifest.job = job;
+        manifest.worker = (int32_t)worker;
+        for (ChunkKey key : tile_farm_worker_chunks(job, worker)) {
+            const std::string file = store + "/incoming.tile";
+            std::ofstream(file, std::ios::binary) << "tile " << key.x << " " << key.z;
+            TileFarmEntry entry;
+            ASSERT_TRUE(store_tile_farm_object(store, file, key, entry));
+            manifest.entries.push_back(entry);
+        }
+        const std::string path = tile_farm_partial_manifest_path(store, worker, job.workerCount);
+        ASSERT_TRUE(write_tile_farm_manifest(path, manifest));
+    }
+}
+
+TEST(TileFarmTests, RegionsCoverTheRangeOnce) {
+    const TileFarmJob job = test_job(1);
+    const std::vector<ChunkRange> regions = tile_farm_regions(job);
+    // 12 x 8 chunks in regions of 4: 3 x 2 regions
+    ASSERT_EQ(regions.size(), 6u);
+    uint64_t chunks = 0;
+    for (const ChunkRange& region : regions) {
+        EXPECT_GE(region.minX, job.range.minX);
+        EXPECT_LE(region.maxX, job.range.maxX);
+        chunks += chunk_range_count(region);
+    }
+    EXPECT_EQ(chunks, chunk_range_count(job.range));
+    EXPECT_EQ(chunk_range_count({ 0, 0, -1, 0 }), 0u);
+
+    TileFarmJob clipped = job;
+    clipped.regionChunks = 5;
+    const std::vector<ChunkRange> edges = tile_farm_regions(clipped);
+    ASSERT_EQ(edges.size(), 6u);
+    EXPECT_EQ(edges[2].maxX, job.range.maxX);
+    EXPECT_EQ(edges[2].minX, 5);
+}
+
+TEST(TileFarmTests, WorkersShareTheRegionsEvenly) {
+    TileFarmJob job = test_job(4);
+    job.range = { 0, 0, 63, 63 }; // 256 regions
+    std::set<std::pair<int32_t, int32_t>> all;
+    for (uint32_t worker = 0; worker < job.workerCount; ++worker) {
+        const std::vector<ChunkKey> keys = tile_farm_worker_chunks(job, worker);
+        EXPECT_EQ(keys.size(), 64u * 16);
+        for (ChunkKey key : keys) {
+            EXPECT_TRUE(all.insert({ key.x, key.z }).second);
+        }
+    }
+    EXPECT_EQ(all.size(), chunk_range_count(job.range));
+
+    // Deterministic for a generator, reshuffled by another
+    const std::vector<uint32_t> workers = tile_farm_region_workers(job);
+    EXPECT_EQ(tile_farm_region_workers(job), workers);
+    job.generatorKey ^= 1;
+    EXPECT_NE(tile_farm_region_workers(job), workers);
+}
+
+TEST(TileFarmTests, ManifestsRoundTrip) {
+    const std::string dir = test_directory("manifest");
+    TileFarmManifest manifest;
+    manifest.job = test_job(3);
+    manifest.worker = 2;
+    manifest.entries.push_back({ { -5, 4 }, 0xfedcba9876543210ull, 16384 });
+    manifest.entries.push_back({ { 6, -3 }, 0x1ull, 12 });
+    ASSERT_TRUE(write_tile_farm_manifest(dir + "/m.json", manifest));
+
+    TileFarmManifest read;
+    std::string error;
+    ASSERT_TRUE(read_tile_farm_manifest(dir + "/m.json", read, error)) << error;
+    EXPECT_EQ(read.job.generatorKey, manifest.job.generatorKey);
+    EXPECT_EQ(read.job.range.minX, -5);
+    EXPECT_EQ(read.job.range.maxZ, 4);
+    EXPECT_EQ(read.job.workerCount, 3u);
+    EXPECT_EQ(read.job.regionChunks, 4);
+    EXPECT_EQ(read.worker, 2);
+    ASSERT_EQ(read.entries.size(), 2u);
+    EXPECT_EQ(read.entries[0].key.x, -5);
+    EXPECT_EQ(read.entries[0].contentHash, 0xfedcba9876543210ull);
+    EXPECT_EQ(read.entries[1].size, 12u);
+
+    std::ofstream(dir + "/bad.json") << "{\"generator\": 5}";
+    EXPECT_FALSE(read_tile_farm_manifest(dir + "/bad.json", read, error));
+}
+
+TEST(TileFarmTests, ObjectsAreNamedByTheirContents) {
+    const std::string store = test_directory("objects");
+    TileFarmEntry first, second;
+    std::ofstream(store + "/a.tile", std::ios::binary) << "same bytes";
+    ASSERT_TRUE(store_tile_farm_object(store, store + "/a.tile", { 1, 2 }, first));
+    std::ofstream(store + "/b.tile", std::ios::binary) << "same bytes";
+    ASSERT_TRUE(store_tile_farm_object(store, store + "/b.tile", { 1, 2 }, second));
+    EXPECT_EQ(first.contentHash, second.contentHash);
+    EXPECT_EQ(first.size, 10u);
+    EXPECT_TRUE(std::filesystem::exists(tile_farm_object_path(store, first.contentHash)));
+    EXPECT_FALSE(std::filesystem::exists(store + "/b.tile"));
+}
+
+TEST(TileFarmTests, MergeChecksEveryChunkAndInstallLinksThem) {
+    const std::string store = test_directory("merge");
+    const TileFarmJob job = test_job(3);
+    bake_worker(store, job, 0);
+    bake_worker(store, job, 1);
+
+    TileFarmManifest merged;
+    std::string error;
+    EXPECT_FALSE(merge_tile_farm(store, 3, merged, error)); // Worker 2 has not finished
+    bake_worker(store, job, 2);
+    ASSERT_TRUE(merge_tile_farm(store, 3, merged, error)) << error;
+    ASSERT_EQ(merged.entries.size(), chunk_range_count(job.range));
+    EXPECT_EQ(merged.worker, -1);
+    EXPECT_EQ(merged.entries[0].key.x, job.range.minX);
+    EXPECT_EQ(merged.entries[0].key.z, job.range.minZ);
+
+    TileFarmManifest read;
+    ASSERT_TRUE(read_tile_farm_manifest(tile_farm_manifest_path(store), read, error)) << error;
+    EXPECT_EQ(read.entries.size(), merged.entries.size());
+
+    const std::string cache = test_directory("cache");
+    ASSERT_TRUE(install_tile_farm(store, merged, cache, error)) << error;
+    const std::string tile = terrain_tile_path(terrain_tile_directory(cache, job.generatorKey), { -5, -3 });
+    std::ifstream in(tile);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(contents, "tile -5 -3");
+
+    // A worker that skipped a chunk fails the merge
+    TileFarmManifest partial;
+    const std::string path = tile_farm_partial_manifest_path(store, 1, 3);
+    ASSERT_TRUE(read_tile_farm_manifest(path, partial, error));
+    partial.entries.pop_back();
+    ASSERT_TRUE(write_tile_farm_manifest(path, partial));
+    EXPECT_FALSE(merge_tile_farm(store, 3, merged, error));
+    EXPECT_NE(error.find("not baked"), std::string::npos) << error;
+
+    // And one that lists another's chunk too
+    partial.entries.push_back(merged.entries[0]);
+    partial.entries.push_back(merged.entries[0]);
+    ASSERT_TRUE(write_tile_farm_manifest(path, partial));
+    EXPECT_FALSE(merge_tile_farm(store, 3, merged, error));
+    EXPECT_NE(error.find("twice"), std::string::npos) << error;
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "transform_graph.hpp"
+#include "camera.hpp"
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    simd::float3 world_position(const TransformGraph& graph, TransformNode node) {
+        return affine_translation_of(graph.world[transform_graph_position(graph, node)]);
+    }
+}
+
+TEST(TransformGraphTests, ChildrenFollowTheirParent) {
+    SceneStore scene;
+    TransformGraph graph;
+    Entity trunk = scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 0.0f, 0.0f), { 1.0f, 0.0f, 0.0f });
+
+    TransformNode tree = transform_graph_create(graph, {}, affine_translation(5.0f, 0.0f, 0.0f));
+    TransformNode trunkNode = transform_graph_create(graph, tree, affine_translation(0.0f, 1.0f, 0.0f), trunk);
+    TransformNode leaves = transform_graph_create(graph, trunkNode, affine_translation(0.0f, 1.5f, 0.0f));
+    EXPECT_EQ(transform_graph_update(graph, scene), 3u);
+
+    EXPECT_FLOAT_EQ(world_position(graph, leaves).x, 5.0f);
+    EXPECT_FLOAT_EQ(world_position(graph, leaves).y, 2.5f);
+    EXPECT_FLOAT_EQ(scene.transforms[scene_index(scene, trunk)].columns[3].x, 5.0f);
+
+    // Nothing moved: nothing is recomputed
+    EXPECT_EQ(transform_graph_update(graph, scene), 0u);
+
+    transform_graph_set_local(graph, tree, affine_translation(-2.0f, 0.0f, 0.0f));
+    EXPECT_EQ(transform_graph_update(graph, scene), 3u);
+    EXPECT_FLOAT_EQ(world_position(graph, leaves).x, -2.0f);
+    EXPECT_FLOAT_EQ(scene.transforms[scene_index(scene, trunk)].columns[3].x, -2.0f);
+    // The entity's bounds follow on the scene's own pass
+    EXPECT_EQ(scene_update_bounds(scene), 1u);
+    EXPECT_FLOAT_EQ(scene.worldBounds.centerX[scene_index(scene, trunk)], -2.0f);
+}
+
+TEST(TransformGraphTests, OnlyTheChangedSubtreeIsRecomputed) {
+    SceneStore scene;
+    TransformGraph graph;
+    TransformNode a = transform_graph_create(graph, {}, affine_translation(1.0f, 0.0f, 0.0f));
+    TransformNode b = transform_graph_create(graph, {}, affine_translation(2.0f, 0.0f, 0.0f));
+    TransformNode a1 = transform_graph_create(graph, a, affine_translation(0.0f, 1.0f, 0.0f));
+    TransformNode b1 = transform_graph_create(graph, b, affine_translation(0.0f, 1.0f, 0.0f));
+    TransformNode b2 = transform_graph_create(graph, b1, affine_translation(0.0f, 1.0f, 0.0f));
+    transform_graph_update(graph, scene);
+
+    // Breadth-first: both roots, then both children, then the grandchild
+    EXPECT_EQ(transform_graph_position(graph, a), 0u);
+    EXPECT_EQ(transform_graph_position(graph, b), 1u);
+    EXPECT_EQ(transform_graph_position(graph, b2), 4u);
+
+    transform_graph_set_local(graph, b1, affine_translation(0.0f, 3.0f, 0.0f));
+    EXPECT_EQ(transform_graph_update(graph, scene), 2u);
+    EXPECT_FLOAT_EQ(world_position(graph, b2).y, 4.0f);
+    EXPECT_FLOAT_EQ(world_position(graph, a1).y, 1.0f);
+}
+
+TEST(TransformGraphTests, DestroyRemovesTheSubtreeAndKeepsOtherHandles) {
+    SceneStore scene;
+    TransformGraph graph;
+    TransformNode a = transform_graph_create(graph, {}, affine_translation(1.0f, 0.0f, 0.0f));
+    TransformNode b = transform_graph_create(graph, {}, affine_translation(2.0f, 0.0f, 0.0f));
+    TransformNode a1 = transform_graph_create(graph, a, affine_translation(0.0f, 1.0f, 0.0f));
+    TransformNode b1 = transform_graph_create(graph, b, affine_translation(0.0f, 1.0f, 0.0f));
+    TransformNode a2 = transform_graph_create(graph, a1, affine_translation(0.0f, 1.0f, 0.0f));
+
+    transform_graph_destroy(graph, a);
+    EXPECT_EQ(graph.size(), 2u);
+    EXPECT_EQ(transform_graph_position(graph, a1), UINT32_MAX);
+    EXPECT_EQ(transform_graph_position(graph, a2), UINT32_MAX);
+    ASSERT_EQ(graph.levelEnds.size(), 2u);
+
+    transform_graph_update(graph, scene);
+    EXPECT_FLOAT_EQ(world_position(graph, b1).x, 2.0f);
+    EXPECT_FLOAT_EQ(world_position(graph, b1).y, 1.0f);
+
+    // A stale parent is refused
+    EXPECT_EQ(transform_graph_create(graph, a1, affine_translation(0.0f, 0.0f, 0.0f)).index, UINT32_MAX);
+}
+
+TEST(TransformGraphTests, MovingAParentMarksItsChildrenForUpload) {
+    SceneStore scene;
+    TransformGraph graph;
+    Entity entities[4];
+    for (int i = 0; i < 4; ++i) {
+        entities[i] = scene_create(scene, 0, UNIT_BOX, matrix_translation(0.0f, 0.0f, 0.0f), { 1.0f, 1.0f, 1.0f });
+    }
+    // The cart carries a crate, which carries a lamp; the post stands on its own
+    TransformNode cart = transform_graph_create(graph, {}, affine_translation(0.0f, 0.0f, 0.0f), entities[0]);
+    TransformNode crate = transform_graph_create(graph, cart, affine_translation(0.0f, 1.0f, 0.0f), entities[2]);
+    transform_graph_create(graph, crate, affine_translation(0.0f, 1.0f, 0.0f), entities[3]);
+    transform_graph_create(graph, {}, affine_translation(4.0f, 0.0f, 0.0f), entities[1]);
+    transform_graph_update(graph, scene);
+    std::vector<SceneRange> ranges;
+    scene_take_instance_ranges(scene, 0, ranges);
+
+    // Only the cart's own transform changes, but its whole subtree is written to the scene
+    transform_graph_set_local(graph, cart, affine_translation(-3.0f, 0.0f, 0.0f));
+    transform_graph_update(graph, scene);
+    EXPECT_EQ(scene_take_instance_ranges(scene, 0, ranges), 3u);
+    ASSERT_EQ(ranges.size(), 2u);
+    EXPECT_EQ(ranges[0].first, scene_index(scene, entities[0]));
+    EXPECT_EQ(ranges[0].count, 1u);
+    EXPECT_EQ(ranges[1].first, scene_index(scene, entities[2]));
+    EXPECT_EQ(ranges[1].count, 2u);
+    EXPECT_FLOAT_EQ(scene.transforms[scene_index(scene, entities[3])].columns[3].x, -3.0f);
+}
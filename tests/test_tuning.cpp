@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "tuning.hpp"
+
+#include <string>
+
+TEST(TuningTests, StagedValuesLandOnlyAtApply) {
+    float lodBias = 1.0f;
+    int32_t resolution = 2048;
+    bool shadows = true;
+    TuningRegistry tuning;
+    const uint32_t bias = tuning.add("Terrain", "LOD bias", &lodBias, 0.5f, 4.0f);
+    const uint32_t size = tuning.add("Shadows", "Shadow resolution", &resolution, 512, 4096);
+    const uint32_t enabled = tuning.add("Shadows", "Shadows", &shadows);
+    EXPECT_EQ(tuning.find("Shadow resolution"), size);
+    EXPECT_EQ(tuning.find("Missing"), TuningRegistry::NONE);
+
+    tuning.set(bias, 9.0);
+    tuning.set(size, 1000.4);
+    EXPECT_TRUE(tuning.pending());
+    EXPECT_FLOAT_EQ(lodBias, 1.0f);
+
+    EXPECT_EQ(tuning.apply(), 2u);
+    EXPECT_FLOAT_EQ(lodBias, 4.0f);
+    EXPECT_EQ(resolution, 1000);
+    EXPECT_TRUE(tuning.changed(bias));
+    EXPECT_FALSE(tuning.changed(enabled));
+    EXPECT_FALSE(tuning.pending());
+
+    // Nothing staged, so nothing is written, even over a target the code moved itself
+    lodBias = 2.0f;
+    EXPECT_EQ(tuning.apply(), 0u);
+    EXPECT_FALSE(tuning.changed(bias));
+    EXPECT_FLOAT_EQ(lodBias, 2.0f);
+
+    tuning.reset();
+    tuning.apply();
+    EXPECT_FLOAT_EQ(lodBias, 1.0f);
+    EXPECT_EQ(resolution, 2048);
+}
+
+TEST(TuningTests, JsonRoundTripsAndSkipsUnknownNames) {
+    float scale = 0.8f;
+    int32_t octaves = 5;
+    bool flag = false;
+    TuningRegistry saved;
+    saved.add("Rendering", "Render scale", &scale, 0.25f, 1.0f);
+    saved.add("Terrain", "Noise octaves", &octaves, 1, 16, true);
+    saved.add("Rendering", "Flag", &flag);
+    saved.set(0, 0.3f);
+    saved.set(1, 7.0);
+    saved.set(2, 1.0);
+
+    float loadedScale = 1.0f;
+    int32_t loadedOctaves = 5;
+    bool loadedFlag = false;
+    TuningRegistry loaded;
+    loaded.add("Rendering", "Render scale", &loadedScale, 0.25f, 1.0f);
+    loaded.add("Terrain", "Noise octaves", &loadedOctaves, 1, 16, true);
+    loaded.add("Rendering", "Flag", &loadedFlag);
+    std::string error;
+    ASSERT_TRUE(loaded.from_json(saved.to_json(), error)) << error;
+    loaded.apply();
+    EXPECT_EQ(loadedScale, 0.3f);
+    EXPECT_EQ(loadedOctaves, 7);
+    EXPECT_TRUE(loadedFlag);
+
+    // Unknown names are skipped and values out of range clamped
+    ASSERT_TRUE(loaded.from_json(R"({ "Old knob": 3, "Noise octaves": 40, "Render scale": "high" })", error));
+    loaded.apply();
+    EXPECT_EQ(loadedOctaves, 16);
+    EXPECT_EQ(loadedScale, 0.3f);
+
+    EXPECT_FALSE(loaded.from_json("[1, 2]", error));
+    EXPECT_FALSE(error.empty());
+}
@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "ui_refresh.hpp"
+
+TEST(UiRefreshTests, FirstFrameAndResizesLayOut) {
+    UiRefresh refresh;
+    EXPECT_TRUE(ui_refresh_due(refresh, 0.0, false, 1280, 720));
+    ui_refresh_laid_out(refresh, 0.0, false, 1280, 720);
+    EXPECT_FALSE(ui_refresh_due(refresh, 0.01, false, 1280, 720));
+    EXPECT_TRUE(ui_refresh_due(refresh, 0.01, false, 1920, 1080));
+}
+
+TEST(UiRefreshTests, IdleUiRefreshesOnlyForTheStats) {
+    UiRefresh refresh;
+    ui_refresh_laid_out(refresh, 10.0, false, 800, 600);
+    uint32_t layouts = 0;
+    // One second at 120 frames a second
+    for (int frame = 1; frame <= 120; ++frame) {
+        const double now = 10.0 + frame / 120.0;
+        if (ui_refresh_due(refresh, now, false, 800, 600)) {
+            ui_refresh_laid_out(refresh, now, false, 800, 600);
+            ++layouts;
+        }
+    }
+    EXPECT_EQ(layouts, (uint32_t)(1.0 / UI_REFRESH_SECONDS));
+}
+
+TEST(UiRefreshTests, InputLaysOutUntilTheUiSettles) {
+    UiRefresh refresh;
+    ui_refresh_laid_out(refresh, 0.0, false, 800, 600);
+    EXPECT_TRUE(ui_refresh_due(refresh, 0.001, true, 800, 600));
+    ui_refresh_laid_out(refresh, 0.001, true, 800, 600);
+    for (uint32_t frame = 0; frame < UI_SETTLE_FRAMES; ++frame) {
+        EXPECT_TRUE(ui_refresh_due(refresh, 0.002, false, 800, 600)) << frame;
+        ui_refresh_laid_out(refresh, 0.002, false, 800, 600);
+    }
+    EXPECT_FALSE(ui_refresh_due(refresh, 0.003, false, 800, 600));
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "upload_budget.hpp"
+
+#include <cstdint>
+
+TEST(UploadBudgetTests, AdmitsBatchesUntilTheFrameIsFull) {
+    UploadBudgetSettings settings;
+    settings.bytesPerFrame = 1000;
+    settings.millisecondsPerFrame = 0.0f;
+    UploadBudget budget;
+    upload_budget_begin_frame(budget);
+    EXPECT_TRUE(upload_budget_admit(budget, settings, 400));
+    EXPECT_TRUE(upload_budget_admit(budget, settings, 600));
+    EXPECT_FALSE(upload_budget_admit(budget, settings, 1));
+    EXPECT_EQ(budget.frameBytes, 1000u);
+    EXPECT_EQ(budget.frameBatches, 2u);
+
+    upload_budget_begin_frame(budget);
+    EXPECT_TRUE(upload_budget_admit(budget, settings, 10));
+    EXPECT_FALSE(upload_budget_admit(budget, settings, 991));
+}
+
+TEST(UploadBudgetTests, FirstBatchAlwaysGoes) {
+    UploadBudgetSettings settings;
+    settings.bytesPerFrame = 100;
+    UploadBudget budget;
+    upload_budget_begin_frame(budget);
+    EXPECT_TRUE(upload_budget_admit(budget, settings, 5000));
+    EXPECT_FALSE(upload_budget_admit(budget, settings, 1));
+}
+
+TEST(UploadBudgetTests, TimeLimitUsesTheMeasuredThroughput) {
+    UploadBudgetSettings settings;
+    settings.bytesPerFrame = 0;
+    settings.millisecondsPerFrame = 0.5f;
+    settings.smoothing = 0.5f;
+    UploadBudget budget;
+    // Nothing timed yet: no limit
+    EXPECT_EQ(upload_budget_frame_limit(budget, settings), SIZE_MAX);
+
+    upload_budget_measure(budget, settings, 4000, 2.0);
+    EXPECT_DOUBLE_EQ(budget.bytesPerMs, 2000.0);
+    EXPECT_EQ(upload_budget_frame_limit(budget, settings), 1000u);
+
+    upload_budget_measure(budget, settings, 4000, 1.0);
+    EXPECT_DOUBLE_EQ(budget.bytesPerMs, 3000.0);
+    upload_budget_measure(budget, settings, 4000, 0.0); // Untimed batches are ignored
+    EXPECT_DOUBLE_EQ(budget.bytesPerMs, 3000.0);
+
+    // The lower of the two limits wins
+    settings.bytesPerFrame = 800;
+    EXPECT_EQ(upload_budget_frame_limit(budget, settings), 800u);
+}
+
+TEST(UploadBudgetTests, SlicesTextureRows) {
+    EXPECT_EQ(upload_slice_rows(256, 1024, 64 * 1024), 256u);
+    EXPECT_EQ(upload_slice_rows(256, 100, 64 * 1024), 100u);
+    EXPECT_EQ(upload_slice_rows(100000, 10, 64 * 1024), 1u);
+    EXPECT_EQ(upload_slice_rows(256, 1024, 0), 1024u);
+}
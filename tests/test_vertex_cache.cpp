@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include "landscape.hpp"
+#include "terrain_lod.hpp"
+#include "vertex_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace {
+    // Triangles rotated to start at their smallest index, so reordering can be compared as a multiset
+    std::vector<std::array<uint32_t, 3>> canonical_triangles(const std::vector<uint32_t>& indices) {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+}
+
+TEST(VertexCacheTests, KeepsTrianglesAndWinding) {
+    MeshSize size = landscape_mesh_size(40, 40);
+    std::vector<Vertex> vertices(size.vertexCount);
+    std::vector<uint32_t> indices(size.indexCount);
+    build_landscape(40, 40, vertices.data(), indices.data());
+
+    std::vector<uint32_t> optimized = indices;
+    optimize_vertex_cache(optimized.data(), optimized.size(), vertices.size());
+    EXPECT_EQ(canonical_triangles(optimized), canonical_triangles(indices));
+}
+
+TEST(VertexCacheTests, ReducesAcmrOfRowMajorGrid) {
+    const uint32_t n = 256;
+    std::vector<uint32_t> indices;
+    for (uint32_t z = 0; z < n - 1; ++z) {
+        for (uint32_t x = 0; x < n - 1; ++x) {
+            uint32_t i0 = z * n + x;
+            indices.insert(indices.end(), { i0, i0 + n, i0 + 1, i0 + 1, i0 + n, i0 + n + 1 });
+        }
+    }
+
+    float before = vertex_cache_acmr(indices.data(), indices.size(), n * n);
+    optimize_vertex_cache(indices.data(), indices.size(), n * n);
+    float after = vertex_cache_acmr(indices.data(), indices.size(), n * n);
+
+    EXPECT_GT(before, 0.9f);
+    EXPECT_LT(after, 0.75f);
+}
+
+TEST(VertexCacheTests, GeneratedTerrainIsStriped) {
+    MeshData landscape = create_landscape(256, 256);
+    EXPECT_LT(vertex_cache_acmr(landscape.indices, landscape.vertices.size()), 0.6f);
+}
+
+TEST(VertexCacheTests, AcmrOfIsolatedTrianglesIsThree) {
+    std::vector<uint32_t> indices = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+    EXPECT_FLOAT_EQ(vertex_cache_acmr(indices.data(), indices.size(), 9), 3.0f);
+}
+
+TEST(VertexCacheTests, LodRangesAreOptimized) {
+    TerrainLodIndices lod = build_terrain_lod_indices(65);
+    const IndexRange& range = lod.range(0, 0);
+    float acmr = vertex_cache_acmr(lod.indices.data() + range.offset, range.count, 65 * 65);
+    EXPECT_LT(acmr, 0.8f);
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+#include "landscape.hpp"
+#include "vertex_packing.hpp"
+
+#include <cmath>
+
+TEST(VertexPackingTests, PackedVertexIsTwelveBytes) {
+    EXPECT_EQ(sizeof(PackedVertex), 12u);
+    EXPECT_EQ(vertex_stride(VertexFormat::Packed), 12u);
+    EXPECT_EQ(vertex_stride(VertexFormat::Float), sizeof(Vertex));
+}
+
+TEST(VertexPackingTests, OctahedralNormalsRoundTrip) {
+    for (int i = 0; i < 256; ++i) {
+        float theta = 0.1f + 2.9f * (i % 16) / 15.0f;
+        float phi = 6.2831853f * (i / 16) / 16.0f;
+        simd::float3 n = { sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta) };
+
+        int16_t encoded[2];
+        encode_octahedral_normal(n, encoded);
+        simd::float3 decoded = decode_octahedral_normal(encoded);
+        EXPECT_GT(simd::dot(n, decoded), 0.99999f) << "theta " << theta << " phi " << phi;
+    }
+}
+
+TEST(VertexPackingTests, TerrainChunkPositionsStayWithinQuantizationStep) {
+    const int res = 33;
+    const float chunkSize = 32.0f;
+    MeshData chunk = create_terrain_chunk(-2, 3, res, chunkSize);
+    QuantizationBox box = terrain_chunk_quantization_box(-2, 3, chunkSize);
+
+    std::vector<PackedVertex> packed(chunk.vertices.size());
+    pack_vertices(chunk.vertices.data(), chunk.vertices.size(), box, packed.data());
+
+    const float tolerance = 0.5f / 65535.0f;
+    for (size_t i = 0; i < packed.size(); ++i) {
+        const Vertex& v = chunk.vertices[i];
+        Vertex u = unpack_vertex(packed[i], box);
+        EXPECT_NEAR(u.position.x, v.position.x, box.extent.x * tolerance + 1e-5f);
+        EXPECT_NEAR(u.position.y, v.position.y, box.extent.y * tolerance + 1e-5f);
+        EXPECT_NEAR(u.position.z, v.position.z, box.extent.z * tolerance + 1e-5f);
+        EXPECT_GT(simd::dot(u.normal, v.normal), 0.9999f);
+    }
+}
+
+TEST(VertexPackingTests, QuantizationMatrixMapsUnitCubeToBox) {
+    QuantizationBox box = { { -4.0f, -2.0f, 8.0f }, { 32.0f, 4.0f, 16.0f } };
+    simd::float4x4 m = quantization_matrix(box);
+    simd::float4 corner = m * simd::float4{ 1.0f, 1.0f, 1.0f, 1.0f };
+    EXPECT_FLOAT_EQ(corner.x, 28.0f);
+    EXPECT_FLOAT_EQ(corner.y, 2.0f);
+    EXPECT_FLOAT_EQ(corner.z, 24.0f);
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "virtual_texture.hpp"
+
+#include <vector>
+
+namespace {
+    // 1024 texels in 128 texel pages: 8x8, 4x4, 2x2 and 1x1 pages, then a tail from level 4
+    VirtualTextureLayout small_layout() {
+        return make_virtual_texture_layout(1024, 128, 128, 4);
+    }
+
+    void request(const VirtualTextureLayout& layout, std::vector<uint32_t>& feedback, const VirtualPage& page) {
+        const uint32_t index = virtual_page_index(layout, page);
+        feedback[index / 32] |= 1u << (index % 32);
+    }
+}
+
+TEST(VirtualTextureTests, LayoutCountsThePagesOfEachSparseLevel) {
+    const VirtualTextureLayout layout = small_layout();
+    EXPECT_EQ(layout.mipCount, 11u);
+    EXPECT_EQ(layout.sparseMips, 4u);
+    EXPECT_EQ(layout.pageCount, 64u + 16u + 4u + 1u);
+    EXPECT_EQ(layout.pageOffset[1], 64u);
+    EXPECT_EQ(layout.pagesX[2], 2u);
+
+    for (uint32_t index = 0; index < layout.pageCount; ++index) {
+        EXPECT_EQ(virtual_page_index(layout, virtual_page_at(layout, index)), index);
+    }
+    const VirtualPage page = virtual_page_at(layout, virtual_page_index(layout, { 1, 3, 2 }));
+    EXPECT_EQ(page.mip, 1u);
+    EXPECT_EQ(page.x, 3u);
+    EXPECT_EQ(page.y, 2u);
+
+    // A tail level reported past the last level leaves every level sparse
+    EXPECT_EQ(make_virtual_texture_layout(256, 128, 64, 99).sparseMips, 9u);
+    const VirtualTextureLayout wide = make_virtual_texture_layout(256, 128, 64, 99);
+    EXPECT_EQ(wide.pagesX[0], 2u);
+    EXPECT_EQ(wide.pagesY[0], 4u);
+    EXPECT_EQ(wide.pagesX[8], 1u);
+}
+
+TEST(VirtualTextureTests, UniformsCarryThePageAddressing) {
+    const VirtualTextureLayout layout = small_layout();
+    const VirtualTextureUniforms uniforms = virtual_texture_uniforms(layout, -10.0f, -20.0f, 64.0f);
+    EXPECT_EQ(uniforms.size, 1024u);
+    EXPECT_EQ(uniforms.sparseMips, 4u);
+    EXPECT_EQ(uniforms.minMipWidth, 8u);
+    EXPECT_EQ(uniforms.minMipHeight, 8u);
+    EXPECT_EQ(uniforms.pageOffset[3], 84u);
+    EXPECT_EQ(uniforms.pagesX[1], 4u);
+}
+
+TEST(VirtualTextureTests, RequestsLoadAncestorsCoarsestFirst) {
+    const VirtualTextureLayout layout = small_layout();
+    VirtualTextureCache cache(layout, 100);
+    std::vector<uint32_t> feedback(virtual_texture_feedback_words(layout), 0);
+    request(layout, feedback, { 0, 5, 6 });
+
+    VirtualTextureUpdate update;
+    cache.update(feedback.data(), 1, 100, update);
+    ASSERT_EQ(update.loads.size(), 4u);
+    EXPECT_TRUE(update.evictions.empty());
+    EXPECT_TRUE(update.minMipChanged);
+    EXPECT_EQ(update.loads[0], virtual_page_index(layout, { 3, 0, 0 }));
+    EXPECT_EQ(update.loads[1], virtual_page_index(layout, { 2, 1, 1 }));
+    EXPECT_EQ(update.loads[2], virtual_page_index(layout, { 1, 2, 3 }));
+    EXPECT_EQ(update.loads[3], virtual_page_index(layout, { 0, 5, 6 }));
+    EXPECT_EQ(cache.resident_count(), 4u);
+
+    // Nothing changes while the same page is asked for
+    cache.update(feedback.data(), 2, 100, update);
+    EXPECT_TRUE(update.loads.empty());
+    EXPECT_FALSE(update.minMipChanged);
+}
+
+TEST(VirtualTextureTests, LoadsPerUpdateAreLimited) {
+    const VirtualTextureLayout layout = small_layout();
+    VirtualTextureCache cache(layout, 100);
+    std::vector<uint32_t> feedback(virtual_texture_feedback_words(layout), 0);
+    request(layout, feedback, { 0, 0, 0 });
+    request(layout, feedback, { 0, 7, 7 });
+
+    VirtualTextureUpdate update;
+    cache.update(feedback.data(), 1, 3, update);
+    ASSERT_EQ(update.loads.size(), 3u);
+    // The root and the level 2 pages above both requests come before any finer page
+    EXPECT_EQ(update.loads[0], virtual_page_index(layout, { 3, 0, 0 }));
+    EXPECT_EQ(virtual_page_at(layout, update.loads[1]).mip, 2u);
+    EXPECT_EQ(virtual_page_at(layout, update.loads[2]).mip, 2u);
+
+    cache.update(feedback.data(), 2, 100, update);
+    EXPECT_EQ(update.loads.size(), 4u);
+    EXPECT_EQ(cache.resident_count(), 7u);
+}
+
+TEST(VirtualTextureTests, FullBudgetEvictsTheLeastRecentlyUsed) {
+    const VirtualTextureLayout layout = small_layout();
+    VirtualTextureCache cache(layout, 5);
+    std::vector<uint32_t> feedback(virtual_texture_feedback_words(layout), 0);
+    VirtualTextureUpdate update;
+
+    request(layout, feedback, { 0, 0, 0 });
+    cache.update(feedback.data(), 1, 100, update);
+    ASSERT_EQ(cache.resident_count(), 4u);
+
+    // A neighbour in another level 1 page needs two pages; one fits, so the oldest unused page goes
+    std::fill(feedback.begin(), feedback.end(), 0);
+    request(layout, feedback, { 0, 2, 0 });
+    cache.update(feedback.data(), 2, 100, update);
+    ASSERT_EQ(update.loads.size(), 2u);
+    ASSERT_EQ(update.evictions.size(), 1u);
+    EXPECT_EQ(update.evictions[0], virtual_page_index(layout, { 0, 0, 0 }));
+    EXPECT_EQ(cache.resident_count(), 5u);
+    EXPECT_TRUE(cache.resident(virtual_page_index(layout, { 0, 2, 0 })));
+
+    // Pages used this frame are never evicted: of five missing pages only the one room can be made for loads
+    request(layout, feedback, { 0, 4, 4 });
+    request(layout, feedback, { 0, 6, 6 });
+    cache.update(feedback.data(), 3, 100, update);
+    ASSERT_EQ(update.evictions.size(), 1u);
+    EXPECT_EQ(update.evictions[0], virtual_page_index(layout, { 1, 0, 0 }));
+    ASSERT_EQ(update.loads.size(), 1u);
+    EXPECT_EQ(update.loads[0], virtual_page_index(layout, { 2, 1, 1 }));
+    EXPECT_EQ(cache.resident_count(), 5u);
+}
+
+TEST(VirtualTextureTests, MinMipFollowsTheResidentChain) {
+    const VirtualTextureLayout layout = small_layout();
+    VirtualTextureCache cache(layout, 100);
+    for (uint8_t level : cache.min_mip()) {
+        EXPECT_EQ(level, 4u); // The tail only
+    }
+
+    std::vector<uint32_t> feedback(virtual_texture_feedback_words(layout), 0);
+    request(layout, feedback, { 0, 5, 6 });
+    VirtualTextureUpdate update;
+    cache.update(feedback.data(), 1, 100, update);
+    const std::vector<uint8_t>& minMip = cache.min_mip();
+    ASSERT_EQ(minMip.size(), 64u);
+    EXPECT_EQ(minMip[6 * 8 + 5], 0u);
+    EXPECT_EQ(minMip[6 * 8 + 4], 1u);  // Same level 1 page
+    EXPECT_EQ(minMip[4 * 8 + 4], 2u);  // Same level 2 page
+    EXPECT_EQ(minMip[0], 3u);          // Only the root
+
+    // A page without its parent is no use to the shader
+    VirtualTextureCache orphan(layout, 3);
+    orphan.update(feedback.data(), 1, 3, update);
+    EXPECT_EQ(orphan.min_mip()[6 * 8 + 5], 1u);
+}
+
+TEST(VirtualTextureTests, TexelsFollowTheHeightBands) {
+    const VirtualTextureLayout layout = make_virtual_texture_layout(64, 16, 16, 2);
+    VirtualTextureWorld world;
+    world.originX = -32.0f;
+    world.originZ = -32.0f;
+    world.worldSize = 64.0f;
+
+    std::vector<uint8_t> texels(16 * 16 * 4);
+    generate_virtual_texels(layout, world, 0, 16, 32, 16, 16, texels.data(), 16 * 4);
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < 16; ++x) {
+            const uint8_t* texel = &texels[(y * 16 + x) * 4];
+            ASSERT_EQ(texel[3], 255);
+            const float height = get_terrain_height(-32.0f + 16.5f + x, -32.0f + 32.5f + y, world.terrain);
+            // Snow is white, grass green over red and blue; rock grey lies between
+            if (height < -1.0f) {
+                EXPECT_GE(texel[1], texel[2]);
+            }
+            if (height > 10.0f) {
+                EXPECT_GT(texel[2], 150);
+            }
+        }
+    }
+
+    // A region generated in one call matches the same region generated in parts
+    std::vector<uint8_t> left(8 * 16 * 4), whole(16 * 16 * 4);
+    generate_virtual_texels(layout, world, 1, 0, 0, 16, 16, whole.data(), 16 * 4);
+    generate_virtual_texels(layout, world, 1, 8, 0, 8, 16, left.data(), 8 * 4);
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t i = 0; i < 8 * 4; ++i) {
+            ASSERT_EQ(left[y * 8 * 4 + i], whole[y * 16 * 4 + 8 * 4 + i]);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "volume_terrain.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+    constexpr int CELLS = 16;
+
+    // Features everywhere, at full strength
+    VolumeTerrainSettings everywhere() {
+        VolumeTerrainSettings settings;
+        settings.enabled = true;
+        settings.featureThreshold = -4.0f;
+        settings.featureSoftness = 0.01f;
+        return settings;
+    }
+
+    std::vector<float> rolling_heights(int gridX, int gridZ) {
+        std::vector<float> heights((size_t)(CELLS + 3) * (CELLS + 3));
+        for (int z = 0, i = 0; z < CELLS + 3; ++z) {
+            for (int x = 0; x < CELLS + 3; ++x, ++i) {
+                const float wx = (float)(gridX + x - 1), wz = (float)(gridZ + z - 1);
+                heights[i] = 4.0f * sinf(wx * 0.2f) + 3.0f * cosf(wz * 0.15f);
+            }
+        }
+        return heights;
+    }
+
+    VolumeChunkInput chunk_input(int chunkX, int chunkZ, const std::vector<float>& heights) {
+        VolumeChunkInput input;
+        input.cells = CELLS;
+        input.spacing = 1.0f;
+        input.gridX = chunkX * CELLS;
+        input.gridZ = chunkZ * CELLS;
+        input.origin = { (float)input.gridX, (float)input.gridZ };
+        input.heights = heights.data();
+        return input;
+    }
+}
+
+TEST(VolumeTerrainTests, NoFeaturesLeaveTheHeightField) {
+    VolumeTerrainSettings settings;
+    settings.featureThreshold = 4.0f;
+    EXPECT_EQ(volume_feature_mask(settings, 12.0f, -40.0f), 0.0f);
+    EXPECT_FLOAT_EQ(volume_density(settings, { 1.0f, 7.5f, 2.0f }, 5.0f, 0.0f), 2.5f);
+
+    const std::vector<float> heights = rolling_heights(0, 0);
+    VolumeMesh mesh;
+    EXPECT_FALSE(build_volume_mesh(settings, chunk_input(0, 0, heights), mesh));
+    EXPECT_TRUE(mesh.vertices.empty());
+    EXPECT_TRUE(mesh.indices.empty());
+}
+
+TEST(VolumeTerrainTests, FlatSurfaceMeshesToOneQuadPerCell) {
+    VolumeTerrainSettings settings = everywhere();
+    settings.overhangAmplitude = 0.0f;
+    settings.caveRadius = 0.0f;
+    const std::vector<float> heights((size_t)(CELLS + 3) * (CELLS + 3), 3.25f);
+    VolumeMesh mesh;
+    ASSERT_TRUE(build_volume_mesh(settings, chunk_input(0, 0, heights), mesh));
+    EXPECT_EQ(mesh.indices.size(), (size_t)6 * CELLS * CELLS);
+    for (const Vertex& vertex : mesh.vertices) {
+        EXPECT_NEAR(vertex.position.y, 3.25f, 1e-5f);
+        EXPECT_NEAR(vertex.normal.y, 1.0f, 1e-5f);
+    }
+    EXPECT_GT(mesh.skippedBricks, 0u);
+}
+
+TEST(VolumeTerrainTests, SkippedBricksDoNotChangeTheMesh) {
+    const VolumeTerrainSettings settings = everywhere();
+    const std::vector<float> heights = rolling_heights(CELLS, -2 * CELLS);
+    VolumeMesh sparse, dense;
+    ASSERT_TRUE(build_volume_mesh(settings, chunk_input(1, -2, heights), sparse, true));
+    ASSERT_TRUE(build_volume_mesh(settings, chunk_input(1, -2, heights), dense, false));
+    EXPECT_GT(sparse.skippedBricks, 0u);
+    EXPECT_EQ(dense.skippedBricks, 0u);
+    EXPECT_LT(sparse.bricks, dense.bricks);
+    ASSERT_EQ(sparse.vertices.size(), dense.vertices.size());
+    EXPECT_EQ(sparse.indices, dense.indices);
+    for (size_t i = 0; i < sparse.vertices.size(); ++i) {
+        EXPECT_EQ(sparse.vertices[i].position.y, dense.vertices[i].position.y);
+    }
+}
+
+TEST(VolumeTerrainTests, NeighboursShareTheirBorderVertices) {
+    const VolumeTerrainSettings settings = everywhere();
+    const std::vector<float> leftHeights = rolling_heights(0, 0);
+    const std::vector<float> rightHeights = rolling_heights(CELLS, 0);
+    VolumeMesh left, right;
+    ASSERT_TRUE(build_volume_mesh(settings, chunk_input(0, 0, leftHeights), left));
+    ASSERT_TRUE(build_volume_mesh(settings, chunk_input(1, 0, rightHeights), right));
+
+    // The right chunk's vertices in the cells before its origin are the left chunk's last ones
+    size_t shared = 0;
+    for (const Vertex& vertex : right.vertices) {
+        if (vertex.position.x >= CELLS) {
+            continue;
+        }
+        bool found = false;
+        for (const Vertex& other : left.vertices) {
+            found |= other.position.x == vertex.position.x && other.position.y == vertex.position.y &&
+                     other.position.z == vertex.position.z;
+        }
+        EXPECT_TRUE(found);
+        ++shared;
+    }
+    EXPECT_GT(shared, 0u);
+}
+
+TEST(VolumeTerrainTests, CavesOpenBelowTheSurface) {
+    VolumeTerrainSettings settings = everywhere();
+    settings.overhangAmplitude = 0.0f;
+    settings.caveRadius = 0.5f;
+    // With tunnels this wide, some point a few units under the surface is air
+    int air = 0;
+    for (int i = 0; i < 200; ++i) {
+        air += volume_density(settings, { 3.0f * i, -4.0f, 1.7f * i }, 0.0f, 1.0f) > 0.0f;
+    }
+    EXPECT_GT(air, 0);
+    // Below caveDepth the ground is solid again
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_LT(volume_density(settings, { 3.0f * i, -settings.caveDepth - 1.0f, 1.7f * i }, 0.0f, 1.0f), 0.0f);
+    }
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "world_origin.hpp"
+#include "camera.hpp"
+
+namespace {
+    constexpr float CHUNK = 32.0f;
+}
+
+TEST(WorldOriginTests, PositionsRoundTripFarFromZero) {
+    // Ten thousand kilometres out, where a float alone would be off by half a metre
+    const double x = 1.0e7 + 0.123;
+    const double z = -1.0e7 - 7.5;
+    const WorldPosition position = world_position_from_double(x, 4.0, z, CHUNK);
+    EXPECT_GE(position.local.x, 0.0f);
+    EXPECT_LT(position.local.x, CHUNK);
+    EXPECT_GE(position.local.z, 0.0f);
+    EXPECT_LT(position.local.z, CHUNK);
+
+    const simd::double3 back = world_position_to_double(position, CHUNK);
+    EXPECT_NEAR(back.x, x, 1e-5);
+    EXPECT_NEAR(back.y, 4.0, 1e-6);
+    EXPECT_NEAR(back.z, z, 1e-5);
+}
+
+TEST(WorldOriginTests, DeltasKeepTheirPrecisionAnywhere) {
+    const WorldPosition a = world_position_from_double(1.0e7 + 0.25, 0.0, 5.0e6, CHUNK);
+    const WorldPosition b = world_position_from_double(1.0e7 - 0.5, 0.0, 5.0e6 + 40.0, CHUNK);
+    const simd::float3 delta = world_position_delta(a, b, CHUNK);
+    EXPECT_NEAR(delta.x, 0.75f, 1e-5f);
+    EXPECT_NEAR(delta.z, -40.0f, 1e-5f);
+
+    // The same two points through plain floats lose the fraction entirely
+    EXPECT_NE((float)(1.0e7 + 0.25) - (float)(1.0e7 - 0.5), 0.75f);
+}
+
+TEST(WorldOriginTests, NormalizingCarriesWholeChunks) {
+    WorldPosition position;
+    position.chunkX = 3;
+    position.chunkZ = -2;
+    position.local = { 70.0f, 1.0f, -5.0f };
+    world_position_normalize(position, CHUNK);
+    EXPECT_EQ(position.chunkX, 5);
+    EXPECT_EQ(position.chunkZ, -3);
+    EXPECT_FLOAT_EQ(position.local.x, 6.0f);
+    EXPECT_FLOAT_EQ(position.local.y, 1.0f);
+    EXPECT_FLOAT_EQ(position.local.z, 27.0f);
+}
+
+TEST(WorldOriginTests, RebasingMovesWholeChunksAndKeepsPositions) {
+    WorldOrigin origin;
+    origin.chunkSize = CHUNK;
+    simd::float3 shift = { 0.0f, 0.0f, 0.0f };
+    EXPECT_FALSE(world_origin_rebase(origin, { 100.0f, 3.0f, -100.0f }, 1024.0f, shift));
+
+    const simd::float3 eye = { 1500.0f, 3.0f, -70.0f };
+    const WorldPosition before = world_origin_absolute(origin, eye);
+    ASSERT_TRUE(world_origin_rebase(origin, eye, 1024.0f, shift));
+    EXPECT_EQ(origin.chunkX, 46);
+    EXPECT_EQ(origin.chunkZ, -3);
+    EXPECT_FLOAT_EQ(shift.x, 46.0f * CHUNK);
+    EXPECT_FLOAT_EQ(shift.y, 0.0f);
+    EXPECT_FLOAT_EQ(shift.z, -3.0f * CHUNK);
+
+    // The same world point, now near zero in float
+    const simd::float3 after = world_origin_relative(origin, before);
+    EXPECT_FLOAT_EQ(after.x, eye.x - shift.x);
+    EXPECT_FLOAT_EQ(after.z, eye.z - shift.z);
+    EXPECT_LT(after.x, CHUNK);
+    EXPECT_LT(after.z, CHUNK);
+}
+
+TEST(WorldOriginTests, CameraRelativeViewMatchesTheTranslatedView) {
+    Camera cam = make_camera(16, 9);
+    cam.position = { 12.0f, 5.0f, -8.0f };
+    cam.yaw = 0.7f;
+    cam.pitch = -0.3f;
+    update_camera_view(cam);
+
+    // Moving a point by -eye and then rotating it is the ordinary view transform
+    const simd::float3 point = { 20.0f, 1.0f, -30.0f };
+    const simd::float4 expected = cam.viewMatrix * simd::float4{ point.x, point.y, point.z, 1.0f };
+    const simd::float3 relative = point - cam.position;
+    const simd::float4 actual =
+        matrix_camera_relative_view(cam.yaw, cam.pitch) * simd::float4{ relative.x, relative.y, relative.z, 1.0f };
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_NEAR(actual[i], expected[i], 1e-4f);
+    }
+}
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include "camera.hpp"
+#include "world_save.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+    const BoundingBox UNIT_BOX = { { -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f } };
+
+    std::string test_path(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "world_save_tests";
+        std::filesystem::create_directories(dir);
+        return (dir / name).string();
+    }
+
+    std::vector<char> file_bytes(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // A scene with holes in its handle table and an entity moved after creation
+    SceneStore sample_scene(std::vector<Entity>& kept) {
+        SceneStore scene;
+        std::vector<Entity> all;
+        for (int i = 0; i < 12; ++i) {
+            all.push_back(scene_create(scene, (uint32_t)i % 3, UNIT_BOX, matrix_translation(i * 3.0f, 0.0f, 1.0f),
+                                       { 0.1f * i, 0.5f, 1.0f }));
+        }
+        scene_destroy(scene, all[2]);
+        scene_destroy(scene, all[7]);
+        scene_set_transform(scene, all[5], matrix_translation(-20.0f, 4.0f, 2.0f));
+        scene_update_bounds(scene);
+        for (size_t i = 0; i < all.size(); ++i) {
+            if (i != 2 && i != 7) {
+                kept.push_back(all[i]);
+            }
+        }
+        return scene;
+    }
+
+    TerrainEdits sample_edits() {
+        TerrainEdits edits(0.5f, 100.0f);
+        TerrainBrush brush;
+        brush.centerX = 3.0f;
+        brush.radius = 2.0f;
+        const TerrainGridRect rect = edits.brush_rect(brush);
+        edits.apply(brush, std::vector<float>((size_t)rect.width() * rect.depth(), 1.0f).data());
+        return edits;
+    }
+
+    CameraPose sample_camera() {
+        CameraPose camera;
+        camera.position = { 1.0f, 2.0f, 3.0f };
+        camera.yaw = 0.5f;
+        camera.pitch = -0.25f;
+        return camera;
+    }
+}
+
+TEST(WorldSaveTests, RestoresTheSceneWithItsHandlesCameraAndEdits) {
+    std::vector<Entity> kept;
+    const SceneStore scene = sample_scene(kept);
+    const TerrainEdits edits = sample_edits();
+    WorldSaveState state;
+    world_save_capture(scene, sample_camera(), edits, state);
+    const std::string path = test_path("restore.save");
+    ASSERT_TRUE(write_world_save(path, state));
+    EXPECT_EQ(std::filesystem::file_size(path), world_save_file_size(state));
+
+    WorldSaveFile file;
+    ASSERT_TRUE(map_world_save(path, file));
+    SceneStore restored;
+    world_save_restore_scene(file, restored);
+    ASSERT_EQ(restored.size(), scene.size());
+    for (Entity entity : kept) {
+        const uint32_t a = scene_index(scene, entity);
+        const uint32_t b = scene_index(restored, entity);
+        ASSERT_EQ(a, b);
+        EXPECT_EQ(restored.meshes[b], scene.meshes[a]);
+        EXPECT_EQ(restored.colors[b].x, scene.colors[a].x);
+        EXPECT_EQ(restored.transforms[b].columns[3].x, scene.transforms[a].columns[3].x);
+        EXPECT_EQ(restored.worldBounds.centerY[b], scene.worldBounds.centerY[a]);
+    }
+    // The hierarchy came along: queries work at once, and new entities reuse the freed slots
+    std::vector<Entity> found;
+    scene_query_box(restored, { { -21.0f, 3.0f, 1.0f }, { -19.0f, 5.0f, 3.0f } }, found);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].index, kept[4].index);
+    // Every restored instance is uploaded, as one range
+    std::vector<SceneRange> ranges;
+    EXPECT_EQ(scene_take_instance_ranges(restored, 0, ranges), restored.size());
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].first, 0u);
+    EXPECT_EQ(ranges[0].count, (uint32_t)restored.size());
+    const Entity added = scene_create(restored, 0, UNIT_BOX, matrix_translation(0.0f, 9.0f, 0.0f), {});
+    EXPECT_EQ(added.index, 7u);
+    EXPECT_EQ(added.generation, 1u);
+    scene_set_color(restored, kept[0], { 0.0f, 1.0f, 0.0f });
+    EXPECT_EQ(scene_take_instance_ranges(restored, 0, ranges), 2u);
+    EXPECT_EQ(restored.instanceFlags.size(), restored.size());
+
+    const CameraPose camera = world_save_camera(file);
+    EXPECT_EQ(camera.position.z, 3.0f);
+    EXPECT_EQ(camera.pitch, -0.25f);
+    EXPECT_EQ(file.header.terrainSpacing, 0.5f);
+    TerrainEdits loaded(0.5f, 100.0f);
+    loaded.assign(world_save_terrain_edits(file), file.header.sections[WORLD_SAVE_TERRAIN_EDITS].count);
+    ASSERT_EQ(loaded.size(), edits.size());
+    EXPECT_EQ(loaded.offset(6, 0), edits.offset(6, 0));
+    EXPECT_GT(loaded.offset(6, 0), 0.0f);
+    unmap_world_save(file);
+}
+
+TEST(WorldSaveTests, EqualWorldsGiveEqualFiles) {
+    std::vector<Entity> kept;
+    const SceneStore scene = sample_scene(kept);
+    // The same edits made in another order
+    const TerrainEdits edits = sample_edits();
+    std::vector<TerrainEditPoint> points;
+    edits.points(points);
+    std::vector<TerrainEditPoint> reversed(points.rbegin(), points.rend());
+    TerrainEdits shuffled(0.5f, 100.0f);
+    shuffled.assign(reversed.data(), reversed.size());
+
+    WorldSaveState first;
+    WorldSaveState second;
+    world_save_capture(scene, sample_camera(), edits, first);
+    world_save_capture(scene, sample_camera(), shuffled, second);
+    ASSERT_TRUE(write_world_save(test_path("first.save"), first));
+    ASSERT_TRUE(write_world_save(test_path("second.save"), second));
+    EXPECT_EQ(file_bytes(test_path("first.save")), file_bytes(test_path("second.save")));
+}
+
+TEST(WorldSaveTests, RejectsForeignAndDamagedFiles) {
+    std::vector<Entity> kept;
+    WorldSaveState state;
+    world_save_capture(sample_scene(kept), sample_camera(), sample_edits(), state);
+    const std::string path = test_path("damaged.save");
+    ASSERT_TRUE(write_world_save(path, state));
+    const std::vector<char> bytes = file_bytes(path);
+
+    WorldSaveFile file;
+    EXPECT_FALSE(map_world_save(test_path("missing.save"), file));
+    // Cut short
+    std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size() / 2);
+    EXPECT_FALSE(map_world_save(path, file));
+    // An owner slot pointing past the handle table
+    std::vector<char> damaged = bytes;
+    WorldSaveHeader header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    const uint32_t slot = 1000;
+    memcpy(damaged.data() + header.sections[WORLD_SAVE_OWNERS].offset, &slot, sizeof(slot));
+    std::ofstream(path, std::ios::binary).write(damaged.data(), damaged.size());
+    EXPECT_FALSE(map_world_save(path, file));
+    // Another version
+    damaged = bytes;
+    damaged[offsetof(WorldSaveHeader, version)]++;
+    std::ofstream(path, std::ios::binary).write(damaged.data(), damaged.size());
+    EXPECT_FALSE(map_world_save(path, file));
+}
+
+TEST(WorldSaveTests, CellRoundTripsAndBelongsToItsChunk) {
+    SceneCellObjects objects;
+    for (int i = 0; i < 3; ++i) {
+        objects.transforms.push_back(matrix_translation(i * 2.0f, 1.0f, -3.0f));
+        objects.colors.push_back({ 0.25f * i, 0.5f, 1.0f });
+        objects.meshes.push_back((uint32_t)i);
+        objects.localBounds.push_back(UNIT_BOX);
+    }
+    const std::string path = test_path("cell.cell");
+    ASSERT_TRUE(write_scene_cell(path, { 4, -7 }, objects));
+
+    SceneCellObjects read;
+    ASSERT_TRUE(read_scene_cell(path, { 4, -7 }, read));
+    ASSERT_EQ(read.size(), 3u);
+    EXPECT_EQ(read.meshes, objects.meshes);
+    EXPECT_FLOAT_EQ(read.transforms[2].columns[3].x, 4.0f);
+    EXPECT_FLOAT_EQ(read.colors[1].x, 0.25f);
+    EXPECT_FLOAT_EQ(read.localBounds[0].max.y, 0.5f);
+    EXPECT_FALSE(read_scene_cell(path, { 4, 7 }, read));
+    // Cut short
+    const std::vector<char> bytes = file_bytes(path);
+    std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size() - 1);
+    EXPECT_FALSE(read_scene_cell(path, { 4, -7 }, read));
+}
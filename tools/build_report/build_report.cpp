@@ -0,0 +1,69 @@
+/**
+ * @file build_report.cpp
+ * @brief Offline tool: summarises the clang -ftime-trace profiles of a build.
+ *
+ * Usage: build_report [--top <n>] <trace.json>...
+ *
+ * Prints the total compile time, then the n slowest translation units with their frontend and
+ * backend split, the n headers that cost the most summed over every unit that parsed them, and
+ * the n most expensive template instantiations (see build_trace.hpp). The build_time_report
+ * target runs it over the engine's profiles of a -DENABLE_BUILD_TRACE=ON build.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "build_trace.hpp"
+#include "json.hpp"
+
+namespace {
+    void print_costs(const char* title, const std::vector<BuildTraceCost>& costs, size_t top) {
+        printf("\n%s\n%10s %8s  %s\n", title, "ms", "count", "name");
+        for (size_t i = 0; i < costs.size() && i < top; ++i) {
+            printf("%10.1f %8u  %s\n", costs[i].ms, costs[i].count, costs[i].name.c_str());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t top = 20;
+    std::vector<const char*> traces;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            top = (size_t)atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            traces.clear();
+            break;
+        } else {
+            traces.push_back(argv[i]);
+        }
+    }
+    if (traces.empty()) {
+        fprintf(stderr, "usage: %s [--top <n>] <trace.json>...\n", argv[0]);
+        return 2;
+    }
+
+    BuildTraceReport report;
+    std::string error;
+    for (const char* trace : traces) {
+        JsonValue root;
+        if (!load_json(trace, root, error) || !add_build_trace(root, trace, report, error)) {
+            fprintf(stderr, "%s: %s\n", trace, error.c_str());
+            return 2;
+        }
+    }
+    finish_build_trace(report);
+
+    printf("%zu translation units, %.1f s of compile time\n", report.units.size(), report.totalMs / 1000.0);
+    printf("\nSlowest translation units\n%10s %10s %10s  %s\n", "ms", "frontend", "backend", "name");
+    for (size_t i = 0; i < report.units.size() && i < top; ++i) {
+        const BuildTraceUnit& unit = report.units[i];
+        printf("%10.1f %10.1f %10.1f  %s\n", unit.totalMs, unit.frontendMs, unit.backendMs, unit.name.c_str());
+    }
+    print_costs("Most expensive headers, summed over the units that include them", report.headers, top);
+    print_costs("Most expensive template instantiations", report.templates, top);
+    return 0;
+}
@@ -0,0 +1,20 @@
+# Summarises the -ftime-trace profiles of a -DENABLE_BUILD_TRACE=ON build into REPORT.
+# Invoked by the build_time_report target; see the Build Report section of CMakeLists.txt.
+
+# Clang writes each profile next to its object, named after the source: main.mm.json beside main.mm.o
+file(GLOB_RECURSE TRACES ${TRACE_DIR}/*.cpp.json ${TRACE_DIR}/*.mm.json)
+if (NOT TRACES)
+    message(FATAL_ERROR "No -ftime-trace profiles under ${TRACE_DIR}; configure with -DENABLE_BUILD_TRACE=ON and build")
+endif()
+
+execute_process(
+    COMMAND ${BUILD_REPORT} --top 25 ${TRACES}
+    OUTPUT_FILE ${REPORT}
+    RESULT_VARIABLE RESULT
+)
+if (RESULT)
+    message(FATAL_ERROR "build_report failed: ${RESULT}")
+endif()
+file(READ ${REPORT} SUMMARY)
+message("${SUMMARY}")
+message(STATUS "Wrote ${REPORT}")
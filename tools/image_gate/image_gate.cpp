@@ -0,0 +1,122 @@
+/**
+ * @file image_gate.cpp
+ * @brief Offline tool: compares rendered images with the golden images stored for them.
+ *
+ * Usage: image_gate [--golden <dir>] [--delta-e <difference>] [--max-fraction <fraction>]
+ *                   [--max-mean <difference>] [--diff <dir>] [--update] <image.tga>...
+ *
+ * Each image is compared with <dir>/<image file name> within the perceptual tolerance of
+ * image_gate.hpp. --diff writes a diff image of every failed comparison to <dir>, named after
+ * the image. --update stores the images as the new golden images instead. Exits with 1 if any
+ * image differs by more than the tolerance.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "image_file.hpp"
+#include "image_gate.hpp"
+
+int main(int argc, char** argv) {
+    std::filesystem::path golden = "tests/golden/images";
+    std::filesystem::path diffs;
+    ImageGateSettings settings;
+    bool update = false;
+    std::vector<const char*> images;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            golden = argv[++i];
+        } else if (strcmp(argv[i], "--delta-e") == 0 && i + 1 < argc) {
+            settings.deltaE = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-fraction") == 0 && i + 1 < argc) {
+            settings.maxFraction = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-mean") == 0 && i + 1 < argc) {
+            settings.maxMeanDeltaE = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            diffs = argv[++i];
+        } else if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (argv[i][0] == '-') {
+            images.clear();
+            break;
+        } else {
+            images.push_back(argv[i]);
+        }
+    }
+    if (images.empty()) {
+        fprintf(stderr,
+                "usage: %s [--golden <dir>] [--delta-e <difference>] [--max-fraction <fraction>] "
+                "[--max-mean <difference>] [--diff <dir>] [--update] <image.tga>...\n",
+                argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    for (const char* image : images) {
+        const std::filesystem::path name = std::filesystem::path(image).filename();
+        const std::filesystem::path goldenPath = golden / name;
+        if (update) {
+            std::error_code ec;
+            std::filesystem::create_directories(golden, ec);
+            std::filesystem::copy_file(image, goldenPath, std::filesystem::copy_options::overwrite_existing, ec);
+            if (ec) {
+                fprintf(stderr, "cannot write %s: %s\n", goldenPath.string().c_str(), ec.message().c_str());
+                return 2;
+            }
+            printf("%s: stored as the golden image\n", image);
+            continue;
+        }
+        if (!std::filesystem::exists(goldenPath)) {
+            printf("%s: no golden image yet; run with --update to store one\n", image);
+            continue;
+        }
+
+        std::vector<uint8_t> current, expected;
+        uint32_t width = 0, height = 0, goldenWidth = 0, goldenHeight = 0;
+        std::string error;
+        if (!read_tga(image, current, width, height, error)) {
+            fprintf(stderr, "%s: %s\n", image, error.c_str());
+            return 2;
+        }
+        if (!read_tga(goldenPath.string().c_str(), expected, goldenWidth, goldenHeight, error)) {
+            fprintf(stderr, "%s: %s\n", goldenPath.string().c_str(), error.c_str());
+            return 2;
+        }
+        if (width != goldenWidth || height != goldenHeight) {
+            printf("%s: %ux%u, but the golden image is %ux%u  FAILED\n", image, width, height, goldenWidth,
+                   goldenHeight);
+            ++failures;
+            continue;
+        }
+
+        std::vector<uint8_t> diff;
+        const ImageComparison comparison = compare_images(expected.data(), current.data(), width, height, settings,
+                                                          diffs.empty() ? nullptr : &diff);
+        printf("%s: mean dE %.3f, max dE %.2f, %llu changed pixels (%.3f%%)  %s\n", image, comparison.meanDeltaE,
+               comparison.maxDeltaE, (unsigned long long)comparison.changedPixels,
+               comparison.changedFraction * 100.0f, comparison.passed ? "passed" : "FAILED");
+        if (comparison.passed) {
+            continue;
+        }
+        ++failures;
+        if (!diffs.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(diffs, ec);
+            const std::filesystem::path diffPath = diffs / name;
+            if (!write_tga(diffPath.string().c_str(), diff.data(), width, height, (size_t)width * 4, error)) {
+                fprintf(stderr, "%s: %s\n", diffPath.string().c_str(), error.c_str());
+            }
+        }
+    }
+    if (failures > 0) {
+        printf("%d image(s) differ from their golden image by more than dE %.2f on %.3f%% of the pixels "
+               "or dE %.2f on average\n",
+               failures, settings.deltaE, settings.maxFraction * 100.0f, settings.maxMeanDeltaE);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+# Renders the golden views headless in each renderer configuration and compares them with the golden images.
+# Invoked by the golden_images test (ctest -L golden); see the Golden Images section of CMakeLists.txt.
+# Set GOLDEN_UPDATE in the environment to store the renders as the new golden images instead.
+
+# A fixed seed, so the terrain does not depend on the defaults
+set(COMMON_ARGS --terrain-seed 1337)
+set(CONFIGS forward deferred msaa4 height_maps reverse_z)
+set(forward_ARGS)
+set(deferred_ARGS --deferred)
+set(msaa4_ARGS --msaa 4)
+set(height_maps_ARGS --height-maps)
+set(reverse_z_ARGS --reverse-z)
+
+set(GATE_ARGS)
+if (DEFINED ENV{GOLDEN_UPDATE})
+    list(APPEND GATE_ARGS --update)
+endif()
+
+set(FAILED)
+foreach(CONFIG ${CONFIGS})
+    file(REMOVE_RECURSE ${OUTPUT_DIR}/${CONFIG})
+    file(MAKE_DIRECTORY ${OUTPUT_DIR}/${CONFIG})
+    execute_process(
+        COMMAND ${GLFW_METAL} --headless ${VIEWS} --headless-output ${OUTPUT_DIR}/${CONFIG} ${COMMON_ARGS}
+                ${${CONFIG}_ARGS}
+        OUTPUT_QUIET
+        RESULT_VARIABLE RESULT
+    )
+    if (RESULT)
+        message(FATAL_ERROR "Rendering the ${CONFIG} views failed: ${RESULT}")
+    endif()
+
+    file(GLOB IMAGES ${OUTPUT_DIR}/${CONFIG}/*.tga)
+    list(SORT IMAGES)
+    execute_process(
+        COMMAND ${IMAGE_GATE} --golden ${GOLDEN}/${CONFIG} --diff ${OUTPUT_DIR}/${CONFIG}/diff ${GATE_ARGS} ${IMAGES}
+        RESULT_VARIABLE RESULT
+    )
+    if (RESULT)
+        list(APPEND FAILED ${CONFIG})
+    endif()
+endforeach()
+
+if (FAILED)
+    message(FATAL_ERROR "Golden images differ in: ${FAILED}; the diff images are in ${OUTPUT_DIR}/<config>/diff")
+endif()
@@ -0,0 +1,50 @@
+/**
+ * @file mesh_cooker.cpp
+ * @brief Offline tool: converts OBJ or glTF meshes into the runtime format of mesh_asset.hpp.
+ *
+ * Usage: mesh_cooker [--compress] <input.obj|.gltf|.glb> <output.mesh>
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#include "mesh_asset.hpp"
+#include "mesh_import.hpp"
+#include "vertex_cache.hpp"
+
+int main(int argc, char** argv) {
+    const bool compress = argc == 4 && strcmp(argv[1], "--compress") == 0;
+    if (argc != 3 && !compress) {
+        fprintf(stderr, "usage: %s [--compress] <input.obj|.gltf|.glb> <output.mesh>\n", argv[0]);
+        return 1;
+    }
+    const char* input = argv[argc - 2];
+    const char* output = argv[argc - 1];
+
+    MeshData source;
+    std::string error;
+    if (!import_mesh(input, source, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const float importedAcmr = vertex_cache_acmr(source.indices, source.vertices.size());
+
+    CookedMesh mesh = cook_mesh(std::move(source));
+    if (!write_mesh_asset(output, mesh, compress)) {
+        fprintf(stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    std::error_code sizeError;
+    printf("%s: %zu vertices, %u triangles, %zu meshlets, ACMR %.3f -> %.3f, %zu bytes (%zu uncompressed)\n",
+           output, mesh.vertices.size(), mesh.lods.levels[0].indexCount / 3, mesh.meshlets.size(), importedAcmr,
+           vertex_cache_acmr(mesh.indices, mesh.vertices.size()),
+           (size_t)std::filesystem::file_size(output, sizeError), mesh_asset_file_size(mesh));
+    for (uint32_t i = 1; i < mesh.lods.count; ++i) {
+        const MeshLod& lod = mesh.lods.levels[i];
+        printf("  LOD %u: %u triangles, error %.4f\n", i, lod.indexCount / 3, lod.error);
+    }
+    return 0;
+}
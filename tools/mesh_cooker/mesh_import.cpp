@@ -0,0 +1,568 @@
+#include "mesh_import.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+    bool read_file(const std::string& path, std::vector<uint8_t>& contents) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        contents.resize((size_t)file.tellg());
+        file.seekg(0);
+        return (bool)file.read((char*)contents.data(), contents.size());
+    }
+
+    // Area-weighted face normals summed per position; vertices that share a position share the result
+    void generate_normals(MeshData& mesh, const std::vector<uint32_t>& positionIds, const std::vector<bool>& missing) {
+        uint32_t positionCount = 0;
+        for (uint32_t id : positionIds) positionCount = std::max(positionCount, id + 1);
+        std::vector<simd::float3> sums(positionCount, simd::float3{ 0.0f, 0.0f, 0.0f });
+        const std::vector<uint32_t>& indices = mesh.indices.indices32;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            const simd::float3 a = mesh.vertices[indices[i]].position;
+            const simd::float3 b = mesh.vertices[indices[i + 1]].position;
+            const simd::float3 c = mesh.vertices[indices[i + 2]].position;
+            // The cross product's length is twice the area, which weights the sum
+            const simd::float3 n = simd::cross(b - a, c - a);
+            for (int k = 0; k < 3; ++k) {
+                sums[positionIds[indices[i + k]]] += n;
+            }
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); ++v) {
+            if (!missing[v]) continue;
+            const simd::float3 sum = sums[positionIds[v]];
+            const float length = simd::length(sum);
+            mesh.vertices[v].normal = length > 0.0f ? sum / length : simd::float3{ 0.0f, 1.0f, 0.0f };
+        }
+    }
+
+    void finish_mesh(MeshData& mesh, const std::vector<uint32_t>& positionIds, const std::vector<bool>& missingNormals) {
+        bool anyMissing = false;
+        for (bool missing : missingNormals) anyMissing |= missing;
+        if (anyMissing) {
+            generate_normals(mesh, positionIds, missingNormals);
+        }
+        mesh.bounds = compute_bounds(mesh.vertices.data(), mesh.vertices.size());
+    }
+
+    // ---- OBJ ----
+
+    // Resolves a 1-based or negative (relative) OBJ index; returns -1 if out of range
+    long obj_index(long index, size_t count) {
+        if (index > 0 && (size_t)index <= count) return index - 1;
+        if (index < 0 && (size_t)-index <= count) return (long)count + index;
+        return -1;
+    }
+
+    // ---- glTF ----
+
+    /// A parsed JSON value; just enough of JSON for glTF documents.
+    struct Json {
+        enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+        double number = 0.0;
+        std::string string;
+        std::vector<Json> items;
+        std::vector<std::pair<std::string, Json>> members;
+
+        const Json* find(const char* key) const {
+            for (const auto& member : members) {
+                if (member.first == key) return &member.second;
+            }
+            return nullptr;
+        }
+
+        int integer(const char* key, int fallback) const {
+            const Json* value = find(key);
+            return value && value->type == Number ? (int)value->number : fallback;
+        }
+    };
+
+    class JsonParser {
+    public:
+        JsonParser(const char* begin, const char* end) : m_cursor(begin), m_end(end) {}
+
+        bool parse(Json& value) {
+            if (!parse_value(value, 0)) return false;
+            skip_space();
+            return m_cursor == m_end;
+        }
+
+    private:
+        static constexpr int MAX_DEPTH = 64;
+
+        void skip_space() {
+            while (m_cursor < m_end && (*m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\n' || *m_cursor == '\r')) {
+                ++m_cursor;
+            }
+        }
+
+        bool literal(const char* word) {
+            const size_t length = strlen(word);
+            if ((size_t)(m_end - m_cursor) < length || strncmp(m_cursor, word, length) != 0) return false;
+            m_cursor += length;
+            return true;
+        }
+
+        bool parse_string(std::string& out) {
+            if (m_cursor >= m_end || *m_cursor != '"') return false;
+            ++m_cursor;
+            while (m_cursor < m_end && *m_cursor != '"') {
+                char c = *m_cursor++;
+                if (c != '\\') {
+                    out += c;
+                    continue;
+                }
+                if (m_cursor >= m_end) return false;
+                c = *m_cursor++;
+                switch (c) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (m_end - m_cursor < 4) return false;
+                    const unsigned code = (unsigned)strtoul(std::string(m_cursor, 4).c_str(), nullptr, 16);
+                    m_cursor += 4;
+                    // Names and URIs are ASCII in practice; other code points are kept as UTF-8 without surrogate pairing
+                    if (code < 0x80) {
+                        out += (char)code;
+                    } else if (code < 0x800) {
+                        out += (char)(0xC0 | (code >> 6));
+                        out += (char)(0x80 | (code & 0x3F));
+                    } else {
+                        out += (char)(0xE0 | (code >> 12));
+                        out += (char)(0x80 | ((code >> 6) & 0x3F));
+                        out += (char)(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: out += c; break;
+                }
+            }
+            if (m_cursor >= m_end) return false;
+            ++m_cursor;
+            return true;
+        }
+
+        bool parse_value(Json& value, int depth) {
+            if (depth > MAX_DEPTH) return false;
+            skip_space();
+            if (m_cursor >= m_end) return false;
+            const char c = *m_cursor;
+            if (c == '{') {
+                value.type = Json::Object;
+                ++m_cursor;
+                skip_space();
+                if (m_cursor < m_end && *m_cursor == '}') {
+                    ++m_cursor;
+                    return true;
+                }
+                for (;;) {
+                    std::pair<std::string, Json> member;
+                    skip_space();
+                    if (!parse_string(member.first)) return false;
+                    skip_space();
+                    if (m_cursor >= m_end || *m_cursor++ != ':') return false;
+                    if (!parse_value(member.second, depth + 1)) return false;
+                    value.members.push_back(std::move(member));
+                    skip_space();
+                    if (m_cursor >= m_end) return false;
+                    if (*m_cursor == ',') { ++m_cursor; continue; }
+                    if (*m_cursor == '}') { ++m_cursor; return true; }
+                    return false;
+                }
+            }
+            if (c == '[') {
+                value.type = Json::Array;
+                ++m_cursor;
+                skip_space();
+                if (m_cursor < m_end && *m_cursor == ']') {
+                    ++m_cursor;
+                    return true;
+                }
+                for (;;) {
+                    value.items.emplace_back();
+                    if (!parse_value(value.items.back(), depth + 1)) return false;
+                    skip_space();
+                    if (m_cursor >= m_end) return false;
+                    if (*m_cursor == ',') { ++m_cursor; continue; }
+                    if (*m_cursor == ']') { ++m_cursor; return true; }
+                    return false;
+                }
+            }
+            if (c == '"') {
+                value.type = Json::String;
+                return parse_string(value.string);
+            }
+            if (literal("true")) { value.type = Json::Bool; value.number = 1.0; return true; }
+            if (literal("false")) { value.type = Json::Bool; return true; }
+            if (literal("null")) { value.type = Json::Null; return true; }
+
+            // strtod stops at the end of the number; the document is null-terminated by the caller
+            char* numberEnd = nullptr;
+            value.type = Json::Number;
+            value.number = strtod(m_cursor, &numberEnd);
+            if (numberEnd == m_cursor) return false;
+            m_cursor = numberEnd;
+            return true;
+        }
+
+        const char* m_cursor;
+        const char* m_end;
+    };
+
+    bool decode_base64(const std::string& text, std::vector<uint8_t>& out) {
+        uint32_t bits = 0;
+        int bitCount = 0;
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else if (c == '=') break;
+            else return false;
+            bits = (bits << 6) | (uint32_t)value;
+            bitCount += 6;
+            if (bitCount >= 8) {
+                bitCount -= 8;
+                out.push_back((uint8_t)(bits >> bitCount));
+            }
+        }
+        return true;
+    }
+
+    const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+    const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+    const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+    const int GLTF_BYTE = 5121;
+    const int GLTF_UNSIGNED_SHORT = 5123;
+    const int GLTF_UNSIGNED_INT = 5125;
+    const int GLTF_FLOAT = 5126;
+    const int GLTF_TRIANGLES = 4;
+
+    const Json EMPTY_ARRAY = { Json::Array };
+
+    // The elements of an array member, or none if it is missing
+    const std::vector<Json>& items(const Json& object, const char* key) {
+        const Json* value = object.find(key);
+        return value ? value->items : EMPTY_ARRAY.items;
+    }
+
+    struct GltfDocument {
+        Json json;
+        std::vector<std::vector<uint8_t>> buffers;
+    };
+
+    // Locates the elements of an accessor; element i starts at data + i * stride
+    bool accessor_view(const GltfDocument& doc, int index, int componentType, int components,
+                       const uint8_t*& data, size_t& stride, size_t& count, std::string& error) {
+        const Json* accessors = doc.json.find("accessors");
+        const Json* views = doc.json.find("bufferViews");
+        if (!accessors || index < 0 || (size_t)index >= accessors->items.size() || !views) {
+            error = "accessor " + std::to_string(index) + " does not exist";
+            return false;
+        }
+        const Json& accessor = accessors->items[index];
+        const int viewIndex = accessor.integer("bufferView", -1);
+        if (viewIndex < 0 || (size_t)viewIndex >= views->items.size() || accessor.find("sparse")) {
+            error = "accessor " + std::to_string(index) + " has no buffer view or is sparse";
+            return false;
+        }
+        if (accessor.integer("componentType", 0) != componentType) {
+            error = "accessor " + std::to_string(index) + " has an unsupported component type";
+            return false;
+        }
+        const Json& view = views->items[viewIndex];
+        const int bufferIndex = view.integer("buffer", -1);
+        if (bufferIndex < 0 || (size_t)bufferIndex >= doc.buffers.size()) {
+            error = "buffer view " + std::to_string(viewIndex) + " refers to a missing buffer";
+            return false;
+        }
+        const size_t componentSize = componentType == GLTF_FLOAT || componentType == GLTF_UNSIGNED_INT ? 4
+                                   : componentType == GLTF_UNSIGNED_SHORT ? 2 : 1;
+        const size_t elementSize = componentSize * components;
+        count = (size_t)accessor.integer("count", 0);
+        stride = (size_t)view.integer("byteStride", 0);
+        if (stride == 0) stride = elementSize;
+        const size_t offset = (size_t)view.integer("byteOffset", 0) + (size_t)accessor.integer("byteOffset", 0);
+        const std::vector<uint8_t>& buffer = doc.buffers[bufferIndex];
+        if (count > 0 && offset + (count - 1) * stride + elementSize > buffer.size()) {
+            error = "accessor " + std::to_string(index) + " reads past the end of its buffer";
+            return false;
+        }
+        data = buffer.data() + offset;
+        return true;
+    }
+
+    bool read_float3s(const GltfDocument& doc, int index, std::vector<simd::float3>& out, std::string& error) {
+        const uint8_t* data;
+        size_t stride, count;
+        if (!accessor_view(doc, index, GLTF_FLOAT, 3, data, stride, count, error)) return false;
+        out.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            float v[3];
+            memcpy(v, data + i * stride, sizeof(v));
+            out[i] = simd::float3{ v[0], v[1], v[2] };
+        }
+        return true;
+    }
+
+    bool read_indices(const GltfDocument& doc, int index, std::vector<uint32_t>& out, std::string& error) {
+        const Json* accessors = doc.json.find("accessors");
+        const int componentType = accessors && index >= 0 && (size_t)index < accessors->items.size()
+            ? accessors->items[index].integer("componentType", 0) : 0;
+        if (componentType != GLTF_BYTE && componentType != GLTF_UNSIGNED_SHORT && componentType != GLTF_UNSIGNED_INT) {
+            error = "index accessor " + std::to_string(index) + " is not unsigned integers";
+            return false;
+        }
+        const uint8_t* data;
+        size_t stride, count;
+        if (!accessor_view(doc, index, componentType, 1, data, stride, count, error)) return false;
+        out.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t* element = data + i * stride;
+            if (componentType == GLTF_BYTE) {
+                out[i] = *element;
+            } else if (componentType == GLTF_UNSIGNED_SHORT) {
+                uint16_t v;
+                memcpy(&v, element, sizeof(v));
+                out[i] = v;
+            } else {
+                memcpy(&out[i], element, sizeof(uint32_t));
+            }
+        }
+        return true;
+    }
+
+    bool load_gltf_document(const std::string& path, GltfDocument& doc, std::string& error) {
+        std::vector<uint8_t> contents;
+        if (!read_file(path, contents)) {
+            error = "cannot read " + path;
+            return false;
+        }
+
+        std::string jsonText;
+        std::vector<uint8_t> binChunk;
+        uint32_t magic = 0;
+        if (contents.size() >= 12) memcpy(&magic, contents.data(), sizeof(magic));
+        if (magic == GLB_MAGIC) {
+            size_t offset = 12;
+            while (offset + 8 <= contents.size()) {
+                uint32_t chunkLength, chunkType;
+                memcpy(&chunkLength, contents.data() + offset, 4);
+                memcpy(&chunkType, contents.data() + offset + 4, 4);
+                offset += 8;
+                if (offset + chunkLength > contents.size()) {
+                    error = "truncated GLB chunk";
+                    return false;
+                }
+                if (chunkType == GLB_CHUNK_JSON) {
+                    jsonText.assign((const char*)contents.data() + offset, chunkLength);
+                } else if (chunkType == GLB_CHUNK_BIN && binChunk.empty()) {
+                    binChunk.assign(contents.begin() + offset, contents.begin() + offset + chunkLength);
+                }
+                offset += chunkLength;
+            }
+        } else {
+            jsonText.assign(contents.begin(), contents.end());
+        }
+
+        JsonParser parser(jsonText.c_str(), jsonText.c_str() + jsonText.size());
+        if (!parser.parse(doc.json) || doc.json.type != Json::Object) {
+            error = "invalid glTF JSON";
+            return false;
+        }
+
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        if (const Json* buffers = doc.json.find("buffers")) {
+            for (const Json& buffer : buffers->items) {
+                doc.buffers.emplace_back();
+                const Json* uri = buffer.find("uri");
+                if (!uri) {
+                    // Only the first buffer of a .glb may omit its URI; it is the binary chunk
+                    doc.buffers.back() = std::move(binChunk);
+                    binChunk.clear();
+                } else if (uri->string.compare(0, 5, "data:") == 0) {
+                    const size_t comma = uri->string.find(',');
+                    if (comma == std::string::npos || uri->string.find(";base64") > comma ||
+                        !decode_base64(uri->string.substr(comma + 1), doc.buffers.back())) {
+                        error = "unsupported data URI";
+                        return false;
+                    }
+                } else if (!read_file((directory / uri->string).string(), doc.buffers.back())) {
+                    error = "cannot read buffer " + uri->string;
+                    return false;
+                }
+                if (doc.buffers.back().size() < (size_t)buffer.integer("byteLength", 0)) {
+                    error = "buffer is shorter than its byteLength";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+bool import_obj(const std::string& path, MeshData& mesh, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot read " + path;
+        return false;
+    }
+
+    std::vector<simd::float3> positions;
+    std::vector<simd::float3> normals;
+    std::unordered_map<uint64_t, uint32_t> vertexLookup;  // (position, normal + 1) to vertex
+    std::vector<uint32_t> positionIds;
+    std::vector<bool> missingNormals;
+    mesh = MeshData();
+    mesh.indices.format = IndexFormat::UInt32;
+    std::vector<uint32_t>& indices = mesh.indices.indices32;
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "v" || keyword == "vn") {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            tokens >> x >> y >> z;
+            (keyword == "v" ? positions : normals).push_back(simd::float3{ x, y, z });
+        } else if (keyword == "f") {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while (tokens >> corner) {
+                // v, v/vt, v//vn or v/vt/vn
+                const long p = obj_index(strtol(corner.c_str(), nullptr, 10), positions.size());
+                long n = -1;
+                const size_t lastSlash = corner.rfind('/');
+                if (lastSlash != std::string::npos && corner.find('/') != lastSlash) {
+                    n = obj_index(strtol(corner.c_str() + lastSlash + 1, nullptr, 10), normals.size());
+                }
+                if (p < 0) {
+                    error = path + ":" + std::to_string(lineNumber) + ": face refers to a missing vertex";
+                    return false;
+                }
+                const uint64_t key = ((uint64_t)p << 32) | (uint64_t)(n + 1);
+                auto found = vertexLookup.find(key);
+                if (found == vertexLookup.end()) {
+                    Vertex vertex;
+                    vertex.position = positions[p];
+                    vertex.normal = n >= 0 ? simd::normalize(normals[n]) : simd::float3{ 0.0f, 0.0f, 0.0f };
+                    found = vertexLookup.emplace(key, (uint32_t)mesh.vertices.size()).first;
+                    mesh.vertices.push_back(vertex);
+                    positionIds.push_back((uint32_t)p);
+                    missingNormals.push_back(n < 0);
+                }
+                polygon.push_back(found->second);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                indices.push_back(polygon[0]);
+                indices.push_back(polygon[i - 1]);
+                indices.push_back(polygon[i]);
+            }
+        }
+    }
+    if (indices.empty()) {
+        error = path + " has no faces";
+        return false;
+    }
+    finish_mesh(mesh, positionIds, missingNormals);
+    return true;
+}
+
+bool import_gltf(const std::string& path, MeshData& mesh, std::string& error) {
+    GltfDocument doc;
+    if (!load_gltf_document(path, doc, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+
+    mesh = MeshData();
+    mesh.indices.format = IndexFormat::UInt32;
+    std::vector<uint32_t> positionIds;
+    std::vector<bool> missingNormals;
+    for (const Json& source : items(doc.json, "meshes")) {
+        for (const Json& primitive : items(source, "primitives")) {
+            const Json* attributes = primitive.find("attributes");
+            if (primitive.integer("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES || !attributes) {
+                continue;
+            }
+            std::vector<simd::float3> positions;
+            std::vector<simd::float3> normals;
+            if (!read_float3s(doc, attributes->integer("POSITION", -1), positions, error)) {
+                error = path + ": " + error;
+                return false;
+            }
+            const int normalAccessor = attributes->integer("NORMAL", -1);
+            if (normalAccessor >= 0 && !read_float3s(doc, normalAccessor, normals, error)) {
+                error = path + ": " + error;
+                return false;
+            }
+            std::vector<uint32_t> indices;
+            const int indexAccessor = primitive.integer("indices", -1);
+            if (indexAccessor >= 0) {
+                if (!read_indices(doc, indexAccessor, indices, error)) {
+                    error = path + ": " + error;
+                    return false;
+                }
+            } else {
+                for (uint32_t i = 0; i < positions.size(); ++i) indices.push_back(i);
+            }
+
+            const uint32_t base = (uint32_t)mesh.vertices.size();
+            const bool hasNormals = normals.size() == positions.size();
+            for (size_t i = 0; i < positions.size(); ++i) {
+                Vertex vertex;
+                vertex.position = positions[i];
+                vertex.normal = hasNormals ? normals[i] : simd::float3{ 0.0f, 0.0f, 0.0f };
+                mesh.vertices.push_back(vertex);
+                positionIds.push_back(base + (uint32_t)i);
+                missingNormals.push_back(!hasNormals);
+            }
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                if (indices[i] >= positions.size() || indices[i + 1] >= positions.size() ||
+                    indices[i + 2] >= positions.size()) {
+                    error = path + ": index out of range";
+                    return false;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    mesh.indices.indices32.push_back(base + indices[i + k]);
+                }
+            }
+        }
+    }
+    if (mesh.indices.indices32.empty()) {
+        error = path + " has no triangle primitives";
+        return false;
+    }
+    finish_mesh(mesh, positionIds, missingNormals);
+    return true;
+}
+
+bool import_mesh(const std::string& path, MeshData& mesh, std::string& error) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    for (char& c : extension) c = (char)tolower(c);
+    if (extension == ".obj") {
+        return import_obj(path, mesh, error);
+    }
+    if (extension == ".gltf" || extension == ".glb") {
+        return import_gltf(path, mesh, error);
+    }
+    error = path + ": unsupported file type; expected .obj, .gltf or .glb";
+    return false;
+}
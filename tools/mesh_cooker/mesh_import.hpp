@@ -0,0 +1,45 @@
+/**
+ * @file mesh_import.hpp
+ * @brief Reads authored meshes into MeshData for the cooker; never used by the renderer.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "objects.hpp"
+
+/**
+ * @brief Imports a Wavefront OBJ file.
+ *
+ * Polygons are fanned into triangles and every distinct position/normal pair becomes one
+ * vertex. Texture coordinates, groups and materials are ignored. Vertices without a normal
+ * get the area-weighted average of the faces around their position.
+ *
+ * @param path The file to read.
+ * @param mesh Receives the mesh, with 32-bit indices.
+ * @param error Receives a description of the problem if the import fails.
+ * @return True if the mesh was imported.
+ */
+bool import_obj(const std::string& path, MeshData& mesh, std::string& error);
+
+/**
+ * @brief Imports the triangle primitives of a glTF 2.0 file, .gltf or .glb.
+ *
+ * All primitives of all meshes are merged in mesh space; node transforms, materials and
+ * attributes other than POSITION and NORMAL are ignored. Buffers may be external files,
+ * base64 data URIs or the binary chunk of a .glb. Missing normals are generated as in
+ * import_obj().
+ *
+ * @param path The file to read.
+ * @param mesh Receives the mesh, with 32-bit indices.
+ * @param error Receives a description of the problem if the import fails.
+ * @return True if the mesh was imported.
+ */
+bool import_gltf(const std::string& path, MeshData& mesh, std::string& error);
+
+/**
+ * @brief Imports a mesh, picking the importer from the file extension.
+ * @copydetails import_obj
+ */
+bool import_mesh(const std::string& path, MeshData& mesh, std::string& error);
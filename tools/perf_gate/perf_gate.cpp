@@ -0,0 +1,119 @@
+/**
+ * @file perf_gate.cpp
+ * @brief Offline tool: compares benchmark reports with the baselines stored for the device.
+ *
+ * Usage: perf_gate [--baselines <dir>] [--device <class>] [--threshold <fraction>] [--alpha <p>]
+ *                  [--update] <report.json>...
+ *
+ * Each report is compared with <dir>/<class>/<report file name>, metric by metric (see
+ * perf_gate.hpp). The class defaults to the device named in the first frame benchmark report,
+ * so microbenchmark reports passed alongside it share its baselines. --update stores the
+ * reports as the new baselines instead. Exits with 1 if any metric regressed.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "perf_gate.hpp"
+
+int main(int argc, char** argv) {
+    std::filesystem::path baselines = "benchmarks/baselines";
+    std::string deviceClass;
+    PerfGateSettings settings;
+    bool update = false;
+    std::vector<const char*> reports;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--baselines") == 0 && i + 1 < argc) {
+            baselines = argv[++i];
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            deviceClass = perf_device_class(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            settings.threshold = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            settings.alpha = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (argv[i][0] == '-') {
+            reports.clear();
+            break;
+        } else {
+            reports.push_back(argv[i]);
+        }
+    }
+    if (reports.empty()) {
+        fprintf(stderr,
+                "usage: %s [--baselines <dir>] [--device <class>] [--threshold <fraction>] [--alpha <p>] "
+                "[--update] <report.json>...\n",
+                argv[0]);
+        return 2;
+    }
+
+    std::vector<JsonValue> roots(reports.size());
+    std::string error;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        if (!load_json(reports[i], roots[i], error)) {
+            fprintf(stderr, "%s: %s\n", reports[i], error.c_str());
+            return 2;
+        }
+        if (deviceClass.empty() && !perf_report_device(roots[i]).empty()) {
+            deviceClass = perf_device_class(perf_report_device(roots[i]));
+        }
+    }
+    if (deviceClass.empty()) {
+        deviceClass = perf_device_class("");
+    }
+
+    int regressions = 0;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        const std::filesystem::path baselinePath =
+            baselines / deviceClass / std::filesystem::path(reports[i]).filename();
+        std::vector<PerfMetric> current;
+        if (!parse_perf_report(roots[i], current, error)) {
+            fprintf(stderr, "%s: %s\n", reports[i], error.c_str());
+            return 2;
+        }
+        if (update) {
+            std::error_code ec;
+            std::filesystem::create_directories(baselinePath.parent_path(), ec);
+            std::filesystem::copy_file(reports[i], baselinePath, std::filesystem::copy_options::overwrite_existing,
+                                       ec);
+            if (ec) {
+                fprintf(stderr, "cannot write %s: %s\n", baselinePath.string().c_str(), ec.message().c_str());
+                return 2;
+            }
+            printf("%s: stored as the baseline for %s\n", reports[i], deviceClass.c_str());
+            continue;
+        }
+
+        JsonValue baselineRoot;
+        std::vector<PerfMetric> baseline;
+        if (!std::filesystem::exists(baselinePath)) {
+            printf("%s: no baseline for %s yet; run with --update to store one\n", reports[i], deviceClass.c_str());
+            continue;
+        }
+        if (!load_json(baselinePath.string().c_str(), baselineRoot, error) ||
+            !parse_perf_report(baselineRoot, baseline, error)) {
+            fprintf(stderr, "%s: %s\n", baselinePath.string().c_str(), error.c_str());
+            return 2;
+        }
+
+        printf("%s against %s:\n", reports[i], baselinePath.string().c_str());
+        for (const PerfComparison& comparison : compare_perf_metrics(baseline, current, settings)) {
+            printf("  %-48s %10.4f -> %10.4f ms  %+7.1f%%  p %.4f  %s\n", comparison.name.c_str(),
+                   comparison.baselineMedian, comparison.currentMedian, comparison.change * 100.0f, comparison.p,
+                   perf_verdict_name(comparison.verdict));
+            regressions += comparison.verdict == PerfVerdict::Regressed;
+        }
+    }
+    if (regressions > 0) {
+        printf("%d metric(s) regressed by more than %.1f%% (p < %g)\n", regressions, settings.threshold * 100.0f,
+               settings.alpha);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+# Runs the benchmark suite and compares the reports with the stored baselines.
+# Invoked by the perf_gate test (ctest -L perf); see the Performance Gate section of CMakeLists.txt.
+# Set PERF_GATE_UPDATE in the environment to store the reports as the new baselines instead.
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+set(REPORTS ${OUTPUT_DIR}/flyover.json)
+
+execute_process(
+    COMMAND ${GLFW_METAL} --benchmark ${CAMERA_PATH} --benchmark-output ${OUTPUT_DIR}/flyover.json
+    RESULT_VARIABLE RESULT
+)
+if (RESULT)
+    message(FATAL_ERROR "The frame benchmark failed: ${RESULT}")
+endif()
+
+# Every repetition is one sample of the rank test
+if (RUN_BENCHMARKS)
+    execute_process(
+        COMMAND ${RUN_BENCHMARKS} --benchmark_repetitions=10 --benchmark_out=${OUTPUT_DIR}/microbenchmarks.json
+                --benchmark_out_format=json
+        OUTPUT_QUIET
+        RESULT_VARIABLE RESULT
+    )
+    if (RESULT)
+        message(FATAL_ERROR "run_benchmarks failed: ${RESULT}")
+    endif()
+    list(APPEND REPORTS ${OUTPUT_DIR}/microbenchmarks.json)
+endif()
+
+set(ARGS --baselines ${BASELINES})
+if (DEVICE_CLASS)
+    list(APPEND ARGS --device ${DEVICE_CLASS})
+endif()
+if (DEFINED ENV{PERF_GATE_UPDATE})
+    list(APPEND ARGS --update)
+endif()
+
+execute_process(COMMAND ${PERF_GATE} ${ARGS} ${REPORTS} RESULT_VARIABLE RESULT)
+if (RESULT)
+    message(FATAL_ERROR "Performance gate failed")
+endif()
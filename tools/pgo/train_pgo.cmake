@@ -0,0 +1,41 @@
+# Trains the PGO profile: runs an instrumented glfw_metal (-DPGO_INSTRUMENT=ON) through the frame
+# benchmarks and merges the raw profiles into PGO_PROFILE, which Dist builds are then optimized with.
+# Invoked by the pgo_train target; see the Optimization section of CMakeLists.txt.
+
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+
+# The forward and deferred paths over the flyover, and a crowded scene for the culling and batching paths
+set(RUNS
+    "--benchmark;${PATHS_DIR}/flyover.json"
+    "--benchmark;${PATHS_DIR}/flyover.json;--deferred"
+    "--benchmark;${PATHS_DIR}/stress.json;--stress;100000;--stress-lights;64"
+)
+set(INDEX 0)
+foreach(RUN ${RUNS})
+    # %p keeps the profiles of concurrent processes apart; each run writes its own anyway
+    set(ENV{LLVM_PROFILE_FILE} ${OUTPUT_DIR}/glfw_metal-${INDEX}-%p.profraw)
+    execute_process(
+        COMMAND ${GLFW_METAL} ${RUN} --benchmark-output ${OUTPUT_DIR}/report-${INDEX}.json
+        RESULT_VARIABLE RESULT
+    )
+    if (RESULT)
+        message(FATAL_ERROR "Training run ${INDEX} failed: ${RESULT}")
+    endif()
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+file(GLOB PROFILES ${OUTPUT_DIR}/*.profraw)
+if (NOT PROFILES)
+    message(FATAL_ERROR "No profiles were written; was glfw_metal built with -DPGO_INSTRUMENT=ON?")
+endif()
+get_filename_component(PROFILE_DIR ${PGO_PROFILE} DIRECTORY)
+file(MAKE_DIRECTORY ${PROFILE_DIR})
+execute_process(
+    COMMAND xcrun llvm-profdata merge -output=${PGO_PROFILE} ${PROFILES}
+    RESULT_VARIABLE RESULT
+)
+if (RESULT)
+    message(FATAL_ERROR "llvm-profdata failed: ${RESULT}")
+endif()
+message(STATUS "Wrote ${PGO_PROFILE}; reconfigure a Dist build to use it")
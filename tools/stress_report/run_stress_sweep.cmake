@@ -0,0 +1,35 @@
+# Runs the stress benchmark at a range of scene sizes and tabulates where each metric stops scaling.
+# Invoked by the stress_sweep target; see the Stress Sweep section of CMakeLists.txt.
+# OBJECT_COUNTS and LIGHTS may be overridden with -D when running the script by hand.
+
+if (NOT OBJECT_COUNTS)
+    set(OBJECT_COUNTS 1000 4000 16000 64000 256000 1000000)
+endif()
+if (NOT LIGHTS)
+    set(LIGHTS 256)
+endif()
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+set(REPORTS)
+foreach(COUNT ${OBJECT_COUNTS})
+    message(STATUS "Stress benchmark with ${COUNT} objects")
+    execute_process(
+        COMMAND ${GLFW_METAL} --benchmark ${CAMERA_PATH} --stress ${COUNT} --stress-lights ${LIGHTS}
+                --benchmark-output ${OUTPUT_DIR}/stress_${COUNT}.json
+        RESULT_VARIABLE RESULT
+    )
+    if (RESULT)
+        message(FATAL_ERROR "The stress benchmark with ${COUNT} objects failed: ${RESULT}")
+    endif()
+    list(APPEND REPORTS ${OUTPUT_DIR}/stress_${COUNT}.json)
+endforeach()
+
+execute_process(
+    COMMAND ${STRESS_REPORT} ${REPORTS}
+    OUTPUT_FILE ${OUTPUT_DIR}/scaling.csv
+    RESULT_VARIABLE RESULT
+)
+if (RESULT)
+    message(FATAL_ERROR "stress_report failed: ${RESULT}")
+endif()
+message(STATUS "Scaling table written to ${OUTPUT_DIR}/scaling.csv")
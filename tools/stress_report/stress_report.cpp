@@ -0,0 +1,112 @@
+/**
+ * @file stress_report.cpp
+ * @brief Offline tool: tabulates the frame benchmark reports of a stress sweep by object count.
+ *
+ * Usage: stress_report [--max-exponent <e>] [--min-ms <ms>] <report.json>...
+ *
+ * Every report must come from a `--stress` run. They are ordered by object count, and every
+ * sample series (frame, phase and GPU pass times) becomes one CSV row on stdout: the metric,
+ * its median at each count, and the count at which it stops scaling (see perf_scaling()),
+ * or nothing if it kept up. The header row holds the counts, so the table plots as is.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "perf_gate.hpp"
+
+namespace {
+    struct StressRun {
+        uint32_t objects = 0;
+        std::vector<PerfMetric> metrics;
+    };
+
+    float median(std::vector<float> samples) {
+        if (samples.empty()) {
+            return 0.0f;
+        }
+        const size_t mid = samples.size() / 2;
+        std::nth_element(samples.begin(), samples.begin() + mid, samples.end());
+        return samples[mid];
+    }
+}
+
+int main(int argc, char** argv) {
+    float maxExponent = 1.2f;
+    float minMs = 0.05f;
+    std::vector<const char*> reports;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--max-exponent") == 0 && i + 1 < argc) {
+            maxExponent = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc) {
+            minMs = (float)atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            reports.clear();
+            break;
+        } else {
+            reports.push_back(argv[i]);
+        }
+    }
+    if (reports.size() < 2) {
+        fprintf(stderr, "usage: %s [--max-exponent <e>] [--min-ms <ms>] <report.json> <report.json>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<StressRun> runs(reports.size());
+    std::string error;
+    for (size_t i = 0; i < reports.size(); ++i) {
+        JsonValue root;
+        if (!load_json(reports[i], root, error) || !parse_perf_report(root, runs[i].metrics, error)) {
+            fprintf(stderr, "%s: %s\n", reports[i], error.c_str());
+            return 2;
+        }
+        const JsonValue* stress = root.find("stress");
+        const JsonValue* objects = stress ? stress->find("objects") : nullptr;
+        if (!objects || objects->type != JsonValue::NUMBER) {
+            fprintf(stderr, "%s: not a --stress report\n", reports[i]);
+            return 2;
+        }
+        runs[i].objects = (uint32_t)objects->number;
+    }
+    std::sort(runs.begin(), runs.end(), [](const StressRun& a, const StressRun& b) { return a.objects < b.objects; });
+
+    std::vector<uint32_t> counts;
+    printf("metric");
+    for (const StressRun& run : runs) {
+        counts.push_back(run.objects);
+        printf(",%u", run.objects);
+    }
+    printf(",knee\n");
+
+    // The metrics of the smallest run; a pass only some runs profiled is left out
+    for (const PerfMetric& metric : runs.front().metrics) {
+        std::vector<float> medians;
+        for (const StressRun& run : runs) {
+            const auto found = std::find_if(run.metrics.begin(), run.metrics.end(),
+                                            [&](const PerfMetric& other) { return other.name == metric.name; });
+            if (found == run.metrics.end() || found->samples.empty()) {
+                break;
+            }
+            medians.push_back(median(found->samples));
+        }
+        if (medians.size() != runs.size()) {
+            continue;
+        }
+        const PerfScaling scaling = perf_scaling(counts, medians, maxExponent, minMs);
+        printf("%s", metric.name.c_str());
+        for (float ms : medians) {
+            printf(",%.4f", ms);
+        }
+        if (scaling.knee < counts.size()) {
+            printf(",%u\n", counts[scaling.knee]);
+        } else {
+            printf(",\n");
+        }
+    }
+    return 0;
+}
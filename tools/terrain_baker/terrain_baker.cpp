@@ -0,0 +1,180 @@
+/**
+ * @file terrain_baker.cpp
+ * @brief Offline tool: bakes the terrain tiles of a range of chunks, on any platform and any number of machines.
+ *
+ * Usage:
+ *   terrain_baker [options] <cache root> <min x> <min z> <max x> <max z>
+ *   terrain_baker [options] --store <store> <min x> <min z> <max x> <max z>
+ *   terrain_baker --merge <store> <workers>
+ *   terrain_baker --install <store> <cache root>
+ *
+ * The first form writes the tiles straight into the generator's directory under the cache
+ * root, the directory glfw_metal reads with the same terrain options. The second bakes into
+ * a farm store shared by the workers (see tile_farm.hpp); --merge then checks the workers'
+ * manifests and writes the store's manifest, and --install links its tiles into a cache.
+ * --shard i/n makes this process worker i of n, baking only its regions of the range.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+#include "terrain_bake.hpp"
+#include "tile_farm.hpp"
+
+namespace {
+    void print_usage(const char* program) {
+        fprintf(stderr,
+                "usage: %s [options] <cache root> <min x> <min z> <max x> <max z>\n"
+                "       %s [options] --store <store> <min x> <min z> <max x> <max z>\n"
+                "       %s --merge <store> <workers>\n"
+                "       %s --install <store> <cache root>\n"
+                "options: [--resolution n] [--chunk-size s] [--float-vertices] [--height-maps] [--compress]\n"
+                "         [--terrain-seed n] [--terrain-octaves n] [--terrain-height h] [--shard i/n]\n"
+                "         [--region-chunks n]\n",
+                program, program, program, program);
+    }
+
+    int merge(const char* store, uint32_t workerCount) {
+        TileFarmManifest merged;
+        std::string error;
+        if (!merge_tile_farm(store, workerCount, merged, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        printf("%s: %zu tiles from %u workers (generator %016" PRIx64 ")\n", tile_farm_manifest_path(store).c_str(),
+               merged.entries.size(), workerCount, merged.job.generatorKey);
+        return 0;
+    }
+
+    int install(const char* store, const char* cacheRoot) {
+        TileFarmManifest manifest;
+        std::string error;
+        if (!read_tile_farm_manifest(tile_farm_manifest_path(store), manifest, error) ||
+            !install_tile_farm(store, manifest, cacheRoot, error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        printf("%s: %zu tiles installed\n", terrain_tile_directory(cacheRoot, manifest.job.generatorKey).c_str(),
+               manifest.entries.size());
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], "--merge") == 0) {
+        return merge(argv[2], (uint32_t)std::max(atoi(argv[3]), 1));
+    }
+    if (argc == 4 && strcmp(argv[1], "--install") == 0) {
+        return install(argv[2], argv[3]);
+    }
+
+    TerrainBakeSettings settings;
+    TileFarmJob job;
+    uint32_t shard = 0;
+    const char* store = nullptr;
+    std::vector<const char*> positional;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc) {
+            settings.resolution = std::clamp(atoi(argv[++i]), 2, 1025);
+        } else if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            settings.chunkSize = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--float-vertices") == 0) {
+            settings.vertexFormat = VertexFormat::Float;
+        } else if (strcmp(argv[i], "--height-maps") == 0) {
+            settings.heightMaps = true;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            settings.compressed = true;
+        } else if (strcmp(argv[i], "--terrain-seed") == 0 && i + 1 < argc) {
+            settings.terrain.noise.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--terrain-octaves") == 0 && i + 1 < argc) {
+            settings.terrain.noise.octaves = (uint32_t)std::clamp(atoi(argv[++i]), 1, 16);
+        } else if (strcmp(argv[i], "--terrain-height") == 0 && i + 1 < argc) {
+            settings.terrain.height = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%u/%u", &shard, &job.workerCount) == 2 && shard < job.workerCount) {
+            ++i;
+        } else if (strcmp(argv[i], "--region-chunks") == 0 && i + 1 < argc) {
+            job.regionChunks = std::max(atoi(argv[++i]), 1);
+        } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store = argv[++i];
+        } else if (argv[i][0] != '-' || (argv[i][1] >= '0' && argv[i][1] <= '9')) {
+            positional.push_back(argv[i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    const size_t rangeStart = store ? 0 : 1;
+    if (positional.size() != rangeStart + 4 || settings.chunkSize <= 0.0f) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    job.range.minX = atoi(positional[rangeStart]);
+    job.range.minZ = atoi(positional[rangeStart + 1]);
+    job.range.maxX = atoi(positional[rangeStart + 2]);
+    job.range.maxZ = atoi(positional[rangeStart + 3]);
+    if (chunk_range_count(job.range) == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    job.generatorKey = terrain_tile_generator_key(terrain_bake_tile_params(settings));
+    const std::vector<ChunkKey> keys = tile_farm_worker_chunks(job, shard);
+    // Farm tiles are written next to the objects, so moving them in is a rename
+    const std::string directory = store ? (std::filesystem::path(store) / "incoming" / std::to_string(shard)).string()
+                                        : terrain_tile_directory(positional[0], job.generatorKey);
+
+    TileFarmManifest manifest;
+    manifest.job = job;
+    manifest.worker = (int32_t)shard;
+    manifest.entries.resize(keys.size());
+    std::vector<uint8_t> baked(keys.size(), 0);
+
+    JobSystem jobs;
+    std::atomic<uint32_t> failed{ 0 };
+    jobs.parallel_for((uint32_t)keys.size(), 16, [&](uint32_t begin, uint32_t end) {
+        std::vector<Vertex> vertices;
+        std::vector<uint8_t> payload;
+        for (uint32_t i = begin; i < end; ++i) {
+            bool ok = bake_terrain_tile(directory, keys[i], settings, vertices, payload);
+            if (ok && store) {
+                ok = store_tile_farm_object(store, terrain_tile_path(directory, keys[i]), keys[i], manifest.entries[i]);
+            }
+            if (!ok) {
+                fprintf(stderr, "cannot write the tile of chunk %d, %d\n", keys[i].x, keys[i].z);
+                failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            baked[i] = ok;
+        }
+    });
+
+    const char* output = directory.c_str();
+    std::string manifestPath;
+    if (store) {
+        // Failed tiles stay out of the manifest, so the merge reports them
+        size_t kept = 0;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (baked[i]) {
+                manifest.entries[kept++] = manifest.entries[i];
+            }
+        }
+        manifest.entries.resize(kept);
+        manifestPath = tile_farm_partial_manifest_path(store, shard, job.workerCount);
+        if (!write_tile_farm_manifest(manifestPath, manifest)) {
+            fprintf(stderr, "cannot write %s\n", manifestPath.c_str());
+            return 1;
+        }
+        output = manifestPath.c_str();
+    }
+    printf("%s: %zu tiles baked, %u failed (generator %016" PRIx64 ")\n", output, keys.size() - failed.load(),
+           failed.load(), job.generatorKey);
+    return failed.load() == 0 ? 0 : 1;
+}